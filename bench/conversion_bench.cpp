@@ -0,0 +1,166 @@
+/*
+    Microbenchmark of the segment conversion strategies, one backend per binary (the headers
+    all define ManSeg::TwoSegArray, so they cannot share a translation unit):
+        MANSEG_BENCH_BACKEND=0  sse          manseglib.hpp, element conversions as SSE casts
+        MANSEG_BENCH_BACKEND=1  shift        manseglib.hpp, element conversions as memcpy + shifts
+        MANSEG_BENCH_BACKEND=2  pun          manseglib_int_shift_pun.hpp, union punning
+        MANSEG_BENCH_BACKEND=3  reinterpret  manseglib_int_shift_reinterpret.hpp, reinterpret_cast shifts
+
+    Each of heads, pairs and double arrays is read (sum += a[i]), written (a[i] = v) and
+    compound assigned (a[i] += v), sequentially and through a random permutation, at a cache
+    resident and a DRAM resident size. Times are reported per element, and bandwidth counts the
+    bytes of the array touched (read, write, or both for compound assignment), not the indices.
+
+    usage: conversion_bench [cache elements] [dram elements] [seconds per case]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+
+#include <stdlib.h>
+
+#if !defined(MANSEG_BENCH_BACKEND)
+#define MANSEG_BENCH_BACKEND 0
+#endif
+
+#if MANSEG_BENCH_BACKEND == 0
+#define MANSEG_ELEMENT_SSE
+#include "../manseglib.hpp"
+const char* backendName = "sse";
+#elif MANSEG_BENCH_BACKEND == 1
+#define MANSEG_ELEMENT_SHIFTS
+#include "../manseglib.hpp"
+const char* backendName = "shift";
+#elif MANSEG_BENCH_BACKEND == 2
+#include "../manseglib_int_shift_pun.hpp"
+const char* backendName = "pun";
+#elif MANSEG_BENCH_BACKEND == 3
+#include "../manseglib_int_shift_reinterpret.hpp"
+const char* backendName = "reinterpret";
+#else
+#error "MANSEG_BENCH_BACKEND must be 0 (sse), 1 (shift), 2 (pun) or 3 (reinterpret)"
+#endif
+
+using namespace ManSeg;
+using namespace std;
+
+enum Op { OP_READ, OP_WRITE, OP_COMPOUND };
+const char* opNames[] = { "read", "write", "compound" };
+
+// keeps the compiler from discarding the reads
+volatile double sink;
+
+// index of element j: j itself, or the j'th entry of a random permutation
+struct Sequential { uint_fast64_t operator()(const int32_t*, const uint_fast64_t& j) const { return j; } };
+struct Random { uint_fast64_t operator()(const int32_t* perm, const uint_fast64_t& j) const { return perm[j]; } };
+
+template<Op op, class Index, class Arr>
+void sweep(Arr& a, const int32_t* perm, const uint_fast64_t& n)
+{
+    Index index;
+    if(op == OP_READ)
+    {
+        // independent sums, so the loop is not bound by the latency of the additions
+        double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+        uint_fast64_t j = 0;
+        for(; j + 4 <= n; j += 4)
+        {
+            sum[0] += a[index(perm, j)];
+            sum[1] += a[index(perm, j + 1)];
+            sum[2] += a[index(perm, j + 2)];
+            sum[3] += a[index(perm, j + 3)];
+        }
+        for(; j < n; ++j)
+            sum[0] += a[index(perm, j)];
+        sink = sum[0] + sum[1] + sum[2] + sum[3];
+    }
+    else if(op == OP_WRITE)
+    {
+        for(uint_fast64_t j = 0; j < n; ++j)
+            a[index(perm, j)] = static_cast<double>(j) * 1e-6;
+    }
+    else
+    {
+        for(uint_fast64_t j = 0; j < n; ++j)
+            a[index(perm, j)] += static_cast<double>(j) * 1e-9;
+    }
+}
+
+// seconds per sweep, repeating the sweep until minTime has passed
+template<Op op, class Index, class Arr>
+double timeSweep(Arr& a, const int32_t* perm, const uint_fast64_t& n, const double& minTime)
+{
+    sweep<op, Index>(a, perm, n); // warm up caches and page tables
+    uint_fast64_t reps = 0;
+    double elapsed = 0.0;
+    auto start = chrono::steady_clock::now();
+    do
+    {
+        sweep<op, Index>(a, perm, n);
+        ++reps;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while(elapsed < minTime);
+    return elapsed / reps;
+}
+
+template<Op op, class Arr>
+void report(const char* arrayName, Arr& a, const int32_t* perm, const uint_fast64_t& n, const double& bytesPerElement, const double& minTime)
+{
+    const double bytes = bytesPerElement * (op == OP_COMPOUND ? 2.0 : 1.0);
+    const double seq = timeSweep<op, Sequential>(a, perm, n, minTime);
+    const double rnd = timeSweep<op, Random>(a, perm, n, minTime);
+    cout << setw(12) << backendName << setw(8) << arrayName << setw(10) << opNames[op] << setw(12) << n
+        << setw(10) << seq * 1e9 / n << setw(10) << bytes * n / seq * 1e-9
+        << setw(10) << rnd * 1e9 / n << setw(10) << bytes * n / rnd * 1e-9 << "\n";
+}
+
+template<class Arr>
+void benchArray(const char* arrayName, Arr& a, const int32_t* perm, const uint_fast64_t& n, const double& bytesPerElement, const double& minTime)
+{
+    for(uint_fast64_t i = 0; i < n; ++i)
+        a[i] = static_cast<double>(i) * 1e-6;
+    report<OP_READ>(arrayName, a, perm, n, bytesPerElement, minTime);
+    report<OP_WRITE>(arrayName, a, perm, n, bytesPerElement, minTime);
+    report<OP_COMPOUND>(arrayName, a, perm, n, bytesPerElement, minTime);
+}
+
+void benchSize(const uint_fast64_t& n, const double& minTime)
+{
+    int32_t* perm = new int32_t[n];
+    iota(perm, perm + n, 0);
+    shuffle(perm, perm + n, mt19937(5489));
+
+    TwoSegArray<false> heads(n);
+    TwoSegArray<true> pairs(n);
+    double* d = new double[n];
+
+    benchArray("heads", heads, perm, n, sizeof(float), minTime);
+    benchArray("pairs", pairs, perm, n, 2 * sizeof(float), minTime);
+    benchArray("double", d, perm, n, sizeof(double), minTime);
+
+    heads.del();
+    pairs.del();
+    delete[] d;
+    delete[] perm;
+}
+
+int main(int argc, char** argv)
+{
+    // 16K elements is 64KB of heads (inside L2); 32M elements is 256MB of doubles
+    const uint_fast64_t cacheElements = (argc > 1) ? strtoull(argv[1], nullptr, 10) : (1 << 14);
+    const uint_fast64_t dramElements = (argc > 2) ? strtoull(argv[2], nullptr, 10) : (1 << 25);
+    const double minTime = (argc > 3) ? atof(argv[3]) : 0.2;
+
+    cout << fixed << setprecision(3);
+    cout << setw(12) << "backend" << setw(8) << "array" << setw(10) << "op" << setw(12) << "elements"
+        << setw(10) << "seq ns" << setw(10) << "seq GB/s" << setw(10) << "rand ns" << setw(10) << "rand GB/s" << "\n";
+
+    benchSize(cacheElements, minTime);
+    benchSize(dramElements, minTime);
+
+    return 0;
+}
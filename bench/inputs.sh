@@ -0,0 +1,49 @@
+#!/bin/bash
+
+## Generates the inputs of regress.sh and sweep.sh in $WORK (once), with a fixed seed so every machine
+## runs the same problems. Sourced by both scripts after they set WORK.
+
+# skewed random graph: exponential out degrees (mean 8), destinations biased to low ids
+if [ ! -f $WORK/rmat.coo ] || [ ! -f $WORK/rmat.adj ]
+then
+    awk -v n=524288 -v work=$WORK 'BEGIN {
+        x = 1; m = 0
+        for (v = 0; v < n; v++) {
+            x = (x * 16807) % 2147483647
+            deg = int(-log((x + 1) / 2147483648) * 8)
+            offsets[v] = m
+            for (k = 0; k < deg; k++) {
+                x = (x * 16807) % 2147483647
+                u = x / 2147483647
+                print v, int(n * u * u) > (work "/edges.tmp")
+                m++
+            }
+        }
+        close(work "/edges.tmp")
+        print "%" > (work "/rmat.coo")
+        print n, m > (work "/rmat.coo")
+        print "AdjacencyGraph" > (work "/rmat.adj")
+        print n > (work "/rmat.adj")
+        print m > (work "/rmat.adj")
+        for (v = 0; v < n; v++)
+            print offsets[v] > (work "/rmat.adj")
+    }'
+    cat $WORK/edges.tmp >> $WORK/rmat.coo
+    awk '{ print $2 }' $WORK/edges.tmp >> $WORK/rmat.adj
+    rm $WORK/edges.tmp
+fi
+
+# 5 point Poisson matrix on a 300 x 300 grid (lower triangle)
+if [ ! -f $WORK/poisson.mtx ]
+then
+    awk -v k=300 'BEGIN {
+        n = k * k
+        print "%%MatrixMarket matrix coordinate real symmetric"
+        print n, n, n + 2 * (n - k)
+        for (i = 1; i <= n; i++) {
+            print i, i, 4.0
+            if ((i - 1) % k != 0) print i, i - 1, -1.0
+            if (i > k) print i, i - k, -1.0
+        }
+    }' > $WORK/poisson.mtx
+fi
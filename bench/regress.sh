@@ -0,0 +1,118 @@
+#!/bin/bash
+
+## Performance regression check: runs every case of regress_cases.txt and compares its solve time,
+## iterations and iterations at the heads (before the precision switch) with regress_baseline.csv.
+## Build the programs first (make regress does both).
+##   ./regress.sh              compare, exit status 1 if a case is slower or converges differently
+##   ./regress.sh --baseline   write the measurements as the new baseline
+## THRESHOLD (default 0.10) is the slowdown flagged, REPEATS (default 3) the runs per case (the fastest
+## counts) and THREADS the thread count of "max" cases (default: all cores).
+## The solve time is the sum of the iteration times the driver writes to $MANSEG_RESULTS, or the wall
+## clock time of the run for drivers which do not write results.
+
+cd "$(dirname "$0")"
+
+THRESHOLD=${THRESHOLD:-0.10}
+REPEATS=${REPEATS:-3}
+THREADS=${THREADS:-$(nproc)}
+WORK=regress_work
+BASELINE=regress_baseline.csv
+CURRENT=$WORK/current.csv
+
+mkdir -p $WORK
+
+source ./inputs.sh
+
+## prints "time iterations heads_iterations" of a results CSV (- for what it does not have)
+summarise()
+{
+    awk -F, 'NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        $col["level"] != "round" {
+            t += $col["time"]; its++
+            if ($col["level"] == "heads") heads++; else switched = 1
+        }
+        END {
+            if (its == 0) { print "- - -"; exit }
+            printf "%.6f %d %s\n", t, its, switched ? heads : "-"
+        }' "$1"
+}
+
+# threads is as in regress_cases.txt, so "max" cases compare across machines
+echo "case,mode,threads,time,iterations,heads_iterations" > $CURRENT
+status=0
+while read -r name mode threads binary args
+do
+    case "$name" in ""|\#*) continue ;; esac
+    key="$name,$mode,$threads"
+    [ "$threads" = "max" ] && threads=$THREADS
+    args=${args//@WORK@/$WORK}
+
+    if [ ! -x $WORK/$binary ]
+    then
+        echo "SKIP    $key ($binary was not built)"
+        continue
+    fi
+
+    best=""
+    for ((r = 0; r < REPEATS; r++))
+    do
+        rm -f $WORK/results.csv
+        start=$(date +%s.%N)
+        if ! OMP_NUM_THREADS=$threads MANSEG_RESULTS=$WORK/results.csv ./$WORK/$binary $args < /dev/null > $WORK/$name.log 2>&1
+        then
+            echo "FAIL    $key (exit status, see $WORK/$name.log)"
+            status=1
+            best=""
+            break
+        fi
+        end=$(date +%s.%N)
+        if [ -f $WORK/results.csv ]
+        then
+            read -r t its heads <<< "$(summarise $WORK/results.csv)"
+        else
+            t=$(awk -v s=$start -v e=$end 'BEGIN { printf "%.6f", e - s }')
+            its=-
+            heads=-
+        fi
+        if [ -z "$best" ] || awk -v a=$t -v b=$best 'BEGIN { exit !(a < b) }'
+        then
+            best=$t
+        fi
+    done
+    [ -z "$best" ] && continue
+    echo "$key,$best,$its,$heads" >> $CURRENT
+
+    base=$(grep "^$key," $BASELINE 2>/dev/null)
+    if [ "$1" = "--baseline" ]
+    then
+        echo "RECORD  $key: ${best}s, $its iterations, $heads at the heads"
+    elif [ -z "$base" ]
+    then
+        echo "NEW     $key: ${best}s, $its iterations, $heads at the heads (no baseline)"
+    else
+        IFS=, read -r _ _ _ btime bits bheads <<< "$base"
+        verdict=$(awk -v t=$best -v b=$btime -v th=$THRESHOLD 'BEGIN {
+            if (t > b * (1 + th)) print "SLOW"; else if (t < b * (1 - th)) print "FASTER"; else print "OK" }')
+        if [ "$its" != "$bits" ] || [ "$heads" != "$bheads" ]
+        then
+            verdict=CHANGED
+        fi
+        printf "%-7s %s: %ss (baseline %ss), %s iterations (%s), %s at the heads (%s)\n" \
+            $verdict "$key" $best $btime $its $bits $heads $bheads
+        if [ $verdict = SLOW ] || [ $verdict = CHANGED ]
+        then
+            status=1
+        fi
+    fi
+done < regress_cases.txt
+
+if [ "$1" = "--baseline" ]
+then
+    {
+        echo "# $(uname -m), $(nproc) cores, $(${CXX:-g++} --version | head -1), $(date +%Y-%m-%d)"
+        cat $CURRENT
+    } > $BASELINE
+    echo "wrote $BASELINE"
+    exit 0
+fi
+exit $status
@@ -0,0 +1,192 @@
+#!/bin/bash
+
+## Thread and NUMA scaling of the drivers, per precision level: runs each app over a range of thread
+## counts on 1, 2, ... of the machine's NUMA nodes, and reports for every level the time of an
+## iteration, the bandwidth it reached, its speedup over one thread and its parallel efficiency.
+##   ./scaling.sh [pagerank] [f2d] [update] [jacobi] [cg]     (default: all five)
+## pagerank is ligra's PageRankManSeg, f2d PageRankUpdate_F2D (floats, then doubles), update the
+## double precision PageRankUpdate; jacobi is jacobi_mod_omp and cg sparsesolve. Build the programs
+## first (make scaling does both; the ligra apps are built with OpenMP in $WORK/scaling).
+## THREAD_COUNTS (default 1 2 4 ... and all the cores) are the counts tried on each set of nodes, up to
+## its cores, NODES (default: all of them, by numactl) the largest number of nodes bound to with
+## numactl --cpunodebind --membind, and REPEATS (default 1) the runs per point (the fastest counts).
+## Without numactl, or on one node, only the thread counts are swept.
+## Every point is written to $WORK/scaling_<app>.csv: per level the iterations, their time, the time
+## of one, the GB/s of the driver's bytes model, and the speedup and efficiency against one thread on
+## one node. Bandwidth is taken to saturate at the first thread count from which adding threads gains
+## less than SATURATION (default 0.25) of linear scaling; saturated = 1 marks it. The heads pay off
+## while an iteration at the lowest level is at least PAYOFF (default 1.1) times faster than one at the
+## highest, and the last table gives that ratio for each point.
+
+cd "$(dirname "$0")"
+
+REPEATS=${REPEATS:-1}
+SATURATION=${SATURATION:-0.25}
+PAYOFF=${PAYOFF:-1.1}
+WORK=regress_work
+
+mkdir -p $WORK
+
+source ./inputs.sh
+
+if [ -z "$THREAD_COUNTS" ]
+then
+    for ((t = 1; t < $(nproc); t *= 2))
+    do
+        THREAD_COUNTS="$THREAD_COUNTS $t"
+    done
+    THREAD_COUNTS="$THREAD_COUNTS $(nproc)"
+fi
+
+## the cpus of each NUMA node, one line per node, from numactl -H (none without numactl)
+if command -v numactl > /dev/null 2>&1
+then
+    node_cpus=$(numactl -H | awk '/^node [0-9]+ cpus:/ { print NF - 3 }')
+fi
+[ -z "$node_cpus" ] && node_cpus=$(nproc)
+available=$(echo "$node_cpus" | wc -l)
+NODES=${NODES:-$available}
+[ "$NODES" -gt "$available" ] && NODES=$available
+
+## binary and arguments of an app on threads threads and nodes nodes
+command_of()
+{
+    local app=$1 threads=$2 nodes=$3
+    # ligra's guidance is a few partitions per thread, and at least one per node
+    local parts=$((4 * threads > nodes ? 4 * threads : nodes))
+    case "$app" in
+    pagerank) echo "scaling/PageRankManSeg -c $parts -p $nodes -rounds 1 $WORK/rmat.adj" ;;
+    f2d) echo "scaling/PageRankUpdate_F2D -c $parts -p $nodes -rounds 1 $WORK/rmat.adj" ;;
+    update) echo "scaling/PageRankUpdate -c $parts -p $nodes -rounds 1 $WORK/rmat.adj" ;;
+    jacobi) echo "jacobi_mod_omp 30" ;;
+    cg) echo "sparsesolve $WORK/poisson.mtx 100 1e-7 2000 1e-7 100" ;;
+    esac
+}
+
+## prints "level iterations time bytes" for each level of a results CSV, in the order they first appear
+summarise()
+{
+    awk -F, 'NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        $col["level"] != "round" {
+            l = $col["level"]
+            if (!(l in its)) order[n++] = l
+            its[l]++; t[l] += $col["time"]; b[l] += $col["bytes"]
+        }
+        END { for (i = 0; i < n; i++) printf "%s %d %.6f %.0f\n", order[i], its[order[i]], t[order[i]], b[order[i]] }' "$1"
+}
+
+## runs app on threads threads bound to the first nodes nodes REPEATS times, and prints the levels of
+## the run with the fastest solve
+run_point()
+{
+    local app=$1 threads=$2 nodes=$3
+    local bind="" best="" levels="" total
+    if [ $available -gt 1 ]
+    then
+        bind="numactl --cpunodebind=0-$((nodes - 1)) --membind=0-$((nodes - 1))"
+    fi
+    local command=$(command_of $app $threads $nodes)
+    for ((r = 0; r < REPEATS; r++))
+    do
+        rm -f $WORK/results.csv
+        if ! OMP_NUM_THREADS=$threads CILK_NWORKERS=$threads MANSEG_RESULTS=$WORK/results.csv \
+            $bind ./$WORK/$command < /dev/null > $WORK/scaling_$app.log 2>&1 || [ ! -f $WORK/results.csv ]
+        then
+            echo "FAIL    $app on $threads threads, $nodes nodes (see $WORK/scaling_$app.log)" >&2
+            return
+        fi
+        total=$(summarise $WORK/results.csv | awk '{ t += $3 } END { printf "%.6f", t }')
+        if [ -z "$best" ] || awk -v a=$total -v b=$best 'BEGIN { exit !(a < b) }'
+        then
+            best=$total
+            levels=$(summarise $WORK/results.csv)
+        fi
+    done
+    echo "$levels"
+}
+
+## fills in speedup, efficiency and saturated in a scaling CSV, against the first row of each level
+## (one thread on one node); saturated marks, for each nodes and level, the first thread count from
+## which the next gains less than SATURATION of linear bandwidth scaling
+analyse()
+{
+    {
+        head -1 "$1"
+        tail -n +2 "$1" | awk -F, -v OFS=, -v s=$SATURATION '
+            { row[NR] = $0; key[NR] = $2 SUBSEP $4
+              if (!($4 in base)) base[$4] = $7
+              prev = last[key[NR]]
+              if (prev != "" && !(key[NR] in done)) {
+                  split(row[prev], p, ",")
+                  if (p[8] > 0 && ($8 / p[8] - 1) / ($3 / p[3] - 1) < s) { sat[prev] = 1; done[key[NR]] = 1 }
+              }
+              last[key[NR]] = NR }
+            END { for (i = 1; i <= NR; i++) {
+                      split(row[i], f, ",")
+                      speedup = f[7] > 0 ? base[f[4]] / f[7] : 0
+                      printf "%s,%s,%s,%s,%s,%s,%s,%s,%.3f,%.3f,%d\n", f[1], f[2], f[3], f[4], f[5], f[6], f[7], f[8],
+                          speedup, speedup / f[3], (i in sat) }
+            }'
+    } > "$1.tmp"
+    mv "$1.tmp" "$1"
+}
+
+apps="$*"
+[ -z "$apps" ] && apps="pagerank f2d update jacobi cg"
+for app in $apps
+do
+    command=$(command_of $app 1 1)
+    if [ -z "$command" ]
+    then
+        echo "unknown app $app (pagerank, f2d, update, jacobi or cg)"
+        exit 1
+    fi
+    if [ ! -x $WORK/${command%% *} ]
+    then
+        echo "SKIP    $app (${command%% *} was not built)"
+        continue
+    fi
+
+    out=$WORK/scaling_$app.csv
+    echo "app,nodes,threads,level,iterations,time,per_iteration,gbs,speedup,efficiency,saturated" > $out
+    for ((nodes = 1; nodes <= NODES; nodes++))
+    do
+        cores=$(echo "$node_cpus" | head -$nodes | awk '{ c += $1 } END { print c }')
+        # the counts that fit on these nodes, then all their cores
+        counts=""
+        for t in $THREAD_COUNTS
+        do
+            [ $t -lt $cores ] && counts="$counts $t"
+        done
+        for threads in $counts $cores
+        do
+            run_point $app $threads $nodes | while read -r level its t bytes
+            do
+                [ -z "$level" ] && continue
+                awk -v OFS=, -v a=$app -v n=$nodes -v p=$threads -v l=$level -v i=$its -v t=$t -v b=$bytes \
+                    'BEGIN { printf "%s,%d,%d,%s,%d,%.6f,%.6f,%.3f\n", a, n, p, l, i, t, t / i, (t > 0 ? b / t * 1e-9 : 0) }'
+            done >> $out
+        done
+    done
+    analyse $out
+
+    echo "Scaling of $app (time of an iteration, GB/s, speedup, efficiency; * where bandwidth saturates):"
+    awk -F, 'NR > 1 { printf "    %d nodes %4d threads  %-8s %10.6fs %8.2f GB/s %7.2fx %5.0f%%%s\n",
+        $2, $3, $4, $7, $8, $9, 100 * $10, ($11 == 1 ? " *" : "") }' $out
+    # the lowest level's iterations against the highest's, at each point
+    awk -F, -v payoff=$PAYOFF 'NR > 1 {
+            k = $2 "," $3
+            if (!(k in first)) { first[k] = $7; keys[n++] = k; low = $4 }
+            last[k] = $7; high[k] = $4
+        }
+        END {
+            if (n == 0 || high[keys[0]] == low) exit
+            printf "%s against %s per iteration:\n", low, high[keys[0]]
+            for (i = 0; i < n; i++) {
+                split(keys[i], p, ",")
+                r = first[keys[i]] > 0 ? last[keys[i]] / first[keys[i]] : 0
+                printf "    %d nodes %4d threads  %.2fx%s\n", p[1], p[2], r, (r < payoff ? " (no longer pays off)" : "")
+            }
+        }' $out
+    echo "(all points in $out)"
+done
@@ -0,0 +1,292 @@
+/*
+    STREAM style bandwidth harness for the segmented layouts: copy (c = a), scale (b = s * c),
+    add (c = a + b) and triad (a = b + s * c), plus a compensated sum of a, run over the heads,
+    the pairs and the full doubles of three ManSegArrays, and over float arrays as a baseline.
+    Bandwidth counts the bytes of every array read or written once per element, as STREAM does,
+    so heads move 4 bytes per element, pairs and full 8, and float 4.
+
+    The sweep covers thread counts (1, 2, 4, ... up to OMP_NUM_THREADS, or the given list) and
+    the placement of pages between NUMA nodes:
+        first-touch  each thread initialises (and so places) the part of the arrays it later streams
+        single       the master thread initialises everything, so all pages are on its node
+        interleave   pages are interleaved over every node with libnuma (when built with MANSEG_BENCH_NUMA)
+
+    Each kernel is timed repeats times and the best time is reported, against the given peak
+    bandwidth (e.g. channels * MT/s * 8 bytes) or, without one, the best bandwidth of the run.
+
+    usage: stream_bench [elements] [repeats] [peak GB/s] [threads, e.g. 1,4,16]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+#include <stdlib.h>
+#include <omp.h>
+
+#if defined(MANSEG_BENCH_NUMA)
+#include <numa.h>
+#endif
+
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+enum Kernel { K_COPY, K_SCALE, K_ADD, K_TRIAD, K_KAHAN, NUM_KERNELS };
+const char* kernelNames[NUM_KERNELS] = { "copy", "scale", "add", "triad", "kahan" };
+/* number of arrays each kernel streams */
+const int kernelArrays[NUM_KERNELS] = { 2, 2, 3, 3, 1 };
+
+constexpr double scalar = 3.0;
+
+// keeps the compiler from discarding the reductions
+volatile double sink;
+
+struct Result
+{
+    string layout;
+    string placement;
+    int threads;
+    double bandwidth[NUM_KERNELS]; // GB/s
+};
+
+#if defined(MANSEG_BENCH_NUMA)
+/* storage policy placing every array round robin over the NUMA nodes, a page at a time */
+struct InterleavedAllocator
+{
+    template<typename T>
+    T* allocate(const uint_fast64_t& length, const bool& zero)
+    {
+        void* mem = numa_alloc_interleaved(length * sizeof(T));
+        if(mem == nullptr)
+            throw std::bad_alloc();
+        return reinterpret_cast<T*>(mem);
+    }
+
+    template<typename T>
+    void deallocate(T* ptr, const uint_fast64_t& length) { numa_free(ptr, length * sizeof(T)); }
+};
+#endif
+
+// the part of [0, n) streamed by thread t of nt, with the same split as parallelReduceSum
+inline void chunk(const uint_fast64_t& n, const int& t, const int& nt, uint_fast64_t& start, uint_fast64_t& length)
+{
+    start = (n * t) / nt;
+    length = (n * (t + 1)) / nt - start;
+}
+
+/* the four STREAM kernels over the range of the calling thread, for any array the expressions accept */
+template<class X>
+void streamKernel(const Kernel& k, X& a, X& b, X& c, const uint_fast64_t& n)
+{
+    #pragma omp parallel
+    {
+        uint_fast64_t s, len;
+        chunk(n, omp_get_thread_num(), omp_get_num_threads(), s, len);
+        switch(k)
+        {
+            case K_COPY: assign(c, s, len, expr(a)); break;
+            case K_SCALE: assign(b, s, len, scalar * expr(c)); break;
+            case K_ADD: assign(c, s, len, expr(a) + expr(b)); break;
+            case K_TRIAD: assign(a, s, len, expr(b) + scalar * expr(c)); break;
+            default: break;
+        }
+    }
+}
+
+template<class X>
+void runKernel(const Kernel& k, X& a, X& b, X& c, const uint_fast64_t& n)
+{
+    if(k == K_KAHAN)
+        sink = parallelKahanSum(a, 0, n);
+    else
+        streamKernel(k, a, b, c, n);
+}
+
+/* the same kernels as plain loops over floats; the Kahan sum is accumulated in double, as for the other layouts */
+void runKernel(const Kernel& k, float* a, float* b, float* c, const uint_fast64_t& n)
+{
+    double total = 0.0;
+    #pragma omp parallel reduction(+:total)
+    {
+        uint_fast64_t s, len;
+        chunk(n, omp_get_thread_num(), omp_get_num_threads(), s, len);
+        const uint_fast64_t e = s + len;
+        switch(k)
+        {
+            case K_COPY: for(uint_fast64_t i = s; i < e; ++i) c[i] = a[i]; break;
+            case K_SCALE: for(uint_fast64_t i = s; i < e; ++i) b[i] = static_cast<float>(scalar) * c[i]; break;
+            case K_ADD: for(uint_fast64_t i = s; i < e; ++i) c[i] = a[i] + b[i]; break;
+            case K_TRIAD: for(uint_fast64_t i = s; i < e; ++i) a[i] = b[i] + static_cast<float>(scalar) * c[i]; break;
+            case K_KAHAN:
+            {
+                // 8 independent compensated lanes, as reduceSum uses for the other layouts
+                double d[8] = { 0.0 };
+                double err[8] = { 0.0 };
+                uint_fast64_t i = s;
+                for(; i + 8 <= e; i += 8)
+                {
+                    for(int l = 0; l < 8; ++l)
+                    {
+                        double temp = d[l];
+                        double y = a[i + l] + err[l];
+                        d[l] = temp + y;
+                        err[l] = temp - d[l];
+                        err[l] += y;
+                    }
+                }
+                for(; i < e; ++i)
+                    d[0] += a[i];
+                for(int l = 0; l < 8; ++l)
+                    total += d[l];
+                break;
+            }
+            default: break;
+        }
+    }
+    sink = total;
+}
+
+/* best time of each kernel over repeats runs (the first run of each is only a warm up) */
+template<class X>
+Result timeLayout(const char* layout, const char* placement, const int& threads, X& a, X& b, X& c,
+    const uint_fast64_t& n, const int& repeats, const double& bytesPerElement)
+{
+    Result r;
+    r.layout = layout;
+    r.placement = placement;
+    r.threads = threads;
+    for(int k = 0; k < NUM_KERNELS; ++k)
+    {
+        double best = numeric_limits<double>::max();
+        for(int rep = 0; rep <= repeats; ++rep)
+        {
+            const double start = omp_get_wtime();
+            runKernel(Kernel(k), a, b, c, n);
+            const double t = omp_get_wtime() - start;
+            if(rep > 0)
+                best = min(best, t);
+        }
+        r.bandwidth[k] = kernelArrays[k] * bytesPerElement * n / best * 1e-9;
+    }
+    return r;
+}
+
+/*
+    Allocates the arrays with allocator, initialises them (in parallel, or on the master thread
+    when parallelInit is false, which decides where first-touch places the pages) and times every layout.
+*/
+template<class Allocator>
+void runPlacement(const char* placement, const bool& parallelInit, const int& threads, const uint_fast64_t& n,
+    const int& repeats, vector<Result>& results)
+{
+    omp_set_num_threads(threads);
+    Allocator allocator;
+    BasicManSegArray<Allocator> a(n, allocator), b(n, allocator), c(n, allocator);
+    a.allocFull();
+    b.allocFull();
+    c.allocFull();
+    float* fa = allocator.template allocate<float>(n, false);
+    float* fb = allocator.template allocate<float>(n, false);
+    float* fc = allocator.template allocate<float>(n, false);
+
+    #pragma omp parallel if(parallelInit)
+    {
+        uint_fast64_t s, len;
+        chunk(n, omp_get_thread_num(), omp_get_num_threads(), s, len);
+        for(uint_fast64_t i = s; i < s + len; ++i)
+        {
+            a.pairs.set(i, 1.0);
+            b.pairs.set(i, 2.0);
+            c.pairs.set(i, 0.0);
+            a.full[i] = 1.0;
+            b.full[i] = 2.0;
+            c.full[i] = 0.0;
+            fa[i] = 1.0f;
+            fb[i] = 2.0f;
+            fc[i] = 0.0f;
+        }
+    }
+
+    results.push_back(timeLayout("heads", placement, threads, a.heads, b.heads, c.heads, n, repeats, sizeof(float)));
+    results.push_back(timeLayout("pairs", placement, threads, a.pairs, b.pairs, c.pairs, n, repeats, 2 * sizeof(float)));
+    results.push_back(timeLayout("full", placement, threads, a.full, b.full, c.full, n, repeats, sizeof(double)));
+    results.push_back(timeLayout("float", placement, threads, fa, fb, fc, n, repeats, sizeof(float)));
+
+    allocator.deallocate(fa, n);
+    allocator.deallocate(fb, n);
+    allocator.deallocate(fc, n);
+}
+
+int main(int argc, char** argv)
+{
+    // 32M elements is 128-256MB per array, well beyond the last level cache of current nodes
+    const uint_fast64_t n = (argc > 1) ? strtoull(argv[1], nullptr, 10) : (1 << 25);
+    const int repeats = (argc > 2) ? atoi(argv[2]) : 10;
+    double peak = (argc > 3) ? atof(argv[3]) : 0.0;
+
+    vector<int> threadCounts;
+    if(argc > 4)
+    {
+        stringstream list(argv[4]);
+        string item;
+        while(getline(list, item, ','))
+            threadCounts.push_back(atoi(item.c_str()));
+    }
+    else
+    {
+        for(int t = 1; t < omp_get_max_threads(); t *= 2)
+            threadCounts.push_back(t);
+        threadCounts.push_back(omp_get_max_threads());
+    }
+
+    vector<Result> results;
+    for(const int& t : threadCounts)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        // pages are only placed when first written, rather than when new[] clears them
+        runPlacement<LazySegmentAllocator>("first-touch", true, t, n, repeats, results);
+        runPlacement<LazySegmentAllocator>("single", false, t, n, repeats, results);
+#else
+        runPlacement<SegmentAllocator>("first-touch", true, t, n, repeats, results);
+#endif
+#if defined(MANSEG_BENCH_NUMA)
+        if(numa_available() >= 0)
+            runPlacement<InterleavedAllocator>("interleave", true, t, n, repeats, results);
+#endif
+    }
+
+    const char* peakSource = "given";
+    if(peak <= 0.0)
+    {
+        peakSource = "best measured";
+        for(const Result& r : results)
+            peak = max(peak, *max_element(r.bandwidth, r.bandwidth + NUM_KERNELS));
+    }
+
+    cout << fixed << setprecision(2);
+    cout << n << " elements, best of " << repeats << ", peak " << peak << " GB/s (" << peakSource << ")\n";
+    cout << "GB/s (% of peak)\n";
+    cout << setw(8) << "layout" << setw(13) << "placement" << setw(8) << "threads";
+    for(int k = 0; k < NUM_KERNELS; ++k)
+        cout << setw(17) << kernelNames[k];
+    cout << "\n";
+    for(const Result& r : results)
+    {
+        cout << setw(8) << r.layout << setw(13) << r.placement << setw(8) << r.threads;
+        for(int k = 0; k < NUM_KERNELS; ++k)
+        {
+            stringstream cell;
+            cell << fixed << setprecision(2) << r.bandwidth[k] << " (" << setprecision(0) << 100.0 * r.bandwidth[k] / peak << "%)";
+            cout << setw(17) << cell.str();
+        }
+        cout << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#!/bin/bash
+
+## Accuracy against time of the precision switch settings: runs an app once in double precision
+## (MANSEG_SWITCH_POLICY=full, the reference) and then for every setting of sweep_grid.txt, and prints
+## the settings on the Pareto frontier, those no other setting beats in both solve time and final error.
+##   ./sweep.sh [pagerank] [jacobi] [cg]     (default: all three)
+## Build the programs first (make sweep does both). REPEATS (default 1) is the runs per setting (the
+## fastest counts), THREADS the OpenMP/cilk thread count (default: all cores) and GRID the settings file.
+## Every setting is written to $WORK/sweep_<app>.csv with its solve time (the sum of the iteration
+## times), wall clock time, iterations at each precision and final error, pareto = 1 on the frontier.
+## The final error is relative to the reference run for pagerank and jacobi (after the same number of
+## iterations for jacobi) and to the known solution for cg. The reference is saved in binary
+## ($WORK/sweep_<app>.bin, see manseglib_results.hpp).
+
+cd "$(dirname "$0")"
+
+REPEATS=${REPEATS:-1}
+THREADS=${THREADS:-$(nproc)}
+GRID=${GRID:-sweep_grid.txt}
+WORK=regress_work
+
+mkdir -p $WORK
+
+source ./inputs.sh
+
+## binary and arguments of an app
+command_of()
+{
+    case "$1" in
+    pagerank) echo "PageRankManSeg -c 1 -rounds 1 $WORK/rmat.adj" ;;
+    jacobi) echo "jacobi_mod_omp 30" ;;
+    cg) echo "sparsesolve $WORK/poisson.mtx 100 1e-7 2000 1e-7 100" ;;
+    esac
+}
+
+## prints "time iterations heads interim full final_error" of a results CSV
+summarise()
+{
+    awk -F, 'NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        $col["level"] != "round" {
+            t += $col["time"]; its++; n[$col["level"]]++
+            error = $col["final_error"]
+        }
+        END { printf "%.6f %d %d %d %d %s\n", t, its, n["heads"], n["interim"], n["full"], error == "" ? "-" : error }' "$1"
+}
+
+## runs app with policy and param REPEATS times, appending the fastest to the app's CSV
+run_setting()
+{
+    local app=$1 policy=$2 param=$3 out=$4
+    local best="" line
+    for ((r = 0; r < REPEATS; r++))
+    do
+        rm -f $WORK/results.csv
+        start=$(date +%s.%N)
+        if ! OMP_NUM_THREADS=$THREADS CILK_NWORKERS=$THREADS MANSEG_SWITCH_POLICY=$policy MANSEG_SWITCH_PARAM=$param \
+            MANSEG_RESULTS=$WORK/results.csv MANSEG_REFERENCE=$REFERENCE MANSEG_VALUES=$VALUES \
+            ./$WORK/$COMMAND < /dev/null > $WORK/sweep_$app.log 2>&1 || [ ! -f $WORK/results.csv ]
+        then
+            echo "FAIL    $app $policy $param (see $WORK/sweep_$app.log)"
+            return
+        fi
+        end=$(date +%s.%N)
+        read -r t its heads interim full error <<< "$(summarise $WORK/results.csv)"
+        # the reference run has nothing to compare with but is exact by definition
+        [ $policy = full ] && [ "$error" = "-" ] && [ -n "$VALUES" ] && error=0
+        wall=$(awk -v s=$start -v e=$end 'BEGIN { printf "%.6f", e - s }')
+        if [ -z "$best" ] || awk -v a=$t -v b=$best 'BEGIN { exit !(a < b) }'
+        then
+            best=$t
+            line="$app,$policy,$param,$t,$wall,$its,$heads,$interim,$full,$error"
+        fi
+    done
+    echo "$line" >> $out
+    printf "%-8s %-10s %-8s %ss, %s iterations (%s heads, %s interim, %s full), error %s\n" \
+        $app $policy "$param" $best $its $heads $interim $full $error
+}
+
+## marks the rows of a sweep CSV that no other row beats in both time and error
+pareto()
+{
+    {
+        echo "$(head -1 "$1"),pareto"
+        tail -n +2 "$1" | sort -t, -k4,4g | awk -F, -v OFS=, '
+            BEGIN { best = "" }
+            {
+                front = ($10 != "-" && (best == "" || $10 + 0 < best + 0))
+                if (front) best = $10
+                print $0, front
+            }'
+    } > "$1.tmp"
+    mv "$1.tmp" "$1"
+}
+
+apps="$*"
+[ -z "$apps" ] && apps="pagerank jacobi cg"
+for app in $apps
+do
+    COMMAND=$(command_of $app)
+    if [ -z "$COMMAND" ]
+    then
+        echo "unknown app $app (pagerank, jacobi or cg)"
+        exit 1
+    fi
+    if [ ! -x $WORK/${COMMAND%% *} ]
+    then
+        echo "SKIP    $app (${COMMAND%% *} was not built)"
+        continue
+    fi
+
+    out=$WORK/sweep_$app.csv
+    echo "app,policy,param,time,wall,iterations,heads,interim,full,final_error" > $out
+
+    # the double precision run writes the reference of the others
+    REFERENCE=""
+    VALUES=$WORK/sweep_$app.bin
+    run_setting $app full - $out
+    REFERENCE=$VALUES
+    VALUES=""
+
+    while read -r gridapp policy params
+    do
+        [ "$gridapp" = "$app" ] || continue
+        for param in $params
+        do
+            run_setting $app $policy $param $out
+        done
+    done < $GRID
+
+    pareto $out
+    echo "Pareto frontier of $app (fastest first):"
+    awk -F, 'NR > 1 && $11 == 1 { printf "    %-10s %-8s %ss, error %s, %s heads of %s iterations\n", $2, $3, $4, $10, $7, $6 }' $out
+    echo "(all settings in $out)"
+done
@@ -0,0 +1,95 @@
+/*
+    Reads the telemetry a running driver publishes to the shared memory segment named by its
+    $MANSEG_TELEMETRY (see manseglib_telemetry.hpp), without touching the run: the segment is
+    mapped read only.
+        ./telemetry_export /pagerank_42                        # prints the block once
+        ./telemetry_export /pagerank_42 --interval 1           # prints it every second until the run finishes
+        ./telemetry_export /pagerank_42 --prom /var/lib/node_exporter/pagerank.prom --interval 5
+    --prom writes the block in the Prometheus text format, to a temporary file renamed over FILE so
+    that the node exporter's textfile collector never reads half of it. Exits with 2 if the segment
+    does not exist or has not been set up, and with 1 if it could not be read consistently.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "../manseglib_telemetry.hpp"
+
+void print(const ManSeg::TelemetrySnapshot& s)
+{
+    printf("%s pid %llu round %lld iter %lld delta %.6e level %s %.3f ms %.2f GB/s elapsed %.3f s%s\n",
+           s.app, (unsigned long long)s.pid, (long long)s.round, (long long)s.iteration, s.delta, s.level,
+           s.seconds * 1e3, s.bytesPerSecond * 1e-9, s.elapsed, s.finished ? " finished" : "");
+    fflush(stdout);
+}
+
+bool writeProm(const ManSeg::TelemetrySnapshot& s, const std::string& path)
+{
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if(f == nullptr)
+    {
+        fprintf(stderr, "cannot open %s\n", tmp.c_str());
+        return false;
+    }
+    char labels[128];
+    snprintf(labels, sizeof(labels), "{app=\"%s\",pid=\"%llu\"}", s.app, (unsigned long long)s.pid);
+    fprintf(f, "# HELP manseg_round Round of the run.\n# TYPE manseg_round gauge\nmanseg_round%s %lld\n", labels, (long long)s.round);
+    fprintf(f, "# HELP manseg_iteration Last iteration done.\n# TYPE manseg_iteration gauge\nmanseg_iteration%s %lld\n", labels, (long long)s.iteration);
+    fprintf(f, "# HELP manseg_delta Delta of the last iteration.\n# TYPE manseg_delta gauge\nmanseg_delta%s %.17g\n", labels, s.delta);
+    fprintf(f, "# HELP manseg_iteration_seconds Time of the last iteration.\n# TYPE manseg_iteration_seconds gauge\nmanseg_iteration_seconds%s %.9g\n", labels, s.seconds);
+    fprintf(f, "# HELP manseg_elapsed_seconds Time of all the iterations so far.\n# TYPE manseg_elapsed_seconds counter\nmanseg_elapsed_seconds%s %.9g\n", labels, s.elapsed);
+    fprintf(f, "# HELP manseg_bytes_per_second Modelled memory traffic of the last iteration per second.\n# TYPE manseg_bytes_per_second gauge\nmanseg_bytes_per_second%s %.9g\n", labels, s.bytesPerSecond);
+    fprintf(f, "# HELP manseg_level Precision level of the last iteration.\n# TYPE manseg_level gauge\nmanseg_level{app=\"%s\",pid=\"%llu\",level=\"%s\"} 1\n", s.app, (unsigned long long)s.pid, s.level);
+    fprintf(f, "# HELP manseg_updates_total Iterations published.\n# TYPE manseg_updates_total counter\nmanseg_updates_total%s %llu\n", labels, (unsigned long long)s.updates);
+    fprintf(f, "# HELP manseg_finished Whether the run has ended.\n# TYPE manseg_finished gauge\nmanseg_finished%s %d\n", labels, s.finished ? 1 : 0);
+    const bool ok = fclose(f) == 0 && rename(tmp.c_str(), path.c_str()) == 0;
+    if(!ok)
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s NAME [--prom FILE] [--interval SECONDS]\n", argv[0]);
+        return 2;
+    }
+    std::string prom;
+    double interval = 0.0;
+    for(int i = 2; i + 1 < argc; i += 2)
+    {
+        if(strcmp(argv[i], "--prom") == 0)
+            prom = argv[i + 1];
+        else if(strcmp(argv[i], "--interval") == 0)
+            interval = atof(argv[i + 1]);
+    }
+
+    ManSeg::TelemetryReader reader(argv[1]);
+    if(!reader.isOpen())
+    {
+        fprintf(stderr, "no telemetry at %s\n", argv[1]);
+        return 2;
+    }
+    ManSeg::TelemetrySnapshot s;
+    for(;;)
+    {
+        if(!reader.read(s))
+        {
+            fprintf(stderr, "cannot read a consistent block from %s\n", argv[1]);
+            return 1;
+        }
+        if(prom.empty())
+            print(s);
+        else if(!writeProm(s, prom))
+            return 1;
+        if(interval <= 0.0 || s.finished)
+            return 0;
+        usleep((useconds_t)(interval * 1e6));
+    }
+}
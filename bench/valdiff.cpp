@@ -0,0 +1,62 @@
+/*
+    Compares two saved solutions ($MANSEG_VALUES files, binary .bin or text) in place of diffing the
+    text dumps: reports the largest absolute difference and where it is, the L2 norm of the difference,
+    and the L1 and L2 errors of the first file relative to the second.
+        ./valdiff values.bin reference.bin [tolerance]
+    Exits with 1 if the files differ in length or any value differs by more than tolerance (default 0,
+    bit for bit up to the sign of zero), and with 2 if a file cannot be read.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "../manseglib_results.hpp"
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s values reference [tolerance]\n", argv[0]);
+        return 2;
+    }
+    const double tolerance = (argc > 3) ? atof(argv[3]) : 0.0;
+
+    std::vector<double> x, ref;
+    if(!ManSeg::loadReference(argv[1], x) || !ManSeg::loadReference(argv[2], ref))
+    {
+        fprintf(stderr, "cannot read %s\n", x.empty() ? argv[1] : argv[2]);
+        return 2;
+    }
+    if(x.size() != ref.size())
+    {
+        printf("lengths differ: %zu and %zu values\n", x.size(), ref.size());
+        return 1;
+    }
+
+    double maxDiff = 0.0, l1 = 0.0, l2 = 0.0, refL1 = 0.0, refL2 = 0.0;
+    size_t at = 0, differing = 0;
+    for(size_t i = 0; i < x.size(); ++i)
+    {
+        const double d = fabs(x[i] - ref[i]);
+        // a NaN on either side counts as the largest difference
+        if(d > maxDiff || (d != d && maxDiff == maxDiff))
+        {
+            maxDiff = d;
+            at = i;
+        }
+        if(!(d <= tolerance)) ++differing;
+        l1 += d;
+        l2 += d * d;
+        refL1 += fabs(ref[i]);
+        refL2 += ref[i] * ref[i];
+    }
+
+    printf("%zu values, %zu differ by more than %g\n", x.size(), differing, tolerance);
+    printf("max |x - ref| = %.17g at %zu (%.17g, %.17g)\n", maxDiff, at, x.empty() ? 0.0 : x[at], ref.empty() ? 0.0 : ref[at]);
+    printf("||x - ref||_2 = %.17g\n", sqrt(l2));
+    printf("relative L1 = %.17g, relative L2 = %.17g\n", refL1 > 0.0 ? l1 / refL1 : l1, refL2 > 0.0 ? sqrt(l2 / refL2) : sqrt(l2));
+    return differing == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#!/bin/bash
+
+## mpir_class (all double) against mpir_class_manseg on one matrix: outer and inner iterations,
+## final residual and time of each, and the outer iterations the ManSeg solve saved
+## ./compare_ir.sh matrix.mtx [out_its] [out_tol] [in_its] [in_tol] [step_chk]
+
+MTX=${1:-./data/bcsstk01.mtx}
+ARGS="${2:-100} ${3:-1e-7} ${4:-2000} ${5:-1e-7} ${6:-100}"
+
+make -s -C mpir_class && make -s -C mpir_class_manseg || exit 1
+
+field() { grep "# $1" | sed 's/.*: *//' | sed 's/ s$//'; }
+
+./mpir_class/sparsesolve $MTX $ARGS > ./compare_ref.out
+./mpir_class_manseg/sparsesolve $MTX $ARGS > ./compare_manseg.out
+
+printf "%-18s %10s %10s %14s %12s\n" solver outer inner residual time
+for s in ref manseg; do
+    f=./compare_$s.out
+    printf "%-18s %10s %10s %14s %12s\n" $s "$(field 'outer_iterations' < $f)" "$(field 'inner_iterations' < $f)" \
+        "$(field 'residual (ir)' < $f)" "$(field 'Time taken' < $f)"
+done
+grep "switching precision" ./compare_manseg.out | tail -1
+echo "outer iterations saved: $(( $(field 'outer_iterations' < ./compare_ref.out) - $(field 'outer_iterations' < ./compare_manseg.out) ))"
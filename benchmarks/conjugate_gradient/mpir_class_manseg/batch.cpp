@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <tgmath.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "batch.h"
+
+void conjugate_gradient(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control);
+bool gmres(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter);
+
+/*
+    The refinement of iterative_refinement for one system of a batch, with the same switches of
+    precision, but without its checkpoints, energy phases, results or progress lines, which are of a
+    run solving one system.
+*/
+static void batch_refine(batch_system *s, int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol, int step_check)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const int n = s->n;
+    matrix_format *A = s->A;
+    DOUBLE *x = s->x;
+
+    SolverArray e(n);
+    SolverArray d(n);
+    seg_copy(n, FullView(x, n), d.heads); // d = heads(x)
+    vector_set(n, 0.0, x);
+    seg_copy(n, FullView(s->b_dash, n), e.pairs); // e = b_dash
+
+    AbsoluteBoundPolicy maxDiffBound(5e-3);
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(maxDiffBound), false);
+    PrecisionController<StagnationPolicy> outer(StagnationPolicy(0.5), false, seg_norm2(n, e.pairs));
+    s->out_iter = s->in_iter = 0;
+    DOUBLE residual;
+    do
+    {
+        bool stalled = false;   // CG promotes A itself
+#ifdef USE_GMRES
+        stalled = gmres(n, A, s->anorm, s->M, &e, &d, in_maxiter, in_tol, &s->in_iter);
+        if (A->useTail)
+            seg_axpy(n, 1.0, d.pairs, FullView(x, n)); // x = x + d
+        else
+            seg_axpy(n, 1.0, d.heads, FullView(x, n));
+#else
+        conjugate_gradient(n, A, s->anorm, s->M, &e, &d, in_maxiter, in_tol, step_check, &s->in_iter, &control);
+        seg_axpy(n, 1.0, d.heads, FullView(x, n)); // x = x + d
+#endif
+        matrix_mult(A, FullView(x, n), e.pairs);
+        residual = seg_xpby_norm2(n, FullView(A->useTail ? s->b : s->b_dash, n), -1.0, e.pairs); // r = b - Ax
+#ifdef USE_GMRES
+        seg_set(n, 0.0, d.pairs);
+#else
+        seg_set(n, 0.0, d.heads);
+#endif
+
+        if (!A->useTail && (stalled || outer.update(residual) != PRECISION_HEADS))
+        {
+            mat_increase_precision(A);
+            matrix_mult(A, FullView(x, n), e.pairs);
+            residual = seg_xpby_norm2(n, FullView(s->b, n), -1.0, e.pairs);
+        }
+        s->out_iter++;
+    } while ((residual > out_tol) && (s->out_iter < out_maxiter));
+
+    s->residual = residual;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    s->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/*
+    Solves count independent systems, each by one thread at a time, for batches of small systems whose
+    own products and vector operations are too short to share between the threads: a thread takes the
+    next system as it finishes one, the largest systems (by nonzeros, then unknowns) first, so that the
+    ones left for the end are the quickest. Inside the batch the vector operations and products run on
+    the one thread (nested parallel regions get a single thread), the solvers print nothing, and the
+    vectors of a solve come from the thread's own pool (SegmentPool::local()), which the thread's next
+    solves, in this batch or a later one, reuse without taking the global pool's lock.
+*/
+void solve_batch(batch_system *systems, int count, int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol,
+    int step_check)
+{
+    std::vector<int> order(count);
+    for (int i = 0; i < count; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [systems](int p, int q) {
+        return systems[p].nz != systems[q].nz ? systems[p].nz > systems[q].nz : systems[p].n > systems[q].n;
+    });
+
+    #pragma omp parallel
+    {
+        const bool logging = solver_log;
+        solver_log = false;
+        {
+            SegmentPool::Scope scope(SegmentPool::local());
+            #pragma omp for schedule(dynamic, 1)
+            for (int i = 0; i < count; i++)
+                batch_refine(&systems[order[i]], out_maxiter, out_tol, in_maxiter, in_tol, step_check);
+        }
+        solver_log = logging;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef __cg_BATCH_H__
+#define __cg_BATCH_H__
+
+#include "cg.h"
+#include "vector.h"
+#include "matrix.h"
+
+/*
+    One of the independent systems of a batch, A x = b, solved by iterative refinement as in ir.cpp:
+    b_dash is b made with the matrix at its heads, and x holds the starting guess and gets the
+    solution. A and M are the system's own, as the refinement promotes A and a preconditioner may keep
+    the intermediate vector of its solve. The rest is set by solve_batch.
+*/
+struct batch_system
+{
+    int n, nz;
+    matrix_format *A;
+    precond_format *M;
+    DOUBLE anorm;
+    DOUBLE *b, *b_dash, *x;
+
+    int out_iter, in_iter;
+    DOUBLE residual;        // of the last outer iteration
+    double seconds;
+};
+
+void solve_batch(batch_system *systems, int count, int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol,
+    int step_check);
+
+#endif
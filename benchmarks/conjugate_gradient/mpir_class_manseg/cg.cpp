@@ -9,168 +9,567 @@
 #include "vector.h"
 #include "matrix.h"
 
-void conjugate_gradient(int n, matrix *A, matrix *M, FLOAT *b, FLOAT *x, int maxiter, FLOAT umbral, int step_check, int *in_iter, bool *precision_increase)
+thread_local bool solver_log = true;
+
+/*
+    Define (e.g. make CCXFLAGS+=-DCG_PIPELINED) to use a CG with a single reduction per iteration in
+    place of the standard one, which has two dependent reductions (p^Tw for alpha, then r^Tz and ||r||
+    after the update):
+        CG_SINGLE_REDUCTION: Chronopoulos and Gear's CG, which gets p^Tw from a recurrence, so the
+            dot products of an iteration are made together after its product
+        CG_PIPELINED: Ghysels and Vanroose's pipelined CG, which also takes the product out of the
+            path of the reduction: the dot products are made in the pass of the vector updates, and
+            the product after it only needs the vectors
+    Both keep more vectors (two and six more), which are ManSegArrays used at head precision like the
+    rest, so they cost 4 bytes per value rather than 8. Their recurrences lose more accuracy than
+    standard CG's, pipelined CG's by far the most at head precision: it replaces its residual every
+    CG_REPLACE iterations, and leaves the rest to the refinement. On one node the reductions are
+    OpenMP barriers rather than messages, so what either variant saves is a pass or two over the
+    vectors, not network latency.
+*/
+// #define CG_SINGLE_REDUCTION
+// #define CG_PIPELINED
+
+// iterations between the residual replacements of pipelined CG
+#define CG_REPLACE 16
+
+/*
+    The heads phase of a solve ends early, with the matrix promoted and the correction handed back to
+    the refinement, once its residual can no longer improve at the heads: when the (recurrence)
+    residual is still above CG_STAGNATION_RATIO times what it was CG_STAGNATION_WINDOW iterations
+    earlier, or is below the accuracy the heads can attain,
+        u (||A|| ||x|| + ||b||),    u = MaxSingleSegmentPrecision
+    past which the true residual stops following the recurrence. ||x|| is measured at the start and
+    at each explicit check. A window of 0 leaves the heads phase to the residual check alone.
+*/
+#define CG_STAGNATION_WINDOW 32
+#define CG_STAGNATION_RATIO 0.9
+
+// the state of a solve, carried from its heads phase into its full precision phase
+struct cg_state
 {
-    int iter = 0;
-    FLOAT2 alpha, beta;
+    int n, iter, step;
 	FLOAT2 rho; // rho = r(k-1)^Tz(k-1)
-	FLOAT2 tau; // tau = r(k)^Tz(k)
 	FLOAT2 tol; // tol = ||r(k)||v2
+    DOUBLE anorm, bnorm, xnorm;   // of the attainable residual, ||A|| from the caller
+    PrecisionController<ResidualHistoryPolicy> monitor;
+    SolverArray r;
+    SolverArray p; // this may be the actual "conjugate gradient" (conjugate vectors)
+    SolverArray z;
+    SolverArray tr;
+    SolverArray x_prev;
+#if defined(CG_SINGLE_REDUCTION) || defined(CG_PIPELINED)
+    // z holds u = M^-1 r; the names of the rest are in vector.h
+    FLOAT2 alpha;   // alpha of the previous iteration
+    FLOAT2 gamma;   // gamma = r(k)^Tu(k), the next rho
+    FLOAT2 delta;   // delta = w(k)^Tu(k)
+    SolverArray w, ap;
+#endif
+#ifdef CG_PIPELINED
+    SolverArray m, am, map, amap;
+#endif
 
-	// x(0) = [0, 0, .., 0]
+    cg_state(int n, DOUBLE anorm) :n(n), iter(0), step(0), anorm(anorm), bnorm(0.0), xnorm(0.0),
+        monitor(ResidualHistoryPolicy(CG_STAGNATION_WINDOW, CG_STAGNATION_RATIO), false),
+        r(n), p(n), z(n), tr(n), x_prev(n) {
+#if defined(CG_SINGLE_REDUCTION) || defined(CG_PIPELINED)
+        w.alloc(n);
+        ap.alloc(n);
+#endif
+#ifdef CG_PIPELINED
+        am.alloc(n);
+        amap.alloc(n);
+        // m and map are only made with a preconditioner (by cg_start)
+#endif
+    }
+};
+
+/*
+    The explicit residual check, made every step_check iterations: compares ||b - Ax|| with the
+    recurrence residual, and in the heads phase gives the controller the largest change of x since the
+    last check. Returns false if the solve has to break out, and sets *switched if the controller
+    switched precision.
+    Before that, every iteration of the heads phase gives the monitor the recurrence residual; if it
+    has stagnated or reached the attainable accuracy, the matrix is promoted and the solve stops.
+*/
+template<AccessLevel precision>
+static bool cg_check(Matrix<matrix_format, precision> A, cg_state &s, SolverArray *b, SolverArray *x,
+    int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control, bool *switched)
+{
+    int n = s.n;
+    FLOAT2 residual;
+
+	if (precision == ACCESS_HEADS && CG_STAGNATION_WINDOW > 0) {
+		s.monitor.policy().floor = MaxSingleSegmentPrecision * (s.anorm * s.xnorm + s.bnorm);
+		if (s.monitor.update(s.tol) != PRECISION_HEADS) {
+			SOLVER_LOG("stopping at iteration %d (%s), switching precision\n", *in_iter, s.monitor.reasonName());
+			mat_increase_precision(A.f);
+			return false;
+		}
+	}
 
-    FLOAT *r = ALLOC(FLOAT, n);
-    FLOAT *p = ALLOC(FLOAT, n); // this may be the actual "conjugate gradient" (conjugate vectors)
-    FLOAT *z = ALLOC(FLOAT, n);
+	// residual = true residual
+	// 10 = deviation (over 10x away) from the true residual
+	if (s.step < step_check) {
+		s.step++;
+	}
+	else {
+		A.mult(x->heads, s.tr.heads);		 // tr = Ax
+		residual = seg_xpby_norm2(n, b->heads, -1.0, s.tr.heads); // tr = b - Ax
+		SOLVER_LOG("# rescheck: total_cg_iter=%d current_iter=%d tol=%e resid=%e\n", *in_iter, s.iter, (double)s.tol, (double)residual);
+
+		double explicit_residual_deviation = residual/s.tol;
+
+		// not great performance, but better than most things
+		// it's not better at all, it's just bad in roughly the same amount of
+		// situations
+		if(precision == ACCESS_HEADS) {
+			/* double vv = fabs(x_norm_prev-x_norm)/x_norm_prev; // percentage change
+			printf("abs(x_diff/x_norm_prev) = %e\n", vv);
+			if(vv < 1e-5)
+			{
+				*precision_increase = true;
+				mat_increase_precision(A);
+				printf("increased precision at %d\n", *in_iter);
+				// break;
+			}
+			else
+			{
+				x_norm_prev = x_norm;
+			} */
+
+			double max_diff = seg_max_diff_and_copy(n, x->heads, s.x_prev.heads);
+			SOLVER_LOG("max diff = %e\n", max_diff);
+			s.xnorm = seg_norm2(n, x->heads);
+			if(control->update(max_diff) != PRECISION_HEADS) {
+				SOLVER_LOG("switching precision at iteration %d (%s)\n", *in_iter, control->reasonName());
+				// switching = true;
+				mat_increase_precision(A.f);
+				*switched = true;
+			}
+			// else {
+			// 	floatm_copy(n, x, x_prev);
+			// }
+			/* float min_diff = floatm_min_diff(n, x, x_prev);
+			printf("min diff = %e\n", min_diff);
+			if(min_diff <= 5e-5) {
+				printf("switching precision at iteration %d\n", *in_iter);
+				*precision_increase = true;
+				// switching = true;
+				mat_increase_precision(A);
+			}
+			else {
+				floatm_copy(n, x, x_prev);
+			} */
+		}
+		
+		if (explicit_residual_deviation > 10) {
+			SOLVER_LOG("broke out : iter = %d\n", *in_iter);
+			return false;
+		}
+		s.step = 1;
+	}
+	return true;
+}
 
-    FLOAT *tr = ALLOC(FLOAT, n);
+#if !defined(CG_SINGLE_REDUCTION) && !defined(CG_PIPELINED)
+
+template<class Mat>
+static void cg_start(Mat A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x)
+{
+    int n = s.n;
 
 	// r(0) = b - Ax(0)
-    floatm_mult(A, x, r);
-    floatm_xpby(n, b, -1.0, r);
+    A.mult(x->heads, s.r.heads);
+    // tol = ||r(0)||, in the same pass
+    s.tol = seg_xpby_norm2(n, b->heads, -1.0, s.r.heads);
 
     if (M) {
 		// Mz(0) = r(0)
-        floatm_mult(M, r, z);
+        M->mult(s.r.heads, s.z.heads);
 		// calculate rho
-        rho = floatm_dot(n, r, z);
-		// calculate tol
-		tol = floatm_norm2(n, r);
+        s.rho = seg_dot(n, s.r.heads, s.z.heads);
     } else { // small optimization
 		// z(0) = r(0)
-        floatm_copy(n, r, z);
+        seg_copy(n, s.r.heads, s.z.heads);
 		// rho = r(0)^Tr(0)
-        rho = floatm_dot(n, r, r);
-        // tol = sqrt(rho)
-		tol = sqrt(rho);
+        s.rho = s.tol * s.tol;
     }
 	// p(1) = z(0)
-	floatm_copy(n, z, p);
+	seg_copy(n, s.z.heads, s.p.heads);
 
-    int step = 0;
-    FLOAT2 residual = tol;
+	seg_set(n, 0.0, s.x_prev.heads);
+}
 
-	FLOAT *x_prev = CALLOC(FLOAT, n);
-	bool switching = false;
+/*
+    CG iterations with the values of A read at precision, until the solve converges, reaches maxiter
+    or breaks out. Returns true if the controller switched precision in the heads phase; the iteration
+    is completed, and the solve continues in the full precision phase.
+*/
+template<AccessLevel precision>
+static bool cg_iterate(Matrix<matrix_format, precision> A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x,
+    int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control)
+{
+    int n = s.n;
+    FLOAT2 alpha, beta;
+	FLOAT2 tau; // tau = r(k)^Tz(k)
 
 	// tol = recurrence residual
-	// residual = true residual
-	// 10 = deviation (over 10x away) from the true residual
-    while ((iter < maxiter) && (tol > umbral)) {
+    while ((s.iter < maxiter) && (s.tol > umbral)) {
+        bool switched = false;
+
 		// w = Ap(k+1)
-		floatm_mult(A, p, z);
+		A.mult(s.p.heads, s.z.heads);
 
 		// if(switching) break;
 
-		if (step < step_check) {
-			step++;
-		}
-		else {
-			floatm_mult(A, x, tr);		 // tr = Ax
-			floatm_xpby(n, b, -1.0, tr); // tr = b - Ax
-			residual = floatm_norm2(n, tr);
-			printf("# rescheck: total_cg_iter=%d current_iter=%d tol=%e resid=%e\n", *in_iter, iter, (double)tol, (double)residual);
-
-			double explicit_residual_deviation = residual/tol;
-
-			// not great performance, but better than most things
-			// it's not better at all, it's just bad in roughly the same amount of
-			// situations
-			if(!A->useTail) {
-				/* double vv = fabs(x_norm_prev-x_norm)/x_norm_prev; // percentage change
-				printf("abs(x_diff/x_norm_prev) = %e\n", vv);
-				if(vv < 1e-5)
-				{
-					*precision_increase = true;
-					mat_increase_precision(A);
-					printf("increased precision at %d\n", *in_iter);
-					// break;
-				}
-				else
-				{
-					x_norm_prev = x_norm;
-				} */
-
-				float max_diff = floatm_max_diff_and_copy(n, x, x_prev);
-				printf("max diff = %e\n", max_diff);
-				if(max_diff <= 5e-3) {
-					printf("switching precision at iteration %d\n", *in_iter);
-					*precision_increase = true;
-					// switching = true;
-					mat_increase_precision(A);
-				}
-				// else {
-				// 	floatm_copy(n, x, x_prev);
-				// }
-				/* float min_diff = floatm_min_diff(n, x, x_prev);
-				printf("min diff = %e\n", min_diff);
-				if(min_diff <= 5e-5) {
-					printf("switching precision at iteration %d\n", *in_iter);
-					*precision_increase = true;
-					// switching = true;
-					mat_increase_precision(A);
-				}
-				else {
-					floatm_copy(n, x, x_prev);
-				} */
-			}
-			
-			if (explicit_residual_deviation > 10) {
-				printf("broke out : iter = %d\n", *in_iter);
-				break;
-			}
-			step = 1;
-		}
+		if (!cg_check(A, s, b, x, step_check, in_iter, control, &switched))
+			return false;
 
 		// alpha(k+1) = rho / p(k+1)w
-		alpha = rho / floatm_dot(n, z, p);
+		alpha = s.rho / seg_dot(n, s.z.heads, s.p.heads);
 
+		// in one pass:
 		// x(k+1) = x + alpha(k+1)p(k+1)
-		floatm_axpy(n, alpha, p, x);
-
 		// r(k+1) = r(k) - alpha(k+1)(w)
-		floatm_axpy(n, -alpha, z, r);
-
-		// apply preconditioner
-		if (M) {
-			// Solve Mz(k) = r(k)
-		    floatm_mult(M, r, z);
-			// calculate tau
-		    tau = floatm_dot(n, r, z);
-			// calculate tol
-		    tol = floatm_norm2(n, r);
-		} else {
-			// tau = inner product(r)
-		    tau = floatm_dot(n, r, r);
-			// tol = sqrt(tau)
-		    tol = sqrt(tau);
+		// solve Mz(k) = r(k) (z is w until then), if M is a diagonal
+		// tau = r^Tz (r^Tr without M), tol = sqrt(r^Tr)
+		DOUBLE rr;
+		seg_cg_update(n, alpha, s.p.heads, x->heads, s.r.heads, s.z.heads, M ? M->diagonal() : NULL, &tau, &rr);
+		s.tol = sqrt(rr);
+		if (M && !M->diagonal()) {
+			// solve Mz(k) = r(k), and tau = r^Tz
+			M->mult(s.r.heads, s.z.heads);
+			tau = seg_dot(n, s.r.heads, s.z.heads);
 		}
 		
 		// beta = tau / rho
-		beta =  tau / rho;
+		beta =  tau / s.rho;
 		// update r(k-1)^Tz(k-1) to r(k)^Tz(k)
-		rho = tau;
+		s.rho = tau;
 		
 		// p(k+1) = z(k) + beta(k) + p(k)
 		if (M) {
-			floatm_xpby(n, z, beta, p);
+			seg_xpby(n, s.z.heads, beta, s.p.heads);
+		}
+		else {
+			seg_xpby(n, s.r.heads, beta, s.p.heads);
+		}
+
+		s.iter++;
+		(*in_iter)++;
+
+		if (switched)
+			return true;
+	}
+	return false;
+}
+
+#elif defined(CG_SINGLE_REDUCTION)
+
+template<class Mat>
+static void cg_start(Mat A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x)
+{
+    int n = s.n;
+    FLOAT2 rr;
+    SolverArray &u = M ? s.z : s.r;
+
+	// r(0) = b - Ax(0)
+    A.mult(x->heads, s.r.heads);
+    seg_xpby(n, b->heads, -1.0, s.r.heads);
+	// u(0) = M^-1r(0), w(0) = Au(0)
+    if (M)
+        M->mult(s.r.heads, s.z.heads);
+    A.mult(u.heads, s.w.heads);
+    seg_cg_dots(n, s.r.heads, u.heads, s.w.heads, &s.gamma, &s.delta, &rr);
+    s.tol = sqrt(rr);
+
+	// p and ap start at zero, so the first iteration takes beta = 0
+	seg_set(n, 0.0, s.p.heads);
+	seg_set(n, 0.0, s.ap.heads);
+	seg_set(n, 0.0, s.x_prev.heads);
+}
+
+/*
+    Chronopoulos-Gear CG iterations: as cg_iterate of standard CG, but p^Tw comes from the recurrence
+        alpha(k) = gamma(k) / (delta(k) - beta(k) gamma(k) / alpha(k-1))
+    with ap = Ap updated alongside p, so the only reduction is the one after the product.
+*/
+template<AccessLevel precision>
+static bool cg_iterate(Matrix<matrix_format, precision> A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x,
+    int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control)
+{
+    int n = s.n;
+    FLOAT2 alpha, beta, rr;
+    SolverArray &u = M ? s.z : s.r;
+
+    while ((s.iter < maxiter) && (s.tol > umbral)) {
+        bool switched = false;
+
+		if (!cg_check(A, s, b, x, step_check, in_iter, control, &switched))
+			return false;
+
+		// beta = gamma(k) / gamma(k-1), alpha from the recurrence
+		if (s.iter == 0) {
+			beta = 0.0;
+			alpha = s.gamma / s.delta;
 		}
 		else {
-			floatm_xpby(n, r, beta, p);
+			beta = s.gamma / s.rho;
+			alpha = s.gamma / (s.delta - beta * s.gamma / s.alpha);
 		}
+		s.rho = s.gamma;
+		s.alpha = alpha;
+
+		// p = u + beta p, ap = w + beta ap, x = x + alpha p, r = r - alpha ap, u = M^-1r
+		seg_cgcg_update(n, alpha, beta, u.heads, s.w.heads, s.p.heads, s.ap.heads, x->heads, s.r.heads, M ? M->diagonal() : NULL);
+		if (M && !M->diagonal())
+			M->mult(s.r.heads, s.z.heads);
 
-		iter++;
+		// w = Au, and gamma = r^Tu, delta = w^Tu and tol = ||r|| in one reduction
+		A.mult(u.heads, s.w.heads);
+		seg_cg_dots(n, s.r.heads, u.heads, s.w.heads, &s.gamma, &s.delta, &rr);
+		s.tol = sqrt(rr);
+
+		s.iter++;
 		(*in_iter)++;
+
+		if (switched)
+			return true;
 	}
+	return false;
+}
+
+#else // CG_PIPELINED
+
+template<class Mat>
+static void cg_start(Mat A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x)
+{
+    int n = s.n;
+    FLOAT2 rr;
+    SolverArray &u = M ? s.z : s.r;
+
+	// r(0) = b - Ax(0)
+    A.mult(x->heads, s.r.heads);
+    seg_xpby(n, b->heads, -1.0, s.r.heads);
+	// u(0) = M^-1r(0), w(0) = Au(0), m(0) = M^-1w(0)
+    if (M) {
+        s.m.alloc(n);
+        s.map.alloc(n);
+        M->mult(s.r.heads, s.z.heads);
+    }
+    A.mult(u.heads, s.w.heads);
+    if (M)
+        M->mult(s.w.heads, s.m.heads);
+    seg_cg_dots(n, s.r.heads, u.heads, s.w.heads, &s.gamma, &s.delta, &rr);
+    s.tol = sqrt(rr);
+
+	// the recurrence vectors start at zero, so the first iteration takes beta = 0
+	seg_set(n, 0.0, s.p.heads);
+	seg_set(n, 0.0, s.ap.heads);
+	seg_set(n, 0.0, s.amap.heads);
+	if (M)
+		seg_set(n, 0.0, s.map.heads);
+	seg_set(n, 0.0, s.x_prev.heads);
+}
+
+/*
+    Ghysels-Vanroose pipelined CG iterations: alpha and beta as in Chronopoulos-Gear, with Ap, M^-1Ap
+    and AM^-1Ap also kept by recurrences, so an iteration is the product am = Am followed by one pass
+    that updates the vectors and makes the dot products of the next iteration.
+*/
+template<AccessLevel precision>
+static bool cg_iterate(Matrix<matrix_format, precision> A, precond_format *M, cg_state &s, SolverArray *b, SolverArray *x,
+    int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control)
+{
+    int n = s.n;
+    FLOAT2 alpha, beta, rr;
+    SolverArray &u = M ? s.z : s.r;
+    SolverArray &m = M ? s.m : s.w;
+    SolverArray &map = M ? s.map : s.ap;
+    FLOAT2 replaced_residual = INFINITY;
+
+    while ((s.iter < maxiter) && (s.tol > umbral)) {
+        bool switched = false;
+
+		if (!cg_check(A, s, b, x, step_check, in_iter, control, &switched))
+			return false;
+
+		// the recurrences of head precision vectors drift from the products within a few tens of
+		// iterations: every CG_REPLACE iterations r is replaced by b - Ax, and the vectors derived from
+		// r and p are made again from them. The rounding of the heads can still leave the solve to
+		// stagnate above the tolerance, so it breaks out (to the refinement) once the residual of a
+		// replacement is no lower than the last one's
+		if (s.iter > 0 && s.iter % CG_REPLACE == 0) {
+			A.mult(x->heads, s.r.heads);
+			seg_xpby(n, b->heads, -1.0, s.r.heads);
+			if (M)
+				M->mult(s.r.heads, s.z.heads);
+			A.mult(u.heads, s.w.heads);
+			if (M)
+				M->mult(s.w.heads, s.m.heads);
+			A.mult(s.p.heads, s.ap.heads);
+			if (M)
+				M->mult(s.ap.heads, s.map.heads);
+			A.mult(map.heads, s.amap.heads);
+			seg_cg_dots(n, s.r.heads, u.heads, s.w.heads, &s.gamma, &s.delta, &rr);
+			s.tol = sqrt(rr);
+			if (s.tol >= replaced_residual) {
+				SOLVER_LOG("broke out (stagnated) : iter = %d\n", *in_iter);
+				return false;
+			}
+			replaced_residual = s.tol;
+		}
+
+		// beta = gamma(k) / gamma(k-1), alpha from the recurrence
+		if (s.iter == 0) {
+			beta = 0.0;
+			alpha = s.gamma / s.delta;
+		}
+		else {
+			beta = s.gamma / s.rho;
+			alpha = s.gamma / (s.delta - beta * s.gamma / s.alpha);
+		}
+		s.rho = s.gamma;
+		s.alpha = alpha;
 
-	if(iter >= maxiter)
-		printf("======= iter > maxiter =======\n");
-	if(tol <= umbral)
-		printf("======= tol <= umbral - > %e =======\n", tol);
-
-    FREE(r);
-    FREE(p);
-    FREE(z);
-    FREE(tr);
-	FREE(x_prev);
-}
\ No newline at end of file
+		// am = Am
+		A.mult(m.heads, s.am.heads);
+
+		// the updates, m = M^-1w, and gamma = r^Tu, delta = w^Tu and tol = ||r|| of the next iteration
+		seg_pipecg_update(n, alpha, beta, s.am.heads, s.amap.heads, m.heads, map.heads, s.w.heads, s.ap.heads,
+			u.heads, s.p.heads, x->heads, s.r.heads, M != NULL, M ? M->diagonal() : NULL, &s.gamma, &s.delta, &rr);
+		if (M && !M->diagonal())
+			M->mult(s.w.heads, s.m.heads);
+		s.tol = sqrt(rr);
+
+		s.iter++;
+		(*in_iter)++;
+
+		if (switched)
+			return true;
+	}
+	return false;
+}
+
+#endif
+
+// CG on the heads of b and x; its vectors are ManSegArrays used at head precision. anorm is ||A||, for
+// the attainable accuracy of the heads phase
+void conjugate_gradient(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control)
+{
+	// x(0) = [0, 0, .., 0]
+    cg_state s(n, anorm);
+    if (!A->useTail && CG_STAGNATION_WINDOW > 0) {
+        s.bnorm = seg_norm2(n, b->heads);
+        s.xnorm = seg_norm2(n, x->heads);
+    }
+
+	// one branch per phase rather than per product: the heads phase ends if the controller switches
+    bool full = A->useTail;
+    if (full)
+        cg_start(Matrix<matrix_format, ACCESS_SWITCHED>(A), M, s, b, x);
+    else
+        cg_start(Matrix<matrix_format, ACCESS_HEADS>(A), M, s, b, x);
+    if (!full)
+        full = cg_iterate(Matrix<matrix_format, ACCESS_HEADS>(A), M, s, b, x, maxiter, umbral, step_check, in_iter, control);
+    if (full)
+        cg_iterate(Matrix<matrix_format, ACCESS_SWITCHED>(A), M, s, b, x, maxiter, umbral, step_check, in_iter, control);
+
+	if(s.iter >= maxiter)
+		SOLVER_LOG("======= iter > maxiter =======\n");
+	if(s.tol <= umbral)
+		SOLVER_LOG("======= tol <= umbral - > %e =======\n", s.tol);
+}
+/*
+    Batched CG: k independent (Jacobi preconditioned) CG solves of the same A, one per vector of the
+    blocks b and x, stored interleaved (see vector.h). Their iterations are made in lockstep, so each
+    iteration makes its k products in one pass over A; every vector has its own alpha and beta. A
+    vector that reaches umbral is frozen (alpha = 0) while the rest go on. This is not O'Leary's block
+    CG, whose shared Krylov space needs the block to be deflated once its vectors become dependent: the
+    point here is only to stream A once per k products.
+    The matrix is read at the precision of its phase, with no switch during the solve (the batched
+    refinement, in ir.cpp, switches between solves).
+*/
+template<AccessLevel precision>
+static void batched_cg(Matrix<matrix_format, precision> A, precond_format *M, int n, int k, SolverArray *b, SolverArray *x,
+    int maxiter, FLOAT umbral, int *in_iter)
+{
+    SolverArray r(n * k), p(n * k), z(n * k);
+    FLOAT2 rho[MAX_RHS], tol[MAX_RHS], alpha[MAX_RHS], beta[MAX_RHS], tau[MAX_RHS], pw[MAX_RHS], rr[MAX_RHS];
+    std::vector<double> mx(n), my(n);
+    const FLOAT *d = M ? M->diagonal() : NULL;
+
+    // z = M^-1 r, a vector at a time for a preconditioner that is not a diagonal
+    auto precondition = [&]() {
+        if (d) {
+            for (int i = 0; i < n; i++)
+                for (int q = 0; q < k; q++)
+                    z.heads.set(i * k + q, r.heads.read(i * k + q) / d[i]);
+            return;
+        }
+        for (int q = 0; q < k; q++) {
+            for (int i = 0; i < n; i++)
+                mx[i] = r.heads.read(i * k + q);
+            M->mult(FullView(mx.data(), n), FullView(my.data(), n));
+            for (int i = 0; i < n; i++)
+                z.heads.set(i * k + q, my[i]);
+        }
+    };
+
+	// r(0) = b - Ax(0), z(0) = M^-1r(0), p(1) = z(0)
+    A.mult(k, x->heads, r.heads);
+    seg_block_xpby_norm2(n, k, b->heads, -1.0, r.heads, tol);
+    if (M) {
+        precondition();
+        seg_block_dot(n, k, r.heads, z.heads, rho);
+    }
+    else {
+        seg_copy(n * k, r.heads, z.heads);
+        for (int q = 0; q < k; q++) rho[q] = tol[q] * tol[q];
+    }
+    seg_copy(n * k, z.heads, p.heads);
+
+    int iter = 0;
+    auto active = [&]() {
+        for (int q = 0; q < k; q++)
+            if (tol[q] > umbral) return true;
+        return false;
+    };
+    while (iter < maxiter && active()) {
+		// w = Ap, for the k vectors in one pass over A
+        A.mult(k, p.heads, z.heads);
+        seg_block_dot(n, k, z.heads, p.heads, pw);
+        for (int q = 0; q < k; q++)
+            alpha[q] = tol[q] > umbral ? rho[q] / pw[q] : 0.0;
+
+		// x = x + alpha p, r = r - alpha w, z = r ./ d, tau = r^Tz
+        seg_block_cg_update(n, k, alpha, p.heads, x->heads, r.heads, z.heads, d, tau, rr);
+        if (M && !d) {
+            precondition();
+            seg_block_dot(n, k, r.heads, z.heads, tau);
+        }
+
+        for (int q = 0; q < k; q++) {
+            beta[q] = tol[q] > umbral ? tau[q] / rho[q] : 0.0;
+            rho[q] = tau[q];
+            tol[q] = sqrt(rr[q]);
+        }
+		// p = z + beta p
+        seg_block_xpby(n, k, M ? z.heads : r.heads, beta, p.heads);
+
+        iter++;
+        (*in_iter)++;
+    }
+
+    if (iter >= maxiter)
+        SOLVER_LOG("======= iter > maxiter =======\n");
+}
+
+void batched_conjugate_gradient(int n, int k, matrix_format *A, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter)
+{
+    if (A->useTail)
+        batched_cg(Matrix<matrix_format, ACCESS_SWITCHED>(A), M, n, k, b, x, maxiter, umbral, in_iter);
+    else
+        batched_cg(Matrix<matrix_format, ACCESS_HEADS>(A), M, n, k, b, x, maxiter, umbral, in_iter);
+}
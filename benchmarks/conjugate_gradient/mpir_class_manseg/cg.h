@@ -13,7 +13,43 @@
 #define FLOAT2 DOUBLE
 #endif
 
+#include <omp.h>
+
 #include "../../../manseglib.hpp"
+#include "../../../manseglib_expr.hpp"
+#include "../../../manseglib_controller.hpp"
+#include "../../../manseglib_energy.hpp"
+#include "../../../manseglib_results.hpp"
+#include "../../../manseglib_checkpoint.hpp"
+#include "../../../manseglib_stencil.hpp"
+#include "../../../manseglib_pool.hpp"
+#include "../../../manseglib_anderson.hpp"
+
+/*
+    The vectors of a solve (the CG state, the residual and correction of the refinement, the GMRES
+    basis) come from SegmentPool::global(), so the inner solve made at every outer iteration, and
+    every later solve of a system of about the same size, reuses the planes of the last one rather
+    than mapping, faulting in and zeroing new ones. The matrix and preconditioner are made once.
+*/
+typedef ManSeg::PooledManSegArray SolverArray;
+
+/*
+    Define (in every file, e.g. make CCXFLAGS+=-DUSE_GMRES) to make the corrections of the refinement
+    with restarted GMRES (gmres.cpp) rather than CG, for matrices that are not symmetric positive
+    definite; GMRES_RESTART is the number of basis vectors kept before a restart.
+*/
+// #define USE_GMRES
+#define GMRES_RESTART 30
+
+// most right hand sides solved together by the batched solve (vectors of a block, see vector.h)
+#define MAX_RHS 16
+
+/*
+    Whether the solvers print their progress, per thread: the workers of a batch of solves (batch.cpp)
+    turn it off, as the lines of their systems would be interleaved. Defined in cg.cpp.
+*/
+extern thread_local bool solver_log;
+#define SOLVER_LOG(...) do { if (solver_log) printf(__VA_ARGS__); } while (0)
 
 #define ALLOC(t, l) (t*)malloc((l) * sizeof(t))
 #define CALLOC(t, l) (t*)calloc(sizeof(t),(l))
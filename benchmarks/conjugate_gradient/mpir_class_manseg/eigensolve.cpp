@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <tgmath.h>
+#include <string.h>
+
+#include <time.h>
+#include <omp.h>
+
+#include "mmio.h"
+
+#include "cg.h"
+#include "vector.h"
+#include "matrix.h"
+
+#include "../../../manseglib_lanczos.hpp"
+
+/*
+    The matrix as the operator of the eigensolvers: its heads until the solver switches, and after it
+    the values read at ACCESS_SWITCHED, promoted (see mat_increase_precision) by the first product.
+*/
+class MatrixOperator
+{
+public:
+    matrix_format *A;
+
+    explicit MatrixOperator(matrix_format *A) :A(A) {}
+
+    template<class In, class Out>
+    void operator()(const PrecisionLevel &level, const In &x, Out &&y) {
+        if (level == PRECISION_HEADS) {
+            Matrix<matrix_format, ACCESS_HEADS>(A).mult(x, y);
+            return;
+        }
+        if (!A->useTail)
+            mat_increase_precision(A);
+        Matrix<matrix_format, ACCESS_SWITCHED>(A).mult(x, y);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3 || argc > 6)
+    {
+        fprintf(stderr, "Missing arguments: algorithm matrix_file eigenvalues [smallest] [maxit] [tol]\n");
+        return 1;
+    }
+
+    int n, nz;
+    int *order = NULL;
+#if defined(USE_OPERATOR)
+    int nx, ny;
+    if (sscanf(argv[1], "%dx%d", &nx, &ny) != 2 || nx < 1 || ny < 1)
+    {
+        fprintf(stderr, "The operator needs a grid, NXxNY, in place of the matrix file: %s\n", argv[1]);
+        return 1;
+    }
+    matrix_format *A = operator_create(nx, ny, 4.0, -1.0);
+    matrix_coo *coo = NULL;
+    n = nx * ny;
+    nz = 5 * n - 2 * nx - 2 * ny;
+#else
+    matrix_coo *coo = coo_load(argv[1], &n, &nz, MATRIX_ORDERING, &order);
+#endif
+#if defined(USE_OPERATOR)
+#elif defined(USE_DENSE)
+    matrix_format *A = dense_create(n, nz, coo);
+#elif defined(USE_CSR)
+    matrix_format *A = csr_create(n, nz, coo);
+#elif defined(USE_SYM)
+    matrix_format *A = sym_create(n, nz, coo);
+#elif defined(USE_STREAM)
+    matrix_format *A = stream_create(n, nz, coo);
+#else
+    matrix_format *A = sell_create(n, nz, coo);
+#endif
+    delete coo;
+
+    EigenOptions opts;
+    opts.wanted = std::max(1, atoi(argv[2]));
+    opts.largest = argc <= 3 || atoi(argv[3]) == 0;
+    if (argc > 4)
+        opts.maxIterations = atoi(argv[4]);
+    if (argc > 5 && atof(argv[5]) > 0.0)
+        opts.tol = atof(argv[5]);
+    opts.basis = std::max(opts.basis, 4 * opts.wanted);
+
+    // the same start for every format and ordering, as for sparsesolve's guesses
+    DOUBLE *s = ALLOC(DOUBLE, n);
+    vector_rand(n, s);
+    if (order)
+        vector_permute(n, 1, order, s, false);
+    ManSegArray start(n);
+    start.pairs.writeBlock(0, n, s);
+    FREE(s);
+
+    std::vector<ManSegArray> vectors;
+    for (int i = 0; i < opts.wanted; i++)
+        vectors.emplace_back(n);
+
+    printf("# algorithm            : %s\n", argv[0]);
+    printf("# matrix               : %s\n", argv[1]);
+    printf("# problem_size         : %d\n", n);
+    printf("# nnz                  : %d\n", nz);
+    printf("# eigenvalues          : %d %s\n", opts.wanted, opts.largest ? "largest" : "smallest");
+    printf("# basis                : %d\n", opts.basis);
+    printf("# tolerance            : %e\n\n", opts.tol);
+
+    struct timespec t_start, t_end;
+    MatrixOperator op(A);
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    EigenResult r = lanczos((uint_fast64_t)n, op, start, opts, vectors.data());
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    const double time_taken = (t_end.tv_sec - t_start.tv_sec) + (t_end.tv_nsec - t_start.tv_nsec) * 1e-9;
+
+    // the residuals of the Ritz vectors, from products at full precision
+    mat_increase_precision(A);
+    ManSegArray y(n);
+    double largest_residual = 0.0;
+    for (size_t i = 0; i < r.values.size(); i++) {
+        Matrix<matrix_format, ACCESS_SWITCHED>(A).mult(vectors[i].pairs, y.pairs);
+        const double residual = residualNorm(n, y.pairs, r.values[i], vectors[i].pairs) / blas::nrm2(n, vectors[i].pairs);
+        largest_residual = std::max(largest_residual, residual);
+        printf("# eigenvalue %-9zu : %.15e (residual %e, bound %e)\n", i, r.values[i], residual, r.residuals[i]);
+    }
+
+    printf("\n# iterations           : %d\n", r.iterations);
+    printf("# restarts             : %d\n", r.restarts);
+    printf("# switched_at          : %d\n", r.switchedAt);
+    printf("# converged            : %s\n", r.converged ? "yes" : "no");
+    printf("\n# Time taken           : %.7f s\n", time_taken);
+
+    ResultsWriter results("eigensolve");
+    results.set("matrix", argv[1]);
+    results.set("problem_size", n);
+    results.set("nnz", nz);
+    results.set("threads", omp_get_max_threads());
+    results.set("eigenvalues", opts.wanted);
+    results.set("iterations", r.iterations);
+    results.set("switched_at", r.switchedAt);
+    results.set("largest_residual", largest_residual);
+    results.set("total_time", time_taken);
+    results.write();
+
+    return r.converged ? 0 : 2;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <tgmath.h>
+#include <float.h>
+#include <stdbool.h>
+
+#include <vector>
+
+#include "cg.h"
+#include "vector.h"
+#include "matrix.h"
+
+/*
+    Restarted GMRES for the corrections of the refinement, A d = e, preconditioned on the right:
+    A M^-1 u = e, with d = M^-1 u. The Krylov basis is the memory of GMRES, GMRES_RESTART + 1 vectors
+    of n. Its vectors are ManSegArrays, read and written at heads (4 bytes per value) while the matrix
+    is, and at pairs once the refinement has promoted the matrix, when the residual is small enough
+    for the heads to limit it. The basis comes from the pool of the solver's vectors (see cg.h), whose
+    tails are never made resident unless they are written: in the heads phase the basis takes half the memory and traffic
+    of a double one, or a restart twice as long fits in the same memory.
+    The basis is orthogonalised by modified Gram-Schmidt, with the update by each basis vector fused
+    with the dot product of the next one, in one pass per basis vector rather than two. The Hessenberg
+    matrix and its Givens rotations are small, and kept in doubles.
+    At the heads, the true residual of each restart goes to a monitor, as the recurrence residual of
+    CG does (see cg.cpp). The solve stops, for the refinement to promote the matrix, once a restart
+    lowers that residual by less than GMRES_STAGNATION_RATIO, or once it reaches the attainable
+    accuracy of the heads, u (||A|| ||x|| + ||b||). A tolerance the heads cannot reach otherwise
+    takes every iteration of maxiter.
+*/
+#define GMRES_STAGNATION_RATIO 0.9
+
+typedef SolverArray BasisArray;
+
+// returns true if the heads phase stopped on its monitor
+template<AccessLevel basis, AccessLevel precision>
+static bool gmres_solve(Matrix<matrix_format, precision> A, DOUBLE anorm, precond_format *M, int n, std::vector<BasisArray> &V,
+    SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter)
+{
+    typedef typename LevelView<basis, PooledSegmentAllocator>::type View;
+    const int m = GMRES_RESTART;
+    typename LevelView<basis, PooledSegmentAllocator>::type bv = LevelView<basis, PooledSegmentAllocator>::of(*b), xv = LevelView<basis, PooledSegmentAllocator>::of(*x);
+    // H is (m + 1) x m, by columns; cs and sn are the rotations, and g the rotated residual
+    std::vector<double> H((m + 1) * m), cs(m), sn(m), g(m + 1), y(m), u(n);
+    BasisArray z(n);
+    View zv = LevelView<basis, PooledSegmentAllocator>::of(z);
+    int iter = 0;
+    FLOAT2 residual;
+    // a window of one restart
+    PrecisionController<ResidualHistoryPolicy> monitor(ResidualHistoryPolicy(1, GMRES_STAGNATION_RATIO), false);
+    DOUBLE bnorm = basis == ACCESS_HEADS ? seg_norm2(n, bv) : 0.0;
+
+    do {
+		// r = b - Ax, in V[0]
+        View v0 = LevelView<basis, PooledSegmentAllocator>::of(V[0]);
+        A.mult(xv, v0);
+        residual = seg_xpby_norm2(n, bv, -1.0, v0);
+        SOLVER_LOG("# gmres: restart at iter=%d resid=%e\n", iter, (double)residual);
+        if (residual <= umbral || residual == 0.0)
+            break;
+        if (basis == ACCESS_HEADS) {
+            monitor.policy().floor = MaxSingleSegmentPrecision * (anorm * seg_norm2(n, xv) + bnorm);
+            if (monitor.update(residual) != PRECISION_HEADS) {
+                SOLVER_LOG("stopping at iteration %d (%s), switching precision\n", *in_iter, monitor.reasonName());
+                return true;
+            }
+        }
+        seg_scale(n, 1.0 / residual, v0);
+        std::fill(g.begin(), g.end(), 0.0);
+        g[0] = residual;
+
+        int cols = 0;
+        for (int j = 0; j < m && iter < maxiter; j++) {
+            double *h = &H[j * (m + 1)];
+            View vj = LevelView<basis, PooledSegmentAllocator>::of(V[j]), w = LevelView<basis, PooledSegmentAllocator>::of(V[j + 1]);
+			// w = AM^-1 v(j)
+            if (M) {
+                M->mult(vj, zv);
+                A.mult(zv, w);
+            }
+            else {
+                A.mult(vj, w);
+            }
+			// modified Gram-Schmidt: h(i) = w^Tv(i), w = w - h(i)v(i) for i <= j, then h(j+1) = ||w||
+            h[0] = seg_dot(n, w, v0);
+            for (int i = 0; i < j; i++)
+                h[i + 1] = seg_axpy_dot(n, -h[i], LevelView<basis, PooledSegmentAllocator>::of(V[i]), w, LevelView<basis, PooledSegmentAllocator>::of(V[i + 1]));
+            h[j + 1] = seg_axpy_norm2(n, -h[j], vj, w);
+            if (h[j + 1] != 0.0)
+                seg_scale(n, 1.0 / h[j + 1], w);
+
+			// the rotations of the earlier columns, and a new one to zero h(j+1)
+            for (int i = 0; i < j; i++) {
+                double t = cs[i] * h[i] + sn[i] * h[i + 1];
+                h[i + 1] = -sn[i] * h[i] + cs[i] * h[i + 1];
+                h[i] = t;
+            }
+            double rho = hypot(h[j], h[j + 1]);
+            cs[j] = h[j] / rho;
+            sn[j] = h[j + 1] / rho;
+            h[j] = rho;
+            h[j + 1] = 0.0;
+            g[j + 1] = -sn[j] * g[j];
+            g[j] = cs[j] * g[j];
+            residual = fabs(g[j + 1]);
+
+            cols = j + 1;
+            iter++;
+            (*in_iter)++;
+            if (residual <= umbral)
+                break;
+        }
+
+		// y = H^-1 g, and x = x + M^-1 Vy
+        for (int i = cols - 1; i >= 0; i--) {
+            double t = g[i];
+            for (int l = i + 1; l < cols; l++)
+                t -= H[l * (m + 1) + i] * y[l];
+            y[i] = t / H[i * (m + 1) + i];
+        }
+        std::fill(u.begin(), u.end(), 0.0);
+        for (int i = 0; i < cols; i++)
+            seg_axpy(n, y[i], LevelView<basis, PooledSegmentAllocator>::of(V[i]), FullView(u.data(), n));
+        if (M) {
+            M->mult(FullView(u.data(), n), zv);
+            seg_axpy(n, 1.0, zv, xv);
+        }
+        else {
+            seg_axpy(n, 1.0, FullView(u.data(), n), xv);
+        }
+    } while (residual > umbral && iter < maxiter);
+
+    if (iter >= maxiter)
+        SOLVER_LOG("======= iter > maxiter =======\n");
+    return false;
+}
+
+// GMRES for the correction x of the refinement, at heads or (once A is promoted) at pairs. anorm is
+// ||A||, for the attainable accuracy of the heads; returns true if the heads could go no further, for
+// the refinement to promote A
+bool gmres(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter)
+{
+    std::vector<BasisArray> V(GMRES_RESTART + 1);
+    for (size_t i = 0; i < V.size(); i++)
+        V[i].alloc(n);
+
+    if (A->useTail)
+        return gmres_solve<ACCESS_PAIRS>(Matrix<matrix_format, ACCESS_SWITCHED>(A), anorm, M, n, V, b, x, maxiter, umbral, in_iter);
+    return gmres_solve<ACCESS_HEADS>(Matrix<matrix_format, ACCESS_HEADS>(A), anorm, M, n, V, b, x, maxiter, umbral, in_iter);
+}
@@ -4,67 +4,294 @@
 #include <tgmath.h>
 #include <float.h>
 #include <stdbool.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 #include "cg.h"
 #include "vector.h"
 #include "matrix.h"
 
-void conjugate_gradient(int n, matrix *A, matrix *M, FLOAT *b, FLOAT *x, int maxiter, FLOAT umbral, int step_check, int *in_iter, bool *precision_increase);
+void conjugate_gradient(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int step_check, int *in_iter, PrecisionController<ConfiguredPolicy> *control);
+bool gmres(int n, matrix_format *A, DOUBLE anorm, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter);
+void batched_conjugate_gradient(int n, int k, matrix_format *A, precond_format *M, SolverArray *b, SolverArray *x, int maxiter, FLOAT umbral, int *in_iter);
+
+/*
+    Model of the memory traffic of one CG iteration, for the results: the CSR values at the
+    matrix's precision and column indices, the row offsets and the fourteen passes over vector heads
+    left by the fused updates (two for the product, two for p^Tw, seven for seg_cg_update and three
+    for the new p).
+*/
+static double cgBytes(int n, int nz, PrecisionLevel level)
+{
+#ifdef USE_OPERATOR
+    // nothing of the matrix is stored, let alone read
+    return 14.0*n*sizeof(float);
+#endif
+#ifdef USE_GMRES
+    // GMRES: on average half a restart of basis vectors, at heads or pairs, each read twice by the
+    // fused Gram-Schmidt, and the new vector's product, scaling and preconditioner
+    return nz*(sizeof(int) + (level == PRECISION_HEADS ? sizeof(float) : sizeof(double))) + (n + 1)*sizeof(int)
+        + (GMRES_RESTART + 6.0)*n*(level == PRECISION_HEADS ? sizeof(float) : sizeof(double));
+#else
+    return nz*(sizeof(int) + (level == PRECISION_HEADS ? sizeof(float) : sizeof(double))) + (n + 1)*sizeof(int) + 14.0*n*sizeof(float);
+#endif
+}
+
+/*
+    x = x + d, mixed with the outer iterations before it (see AndersonAccelerator) when $MANSEG_ANDERSON
+    is set: x + d is the fixed point map, made a chunk at a time from d's heads or pairs.
+*/
+template<class View>
+static void andersonUpdate(AndersonAccelerator<>& anderson, int n, const View& d, DOUBLE *x)
+{
+    const int chunk = 4096;
+    std::vector<double> g(chunk);
+    for(int r = 0; r * chunk < n; r++)
+    {
+        const int start = r * chunk, count = std::min(chunk, n - start);
+        d.readBlock(start, count, g.data());
+        for(int i = 0; i < count; i++)
+            g[i] += x[start + i];
+        anderson.accumulate(r, start, count, x + start, g.data());
+    }
+    anderson.solve();
+    for(int r = 0; r * chunk < n; r++)
+    {
+        const int start = r * chunk, count = std::min(chunk, n - start);
+        d.readBlock(start, count, g.data());
+        for(int i = 0; i < count; i++)
+            g[i] += x[start + i];
+        anderson.apply(start, count, x + start, g.data(), x + start);
+    }
+}
+
+// what a refinement resumes from besides x, saved with it after every few outer iterations
+struct IRCheckpoint
+{
+    int n;
+    int outIter, inIter, promoted;
+    bool useTail;
+    PrecisionController<ConfiguredPolicy> control;
+    PrecisionController<StagnationPolicy> outer;
+};
 
-void iterative_refinement(int n, matrix *A, matrix *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x, int out_maxiter, DOUBLE out_tol, 
-    int in_maxiter, DOUBLE in_tol, int step_check, int *out_iter, int *in_iter)
+void iterative_refinement(int n, int nz, matrix_format *A, DOUBLE anorm, precond_format *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x, int out_maxiter, DOUBLE out_tol, 
+    int in_maxiter, DOUBLE in_tol, int step_check, int *out_iter, int *in_iter, ResultsWriter *results)
 {
-    DOUBLE *e = ALLOC(DOUBLE, n);
-    FLOAT *r = ALLOC(FLOAT, n);
-    FLOAT *d = ALLOC(FLOAT, n);
+    // the residual e is kept in its pairs, and CG solves for the correction d with e's heads as the
+    // right hand side, so neither is copied to float
+    SolverArray e(n);
+    SolverArray d(n);
 
-    mixed_copy(n, x, d); // d = (float)x
+    seg_copy(n, FullView(x, n), d.heads); // d = heads(x)
     vector_set(n, 0.0, x);
 	// fill r with low precision version first
-    mixed_copy(n, b_dash, r); // r = (float)b_dash
+    seg_copy(n, FullView(b_dash, n), e.pairs); // e = b_dash
 
 	double x_norm, x_norm_prev;
     DOUBLE residual;
-	bool precision_increase = false;
-	bool switched = false;
+	// the matrix goes to full precision once an explicit residual check moves x by at most 5e-3,
+	// unless $MANSEG_SWITCH_POLICY says otherwise
+	AbsoluteBoundPolicy maxDiffBound(5e-3);
+	PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(maxDiffBound), false);
+	results->set("switch_policy", control.policy().name());
+	results->set("switch_param", control.policy().parameter());
+	// the inner check only sees CG's own progress, and a refinement can stall at the heads with the
+	// inner solves still converging (or with nothing left for them to do): the matrix is also promoted
+	// once an outer iteration reduces the residual by less than half
+	PrecisionController<StagnationPolicy> outer(StagnationPolicy(0.5), false, seg_norm2(n, e.pairs));
+	int promoted = -1;
+	// $MANSEG_ANDERSON=m: each correction is mixed with the m before it, restarted when the matrix is promoted
+	const int andersonWindow = getenv("MANSEG_ANDERSON") != NULL ? atoi(getenv("MANSEG_ANDERSON")) : 0;
+	std::unique_ptr<AndersonAccelerator<> > anderson;
+	if(andersonWindow > 0)
+		anderson.reset(new AndersonAccelerator<>(n, andersonWindow, (n + 4095) / 4096));
+	results->set("anderson", andersonWindow);
+	results->set("anderson_bytes", anderson ? (long)anderson->bytes() : 0L);
+	// a preempted run, requeued with the same arguments, resumes from its last $MANSEG_CHECKPOINT, saved
+	// every $MANSEG_CHECKPOINT_EVERY outer iterations while the next correction is solved for. x is kept
+	// in doubles throughout, so both planes are saved; the residual is made again from it
+	Checkpointer checkpoint;
+	{
+		IRCheckpoint resumed;
+		CheckpointFile saved;
+		if(saved.state(resumed) && resumed.n == n && saved.size() == (uint_fast64_t)n && saved.hasTails())
+		{
+			for(int i = 0; i < n; i++)
+				x[i] = saved.value(i);
+			*out_iter = resumed.outIter;
+			*in_iter = resumed.inIter;
+			promoted = resumed.promoted;
+			control = resumed.control;
+			outer = resumed.outer;
+			if(resumed.useTail && !A->useTail)
+				mat_increase_precision(A);
+			seg_set(n, 0.0, d.pairs);
+			matrix_mult(A, FullView(x, n), e.pairs);
+			seg_xpby_norm2(n, FullView(A->useTail ? b : b_dash, n), -1.0, e.pairs); // r = b - Ax
+			printf("resuming from %s at outer iteration %d\n", getenv("MANSEG_CHECKPOINT"), *out_iter);
+		}
+	}
+	results->set("resumed_outer_iteration", *out_iter);
+	// RAPL energy of each outer iteration, charged to the matrix's precision level with its inner
+	// iterations, so that joules per CG iteration at the heads and in full can be compared
+	EnergyPhases energy;
+	energy.start();
     do
     {
-		conjugate_gradient(n, A, M, r, d, in_maxiter, in_tol, step_check, in_iter, &precision_increase);
-        
-		mixed_axpy(n, 1.0, d, x); // x = x + d
-		matrix_mult(A, x, e);
+		struct timespec step_start, step_end;
+		clock_gettime(CLOCK_MONOTONIC, &step_start);
+		int in_start = *in_iter;
+		PrecisionLevel level = A->useTail ? PRECISION_FULL : PRECISION_HEADS;
+		bool stalled = false;   // CG promotes A itself
+#ifdef USE_GMRES
+		// GMRES makes d at pairs once the matrix is promoted, and says when the heads have stalled
+		stalled = gmres(n, A, anorm, M, &e, &d, in_maxiter, in_tol, in_iter);
+		checkpoint.wait(); // x was being saved during the solve
+		if(anderson && A->useTail)
+			andersonUpdate(*anderson, n, d.pairs, x);
+		else if(anderson)
+			andersonUpdate(*anderson, n, d.heads, x);
+		else if(A->useTail)
+			seg_axpy(n, 1.0, d.pairs, FullView(x, n)); // x = x + d
+		else
+			seg_axpy(n, 1.0, d.heads, FullView(x, n));
+#else
+		conjugate_gradient(n, A, anorm, M, &e, &d, in_maxiter, in_tol, step_check, in_iter, &control);
+		checkpoint.wait(); // x was being saved during the solve
+		if(anderson)
+			andersonUpdate(*anderson, n, d.heads, x);
+		else
+			seg_axpy(n, 1.0, d.heads, FullView(x, n)); // x = x + d
+#endif
+		matrix_mult(A, FullView(x, n), e.pairs);
 
 		// i *think* this is helping things, but it requires more testing
 		// it would maybe make sense, since b is the other component of Ax = b [or AMx = Mb or whatever]
 		// so having it be more accurate would (when we switch) would help hone in on the result
-		if(!precision_increase)
-			vector_xpby(n, b_dash, -1.0, e); // r = b - Ax
+		if(!A->useTail)
+			residual = seg_xpby_norm2(n, FullView(b_dash, n), -1.0, e.pairs); // r = b - Ax
 		else
-			vector_xpby(n, b, -1.0, e); // r = b - Ax
+			residual = seg_xpby_norm2(n, FullView(b, n), -1.0, e.pairs); // r = b - Ax
 
-        residual = vector_norm2(n, e);
-        mixed_copy(n, e, r);
-        floatm_set(n, 0.0, d);
+#ifdef USE_GMRES
+        seg_set(n, 0.0, d.pairs);
+#else
+        seg_set(n, 0.0, d.heads);
+#endif
 
-		/* if(!switched && precision_increase)
+		if(!A->useTail && (stalled || outer.update(residual) != PRECISION_HEADS))
 		{
+			printf("switching precision at outer iteration %d (%s)\n", *out_iter, stalled ? "inner solve stalled" : outer.reasonName());
 			mat_increase_precision(A);
-			switched = true;
-		} */
+			if(anderson)
+				anderson->restart();
+			// the next correction is for the full precision residual
+			matrix_mult(A, FullView(x, n), e.pairs);
+			residual = seg_xpby_norm2(n, FullView(b, n), -1.0, e.pairs);
+		}
+		if(promoted < 0 && A->useTail)
+			promoted = *out_iter;
 
 		printf("%d: outer: residual = %e\n", *out_iter, residual);
-        // *energy += iter * (bits + 12) / 8;
-        // printf("%d %d %d %e %e\n", *in_iter, 0, bits, (double)residual, (double)residual);
+		clock_gettime(CLOCK_MONOTONIC, &step_end);
+		results->iteration(*out_iter, residual, (step_end.tv_sec - step_start.tv_sec) + (step_end.tv_nsec - step_start.tv_nsec)*1e-9,
+						   levelName(level), (*in_iter - in_start)*cgBytes(n, nz, level));
+		Energy step = energy.lap(levelName(level), (step_end.tv_sec - step_start.tv_sec) + (step_end.tv_nsec - step_start.tv_nsec)*1e-9,
+								 *in_iter - in_start);
+		results->energy(step.package, step.dram);
 
-        (*out_iter)++;		
+        (*out_iter)++;
+		if(residual > out_tol && checkpoint.due(*out_iter))
+			checkpoint.saveFull(IRCheckpoint{n, *out_iter, *in_iter, promoted, A->useTail, control, outer}, x, n);
     } while ((residual > out_tol) && (*out_iter < out_maxiter));
+	// a finished refinement leaves nothing to resume
+	checkpoint.remove();
+	results->set("checkpoint_bytes", (long)checkpoint.bytes());
+	results->set("checkpoint_plane_bytes", (long)checkpoint.rawBytes());
+
+	results->set("promoted_outer_iteration", promoted);
+	energy.print();
+	energy.report(*results);
 
     if (residual <= out_tol)
         printf("\n==== residual less than out_tol ====\n");
 	if(*out_iter >= out_maxiter)
 		printf("out_iter >= out_maxiter\n");
 
-    FREE(e);
-    FREE(r);
-    FREE(d);
-}
\ No newline at end of file
+}
+
+/*
+    Iterative refinement of k right hand sides at once, with b, b_dash and x blocks of k vectors stored
+    interleaved (see vector.h): as above, with the corrections made by the batched CG, whose iterations
+    read A once for all k vectors. The residual of an outer iteration is the largest of the k, and the
+    matrix is promoted when it stagnates; the inner solves do not switch.
+*/
+void batched_iterative_refinement(int n, int nz, int k, matrix_format *A, precond_format *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x,
+    int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol, int *out_iter, int *in_iter, ResultsWriter *results)
+{
+    SolverArray e(n * k);
+    SolverArray d(n * k);
+    FLOAT2 residuals[MAX_RHS];
+
+    seg_copy(n * k, FullView(x, n * k), d.heads);
+    vector_set(n * k, 0.0, x);
+    seg_copy(n * k, FullView(b_dash, n * k), e.pairs);
+
+    DOUBLE residual;
+    seg_block_dot(n, k, e.pairs, e.pairs, residuals);
+    residual = sqrt(*std::max_element(residuals, residuals + k));
+    PrecisionController<StagnationPolicy> outer(StagnationPolicy(0.5), false, residual);
+    int promoted = -1;
+    EnergyPhases energy;
+    energy.start();
+    do
+    {
+		struct timespec step_start, step_end;
+		clock_gettime(CLOCK_MONOTONIC, &step_start);
+		int in_start = *in_iter;
+		PrecisionLevel level = A->useTail ? PRECISION_FULL : PRECISION_HEADS;
+		batched_conjugate_gradient(n, k, A, M, &e, &d, in_maxiter, in_tol, in_iter);
+
+		seg_axpy(n * k, 1.0, d.heads, FullView(x, n * k)); // x = x + d
+		matrix_mult(A, k, FullView(x, n * k), e.pairs);
+		seg_block_xpby_norm2(n, k, FullView(A->useTail ? b : b_dash, n * k), -1.0, e.pairs, residuals); // r = b - Ax
+		residual = *std::max_element(residuals, residuals + k);
+
+        seg_set(n * k, 0.0, d.heads);
+
+		if(!A->useTail && outer.update(residual) != PRECISION_HEADS)
+		{
+			printf("switching precision at outer iteration %d (%s)\n", *out_iter, outer.reasonName());
+			mat_increase_precision(A);
+			matrix_mult(A, k, FullView(x, n * k), e.pairs);
+			seg_block_xpby_norm2(n, k, FullView(b, n * k), -1.0, e.pairs, residuals);
+			residual = *std::max_element(residuals, residuals + k);
+		}
+		if(promoted < 0 && A->useTail)
+			promoted = *out_iter;
+
+		printf("%d: outer: max residual of %d = %e\n", *out_iter, k, residual);
+		clock_gettime(CLOCK_MONOTONIC, &step_end);
+		// an inner iteration reads the matrix once, and the vectors k times over
+		results->iteration(*out_iter, residual, (step_end.tv_sec - step_start.tv_sec) + (step_end.tv_nsec - step_start.tv_nsec)*1e-9,
+						   levelName(level), (*in_iter - in_start)*(cgBytes(n, nz, level) + (k - 1)*14.0*n*sizeof(float)));
+		Energy step = energy.lap(levelName(level), (step_end.tv_sec - step_start.tv_sec) + (step_end.tv_nsec - step_start.tv_nsec)*1e-9,
+								 *in_iter - in_start);
+		results->energy(step.package, step.dram);
+
+        (*out_iter)++;
+    } while ((residual > out_tol) && (*out_iter < out_maxiter));
+
+	results->set("promoted_outer_iteration", promoted);
+	energy.print();
+	energy.report(*results);
+
+    if (residual <= out_tol)
+        printf("\n==== residual less than out_tol ====\n");
+	if(*out_iter >= out_maxiter)
+		printf("out_iter >= out_maxiter\n");
+}
@@ -8,33 +8,360 @@
 #include "mmio.h"
 #include <tgmath.h> // interferes with mmio.h
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
 #include "cg.h"
 #include "matrix.h"
+#include "../../../manseglib_writer.hpp"
+
+/*
+    Loading: the entries of a .mtx file are parsed by all the threads, each from its own stretch of the
+    text, mirrored to both triangles if the matrix is symmetric, and sorted by (row, column) with two counting sort passes (by
+    column, then stably by row). The result is cached next to the file, as file.mtx.bin: the entries
+    in CSR, with the values split into heads and tails planes. Later runs map the cache instead, as
+    long as it records the size and modification time of the .mtx it was made from.
+    With an ordering (USE_RCM, USE_ND) the entries are then renumbered, and re-sorted. The cache keeps
+    the entries in the numbering of the file, and the order of the last ordering made, which a run
+    asking for another one replaces.
+*/
+
+struct mtx_cache_header
+{
+    char magic[8];
+    int32_t n, nz;
+    int64_t size, mtime;    // of the .mtx file
+    int32_t ordering;       // of the order kept, ORDER_NONE for none
+    int32_t reserved;
+};
+
+static const char mtx_cache_magic[8] = "MSCSR02";
+
+// the cache: the header, then i[n + 1], j[nz], heads[nz], tails[nz] and (with an ordering) order[n],
+// each on a cache line
+static size_t cache_align(size_t bytes) { return (bytes + 63) / 64 * 64; }
+
+static size_t cache_bytes(int n, int nz, int ordering, size_t *j_at, size_t *heads_at, size_t *tails_at, size_t *order_at)
+{
+    *j_at = cache_align(sizeof(mtx_cache_header)) + cache_align((n + 1) * sizeof(int));
+    *heads_at = *j_at + cache_align(nz * sizeof(int));
+    *tails_at = *heads_at + cache_align(nz * sizeof(float));
+    *order_at = *tails_at + cache_align(nz * sizeof(float));
+    return *order_at + (ordering != ORDER_NONE ? cache_align(n * sizeof(int)) : 0);
+}
+
+// the entries of the cache of a .mtx file with status src, or NULL if there is no valid cache. *order
+// is the cached order if it is of ordering, else NULL
+static matrix_coo *coo_from_cache(const char *cache, const struct stat *src, int *n, int *nz, int ordering, int **order)
+{
+    int fd = open(cache, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(mtx_cache_header))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    const mtx_cache_header *h = (const mtx_cache_header*)base;
+    size_t j_at, heads_at, tails_at, order_at;
+    if (memcmp(h->magic, mtx_cache_magic, sizeof(h->magic)) != 0 || h->size != (int64_t)src->st_size
+        || h->mtime != (int64_t)src->st_mtime || h->n < 0 || h->nz < 0
+        || cache_bytes(h->n, h->nz, h->ordering, &j_at, &heads_at, &tails_at, &order_at) != (size_t)st.st_size) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+
+    const char *data = (const char*)base;
+    const int *i = (const int*)(data + cache_align(sizeof(mtx_cache_header)));
+    const int *j = (const int*)(data + j_at);
+    // the planes are only read, through a pair view
+    TwoSegArray<true> values((float*)(data + heads_at), (float*)(data + tails_at), h->nz);
+    matrix_coo *coo = ALLOC(matrix_coo, h->nz);
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int r = 0; r < h->n; r++) {
+        double a[ROW_CHUNK];
+        for (int l = i[r]; l < i[r + 1]; l += ROW_CHUNK) {
+            int len = std::min(ROW_CHUNK, i[r + 1] - l);
+            values.readBlock(l, len, a);
+            for (int m = 0; m < len; m++) {
+                coo[l + m].i = r;
+                coo[l + m].j = j[l + m];
+                coo[l + m].a = a[m];
+            }
+        }
+    }
+    *n = h->n;
+    *nz = h->nz;
+    *order = NULL;
+    if (ordering != ORDER_NONE && h->ordering == ordering) {
+        *order = ALLOC(int, h->n);
+        memcpy(*order, data + order_at, h->n * sizeof(int));
+    }
+    munmap(base, st.st_size);
+    return coo;
+}
+
+// count bytes to fd at offset at; false if they could not all be written
+static bool cache_pwrite(int fd, const void *from, size_t count, off_t at)
+{
+    const char *p = (const char*)from;
+    while (count > 0) {
+        ssize_t put = pwrite(fd, p, count, at);
+        if (put <= 0) return false;
+        p += put;
+        at += put;
+        count -= put;
+    }
+    return true;
+}
+
+// writes the sorted entries of a .mtx file with status src, and order if there is one, to path in the
+// layout of the cache; false if it could not be written. The file is written a piece at a time, the
+// values through a SegmentWriter, so that no more than a chunk of it is held besides the entries
+static bool coo_write(const char *path, const struct stat *src, int n, int nz, const matrix_coo *coo,
+    int ordering, const int *order)
+{
+    if (order == NULL) ordering = ORDER_NONE;
+    size_t j_at, heads_at, tails_at, order_at;
+    size_t bytes = cache_bytes(n, nz, ordering, &j_at, &heads_at, &tails_at, &order_at);
+    mtx_cache_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, mtx_cache_magic, sizeof(h.magic));
+    h.n = n;
+    h.nz = nz;
+    h.size = src->st_size;
+    h.mtime = src->st_mtime;
+    h.ordering = ordering;
+
+    // written under another name and renamed, so a run never maps a partly written file
+    size_t len = strlen(path);
+    char *tmp = ALLOC(char, len + 5);
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+    int fd = open(tmp, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+    // the padding between the arrays is the hole the truncation leaves
+    bool written = ftruncate(fd, bytes) == 0 && cache_pwrite(fd, &h, sizeof(h), 0);
+
+    int *i = CALLOC(int, n + 1);
+    for (int k = 0; k < nz; k++) i[coo[k].i + 1]++;
+    for (int r = 0; r < n; r++) i[r + 1] += i[r];
+    written = written && cache_pwrite(fd, i, (n + 1) * sizeof(int), cache_align(sizeof(mtx_cache_header)));
+    free(i);
+
+    int j[ROW_CHUNK];
+    SegmentWriter values(fd, heads_at, tails_at, nz);
+    for (int k = 0; written && k < nz; k += ROW_CHUNK) {
+        int m = std::min(ROW_CHUNK, nz - k);
+        for (int l = 0; l < m; l++) {
+            j[l] = coo[k + l].j;
+            values.push(coo[k + l].a);
+        }
+        written = cache_pwrite(fd, j, m * sizeof(int), j_at + (off_t)k * sizeof(int));
+    }
+    written = values.close() && written;
+    if (order != NULL)
+        written = written && cache_pwrite(fd, order, n * sizeof(int), order_at);
+
+    written = close(fd) == 0 && written && rename(tmp, path) == 0;
+    if (!written)
+        remove(tmp);
+    free(tmp);
+    return written;
+}
+
+// writes the cache of the sorted entries of a .mtx file; a cache that cannot be written is only a
+// slower next run
+static void coo_to_cache(const char *cache, const struct stat *src, int n, int nz, const matrix_coo *coo,
+    int ordering, const int *order)
+{
+    coo_write(cache, src, n, nz, coo, ordering, order);
+}
+
+// sorts the entries by (row, column): a radix sort with digits of base n, by column, then stably by row
+static void coo_sort(int n, int nz, matrix_coo *coo)
+{
+    int *count = ALLOC(int, n + 1);
+    matrix_coo *by_col = ALLOC(matrix_coo, nz);
+    memset(count, 0, (n + 1) * sizeof(int));
+    for (int l = 0; l < nz; l++) count[coo[l].j + 1]++;
+    for (int c = 0; c < n; c++) count[c + 1] += count[c];
+    for (int l = 0; l < nz; l++) by_col[count[coo[l].j]++] = coo[l];
+    memset(count, 0, (n + 1) * sizeof(int));
+    for (int l = 0; l < nz; l++) count[by_col[l].i + 1]++;
+    for (int r = 0; r < n; r++) count[r + 1] += count[r];
+    for (int l = 0; l < nz; l++) coo[count[by_col[l].i]++] = by_col[l];
+    free(by_col);
+    free(count);
+}
+
+// an entry as read, before it is mirrored
+struct mtx_entry
+{
+    int i, j;
+    double a;
+};
+
+// the order of ordering for the pattern of the sorted entries
+static int *coo_make_order(int n, int nz, const matrix_coo *coo, int ordering)
+{
+    int *i = CALLOC(int, n + 1);
+    int *j = ALLOC(int, nz);
+    for (int l = 0; l < nz; l++) {
+        i[coo[l].i + 1]++;
+        j[l] = coo[l].j;
+    }
+    for (int r = 0; r < n; r++) i[r + 1] += i[r];
+    int *order = make_order(ordering, n, i, j);
+    free(i);
+    free(j);
+    return order;
+}
+
+// parses the entries of a .mtx file, from its text after the size line
+static matrix_coo *coo_parse(const char *fname, MM_typecode matcode, long data, int N, int NZ, int *nz)
+{
+    FILE *f = fopen(fname, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    // the whole text, terminated so that strtol and strtod stop at its end
+    char *text = ALLOC(char, size - data + 1);
+    fseek(f, data, SEEK_SET);
+    size = data + (long)fread(text, 1, size - data, f);
+    text[size - data] = '\0';
+    fclose(f);
 
-static int compar(const void *pa, const void *pb)
+    // each thread parses the lines starting in its stretch of the text
+    int threads = omp_get_max_threads();
+    std::vector<std::vector<mtx_entry> > parts(threads);
+    std::vector<int> mirrored(threads + 1, 0);
+    bool pattern = mm_is_pattern(matcode), symmetric = mm_is_symmetric(matcode), failed = false;
+    #pragma omp parallel num_threads(threads) reduction(||: failed)
+    {
+        int t = omp_get_thread_num(), parts_made = omp_get_num_threads();
+        long from = (size - data) * t / parts_made, to = (size - data) * (t + 1) / parts_made;
+        // a line belongs to the stretch its first character is in
+        if (from > 0)
+            while (from < to && text[from - 1] != '\n') from++;
+        std::vector<mtx_entry> &part = parts[t];
+        part.reserve((size_t)((double)NZ * (to - from) / (size - data + 1)) + 16);
+        char *p = text + from;
+        while (!failed) {
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+            if (p >= text + to || *p == '\0') break;
+            mtx_entry e;
+            char *q;
+            e.i = (int)strtol(p, &q, 10) - 1;
+            e.j = (int)strtol(q, &p, 10) - 1;
+            e.a = pattern ? 1.0 : strtod(p, &q);
+            if (!pattern) p = q;
+            if (e.i < 0 || e.i >= N || e.j < 0 || e.j >= N) failed = true;
+            // skip anything else on the line (e.g. an imaginary part)
+            while (*p != '\n' && *p != '\0') p++;
+            part.push_back(e);
+        }
+        int count = 0;
+        for (size_t k = 0; k < part.size(); k++)
+            count += part[k].i == part[k].j || !symmetric ? 1 : 2;
+        mirrored[t + 1] = count;
+    }
+    free(text);
+    size_t read = 0;
+    for (int t = 0; t < threads; t++) read += parts[t].size();
+    if (failed || read != (size_t)NZ) {
+        fprintf(stderr, "Error reading matrix elements: %zu of %d read\n", read, NZ);
+        exit(1);
+    }
+    for (int t = 0; t < threads; t++) mirrored[t + 1] += mirrored[t];
+    int k = mirrored[threads];
+
+    // the off diagonal entries of one triangle, to both (of a symmetric matrix)
+    matrix_coo *both = ALLOC(matrix_coo, k);
+    #pragma omp parallel for num_threads(threads)
+    for (int t = 0; t < threads; t++) {
+        int at = mirrored[t];
+        for (size_t l = 0; l < parts[t].size(); l++) {
+            const mtx_entry &e = parts[t][l];
+            both[at].i = e.i;
+            both[at].j = e.j;
+            both[at++].a = e.a;
+            if (e.i != e.j && symmetric) {
+                both[at].i = e.j;
+                both[at].j = e.i;
+                both[at++].a = e.a;
+            }
+        }
+    }
+    parts.clear();
+
+    coo_sort(N, k, both);
+    *nz = k;
+    return both;
+}
+
+// renumbers the entries, (i, j) becoming (new[i], new[j]) for new the inverse of order, and sorts them again
+static void coo_permute(int n, int nz, matrix_coo *coo, const int *order)
 {
-    matrix_coo *a = (matrix_coo*)pa;
-    matrix_coo *b = (matrix_coo*)pb;
-    if (a->i < b->i) return -1;
-    if (a->i > b->i) return 1;
-    if (a->j < b->j) return -1;
-    if (a->j > b->j) return 1;
-    return 0;
+    int *renumbered = ALLOC(int, n);
+    for (int k = 0; k < n; k++) renumbered[order[k]] = k;
+    #pragma omp parallel for
+    for (int l = 0; l < nz; l++) {
+        coo[l].i = renumbered[coo[l].i];
+        coo[l].j = renumbered[coo[l].j];
+    }
+    free(renumbered);
+    coo_sort(n, nz, coo);
 }
 
-matrix_coo* coo_load(const char *fname, int *n, int *nz)
+/*
+    The entries of a .mtx file, sorted by (row, column). With an ordering other than ORDER_NONE they
+    are renumbered by it, and *order is set to the order (the old number of the unknown numbered k is
+    order[k]), for the vectors to be permuted alike; otherwise *order is NULL.
+*/
+matrix_coo* coo_load(const char *fname, int *n, int *nz, int ordering, int **order)
 {
     FILE *f;
     if ((f = fopen(fname, "r")) == NULL) {
         fprintf(stderr, "Error opening file: %s\n", fname);
         exit(1);
     }
+    struct stat src;
+    fstat(fileno(f), &src);
+
+    // file.mtx.bin
+    size_t len = strlen(fname);
+    char *cache = ALLOC(char, len + 5);
+    memcpy(cache, fname, len);
+    memcpy(cache + len, ".bin", 5);
+    matrix_coo *coo = coo_from_cache(cache, &src, n, nz, ordering, order);
+    if (coo != NULL) {
+        fclose(f);
+        if (ordering != ORDER_NONE && *order == NULL) {
+            // cached in another ordering, or none
+            *order = coo_make_order(*n, *nz, coo, ordering);
+            coo_to_cache(cache, &src, *n, *nz, coo, ordering, *order);
+        }
+        free(cache);
+        if (*order != NULL)
+            coo_permute(*n, *nz, coo, *order);
+        return coo;
+    }
+
     MM_typecode matcode;
     if (mm_read_banner(f, &matcode) != 0) {
         fprintf(stderr, "Could not process Matrix Market banner\n");
         exit(1);
     }
-    if (!mm_is_matrix(matcode) || !mm_is_sparse(matcode) || mm_is_complex(matcode) || !mm_is_symmetric(matcode)) {
+    // general (unsymmetric) matrices are for GMRES
+    if (!mm_is_matrix(matcode) || !mm_is_sparse(matcode) || mm_is_complex(matcode) || !(mm_is_symmetric(matcode) || mm_is_general(matcode))) {
         fprintf(stderr, "This application does not support the Market Market type: %s\n",
                 mm_typecode_to_str(matcode));
         exit(1);
@@ -48,31 +375,16 @@ matrix_coo* coo_load(const char *fname, int *n, int *nz)
         fprintf(stderr, "Matrix is not square\n");
         exit(1);
     }
-    matrix_coo *coo = ALLOC(matrix_coo, 2 * NZ);
-
-    int k = 0;
-    for (int l = 0; l < NZ; l++) {
-        double real;
-        if (mm_read_mtx_crd_entry(f, &coo[k].i, &coo[k].j, &real, NULL, matcode) != 0) {
-            fprintf(stderr, "Error reading matrix element %i\n", l);
-            exit(1);
-        }
-        coo[k].i--;
-        coo[k].j--;
-        coo[k].a = real;
-        if (coo[k].i == coo[k].j) k++;
-        else {
-            coo[k + 1].i = coo[k].j;
-            coo[k + 1].j = coo[k].i;
-            coo[k + 1].a = coo[k].a;
-            k += 2;
-        }
-    }
+    long data = ftell(f);
     fclose(f);
-    qsort(coo, k, sizeof(matrix_coo), compar);
-    *n = N; *nz = k;
 
-    coo->useTail = false;
+    coo = coo_parse(fname, matcode, data, N, NZ, nz);
+    *n = N;
+    *order = ordering != ORDER_NONE ? coo_make_order(*n, *nz, coo, ordering) : NULL;
+    coo_to_cache(cache, &src, *n, *nz, coo, ordering, *order);
+    free(cache);
+    if (*order != NULL)
+        coo_permute(*n, *nz, coo, *order);
 
     return coo;
 }
@@ -109,260 +421,262 @@ double coo_max_nz(int n, int nz, matrix_coo *coo)
 }
 
 // CSR matrix
-void csr_dmult_heads(matrix_csr *mat, DOUBLE *x, DOUBLE *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        DOUBLE t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A->heads[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-}
-
-void csr_dmult_full(matrix_csr *mat, DOUBLE *x, DOUBLE *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        DOUBLE t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A->full[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-}
-
-/* void csr_dmult(matrix_csr *mat, DOUBLE *x, DOUBLE *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        DOUBLE t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-} */
-
-void csr_smult_heads(matrix_csr *mat, FLOAT *x, FLOAT *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        FLOAT2 t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A->heads[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-}
-
-void csr_smult_full(matrix_csr *mat, FLOAT *x, FLOAT *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        FLOAT2 t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A->full[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-}
-
-/* void csr_smult(matrix_csr *mat, FLOAT *x, FLOAT *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int k = 0; k < mat->n; k++) {
-        FLOAT2 t = 0.0;
-        for (int l = mat->i[k]; l < mat->i[k + 1]; l++)
-            t += mat->A[l] * x[mat->j[l]];
-        y[k] = t;
-    }
-} */
-
-inline void csr_precision_increase(matrix_csr *mat)
-{
-    // mat->A->del_segments();
-    mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))csr_dmult_full;
-    mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))csr_smult_full;
-}
-
-inline void csr_precision_reduce(matrix_csr *mat)
-{
-    // mat->A->del_segments();
-    mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))csr_dmult_heads;
-    mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))csr_smult_heads;
-}
-
-matrix *csr_create(int n, int nz, matrix_coo *coo)
+matrix_csr *csr_create(int n, int nz, matrix_coo *coo)
 {
     int *i = ALLOC(int, n + 1);
     int *j = ALLOC(int, nz);
     // DOUBLE *A = ALLOC(DOUBLE, nz);
-    ManSegArray *A = new ManSegArray(nz);
-    A->full = new double[nz];
+    ManSegArray *A = new ManSegArray(nz); // full is made at the precision switch
+    // the values are split into the planes a chunk at a time, in the order they are taken
+    SegmentWriter values(A->pairs);
 
     i[0] = 0;
     int l = 0;
     for (int k = 0; k < n; k++) {
         while (l < nz && coo[l].i == k) {
             j[l] = coo[l].j;
-            A->pairs[l] = coo[l].a;
-			A->full[l] = coo[l].a;
+            values.push(coo[l].a);
 			// A[l] = coo[l].a;
             l++;
         }
         i[k + 1] = l;
     }
+    values.close();
 
     matrix_csr *mat = new matrix_csr();
     mat->n = n;
     mat->i = i;
     mat->j = j;
     mat->A = A;
-    mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))csr_dmult_heads;
-    mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))csr_smult_heads;
 	mat->useTail = false;
-    
-	// mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))csr_dmult_full;
-    // mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))csr_smult_full;
-    // mat->useTail = true;
 
-	// mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))csr_dmult;
-    // mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))csr_smult;
-    mat->precision_increase = (void (*)(matrix *))csr_precision_increase;
-	mat->precision_reduce = (void (*)(matrix *))csr_precision_reduce;
-
-    return (matrix *)mat;
+    return mat;
 }
 
-// dense matrix
-void dense_dmult_heads(matrix_dense *mat, DOUBLE *x, DOUBLE *y)
+// CSR streamed from disk: the entries are written to the file in the layout of the cache, and only
+// the row offsets are read back
+matrix_stream *stream_create(int n, int nz, matrix_coo *coo)
 {
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        DOUBLE t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A->heads[i * mat->n + j] * x[j];
-        y[i] = t;
-    }
-}
-
-void dense_dmult_full(matrix_dense *mat, DOUBLE *x, DOUBLE *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        DOUBLE t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A->full[i * mat->n + j] * x[j];
-        y[i] = t;
+    const char *path = getenv("MANSEG_STREAM_FILE") != NULL ? getenv("MANSEG_STREAM_FILE") : "matrix.stream";
+    struct stat none;
+    memset(&none, 0, sizeof(none));
+    int fd = -1;
+    if (coo_write(path, &none, n, nz, coo, ORDER_NONE, NULL))
+        fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error writing the streamed matrix: %s\n", path);
+        exit(1);
     }
-}
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-/* void dense_dmult(matrix_dense *mat, DOUBLE *x, DOUBLE *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        DOUBLE t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A[i * mat->n + j] * x[j];
-        y[i] = t;
+    matrix_stream *mat = new matrix_stream();
+    size_t j_at, heads_at, tails_at, order_at;
+    cache_bytes(n, nz, ORDER_NONE, &j_at, &heads_at, &tails_at, &order_at);
+    mat->n = n;
+    mat->useTail = false;
+    mat->fd = fd;
+    mat->j_at = j_at;
+    mat->heads_at = heads_at;
+    mat->tails_at = tails_at;
+    mat->i = CALLOC(int, n + 1);
+    for (int k = 0; k < nz; k++) mat->i[coo[k].i + 1]++;
+    for (int r = 0; r < n; r++) mat->i[r + 1] += mat->i[r];
+
+    // blocks of whole rows, of STREAM_BLOCK values or the first row past that
+    std::vector<int> first(1, 0);
+    int most = 0;
+    for (int r = 0; r < n; ) {
+        int end = r + 1;
+        while (end < n && mat->i[end + 1] - mat->i[first.back()] <= STREAM_BLOCK) end++;
+        most = std::max(most, mat->i[end] - mat->i[r]);
+        first.push_back(end);
+        r = end;
     }
-} */
-
-void dense_smult_heads(uint8_t m, matrix_dense *mat, FLOAT *x, FLOAT *y)
-{
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        FLOAT2 t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A->heads[i * mat->n + j] * x[j];
-        y[i] = t;
+    mat->blocks = (int)first.size() - 1;
+    mat->first = ALLOC(int, first.size());
+    memcpy(mat->first, first.data(), first.size() * sizeof(int));
+    for (int b = 0; b < 2; b++) {
+        mat->j[b] = ALLOC(int, std::max(most, 1));
+        mat->heads[b] = ALLOC(float, std::max(most, 1));
+        mat->tails[b] = ALLOC(float, std::max(most, 1));
     }
+    return mat;
 }
 
-void dense_smult_full(uint8_t m, matrix_dense *mat, FLOAT *x, FLOAT *y)
+// count bytes at offset at of fd, which has them
+static void stream_pread(int fd, void *to, size_t count, off_t at)
 {
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        FLOAT2 t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A->full[i * mat->n + j] * x[j];
-        y[i] = t;
+    char *p = (char*)to;
+    while (count > 0) {
+        ssize_t got = pread(fd, p, count, at);
+        if (got <= 0) {
+            fprintf(stderr, "Error reading the streamed matrix\n");
+            exit(1);
+        }
+        p += got;
+        at += got;
+        count -= got;
     }
 }
 
-/* void dense_smult(uint8_t m, matrix_dense *mat, FLOAT *x, FLOAT *y)
+void stream_read(const matrix_stream *mat, int b, int into, bool tails)
 {
-	#pragma omp parallel for \
-		shared(mat, x, y)
-    for (int i = 0; i < mat->n; i++) {
-        FLOAT2 t = 0.0;
-        for (int j = 0; j < mat->n; j++)
-            t += mat->A[i * mat->n + j] * x[j];
-        y[i] = t;
-    }
-} */
-
-inline void dense_precision_increase(matrix_dense *mat)
-{
-    // mat->A->del_segments();
-    mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))dense_dmult_full;
-    mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))dense_smult_full;
+    int from = mat->i[mat->first[b]], len = mat->i[mat->first[b + 1]] - from;
+    stream_pread(mat->fd, mat->j[into], len * sizeof(int), mat->j_at + (off_t)from * sizeof(int));
+    stream_pread(mat->fd, mat->heads[into], len * sizeof(float), mat->heads_at + (off_t)from * sizeof(float));
+    if (tails)
+        stream_pread(mat->fd, mat->tails[into], len * sizeof(float), mat->tails_at + (off_t)from * sizeof(float));
 }
 
-inline void dense_precision_reduce(matrix_dense *mat)
-{
-	// mat->A->del_segments();
-	mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))dense_dmult_heads;
-	mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))dense_smult_heads;
-}
-
-matrix *dense_create(int n, int nz, matrix_coo *coo)
+// dense matrix
+matrix_dense *dense_create(int n, int nz, matrix_coo *coo)
 {
     // DOUBLE *A = CALLOC(DOUBLE, n * n);
     ManSegArray *A = new ManSegArray(n*n);
-    A->full = new double[n*n];
 
     // row major format
+    for (int k = 0; k < n * n; k++) A->pairs[k] = 0.0;
     for (int k = 0; k < nz; k++) A->pairs[coo[k].i * n + coo[k].j] = coo[k].a;
     // for (int k = 0; k < nz; k++) A[coo[k].i * n + coo[k].j] = coo[k].a;
-    
-    // copy values across during creation
-    for(int k = 0; k < nz; k++) A->full[k] = A->pairs[k];
 
     matrix_dense *mat = new matrix_dense();
     mat->n = n;
-    mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))dense_dmult_heads;
-    mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))dense_smult_heads;
+    mat->A = A;
+    mat->useTail = false;
 
-	// mat->dmult = (void (*)(matrix *, DOUBLE *, DOUBLE *))dense_dmult;
-    // mat->smult = (void (*)(matrix *, FLOAT *, FLOAT *))dense_smult;
+    return mat;
+}
+
+// SELL-C-sigma matrix
+matrix_sell *sell_create(int n, int nz, matrix_coo *coo)
+{
+    // CSR offsets of the rows, as the entries are sorted by row
+    int *first = CALLOC(int, n + 1);
+    for (int k = 0; k < nz; k++) first[coo[k].i + 1]++;
+    for (int k = 0; k < n; k++) first[k + 1] += first[k];
+
+    // longest rows first within each window, so the rows of a chunk have similar lengths
+    int chunks = (n + SELL_C - 1) / SELL_C;
+    int *row = ALLOC(int, chunks * SELL_C);
+    for (int r = 0; r < chunks * SELL_C; r++) row[r] = r < n ? r : -1;
+    for (int w = 0; w < n; w += SELL_SIGMA)
+        std::stable_sort(row + w, row + std::min(n, w + SELL_SIGMA), [first](int a, int b) {
+            return first[a + 1] - first[a] > first[b + 1] - first[b];
+        });
+
+    int *start = ALLOC(int, chunks + 1);
+    start[0] = 0;
+    for (int k = 0; k < chunks; k++) {
+        int longest = 0;
+        for (int r = 0; r < SELL_C; r++)
+            if (row[k * SELL_C + r] >= 0)
+                longest = std::max(longest, first[row[k * SELL_C + r] + 1] - first[row[k * SELL_C + r]]);
+        start[k + 1] = start[k] + longest * SELL_C;
+    }
+
+    // the column indices of a chunk start on a cache line, as SELL_C is a multiple of 8 (or divides 16)
+    int *j = (int*)aligned_alloc(64, (start[chunks] * sizeof(int) + 64) / 64 * 64);
+    ManSegArray *A = new ManSegArray(start[chunks]);
+    for (int k = 0; k < chunks; k++) {
+        int longest = (start[k + 1] - start[k]) / SELL_C;
+        for (int r = 0; r < SELL_C; r++) {
+            int i = row[k * SELL_C + r];
+            int len = i >= 0 ? first[i + 1] - first[i] : 0;
+            for (int l = 0; l < longest; l++) {
+                int at = start[k] + l * SELL_C + r;
+                if (l < len) {
+                    j[at] = coo[first[i] + l].j;
+                    A->pairs[at] = coo[first[i] + l].a;
+                } else {
+                    // zero padding, at a column already gathered for this row
+                    j[at] = len > 0 ? coo[first[i] + len - 1].j : 0;
+                    A->pairs[at] = 0.0;
+                }
+            }
+        }
+    }
+    free(first);
+
+    matrix_sell *mat = new matrix_sell();
+    mat->n = n;
+    mat->chunks = chunks;
+    mat->start = start;
+    mat->row = row;
+    mat->j = j;
     mat->A = A;
-    mat->precision_increase = (void (*)(matrix *))dense_precision_increase;
-	mat->precision_reduce = (void (*)(matrix *))dense_precision_reduce;
     mat->useTail = false;
 
-    return (matrix *)mat;
+    return mat;
 }
 
-// Jacobi preconditioner
-void jacobi_smult(precond_jacobi *pre, FLOAT *x, FLOAT *y)
+// symmetric CSR matrix, of the upper triangle
+matrix_sym *sym_create(int n, int nz, matrix_coo *coo)
 {
-	#pragma omp parallel for \
-		shared(y, x, pre)
-    for (int k = 0; k < pre->n; k++) {
-       y[k] = x[k] / pre->d[k];
+    int *i = CALLOC(int, n + 1);
+    for (int k = 0; k < nz; k++)
+        if (coo[k].j >= coo[k].i) i[coo[k].i + 1]++;
+    for (int k = 0; k < n; k++) i[k + 1] += i[k];
+
+    int *j = ALLOC(int, i[n]);
+    ManSegArray *A = new ManSegArray(i[n]);
+    for (int k = 0, l = 0; k < nz; k++)
+        if (coo[k].j >= coo[k].i) {
+            j[l] = coo[k].j;
+            A->pairs[l++] = coo[k].a;
+        }
+
+    // a part per thread, of about equal numbers of entries
+    int parts = omp_get_max_threads();
+    int *first = ALLOC(int, parts + 1);
+    int *last = ALLOC(int, parts);
+    first[0] = 0;
+    for (int p = 1, k = 0; p < parts; p++) {
+        while (k < n && i[k] < (int64_t)i[n] * p / parts) k++;
+        first[p] = k;
     }
+    first[parts] = n;
+    double **acc = ALLOC(double*, parts);
+    for (int p = 0; p < parts; p++) {
+        last[p] = first[p + 1] - 1;
+        for (int k = first[p]; k < first[p + 1]; k++)
+            if (i[k + 1] > i[k]) last[p] = std::max(last[p], j[i[k + 1] - 1]);
+        // touched first by the thread of the part, in the product
+        acc[p] = ALLOC(double, std::max(last[p] - first[p] + 1, 1));
+    }
+
+    matrix_sym *mat = new matrix_sym();
+    mat->n = n;
+    mat->i = i;
+    mat->j = j;
+    mat->A = A;
+    mat->parts = parts;
+    mat->first = first;
+    mat->last = last;
+    mat->acc = acc;
+    mat->useTail = false;
+
+    return mat;
 }
 
-struct matrix *jacobi_create(int n, int nz, matrix_coo *coo)
+// matrix free 5 point stencil on an nx x ny grid
+matrix_operator *operator_create(int nx, int ny, double diag, double off)
+{
+    matrix_operator *op = new matrix_operator();
+    op->n = nx * ny;
+    op->nx = nx;
+    op->ny = ny;
+    op->diag = diag;
+    op->off = off;
+    op->apply = operator_stencil5;
+    op->useTail = false;
+
+    return op;
+}
+
+// Jacobi preconditioner
+precond_jacobi *jacobi_create(int n, int nz, matrix_coo *coo)
 {
     FLOAT *d = ALLOC(FLOAT, n);
     for (int k = 0; k < nz; k++)
@@ -373,9 +687,128 @@ struct matrix *jacobi_create(int n, int nz, matrix_coo *coo)
 
     precond_jacobi *pre = new precond_jacobi();
     pre->n = n;
-    pre->dmult = NULL;
-    pre->smult = (void (*)(matrix *, FLOAT *, FLOAT *))jacobi_smult;
     pre->d = d;
 
-    return (matrix *)pre;
+    return pre;
+}
+
+// Jacobi preconditioner of a stencil operator, whose diagonal is constant
+precond_jacobi *operator_jacobi_create(const matrix_operator *op)
+{
+    FLOAT *d = ALLOC(FLOAT, op->n);
+    for (int k = 0; k < op->n; k++)
+        d[k] = op->diag;
+
+    precond_jacobi *pre = new precond_jacobi();
+    pre->n = op->n;
+    pre->d = d;
+
+    return pre;
+}
+
+// buckets the rows by level: the rows of level l are rows[start[l]..start[l + 1]), in increasing order
+static int levels_sort(int n, const int *level, int **start, int **rows)
+{
+    int levels = 0;
+    for (int k = 0; k < n; k++) levels = std::max(levels, level[k] + 1);
+    *start = CALLOC(int, levels + 1);
+    for (int k = 0; k < n; k++) (*start)[level[k] + 1]++;
+    for (int l = 0; l < levels; l++) (*start)[l + 1] += (*start)[l];
+    int *at = ALLOC(int, levels);
+    memcpy(at, *start, levels * sizeof(int));
+    *rows = ALLOC(int, n);
+    for (int k = 0; k < n; k++) (*rows)[at[level[k]]++] = k;
+    free(at);
+    return levels;
+}
+
+// ILU(0) of the entries of A within the diagonal blocks of block rows (n for all of A)
+static precond_ilu *ilu_create(int n, int nz, matrix_coo *coo, int block)
+{
+    int *i = CALLOC(int, n + 1);
+    for (int k = 0; k < nz; k++)
+        if (coo[k].i / block == coo[k].j / block) i[coo[k].i + 1]++;
+    for (int k = 0; k < n; k++) i[k + 1] += i[k];
+
+    // the entries are sorted by row and column, and so are the rows of the factors
+    int *j = ALLOC(int, i[n]);
+    double *a = ALLOC(double, i[n]);
+    int *diag = ALLOC(int, n);
+    for (int k = 0; k < n; k++) diag[k] = -1;
+    for (int k = 0, l = 0; k < nz; k++)
+        if (coo[k].i / block == coo[k].j / block) {
+            if (coo[k].i == coo[k].j) diag[coo[k].i] = l;
+            j[l] = coo[k].j;
+            a[l++] = coo[k].a;
+        }
+
+    // factor in place, row by row (IKJ): a row is reduced by the U rows of its columns left of the diagonal
+    int *pos = ALLOC(int, n);
+    for (int k = 0; k < n; k++) pos[k] = -1;
+    for (int r = 0; r < n; r++) {
+        if (diag[r] < 0) {
+            fprintf(stderr, "ILU(0): no diagonal entry in row %d\n", r);
+            exit(1);
+        }
+        for (int l = i[r]; l < i[r + 1]; l++) pos[j[l]] = l;
+        for (int l = i[r]; l < diag[r]; l++) {
+            int k = j[l];
+            a[l] /= a[diag[k]];
+            for (int m = diag[k] + 1; m < i[k + 1]; m++)
+                if (pos[j[m]] >= 0) a[pos[j[m]]] -= a[l] * a[m];
+        }
+        for (int l = i[r]; l < i[r + 1]; l++) pos[j[l]] = -1;
+        if (a[diag[r]] == 0.0) {
+            fprintf(stderr, "ILU(0): zero pivot in row %d\n", r);
+            exit(1);
+        }
+    }
+    free(pos);
+
+    BasicManSegArray<LazySegmentAllocator> *LU = new BasicManSegArray<LazySegmentAllocator>(i[n]);
+    for (int r = 0; r < n; r++)
+        for (int l = i[r]; l < i[r + 1]; l++)
+            LU->heads.set(l, l == diag[r] ? 1.0 / a[l] : a[l]);
+    free(a);
+
+    precond_ilu *pre = new precond_ilu();
+    pre->levels = pre->ulevels = 0;
+    if (block >= n) {
+        // the level of a row is one past the highest level of the rows it reads: left of the diagonal
+        // going forward, right of it going back
+        int *level = ALLOC(int, n);
+        for (int r = 0; r < n; r++) {
+            level[r] = 0;
+            for (int l = i[r]; l < diag[r]; l++) level[r] = std::max(level[r], level[j[l]] + 1);
+        }
+        pre->levels = levels_sort(n, level, &pre->lstart, &pre->lrows);
+        for (int r = n - 1; r >= 0; r--) {
+            level[r] = 0;
+            for (int l = diag[r] + 1; l < i[r + 1]; l++) level[r] = std::max(level[r], level[j[l]] + 1);
+        }
+        pre->ulevels = levels_sort(n, level, &pre->ustart, &pre->urows);
+        free(level);
+    }
+
+    pre->n = n;
+    pre->block = std::min(block, n);
+    pre->i = i;
+    pre->j = j;
+    pre->diag = diag;
+    pre->LU = LU;
+    pre->t = ALLOC(double, n);
+
+    return pre;
+}
+
+// ILU(0) preconditioner
+precond_ilu *ilu0_create(int n, int nz, matrix_coo *coo)
+{
+    return ilu_create(n, nz, coo, n);
+}
+
+// block Jacobi preconditioner, with ILU(0) of each block
+precond_ilu *block_jacobi_create(int n, int nz, matrix_coo *coo)
+{
+    return ilu_create(n, nz, coo, PRECOND_BLOCK);
 }
@@ -1,23 +1,61 @@
 #ifndef __cg_MATRIX_H__
 #define __cg_MATRIX_H__
 
+#include <unistd.h>
+#include <future>
+
 using namespace ManSeg;
 
-// definitions for matrices
-class matrix
-{
-public:
-    int n;
-    bool useTail;
-    
-    void (*dmult)(matrix *, DOUBLE *, DOUBLE *);
-    void (*smult)(matrix *, FLOAT *, FLOAT *);
+// define (in every file) to store the matrix densely, in CSR, or as the upper triangle in CSR, or not
+// at all (a stencil operator, see matrix_operator), or on disk (CSR streamed a block of rows at a time,
+// see matrix_stream), rather than in SELL-C-sigma
+// #define USE_DENSE
+// #define USE_CSR
+// #define USE_SYM
+// #define USE_OPERATOR
+// #define USE_STREAM
 
-    void (*precision_increase)(matrix *);
-	void (*precision_reduce)(matrix *);
-};
+// define (in every file) to renumber the unknowns when the matrix is loaded, by reverse Cuthill-McKee or
+// by nested dissection (see ordering.cpp), rather than keep the numbering of the file
+// #define USE_RCM
+// #define USE_ND
+
+// define (in every file) to precondition with ILU(0), or block Jacobi, rather than with the diagonal
+// #define USE_ILU0
+// #define USE_BLOCK_JACOBI
+
+// rows of a block of the block Jacobi preconditioner; on a 2D grid numbered row by row a block
+// should span several grid rows
+#define PRECOND_BLOCK 1024
 
-class matrix_coo : public matrix
+// number of values of a row widened/gathered at a time by the products
+#define ROW_CHUNK 64
+
+// rows of a dense matrix multiplied together, sharing the blocks of x
+#define DENSE_ROWS 4
+
+// values of a block of rows of a streamed matrix (a block holds at least one row)
+#define STREAM_BLOCK (1 << 20)
+
+/*
+    Level the values are read at after the precision switch. By default it is the full doubles, which
+    are only made (from the pairs) at the first switch, so the matrix takes 8 bytes per value until
+    then and 16 after. With USE_PAIRS the pairs are read in place and full is never made, for
+    matrices where the extra 8 bytes per value do not fit.
+*/
+#ifdef USE_PAIRS
+#define ACCESS_SWITCHED ACCESS_PAIRS
+#else
+#define ACCESS_SWITCHED ACCESS_FULL
+#endif
+
+// SELL-C-sigma parameters: rows per chunk, and the window of rows sorted by length
+#define SELL_C 8
+#define SELL_SIGMA 256
+
+// definitions for matrices
+// The storage formats only hold the values; the products are in Matrix (below).
+class matrix_coo
 {
 public:
     int i, j;
@@ -25,55 +63,679 @@ public:
     // ManSegArray *a;
 };
 
-class matrix_csr : public matrix
+class matrix_csr
 {
 public:
     int n;
+    bool useTail;   // the solve has switched to full precision
     int *i, *j;
     // double *A;
     ManSegArray *A;
 };
 
-class matrix_dense : public matrix
+class matrix_dense
 {
 public:
     int n;
+    bool useTail;
     // double *A;
     ManSegArray *A;
 };
 
-class precond_jacobi : public matrix
+/*
+    Sliced ELLPACK (SELL-C-sigma): the rows are sorted by length within windows of SELL_SIGMA rows, and
+    cut into chunks of SELL_C rows, each padded to its longest row with zeros. A chunk is stored column
+    by column, so entry l of its rows r = 0..SELL_C-1 are SELL_C consecutive values (and column
+    indices), and a product does SELL_C rows at once without the row-length branches of CSR.
+*/
+class matrix_sell
+{
+public:
+    int n;
+    bool useTail;
+    int chunks;
+    int *start;     // chunk k is values [start[k], start[k + 1]), a multiple of SELL_C
+    int *row;       // row[k * SELL_C + r] is the row stored as row r of chunk k, or -1 past the last row
+    int *j;         // column indices, in the order of the values (padding repeats a column of the row)
+    ManSegArray *A;
+};
+
+/*
+    Symmetric CSR: only the upper triangle (with the diagonal), so each off diagonal value is stored
+    and read once, for both of its entries. Entry (k, c) of row k adds a x_c to y_k and a x_k to y_c,
+    so a row's result is no longer made by the row alone: the rows are split into parts of about equal
+    numbers of entries, each summed by one thread into its own accumulator, which spans the rows the
+    part writes (its own rows, and on to the last column they reach). The accumulators covering a row
+    are then added up for it.
+*/
+class matrix_sym
+{
+public:
+    int n;
+    bool useTail;
+    int *i, *j;     // CSR of the upper triangle
+    ManSegArray *A;
+    int parts;
+    int *first;     // part p is rows [first[p], first[p + 1])
+    int *last;      // and writes rows [first[p], last[p]]
+    double **acc;   // acc[p][k - first[p]] is part p's sum for row k
+};
+
+/*
+    A matrix free operator: the matrix of a stencil on an nx x ny grid numbered row by row, applied by
+    a callback rather than stored, so only the (segmented) vectors are in memory. A product widens
+    three grid rows of x at a time, each padded with a zero ghost value at either end, and the
+    callback makes a row of y from them:
+        apply(op, up, row, down, nx, y)    // y[j] from row[j + 1], its neighbours row[j], row[j + 2],
+                                           // up[j + 1] and down[j + 1]
+    The rows outside the grid are zeros (Dirichlet boundaries). operator_create's callback is the
+    constant coefficient 5 point stencil, y = diag x + off (sum of the 4 neighbours), through the
+    5 point sum of the Jacobi stencil kernel (manseglib_stencil.hpp).
+    There are no values to promote: useTail only marks the phase, for the vectors.
+*/
+class matrix_operator
+{
+public:
+    int n;
+    bool useTail;
+    int nx, ny;
+    double diag, off;   // of the 5 point stencil
+    void (*apply)(const matrix_operator *op, const double *up, const double *row, const double *down, int nx, double *y);
+};
+
+/*
+    CSR on disk, for matrices larger than memory: only the row offsets are kept in memory. The file
+    ($MANSEG_STREAM_FILE, by default matrix.stream in the working directory) has the layout of the
+    .mtx.bin cache (see matrix.cpp), the column indices followed by the heads plane and the tails
+    plane of the values. A product reads the rows a block at a time into one of two buffers, while the
+    block before is multiplied from the other: the column indices and heads of the block, and its
+    tails as well once the solve has switched. So the inner solves of iterative refinement, which are
+    at the heads, read 8 bytes a value from the file rather than 12.
+*/
+class matrix_stream
+{
+public:
+    int n;
+    bool useTail;
+    int *i;             // row offsets
+    int blocks;
+    int *first;         // block b is rows [first[b], first[b + 1])
+    int fd;
+    off_t j_at, heads_at, tails_at;
+    // the two buffers, each of the most values of a block
+    int *j[2];
+    float *heads[2], *tails[2];
+};
+
+#if defined(USE_DENSE)
+typedef matrix_dense matrix_format;
+#elif defined(USE_CSR)
+typedef matrix_csr matrix_format;
+#elif defined(USE_SYM)
+typedef matrix_sym matrix_format;
+#elif defined(USE_STREAM)
+typedef matrix_stream matrix_format;
+#elif defined(USE_OPERATOR)
+typedef matrix_operator matrix_format;
+#if defined(USE_ILU0) || defined(USE_BLOCK_JACOBI)
+#error "ILU(0) and block Jacobi need the entries of the matrix: precondition a matrix_operator with its diagonal"
+#endif
+#else
+typedef matrix_sell matrix_format;
+#endif
+
+// row k of Ax: the values of a row are contiguous, and x is gathered alongside them
+template<class Values, class In>
+static inline DOUBLE csr_row(const matrix_csr *mat, const Values &values, const In &x, int k)
+{
+    double a[ROW_CHUNK], b[ROW_CHUNK];
+    DOUBLE t = 0.0;
+    for (int l = mat->i[k]; l < mat->i[k + 1]; l += ROW_CHUNK) {
+        int len = std::min(ROW_CHUNK, mat->i[k + 1] - l);
+        values.readBlock(l, len, a);
+        gather(x, mat->j + l, len, b);
+        for (int m = 0; m < len; m++)
+            t += a[m] * b[m];
+    }
+    return t;
+}
+
+// at the heads of both, the values and the gathered x are widened in registers rather than into
+// a and b; dotGatherHeads takes rows shorter than a vector a value at a time
+template<class VA, class XA>
+static inline DOUBLE csr_row(const matrix_csr *mat, const TwoSegArray<false, VA> &values, const TwoSegArray<false, XA> &x, int k)
+{
+    int l = mat->i[k];
+    return dotGatherHeads(values.getHeads() + l, mat->j + l, x.getHeads(), mat->i[k + 1] - l);
+}
+
+// y = Ax, reading the values of A at precision
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_csr *mat, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+	#pragma omp parallel for \
+		shared(mat, values, x, y)
+    for (int k = 0; k < mat->n; k++)
+        y.set(k, csr_row(mat, values, x, k));
+}
+
+// reads block b of a streamed matrix into its buffer number into: the column indices and heads, and the tails
+// if tails
+extern void stream_read(const matrix_stream *mat, int b, int into, bool tails);
+
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_stream *mat, In x, Out y)
+{
+    const bool tails = precision != ACCESS_HEADS;
+    std::future<void> next;
+    if (mat->blocks > 0)
+        next = std::async(std::launch::async, stream_read, mat, 0, 0, tails);
+    for (int b = 0; b < mat->blocks; b++) {
+        next.get();
+        if (b + 1 < mat->blocks)
+            next = std::async(std::launch::async, stream_read, mat, b + 1, (b + 1) % 2, tails);
+        // the buffers hold the block's values from the first of its first row
+        const int base = mat->i[mat->first[b]];
+        const int *j = mat->j[b % 2] - base;
+        const float *heads = mat->heads[b % 2] - base, *tail = mat->tails[b % 2] - base;
+	    #pragma omp parallel for \
+		    shared(mat, j, heads, tail, x, y)
+        for (int k = mat->first[b]; k < mat->first[b + 1]; k++) {
+            double a[ROW_CHUNK], c[ROW_CHUNK];
+            DOUBLE t = 0.0;
+            for (int l = mat->i[k]; l < mat->i[k + 1]; l += ROW_CHUNK) {
+                int len = std::min(ROW_CHUNK, mat->i[k + 1] - l);
+                if (tails)
+                    combineSegments(heads + l, tail + l, len, a);
+                else
+                    widenHeads(heads + l, len, a);
+                gather(x, j + l, len, c);
+                for (int m = 0; m < len; m++)
+                    t += a[m] * c[m];
+            }
+            y.set(k, t);
+        }
+    }
+}
+
+/*
+    DENSE_ROWS rows of the dense product abreast: each block of x serves all of them, and their sums
+    are independent, so the additions overlap rather than each waiting on the last. Each row is still
+    summed in column order, as CSR and SELL sum it, so the result is the same. The threads take
+    contiguous runs of these row groups.
+*/
+template<int ROWS>
+static inline void dense_rows(const double (*a)[ROW_CHUNK], const double *x, int len, DOUBLE *t) {
+    for (int m = 0; m < len; m++)
+        for (int r = 0; r < ROWS; r++)
+            t[r] += a[r][m] * x[m];
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_dense *mat, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+    const int n = mat->n;
+    // x is used by every row, so it is read once
+    std::vector<double> xd(n);
+    x.readBlock(0, n, xd.data());
+	#pragma omp parallel for schedule(static) \
+		shared(mat, values, xd, y)
+    for (int i = 0; i < n; i += DENSE_ROWS) {
+        const int rows = std::min(DENSE_ROWS, n - i);
+        double a[DENSE_ROWS][ROW_CHUNK];
+        DOUBLE t[DENSE_ROWS] = { 0.0 };
+        for (int j = 0; j < n; j += ROW_CHUNK) {
+            int len = std::min(ROW_CHUNK, n - j);
+            for (int r = 0; r < rows; r++)
+                values.readBlock((size_t)(i + r) * n + j, len, a[r]);
+            if (rows == DENSE_ROWS)
+                dense_rows<DENSE_ROWS>(a, xd.data() + j, len, t);
+            else
+                for (int r = 0; r < rows; r++)
+                    dense_rows<1>(a + r, xd.data() + j, len, t + r);
+        }
+        for (int r = 0; r < rows; r++)
+            y.set(i + r, t[r]);
+    }
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_sell *mat, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+	#pragma omp parallel for \
+		shared(mat, values, x, y)
+    for (int k = 0; k < mat->chunks; k++) {
+        double a[ROW_CHUNK * SELL_C], b[ROW_CHUNK * SELL_C];
+        DOUBLE t[SELL_C] = { 0.0 };
+        // whole columns of the chunk are widened and gathered at a time, and summed SELL_C rows abreast
+        for (int l = mat->start[k]; l < mat->start[k + 1]; l += ROW_CHUNK * SELL_C) {
+            int len = std::min(ROW_CHUNK * SELL_C, mat->start[k + 1] - l);
+            values.readBlock(l, len, a);
+            gather(x, mat->j + l, len, b);
+            for (int m = 0; m < len; m += SELL_C)
+                for (int r = 0; r < SELL_C; r++)
+                    t[r] += a[m + r] * b[m + r];
+        }
+        for (int r = 0; r < SELL_C; r++)
+            if (mat->row[k * SELL_C + r] >= 0)
+                y.set(mat->row[k * SELL_C + r], t[r]);
+    }
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_sym *mat, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+	#pragma omp parallel \
+		shared(mat, values, x, y)
+    {
+        #pragma omp for schedule(static)
+        for (int p = 0; p < mat->parts; p++) {
+            int r0 = mat->first[p];
+            double *acc = mat->acc[p];
+            memset(acc, 0, (mat->last[p] - r0 + 1) * sizeof(double));
+            double a[ROW_CHUNK], b[ROW_CHUNK], xk[ROW_CHUNK];
+            // x of the rows themselves is read a block of rows at a time, and of the columns gathered
+            for (int k0 = r0; k0 < mat->first[p + 1]; k0 += ROW_CHUNK) {
+                int rows = std::min(ROW_CHUNK, mat->first[p + 1] - k0);
+                x.readBlock(k0, rows, xk);
+                for (int k = k0; k < k0 + rows; k++) {
+                    DOUBLE t = 0.0;
+                    for (int l = mat->i[k]; l < mat->i[k + 1]; l += ROW_CHUNK) {
+                        int len = std::min(ROW_CHUNK, mat->i[k + 1] - l);
+                        values.readBlock(l, len, a);
+                        gather(x, mat->j + l, len, b);
+                        for (int m = 0; m < len; m++) {
+                            t += a[m] * b[m];
+                            if (mat->j[l + m] != k)
+                                acc[mat->j[l + m] - r0] += a[m] * xk[k - k0];
+                        }
+                    }
+                    acc[k - r0] += t;
+                }
+            }
+        }
+        // every accumulator of a part before p that reaches row k has a share of it
+        #pragma omp for schedule(static)
+        for (int p = 0; p < mat->parts; p++) {
+            for (int k = mat->first[p]; k < mat->first[p + 1]; k++) {
+                DOUBLE t = 0.0;
+                for (int q = 0; q <= p; q++)
+                    if (k <= mat->last[q])
+                        t += mat->acc[q][k - mat->first[q]];
+                y.set(k, t);
+            }
+        }
+    }
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmv(const matrix_operator *op, In x, Out y)
+{
+    int nx = op->nx, ny = op->ny;
+	#pragma omp parallel \
+		shared(op, x, y)
+    {
+        // the rows above, at and below the one made, each with its ghosts
+        std::vector<double> rows(3 * (nx + 2), 0.0), out(nx);
+        double *up = &rows[0], *row = &rows[nx + 2], *down = &rows[2 * (nx + 2)];
+        auto load = [&](int r, double *to) {
+            if (r < 0 || r >= ny)
+                std::fill(to + 1, to + nx + 1, 0.0);
+            else
+                x.readBlock((int64_t)r * nx, nx, to + 1);
+        };
+        int last = -2;
+        #pragma omp for schedule(static)
+        for (int r = 0; r < ny; r++) {
+            // consecutive rows of a thread share two of their three rows
+            if (r == last + 1) {
+                std::swap(up, row);
+                std::swap(row, down);
+                load(r + 1, down);
+            }
+            else {
+                load(r - 1, up);
+                load(r, row);
+                load(r + 1, down);
+            }
+            last = r;
+            op->apply(op, up, row, down, nx, out.data());
+            y.writeBlock((int64_t)r * nx, nx, out.data());
+        }
+    }
+}
+
+// y = diag x + off (x_west + x_east + x_north + x_south) for a row of the grid: off times the 5 point
+// sum (with x itself), and (diag - off) x
+static inline void operator_stencil5(const matrix_operator *op, const double *up, const double *row, const double *down,
+    int nx, double *y)
+{
+    stencilRow(up, row, down, nx, op->off, y);
+    for (int j = 0; j < nx; j++)
+        y[j] += (op->diag - op->off) * row[j + 1];
+}
+
+/*
+    Y = AX for a block of k vectors stored interleaved (value i of vector q at i*k + q, as in vector.h):
+    each value of A is read once and used for all k products, so the matrix is streamed once per block
+    rather than once per vector. A column's k values of X are contiguous, so they are loaded as a run
+    rather than gathered one by one. The products are summed SPMM_GROUP vectors at a time, with the
+    group's width known at compile time so that its sums stay in registers; a chunk's values are read
+    from A once, and again from L1 by its later groups.
+*/
+#define SPMM_GROUP 4
+
+// b = x[c, c + K), for any view
+template<int K, class In>
+static inline void spmm_load(const In &x, int c, double *b) {
+    for (int q = 0; q < K; q++) b[q] = const_cast<In &>(x).read(c + q);
+}
+
+// the heads are widened in place, with no dispatch per run
+template<int K, class Allocator>
+static inline void spmm_load(const TwoSegArray<false, Allocator> &x, int c, double *b) {
+    const float *heads = x.getHeads() + c;
+    for (int q = 0; q < K; q++) b[q] = headToDouble(heads[q]);
+}
+
+template<int K>
+static inline void spmm_load(const FullView &x, int c, double *b) {
+    const double *full = x.getFull() + c;
+    for (int q = 0; q < K; q++) b[q] = full[q];
+}
+
+// t[r][q] += a[m] * x[j[m]*k + g + q], for the entries m of rows r = m % ROWS of a chunk, and q < K
+template<int ROWS, int K, class In>
+static inline void spmm_group(const int *j, const double *a, int len, int k, int g, const In &x, DOUBLE (*t)[SPMM_GROUP]) {
+    double b[K];
+    for (int m = 0; m < len; m += ROWS)
+        for (int r = 0; r < ROWS; r++) {
+            spmm_load<K>(x, j[m + r] * k + g, b);
+            for (int q = 0; q < K; q++)
+                t[r][q] += a[m + r] * b[q];
+        }
+}
+
+// every group of a chunk of values, with t[g / SPMM_GROUP * ROWS + r] the sums of group g
+template<int ROWS, class In>
+static inline void spmm_chunk(const int *j, const double *a, int len, int k, const In &x, DOUBLE (*t)[SPMM_GROUP]) {
+    for (int g = 0; g < k; g += SPMM_GROUP) {
+        DOUBLE (*tg)[SPMM_GROUP] = t + g / SPMM_GROUP * ROWS;
+        switch (std::min(SPMM_GROUP, k - g)) {
+        case 1: spmm_group<ROWS, 1>(j, a, len, k, g, x, tg); break;
+        case 2: spmm_group<ROWS, 2>(j, a, len, k, g, x, tg); break;
+        case 3: spmm_group<ROWS, 3>(j, a, len, k, g, x, tg); break;
+        default: spmm_group<ROWS, SPMM_GROUP>(j, a, len, k, g, x, tg); break;
+        }
+    }
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmm(const matrix_csr *mat, int k, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+	#pragma omp parallel for \
+		shared(mat, values, x, y)
+    for (int i = 0; i < mat->n; i++) {
+        double a[ROW_CHUNK];
+        DOUBLE t[MAX_RHS / SPMM_GROUP][SPMM_GROUP] = { { 0.0 } };
+        for (int l = mat->i[i]; l < mat->i[i + 1]; l += ROW_CHUNK) {
+            int len = std::min(ROW_CHUNK, mat->i[i + 1] - l);
+            values.readBlock(l, len, a);
+            spmm_chunk<1>(mat->j + l, a, len, k, x, t);
+        }
+        for (int q = 0; q < k; q++)
+            y.set(i * k + q, t[q / SPMM_GROUP][q % SPMM_GROUP]);
+    }
+}
+
+template<AccessLevel precision, class In, class Out>
+inline void spmm(const matrix_sell *mat, int k, In x, Out y)
+{
+    typename LevelView<precision>::type values = LevelView<precision>::of(*mat->A);
+	#pragma omp parallel for \
+		shared(mat, values, x, y)
+    for (int c = 0; c < mat->chunks; c++) {
+        double a[ROW_CHUNK];
+        DOUBLE t[MAX_RHS / SPMM_GROUP * SELL_C][SPMM_GROUP];
+        for (int e = 0; e < (k + SPMM_GROUP - 1) / SPMM_GROUP * SELL_C; e++)
+            for (int q = 0; q < SPMM_GROUP; q++) t[e][q] = 0.0;
+        for (int l = mat->start[c]; l < mat->start[c + 1]; l += ROW_CHUNK) {
+            int len = std::min(ROW_CHUNK, mat->start[c + 1] - l);
+            values.readBlock(l, len, a);
+            spmm_chunk<SELL_C>(mat->j + l, a, len, k, x, t);
+        }
+        for (int r = 0; r < SELL_C; r++)
+            if (mat->row[c * SELL_C + r] >= 0)
+                for (int q = 0; q < k; q++)
+                    y.set(mat->row[c * SELL_C + r] * k + q, t[q / SPMM_GROUP * SELL_C + r][q % SPMM_GROUP]);
+    }
+}
+
+// the other formats make the products one vector at a time
+template<AccessLevel precision, class Format, class In, class Out>
+inline void spmm(const Format *mat, int k, In x, Out y)
+{
+    std::vector<double> xs(mat->n), ys(mat->n);
+    for (int q = 0; q < k; q++) {
+        for (int i = 0; i < mat->n; i++)
+            xs[i] = x.read(i * k + q);
+        spmv<precision>(mat, FullView(xs.data(), mat->n), FullView(ys.data(), mat->n));
+        for (int i = 0; i < mat->n; i++)
+            y.set(i * k + q, ys[i]);
+    }
+}
+
+/*
+    A matrix stored in Format, with its values read at precision (ACCESS_HEADS, or ACCESS_SWITCHED
+    once the solve has switched). It is a view of the storage, so the two precisions of one matrix
+    are two Matrix types, and mult is instantiated for each precision and each pair of vector views
+    it is called with (heads or pairs of ManSegArrays, or FullViews of DOUBLE arrays):
+        Matrix<matrix_csr, ACCESS_HEADS>(A).mult(p.heads, z.heads);
+    A solve picks the precision once per phase, so no product goes through a function pointer.
+*/
+template<class Format, AccessLevel precision>
+class Matrix
+{
+public:
+    Format *f;
+
+    explicit Matrix(Format *f) :f(f) {}
+
+    // y = Ax
+    template<class In, class Out>
+    void mult(In x, Out y) const { spmv<precision>(f, x, y); }
+
+    // Y = AX, for k vectors stored interleaved
+    template<class In, class Out>
+    void mult(int k, In x, Out y) const { spmm<precision>(f, k, x, y); }
+};
+
+/*
+    Preconditioners: mult(x, y) makes y = M^-1 x, for any pair of views like Matrix::mult. diagonal()
+    is M's diagonal if M is just that, for the CG kernels which divide by it in their own passes, and
+    NULL otherwise.
+*/
+
+// Jacobi preconditioner
+class precond_jacobi
 {
 public:
     int n;
     FLOAT *d;
+
+    const FLOAT *diagonal() const { return d; }
+
+    // y = x ./ d
+    template<class In, class Out>
+    void mult(In x, Out y) const {
+	    #pragma omp parallel for \
+		    shared(y, x)
+        for (int k = 0; k < n; k++) {
+           y.set(k, x.read(k) / d[k]);
+        }
+    }
+};
+
+/*
+    Incomplete LU factorisation with no fill in, ILU(0): unit lower L and U in the pattern of A, row by
+    row as in CSR, with U's diagonal stored inverted. A preconditioner needs little accuracy, so the
+    factors are kept in heads only: their tails (from a LazySegmentAllocator) are never touched, so
+    never made resident, and the factors take 4 bytes per value.
+    Block Jacobi is the same, made after dropping the entries coupling different blocks of block rows:
+    the blocks are solved in parallel, each a row at a time. For ILU(0) of the whole matrix (block = n)
+    with more than one thread the triangular solves are level scheduled: the level of a row is one
+    more than the highest level of the rows it depends on, so the rows of a level are solved in
+    parallel, a level at a time. A level's rows are scattered through the vectors, so on one thread
+    the rows are solved in order instead.
+*/
+class precond_ilu
+{
+public:
+    int n, block;
+    int *i, *j;                     // CSR pattern of the factors
+    int *diag;                      // diag[k] is the position of U's diagonal in row k
+    BasicManSegArray<LazySegmentAllocator> *LU;
+    int levels, *lstart, *lrows;    // the rows of level l of the forward solve are lrows[lstart[l]..lstart[l + 1])
+    int ulevels, *ustart, *urows;   // and of the backward solve (none for block Jacobi)
+    double *t;                      // the intermediate vector of a solve
+
+    const FLOAT *diagonal() const { return NULL; }
+
+    // y = U^-1 L^-1 x
+    template<class In, class Out>
+    void mult(In x, Out y) const {
+        x.readBlock(0, n, t);
+        if (block < n) {
+            #pragma omp parallel for
+            for (int b = 0; b < n; b += block)
+                solve_rows(b, std::min(n, b + block));
+        }
+        else if (omp_get_max_threads() == 1) {
+            solve_rows(0, n);
+        }
+        else {
+            for (int l = 0; l < levels; l++) {
+                #pragma omp parallel for if(lstart[l + 1] - lstart[l] > ROW_CHUNK)
+                for (int r = lstart[l]; r < lstart[l + 1]; r++)
+                    forward_row(lrows[r]);
+            }
+            for (int l = 0; l < ulevels; l++) {
+                #pragma omp parallel for if(ustart[l + 1] - ustart[l] > ROW_CHUNK)
+                for (int r = ustart[l]; r < ustart[l + 1]; r++)
+                    backward_row(urows[r]);
+            }
+        }
+        y.writeBlock(0, n, t);
+    }
+
+private:
+    // sum of the factor's values[l] * t[j[l]] for l in [from, to). Rows are short, so each head is
+    // widened on its own rather than by readBlock
+    double row_dot(int from, int to) const {
+        const float *a = LU->heads.getHeads();
+        double s = 0.0;
+        for (int l = from; l < to; l++)
+            s += headToDouble(a[l]) * t[j[l]];
+        return s;
+    }
+
+    void forward_row(int k) const { t[k] -= row_dot(i[k], diag[k]); }
+
+    void backward_row(int k) const {
+        t[k] = (t[k] - row_dot(diag[k] + 1, i[k + 1])) * headToDouble(LU->heads.getHeads()[diag[k]]);
+    }
+
+    // both solves for rows [from, to), which depend on no others
+    void solve_rows(int from, int to) const {
+        for (int k = from; k < to; k++) forward_row(k);
+        for (int k = to - 1; k >= from; k--) backward_row(k);
+    }
 };
 
-static inline void matrix_mult(matrix *mat, DOUBLE *x, DOUBLE *y) {
-    mat->dmult(mat, x, y);
+#if defined(USE_ILU0) || defined(USE_BLOCK_JACOBI)
+typedef precond_ilu precond_format;
+#else
+typedef precond_jacobi precond_format;
+#endif
+
+// y = Ax at the precision of the current phase, for products outside of the solve loops
+template<class Format, class In, class Out>
+static inline void matrix_mult(Format *mat, In x, Out y) {
+    if (mat->useTail)
+        Matrix<Format, ACCESS_SWITCHED>(mat).mult(x, y);
+    else
+        Matrix<Format, ACCESS_HEADS>(mat).mult(x, y);
+}
+
+template<class Format, class In, class Out>
+static inline void matrix_mult(Format *mat, int k, In x, Out y) {
+    if (mat->useTail)
+        Matrix<Format, ACCESS_SWITCHED>(mat).mult(k, x, y);
+    else
+        Matrix<Format, ACCESS_HEADS>(mat).mult(k, x, y);
+}
+
+// full = pairs, a block at a time
+static inline void make_full(ManSegArray *A) {
+    A->allocFull();
+    const int64_t block = 4096;
+    #pragma omp parallel for
+    for (int64_t k = 0; k < (int64_t)A->length; k += block)
+        A->pairs.readBlock(k, std::min<int64_t>(block, A->length - k), A->full + k);
+}
+
+template<class Format>
+static inline void mat_increase_precision(Format *mat) {
+    mat->useTail = true;
+    if (ACCESS_SWITCHED == ACCESS_FULL && mat->A->full == nullptr)
+        make_full(mat->A);
 }
 
-static inline void floatm_mult(matrix *mat, FLOAT *x, FLOAT *y) {
-    mat->smult(mat, x, y);
+static inline void mat_increase_precision(matrix_operator *mat) {
+    mat->useTail = true;
 }
 
-static inline void mat_increase_precision(matrix* mat) {
+// the tails of a streamed matrix are read from the file by the products after the switch
+static inline void mat_increase_precision(matrix_stream *mat) {
     mat->useTail = true;
-    mat->precision_increase(mat);
 }
 
-static inline void mat_reduce_precision(matrix* mat) {
+template<class Format>
+static inline void mat_reduce_precision(Format *mat) {
     mat->useTail = false;
-    mat->precision_reduce(mat);
 }
 
-extern matrix_coo *coo_load(const char *fname, int *n, int *nz);
+// renumberings of the unknowns
+enum matrix_ordering { ORDER_NONE, ORDER_RCM, ORDER_ND };
+
+#if defined(USE_RCM)
+#define MATRIX_ORDERING ORDER_RCM
+#elif defined(USE_ND)
+#define MATRIX_ORDERING ORDER_ND
+#else
+#define MATRIX_ORDERING ORDER_NONE
+#endif
+
+extern matrix_coo *coo_load(const char *fname, int *n, int *nz, int ordering, int **order);
+extern int *make_order(int ordering, int n, const int *i, const int *j);
 extern double coo_norm_inf(int n, int nz, matrix_coo *coo);
 extern double coo_max_nz(int n, int nz, matrix_coo *coo);
 
-extern matrix *csr_create(int n, int nz, matrix_coo *coo);
-extern matrix *dense_create(int n, int nz, matrix_coo *coo);
-extern matrix *jacobi_create(int n, int nz, matrix_coo *coo);
+extern matrix_csr *csr_create(int n, int nz, matrix_coo *coo);
+extern matrix_dense *dense_create(int n, int nz, matrix_coo *coo);
+extern matrix_sell *sell_create(int n, int nz, matrix_coo *coo);
+extern matrix_sym *sym_create(int n, int nz, matrix_coo *coo);
+extern matrix_stream *stream_create(int n, int nz, matrix_coo *coo);
+extern matrix_operator *operator_create(int nx, int ny, double diag, double off);
+extern precond_jacobi *jacobi_create(int n, int nz, matrix_coo *coo);
+extern precond_jacobi *operator_jacobi_create(const matrix_operator *op);
+extern precond_ilu *ilu0_create(int n, int nz, matrix_coo *coo);
+extern precond_ilu *block_jacobi_create(int n, int nz, matrix_coo *coo);
 
 
 #endif
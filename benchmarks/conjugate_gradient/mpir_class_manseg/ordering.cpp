@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "cg.h"
+#include "matrix.h"
+
+/*
+    Orderings of the unknowns, to renumber a matrix symmetrically (P A P^T) so that the columns of a
+    row are near it, and a product reads x from a few cache lines at a time rather than from all of it.
+    They work on the pattern of the rows as stored (both triangles of a symmetric matrix), in CSR, and
+    make order[k], the old number of the unknown numbered k.
+        ORDER_RCM: reverse Cuthill-McKee. A breadth first search of each connected component from a
+            pseudo-peripheral vertex, taking the neighbours of a vertex by increasing degree, reversed.
+            It makes the bandwidth small, so x is read from a narrow band around each row.
+        ORDER_ND: nested dissection with level set separators. The middle level of a breadth first
+            search from a pseudo-peripheral vertex splits the graph in two, and the two halves are
+            numbered (recursively) before it, down to parts of ND_LEAF vertices, which are numbered by
+            Cuthill-McKee. The bandwidth is wider, but a part's rows only read the part and its
+            separators, and the parts are independent, e.g. for the blocks of block Jacobi.
+*/
+
+// largest part nested dissection numbers without splitting it
+#define ND_LEAF 256
+
+// the pattern, and the state of the searches: part[v] is the (sub)graph v is in, level[v] its distance
+// from the root of the current search, or -1 if the search has not reached it
+struct order_graph
+{
+    int n;
+    const int *i, *j;
+    std::vector<int> part, level;
+    int parts;
+
+    order_graph(int n, const int *i, const int *j) :n(n), i(i), j(j), part(n, 0), level(n, -1), parts(1) {}
+
+    int degree(int v) const { return i[v + 1] - i[v]; }
+};
+
+// breadth first search from root through the vertices of part p, appending them to queue in the order
+// reached. Returns the number of levels; the levels are left set, for the caller to use and reset
+static int bfs(order_graph &g, int p, int root, std::vector<int> &queue)
+{
+    int depth = 0;
+    g.level[root] = 0;
+    queue.push_back(root);
+    for (size_t h = queue.size() - 1; h < queue.size(); h++) {
+        int v = queue[h];
+        for (int l = g.i[v]; l < g.i[v + 1]; l++) {
+            int u = g.j[l];
+            if (g.part[u] == p && g.level[u] < 0) {
+                g.level[u] = g.level[v] + 1;
+                depth = g.level[u];
+                queue.push_back(u);
+            }
+        }
+    }
+    return depth + 1;
+}
+
+static void reset_levels(order_graph &g, const std::vector<int> &queue, size_t from = 0)
+{
+    for (size_t k = from; k < queue.size(); k++)
+        g.level[queue[k]] = -1;
+}
+
+// a vertex of part p, in start's component, far from the others (George and Liu): the search moves to
+// the vertex of least degree in the last level of a search for as long as that makes more levels
+static int peripheral(order_graph &g, int p, int start)
+{
+    std::vector<int> queue;
+    int root = start, depth = 0;
+    for (int tries = 0; tries < 8; tries++) {
+        queue.clear();
+        int d = bfs(g, p, root, queue);
+        int next = -1;
+        for (size_t k = queue.size(); k-- > 0 && g.level[queue[k]] == d - 1; )
+            if (next < 0 || g.degree(queue[k]) < g.degree(next))
+                next = queue[k];
+        reset_levels(g, queue);
+        if (d <= depth)
+            break;
+        depth = d;
+        root = next;
+    }
+    return root;
+}
+
+// Cuthill-McKee from root through part p, appended to queue; the levels are left set
+static void cuthill_mckee(order_graph &g, int p, int root, std::vector<int> &queue)
+{
+    g.level[root] = 0;
+    queue.push_back(root);
+    for (size_t h = queue.size() - 1; h < queue.size(); h++) {
+        int v = queue[h];
+        size_t from = queue.size();
+        for (int l = g.i[v]; l < g.i[v + 1]; l++) {
+            int u = g.j[l];
+            if (g.part[u] == p && g.level[u] < 0) {
+                g.level[u] = g.level[v] + 1;
+                queue.push_back(u);
+            }
+        }
+        std::sort(queue.begin() + from, queue.end(), [&g](int a, int b) {
+            return g.degree(a) != g.degree(b) ? g.degree(a) < g.degree(b) : a < b;
+        });
+    }
+}
+
+static void rcm(order_graph &g, int *order)
+{
+    std::vector<int> queue;
+    queue.reserve(g.n);
+    for (int v = 0; v < g.n; v++) {
+        if (g.part[v] != 0)
+            continue;
+        size_t from = queue.size();
+        cuthill_mckee(g, 0, peripheral(g, 0, v), queue);
+        // numbered: out of the graph for the next components
+        for (size_t k = from; k < queue.size(); k++)
+            g.part[queue[k]] = -1;
+    }
+    reset_levels(g, queue);
+    std::reverse_copy(queue.begin(), queue.end(), order);
+}
+
+// numbers the vertices verts, all of part p, into order[0 .. verts.size())
+static void dissect(order_graph &g, int p, const std::vector<int> &verts, int *order)
+{
+    int count = (int)verts.size();
+    std::vector<int> queue;
+    queue.reserve(count);
+    int root = -1, depth = 0;
+    if (count > ND_LEAF) {
+        root = peripheral(g, p, verts[0]);
+        depth = bfs(g, p, root, queue);
+        reset_levels(g, queue);
+    }
+
+    // small, or too shallow to cut into three: Cuthill-McKee, component by component
+    if (count <= ND_LEAF || ((int)queue.size() == count && depth < 3)) {
+        queue.clear();
+        for (int k = 0; k < count; k++)
+            if (g.level[verts[k]] < 0)
+                cuthill_mckee(g, p, verts[k], queue);
+        reset_levels(g, queue);
+        std::copy(queue.begin(), queue.end(), order);
+        return;
+    }
+
+    std::vector<int> first, second, separator;
+    if ((int)queue.size() < count) {
+        // not connected: whole components up to half the vertices, then the rest, with nothing
+        // between them
+        queue.clear();
+        size_t last = 0;
+        for (int k = 0; k < count && (int)queue.size() < count / 2; k++)
+            if (g.level[verts[k]] < 0) {
+                last = queue.size();
+                bfs(g, p, verts[k], queue);
+            }
+        // (the last component taken may have been the rest)
+        size_t taken = (int)queue.size() < count ? queue.size() : last;
+        first.assign(queue.begin(), queue.begin() + taken);
+        second.assign(queue.begin() + taken, queue.end());
+        for (int k = 0; k < count; k++)
+            if (g.level[verts[k]] < 0)
+                second.push_back(verts[k]);
+    }
+    else {
+        // the level holding the middle vertex, kept off the first and last levels so neither half is empty
+        queue.clear();
+        bfs(g, p, root, queue);
+        int middle = std::min(std::max(g.level[queue[count / 2]], 1), depth - 2);
+        for (int k = 0; k < count; k++) {
+            int v = queue[k];
+            (g.level[v] < middle ? first : g.level[v] == middle ? separator : second).push_back(v);
+        }
+    }
+    reset_levels(g, queue);
+
+    int a = g.parts++, b = g.parts++;
+    for (size_t k = 0; k < first.size(); k++) g.part[first[k]] = a;
+    for (size_t k = 0; k < second.size(); k++) g.part[second[k]] = b;
+    for (size_t k = 0; k < separator.size(); k++) g.part[separator[k]] = -1;
+    dissect(g, a, first, order);
+    dissect(g, b, second, order + first.size());
+    std::copy(separator.begin(), separator.end(), order + first.size() + second.size());
+}
+
+int *make_order(int ordering, int n, const int *i, const int *j)
+{
+    int *order = ALLOC(int, n);
+    order_graph g(n, i, j);
+    if (ordering == ORDER_ND) {
+        std::vector<int> verts(n);
+        for (int v = 0; v < n; v++) verts[v] = v;
+        dissect(g, 0, verts, order);
+    }
+    else
+        rcm(g, order);
+    return order;
+}
@@ -8,24 +8,153 @@
 
 #include <sys/time.h>
 #include <time.h>
+#include <omp.h>
 
 #include "mmio.h"
 
 #include "cg.h"
 #include "vector.h"
 #include "matrix.h"
+#include "batch.h"
 
-// #define USE_DENSE
 #define USE_PRECOND
 
-void iterative_refinement(int n, matrix *A, matrix *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x, int out_maxiter, DOUBLE out_tol, 
-    int in_maxiter, DOUBLE in_tol, int step_check, int *out_iter, int *in_iter);
+void iterative_refinement(int n, int nz, matrix_format *A, DOUBLE anorm, precond_format *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x, int out_maxiter, DOUBLE out_tol, 
+    int in_maxiter, DOUBLE in_tol, int step_check, int *out_iter, int *in_iter, ResultsWriter *results);
+void batched_iterative_refinement(int n, int nz, int k, matrix_format *A, precond_format *M, DOUBLE *b, DOUBLE *b_dash, DOUBLE *x,
+    int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol, int *out_iter, int *in_iter, ResultsWriter *results);
+
+// the matrix in the format chosen at compile time, from coo, or for the operator from its grid
+static matrix_format *matrix_create(int n, int nz, matrix_coo *coo, int nx, int ny)
+{
+#if defined(USE_OPERATOR)
+    return operator_create(nx, ny, 4.0, -1.0);
+#elif defined(USE_DENSE)
+    return dense_create(n, nz, coo);
+#elif defined(USE_CSR)
+    return csr_create(n, nz, coo);
+#elif defined(USE_SYM)
+    return sym_create(n, nz, coo);
+#elif defined(USE_STREAM)
+    return stream_create(n, nz, coo);
+#else
+    return sell_create(n, nz, coo);
+#endif
+}
+
+static precond_format *precond_create(int n, int nz, matrix_coo *coo, matrix_format *A)
+{
+#if defined(USE_PRECOND) && defined(USE_ILU0)
+    return ilu0_create(n, nz, coo);
+#elif defined(USE_PRECOND) && defined(USE_BLOCK_JACOBI)
+    return block_jacobi_create(n, nz, coo);
+#elif defined(USE_PRECOND) && defined(USE_OPERATOR)
+    return operator_jacobi_create(A);
+#elif defined(USE_PRECOND)
+    // the diagonal of the matrix
+    return jacobi_create(n, nz, coo);
+#else
+    return NULL;
+#endif
+}
+
+/*
+    $MANSEG_BATCH: count systems of the matrix, each with a matrix and preconditioner of its own, a
+    random solution s (b = As) and a random guess, solved together by solve_batch (batch.cpp), as a
+    service solving many small independent systems would. The results are of the batch: its time,
+    systems per second, the iterations of all its solves and the largest error of any.
+*/
+static int run_batch(int count, const char *name, int n, int nz, matrix_coo *coo, int nx, int ny, int *order, DOUBLE norm,
+    int out_maxiter, DOUBLE out_tol, int in_maxiter, DOUBLE in_tol, int step_check)
+{
+    std::vector<batch_system> systems(count);
+    std::vector<DOUBLE*> solutions(count);
+    for (int q = 0; q < count; q++) {
+        batch_system &sys = systems[q];
+        sys.n = n;
+        sys.nz = nz;
+        sys.A = matrix_create(n, nz, coo, nx, ny);
+        sys.M = precond_create(n, nz, coo, sys.A);
+        sys.anorm = norm;
+        sys.b = ALLOC(DOUBLE, n);
+        sys.b_dash = ALLOC(DOUBLE, n);
+        sys.x = ALLOC(DOUBLE, n);
+        DOUBLE *s = solutions[q] = ALLOC(DOUBLE, n);
+        vector_rand(n, s);
+        if (order)
+            vector_permute(n, 1, order, s, false);
+        matrix_mult(sys.A, FullView(s, n), FullView(sys.b_dash, n));
+        Matrix<matrix_format, ACCESS_PAIRS>(sys.A).mult(FullView(s, n), FullView(sys.b, n)); // b = As
+        vector_rand(n, sys.x);
+        if (order)
+            vector_permute(n, 1, order, sys.x, false);
+    }
+
+    printf("# matrix               : %s\n", name);
+    printf("# problem_size         : %d\n", n);
+    printf("# nnz                  : %d\n", nz);
+    printf("# batch                : %d\n\n", count);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    solve_batch(systems.data(), count, out_maxiter, out_tol, in_maxiter, in_tol, step_check);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double time_taken = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    long in_iter = 0;
+    int out_iter = 0, unconverged = 0;
+    DOUBLE residual = 0.0;
+    double error = 0.0, slowest = 0.0;
+    for (int q = 0; q < count; q++) {
+        const batch_system &sys = systems[q];
+        in_iter += sys.in_iter;
+        out_iter = std::max(out_iter, sys.out_iter);
+        residual = std::max(residual, sys.residual);
+        slowest = std::max(slowest, sys.seconds);
+        if (sys.residual > out_tol)
+            unconverged++;
+        if (order) {
+            vector_permute(n, 1, order, sys.x, true);
+            vector_permute(n, 1, order, solutions[q], true);
+        }
+        error = std::max(error, relativeError(sys.x, n, std::vector<double>(solutions[q], solutions[q] + n)));
+    }
+
+    printf("# outer_iterations (ir): %d (most of any system)\n", out_iter);
+    printf("# inner_iterations (cg): %ld (all systems)\n", in_iter);
+    printf("# residual (ir)        : %e (largest)\n", (double)residual);
+    printf("# unconverged          : %d\n", unconverged);
+    printf("# slowest system       : %.7f s\n", slowest);
+    printf("\n# Time taken           : %.7f s, %.1f systems/s\n", time_taken, count / time_taken);
+
+    ResultsWriter results("sparsesolve");
+    results.set("matrix", name);
+    results.set("problem_size", n);
+    results.set("nnz", nz);
+    results.set("threads", omp_get_max_threads());
+    results.set("batch", count);
+    results.set("unconverged", unconverged);
+    results.set("systems_per_second", count / time_taken);
+    results.set("slowest_system_time", slowest);
+    results.finalError(error);
+    results.set("inner_iterations", in_iter);
+    results.set("total_time", time_taken);
+    results.write();
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
-    if (argc != 7)
+    if (argc != 7 && argc != 8)
+    {
+        fprintf(stderr, "Missing arguments: algorithm matrix_file out_its out_tol in_its in_tol step_chk [rhs]\n");
+        return 1;
+    }
+    // rhs > 1 solves that many right hand sides together, with the batched CG
+    int k = argc > 7 ? atoi(argv[7]) : 1;
+    if (k < 1 || k > MAX_RHS)
     {
-        fprintf(stderr, "Missing arguments: algorithm matrix_file out_its out_tol in_its in_tol step_chk\n");
+        fprintf(stderr, "rhs must be from 1 to %d\n", MAX_RHS);
         return 1;
     }
 
@@ -33,32 +162,50 @@ int main(int argc, char *argv[])
 
     int n, nz;
     matrix_coo *coo;
-    coo = coo_load(argv[1], &n, &nz);
-#ifdef USE_DENSE
-    matrix *A = dense_create(n, nz, coo);
+    // with an ordering, the solve is of PAP^T Px = Pb, and order gives P (see coo_load)
+    int *order = NULL;
+    int nx = 0, ny = 0;
+#if defined(USE_OPERATOR)
+    // matrix_file is the grid, NXxNY, of the 5 point Laplacian, which is applied rather than stored
+    if (sscanf(argv[1], "%dx%d", &nx, &ny) != 2 || nx < 1 || ny < 1)
+    {
+        fprintf(stderr, "The operator needs a grid, NXxNY, in place of the matrix file: %s\n", argv[1]);
+        return 1;
+    }
+    coo = NULL;
+    n = nx * ny;
+    nz = 5 * n - 2 * nx - 2 * ny;
 #else
-    matrix *A = csr_create(n, nz, coo);
+    coo = coo_load(argv[1], &n, &nz, MATRIX_ORDERING, &order);
 #endif
+    matrix_format *A = matrix_create(n, nz, coo, nx, ny);
 
 	// increase precision before doing b = As
 	// mat_increase_precision(A);
 
-    DOUBLE *x = ALLOC(DOUBLE, n); // unknown vector x (what we want to find)
-    DOUBLE *b = ALLOC(DOUBLE, n); // well-known vector (high)
-	DOUBLE *b_dash = ALLOC(DOUBLE, n); // well-knoown vector (low)
-    DOUBLE *r = ALLOC(DOUBLE, n); // residual vector
-    DOUBLE *s = ALLOC(DOUBLE, n); // randomised starting point (i think)
+    // with k right hand sides these are blocks of k vectors, interleaved (see vector.h)
+    DOUBLE *x = ALLOC(DOUBLE, n * k); // unknown vector x (what we want to find)
+    DOUBLE *b = ALLOC(DOUBLE, n * k); // well-known vector (high)
+	DOUBLE *b_dash = ALLOC(DOUBLE, n * k); // well-knoown vector (low)
+    DOUBLE *r = ALLOC(DOUBLE, n * k); // residual vector
+    DOUBLE *s = ALLOC(DOUBLE, n * k); // randomised starting point (i think)
 
-    vector_rand(n, s); // randomise "starting point"
+    vector_rand(n * k, s); // randomise "starting point"
+    // drawn in the numbering of the file, so every ordering solves the same system
+    if (order)
+        vector_permute(n, k, order, s, false);
     // vector_set(n, 1.0 / sqrt(n), s);
 
-	// create low precision copy
-	matrix_mult(A, s, b_dash);
-	// increase to get high precision version
-	mat_increase_precision(A);
-    matrix_mult(A, s, b); // b = As
-	// reduce again before we start computation
-	mat_reduce_precision(A);
+    if (k == 1) {
+	    // create low precision copy
+	    matrix_mult(A, FullView(s, n), FullView(b_dash, n));
+	    // high precision version from the pairs, exactly as from full, but without making full yet
+        Matrix<matrix_format, ACCESS_PAIRS>(A).mult(FullView(s, n), FullView(b, n)); // b = As
+    }
+    else {
+        matrix_mult(A, k, FullView(s, n * k), FullView(b_dash, n * k));
+        Matrix<matrix_format, ACCESS_PAIRS>(A).mult(k, FullView(s, n * k), FullView(b, n * k));
+    }
 
 
     int out_maxiter = atoi(argv[2]);
@@ -74,7 +221,7 @@ int main(int argc, char *argv[])
 
     
     DOUBLE max = 0;
-    for (int i = 0; i < nz; i++) // max error present in matrix
+    for (int i = 0; coo && i < nz; i++) // max error present in matrix
     {
         DOUBLE x1 = coo[i].a;
         DOUBLE x2 = x1;
@@ -83,16 +230,22 @@ int main(int argc, char *argv[])
             max = error;
     }
 
-#ifdef USE_PRECOND
-    matrix *M = jacobi_create(n, nz, coo);
-
-    // create jacobian matrix
-    // i think this just means we have a diagonal of the matrix coo
-    // ([0,0], [1,1,], etc)
+    precond_format *M = precond_create(n, nz, coo, A);
+#if defined(USE_OPERATOR)
+    DOUBLE norm = fabs(A->diag) + 4.0 * fabs(A->off);
 #else
-    matrix *M = NULL;
-#endif
     DOUBLE norm = coo_norm_inf(n, nz, coo);
+#endif
+
+    // $MANSEG_BATCH > 1 solves that many independent systems of the matrix instead (see run_batch)
+    const int batch = getenv("MANSEG_BATCH") != NULL ? atoi(getenv("MANSEG_BATCH")) : 1;
+    if (batch > 1) {
+        if (k > 1) {
+            fprintf(stderr, "$MANSEG_BATCH solves systems of one right hand side each\n");
+            return 1;
+        }
+        return run_batch(batch, argv[1], n, nz, coo, nx, ny, order, norm, out_maxiter, out_tol, in_maxiter, in_tol, step_check);
+    }
     delete coo;
 
     printf("# algorithm            : %s\n", argv[0]);
@@ -103,22 +256,68 @@ int main(int argc, char *argv[])
     printf("# nnz                  : %d\n", nz);
     printf("# matrix_norm          : %e\n", (double)norm);
     printf("# matrix_error         : %e\n", (double)max);
+    if (k > 1)
+        printf("# right_hand_sides     : %d\n", k);
     printf("# bnorm                : %e\n\n", (double)vector_norm2(n, b));
 
     // randomize guesses in x
-    vector_rand(n, x);
+    vector_rand(n * k, x);
+    if (order)
+        vector_permute(n, k, order, x, false);
 
     int out_iter = 0, in_iter = 0;
 
+    ResultsWriter results("sparsesolve");
+    results.set("matrix", argv[1]);
+    results.set("problem_size", n);
+    results.set("nnz", nz);
+    results.set("threads", omp_get_max_threads());
+    results.set("numa", getenv("OMP_PLACES") != NULL ? getenv("OMP_PLACES") : "none");
+    results.set("right_hand_sides", k);
+    results.set("ordering", MATRIX_ORDERING == ORDER_RCM ? "rcm" : MATRIX_ORDERING == ORDER_ND ? "nd" : "none");
+
     // oprecomp_start();
     // do {
     //
 
-    clock_gettime(CLOCK_MONOTONIC, &ir_start);
-    // repeat cg until it converges on a solution or the residual error is too large
-    iterative_refinement(n, A, M, b, b_dash, x, out_maxiter, out_tol, in_maxiter, in_tol, step_check,
-                         &out_iter, &in_iter);
-    clock_gettime(CLOCK_MONOTONIC, &ir_end);
+    // $MANSEG_SOLVES > 1 solves the system that many times from the same x, as a service solving many
+    // systems of one size would, each solve's vectors coming from the pool the last one left them in
+    // (see SolverArray); the matrix starts each solve at the heads again. The results are the last's.
+    const int solves = getenv("MANSEG_SOLVES") != NULL ? std::max(1, atoi(getenv("MANSEG_SOLVES"))) : 1;
+    DOUBLE *x0 = NULL;
+    if (solves > 1) {
+        x0 = ALLOC(DOUBLE, n * k);
+        memcpy(x0, x, n * k * sizeof(DOUBLE));
+        results.set("solves", solves);
+    }
+
+    for (int solve = 0; solve < solves; solve++) {
+        ResultsWriter unrecorded("sparsesolve", "");
+        ResultsWriter *recorded = solve == solves - 1 ? &results : &unrecorded;
+        if (solve > 0) {
+            memcpy(x, x0, n * k * sizeof(DOUBLE));
+            out_iter = in_iter = 0;
+            mat_reduce_precision(A);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &ir_start);
+        // repeat cg until it converges on a solution or the residual error is too large
+        if (k == 1)
+            iterative_refinement(n, nz, A, norm, M, b, b_dash, x, out_maxiter, out_tol, in_maxiter, in_tol, step_check,
+                                 &out_iter, &in_iter, recorded);
+        else
+            batched_iterative_refinement(n, nz, k, A, M, b, b_dash, x, out_maxiter, out_tol, in_maxiter, in_tol,
+                                         &out_iter, &in_iter, recorded);
+        clock_gettime(CLOCK_MONOTONIC, &ir_end);
+
+        if (solves > 1)
+            printf("# solve %d               : %.7f s, %lu planes reused, %lu mapped\n", solve,
+                   (ir_end.tv_sec - ir_start.tv_sec) + (ir_end.tv_nsec - ir_start.tv_nsec) * 1e-9,
+                   (unsigned long)SegmentPool::global().reused(), (unsigned long)SegmentPool::global().mapped());
+    }
+    if (x0) {
+        FREE(x0);
+    }
 
     //
     // } while (oprecomp_iterate());
@@ -126,10 +325,25 @@ int main(int argc, char *argv[])
     double time_taken = (ir_end.tv_sec - ir_start.tv_sec) * 1e9;
     time_taken = (time_taken + (ir_end.tv_nsec - ir_start.tv_nsec)) * 1e-9;
 
-    matrix_mult(A, x, r); // r = Ax
-    vector_xpby(n, b, -1.0, r); // r = x + b^-1
-    DOUBLE residual = vector_norm2(n, r);
-    DOUBLE normalized_residual = residual / (vector_norm2(n, x) * norm);
+    // with k right hand sides, the largest residual of the k
+    DOUBLE residual, normalized_residual;
+    if (k == 1) {
+        matrix_mult(A, FullView(x, n), FullView(r, n)); // r = Ax
+        vector_xpby(n, b, -1.0, r); // r = x + b^-1
+        residual = vector_norm2(n, r);
+        normalized_residual = residual / (vector_norm2(n, x) * norm);
+    }
+    else {
+        FLOAT2 residuals[MAX_RHS], xnorms[MAX_RHS];
+        matrix_mult(A, k, FullView(x, n * k), FullView(r, n * k));
+        seg_block_xpby_norm2(n, k, FullView(b, n * k), -1.0, FullView(r, n * k), residuals);
+        seg_block_dot(n, k, FullView(x, n * k), FullView(x, n * k), xnorms);
+        residual = normalized_residual = 0.0;
+        for (int q = 0; q < k; q++) {
+            residual = std::max(residual, residuals[q]);
+            normalized_residual = std::max(normalized_residual, residuals[q] / (sqrt(xnorms[q]) * norm));
+        }
+    }
 
     printf("# outer_maxiter        : %d\n", out_maxiter);
     printf("# outer_tolerance      : %e\n", (double)out_tol);
@@ -142,6 +356,16 @@ int main(int argc, char *argv[])
 
     printf("\n# Time taken           : %.7f s\n", time_taken);
 
+    // b = As, so s is the double precision solution; both back in the numbering of the file
+    if (order) {
+        vector_permute(n, k, order, x, true);
+        vector_permute(n, k, order, s, true);
+    }
+    results.finalError(relativeError(x, n * k, std::vector<double>(s, s + n * k)));
+    results.set("inner_iterations", in_iter);
+    results.set("total_time", time_taken);
+    results.write();
+
     // todo: dump x values
     // char *st = &argv[1][7];
     // char *ed = &argv[1][strlen(argv[1])-4];
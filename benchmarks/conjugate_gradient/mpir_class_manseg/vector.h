@@ -33,6 +33,19 @@ static inline DOUBLE vector_norm2(int n, DOUBLE *x) {
     return sqrt(vector_dot(n, x, x));
 }
 
+// x = Px, the new value i being the old value order[i], in each of the k interleaved vectors of a block
+// (see the batched kernels below); with inverse, x = P^Tx
+static inline void vector_permute(int n, int k, const int *order, DOUBLE *x, bool inverse) {
+    std::vector<DOUBLE> y(x, x + (size_t)n * k);
+    for (int i = 0; i < n; i++)
+        for (int q = 0; q < k; q++) {
+            if (inverse)
+                x[(size_t)order[i] * k + q] = y[(size_t)i * k + q];
+            else
+                x[(size_t)i * k + q] = y[(size_t)order[i] * k + q];
+        }
+}
+
 // limited precision version
 
 static inline void floatm_set(int n, FLOAT a, FLOAT *x) {
@@ -146,17 +159,9 @@ static inline void floatm_abs_diff(int n, FLOAT *x, FLOAT *y, FLOAT *z) {
 	for(int i = 0; i < n; i++) z[i] = fabsf(x[i] - y[i]);
 }
 
+// compensated sum(abs(y - x))
 static inline DOUBLE double_norm_diff(int n, DOUBLE *x, DOUBLE *y) {
-    DOUBLE d = 0.0;
-    DOUBLE err = 0.0;
-    for(int i = 0; i < n; i++) {
-        DOUBLE temp = d;
-        DOUBLE r = std::fabs(y[i] - x[i]) + err;
-        d = temp + r;
-        err = temp - d;
-        err += r;
-    }
-    return d;
+    return ManSeg::l1Diff(y, x, 0, n);
 }
 
 static inline FLOAT2 float_norm_diff(int n, FLOAT *x, FLOAT *y) {
@@ -173,17 +178,467 @@ static inline FLOAT2 float_norm_diff(int n, FLOAT *x, FLOAT *y) {
 }
 
 // mixed precision routines
+// The CG and IR vectors are ManSegArrays: the inner solve works on their heads, and the outer
+// residual is kept in the pairs of the same array, so no float copies are made between the two.
+// The seg_ kernels take any of the views of a ManSegArray (heads or pairs), or a FullView of
+// DOUBLEs. Each operand is widened a chunk at a time, every update of the chunk is made while it is
+// in L1, and it is narrowed back once, so the fused kernels read and write each vector once.
+// Sums are kept in VEC_LANES lanes so they vectorise, and long vectors are split between threads.
+
+#define VEC_CHUNK 256
+#define VEC_LANES 4
+#define VEC_PARALLEL 65536
+
+// sum of x[m] * y[m] for m < len, in VEC_LANES lanes
+static inline double chunk_dot(const double *x, const double *y, int len) {
+    double lanes[VEC_LANES] = { 0.0 };
+    int m = 0;
+    for (; m + VEC_LANES <= len; m += VEC_LANES)
+        for (int k = 0; k < VEC_LANES; k++) lanes[k] += x[m + k] * y[m + k];
+    for (; m < len; m++) lanes[0] += x[m] * y[m];
+    double r = 0.0;
+    for (int k = 0; k < VEC_LANES; k++) r += lanes[k];
+    return r;
+}
 
-static inline void mixed_copy(int n, DOUBLE *x, FLOAT *y) {
-    for (int i = 0; i < n; i++) y[i] = x[i];
+// x = a
+template<class X>
+static inline void seg_set(int n, DOUBLE a, X x) {
+    double as[VEC_CHUNK];
+    for (int m = 0; m < VEC_CHUNK; m++) as[m] = a;
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK)
+        x.writeBlock(i, std::min(VEC_CHUNK, n - i), as);
 }
 
-static inline void mixed_axpy(int n, DOUBLE a, FLOAT *x, DOUBLE *y) {
-    for (int i = 0; i < n; i++) y[i] += x[i] * a;
+// y = x
+template<class X, class Y>
+static inline void seg_copy(int n, X x, Y y) {
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.writeBlock(i, len, xs);
+    }
 }
 
-static inline void mixed_xpby(int n, DOUBLE *x, DOUBLE b, FLOAT *y) {
-    for (int i = 0; i < n; i++) y[i] = x[i] + b * y[i];
+// y = y + x*a
+template<class X, class Y>
+static inline void seg_axpy(int n, FLOAT2 a, X x, Y y) {
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = ys[m] + xs[m] * a;
+        y.writeBlock(i, len, ys);
+    }
+}
+
+// y = x + b*y
+template<class X, class Y>
+static inline void seg_xpby(int n, X x, FLOAT2 b, Y y) {
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = xs[m] + b * ys[m];
+        y.writeBlock(i, len, ys);
+    }
+}
+
+// inner product
+template<class X, class Y>
+static inline FLOAT2 seg_dot(int n, X x, Y y) {
+    FLOAT2 r = 0.0;
+    #pragma omp parallel for reduction(+: r) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        r += chunk_dot(xs, ys, len);
+    }
+    return r;
+}
+
+template<class X>
+static inline FLOAT2 seg_norm2(int n, X x) {
+    return sqrt(seg_dot(n, x, x));
+}
+
+// y = x + b*y, returning ||y|| (of y as stored)
+template<class X, class Y>
+static inline FLOAT2 seg_xpby_norm2(int n, X x, FLOAT2 b, Y y) {
+    FLOAT2 r = 0.0;
+    #pragma omp parallel for reduction(+: r) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = xs[m] + b * ys[m];
+        y.writeBlock(i, len, ys);
+        y.readBlock(i, len, ys);
+        r += chunk_dot(ys, ys, len);
+    }
+    return sqrt(r);
+}
+
+// x = a*x
+template<class X>
+static inline void seg_scale(int n, FLOAT2 a, X x) {
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        for (int m = 0; m < len; m++) xs[m] = a * xs[m];
+        x.writeBlock(i, len, xs);
+    }
+}
+
+// y = y + a*x, returning y^Tz (of y as stored): a step of modified Gram-Schmidt fused with the dot
+// product of the next step
+template<class X, class Y, class Z>
+static inline FLOAT2 seg_axpy_dot(int n, FLOAT2 a, X x, Y y, Z z) {
+    FLOAT2 r = 0.0;
+    #pragma omp parallel for reduction(+: r) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK], zs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = ys[m] + xs[m] * a;
+        y.writeBlock(i, len, ys);
+        y.readBlock(i, len, ys);
+        z.readBlock(i, len, zs);
+        r += chunk_dot(ys, zs, len);
+    }
+    return r;
+}
+
+// y = y + a*x, returning ||y|| (of y as stored)
+template<class X, class Y>
+static inline FLOAT2 seg_axpy_norm2(int n, FLOAT2 a, X x, Y y) {
+    FLOAT2 r = 0.0;
+    #pragma omp parallel for reduction(+: r) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = ys[m] + xs[m] * a;
+        y.writeBlock(i, len, ys);
+        y.readBlock(i, len, ys);
+        r += chunk_dot(ys, ys, len);
+    }
+    return sqrt(r);
+}
+
+/*
+    The vector updates of a (Jacobi preconditioned) CG iteration in one pass, with w = Ap in z:
+        x = x + alpha*p;  r = r - alpha*w;  z = r ./ d;  *rz = r^Tz;  *rr = r^Tr
+    With d null (no preconditioner, or one that is not a diagonal) z is left as it is, and *rz = *rr.
+    The dot products are of r and z as stored, as separate kernels would read them.
+*/
+template<class V>
+static inline void seg_cg_update(int n, FLOAT2 alpha, V p, V x, V r, V z, const FLOAT *d, FLOAT2 *rz, FLOAT2 *rr) {
+    FLOAT2 sum_rz = 0.0, sum_rr = 0.0;
+    #pragma omp parallel for reduction(+: sum_rz, sum_rr) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double ps[VEC_CHUNK], xs[VEC_CHUNK], rs[VEC_CHUNK], zs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        p.readBlock(i, len, ps);
+        x.readBlock(i, len, xs);
+        for (int m = 0; m < len; m++) xs[m] = xs[m] + ps[m] * alpha;
+        x.writeBlock(i, len, xs);
+
+        z.readBlock(i, len, zs);
+        r.readBlock(i, len, rs);
+        for (int m = 0; m < len; m++) rs[m] = rs[m] + zs[m] * -alpha;
+        r.writeBlock(i, len, rs);
+        r.readBlock(i, len, rs);
+        sum_rr += chunk_dot(rs, rs, len);
+        if (d) {
+            for (int m = 0; m < len; m++) zs[m] = rs[m] / d[i + m];
+            z.writeBlock(i, len, zs);
+            z.readBlock(i, len, zs);
+            sum_rz += chunk_dot(rs, zs, len);
+        }
+    }
+    *rr = sum_rr;
+    *rz = d ? sum_rz : sum_rr;
+}
+
+/*
+    The kernels of the single reduction CG variants (in cg.cpp). Names follow the vectors they hold:
+    u = M^-1 r, w = Au, ap = Ap, m = M^-1 w, am = Am, map = M^-1 Ap and amap = AM^-1 Ap. d is M if it
+    is a diagonal, and null otherwise, when the vector divided by d is left for M to make after the
+    kernel. Without a preconditioner u is r, m is w and map is ap: pass the same view for each.
+*/
+
+// the dot products of one reduction: *gamma = r^Tu, *delta = w^Tu, *rr = r^Tr
+template<class V>
+static inline void seg_cg_dots(int n, V r, V u, V w, FLOAT2 *gamma, FLOAT2 *delta, FLOAT2 *rr) {
+    FLOAT2 sum_ru = 0.0, sum_wu = 0.0, sum_rr = 0.0;
+    #pragma omp parallel for reduction(+: sum_ru, sum_wu, sum_rr) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double rs[VEC_CHUNK], us[VEC_CHUNK], ws[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        r.readBlock(i, len, rs);
+        u.readBlock(i, len, us);
+        w.readBlock(i, len, ws);
+        sum_ru += chunk_dot(rs, us, len);
+        sum_wu += chunk_dot(ws, us, len);
+        sum_rr += chunk_dot(rs, rs, len);
+    }
+    *gamma = sum_ru;
+    *delta = sum_wu;
+    *rr = sum_rr;
+}
+
+/*
+    The vector updates of a Chronopoulos-Gear iteration, in one pass:
+        p = u + beta*p;  ap = w + beta*ap;  x = x + alpha*p;  r = r - alpha*ap;  u = r ./ d
+*/
+template<class V>
+static inline void seg_cgcg_update(int n, FLOAT2 alpha, FLOAT2 beta, V u, V w, V p, V ap, V x, V r, const FLOAT *d) {
+    #pragma omp parallel for if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double us[VEC_CHUNK], ws[VEC_CHUNK], ps[VEC_CHUNK], aps[VEC_CHUNK], xs[VEC_CHUNK], rs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        u.readBlock(i, len, us);
+        w.readBlock(i, len, ws);
+        p.readBlock(i, len, ps);
+        ap.readBlock(i, len, aps);
+        x.readBlock(i, len, xs);
+        r.readBlock(i, len, rs);
+        for (int m = 0; m < len; m++) {
+            ps[m] = us[m] + beta * ps[m];
+            aps[m] = ws[m] + beta * aps[m];
+            xs[m] = xs[m] + ps[m] * alpha;
+            rs[m] = rs[m] + aps[m] * -alpha;
+        }
+        p.writeBlock(i, len, ps);
+        ap.writeBlock(i, len, aps);
+        x.writeBlock(i, len, xs);
+        r.writeBlock(i, len, rs);
+        if (d) {
+            r.readBlock(i, len, rs);
+            for (int m = 0; m < len; m++) us[m] = rs[m] / d[i + m];
+            u.writeBlock(i, len, us);
+        }
+    }
+}
+
+/*
+    The vector updates of a Ghysels-Vanroose iteration, with am = Am just made, and the dot products
+    of the next iteration, in one pass:
+        amap = am + beta*amap;  map = m + beta*map;  ap = w + beta*ap;  p = u + beta*p;
+        x = x + alpha*p;  r = r - alpha*ap;  u = u - alpha*map;  w = w - alpha*amap;  m = w ./ d;
+        *gamma = r^Tu;  *delta = w^Tu;  *rr = r^Tr
+    With precond false (no preconditioner) u, m and map are only read through r, w and ap.
+*/
+template<class V>
+static inline void seg_pipecg_update(int n, FLOAT2 alpha, FLOAT2 beta, V am, V amap, V m, V map, V w, V ap, V u, V p,
+    V x, V r, bool precond, const FLOAT *d, FLOAT2 *gamma, FLOAT2 *delta, FLOAT2 *rr) {
+    FLOAT2 sum_ru = 0.0, sum_wu = 0.0, sum_rr = 0.0;
+    #pragma omp parallel for reduction(+: sum_ru, sum_wu, sum_rr) if(n >= VEC_PARALLEL)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double ams[VEC_CHUNK], amaps[VEC_CHUNK], ms[VEC_CHUNK], maps[VEC_CHUNK], ws[VEC_CHUNK], aps[VEC_CHUNK],
+            us[VEC_CHUNK], ps[VEC_CHUNK], xs[VEC_CHUNK], rs[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        am.readBlock(i, len, ams);
+        amap.readBlock(i, len, amaps);
+        w.readBlock(i, len, ws);
+        ap.readBlock(i, len, aps);
+        p.readBlock(i, len, ps);
+        x.readBlock(i, len, xs);
+        r.readBlock(i, len, rs);
+        if (precond) {
+            m.readBlock(i, len, ms);
+            map.readBlock(i, len, maps);
+            u.readBlock(i, len, us);
+            for (int k = 0; k < len; k++) {
+                maps[k] = ms[k] + beta * maps[k];
+                ps[k] = us[k] + beta * ps[k];
+                us[k] = us[k] + maps[k] * -alpha;
+            }
+        }
+        else {
+            for (int k = 0; k < len; k++) ps[k] = rs[k] + beta * ps[k];
+        }
+        for (int k = 0; k < len; k++) {
+            amaps[k] = ams[k] + beta * amaps[k];
+            aps[k] = ws[k] + beta * aps[k];
+            xs[k] = xs[k] + ps[k] * alpha;
+            rs[k] = rs[k] + aps[k] * -alpha;
+            ws[k] = ws[k] + amaps[k] * -alpha;
+        }
+        amap.writeBlock(i, len, amaps);
+        ap.writeBlock(i, len, aps);
+        p.writeBlock(i, len, ps);
+        x.writeBlock(i, len, xs);
+        r.writeBlock(i, len, rs);
+        w.writeBlock(i, len, ws);
+        r.readBlock(i, len, rs);
+        w.readBlock(i, len, ws);
+        if (precond) {
+            map.writeBlock(i, len, maps);
+            u.writeBlock(i, len, us);
+            u.readBlock(i, len, us);
+            if (d) {
+                for (int k = 0; k < len; k++) ms[k] = ws[k] / d[i + k];
+                m.writeBlock(i, len, ms);
+            }
+            sum_ru += chunk_dot(rs, us, len);
+            sum_wu += chunk_dot(ws, us, len);
+        }
+        else {
+            sum_wu += chunk_dot(ws, rs, len);
+        }
+        sum_rr += chunk_dot(rs, rs, len);
+    }
+    *rr = sum_rr;
+    *gamma = precond ? sum_ru : sum_rr;
+    *delta = sum_wu;
+}
+
+/*
+    Kernels of the batched CG (in cg.cpp), on blocks of k <= MAX_RHS vectors of length n stored
+    interleaved: value i of vector q is at i*k + q, so that a product can read each value of the matrix
+    once for all k (see spmm in matrix.h). Each vector has its own scalars (a[q]) and sums (out[q]). A
+    chunk is a whole number of rows of the block, so value m of every chunk is of vector m % k: the
+    scalars are spread over a chunk once (as[m] = a[m % k]), the sums are kept per position of the
+    chunk, and only folded per vector at the end, so the loops are as flat as those of the seg_ kernels.
+*/
+
+// values of a chunk of a block of k vectors
+static inline int block_chunk(int k) {
+    return VEC_CHUNK / k * k;
+}
+
+// as[m] = a[m % k] for m < block_chunk(k)
+static inline void block_spread(int k, const FLOAT2 *a, double *as) {
+    for (int m = 0; m < block_chunk(k); m++) as[m] = a[m % k];
+}
+
+// out[q] = sum of acc[m] for m % k = q
+static inline void block_fold(int k, const double *acc, FLOAT2 *out) {
+    for (int q = 0; q < k; q++) out[q] = 0.0;
+    for (int m = 0; m < block_chunk(k); m++) out[m % k] += acc[m];
+}
+
+// out[q] = x_q^Ty_q
+template<class X, class Y>
+static inline void seg_block_dot(int n, int k, X x, Y y, FLOAT2 *out) {
+    double acc[VEC_CHUNK] = { 0.0 };
+    int chunk = block_chunk(k);
+    #pragma omp parallel for reduction(+: acc[:VEC_CHUNK]) if(n * k >= VEC_PARALLEL)
+    for (int i = 0; i < n * k; i += chunk) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(chunk, n * k - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) acc[m] += xs[m] * ys[m];
+    }
+    block_fold(k, acc, out);
+}
+
+// y_q = x_q + b[q]*y_q
+template<class X, class Y>
+static inline void seg_block_xpby(int n, int k, X x, const FLOAT2 *b, Y y) {
+    double bs[VEC_CHUNK];
+    int chunk = block_chunk(k);
+    block_spread(k, b, bs);
+    #pragma omp parallel for if(n * k >= VEC_PARALLEL)
+    for (int i = 0; i < n * k; i += chunk) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(chunk, n * k - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = xs[m] + bs[m] * ys[m];
+        y.writeBlock(i, len, ys);
+    }
+}
+
+// y = x + b*y, with out[q] = ||y_q|| (of y as stored)
+template<class X, class Y>
+static inline void seg_block_xpby_norm2(int n, int k, X x, FLOAT2 b, Y y, FLOAT2 *out) {
+    double acc[VEC_CHUNK] = { 0.0 };
+    int chunk = block_chunk(k);
+    #pragma omp parallel for reduction(+: acc[:VEC_CHUNK]) if(n * k >= VEC_PARALLEL)
+    for (int i = 0; i < n * k; i += chunk) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(chunk, n * k - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) ys[m] = xs[m] + b * ys[m];
+        y.writeBlock(i, len, ys);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) acc[m] += ys[m] * ys[m];
+    }
+    block_fold(k, acc, out);
+    for (int q = 0; q < k; q++) out[q] = sqrt(out[q]);
+}
+
+// seg_cg_update for each vector of the block, with its own alpha[q], rz[q] and rr[q]
+template<class V>
+static inline void seg_block_cg_update(int n, int k, const FLOAT2 *alpha, V p, V x, V r, V z, const FLOAT *d, FLOAT2 *rz, FLOAT2 *rr) {
+    double as[VEC_CHUNK], acc_rz[VEC_CHUNK] = { 0.0 }, acc_rr[VEC_CHUNK] = { 0.0 };
+    int chunk = block_chunk(k);
+    block_spread(k, alpha, as);
+    #pragma omp parallel for reduction(+: acc_rz[:VEC_CHUNK], acc_rr[:VEC_CHUNK]) if(n * k >= VEC_PARALLEL)
+    for (int i = 0; i < n * k; i += chunk) {
+        double ps[VEC_CHUNK], xs[VEC_CHUNK], rs[VEC_CHUNK], zs[VEC_CHUNK];
+        int len = std::min(chunk, n * k - i);
+        p.readBlock(i, len, ps);
+        x.readBlock(i, len, xs);
+        for (int m = 0; m < len; m++) xs[m] = xs[m] + ps[m] * as[m];
+        x.writeBlock(i, len, xs);
+
+        z.readBlock(i, len, zs);
+        r.readBlock(i, len, rs);
+        for (int m = 0; m < len; m++) rs[m] = rs[m] + zs[m] * -as[m];
+        r.writeBlock(i, len, rs);
+        r.readBlock(i, len, rs);
+        for (int m = 0; m < len; m++) acc_rr[m] += rs[m] * rs[m];
+        if (d) {
+            // the rows' d, spread over their k values
+            for (int m = 0, row = i / k; m < len; m += k, row++)
+                for (int q = 0; q < k; q++) zs[m + q] = d[row];
+            for (int m = 0; m < len; m++) zs[m] = rs[m] / zs[m];
+            z.writeBlock(i, len, zs);
+            z.readBlock(i, len, zs);
+            for (int m = 0; m < len; m++) acc_rz[m] += rs[m] * zs[m];
+        }
+    }
+    block_fold(k, acc_rr, rr);
+    if (d)
+        block_fold(k, acc_rz, rz);
+    else
+        for (int q = 0; q < k; q++) rz[q] = rr[q];
+}
+
+// max(abs(x - y)), then y = x
+template<class X, class Y>
+static inline DOUBLE seg_max_diff_and_copy(int n, X x, Y y) {
+    double maxv = 0.0;
+    #pragma omp parallel for reduction(max: maxv)
+    for (int i = 0; i < n; i += VEC_CHUNK) {
+        double xs[VEC_CHUNK], ys[VEC_CHUNK];
+        int len = std::min(VEC_CHUNK, n - i);
+        x.readBlock(i, len, xs);
+        y.readBlock(i, len, ys);
+        for (int m = 0; m < len; m++) maxv = std::max(maxv, fabs(xs[m] - ys[m]));
+        y.writeBlock(i, len, xs);
+    }
+    return maxv;
 }
 
 #endif
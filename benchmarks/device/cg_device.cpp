@@ -0,0 +1,231 @@
+#include <iostream>
+#include <chrono>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_device.hpp"
+
+/*
+    Conjugate gradients on a GPU, with the matrix values and the vectors in DeviceSegArrays.
+        ./cg_device [side] [tol]        (default 1000 and 1e-10)
+    The matrix is the 5 point Laplacian of a side x side grid with coefficients that vary from edge to
+    edge, so its values are not exact in the heads, and b = A*1. CG first runs with only the heads on
+    the device, the matrix values included. Its recursive residual goes on falling at the heads long
+    after the true residual b - A x has stopped (x, truncated to a head, cannot take the small updates),
+    so every checkFrequency iterations the true residual is computed, and the controller switches once
+    it falls by less than a quarter between checks (or the recursive one reaches
+    AdaptivePrecisionBound). Then the tails of the values and of b are copied over and combined with
+    the heads, the vectors are promoted, and CG restarts from the residual of x computed at full
+    precision, to tol. The row offsets and column indices (ints) stay on the device throughout. With
+    nvcc or hipcc the kernels run on the GPU; built with g++ (make host) they run on the host.
+    $MANSEG_VALUES saves x and $MANSEG_RESULTS the iterations.
+*/
+
+using namespace std;
+using namespace ManSeg;
+using namespace ManSeg::device;
+
+constexpr int maxIter = 20000;
+constexpr int checkFrequency = 25;
+
+struct Laplacian
+{
+    uint_fast64_t rows;
+    vector<int> offsets, cols;
+    vector<double> values;
+
+    explicit Laplacian(const int& side) :rows((uint_fast64_t)side * side), offsets(1, 0)
+    {
+        for(uint_fast64_t i = 0; i < rows; ++i)
+        {
+            const uint_fast64_t r = i / side, c = i % side;
+            const int64_t neighbours[4] = { r > 0 ? (int64_t)(i - side) : -1, c > 0 ? (int64_t)i - 1 : -1,
+                c + 1 < (uint_fast64_t)side ? (int64_t)i + 1 : -1, r + 1 < (uint_fast64_t)side ? (int64_t)(i + side) : -1 };
+            double diagonal = 0.0;
+            const size_t diagonalAt = cols.size();
+            cols.push_back(i);
+            values.push_back(0.0);
+            for(int k = 0; k < 4; ++k)
+                if(neighbours[k] >= 0)
+                {
+                    // symmetric: the coefficient of an edge depends only on its two ends
+                    const double a = -(1.0 + 1.0 / (1 + (i + neighbours[k]) % 7));
+                    cols.push_back(neighbours[k]);
+                    values.push_back(a);
+                    diagonal -= a;
+                }
+            values[diagonalAt] = diagonal * (1.0 + 1e-4);
+            offsets.push_back(cols.size());
+        }
+    }
+
+    /* bytes read and written by an iteration with values of valueBytes */
+    double iterationBytes(const size_t& valueBytes) const
+    {
+        return cols.size()*(sizeof(int) + 2*valueBytes) + rows*(sizeof(int) + 13*valueBytes);
+    }
+};
+
+/* (b[i] - (Ax)[i])^2, with q = -A x */
+template<class View>
+struct ResidualSquare
+{
+    View q;
+    View b;
+    MANSEG_HD double operator()(const uint_fast64_t& i) const
+    {
+        const double v = q.read(i) + b.read(i);
+        return v * v;
+    }
+};
+
+double seconds(const chrono::high_resolution_clock::time_point& from)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - from).count()*1e-9;
+}
+
+/*
+    CG iterations on A x = b from the residual in r (and p = r), until the relative residual is below tol,
+    or at the heads until control switches on the true residual; iter counts on from its value.
+*/
+template<class Vals, class View>
+double cg(const Laplacian& A, const DeviceBuffer<int>& offsets, const DeviceBuffer<int>& cols, Vals vals,
+    View b, View x, View r, View p, View q, const double& bnorm, const double& tol, int& iter, const PrecisionLevel& level,
+    PrecisionController<StagnationPolicy>& control, ResultsWriter& results)
+{
+    const uint_fast64_t n = A.rows;
+    double rr = dot(r, r, n);
+    double relres = sqrt(rr) / bnorm;
+    auto tmStart = chrono::high_resolution_clock::now();
+    while(iter < maxIter && relres > tol)
+    {
+        spmv(n, offsets.data(), cols.data(), vals, p, q);
+        const double alpha = rr / dot(p, q, n);
+        axpy(alpha, p, x, n);
+        axpy(-alpha, q, r, n);
+        const double rrNext = dot(r, r, n);
+        xpay(r, rrNext / rr, p, n);
+        rr = rrNext;
+        relres = sqrt(rr) / bnorm;
+        ++iter;
+
+        const double tmStep = seconds(tmStart);
+        results.iteration(iter, relres, tmStep, levelName(level), A.iterationBytes(level == PRECISION_HEADS ? sizeof(float) : sizeof(double)));
+        if(iter % 100 == 0)
+            cout << "iteration " << iter << ": residual=" << relres << endl;
+        if(level == PRECISION_HEADS && iter % checkFrequency == 0)
+        {
+            // q is free until the next spmv
+            spmv(n, offsets.data(), cols.data(), vals, x, q, -1.0);
+            const double trueResidual = sqrt(reduce<false>(n, ResidualSquare<View>{ q, b })) / bnorm;
+            if(control.update(trueResidual) != PRECISION_HEADS)
+            {
+                cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+                break;
+            }
+        }
+        tmStart = chrono::high_resolution_clock::now();
+    }
+    return relres;
+}
+
+int main(int argc, char* argv[])
+{
+    const int side = argc > 1 ? atoi(argv[1]) : 1000;
+    const double tol = argc > 2 ? atof(argv[2]) : 1e-10;
+    auto tmStart = chrono::high_resolution_clock::now();
+    const auto totalSt = tmStart;
+    Laplacian A(side);
+    const uint_fast64_t n = A.rows, nnz = A.values.size();
+    ManSegArray hostVals(nnz), hostB(n);
+    for(uint_fast64_t k = 0; k < nnz; ++k)
+        hostVals.pairs.set(k, A.values[k]);
+    double bnorm = 0.0;
+    for(uint_fast64_t i = 0; i < n; ++i)
+    {
+        double s = 0.0;
+        for(int k = A.offsets[i]; k < A.offsets[i + 1]; ++k)
+            s += A.values[k];
+        hostB.pairs.set(i, s);
+        bnorm += s * s;
+    }
+    bnorm = sqrt(bnorm);
+    cout << "Matrix: " << n << " rows, " << nnz << " entries (" << seconds(tmStart) << " seconds)" << endl;
+
+    DeviceBuffer<int> offsets(A.offsets), cols(A.cols);
+    DeviceSegArray vals(nnz), b(n), x(n), r(n), p(n), q(n);
+    vals.uploadHeads(hostVals.heads.getHeads());
+    b.uploadHeads(hostB.heads.getHeads());
+    fill(x.heads(), n, 0.0);
+    copyValues(b.heads(), r.heads(), n);
+    copyValues(b.heads(), p.heads(), n);
+
+    ResultsWriter results("cg_device");
+    results.set("rows", (long)n);
+    results.set("entries", (long)nnz);
+#if defined(MANSEG_DEVICE_CUDA)
+    results.set("backend", "cuda");
+#elif defined(MANSEG_DEVICE_HIP)
+    results.set("backend", "hip");
+#else
+    results.set("backend", "host");
+#endif
+    const size_t indexBytes = (A.offsets.size() + A.cols.size()) * sizeof(int);
+    results.set("device_bytes_heads", (long)(indexBytes + vals.deviceBytes() + 6 * b.deviceBytes()));
+
+    PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25), false);
+    int iter = 0;
+    tmStart = chrono::high_resolution_clock::now();
+    double relres = cg(A, offsets, cols, vals.heads(), b.heads(), x.heads(), r.heads(), p.heads(), q.heads(), bnorm,
+        AdaptivePrecisionBound, iter, PRECISION_HEADS, control, results);
+    const double headsT = seconds(tmStart);
+    cout << "heads: " << iter << " iterations, residual " << relres << ", " << headsT << " seconds" << endl;
+
+    // the tails of the matrix and of b go over now, and are combined with their heads on the device
+    tmStart = chrono::high_resolution_clock::now();
+    vals.uploadTails(hostVals.heads.getTails());
+    b.uploadTails(hostB.heads.getTails());
+    DeviceSegArray* arrays[6] = { &vals, &b, &x, &r, &p, &q };
+    for(int k = 0; k < 6; ++k)
+        arrays[k]->promote();
+    const double switchT = seconds(tmStart);
+    results.set("switch_iter", iter);
+    results.set("switch_time", switchT);
+    results.set("device_bytes_full", (long)(indexBytes + vals.deviceBytes() + 6 * b.deviceBytes()));
+
+    // r = b - A x at full precision, and CG restarts from it
+    tmStart = chrono::high_resolution_clock::now();
+    spmv(n, offsets.data(), cols.data(), vals.full(), x.full(), r.full(), -1.0);
+    axpy(1.0, b.full(), r.full(), n);
+    copyValues(r.full(), p.full(), n);
+    const int headsIter = iter;
+    relres = cg(A, offsets, cols, vals.full(), b.full(), x.full(), r.full(), p.full(), q.full(), bnorm, tol, iter, PRECISION_FULL,
+        control, results);
+    const double fullT = seconds(tmStart);
+    cout << "full: " << (iter - headsIter) << " iterations, residual " << relres << ", " << fullT << " seconds" << endl;
+
+    vector<double> solution(n);
+    x.download(solution.data());
+    double error = 0.0;
+    for(uint_fast64_t i = 0; i < n; ++i)
+        error = max(error, fabs(solution[i] - 1.0));
+    const double totalT = seconds(totalSt);
+    cout << "max error " << error << "\nTotal time:" << totalT << " seconds" << endl;
+    if(relres > tol)
+        cerr << "error: solution has not converged" << endl;
+
+    writeValues(getenv("MANSEG_VALUES"), solution.data(), n);
+    results.finalError(error);
+    results.set("heads_time", headsT);
+    results.set("full_time", fullT);
+    results.set("total_time", totalT);
+    results.write();
+    hostVals.del();
+    hostB.del();
+    return 0;
+}
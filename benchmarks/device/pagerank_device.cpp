@@ -0,0 +1,208 @@
+#include <iostream>
+#include <chrono>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_device.hpp"
+#include "../local_pagerank/cpp/graph_loader.h"
+
+/*
+    PageRank on a GPU: the Jacobi pull iteration of omp_pagerank_manseg, with the ranks, their
+    contributions and the new ranks in DeviceSegArrays. Until the controller switches precision only
+    the heads of the three are on the device, so an iteration moves about half the bytes; at the switch
+    they are promoted in place to doubles and the iteration goes on at full precision.
+        ./pagerank_device <type> <format> <input_file>      e.g. SNAP COO graph.txt, or x CSC graph.csc
+    The ranks have no tails to copy over (the heads iterations never computed any), so the promoted
+    ranks are the heads widened, as after the interim step on the host. The graph (CSC offsets, sources
+    and out-degrees, as ints) stays on the device for the whole run. With nvcc or hipcc the kernels run
+    on the GPU; built with g++ (make host) they run on the host, to check the code and its results.
+    $MANSEG_VALUES saves the ranks and $MANSEG_RESULTS the iterations, as for the other PageRanks.
+*/
+
+using namespace std;
+using namespace ManSeg;
+using namespace ManSeg::device;
+
+constexpr double d = 0.85;
+constexpr double tol = 1e-7;
+constexpr int maxIter = 100;
+
+/* contr[u] = d*pr[u]/outdeg[u]; dangling vertices are never read from */
+template<class In, class Out>
+struct Contributions
+{
+    In pr;
+    const int* outdeg;
+    Out contr;
+    double damping;
+    MANSEG_HD void operator()(const uint_fast64_t& u) const { contr.set(u, damping * (pr.read(u) / outdeg[u])); }
+};
+
+/* adds w to next[i] (the rank lost to dangling vertices, spread evenly) and returns |next[i] - pr[i]| */
+template<class View>
+struct Normalise
+{
+    View pr;
+    View next;
+    double w;
+    MANSEG_HD double operator()(const uint_fast64_t& i) const
+    {
+        next.set(i, next.read(i) + w);
+        return fabs(next.read(i) - pr.read(i));
+    }
+};
+
+struct DeviceGraph
+{
+    int numVertices;
+    int numEdges;
+    vector<int> index, source, outdeg;
+
+    DeviceGraph(const string& type, const string& format, const string& file)
+    {
+        const bool snap = (type.compare("SNAP") == 0);
+        GraphText text(file, format.c_str());
+        const char* p = text.skipLines(text.begin(), 1);
+        // the SNAP descriptor, e.g. "# Nodes: 4 Edges: 5", or the line "numVertices numEdges"
+        const char* end = snap ? text.nextLine(p) : text.end();
+        p = readInt(p, end, numVertices);
+        p = readInt(p, end, numEdges);
+        const char* body = snap ? end : text.nextLine(p);
+
+        index.resize(numVertices + 1);
+        source.resize(numEdges);
+        if(!snap && format.compare("CSC") == 0)
+            readAdjacency(text, body, numVertices, numEdges, index.data(), source.data());
+        else
+        {
+            vector<int> src(numEdges), dst(numEdges);
+            readEdges(text, body, numEdges, numVertices, src.data(), dst.data());
+            groupColumns(numVertices, numEdges, src.data(), dst.data(), index.data(), source.data());
+        }
+        int* degrees = sourceDegrees(numVertices, numEdges, source.data());
+        outdeg.assign(degrees, degrees + numVertices);
+        delete[] degrees;
+    }
+
+    /* bytes read and written by an iteration with values of valueBytes */
+    double iterationBytes(const size_t& valueBytes) const
+    {
+        return numEdges*(sizeof(int) + valueBytes) + numVertices*(2*sizeof(int) + 7*valueBytes);
+    }
+};
+
+/* one iteration from pr into next, using contr; returns sum |next - pr| */
+template<class View>
+double iterate(const DeviceGraph& g, const DeviceBuffer<int>& index, const DeviceBuffer<int>& source, const DeviceBuffer<int>& outdeg,
+    View pr, View contr, View next)
+{
+    const uint_fast64_t n = g.numVertices;
+    forEach(n, Contributions<View, View>{ pr, outdeg.data(), contr, d });
+    spmv(n, index.data(), source.data(), UnitValues(), contr, next);
+    const double w = (1.0 - sum(next, n)) / n;
+    return reduce<false>(n, Normalise<View>{ pr, next, w });
+}
+
+double seconds(const chrono::high_resolution_clock::time_point& from)
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - from).count()*1e-9;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 4)
+    {
+        cerr << "usage: " << argv[0] << " <type> <format> <input_file>" << endl;
+        return 1;
+    }
+    auto tmStart = chrono::high_resolution_clock::now();
+    const auto totalSt = tmStart;
+    DeviceGraph g(argv[1], argv[2], argv[3]);
+    const int n = g.numVertices;
+    cout << "Reading input: " << seconds(tmStart) << " seconds" << endl;
+
+    tmStart = chrono::high_resolution_clock::now();
+    DeviceBuffer<int> index(g.index), source(g.source), outdeg(g.outdeg);
+    DeviceSegArray a(n), b(n), contr(n);
+    DeviceSegArray* pr = &a;
+    DeviceSegArray* next = &b;
+    fill(pr->heads(), n, 1.0 / n);
+    synchronize();
+    cout << "Initialisation: " << seconds(tmStart) << " seconds" << endl;
+
+    ResultsWriter results("pagerank_device");
+    results.set("input", argv[3]);
+    results.set("vertices", n);
+    results.set("edges", g.numEdges);
+#if defined(MANSEG_DEVICE_CUDA)
+    results.set("backend", "cuda");
+#elif defined(MANSEG_DEVICE_HIP)
+    results.set("backend", "hip");
+#else
+    results.set("backend", "host");
+#endif
+    const size_t graphBytes = (g.index.size() + g.source.size() + g.outdeg.size()) * sizeof(int);
+    results.set("device_bytes_heads", (long)(graphBytes + 3 * pr->deviceBytes()));
+
+    PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
+    int iter = 0;
+    double delta = 2.0;
+    tmStart = chrono::high_resolution_clock::now();
+    const auto iterateS = tmStart;
+    while(iter < maxIter) // only the heads are on the device
+    {
+        delta = iterate(g, index, source, outdeg, pr->heads(), contr.heads(), next->heads());
+        ++iter;
+        swap(pr, next);
+
+        const double tmStep = seconds(tmStart);
+        cout << "iteration " << iter << ": delta=" << delta << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_HEADS), g.iterationBytes(sizeof(float)));
+        tmStart = chrono::high_resolution_clock::now();
+        if(control.update(delta) != PRECISION_HEADS)
+        {
+            cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+            break;
+        }
+    }
+
+    cout << "\n=========================\nIncreased Precision\n=========================" << endl;
+    pr->promote();
+    next->promote();
+    contr.promote();
+    results.set("switch_iter", iter);
+    results.set("device_bytes_full", (long)(graphBytes + 3 * pr->deviceBytes()));
+    // at least one iteration at full precision: the heads' delta says nothing of the tails
+    do
+    {
+        delta = iterate(g, index, source, outdeg, pr->full(), contr.full(), next->full());
+        ++iter;
+        swap(pr, next);
+
+        const double tmStep = seconds(tmStart);
+        cout << "iteration " << iter << ": delta=" << delta << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_FULL), g.iterationBytes(sizeof(double)));
+        tmStart = chrono::high_resolution_clock::now();
+    } while(iter < maxIter && delta > tol);
+
+    const double iterateT = seconds(iterateS), totalT = seconds(totalSt);
+    cout << "\nTotal time:" << totalT << " seconds\n"
+        << "Total iterate time:" << iterateT << " seconds" << endl;
+    if(delta > tol)
+        cerr << "error: solution has not converged" << endl;
+
+    vector<double> ranks(n);
+    pr->download(ranks.data());
+    writeValues(getenv("MANSEG_VALUES"), ranks.data(), n);
+    vector<double> reference;
+    if(loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(ranks.data(), n, reference));
+    results.set("total_time", totalT);
+    results.write();
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+* Copyright (c) 2008, BSC (Barcelon Supercomputing Center)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the <organization> nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY BSC ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_grid.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+
+/*
+    The 3-D 7 point stencil on NB x NB x NB bricks of B x B x B points, with zero outside the grid, by
+    Jacobi (a sweep from A into A_new, the average of a point and its six neighbours) or red-black SOR
+    (in place, one grid), from values made as jacobi_mod_omp makes its grid's. Usage:
+        jacobi3d_omp [iterations] [size] [block] [method] [switch] [omega]
+    size (default 256) is the points per side and block (default 32) the points per side of a brick,
+    dividing size. method is jacobi (default) or sor, with omega for sor (default auto, the optimum for
+    the grid, 2 / (1 + sin(pi / (size + 1)))). switch is global (default), the whole grid leaving the
+    heads when the controller switches on the largest change of a point, or brick, a controller for each
+    brick switching on the brick's own.
+    The bricks are the blocks of a ManSegGrid (brick (bk, bi, bj) is block (bk * NB + bi, bj)) without
+    the full doubles: a brick is read and written at its heads until it switches and at its pairs after,
+    whose tails are still zero, so the switch moves no data. A brick's six faces are gathered from its
+    neighbours at the brick's own level, as heads while it is at the heads, 4 bytes a point.
+*/
+
+enum Method { JACOBI, SOR };
+enum Switch { GLOBAL, BRICK };
+
+int NB = 8;
+int B = 32;
+Method METHOD = JACOBI;
+Switch SWITCH = GLOBAL;
+double OMEGA = 1.0;
+
+ManSegGrid A;
+ManSegGrid A_new;
+
+// whether each brick is at the pairs, and its controller for the brick switch
+std::vector<char> atPairs;
+std::vector<PrecisionController<ConfiguredPolicy> > brickControl;
+
+ResultsWriter results("jacobi3d_omp");
+
+long usecs(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+inline ManSegGrid::Block& brick(ManSegGrid& g, int bk, int bi, int bj) { return g[bk * NB + bi][bj]; }
+
+void alloc_and_genmat()
+{
+    int init_val = 1325;
+
+    A.alloc(NB * NB, NB, B * B * B, false);
+    if (METHOD == JACOBI)
+        A_new.alloc(NB * NB, NB, B * B * B, false);
+    for (int bk = 0; bk < NB; bk++)
+        for (int bi = 0; bi < NB; bi++)
+            for (int bj = 0; bj < NB; bj++)
+                for (int p = 0; p < B * B * B; p++)
+                {
+                    init_val = (3125 * init_val) % 65536;
+                    brick(A, bk, bi, bj).heads[p] = (init_val - 32768.0) / 16384.0;
+                }
+}
+
+/*
+    The six faces of brick (bk, bi, bj) of g, read at level into faces (6 * B * B doubles), in the order
+    and layout of BrickHalos; the faces on the edge of the grid are null.
+*/
+template<AccessLevel level>
+BrickHalos gatherFaces(ManSegGrid& g, int bk, int bi, int bj, double* faces)
+{
+    typedef LevelView<level, SlabAllocator> View;
+    BrickHalos h;
+    const int plane = B * B;
+    if (bk > 0)
+        View::of(brick(g, bk - 1, bi, bj)).readBlock((B - 1) * plane, plane, faces);
+    if (bk < NB - 1)
+        View::of(brick(g, bk + 1, bi, bj)).readBlock(0, plane, faces + plane);
+    for (int k = 0; k < B; k++)
+    {
+        if (bi > 0)
+            View::of(brick(g, bk, bi - 1, bj)).readBlock(k * plane + (B - 1) * B, B, faces + 2 * plane + k * B);
+        if (bi < NB - 1)
+            View::of(brick(g, bk, bi + 1, bj)).readBlock(k * plane, B, faces + 3 * plane + k * B);
+    }
+    if (bj > 0)
+    {
+        typename View::type a = View::of(brick(g, bk, bi, bj - 1));
+        for (int k = 0; k < B; k++)
+            for (int i = 0; i < B; i++)
+                faces[4 * plane + k * B + i] = a[k * plane + i * B + B - 1];
+    }
+    if (bj < NB - 1)
+    {
+        typename View::type a = View::of(brick(g, bk, bi, bj + 1));
+        for (int k = 0; k < B; k++)
+            for (int i = 0; i < B; i++)
+                faces[5 * plane + k * B + i] = a[k * plane + i * B];
+    }
+    const bool inside[6] = { bk > 0, bk < NB - 1, bi > 0, bi < NB - 1, bj > 0, bj < NB - 1 };
+    for (int f = 0; f < 6; f++)
+        h.face[f] = inside[f] ? faces + f * plane : nullptr;
+    return h;
+}
+
+// one Jacobi sweep of brick b, or half an SOR sweep of colour, at level; returns the largest change
+template<AccessLevel level>
+double update(int b, int colour)
+{
+    typedef LevelView<level, SlabAllocator> View;
+    static thread_local std::vector<double> faces;
+    faces.resize(6 * B * B);
+    const int bk = b / (NB * NB), bi = (b / NB) % NB, bj = b % NB;
+    BrickHalos h = gatherFaces<level>(A, bk, bi, bj, faces.data());
+    if (METHOD == JACOBI)
+        return stencil7(View::of(brick(A, bk, bi, bj)), View::of(brick(A_new, bk, bi, bj)), B, h);
+    // the colour of the brick's first point, from its global position
+    const int first = (colour + (bk + bi + bj) * B) % 2;
+    return sor7(View::of(brick(A, bk, bi, bj)), B, h, first, OMEGA);
+}
+
+// an iteration over all the bricks, each at its level, with each brick's largest change in brickDelta
+void iterate(std::vector<double>& brickDelta)
+{
+    const int bricks = NB * NB * NB;
+    std::fill(brickDelta.begin(), brickDelta.end(), 0.0);
+    for (int colour = 0; colour < ((METHOD == SOR) ? 2 : 1); colour++)
+    {
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < bricks; b++)
+        {
+            double d = atPairs[b] ? update<ACCESS_PAIRS>(b, colour) : update<ACCESS_HEADS>(b, colour);
+            brickDelta[b] = std::max(brickDelta[b], d);
+        }
+    }
+    if (METHOD == JACOBI)
+        A.swap(A_new);
+}
+
+void compute(int niters)
+{
+    const int bricks = NB * NB * NB;
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(), false, INFINITY);
+    results.set("switch_policy", control.policy().name());
+    results.set("switch_param", control.policy().parameter());
+    atPairs.assign(bricks, 0);
+    if (SWITCH == BRICK)
+        brickControl.assign(bricks, control);
+    std::vector<double> brickDelta(bricks);
+    for (int iters = 1; iters <= niters; iters++)
+    {
+        long iterStart = usecs();
+        int pairBricks = std::count(atPairs.begin(), atPairs.end(), 1);
+        iterate(brickDelta);
+        double delta = *std::max_element(brickDelta.begin(), brickDelta.end());
+        printf("iteration %d: delta = %e\n", iters, delta);
+
+        // per point: Jacobi reads A and writes A_new, SOR reads and writes every row of A for each colour
+        const char* level = (pairBricks == bricks) ? "full" : (pairBricks == 0) ? "heads" : "interim";
+        double passes = (METHOD == JACOBI) ? 2.0 : 4.0;
+        results.iteration(iters, delta, (usecs() - iterStart)*1e-6, level,
+                          passes*(4.0*(bricks - pairBricks) + 8.0*pairBricks)*B*B*B);
+
+        if (SWITCH == GLOBAL)
+        {
+            if (pairBricks == 0 && control.update(delta) != PRECISION_HEADS)
+            {
+                printf("precision switch at iter %d (%s)\n", iters, control.reasonName());
+                atPairs.assign(bricks, 1);
+            }
+            continue;
+        }
+        int switched = 0;
+        for (int b = 0; b < bricks; b++)
+            if (!atPairs[b] && brickControl[b].update(brickDelta[b]) != PRECISION_HEADS)
+            {
+                atPairs[b] = 1;
+                switched++;
+            }
+        if (switched > 0)
+            printf("%d bricks switched at iter %d (%d/%d pairs)\n", switched, iters, pairBricks + switched, bricks);
+    }
+    printf("hit max iters\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int niters = (argc > 1) ? atoi(argv[1]) : 1;
+    int size = (argc > 2) ? atoi(argv[2]) : 256;
+    B = (argc > 3) ? atoi(argv[3]) : 32;
+    if (B <= 0 || size <= 0 || size % B != 0)
+    {
+        fprintf(stderr, "the brick size %d does not divide the grid size %d\n", B, size);
+        return 1;
+    }
+    NB = size / B;
+    const char* method = (argc > 4) ? argv[4] : "jacobi";
+    const char* sw = (argc > 5) ? argv[5] : "global";
+    METHOD = (strcmp(method, "sor") == 0) ? SOR : JACOBI;
+    SWITCH = (strcmp(sw, "brick") == 0) ? BRICK : GLOBAL;
+    if ((METHOD == JACOBI && strcmp(method, "jacobi") != 0) || (SWITCH == GLOBAL && strcmp(sw, "global") != 0))
+    {
+        fprintf(stderr, "the method %s must be jacobi or sor, and the switch %s global or brick\n", method, sw);
+        return 1;
+    }
+    OMEGA = (argc > 6 && strcmp(argv[6], "auto") != 0) ? atof(argv[6]) : 2.0 / (1.0 + sin(M_PI / (size + 1)));
+    if (METHOD == SOR && (OMEGA <= 0.0 || OMEGA >= 2.0))
+    {
+        fprintf(stderr, "the over-relaxation %g must be between 0 and 2\n", OMEGA);
+        return 1;
+    }
+
+    results.set("iterations", niters);
+    results.set("size", size);
+    results.set("block", B);
+    results.set("method", method);
+    results.set("switch", sw);
+    if (METHOD == SOR)
+        results.set("omega", OMEGA);
+    results.set("threads", omp_get_max_threads());
+
+    alloc_and_genmat();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compute(niters);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time_taken = (end.tv_sec - start.tv_sec) * 1e9;
+    time_taken = (time_taken + (end.tv_nsec - start.tv_nsec)) * 1e-9;
+    printf("Running time  = %g %s\n", time_taken, "s");
+
+    // plane by plane, row by row of the whole grid; the pairs are the heads of a brick that did not switch
+    std::vector<double> values;
+    for (int z = 0; z < size; ++z)
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                values.push_back(brick(A, z / B, y / B, x / B).pairs[((z % B) * B + y % B) * B + x % B]);
+    writeValues(getenv("MANSEG_VALUES"), values.data(), values.size());
+    std::vector<double> reference;
+    if (loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(values.data(), values.size(), reference));
+    results.set("pair_bricks", (int)std::count(atPairs.begin(), atPairs.end(), 1));
+    results.set("total_time", time_taken);
+    results.write();
+
+    return 0;
+}
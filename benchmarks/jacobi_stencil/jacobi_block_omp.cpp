@@ -0,0 +1,256 @@
+/*
+* Copyright (c) 2008, BSC (Barcelon Supercomputing Center)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the <organization> nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY BSC ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    jacobi_mod_omp with the precision switch made per block: each block of the grid is
+    promoted from heads to pairs once its own delta is within AdaptivePrecisionBound,
+    rather than the whole grid switching when the global delta is. Usage:
+        jacobi_block_omp [iterations] [check]
+    The convergence check (the global delta, and the blocks' promotions) is made every check
+    sweeps (default 1), and on the last.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include "../../manseglib_adaptive.hpp"
+
+using namespace ManSeg;
+
+#define NB 64
+#define B 64
+
+typedef double fp_type;
+
+typedef fp_type* vin;
+typedef fp_type* vout;
+
+typedef BlockAdaptiveArray<> Grid;
+
+// block (ii, jj) of the NB x NB grid is block ii * NB + jj
+Grid A;
+Grid A_new;
+
+// the largest change of each block in the last sweep, kept by the sweep as it writes
+double blockDelta[NB * NB];
+
+void alloc_and_genmat()
+{
+    int init_val, i, j, ii, jj;
+
+    init_val = 1325;
+
+    A.alloc(NB * NB, B * B);
+    A_new.alloc(NB * NB, B * B);
+
+    for (ii = 0; ii < NB; ii++)
+    {
+        for (jj = 0; jj < NB; jj++)
+        {
+            for (i = 0; i < B; i++)
+            {
+                for (j = 0; j < B; j++)
+                {
+                    init_val = (3125 * init_val) % 65536;
+                    A.write(ii * NB + jj, i * B + j, (fp_type)((init_val - 32768.0) / 16384.0));
+                }
+            }
+        }
+    }
+}
+
+long usecs(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+void clear(vout v)
+{
+    int i;
+    for (i = 0; i < B; i++)
+        v[i] = (fp_type)0.0;
+}
+
+// halos are read at the precision of the neighbouring block
+void getlastrow(int b, vout v) { A.readBlock(b, (B - 1) * B, B, v); }
+void getfirstrow(int b, vout v) { A.readBlock(b, 0, B, v); }
+
+void getlastcol(int b, vout v)
+{
+    for (int i = 0; i < B; i++)
+        v[i] = A.read(b, i * B + B - 1);
+}
+
+void getfirstcol(int b, vout v)
+{
+    for (int i = 0; i < B; i++)
+        v[i] = A.read(b, i * B + 0);
+}
+
+/*
+    One sweep of a block, instantiated for the heads and the pairs views.
+    The block is widened into doubles once and narrowed once. The left and right halos are
+    columns, indexed by row, and the top and bottom halos rows, indexed by column; the edges of
+    the grid read zeros.
+    The block's delta is taken from the doubles as they are computed, rather than by
+    reading both grids again afterwards.
+*/
+struct JacobiKernel
+{
+    void operator()(const uint_fast64_t& b, Grid::HeadsType blk) { sweep(b, blk, A_new.heads(b)); }
+    void operator()(const uint_fast64_t& b, Grid::PairsType blk) { sweep(b, blk, A_new.pairs(b)); }
+
+    template<class View>
+    void sweep(const uint_fast64_t& b, const View& in, View out)
+    {
+        fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
+        fp_type cur[B * B], next[B * B];
+        const int ii = b / NB, jj = b % NB;
+
+        if (ii > 0) getlastrow(b - NB, tophalo); else clear(tophalo);
+        if (jj > 0) getlastcol(b - 1, lefthalo); else clear(lefthalo);
+        if (ii < NB - 1) getfirstrow(b + NB, bottomhalo); else clear(bottomhalo);
+        if (jj < NB - 1) getfirstcol(b + 1, righthalo); else clear(righthalo);
+
+        in.readBlock(0, B * B, cur);
+        double delta = 0.0;
+        for (int i = 0; i < B; i++)
+        {
+            for (int j = 0; j < B; j++)
+            {
+                fp_type left = (j == 0 ? lefthalo[i] : cur[i * B + j - 1]);
+                fp_type top = (i == 0 ? tophalo[j] : cur[(i - 1) * B + j]);
+                fp_type right = (j == B - 1 ? righthalo[i] : cur[i * B + j + 1]);
+                fp_type bottom = (i == B - 1 ? bottomhalo[j] : cur[(i + 1) * B + j]);
+
+                next[i * B + j] = 0.2 * (cur[i * B + j] + left + top + right + bottom);
+                delta = std::max(delta, std::fabs(next[i * B + j] - cur[i * B + j]));
+            }
+        }
+        out.writeBlock(0, B * B, next);
+        blockDelta[b] = delta;
+    }
+};
+
+/* global delta; blocks within the bound are promoted in both grids */
+double maxdelta(int iters)
+{
+    double dmax = -__DBL_MAX__;
+    int switched = 0;
+
+    #pragma omp parallel for schedule(static) reduction(max: dmax) reduction(+: switched)
+    for (int b = 0; b < NB * NB; ++b)
+    {
+        double blockmax = blockDelta[b];
+        if (dmax < blockmax) dmax = blockmax;
+
+        if (A_new.promoteIfConverged(b, blockmax))
+        {
+            A.promote(b);
+            ++switched;
+        }
+    }
+
+    if (switched > 0)
+        printf("%d blocks switched at iter %d (%lu/%d pairs)\n", switched, iters, (unsigned long)A.numPromoted(), NB * NB);
+
+    return dmax;
+}
+
+void compute(int niters, int check)
+{
+    int iters;
+    JacobiKernel kernel;
+
+    double delta = 2.0;
+    double epsilon = 1e-7;
+
+    iters = 0;
+    while(iters < niters)
+    {
+        ++iters;
+
+        A.parallelForEachBlock(kernel);
+
+        if (iters % check == 0 || iters == niters)
+        {
+            delta = maxdelta(iters);
+            printf("iteration %d: delta = %e\n", iters, delta);
+        }
+
+        #pragma omp parallel for schedule(static)
+        for (int b = 0; b < NB * NB; ++b)
+            A.copyBlock(b, A_new);
+    } // iter
+
+    if(iters >= niters)
+        printf("hit max iters\n");
+    if(delta <= epsilon)
+        printf("converged to %e\n", delta);
+}
+
+int main(int argc, char *argv[])
+{
+    int niters, check;
+    struct timespec start, end;
+
+    if (argc > 1)
+    {
+        niters = atoi(argv[1]);
+    }
+    else
+        niters = 1;
+    check = (argc > 2) ? atoi(argv[2]) : 1;
+    if (check < 1)
+    {
+        fprintf(stderr, "the sweeps between convergence checks %d must be at least 1\n", check);
+        return 1;
+    }
+
+    alloc_and_genmat();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compute(niters, check);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time_taken = (end.tv_sec - start.tv_sec) * 1e9;
+    time_taken = (time_taken + (end.tv_nsec - start.tv_nsec)) * 1e-9;
+
+    printf("Running time  = %g %s\n", time_taken, "s");
+
+    A.del();
+    A_new.del();
+
+    return 0;
+}
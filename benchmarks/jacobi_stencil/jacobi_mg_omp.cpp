@@ -0,0 +1,148 @@
+/*
+* Copyright (c) 2008, BSC (Barcelon Supercomputing Center)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the <organization> nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY BSC ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <time.h>
+#include <vector>
+#include <omp.h>
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_multigrid.hpp"
+#include "../../manseglib_results.hpp"
+
+using namespace ManSeg;
+
+/*
+    Multigrid V-cycles on the grid of jacobi_mod_omp: NB x NB blocks of B x B points, from the same
+    starting values, solving 4u - (the four neighbours) = source with zero outside the grid (with
+    source 0 this is the problem jacobi_mod_omp's sweeps converge on). Usage:
+        jacobi_mg_omp [cycles] [size] [block] [source]
+    size (default 4096) and block (default 64) as for jacobi_mod_omp, any block dividing size; source
+    defaults to 1. The finest level is at the heads until the residual stagnates (decreases by less
+    than half a cycle; MANSEG_SWITCH_POLICY and MANSEG_SWITCH_PARAM override this), and at the pairs
+    after; the coarse levels are always at the heads (see manseglib_multigrid.hpp).
+*/
+
+long usecs(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+ResultsWriter results("jacobi_mg_omp");
+
+// the starting values of jacobi_mod_omp, block by block
+void genmat(Multigrid& mg, int NB, int B, double source)
+{
+    int init_val = 1325;
+    for (int ii = 0; ii < NB; ii++)
+        for (int jj = 0; jj < NB; jj++)
+            for (int k = 0; k < B * B; k++)
+            {
+                init_val = (3125 * init_val) % 65536;
+                mg.solution()[ii][jj].heads[k] = (init_val - 32768.0) / 16384.0;
+                mg.rhs()[ii][jj].pairs[k] = source;
+            }
+}
+
+int main(int argc, char *argv[])
+{
+    int ncycles = (argc > 1) ? atoi(argv[1]) : 20;
+    int size = (argc > 2) ? atoi(argv[2]) : 4096;
+    int block = (argc > 3) ? atoi(argv[3]) : 64;
+    double source = (argc > 4) ? atof(argv[4]) : 1.0;
+    if (block <= 0 || size <= 0 || size % block != 0)
+    {
+        fprintf(stderr, "the block size %d does not divide the grid size %d\n", block, size);
+        return 1;
+    }
+    const int NB = size / block;
+
+    results.set("iterations", ncycles);
+    results.set("size", size);
+    results.set("block", block);
+    results.set("source", source);
+    results.set("threads", omp_get_max_threads());
+
+    Multigrid mg(NB, block);
+    genmat(mg, NB, block, source);
+    printf("%d levels, coarsest %d x %d\n", (int)mg.numLevels(), (int)mg.side(mg.numLevels() - 1), (int)mg.side(mg.numLevels() - 1));
+    results.set("levels", (int)mg.numLevels());
+
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(StagnationPolicy(0.5)), false, INFINITY);
+    results.set("switch_policy", control.policy().name());
+    results.set("switch_param", control.policy().parameter());
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const uint_fast64_t before = mg.sweeps(0);
+    for (int c = 1; c <= ncycles; c++)
+    {
+        long cycleStart = usecs();
+        PrecisionLevel level = control.level();
+        uint_fast64_t fineSweeps = mg.sweeps(0);
+        double residual = mg.vcycle(level);
+        fineSweeps = mg.sweeps(0) - fineSweeps;
+        printf("cycle %d: residual = %e\n", c, residual);
+        // per point of the finest level: each sweep reads the values and the right hand side and writes
+        // the next values, and the residual and the correction read two planes and write one; the coarse
+        // levels, a third as many points, are left out
+        double pointBytes = (level == PRECISION_HEADS) ? sizeof(float) : sizeof(double);
+        results.iteration(c, residual, (usecs() - cycleStart)*1e-6, levelName(level),
+                          (3.0*fineSweeps + 5.0)*pointBytes*size*size);
+        if (level == PRECISION_HEADS && control.update(residual) != PRECISION_HEADS)
+            printf("precision switch at cycle %d (%s)\n", c, control.reasonName());
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time_taken = (end.tv_sec - start.tv_sec) * 1e9;
+    time_taken = (time_taken + (end.tv_nsec - start.tv_nsec)) * 1e-9;
+    const double residual = mg.residual(PRECISION_FULL);
+    printf("final residual = %e, %d sweeps of the finest grid\n", residual, (int)(mg.sweeps(0) - before));
+    printf("Running time  = %g %s\n", time_taken, "s");
+
+    // row by row of the whole grid, as jacobi_mod_omp writes its $MANSEG_VALUES
+    std::vector<double> values;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            values.push_back(mg.solution()[row / block][col / block].pairs[(row % block) * block + col % block]);
+    writeValues(getenv("MANSEG_VALUES"), values.data(), values.size());
+    std::vector<double> reference;
+    if (loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(values.data(), values.size(), reference));
+    results.set("switch_iteration", control.switchIteration());
+    results.set("fine_sweeps", (long)(mg.sweeps(0) - before));
+    results.set("final_residual", residual);
+    results.set("total_time", time_taken);
+    results.write();
+
+    return 0;
+}
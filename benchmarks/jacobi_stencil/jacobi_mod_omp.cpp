@@ -30,48 +30,92 @@
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <vector>
+#include <omp.h>
 #include "../../manseglib.hpp"
+#include "../../manseglib_anderson.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_energy.hpp"
+#include "../../manseglib_grid.hpp"
+#include "../../manseglib_memory.hpp"
+#include "../../manseglib_progressive.hpp"
+#include "../../manseglib_refine.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_stencil.hpp"
+#include "../../manseglib_traffic.hpp"
 
 using namespace ManSeg;
 
-#define NB 64
-#define B 64
+/*
+    The grid is NB x NB blocks of B x B points. NB is set at run time from the grid size; B is a
+    template parameter so the loops over a block have constant bounds, with the sizes in
+    JACOBI_BLOCK_SIZES instantiated. Usage:
+        jacobi_mod_omp [iterations] [size] [block] [steps] [schedule] [check]
+    size (default 4096) is the points per side of the grid and block (default 64) the points per side
+    of a block, one of JACOBI_BLOCK_SIZES dividing size, or auto to pick it from the cache sizes.
+    steps (default 1, at most block) is the sweeps done per pass over the grid while at the heads
+    (temporal blocking, see sweepSteps). schedule is static (default), a parallel loop over the blocks
+    per iteration, dataflow, a task per block sweep (see compute_dataflow), or async, chaotic relaxation
+    in place (see compute_async); steps must be 1 for the last two. check (default 1, static only) is
+    the sweeps between convergence checks: the sweep always keeps its blocks' largest changes, but
+    the grid's delta is only reduced, and passed to the controller, at a pass ending on a multiple of
+    check sweeps or the last.
+*/
+#define JACOBI_BLOCK_SIZES(X) X(16) X(32) X(64) X(128) X(256) X(512)
 #define FALSE (0)
 #define TRUE (1)
 
 typedef double fp_type;
 
-typedef fp_type* vin;
 typedef fp_type* vout;
 
-typedef ManSegArray bin;
-typedef ManSegArray binout;
+typedef ManSegGrid::Block bin;
+
+int NB = 64;
+int STEPS = 1;
+int CHECK = 1;
+enum Schedule { STATIC, DATAFLOW, ASYNC };
+Schedule SCHEDULE = STATIC;
 
-ManSegArray A[NB][NB];
-ManSegArray A_new[NB][NB];
+// each grid is one slab, in block order, with every block row first touched by the thread that sweeps it
+typedef ManSegGrid Grid;
+Grid A;
+Grid A_new;
 
 enum Precision { HEADS, PAIRS, INTERIM }; // INTERIM = read heads, write pairs
 
+// the view of a block the kernels use at a precision: the heads, or the full doubles for PAIRS
+template<enum Precision P>
+struct BlockView : LevelView<(P == Precision::HEADS) ? ACCESS_HEADS : ACCESS_FULL, SlabAllocator> {};
+
 Precision MatrixPrecision = Precision::HEADS;
 
+ResultsWriter results("jacobi_mod_omp");
+// RAPL energy by precision level, where the counters can be read
+EnergyPhases energy;
+
+template<int B>
 void alloc_and_genmat()
 {
     int init_val, i, j, ii, jj;
-    fp_type *p, *p_new;
 
     init_val = 1325;
 
+    A.alloc(NB, NB, B * B);
+    // the asynchronous sweeps update A in place
+    if (SCHEDULE != ASYNC)
+        A_new.alloc(NB, NB, B * B);
+    // as allocated, for the memory report: the two grids swap every iteration
+    A.label("A");
+    A_new.label("A_new");
     for (ii = 0; ii < NB; ii++)
     {
         for (jj = 0; jj < NB; jj++)
         {
-            A[ii][jj].alloc(B * B);
-			A[ii][jj].full = new double[B * B];
-            A_new[ii][jj].alloc(B * B);
-			A_new[ii][jj].full = new double[B * B];
-
             for (i = 0; i < B; i++)
             {
                 for (j = 0; j < B; j++)
@@ -92,268 +136,591 @@ long usecs(void)
     return t.tv_sec * 1000000 + t.tv_usec;
 }
 
-void clear(vout v)
-{
-    int i, j, k;
-    for (i = 0; i < B; i++)
-        v[i] = (fp_type)0.0;
-}
-
-template<enum Precision = Precision::PAIRS>
+template<int B, enum Precision P = Precision::PAIRS>
 void getlastrow(bin& A, vout v)
 {
-    int j;
-    for (j = 0; j < B; j++)
-        v[j] = A.full[(B - 1) * B + j];
-}
-template<>
-void getlastrow<Precision::HEADS>(bin& A, vout v)
-{
-    int j;
-    for (j = 0; j < B; j++)
-        v[j] = A.heads[(B - 1) * B + j];
+    BlockView<P>::of(A).readBlock((B - 1) * B, B, v);
 }
 
-template<enum Precision = Precision::PAIRS>
+template<int B, enum Precision P = Precision::PAIRS>
 void getlastcol(bin& A, vout v)
 {
+    typename BlockView<P>::type a = BlockView<P>::of(A);
     int i;
     for (i = 0; i < B; i++)
-        v[i] = A.full[i * B + B - 1];
-}
-template<>
-void getlastcol<Precision::HEADS>(bin& A, vout v)
-{
-    int i;
-    for (i = 0; i < B; i++)
-        v[i] = A.heads[i * B + B - 1];
+        v[i] = a[i * B + B - 1];
 }
 
-template<enum Precision = Precision::PAIRS>
+template<int B, enum Precision P = Precision::PAIRS>
 void getfirstrow(bin& A, vout v)
 {
-    int j;
-    for (j = 0; j < B; j++)
-        v[j] = A.full[0 * B + j];
-}
-template<>
-void getfirstrow<Precision::HEADS>(bin& A, vout v)
-{
-    int j;
-    for (j = 0; j < B; j++)
-        v[j] = A.heads[0 * B + j];
+    BlockView<P>::of(A).readBlock(0, B, v);
 }
 
-template<enum Precision = Precision::PAIRS>
+template<int B, enum Precision P = Precision::PAIRS>
 void getfirstcol(bin& A, vout v)
 {
+    typename BlockView<P>::type a = BlockView<P>::of(A);
     int i;
     for (i = 0; i < B; i++)
-        v[i] = A.full[i * B + 0];
+        v[i] = a[i * B + 0];
 }
-template<>
-void getfirstcol<Precision::HEADS>(bin& A, vout v)
+
+/*
+    Sweeps block (ii, jj) of A into A_new at precision P, returning the largest change of a point.
+    The halos are gathered from the neighbouring blocks; the grid's edges are fixed at zero.
+*/
+template<int B, enum Precision P>
+double sweep(int ii, int jj)
 {
-    int i;
-    for (i = 0; i < B; i++)
-        v[i] = A.heads[i * B + 0];
+    fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
+
+    if (ii > 0)
+        getlastrow<B, P>(A[ii - 1][jj], tophalo);
+    if (jj > 0)
+        getlastcol<B, P>(A[ii][jj - 1], lefthalo);
+    if (ii < NB - 1)
+        getfirstrow<B, P>(A[ii + 1][jj], bottomhalo);
+    if (jj < NB - 1)
+        getfirstcol<B, P>(A[ii][jj + 1], righthalo);
+
+    return stencil5(BlockView<P>::of(A[ii][jj]), BlockView<P>::of(A_new[ii][jj]), B,
+                    (ii > 0) ? tophalo : nullptr, (ii < NB - 1) ? bottomhalo : nullptr,
+                    (jj > 0) ? lefthalo : nullptr, (jj < NB - 1) ? righthalo : nullptr);
 }
 
-template<enum Precision = Precision::PAIRS>
-void jacobi(vin lefthalo, vin tophalo, vin righthalo, vin bottomhalo, 
-                bin& A, binout& A_new, int ii, int jj, int iter)
+/*
+    sweep<B, P> as a Chebyshev step (see chebyshev5): A_new still holds the sweep before A's, and is read
+    a row at a time before it is overwritten, so the three-term recurrence needs no third grid.
+*/
+template<int B, enum Precision P>
+double sweepChebyshev(int ii, int jj, double omega, double gamma)
 {
-    int i, j;
-    fp_type tmp;
-    fp_type left, top, right, bottom;
+    fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
+
+    if (ii > 0)
+        getlastrow<B, P>(A[ii - 1][jj], tophalo);
+    if (jj > 0)
+        getlastcol<B, P>(A[ii][jj - 1], lefthalo);
+    if (ii < NB - 1)
+        getfirstrow<B, P>(A[ii + 1][jj], bottomhalo);
+    if (jj < NB - 1)
+        getfirstcol<B, P>(A[ii][jj + 1], righthalo);
+
+    return chebyshev5(BlockView<P>::of(A[ii][jj]), BlockView<P>::of(A_new[ii][jj]), BlockView<P>::of(A_new[ii][jj]), B,
+                      (ii > 0) ? tophalo : nullptr, (ii < NB - 1) ? bottomhalo : nullptr,
+                      (jj > 0) ? lefthalo : nullptr, (jj < NB - 1) ? righthalo : nullptr, omega, gamma);
+}
 
-    for (i = 0; (i < B); i++)
+/*
+    steps sweeps of block (ii, jj) of A's heads in one pass, into A_new's heads, returning the largest
+    change of a point in the last. A heads block is B*B*4 bytes and stays in cache for all of them:
+    it is widened into a tile with a halo steps points deep from its eight neighbours, advanced with
+    stencil5Steps and stored once, so a pass reads and writes the grid once for steps sweeps, at the
+    cost of recomputing the halos. The tile's sweeps are truncated to heads as the single step sweeps
+    store them, so the values are the same as steps passes of sweep<B, HEADS>.
+*/
+template<int B>
+double sweepSteps(int ii, int jj, int steps)
+{
+    const int width = B + 2 * steps;
+    static thread_local std::vector<double> buffers;
+    // zero outside the grid
+    buffers.assign(2 * width * width, 0.0);
+    double* tile = buffers.data();
+    double* scratch = tile + width * width;
+
+    // rows ii*B - steps to (ii + 1)*B + steps of the grid, each from up to three blocks
+    for (int r = 0; r < width; r++)
     {
-        for (j = 0; j < B; j++)
+        int row = ii * B - steps + r;
+        if (row < 0 || row >= NB * B)
+            continue;
+        for (int dj = -1; dj <= 1; dj++)
         {
-            tmp = A.full[i * B + j];
-            left = (j == 0 ? lefthalo[j] : A.full[i * B + j - 1]);
-            top = (i == 0 ? tophalo[i] : A.full[(i - 1) * B + j]);
-            right = (j == B - 1 ? righthalo[i] : A.full[i * B + j + 1]);
-            bottom = (i == B - 1 ? bottomhalo[i] : A.full[(i + 1) * B + j]);
-
-            A_new.full[i * B + j] = 0.2 * (A.full[i * B + j] + left + top + right + bottom);
+            if (jj + dj < 0 || jj + dj >= NB)
+                continue;
+            int first = (dj < 0) ? B - steps : 0;
+            int last = (dj > 0) ? steps : B;
+            A[row / B][jj + dj].heads.readBlock((row % B) * B + first, last - first,
+                                                tile + r * width + dj * B + steps + first);
         }
     }
+
+    // the points of the tile inside the grid are updated, the zero edges are not
+    int rowBegin = std::max(1, steps - ii * B), rowEnd = std::min(width - 1, (NB - ii) * B + steps);
+    int colBegin = std::max(1, steps - jj * B), colEnd = std::min(width - 1, (NB - jj) * B + steps);
+    double delta = stencil5Steps(tile, scratch, width, steps, rowBegin, rowEnd, colBegin, colEnd, true);
+
+    for (int i = 0; i < B; i++)
+        A_new[ii][jj].heads.writeBlock(i * B, B, tile + (i + steps) * width + steps);
+    return delta;
 }
-template<>
-void jacobi<Precision::HEADS>(vin lefthalo, vin tophalo, vin righthalo, vin bottomhalo, 
-                bin& A, binout& A_new, int ii, int jj, int iter)
+
+/*
+    Late refinement ($MANSEG_REFINE): the full values frozen in refineBase, block after block in grid
+    order, with the heads of A and A_new holding the corrections against it.
+*/
+BaseSnapshot<> refineBase;
+
+inline CorrectedView refineView(Grid& grid, int ii, int jj, int B)
 {
-    int i, j;
-    fp_type tmp;
-    fp_type left, top, right, bottom;
+    return refineBase.view(grid[ii][jj].heads.getHeads(), (uint_fast64_t)(ii * NB + jj) * B * B, B * B);
+}
 
-    for (i = 0; (i < B); i++)
-    {
-        for (j = 0; j < B; j++)
-        {
-            tmp = A.heads[i * B + j];
-            left = (j == 0 ? lefthalo[j] : A.heads[i * B + j - 1]);
-            top = (i == 0 ? tophalo[i] : A.heads[(i - 1) * B + j]);
-            right = (j == B - 1 ? righthalo[i] : A.heads[i * B + j + 1]);
-            bottom = (i == B - 1 ? bottomhalo[i] : A.heads[(i + 1) * B + j]);
+/* sweep<B, PAIRS> on the values refineBase plus A's corrections, into A_new's corrections */
+template<int B>
+double sweepRefine(int ii, int jj)
+{
+    fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
 
-            A_new.heads[i * B + j] = 0.2 * (A.heads[i * B + j] + left + top + right + bottom);
-        }
+    if (ii > 0)
+        refineView(A, ii - 1, jj, B).readBlock((B - 1) * B, B, tophalo);
+    if (jj > 0)
+    {
+        CorrectedView left = refineView(A, ii, jj - 1, B);
+        for (int i = 0; i < B; i++)
+            lefthalo[i] = left[i * B + B - 1];
     }
+    if (ii < NB - 1)
+        refineView(A, ii + 1, jj, B).readBlock(0, B, bottomhalo);
+    if (jj < NB - 1)
+    {
+        CorrectedView right = refineView(A, ii, jj + 1, B);
+        for (int i = 0; i < B; i++)
+            righthalo[i] = right[i * B];
+    }
+
+    return stencil5(refineView(A, ii, jj, B), refineView(A_new, ii, jj, B), B,
+                    (ii > 0) ? tophalo : nullptr, (ii < NB - 1) ? bottomhalo : nullptr,
+                    (jj > 0) ? lefthalo : nullptr, (jj < NB - 1) ? righthalo : nullptr);
 }
 
-template<class Arr>
-inline double blockdelta(Arr& A_new, Arr& A)
+/*
+    Sweeps block (ii, jj) of in into out, each neighbour's halo read at the block's own precision:
+    inHeads[i * NB + j] is true while block (i, j) of in holds its newest values in its heads. The
+    result is stored in the heads if toHeads, otherwise in the full doubles (from the heads of a block
+    still at the heads, the interim step).
+*/
+template<int B>
+double sweepBlock(Grid& in, Grid& out, const std::vector<char>& inHeads, bool toHeads, int ii, int jj)
 {
-	double delta = -__DBL_MAX__;
-	for (int i = 0; (i < B); ++i)
+    fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
+    auto heads = [&](int i, int j) { return inHeads[i * NB + j] != 0; };
+
+    if (ii > 0)
+        heads(ii - 1, jj) ? getlastrow<B, Precision::HEADS>(in[ii - 1][jj], tophalo) : getlastrow<B>(in[ii - 1][jj], tophalo);
+    if (jj > 0)
+        heads(ii, jj - 1) ? getlastcol<B, Precision::HEADS>(in[ii][jj - 1], lefthalo) : getlastcol<B>(in[ii][jj - 1], lefthalo);
+    if (ii < NB - 1)
+        heads(ii + 1, jj) ? getfirstrow<B, Precision::HEADS>(in[ii + 1][jj], bottomhalo) : getfirstrow<B>(in[ii + 1][jj], bottomhalo);
+    if (jj < NB - 1)
+        heads(ii, jj + 1) ? getfirstcol<B, Precision::HEADS>(in[ii][jj + 1], righthalo) : getfirstcol<B>(in[ii][jj + 1], righthalo);
+
+    const fp_type* top = (ii > 0) ? tophalo : nullptr;
+    const fp_type* bottom = (ii < NB - 1) ? bottomhalo : nullptr;
+    const fp_type* left = (jj > 0) ? lefthalo : nullptr;
+    const fp_type* right = (jj < NB - 1) ? righthalo : nullptr;
+    if (toHeads)
+        return stencil5(BlockView<Precision::HEADS>::of(in[ii][jj]), BlockView<Precision::HEADS>::of(out[ii][jj]),
+                        B, top, bottom, left, right);
+    if (heads(ii, jj))
+        return stencil5(BlockView<Precision::HEADS>::of(in[ii][jj]), BlockView<Precision::PAIRS>::of(out[ii][jj]),
+                        B, top, bottom, left, right);
+    return stencil5(BlockView<Precision::PAIRS>::of(in[ii][jj]), BlockView<Precision::PAIRS>::of(out[ii][jj]),
+                    B, top, bottom, left, right);
+}
+
+/*
+    Dataflow schedule: the sweep of a block in iteration t is a task that depends on the sweeps of
+    the block and its four neighbours in iteration t - 1, which wrote its input and were the last to
+    read the block it overwrites. There is no barrier between iterations; a thread moves on to any
+    block whose neighbours are done, so the sweeps of several iterations overlap.
+    The delta is checked asynchronously: the task that completes an iteration (the last of its blocks)
+    passes the iteration's delta to the controller, in iteration order. Precision is per block: once
+    the controller switches, each block goes to full precision at its next sweep to start (the
+    interim step), while sweeps already running finish at the heads, so no thread waits for the
+    transition. Which iteration a block switches in depends on the timing, so the values after the
+    switch are not reproducible from run to run.
+*/
+template<int B>
+void compute_dataflow(int niters)
+{
+	PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(), false, INFINITY);
+	results.set("switch_policy", control.policy().name());
+	results.set("switch_param", control.policy().parameter());
+
+	// iteration t reads grid[(t - 1) % 2] and writes grid[t % 2]
+	Grid* grid[2] = { &A, &A_new };
+	// whether each block of a grid holds its newest values in its heads
+	std::vector<char> heads[2] = { std::vector<char>(NB * NB, 1), std::vector<char>(NB * NB, 1) };
+	// the tasks' dependences, a block's sweep into each grid, with a ring of unused ones for the
+	// neighbours of the edge blocks
+	const int W = NB + 2;
+	std::vector<char> ready[2] = { std::vector<char>(W * W), std::vector<char>(W * W) };
+
+	// per iteration: largest change, blocks swept, and blocks swept at the heads and interim
+	std::vector<double> iterDelta(niters + 1, 0.0);
+	std::vector<int> done(niters + 1, 0), headsBlocks(niters + 1, 0), interimBlocks(niters + 1, 0);
+	// the last iteration at the heads, niters until the switch
+	int switchAt = niters;
+	int checked = 1;
+	long lastDone = usecs();
+
+	#pragma omp parallel
+	#pragma omp single
+	for (int t = 1; t <= niters; t++)
 	{
-		for (int j = 0; j < B; ++j)
+		const int src = (t - 1) % 2, dst = t % 2;
+		char* in = ready[src].data();
+		char* out = ready[dst].data();
+		for (int ii = 0; ii < NB; ii++)
 		{
-			double diff = fabs(A_new[i * B + j] - A[i * B + j]);
-			if(diff > delta) delta = diff;
+			for (int jj = 0; jj < NB; jj++)
+			{
+				const int c = (ii + 1) * W + jj + 1;
+				#pragma omp task firstprivate(t, src, dst, ii, jj, c) shared(grid, heads, iterDelta, done, headsBlocks, interimBlocks, switchAt, checked, lastDone, control) \
+					depend(in: in[c], in[c - 1], in[c + 1], in[c - W], in[c + W]) depend(out: out[c])
+				{
+					int last;
+					#pragma omp atomic read
+					last = switchAt;
+					const bool toHeads = t <= last;
+					const bool fromHeads = heads[src][ii * NB + jj] != 0;
+					double blockmax = sweepBlock<B>(*grid[src], *grid[dst], heads[src], toHeads, ii, jj);
+					heads[dst][ii * NB + jj] = toHeads;
+
+					#pragma omp critical(jacobi_dataflow)
+					{
+						if (iterDelta[t] < blockmax) iterDelta[t] = blockmax;
+						if (toHeads) headsBlocks[t]++;
+						else if (fromHeads) interimBlocks[t]++;
+						done[t]++;
+						// the iterations completed by this block, in order
+						while (checked <= niters && done[checked] == NB * NB)
+						{
+							const int it = checked++;
+							long now = usecs();
+							double delta = iterDelta[it];
+							printf("iteration %d: delta = %e\n", it, delta);
+							// per point: the stencil reads A and writes A_new, at the block's precision
+							int fullBlocks = NB * NB - headsBlocks[it] - interimBlocks[it];
+							const char* level = (fullBlocks == NB * NB) ? "full" : (headsBlocks[it] == NB * NB) ? "heads" : "interim";
+							results.iteration(it, delta, (now - lastDone)*1e-6, level,
+											  (8.0*headsBlocks[it] + 12.0*interimBlocks[it] + 16.0*fullBlocks)*B*B);
+							Energy e = energy.lap(level, (now - lastDone)*1e-6);
+							results.energy(e.package, e.dram);
+							lastDone = now;
+
+							if (MatrixPrecision == Precision::HEADS && control.update(delta) != PRECISION_HEADS)
+							{
+								MatrixPrecision = Precision::PAIRS;
+								printf("precision switch at iter %d (%s)\n", it, control.reasonName());
+								#pragma omp atomic write
+								switchAt = it;
+							}
+						}
+					}
+				}
+			}
 		}
 	}
-	return delta;
+
+	// the newest grid becomes A, with the blocks that finished at the heads widened after a switch
+	const int newest = niters % 2;
+	if (newest == 1)
+		A.swap(A_new);
+	if (MatrixPrecision == Precision::PAIRS)
+	{
+		for (int i = 0; i < NB; ++i)
+			for (int j = 0; j < NB; ++j)
+				if (heads[newest][i * NB + j])
+					for (int k = 0; k < B * B; ++k)
+						A[i][j].full[k] = A[i][j].heads[k];
+	}
+	printf("hit max iters\n");
 }
 
-double maxdelta(int iters)
+/*
+    Asynchronous (chaotic) relaxation: each thread sweeps its own block rows niters times, in place,
+    taking the halos from whatever values its neighbours' blocks hold at the time, with no A_new
+    and no barrier. This is not Jacobi (a sweep sees some of the current iteration's values, as
+    Gauss-Seidel does) and the values differ from run to run, but it converges for the same grids,
+    in half the memory, and no thread ever waits for another.
+    Iteration k's delta is the largest change in the k-th sweeps of all the threads, passed to the
+    controller by the thread that completes it, in order, as compute_dataflow does. By default the
+    controller switches once the delta stagnates (decreases by less than 5% a sweep), as the heads
+    stop resolving the changes; MANSEG_SWITCH_POLICY and MANSEG_SWITCH_PARAM override this. Each
+    thread then moves its blocks to full precision at its next sweep.
+*/
+template<int B>
+void compute_async(int niters)
 {
-	double dmax = -__DBL_MAX__;
-
-	#pragma omp parallel for schedule(static) reduction(max: dmax)
-	for (int ii = 0; ii < NB; ++ii)
+	PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(StagnationPolicy(0.05)), false, INFINITY);
+	results.set("switch_policy", control.policy().name());
+	results.set("switch_param", control.policy().parameter());
+
+	// whether each block holds its newest values in its heads
+	std::vector<char> heads(NB * NB, 1);
+	// per iteration: largest change, threads done, and blocks swept at the heads and interim
+	std::vector<double> iterDelta(niters + 1, 0.0);
+	std::vector<int> done(niters + 1, 0), headsBlocks(niters + 1, 0), interimBlocks(niters + 1, 0);
+	int switched = 0;
+	int checked = 1;
+	long lastDone = usecs();
+
+	#pragma omp parallel shared(heads, iterDelta, done, headsBlocks, interimBlocks, switched, checked, lastDone, control)
 	{
-		for (int jj = 0; jj < NB; ++jj)
+		const int threads = omp_get_num_threads();
+		const int id = omp_get_thread_num();
+		const int firstRow = id * NB / threads, lastRow = (id + 1) * NB / threads;
+
+		for (int t = 1; t <= niters; t++)
 		{
-			// if(BlockPrecision[ii][jj] == Precision::HEADS)
-			if(MatrixPrecision == Precision::HEADS)
+			int full;
+			#pragma omp atomic read
+			full = switched;
+			const bool toHeads = !full;
+
+			double delta = 0.0;
+			int headsCount = 0, interimCount = 0;
+			for (int ii = firstRow; ii < lastRow; ii++)
 			{
-				double blockmax = blockdelta(A_new[ii][jj].heads, A[ii][jj].heads);
-				if(dmax < blockmax) dmax = blockmax;
-
-				/* // do copy from heads to full if block delta is small enough
-				if(blockmax < AdaptivePrecisionBound)
+				for (int jj = 0; jj < NB; jj++)
 				{
-					printf("block[%d][%d] switch at iter %d\n", ii, jj, iters);
-					BlockPrecision[ii][jj] = Precision::PAIRS;
-					for (int i = 0; (i < B); ++i)
-						for (int j = 0; j < B; ++j)
-							A_new[ii][jj].full[i * B + j] = A_new[ii][jj].heads[i * B + j];
-				} */
+					const bool fromHeads = heads[ii * NB + jj] != 0;
+					double blockmax = sweepBlock<B>(A, A, heads, toHeads, ii, jj);
+					if (delta < blockmax) delta = blockmax;
+					if (toHeads) headsCount++;
+					else if (fromHeads) interimCount++;
+					#pragma omp atomic write
+					heads[ii * NB + jj] = toHeads;
+				}
 			}
-			// else if(BlockPrecision[ii][jj] == Precision::PAIRS)
-			else if(MatrixPrecision == Precision::PAIRS)
+
+			#pragma omp critical(jacobi_async)
 			{
-				double blockmax = blockdelta(A_new[ii][jj].full, A[ii][jj].full);
-				if(dmax < blockmax) dmax = blockmax;
+				if (iterDelta[t] < delta) iterDelta[t] = delta;
+				headsBlocks[t] += headsCount;
+				interimBlocks[t] += interimCount;
+				done[t]++;
+				// the iterations completed by this thread, in order
+				while (checked <= niters && done[checked] == threads)
+				{
+					const int it = checked++;
+					long now = usecs();
+					double itDelta = iterDelta[it];
+					printf("iteration %d: delta = %e\n", it, itDelta);
+					// per point: the stencil reads and writes the block in place, at the block's precision
+					int fullBlocks = NB * NB - headsBlocks[it] - interimBlocks[it];
+					const char* level = (fullBlocks == NB * NB) ? "full" : (headsBlocks[it] == NB * NB) ? "heads" : "interim";
+					results.iteration(it, itDelta, (now - lastDone)*1e-6, level,
+									  (8.0*headsBlocks[it] + 12.0*interimBlocks[it] + 16.0*fullBlocks)*B*B);
+					Energy e = energy.lap(level, (now - lastDone)*1e-6);
+					results.energy(e.package, e.dram);
+					lastDone = now;
+
+					if (MatrixPrecision == Precision::HEADS && control.update(itDelta) != PRECISION_HEADS)
+					{
+						MatrixPrecision = Precision::PAIRS;
+						printf("precision switch at iter %d (%s)\n", it, control.reasonName());
+						#pragma omp atomic write
+						switched = 1;
+					}
+				}
 			}
 		}
 	}
 
-	return dmax;
+	// blocks of threads that finished before seeing the switch are widened
+	if (MatrixPrecision == Precision::PAIRS)
+	{
+		for (int i = 0; i < NB; ++i)
+			for (int j = 0; j < NB; ++j)
+				if (heads[i * NB + j])
+					for (int k = 0; k < B * B; ++k)
+						A[i][j].full[k] = A[i][j].heads[k];
+	}
+	printf("hit max iters\n");
+}
+
+/* the blocks sweep(ii, jj) reads, widened into full first if the widening has not got to them yet */
+inline void widenNeighbourhood(ProgressivePromotion& widening, int ii, int jj)
+{
+    widening.promote(ii * NB + jj);
+    if (ii > 0)
+        widening.promote((ii - 1) * NB + jj);
+    if (jj > 0)
+        widening.promote(ii * NB + jj - 1);
+    if (ii < NB - 1)
+        widening.promote((ii + 1) * NB + jj);
+    if (jj < NB - 1)
+        widening.promote(ii * NB + jj + 1);
+}
+
+/*
+    Mixes the pass just made, A into A_new at precision P, with the passes before it (see
+    AndersonAccelerator): each block is a range of the accelerator, widened to doubles, and A_new's
+    block is overwritten with the mixed values.
+*/
+template<int B, enum Precision P>
+void mixPass(AndersonAccelerator<>& anderson)
+{
+	#pragma omp parallel shared(A, A_new)
+	{
+		std::vector<double> x(B * B), g(B * B);
+		#pragma omp for schedule(static)
+		for (int b = 0; b < NB * NB; b++)
+		{
+			BlockView<P>::of(A[b / NB][b % NB]).readBlock(0, B * B, x.data());
+			BlockView<P>::of(A_new[b / NB][b % NB]).readBlock(0, B * B, g.data());
+			anderson.accumulate(b, (uint_fast64_t)b * B * B, B * B, x.data(), g.data());
+		}
+		#pragma omp single
+		anderson.solve();
+		#pragma omp for schedule(static)
+		for (int b = 0; b < NB * NB; b++)
+		{
+			BlockView<P>::of(A[b / NB][b % NB]).readBlock(0, B * B, x.data());
+			auto next = BlockView<P>::of(A_new[b / NB][b % NB]);
+			next.readBlock(0, B * B, g.data());
+			anderson.apply((uint_fast64_t)b * B * B, B * B, x.data(), g.data(), g.data());
+			next.writeBlock(0, B * B, g.data());
+		}
+	}
 }
 
+template<int B>
 void compute(int niters)
 {
     int iters;
-    int ii, jj;
-    fp_type lefthalo[B], tophalo[B], righthalo[B], bottomhalo[B];
 
 	double delta = 2.0;
 	double epsilon = 1e-7;
+	// the delta is not bounded by 2 here, so the first iteration has no previous delta to compare with
+	PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(), false, INFINITY);
+	results.set("switch_policy", control.policy().name());
+	results.set("switch_param", control.policy().parameter());
+	/*
+		$MANSEG_PROGRESSIVE=1: at the switch A_new's blocks are widened a block at a time (see
+		ProgressivePromotion), by a thread of their own and by the first full sweeps for the blocks they
+		read, rather than in a pass every thread waits for before sweeping again.
+	*/
+	const bool progressive = getenv("MANSEG_PROGRESSIVE") != nullptr && atoi(getenv("MANSEG_PROGRESSIVE")) != 0;
+	results.set("progressive", progressive ? 1L : 0L);
+	std::unique_ptr<ProgressivePromotion> widening;
+	/*
+		$MANSEG_REFINE=k: after k sweeps at full precision the values are frozen as a base (see
+		BaseSnapshot), and the sweeps go on writing only corrections to it, in the heads.
+		$MANSEG_REFINE_REBASE=r folds the corrections into the base every r sweeps (0, the default: never).
+	*/
+	const int refineAfter = (getenv("MANSEG_REFINE") != nullptr) ? atoi(getenv("MANSEG_REFINE")) : 0;
+	const int rebaseEvery = (getenv("MANSEG_REFINE_REBASE") != nullptr) ? atoi(getenv("MANSEG_REFINE_REBASE")) : 0;
+	results.set("refine", (long)refineAfter);
+	results.set("refine_rebase", (long)rebaseEvery);
+	bool refining = false;
+	int fullSweeps = 0, refineSweeps = 0, rebases = 0;
+	/*
+		$MANSEG_CHEBYSHEV=1: single sweeps made Chebyshev steps with the weights of the grid's stencil, their
+		count started again at the switch, where A_new's full values are stale; not once refining
+	*/
+	const bool chebyshev = getenv("MANSEG_CHEBYSHEV") != nullptr && atoi(getenv("MANSEG_CHEBYSHEV")) != 0;
+	const ChebyshevWeights chebyshevWeights = ChebyshevWeights::forStencil5((uint_fast64_t)NB * B);
+	uint_fast64_t chebyshevSweeps = 0;
+	results.set("chebyshev", chebyshev ? 1L : 0L);
+	/*
+		$MANSEG_ANDERSON=m: every pass is mixed with the m before it (see mixPass), its history in heads
+		whatever the precision of the grid, and restarted at the switch; not once refining, whose values
+		are a base and a correction, nor with $MANSEG_CHEBYSHEV.
+	*/
+	const int andersonWindow = (!chebyshev && getenv("MANSEG_ANDERSON") != nullptr) ? atoi(getenv("MANSEG_ANDERSON")) : 0;
+	std::unique_ptr<AndersonAccelerator<> > anderson;
+	if (andersonWindow > 0)
+		anderson.reset(new AndersonAccelerator<>((uint_fast64_t)NB * NB * B * B, andersonWindow, NB * NB));
+	results.set("anderson", (long)andersonWindow);
+	results.set("anderson_bytes", anderson ? (long)anderson->bytes() : 0L);
 
 	iters = 0;
     // for (iters = 0; iters < niters; iters++)
 	// while((delta > epsilon) && (iters < niters))
 	while(iters < niters)
     {
-		++iters;
+		long iterStart = usecs();
+		Traffic::Totals passStart = Traffic::totals();
+		Precision iterPrecision = MatrixPrecision;
+		const bool iterRefine = refining;
 
-        #pragma omp parallel \
-            private(iters, ii, jj, lefthalo, tophalo, righthalo, bottomhalo) \
-            shared(A, A_new) 
-        {
-            #pragma omp for schedule(static)
-            for (ii = 0; ii < NB; ii++)
-            {
-                for (jj = 0; jj < NB; jj++)
-                {
-                //    if(BlockPrecision[ii][jj] == Precision::HEADS)
-                   if(MatrixPrecision == Precision::HEADS)
-				   {
-					    if (ii > 0)
-                        	getlastrow<Precision::HEADS>(A[ii - 1][jj], tophalo);
-						else
-							clear(tophalo);
-
-						if (jj > 0)
-							getlastcol<Precision::HEADS>(A[ii][jj - 1], lefthalo);
-						else
-							clear(lefthalo);
-
-						if (ii < NB - 1)
-							getfirstrow<Precision::HEADS>(A[ii + 1][jj], bottomhalo);
-						else
-							clear(bottomhalo);
-
-						if (jj < NB - 1)
-							getfirstcol<Precision::HEADS>(A[ii][jj + 1], righthalo);
-						else
-							clear(lefthalo);
-
-                        jacobi<Precision::HEADS>(lefthalo, tophalo, righthalo, bottomhalo, A[ii][jj], A_new[ii][jj], ii, jj, iters);
-				   }
-                    else
-					{
-						if (ii > 0)
-                        	getlastrow<Precision::PAIRS>(A[ii - 1][jj], tophalo);
-						else
-							clear(tophalo);
-
-						if (jj > 0)
-							getlastcol<Precision::PAIRS>(A[ii][jj - 1], lefthalo);
-						else
-							clear(lefthalo);
-
-						if (ii < NB - 1)
-							getfirstrow<Precision::PAIRS>(A[ii + 1][jj], bottomhalo);
-						else
-							clear(bottomhalo);
-
-						if (jj < NB - 1)
-							getfirstcol<Precision::PAIRS>(A[ii][jj + 1], righthalo);
-						else
-							clear(lefthalo);
-
-                        jacobi<Precision::PAIRS>(lefthalo, tophalo, righthalo, bottomhalo, A[ii][jj], A_new[ii][jj], ii, jj, iters);
-					}
-                } // jj
-            } // ii
-        } // end parallel
-
-		delta = maxdelta(iters);
-		printf("iteration %d: delta = %e\n", iters, delta);
-		
-		if(MatrixPrecision == Precision::HEADS)
+		// A's corrections are folded into the base; A_new's are overwritten by the sweep
+		if (refining && rebaseEvery > 0 && refineSweeps > 0 && refineSweeps % rebaseEvery == 0)
+		{
+			#pragma omp parallel for schedule(static) shared(A)
+			for (int ii = 0; ii < NB; ii++)
+				for (int jj = 0; jj < NB; jj++)
+					refineBase.rebase((uint_fast64_t)(ii * NB + jj) * B * B, B * B, A[ii][jj].heads.getHeads());
+			rebases++;
+		}
+		// temporal blocking at the heads; single sweeps once the precision is raised
+		int steps = (MatrixPrecision == Precision::HEADS && !chebyshev) ? std::min(STEPS, niters - iters) : 1;
+		const double omega = (chebyshev && !refining) ? chebyshevWeights.omega(++chebyshevSweeps) : 0.0;
+		iters += steps;
+
+		// the sweep computes each block's largest change as it goes; between checks it is not reduced
+		bool checked = (iters / CHECK != (iters - steps) / CHECK) || iters == niters;
+		double passDelta = 0.0;
+		#pragma omp parallel for schedule(static) shared(A, A_new) reduction(max: passDelta)
+		for (int ii = 0; ii < NB; ii++)
 		{
-			// precision switch
-			if(delta <= AdaptivePrecisionBound)
+			for (int jj = 0; jj < NB; jj++)
 			{
-				MatrixPrecision = Precision::PAIRS;
-				printf("precision switch at iter %d\n", iters);
-				#pragma omp parallel for schedule(static) shared(A, A_new)
-				for(int i = 0; i < NB; ++i)
+				if (widening)
+					widenNeighbourhood(*widening, ii, jj);
+				double blockmax = (steps > 1) ? sweepSteps<B>(ii, jj, steps)
+							: (omega != 0.0 && MatrixPrecision == Precision::HEADS) ? sweepChebyshev<B, Precision::HEADS>(ii, jj, omega, chebyshevWeights.gamma())
+							: (omega != 0.0) ? sweepChebyshev<B, Precision::PAIRS>(ii, jj, omega, chebyshevWeights.gamma())
+							: (MatrixPrecision == Precision::HEADS) ? sweep<B, Precision::HEADS>(ii, jj)
+							: refining ? sweepRefine<B>(ii, jj) : sweep<B, Precision::PAIRS>(ii, jj);
+				if (checked && passDelta < blockmax) passDelta = blockmax;
+			}
+		}
+		if (checked)
+		{
+			delta = passDelta;
+			printf("iteration %d: delta = %e\n", iters, delta);
+		}
+		// every block has been read by a full sweep, so widened
+		if (widening)
+		{
+			widening->finish();
+			printf("%lu of %d blocks widened in the background\n", (unsigned long)widening->numBackground(), NB * NB);
+			results.set("progressive_background_blocks", (long)widening->numBackground());
+			widening.reset();
+		}
+
+		if (anderson && !refining)
+		{
+			if (MatrixPrecision == Precision::HEADS)
+				mixPass<B, Precision::HEADS>(*anderson);
+			else
+				mixPass<B, Precision::PAIRS>(*anderson);
+		}
+
+		// precision switch: the newest values, in A_new's heads, are widened into its full doubles
+		if(checked && MatrixPrecision == Precision::HEADS && control.update(delta) != PRECISION_HEADS)
+		{
+			if (anderson)
+				anderson->restart();
+			chebyshevSweeps = 0;
+			MatrixPrecision = Precision::PAIRS;
+			printf("precision switch at iter %d (%s)\n", iters, control.reasonName());
+			if (progressive)
+			{
+				// the blocks stay where they are when the grids are swapped below
+				bin* blocks = A_new[0];
+				widening.reset(new ProgressivePromotion(NB * NB, [blocks](const uint_fast64_t& b)
 				{
-					for(int j = 0; j < NB; ++j)
-					{
-						for(int k = 0; k < B; ++k)
-							for(int l = 0; l < B; ++l)
-								A[i][j].full[k * B + l] = A_new[i][j].heads[k * B + l];
-					}
-				}
+					widenHeads(blocks[b].heads.getHeads(), B * B, blocks[b].full);
+				}));
+				widening->start();
 			}
 			else
 			{
@@ -364,79 +731,201 @@ void compute(int niters)
 					{
 						for(int k = 0; k < B; ++k)
 							for(int l = 0; l < B; ++l)
-								A[i][j].heads[k * B + l] = A_new[i][j].heads[k * B + l];
+								A_new[i][j].full[k * B + l] = A_new[i][j].heads[k * B + l];
 					}
 				}
 			}
 		}
-		else if(MatrixPrecision == Precision::PAIRS)
+
+		// A_new becomes the current grid, and the old grid is overwritten by the next sweep
+		A.swap(A_new);
+
+		if (iterRefine)
+			refineSweeps++;
+		else if (iterPrecision == Precision::PAIRS && refineAfter > 0 && ++fullSweeps == refineAfter)
 		{
-			#pragma omp parallel for schedule(static) shared(A, A_new)
-			for(int i = 0; i < NB; ++i)
-			{
-				for(int j = 0; j < NB; ++j)
+			// A's full values become the base, with A's corrections zero
+			refineBase.alloc((uint_fast64_t)NB * NB * B * B);
+			#pragma omp parallel for schedule(static) shared(A)
+			for (int ii = 0; ii < NB; ii++)
+				for (int jj = 0; jj < NB; jj++)
 				{
-					for(int k = 0; k < B; ++k)
-						for(int l = 0; l < B; ++l)
-							A[i][j].full[k * B + l] = A_new[i][j].full[k * B + l];
+					refineBase.freeze((uint_fast64_t)(ii * NB + jj) * B * B, B * B, A[ii][jj].full);
+					memset(A[ii][jj].heads.getHeads(), 0, B * B * sizeof(float));
 				}
-			}
+			refining = true;
+			printf("refining from iter %d\n", iters);
+			anderson.reset();
+		}
+
+		// per point: the stencil reads A and writes A_new, once for the steps of a pass (or the bytes
+		// counted, with MANSEG_TRAFFIC). The pass's time and bytes are shared between its sweeps, and
+		// only the last of a checked pass has a delta
+		// refining reads the base and a correction and writes a correction, as many bytes as full
+		double pointBytes = (iterPrecision == Precision::HEADS) ? sizeof(float) : sizeof(double);
+		double passBytes = Traffic::enabled ? (double)(Traffic::totals() - passStart).bytes() : 2.0*pointBytes*NB*NB*B*B;
+		double passTime = (usecs() - iterStart)*1e-6;
+		const char* level = (iterPrecision == Precision::HEADS) ? "heads" : iterRefine ? "refine" : "full";
+		Energy passEnergy = energy.lap(level, passTime, steps);
+		for (int s = steps - 1; s >= 0; s--)
+		{
+			results.iteration(iters - s, (s == 0 && checked) ? delta : NAN, passTime / steps, level, passBytes / steps);
+			results.energy(passEnergy.package / steps, passEnergy.dram / steps);
 		}
-		
     } // iter
 
+	// the values, base plus correction, back in A's full doubles
+	if (refining)
+	{
+		#pragma omp parallel for schedule(static) shared(A)
+		for (int ii = 0; ii < NB; ii++)
+			for (int jj = 0; jj < NB; jj++)
+				refineBase.combine((uint_fast64_t)(ii * NB + jj) * B * B, B * B, A[ii][jj].heads.getHeads(), A[ii][jj].full);
+		printf("%d sweeps refined, %d rebases\n", refineSweeps, rebases);
+		results.set("refine_sweeps", (long)refineSweeps);
+		results.set("refine_rebases", (long)rebases);
+		refineBase.free();
+	}
+
 	if(iters >= niters)
 		printf("hit max iters\n");
 	if(delta <= epsilon)
 		printf("converged to %e\n", delta); 
 }
 
-int main(int argc, char *argv[])
+/*
+    Block size for the cache hierarchy: the largest block whose full precision A and A_new blocks
+    (the larger working set, 16 bytes a point) fit in half the L2 cache, so a block sweep and the
+    delta after it stay cache resident alongside the halos and the neighbouring blocks' edges.
+    Blocks are distributed to threads a block row at a time, so a smaller block is preferred while
+    there are fewer block rows than threads. Falls back to 256KB when the L2 size is unknown.
+*/
+int autotune_block(int size, int threads)
 {
-    int niters;
-    struct timespec start, end;
-
-    if (argc > 1)
-    {
-        niters = atoi(argv[1]);
-    }
-    else
-        niters = 1;
+    long cache = 0;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (cache <= 0)
+        cache = 256 * 1024;
+
+    int best = 0;
+#define JACOBI_CANDIDATE(b) \
+    if (size % b == 0 && (best == 0 || (16L * b * b <= cache / 2 && size / b >= threads))) \
+        best = b;
+    JACOBI_BLOCK_SIZES(JACOBI_CANDIDATE)
+#undef JACOBI_CANDIDATE
+    printf("autotuned block size %d for a %ldKB L2 cache and %d threads\n", best, cache / 1024, threads);
+    return best;
+}
 
-    alloc_and_genmat();
+template<int B>
+void run(int niters)
+{
+    alloc_and_genmat<B>();
 
+    struct timespec start, end;
     clock_gettime(CLOCK_MONOTONIC, &start);
-    compute(niters);
+    energy.start();
+    if (SCHEDULE == DATAFLOW)
+        compute_dataflow<B>(niters);
+    else if (SCHEDULE == ASYNC)
+        compute_async<B>(niters);
+    else
+        compute<B>(niters);
     clock_gettime(CLOCK_MONOTONIC, &end);
 
     double time_taken = (end.tv_sec - start.tv_sec) * 1e9;
     time_taken = (time_taken + (end.tv_nsec - start.tv_nsec)) * 1e-9;
 
     printf("Running time  = %g %s\n", time_taken, "s");
+    if (Traffic::enabled)
+    {
+        Traffic::Totals traffic = Traffic::totals();
+        for (int c = 0; c < Traffic::NUM_COUNTERS; c++)
+            results.set(Traffic::counterName((Traffic::Counter)c), (long)traffic[(Traffic::Counter)c]);
+    }
+    energy.print();
+    energy.report(results);
+    if (Memory::enabled)
+    {
+        printf("%s", memoryReport().c_str());
+        results.set("memory_peak_bytes", (long)Memory::peakBytes());
+    }
+
+    // row by row of the whole grid, as jacobi_omp writes its $MANSEG_VALUES, the reference for $MANSEG_REFERENCE
+    std::vector<double> values;
+    for (int row = 0; row < NB * B; ++row)
+        for (int col = 0; col < NB * B; ++col)
+        {
+            bin& block = A[row / B][col / B];
+            int i = (row % B) * B + col % B;
+            values.push_back((MatrixPrecision == Precision::PAIRS) ? (double)block.full[i] : (double)block.heads[i]);
+        }
+    writeValues(getenv("MANSEG_VALUES"), values.data(), values.size());
+    std::vector<double> reference;
+    if (loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(values.data(), values.size(), reference));
+    results.set("total_time", time_taken);
+}
+
+int main(int argc, char *argv[])
+{
+    int niters = (argc > 1) ? atoi(argv[1]) : 1;
+    int size = (argc > 2) ? atoi(argv[2]) : 4096;
+    int block = 64;
+    if (argc > 3)
+        block = (strcmp(argv[3], "auto") == 0) ? autotune_block(size, omp_get_max_threads()) : atoi(argv[3]);
 
-    /* FILE *outFile;
-    outFile = fopen("./jacobi_mod_omp_values.txt", "w");
-    if (outFile == NULL)
+    if (block <= 0 || size <= 0 || size % block != 0)
     {
-        fprintf(stderr, "Error writing to file\n");
+        fprintf(stderr, "the block size %d does not divide the grid size %d\n", block, size);
+        return 1;
     }
-    else
+    NB = size / block;
+    STEPS = (argc > 4) ? atoi(argv[4]) : 1;
+    if (STEPS < 1 || STEPS > block)
+    {
+        fprintf(stderr, "the steps per pass %d must be between 1 and the block size %d\n", STEPS, block);
+        return 1;
+    }
+    const char* schedule = (argc > 5) ? argv[5] : "static";
+    SCHEDULE = (strcmp(schedule, "dataflow") == 0) ? DATAFLOW : (strcmp(schedule, "async") == 0) ? ASYNC : STATIC;
+    if ((SCHEDULE == STATIC && strcmp(schedule, "static") != 0) || (SCHEDULE != STATIC && STEPS != 1))
+    {
+        fprintf(stderr, "the schedule %s must be static, or dataflow or async with 1 step per pass\n", schedule);
+        return 1;
+    }
+    CHECK = (argc > 6) ? atoi(argv[6]) : 1;
+    if (CHECK < 1 || (SCHEDULE != STATIC && CHECK != 1))
     {
-        int ii, jj, i, j;
-        for (ii = 0; ii < NB; ++ii)
-            for (jj = 0; jj < NB; ++jj)
-                // if(BlockPrecision[ii][jj] == Precision::PAIRS)
-                if(MatrixPrecision == Precision::PAIRS)
-					for (i = 0; i < B; ++i)
-						for (j = 0; j < B; ++j)
-							fprintf(outFile, "%.15f\n", (double)(A[ii][jj].full[i * B + j]));
-				else
-					for (i = 0; i < B; ++i)
-						for (j = 0; j < B; ++j)
-							fprintf(outFile, "%.15f\n", (double)(A[ii][jj].heads[i * B + j]));
-
-        fclose(outFile);
-    } */
+        fprintf(stderr, "the sweeps between convergence checks %d must be at least 1, and 1 unless the schedule is static\n", CHECK);
+        return 1;
+    }
+
+    results.set("iterations", niters);
+    results.set("size", size);
+    results.set("block", block);
+    results.set("steps", STEPS);
+    results.set("schedule", schedule);
+    results.set("check", CHECK);
+    results.set("threads", omp_get_max_threads());
+    results.set("numa", getenv("OMP_PLACES") != nullptr ? getenv("OMP_PLACES") : "none");
+    // $MANSEG_HEADS_FLOAT=1: the single step sweeps at the heads in float where a block allows it (see HeadsArithmetic)
+    const bool headsFloat = getenv("MANSEG_HEADS_FLOAT") != nullptr && atoi(getenv("MANSEG_HEADS_FLOAT")) != 0;
+    setHeadsArithmetic(headsFloat ? HEADS_FLOAT : HEADS_DOUBLE);
+    results.set("heads_float", headsFloat ? 1L : 0L);
+
+    switch (block)
+    {
+#define JACOBI_RUN(b) case b: run<b>(niters); break;
+    JACOBI_BLOCK_SIZES(JACOBI_RUN)
+#undef JACOBI_RUN
+    default:
+        fprintf(stderr, "block size %d is not one of the instantiated sizes (JACOBI_BLOCK_SIZES)\n", block);
+        return 1;
+    }
+    results.write();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,419 @@
+/*
+* Copyright (c) 2008, BSC (Barcelon Supercomputing Center)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the <organization> nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY BSC ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    jacobi_mod_omp distributed with MPI: the NB x NB block grid is split into a 2D grid of ranks, each
+    owning a rectangle of blocks that its OpenMP threads sweep. The edges of a rank's rectangle are
+    exchanged with its four neighbours every iteration; while the grid is at the heads they are sent
+    as the heads (32 bits a point, half the bytes of doubles), and once the controller switches they
+    are sent as the full doubles. The exchange is overlapped with the sweep of the blocks that need
+    no remote halo, and the blocks on the edge are swept once it completes.
+    Usage:
+        mpirun -np P jacobi_mpi [iterations] [size] [block]
+    with the same defaults as jacobi_mod_omp; the values are the same as its static schedule's.
+*/
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_grid.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+
+typedef double fp_type;
+typedef ManSegGrid::Block bin;
+
+enum Precision { HEADS, PAIRS };
+
+// sides of a rank's rectangle, and of a block
+enum Side { TOP, BOTTOM, LEFT, RIGHT };
+
+int NB = 64;        // blocks per side of the whole grid
+int B = 64;         // points per side of a block
+
+// this rank's blocks: rows [r0, r1) and columns [c0, c1) of the block grid
+int r0, r1, c0, c1;
+int rows, cols;
+int neighbour[4];   // rank across each side, or MPI_PROC_NULL at the grid's edge
+MPI_Comm grid_comm;
+
+ManSegGrid A;
+ManSegGrid A_new;
+
+Precision MatrixPrecision = Precision::HEADS;
+
+ResultsWriter results("jacobi_mpi");
+
+long usecs(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+/*
+    The halo exchange. send[s] holds this rank's edge on side s, packed as heads (floats) or
+    doubles, and recv[s] the neighbour's edge facing it; ghost[s] is recv[s] widened to doubles,
+    where the sweeps read it.
+*/
+std::vector<char> send[4], recv[4];
+std::vector<double> ghost[4];
+MPI_Request requests[8];
+double haloBytes = 0.0;
+
+// points along side s of the rectangle
+int edgeLength(int s) { return (s == TOP || s == BOTTOM) ? cols * B : rows * B; }
+
+// point k of side s of the rectangle: the block it is in and its index in the block
+void edgePoint(int s, int k, int& i, int& j, int& index)
+{
+    int along = k / B, offset = k % B;
+    switch (s)
+    {
+    case TOP:    i = 0;            j = along;        index = offset; break;
+    case BOTTOM: i = rows - 1;     j = along;        index = (B - 1) * B + offset; break;
+    case LEFT:   i = along;        j = 0;            index = offset * B; break;
+    default:     i = along;        j = cols - 1;     index = offset * B + B - 1; break;
+    }
+}
+
+/* packs the edges of grid g at precision p and starts their exchange */
+void start_exchange(ManSegGrid& g, Precision p)
+{
+    const size_t pointBytes = (p == Precision::HEADS) ? sizeof(float) : sizeof(double);
+    const MPI_Datatype type = (p == Precision::HEADS) ? MPI_FLOAT : MPI_DOUBLE;
+    for (int s = 0; s < 4; s++)
+    {
+        const int n = edgeLength(s);
+        send[s].resize(n * sizeof(double));
+        recv[s].resize(n * sizeof(double));
+        if (neighbour[s] != MPI_PROC_NULL)
+        {
+            float* heads = reinterpret_cast<float*>(send[s].data());
+            double* full = reinterpret_cast<double*>(send[s].data());
+            #pragma omp parallel for schedule(static)
+            for (int k = 0; k < n; k++)
+            {
+                int i, j, index;
+                edgePoint(s, k, i, j, index);
+                if (p == Precision::HEADS)
+                    heads[k] = g[i][j].heads.getHeads()[index];
+                else
+                    full[k] = g[i][j].full[index];
+            }
+            haloBytes += n * pointBytes;
+        }
+        // the edge on side s goes to that neighbour, which receives it as the ghost of the opposite side
+        MPI_Irecv(recv[s].data(), n, type, neighbour[s], s ^ 1, grid_comm, &requests[2 * s]);
+        MPI_Isend(send[s].data(), n, type, neighbour[s], s, grid_comm, &requests[2 * s + 1]);
+    }
+}
+
+/* waits for the exchange and widens the received edges into the ghosts */
+void finish_exchange(Precision p)
+{
+    MPI_Waitall(8, requests, MPI_STATUSES_IGNORE);
+    for (int s = 0; s < 4; s++)
+    {
+        const int n = edgeLength(s);
+        ghost[s].resize(n);
+        if (neighbour[s] == MPI_PROC_NULL)
+            continue;
+        if (p == Precision::HEADS)
+            widenHeads(reinterpret_cast<const float*>(recv[s].data()), n, ghost[s].data());
+        else
+            memcpy(ghost[s].data(), recv[s].data(), n * sizeof(double));
+    }
+}
+
+// the view of a block the kernels use at a precision: the heads, or the full doubles for PAIRS
+template<enum Precision P>
+struct BlockView : LevelView<(P == Precision::HEADS) ? ACCESS_HEADS : ACCESS_FULL, SlabAllocator> {};
+
+/* whether block (i, j) has a neighbour on another rank */
+bool on_edge(int i, int j)
+{
+    return (i == 0 && neighbour[TOP] != MPI_PROC_NULL) || (i == rows - 1 && neighbour[BOTTOM] != MPI_PROC_NULL)
+        || (j == 0 && neighbour[LEFT] != MPI_PROC_NULL) || (j == cols - 1 && neighbour[RIGHT] != MPI_PROC_NULL);
+}
+
+/*
+    Sweeps local block (i, j) of A into A_new at precision P, returning the largest change of a point.
+    The halos come from the neighbouring local blocks, the ghosts of the neighbouring ranks, or are
+    zero at the grid's edges.
+*/
+template<enum Precision P>
+double sweep(int i, int j)
+{
+    static thread_local std::vector<fp_type> halos;
+    halos.resize(4 * B);
+    const fp_type* halo[4] = { nullptr, nullptr, nullptr, nullptr };
+
+    if (i > 0)
+    {
+        BlockView<P>::of(A[i - 1][j]).readBlock((B - 1) * B, B, &halos[TOP * B]);
+        halo[TOP] = &halos[TOP * B];
+    }
+    else if (neighbour[TOP] != MPI_PROC_NULL)
+        halo[TOP] = &ghost[TOP][j * B];
+    if (i < rows - 1)
+    {
+        BlockView<P>::of(A[i + 1][j]).readBlock(0, B, &halos[BOTTOM * B]);
+        halo[BOTTOM] = &halos[BOTTOM * B];
+    }
+    else if (neighbour[BOTTOM] != MPI_PROC_NULL)
+        halo[BOTTOM] = &ghost[BOTTOM][j * B];
+    if (j > 0)
+    {
+        typename BlockView<P>::type a = BlockView<P>::of(A[i][j - 1]);
+        for (int k = 0; k < B; k++)
+            halos[LEFT * B + k] = a[k * B + B - 1];
+        halo[LEFT] = &halos[LEFT * B];
+    }
+    else if (neighbour[LEFT] != MPI_PROC_NULL)
+        halo[LEFT] = &ghost[LEFT][i * B];
+    if (j < cols - 1)
+    {
+        typename BlockView<P>::type a = BlockView<P>::of(A[i][j + 1]);
+        for (int k = 0; k < B; k++)
+            halos[RIGHT * B + k] = a[k * B];
+        halo[RIGHT] = &halos[RIGHT * B];
+    }
+    else if (neighbour[RIGHT] != MPI_PROC_NULL)
+        halo[RIGHT] = &ghost[RIGHT][i * B];
+
+    return stencil5(BlockView<P>::of(A[i][j]), BlockView<P>::of(A_new[i][j]), B,
+                    halo[TOP], halo[BOTTOM], halo[LEFT], halo[RIGHT]);
+}
+
+/* sweeps the local blocks that are (edge true) or are not on an edge shared with another rank */
+template<enum Precision P>
+double sweep_blocks(bool edge)
+{
+    double delta = 0.0;
+    #pragma omp parallel for schedule(static) collapse(2) reduction(max: delta)
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            if (on_edge(i, j) != edge)
+                continue;
+            double blockmax = sweep<P>(i, j);
+            if (delta < blockmax) delta = blockmax;
+        }
+    }
+    return delta;
+}
+
+void alloc_and_genmat()
+{
+    A.alloc(rows, cols, B * B);
+    A_new.alloc(rows, cols, B * B);
+
+    // the whole grid's sequence, as jacobi_mod_omp generates it, keeping this rank's blocks
+    int init_val = 1325;
+    for (int ii = 0; ii < NB; ii++)
+        for (int jj = 0; jj < NB; jj++)
+        {
+            const bool mine = ii >= r0 && ii < r1 && jj >= c0 && jj < c1;
+            for (int k = 0; k < B * B; k++)
+            {
+                init_val = (3125 * init_val) % 65536;
+                if (mine)
+                    A[ii - r0][jj - c0].heads[k] = (fp_type)((init_val - 32768.0) / 16384.0);
+            }
+        }
+}
+
+void compute(int niters, int rank)
+{
+    double delta = 2.0;
+    // the delta is not bounded by 2 here, so the first iteration has no previous delta to compare with
+    // every rank runs the controller on the same global deltas, so all switch together
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(), false, INFINITY);
+    results.set("switch_policy", control.policy().name());
+    results.set("switch_param", control.policy().parameter());
+
+    for (int iters = 1; iters <= niters; iters++)
+    {
+        long iterStart = usecs();
+        Precision iterPrecision = MatrixPrecision;
+
+        // the blocks inside the rectangle are swept while the edges are in flight
+        start_exchange(A, iterPrecision);
+        double local = (iterPrecision == Precision::HEADS) ? sweep_blocks<Precision::HEADS>(false)
+                                                           : sweep_blocks<Precision::PAIRS>(false);
+        finish_exchange(iterPrecision);
+        local = std::max(local, (iterPrecision == Precision::HEADS) ? sweep_blocks<Precision::HEADS>(true)
+                                                                    : sweep_blocks<Precision::PAIRS>(true));
+        MPI_Allreduce(&local, &delta, 1, MPI_DOUBLE, MPI_MAX, grid_comm);
+        if (rank == 0)
+            printf("iteration %d: delta = %e\n", iters, delta);
+
+        // precision switch: the newest values, in A_new's heads, are widened into its full doubles
+        if (MatrixPrecision == Precision::HEADS && control.update(delta) != PRECISION_HEADS)
+        {
+            MatrixPrecision = Precision::PAIRS;
+            if (rank == 0)
+                printf("precision switch at iter %d (%s)\n", iters, control.reasonName());
+            #pragma omp parallel for schedule(static) collapse(2)
+            for (int i = 0; i < rows; ++i)
+                for (int j = 0; j < cols; ++j)
+                    for (int k = 0; k < B * B; ++k)
+                        A_new[i][j].full[k] = A_new[i][j].heads[k];
+        }
+
+        // A_new becomes the current grid, and the old grid is overwritten by the next sweep
+        A.swap(A_new);
+
+        // per point of the whole grid: the stencil reads A and writes A_new
+        double pointBytes = (iterPrecision == Precision::HEADS) ? sizeof(float) : sizeof(double);
+        results.iteration(iters, delta, (usecs() - iterStart)*1e-6, (iterPrecision == Precision::HEADS) ? "heads" : "full",
+                          2.0*pointBytes*NB*NB*B*B);
+    }
+    if (rank == 0)
+        printf("hit max iters\n");
+}
+
+/* the whole grid row by row on rank 0, as jacobi_mod_omp writes it; empty on the other ranks */
+std::vector<double> gather_values(int rank, int ranks)
+{
+    std::vector<double> local;
+    local.reserve((size_t)rows * cols * B * B);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            for (int k = 0; k < B * B; k++)
+                local.push_back((MatrixPrecision == Precision::PAIRS) ? (double)A[i][j].full[k] : (double)A[i][j].heads[k]);
+
+    std::vector<double> values;
+    if (rank != 0)
+    {
+        int extent[4] = { r0, r1, c0, c1 };
+        MPI_Send(extent, 4, MPI_INT, 0, 0, grid_comm);
+        MPI_Send(local.data(), (int)local.size(), MPI_DOUBLE, 0, 1, grid_comm);
+        return values;
+    }
+
+    const int size = NB * B;
+    values.resize((size_t)size * size);
+    for (int from = 0; from < ranks; from++)
+    {
+        int extent[4] = { r0, r1, c0, c1 };
+        std::vector<double> blocks;
+        if (from == 0)
+            blocks.swap(local);
+        else
+        {
+            MPI_Recv(extent, 4, MPI_INT, from, 0, grid_comm, MPI_STATUS_IGNORE);
+            blocks.resize((size_t)(extent[1] - extent[0]) * (extent[3] - extent[2]) * B * B);
+            MPI_Recv(blocks.data(), (int)blocks.size(), MPI_DOUBLE, from, 1, grid_comm, MPI_STATUS_IGNORE);
+        }
+        size_t n = 0;
+        for (int ii = extent[0]; ii < extent[1]; ii++)
+            for (int jj = extent[2]; jj < extent[3]; jj++)
+                for (int k = 0; k < B * B; k++)
+                    values[(size_t)(ii * B + k / B) * size + jj * B + k % B] = blocks[n++];
+    }
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+    int provided, rank, ranks;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    int niters = (argc > 1) ? atoi(argv[1]) : 1;
+    int size = (argc > 2) ? atoi(argv[2]) : 4096;
+    B = (argc > 3) ? atoi(argv[3]) : 64;
+
+    // a 2D grid of ranks, each with at least one block in each direction
+    int dims[2] = { 0, 0 }, periods[2] = { 0, 0 }, coords[2];
+    MPI_Dims_create(ranks, 2, dims);
+    if (B <= 0 || size <= 0 || size % B != 0 || size / B < std::max(dims[0], dims[1]))
+    {
+        fprintf(stderr, "the block size %d must divide the grid size %d into at least %d x %d blocks\n", B, size, dims[0], dims[1]);
+        MPI_Finalize();
+        return 1;
+    }
+    NB = size / B;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 1, &grid_comm);
+    MPI_Comm_rank(grid_comm, &rank);
+    MPI_Cart_coords(grid_comm, rank, 2, coords);
+    MPI_Cart_shift(grid_comm, 0, 1, &neighbour[TOP], &neighbour[BOTTOM]);
+    MPI_Cart_shift(grid_comm, 1, 1, &neighbour[LEFT], &neighbour[RIGHT]);
+    r0 = coords[0] * NB / dims[0];
+    r1 = (coords[0] + 1) * NB / dims[0];
+    c0 = coords[1] * NB / dims[1];
+    c1 = (coords[1] + 1) * NB / dims[1];
+    rows = r1 - r0;
+    cols = c1 - c0;
+
+    results.set("iterations", niters);
+    results.set("size", size);
+    results.set("block", B);
+    results.set("ranks", ranks);
+    results.set("threads", omp_get_max_threads());
+
+    alloc_and_genmat();
+
+    MPI_Barrier(grid_comm);
+    double start = MPI_Wtime();
+    compute(niters, rank);
+    MPI_Barrier(grid_comm);
+    double time_taken = MPI_Wtime() - start;
+
+    double totalHalo = 0.0;
+    MPI_Reduce(&haloBytes, &totalHalo, 1, MPI_DOUBLE, MPI_SUM, 0, grid_comm);
+    std::vector<double> values = gather_values(rank, ranks);
+    if (rank == 0)
+    {
+        printf("Running time  = %g %s\n", time_taken, "s");
+        printf("halo bytes sent = %.0f\n", totalHalo);
+        writeValues(getenv("MANSEG_VALUES"), values.data(), values.size());
+        std::vector<double> reference;
+        if (loadReference(getenv("MANSEG_REFERENCE"), reference))
+            results.finalError(relativeError(values.data(), values.size(), reference));
+        results.set("halo_bytes", totalHalo);
+        results.set("total_time", time_taken);
+        results.write();
+    }
+
+    MPI_Finalize();
+    return 0;
+}
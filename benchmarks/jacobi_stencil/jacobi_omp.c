@@ -25,6 +25,7 @@
 * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,8 +33,12 @@
 #include <math.h>
 #include <time.h>
 
-#define NB 64
-#define B 64
+/*
+    The grid is NB x NB blocks of B x B points, both set at run time:
+        jacobi_omp [iterations] [size] [block]
+    with size (default 4096) the points per side of the grid and block (default 64) of a block,
+    as for jacobi_mod_omp.
+*/
 #define FALSE (0)
 #define TRUE (1)
 
@@ -45,9 +50,33 @@ typedef fp_type *vout;
 typedef fp_type *bin;
 typedef fp_type *binout;
 
-fp_type *A[NB][NB];
-fp_type *A_new[NB][NB];
-fp_type *tmp[NB][NB];
+int NB = 64;
+int B = 64;
+
+fp_type ***A;
+fp_type ***A_new;
+fp_type ***tmp;
+
+fp_type ***alloc_blocks()
+{
+    int ii;
+    fp_type ***M = (fp_type ***)malloc(NB * sizeof(fp_type **));
+    if (M == NULL)
+    {
+        printf("Out of memory\n");
+        exit(1);
+    }
+    for (ii = 0; ii < NB; ii++)
+    {
+        M[ii] = (fp_type **)malloc(NB * sizeof(fp_type *));
+        if (M[ii] == NULL)
+        {
+            printf("Out of memory\n");
+            exit(1);
+        }
+    }
+    return M;
+}
 
 void alloc_and_genmat()
 {
@@ -56,6 +85,9 @@ void alloc_and_genmat()
 
     init_val = 1325;
 
+    A = alloc_blocks();
+    A_new = alloc_blocks();
+    tmp = alloc_blocks();
     for (ii = 0; ii < NB; ii++)
     {
         for (jj = 0; jj < NB; jj++)
@@ -141,10 +173,10 @@ void jacobi(vin lefthalo, vin tophalo, vin righthalo, vin bottomhalo, bin A, bin
         for (j = 0; j < B; j++)
         {
             tmp = A[i * B + j];
-            left = (j == 0 ? lefthalo[j] : A[i * B + j - 1]);
-            top = (i == 0 ? tophalo[i] : A[(i - 1) * B + j]);
+            left = (j == 0 ? lefthalo[i] : A[i * B + j - 1]);
+            top = (i == 0 ? tophalo[j] : A[(i - 1) * B + j]);
             right = (j == B - 1 ? righthalo[i] : A[i * B + j + 1]);
-            bottom = (i == B - 1 ? bottomhalo[i] : A[(i + 1) * B + j]);
+            bottom = (i == B - 1 ? bottomhalo[j] : A[(i + 1) * B + j]);
 
             A_new[i * B + j] = 0.2 * (A[i * B + j] + left + top + right + bottom);
         }
@@ -216,7 +248,7 @@ void compute(int niters)
                     if (jj < NB - 1)
                         getfirstcol(A[ii][jj + 1], righthalo);
                     else
-                        clear(lefthalo);
+                        clear(righthalo);
 
                     jacobi(lefthalo, tophalo, righthalo, bottomhalo, A[ii][jj], A_new[ii][jj]);
                 } // jj
@@ -226,20 +258,10 @@ void compute(int niters)
 		delta = maxdelta();
 		printf("iteration %d: delta = %e\n", iters, delta);
 
-		// yes, this is an inefficient copy
-		// however, the library version requires you to do a copy in this way
-		// on all of the component parts to avoid segmentation fault
-		#pragma omp parallel for schedule(static) shared(A, A_new)
-		for(int i = 0; i < NB; ++i)
-		{
-			for(int j = 0; j < NB; ++j)
-			{
-				for(int k = 0; k < B; ++k)
-					for(int l = 0; l < B; ++l)
-						A[i][j][k * B + l] = A_new[i][j][k * B + l];
-			}
-		}
-			
+		// A_new becomes the current grid, and the old grid is overwritten by the next sweep
+		fp_type ***swap = A;
+		A = A_new;
+		A_new = swap;
     } // iter
 }
 
@@ -256,6 +278,15 @@ int main(int argc, char *argv[])
     }
     else
         niters = 1;
+    int size = (argc > 2) ? atoi(argv[2]) : 4096;
+    if (argc > 3)
+        B = atoi(argv[3]);
+    if (B <= 0 || size <= 0 || size % B != 0)
+    {
+        fprintf(stderr, "the block size %d does not divide the grid size %d\n", B, size);
+        return 1;
+    }
+    NB = size / B;
 
     alloc_and_genmat();
 
@@ -268,6 +299,38 @@ int main(int argc, char *argv[])
 
     printf("Running time  = %g %s\n", time_taken, "s");
 
+    /*
+        $MANSEG_VALUES saves the result row by row of the whole grid, the reference for jacobi_mod_omp's $MANSEG_REFERENCE.
+        A name ending in .bin gives manseglib_results.hpp's binary format, written a grid row at a time.
+    */
+    const char *valuesPath = getenv("MANSEG_VALUES");
+    size_t pathLength = valuesPath ? strlen(valuesPath) : 0;
+    int binary = pathLength >= 4 && strcmp(valuesPath + pathLength - 4, ".bin") == 0;
+    FILE *valuesFile = valuesPath ? fopen(valuesPath, binary ? "wb" : "w") : NULL;
+    if (valuesFile != NULL)
+    {
+        int row, col;
+        if (binary)
+        {
+            uint64_t count = (uint64_t)NB * B * NB * B;
+            fp_type *line = malloc(NB * B * sizeof(fp_type));
+            fwrite("MSVALUES", 1, 8, valuesFile);
+            fwrite(&count, sizeof(count), 1, valuesFile);
+            for (row = 0; row < NB * B; ++row)
+            {
+                for (col = 0; col < NB * B; ++col)
+                    line[col] = A[row / B][col / B][(row % B) * B + col % B];
+                fwrite(line, sizeof(fp_type), NB * B, valuesFile);
+            }
+            free(line);
+        }
+        else
+            for (row = 0; row < NB * B; ++row)
+                for (col = 0; col < NB * B; ++col)
+                    fprintf(valuesFile, "%.17g\n", A[row / B][col / B][(row % B) * B + col % B]);
+        fclose(valuesFile);
+    }
+
     /* FILE *outFile;
     outFile = fopen("./jacobi_omp_values.txt", "w");
     if (outFile == NULL)
@@ -0,0 +1,211 @@
+/*
+* Copyright (c) 2008, BSC (Barcelon Supercomputing Center)
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of the <organization> nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY BSC ''AS IS'' AND ANY
+* EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL <copyright holder> BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_grid.hpp"
+#include "../../manseglib_results.hpp"
+#include "../../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+
+/*
+    Red-black SOR on the grid of jacobi_mod_omp, in place: NB x NB blocks of B x B points, from the same
+    starting values, converging on the same fixed point (zero, with the zero boundary). Usage:
+        jacobi_sor_omp [iterations] [size] [block] [omega]
+    size (default 4096) and block (default 64) as for jacobi_mod_omp, any block dividing size. omega
+    (default auto) is the over-relaxation, between 0 and 2: 1 is Gauss-Seidel, and auto the optimum for
+    the grid, 2 / (1 + sin(pi / (size + 1))).
+    An iteration over-relaxes the red points (row + column even) of every block, then the black. Every
+    neighbour of a point is of the other colour, so each colour is a parallel loop over the blocks with
+    the halos gathered as it goes (see sor5). There is one grid, with no full doubles: the heads until
+    the controller switches, and the pairs after it, whose tails are still zero, so the switch moves
+    no data. That is 8 bytes a point, where jacobi_mod_omp's A and A_new take 32.
+*/
+
+typedef ManSegGrid::Block bin;
+
+int NB = 64;
+int B = 64;
+double OMEGA = 1.0;
+
+ManSegGrid A;
+
+ResultsWriter results("jacobi_sor_omp");
+
+long usecs(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+// the starting values of jacobi_mod_omp, at the heads
+void alloc_and_genmat()
+{
+    int init_val = 1325;
+
+    A.alloc(NB, NB, B * B, false);
+    for (int ii = 0; ii < NB; ii++)
+        for (int jj = 0; jj < NB; jj++)
+            for (int k = 0; k < B * B; k++)
+            {
+                init_val = (3125 * init_val) % 65536;
+                A[ii][jj].heads[k] = (init_val - 32768.0) / 16384.0;
+            }
+}
+
+/*
+    Over-relaxes the points of colour (0 red, 1 black) of block (ii, jj) at level, returning the largest
+    change of a point. The halos hold the other colour, which no block is updating.
+*/
+template<AccessLevel level>
+double relax(int ii, int jj, int colour)
+{
+    typedef LevelView<level, SlabAllocator> View;
+    static thread_local std::vector<double> halos;
+    halos.resize(4 * B);
+    double* top = halos.data();
+    double* bottom = top + B;
+    double* left = bottom + B;
+    double* right = left + B;
+    if (ii > 0)
+        View::of(A[ii - 1][jj]).readBlock((B - 1) * B, B, top);
+    if (ii < NB - 1)
+        View::of(A[ii + 1][jj]).readBlock(0, B, bottom);
+    if (jj > 0)
+    {
+        typename View::type a = View::of(A[ii][jj - 1]);
+        for (int i = 0; i < B; i++)
+            left[i] = a[i * B + B - 1];
+    }
+    if (jj < NB - 1)
+    {
+        typename View::type a = View::of(A[ii][jj + 1]);
+        for (int i = 0; i < B; i++)
+            right[i] = a[i * B];
+    }
+    // the colour of the block's first point, from its global row and column
+    const int first = (colour + (ii + jj) * B) % 2;
+    return sor5(View::of(A[ii][jj]), B, (ii > 0) ? top : nullptr, (ii < NB - 1) ? bottom : nullptr,
+                (jj > 0) ? left : nullptr, (jj < NB - 1) ? right : nullptr, first, OMEGA);
+}
+
+template<AccessLevel level>
+double iterate()
+{
+    double delta = 0.0;
+    for (int colour = 0; colour < 2; colour++)
+    {
+        #pragma omp parallel for schedule(static) reduction(max: delta)
+        for (int ii = 0; ii < NB; ii++)
+            for (int jj = 0; jj < NB; jj++)
+                delta = std::max(delta, relax<level>(ii, jj, colour));
+    }
+    return delta;
+}
+
+void compute(int niters)
+{
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment(), false, INFINITY);
+    results.set("switch_policy", control.policy().name());
+    results.set("switch_param", control.policy().parameter());
+    for (int iters = 1; iters <= niters; iters++)
+    {
+        long iterStart = usecs();
+        PrecisionLevel level = control.level();
+        double delta = (level == PRECISION_HEADS) ? iterate<ACCESS_HEADS>() : iterate<ACCESS_PAIRS>();
+        printf("iteration %d: delta = %e\n", iters, delta);
+        // per point: each colour reads and writes every row of the grid, the other colour's points included
+        double pointBytes = (level == PRECISION_HEADS) ? sizeof(float) : sizeof(double);
+        results.iteration(iters, delta, (usecs() - iterStart)*1e-6, levelName(level), 4.0*pointBytes*NB*NB*B*B);
+        if (level == PRECISION_HEADS && control.update(delta) != PRECISION_HEADS)
+            printf("precision switch at iter %d (%s)\n", iters, control.reasonName());
+    }
+    results.set("switch_iteration", control.switchIteration());
+    printf("hit max iters\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int niters = (argc > 1) ? atoi(argv[1]) : 1;
+    int size = (argc > 2) ? atoi(argv[2]) : 4096;
+    B = (argc > 3) ? atoi(argv[3]) : 64;
+    if (B <= 0 || size <= 0 || size % B != 0)
+    {
+        fprintf(stderr, "the block size %d does not divide the grid size %d\n", B, size);
+        return 1;
+    }
+    NB = size / B;
+    OMEGA = (argc > 4 && strcmp(argv[4], "auto") != 0) ? atof(argv[4]) : 2.0 / (1.0 + sin(M_PI / (size + 1)));
+    if (OMEGA <= 0.0 || OMEGA >= 2.0)
+    {
+        fprintf(stderr, "the over-relaxation %g must be between 0 and 2\n", OMEGA);
+        return 1;
+    }
+    printf("omega = %.6f\n", OMEGA);
+
+    results.set("iterations", niters);
+    results.set("size", size);
+    results.set("block", B);
+    results.set("omega", OMEGA);
+    results.set("threads", omp_get_max_threads());
+
+    alloc_and_genmat();
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    compute(niters);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double time_taken = (end.tv_sec - start.tv_sec) * 1e9;
+    time_taken = (time_taken + (end.tv_nsec - start.tv_nsec)) * 1e-9;
+    printf("Running time  = %g %s\n", time_taken, "s");
+
+    // row by row of the whole grid, as jacobi_mod_omp writes its $MANSEG_VALUES; the pairs are the heads before a switch
+    std::vector<double> values;
+    for (int row = 0; row < size; ++row)
+        for (int col = 0; col < size; ++col)
+            values.push_back(A[row / B][col / B].pairs[(row % B) * B + col % B]);
+    writeValues(getenv("MANSEG_VALUES"), values.data(), values.size());
+    std::vector<double> reference;
+    if (loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(values.data(), values.size(), reference));
+    results.set("total_time", time_taken);
+    results.write();
+
+    return 0;
+}
@@ -1,5 +1,13 @@
 #!/bin/bash
 
-echo "diff jacobi_u | jacobi_omp : "
-diff --speed-large-files --strip-trailing-cr --suppress-common-lines \
-    ./jacobi_u.txt ./jacobi_omp.txt | grep '>' -c
\ No newline at end of file
+## jacobi_omp (double) against jacobi_mod_omp, on their binary $MANSEG_VALUES dumps
+## ./test_diff.sh [iterations] [size] [block] [tolerance]
+
+make jacobi_omp jacobi_mod_omp
+make -C ../../bench valdiff
+
+MANSEG_VALUES=./jacobi_omp.bin ./jacobi_omp ${1:-100} ${2:-4096} ${3:-64} > /dev/null
+MANSEG_VALUES=./jacobi_mod_omp.bin ./jacobi_mod_omp ${1:-100} ${2:-4096} ${3:-64} > /dev/null
+
+echo "diff jacobi_omp | jacobi_mod_omp : "
+../../bench/valdiff ./jacobi_mod_omp.bin ./jacobi_omp.bin ${4:-1e-5}
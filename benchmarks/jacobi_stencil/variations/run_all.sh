@@ -1,29 +1,30 @@
 #!/bin/bash
 
-VAR="nb16_b512 nb32_b128 nb32_b256 nb32_b512 nb64_b64 nb64_b128 nb128_b32 nb128_b64 nb256_b32 nb512_b16"
+# runs jacobi_omp and jacobi_mod_omp over a range of tilings of the 4096 x 4096 grid;
+# the programs take the block size on the command line, so one build serves every tiling
+VAR="nb16_b256 nb16_b512 nb32_b128 nb32_b256 nb32_b512 nb64_b64 nb64_b128 nb128_b32 nb128_b64 nb256_b16 nb256_b32 nb512_b16"
 JS="jacobi_omp jacobi_mod_omp"
 
 ITER=10000
 
-for var in $VAR;
-do
-	cd ${var}
-	make $JS
-	cd ..
-done
+make -C .. $JS
 
 echo "finished making"
 echo ""
 
 for var in $VAR;
 do
+	nb=${var%_b*}
+	nb=${nb#nb}
+	b=${var#*_b}
+	mkdir -p ${var}
 	echo "runs for ${var}"
 	date
 	for j in $JS;
 	do
 		echo "start ${j}"
 		date
-		./${var}/${j} $ITER > ./${var}/${j}_out.txt
+		../${j} $ITER $((nb * b)) $b > ./${var}/${j}_out.txt
 		date
 		echo "end ${j}"
 		echo ""
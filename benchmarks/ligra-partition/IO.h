@@ -30,10 +30,18 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <cassert>
+#include <cstring>
+#include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string>
 
+#include <vector>
+#include <algorithm>
+#include <utility>
 #include "parallel.h"
 #include "quickSort.h"
+#include "../../manseglib_mapped.hpp"
 using namespace std;
 
 typedef pair<intE,intE> intPair;
@@ -132,24 +140,126 @@ words stringToWords(char *Str, intT n)
     return words(Str,n,SA,m);
 }
 
+// A text graph file: its header word, and the numbers that follow it
+struct textGraph
+{
+    string header;
+    intT m;     // number of numbers
+    intT* A;    // the numbers, in file order
+    textGraph() : m(0), A(0) {}
+    void del()
+    {
+        delete [] A;
+    }
+};
+
+// bytes of a text graph file parsed by one task of readTextGraph
+#define TEXT_CHUNK (1<<20)
+
+// parses the integer at p (an optional '-', then digits) in the manner of from_chars,
+// without the copy and locale of atol, and returns the character after it
+inline const char* parseInt(const char* p, const char* end, intT &x)
+{
+    bool neg = (p < end && *p == '-');
+    if( neg ) ++p;
+    intT v = 0;
+    for( ; p < end && *p >= '0' && *p <= '9'; ++p )
+        v = 10*v + (*p - '0');
+    x = neg ? -v : v;
+    return p;
+}
+
+// does a word start at S[i]? (the word holding S[i] is counted by the chunk of its first character)
+inline bool wordStart(const char* S, intT i)
+{
+    return !isSpace(S[i]) && (i == 0 || isSpace(S[i-1]));
+}
+
+// Reads a text graph file in parallel: the file is mapped rather than copied, split into
+// TEXT_CHUNK byte chunks, the words starting in each chunk counted, the counts prefix
+// summed into each chunk's first output slot, and then every chunk parsed into its slots.
+// This replaces the serial read and the words pointer array of readStringFromFile/stringToWords.
+textGraph readTextGraph(char *fileName)
+{
+    int fd = open(fileName, O_RDONLY);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) < 0)
+    {
+        std::cout << "Unable to open file: " << fileName << std::endl;
+        abort();
+    }
+    intT n = sb.st_size;
+    textGraph T;
+    if (n == 0)
+    {
+        close(fd);
+        return T;
+    }
+    const char* S = (const char*)mmap(0, n, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (S == MAP_FAILED)
+    {
+        std::cout << "Unable to map file: " << fileName << " (" << strerror(errno) << ")" << std::endl;
+        abort();
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise((void*)S, n, MADV_SEQUENTIAL);
+#endif
+
+    // the header word is not a number
+    intT body = 0;
+    while (body < n && isSpace(S[body])) body++;
+    intT h = body;
+    while (body < n && !isSpace(S[body])) body++;
+    T.header = string(S+h, body-h);
+
+    intT numChunks = (n - body + TEXT_CHUNK - 1) / TEXT_CHUNK;
+    intT* counts = new intT [numChunks+1];
+    {
+        parallel_for (intT k=0; k < numChunks; k++)
+        {
+            intT e = std::min(n, body + (k+1)*(intT)TEXT_CHUNK);
+            intT c = 0;
+            for (intT i = body + k*TEXT_CHUNK; i < e; i++)
+                c += wordStart(S, i);
+            counts[k] = c;
+        }
+    }
+    counts[numChunks] = 0;
+    T.m = sequence::plusScan(counts, counts, numChunks+1);
+    T.A = new intT [T.m];
+    {
+        parallel_for (intT k=0; k < numChunks; k++)
+        {
+            intT e = std::min(n, body + (k+1)*(intT)TEXT_CHUNK);
+            intT* out = T.A + counts[k];
+            for (intT i = body + k*TEXT_CHUNK; i < e; i++)
+                if (wordStart(S, i))
+                    i = parseInt(S+i, S+n, *out++) - S;
+        }
+    }
+    delete [] counts;
+    munmap((void*)S, n);
+    close(fd);
+    return T;
+}
+
 template <class vertex>
 wholeGraph<vertex> readGraphFromFile(char* fname, bool isSymmetric)
 {
-    _seq<char> S = readStringFromFile(fname);
-    words W = stringToWords(S.A, S.n);
+    textGraph W = readTextGraph(fname);
 #ifndef WEIGHTED
-    if (W.Strings[0] != (string) "AdjacencyGraph")
+    if (W.header != (string) "AdjacencyGraph")
 #else
-    if (W.Strings[0] != (string) "WeightedAdjacencyGraph")
+    if (W.header != (string) "WeightedAdjacencyGraph")
 #endif
     {
         cout << "Bad input file" << endl;
         abort();
     }
 
-    intT len = W.m -1;
-    intT n = atol(W.Strings[1]);
-    intT m = atol(W.Strings[2]);
+    intT len = W.m;
+    intT n = W.A[0];
+    intT m = W.A[1];
 #ifndef WEIGHTED
     if (len != n + m + 2)
 #else
@@ -168,20 +278,20 @@ wholeGraph<vertex> readGraphFromFile(char* fname, bool isSymmetric)
     intT* offsets = new intT [n];
     intE* edges = WG.allocatedInplace;
     {
-        parallel_for(intT i=0; i < n; i++) offsets[i] = atol(W.Strings[i + 3]);
+        parallel_for(intT i=0; i < n; i++) offsets[i] = W.A[i + 2];
     }
     {
         parallel_for(intT i=0; i<m; i++)
         {
 #ifndef WEIGHTED
-            edges[i] = atol(W.Strings[i+n+3]);
+            edges[i] = W.A[i+n+2];
 #else
-            edges[2*i] = atol(W.Strings[i+n+3]);
-            edges[2*i+1] = atol(W.Strings[i+n+m+3]);
+            edges[2*i] = W.A[i+n+2];
+            edges[2*i+1] = W.A[i+n+m+2];
 #endif
         }
     }
-    W.del(); // to deal with performance bug in malloc
+    W.del();
     vertex * V = WG.V;
     {
         parallel_for (intT i=0; i < n; i++)
@@ -209,12 +319,11 @@ wholeGraph<vertex> readGraphFromFile(char* fname, bool isSymmetric)
         struct stat buffer;
         if( stat( t_fname, &buffer ) == 0)
         {
-            _seq<char> S = readStringFromFile(t_fname);
-            words W = stringToWords(S.A, S.n);
+            textGraph W = readTextGraph(t_fname);
 #ifndef WEIGHTED
-            if (W.Strings[0] != (string) "AdjacencyGraph")
+            if (W.header != (string) "AdjacencyGraph")
 #else
-            if (W.Strings[0] != (string) "WeightedAdjacencyGraph")
+            if (W.header != (string) "WeightedAdjacencyGraph")
 #endif
             {
                 cout << "Bad input file (header)" << endl;
@@ -222,8 +331,8 @@ wholeGraph<vertex> readGraphFromFile(char* fname, bool isSymmetric)
             }
 
 
-            if( len != W.m-1 || atol(W.Strings[1]) != n
-                    || atol(W.Strings[2]) !=m )
+            if( len != W.m || W.A[0] != n
+                    || W.A[1] !=m )
             {
                 cout << "Transpose not matching input file (n, m)" << endl;
                 abort();
@@ -232,21 +341,21 @@ wholeGraph<vertex> readGraphFromFile(char* fname, bool isSymmetric)
             intE* t_edges = WG.inEdges;
 
             {
-                parallel_for(intT i=0; i < n; i++) offsets[i] = atol(W.Strings[i + 3]);
+                parallel_for(intT i=0; i < n; i++) offsets[i] = W.A[i + 2];
             }
             {
                 parallel_for(intT i=0; i<m; i++)
                 {
 #ifndef WEIGHTED
-                    t_edges[i] = atol(W.Strings[i+n+3]);
+                    t_edges[i] = W.A[i+n+2];
 #else
-                    t_edges[2*i] = atol(W.Strings[i+n+3]);
-                    t_edges[2*i+1] = atol(W.Strings[i+n+m+3]);
+                    t_edges[2*i] = W.A[i+n+2];
+                    t_edges[2*i+1] = W.A[i+n+m+2];
 #endif
                 }
             }
 
-            W.del(); // to deal with performance bug in malloc
+            W.del();
             {
                 parallel_for (intT i=0; i < n; i++)
                 {
@@ -655,10 +764,628 @@ wholeGraph<vertex> readGraphFromGalois(char* fname, bool isSymmetric)
     }
 }
 
+// ======================================================================
+// Binary CSR graph format
+// ======================================================================
+// Written once from any input by GraphToBinary, and read by readGraph with -b
+// (Galois files are still accepted, and told apart by the magic number),
+// so later runs load by copying arrays instead of parsing text or transposing.
+// Every section starts on a 64 byte boundary, in this order:
+//   header            binaryGraphHeader
+//   out-offsets       uint64 [n+1]
+//   out-edges         intE [m]    (uint64 if BG_EDGE64, else uint32)
+//   out-weights       intE [m]    if BG_WEIGHTED
+//   out-degrees       uint64 [n]
+//   in-offsets, in-edges, in-weights, in-degrees, as above, if BG_TRANSPOSE
+//   partition starts  uint64 [numParts+1], as computed by partitionByDegree
+//                     by in-degree, or by out-degree if BG_PARTS_BY_SOURCE
+const char BG_MAGIC[8] = { 'L', 'I', 'G', 'R', 'A', 'B', 'I', 'N' };
+const uint64_t BG_VERSION = 1;
+
+enum binaryGraphFlags
+{
+    BG_SYMMETRIC = 1,
+    BG_WEIGHTED = 2,
+    BG_TRANSPOSE = 4,
+    BG_EDGE64 = 8,
+    BG_PARTS_BY_SOURCE = 16
+};
+
+struct binaryGraphHeader
+{
+    char magic[8];
+    uint64_t version;
+    uint64_t flags;
+    uint64_t n;
+    uint64_t m;
+    uint64_t numParts;
+    uint64_t reserved[2];
+};
+
+// byte offsets of the sections of a binary graph file
+struct binaryGraphLayout
+{
+    uint64_t offsets[2], edges[2], weights[2], degrees[2]; // [0] out, [1] in
+    uint64_t parts;
+    uint64_t size;
+
+    binaryGraphLayout(const binaryGraphHeader &h)
+    {
+        const uint64_t e = (h.flags & BG_EDGE64) ? 8 : 4;
+        uint64_t pos = align(sizeof(binaryGraphHeader));
+        for (int d = 0; d < 2; d++)
+        {
+            const bool present = d == 0 || (h.flags & BG_TRANSPOSE);
+            offsets[d] = pos;
+            if (present) pos = align(pos + 8*(h.n+1));
+            edges[d] = pos;
+            if (present) pos = align(pos + e*h.m);
+            weights[d] = pos;
+            if (present && (h.flags & BG_WEIGHTED)) pos = align(pos + e*h.m);
+            degrees[d] = pos;
+            if (present) pos = align(pos + 8*h.n);
+        }
+        parts = pos;
+        if (h.numParts) pos = align(pos + 8*(h.numParts+1));
+        size = pos;
+    }
+
+    static uint64_t align(uint64_t pos)
+    {
+        return (pos + 63) & ~(uint64_t)63;
+    }
+};
+
+inline bool isBinaryGraph(char* fname)
+{
+    char magic[8];
+    ifstream file(fname, ios::in | ios::binary);
+    return file.read(magic, 8) && memcmp(magic, BG_MAGIC, 8) == 0;
+}
+
+// Copies the out or in (d = 1) edges of a mapped binary graph into edges, laid out as wholeGraph
+// expects: m intE, or m (edge, weight) pairs if WEIGHTED.
+inline void copyBinaryEdges(const char* data, const binaryGraphHeader &h, const binaryGraphLayout &L,
+                            int d, intE* edges)
+{
+    const intT m = h.m;
+    const intE* edest = (const intE*)(data + L.edges[d]);
+#ifndef WEIGHTED
+    parallel_for(intT i=0; i<m; i++) edges[i] = edest[i];
+#else
+    const intE* ewght = (const intE*)(data + L.weights[d]);
+    parallel_for(intT i=0; i<m; i++)
+    {
+        edges[2*i] = edest[i];
+        edges[2*i+1] = ewght[i];
+    }
+#endif
+}
+
+// Points the vertices at their out (in = false) or in adjacency lists in edges, laid out as
+// copyBinaryEdges leaves them, with the offsets and degrees of a binary graph.
+template <class vertex>
+void setBinaryVertices(intT n, const uint64_t* offsets, const uint64_t* degrees,
+                       intE* edges, vertex* V, bool in)
+{
+    parallel_for(intT i=0; i<n; i++)
+    {
+#ifndef WEIGHTED
+        intE* neighbors = edges+offsets[i];
+#else
+        intE* neighbors = edges+2*offsets[i];
+#endif
+        if (in)
+        {
+            V[i].setInDegree(degrees[i]);
+            V[i].setInNeighbors(neighbors);
+        }
+        else
+        {
+            V[i].setOutDegree(degrees[i]);
+            V[i].setOutNeighbors(neighbors);
+        }
+    }
+}
+
+// Copies the out (in = false) or in adjacency lists of a mapped binary graph
+// into edges (laid out as wholeGraph expects), and points the vertices at them.
+template <class vertex>
+void setBinaryAdjacency(const char* data, const binaryGraphHeader &h, const binaryGraphLayout &L,
+                        int d, intE* edges, vertex* V, bool in)
+{
+    copyBinaryEdges(data, h, L, d, edges);
+    setBinaryVertices(h.n, (const uint64_t*)(data + L.offsets[d]), (const uint64_t*)(data + L.degrees[d]),
+                      edges, V, in);
+}
+
+// Maps a binary graph file read-only and checks its header against this build and isSymmetric.
+// Returns the mapping, of len bytes, and its header in h.
+inline const char* mapBinaryGraph(char* fname, bool isSymmetric, binaryGraphHeader &h, size_t &len)
+{
+    int fd = open( fname, O_RDONLY );
+    if( fd < 0 )
+    {
+        std::cerr << "Error in binary graph file: cannot open '" << fname << "'\n";
+        abort();
+    }
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || (uint64_t)st.st_size < sizeof(binaryGraphHeader) )
+    {
+        std::cerr << "Error in binary graph file: cannot read header\n";
+        abort();
+    }
+    len = st.st_size;
+
+    // the whole file is read once, in order, so fault it all in up front
+    int mapFlags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    mapFlags |= MAP_POPULATE;
+#endif
+    const char * data = (const char *)mmap( 0, len, PROT_READ, mapFlags, fd, 0 );
+    if( data == (const char *)-1 )
+    {
+        std::cerr << "Cannot mmap input graph file\n";
+        abort();
+    }
+    close( fd );
+
+    memcpy( &h, data, sizeof(h) );
+    if( memcmp( h.magic, BG_MAGIC, 8 ) != 0 || h.version != BG_VERSION )
+    {
+        std::cerr << "Error in binary graph file: version (" << h.version
+                  << ") != " << BG_VERSION << "\n";
+        abort();
+    }
+    binaryGraphLayout L(h);
+    if( L.size > len )
+    {
+        std::cerr << "Error in binary graph file: truncated (" << len
+                  << " bytes, expected " << L.size << ")\n";
+        abort();
+    }
+    if( ((h.flags & BG_EDGE64) != 0) != (sizeof(intE) == 8) )
+    {
+        std::cerr << "Error in binary graph file: edges are " << ((h.flags & BG_EDGE64) ? 64 : 32)
+                  << " bit, but intE is " << 8*sizeof(intE) << " bit\n";
+        abort();
+    }
+#ifdef WEIGHTED
+    if( !(h.flags & BG_WEIGHTED) )
+    {
+        std::cerr << "Error in binary graph file: graph has no weights\n";
+        abort();
+    }
+#endif
+    // an asymmetric graph needs its in-edges, which a symmetric graph has as its out-edges
+    if( !isSymmetric && !(h.flags & BG_SYMMETRIC) && !(h.flags & BG_TRANSPOSE) )
+    {
+        std::cerr << "Error in binary graph file: no transposed edges; "
+                  << "convert it again as an asymmetric graph\n";
+        abort();
+    }
+    return data;
+}
+
+// the partition starts stored in a binary graph, if any, for partitionByDegree
+template <class vertex>
+void setBinaryPartitions(wholeGraph<vertex> &G, const uint64_t* starts, uint64_t numParts, bool bySource)
+{
+    if( numParts )
+    {
+        G.numPartitions = numParts;
+        G.partitionStarts = new intT [numParts+1];
+        for( uint64_t p=0; p <= numParts; p++ )
+            G.partitionStarts[p] = starts[p];
+        G.partitionsBySource = bySource;
+    }
+}
+
+template <class vertex>
+wholeGraph<vertex> readGraphFromBinary(char* fname, bool isSymmetric)
+{
+    binaryGraphHeader h;
+    size_t len;
+    const char * data = mapBinaryGraph( fname, isSymmetric, h, len );
+    binaryGraphLayout L(h);
+    const bool fileSymmetric = h.flags & BG_SYMMETRIC;
+
+    wholeGraph<vertex> G(h.n, h.m, isSymmetric);
+    setBinaryAdjacency(data, h, L, 0, (intE*)G.allocatedInplace, (vertex*)G.V, false);
+    if( !isSymmetric )
+        setBinaryAdjacency(data, h, L, fileSymmetric ? 0 : 1, (intE*)G.inEdges, (vertex*)G.V, true);
+    setBinaryPartitions( G, (const uint64_t*)(data + L.parts), h.numParts, h.flags & BG_PARTS_BY_SOURCE );
+
+    munmap( (void*)data, len );
+    return G;
+}
+
+// ======================================================================
+// Shared-memory binary graphs
+// ======================================================================
+// With -shm, jobs running at once on a node share one copy of a binary graph's edges. The first
+// process to read the file copies its offsets, degrees and edges (in the layout wholeGraph uses,
+// and interleaved over the NUMA nodes) into a named POSIX shared memory segment; the others map it
+// read-only and wait until it is complete. Each process still builds its own vertices, pointing
+// into the segment (which maps at a different address in each), and everything derived from the
+// graph: partitions, CSC and vertex arrays. The segment is named after the file's device, inode,
+// size and modification time and the edge layout of the build, so a rewritten file gets a new one.
+// It stays until removed (rm /dev/shm/ligra.*), so later jobs skip reading the file too.
+struct sharedGraphHeader
+{
+    uint64_t ready;     // set last, by the process that filled the segment
+    uint64_t n, m;
+    uint64_t flags;     // of the binary file
+    uint64_t numParts;
+    // byte offsets of the sections: [0] out, [1] in (the out ones again if the file is symmetric)
+    uint64_t offsets[2], degrees[2], edges[2];
+    uint64_t parts;
+    uint64_t size;
+
+    void layout(const binaryGraphHeader &h)
+    {
+        n = h.n;
+        m = h.m;
+        flags = h.flags;
+        numParts = h.numParts;
+#ifndef WEIGHTED
+        const uint64_t edgeBytes = sizeof(intE)*m;
+#else
+        const uint64_t edgeBytes = 2*sizeof(intE)*m;
+#endif
+        // the edges start on page boundaries, so they interleave page by page
+        uint64_t pos = binaryGraphLayout::align(sizeof(sharedGraphHeader));
+        for( int d=0; d < 2; d++ )
+        {
+            if( d == 1 && (flags & BG_SYMMETRIC) )
+            {
+                offsets[1] = offsets[0];
+                degrees[1] = degrees[0];
+                edges[1] = edges[0];
+                break;
+            }
+            if( d == 1 && !(flags & BG_TRANSPOSE) )
+                break;
+            offsets[d] = pos;
+            pos = binaryGraphLayout::align(pos + 8*(n+1));
+            degrees[d] = pos;
+            pos = pageAlign(pos + 8*n);
+            edges[d] = pos;
+            pos = pageAlign(pos + edgeBytes);
+        }
+        parts = pos;
+        pos = binaryGraphLayout::align(pos + 8*(numParts+1));
+        size = pos;
+    }
+
+    static uint64_t pageAlign(uint64_t pos)
+    {
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        return (pos + page - 1) / page * page;
+    }
+};
+
+// name of the shared segment for a graph file, or "" if it cannot be opened
+inline std::string sharedGraphName(char* fname)
+{
+    struct stat st;
+    if( stat( fname, &st ) != 0 )
+        return "";
+    char name[256];
+    snprintf( name, sizeof(name), "/ligra.%lx.%lx.%lx.%lx.e%d%s",
+              (unsigned long)st.st_dev, (unsigned long)st.st_ino, (unsigned long)st.st_size,
+              (unsigned long)st.st_mtime, (int)(8*sizeof(intE)),
+#ifdef WEIGHTED
+              "w"
+#else
+              ""
+#endif
+              );
+    return name;
+}
+
+// Fills a new shared segment, open read-write as fd, from the binary graph fname, and maps it.
+inline char* fillSharedGraph(char* fname, const std::string &name, int fd)
+{
+    binaryGraphHeader h;
+    size_t len;
+    const char * data = mapBinaryGraph( fname, true, h, len );
+    binaryGraphLayout L(h);
+    sharedGraphHeader S;
+    memset( &S, 0, sizeof(S) );
+    S.layout( h );
+    char * mem = 0;
+    if( ftruncate( fd, S.size ) == 0 )
+        mem = (char *)mmap( 0, S.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if( mem == 0 || mem == (char *)-1 )
+    {
+        std::cerr << "Cannot create shared graph " << name << ": " << strerror(errno) << "\n";
+        shm_unlink( name.c_str() );
+        abort();
+    }
+#if NUMA
+    struct bitmask *bmp = numa_allocate_nodemask();
+    numa_bitmask_setall( bmp );
+    if( mbind( mem, S.size, MPOL_INTERLEAVE, bmp->maskp, bmp->size, 0 ) < 0 )
+        std::cerr << "mbind failed: " << strerror(errno) << '\n';
+    numa_bitmask_free( bmp );
+#endif
+    memcpy( mem, &S, sizeof(S) );
+    const int sections = (h.flags & BG_SYMMETRIC) || !(h.flags & BG_TRANSPOSE) ? 1 : 2;
+    for( int d=0; d < sections; d++ )
+    {
+        memcpy( mem + S.offsets[d], data + L.offsets[d], 8*(S.n+1) );
+        memcpy( mem + S.degrees[d], data + L.degrees[d], 8*S.n );
+        copyBinaryEdges( data, h, L, d, (intE*)(mem + S.edges[d]) );
+    }
+    if( h.numParts )
+        memcpy( mem + S.parts, data + L.parts, 8*(h.numParts+1) );
+    munmap( (void*)data, len );
+
+    // the others may use it from here on, and nobody writes it again
+    __atomic_store_n( &((sharedGraphHeader *)mem)->ready, 1, __ATOMIC_RELEASE );
+    mprotect( mem, S.size, PROT_READ );
+    return mem;
+}
+
+// Maps the shared segment open read-only as fd once its creator has sized it, and waits until it
+// has been filled.
+inline char* attachSharedGraph(const std::string &name, int fd)
+{
+    struct stat st;
+    while( fstat( fd, &st ) == 0 && (uint64_t)st.st_size < sizeof(sharedGraphHeader) )
+        usleep( 1000 );
+    char * mem = (char *)mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( mem == (char *)-1 )
+    {
+        std::cerr << "Cannot map shared graph " << name << ": " << strerror(errno) << "\n";
+        abort();
+    }
+    const sharedGraphHeader *S = (const sharedGraphHeader *)mem;
+    bool waited = false;
+    while( !__atomic_load_n( &S->ready, __ATOMIC_ACQUIRE ) )
+    {
+        if( !waited )
+            std::cerr << "waiting for shared graph " << name << " to be filled\n";
+        waited = true;
+        usleep( 10000 );
+    }
+    return mem;
+}
+
+template <class vertex>
+wholeGraph<vertex> readGraphFromShared(char* fname, bool isSymmetric)
+{
+    std::string name = sharedGraphName( fname );
+    if( name.empty() )
+    {
+        std::cerr << "Error in binary graph file: cannot open '" << fname << "'\n";
+        abort();
+    }
+    char * mem;
+    int fd = shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if( fd >= 0 )
+    {
+        mem = fillSharedGraph( fname, name, fd );
+        std::cerr << "shared graph " << name << " created\n";
+    }
+    else if( errno == EEXIST && (fd = shm_open( name.c_str(), O_RDONLY, 0 )) >= 0 )
+    {
+        mem = attachSharedGraph( name, fd );
+        std::cerr << "shared graph " << name << " attached\n";
+    }
+    else
+    {
+        std::cerr << "Cannot open shared graph " << name << ": " << strerror(errno) << "\n";
+        abort();
+    }
+    close( fd );
+
+    const sharedGraphHeader &S = *(const sharedGraphHeader *)mem;
+    if( !isSymmetric && !(S.flags & BG_SYMMETRIC) && !(S.flags & BG_TRANSPOSE) )
+    {
+        std::cerr << "Error in binary graph file: no transposed edges; "
+                  << "convert it again as an asymmetric graph\n";
+        abort();
+    }
+    // private vertices over the shared edges, which are only ever read through them
+    wholeGraph<vertex> G;
+    G.n = S.n;
+    G.m = S.m;
+    G.isSymmetric = isSymmetric;
+    G.transposed = false;
+    G.V.Interleave_allocate( G.n );
+    G.shared = mem;
+    G.sharedBytes = S.size;
+    setBinaryVertices( G.n, (const uint64_t*)(mem + S.offsets[0]), (const uint64_t*)(mem + S.degrees[0]),
+                       (intE*)(mem + S.edges[0]), (vertex*)G.V, false );
+    if( !isSymmetric )
+        setBinaryVertices( G.n, (const uint64_t*)(mem + S.offsets[1]), (const uint64_t*)(mem + S.degrees[1]),
+                           (intE*)(mem + S.edges[1]), (vertex*)G.V, true );
+    setBinaryPartitions( G, (const uint64_t*)(mem + S.parts), S.numParts, S.flags & BG_PARTS_BY_SOURCE );
+    return G;
+}
+
+// writes count values of type T, as uint64 or intE, then pads to the next section
+template <class T>
+void writeBinarySection(FILE* f, const T* values, uint64_t count, uint64_t end)
+{
+    if( count && fwrite( values, sizeof(T), count, f ) != count )
+    {
+        std::cerr << "Error writing binary graph file\n";
+        abort();
+    }
+    static const char zeros[64] = { 0 };
+    long pos = ftell( f );
+    if( (uint64_t)pos < end )
+        fwrite( zeros, 1, end - pos, f );
+}
+
+// Writes the out (in = false) or in adjacency lists of G as the sections laid out from index d.
+template <class vertex>
+void writeBinaryAdjacency(FILE* f, wholeGraph<vertex> &G, const binaryGraphLayout &L, int d, bool in, bool weighted)
+{
+    const intT n = G.n;
+    const intT m = G.m;
+    vertex* V = G.V;
+    uint64_t* offsets = new uint64_t [n+1];
+    uint64_t* degrees = new uint64_t [n];
+    offsets[0] = 0;
+    for( intT i=0; i<n; i++ )
+    {
+        degrees[i] = in ? V[i].getInDegree() : V[i].getOutDegree();
+        offsets[i+1] = offsets[i] + degrees[i];
+    }
+    intE* edest = new intE [m];
+    intE* ewght = weighted ? new intE [m] : 0;
+    parallel_for( intT i=0; i<n; i++ )
+    {
+        for( uint64_t j=0; j<degrees[i]; j++ )
+        {
+            edest[offsets[i]+j] = in ? V[i].getInNeighbor(j) : V[i].getOutNeighbor(j);
+            if( weighted )
+                ewght[offsets[i]+j] = in ? V[i].getInWeight(j) : V[i].getOutWeight(j);
+        }
+    }
+    writeBinarySection( f, offsets, n+1, L.edges[d] );
+    writeBinarySection( f, edest, m, L.weights[d] );
+    if( weighted )
+        writeBinarySection( f, ewght, m, L.degrees[d] );
+    writeBinarySection( f, degrees, n, d == 0 ? L.offsets[1] : L.parts );
+    delete [] offsets;
+    delete [] degrees;
+    delete [] edest;
+    if( ewght ) delete [] ewght;
+}
+
+// Writes G as a binary graph, with the partitions of numParts > 0 partitions
+// by in-degree (or out-degree if bySource), as partitionByDegree computes them.
+template <class vertex>
+void writeGraphToBinary(wholeGraph<vertex> &G, char* fname, intT numParts, bool bySource)
+{
+    binaryGraphHeader h;
+    memset( &h, 0, sizeof(h) );
+    memcpy( h.magic, BG_MAGIC, 8 );
+    h.version = BG_VERSION;
+    h.n = G.n;
+    h.m = G.m;
+    h.numParts = numParts;
+    h.flags = (G.isSymmetric ? BG_SYMMETRIC : BG_TRANSPOSE)
+              | (sizeof(intE) == 8 ? BG_EDGE64 : 0)
+              | (bySource ? BG_PARTS_BY_SOURCE : 0);
+#ifdef WEIGHTED
+    h.flags |= BG_WEIGHTED;
+#endif
+    binaryGraphLayout L(h);
+
+    FILE* f = fopen( fname, "wb" );
+    if( !f )
+    {
+        std::cerr << "Error in binary graph file: cannot create '" << fname << "'\n";
+        abort();
+    }
+    writeBinarySection( f, &h, 1, L.offsets[0] );
+    writeBinaryAdjacency( f, G, L, 0, false, h.flags & BG_WEIGHTED );
+    if( h.flags & BG_TRANSPOSE )
+        writeBinaryAdjacency( f, G, L, 1, true, h.flags & BG_WEIGHTED );
+
+    if( numParts )
+    {
+        intT* degrees = new intT [G.n];
+        intT* sizes = new intT [numParts];
+        parallel_for( intT i=0; i<G.n; i++ )
+            degrees[i] = bySource ? G.V[i].getOutDegree() : G.V[i].getInDegree();
+        partitionSizesByDegree( degrees, G.n, G.m, numParts, sizes );
+        uint64_t* starts = new uint64_t [numParts+1];
+        starts[0] = 0;
+        for( intT p=0; p<numParts; p++ )
+            starts[p+1] = starts[p] + sizes[p];
+        writeBinarySection( f, starts, numParts+1, L.size );
+        delete [] degrees;
+        delete [] sizes;
+        delete [] starts;
+    }
+    fclose( f );
+}
+
+// ======================================================================
+// Edge weight planes
+// ======================================================================
+// Real edge weights kept beside a graph file as the segment planes of their doubles (see
+// manseglib_results.hpp): <graph>.planes for the out-edges, in the order of the file's edges, and
+// for an asymmetric binary graph <graph>.in.planes for its in-edges, in the order of those. The
+// graphtools converters addAdjWeights and VEBO write the first with -planes; GraphToBinary -planes
+// carries it over to the binary graph and adds the second. mapWeightPlanes maps only the heads plane
+// at first, so a run at heads precision reads 4 of the 8 bytes of each weight from storage.
+inline std::string weightPlanesName(const char* graphFile, bool in)
+{
+    return std::string(graphFile) + (in ? ".in.planes" : ".planes");
+}
+
+// The weights of the out (in = false) or in-edges of graphFile as a heads array of m values, whose
+// createFullPrecision maps the tails as well. Empty (isAlloc() false) if there are no planes for m edges.
+inline ManSeg::MappedSegments mapWeightPlanes(const char* graphFile, bool in, intT m)
+{
+    uint_fast64_t count;
+    ManSeg::MappedSegments w = ManSeg::mapSegments( weightPlanesName( graphFile, in ).c_str(), count );
+    if( w.isAlloc() && count != (uint_fast64_t)m )
+    {
+        std::cerr << weightPlanesName( graphFile, in ) << " has " << count << " weights, not " << m << "\n";
+        w.del();
+        return ManSeg::MappedSegments();
+    }
+    return w;
+}
+
+// Writes the weight planes of the binary graph oFile from those of iFile, which G was read from: the
+// out-edges' as they are, and for an asymmetric G the in-edges' too. False if iFile has none for G.
+template <class vertex>
+bool writeBinaryWeightPlanes(wholeGraph<vertex> &G, const char* iFile, const char* oFile)
+{
+    std::vector<double> w;
+    if( !ManSeg::loadSegments( weightPlanesName( iFile, false ).c_str(), w, true ) || (intT)w.size() != G.m )
+        return false;
+    if( !ManSeg::writeSegments( weightPlanesName( oFile, false ).c_str(), w.data(), w.size() ) )
+        return false;
+    if( G.isSymmetric )
+        return true;
+
+    // the k-th edge from u to v of the out-edges is the k-th from u of v's in-edges: both sides as
+    // (v, u, index) in order line the edges up
+    const intT n = G.n, m = G.m;
+    vertex* V = G.V;
+    std::vector<uint64_t> outStart(n+1, 0), inStart(n+1, 0);
+    for( intT i=0; i<n; i++ )
+    {
+        outStart[i+1] = outStart[i] + V[i].getOutDegree();
+        inStart[i+1] = inStart[i] + V[i].getInDegree();
+    }
+    typedef std::pair<std::pair<intT, intT>, uint64_t> edgeKey;
+    std::vector<edgeKey> out(m), in(m);
+    parallel_for( intT u=0; u<n; u++ )
+    {
+        for( uint64_t j=0; j < outStart[u+1]-outStart[u]; j++ )
+            out[outStart[u]+j] = edgeKey( std::make_pair( (intT)V[u].getOutNeighbor(j), u ), outStart[u]+j );
+    }
+    parallel_for( intT v=0; v<n; v++ )
+    {
+        for( uint64_t j=0; j < inStart[v+1]-inStart[v]; j++ )
+            in[inStart[v]+j] = edgeKey( std::make_pair( v, (intT)V[v].getInNeighbor(j) ), inStart[v]+j );
+    }
+    std::sort( out.begin(), out.end() );
+    std::sort( in.begin(), in.end() );
+    std::vector<double> inW(m);
+    parallel_for( intT e=0; e<m; e++ )
+        inW[in[e].second] = w[out[e].second];
+    return ManSeg::writeSegments( weightPlanesName( oFile, true ).c_str(), inW.data(), inW.size() );
+}
+
 template <class vertex>
-wholeGraph<vertex> readGraph(char* iFile, bool symmetric, bool binary)
+wholeGraph<vertex> readGraph(char* iFile, bool symmetric, bool binary, bool shared = false)
 {
-    // if(binary) return readGraphFromBinary<vertex>(iFile,symmetric);
+    if(binary && isBinaryGraph(iFile))
+        return shared ? readGraphFromShared<vertex>(iFile,symmetric) : readGraphFromBinary<vertex>(iFile,symmetric);
+    if(shared) std::cerr << "-shm needs a binary graph (see GraphToBinary); reading a private copy\n";
     if(binary) return readGraphFromGalois<vertex>(iFile,symmetric);
     else return readGraphFromFile<vertex>(iFile,symmetric);
 }
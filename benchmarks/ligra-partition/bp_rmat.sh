@@ -0,0 +1,24 @@
+#!/bin/bash
+# BP (doubles) against BPManSeg (heads, then pairs) on the rMat input in the repo
+# module load compilers/gcc-4.9.0
+
+#export LD_LIBRARY_PATH="../../cilk-swan/lib/"  # req. lib
+export CILK_NWORKERS=4                                             # no. cpu threads
+#export LD_PRELOAD="./bin/interposer_cilk.so"                       # req. for cilk
+
+# BPManSeg indexes messages by in-edge, so both run partitioned by destination
+GRAPH="rMatGraph_J_5_100"
+ARGS="-c 1 -P dest -rounds 10"
+
+make BP BPManSeg
+mkdir -p bp_out
+
+date
+echo "ref bp start"
+./BP ${ARGS} ${GRAPH} > bp_out/ref_${GRAPH}.txt 2>&1
+echo "bp manseg start"
+./BPManSeg ${ARGS} ${GRAPH} > bp_out/${GRAPH}_msa.txt 2>&1
+date
+
+grep -H "Average" bp_out/ref_${GRAPH}.txt bp_out/${GRAPH}_msa.txt
+grep -H "switching precision\|converged" bp_out/${GRAPH}_msa.txt
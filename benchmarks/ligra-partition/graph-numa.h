@@ -2,10 +2,12 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <stdint.h>
 #include "parallel.h"
 #include <assert.h>
 #include "numa_page_check.h"
 #include "mm.h"
+#include "quickSort.h"
 #include <unistd.h>
 #include <sched.h>
 #include <errno.h>
@@ -22,10 +24,34 @@
 #define EDGES_HILBERT 0
 #endif
 
+// dense edgeMap decodes byte-coded COO partitions (CompressedEdgeList) instead of the CSC
+#ifndef COMPRESSED_EDGES
+#define COMPRESSED_EDGES 0
+#endif
+// edge functors taking an edge index (MORE_ARG) need the CSC, as COO edges carry none
+#if COMPRESSED_EDGES && defined(MORE_ARG)
+#undef COMPRESSED_EDGES
+#define COMPRESSED_EDGES 0
+#endif
+// edges per independently decoded block of a CompressedEdgeList
+#ifndef COMPRESSED_BLOCK
+#define COMPRESSED_BLOCK 128
+#endif
+// dense edgeMap traverses COO partitions of 32-bit endpoints, offsets from the partition's lowest
+// source and destination (LocalIdEdgeList), rather than of intT (64 bits with -DLONG)
+#ifndef LOCAL_EDGE_IDS
+#define LOCAL_EDGE_IDS 0
+#endif
+#if COMPRESSED_EDGES && LOCAL_EDGE_IDS
+#undef LOCAL_EDGE_IDS
+#define LOCAL_EDGE_IDS 0
+#endif
+
+// parallel (cilk_spawn) quicksort of a contiguous range
 template<typename It, typename Cmp>
 void mysort( It begin, It end, Cmp cmp )
 {
-    std::sort( begin, end, cmp );
+    quickSort( &*begin, end - begin, cmp );
 }
 
 using namespace std;
@@ -362,6 +388,12 @@ public:
         return e2d( l ) < e2d( r );
     }
 
+    // stores the curve index of e up front, so that a parallel sort does not write it while comparing
+    void set_index( Edge_Hilbert & e ) const
+    {
+        e.setE2d( xy2d( e.getSource(), e.getDestination() ) );
+    }
+
 private:
     intT e2d( const Edge_Hilbert & e ) const
     {
@@ -484,7 +516,10 @@ public:
 		mmap_ptr<Edge_Hilbert> hilbert_edges;
 		hilbert_edges.local_allocate(num_edges,numanode);
 		std::copy( begin(), end(), hilbert_edges.get() );													 
-		mysort(&hilbert_edges[0], &hilbert_edges[num_edges], HilbertEdgeSort(num_edges));
+		HilbertEdgeSort sorter(num_edges);
+		parallel_for( intE i=0; i < num_edges; ++i )
+			sorter.set_index( hilbert_edges[i] );
+		mysort(&hilbert_edges[0], &hilbert_edges[num_edges], sorter);
 		std::copy( &hilbert_edges[0], &hilbert_edges[num_edges], edges.get() );														   
 		hilbert_edges.del();
     }
@@ -494,6 +529,272 @@ public:
     }
 };
 
+// COO edge list compressed Ligra+ style, in blocks of COMPRESSED_BLOCK edges kept in the
+// order of the EdgeList it is built from (Hilbert or CSR sorted). The first edge of a block is
+// stored raw; each following edge as the differences of its source and destination from the
+// previous edge, zigzagged and written as byte codes (7 bits per byte, high bit set on all but
+// the last), then its weight if WEIGHTED. In Hilbert order consecutive edges are close in both
+// ends, so most edges take 2-4 bytes rather than two intTs. Blocks decode independently,
+// so edgeMapDense runs over blocks in parallel.
+template<class Edge>
+class CompressedEdgeList
+{
+private:
+    mmap_ptr<unsigned char> bytes;
+    mmap_ptr<intT> blockStarts;  // byte offset of each block, and the total at the end
+    intT num_edges;
+    intT num_blocks;
+    intT num_vertices;
+
+    static inline uintT zigzag( intT d )
+    {
+        return ((uintT)d << 1) ^ (uintT)(d >> (sizeof(intT)*8-1));
+    }
+    static inline intT unzigzag( uintT u )
+    {
+        return (intT)(u >> 1) ^ -(intT)(u & 1);
+    }
+    static inline intT codeLength( uintT u )
+    {
+        intT l = 1;
+        while( u >= 128 ) { u >>= 7; ++l; }
+        return l;
+    }
+    static inline unsigned char * encode( unsigned char *p, uintT u )
+    {
+        while( u >= 128 )
+        {
+            *p++ = (unsigned char)(u | 128);
+            u >>= 7;
+        }
+        *p++ = (unsigned char)u;
+        return p;
+    }
+    static inline const unsigned char * decode( const unsigned char *p, uintT &u )
+    {
+        u = 0;
+        int shift = 0;
+        unsigned char b;
+        do
+        {
+            b = *p++;
+            u |= (uintT)(b & 127) << shift;
+            shift += 7;
+        }
+        while( b & 128 );
+        return p;
+    }
+    // bytes of edge i of EL, coded against edge i-1 unless it starts a block
+    static inline intT edgeLength( const EdgeList<Edge> & EL, intT i )
+    {
+        intT l = 0;
+        if( i % COMPRESSED_BLOCK == 0 )
+            l = codeLength( EL[i].getSource() ) + codeLength( EL[i].getDestination() );
+        else
+            l = codeLength( zigzag( (intT)EL[i].getSource() - (intT)EL[i-1].getSource() ) )
+                + codeLength( zigzag( (intT)EL[i].getDestination() - (intT)EL[i-1].getDestination() ) );
+#ifdef WEIGHTED
+        l += codeLength( zigzag( EL[i].getWeight() ) );
+#endif
+        return l;
+    }
+
+public:
+    CompressedEdgeList() : num_edges(0), num_blocks(0), num_vertices(0) {}
+    CompressedEdgeList( const EdgeList<Edge> & EL, int numanode )
+        : num_edges(EL.get_num_edges()), num_vertices(EL.get_num_vertices())
+    {
+        num_blocks = (num_edges + COMPRESSED_BLOCK - 1) / COMPRESSED_BLOCK;
+        blockStarts.local_allocate( num_blocks+1, numanode );
+        parallel_for( intT b=0; b < num_blocks; ++b )
+        {
+            intT l = 0;
+            intT e = std::min( num_edges, (b+1)*(intT)COMPRESSED_BLOCK );
+            for( intT i=b*COMPRESSED_BLOCK; i < e; ++i )
+                l += edgeLength( EL, i );
+            blockStarts[b] = l;
+        }
+        blockStarts[num_blocks] = 0;
+        sequence::plusScan( blockStarts.get(), blockStarts.get(), num_blocks+1 );
+        bytes.local_allocate( std::max( blockStarts[num_blocks], (intT)1 ), numanode );
+        parallel_for( intT b=0; b < num_blocks; ++b )
+        {
+            unsigned char *p = &bytes[blockStarts[b]];
+            intT e = std::min( num_edges, (b+1)*(intT)COMPRESSED_BLOCK );
+            for( intT i=b*COMPRESSED_BLOCK; i < e; ++i )
+            {
+                if( i == b*COMPRESSED_BLOCK )
+                {
+                    p = encode( p, EL[i].getSource() );
+                    p = encode( p, EL[i].getDestination() );
+                }
+                else
+                {
+                    p = encode( p, zigzag( (intT)EL[i].getSource() - (intT)EL[i-1].getSource() ) );
+                    p = encode( p, zigzag( (intT)EL[i].getDestination() - (intT)EL[i-1].getDestination() ) );
+                }
+#ifdef WEIGHTED
+                p = encode( p, zigzag( EL[i].getWeight() ) );
+#endif
+            }
+        }
+    }
+    void del()
+    {
+        bytes.del();
+        blockStarts.del();
+    }
+
+    size_t get_num_edges() const
+    {
+        return num_edges;
+    }
+    size_t get_num_vertices() const
+    {
+        return num_vertices;
+    }
+    size_t get_num_blocks() const
+    {
+        return num_blocks;
+    }
+    size_t get_num_bytes() const
+    {
+        return num_blocks ? blockStarts.get()[num_blocks] : 0;
+    }
+
+    // calls op(src, dst, weight) for each edge of block b, in order
+    template<class Op>
+    inline void decode_block( intT b, Op op ) const
+    {
+        const unsigned char *p = bytes.get() + blockStarts.get()[b];
+        intT e = std::min( num_edges, (b+1)*(intT)COMPRESSED_BLOCK ) - b*COMPRESSED_BLOCK;
+        intT src = 0, dst = 0;
+        for( intT i=0; i < e; ++i )
+        {
+            uintT s, d;
+            p = decode( p, s );
+            p = decode( p, d );
+            if( i == 0 )
+            {
+                src = s;
+                dst = d;
+            }
+            else
+            {
+                src += unzigzag( s );
+                dst += unzigzag( d );
+            }
+#ifdef WEIGHTED
+            uintT w;
+            p = decode( p, w );
+            op( src, dst, (intE)unzigzag( w ) );
+#else
+            op( src, dst, (intE)1 );
+#endif
+        }
+    }
+};
+
+// COO edge list of partition-relative 32-bit endpoints: each edge stores its source and destination
+// as offsets from the lowest source and destination of the partition, so an edge takes 8 bytes
+// (and its weight) where two intTs take 16 with -DLONG. A partition is a range of destinations
+// (or of sources), so its offsets fit in 32 bits unless the graph has 2^32 vertices; the
+// constructor aborts if they do not. Edges keep the order of the EdgeList it is built from.
+template<class Edge>
+class LocalIdEdgeList
+{
+public:
+    struct LocalEdge
+    {
+        uint32_t src, dst;
+#ifdef WEIGHTED
+        intE weight;
+#endif
+    };
+    typedef const LocalEdge * const_iterator;
+
+private:
+    mmap_ptr<LocalEdge> edges;
+    intT num_edges;
+    intT num_vertices;
+    intT src_base, dst_base;
+
+public:
+    LocalIdEdgeList() : num_edges(0), num_vertices(0), src_base(0), dst_base(0) {}
+    LocalIdEdgeList( const EdgeList<Edge> & EL, int numanode )
+        : num_edges(EL.get_num_edges()), num_vertices(EL.get_num_vertices()), src_base(0), dst_base(0)
+    {
+        intT src_top = 0, dst_top = 0;
+        if( num_edges > 0 )
+        {
+            src_base = src_top = EL[0].getSource();
+            dst_base = dst_top = EL[0].getDestination();
+        }
+        for( intT i=1; i < num_edges; ++i )
+        {
+            src_base = std::min( src_base, (intT)EL[i].getSource() );
+            src_top = std::max( src_top, (intT)EL[i].getSource() );
+            dst_base = std::min( dst_base, (intT)EL[i].getDestination() );
+            dst_top = std::max( dst_top, (intT)EL[i].getDestination() );
+        }
+        if( (uintT)(src_top - src_base) > UINT32_MAX || (uintT)(dst_top - dst_base) > UINT32_MAX )
+        {
+            std::cerr << "LocalIdEdgeList: a partition spans more than 2^32 vertex ids; build without LOCAL_EDGE_IDS\n";
+            abort();
+        }
+        edges.local_allocate( std::max( num_edges, (intT)1 ), numanode );
+        parallel_for( intT i=0; i < num_edges; ++i )
+        {
+            edges[i].src = (uint32_t)(EL[i].getSource() - src_base);
+            edges[i].dst = (uint32_t)(EL[i].getDestination() - dst_base);
+#ifdef WEIGHTED
+            edges[i].weight = EL[i].getWeight();
+#endif
+        }
+    }
+    void del()
+    {
+        edges.del();
+    }
+
+    const_iterator cbegin() const
+    {
+        return edges.get();
+    }
+    const_iterator cend() const
+    {
+        return edges.get() + num_edges;
+    }
+    size_t get_num_edges() const
+    {
+        return num_edges;
+    }
+    size_t get_num_vertices() const
+    {
+        return num_vertices;
+    }
+
+    intT getSource( const LocalEdge & e ) const
+    {
+        return src_base + e.src;
+    }
+    intT getDestination( const LocalEdge & e ) const
+    {
+        return dst_base + e.dst;
+    }
+#ifdef WEIGHTED
+    intE getWeight( const LocalEdge & e ) const
+    {
+        return e.weight;
+    }
+#else
+    intE getWeight( const LocalEdge & ) const
+    {
+        return 1;
+    }
+#endif
+};
+
 // wholeGraph for whole graph loading
 // and sparse iteration graph traversal
 // uses NUMA interleave to allocate
@@ -509,11 +810,19 @@ public:
     mmap_ptr<intE> inEdges;
     bool transposed;
     bool isSymmetric;
-
-    wholeGraph() {}
+    // partition starts stored in a binary graph file, reused by partitionByDegree
+    intT numPartitions;
+    intT* partitionStarts;
+    bool partitionsBySource;
+    // the shared memory segment holding the edges, if they were attached with -shm (IO.h)
+    char* shared;
+    size_t sharedBytes;
+
+    wholeGraph() : numPartitions(0), partitionStarts(0), partitionsBySource(false), shared(0), sharedBytes(0) {}
     wholeGraph(intT nn, intT mm, bool issym)
         : n(nn), m(mm), isSymmetric(issym),
-          transposed(false)
+          transposed(false),
+          numPartitions(0), partitionStarts(0), partitionsBySource(false), shared(0), sharedBytes(0)
     {
 
 //NUMA_AWARE and Ligra_normal without partition
@@ -539,6 +848,13 @@ public:
         allocatedInplace.del();
         V.del();
         inEdges.del();
+        if (shared)
+            munmap(shared, sharedBytes);
+        shared = 0;
+        if (partitionStarts)
+            delete [] partitionStarts;
+        partitionStarts = 0;
+        numPartitions = 0;
     }
 
 //    void reorder_vertices( intT * __restrict reorder );
@@ -611,6 +927,98 @@ public:
     }
 
 };
+// Edge weights of the CSC graph as a plane of mantissa segmented doubles, apart from the
+// neighbour ids. Plane is a ManSeg::BasicManSegArray (see manseg_mm.h); the weight of in-edge j
+// of vertex d is element offset(d) + j, so an edge functor built with MORE_ARG reads it through
+// its edge index. Weights that are exact at the heads (e.g. integers below 2^21) only write the
+// heads, so with a lazy allocator their tails are not paged in until something writes them.
+// The in-edges of a vertex must all be in its CSC partition, i.e. partitioned by destination.
+template <class Plane>
+class SegmentedWeights
+{
+public:
+    Plane plane;
+    mmap_ptr<intT> offsets;
+
+    template <class vertex>
+    SegmentedWeights( graph<vertex> & G )
+    {
+        const intT n = G.n;
+        offsets.Interleave_allocate(n);
+        parallel_for( intT i=0; i < n; ++i )
+            offsets[i] = G.V[i].getInDegree();
+        intT m = sequence::plusScan( offsets.get(), offsets.get(), n );
+        plane.alloc( m );
+        parallel_for( intT i=0; i < G.CSCVn; ++i )
+        {
+            intT d = G.CSCV[i].first;
+            vertex V = G.CSCV[i].second;
+            for( intT j=0; j < V.getInDegree(); ++j )
+            {
+                double w = V.getInWeight(j);
+                intT e = offsets[d] + j;
+                plane.heads.set( e, w );
+                if( plane.heads.read( e ) != w )
+                    plane.pairs.set( e, w );
+            }
+        }
+    }
+
+    intT offset( intT d ) const
+    {
+        return offsets.get()[d];
+    }
+
+    void del()
+    {
+        plane.delSegments();
+        offsets.del();
+    }
+};
+
+// Split n vertices into numOfNode consecutive ranges of about m/numOfNode edges
+// each, where vertex i has degrees[i] edges, storing the number of vertices of each
+// range in sizeArr. Used by partitionByDegree, and to store the partitions in binary
+// graph files (see writeGraphToBinary in IO.h).
+inline void partitionSizesByDegree(const intT* degrees, intT n, intT m, int numOfNode, intT *sizeArr)
+{
+    intT * edges= new intT [numOfNode];
+    for (int i = 0; i < numOfNode; i++)
+    {
+        edges[i] = 0;
+        sizeArr[i] = 0;
+    }
+    
+    intT averageDegree = m / numOfNode;
+    cerr<<"Average Degree: "<<averageDegree<<endl;
+    int counter = 0;
+    for (intT i = 0; i < n; i++)
+    {
+        edges[counter]+=degrees[i];
+        sizeArr[counter]++;
+        intT next = (i+1 < n) ? degrees[i+1] : 0;
+        if (edges[counter]<averageDegree && next+edges[counter]> 1.1*averageDegree)
+            counter++;
+        if (edges[counter]>=averageDegree && counter <numOfNode-1)
+            counter++;
+    }
+#define PSIZE 0
+#if PSIZE
+     intT a=0,b=0;
+    for (intT i=0; i<numOfNode;i++)
+    {
+        cerr<<" Part " <<i<<" with size "<<sizeArr[i]<<" and edges "<<edges[i]<<endl;
+        a+=edges[i];
+        b+=sizeArr[i];
+    }
+    assert(a==m);
+    assert(b==n);
+    abort();
+#endif
+    assert( counter+1 == numOfNode );
+    delete [] edges;
+}
+
 //Graph partitioning, contain partitioned graph,
 //partitioner value
 //Select there partitioning method,
@@ -637,6 +1045,12 @@ public:
 private:
     // All variables should be private
     EdgeList<Edge> * localEdgeList;
+#if COMPRESSED_EDGES
+    CompressedEdgeList<Edge> * localCompressedEdgeList;
+#endif
+#if LOCAL_EDGE_IDS
+    LocalIdEdgeList<Edge> * localIdEdgeList;
+#endif
     graph<vertex> CSCGraph;
 public:
     partitioned_graph( wholeGraph<vertex> & GA, 
@@ -648,6 +1062,12 @@ public:
         //cerr<<"m="<<m<<"n="<<n<<endl;
         const int coo_perNode = coo_partition.get_num_per_node_partitions();
         localEdgeList = new EdgeList<Edge>[coo_part];
+#if COMPRESSED_EDGES
+        localCompressedEdgeList = new CompressedEdgeList<Edge>[coo_part];
+#endif
+#if LOCAL_EDGE_IDS
+        localIdEdgeList = new LocalIdEdgeList<Edge>[coo_part];
+#endif
         if(partition_vertex)
              partitionByVertex( GA, coo_part, coo_partition.as_array(), partition_relabel);
         else
@@ -672,6 +1092,18 @@ public:
                         localEdgeList[p].hilbert_sort();
 #else
                         localEdgeList[p].CSR_sort();
+#endif
+#if COMPRESSED_EDGES
+                        // the compressed copy replaces the raw edges
+                        localCompressedEdgeList[p] = CompressedEdgeList<Edge>( localEdgeList[p], i );
+                        localEdgeList[p].del();
+                        localEdgeList[p] = EdgeList<Edge>();
+#endif
+#if LOCAL_EDGE_IDS
+                        // as does the one of local ids
+                        localIdEdgeList[p] = LocalIdEdgeList<Edge>( localEdgeList[p], i );
+                        localEdgeList[p].del();
+                        localEdgeList[p] = EdgeList<Edge>();
 #endif
                 }
             }        
@@ -726,6 +1158,15 @@ public:
            abort();
 #endif
          cerr<<"COO: "<<par.stop()<<endl;
+#if COMPRESSED_EDGES
+        if(!partition_vertex)
+        {
+            size_t compressedBytes = 0;
+            for( int p=0; p < coo_part; ++p )
+                compressedBytes += localCompressedEdgeList[p].get_num_bytes();
+            cerr<<"Compressed COO: "<<(double)compressedBytes/GA.m<<" bytes per edge"<<endl;
+        }
+#endif
         //cerr<<"CSC Chunk"<<endl;
         CSCGraph = PartitionByDest(GA,0,GA.m,coo_part);
         if(partition_vertex)
@@ -742,6 +1183,16 @@ public:
 	    localEdgeList[p].del();
 
         delete [] localEdgeList;
+#if COMPRESSED_EDGES
+        for( int p=0; p < coo_partition.get_num_partitions(); ++p )
+	    localCompressedEdgeList[p].del();
+        delete [] localCompressedEdgeList;
+#endif
+#if LOCAL_EDGE_IDS
+        for( int p=0; p < coo_partition.get_num_partitions(); ++p )
+	    localIdEdgeList[p].del();
+        delete [] localIdEdgeList;
+#endif
         CSCGraph.del();
     }
 
@@ -750,6 +1201,19 @@ public:
         return localEdgeList[p];
     }
 
+#if COMPRESSED_EDGES
+    const CompressedEdgeList<Edge> & get_compressed_edge_list_partition( intT p )
+    {
+        return localCompressedEdgeList[p];
+    }
+#endif
+#if LOCAL_EDGE_IDS
+    const LocalIdEdgeList<Edge> & get_local_id_edge_list_partition( intT p )
+    {
+        return localIdEdgeList[p];
+    }
+#endif
+
     graph<vertex> & get_partition()
     {
         return CSCGraph;
@@ -1297,7 +1761,8 @@ void partitioned_graph<vertex>::cscpartitionByDegree(graph<vertex> GA, int numOf
     {
         edges[counter]+=degrees[i];
         sizeArr[counter]++;
-        if (edges[counter]<averageDegree && degrees[i+1]+edges[counter]> 1.1*averageDegree)
+        intT next = (i+1 < n) ? degrees[i+1] : 0;
+        if (edges[counter]<averageDegree && next+edges[counter]> 1.1*averageDegree)
             counter++;
         if (edges[counter]>=averageDegree && counter <numOfNode-1)
             counter++;
@@ -1355,6 +1820,13 @@ void partitioned_graph<vertex>::partitionByDegree(wholeGraph<vertex> GA, int num
     } 
     assert( counter+1 == numOfNode );
   }
+  else if (GA.partitionStarts && GA.numPartitions == numOfNode && GA.partitionsBySource == useOutDegree)
+  {
+    // computed by partitionSizesByDegree when the binary graph was written
+    cerr<<"Stored chunk size..."<<endl;
+    for (int i = 0; i < numOfNode; i++)
+        sizeArr[i] = GA.partitionStarts[i+1] - GA.partitionStarts[i];
+  }
   else{
     cerr<<"Original chunk size..."<<endl;
     intT* degrees = new intT [n];
@@ -1370,40 +1842,7 @@ void partitioned_graph<vertex>::partitionByDegree(wholeGraph<vertex> GA, int num
             parallel_for(intT i = 0; i < n; i++) degrees[i] = GA.V[i].getInDegree();
         }
     }
-    intT * edges= new intT [numOfNode];
-    for (int i = 0; i < numOfNode; i++)
-    {
-        edges[i] = 0;
-        sizeArr[i] = 0;
-    }
-    
-    intT averageDegree = GA.m / numOfNode;
-    cerr<<"Average Degree: "<<averageDegree<<endl;
-    int counter = 0;
-    for (intT i = 0; i < n; i++)
-    {
-        edges[counter]+=degrees[i];
-        sizeArr[counter]++;
-        if (edges[counter]<averageDegree && degrees[i+1]+edges[counter]> 1.1*averageDegree)
-            counter++;
-        if (edges[counter]>=averageDegree && counter <numOfNode-1)
-            counter++;
-    }
-#define PSIZE 0
-#if PSIZE
-     intT a=0,b=0;
-    for (intT i=0; i<numOfNode;i++)
-    {
-        cerr<<" Part " <<i<<" with size "<<sizeArr[i]<<" and edges "<<edges[i]<<endl;
-        a+=edges[i];
-        b+=sizeArr[i];
-    }
-    assert(a==GA.m);
-    assert(b==GA.n);
-    abort();
-#endif
-    assert( counter+1 == numOfNode );
+    partitionSizesByDegree(degrees, n, GA.m, numOfNode, sizeArr);
     delete [] degrees;
-    delete [] edges;
    }
 }
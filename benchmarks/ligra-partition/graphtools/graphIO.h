@@ -34,9 +34,13 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <string>
+#include <vector>
+
 #include "parallel.h"
 #include "IO.h"
 #include "graphUtils.h"
+#include "../../../manseglib_results.hpp"
 
 using namespace benchIO;
 using namespace std;
@@ -158,6 +162,31 @@ namespace benchIO {
     return r;
   }
 
+  // The edge weights of a graph file, as doubles split into ManSeg segment planes: <file>.planes
+  // holds the heads plane then the tails plane, each page aligned (see manseglib_results.hpp), one
+  // value per edge in the order of the file's edges. A weighted Ligra app can map the heads plane
+  // alone (mapWeightPlanes in ligra-partition/IO.h), reading half the bytes of the weights.
+  inline string weightPlanesName(const char* fname) {
+    return string(fname) + ".planes";
+  }
+
+  template <class intT>
+  int writeWeightPlanes(const double* W, intT m, const char* fname) {
+    string name = weightPlanesName(fname);
+    if (!ManSeg::writeSegments(name.c_str(), W, (uint_fast64_t) m)) {
+      std::cout << "Unable to write file: " << name << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  // the weights of the graph file fname, or an empty vector if it has no planes
+  inline vector<double> readWeightPlanes(const char* fname) {
+    vector<double> W;
+    ManSeg::loadSegments(weightPlanesName(fname).c_str(), W, true);
+    return W;
+  }
+
   template <class intT>
   edgeArray<intT> readEdgeArrayFromFile(char* fname) {
     _seq<char> S = readStringFromFile(fname);
@@ -27,6 +27,7 @@
 #include <iostream>
 #include "parallel.h"
 #include "utils.h"
+#include "../../../manseglib_expr.hpp"
 using namespace std;
 
 #define _BSIZE 2048
@@ -492,6 +493,149 @@ void countSerial( intT * Out, intT s, intT e, F f, bool atomic=false ) {
     return R;
   }
 
+  // Overloads of the above on the heads or pairs of a ManSeg array (HeadsArray, PairsArray). Each
+  // block of _SCAN_BSIZE values is widened to doubles in one vectorised read, and sums are
+  // compensated (ManSeg::reduceSum): within a block by its SIMD lanes, then over the blocks.
+
+  template <bool P, class Al>
+  struct getTwoSeg {
+    ManSeg::TwoSegArray<P,Al> A;
+    getTwoSeg(const ManSeg::TwoSegArray<P,Al>& AA) : A(AA) {}
+    template <class intT>
+    double operator() (intT i) {return A.read(i);}
+  };
+
+  // the values of a block of a scan, to the output
+  template <class intT>
+  void writeScanBlock(double* Out, intT s, intT n, const double* v) {
+    for (intT j=0; j < n; j++) Out[s+j] = v[j];
+  }
+
+  template <class Al, class intT>
+  void writeScanBlock(ManSeg::TwoSegArray<true,Al> Out, intT s, intT n, const double* v) {
+    Out.writeBlock(s, n, v);
+  }
+
+  template <class Al, class intT>
+  void writeScanBlock(ManSeg::TwoSegArray<false,Al> Out, intT s, intT n, const double* v) {
+    Out.template writeBlock<ManSeg::ROUND_NEAREST>(s, n, v);
+  }
+
+  // sum of A[0..n)
+  template <bool P, class Al, class intT>
+  double plusReduce(const ManSeg::TwoSegArray<P,Al>& A, intT n) {
+    intT s = 0, e = n;
+    intT l = nblocks(n, _SCAN_BSIZE);
+    if (l <= 1) return n > 0 ? ManSeg::kahanSum(A, 0, n) : 0.0;
+    double *Sums = newA(double,l);
+    blocked_for (i, s, e, _SCAN_BSIZE, Sums[i] = ManSeg::kahanSum(A, s, e-s););
+    double r = ManSeg::kahanSum(Sums, 0, l);
+    free(Sums);
+    return r;
+  }
+
+  // sum of A[i] * W[i] over [0, n), W any arithmetic array (e.g. degrees)
+  template <bool P, class Al, class WT, class intT>
+  double plusReduce(const ManSeg::TwoSegArray<P,Al>& A, WT* W, intT n) {
+    intT s = 0, e = n;
+    intT l = nblocks(n, _SCAN_BSIZE);
+    if (n <= 0) return 0.0;
+    double *Sums = newA(double,l);
+    blocked_for (i, s, e, _SCAN_BSIZE, {
+        double a[_SCAN_BSIZE];
+        double w[_SCAN_BSIZE];
+        A.readBlock(s, e-s, a);
+        for (intT j=0; j < e-s; j++) w[j] = (double) W[s+j];
+        Sums[i] = ManSeg::dot((const double*) a, (const double*) w, 0, e-s);
+      });
+    double r = ManSeg::kahanSum(Sums, 0, l);
+    free(Sums);
+    return r;
+  }
+
+  // f-reduction of A[0..n) for an f other than +, e.g. a max (n > 0)
+  template <bool P, class Al, class intT, class F>
+  double reduce(const ManSeg::TwoSegArray<P,Al>& A, intT n, F f) {
+    intT s = 0, e = n;
+    intT l = nblocks(n, _SCAN_BSIZE);
+    double *Sums = newA(double,l);
+    blocked_for (i, s, e, _SCAN_BSIZE, {
+        double a[_SCAN_BSIZE];
+        A.readBlock(s, e-s, a);
+        double r = a[0];
+        for (intT j=1; j < e-s; j++) r = f(r, a[j]);
+        Sums[i] = r;
+      });
+    double r = reduce(Sums, l, f);
+    free(Sums);
+    return r;
+  }
+
+  // exclusive + scan of In[0..n) into Out (double*, HeadsArray or PairsArray, and may be In); returns
+  // the total. The running sum is compensated, so Out[i] is the sum to within a rounding of its own.
+  template <bool P, class Al, class OT, class intT>
+  double plusScan(const ManSeg::TwoSegArray<P,Al>& In, OT Out, intT n) {
+    intT s = 0, e = n;
+    if (n <= 0) return 0.0;
+    intT l = nblocks(n, _SCAN_BSIZE);
+    double *Sums = newA(double,l);
+    double *Errs = newA(double,l);
+    blocked_for (i, s, e, _SCAN_BSIZE, Sums[i] = ManSeg::kahanSum(In, s, e-s););
+    // each block's offset as a sum and its compensation
+    double sum = 0.0, err = 0.0;
+    for (intT i=0; i < l; i++) {
+      double b = Sums[i];
+      Sums[i] = sum; Errs[i] = err;
+      double y = b - err, t = sum + y;
+      err = (t - sum) - y; sum = t;
+    }
+    blocked_for (i, s, e, _SCAN_BSIZE, {
+        double v[_SCAN_BSIZE];
+        In.readBlock(s, e-s, v);
+        double run = Sums[i];
+        double c = Errs[i];
+        for (intT j=0; j < e-s; j++) {
+          double y = v[j] - c;
+          double t = run + y;
+          c = (t - run) - y;
+          v[j] = run; run = t;
+        }
+        writeScanBlock(Out, s, e-s, v);
+      });
+    free(Sums); free(Errs);
+    return sum;
+  }
+
+  // the values of In[0..n) for which p(value) holds, in order, into Out; returns how many
+  template <bool P, class Al, class intT, class PRED>
+  intT filter(const ManSeg::TwoSegArray<P,Al>& In, double* Out, intT n, PRED p) {
+    intT s = 0, e = n;
+    bool *Fl = newA(bool,n);
+    blocked_for (i, s, e, _SCAN_BSIZE, {
+        double v[_SCAN_BSIZE];
+        In.readBlock(s, e-s, v);
+        for (intT j=0; j < e-s; j++) Fl[s+j] = (bool) p(v[j]);
+      });
+    intT m = pack(Out, Fl, (intT) 0, n, getTwoSeg<P,Al>(In)).n;
+    free(Fl);
+    return m;
+  }
+
+  // the indices of the values of In[0..n) for which p(value) holds, in order
+  template <bool P, class Al, class intT, class PRED>
+  _seq<intT> filterIndex(const ManSeg::TwoSegArray<P,Al>& In, intT n, PRED p) {
+    intT s = 0, e = n;
+    bool *Fl = newA(bool,n);
+    blocked_for (i, s, e, _SCAN_BSIZE, {
+        double v[_SCAN_BSIZE];
+        In.readBlock(s, e-s, v);
+        for (intT j=0; j < e-s; j++) Fl[s+j] = (bool) p(v[j]);
+      });
+    _seq<intT> R = packIndex(Fl, n);
+    free(Fl);
+    return R;
+  }
+
 }
 
 #endif // _A_SEQUENCE_INCLUDED
@@ -33,16 +33,24 @@
 #include <string>
 #include <assert.h>
 #include <algorithm>
+#include <type_traits>
+#include <utility>
 #include <sys/mman.h>
+#include <unistd.h>
 #ifndef __APPLE__
 #include <numa.h>
 #endif
 #include "parallel.h"
+// the library's bulk operations (promotion, reductions, fills) run on Ligra's parallel_for
+#ifndef MANSEG_PARALLEL_FOR
+#define MANSEG_PARALLEL_FOR parallel_for
+#endif
 #include "gettime.h"
 #include "utils.h"
 #include "graph-numa.h"
 #include "IO.h"
 #include "parseCommandLine.h"
+#include "../../manseglib_results.hpp"
 #ifndef PART96
 #define PART96 0
 #endif
@@ -51,10 +59,32 @@
 #define PAPI_CACHE 0
 #endif
 
-#if PAPI_CACHE
+// the same per round counters through perf_event_open, without libpapi (see perf_code.h)
+#ifndef PERF_CACHE
+#define PERF_CACHE 0
+#endif
+
+#if PERF_CACHE
+#undef PAPI_CACHE
+#define PAPI_CACHE 1
+#include "perf_code.h"
+#elif PAPI_CACHE
 #include "papi_code.h"
 #endif
 
+// the time and edges of each partition of the dense edgeMaps, printed per NUMA node after every round,
+// and with -rebalance the CSC boundaries moved to even out the times (see partition_profile.h)
+#ifndef PARTITION_PROFILE
+#define PARTITION_PROFILE 0
+#endif
+
+#if PARTITION_PROFILE
+#include "partition_profile.h"
+#endif
+
+// -tune: the COO partition count chosen by trial rounds (see partition_tune.h)
+#include "partition_tune.h"
+
 #define STEP (4096)
 //Timer design
 using namespace std;
@@ -345,6 +375,64 @@ void remDuplicates(intT* indices, intT* flags, intT m, intT n)
     }
 }
 
+//*****PREFETCH HOOK*****
+// A functor may define prefetch(intT s), which the dense edge loops call for the source of the edge
+// LIGRA_PREFETCH_DISTANCE edges ahead, so it can prefetch what update() will read at random for s
+// (e.g. ManSeg::prefetch(p_curr, s)). Functors without it are not affected; 0 turns it off.
+#ifndef LIGRA_PREFETCH_DISTANCE
+#define LIGRA_PREFETCH_DISTANCE 16
+#endif
+
+template<class F>
+struct has_prefetch
+{
+    template<class G> static char test(decltype(std::declval<G&>().prefetch(intT(0)))*);
+    template<class G> static long test(...);
+    static const bool value = LIGRA_PREFETCH_DISTANCE > 0 && sizeof(test<F>(0)) == 1;
+};
+
+template<class F>
+inline typename std::enable_if<has_prefetch<F>::value>::type edgePrefetch( F &f, intT src )
+{
+    f.prefetch(src);
+}
+template<class F>
+inline typename std::enable_if<!has_prefetch<F>::value>::type edgePrefetch( F &, intT ) {}
+
+// in-edge j + LIGRA_PREFETCH_DISTANCE of V, if it has one
+template<class F, class vertex>
+inline void prefetchInNeighbor( F &f, vertex &V, intT j, intT d )
+{
+    if( has_prefetch<F>::value && j + LIGRA_PREFETCH_DISTANCE < d )
+        edgePrefetch( f, V.getInNeighbor(j + LIGRA_PREFETCH_DISTANCE) );
+}
+
+// the edge LIGRA_PREFETCH_DISTANCE after I in a COO edge list, if there is one
+template<class F, class Edge>
+inline void prefetchEdgeSource( F &f, const Edge *I, const Edge *E )
+{
+    if( has_prefetch<F>::value && E - I > LIGRA_PREFETCH_DISTANCE )
+        edgePrefetch( f, I[LIGRA_PREFETCH_DISTANCE].getSource() );
+}
+
+// A functor with set_node(int) reads data kept once per NUMA node (e.g. ReplicatedHeads in
+// manseg_replica.h): the dense loops give the partitions of node i a copy of it told i.
+template<class F>
+struct has_set_node
+{
+    template<class G> static char test(decltype(std::declval<G&>().set_node(0))*);
+    template<class G> static long test(...);
+    static const bool value = sizeof(test<F>(0)) == 1;
+};
+
+template<class F>
+inline typename std::enable_if<has_set_node<F>::value>::type edgeSetNode( F &f, int node )
+{
+    f.set_node(node);
+}
+template<class F>
+inline typename std::enable_if<!has_set_node<F>::value>::type edgeSetNode( F &, int ) {}
+
 //*****EDGE FUNCTIONS*****
 // Apply an edgeMapDense(Backward) to all vertices in the frontier.
 // By construction of the graph, only vertices within the partition
@@ -569,6 +657,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
 		    // TODO: only parallel if d large enough
                for(intT j=0; j<d; j++)
                 {
+                    prefetchInNeighbor( f, V, j, d );
                     intT ngh = V.getInNeighbor(j);
                     edgeOpInAtomic( ngh, j, id, V.getInWeight(j), f, next );
                 }
@@ -606,7 +695,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
 
                         for(intT j=0; j<d; j++)
                         {
-
+                            prefetchInNeighbor( f, V, j, d );
                             intT ngh = V.getInNeighbor(j);
                             if( !edgeOpIn( ngh, cache, j, id, V.getInWeight(j), f, next ) )
                                 break;
@@ -618,6 +707,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
                     {
                         for(intT j=0; j<d; j++)
                         {
+                            prefetchInNeighbor( f, V, j, d );
                             intT ngh = V.getInNeighbor(j);
                             if( !edgeOpIn( ngh, j, id, V.getInWeight(j), f, next ) )
                                 break;
@@ -655,6 +745,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
 	        // TODO: only parallel if d large enough
                for(intT j=0; j<d; j++)
                 {
+                    prefetchInNeighbor( f, V, j, d );
                     intT ngh = V.getInNeighbor(j);
                     edgeOpInAtomic( ngh, j, id, V.getInWeight(j), f, vertices, next );
                 }
@@ -693,7 +784,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
 
                         for(intT j=0; j<d; j++)
                         {
-
+                            prefetchInNeighbor( f, V, j, d );
                             intT ngh = V.getInNeighbor(j);
                             if( !edgeOpIn( ngh, cache, j, id, V.getInWeight(j), f, vertices, next ) )
                                 break;
@@ -705,6 +796,7 @@ bool* edgeMapDenseCSC(graph<vertex> GA, bool * vertices,bool bit,
                     {
                         for(intT j=0; j<d; j++)
                         {
+                            prefetchInNeighbor( f, V, j, d );
                             intT ngh = V.getInNeighbor(j);
                             if( !edgeOpIn( ngh, j, id, V.getInWeight(j), f, vertices, next ) )
                                 break;
@@ -813,6 +905,7 @@ bool* edgeMapDense(const EdgeList<Edge> & EL, bool* vertices, bool bit, F f, boo
                   I=EL.cbegin(); I != E; ++I )
 #endif
        {
+        prefetchEdgeSource( f, I, E );
         const Edge &eref = *I;
 
         intT src = eref.getSource();
@@ -842,6 +935,7 @@ bool* edgeMapDense(const EdgeList<Edge> & EL, bool* vertices, bool bit, F f, boo
 #endif
        
        {
+        prefetchEdgeSource( f, I, E );
         const Edge &eref = *I;
 
         intT src = eref.getSource();
@@ -863,6 +957,87 @@ bool* edgeMapDense(const EdgeList<Edge> & EL, bool* vertices, bool bit, F f, boo
     return next;
 }
 
+#if COMPRESSED_EDGES
+//compressed COO edgelist, decoded block by block as it is traversed
+template<class F, class Edge>
+bool* edgeMapDense(const CompressedEdgeList<Edge> & EL, bool* vertices, bool bit, F f, bool *next)
+{
+    intT nb = EL.get_num_blocks();
+#if PART96
+    for( intT b=0; b < nb; ++b )
+#else
+    parallel_for( intT b=0; b < nb; ++b )
+#endif
+    {
+        EL.decode_block( b, [&]( intT src, intT dst, intE wgh )
+        {
+            if( f.cond(dst) )
+            {
+                if (bit)
+                {
+#if PART96
+                    edgeOpIn( src, /*unused*/1, dst, wgh, f, next );
+#else
+                    edgeOpInAtomic( src, 1, dst, wgh, f, next );
+#endif
+                }
+                else
+                {
+#if PART96
+                    edgeOpIn( src, /*unused*/1, dst, wgh, f, vertices, next );
+#else
+                    edgeOpInAtomic( src, 1, dst, wgh, f, vertices, next );
+#endif
+                }
+            }
+        } );
+    }
+    return next;
+}
+#endif
+
+#if LOCAL_EDGE_IDS
+//COO edgelist of partition-relative 32-bit ids
+template<class F, class Edge>
+bool* edgeMapDense(const LocalIdEdgeList<Edge> & EL, bool* vertices, bool bit, F f, bool *next)
+{
+    typedef typename LocalIdEdgeList<Edge>::const_iterator iterator;
+    iterator E=EL.cend();
+#if PART96
+    for( iterator I=EL.cbegin(); I != E; ++I )
+#else
+    parallel_for( iterator I=EL.cbegin(); I != E; ++I )
+#endif
+    {
+        if( has_prefetch<F>::value && E - I > LIGRA_PREFETCH_DISTANCE )
+            edgePrefetch( f, EL.getSource( I[LIGRA_PREFETCH_DISTANCE] ) );
+        intT src = EL.getSource( *I );
+        intT dst = EL.getDestination( *I );
+        intE wgh = EL.getWeight( *I );
+        if( f.cond(dst) )
+        {
+            if (bit)
+            {
+#if PART96
+                edgeOpIn( src, /*unused*/1, dst, wgh, f, next );
+#else
+                edgeOpInAtomic( src, 1, dst, wgh, f, next );
+#endif
+            }
+            else
+            {
+#if PART96
+                edgeOpIn( src, /*unused*/1, dst, wgh, f, vertices, next );
+#else
+                edgeOpInAtomic( src, 1, dst, wgh, f, vertices, next );
+#endif
+            }
+        }
+    }
+    return next;
+}
+#endif
+
 template <class F, class vertex>
 pair<uintT,intT*> edgeMapSparseWithG(graph<vertex> GA, partitioned_vertices frontier, uintT Totalm, F f, intT remDups=0, intT* flags=NULL)
 {
@@ -913,6 +1088,96 @@ pair<uintT,intT*> edgeMapSparseWithG(graph<vertex> GA, partitioned_vertices fron
     return pair<uintT,intT*>(nextM, nextIndices);
 }
 
+//*****DIRECTION COST MODEL*****
+// A functor may declare the bytes a vertex takes in the array update() reads at the source
+// (read_bytes) and in the one it writes at the destination (write_bytes), e.g. 4 for ManSeg heads
+// and 8 for doubles. edgeMap with threshold -1 then estimates the bytes each traversal moves and
+// takes the cheapest, rather than comparing the frontier with m/20:
+//   sparse:    per active vertex its id, offset and value; per out-edge the target, an atomic update
+//              of its value and its slot in the output (written, then filtered)
+//   dense CSC: per vertex its offset, value and frontier flags; per in-edge the source and its flag;
+//              per active out-edge a random read of the source's value
+//   dense COO: per edge its source, destination and flag; per active out-edge a random read of the
+//              source's value and an update of the destination's (atomic unless PART96)
+// A random access costs its bytes, plus a cache line as often as the array outgrows the last level
+// cache, and an atomic update a whole line, which it takes exclusive. The smaller values of the heads
+// so move the crossover through the hit rate as well as the byte counts. COO is only considered
+// where the edge lists exist (not with -v vertex).
+template<class F>
+struct has_value_bytes
+{
+    template<class G> static char test(decltype(G::read_bytes + G::write_bytes)*);
+    template<class G> static long test(...);
+    static const bool value = sizeof(test<F>(0)) == 1;
+};
+
+enum edgeMapStrategy { EDGEMAP_SPARSE, EDGEMAP_DENSE_CSC, EDGEMAP_DENSE_COO };
+
+inline double lastLevelCacheBytes()
+{
+    static long bytes = 0;
+    if( bytes == 0 )
+    {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+        if( bytes <= 0 )
+            bytes = 8 * 1024 * 1024;
+    }
+    return bytes;
+}
+
+// bytes moved by a random access to one of n values of the given size
+inline double randomAccessBytes( intT n, int bytes )
+{
+    double miss = 1.0 - lastLevelCacheBytes() / ((double)n * bytes);
+    return bytes + (miss > 0 ? 64 * miss : 0);
+}
+
+inline edgeMapStrategy edgeMapCostModel( intT n, intT edges, intT active, intT outEdges,
+                                         int readBytes, int writeBytes, bool haveCOO )
+{
+    const double I = sizeof(intT), E = sizeof(intE), line = 64;
+#if LOCAL_EDGE_IDS
+    const double cooEdge = sizeof(LocalIdEdgeList<Edge>::LocalEdge);
+#else
+    const double cooEdge = sizeof(Edge);
+#endif
+    const double read = randomAccessBytes(n, readBytes);
+#if PART96
+    const double update = 2 * randomAccessBytes(n, writeBytes);
+#else
+    const double update = line;
+#endif
+    double sparse = active * (2*I + readBytes) + (double)outEdges * (E + line + 2*I);
+    double csc = n * (I + writeBytes + 2) + (double)edges * (E + 1) + (double)outEdges * read;
+    double coo = 2.0 * n + (double)edges * (cooEdge + 1) + (double)outEdges * (read + update);
+    if( haveCOO && coo < csc && coo < sparse )
+        return EDGEMAP_DENSE_COO;
+    return csc < sparse ? EDGEMAP_DENSE_CSC : EDGEMAP_SPARSE;
+}
+
+// a functor with a static pull_only member (set true) only sums a destination's in-edges in its
+// cache: it needs the dense CSC, where each destination owns its edges, and never runs on the COO
+template<class F>
+struct is_pull_only
+{
+    template<class G> static char test(decltype(G::pull_only)*);
+    template<class G> static long test(...);
+    static const bool value = sizeof(test<F>(0)) == 1;
+};
+
+template<class F, bool = has_value_bytes<F>::value>
+struct value_bytes
+{
+    static const int read = 8, write = 8;
+};
+template<class F>
+struct value_bytes<F, true>
+{
+    static const int read = F::read_bytes, write = F::write_bytes;
+};
+
 static int edgesTraversed = 0;
 template <class F, class vertex>
 partitioned_vertices edgeMap(partitioned_graph<vertex> GA, partitioned_vertices Localfrontier, F f, intT threshold = -1,char option=DENSE, bool remDups=false)
@@ -926,10 +1191,6 @@ partitioned_vertices edgeMap(partitioned_graph<vertex> GA, partitioned_vertices
     int coo_partitions=coo_part.get_num_partitions();
     const int coo_perNode = coo_part.get_num_per_node_partitions();
     intT numVertices = GA.n;
-    // first threshold for dense/sparse
-    if(threshold == -1) threshold = GA.m/20; //default threshold
-    // second threshold for dense edgelist/CSC
-    intT denseThreshold = GA.m/2;
 
     intT m = Localfrontier.numNonzeros();
     if (numVertices != Localfrontier.numRows())
@@ -946,29 +1207,94 @@ partitioned_vertices edgeMap(partitioned_graph<vertex> GA, partitioned_vertices
     // m = NNZ, outDegrees is #out-edges for active vertices, threshold=edges in graph/20
     partitioned_vertices v1;
 
+    // the functor's value sizes give the strategy with the cost model, or else a threshold on
+    // the frontier (m/20 by default) chooses between dense and sparse
+    edgeMapStrategy strategy;
+    const bool haveCOO = !GA.part_ver && !is_pull_only<F>::value;
+    if( threshold == -1 && has_value_bytes<F>::value )
+        strategy = edgeMapCostModel( numVertices, GA.m, m, TotalOutDegrees,
+                                     value_bytes<F>::read, value_bytes<F>::write, haveCOO );
+    else
+    {
+        if(threshold == -1) threshold = GA.m/20; //default threshold
+        if( m+TotalOutDegrees <= threshold )
+            strategy = EDGEMAP_SPARSE;
+#if COMPRESSED_EDGES || LOCAL_EDGE_IDS
+        else if (haveCOO) // the compressed (or local id) COO partitions replace the CSC for dense traversal, but not for a pull
+            strategy = EDGEMAP_DENSE_COO;
+#endif
+        else // CSC while still using edge balancing for pagerank
+            strategy = EDGEMAP_DENSE_CSC;
+    }
+
     tmlog( tm_setup, tm_edgemap_setup_ );
     // Here try to remodify the order of graph traversal
-    if(  m+TotalOutDegrees > threshold)
+    if( strategy != EDGEMAP_SPARSE )
     {
       Localfrontier.toDense(coo_part);
       v1 = partitioned_vertices::dense(numVertices,coo_part);
-    //   if (m+TotalOutDegrees > denseThreshold && !GA.part_ver) // if(false)
-      if (false) // force use CSC format while still using edge balancing for pagerank
+      if( strategy == EDGEMAP_DENSE_COO )
       {
+#if PARTITION_PROFILE
+            partitionProfile.begin( coo_partitions, coo_perNode );
+#endif
             parallel_for_numa(int i=0; i < num_numa_node; ++i )   //same loop with allocation
             {
+                F fi = f;
+                edgeSetNode( fi, i );
                 parallel_for( int p = coo_perNode*i; p < coo_perNode*(i+1); ++p )
-                   edgeMapDense(GA.get_edge_list_partition(p),Localfrontier.d, Localfrontier.bit, f, v1.d);
+                {
+#if COMPRESSED_EDGES
+                   const auto & EL = GA.get_compressed_edge_list_partition(p);
+#elif LOCAL_EDGE_IDS
+                   const auto & EL = GA.get_local_id_edge_list_partition(p);
+#else
+                   const auto & EL = GA.get_edge_list_partition(p);
+#endif
+#if PARTITION_PROFILE
+                   const double t0 = PartitionProfile::now();
+                   edgeMapDense(EL,Localfrontier.d, Localfrontier.bit, fi, v1.d);
+                   partitionProfile.record( p, PartitionProfile::now() - t0, EL.get_num_edges() );
+#else
+                   edgeMapDense(EL,Localfrontier.d, Localfrontier.bit, fi, v1.d);
+#endif
+                }
             }
+#if PARTITION_PROFILE
+            partitionProfile.end();
+#endif
             tmlog( tm_setup, tm_edgemap_dense_ );
       }
       else
       {
+#if PARTITION_PROFILE
+            partitionProfile.begin( coo_partitions, coo_perNode );
+#endif
             parallel_for_numa( int i=0; i < num_numa_node; ++i )   //same loop with allocation
             {
+                F fi = f;
+                edgeSetNode( fi, i );
                 parallel_for( int p = coo_perNode*i; p < coo_perNode*(i+1); ++p )
-                   edgeMapDenseCSC(WG, Localfrontier.d,Localfrontier.bit,f, v1.d, csc_part.start_of(p), csc_part.start_of(p+1), GA.source);
+                {
+#if PARTITION_PROFILE
+                   const intT lo = partitionProfile.start_of( csc_part, p ), hi = partitionProfile.start_of( csc_part, p+1 );
+                   const double t0 = PartitionProfile::now();
+                   edgeMapDenseCSC(WG, Localfrontier.d,Localfrontier.bit,fi, v1.d, lo, hi, GA.source);
+                   const double t1 = PartitionProfile::now();
+                   long edges = 0;
+                   for( intT j = lo; j < hi; ++j )
+                       edges += WG.CSCV[j].second.getInDegree();
+                   partitionProfile.record( p, t1 - t0, edges );
+#else
+                   edgeMapDenseCSC(WG, Localfrontier.d,Localfrontier.bit,fi, v1.d, csc_part.start_of(p), csc_part.start_of(p+1), GA.source);
+#endif
+                }
             }   
+#if PARTITION_PROFILE
+            partitionProfile.end();
+            if( partitionProfile.rebalance() )
+                partitionProfile.rebalanceBounds( csc_part, [&]( intT j ) { return WG.CSCV[j].second.getInDegree() + 1.0; } );
+#endif
        }
         // Calculate statistics on active vertices and their out-degree
            intTpair p = sequence::reduce<intT>((intT)0, (intT)GA.n,
@@ -1111,6 +1437,78 @@ inline bool cond_true (intT d)
 template<class GraphType>
 void Compute(GraphType&, long);
 
+// results of the run, written to $MANSEG_RESULTS by parallel_main; Compute can add its iterations
+ManSeg::ResultsWriter* ligraResults = 0;
+
+// the rounds of Compute on G partitioned numOfCoo ways, or with tune, on one trial round per candidate
+// count and the rest at the count that finishes them soonest; returns that count, or numOfCoo
+template<class vertex>
+int runRounds(wholeGraph<vertex> & G, long start, long rounds, int numOfCoo, PartitionTune* tune,
+               bool part_src, bool part_vertex, bool relabel, ManSeg::ResultsWriter & results)
+{
+    const size_t trials = tune ? tune->counts().size() : 0;
+    partitioned_graph<vertex>* PG = 0;
+    int built = 0;
+    double buildTime = 0;
+#if PAPI_CACHE 
+    PAPI_initial();         /*PAPI Event inital*/
+#endif
+    for(int r=0; r<rounds; r++)
+    {
+        const int count = (size_t)r < trials ? tune->counts()[r] : numOfCoo;
+        if(count != built)
+        {
+            timer build;
+            build.start();
+            if(PG)
+            {
+                PG->del();
+                delete PG;
+            }
+            PG = new partitioned_graph<vertex>( G, count, part_src, part_vertex, relabel);
+            if(PG->transposed()) PG->transpose();
+            buildTime = build.next();
+            built = count;
+        }
+#if PAPI_CACHE 
+        PAPI_start_count();   /*start PAPI counters*/
+#endif
+        results.round(r);
+        startTime();
+        Compute(*PG,start);
+        double roundTime = _tm.next();
+        cout << "Running : ";
+        _tm.reportT(roundTime);
+#if PARTITION_PROFILE
+        partitionProfile.report(results);
+#endif
+        results.endRound(roundTime);
+#if PAPI_CACHE 
+        PAPI_stop_count();   /*stop PAPI counters*/
+        PAPI_print();   /* PAPI results print*/
+#endif
+        if(PG->transposed()) PG->transpose();
+
+        if((size_t)r < trials)
+        {
+            tune->record(r, buildTime, roundTime);
+            cerr << "tune: " << count << " partitions, build " << buildTime << " s, round " << roundTime << " s" << endl;
+            if((size_t)r + 1 == trials)
+            {
+                numOfCoo = tune->choose(r, rounds - r - 1);
+                cerr << "tune: using " << numOfCoo << " partitions" << endl;
+            }
+        }
+    }
+    reportAvg(rounds);
+    if(PG)
+    {
+        PG->del();
+        delete PG;
+    }
+    return numOfCoo;
+}
+
 //driver
 int parallel_main(int argc, char* argv[])
 {
@@ -1118,6 +1516,7 @@ int parallel_main(int argc, char* argv[])
     char* iFile = P.getArgument(0);
     bool symmetric = P.getOptionValue("-s");
     bool binary = P.getOptionValue("-b");             //Galois binary format
+    bool shared = P.getOptionValue("-shm");           //share the binary graph's edges with other jobs
     long start = P.getOptionLongValue("-r",100);      //start vertex for BFS,BC and BellmanFord
     long rounds = P.getOptionLongValue("-rounds",3); // Usually 20 rounds
     int numOfNode = P.getOptionLongValue("-p", 4);    // NUMA node number
@@ -1125,6 +1524,8 @@ int parallel_main(int argc, char* argv[])
     char *part_how = P.getOptionValue("-P");          // Parition method, default is partition by destination
     char *vertex_edge = P.getOptionValue("-v");       // vertex/edge oriented, default is edge
     bool relabel = P.getOptionValue("-o");            // original/relabel graph, if -o, uses relabel graph 
+    bool rebalance = P.getOptionValue("-rebalance");  // move the CSC partition boundaries by their measured times
+    char *tune_list = P.getOptionValue("-tune");      // choose the partition count from these (or "auto") by trial rounds
     bool part_src = true;
     bool part_vertex = true;
     if( !part_how || !strcmp( part_how, "dest" ) )
@@ -1157,31 +1558,52 @@ int parallel_main(int argc, char* argv[])
         numOfNode = 1;
     cerr << "numOfNode: " << numOfNode << endl;
 #endif
-    if(symmetric)
-    {
-        wholeGraph<symmetricVertex> G =
-            readGraph<symmetricVertex>(iFile,symmetric,binary); //symmetric graph
-        partitioned_graph<symmetricVertex> PG( G, numOfCoo, part_src, part_vertex,relabel);
-        intT n = G.n;
-
-#if PAPI_CACHE 
-        PAPI_initial();         /*PAPI Event inital*/
+    const char* app = strrchr(argv[0], '/');
+    ManSeg::ResultsWriter results(app ? app + 1 : argv[0]);
+    ligraResults = &results;
+    results.set("input", iFile);
+    results.set("threads", getWorkers());
+#if NUMA
+    results.set("numa", "partitioned");
+#else
+    results.set("numa", "none");
 #endif
-        for(int r=0; r<rounds; r++)
+    results.set("numa_nodes", numOfNode);
+    results.set("partition_by", part_src ? "source" : "dest");
+    results.set("rounds", rounds);
+
+    // with -tune, a count cached for this graph, app and partitioning, or trial rounds to find one
+    PartitionTune* tune = 0;
+    std::ostringstream tuneKey;
+    tuneKey << (app ? app + 1 : argv[0]) << "/" << (part_src ? "source" : "dest") << "/" << (part_vertex ? "vertex" : "edge")
+            << "/" << (relabel ? "relabel" : "original") << "/" << numOfNode << "x" << getWorkers();
+    if(tune_list)
+    {
+        int cached = PartitionTune::cached(iFile, tuneKey.str());
+        if(cached > 0)
         {
-#if PAPI_CACHE 
-            PAPI_start_count();   /*start PAPI counters*/
-#endif
-            startTime();
-            Compute(PG,start);
-            nextTime("Running");
-#if PAPI_CACHE 
-            PAPI_stop_count();   /*stop PAPI counters*/
-            PAPI_print();   /* PAPI results print*/
-#endif
+            numOfCoo = cached;
+            cerr << "tune: " << numOfCoo << " partitions from " << iFile << ".tune" << endl;
+            results.set("partition_tuning", "cached");
+        }
+        else
+        {
+            tune = new PartitionTune(tune_list, numOfCoo, numOfNode);
+            results.set("partition_tuning", "trials");
         }
-        reportAvg(rounds);
-        PG.del();
+    }
+#if PARTITION_PROFILE
+    partitionProfile.setRebalance(rebalance);
+    results.set("rebalance", rebalance ? 1 : 0);
+#else
+    if(rebalance)
+        cerr << "-rebalance needs a build with -DPARTITION_PROFILE=1; ignored" << endl;
+#endif
+    if(symmetric)
+    {
+        wholeGraph<symmetricVertex> G =
+            readGraph<symmetricVertex>(iFile,symmetric,binary,shared); //symmetric graph
+        numOfCoo = runRounds(G, start, rounds, numOfCoo, tune, part_src, part_vertex, relabel, results);
         G.del();
     }
     else
@@ -1190,38 +1612,26 @@ int parallel_main(int argc, char* argv[])
         double load_t=0;
         load.start();
         wholeGraph<asymmetricVertex> G =
-            readGraph<asymmetricVertex>(iFile,symmetric,binary); //asymmetric graph
+            readGraph<asymmetricVertex>(iFile,symmetric,binary,shared); //asymmetric graph
         cerr<<"Loading: "<<tmlog(load,load_t)<<endl;
-        partitioned_graph<asymmetricVertex> PG( G, numOfCoo, part_src, part_vertex,relabel);
-        if(PG.transposed()) PG.transpose();
-
-        intT n = G.n;
-#if PAPI_CACHE 
-        PAPI_initial();         /*PAPI Event inital*/
-#endif
-        for(int r=0; r<rounds; r++)
-        {
-#if PAPI_CACHE 
-            PAPI_start_count();   /*start PAPI counters*/
-#endif
-            startTime();
-            Compute(PG,start);
-            nextTime("Running");
-#if PAPI_CACHE 
-            PAPI_stop_count();   /*stop PAPI counters*/
-            PAPI_print();   /* PAPI results print*/
-#endif
-	    if(PG.transposed()) PG.transpose();
-        }
-        reportAvg(rounds);
-        PG.del();
+        numOfCoo = runRounds(G, start, rounds, numOfCoo, tune, part_src, part_vertex, relabel, results);
         G.del();
-
     }
+    if(tune)
+    {
+        // the count the trials chose, unless there were too few rounds to try them all
+        if((size_t)rounds >= tune->counts().size())
+            PartitionTune::save(iFile, tuneKey.str(), numOfCoo);
+        results.set("partition_trials", tune->trials());
+        delete tune;
+    }
+    results.set("partitions", numOfCoo);
 #if PAPI_CACHE 
         PAPI_total_print(rounds);   /* PAPI results print*/
         PAPI_end();
 #endif
     //timeprint();    /* Time Details print*/
+    results.write();
+    ligraResults = 0;
     return 0;
 }
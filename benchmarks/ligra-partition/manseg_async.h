@@ -0,0 +1,337 @@
+// -*- C++ -*-
+// Asynchronous PageRank of PageRankManSeg ($MANSEG_ASYNC=1), without a barrier between iterations.
+//
+// An iteration of edgeMap is bulk synchronous: every partition's scatter ends before the vertex phase
+// and its sums, and those before the next scatter, so each iteration waits for its slowest node, twice.
+// Here every worker owns a range of vertices of its own node's partitions and sweeps it over and over
+// at its own pace. It pulls each of its vertices from the contributions (damping * rank / outdeg) the
+// other workers published last, and publishes its own as it goes: x[d] is only written by its owner,
+// contrib[s] is read by every worker with an in-edge from s. The rank lost to dangling vertices and
+// teleports is added back from the sum each worker published after its last sweep. With a single
+// worker a sweep is a Gauss-Seidel iteration; with more, how fresh a contribution is depends on timing.
+//
+// The sweeps are at the heads while the precision controller says so, with contrib a heads array
+// whose tails stay zero, then read and write x and contrib as pairs: a head whose tail is still zero
+// reads as the head, so no interim sweep is needed and the workers switch one by one. A round is over
+// once every worker has finished another sweep. Its delta, the sum of every worker's last change,
+// goes to the controller, and to the results as an iteration.
+//
+// Convergence is detected without a barrier either. A round whose delta is below epsilon raises a
+// probe. Each worker tags a sweep with the probe it started under. The run stops once every worker
+// has finished a sweep started under the probe and the sum of those sweeps' changes is still below
+// epsilon. Those sweeps read only values published after the probe was raised, so nothing a worker
+// was still to publish can move the ranks further. A probe that fails is dropped, and the next quiet
+// round raises another.
+//
+// The workers are threads of their own, placed as ManSeg::ThreadTopology places worker w of n, on the
+// node of Ligra's partition w of n. Node i's vertices are split between the workers on node i by
+// their in-edges. With fewer workers than nodes, a worker takes whole nodes. Contributions are plain
+// 32-bit stores and loads, which x86 and AArch64 make whole; a pair read while its owner writes it may
+// take the new head with the old tail, off by less than the change itself. Needs pulling (-P destination).
+#ifndef MANSEG_ASYNC_H
+#define MANSEG_ASYNC_H
+// mm.h has no include guard, so include this after ligra-numa.h
+#include <math.h>
+#include <stdlib.h>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+
+// $MANSEG_ASYNC=1 runs PageRankManSeg asynchronously
+inline bool asyncMode()
+{
+    const char* async = getenv("MANSEG_ASYNC");
+    return async != nullptr && atoi(async) != 0;
+}
+
+// what worker w publishes after each of its sweeps, a cache line of its own
+struct alignas(64) AsyncSlot
+{
+    std::atomic<long> sweeps;       // sweeps finished
+    std::atomic<double> change;     // sum |new - old| over its vertices in its last sweep
+    std::atomic<double> kept;       // damping times the rank its vertices with out-edges passed on
+    std::atomic<long> probe;        // the probe its last sweep started under, 0 for none
+};
+static_assert( sizeof(AsyncSlot) == 64, "an AsyncSlot is one cache line" );
+
+// std::allocator only aligns to alignof(max_align_t) before C++17, so the slots get lines of their own from this
+template<class T>
+struct CacheLineAllocator
+{
+    typedef T value_type;
+    CacheLineAllocator() {}
+    template<class U> CacheLineAllocator( const CacheLineAllocator<U> & ) {}
+    T *allocate( size_t n )
+    {
+        void *p = nullptr;
+        if( posix_memalign( &p, alignof(T) > 64 ? alignof(T) : 64, n * sizeof(T) ) != 0 )
+            throw std::bad_alloc();
+        return static_cast<T *>( p );
+    }
+    void deallocate( T *p, size_t ) { free( p ); }
+    template<class U> bool operator==( const CacheLineAllocator<U> & ) const { return true; }
+    template<class U> bool operator!=( const CacheLineAllocator<U> & ) const { return false; }
+};
+
+template<class vertex, class Policy, ManSeg::RoundingMode Rounding = ManSeg::ROUND_TRUNCATE>
+class AsyncPageRank
+{
+public:
+    /*
+        x starts from its heads, or from its pairs if control is past the heads; contrib is zeroed, with
+        tails; both are partitioned as part. m is the number of edges, for the traffic of a round.
+    */
+    AsyncPageRank( const partitioner &_part, vertex *_V, intT _n, intT _m, PartitionedManSegArray &_x, PartitionedManSegArray &_contrib,
+                   ManSeg::PrecisionController<Policy> &_control, double _damping, double _epsilon, int _maxRounds, int _workers )
+        : part( _part ), V( _V ), n( _n ), m( _m ), x( _x ), contrib( _contrib ), control( _control ), damping( _damping ),
+          epsilon( _epsilon ), maxRounds( _maxRounds ), workers( std::max( 1, _workers ) ), slots( workers ), seen( workers, 0 ),
+          level( _control.level() == ManSeg::PRECISION_HEADS ? ManSeg::PRECISION_HEADS : ManSeg::PRECISION_FULL ),
+          stop( false ), probe( 0 ), probes( 0 ), rounds( 0 ), switchRound( -1 ), converged( false ), delta( 2.0 )
+    {
+        for( AsyncSlot &s : slots )
+        {
+            s.sweeps = 0;
+            s.change = 2.0 / workers;
+            s.kept = 0.;
+            s.probe = 0;
+        }
+        assignRanges();
+        // the contributions of the starting ranks, and the rank they pass on, before any worker reads them
+        const bool full = level == ManSeg::PRECISION_FULL;
+        parallel_for( int w=0; w < workers; ++w )
+        {
+            double kept = 0.;
+            for( const std::pair<intT, intT> &r : ranges[w] )
+                kept += full ? publish( r.first, r.second, x.pairs, contrib.pairs ) : publish( r.first, r.second, x.heads, contrib.heads );
+            slots[w].kept = kept;
+        }
+    }
+
+    // runs the workers to convergence or maxRounds rounds; the rounds run
+    int run()
+    {
+        roundTime.start();
+        std::vector<std::thread> team;
+        for( int w=1; w < workers; ++w )
+            team.push_back( std::thread( [this, w]() { work( w ); } ) );
+        work( 0 );
+        for( std::thread &t : team )
+            t.join();
+        return rounds;
+    }
+
+    bool hasConverged() const { return converged; }
+    double lastDelta() const { return delta; }
+    int switchedAt() const { return switchRound; }
+    long probesRaised() const { return probes; }
+    // sweeps of every worker, and how far apart the most and fewest of a worker are
+    long totalSweeps() const
+    {
+        long total = 0;
+        for( const AsyncSlot &s : slots )
+            total += s.sweeps;
+        return total;
+    }
+    long sweepSpread() const
+    {
+        long most = 0, fewest = slots[0].sweeps;
+        for( const AsyncSlot &s : slots )
+        {
+            most = std::max( most, s.sweeps.load() );
+            fewest = std::min( fewest, s.sweeps.load() );
+        }
+        return most - fewest;
+    }
+
+private:
+    const partitioner &part;
+    vertex *V;
+    intT n, m;
+    PartitionedManSegArray &x, &contrib;
+    ManSeg::PrecisionController<Policy> &control;
+    double damping, epsilon;
+    int maxRounds, workers;
+    std::vector<std::vector<std::pair<intT, intT> > > ranges;
+    std::vector<AsyncSlot, CacheLineAllocator<AsyncSlot> > slots;
+    std::vector<long> seen;             // each worker's sweeps when the last round closed
+    std::atomic<int> level;
+    std::atomic<bool> stop;
+    std::atomic<long> probe;
+    long probes;
+    std::mutex coordinating;
+    int rounds, switchRound;
+    bool converged;
+    double delta;
+    timer roundTime;
+
+    // node i's vertices (those of its partitions) split between its workers by in-edges, each vertex
+    // counting as one more; with fewer workers than nodes, the nodes split between the workers
+    void assignRanges()
+    {
+        const int perNode = std::max( 1, part.get_num_per_node_partitions() );
+        const int nodes = std::max( 1, part.get_num_partitions() / perNode );
+        // node i's partitions, the last node taking any left over
+        auto nodeRange = [&]( int i ) {
+            return std::make_pair( part.start_of( perNode*i ), i == nodes - 1 ? n : part.start_of( perNode*(i+1) ) );
+        };
+        ranges.assign( workers, std::vector<std::pair<intT, intT> >() );
+        if( workers < nodes )
+        {
+            for( int i=0; i < nodes; ++i )
+                ranges[(long)i * workers / nodes].push_back( nodeRange( i ) );
+            return;
+        }
+        // Ligra's k / (parts / nodes), the last node taking the rest, as ThreadTopology binds them
+        const int perWorker = std::max( 1, workers / nodes );
+        for( int i=0; i < nodes; ++i )
+        {
+            const int first = i * perWorker, last = i == nodes - 1 ? workers : (i+1) * perWorker;
+            const intT s = nodeRange( i ).first, e = nodeRange( i ).second;
+            double cost = 0.;
+            for( intT d=s; d < e; ++d )
+                cost += 1 + V[d].getInDegree();
+            intT from = s;
+            double acc = 0.;
+            for( int w=first; w < last; ++w )
+            {
+                const double upto = cost * (w - first + 1) / (last - first);
+                intT to = from;
+                while( to < e && (w == last - 1 || acc + 1 + V[to].getInDegree() <= upto) )
+                    acc += 1 + V[to++].getInDegree();
+                ranges[w].push_back( std::make_pair( from, to ) );
+                from = to;
+            }
+        }
+    }
+
+    // the contributions of [s, e) from their ranks; returns the rank they pass on
+    template<class RankView, class ContribView>
+    double publish( intT s, intT e, RankView xs, ContribView cs )
+    {
+        double kept = 0.;
+        for( intT d=s; d < e; ++d )
+        {
+            const intT out = V[d].getOutDegree();
+            const double rank = xs.read( d );
+            cs.template set<Rounding>( d, out > 0 ? damping*(rank/out) : 0.0 );
+            if( out > 0 )
+                kept += damping*rank;
+        }
+        return kept;
+    }
+
+    // one sweep of [s, e): returns sum |new - old|, adding to kept the rank the range passes on
+    template<class RankView, class ContribView>
+    double sweep( intT s, intT e, RankView xs, ContribView cs, double add, double &kept )
+    {
+        double change = 0.;
+        for( intT d=s; d < e; ++d )
+        {
+            double sum = add;
+            const intT degree = V[d].getInDegree();
+            for( intT j=0; j < degree; ++j )
+                sum += cs.read( V[d].getInNeighbor( j ) );
+            change += fabs( sum - xs.read( d ) );
+            xs.template set<Rounding>( d, sum );
+            // the rank as stored, i.e. after rounding to the heads
+            const double rank = xs.read( d );
+            const intT out = V[d].getOutDegree();
+            cs.template set<Rounding>( d, out > 0 ? damping*(rank/out) : 0.0 );
+            if( out > 0 )
+                kept += damping*rank;
+        }
+        return change;
+    }
+
+    void work( int w )
+    {
+        ManSeg::ThreadTopology::instance().bind( w, workers );
+        AsyncSlot &mine = slots[w];
+        while( !stop.load( std::memory_order_acquire ) )
+        {
+            // the probe first: one raised after the switch is seen with it
+            const long tag = probe.load( std::memory_order_acquire );
+            const bool full = level.load( std::memory_order_acquire ) == ManSeg::PRECISION_FULL;
+            double passed = 0.;
+            for( const AsyncSlot &s : slots )
+                passed += s.kept.load( std::memory_order_relaxed );
+            const double add = (1 - passed) / n;
+
+            double change = 0., kept = 0.;
+            for( const std::pair<intT, intT> &r : ranges[w] )
+                change += full ? sweep( r.first, r.second, x.pairs, contrib.pairs, add, kept )
+                               : sweep( r.first, r.second, x.heads, contrib.heads, add, kept );
+            mine.change.store( change, std::memory_order_relaxed );
+            mine.kept.store( kept, std::memory_order_relaxed );
+            mine.probe.store( tag, std::memory_order_release );
+            mine.sweeps.fetch_add( 1, std::memory_order_release );
+            coordinate();
+        }
+    }
+
+    // closes a round once every worker has finished another sweep, and checks the probe, on one worker at a time
+    void coordinate()
+    {
+        std::unique_lock<std::mutex> lock( coordinating, std::try_to_lock );
+        if( !lock.owns_lock() )
+            return;
+        // a worker far ahead does not close rounds by itself on what the others published long ago
+        bool fresh = !stop;
+        for( int w=0; w < workers && fresh; ++w )
+            fresh = slots[w].sweeps.load( std::memory_order_acquire ) > seen[w];
+        if( fresh )
+        {
+            ++rounds;
+            delta = 0.;
+            for( int w=0; w < workers; ++w )
+            {
+                seen[w] = slots[w].sweeps.load( std::memory_order_acquire );
+                delta += slots[w].change.load( std::memory_order_relaxed );
+            }
+            const ManSeg::PrecisionLevel at = (ManSeg::PrecisionLevel)level.load();
+            std::cerr << rounds << ": delta = " << delta << "\n";
+            // per edge its source and that source's contribution, per vertex its rank read and written and its contribution written
+            const double bytes = at == ManSeg::PRECISION_FULL ? 8 : 4;
+            ligraResults->iteration( rounds, delta, roundTime.next(), ManSeg::levelName( at ),
+                                     m*(sizeof(intE) + bytes) + n*(3*bytes + 2*sizeof(intT)) );
+            if( at == ManSeg::PRECISION_HEADS && control.update( delta ) != ManSeg::PRECISION_HEADS )
+            {
+                // the tails are zero, so the pairs read the heads as they are
+                control.skipInterim();
+                switchRound = rounds;
+                level.store( ManSeg::PRECISION_FULL, std::memory_order_release );
+                std::cerr << "switching precision at round " << rounds << " (" << control.reasonName() << ")\n";
+            }
+            else if( at == ManSeg::PRECISION_FULL && delta < epsilon && probe.load() == 0 )
+                probe.store( ++probes, std::memory_order_release );
+            if( rounds >= maxRounds )
+                stop.store( true, std::memory_order_release );
+        }
+
+        const long raised = probe.load();
+        if( raised == 0 || stop )
+            return;
+        double since = 0.;
+        for( const AsyncSlot &s : slots )
+        {
+            if( s.probe.load( std::memory_order_acquire ) != raised )
+                return;
+            since += s.change.load( std::memory_order_relaxed );
+        }
+        if( since < epsilon )
+        {
+            delta = since;
+            converged = true;
+            stop.store( true, std::memory_order_release );
+        }
+        else
+            probe.store( 0, std::memory_order_release );
+    }
+};
+
+#endif // MANSEG_ASYNC_H
@@ -0,0 +1,93 @@
+// -*- C++ -*-
+// Fused gathers for vector iterations over one direction of the edges (HITSManSeg, KatzManSeg):
+// every vertex sums its neighbours' values (in-neighbours, or out-neighbours for the transpose)
+// from the whole graph's adjacency, so each value is written once, by its own vertex, whichever
+// way the graph is partitioned, and no edge list has to be transposed. The vertex phase rides on
+// the same sweep: the sum is finished (scaled, shifted) as it is stored, and the change from the
+// last iterate and a weighted sum of the new one are reduced alongside, rather than in passes of
+// their own. The reductions are over fixed blocks of vertex ids, so they do not depend on the
+// partitioning or the number of threads.
+#ifndef MANSEG_GATHER_H
+#define MANSEG_GATHER_H
+#include <algorithm>
+#include "../../manseglib_expr.hpp"
+
+#ifndef MANSEG_REDUCE_BLOCK
+#define MANSEG_REDUCE_BLOCK 4096
+#endif
+
+// what a gatherSweep reduces
+struct GatherSums
+{
+    double delta;       // compensated sum of |prev[v] - y[v]|, y as stored
+    double weighted;    // compensated sum of weight(v) * y[v]
+};
+
+// does sum += x; but with high accuracy
+inline void compensatedAdd(double &sum, double &err, double x)
+{
+    double tmp = sum;
+    double y = x + err;
+    sum = tmp + y;
+    err = tmp - sum;
+    err += y;
+}
+
+// calls body(b, s, e) for every block [s, e) of 0..n that starts in partition k
+template<class Body>
+inline void forGatherBlocks(const partitioner &part, int k, intT n, Body body)
+{
+    intT first = (part.start_of(k) + MANSEG_REDUCE_BLOCK - 1) / MANSEG_REDUCE_BLOCK;
+    intT last = (part.start_of(k+1) + MANSEG_REDUCE_BLOCK - 1) / MANSEG_REDUCE_BLOCK;
+    for( intT b=first; b < last; ++b )
+        body(b, b * MANSEG_REDUCE_BLOCK, std::min<intT>(n, (b+1) * MANSEG_REDUCE_BLOCK));
+}
+
+// sum of x over the in-neighbours (In) or out-neighbours of V[v]
+template<bool In, class vertex, class ReadView>
+inline double gatherNeighbours(vertex *V, intT v, ReadView &x)
+{
+    const intT d = In ? V[v].getInDegree() : V[v].getOutDegree();
+    double sum = 0.;
+    for( intT j=0; j < d; ++j )
+        sum += x.read(In ? V[v].getInNeighbor(j) : V[v].getOutNeighbor(j));
+    return sum;
+}
+
+/*
+    y[v] = finish(v, sum of x over the neighbours of v), for every vertex, with the compensated
+    sums of |prev[v] - y[v]| and of weight(v) * y[v] (y as stored, i.e. rounded to the heads when
+    y is a heads view). x, prev and y may be at different levels, as for an interim iteration;
+    prev and y must not be the same array.
+*/
+template<bool In, class vertex, class ReadView, class PrevView, class WriteView, class Finish, class Weight>
+GatherSums gatherSweep(const partitioner &part, vertex *V, intT n, ReadView x, PrevView prev, WriteView y,
+                       Finish finish, Weight weight)
+{
+    MANSEG_TRACE_SCOPE("gatherSweep");
+    intT nb = (n + MANSEG_REDUCE_BLOCK - 1) / MANSEG_REDUCE_BLOCK;
+    double *bdelta = new double [nb];
+    double *bweighted = new double [nb];
+    map_partition( k, part, {
+        forGatherBlocks(part, k, n, [&](intT b, intT s, intT e) {
+            double delta = 0., derr = 0., weighted = 0., werr = 0.;
+            for( intT v=s; v < e; ++v )
+            {
+                y.template set<MANSEG_ROUNDING>(v, finish(v, gatherNeighbours<In>(V, v, x)));
+                const double stored = y.read(v);
+                compensatedAdd(delta, derr, fabs(prev.read(v) - stored));
+                compensatedAdd(weighted, werr, weight(v) * stored);
+            }
+            bdelta[b] = delta;
+            bweighted[b] = weighted;
+        });
+    } );
+    GatherSums sums;
+    sums.delta = ManSeg::kahanSum(bdelta, 0, nb);
+    sums.weighted = ManSeg::kahanSum(bweighted, 0, nb);
+    delete [] bdelta;
+    delete [] bweighted;
+    return sums;
+}
+
+#endif // MANSEG_GATHER_H
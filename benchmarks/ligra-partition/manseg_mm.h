@@ -0,0 +1,137 @@
+// -*- C++ -*-
+// Storage policy placing ManSeg arrays the same way mmap_ptr::part_allocate does:
+// each partition's heads and tails (and full doubles) are bound to its home NUMA node.
+#ifndef MANSEG_MM_H
+#define MANSEG_MM_H
+// mm.h has no include guard, so include this after ligra-numa.h
+#include "../../manseglib.hpp"
+
+struct PartitionedSegmentAllocator
+{
+    const partitioner *part;
+    bool hugePages;     // try MAP_HUGETLB, falling back to transparent huge pages
+    uint_fast64_t width;    // values per element of the partitioner, e.g. the k of an n x k vertex property
+
+    PartitionedSegmentAllocator():part(0),hugePages(false),width(1) {}
+    PartitionedSegmentAllocator(const partitioner &_part, bool _hugePages=false, uint_fast64_t _width=1)
+        :part(&_part),hugePages(_hugePages),width(_width) {}
+
+#if NUMA
+    template<typename T>
+    T* allocate(const uint_fast64_t& length, const bool& zero)
+    {
+        // anonymous mappings are zero-filled, so zero needs no extra work
+        size_t totalSize = mapped_size(length*sizeof(T));
+        void *mem = MAP_FAILED;
+        if(hugePages)
+            mem = mmap(0, totalSize, PROTECTED, FLAGS|MAP_HUGETLB, 0, 0);
+        if(mem == MAP_FAILED)
+        {
+            mem = mmap(0, totalSize, PROTECTED, FLAGS, 0, 0);
+            if(mem == MAP_FAILED)
+            {
+                std::cerr << "segment mmap failed: " << strerror(errno) << ", size " << totalSize << '\n';
+                exit(1);
+            }
+#ifdef MADV_HUGEPAGE
+            if(hugePages)
+                madvise(mem, totalSize, MADV_HUGEPAGE);
+#endif
+        }
+        if(part != 0 && length == (uint_fast64_t)part->get_num_elements() * width)
+            bind_partitions(mem, sizeof(T) * width);
+        return reinterpret_cast<T*>(mem);
+    }
+
+    template<typename T>
+    void deallocate(T* ptr, const uint_fast64_t& length)
+    {
+        size_t totalSize = mapped_size(length*sizeof(T));
+        if(munmap(ptr, totalSize) == -1)
+        {
+            cerr<<"munmap failed "<<errno<<" "<<strerror(errno)
+                <<" address "<<ptr
+                <<" and size "<<totalSize<<endl;
+            abort();
+        }
+    }
+
+private:
+    static size_t mapped_size(size_t bytes)
+    {
+        return ((bytes+page_size-1)/page_size)*page_size;
+    }
+
+    void bind_partitions(void *mem, size_t elemSize)
+    {
+        const int perNode = part->get_num_per_node_partitions();
+        intptr_t pmem = reinterpret_cast<intptr_t>(mem);
+        for( int p=0; p < num_numa_node; ++p )
+        {
+            struct bitmask *bmp = numa_allocate_nodemask();
+            numa_bitmask_setbit(bmp, p);
+            for( int i = perNode*p; i < perNode*(p+1); ++i )
+            {
+                size_t size = part->get_size(i)*elemSize;
+                // round to small pages, as part_allocate does
+                intptr_t start = (pmem + (small_size-1)) & ~intptr_t(small_size-1);
+                size_t bound = ((size + (pmem - start) + small_size-1)/small_size)*small_size;
+                if(start < pmem + (intptr_t)size
+                   && mbind(reinterpret_cast<void*>(start), bound, mflag, bmp->maskp, bmp->size, 0) < 0)
+                    std::cerr << "mbind failed: " << strerror(errno)
+                              << " address " << (void*)start
+                              << ", size " << bound << '\n';
+                pmem += size;
+            }
+            numa_bitmask_free(bmp);
+        }
+    }
+#else
+    template<typename T>
+    T* allocate(const uint_fast64_t& length, const bool& zero)
+    {
+        return zero ? new T[length] () : new T[length];
+    }
+
+    template<typename T>
+    void deallocate(T* ptr, const uint_fast64_t& length) { delete [] ptr; }
+#endif
+};
+
+/*
+    ManSegArray over the elements of a partitioner, as mmap_ptr(const partitioner&) is:
+    the heads, tails and full planes of each partition are bound to its home node and
+    then zeroed by the loop() that later streams them, so every page is faulted in
+    by a thread of that node before the first iteration.
+*/
+class PartitionedManSegArray : public ManSeg::BasicManSegArray<PartitionedSegmentAllocator>
+{
+    typedef ManSeg::BasicManSegArray<PartitionedSegmentAllocator> Base;
+public:
+    using Base::Base;
+
+    explicit PartitionedManSegArray(const partitioner &part, bool hugePages=false, bool withFull=true)
+        :Base(part.get_num_elements(), PartitionedSegmentAllocator(part, hugePages))
+    {
+        if(withFull)
+            allocFull();
+        first_touch(part);
+    }
+
+    PartitionedManSegArray(PartitionedManSegArray&&) = default;
+    PartitionedManSegArray& operator=(PartitionedManSegArray&&) = default;
+
+    friend void swap(PartitionedManSegArray &a, PartitionedManSegArray &b) noexcept { a.swap(b); }
+
+    // zeroes every plane partition by partition, on the threads of the partition's node
+    void first_touch(const partitioner &part)
+    {
+        const int perNode = part.get_num_per_node_partitions();
+        float *h = heads.getHeads();
+        float *t = heads.getTails();
+        double *f = full;
+        loop(j, part, perNode, { h[j] = 0.0f; t[j] = 0.0f; if(f) f[j] = 0.0; });
+    }
+};
+
+#endif // MANSEG_MM_H
@@ -0,0 +1,276 @@
+// -*- C++ -*-
+// Multilevel (aggregation) starting ranks for PageRankManSeg's heads iterations.
+//
+// The vertices are clustered around hubs: each joins the in-neighbour with the most out-edges, if
+// that has more than it does, so the vertices a hub links to become one aggregate. The aggregates
+// make a coarse graph whose edges carry the share of a source aggregate's rank that reaches a
+// destination aggregate, the ranks of an aggregate's members taken as proportional to their sizes.
+// The coarse graph is clustered the same way until it is $MANSEG_MULTILEVEL times smaller than the
+// graph, or a level no longer shrinks it by a tenth. PageRank is then solved on the coarsest graph
+// with its ranks in heads, and each vertex starts from its aggregate's rank divided between its
+// members as one pull of the graph divides it. The fine heads iterations correct the ranks within
+// aggregates from there, and the switch to full precision follows as usual.
+#ifndef MANSEG_MULTILEVEL_H
+#define MANSEG_MULTILEVEL_H
+// mm.h has no include guard, so include this after ligra-numa.h
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "../../manseglib.hpp"
+
+// how many times smaller the coarsest graph should be: $MANSEG_MULTILEVEL, 0 (the default) for no
+// multilevel start
+inline int multilevelRatio()
+{
+    const char* ratio = getenv("MANSEG_MULTILEVEL");
+    return (ratio != NULL && *ratio != '\0') ? std::max(0, atoi(ratio)) : 0;
+}
+
+/*
+    An aggregated graph: in-edges by destination aggregate, each with the share of its source
+    aggregate's rank it carries before damping, rounded to a head.
+*/
+struct CoarseGraph
+{
+    intT n;
+    std::vector<intT> size;         // n: the vertices of the graph in each aggregate
+    std::vector<intT> outEdges;     // n: the coarse edges out of each, for the next clustering
+    std::vector<intT> offset;       // n+1: each aggregate's in-edges
+    std::vector<intT> source;
+    std::vector<float> weight;
+
+    CoarseGraph() : n(0) {}
+    intT numEdges() const { return offset.empty() ? 0 : offset[n]; }
+};
+
+/*
+    Hub clustering of n vertices: each joins the in-neighbour with the largest key (its out-edges),
+    ties to the smaller id, unless its own key is larger. Returns the number of aggregates, with
+    label[v] the aggregate of v, numbered in the order of their hubs.
+*/
+template<class InDegree, class InNeighbor, class Key>
+intT hubClusters(intT n, InDegree inDegree, InNeighbor inNeighbor, Key key, std::vector<intT> &label)
+{
+    std::vector<intT> hub(n);
+    parallel_for( intT v=0; v < n; ++v )
+    {
+        intT best = v;
+        const intT degree = inDegree(v);
+        for( intT j=0; j < degree; ++j )
+        {
+            const intT u = inNeighbor(v, j);
+            if( key(u) > key(best) || (key(u) == key(best) && u < best) )
+                best = u;
+        }
+        hub[v] = best;
+    }
+    // the hubs chosen by some vertex, numbered in order
+    std::vector<intT> id(n, 0);
+    for( intT v=0; v < n; ++v )
+        id[hub[v]] = 1;
+    intT count = 0;
+    for( intT v=0; v < n; ++v )
+        id[v] = id[v] ? count++ : -1;
+    label.resize(n);
+    parallel_for( intT v=0; v < n; ++v )
+        label[v] = id[hub[v]];
+    return count;
+}
+
+/*
+    The graph of count aggregates of n vertices, label[v] the aggregate of v. A vertex's in-edges are
+    given by inDegree(v), inNeighbor(v, j) and inWeight(v, j), the share of the neighbour's rank the
+    edge carries, and size(v) is the number of fine vertices v stands for. The edges from the members
+    of one aggregate into another are merged, weighted by their sources' sizes.
+*/
+template<class InDegree, class InNeighbor, class InWeight, class Size>
+void aggregate(intT n, const std::vector<intT> &label, intT count, InDegree inDegree, InNeighbor inNeighbor,
+               InWeight inWeight, Size size, CoarseGraph &coarse)
+{
+    coarse.n = count;
+    coarse.size.assign(count, 0);
+    std::vector<intT> memberStart(count + 1, 0), members(n);
+    for( intT v=0; v < n; ++v )
+    {
+        coarse.size[label[v]] += size(v);
+        ++memberStart[label[v] + 1];
+    }
+    for( intT a=0; a < count; ++a )
+        memberStart[a + 1] += memberStart[a];
+    {
+        std::vector<intT> fill(memberStart.begin(), memberStart.end() - 1);
+        for( intT v=0; v < n; ++v )
+            members[fill[label[v]]++] = v;
+    }
+
+    // each aggregate's merged in-edges, by source aggregate
+    std::vector<std::vector<std::pair<intT, double> > > edges(count);
+    parallel_for( intT a=0; a < count; ++a )
+    {
+        std::vector<std::pair<intT, double> > &in = edges[a];
+        for( intT k=memberStart[a]; k < memberStart[a + 1]; ++k )
+        {
+            const intT v = members[k];
+            const intT degree = inDegree(v);
+            for( intT j=0; j < degree; ++j )
+            {
+                const intT u = inNeighbor(v, j);
+                in.push_back(std::make_pair(label[u], inWeight(v, j) * size(u)));
+            }
+        }
+        std::sort(in.begin(), in.end());
+        intT merged = 0;
+        for( size_t e=0; e < in.size(); ++e )
+        {
+            if( merged > 0 && in[merged - 1].first == in[e].first )
+                in[merged - 1].second += in[e].second;
+            else
+                in[merged++] = in[e];
+        }
+        in.resize(merged);
+    }
+
+    coarse.offset.assign(count + 1, 0);
+    for( intT a=0; a < count; ++a )
+        coarse.offset[a + 1] = coarse.offset[a] + edges[a].size();
+    coarse.source.resize(coarse.numEdges());
+    coarse.weight.resize(coarse.numEdges());
+    coarse.outEdges.assign(count, 0);
+    for( intT a=0; a < count; ++a )
+    {
+        intT e = coarse.offset[a];
+        for( size_t j=0; j < edges[a].size(); ++j, ++e )
+        {
+            const intT s = edges[a][j].first;
+            coarse.source[e] = s;
+            coarse.weight[e] = (float)(edges[a][j].second / coarse.size[s]);
+            ++coarse.outEdges[s];
+        }
+        std::vector<std::pair<intT, double> >().swap(edges[a]);
+    }
+}
+
+// what multilevelStart did, for the results
+struct MultilevelStats
+{
+    int levels;
+    intT coarseVertices;
+    intT coarseEdges;
+    int iterations;
+    double coarseDelta;
+
+    MultilevelStats() : levels(0), coarseVertices(0), coarseEdges(0), iterations(0), coarseDelta(0.) {}
+};
+
+/*
+    Starting ranks for the n vertices of G, with the in-edges of every vertex (a pull graph), from
+    PageRank on the graph aggregated ratio times smaller (see the top of this file). The coarse
+    iterations are those of PageRankManSeg's heads: the damped pull, then the rank lost to vertices
+    without out-edges and to the damping spread over all the vertices, and stop at an L1 delta of
+    epsilon, once it no longer falls, or after maxIter.
+*/
+template<class vertex>
+std::vector<double> multilevelStart(graph<vertex> &G, intT n, int ratio, double damping, double epsilon,
+                                    int maxIter, MultilevelStats &stats)
+{
+    vertex *V = G.V;
+    std::vector<intT> toCoarse(n);      // the aggregate of each vertex at the current level
+    CoarseGraph coarse;
+
+    // the first level from the graph itself: a vertex stands for one, and an edge carries 1/outdeg
+    {
+        std::vector<intT> label;
+        intT count = hubClusters(n, [V](intT v) { return (intT)V[v].getInDegree(); },
+                                 [V](intT v, intT j) { return (intT)V[v].getInNeighbor(j); },
+                                 [V](intT u) { return (intT)V[u].getOutDegree(); }, label);
+        aggregate(n, label, count, [V](intT v) { return (intT)V[v].getInDegree(); },
+                  [V](intT v, intT j) { return (intT)V[v].getInNeighbor(j); },
+                  [V](intT v, intT j) { return 1.0 / V[V[v].getInNeighbor(j)].getOutDegree(); },
+                  [](intT) { return (intT)1; }, coarse);
+        toCoarse = label;
+        stats.levels = 1;
+    }
+    const intT target = std::max<intT>(1, n / std::max(1, ratio));
+    while( coarse.n > target && stats.levels < 16 )
+    {
+        const CoarseGraph &c = coarse;
+        std::vector<intT> label;
+        intT count = hubClusters(c.n, [&c](intT v) { return c.offset[v + 1] - c.offset[v]; },
+                                 [&c](intT v, intT j) { return c.source[c.offset[v] + j]; },
+                                 [&c](intT u) { return c.outEdges[u]; }, label);
+        if( count > c.n - c.n / 10 )
+            break;
+        CoarseGraph next;
+        aggregate(c.n, label, count, [&c](intT v) { return c.offset[v + 1] - c.offset[v]; },
+                  [&c](intT v, intT j) { return c.source[c.offset[v] + j]; },
+                  [&c](intT v, intT j) { return (double)c.weight[c.offset[v] + j]; },
+                  [&c](intT v) { return c.size[v]; }, next);
+        parallel_for( intT v=0; v < n; ++v )
+            toCoarse[v] = label[toCoarse[v]];
+        std::swap(coarse, next);
+        ++stats.levels;
+    }
+    stats.coarseVertices = coarse.n;
+    stats.coarseEdges = coarse.numEdges();
+
+    // PageRank on the coarsest graph, its ranks in heads
+    const intT nc = coarse.n;
+    std::vector<float> planes(2 * nc);
+    ManSeg::HeadsArray x(planes.data(), nullptr, nc), next(planes.data() + nc, nullptr, nc);
+    for( intT a=0; a < nc; ++a )
+        x.set<ManSeg::ROUND_NEAREST>(a, (double)coarse.size[a] / n);
+    double delta = 2.0;
+    for( int it=0; it < maxIter && delta > epsilon; ++it )
+    {
+        double sum = 0.;
+        for( intT a=0; a < nc; ++a )
+        {
+            double in = 0.;
+            for( intT e=coarse.offset[a]; e < coarse.offset[a + 1]; ++e )
+                in += coarse.weight[e] * x.read(coarse.source[e]);
+            next.set<ManSeg::ROUND_NEAREST>(a, damping * in);
+            sum += next.read(a);
+        }
+        const double lost = (1. - sum) / n;
+        double change = 0.;
+        for( intT a=0; a < nc; ++a )
+        {
+            next.set<ManSeg::ROUND_NEAREST>(a, next.read(a) + lost * coarse.size[a]);
+            change += fabs(next.read(a) - x.read(a));
+        }
+        std::swap(x, next);
+        ++stats.iterations;
+        // at the heads' precision
+        if( change >= delta )
+        {
+            delta = change;
+            break;
+        }
+        delta = change;
+    }
+    stats.coarseDelta = delta;
+
+    // each vertex's share of its aggregate's rank from a pull of the ranks divided evenly, so that
+    // the members an aggregate's in-edges reach most start highest
+    std::vector<double> even(n), pulled(n), total(nc, 0.);
+    parallel_for( intT v=0; v < n; ++v )
+        even[v] = x.read(toCoarse[v]) / coarse.size[toCoarse[v]] / std::max<intT>(1, V[v].getOutDegree());
+    parallel_for( intT v=0; v < n; ++v )
+    {
+        double in = 0.;
+        const intT degree = V[v].getInDegree();
+        for( intT j=0; j < degree; ++j )
+            in += even[V[v].getInNeighbor(j)];
+        pulled[v] = (1. - damping) / n + damping * in;
+    }
+    for( intT v=0; v < n; ++v )
+        total[toCoarse[v]] += pulled[v];
+    std::vector<double> &ranks = even;
+    parallel_for( intT v=0; v < n; ++v )
+        ranks[v] = x.read(toCoarse[v]) * pulled[v] / total[toCoarse[v]];
+    return ranks;
+}
+
+#endif // MANSEG_MULTILEVEL_H
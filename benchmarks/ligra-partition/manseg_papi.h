@@ -0,0 +1,281 @@
+// -*- C++ -*-
+// Hardware counters per precision phase: a PhaseCounter scoped around the heads, interim or full
+// loop of a Compute adds the cycles, LLC misses, DTLB misses and DRAM traffic of every worker
+// thread to a PhaseTable, which prints them per phase (and per thread with MANSEG_PHASES_THREADS).
+//     ManSeg::PhaseTable phases;
+//     { ManSeg::PhaseCounter pc(phases, PRECISION_HEADS); while(...) { ...; pc.iteration(); } }
+//     phases.print();
+// Counting needs -DMANSEG_PHASES=1 -lpapi; otherwise both classes do nothing. Where libpapi is not
+// installed, -DMANSEG_PHASES=1 -DMANSEG_PHASES_PERF=1 counts through perf_event_open instead (see
+// manseg_perf.h), with the DRAM traffic from the memory controllers where they can be read.
+// With PAPI it uses its own event sets, so do not combine it with PAPI_CACHE.
+#ifndef MANSEG_PAPI_H
+#define MANSEG_PAPI_H
+#include <stdio.h>
+#include "parallel.h"
+#include "manseg_perf.h"
+#include "../../manseglib_controller.hpp"
+
+#ifndef MANSEG_PHASES
+#define MANSEG_PHASES 0
+#endif
+// print a row per worker thread as well as the totals
+#ifndef MANSEG_PHASES_THREADS
+#define MANSEG_PHASES_THREADS 0
+#endif
+// count with perf_event_open rather than PAPI
+#ifndef MANSEG_PHASES_PERF
+#define MANSEG_PHASES_PERF 0
+#endif
+// DRAM reads and writes are counted as LLC misses served by local and remote memory (as in
+// papi_code.h), of MANSEG_PHASE_LINE bytes each; the event names are those of the Intel
+// offcore response events, so override them for other machines
+#ifndef MANSEG_PHASE_DRAM_LOCAL
+#define MANSEG_PHASE_DRAM_LOCAL "OFFCORE_RESPONSE_0:ANY_REQUEST:LLC_MISS_LOCAL:SNP_NONE:SNP_NOT_NEEDED:SNP_MISS:SNP_NO_FWD:u=0:k=0"
+#endif
+#ifndef MANSEG_PHASE_DRAM_REMOTE
+#define MANSEG_PHASE_DRAM_REMOTE "OFFCORE_RESPONSE_1:ANY_REQUEST:LLC_MISS_REMOTE:SNP_NONE:SNP_NOT_NEEDED:SNP_MISS:SNP_NO_FWD:u=0:k=0"
+#endif
+#ifndef MANSEG_PHASE_LINE
+#define MANSEG_PHASE_LINE 64
+#endif
+
+#if MANSEG_PHASES && !MANSEG_PHASES_PERF
+#include <papi.h>
+#endif
+
+namespace ManSeg
+{
+    // with perf_event_open the DRAM lines are the memory controllers' rather than the LLC misses
+    // served by DRAM: reads count as local, writes as remote
+    enum PhaseEvent { PHASE_CYCLES, PHASE_LLC_MISSES, PHASE_DRAM_LOCAL, PHASE_DRAM_REMOTE, PHASE_TLB_MISSES, PHASE_NUM_EVENTS };
+
+    /*
+        Counts per phase (PrecisionLevel) and worker thread. An event the machine does not have is
+        left out of the event sets, and printed as n/a.
+    */
+    class PhaseTable
+    {
+    public:
+        PhaseTable()
+            :workers(0), eventSets(0), counts(0), perf(0), perfCounts(0)
+        {
+            for(int p = 0; p < 3; p++)
+                iterations[p] = 0;
+#if MANSEG_PHASES && MANSEG_PHASES_PERF
+            perf = new PerfCounters();
+            workers = perf->workers();
+            counts = new long long[3*workers*PHASE_NUM_EVENTS]();
+            perfCounts = new long long[workers*PERF_NUM_EVENTS];
+            for(int e = 0; e < PHASE_NUM_EVENTS; e++)
+                available[e] = perf->available(perfEvent((PhaseEvent)e));
+            if(!perf->anyAvailable())
+                fprintf(stderr, "PhaseTable: perf_event_open counts nothing here (see /proc/sys/kernel/perf_event_paranoid)\n");
+#elif MANSEG_PHASES
+            if(!PAPI_is_initialized())
+            {
+                if(PAPI_library_init(PAPI_VER_CURRENT) != PAPI_VER_CURRENT)
+                {
+                    fprintf(stderr, "PhaseTable: PAPI library init error\n");
+                    return;
+                }
+                PAPI_thread_init(pthread_self);
+            }
+            workers = phaseWorkers();
+            eventSets = new int[workers];
+            counts = new long long[3*workers*PHASE_NUM_EVENTS]();
+            for(int w = 0; w < workers; w++)
+                eventSets[w] = PAPI_NULL;
+            onAllWorkers([this](int w) { this->createEventSet(w); });
+#endif
+        }
+
+        ~PhaseTable()
+        {
+#if MANSEG_PHASES && MANSEG_PHASES_PERF
+            delete perf;
+            delete [] perfCounts;
+            delete [] counts;
+#elif MANSEG_PHASES
+            if(eventSets)
+                onAllWorkers([this](int w) { PAPI_cleanup_eventset(this->eventSets[w]); PAPI_destroy_eventset(&this->eventSets[w]); });
+            delete [] eventSets;
+            delete [] counts;
+#endif
+        }
+
+        /* starts the counters of every worker */
+        void start()
+        {
+#if MANSEG_PHASES && MANSEG_PHASES_PERF
+            perf->start();
+#elif MANSEG_PHASES
+            if(eventSets)
+                onAllWorkers([this](int w) { PAPI_start(this->eventSets[w]); });
+#endif
+        }
+
+        /* stops the counters of every worker, adding them to phase */
+        void stop(const PrecisionLevel& phase)
+        {
+#if MANSEG_PHASES && MANSEG_PHASES_PERF
+            for(int i = 0; i < workers*PERF_NUM_EVENTS; i++)
+                perfCounts[i] = 0;
+            perf->stop(perfCounts);
+            for(int w = 0; w < workers; w++)
+                for(int e = 0; e < PHASE_NUM_EVENTS; e++)
+                    counts[(phase*workers + w)*PHASE_NUM_EVENTS + e] += perfCounts[w*PERF_NUM_EVENTS + perfEvent((PhaseEvent)e)];
+#elif MANSEG_PHASES
+            if(eventSets)
+                onAllWorkers([this, phase](int w) { this->stopWorker(phase, w); });
+#endif
+        }
+
+        void addIterations(const PrecisionLevel& phase, const int& n) { iterations[phase] += n; }
+
+        /* phase's total of event e over the workers */
+        long long total(const PrecisionLevel& phase, const PhaseEvent& e) const
+        {
+            long long t = 0;
+            for(int w = 0; w < workers; w++)
+                t += count(phase, w, e);
+            return t;
+        }
+
+        /* bytes read from or written to DRAM in phase, local and remote */
+        long long dramBytes(const PrecisionLevel& phase) const
+        {
+            return (total(phase, PHASE_DRAM_LOCAL) + total(phase, PHASE_DRAM_REMOTE)) * MANSEG_PHASE_LINE;
+        }
+
+        void print(FILE* out = stderr) const
+        {
+#if MANSEG_PHASES
+            static const char* names[3] = { "heads", "interim", "full" };
+            fprintf(out, "phase\tthread\titers\tcycles\tLLC_misses\tTLB_misses\tDRAM_bytes\tDRAM_bytes/iter\n");
+            for(int p = 0; p < 3; p++)
+            {
+                PrecisionLevel phase = (PrecisionLevel)p;
+                if(iterations[p] == 0) continue;
+#if MANSEG_PHASES_THREADS
+                for(int w = 0; w < workers; w++)
+                {
+                    fprintf(out, "%s\t%d\t%d", names[p], w, iterations[p]);
+                    printCount(out, count(phase, w, PHASE_CYCLES), PHASE_CYCLES);
+                    printCount(out, count(phase, w, PHASE_LLC_MISSES), PHASE_LLC_MISSES);
+                    printCount(out, count(phase, w, PHASE_TLB_MISSES), PHASE_TLB_MISSES);
+                    printCount(out, (count(phase, w, PHASE_DRAM_LOCAL) + count(phase, w, PHASE_DRAM_REMOTE)) * MANSEG_PHASE_LINE, PHASE_DRAM_LOCAL);
+                    fprintf(out, "\t-\n");
+                }
+#endif
+                fprintf(out, "%s\tall\t%d", names[p], iterations[p]);
+                printCount(out, total(phase, PHASE_CYCLES), PHASE_CYCLES);
+                printCount(out, total(phase, PHASE_LLC_MISSES), PHASE_LLC_MISSES);
+                printCount(out, total(phase, PHASE_TLB_MISSES), PHASE_TLB_MISSES);
+                printCount(out, dramBytes(phase), PHASE_DRAM_LOCAL);
+                printCount(out, dramBytes(phase) / iterations[p], PHASE_DRAM_LOCAL);
+                fprintf(out, "\n");
+            }
+#endif
+        }
+
+    private:
+        int workers;
+        int* eventSets;
+        long long* counts;      // [phase][worker][event]
+        int iterations[3];
+        bool available[PHASE_NUM_EVENTS];
+        int slot[PHASE_NUM_EVENTS];     // position of each event in the event sets, or -1
+        PerfCounters* perf;             // in place of the event sets, with MANSEG_PHASES_PERF
+        long long* perfCounts;          // [worker][PerfEvent] of a stop
+
+        long long count(const PrecisionLevel& phase, const int& w, const PhaseEvent& e) const
+        {
+            return counts[(phase*workers + w)*PHASE_NUM_EVENTS + e];
+        }
+
+#if MANSEG_PHASES
+        void printCount(FILE* out, const long long& c, const PhaseEvent& e) const
+        {
+            if(e == PHASE_DRAM_LOCAL ? (available[PHASE_DRAM_LOCAL] || available[PHASE_DRAM_REMOTE]) : available[e])
+                fprintf(out, "\t%lld", c);
+            else
+                fprintf(out, "\tn/a");
+        }
+
+        static PerfEvent perfEvent(const PhaseEvent& e)
+        {
+            static const PerfEvent events[PHASE_NUM_EVENTS] = { PERF_CYCLES, PERF_LLC_MISSES, PERF_DRAM_READS, PERF_DRAM_WRITES, PERF_DTLB_MISSES };
+            return events[e];
+        }
+#endif
+
+#if MANSEG_PHASES && !MANSEG_PHASES_PERF
+        // the same events are added on every worker, so worker 0 decides which are available
+        void createEventSet(const int& w)
+        {
+            static const char* events[PHASE_NUM_EVENTS] = { "PAPI_TOT_CYC", "PAPI_L3_TCM", MANSEG_PHASE_DRAM_LOCAL, MANSEG_PHASE_DRAM_REMOTE, "PAPI_TLB_DM" };
+            if(PAPI_create_eventset(&eventSets[w]) != PAPI_OK)
+            {
+                fprintf(stderr, "PhaseTable: error creating event set of thread %d\n", w);
+                return;
+            }
+            int added = 0;
+            for(int e = 0; e < PHASE_NUM_EVENTS; e++)
+            {
+                bool ok = PAPI_add_named_event(eventSets[w], (char*)events[e]) == PAPI_OK;
+                if(w == 0)
+                {
+                    available[e] = ok;
+                    slot[e] = ok ? added : -1;
+                }
+                if(ok) added++;
+            }
+        }
+
+        void stopWorker(const PrecisionLevel& phase, const int& w)
+        {
+            long long v[PHASE_NUM_EVENTS];
+            if(PAPI_stop(eventSets[w], v) != PAPI_OK)
+            {
+                fprintf(stderr, "PhaseTable: error stopping the counters of thread %d\n", w);
+                return;
+            }
+            for(int e = 0; e < PHASE_NUM_EVENTS; e++)
+                if(slot[e] >= 0)
+                    counts[(phase*workers + w)*PHASE_NUM_EVENTS + e] += v[slot[e]];
+        }
+#endif
+    };
+
+    /*
+        Counts the enclosing scope as phase of table: the counters of every worker are started by
+        the constructor and stopped (and added to the table) by the destructor. Call iteration()
+        once per iteration, for the per iteration column.
+    */
+    class PhaseCounter
+    {
+    public:
+        PhaseCounter(PhaseTable& table, const PrecisionLevel& phase)
+            :table(table), phase(phase)
+        {
+            table.start();
+        }
+
+        ~PhaseCounter()
+        {
+            table.stop(phase);
+        }
+
+        void iteration() { table.addIterations(phase, 1); }
+
+    private:
+        PhaseTable& table;
+        PrecisionLevel phase;
+
+        PhaseCounter(const PhaseCounter&);
+        PhaseCounter& operator=(const PhaseCounter&);
+    };
+}
+
+#endif // MANSEG_PAPI_H
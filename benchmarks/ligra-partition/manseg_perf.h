@@ -0,0 +1,398 @@
+// -*- C++ -*-
+// Hardware counters through perf_event_open, for machines without libpapi: each worker thread
+// counts its own cycles, LLC misses and DTLB load misses as one event group (so the three are
+// scheduled, and multiplexed, together), and the memory controllers' CAS counts give the DRAM
+// lines read and written by the whole machine.
+//     ManSeg::PerfCounters perf;      // opens the groups on every worker
+//     perf.start(); ... perf.stop(counts);     // counts[worker*PERF_NUM_EVENTS + event] +=
+// Thread events count user mode only, which perf_event_paranoid 2 (the default) allows. The DRAM
+// lines are machine wide uncore events (Intel's uncore_imc PMUs), which need perf_event_paranoid
+// 0 or CAP_PERFMON; they are added to worker 0's counts. An event that cannot be opened (a VM
+// without a PMU, AMD without the IMC PMUs, a seccomp filter) is left out, and available() says so.
+// Used by PhaseTable with MANSEG_PHASES_PERF (see manseg_papi.h) and by perf_code.h.
+#ifndef MANSEG_PERF_H
+#define MANSEG_PERF_H
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "parallel.h"
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace ManSeg
+{
+    enum PerfEvent { PERF_CYCLES, PERF_LLC_MISSES, PERF_DTLB_MISSES, PERF_DRAM_READS, PERF_DRAM_WRITES, PERF_NUM_EVENTS };
+
+    inline const char* perfEventName(const PerfEvent& e)
+    {
+        static const char* names[PERF_NUM_EVENTS] = { "cycles", "LLC_misses", "DTLB_misses", "DRAM_reads", "DRAM_writes" };
+        return names[e];
+    }
+
+    inline int phaseWorkers() { return getWorkers(); }
+
+    inline int phaseWorker()
+    {
+#if defined(CILK) || defined(CILKP)
+        return __cilkrts_get_worker_number();
+#elif defined(OPENMP)
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
+#if defined(CILK) || defined(CILKP)
+    // runs fn once on each of the n workers: every spawned task waits until all n have started
+    // (see on_all_workers_help in papi_code.h), so no worker can run two of them
+    template<class Fn>
+    void onAllWorkersHelp(int i, int n, volatile bool* flags, Fn& fn)
+    {
+        if(i < n-1)
+            cilk_spawn onAllWorkersHelp(i+1, n, flags, fn);
+        if(n > 1)
+        {
+            if(i == n-2)
+                for(int j = 0; j < n; j++)
+                    flags[j] = true;
+            else
+                while(!flags[i]);
+        }
+        fn(phaseWorker());
+        cilk_sync;
+    }
+#endif
+
+    template<class Fn>
+    void onAllWorkers(Fn fn)
+    {
+#if defined(CILK) || defined(CILKP)
+        int n = phaseWorkers();
+        volatile bool* flags = new bool[n];
+        for(int i = 0; i < n; i++)
+            flags[i] = false;
+        onAllWorkersHelp(0, n, flags, fn);
+        delete [] flags;
+#elif defined(OPENMP)
+        #pragma omp parallel
+        fn(phaseWorker());
+#else
+        fn(0);
+#endif
+    }
+
+#if defined(__linux__)
+    inline int perfEventOpen(perf_event_attr& attr, const pid_t& pid, const int& cpu, const int& group)
+    {
+        return (int)syscall(__NR_perf_event_open, &attr, pid, cpu, group, 0UL);
+    }
+#endif
+
+    /*
+        The calling thread's cycles, LLC misses and DTLB load misses, as a group led by the first
+        that opens. Counts are scaled up by the time the group was enabled over the time it ran,
+        should the kernel have multiplexed it with other groups.
+    */
+    class PerfThreadGroup
+    {
+    public:
+        PerfThreadGroup() :leader(-1), opened(0)
+        {
+            for(int e = 0; e < PERF_NUM_EVENTS; e++)
+                slot[e] = -1;
+        }
+
+        ~PerfThreadGroup() { close(); }
+
+        /* opens the events on the calling thread; false if none could be */
+        bool open()
+        {
+#if defined(__linux__)
+            static const uint32_t types[3] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+            static const uint64_t configs[3] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+            for(int e = PERF_CYCLES; e <= PERF_DTLB_MISSES; e++)
+            {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = types[e];
+                attr.config = configs[e];
+                attr.disabled = leader < 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                int fd = perfEventOpen(attr, 0, -1, leader);
+                if(fd < 0)
+                    continue;
+                if(leader < 0)
+                    leader = fd;
+                fds[opened] = fd;
+                slot[e] = opened++;
+            }
+#endif
+            return opened > 0;
+        }
+
+        bool available(const PerfEvent& e) const { return slot[e] >= 0; }
+
+        void start()
+        {
+#if defined(__linux__)
+            if(leader < 0) return;
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+        }
+
+        /* stops the group, adding its counts since start to counts[PERF_NUM_EVENTS] */
+        void stop(long long* counts)
+        {
+#if defined(__linux__)
+            if(leader < 0) return;
+            ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t buf[3 + 3];    // nr, time enabled, time running, a value per event
+            if(read(leader, buf, sizeof(buf)) < (ssize_t)((3 + opened) * sizeof(uint64_t)))
+                return;
+            double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / buf[2] : 1.0;
+            for(int e = 0; e < PERF_NUM_EVENTS; e++)
+                if(slot[e] >= 0)
+                    counts[e] += (long long)(buf[3 + slot[e]] * scale);
+#else
+            (void)counts;
+#endif
+        }
+
+        void close()
+        {
+#if defined(__linux__)
+            for(int i = opened - 1; i >= 0; i--)
+                ::close(fds[i]);
+#endif
+            leader = -1;
+            opened = 0;
+            for(int e = 0; e < PERF_NUM_EVENTS; e++)
+                slot[e] = -1;
+        }
+
+    private:
+        int leader;
+        int opened;
+        int fds[3];
+        int slot[PERF_NUM_EVENTS];  // position of each event in the group's reads, or -1
+
+        PerfThreadGroup(const PerfThreadGroup&);
+        PerfThreadGroup& operator=(const PerfThreadGroup&);
+    };
+
+    /*
+        DRAM lines read and written, from the cas_count_read and cas_count_write events of every
+        uncore_imc PMU, opened on one CPU of each socket (the PMU's cpumask). Each count is a 64 byte
+        line.
+    */
+    class PerfDram
+    {
+    public:
+        PerfDram() {}
+        ~PerfDram() { close(); }
+
+        /* opens the events of every memory controller; false if none could be */
+        bool open(const char* root = "/sys/bus/event_source/devices")
+        {
+#if defined(__linux__)
+            DIR* dir = opendir(root);
+            if(dir == nullptr)
+                return false;
+            std::vector<std::string> pmus;
+            for(struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+                if(strncmp(entry->d_name, "uncore_imc", 10) == 0)
+                    pmus.push_back(entry->d_name);
+            closedir(dir);
+            for(size_t p = 0; p < pmus.size(); p++)
+            {
+                std::string pmu = std::string(root) + "/" + pmus[p];
+                std::string type = readLine(pmu + "/type"), cpus = readLine(pmu + "/cpumask");
+                if(type.empty() || cpus.empty())
+                    continue;
+                for(int w = 0; w < 2; w++)
+                {
+                    uint64_t config;
+                    if(!eventConfig(pmu, w == 0 ? "cas_count_read" : "cas_count_write", config))
+                        continue;
+                    // cpumask is a list of CPUs and ranges, e.g. "0,28" or "0-1"; the first of each item will do
+                    for(const char* c = cpus.c_str(); *c != '\0'; )
+                    {
+                        perf_event_attr attr;
+                        memset(&attr, 0, sizeof(attr));
+                        attr.size = sizeof(attr);
+                        attr.type = (uint32_t)atoi(type.c_str());
+                        attr.config = config;
+                        attr.disabled = 1;
+                        int fd = perfEventOpen(attr, -1, atoi(c), -1);
+                        if(fd >= 0)
+                            counters.push_back(Counter{ fd, w == 0 ? PERF_DRAM_READS : PERF_DRAM_WRITES });
+                        c += strcspn(c, ",");
+                        if(*c == ',') c++;
+                    }
+                }
+            }
+#else
+            (void)root;
+#endif
+            return !counters.empty();
+        }
+
+        bool available(const PerfEvent& e) const
+        {
+            for(size_t i = 0; i < counters.size(); i++)
+                if(counters[i].event == e)
+                    return true;
+            return false;
+        }
+
+        void start()
+        {
+#if defined(__linux__)
+            for(size_t i = 0; i < counters.size(); i++)
+            {
+                ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        /* stops the counters, adding the lines read and written to counts[PERF_NUM_EVENTS] */
+        void stop(long long* counts)
+        {
+#if defined(__linux__)
+            for(size_t i = 0; i < counters.size(); i++)
+            {
+                ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t v;
+                if(read(counters[i].fd, &v, sizeof(v)) == (ssize_t)sizeof(v))
+                    counts[counters[i].event] += (long long)v;
+            }
+#else
+            (void)counts;
+#endif
+        }
+
+        void close()
+        {
+#if defined(__linux__)
+            for(size_t i = 0; i < counters.size(); i++)
+                ::close(counters[i].fd);
+#endif
+            counters.clear();
+        }
+
+    private:
+        struct Counter
+        {
+            int fd;
+            PerfEvent event;
+        };
+        std::vector<Counter> counters;
+
+        static std::string readLine(const std::string& path)
+        {
+            char line[256] = "";
+            FILE* f = fopen(path.c_str(), "r");
+            if(f == nullptr)
+                return "";
+            if(fgets(line, sizeof(line), f) == nullptr)
+                line[0] = '\0';
+            fclose(f);
+            line[strcspn(line, "\n")] = '\0';
+            return line;
+        }
+
+        // an event such as "event=0x04,umask=0x03" as a config, its fields placed as the PMU's
+        // format files say (e.g. format/umask is "config:8-15")
+        static bool eventConfig(const std::string& pmu, const char* name, uint64_t& config)
+        {
+            std::string event = readLine(pmu + "/events/" + name);
+            if(event.empty())
+                return false;
+            config = 0;
+            for(size_t at = 0; at < event.size(); )
+            {
+                size_t end = event.find(',', at);
+                if(end == std::string::npos) end = event.size();
+                std::string term = event.substr(at, end - at);
+                at = end + 1;
+                size_t eq = term.find('=');
+                std::string field = term.substr(0, eq);
+                uint64_t value = eq == std::string::npos ? 1 : strtoull(term.c_str() + eq + 1, nullptr, 0);
+                std::string format = readLine(pmu + "/format/" + field);
+                if(format.compare(0, 7, "config:") != 0)
+                    return false;
+                config |= value << atoi(format.c_str() + 7);
+            }
+            return true;
+        }
+    };
+
+    /* a PerfThreadGroup on every worker thread, and the machine's DRAM lines (counted as worker 0's) */
+    class PerfCounters
+    {
+    public:
+        PerfCounters() :n(phaseWorkers()), groups(new PerfThreadGroup[n])
+        {
+            onAllWorkers([this](int w) { this->groups[w].open(); });
+            dram.open();
+        }
+
+        ~PerfCounters() { delete [] groups; }
+
+        int workers() const { return n; }
+
+        bool available(const PerfEvent& e) const
+        {
+            return (e == PERF_DRAM_READS || e == PERF_DRAM_WRITES) ? dram.available(e) : groups[0].available(e);
+        }
+
+        bool anyAvailable() const
+        {
+            for(int e = 0; e < PERF_NUM_EVENTS; e++)
+                if(available((PerfEvent)e))
+                    return true;
+            return false;
+        }
+
+        /* the counters of every worker and of the memory controllers; a group is enabled from any thread */
+        void start()
+        {
+            dram.start();
+            for(int w = 0; w < n; w++)
+                groups[w].start();
+        }
+
+        /* stops the counters, adding each worker's to counts[worker*PERF_NUM_EVENTS + event] */
+        void stop(long long* counts)
+        {
+            for(int w = 0; w < n; w++)
+                groups[w].stop(counts + w*PERF_NUM_EVENTS);
+            dram.stop(counts);
+        }
+
+    private:
+        int n;
+        PerfThreadGroup* groups;
+        PerfDram dram;
+
+        PerfCounters(const PerfCounters&);
+        PerfCounters& operator=(const PerfCounters&);
+    };
+}
+
+#endif // MANSEG_PERF_H
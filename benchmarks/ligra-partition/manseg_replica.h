@@ -0,0 +1,105 @@
+// -*- C++ -*-
+// Copies of a vector's heads on every NUMA node, for the pulls of PageRankManSeg's heads iterations.
+//
+// A pull reads p_curr[s] for the sources of each destination's in-edges, which are anywhere in the
+// graph, so with the vector's partitions bound to their home nodes most of those reads are remote
+// (three in four on four nodes). p_curr is only read during the scatter, so each node can read a
+// copy of its own instead: ReplicatedHeads keeps one n-float replica per node, bound to the node, and
+// broadcast() copies the heads into all of them in one streaming pass, each node's threads writing
+// its own replica. A copy of doubles on every node would take 8n bytes a node; the heads take 4n.
+//
+// ReplicatedHeadsView reads them: edgeMap's dense loops give each node's partitions a copy of the
+// functor told the node (see set_node in ligra-numa.h), and the functor points its view at that
+// node's replica with selectNode. Until then the view reads node 0's.
+#ifndef MANSEG_REPLICA_H
+#define MANSEG_REPLICA_H
+// mm.h has no include guard, so include this after ligra-numa.h
+#include <string.h>
+#include "../../manseglib.hpp"
+
+class ReplicatedHeads
+{
+public:
+    ReplicatedHeads( intT _n ) : n( _n ), replicas( num_numa_node )
+    {
+        for( int i=0; i < num_numa_node; ++i )
+            replicas[i] = allocate( i );
+    }
+    ~ReplicatedHeads()
+    {
+        for( int i=0; i < num_numa_node; ++i )
+            release( replicas[i] );
+    }
+    ReplicatedHeads( const ReplicatedHeads & ) = delete;
+    ReplicatedHeads & operator=( const ReplicatedHeads & ) = delete;
+
+    // copies heads to every node's replica, the threads of each node filling their own
+    void broadcast( const float *heads )
+    {
+        const intT chunk = 1 << 16;
+        const intT chunks = (n + chunk - 1) / chunk;
+        parallel_for_numa( int i=0; i < num_numa_node; ++i )
+        {
+            float *r = replicas[i];
+            parallel_for( intT c=0; c < chunks; ++c )
+                memcpy( r + c * chunk, heads + c * chunk, std::min( chunk, n - c * chunk ) * sizeof(float) );
+        }
+    }
+
+    float * const * get() const { return replicas.data(); }
+    long bytes() const { return (long)num_numa_node * n * sizeof(float); }
+
+private:
+#if NUMA
+    float *allocate( int node )
+    {
+        size_t size = mapped_size();
+        void *mem = mmap( 0, size, PROTECTED, FLAGS, 0, 0 );
+        if( mem == MAP_FAILED )
+        {
+            std::cerr << "replica mmap failed: " << strerror( errno ) << ", size " << size << '\n';
+            exit( 1 );
+        }
+        struct bitmask *bmp = numa_allocate_nodemask();
+        numa_bitmask_setbit( bmp, node );
+        if( mbind( mem, size, mflag, bmp->maskp, bmp->size, 0 ) < 0 )
+            std::cerr << "mbind failed: " << strerror( errno ) << " address " << mem << ", size " << size << '\n';
+        numa_bitmask_free( bmp );
+        return reinterpret_cast<float*>( mem );
+    }
+    void release( float *r ) { munmap( r, mapped_size() ); }
+    size_t mapped_size() const { return ((n * sizeof(float) + small_size - 1) / small_size) * small_size; }
+#else
+    float *allocate( int ) { return new float [n]; }
+    void release( float *r ) { delete [] r; }
+#endif
+
+    intT n;
+    std::vector<float*> replicas;
+};
+
+// reads the heads of one node's replica (see the top of the file)
+struct ReplicatedHeadsView
+{
+    float * const *replicas;
+    ManSeg::HeadsSpan span;
+
+    ReplicatedHeadsView( const ReplicatedHeads &r, intT n ) : replicas( r.get() ), span( r.get()[0], nullptr, n ) { }
+
+    ManSeg::Head operator[]( intT id ) const { return span[id]; }
+    double read( intT id ) const { return span.read( id ); }
+
+    void select( int node ) { span = ManSeg::HeadsSpan( replicas[node], nullptr, span.size() ); }
+};
+
+namespace ManSeg
+{
+    inline void prefetch( const ReplicatedHeadsView &a, const uint_fast64_t &id ) { prefetch( a.span, id ); }
+}
+
+// points a view at node's replica; views of a single copy read it wherever they are
+template<class View>
+inline void selectNode( View &, int ) { }
+inline void selectNode( ReplicatedHeadsView &v, int node ) { v.select( node ); }
+
+#endif // MANSEG_REPLICA_H
@@ -0,0 +1,182 @@
+// -*- C++ -*-
+// Cache blocked pulls (graph segmenting, as in Cagra): the in-edges of every vertex are divided by
+// source range into segments small enough that a segment's slice of the source values (and of the
+// out-degrees and the frontier) stays in cache. An iteration pulls one segment at a time, each
+// destination summing its edges from that segment into a partial sum, then merges every
+// destination's partials in segment order. The random reads of p_curr[s] so hit cache rather than
+// DRAM, for the price of streaming the partials once more. At the heads a source takes 4 bytes of
+// p_curr rather than 8, so a segment of the same size holds more sources.
+#ifndef MANSEG_SEGMENTED_H
+#define MANSEG_SEGMENTED_H
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+// bytes of cache for the source values of a segment: $MANSEG_SEGMENT_KB, "l2" or "llc" for the size
+// of that cache, or 0 (the default) not to segment
+inline long segmentCacheBytes()
+{
+    const char* kb = getenv("MANSEG_SEGMENT_KB");
+    if(kb == NULL || *kb == '\0')
+        return 0;
+    long bytes = 0;
+    if(strcmp(kb, "l2") == 0)
+    {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return bytes > 0 ? bytes : 256 * 1024;
+    }
+    if(strcmp(kb, "llc") == 0)
+    {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+        return bytes > 0 ? bytes : 8 * 1024 * 1024;
+    }
+    return atol(kb) * 1024;
+}
+
+/*
+    The in-edges of a graph, segmented by source. An entry is one destination's edges from one
+    segment: entries are in destination order, and a destination's in segment order, so its partial
+    sums are contiguous for the merge. segmentEntries lists each segment's entries, in destination
+    order, for the pull of that segment. Sources are sorted within an in-edge list.
+*/
+struct SegmentedGraph
+{
+    intT n;
+    intT segmentSize;       // sources per segment
+    intT numSegments;
+    intT numEntries;
+    intT *entryStart;       // n+1: the entries of destination d
+    intT *edgeStart;        // numEntries+1: the sources of an entry
+    intT *destination;      // numEntries: the destination of an entry
+    intT *sources;          // m
+    intT *segmentStart;     // numSegments+1: a segment's run of segmentEntries
+    intT *segmentEntries;   // numEntries
+    intT *outDegree;        // n: the out-degree of every source, read with its value
+    double *partial;        // numEntries: the partial sums of the last pull
+
+    template<class vertex>
+    SegmentedGraph(graph<vertex> &G, intT _n, intT _segmentSize)
+        : n(_n), segmentSize(std::max<intT>(1, _segmentSize))
+    {
+        numSegments = (n + segmentSize - 1) / segmentSize;
+        vertex *V = G.V;
+        outDegree = new intT [n];
+        entryStart = new intT [n+1];
+        intT *edgeOffset = new intT [n+1];
+        parallel_for( intT d=0; d < n; ++d )
+        {
+            outDegree[d] = V[d].getOutDegree();
+            edgeOffset[d] = V[d].getInDegree();
+        }
+        edgeOffset[n] = 0;
+        intT m = sequence::plusScan(edgeOffset, edgeOffset, n+1);
+
+        // each destination's in-edges, sorted by source, and the number of segments they come from
+        sources = new intT [m];
+        parallel_for( intT d=0; d < n; ++d )
+        {
+            intT *list = sources + edgeOffset[d];
+            intT degree = V[d].getInDegree();
+            for( intT j=0; j < degree; ++j )
+                list[j] = V[d].getInNeighbor(j);
+            std::sort(list, list + degree);
+            intT runs = 0;
+            for( intT j=0; j < degree; ++j )
+                runs += j == 0 || list[j] / segmentSize != list[j-1] / segmentSize;
+            entryStart[d] = runs;
+        }
+        entryStart[n] = 0;
+        numEntries = sequence::plusScan(entryStart, entryStart, n+1);
+
+        edgeStart = new intT [numEntries+1];
+        destination = new intT [numEntries];
+        parallel_for( intT d=0; d < n; ++d )
+        {
+            intT e = entryStart[d];
+            intT degree = edgeOffset[d+1] - edgeOffset[d];
+            for( intT j=0; j < degree; ++j )
+                if( j == 0 || sources[edgeOffset[d] + j] / segmentSize != sources[edgeOffset[d] + j-1] / segmentSize )
+                {
+                    destination[e] = d;
+                    edgeStart[e++] = edgeOffset[d] + j;
+                }
+        }
+        edgeStart[numEntries] = m;
+
+        // counting sort of the entries by segment, keeping destination order within each
+        segmentStart = new intT [numSegments+1];
+        segmentEntries = new intT [numEntries];
+        std::fill(segmentStart, segmentStart + numSegments + 1, 0);
+        for( intT e=0; e < numEntries; ++e )
+            ++segmentStart[sources[edgeStart[e]] / segmentSize + 1];
+        for( intT k=0; k < numSegments; ++k )
+            segmentStart[k+1] += segmentStart[k];
+        std::vector<intT> fill(segmentStart, segmentStart + numSegments);
+        for( intT e=0; e < numEntries; ++e )
+            segmentEntries[fill[sources[edgeStart[e]] / segmentSize]++] = e;
+
+        partial = new double [numEntries];
+        delete [] edgeOffset;
+    }
+
+    ~SegmentedGraph()
+    {
+        delete [] entryStart;
+        delete [] edgeStart;
+        delete [] destination;
+        delete [] sources;
+        delete [] segmentStart;
+        delete [] segmentEntries;
+        delete [] outDegree;
+        delete [] partial;
+    }
+
+    SegmentedGraph(const SegmentedGraph&) = delete;
+    SegmentedGraph& operator=(const SegmentedGraph&) = delete;
+
+    /*
+        For every destination d, the sum of contribution(s) over its in-edges from active sources
+        (all of them if active is NULL) is passed to store(d, sum), and next[d] is set if there was
+        one. The sums are taken a segment at a time, then merged.
+    */
+    template<class Contribution, class Store>
+    void pull(const bool *active, bool *next, Contribution contribution, Store store)
+    {
+        for( intT k=0; k < numSegments; ++k )
+        {
+            parallel_for( intT i=segmentStart[k]; i < segmentStart[k+1]; ++i )
+            {
+                intT e = segmentEntries[i];
+                double sum = 0.;
+                bool any = false;
+                for( intT j=edgeStart[e]; j < edgeStart[e+1]; ++j )
+                {
+                    intT s = sources[j];
+                    if( active == NULL || active[s] )
+                    {
+                        sum += contribution(s);
+                        any = true;
+                    }
+                }
+                partial[e] = sum;
+                if( any )
+                    next[destination[e]] = 1;
+            }
+        }
+        parallel_for( intT d=0; d < n; ++d )
+        {
+            double sum = 0.;
+            for( intT e=entryStart[d]; e < entryStart[d+1]; ++e )
+                sum += partial[e];
+            store(d, sum);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,30 @@
+// -*- C++ -*-
+// Frontiers of the vertices whose heads changed, for edgeMaps that skip stable vertices at the heads.
+//
+// A vertex value written through a ManSeg::TrackedHeadsView marks the ChangeMask when its heads change
+// (see manseglib_stability.hpp). changedFrontier makes the vertices that changed in the last iteration a
+// dense frontier, as vertexFilter does, so a push from them touches only the edges of values that can
+// still move; once the mask is stopped at promotion it holds every vertex.
+#ifndef MANSEG_STABILITY_LIGRA_H
+#define MANSEG_STABILITY_LIGRA_H
+// mm.h has no include guard, so include this after ligra-numa.h
+#include "../../manseglib_stability.hpp"
+
+template <class GraphType>
+partitioned_vertices changedFrontier(GraphType &GA, const ManSeg::ChangeMask &changes)
+{
+    typedef typename GraphType::vertex_type vertex;
+    const intT n = GA.n;
+    mmap_ptr<bool> d;
+    d.part_allocate(GA.get_partitioner());
+
+    // a mask word per iteration, so no two threads read the same word
+    bool *flags = d.get();
+    parallel_for(intT w=0; w < (n + 63) / 64; ++w)
+        changes.flags(flags + w * 64, w * 64, std::min(n, w * 64 + 64));
+
+    intTpair p = sequence::reduce<intT>((intT)0, n, GoutDegree<vertex>(GA.get_partition(), flags));
+    return partitioned_vertices::boolean(n, d, p.first, p.second);
+}
+
+#endif // MANSEG_STABILITY_LIGRA_H
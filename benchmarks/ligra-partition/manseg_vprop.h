@@ -0,0 +1,281 @@
+// -*- C++ -*-
+// Vector valued vertex properties (embeddings, label distributions): n x k values in the heads and
+// tails planes of a mantissa segmented array, vertex major, so the k heads of a vertex are one run
+// of 4k bytes that an edge reads with one widening kernel, k*4 bytes an edge rather than k*8 until
+// the tails are needed. A ManSegMatrix pads its rows to a 64 wide tile row, which for small k would
+// move more than doubles do; the rows here are packed, and each partition's rows are bound to its
+// home node as the values of a PartitionedManSegArray are.
+#ifndef MANSEG_VPROP_H
+#define MANSEG_VPROP_H
+#include "manseg_mm.h"
+
+// the largest k the edgeMap functors' caches hold
+#ifndef MANSEG_VPROP_MAX_K
+#define MANSEG_VPROP_MAX_K 64
+#endif
+
+namespace ManSeg
+{
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* acc[i] += the value of heads[i] (and tails[i]) for the first multiple of 8 of n values; returns that count */
+        template<bool useTail>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t accumulateRowAVX2(const float* heads, const float* tails, const uint_fast64_t& n, double* acc)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i t = useTail ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tails + i)) : _mm256_setzero_si256();
+                __m256i lo = _mm256_unpacklo_epi32(t, h);
+                __m256i hi = _mm256_unpackhi_epi32(t, h);
+                __m256d a0 = _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20));
+                __m256d a1 = _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31));
+                _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), a0));
+                _mm256_storeu_pd(acc + i + 4, _mm256_add_pd(_mm256_loadu_pd(acc + i + 4), a1));
+            }
+            return i;
+        }
+#endif
+    }
+
+    /* acc[i] += the value of heads[i] (and tails[i], with useTail) for n values */
+    template<bool useTail>
+    inline void accumulateRow(const float* heads, const float* tails, const uint_fast64_t& n, double* acc)
+    {
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+        const SimdLevel level = simdLevel();
+        if(level == SIMD_AVX2 || level == SIMD_AVX512) i = simd::accumulateRowAVX2<useTail>(heads, tails, n, acc);
+#endif
+        for(; i < n; ++i)
+            acc[i] += useTail ? segmentsToDouble(heads[i], tails[i]) : headToDouble(heads[i]);
+    }
+}
+
+/*
+    The rows of a vertex property at the heads (useTail false) or pairs: row v is the k values
+    from v*k of both planes.
+*/
+template<bool useTail>
+class VertexRows
+{
+public:
+    VertexRows(float *heads, float *tails, uint_fast64_t k) :heads(heads), tails(tails), k(k) {}
+
+    uint_fast64_t width() const { return k; }
+
+    double read(const uint_fast64_t& v, const uint_fast64_t& j) const
+    {
+        const uint_fast64_t at = v * k + j;
+        return useTail ? ManSeg::segmentsToDouble(heads[at], tails[at]) : ManSeg::headToDouble(heads[at]);
+    }
+
+    /* out[j] = value j of row v */
+    void readRow(const uint_fast64_t& v, double *out) const
+    {
+        if(useTail)
+            ManSeg::combineSegments(heads + v * k, tails + v * k, k, out);
+        else
+            ManSeg::widenHeads(heads + v * k, k, out);
+    }
+
+    /* acc[j] += value j of row v */
+    void accumulate(const uint_fast64_t& v, double *acc) const
+    {
+        ManSeg::accumulateRow<useTail>(heads + v * k, tails + v * k, k, acc);
+    }
+
+    /* row v = in, its heads rounded according to mode */
+    template<ManSeg::RoundingMode mode = ManSeg::ROUND_TRUNCATE>
+    void writeRow(const uint_fast64_t& v, const double *in)
+    {
+        if(useTail)
+            ManSeg::splitSegments(in, k, heads + v * k, tails + v * k);
+        else
+            ManSeg::narrowToHeads<mode>(in, k, heads + v * k);
+    }
+
+    /*
+        row v += in, atomically for each value: a CAS on each head word, or at the pairs the row
+        under the pair lock of v (see ManSeg::atomicAdd).
+    */
+    void atomicAccumulate(const uint_fast64_t& v, const double *in)
+    {
+        if(!useTail)
+        {
+            for(uint_fast64_t j = 0; j < k; ++j)
+                ManSeg::atomicAdd(reinterpret_cast<ManSeg::h32*>(heads + v * k + j), in[j]);
+            return;
+        }
+        ManSeg::PairLock& lock = ManSeg::pairLock(v);
+        while(!ManSeg::tryLock(&lock.locked))
+            while(lock.locked)
+                ManSeg::spinPause();
+        double row[MANSEG_VPROP_MAX_K];
+        readRow(v, row);
+        for(uint_fast64_t j = 0; j < k; ++j)
+            row[j] += in[j];
+        writeRow(v, row);
+        ManSeg::unlock(&lock.locked);
+    }
+
+    void prefetch(const uint_fast64_t& v) const
+    {
+        ManSeg::prefetchLine(heads + v * k);
+        if(useTail)
+            ManSeg::prefetchLine(tails + v * k);
+    }
+
+private:
+    float *heads;
+    float *tails;
+    uint_fast64_t k;
+};
+
+/*
+    n x k values over the elements of a partitioner, zeroed partition by partition on the threads
+    of each partition's node. k is at most MANSEG_VPROP_MAX_K.
+*/
+class PartitionedVertexMatrix : public ManSeg::BasicManSegArray<PartitionedSegmentAllocator>
+{
+    typedef ManSeg::BasicManSegArray<PartitionedSegmentAllocator> Base;
+public:
+    PartitionedVertexMatrix(const partitioner &part, uint_fast64_t k, bool hugePages=false)
+        :Base((uint_fast64_t)part.get_num_elements() * k, PartitionedSegmentAllocator(part, hugePages, k)), k(k)
+    {
+        if(k == 0 || k > MANSEG_VPROP_MAX_K)
+        {
+            cerr << "PartitionedVertexMatrix: k = " << k << ", must be 1 to " << MANSEG_VPROP_MAX_K << "\n";
+            abort();
+        }
+        first_touch(part);
+    }
+
+    PartitionedVertexMatrix(PartitionedVertexMatrix&&) = default;
+    PartitionedVertexMatrix& operator=(PartitionedVertexMatrix&&) = default;
+
+    friend void swap(PartitionedVertexMatrix &a, PartitionedVertexMatrix &b) noexcept
+    {
+        a.swap(b);
+        std::swap(a.k, b.k);
+    }
+
+    uint_fast64_t width() const { return k; }
+
+    VertexRows<false> headRows() { return VertexRows<false>(heads.getHeads(), heads.getTails(), k); }
+    VertexRows<true> pairRows() { return VertexRows<true>(heads.getHeads(), heads.getTails(), k); }
+
+    /* the rows at an AccessLevel, ACCESS_HEADS or ACCESS_PAIRS (there is no full plane) */
+    template<ManSeg::AccessLevel level>
+    VertexRows<level != ManSeg::ACCESS_HEADS> rows_as()
+    {
+        static_assert(level != ManSeg::ACCESS_FULL, "a PartitionedVertexMatrix has no full plane");
+        return VertexRows<level != ManSeg::ACCESS_HEADS>(heads.getHeads(), heads.getTails(), k);
+    }
+
+private:
+    uint_fast64_t k;
+
+    void first_touch(const partitioner &part)
+    {
+        const int perNode = part.get_num_per_node_partitions();
+        float *h = heads.getHeads();
+        float *t = heads.getTails();
+        const uint_fast64_t w = k;
+        loop(j, part, perNode, {
+            std::fill(h + j * w, h + (j + 1) * w, 0.0f);
+            std::fill(t + j * w, t + (j + 1) * w, 0.0f);
+        });
+    }
+};
+
+/*
+    edgeMap functor summing rows along the edges: out[d] += scale(d) * in[s] for each edge s -> d,
+    with scale(d) from a Scale functor (e.g. a damping over the in-degree of d). The dense pull keeps
+    the sum of d's in-rows in its cache, and adds it to out[d] once, when committed; the pushes add
+    each row as it comes, atomically for the sparse and source partitioned paths. Either way out must
+    hold its starting value (e.g. the restart term of a propagation) before the edgeMap. In and Out
+    are VertexRows, at any level each.
+*/
+template<class In, class Out, class Scale>
+struct RowSum_F
+{
+    In in;
+    Out out;
+    Scale scale;
+    static const bool use_cache = true;
+    struct cache_t
+    {
+        double sum[MANSEG_VPROP_MAX_K];
+    };
+    RowSum_F(const In &_in, const Out &_out, const Scale &_scale) :in(_in), out(_out), scale(_scale) {}
+
+    inline bool update(intT s, intT d)
+    {
+        double row[MANSEG_VPROP_MAX_K], sum[MANSEG_VPROP_MAX_K];
+        scaledRow(s, d, row);
+        out.readRow(d, sum);
+        const uint_fast64_t k = in.width();
+        for(uint_fast64_t j = 0; j < k; ++j)
+            sum[j] += row[j];
+        out.writeRow(d, sum);
+        return 1;
+    }
+    inline bool updateAtomic(intT s, intT d)
+    {
+        double row[MANSEG_VPROP_MAX_K];
+        scaledRow(s, d, row);
+        out.atomicAccumulate(d, row);
+        return 1;
+    }
+
+    inline void create_cache(cache_t &cache, intT d)
+    {
+        std::fill(cache.sum, cache.sum + in.width(), 0.0);
+    }
+    inline bool update(cache_t &cache, intT s)
+    {
+        in.accumulate(s, cache.sum);
+        return 1;
+    }
+    inline void commit_cache(cache_t &cache, intT d)
+    {
+        double row[MANSEG_VPROP_MAX_K];
+        const double f = scale(d);
+        const uint_fast64_t k = in.width();
+        out.readRow(d, row);
+        for(uint_fast64_t j = 0; j < k; ++j)
+            row[j] += f * cache.sum[j];
+        out.writeRow(d, row);
+    }
+
+    inline void prefetch(intT s)
+    {
+        in.prefetch(s);
+    }
+    inline bool cond(intT d)
+    {
+        return cond_true(d);
+    }
+
+private:
+    // row = scale(d) * in[s]
+    inline void scaledRow(intT s, intT d, double *row)
+    {
+        const double f = scale(d);
+        const uint_fast64_t k = in.width();
+        in.readRow(s, row);
+        for(uint_fast64_t j = 0; j < k; ++j)
+            row[j] *= f;
+    }
+};
+
+template<class In, class Out, class Scale>
+inline RowSum_F<In, Out, Scale> makeRowSum_F(const In &in, const Out &out, const Scale &scale)
+{
+    return RowSum_F<In, Out, Scale>(in, out, scale);
+}
+
+#endif // MANSEG_VPROP_H
@@ -0,0 +1,467 @@
+// -*- C++ -*-
+// One PageRank (power iteration, as PageRankUpdate.C) over a precision ladder: the storage of the
+// vectors, and the rung each iteration reads and writes, are the only things a ladder chooses, so
+// every variant runs the same edge functor and the same fused vertex sweep, and their times and
+// iteration counts compare like for like. A driver defines PR_LADDER and includes this file:
+//     DoubleLadder        doubles throughout                       (PageRankUpdate)
+//     FloatLadder         floats throughout                        (PageRankUpdate_Floats)
+//     FloatDoubleLadder   floats, then doubles                     (PageRankUpdate_F2D)
+//     HeadsPairsLadder    ManSeg heads, then pairs                 (PageRankUpdate_ManSeg)
+//     HeadsFullLadder     ManSeg heads, then a plane of doubles    (PageRankUpdate_ManSegFull)
+// A two rung ladder stays on the low rung until the PrecisionController ($MANSEG_SWITCH_POLICY,
+// by default the AdaptivePrecisionBound on the change) switches, runs one interim iteration that
+// reads the low rung and writes the high one, and then reads and writes the high rung. Built with
+// -DPR_SCHEDULE_HEADS=k, it does k iterations on the low rung, the interim one and the rest on the
+// high rung, as a FixedSchedule (manseglib_schedule.hpp), with no controller at all. Either way an
+// iteration is PageRankIteration::iterate<level>, so its rungs are chosen at compile time.
+// PageRankManSeg.C keeps its own loop for what only it has (checkpoints, dual writes, priority
+// promotion, the shadow sample, segments and warm starts).
+#ifndef PAGERANK_ENGINE_H
+#define PAGERANK_ENGINE_H
+#include "ligra-numa.h"
+#include "math.h"
+#include "../../manseglib.hpp"
+#include "../../manseglib_controller.hpp"
+#include "../../manseglib_schedule.hpp"
+#include "../../manseglib_energy.hpp"
+#include "manseg_mm.h"
+#include "../../manseglib_trace.hpp"
+using namespace ManSeg;
+int MaxIter=100;
+// rounding of head writes: ROUND_TRUNCATE, ROUND_NEAREST or ROUND_STOCHASTIC
+#ifndef MANSEG_ROUNDING
+#define MANSEG_ROUNDING ROUND_TRUNCATE
+#endif
+#include "manseg_gather.h"
+
+// floats behind the view interface of the ManSeg views (read, set<mode>), for the float rungs
+class FloatView
+{
+public:
+    FloatView(float *values) :values(values) {}
+
+    double read(const uint_fast64_t& id) const { return values[id]; }
+
+    /* rounded to the nearest float, whatever the mode */
+    template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+    void set(const uint_fast64_t& id, const T& t) { values[id] = (float)t; }
+
+    float *get() const { return values; }
+
+private:
+    float *values;
+};
+
+inline void atomicAdd(FloatView& a, const uint_fast64_t& id, const double& value)
+{
+    writeAdd(a.get() + id, (float)value);
+}
+
+// a vector of one storage type, for the single rung ladders and FloatDoubleLadder
+template<class T>
+struct PlainVector
+{
+    mmap_ptr<T> values;
+    intT length;
+
+    explicit PlainVector(const partitioner &part) :length(part.get_num_elements())
+    {
+        values.part_allocate(part);
+        const int perNode = part.get_num_per_node_partitions();
+        T *v = values;
+        loop(j, part, perNode, v[j] = 0);
+    }
+    void del() { values.del(); }
+};
+
+inline FloatView viewOf(PlainVector<float> &v) { return FloatView(v.values); }
+inline FullView viewOf(PlainVector<double> &v) { return FullView(v.values, v.length); }
+
+struct DoubleLadder
+{
+    static const bool twoRungs = false;
+    static const char *lowName() { return "double"; }
+    static const char *highName() { return "double"; }
+    static const char *name() { return "double"; }
+    static const int lowBytes = sizeof(double), highBytes = sizeof(double);
+
+    struct Vector
+    {
+        PlainVector<double> d;
+        explicit Vector(const partitioner &part) :d(part) {}
+        FullView low() { return viewOf(d); }
+        FullView high() { return viewOf(d); }
+        void del() { d.del(); }
+        friend void swap(Vector &a, Vector &b) { std::swap(a.d, b.d); }
+    };
+};
+
+struct FloatLadder
+{
+    static const bool twoRungs = false;
+    static const char *lowName() { return "float"; }
+    static const char *highName() { return "float"; }
+    static const char *name() { return "float"; }
+    static const int lowBytes = sizeof(float), highBytes = sizeof(float);
+
+    struct Vector
+    {
+        PlainVector<float> f;
+        explicit Vector(const partitioner &part) :f(part) {}
+        FloatView low() { return viewOf(f); }
+        FloatView high() { return viewOf(f); }
+        void del() { f.del(); }
+        friend void swap(Vector &a, Vector &b) { std::swap(a.f, b.f); }
+    };
+};
+
+// the views of the rungs of PartitionedManSegArrays
+typedef LevelView<ACCESS_HEADS, PartitionedSegmentAllocator>::type PartitionedHeads;
+typedef LevelView<ACCESS_PAIRS, PartitionedSegmentAllocator>::type PartitionedPairs;
+
+// a float and a double array per vector, as PageRankUpdate_F2D.C had
+struct FloatDoubleLadder
+{
+    static const bool twoRungs = true;
+    static const char *lowName() { return "float"; }
+    static const char *highName() { return "double"; }
+    static const char *name() { return "float-double"; }
+    static const int lowBytes = sizeof(float), highBytes = sizeof(double);
+
+    struct Vector
+    {
+        PlainVector<float> f;
+        PlainVector<double> d;
+        explicit Vector(const partitioner &part) :f(part), d(part) {}
+        FloatView low() { return viewOf(f); }
+        FullView high() { return viewOf(d); }
+        void del() { f.del(); d.del(); }
+        friend void swap(Vector &a, Vector &b) { std::swap(a.f, b.f); std::swap(a.d, b.d); }
+    };
+};
+
+// the heads, then the pairs, of one PartitionedManSegArray: 4 bytes a value, then 8, and no copy
+struct HeadsPairsLadder
+{
+    static const bool twoRungs = true;
+    static const char *lowName() { return "heads"; }
+    static const char *highName() { return "pairs"; }
+    static const char *name() { return "heads-pairs"; }
+    static const int lowBytes = sizeof(float), highBytes = sizeof(double);
+
+    struct Vector
+    {
+        PartitionedManSegArray a;
+        explicit Vector(const partitioner &part) :a(part, false, false) {}
+        PartitionedHeads low() { return a.read_as<ACCESS_HEADS>(); }
+        PartitionedPairs high() { return a.read_as<ACCESS_PAIRS>(); }
+        void del() {}
+        friend void swap(Vector &x, Vector &y) { swap(x.a, y.a); }
+    };
+};
+
+// the heads, then the full plane of doubles of a PartitionedManSegArray (12 bytes a value in all)
+struct HeadsFullLadder
+{
+    static const bool twoRungs = true;
+    static const char *lowName() { return "heads"; }
+    static const char *highName() { return "full"; }
+    static const char *name() { return "heads-full"; }
+    static const int lowBytes = sizeof(float), highBytes = sizeof(double);
+
+    struct Vector
+    {
+        PartitionedManSegArray a;
+        explicit Vector(const partitioner &part) :a(part, false, true) {}
+        PartitionedHeads low() { return a.read_as<ACCESS_HEADS>(); }
+        FullView high() { return a.read_as<ACCESS_FULL>(); }
+        void del() {}
+        friend void swap(Vector &x, Vector &y) { swap(x.a, y.a); }
+    };
+};
+
+// p_next[d] += damping * p_curr[s] / outdeg(s), summed in doubles whatever the rungs
+template <class vertex, class ReadView, class WriteView>
+struct PR_F
+{
+    ReadView p_curr;
+    WriteView p_next;
+    double damping;
+    vertex* V;
+    static const bool use_cache = true;
+
+    struct cache_t
+    {
+        double p_next;
+    };
+    PR_F(const ReadView &_p_curr, const WriteView &_p_next, double _damping, vertex* _V) :
+        p_curr(_p_curr), p_next(_p_next), damping(_damping), V(_V) {}
+    inline bool update(intT s, intT d)  //update function applies PageRank equation
+    {
+        p_next.template set<MANSEG_ROUNDING>(d, p_next.read(d) + damping*(p_curr.read(s)/V[s].getOutDegree()));
+        return 1;
+    }
+    inline bool updateAtomic (intT s, intT d)   //atomic Update
+    {
+        atomicAdd(p_next, d, damping*(p_curr.read(s)/V[s].getOutDegree()));
+        return 1;
+    }
+
+    inline void create_cache(cache_t &cache, intT d)
+    {
+        cache.p_next = p_next.read(d);
+    }
+    inline bool update(cache_t &cache, intT s)
+    {
+        cache.p_next += damping*(p_curr.read(s)/V[s].getOutDegree());
+        return 1;
+    }
+
+    inline void commit_cache(cache_t &cache, intT d)
+    {
+        // Cache is used only in sequential mode
+        p_next.template set<MANSEG_ROUNDING>(d, cache.p_next);
+    }
+
+    inline bool cond (intT d)
+    {
+        return cond_true(d);    //does nothing
+    }
+};
+
+// compensated sum of a over 0..n, by fixed blocks of vertex ids
+template<class View>
+double sumArray(const partitioner &part, View a, intT n)
+{
+    MANSEG_TRACE_SCOPE("sumArray");
+    intT nb = (n + MANSEG_REDUCE_BLOCK - 1) / MANSEG_REDUCE_BLOCK;
+    double *bsum = new double [nb];
+    map_partition( k, part, {
+        forGatherBlocks(part, k, n, [&](intT b, intT s, intT e) {
+            double sum = 0., err = 0.;
+            for( intT j=s; j < e; ++j )
+                compensatedAdd(sum, err, a.read(j));
+            bsum[b] = sum;
+        });
+    } );
+    double sum = kahanSum(bsum, 0, nb);
+    delete [] bsum;
+    return sum;
+}
+
+/*
+    The vertex phase in one sweep: p_next[j] += scaleAdditive, then delta is the compensated sum
+    of |p_curr[j] - p_next[j]| (p_next as stored) and norm that of p_next[j], and p_curr is zeroed
+    through zero_curr, its view at the rung the next iteration accumulates into.
+*/
+template<class CurrView, class ZeroView, class NextView>
+void rescaleDiffReset(const partitioner &part, intT n, CurrView p_curr, ZeroView zero_curr, NextView p_next,
+                      double scaleAdditive, double &delta, double &norm)
+{
+    MANSEG_TRACE_SCOPE("rescaleDiffReset");
+    intT nb = (n + MANSEG_REDUCE_BLOCK - 1) / MANSEG_REDUCE_BLOCK;
+    double *bdelta = new double [nb];
+    double *bnorm = new double [nb];
+    map_partition( k, part, {
+        forGatherBlocks(part, k, n, [&](intT b, intT s, intT e) {
+            double d = 0., derr = 0., x = 0., xerr = 0.;
+            for( intT j=s; j < e; ++j )
+            {
+                p_next.template set<MANSEG_ROUNDING>(j, p_next.read(j) + scaleAdditive);
+                const double stored = p_next.read(j);
+                compensatedAdd(d, derr, fabs(p_curr.read(j) - stored));
+                compensatedAdd(x, xerr, stored);
+                zero_curr.set(j, 0.0);
+            }
+            bdelta[b] = d;
+            bnorm[b] = x;
+        });
+    } );
+    delta = kahanSum(bdelta, 0, nb);
+    norm = kahanSum(bnorm, 0, nb);
+    delete [] bdelta;
+    delete [] bnorm;
+}
+
+/*
+    One iteration, reading p_curr through curr and accumulating into p_next through next, then the
+    vertex phase, zeroing p_curr through zero for the next iteration. Returns the frontier edgeMap
+    gives, for the next iteration.
+*/
+template<class vertex, class GraphType, class ReadView, class WriteView, class ZeroView>
+partitioned_vertices pageRankStep(GraphType &GA, partitioned_vertices &Frontier, vertex *V, ReadView curr, WriteView next,
+                                  ZeroView zero, double damping, double &delta, double &norm)
+{
+    const partitioner &part = GA.get_partitioner();
+    intT n = GA.n;
+    // p_next[d] += damping * (p_curr[s]/V[s].getOutDegree())
+    partitioned_vertices output = edgeMap(GA, Frontier, PR_F<vertex, ReadView, WriteView>(curr, next, damping, V), GA.m/20);
+    // find value to scale PR vals by to make vector add to 1
+    double scaleAdditive = (1 - sumArray(part, next, n))/(double)n;
+    rescaleDiffReset(part, n, curr, zero, next, scaleAdditive, delta, norm);
+    return output;
+}
+
+/*
+    Model of the memory traffic of an iteration, for the results: per edge its index and a read
+    of p_curr, per vertex the accumulated value of p_next, then the sum, and the sweep reading
+    both vectors and writing p_next and p_curr.
+*/
+inline double iterationBytes(intT n, intT m, double readBytes, double writeBytes)
+{
+    return m*(sizeof(intE) + readBytes) + (double)n*(2*writeBytes + writeBytes + readBytes + 2*writeBytes + readBytes);
+}
+
+// the rungs an iteration at level L reads and writes: the low rung at the heads, the low rung into
+// the high one for the interim iteration, and the high rung in full
+template<PrecisionLevel L>
+struct Rungs
+{
+    template<class Vector> static auto read(Vector &v) -> decltype(v.high()) { return v.high(); }
+    template<class Vector> static auto write(Vector &v) -> decltype(v.high()) { return v.high(); }
+};
+
+template<>
+struct Rungs<PRECISION_HEADS>
+{
+    template<class Vector> static auto read(Vector &v) -> decltype(v.low()) { return v.low(); }
+    template<class Vector> static auto write(Vector &v) -> decltype(v.low()) { return v.low(); }
+};
+
+template<>
+struct Rungs<PRECISION_INTERIM>
+{
+    template<class Vector> static auto read(Vector &v) -> decltype(v.low()) { return v.low(); }
+    template<class Vector> static auto write(Vector &v) -> decltype(v.high()) { return v.high(); }
+};
+
+/*
+    An iteration of pageRank at level L, for runSchedule: p_curr is read at L's read rung and p_next
+    accumulated at its write rung, and p_curr is zeroed at the write rung, as the next iteration
+    accumulates into it. Returns the delta.
+*/
+template <class Ladder, class GraphType>
+struct PageRankIteration
+{
+    typedef typename GraphType::vertex_type vertex;
+    typedef typename Ladder::Vector Vector;
+
+    GraphType &GA;
+    vertex *V;
+    Vector &p_curr, &p_next;
+    double damping;
+    EnergyPhases &energy;
+    PrecisionController<ConfiguredPolicy> *control;     // for the reason of a switch, if dynamic
+    partitioned_vertices Frontier;
+    timer iterTime;
+    double delta, norm;     // of the last iteration
+
+    PageRankIteration(GraphType &GA, vertex *V, Vector &p_curr, Vector &p_next, double damping, EnergyPhases &energy)
+        :GA(GA), V(V), p_curr(p_curr), p_next(p_next), damping(damping), energy(energy), control(0),
+        Frontier(partitioned_vertices::bits(GA.get_partitioner(), GA.n, GA.m)), delta(2.0), norm(1.0)
+    {}
+
+    template<PrecisionLevel L>
+    double iterate(const int &iter)
+    {
+        const int count = iter + 1;
+        MANSEG_TRACE_SCOPE_ARG("iteration", "iter", count);
+        if(L == PRECISION_INTERIM)
+            cerr << "switching from " << Ladder::lowName() << " at iter " << iter << " ("
+                 << (control ? control->reasonName() : "fixed schedule") << ")\n";
+        partitioned_vertices output = pageRankStep(GA, Frontier, V, Rungs<L>::read(p_curr), Rungs<L>::write(p_next),
+                                                   Rungs<L>::write(p_curr), damping, delta, norm);
+        swap(p_curr, p_next);
+        // manage frontier stuff
+        Frontier.del();
+        Frontier = output;
+
+        const char *name = L == PRECISION_HEADS ? Ladder::lowName() : L == PRECISION_INTERIM ? levelName(PRECISION_INTERIM) : Ladder::highName();
+        const double readBytes = L == PRECISION_FULL ? Ladder::highBytes : Ladder::lowBytes;
+        const double writeBytes = L == PRECISION_HEADS ? Ladder::lowBytes : Ladder::highBytes;
+        cerr << count << ": delta = " << delta << "  xnorm = " << norm << "\n";
+        const double seconds = iterTime.next();
+        ligraResults->iteration(count, delta, seconds, name, iterationBytes(GA.n, GA.m, readBytes, writeBytes));
+        const Energy e = energy.lap(name, seconds);
+        ligraResults->energy(e.package, e.dram);
+        return delta;
+    }
+};
+
+template <class Ladder, class GraphType>
+void pageRank(GraphType &GA)
+{
+    typedef typename GraphType::vertex_type vertex; // Is determined by GraphType
+    typedef typename Ladder::Vector Vector;
+    const partitioner &part = GA.get_partitioner();
+    graph<vertex> & WG = GA.get_partition();
+    vertex *V = WG.V;
+    const int perNode = part.get_num_per_node_partitions();
+    intT n = GA.n;
+    const double damping = 0.85;
+    const double epsilon = 0.0000001;
+    double one_over_n = 1/(double)n;
+
+    Vector p_curr(part), p_next(part);
+    {
+        auto init = p_curr.low();
+        loop(j, part, perNode, init.set(j, one_over_n));
+    }
+    ligraResults->set("ladder", Ladder::name());
+
+    // RAPL energy by rung, where the counters can be read; the results have the last round's
+    EnergyPhases energy;
+    PageRankIteration<Ladder, GraphType> body(GA, V, p_curr, p_next, damping, energy);
+    timer &iterTime = body.iterTime;
+    int count;
+#ifdef PR_SCHEDULE_HEADS
+    typedef FixedSchedule<Ladder::twoRungs ? PR_SCHEDULE_HEADS : 0, Ladder::twoRungs> Schedule;
+    ligraResults->set("switch_policy", Schedule::name());
+    ligraResults->set("switch_param", (int)Schedule::heads);
+    cerr << setprecision(16);
+    iterTime.start();
+    energy.start();
+    count = runSchedule<Schedule>(body, MaxIter, epsilon);
+#else
+    PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment());
+    if(Ladder::twoRungs)
+    {
+        ligraResults->set("switch_policy", control.policy().name());
+        ligraResults->set("switch_param", control.policy().parameter());
+        body.control = &control;
+    }
+    cerr << setprecision(16);
+    iterTime.start();
+    energy.start();
+    if(Ladder::twoRungs)
+        count = runSchedule(control, body, MaxIter, epsilon);
+    else
+        count = runSchedule<FixedSchedule<0, false> >(body, MaxIter, epsilon);
+#endif
+    if(body.delta <= epsilon)
+        cerr << "successfully converged in " << count << " iterations\n";
+    MANSEG_TRACE_WRITE("PageRankUpdate.trace.json");
+    energy.print(stderr);
+    energy.report(*ligraResults);
+    ligraResults->set("iterations", count);
+    if(Ladder::twoRungs)
+    {
+#ifdef PR_SCHEDULE_HEADS
+        ligraResults->set("switch_iteration", Schedule::switchIteration());
+#else
+        ligraResults->set("switch_iteration", control.switchIteration());
+#endif
+    }
+
+    body.Frontier.del();
+    p_curr.del();
+    p_next.del();
+}
+
+template <class GraphType>
+void Compute(GraphType &GA, long start)
+{
+    pageRank<PR_LADDER>(GA);
+}
+
+#endif // PAGERANK_ENGINE_H
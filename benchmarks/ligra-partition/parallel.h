@@ -63,6 +63,8 @@
 #define cilk_sync
 #define parallel_main main
 #define parallel_for _Pragma("omp parallel for") for
+#define parallel_for_numa _Pragma("omp parallel for") for
+#define cilk_for _Pragma("omp parallel for") for
 #define parallel_for_1 _Pragma("omp parallel for schedule (static,1)") for
 #define parallel_for_256 _Pragma("omp parallel for schedule (static,256)") for
 
@@ -80,6 +82,16 @@
 
 #endif
 
+// number of worker threads the parallel loops run on
+#if defined(CILK) || defined(CILKP)
+#include <cilk/cilk_api.h>
+#define getWorkers() __cilkrts_get_nworkers()
+#elif defined(OPENMP)
+#define getWorkers() omp_get_max_threads()
+#else
+#define getWorkers() 1
+#endif
+
 #include <limits.h>
 
 #if defined(LONG)
@@ -0,0 +1,179 @@
+// -*- C++ -*-
+// Load balance of the partitions of the dense edgeMaps, built with -DPARTITION_PROFILE=1.
+//
+// edgeMap times each partition of its dense COO or CSC loop and counts the edges it covers. After every
+// round parallel_main prints, per NUMA node, the partitions' edges and times (min, max, mean), their
+// imbalance (the slowest partition's time over the mean) and the slowest partition's share of the time
+// the loops took: the part of the critical path that one partition accounts for, whatever the others do.
+// The round's figures for the whole graph also go to the results as partition_imbalance and
+// partition_critical_share.
+//
+// With -rebalance, after each dense CSC edgeMap the CSC boundaries of every node are moved so that its
+// partitions would have taken equal times: a partition's time is taken as spread over its vertices in
+// proportion to their in-degree plus one, and the node's range is cut at equal shares of that. The
+// boundaries between nodes stay where they are, as the vertex data is placed by them. The COO
+// partitions are edge lists of their own, so they are only measured.
+#ifndef PARTITION_PROFILE_H
+#define PARTITION_PROFILE_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+class PartitionProfile
+{
+public:
+    PartitionProfile() : rebalancing( false ), perNode( 1 ), loops( 0 ), wall( 0 ) { }
+
+    void setRebalance( bool on ) { rebalancing = on; }
+    bool rebalance() const { return rebalancing; }
+
+    static double now()
+    {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // at the start of a dense loop over parts partitions, perNode_ to a node
+    void begin( int parts, int perNode_ )
+    {
+        if( (int)time.size() != parts )
+        {
+            time.assign( parts, 0.0 );
+            edges.assign( parts, 0 );
+            last.assign( parts, 0.0 );
+        }
+        perNode = std::max( perNode_, 1 );
+        loopStart = now();
+    }
+
+    // each partition is recorded by the one thread that ran it
+    void record( int p, double seconds, long e )
+    {
+        time[p] += seconds;
+        last[p] = seconds;
+        edges[p] += e;
+    }
+
+    void end()
+    {
+        wall += now() - loopStart;
+        ++loops;
+    }
+
+    // the start of CSC partition p: part's, or the rebalanced one for this many partitions and vertices
+    intT start_of( const partitioner & part, int p ) const
+    {
+        if( (int)bounds.size() == part.get_num_partitions() + 1 && bounds.back() == part.start_of( part.get_num_partitions() ) )
+            return bounds[p];
+        return part.start_of( p );
+    }
+
+    // moves the CSC boundaries within each node by the times of the last loop; weight(v) is the work of
+    // vertex v of the CSC, in any unit
+    template<class Weight>
+    void rebalanceBounds( const partitioner & part, const Weight & weight )
+    {
+        const int parts = part.get_num_partitions();
+        std::vector<intT> from( parts + 1 );
+        for( int p = 0; p <= parts; ++p )
+            from[p] = start_of( part, p );
+        bounds = from;
+        for( int node = 0; node * perNode < parts; ++node )
+        {
+            const int first = node * perNode, stop = std::min( parts, first + perNode );
+            // the time per unit of weight of each partition, and the node's total
+            std::vector<double> rate( stop - first, 0.0 );
+            double total = 0.0;
+            for( int p = first; p < stop; ++p )
+            {
+                double w = 0.0;
+                for( intT v = from[p]; v < from[p + 1]; ++v )
+                    w += weight( v );
+                rate[p - first] = w > 0.0 ? last[p] / w : 0.0;
+                total += last[p];
+            }
+            if( total <= 0.0 )
+                continue;
+            // cut where the running time passes each equal share
+            int p = first, next = first + 1;
+            double run = 0.0;
+            for( intT v = from[first]; v < from[stop] && next < stop; ++v )
+            {
+                while( v >= from[p + 1] )
+                    ++p;
+                run += weight( v ) * rate[p - first];
+                while( next < stop && run >= total * (next - first) / (stop - first) )
+                    bounds[next++] = v + 1;
+            }
+            for( ; next < stop; ++next )
+                bounds[next] = from[stop];
+        }
+    }
+
+    // prints the round's figures per node, sets them in the results and starts the next round
+    void report( ManSeg::ResultsWriter & results )
+    {
+        const int parts = time.size();
+        if( parts == 0 || loops == 0 )
+            return;
+        std::cerr << "partition profile: " << loops << " dense edgeMaps, " << wall << " s" << std::endl;
+        for( int node = 0; node * perNode < parts; ++node )
+        {
+            const int first = node * perNode, stop = std::min( parts, first + perNode );
+            Stats s = stats( first, stop );
+            std::cerr << "  node " << node << ": " << (stop - first) << " partitions"
+                      << ", edges min " << s.minEdges << " max " << s.maxEdges << " mean " << (long)s.meanEdges
+                      << ", ms min " << 1e3 * s.minTime << " max " << 1e3 * s.maxTime << " mean " << 1e3 * s.meanTime
+                      << ", imbalance " << s.imbalance() << ", critical path " << 100.0 * s.maxTime / wall << "%"
+                      << std::endl;
+        }
+        Stats all = stats( 0, parts );
+        results.set( "partition_imbalance", all.imbalance() );
+        results.set( "partition_critical_share", all.maxTime / wall );
+
+        std::fill( time.begin(), time.end(), 0.0 );
+        std::fill( edges.begin(), edges.end(), 0 );
+        loops = 0;
+        wall = 0;
+    }
+
+private:
+    struct Stats
+    {
+        long minEdges, maxEdges;
+        double meanEdges, minTime, maxTime, meanTime;
+
+        double imbalance() const { return meanTime > 0.0 ? maxTime / meanTime : 1.0; }
+    };
+
+    Stats stats( int first, int stop ) const
+    {
+        Stats s = { edges[first], edges[first], 0.0, time[first], time[first], 0.0 };
+        for( int p = first; p < stop; ++p )
+        {
+            s.minEdges = std::min( s.minEdges, edges[p] );
+            s.maxEdges = std::max( s.maxEdges, edges[p] );
+            s.minTime = std::min( s.minTime, time[p] );
+            s.maxTime = std::max( s.maxTime, time[p] );
+            s.meanEdges += edges[p];
+            s.meanTime += time[p];
+        }
+        s.meanEdges /= stop - first;
+        s.meanTime /= stop - first;
+        return s;
+    }
+
+    bool rebalancing;
+    int perNode;
+    long loops;
+    double wall, loopStart;
+    std::vector<double> time, last;  // per partition: over the round, and in the last loop
+    std::vector<long> edges;
+    std::vector<intT> bounds;        // the rebalanced CSC boundaries, if any
+};
+
+static PartitionProfile partitionProfile;
+
+#endif
@@ -0,0 +1,139 @@
+// -*- C++ -*-
+// Choice of the COO partition count by trial rounds, for -tune.
+//
+// The best count depends on the graph, the app and how its data is stored: with the vertex values at
+// their heads a partition's slice of them is half the size, so fewer, larger partitions may stay in cache.
+// With -tune, parallel_main runs one round at each candidate count (the -tune list, or -c with a quarter,
+// a half and twice it) and times it along with the partitioned_graph it needed. The remaining rounds use
+// the count that finishes them soonest, building its graph again unless it is the last one tried; when no
+// rounds remain, the fastest round's count is the choice.
+//
+// The choice is kept in <graph>.tune, one line per app and partitioning, with the graph file's size and
+// modification time, and a later run that finds a matching line uses it without trials.
+#ifndef PARTITION_TUNE_H
+#define PARTITION_TUNE_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+class PartitionTune
+{
+public:
+    // spec is the -tune value, a comma separated list of counts; counts that are not a positive multiple
+    // of the nodes are dropped, and without any left (as for "auto") the candidates are those around base
+    PartitionTune( const char* spec, int base, int nodes )
+    {
+        std::stringstream in( spec ? spec : "" );
+        std::string item;
+        while( std::getline( in, item, ',' ) )
+            add( atoi( item.c_str() ), nodes );
+        if( candidates.empty() )
+        {
+            add( base / 4, nodes );
+            add( base / 2, nodes );
+            add( base, nodes );
+            add( base * 2, nodes );
+        }
+        build.assign( candidates.size(), 0.0 );
+        round.assign( candidates.size(), 0.0 );
+    }
+
+    const std::vector<int> & counts() const { return candidates; }
+
+    void record( size_t i, double buildSeconds, double roundSeconds )
+    {
+        build[i] = buildSeconds;
+        round[i] = roundSeconds;
+    }
+
+    // the count to finish remaining rounds with, when the graph of candidate last is the one built
+    int choose( size_t last, long remaining ) const
+    {
+        size_t best = 0;
+        double bestCost = 0.0;
+        for( size_t i = 0; i < candidates.size(); ++i )
+        {
+            double cost = remaining > 0 ? (i == last ? 0.0 : build[i]) + remaining * round[i] : round[i];
+            if( i == 0 || cost < bestCost )
+            {
+                best = i;
+                bestCost = cost;
+            }
+        }
+        return candidates[best];
+    }
+
+    // "count:build:round" for each candidate, for the results
+    std::string trials() const
+    {
+        std::ostringstream out;
+        for( size_t i = 0; i < candidates.size(); ++i )
+            out << (i ? "," : "") << candidates[i] << ":" << build[i] << ":" << round[i];
+        return out.str();
+    }
+
+    // the count cached for key, the app and its partitioning, or 0
+    static int cached( const std::string & graph, const std::string & key )
+    {
+        std::string stamp = stampOf( graph );
+        std::ifstream in( (graph + ".tune").c_str() );
+        std::string line;
+        while( std::getline( in, line ) )
+        {
+            std::istringstream fields( line );
+            std::string k, s;
+            int count = 0;
+            if( fields >> k >> s >> count && k == key && s == stamp )
+                return count;
+        }
+        return 0;
+    }
+
+    // replaces key's line in the cache; a cache that cannot be written is only reported
+    static void save( const std::string & graph, const std::string & key, int count )
+    {
+        std::vector<std::string> lines;
+        {
+            std::ifstream in( (graph + ".tune").c_str() );
+            std::string line;
+            while( std::getline( in, line ) )
+                if( line.compare( 0, key.size() + 1, key + " " ) != 0 )
+                    lines.push_back( line );
+        }
+        std::ofstream out( (graph + ".tune").c_str() );
+        for( size_t i = 0; i < lines.size(); ++i )
+            out << lines[i] << "\n";
+        out << key << " " << stampOf( graph ) << " " << count << "\n";
+        if( !out )
+            std::cerr << "cannot write " << graph << ".tune" << std::endl;
+    }
+
+private:
+    void add( int count, int nodes )
+    {
+        if( count > 0 && count % nodes == 0 && std::find( candidates.begin(), candidates.end(), count ) == candidates.end() )
+            candidates.push_back( count );
+    }
+
+    // the graph file's size and modification time
+    static std::string stampOf( const std::string & graph )
+    {
+        struct stat st;
+        std::ostringstream out;
+        if( stat( graph.c_str(), &st ) == 0 )
+            out << (long)st.st_size << "@" << (long)st.st_mtime;
+        return out.str();
+    }
+
+    std::vector<int> candidates;
+    std::vector<double> build, round;  // seconds per candidate
+};
+
+#endif
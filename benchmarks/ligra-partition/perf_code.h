@@ -0,0 +1,93 @@
+// -*- C++ -*-
+// papi_code.h's per round counters through perf_event_open, for machines without libpapi: build
+// with -DPERF_CACHE=1 (no -lpapi) and ligra-numa.h calls these in place of PAPI's. Each worker
+// counts its cycles, LLC misses and DTLB misses, and the memory controllers the DRAM lines read and
+// written (see manseg_perf.h); PAPI_total_print gives the average of a round, and THREADS_CACHE
+// prints every thread's counts each round. Events the machine or its perf_event_paranoid do not
+// allow are printed as n/a.
+#ifndef PERF_CODE_H
+#define PERF_CODE_H
+#include <stdio.h>
+#include "manseg_perf.h"
+
+#ifndef THREADS_CACHE
+#define THREADS_CACHE 0
+#endif
+
+ManSeg::PerfCounters *perfCounters = 0;
+long long *perfRound = 0;                        // [worker][event] of the round
+long long perfTotal[ManSeg::PERF_NUM_EVENTS];    // over the rounds
+
+inline void perfPrintCount(const ManSeg::PerfEvent& e, const long long& c)
+{
+    if(perfCounters->available(e))
+        printf("%lld\t", c);
+    else
+        printf("n/a\t");
+}
+
+inline void PAPI_initial()
+{
+    perfCounters = new ManSeg::PerfCounters();
+    perfRound = new long long[perfCounters->workers()*ManSeg::PERF_NUM_EVENTS]();
+    for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+        perfTotal[e] = 0;
+    if(!perfCounters->anyAvailable())
+        printf("perf_event_open counts nothing here (see /proc/sys/kernel/perf_event_paranoid)\n");
+}
+
+inline void PAPI_start_count()
+{
+    perfCounters->start();
+}
+
+inline void PAPI_stop_count()
+{
+    perfCounters->stop(perfRound);
+}
+
+/* adds the round to the totals (printing each thread's, with THREADS_CACHE), and clears it */
+inline void PAPI_print()
+{
+    const int workers = perfCounters->workers();
+#if THREADS_CACHE
+    printf("Threads ");
+    for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+        printf("%s\t", ManSeg::perfEventName((ManSeg::PerfEvent)e));
+    printf("\n");
+#endif
+    for(int w = 0; w < workers; w++)
+    {
+#if THREADS_CACHE
+        printf("%d\t ", w);
+        for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+            perfPrintCount((ManSeg::PerfEvent)e, perfRound[w*ManSeg::PERF_NUM_EVENTS + e]);
+        printf("\n");
+#endif
+        for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+        {
+            perfTotal[e] += perfRound[w*ManSeg::PERF_NUM_EVENTS + e];
+            perfRound[w*ManSeg::PERF_NUM_EVENTS + e] = 0;
+        }
+    }
+}
+
+inline void PAPI_total_print(int rounds)
+{
+    for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+        printf("%s\t", ManSeg::perfEventName((ManSeg::PerfEvent)e));
+    printf("\n");
+    for(int e = 0; e < ManSeg::PERF_NUM_EVENTS; e++)
+        perfPrintCount((ManSeg::PerfEvent)e, perfTotal[e]/rounds);
+    printf("\n\n");
+}
+
+inline void PAPI_end()
+{
+    delete perfCounters;
+    delete [] perfRound;
+    perfCounters = 0;
+    perfRound = 0;
+}
+
+#endif // PERF_CODE_H
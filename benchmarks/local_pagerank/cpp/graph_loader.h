@@ -0,0 +1,966 @@
+#pragma once
+
+/*
+    Reading of the graph files without the strings and streams of getline and istringstream (several
+    allocations per line): the file is mapped, and its integers are read where they lie. Files over
+    ParallelBytes are parsed by one std::thread per core, each taking the lines that start in its
+    stretch of the text. A first pass counts the edges (or values) of every stretch, so each thread
+    then knows where in the arrays to write its own.
+        GraphText text(file, "CSR");            // exits with "error opening file in CSR" if it cannot
+        const char* p = text.skipLines(text.begin(), 1);
+        p = readInt(p, text.end(), numVertices);
+    The edge lists (COO and SNAP files) are a pair "source destination" per line, and the adjacency
+    files (CSR and CSC) a line per vertex, the vertex then its neighbours. Lines that do not start with
+    a digit (comments, blank lines) are skipped.
+    Windows has no mmap, so there the files (and caches) are read into memory instead.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* the size and modification time of file; false if it cannot be read */
+inline bool fileStamp(const std::string& file, int64_t& size, int64_t& mtime)
+{
+#if defined(_WIN32)
+    struct _stat64 st;      // stat's size is 32 bits there
+    if(_stat64(file.c_str(), &st) != 0)
+        return false;
+#else
+    struct stat st;
+    if(stat(file.c_str(), &st) != 0)
+        return false;
+#endif
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+#if defined(_WIN32)
+/* the whole of file in a new[] array, with its size in bytes; nullptr if it cannot be read */
+inline char* readWhole(const std::string& file, size_t& bytes)
+{
+    int64_t size, mtime;
+    FILE* f = fileStamp(file, size, mtime) ? fopen(file.c_str(), "rb") : nullptr;
+    if(f == nullptr)
+        return nullptr;
+    bytes = static_cast<size_t>(size);
+    char* data = new char[bytes > 0 ? bytes : 1];
+    const bool read = fread(data, 1, bytes, f) == bytes;
+    fclose(f);
+    if(!read)
+    {
+        delete[] data;
+        return nullptr;
+    }
+    return data;
+}
+#endif
+
+class GraphText
+{
+public:
+    // files smaller than this are parsed by a single thread
+    static const size_t ParallelBytes = 1 << 20;
+
+    GraphText(const std::string& file, const char* format) :data(nullptr), size(0)
+    {
+#if defined(_WIN32)
+        data = readWhole(file, size);
+        if(data == nullptr)
+        {
+            std::cerr << "error opening file in " << format << std::endl;
+            exit(1);
+        }
+#else
+        int fd = open(file.c_str(), O_RDONLY);
+        struct stat st;
+        if(fd < 0 || fstat(fd, &st) != 0)
+        {
+            std::cerr << "error opening file in " << format << std::endl;
+            exit(1);
+        }
+        size = st.st_size;
+        if(size > 0)
+        {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p == MAP_FAILED)
+            {
+                std::cerr << "error opening file in " << format << std::endl;
+                exit(1);
+            }
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+        close(fd);
+#endif
+    }
+
+    ~GraphText()
+    {
+#if defined(_WIN32)
+        delete[] data;
+#else
+        if(data != nullptr)
+            munmap(const_cast<char*>(data), size);
+#endif
+    }
+
+    GraphText(const GraphText&) = delete;
+    GraphText& operator=(const GraphText&) = delete;
+
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+
+    /* the start of the line after p's */
+    const char* nextLine(const char* p) const
+    {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end() - p));
+        return nl != nullptr ? nl + 1 : end();
+    }
+
+    const char* skipLines(const char* p, int lines) const
+    {
+        for(int i = 0; i < lines && p < end(); ++i)
+            p = nextLine(p);
+        return p;
+    }
+
+    /* the threads for the text from p on, and the stretch of it each takes, cut at line starts */
+    std::vector<const char*> split(const char* p) const
+    {
+        int parts = 1;
+        if(static_cast<size_t>(end() - p) >= ParallelBytes)
+            parts = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<const char*> cut(parts + 1, end());
+        cut[0] = p;
+        for(int t = 1; t < parts; ++t)
+        {
+            const char* c = p + (end() - p) * t / parts;
+            // a line belongs to the stretch its first character is in
+            cut[t] = (c > cut[t - 1] && c[-1] != '\n') ? nextLine(c) : std::max(c, cut[t - 1]);
+        }
+        return cut;
+    }
+
+private:
+    const char* data;
+    size_t size;
+};
+
+inline bool isDigit(const char& c) { return c >= '0' && c <= '9'; }
+
+/* reads the first unsigned integer at or after p (before limit) into value, returning the position after it */
+inline const char* readInt(const char* p, const char* limit, int& value)
+{
+    while(p < limit && !isDigit(*p)) ++p;
+    int v = 0;
+    for(; p < limit && isDigit(*p); ++p)
+        v = v * 10 + (*p - '0');
+    value = v;
+    return p;
+}
+
+/* the start of the line's first value, or nullptr if the line (from p) does not start with a digit */
+inline const char* lineValues(const char* p, const char* limit)
+{
+    while(p < limit && (*p == ' ' || *p == '\t')) ++p;
+    return (p < limit && isDigit(*p)) ? p : nullptr;
+}
+
+// edge lists shorter than this are grouped by a single thread
+static const int GroupParallelEdges = 1 << 20;
+
+/* runs f(t) for t = 0 .. parts - 1, each on its own thread */
+template<class F>
+inline void forEachPart(const int& parts, F f)
+{
+    if(parts == 1)
+    {
+        f(0);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for(int t = 0; t < parts; ++t)
+        threads.emplace_back(f, t);
+    for(auto& thread : threads)
+        thread.join();
+}
+
+/*
+    Reads count edges from p on, a pair of vertices per line, into first and second. Exits if there
+    are fewer, or a vertex is not below n.
+*/
+inline void readEdges(const GraphText& text, const char* p, const int& count, const int& n, int* first, int* second)
+{
+    std::vector<const char*> cut = text.split(p);
+    const int parts = cut.size() - 1;
+
+    std::vector<long> at(parts + 1, 0);
+    forEachPart(parts, [&](int t) {
+        long lines = 0;
+        for(const char* q = cut[t]; q < cut[t + 1]; q = text.nextLine(q))
+            if(lineValues(q, cut[t + 1]) != nullptr)
+                ++lines;
+        at[t + 1] = lines;
+    });
+    for(int t = 0; t < parts; ++t)
+        at[t + 1] += at[t];
+    if(at[parts] < count)
+    {
+        std::cerr << "error: " << at[parts] << " of " << count << " edges in the file" << std::endl;
+        exit(1);
+    }
+
+    std::vector<char> bad(parts, 0);
+    forEachPart(parts, [&](int t) {
+        long k = at[t];
+        for(const char* q = cut[t]; q < cut[t + 1] && k < count; q = text.nextLine(q))
+        {
+            const char* v = lineValues(q, cut[t + 1]);
+            if(v == nullptr) continue;
+            v = readInt(v, cut[t + 1], first[k]);
+            readInt(v, cut[t + 1], second[k]);
+            if(first[k] >= n || second[k] >= n) bad[t] = 1;
+            ++k;
+        }
+    });
+    for(int t = 0; t < parts; ++t)
+        if(bad[t])
+        {
+            std::cerr << "error: an edge has a vertex outside 0.." << (n - 1) << std::endl;
+            exit(1);
+        }
+}
+
+/*
+    Reads n lines from p on, each a vertex then its neighbours, as CSR: index[v] .. index[v + 1] are
+    the positions in adjacent of the neighbours of the vertex of line v. Exits unless there are n lines
+    and m neighbours, all below n.
+*/
+inline void readAdjacency(const GraphText& text, const char* p, const int& n, const int& m, int* index, int* adjacent)
+{
+    std::vector<const char*> cut = text.split(p);
+    const int parts = cut.size() - 1;
+
+    std::vector<long> lineAt(parts + 1, 0), valueAt(parts + 1, 0);
+    forEachPart(parts, [&](int t) {
+        long lines = 0, values = 0;
+        const char* end = cut[t + 1];
+        for(const char* q = cut[t]; q < end; q = text.nextLine(q))
+        {
+            const char* v = lineValues(q, end);
+            if(v == nullptr) continue;
+            ++lines;
+            // the values of the line, less the vertex itself
+            for(--values; v < end && *v != '\n'; )
+            {
+                if(isDigit(*v))
+                {
+                    ++values;
+                    while(v < end && isDigit(*v)) ++v;
+                }
+                else
+                    ++v;
+            }
+        }
+        lineAt[t + 1] = lines;
+        valueAt[t + 1] = values;
+    });
+    for(int t = 0; t < parts; ++t)
+    {
+        lineAt[t + 1] += lineAt[t];
+        valueAt[t + 1] += valueAt[t];
+    }
+    if(lineAt[parts] != n || valueAt[parts] != m)
+    {
+        std::cerr << "error: expected " << n << " vertices and " << m << " edges, the file has "
+            << lineAt[parts] << " and " << valueAt[parts] << std::endl;
+        exit(1);
+    }
+
+    index[0] = 0;
+    std::vector<char> bad(parts, 0);
+    forEachPart(parts, [&](int t) {
+        long line = lineAt[t], k = valueAt[t];
+        const char* end = cut[t + 1];
+        for(const char* q = cut[t]; q < end; q = text.nextLine(q))
+        {
+            const char* v = lineValues(q, end);
+            if(v == nullptr) continue;
+            while(v < end && isDigit(*v)) ++v; // the vertex
+            while(true)
+            {
+                while(v < end && *v != '\n' && !isDigit(*v)) ++v;
+                if(v == end || *v == '\n') break;
+                v = readInt(v, end, adjacent[k]);
+                if(adjacent[k] >= n) bad[t] = 1;
+                ++k;
+            }
+            index[++line] = k;
+        }
+    });
+    for(int t = 0; t < parts; ++t)
+        if(bad[t])
+        {
+            std::cerr << "error: a neighbour outside 0.." << (n - 1) << std::endl;
+            exit(1);
+        }
+}
+
+/*
+    The edges (key[k], value[k]) grouped by key, as CSR: index[v] .. index[v + 1] are the positions in
+    out of the values of the edges of key v, in the order the edges are given (a stable counting sort).
+    Each thread counts the keys of its stretch of the edges, the counts give every stretch its start
+    in each group, and the threads then place their edges there, so the order is that of one thread.
+    The counts take a row of n per thread, so a graph gets no more threads than it has edges per vertex.
+*/
+inline void groupEdges(const int& n, const int& m, const int* key, const int* value, int* index, int* out)
+{
+    int parts = 1;
+    if(m >= GroupParallelEdges && n > 0)
+        parts = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), m / n));
+    if(parts == 1)
+    {
+        memset(index, 0, (n + 1) * sizeof(int));
+        for(int k = 0; k < m; ++k)
+            ++index[key[k] + 1];
+        for(int v = 0; v < n; ++v)
+            index[v + 1] += index[v];
+        std::vector<int> at(index, index + n);
+        for(int k = 0; k < m; ++k)
+            out[at[key[k]]++] = value[k];
+        return;
+    }
+
+    // count[t * n + v]: the edges of key v in stretch t, then where stretch t places the next of them
+    std::vector<int> count(static_cast<size_t>(parts) * n, 0);
+    auto edgesFrom = [&](const int& t) { return static_cast<int>(static_cast<long>(m) * t / parts); };
+    auto keysFrom = [&](const int& t) { return static_cast<int>(static_cast<long>(n) * t / parts); };
+    forEachPart(parts, [&](int t) {
+        int* c = &count[static_cast<size_t>(t) * n];
+        for(int k = edgesFrom(t); k < edgesFrom(t + 1); ++k)
+            ++c[key[k]];
+    });
+
+    // the edges of each range of keys, then the starts in key order, stretch by stretch within a key
+    std::vector<int> before(parts + 1, 0);
+    forEachPart(parts, [&](int t) {
+        int edges = 0;
+        for(int v = keysFrom(t); v < keysFrom(t + 1); ++v)
+            for(int s = 0; s < parts; ++s)
+                edges += count[static_cast<size_t>(s) * n + v];
+        before[t + 1] = edges;
+    });
+    for(int t = 0; t < parts; ++t)
+        before[t + 1] += before[t];
+    forEachPart(parts, [&](int t) {
+        int at = before[t];
+        for(int v = keysFrom(t); v < keysFrom(t + 1); ++v)
+        {
+            index[v] = at;
+            for(int s = 0; s < parts; ++s)
+            {
+                int& c = count[static_cast<size_t>(s) * n + v];
+                const int edges = c;
+                c = at;
+                at += edges;
+            }
+        }
+    });
+    index[n] = m;
+
+    forEachPart(parts, [&](int t) {
+        int* at = &count[static_cast<size_t>(t) * n];
+        for(int k = edgesFrom(t); k < edgesFrom(t + 1); ++k)
+            out[at[key[k]]++] = value[k];
+    });
+}
+
+/*
+    The position of (x, y) along the Hilbert curve through a 2^levels by 2^levels grid. The turn of the
+    curve within each quadrant is a swap and/or a flip of both coordinates, and as these commute the
+    turns so far are kept as two bits, so that the walk down the levels has no branches.
+*/
+inline long hilbertIndex(const int& levels, const long& x, const long& y)
+{
+    long d = 0, swap = 0, flip = 0;
+    for(int i = levels - 1; i >= 0; --i)
+    {
+        long rx = ((x >> i) & 1) ^ flip;
+        long ry = ((y >> i) & 1) ^ flip;
+        const long t = (rx ^ ry) & swap;
+        rx ^= t;
+        ry ^= t;
+        d = (d << 2) | ((3 * rx) ^ ry);
+        flip ^= rx & (ry ^ 1);
+        swap ^= ry ^ 1;
+    }
+    return d;
+}
+
+/*
+    Puts the edges (first[k], second[k]) in the order of a Hilbert curve through tiles of the adjacency
+    matrix, so that an edge's source and destination are close to those of the edges just before it.
+    The tiles span up to 2^16 vertices each way (the ranks of a tile's rows and columns then stay in
+    the L2 cache); they are few enough, at most 2^16 with 8 edges each on average, for a counting sort
+    to scatter to them without missing the TLB on every edge. The edges are grouped by their tile's
+    position on the curve with groupEdges, in the order they are given within a tile.
+*/
+inline void hilbertOrder(const int& n, const int& m, int* first, int* second)
+{
+    int bits = 0;
+    while((1L << bits) < n)
+        ++bits;
+    int levels = std::max(0, bits - 16);
+    while(levels > 0 && (levels > 8 || (8L << (2 * levels)) > m))
+        --levels;
+    const int shift = std::max(0, bits - levels);
+    const int tiles = 1 << (2 * levels);
+
+    std::vector<int> tile(m);
+    const int parts = m >= GroupParallelEdges ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    forEachPart(parts, [&](int t) {
+        for(int k = static_cast<int>(static_cast<long>(m) * t / parts); k < static_cast<long>(m) * (t + 1) / parts; ++k)
+            tile[k] = static_cast<int>(hilbertIndex(levels, first[k] >> shift, second[k] >> shift));
+    });
+
+    // grouped by the same keys, both ends of each edge land in the same place
+    std::vector<int> index(tiles + 1), grouped(m);
+    groupEdges(tiles, m, tile.data(), first, index.data(), grouped.data());
+    memcpy(first, grouped.data(), m * sizeof(int));
+    groupEdges(tiles, m, tile.data(), second, index.data(), grouped.data());
+    memcpy(second, grouped.data(), m * sizeof(int));
+}
+
+/*
+    A binary snapshot of a graph in CSR (or CSC): the index, the adjacent vertices and the out degrees
+    (and the order of a renumbered graph), cached next to the text file as file.csr.bin (or file.csc.bin,
+    file.csc.rcm.bin, ...). Later runs map it in place of parsing, as long as it records the size and
+    modification time of the file it was made from; the mapping is shared and read only, so concurrent
+    runs on the same graph share its pages.
+        GraphCache cache;
+        if(!cache.load(file, "csr", numVertices, numEdges, index, dest, outdegree))
+            ... parse, then GraphCache::save(file, "csr", numVertices, numEdges, index, dest, outdegree);
+*/
+class GraphCache
+{
+public:
+    GraphCache() :base(nullptr), bytes(0) {}
+
+    ~GraphCache()
+    {
+#if defined(_WIN32)
+        delete[] static_cast<char*>(base);
+#else
+        if(base != nullptr)
+            munmap(base, bytes);
+#endif
+    }
+
+    GraphCache(const GraphCache&) = delete;
+    GraphCache& operator=(const GraphCache&) = delete;
+
+    /* maps the cache of file, pointing the arrays into it (and *order, if given); false if there is no valid cache */
+    bool load(const std::string& file, const std::string& format, int& n, int& m, const int*& index, const int*& adjacent, const int*& outdeg,
+        const int** order = nullptr)
+    {
+        int64_t size, mtime;
+        if(!fileStamp(file, size, mtime))
+            return false;
+        size_t length = 0;
+#if defined(_WIN32)
+        void* p = readWhole(cacheName(file, format), length);
+        if(p == nullptr || length < sizeof(Header))
+        {
+            delete[] static_cast<char*>(p);
+            return false;
+        }
+#else
+        int fd = open(cacheName(file, format).c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header))
+        {
+            length = st.st_size;
+            p = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if(p == MAP_FAILED)
+            return false;
+#endif
+
+        const Header* h = static_cast<const Header*>(p);
+        size_t adjacentAt, outdegAt, orderAt;
+        if(memcmp(h->magic, magic(), sizeof(h->magic)) != 0 || h->size != size
+            || h->mtime != mtime || h->n < 0 || h->m < 0 || h->ordered != (order != nullptr)
+            || layout(h->n, h->m, h->ordered, adjacentAt, outdegAt, orderAt) != length)
+        {
+#if defined(_WIN32)
+            delete[] static_cast<char*>(p);
+#else
+            munmap(p, length);
+#endif
+            return false;
+        }
+
+        base = p;
+        bytes = length;
+        const char* data = static_cast<const char*>(p);
+        n = h->n;
+        m = h->m;
+        index = reinterpret_cast<const int*>(data + align(sizeof(Header)));
+        adjacent = reinterpret_cast<const int*>(data + adjacentAt);
+        outdeg = reinterpret_cast<const int*>(data + outdegAt);
+        if(order != nullptr)
+            *order = reinterpret_cast<const int*>(data + orderAt);
+        return true;
+    }
+
+    /* faults in the arrays mapped from the cache (if they are), so that the first reads of them do not */
+    void populate() const
+    {
+#if !defined(_WIN32)
+        if(base == nullptr)
+            return;
+#if defined(MADV_POPULATE_READ)
+        if(madvise(base, bytes, MADV_POPULATE_READ) == 0)
+            return;
+#endif
+        madvise(base, bytes, MADV_WILLNEED);
+        const size_t page = sysconf(_SC_PAGESIZE);
+        for(size_t at = 0; at < bytes; at += page)
+            (void)static_cast<const volatile char*>(base)[at];
+#endif
+    }
+
+    /* writes the cache of file; a cache that cannot be written is only a slower next run */
+    static void save(const std::string& file, const std::string& format, const int& n, const int& m, const int* index, const int* adjacent, const int* outdeg,
+        const int* order = nullptr)
+    {
+        int64_t size, mtime;
+        if(!fileStamp(file, size, mtime))
+            return;
+        size_t adjacentAt, outdegAt, orderAt;
+        std::vector<char> data(layout(n, m, order != nullptr, adjacentAt, outdegAt, orderAt), 0);
+        Header* h = reinterpret_cast<Header*>(data.data());
+        memcpy(h->magic, magic(), sizeof(h->magic));
+        h->n = n;
+        h->m = m;
+        h->size = size;
+        h->mtime = mtime;
+        h->ordered = (order != nullptr);
+        memcpy(data.data() + align(sizeof(Header)), index, (n + 1) * sizeof(int));
+        memcpy(data.data() + adjacentAt, adjacent, m * sizeof(int));
+        memcpy(data.data() + outdegAt, outdeg, n * sizeof(int));
+        if(order != nullptr)
+            memcpy(data.data() + orderAt, order, n * sizeof(int));
+
+        // written under another name and renamed, so a run never maps a partly written cache
+        std::string cache = cacheName(file, format), tmp = cache + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "wb");
+        if(f == nullptr)
+            return;
+        bool written = fwrite(data.data(), 1, data.size(), f) == data.size();
+        if(fclose(f) == 0 && written)
+        {
+#if defined(_WIN32)
+            remove(cache.c_str());      // rename does not replace a file there
+#endif
+            rename(tmp.c_str(), cache.c_str());
+        }
+        else
+            remove(tmp.c_str());
+    }
+
+private:
+    struct Header
+    {
+        char magic[8];
+        int32_t n, m;
+        int64_t size, mtime;    // of the text file
+        int32_t ordered;        // whether the order follows
+        int32_t reserved;
+    };
+
+    static const char* magic() { return "MSGRF02"; }
+
+    static std::string cacheName(const std::string& file, const std::string& format) { return file + "." + format + ".bin"; }
+
+    static size_t align(const size_t& b) { return (b + 63) / 64 * 64; }
+
+    // the header, then index[n + 1], adjacent[m], outdeg[n] and (if ordered) order[n], each on a cache line
+    static size_t layout(const int& n, const int& m, const bool& ordered, size_t& adjacentAt, size_t& outdegAt, size_t& orderAt)
+    {
+        adjacentAt = align(sizeof(Header)) + align((n + 1) * sizeof(int));
+        outdegAt = adjacentAt + align(static_cast<size_t>(m) * sizeof(int));
+        orderAt = outdegAt + align(n * sizeof(int));
+        return orderAt + (ordered ? align(n * sizeof(int)) : 0);
+    }
+
+    void* base;
+    size_t bytes;
+};
+
+/* the out degrees of the vertices of a graph in CSR: the lengths of its rows */
+inline int* rowDegrees(const int& n, const int* index)
+{
+    int* deg = new int[n];
+    for(int v = 0; v < n; ++v)
+        deg[v] = index[v + 1] - index[v];
+    return deg;
+}
+
+/* the out degrees of the vertices of a graph in CSC: how often each is a source */
+inline int* sourceDegrees(const int& n, const int& m, const int* source)
+{
+    int* deg = new int[n]();
+    for(int k = 0; k < m; ++k)
+        ++deg[source[k]];
+    return deg;
+}
+
+/*
+    The edges (src[k], dst[k]) as CSC: index[v] .. index[v + 1] are the positions in source of the
+    sources of the edges into v, in increasing order (grouped by source, then stably by destination),
+    so a column is summed in the same order as the edges are visited in CSR and sorted COO.
+*/
+inline void groupColumns(const int& n, const int& m, const int* src, const int* dst, int* index, int* source)
+{
+    int* bySource = new int[n + 1];
+    int* srcSorted = new int[m];
+    int* dstSorted = new int[m];
+    groupEdges(n, m, src, dst, bySource, dstSorted);
+    const int parts = m >= GroupParallelEdges ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    forEachPart(parts, [&](int t) {
+        for(int v = static_cast<int>(static_cast<long>(n) * t / parts); v < static_cast<long>(n) * (t + 1) / parts; ++v)
+            for(int k = bySource[v]; k < bySource[v + 1]; ++k)
+                srcSorted[k] = v;
+    });
+    groupEdges(n, m, dstSorted, srcSorted, index, source);
+
+    delete[] bySource;
+    delete[] srcSorted;
+    delete[] dstSorted;
+}
+
+/*
+    Renumberings of a graph for the locality of PageRank: order[k] is the old number of the vertex
+    numbered k, and the ranks are computed in the new numbering and put back in the old one for output.
+        degree: by degree (in plus out), largest first, so the ranks that are read most share lines.
+        hub:    the vertices of more than the average degree first, then the rest, each in the old order
+                (hub clustering: the hubs are packed without scattering the rest of the graph).
+        rcm:    reverse Cuthill-McKee on the graph without directions, which keeps the neighbours of a
+                vertex close to it in number.
+        gorder: a greedy Gorder, window 5: the next vertex is the one with the most edges to, and
+                shared sources with, the last 5 placed; hubs of out degree over sqrt(n) do not count
+                as shared sources (they share everything), which bounds the work as in the paper.
+*/
+enum GraphOrder { ORDER_NONE, ORDER_DEGREE, ORDER_HUB, ORDER_RCM, ORDER_GORDER };
+
+inline const char* graphOrderName(const GraphOrder& ordering)
+{
+    static const char* const names[] = {"none", "degree", "hub", "rcm", "gorder"};
+    return names[ordering];
+}
+
+/* the ordering called name, as graphOrderName gives it; false if there is none */
+inline bool parseGraphOrder(const std::string& name, GraphOrder& ordering)
+{
+    for(int o = ORDER_NONE; o <= ORDER_GORDER; ++o)
+        if(name.compare(graphOrderName(static_cast<GraphOrder>(o))) == 0)
+        {
+            ordering = static_cast<GraphOrder>(o);
+            return true;
+        }
+    return false;
+}
+
+namespace reorder
+{
+    /* the other direction of the graph with rows index and adjacent: the row of v lists the rows v is in */
+    inline void transpose(const int& n, const int& m, const int* index, const int* adjacent, std::vector<int>& tIndex, std::vector<int>& tAdjacent)
+    {
+        std::vector<int> row(m);
+        for(int v = 0; v < n; ++v)
+            for(int j = index[v]; j < index[v + 1]; ++j)
+                row[j] = v;
+        tIndex.resize(n + 1);
+        tAdjacent.resize(m);
+        groupEdges(n, m, adjacent, row.data(), tIndex.data(), tAdjacent.data());
+    }
+
+    /* the vertices by degree, largest first, equal degrees in the old order */
+    inline std::vector<int> byDegree(const int& n, const std::vector<int>& degree)
+    {
+        std::vector<int> order(n);
+        for(int v = 0; v < n; ++v)
+            order[v] = v;
+        std::stable_sort(order.begin(), order.end(), [&degree](const int& a, const int& b) { return degree[a] > degree[b]; });
+        return order;
+    }
+
+    inline std::vector<int> hubs(const int& n, const int& m, const std::vector<int>& degree)
+    {
+        std::vector<int> order;
+        order.reserve(n);
+        const double average = 2.0 * m / std::max(n, 1);
+        for(int v = 0; v < n; ++v)
+            if(degree[v] > average) order.push_back(v);
+        for(int v = 0; v < n; ++v)
+            if(degree[v] <= average) order.push_back(v);
+        return order;
+    }
+
+    /*
+        Reverse Cuthill-McKee over the neighbours (out, then in) of each vertex. Each component is
+        started from a pseudo-peripheral vertex: the smallest degree vertex of the last level of a
+        breadth first search from its smallest degree vertex.
+    */
+    inline std::vector<int> rcm(const int& n, const int* out, const int* outAdj, const int* in, const int* inAdj, const std::vector<int>& degree)
+    {
+        std::vector<int> order;
+        order.reserve(n);
+        std::vector<int> level(n, -1), queue, next;
+        auto neighbours = [&](const int& v, std::vector<int>& found) {
+            found.clear();
+            for(int j = out[v]; j < out[v + 1]; ++j) found.push_back(outAdj[j]);
+            for(int j = in[v]; j < in[v + 1]; ++j) found.push_back(inAdj[j]);
+        };
+        // breadth first search from root, into queue, the last level from lastLevel on; returns the number of levels
+        size_t lastLevel = 0;
+        auto search = [&](const int& root) {
+            queue.assign(1, root);
+            level[root] = 0;
+            lastLevel = 0;
+            for(size_t h = 0; h < queue.size(); ++h)
+            {
+                neighbours(queue[h], next);
+                for(const int& u : next)
+                    if(level[u] < 0)
+                    {
+                        level[u] = level[queue[h]] + 1;
+                        if(level[u] > level[queue[lastLevel]])
+                            lastLevel = queue.size();
+                        queue.push_back(u);
+                    }
+            }
+            const int levels = level[queue.back()] + 1;
+            for(const int& v : queue)
+                level[v] = -1;
+            return levels;
+        };
+
+        std::vector<char> placed(n, 0);
+        const std::vector<int> starts = byDegree(n, degree);
+        for(int s = n - 1; s >= 0; --s)
+        {
+            int root = starts[s]; // the smallest degree vertex not yet placed
+            if(placed[root])
+                continue;
+            // move the root to the far end of the component while that makes the search deeper
+            int levels = search(root);
+            for(int tries = 0; tries < 4; ++tries)
+            {
+                int candidate = queue[lastLevel];
+                for(size_t h = lastLevel + 1; h < queue.size(); ++h)
+                    if(degree[queue[h]] < degree[candidate])
+                        candidate = queue[h];
+                const int deeper = search(candidate);
+                if(deeper <= levels)
+                    break;
+                root = candidate;
+                levels = deeper;
+            }
+
+            // Cuthill-McKee from root: each vertex's unplaced neighbours, smallest degree first
+            const size_t first = order.size();
+            order.push_back(root);
+            placed[root] = 1;
+            for(size_t h = first; h < order.size(); ++h)
+            {
+                neighbours(order[h], next);
+                std::sort(next.begin(), next.end());
+                next.erase(std::unique(next.begin(), next.end()), next.end());
+                std::stable_sort(next.begin(), next.end(), [&degree](const int& a, const int& b) { return degree[a] < degree[b]; });
+                for(const int& u : next)
+                    if(!placed[u])
+                    {
+                        placed[u] = 1;
+                        order.push_back(u);
+                    }
+            }
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    /*
+        The unplaced vertices by score, for gorder: a list of vertices per score, so a score moves by one
+        and the largest is found in constant time. A vertex enters its list at the front; the vertices
+        start in the list of 0 smallest degree first, so with nothing scored the largest degree comes next.
+    */
+    class UnitHeap
+    {
+    public:
+        UnitHeap(const int& n, const std::vector<int>& byDegree) :key(n, 0), prev(n, -1), next(n, -1), head(1, -1), top(0)
+        {
+            for(int k = n - 1; k >= 0; --k)
+                insert(byDegree[k]);
+        }
+
+        void increment(const int& v)
+        {
+            if(key[v] < 0) return; // placed
+            remove(v);
+            if(++key[v] == static_cast<int>(head.size()))
+                head.push_back(-1);
+            insert(v);
+        }
+
+        void decrement(const int& v)
+        {
+            if(key[v] <= 0) return; // placed, or never scored
+            remove(v);
+            --key[v];
+            insert(v);
+        }
+
+        /* removes and returns the vertex of the largest score */
+        int pop()
+        {
+            while(head[top] < 0) --top;
+            const int v = head[top];
+            remove(v);
+            key[v] = -1;
+            return v;
+        }
+
+    private:
+        void insert(const int& v)
+        {
+            prev[v] = -1;
+            next[v] = head[key[v]];
+            if(next[v] >= 0) prev[next[v]] = v;
+            head[key[v]] = v;
+            top = std::max(top, key[v]);
+        }
+
+        void remove(const int& v)
+        {
+            if(prev[v] >= 0) next[prev[v]] = next[v];
+            else head[key[v]] = next[v];
+            if(next[v] >= 0) prev[next[v]] = prev[v];
+        }
+
+        std::vector<int> key, prev, next, head;
+        int top;
+    };
+
+    /* greedy Gorder over the out rows (out, outAdj) and in rows (in, inAdj) of the graph */
+    inline std::vector<int> gorder(const int& n, const int* out, const int* outAdj, const int* in, const int* inAdj, const std::vector<int>& degree)
+    {
+        const int window = 5;
+        const int hub = static_cast<int>(std::sqrt(static_cast<double>(n)));
+        const std::vector<int> starts = byDegree(n, degree);
+        UnitHeap heap(n, starts);
+
+        // the score of u against the window is its edges to and from it, and the sources it shares with it
+        auto score = [&](const int& v, const bool& add) {
+            auto update = [&](const int& u) { if(add) heap.increment(u); else heap.decrement(u); };
+            for(int j = out[v]; j < out[v + 1]; ++j) update(outAdj[j]);
+            for(int j = in[v]; j < in[v + 1]; ++j)
+            {
+                const int w = inAdj[j];
+                update(w);
+                if(out[w + 1] - out[w] <= hub)
+                    for(int k = out[w]; k < out[w + 1]; ++k)
+                        if(outAdj[k] != v) update(outAdj[k]);
+            }
+        };
+
+        std::vector<int> order;
+        order.reserve(n);
+        for(int k = 0; k < n; ++k)
+        {
+            const int v = heap.pop();
+            order.push_back(v);
+            score(v, true);
+            if(k >= window)
+                score(order[k - window], false);
+        }
+        return order;
+    }
+}
+
+/*
+    The order (see GraphOrder) of the graph of n vertices and m edges in index and adjacent: its rows
+    are the destinations of each source (CSR) or, if columns, the sources of each destination (CSC).
+*/
+inline std::vector<int> makeGraphOrder(const GraphOrder& ordering, const bool& columns, const int& n, const int& m, const int* index, const int* adjacent)
+{
+    std::vector<int> tIndex, tAdjacent;
+    reorder::transpose(n, m, index, adjacent, tIndex, tAdjacent);
+    const int* out = columns ? tIndex.data() : index;
+    const int* outAdj = columns ? tAdjacent.data() : adjacent;
+    const int* in = columns ? index : tIndex.data();
+    const int* inAdj = columns ? adjacent : tAdjacent.data();
+
+    std::vector<int> degree(n);
+    for(int v = 0; v < n; ++v)
+        degree[v] = (out[v + 1] - out[v]) + (in[v + 1] - in[v]);
+
+    switch(ordering)
+    {
+    case ORDER_DEGREE: return reorder::byDegree(n, degree);
+    case ORDER_HUB: return reorder::hubs(n, m, degree);
+    case ORDER_RCM: return reorder::rcm(n, out, outAdj, in, inAdj, degree);
+    case ORDER_GORDER: return reorder::gorder(n, out, outAdj, in, inAdj, degree);
+    default: break;
+    }
+    std::vector<int> order(n);
+    for(int v = 0; v < n; ++v)
+        order[v] = v;
+    return order;
+}
+
+/*
+    Renumbers the graph (index, adjacent, outdeg) by order into new arrays: row k is the old row
+    order[k], its vertices renumbered and in increasing order, so rows are still summed by source.
+*/
+inline void relabelGraph(const int& n, const int& m, const int* order, const int* index, const int* adjacent, const int* outdeg,
+    int* newIndex, int* newAdjacent, int* newOutdeg)
+{
+    std::vector<int> number(n);
+    for(int k = 0; k < n; ++k)
+        number[order[k]] = k;
+    newIndex[0] = 0;
+    for(int k = 0; k < n; ++k)
+    {
+        const int v = order[k];
+        newIndex[k + 1] = newIndex[k] + (index[v + 1] - index[v]);
+        int* row = newAdjacent + newIndex[k];
+        for(int j = index[v]; j < index[v + 1]; ++j)
+            row[j - index[v]] = number[adjacent[j]];
+        std::sort(row, newAdjacent + newIndex[k + 1]);
+        newOutdeg[k] = outdeg[order[k]];
+    }
+}
@@ -2,13 +2,17 @@
 #include <iomanip>
 #include <chrono>
 
-#include <fstream>
 #include <string>
-#include <regex>
 #include <cmath>
+#include <thread>
 
 #include "../../../manseglib.hpp"
-#include "quicksort.h"
+#include "../../../manseglib_expr.hpp"
+#include "../../../manseglib_controller.hpp"
+#include "../../../manseglib_trace.hpp"
+#include "../../../manseglib_results.hpp"
+#include "../../../manseglib_pages.hpp"
+#include "graph_loader.h"
 
 using namespace std;
 using namespace ManSeg;
@@ -21,6 +25,17 @@ constexpr int maxIter = 100;
 
 enum MatrixType {COO, CSR, CSC, SNAP_COO, SNAP_CSR, SNAP_CSC};
 
+/*
+    $MANSEG_HILBERT_COO=1: the COO formats are put in the order of a Hilbert curve through the matrix
+    once they are read (see hilbertOrder), so that each sweep reads and writes ranks that are close
+    together rather than wherever the file's next edge points.
+*/
+bool hilbertCoo()
+{
+    const char* order = getenv("MANSEG_HILBERT_COO");
+    return order != nullptr && atoi(order) != 0;
+}
+
 template<int matrixType>
 class SparseMatrix;
 
@@ -30,26 +45,17 @@ class SparseMatrix<COO>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
-        {
-            cerr << "error opening file in COO" << endl;
-            exit(1);
-        }
-        string line;
-        getline(f, line);
-
-        f >> numVertices;
-        f >> numEdges;
+        GraphText text(file, "COO");
+        const char* p = text.skipLines(text.begin(), 1);
+        p = readInt(p, text.end(), numVertices);
+        p = readInt(p, text.end(), numEdges);
 
         source = new int[numEdges];
         destination = new int[numEdges];
 
-        for(int i = 0; i < numEdges; ++i)
-            f >> source[i] >> destination[i];
-
-        f.close();
+        readEdges(text, text.nextLine(p), numEdges, numVertices, source, destination);
+        if(hilbertCoo())
+            hilbertOrder(numVertices, numEdges, source, destination);
     }
 
     void calculateOutDegree(int outdeg[])
@@ -58,8 +64,12 @@ public:
             ++outdeg[source[i]];
     }
 
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
+    /*
+        One PageRank sweep, reading prevPr and writing newPr at any pair of levels
+        (heads/heads, heads/full for the interim step, full/full; see ManSeg::LevelView).
+    */
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
         int src, dest;
         for(int i = 0; i < numEdges; ++i)
@@ -70,29 +80,6 @@ public:
         }
     }
 
-    void iterate(double d, double* _prevPr, double* _newPr, int outdeg[], double* contr)
-    {    
-        int src, dest;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            src = source[i];
-            dest = destination[i];
-            _newPr[dest] += d*(_prevPr[src]/outdeg[src]);
-        }
-    }
-
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        int src, dest;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            src = source[i];
-            dest = destination[i];
-            double val = d*(prevPr[src]/outdeg[src]);
-            newPr[dest] += val;
-        }
-    }
-
     int numVertices;
     int numEdges;
 private:
@@ -106,100 +93,51 @@ class SparseMatrix<CSR>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
-        {
-            cerr << "error opening file in CSR" << endl;
-            exit(1);
-        }
-
-        string line;
-        getline(f, line);
-
-        f >> numVertices;
-        f >> numEdges;
-
-        index = new int[numVertices + 1];
-        dest = new int[numEdges];
-
-        index[0] = 0;
-        int pos = 0;
-
-        getline(f, line);
-        for(int i = 0; i < numVertices; ++i)
-        {
-            getline(f, line);
-            istringstream iss(line);
-            vector<string> results(istream_iterator<string>{iss}, istream_iterator<string>());
+        if(cache.load(file, "csr", numVertices, numEdges, index, dest, outdegree))
+            return;
 
-            pos += (results.size() - 1);
-            index[i + 1] = pos;
+        GraphText text(file, "CSR");
+        const char* p = text.skipLines(text.begin(), 1);
+        p = readInt(p, text.end(), numVertices);
+        p = readInt(p, text.end(), numEdges);
 
-            for(int j = 1; j < results.size(); ++j)
-                dest[index[i] + (j - 1)] = stoi(results[j]);
-        }
+        int* idx = new int[numVertices + 1];
+        int* adj = new int[numEdges];
+        readAdjacency(text, text.nextLine(p), numVertices, numEdges, idx, adj);
 
-        f.close();
+        index = idx;
+        dest = adj;
+        outdegree = rowDegrees(numVertices, index);
+        GraphCache::save(file, "csr", numVertices, numEdges, index, dest, outdegree);
     }
 
     void calculateOutDegree(int outdeg[])
     {
-        for(int i = 0; i < numVertices; ++i)
-            outdeg[i] = (index[i + 1] - index[i]);
+        memcpy(outdeg, outdegree, numVertices * sizeof(int));
     }
 
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
+        // the contribution of a vertex is only needed for its own row, so it is computed there
+        // rather than in a pass of its own through contr
         int curr, next;
         for(int i = 0; i < numVertices; ++i)
         {
             curr = index[i];
             next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
-        }
-    }
-
-    void iterate(double d, double* prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
-        }
-    }
-
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
+            // newPr[dest[j]] += d*(prevPr[i]/outdeg[i]) for each out-edge, gathering/scattering the heads
+            scatterAdd(newPr, dest + curr, next - curr, d*(prevPr[i]/outdeg[i]));
         }
     }
 
     int numVertices;
     int numEdges;
 private:
-    int* index;
-    int* dest;
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* dest;
+    const int* outdegree;
 };
 
 template<>
@@ -208,51 +146,31 @@ class SparseMatrix<CSC>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
-        {
-            cerr << "error opening file in CSC" << endl;
-            exit(1);
-        }
-
-        string line;
-        getline(f, line);
-
-        f >> numVertices;
-        f >> numEdges;
+        if(cache.load(file, "csc", numVertices, numEdges, index, source, outdegree))
+            return;
 
-        index = new int[numVertices + 1];
-        source = new int[numEdges];
-
-        index[0] = 0;
-        int pos = 0;
-
-        getline(f, line);
-        for(int i = 0; i < numVertices; ++i)
-        {
-            getline(f, line);
-            istringstream iss(line);
-            vector<string> results(istream_iterator<string>{iss}, istream_iterator<string>());
+        GraphText text(file, "CSC");
+        const char* p = text.skipLines(text.begin(), 1);
+        p = readInt(p, text.end(), numVertices);
+        p = readInt(p, text.end(), numEdges);
 
-            pos += (results.size() - 1);
-            index[i + 1] = pos;
+        int* idx = new int[numVertices + 1];
+        int* adj = new int[numEdges];
+        readAdjacency(text, text.nextLine(p), numVertices, numEdges, idx, adj);
 
-            for(int j = 1; j < results.size(); ++j)
-                source[index[i] + (j - 1)] = stoi(results[j]);
-        }
-
-        f.close();
+        index = idx;
+        source = adj;
+        outdegree = sourceDegrees(numVertices, numEdges, source);
+        GraphCache::save(file, "csc", numVertices, numEdges, index, source, outdegree);
     }
 
     void calculateOutDegree(int outdeg[])
     {
-        for(int i = 0; i < numEdges; ++i)
-            ++outdeg[source[i]];
+        memcpy(outdeg, outdegree, numVertices * sizeof(int));
     }
 
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
         for(int i = 0; i < numVertices; ++i)
         contr[i] = d*(prevPr[i]/outdeg[i]);
@@ -267,41 +185,13 @@ public:
         }
     }
 
-    void iterate(double d, double* prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[i] += contr[source[j]];
-        }
-    }
-
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[i] += contr[source[j]];
-        }
-    }
-
     int numVertices;
     int numEdges;
 private:
-    int* index;
-    int* source;
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* source;
+    const int* outdegree;
 };
 
 
@@ -316,25 +206,12 @@ class SparseMatrix<SNAP_COO>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
-        {
-            cerr << "error opening file in COO" << endl;
-            exit(1);
-        }
-        
-        string skipLine, nodes, edges;
-        getline(f, skipLine); // skip first line
-
-        f >> nodes >> edges;
-        getline(f, skipLine); // skip next descriptor
-
-        string n = regex_replace(nodes, regex("[^0-9]*([0-9]+).*"), "$1");
-        numVertices = atoi(n.c_str());
-        
-        n = regex_replace(edges, regex("[^0-9]*([0-9]+).*"), "$1");
-        numEdges = atoi(n.c_str());
+        GraphText text(file, "COO");
+        const char* p = text.skipLines(text.begin(), 1); // skip first line
+        // the first two numbers of the next descriptor, e.g. "# Nodes: 4 Edges: 5"
+        const char* end = text.nextLine(p);
+        p = readInt(p, end, numVertices);
+        p = readInt(p, end, numEdges);
 
         cout << "numVertices=" << numVertices << "\n";
         cout << "numEdges=" << numEdges << "\n";
@@ -342,12 +219,10 @@ public:
         source = new int[numEdges];
         destination = new int[numEdges];
 
-        getline(f, skipLine); // skip next descriptor
-
-        for(int i = 0; i < numEdges; ++i)
-            f >> source[i] >> destination[i];
-
-        f.close();
+        // (the descriptor lines after it are skipped as they do not start with a number)
+        readEdges(text, end, numEdges, numVertices, source, destination);
+        if(hilbertCoo())
+            hilbertOrder(numVertices, numEdges, source, destination);
     }
 
     void calculateOutDegree(int outdeg[])
@@ -356,8 +231,8 @@ public:
             ++outdeg[source[i]];
     }
 
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
         int src, dest;
         for(int i = 0; i < numEdges; ++i)
@@ -368,29 +243,6 @@ public:
         }
     }
 
-    void iterate(double d, double* _prevPr, double* _newPr, int outdeg[], double* contr)
-    {    
-        int src, dest;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            src = source[i];
-            dest = destination[i];
-            _newPr[dest] += d*(_prevPr[src]/outdeg[src]);
-        }
-    }
-
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        int src, dest;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            src = source[i];
-            dest = destination[i];
-            double val = d*(prevPr[src]/outdeg[src]);
-            newPr[dest] += val;
-        }
-    }
-
     int numVertices;
     int numEdges;
 private:
@@ -404,112 +256,61 @@ class SparseMatrix<SNAP_CSR>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
+        if(!cache.load(file, "csr", numVertices, numEdges, index, dest, outdegree))
         {
-            cerr << "error opening file in CSR" << endl;
-            exit(1);
-        }
+            GraphText text(file, "CSR");
+            const char* p = text.skipLines(text.begin(), 1); // skip first line
+            const char* end = text.nextLine(p);
+            p = readInt(p, end, numVertices);
+            p = readInt(p, end, numEdges);
 
-       string line, nodes, edges;
-        getline(f, line); // skip first line
+            // read in edges as COO, then group them by source (keeping the file's order within a source)
+            int* src = new int[numEdges];
+            int* dst = new int[numEdges];
+            readEdges(text, end, numEdges, numVertices, src, dst);
+            int* idx = new int[numVertices + 1];
+            int* adj = new int[numEdges];
+            groupEdges(numVertices, numEdges, src, dst, idx, adj);
+            delete[] src;
+            delete[] dst;
 
-        f >> nodes >> edges;
-        getline(f, line); 
-
-        string n = regex_replace(nodes, regex("[^0-9]*([0-9]+).*"), "$1");
-        numVertices = atoi(n.c_str());
-        
-        n = regex_replace(edges, regex("[^0-9]*([0-9]+).*"), "$1");
-        numEdges = atoi(n.c_str());
+            index = idx;
+            dest = adj;
+            outdegree = rowDegrees(numVertices, index);
+            GraphCache::save(file, "csr", numVertices, numEdges, index, dest, outdegree);
+        }
 
         cout << "numVertices=" << numVertices << "\n";
         cout << "numEdges=" << numEdges << "\n";
-
-        index = new int[numVertices + 1];
-        dest = new int[numEdges];
-
-        index[0] = 0; // first index
-
-        int indexPos = 0;
-        int edgeCounter = 0;
-        int s; // hold source for comparison
-
-        getline(f, line); // skip next descriptor
-        for(int i = 0; i < numEdges; ++i)
-        {
-            f >> s >> dest[i];
-
-            while(indexPos < s)
-                index[++indexPos] = (edgeCounter);
-
-            ++edgeCounter;
-        }
-
-        while(indexPos < (numVertices + 1))
-            index[++indexPos] = numEdges;
-
-        f.close();
     }
 
     void calculateOutDegree(int outdeg[])
     {
-        for(int i = 0; i < numVertices; ++i)
-            outdeg[i] = (index[i + 1] - index[i]);
+        memcpy(outdeg, outdegree, numVertices * sizeof(int));
     }
 
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
+        // the contribution of a vertex is only needed for its own row, so it is computed there
+        // rather than in a pass of its own through contr
         int curr, next;
         for(int i = 0; i < numVertices; ++i)
         {
             curr = index[i];
             next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
-        }
-    }
-
-    void iterate(double d, double* prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
-        }
-    }
-
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[dest[j]] += contr[i];
+            // newPr[dest[j]] += d*(prevPr[i]/outdeg[i]) for each out-edge, gathering/scattering the heads
+            scatterAdd(newPr, dest + curr, next - curr, d*(prevPr[i]/outdeg[i]));
         }
     }
 
     int numVertices;
     int numEdges;
 private:
-    int* index;
-    int* dest;
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* dest;
+    const int* outdegree;
 };
 
 template<>
@@ -518,108 +319,45 @@ class SparseMatrix<SNAP_CSC>
 public:
     SparseMatrix(string file)
     {
-        ifstream f;
-        f.open(file, std::ios_base::in);
-        if(!f.is_open())
+        if(!cache.load(file, "csc", numVertices, numEdges, index, source, outdegree))
         {
-            cerr << "error opening file in CSR" << endl;
-            exit(1);
-        }
+            GraphText text(file, "CSC");
+            const char* p = text.skipLines(text.begin(), 1); // skip first line
+            const char* end = text.nextLine(p);
+            p = readInt(p, end, numVertices);
+            p = readInt(p, end, numEdges);
 
-       string line, nodes, edges;
-        getline(f, line); // skip first line
+            // read in edges as COO
+            int* src = new int[numEdges];
+            int* dst = new int[numEdges];
+            readEdges(text, end, numEdges, numVertices, src, dst);
 
-        f >> nodes >> edges;
-        getline(f, line);
+            // grouped so each column's sources are in increasing order: the same order of additions
+            // as with CSR/COO, otherwise deltas/pagerank values end up being off due to error
+            int* idx = new int[numVertices + 1];
+            int* adj = new int[numEdges];
+            groupColumns(numVertices, numEdges, src, dst, idx, adj);
 
-        string n = regex_replace(nodes, regex("[^0-9]*([0-9]+).*"), "$1");
-        numVertices = atoi(n.c_str());
-        
-        n = regex_replace(edges, regex("[^0-9]*([0-9]+).*"), "$1");
-        numEdges = atoi(n.c_str());
-
-        cout << "numVertices=" << numVertices << "\n";
-        cout << "numEdges=" << numEdges << "\n";
-
-        index = new int[numVertices + 1];
-        // source = new int[numEdges];
-
-        getline(f, line);  // skip next line
-
-        // read in edges as COO
-        int* src = new int[numEdges];
-        int* dst = new int[numEdges];
-
-        for(int i = 0; i < numEdges; ++i)
-            f >> src[i] >> dst[i];
-
-        // perform sort on dst, so we can create a CSC representation
-        quicksort_pair(src, dst, 0, (numEdges-1));
+            delete[] src;
+            delete[] dst;
 
-        index[0] = 0; // first index
-        int indexPos = 0;
-        int edgeCounter = 0;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            while(indexPos < dst[i])
-                index[++indexPos] = (edgeCounter);
-            ++edgeCounter;
+            index = idx;
+            source = adj;
+            outdegree = sourceDegrees(numVertices, numEdges, source);
+            GraphCache::save(file, "csc", numVertices, numEdges, index, source, outdegree);
         }
 
-        while(indexPos < (numVertices + 1))
-            index[++indexPos] = numEdges;
-
-        source = src;
-
-        // not super pretty but we need this for the same ordering as
-        // you would get with CSR/COO, otherwise deltas/pagerank values
-        // end up being off due to error
-        for(int i = 0; i < (numVertices); ++i)
-            quicksort(source, index[i], index[i+1]-1);
-
-        f.close();
-
-        delete[] dst;
+        cout << "numVertices=" << numVertices << "\n";
+        cout << "numEdges=" << numEdges << "\n";
     }
 
     void calculateOutDegree(int outdeg[])
     {
-        for(int i = 0; i < numEdges; ++i)
-            ++outdeg[source[i]];
-    }
-
-    template<class TwoSegArray>
-    void iterate(double d, TwoSegArray& prevPr, TwoSegArray& newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[i] += contr[source[j]];
-        }
-    }
-
-    void iterate(double d, double* prevPr, double* newPr, int outdeg[], double* contr)
-    {
-        for(int i = 0; i < numVertices; ++i)
-            contr[i] = d*(prevPr[i]/outdeg[i]);
-
-        int curr, next;
-        for(int i = 0; i < numVertices; ++i)
-        {
-            curr = index[i];
-            next = index[i + 1];
-            for(int j = curr; j < next; ++j)
-                newPr[i] += contr[source[j]];
-        }
+        memcpy(outdeg, outdegree, numVertices * sizeof(int));
     }
 
-    void iterate_fullSet(double d, TwoSegArray<false>& prevPr, double* newPr, int outdeg[], double* contr)
+    template<class ReadView, class WriteView>
+    void iterate(double d, ReadView prevPr, WriteView newPr, int outdeg[], double* contr)
     {
         for(int i = 0; i < numVertices; ++i)
             contr[i] = d*(prevPr[i]/outdeg[i]);
@@ -638,94 +376,133 @@ public:
     int numEdges;
 
 private:
-    int* index;
-    int* source;
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* source;
+    const int* outdegree;
 };
 
 template<class TwoSegArray>
 double sum(TwoSegArray& a, int& n)
 {
-    double d = 0.0;
-    double err = 0.0;
-    for(int i = 0; i < n; ++i)
-    {
-        // does d += a[i] with high accuracy
-        double temp = d;
-        double y = a[i] + err;
-        d = temp + y;
-        err = temp - d;
-        err += y;
-    }
-    return d;
+    // does d += a[i] with high accuracy
+    return kahanSum(a, 0, n);
 }
 double sum(double* a, int& n)
 {
-    double d = 0.0;
-    double err = 0.0;
-    for(int i = 0; i < n; ++i)
-    {
-        // does d += a[i] with high accuracy
-        double temp = d;
-        double y = a[i] + err;
-        d = temp + y;
-        err = temp - d;
-        err += y;
-    }
-    return d;
+    // does d += a[i] with high accuracy
+    return kahanSum(a, 0, n);
 }
 
 template<class TwoSegArray>
 // x, y, n
 double normDiff(TwoSegArray& a, TwoSegArray& b, int& n)
 {
-    double d = 0.0;
-    double err = 0.0;
-    for(int i = 0; i < n; ++i)
-    {
-        // does d += fabs(b[i] - a[i]) with high accuracy
-        double temp = d;
-        double y = std::fabs(b[i] - a[i]) + err;
-        d = temp + y;
-        err = temp - d;
-        err += y;
-    }
-    return d;
+    // does d += fabs(b[i] - a[i]) with high accuracy
+    return l1Diff(a, b, 0, n);
 }
 template<class TwoSegArray>
 double normDiff(TwoSegArray& a, double* b, int& n)
 {
-    double d = 0.0;
-    double err = 0.0;
-    for(int i = 0; i < n; ++i)
-    {
-        // does d += fabs(b[i] - a[i]) with high accuracy
-        double temp = d;
-        double y = std::fabs(b[i] - a[i]) + err;
-        d = temp + y;
-        err = temp - d;
-        err += y;
-    }
-    return d;
+    // does d += fabs(b[i] - a[i]) with high accuracy
+    return l1Diff(a, b, 0, n);
 }
 // x, y, n
 double normDiff(double* a, double* b, int& n)
 {
-    double d = 0.0;
-    double err = 0.0;
-    for(int i = 0; i < n; ++i)
+    // does d += fabs(b[i] - a[i]) with high accuracy
+    return l1Diff(a, b, 0, n);
+}
+
+/*
+    Lag-1 convergence check ($MANSEG_LAGGED_DELTA=1): the delta of an iteration, sum |prev[i] - curr[i]|,
+    is taken on a background thread while the next iteration runs, zeroing prev in the same pass so that
+    it is the accumulator of the iteration after. The loops therefore see each delta one iteration late,
+    and stop or switch after one extra iteration, which only brings the ranks closer; nothing is rolled
+    back. The delta is summed in blocks, so it may differ from normDiff's in the last digits.
+*/
+class LaggedDelta
+{
+public:
+    ~LaggedDelta() { double ignored; wait(ignored); }
+
+    template<class Prev, class Curr>
+    void start(Prev prev, Curr curr, int n)
+    {
+        worker = thread([this, prev, curr, n]() mutable
+        {
+            constexpr int block = 4096;
+            double sum = 0.0, err = 0.0;
+            for(int s = 0; s < n; s += block)
+            {
+                const int len = min(block, n - s);
+                // does sum += l1Diff of the block with high accuracy
+                double tmp = sum;
+                double y = l1Diff(prev, curr, s, len) + err;
+                sum = tmp + y;
+                err = tmp - sum;
+                err += y;
+                for(int i = s; i < s + len; ++i)
+                    prev[i] = 0.0;
+            }
+            result = sum;
+        });
+    }
+
+    // waits for the check started last; false if there was none
+    bool wait(double& delta)
+    {
+        if(!worker.joinable())
+            return false;
+        worker.join();
+        delta = result;
+        return true;
+    }
+
+private:
+    thread worker;
+    double result = 0.0;
+};
+
+bool laggedDelta()
+{
+    const char* lag = getenv("MANSEG_LAGGED_DELTA");
+    return lag != nullptr && atoi(lag) != 0;
+}
+
+/*
+    $MANSEG_SAMPLED_DELTA=k: while delta is far from the switch and convergence tests, estimate it from k
+    sampled vertices (see IndexSample) rather than a full normDiff pass; the exact delta is computed
+    once the estimate's bound no longer settles what the controller does. exact says which was taken.
+*/
+template<class Controller, class A, class B>
+double checkDelta(const IndexSample* sample, const Controller& control, A& a, B& b, int& n, bool& exact)
+{
+    if(sample != nullptr)
     {
-        // does d += fabs(b[i] - a[i]) with high accuracy
-        double temp = d;
-        double y = std::fabs(b[i] - a[i]) + err;
-        d = temp + y;
-        err = temp - d;
-        err += y;
+        SampleEstimate estimate = sampledL1Diff(*sample, a, b);
+        if(control.decides(estimate.lower(), estimate.upper(), tol))
+        {
+            exact = false;
+            return estimate.value;
+        }
     }
-    return d;
+    exact = true;
+    return normDiff(a, b, n);
+}
+
+/*
+    Model of the memory traffic of one iteration, for the results: per edge the two indices,
+    the out degree, a read of the source's rank and an update of the destination's; per vertex
+    the sum, rescale, difference and copy passes.
+*/
+double iterationBytes(int numVertices, int numEdges, double readBytes, double writeBytes)
+{
+    return numEdges*(3*sizeof(int) + readBytes + 2*writeBytes) + numVertices*(readBytes + 7*writeBytes);
 }
 
 template<class SparseMatrix>
-void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::nanoseconds>& tmStart, string& inputFile)
+void pr(SparseMatrix* matrix, chrono::high_resolution_clock::time_point& tmStart, string& inputFile)
 {
     auto totalSt = tmStart;
     auto tmInput = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
@@ -733,21 +510,43 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     tmStart = chrono::high_resolution_clock::now();
 
     int n = matrix->numVertices;
-    ManSegArray x(n); // pagerank
-	x.full = new double[n];
+    // the ranks on large pages with $MANSEG_LARGE_PAGES=1, and on node $MANSEG_NODE (see manseglib_pages.hpp)
+    const PagedSegmentAllocator pages = PagedSegmentAllocator::fromEnvironment();
+    PagedManSegArray x(n, pages); // pagerank
+    x.allocFull();
     // ManSegArray v(n); 
-    ManSegArray y(n);
-	y.full = new double[n];
+    PagedManSegArray y(n, pages);
+    y.allocFull();
+    // with $MANSEG_LAGGED_DELTA, the previous ranks, zeroed by the check of the last iteration
+    const bool lagged = laggedDelta();
+    PagedManSegArray z(pages);
+    if(lagged)
+    {
+        z = PagedManSegArray(n, pages);
+        z.allocFull();      // fresh pages, so zero
+    }
+    LaggedDelta lag;
+    const char* sampleVar = getenv("MANSEG_SAMPLED_DELTA");
+    IndexSample* sample = (sampleVar != nullptr && atoi(sampleVar) > 0) ? new IndexSample(n, atoi(sampleVar)) : nullptr;
+    bool exact = true;      // whether delta was computed in full rather than estimated
+    int exactChecks = 0;
 
     int* outdeg = new int[n];
     double* contr = new double[n];
 
-	double prevDelta = 2.0, delta = 2.0;
-	// int checkFrequency = 4;
-	// double threshold = 3; 
+	double delta = 2.0;
+	// leave the heads once an iteration reduces delta by no more than 25%
+	PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
 
-	// int switch_point = 11;
-	double thresh = 0.25;
+    ResultsWriter results("msa_pagerank");
+    results.set("input", inputFile);
+    results.set("vertices", n);
+    results.set("edges", matrix->numEdges);
+    results.set("threads", 1);
+    results.set("numa", "none");
+    results.set("lagged_delta", lagged ? 1 : 0);
+    results.set("edge_order", hilbertCoo() ? "hilbert" : "file");
+    results.set("delta_sample", sample != nullptr ? (long)sample->size() : 0L);
 
     int iter = 0;
 
@@ -756,6 +555,8 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     {
         x.heads[i] = oneOverN;
         outdeg[i] = y.heads[i] = 0.0;
+        if(lagged)
+            z.heads[i] = 0.0;
     }
 
     matrix->calculateOutDegree(outdeg);
@@ -766,49 +567,67 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     tmStart = chrono::high_resolution_clock::now();
 
     auto iterateS = chrono::high_resolution_clock::now();
+    bool known = true;  // false until a lagged check has finished
     
-	int step = 0;
     while(iter < maxIter) // use heads only
     {
-        matrix->iterate(d, x.heads, y.heads, outdeg, contr);
-
-		double w = (1.0 - sum(y.heads, n))*oneOverN;
-        for(int i = 0; i < n; ++i)
-            y.heads[i] += w;
-
-        delta = normDiff(x.heads, y.heads, n);
-        ++iter;
+        MANSEG_TRACE_SCOPE_ARG("heads iteration", "iter", iter + 1);
+        {
+            MANSEG_TRACE_SCOPE("iterate");
+            matrix->iterate(d, x.heads, y.heads, outdeg, contr);
+        }
 
-        for(int i = 0; i < n; ++i)
         {
-            x.heads[i] = y.heads[i];
-            y.heads[i] = 0.0;
+            MANSEG_TRACE_SCOPE("reduction");
+            double w = (1.0 - sum(y.heads, n))*oneOverN;
+            for(int i = 0; i < n; ++i)
+                y.heads[i] += w;
+
+            ++iter;
+            if(lagged)
+            {
+                // the delta of the previous iteration, then x (previous), y (these ranks) and z (zeroed) rotate
+                known = lag.wait(delta);
+                swap(z, x);
+                swap(x, y);
+                lag.start(z.heads, x.heads, n);
+            }
+            else
+            {
+                delta = checkDelta(sample, control, x.heads, y.heads, n, exact);
+                exactChecks += exact;
+                for(int i = 0; i < n; ++i)
+                {
+                    x.heads[i] = y.heads[i];
+                    y.heads[i] = 0.0;
+                }
+            }
         }
 
         auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
-        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << sum(x.heads, n) 
+        if(!known)
+        {
+            cout << "iteration " << iter << ": delta pending time=" << tmStep << " seconds" << endl;
+            tmStart = chrono::high_resolution_clock::now();
+            continue;
+        }
+        cout << "iteration " << iter << ": delta" << (lagged ? "[previous]" : "") << (exact ? "=" : "~") << delta << " xnorm=" << sum(x.heads, n) 
             << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_HEADS), iterationBytes(n, matrix->numEdges, sizeof(float), sizeof(float)));
 		// cout << "iteration " << iter << ": delta=" << delta << "\n";
         
         tmStart = chrono::high_resolution_clock::now();
 
-		++step;
-		
-		// if(step == checkFrequency)
+		bool switching = (control.update(delta) != PRECISION_HEADS);
+		cout << "% change = " << control.policy().change << "\n";
+		if(switching)
 		{
-			// double ratio = prevDelta/delta;
-			double change = (prevDelta-delta)/prevDelta;
-			// cout  << "ratio = " << ratio << "\n";
-			cout << "% change = " << change << "\n";
-			if(change <= thresh)
-				break;
-			// step = 0;
-
-			// if(delta < thresh)
-				// break;
+			cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+			break;
 		}
-		prevDelta = delta;
     }
+    // the check of the last iteration, so that delta is that of x and z is zeroed
+    lag.wait(delta);
     
     cout << "\n=========================\nInterim Step\n=========================" << endl;
     /*
@@ -826,27 +645,36 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
            rounding towards zero. This, in turn, leads to ||p^k|| < 1
     */
     {
-        matrix->iterate_fullSet(d, x.heads, y.full, outdeg, contr);
+        MANSEG_TRACE_SCOPE_ARG("interim iteration", "iter", iter + 1);
+        {
+            MANSEG_TRACE_SCOPE("iterate");
+            matrix->iterate(d, x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_FULL>(), outdeg, contr);
+        }
     
-        double w = (1.0 - sum(y.full, n))*oneOverN;
-        for(int i = 0; i < n; ++i)
-            y.full[i] += w;
+        {
+            MANSEG_TRACE_SCOPE("reduction");
+            double w = (1.0 - sum(y.full, n))*oneOverN;
+            for(int i = 0; i < n; ++i)
+                y.full[i] += w;
 
-        delta = normDiff(x.pairs, y.full, n);
-        ++iter;
+            delta = normDiff(x.pairs, y.full, n);
+            ++iter;
 
-        for(int i = 0; i < n; ++i)
-        {
-            x.full[i] = y.full[i];
-            y.full[i] = 0.0;
+            for(int i = 0; i < n; ++i)
+            {
+                x.full[i] = y.full[i];
+                y.full[i] = 0.0;
+            }
         }
 
         auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
         cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << sum(x.full, n) 
             << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_INTERIM), iterationBytes(n, matrix->numEdges, sizeof(float), sizeof(double)));
 		// cout << "iteration " << iter << ": delta=" << delta << "\n";
 
         tmStart = chrono::high_resolution_clock::now();
+        control.update(delta); // interim done, on to full precision
 
 		// {
 		// 	double ratio = prevDelta/delta;
@@ -862,25 +690,49 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     cout << "\n=========================\nIncreased Precision\n=========================" << endl;
     while(iter < maxIter && delta > tol) // use full precision
     {
+        MANSEG_TRACE_SCOPE_ARG("full iteration", "iter", iter + 1);
         // matrix->iterate(d, &x.pairs, &y.pairs, outdeg, contr);
-        matrix->iterate(d, x.full, y.full, outdeg, contr);
-
-        double w = (1.0 - sum(y.full, n))*oneOverN;
-        for(int i = 0; i < n; ++i)
-            y.full[i] += w;
-
-        delta = normDiff(x.full, y.full, n);
-        ++iter;
-
-        for(int i = 0; i < n; ++i)
         {
-            x.full[i] = y.full[i];
-            y.full[i] = 0.0;
+            MANSEG_TRACE_SCOPE("iterate");
+            matrix->iterate(d, x.read_as<ACCESS_FULL>(), y.write_as<ACCESS_FULL>(), outdeg, contr);
+        }
+
+        {
+            MANSEG_TRACE_SCOPE("reduction");
+            double w = (1.0 - sum(y.full, n))*oneOverN;
+            for(int i = 0; i < n; ++i)
+                y.full[i] += w;
+
+            ++iter;
+            if(lagged)
+            {
+                known = lag.wait(delta);
+                swap(z, x);
+                swap(x, y);
+                lag.start(z.full, x.full, n);
+            }
+            else
+            {
+                delta = checkDelta(sample, control, x.full, y.full, n, exact);
+                exactChecks += exact;
+                for(int i = 0; i < n; ++i)
+                {
+                    x.full[i] = y.full[i];
+                    y.full[i] = 0.0;
+                }
+            }
         }
  
         auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
-        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << sum(x.full, n) 
+        if(!known)
+        {
+            cout << "iteration " << iter << ": delta pending time=" << tmStep << " seconds" << endl;
+            tmStart = chrono::high_resolution_clock::now();
+            continue;
+        }
+        cout << "iteration " << iter << ": delta" << (lagged ? "[previous]" : "") << (exact ? "=" : "~") << delta << " xnorm=" << sum(x.full, n) 
             << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_FULL), iterationBytes(n, matrix->numEdges, sizeof(double), sizeof(double)));
 		// cout << "iteration " << iter << ": delta=" << delta << "\n";
 
         tmStart = chrono::high_resolution_clock::now();
@@ -897,6 +749,7 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
 		// }
 		// prevDelta = delta;
     }
+    lag.wait(delta);
 
     auto endT = chrono::high_resolution_clock::now();
 
@@ -910,6 +763,15 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     if(delta > tol)
         cerr << "error: solution has not converged" << endl;
 
+    // $MANSEG_VALUES saves the ranks, e.g. from pagerank as the reference for $MANSEG_REFERENCE
+    writeValues(getenv("MANSEG_VALUES"), x.full, n);
+    vector<double> reference;
+    if(loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(x.full, n, reference));
+    results.set("total_time", totalT);
+    results.set("exact_deltas", exactChecks);
+    results.write();
+
     // write to file
     // string outPath = "";
     // for(int i = inputFile.length()-1; i >= 0; --i)
@@ -932,8 +794,11 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     // x.del();
     // y.del();
     delete[] contr;
+    delete sample;
 	x.delSegments();
 	y.delSegments();
+
+    MANSEG_TRACE_WRITE("msa_pagerank.trace.json");
 }
 
 int main(int argc, char** argv)
@@ -20,10 +20,9 @@ constexpr int maxIter = 100;
 // double* npr, *opr, *cnt;
 
 // SNAP csc use:
-// convert into coo
-// then sort on dest
-// then convert to csc
-// initialisation will be slow, but should be O(n log n)
+// read as coo
+// then group by dest with groupColumns (graph_loader.h),
+// a parallel counting sort, O(n + m)
 
 // todo: convert this from virtual nonsense to standalone objects/classes
 // there isn't really any need for there to be inhertiance here,
@@ -10,7 +10,7 @@
 #include <regex>
 #include <cmath>
 
-#include "quicksort.h"
+#include "graph_loader.h"
 
 using namespace std;
 
@@ -432,32 +432,14 @@ public:
         for(int i = 0; i < numEdges; ++i)
             f >> src[i] >> dst[i];
 
-        // perform sort on dst, so we can create a CSC representation
-        quicksort_pair(src, dst, 0, (numEdges-1));
-
-        index[0] = 0; // first index
-        int indexPos = 0;
-        int edgeCounter = 0;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            while(indexPos < dst[i])
-                index[++indexPos] = (edgeCounter);
-            ++edgeCounter;
-        }
-
-        while(indexPos < (numVertices + 1))
-            index[++indexPos] = numEdges;
-
-        source = src;
-
-        // not super pretty but we need this for the same ordering as
-        // you would get with CSR/COO, otherwise deltas/pagerank values
-        // end up being off due to error
-        for(int i = 0; i < (numVertices); ++i)
-            quicksort(source, index[i], index[i+1]-1);
+        // grouped by destination, each column's sources in increasing order, so that deltas/pagerank
+        // values come out as they would with CSR/COO
+        source = new int[numEdges];
+        groupColumns(numVertices, numEdges, src, dst, index, source);
 
         f.close();
 
+        delete[] src;
         delete[] dst;
     }
 
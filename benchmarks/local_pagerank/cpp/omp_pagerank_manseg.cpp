@@ -0,0 +1,1123 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include <omp.h>
+
+#include "../../../manseglib.hpp"
+#include "../../../manseglib_expr.hpp"
+#include "../../../manseglib_controller.hpp"
+#include "../../../manseglib_trace.hpp"
+#include "../../../manseglib_results.hpp"
+#include "../../../manseglib_rank.hpp"
+#include "../../../manseglib_sparse.hpp"
+#include "../../../manseglib_pressure.hpp"
+#include "../../../manseglib_publish.hpp"
+#include "../../../manseglib_throttle.hpp"
+#include "../../../manseglib_batch.hpp"
+#include "../../../manseglib_switchmemo.hpp"
+#include "graph_loader.h"
+
+/*
+    OpenMP ManSeg PageRank: the heads, interim and full phases of msa_pagerank, on as many threads as
+    OMP_NUM_THREADS. Each thread owns a range of vertices, cut so the ranges hold about the same number
+    of edges plus vertices, and computes their contributions. Sums and differences are the compensated
+    parallel reductions of manseglib_expr.hpp.
+        ./omp_pagerank_manseg <type> <format> <input_file|@list> [none|degree|hub|rcm|gorder] [jacobi|gauss-seidel|sparse-tails]
+    The format picks how an iteration runs, whatever the input:
+        CSC, COO: pull. A thread sums the contributions into the vertices of its range, writing each
+            new rank once, so no two threads write the same heads (or tails).
+        CSR: push, with propagation blocking. The destinations are split into bins of binVertices, so
+            a bin's ranks fit in cache. A thread pushes the contributions of its sources into its part
+            of each bin, then the bins are shared out, and each is summed into a private double buffer
+            and narrowed into the ranks in one streaming pass: no atomics, and no scattered writes to
+            the heads.
+    Either way a rank is summed in a double and rounded to the level written once, rather than after
+    every addition as in msa_pagerank, so the heads iterations are slightly more accurate; and the sums
+    are in the order of the sources, so the ranks do not depend on the number of threads.
+    The last argument renumbers the vertices first (see GraphOrder in graph_loader.h); the renumbered
+    graph is cached with its order, and the ranks are put back in the numbering of the file for output.
+    $MANSEG_SNAPSHOT saves the ranks for a later run to start from with $MANSEG_WARM_START.
+    The method is the Jacobi iteration above, or Gauss-Seidel sweeps in place (CSC and COO only; see
+    CscGraph::sweep), or Gauss-Seidel sweeps that only take the leading vertices to full precision
+    (see prSparseTails).
+    An input file of @list runs the graphs named in list, one a line, as a batch (see runBatch).
+    With MANSEG_BIND=1 thread t is bound to a CPU of the node ThreadTopology gives worker t (see
+    manseglib_topology.hpp), so the ranges a thread first touches stay on its node.
+*/
+
+using namespace std;
+using namespace ManSeg;
+
+constexpr double d = 0.85;
+constexpr double tol = 1e-7;
+constexpr int maxIter = 100;
+
+// destinations per propagation blocking bin: a bin's buffer of doubles is 512KB, and its entries
+// hold their destination as a uint16_t offset into the bin
+constexpr int binBits = 16;
+constexpr int binVertices = 1 << binBits;
+
+/*
+    The first vertex of each of parts ranges, and n: range t is [start[t], start[t + 1]), cut so each
+    holds about (m + n) / parts of the work of a graph with index as its CSR (or CSC) index.
+*/
+vector<int> balancedRanges(const int* index, const int& n, const int& m, const int& parts)
+{
+    vector<int> start(parts + 1, n);
+    start[0] = 0;
+    const long work = static_cast<long>(m) + n;
+    int v = 0;
+    for(int t = 1; t < parts; ++t)
+    {
+        const long target = work * t / parts;
+        while(v < n && static_cast<long>(index[v]) + v < target)
+            ++v;
+        start[t] = v;
+    }
+    return start;
+}
+
+/*
+    Renumbers the graph (index, adjacent, outdeg) of file by ordering, pointing the arrays and order at
+    new ones, and caches it as the format cached.
+*/
+void renumber(const GraphOrder& ordering, const bool& columns, const string& file, const string& cached, const int& n, const int& m,
+    const int*& index, const int*& adjacent, const int*& outdeg, const int*& order)
+{
+    auto st = chrono::high_resolution_clock::now();
+    const vector<int> byOrder = makeGraphOrder(ordering, columns, n, m, index, adjacent);
+    int* idx = new int[n + 1];
+    int* adj = new int[m];
+    int* deg = new int[n];
+    int* ord = new int[n];
+    copy(byOrder.begin(), byOrder.end(), ord);
+    relabelGraph(n, m, ord, index, adjacent, outdeg, idx, adj, deg);
+
+    index = idx;
+    adjacent = adj;
+    outdeg = deg;
+    order = ord;
+    GraphCache::save(file, cached, n, m, index, adjacent, outdeg, order);
+    cout << "Renumbering (" << graphOrderName(ordering) << "): "
+        << chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - st).count()*1e-9 << " seconds" << endl;
+}
+
+class CscGraph
+{
+public:
+    /* the graph of file, of type (SNAP or not) and format COO or CSC, in CSC and renumbered by ordering, for threads */
+    CscGraph(const string& type, const string& format, const string& file, const int& threads, const GraphOrder& ordering)
+        :order(nullptr), ordering(ordering)
+    {
+        const string cached = string("csc.") + graphOrderName(ordering);
+        if(ordering == ORDER_NONE)
+        {
+            if(!cache.load(file, "csc", numVertices, numEdges, index, source, outdegree))
+                load(type, format, file);
+        }
+        else if(!cache.load(file, cached, numVertices, numEdges, index, source, outdegree, &order))
+        {
+            GraphCache plain;
+            if(!plain.load(file, "csc", numVertices, numEdges, index, source, outdegree))
+                load(type, format, file);
+            renumber(ordering, true, file, cached, numVertices, numEdges, index, source, outdegree, order);
+        }
+        start = balancedRanges(index, numVertices, numEdges, threads);
+        contr = new double[numVertices];
+        fresh = nullptr;
+    }
+
+    ~CscGraph()
+    {
+        delete[] contr;
+        delete[] fresh;
+    }
+
+    /* faults in the arrays mapped from the cache, if they are */
+    void populate() const { cache.populate(); }
+
+    /* one iteration at a (read level, write level) pair */
+    template<class ReadView, class WriteView>
+    void iterate(ReadView prevPr, WriteView newPr)
+    {
+        const int parts = start.size() - 1;
+        #pragma omp parallel num_threads(min(parts, omp_get_max_threads()))
+        {
+            const int nt = omp_get_num_threads();
+            for(int t = omp_get_thread_num(); t < parts; t += nt)
+                contributions(prevPr, start[t], start[t + 1]);
+            #pragma omp barrier
+            for(int t = omp_get_thread_num(); t < parts; t += nt)
+                pull(newPr, start[t], start[t + 1]);
+        }
+    }
+
+    /*
+        One Gauss-Seidel sweep of x in place, reading it through in and writing it through out (views of
+        the same array at two levels); returns sum |new - old|. A rank is summed from the new ranks of
+        the vertices before it, and the rank lost to dangling vertices and teleports, from the ranks at
+        the start of the sweep, is added back evenly. A thread sweeps its own range in order and reads
+        the other ranges as they were at the start of the sweep, so one thread is plain Gauss-Seidel,
+        and the ranks depend on the number of threads but not on how they are scheduled.
+    */
+    template<class ReadView, class WriteView>
+    double sweep(ReadView in, WriteView out)
+    {
+        const int parts = start.size() - 1;
+        if(parts > 1 && fresh == nullptr)
+            fresh = new double[numVertices];
+        // where a thread keeps the contributions of its range as they change: contr, when there is one range
+        double* own = (parts > 1) ? fresh : contr;
+        vector<double> kept(parts), change(parts);
+        double w = 0.0;
+        #pragma omp parallel num_threads(min(parts, omp_get_max_threads()))
+        {
+            const int nt = omp_get_num_threads();
+            for(int t = omp_get_thread_num(); t < parts; t += nt)
+                kept[t] = contributions(in, start[t], start[t + 1], own);
+            #pragma omp barrier
+            #pragma omp single
+            {
+                double s = 0.0;
+                for(int t = 0; t < parts; ++t)
+                    s += kept[t];
+                w = (1.0 - s)/numVertices;
+            }
+            for(int t = omp_get_thread_num(); t < parts; t += nt)
+                change[t] = gaussSeidel(in, out, start[t], start[t + 1], own, w);
+        }
+        double delta = 0.0;
+        for(int t = 0; t < parts; ++t)
+            delta += change[t];
+        return delta;
+    }
+
+    /* model of the memory traffic of one iteration: per edge the source and its contribution, per vertex the rest */
+    double iterationBytes(const double& readBytes, const double& writeBytes) const
+    {
+        return numEdges*(sizeof(int) + sizeof(double)) + numVertices*(2*sizeof(int) + 3*readBytes + 4*writeBytes + 2*sizeof(double));
+    }
+
+    /* the same for a sweep: the ranks are read twice and written once, and the contributions written twice */
+    double sweepBytes(const double& readBytes, const double& writeBytes) const
+    {
+        return numEdges*(sizeof(int) + sizeof(double)) + numVertices*(3*sizeof(int) + 2*readBytes + writeBytes + 2*sizeof(double));
+    }
+
+    int numVertices;
+    int numEdges;
+    vector<int> start; // the threads' ranges of vertices
+    const int* order;  // the vertex of the file numbered k is order[k], or nullptr if not renumbered
+    GraphOrder ordering;
+
+private:
+    void load(const string& type, const string& format, const string& file)
+    {
+        const bool snap = (type.compare("SNAP") == 0);
+        GraphText text(file, format.c_str());
+        const char* p = text.skipLines(text.begin(), 1);
+        // the SNAP descriptor, e.g. "# Nodes: 4 Edges: 5", or the line "numVertices numEdges"
+        const char* end = snap ? text.nextLine(p) : text.end();
+        p = readInt(p, end, numVertices);
+        p = readInt(p, end, numEdges);
+        const char* body = snap ? end : text.nextLine(p);
+
+        int* idx = new int[numVertices + 1];
+        int* adj = new int[numEdges];
+        if(!snap && format.compare("CSC") == 0)
+            readAdjacency(text, body, numVertices, numEdges, idx, adj);
+        else
+        {
+            int* src = new int[numEdges];
+            int* dst = new int[numEdges];
+            readEdges(text, body, numEdges, numVertices, src, dst);
+            groupColumns(numVertices, numEdges, src, dst, idx, adj);
+            delete[] src;
+            delete[] dst;
+        }
+
+        index = idx;
+        source = adj;
+        outdegree = sourceDegrees(numVertices, numEdges, source);
+        GraphCache::save(file, "csc", numVertices, numEdges, index, source, outdegree);
+    }
+
+    /*
+        One PageRank sweep over the vertices [from, to): newPr[i] = sum of contr[j] over the sources j of
+        i. contr must hold d*prevPr[j]/outdeg[j] for every vertex, i.e. all threads must have finished
+        contributions() first.
+    */
+    template<class WriteView>
+    void pull(WriteView newPr, const int& from, const int& to) const
+    {
+        for(int i = from; i < to; ++i)
+        {
+            double s = 0.0;
+            for(int j = index[i]; j < index[i + 1]; ++j)
+                s += contr[source[j]];
+            newPr.set(i, s);
+        }
+    }
+
+    template<class ReadView>
+    void contributions(ReadView prevPr, const int& from, const int& to)
+    {
+        for(int i = from; i < to; ++i)
+            contr[i] = d*(prevPr.read(i)/outdegree[i]);
+    }
+
+    /* the contributions of [from, to), also copied to own; returns the rank they pass on (d times that of the non dangling vertices) */
+    template<class ReadView>
+    double contributions(ReadView x, const int& from, const int& to, double* own)
+    {
+        double kept = 0.0;
+        for(int i = from; i < to; ++i)
+        {
+            const double r = x.read(i);
+            own[i] = contr[i] = d*(r/outdegree[i]);
+            if(outdegree[i] > 0)
+                kept += d*r;
+        }
+        return kept;
+    }
+
+    /* the Gauss-Seidel sweep of [from, to) (see sweep), returning sum |new - old| over it */
+    template<class ReadView, class WriteView>
+    double gaussSeidel(ReadView in, WriteView out, const int& from, const int& to, double* own, const double& w)
+    {
+        double change = 0.0;
+        for(int i = from; i < to; ++i)
+        {
+            double s = 0.0;
+            for(int j = index[i]; j < index[i + 1]; ++j)
+            {
+                const int k = source[j];
+                s += (k >= from && k < to) ? own[k] : contr[k];
+            }
+            s += w;
+            change += fabs(s - in.read(i));
+            out.set(i, s);
+            own[i] = d*(out.read(i)/outdegree[i]);
+        }
+        return change;
+    }
+
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* source;
+    const int* outdegree;
+    double* contr;
+    double* fresh; // the contributions of each thread's range during a sweep, with more than one range
+};
+
+class CsrGraph
+{
+public:
+    /* the graph of file, of type (SNAP or not) and format CSR, renumbered by ordering and binned for threads */
+    CsrGraph(const string& type, const string& file, const int& threads, const GraphOrder& ordering)
+        :order(nullptr), ordering(ordering)
+    {
+        const string cached = string("csr.") + graphOrderName(ordering);
+        if(ordering == ORDER_NONE)
+        {
+            if(!cache.load(file, "csr", numVertices, numEdges, index, dest, outdegree))
+                load(type, file);
+        }
+        else if(!cache.load(file, cached, numVertices, numEdges, index, dest, outdegree, &order))
+        {
+            GraphCache plain;
+            if(!plain.load(file, "csr", numVertices, numEdges, index, dest, outdegree))
+                load(type, file);
+            renumber(ordering, false, file, cached, numVertices, numEdges, index, dest, outdegree, order);
+        }
+        start = balancedRanges(index, numVertices, numEdges, threads);
+        bins = (numVertices + binVertices - 1) / binVertices;
+        bin();
+    }
+
+    ~CsrGraph()
+    {
+        delete[] binStart;
+        delete[] binDest;
+        delete[] binValue;
+        delete[] sums;
+    }
+
+    /* faults in the arrays mapped from the cache, if they are */
+    void populate() const { cache.populate(); }
+
+    /* one iteration at a (read level, write level) pair */
+    template<class ReadView, class WriteView>
+    void iterate(ReadView prevPr, WriteView newPr)
+    {
+        const int parts = start.size() - 1;
+        #pragma omp parallel num_threads(min(parts, omp_get_max_threads()))
+        {
+            const int nt = omp_get_num_threads();
+            for(int t = omp_get_thread_num(); t < parts; t += nt)
+                push(prevPr, t);
+            #pragma omp barrier
+            double* sum = sums + static_cast<size_t>(omp_get_thread_num()) * binVertices;
+            #pragma omp for schedule(dynamic, 1)
+            for(int b = 0; b < bins; ++b)
+                accumulate(newPr, b, sum);
+        }
+    }
+
+    /*
+        Model of the memory traffic of one iteration: per edge the destination, and a contribution
+        written to its bin and read back with its offset, per vertex the rest
+    */
+    double iterationBytes(const double& readBytes, const double& writeBytes) const
+    {
+        return numEdges*(sizeof(int) + 2*sizeof(double) + sizeof(uint16_t)) + numVertices*(2*sizeof(int) + 3*readBytes + 4*writeBytes);
+    }
+
+    int numVertices;
+    int numEdges;
+    vector<int> start; // the threads' ranges of (source) vertices
+    const int* order;  // the vertex of the file numbered k is order[k], or nullptr if not renumbered
+    GraphOrder ordering;
+
+private:
+    void load(const string& type, const string& file)
+    {
+        const bool snap = (type.compare("SNAP") == 0);
+        GraphText text(file, "CSR");
+        const char* p = text.skipLines(text.begin(), 1);
+        const char* end = snap ? text.nextLine(p) : text.end();
+        p = readInt(p, end, numVertices);
+        p = readInt(p, end, numEdges);
+
+        int* idx = new int[numVertices + 1];
+        int* adj = new int[numEdges];
+        if(snap)
+        {
+            // grouped by source, keeping the file's order within a source
+            int* src = new int[numEdges];
+            int* dst = new int[numEdges];
+            readEdges(text, end, numEdges, numVertices, src, dst);
+            groupEdges(numVertices, numEdges, src, dst, idx, adj);
+            delete[] src;
+            delete[] dst;
+        }
+        else
+            readAdjacency(text, text.nextLine(p), numVertices, numEdges, idx, adj);
+
+        index = idx;
+        dest = adj;
+        outdegree = rowDegrees(numVertices, index);
+        GraphCache::save(file, "csr", numVertices, numEdges, index, dest, outdegree);
+    }
+
+    /*
+        Lays out the bins: bin b holds binStart[b] .. binStart[b + 1], and within it thread t's part
+        starts at at[t * bins + b], holding its edges into the bin in the order of their sources. The
+        destinations (as offsets into the bin) do not change, so they are written here, once; the
+        contributions are written by each iteration, by the thread that owns the part.
+    */
+    void bin()
+    {
+        const int parts = start.size() - 1;
+        at.assign(static_cast<size_t>(parts) * bins, 0);
+        #pragma omp parallel for num_threads(parts) schedule(static, 1)
+        for(int t = 0; t < parts; ++t)
+            for(int j = index[start[t]]; j < index[start[t + 1]]; ++j)
+                ++at[static_cast<size_t>(t) * bins + (dest[j] >> binBits)];
+
+        binStart = new long[bins + 1];
+        long k = 0;
+        for(int b = 0; b < bins; ++b)
+        {
+            binStart[b] = k;
+            for(int t = 0; t < parts; ++t)
+            {
+                const long count = at[static_cast<size_t>(t) * bins + b];
+                at[static_cast<size_t>(t) * bins + b] = k;
+                k += count;
+            }
+        }
+        binStart[bins] = k;
+
+        sums = new double[static_cast<size_t>(parts) * binVertices];
+        binDest = new uint16_t[numEdges];
+        binValue = new double[numEdges];
+        #pragma omp parallel for num_threads(parts) schedule(static, 1)
+        for(int t = 0; t < parts; ++t)
+        {
+            vector<long> next(at.begin() + static_cast<size_t>(t) * bins, at.begin() + static_cast<size_t>(t + 1) * bins);
+            for(int j = index[start[t]]; j < index[start[t + 1]]; ++j)
+            {
+                const long p = next[dest[j] >> binBits]++;
+                binDest[p] = static_cast<uint16_t>(dest[j] & (binVertices - 1));
+                binValue[p] = 0.0;
+            }
+        }
+    }
+
+    /* writes the contributions of the sources of thread t's range to its parts of the bins */
+    template<class ReadView>
+    void push(ReadView prevPr, const int& t)
+    {
+        vector<long> next(at.begin() + static_cast<size_t>(t) * bins, at.begin() + static_cast<size_t>(t + 1) * bins);
+        for(int i = start[t]; i < start[t + 1]; ++i)
+        {
+            const double c = d*(prevPr.read(i)/outdegree[i]);
+            for(int j = index[i]; j < index[i + 1]; ++j)
+                binValue[next[dest[j] >> binBits]++] = c;
+        }
+    }
+
+    /* sums bin b into sum, then narrows it into its vertices of newPr in one pass */
+    template<class WriteView>
+    void accumulate(WriteView newPr, const int& b, double* sum) const
+    {
+        const int first = b * binVertices;
+        const int count = min(binVertices, numVertices - first);
+        memset(sum, 0, count * sizeof(double));
+        for(long p = binStart[b]; p < binStart[b + 1]; ++p)
+            sum[binDest[p]] += binValue[p];
+        for(int i = 0; i < count; ++i)
+            newPr.set(first + i, sum[i]);
+    }
+
+    GraphCache cache; // holds the arrays when they are mapped from the cache
+    const int* index;
+    const int* dest;
+    const int* outdegree;
+
+    int bins;
+    vector<long> at;    // where thread t's part of bin b starts, at t * bins + b
+    long* binStart;
+    uint16_t* binDest;  // destination of each binned edge, less the bin's first vertex
+    double* binValue;   // contribution of each binned edge
+    double* sums;       // each thread's buffer for the bin it is summing
+};
+
+/* adds the rank lost to dangling vertices back evenly (so y sums to 1), returning sum |y - x| */
+template<class ReadView, class WriteView>
+double normalise(ReadView x, WriteView y, const int& n)
+{
+    const double w = (1.0 - parallelKahanSum(y, 0, n))/n;
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; ++i)
+        y.set(i, y.read(i) + w);
+    return parallelL1Diff(x, y, 0, n);
+}
+
+/*
+    The starting ranks of g's vertices, in its numbering, from the heads of the $MANSEG_SNAPSHOT of
+    an earlier run named by $MANSEG_WARM_START, renumbered by $MANSEG_WARM_MAP if the graph has
+    gained or lost vertices since (see warmStart); empty, for a start from 1/n, if there is none.
+*/
+template<class Graph>
+vector<double> startingRanks(const Graph& g)
+{
+    vector<double> warm;
+    if(!warmStart(getenv("MANSEG_WARM_START"), getenv("MANSEG_WARM_MAP"), g.numVertices, warm))
+    {
+        if(getenv("MANSEG_WARM_START") != nullptr)
+            cerr << "cannot warm start from " << getenv("MANSEG_WARM_START") << ", starting from 1/n" << endl;
+        return warm;
+    }
+    if(g.order == nullptr)
+        return warm;
+    vector<double> ordered(g.numVertices);
+    for(int k = 0; k < g.numVertices; ++k)
+        ordered[k] = warm[g.order[k]];
+    return ordered;
+}
+
+/* saves and checks the ranks x of g, in the numbering of the file, and writes the results */
+template<class Graph, class View>
+void finish(const Graph& g, View x, ResultsWriter& results, const double& totalT)
+{
+    const int n = g.numVertices;
+    vector<double> ranks(n);
+    for(int k = 0; k < n; ++k)
+        ranks[g.order != nullptr ? g.order[k] : k] = x.read(k);
+
+    // $MANSEG_VALUES saves the ranks, $MANSEG_REFERENCE compares them to saved ones, and
+    // $MANSEG_SNAPSHOT keeps them for a warm start
+    writeValues(getenv("MANSEG_VALUES"), ranks.data(), n);
+    writeSegments(getenv("MANSEG_SNAPSHOT"), ranks.data(), n);
+    vector<double> reference;
+    if(loadReference(getenv("MANSEG_REFERENCE"), reference))
+        results.finalError(relativeError(ranks.data(), n, reference));
+    results.set("total_time", totalT);
+    results.write();
+
+    MANSEG_TRACE_WRITE("omp_pagerank_manseg.trace.json");
+}
+
+template<class Graph>
+void pr(Graph& g, std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::nanoseconds>& tmStart, const string& inputFile)
+{
+    auto totalSt = tmStart;
+    auto tmInput = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Reading input: " << tmInput << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+
+    int n = g.numVertices;
+    const vector<int>& start = g.start;
+    const int threads = start.size() - 1;
+
+    // from the pool, so the jobs of a batch reuse the arrays of the one before
+    PooledManSegArray x(n); // pagerank
+    x.allocFull();
+    PooledManSegArray y(n); // new pagerank
+    y.allocFull();
+
+    // first touch by the thread that owns each range, from 1/n or a warm start
+    const vector<double> warm = startingRanks(g);
+    const double oneOverN = 1.0/n;
+    #pragma omp parallel num_threads(threads)
+    {
+        const int nt = omp_get_num_threads();
+        for(int t = omp_get_thread_num(); t < threads; t += nt)
+            for(int i = start[t]; i < start[t + 1]; ++i)
+            {
+                x.pairs.set(i, warm.empty() ? oneOverN : warm[i]);
+                y.pairs.set(i, 0.0);
+                x.full[i] = y.full[i] = 0.0;
+            }
+    }
+
+    double delta = 2.0;
+    // leave the heads once an iteration reduces delta by no more than 25%, or with $MANSEG_SWITCH_CACHE
+    // set, where an earlier run on this graph found it best to (see SwitchMemo)
+    SwitchMemo memo(inputFingerprint(inputFile.c_str()), string("omp_pagerank_manseg jacobi stagnation 0.25 ") + graphOrderName(g.ordering));
+    PrecisionController<MemoisedPolicy<StagnationPolicy>> control(memo.policy(StagnationPolicy(0.25)));
+    /*
+        Memory pressure (see MemoryPressure) demotes x and y, at the next full iteration: to their pairs,
+        which keep the ranks exactly in half the space, or, with $MANSEG_DEMOTE_TAILS=1, to their heads,
+        where the iterations go on until delta stagnates, leaving ranks to warm start a later run from.
+    */
+    MemoryPressure pressure;
+    const bool demoteTails = getenv("MANSEG_DEMOTE_TAILS") != nullptr && atoi(getenv("MANSEG_DEMOTE_TAILS")) != 0;
+    // with $MANSEG_PUBLISH set, the ranks of each iteration go to readers there (see RankPublisher)
+    RankPublisher publisher(getenv("MANSEG_PUBLISH"), n);
+    if(getenv("MANSEG_PUBLISH") != nullptr && !publisher.isOpen())
+        cerr << "cannot publish to " << getenv("MANSEG_PUBLISH") << endl;
+    // with $MANSEG_THROTTLE=1, each precision runs on the fewest threads that keep its throughput
+    ThreadThrottle throttle;
+
+    ResultsWriter results("omp_pagerank_manseg");
+    results.set("input", inputFile);
+    results.set("vertices", n);
+    results.set("edges", g.numEdges);
+    results.set("threads", threads);
+    results.set("ordering", graphOrderName(g.ordering));
+    results.set("method", "jacobi");
+    results.set("numa", getenv("OMP_PLACES") != nullptr ? getenv("OMP_PLACES") : "none");
+    results.set("warm_start", warm.empty() ? "none" : getenv("MANSEG_WARM_START"));
+
+    auto tmInit = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Initialisation: " << tmInit << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+    auto iterateS = chrono::high_resolution_clock::now();
+
+    int iter = 0;
+    while(iter < maxIter) // use heads only
+    {
+        MANSEG_TRACE_SCOPE_ARG("heads iteration", "iter", iter + 1);
+        throttle.phase(levelName(PRECISION_HEADS));
+        g.iterate(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_HEADS>());
+        delta = normalise(x.heads, y.heads, n);
+        ++iter;
+        swap(x, y);
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.heads, 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_HEADS), g.iterationBytes(sizeof(float), sizeof(float)));
+        throttle.update(tmStep, g.iterationBytes(sizeof(float), sizeof(float)));
+        publisher.publish(x.heads, n, iter, delta);
+        tmStart = chrono::high_resolution_clock::now();
+
+        memo.observe(delta);
+        if(control.update(delta) != PRECISION_HEADS)
+        {
+            cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+            break;
+        }
+    }
+
+    // the interim step: read the heads, write full precision (see msa_pagerank)
+    cout << "\n=========================\nInterim Step\n=========================" << endl;
+    {
+        MANSEG_TRACE_SCOPE_ARG("interim iteration", "iter", iter + 1);
+        g.iterate(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_FULL>());
+        delta = normalise(x.heads, FullView(y.full, n), n);
+        ++iter;
+        swap(x, y);
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.full, 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_INTERIM), g.iterationBytes(sizeof(float), sizeof(double)));
+        publisher.publish(x.full, n, iter, delta);
+        tmStart = chrono::high_resolution_clock::now();
+        memo.observe(delta);
+        control.update(delta); // interim done, on to full precision
+    }
+
+    // demote x and y if memory pressure has been signalled, here or at the heads
+    AccessLevel level = ACCESS_FULL;
+    PrecisionController<StagnationPolicy> demoted(StagnationPolicy(0.25), false, delta);
+
+    cout << "\n=========================\nIncreased Precision\n=========================" << endl;
+    while(iter < maxIter && delta > tol) // use full precision
+    {
+        if(level != ACCESS_HEADS && pressure.take())
+        {
+            x.demote(demoteTails);
+            y.demote(demoteTails);
+            level = demoteTails ? ACCESS_HEADS : ACCESS_PAIRS;
+            cout << "memory pressure: demoted to the " << (demoteTails ? "heads" : "pairs") << " at iter " << iter << endl;
+            results.set("demoted_at", iter);
+            results.set("demoted_to", demoteTails ? "heads" : "pairs");
+        }
+
+        MANSEG_TRACE_SCOPE_ARG("full iteration", "iter", iter + 1);
+        throttle.phase(level == ACCESS_FULL ? "full" : level == ACCESS_PAIRS ? "pairs" : "heads");
+        double xnorm;
+        if(level == ACCESS_FULL)
+        {
+            g.iterate(x.read_as<ACCESS_FULL>(), y.write_as<ACCESS_FULL>());
+            delta = normalise(FullView(x.full, n), FullView(y.full, n), n);
+            xnorm = parallelKahanSum(y.full, 0, n);
+        }
+        else if(level == ACCESS_PAIRS)
+        {
+            g.iterate(x.read_as<ACCESS_PAIRS>(), y.write_as<ACCESS_PAIRS>());
+            delta = normalise(x.pairs, y.pairs, n);
+            xnorm = parallelKahanSum(y.pairs, 0, n);
+        }
+        else
+        {
+            g.iterate(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_HEADS>());
+            delta = normalise(x.heads, y.heads, n);
+            xnorm = parallelKahanSum(y.heads, 0, n);
+        }
+        ++iter;
+        swap(x, y);
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << xnorm
+            << " time=" << tmStep << " seconds" << endl;
+        const size_t bytes = level == ACCESS_HEADS ? sizeof(float) : sizeof(double);
+        results.iteration(iter, delta, tmStep, levelName(level == ACCESS_HEADS ? PRECISION_HEADS : PRECISION_FULL), g.iterationBytes(bytes, bytes));
+        throttle.update(tmStep, g.iterationBytes(bytes, bytes));
+        if(level == ACCESS_FULL)
+            publisher.publish(x.full, n, iter, delta);
+        else if(level == ACCESS_PAIRS)
+            publisher.publish(x.pairs, n, iter, delta);
+        else
+            publisher.publish(x.heads, n, iter, delta);
+        tmStart = chrono::high_resolution_clock::now();
+        if(level == ACCESS_FULL)
+            memo.observe(delta);
+
+        if(level == ACCESS_HEADS && demoted.update(delta) != PRECISION_HEADS)
+        {
+            cout << "stopping at the heads at iter " << iter << " (" << demoted.reasonName() << ")" << endl;
+            break;
+        }
+    }
+
+    auto endT = chrono::high_resolution_clock::now();
+    auto iterateT = chrono::duration_cast<chrono::nanoseconds>(endT - iterateS).count()*1e-9;
+    auto totalT = chrono::duration_cast<chrono::nanoseconds>(endT - totalSt).count()*1e-9;
+
+    cout << "\nTotal time:" << totalT << " seconds\n"
+        << "Total iterate time:" << iterateT << " seconds\n"
+        << "Total seq time:" << (totalT - iterateT) << " seconds" << endl;
+
+    if(delta > tol)
+        cerr << "error: solution has not converged" << endl;
+
+    if(memo.enabled())
+    {
+        const bool saved = memo.save(control, "stagnation 0.25");
+        const char* outcome = !memo.found() ? "recorded" : control.policy().diverged ? "diverged" : "followed";
+        results.set("switch_memo", outcome);
+        cout << "switch memo: " << outcome << (saved ? " (saved)" : "") << endl;
+    }
+
+    if(publisher.isOpen())
+    {
+        results.set("published", (long)publisher.numPublished());
+        results.set("publish_skipped", (long)publisher.numSkipped());
+    }
+    if(throttle.enabled())
+    {
+        // 0 for a phase that ended before it settled
+        results.set("heads_threads", (long)throttle.settled("heads"));
+        results.set("full_threads", (long)throttle.settled("full"));
+        cout << "threads settled on: heads " << throttle.settled("heads") << ", full " << throttle.settled("full") << endl;
+    }
+
+    if(level == ACCESS_FULL)
+        finish(g, FullView(x.full, n), results, totalT);
+    else if(level == ACCESS_PAIRS)
+        finish(g, x.pairs, results, totalT);
+    else
+        finish(g, x.heads, results, totalT);
+}
+
+/*
+    PageRank by Gauss-Seidel sweeps of a single ManSegArray (see CscGraph::sweep): the heads, then one
+    sweep reading the heads and writing the pairs, then the pairs, which hold the ranks in full
+    precision without allocating full. Each rank is written once a sweep, in place, so there is no y,
+    and a sweep uses the ranks already updated in it, so it takes fewer sweeps than iterations.
+*/
+void prGaussSeidel(CscGraph& g, std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::nanoseconds>& tmStart, const string& inputFile)
+{
+    auto totalSt = tmStart;
+    auto tmInput = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Reading input: " << tmInput << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+
+    int n = g.numVertices;
+    const vector<int>& start = g.start;
+    const int threads = start.size() - 1;
+
+    PooledManSegArray x(n); // pagerank, updated in place
+
+    // first touch by the thread that owns each range, from 1/n or a warm start
+    const vector<double> warm = startingRanks(g);
+    const double oneOverN = 1.0/n;
+    #pragma omp parallel num_threads(threads)
+    {
+        const int nt = omp_get_num_threads();
+        for(int t = omp_get_thread_num(); t < threads; t += nt)
+            for(int i = start[t]; i < start[t + 1]; ++i)
+                x.pairs.set(i, warm.empty() ? oneOverN : warm[i]);
+    }
+
+    double delta = 2.0;
+    PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
+
+    ResultsWriter results("omp_pagerank_manseg");
+    results.set("input", inputFile);
+    results.set("vertices", n);
+    results.set("edges", g.numEdges);
+    results.set("threads", threads);
+    results.set("ordering", graphOrderName(g.ordering));
+    results.set("method", "gauss-seidel");
+    results.set("numa", getenv("OMP_PLACES") != nullptr ? getenv("OMP_PLACES") : "none");
+    results.set("warm_start", warm.empty() ? "none" : getenv("MANSEG_WARM_START"));
+
+    auto tmInit = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Initialisation: " << tmInit << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+    auto iterateS = chrono::high_resolution_clock::now();
+
+    int iter = 0;
+    while(iter < maxIter) // use heads only
+    {
+        MANSEG_TRACE_SCOPE_ARG("heads sweep", "iter", iter + 1);
+        delta = g.sweep(x.read_as<ACCESS_HEADS>(), x.write_as<ACCESS_HEADS>());
+        ++iter;
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.heads, 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_HEADS), g.sweepBytes(sizeof(float), sizeof(float)));
+        tmStart = chrono::high_resolution_clock::now();
+
+        if(control.update(delta) != PRECISION_HEADS)
+        {
+            cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+            break;
+        }
+    }
+
+    cout << "\n=========================\nInterim Step\n=========================" << endl;
+    {
+        MANSEG_TRACE_SCOPE_ARG("interim sweep", "iter", iter + 1);
+        delta = g.sweep(x.read_as<ACCESS_HEADS>(), x.write_as<ACCESS_PAIRS>());
+        ++iter;
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.pairs, 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_INTERIM), g.sweepBytes(sizeof(float), sizeof(double)));
+        tmStart = chrono::high_resolution_clock::now();
+        control.update(delta);
+    }
+
+    cout << "\n=========================\nIncreased Precision\n=========================" << endl;
+    while(iter < maxIter && delta > tol) // use the pairs
+    {
+        MANSEG_TRACE_SCOPE_ARG("full sweep", "iter", iter + 1);
+        delta = g.sweep(x.read_as<ACCESS_PAIRS>(), x.write_as<ACCESS_PAIRS>());
+        ++iter;
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.pairs, 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_FULL), g.sweepBytes(sizeof(double), sizeof(double)));
+        tmStart = chrono::high_resolution_clock::now();
+    }
+
+    auto endT = chrono::high_resolution_clock::now();
+    auto iterateT = chrono::duration_cast<chrono::nanoseconds>(endT - iterateS).count()*1e-9;
+    auto totalT = chrono::duration_cast<chrono::nanoseconds>(endT - totalSt).count()*1e-9;
+
+    cout << "\nTotal time:" << totalT << " seconds\n"
+        << "Total iterate time:" << iterateT << " seconds\n"
+        << "Total seq time:" << (totalT - iterateT) << " seconds" << endl;
+
+    if(delta > tol)
+        cerr << "error: solution has not converged" << endl;
+
+    finish(g, x.pairs, results, totalT);
+}
+
+/*
+    PageRank by Gauss-Seidel sweeps of a SparseTailArray: the heads, then only the vertices of highest
+    rank, a fraction $MANSEG_SPARSE_TAILS (default 0.01) of them, get tails and are kept at full
+    precision, while the rest stay at their heads. The leading ranks, and their order, are then close
+    to those at full precision, for the memory of the heads and a few tails. The sweeps go on until
+    delta is within tol or stops falling, as the heads of the other vertices limit how far it can go.
+*/
+void prSparseTails(CscGraph& g, std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::nanoseconds>& tmStart, const string& inputFile)
+{
+    auto totalSt = tmStart;
+    auto tmInput = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Reading input: " << tmInput << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+
+    int n = g.numVertices;
+    const vector<int>& start = g.start;
+    const int threads = start.size() - 1;
+    const char* fractionVar = getenv("MANSEG_SPARSE_TAILS");
+    const double fraction = (fractionVar != nullptr && *fractionVar != '\0') ? atof(fractionVar) : 0.01;
+
+    SparseTailArray<> x(n); // pagerank, updated in place
+
+    // first touch by the thread that owns each range, from 1/n or a warm start
+    const vector<double> warm = startingRanks(g);
+    const double oneOverN = 1.0/n;
+    #pragma omp parallel num_threads(threads)
+    {
+        const int nt = omp_get_num_threads();
+        for(int t = omp_get_thread_num(); t < threads; t += nt)
+            for(int i = start[t]; i < start[t + 1]; ++i)
+                x.set(i, warm.empty() ? oneOverN : warm[i]);
+    }
+
+    double delta = 2.0;
+    PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
+
+    ResultsWriter results("omp_pagerank_manseg");
+    results.set("input", inputFile);
+    results.set("vertices", n);
+    results.set("edges", g.numEdges);
+    results.set("threads", threads);
+    results.set("ordering", graphOrderName(g.ordering));
+    results.set("method", "sparse-tails");
+    results.set("numa", getenv("OMP_PLACES") != nullptr ? getenv("OMP_PLACES") : "none");
+    results.set("warm_start", warm.empty() ? "none" : getenv("MANSEG_WARM_START"));
+
+    auto tmInit = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+    cout << "Initialisation: " << tmInit << " seconds" << endl;
+    tmStart = chrono::high_resolution_clock::now();
+    auto iterateS = chrono::high_resolution_clock::now();
+
+    int iter = 0;
+    while(iter < maxIter) // use heads only
+    {
+        MANSEG_TRACE_SCOPE_ARG("heads sweep", "iter", iter + 1);
+        delta = g.sweep(x.heads(), x.heads());
+        ++iter;
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " xnorm=" << parallelKahanSum(x.heads(), 0, n)
+            << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, levelName(PRECISION_HEADS), g.sweepBytes(sizeof(float), sizeof(float)));
+        tmStart = chrono::high_resolution_clock::now();
+
+        if(control.update(delta) != PRECISION_HEADS)
+        {
+            cout << "switching precision at iter " << iter << " (" << control.reasonName() << ")\n";
+            break;
+        }
+    }
+
+    // the leaders by their heads get tails
+    const vector<uint_fast64_t> leaders = topK(x.heads(), n, static_cast<uint_fast64_t>(ceil(fraction * n)));
+    x.promote(leaders.begin(), leaders.end());
+    cout << "promoted " << x.numPromoted() << " vertices: " << x.tailBytes() << " bytes of tails" << endl;
+    results.set("sparse_fraction", fraction);
+    results.set("promoted", (double)x.numPromoted());
+    results.set("tail_bytes", (double)x.tailBytes());
+
+    cout << "\n=========================\nSparse Tails\n=========================" << endl;
+    // the heads of the rest limit delta: stop where it stops falling, as the controller would have
+    PrecisionController<StagnationPolicy> floor(StagnationPolicy(0.25), false);
+    while(iter < maxIter && delta > tol)
+    {
+        MANSEG_TRACE_SCOPE_ARG("sparse tails sweep", "iter", iter + 1);
+        delta = g.sweep(x, x);
+        ++iter;
+
+        auto tmStep = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
+        cout << "iteration " << iter << ": delta=" << delta << " time=" << tmStep << " seconds" << endl;
+        results.iteration(iter, delta, tmStep, "sparse", g.sweepBytes(sizeof(float), sizeof(float)));
+        tmStart = chrono::high_resolution_clock::now();
+        if(floor.update(delta) != PRECISION_HEADS)
+            break;
+    }
+
+    auto endT = chrono::high_resolution_clock::now();
+    auto iterateT = chrono::duration_cast<chrono::nanoseconds>(endT - iterateS).count()*1e-9;
+    auto totalT = chrono::duration_cast<chrono::nanoseconds>(endT - totalSt).count()*1e-9;
+
+    cout << "\nTotal time:" << totalT << " seconds\n"
+        << "Total iterate time:" << iterateT << " seconds\n"
+        << "Total seq time:" << (totalT - iterateT) << " seconds" << endl;
+
+    finish(g, x, results, totalT);
+    x.del();
+}
+
+/*
+    Runs the graphs named in list (one a line) back to back in a BatchRunner: the next graph loads (and
+    its cache is faulted in) on a thread of its own while one solves, and the solves take their arrays
+    from the runner's pool. A graph's "Reading input" is the part of its load the solve before did not
+    hide. Returns the number of graphs that could not be read.
+*/
+template<class Graph>
+int runBatch(const string& list, const function<Graph*(const string&)>& load, const function<void(Graph&, chrono::high_resolution_clock::time_point&, const string&)>& solve)
+{
+    BatchRunner<Graph> batch([&](const string& path)
+    {
+        unique_ptr<Graph> g(load(path));
+        g->populate();
+        return g;
+    }, [&](const BatchJob& job, Graph& g)
+    {
+        cout << "\nInput file: " << job.path << endl;
+        auto tmStart = chrono::high_resolution_clock::now()
+            - chrono::duration_cast<chrono::high_resolution_clock::duration>(chrono::duration<double>(job.waitSeconds));
+        solve(g, tmStart, job.path);
+    });
+    ifstream in(list);
+    string path;
+    while(getline(in, path))
+        if(!path.empty() && path[0] != '#')
+            batch.add(path);
+    if(batch.jobs() == 0)
+    {
+        cerr << "No graphs in " << list << endl;
+        return 1;
+    }
+
+    const size_t solved = batch.run();
+    double loads = 0.0, wait = 0.0;
+    for(size_t k = 0; k < batch.jobs(); ++k)
+    {
+        loads += batch.job(k).loadSeconds;
+        wait += batch.job(k).waitSeconds;
+    }
+    cout << "\nBatch of " << batch.jobs() << " graphs: " << batch.wallSeconds() << " seconds"
+        << "\nSolves: " << batch.solveSeconds() << " seconds"
+        << "\nLoads: " << loads << " seconds, of which not hidden: " << wait << " seconds" << endl;
+    return static_cast<int>(batch.jobs() - solved);
+}
+
+int main(int argc, char** argv)
+{
+    cout << setprecision(16);
+    cerr << setprecision(16);
+
+    if(argc < 4)
+    {
+        cerr << "usage: ./omp_pagerank_manseg <type> <format> <input_file|@list> [none|degree|hub|rcm|gorder] [jacobi|gauss-seidel|sparse-tails]" << endl;
+        return 1;
+    }
+
+    string type = argv[1];
+    string format = argv[2];
+    string inputFile = argv[3];
+    GraphOrder ordering = ORDER_NONE;
+    if(argc > 4 && !parseGraphOrder(argv[4], ordering))
+    {
+        cerr << "Unknown ordering: " << argv[4] << endl;
+        return 1;
+    }
+    const bool gaussSeidel = (argc > 5 && string(argv[5]).compare("gauss-seidel") == 0);
+    const bool sparseTails = (argc > 5 && string(argv[5]).compare("sparse-tails") == 0);
+    if(argc > 5 && !gaussSeidel && !sparseTails && string(argv[5]).compare("jacobi") != 0)
+    {
+        cerr << "Unknown method: " << argv[5] << endl;
+        return 1;
+    }
+
+    const bool bound = parallel::bindTeam();
+
+    cout << "\nType: " << type
+    << "\nFormat: " << format
+    << "\nInput file: " << inputFile
+    << "\nThreads: " << omp_get_max_threads() << (bound ? " (bound)" : "")
+    << "\nOrdering: " << graphOrderName(ordering)
+    << "\nMethod: " << (gaussSeidel ? "gauss-seidel" : sparseTails ? "sparse-tails" : "jacobi")
+    << endl;
+
+    if(format.compare("CSR") != 0 && format.compare("CSC") != 0 && format.compare("COO") != 0)
+    {
+        cerr << "Unknown format: " << format << endl;
+        return 1;
+    }
+    if((gaussSeidel || sparseTails) && format.compare("CSR") == 0)
+    {
+        cerr << "Gauss-Seidel sweeps pull: use CSC or COO" << endl;
+        return 1;
+    }
+
+    const int threads = omp_get_max_threads();
+    if(inputFile[0] == '@' && format.compare("CSR") == 0)
+        return runBatch<CsrGraph>(inputFile.substr(1), [&](const string& path) { return new CsrGraph(type, path, threads, ordering); },
+            [](CsrGraph& g, chrono::high_resolution_clock::time_point& tmStart, const string& path) { pr(g, tmStart, path); });
+    else if(inputFile[0] == '@')
+        return runBatch<CscGraph>(inputFile.substr(1), [&](const string& path) { return new CscGraph(type, format, path, threads, ordering); },
+            [&](CscGraph& g, chrono::high_resolution_clock::time_point& tmStart, const string& path)
+            {
+                if(gaussSeidel)
+                    prGaussSeidel(g, tmStart, path);
+                else if(sparseTails)
+                    prSparseTails(g, tmStart, path);
+                else
+                    pr(g, tmStart, path);
+            });
+
+    auto tmStart = chrono::high_resolution_clock::now();
+    if(format.compare("CSR") == 0)
+    {
+        CsrGraph g(type, inputFile, threads, ordering);
+        pr(g, tmStart, inputFile);
+    }
+    else
+    {
+        CscGraph g(type, format, inputFile, threads, ordering);
+        if(gaussSeidel)
+            prGaussSeidel(g, tmStart, inputFile);
+        else if(sparseTails)
+            prSparseTails(g, tmStart, inputFile);
+        else
+            pr(g, tmStart, inputFile);
+    }
+
+    return 0;
+}
@@ -10,7 +10,8 @@
 #include <regex>
 #include <cmath>
 
-#include "quicksort.h"
+#include "graph_loader.h"
+#include "../../../manseglib_results.hpp"
 
 using namespace std;
 
@@ -434,32 +435,14 @@ public:
         for(int i = 0; i < numEdges; ++i)
             f >> src[i] >> dst[i];
 
-        // perform sort on dst, so we can create a CSC representation
-        quicksort_pair(src, dst, 0, (numEdges-1));
-
-        index[0] = 0; // first index
-        int indexPos = 0;
-        int edgeCounter = 0;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            while(indexPos < dst[i])
-                index[++indexPos] = (edgeCounter);
-            ++edgeCounter;
-        }
-
-        while(indexPos < (numVertices + 1))
-            index[++indexPos] = numEdges;
-
-        source = src;
-
-        // not super pretty but we need this for the same ordering as
-        // you would get with CSR/COO, otherwise deltas/pagerank values
-        // end up being off due to error
-        for(int i = 0; i < (numVertices); ++i)
-            quicksort(source, index[i], index[i+1]-1);
+        // grouped by destination, each column's sources in increasing order, so that deltas/pagerank
+        // values come out as they would with CSR/COO
+        source = new int[numEdges];
+        groupColumns(numVertices, numEdges, src, dst, index, source);
 
         f.close();
 
+        delete[] src;
         delete[] dst;
     }
 
@@ -606,6 +589,9 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     if(delta > tol)
         cerr << "error: solution has not converged" << endl;
 
+    // the reference ranks for msa_pagerank's $MANSEG_REFERENCE
+    ManSeg::writeValues(getenv("MANSEG_VALUES"), x, n);
+
     // write to file
     // string outPath = "";
     // for(int i = inputFile.length()-1; i >= 0; --i)
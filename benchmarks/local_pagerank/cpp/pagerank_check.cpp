@@ -9,7 +9,8 @@
 #include <iterator>
 #include <regex>
 
-#include "quicksort.h"
+#include "graph_loader.h"
+#include "../../../manseglib_rank.hpp"
 
 using namespace std;
 
@@ -416,32 +417,14 @@ public:
         for(int i = 0; i < numEdges; ++i)
             f >> src[i] >> dst[i];
 
-        // perform sort on dst, so we can create a CSC representation
-        quicksort_pair(src, dst, 0, (numEdges-1));
-
-        index[0] = 0; // first index
-        int indexPos = 0;
-        int edgeCounter = 0;
-        for(int i = 0; i < numEdges; ++i)
-        {
-            while(indexPos < dst[i])
-                index[++indexPos] = (edgeCounter);
-            ++edgeCounter;
-        }
-
-        while(indexPos < (numVertices + 1))
-            index[++indexPos] = numEdges;
-
-        source = src;
-
-        // not super pretty but we need this for the same ordering as
-        // you would get with CSR/COO, otherwise deltas/pagerank values
-        // end up being off due to error
-        for(int i = 0; i < (numVertices); ++i)
-            quicksort(source, index[i], index[i+1]-1);
+        // grouped by destination, each column's sources in increasing order, so that deltas/pagerank
+        // values come out as they would with CSR/COO
+        source = new int[numEdges];
+        groupColumns(numVertices, numEdges, src, dst, index, source);
 
         f.close();
 
+        delete[] src;
         delete[] dst;
     }
 
@@ -523,9 +506,33 @@ void readPageRankValues(double* x, int n, string file)
     f.close();
 }
 
+/*
+    Compares the leaders of the values being checked with those of the values iterated from them:
+    how many of the top k they share, and how far down the two rankings agree.
+*/
+void compareLeaders(const double* checked, const double* x, const int& n, const int& k)
+{
+    vector<uint_fast64_t> a = ManSeg::topK(checked, n, k);
+    vector<uint_fast64_t> b = ManSeg::topK(x, n, k);
+
+    vector<uint_fast64_t> sa(a), sb(b);
+    sort(sa.begin(), sa.end());
+    sort(sb.begin(), sb.end());
+    vector<uint_fast64_t> shared;
+    set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(shared));
+
+    size_t agree = 0;
+    while(agree < a.size() && a[agree] == b[agree])
+        ++agree;
+
+    cout << "\ntop " << a.size() << ": " << shared.size() << " shared, ranking agrees for the first " << agree << endl;
+    for(size_t i = 0; i < min<size_t>(10, a.size()); ++i)
+        cout << (i + 1) << ": " << a[i] << " " << checked[a[i]] << (a[i] == b[i] ? "" : "  (now " + to_string(b[i]) + ")") << "\n";
+}
+
 template<class SparseMatrix>
 void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::nanoseconds>& tmStart, 
-    string& inputFile, string& outputFile)
+    string& inputFile, string& outputFile, int topCount)
 {
     auto totalSt = tmStart;
     auto tmInput = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
@@ -551,6 +558,7 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     matrix->calculateOutDegree(outdeg);
 
     readPageRankValues(x, n, outputFile);
+    vector<double> checked(x, x + n); // the values being checked, as read
 
     auto tmInit = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - tmStart).count()*1e-9;
     cout << "Initialisation: " << tmInit << " seconds" << endl;
@@ -593,6 +601,8 @@ void pr(SparseMatrix* matrix, std::chrono::time_point<std::chrono::_V2::system_c
     if(delta > tol)
         cerr << "error: solution has not converged" << endl;
 
+    compareLeaders(checked.data(), x, n, topCount);
+
     // write to file
     string outPath = "";
     for(int i = inputFile.length()-1; i >= 0; --i)
@@ -621,7 +631,7 @@ int main(int argc, char** argv)
 
     if(argc < 5)
     {
-        cerr << "usage: ./pagerank <type> <format> <input_file> <output_file>" << endl;
+        cerr << "usage: ./pagerank <type> <format> <input_file> <output_file> [top_k]" << endl;
         return 1;
     }
 
@@ -629,6 +639,7 @@ int main(int argc, char** argv)
     string format = argv[2];
     string inputFile = argv[3];
     string outputFile = argv[4];
+    int topCount = (argc > 5) ? atoi(argv[5]) : 100; // leaders compared
 
     cout << "Type: " << type
     << "\nFormat: " << format 
@@ -650,17 +661,17 @@ int main(int argc, char** argv)
         if(format.compare("CSR") == 0)
         {
             snap_csr = new SparseMatrix<SNAP_CSR>(inputFile);
-            pr(snap_csr, tmStart, inputFile, outputFile);
+            pr(snap_csr, tmStart, inputFile, outputFile, topCount);
         }
         else if(format.compare("CSC") == 0)
         {
             snap_csc = new SparseMatrix<SNAP_CSC>(inputFile);
-            pr(snap_csc, tmStart, inputFile, outputFile);
+            pr(snap_csc, tmStart, inputFile, outputFile, topCount);
         }
         else if(format.compare("COO") == 0)
         {
             snap_coo = new SparseMatrix<SNAP_COO>(inputFile);
-            pr(snap_coo, tmStart, inputFile, outputFile);
+            pr(snap_coo, tmStart, inputFile, outputFile, topCount);
         }
         else
         {
@@ -674,17 +685,17 @@ int main(int argc, char** argv)
         if(format.compare("CSR") == 0)
         {
             csr = new SparseMatrix<CSR>(inputFile);
-            pr(csr, tmStart, inputFile, outputFile);
+            pr(csr, tmStart, inputFile, outputFile, topCount);
         }
         else if(format.compare("CSC") == 0)
         {
             csc = new SparseMatrix<CSC>(inputFile);
-            pr(csc, tmStart, inputFile, outputFile);
+            pr(csc, tmStart, inputFile, outputFile, topCount);
         }
         else if(format.compare("COO") == 0)
         {
             coo = new SparseMatrix<COO>(inputFile);
-            pr(coo, tmStart, inputFile, outputFile);
+            pr(coo, tmStart, inputFile, outputFile, topCount);
         }
         else
         {
@@ -1,20 +1,16 @@
 #ifndef __MATR_H__
 #define __MATR_H__
 
-#include "manseglib.hpp"
+#include "../manseglib_matrix.hpp"
 
 class matr_
 {
 public:
     matr_(int n)
-        : n(n)
-    {
-        v = new ManSeg::ManSegArray[n];
-        for(int i = 0; i < n; ++i)
-            v[i].alloc(n);
-    }
+        : v(n, n), n(n)
+    {}
 
-    ManSeg::ManSegArray* v;
+    ManSeg::ManSegMatrix v;
 
     void fill(double* x);
     void mm(double* x, double* y);
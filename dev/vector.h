@@ -1,16 +1,22 @@
 #ifndef __VEC_H__
 #define __VEC_H__
 
-#include "manseglib.hpp"
+#include "../manseglib.hpp"
 #include "matrix.h"
 
 double prod(matr_* x, int n)
 {
     double p = 0.;
 
+    double row[ManSeg::MatrixTile];
     for(int i = 0; i < n; ++i)
-        for(int j = 0; j < n; ++j)
-            p += (x->v[i].pairs[j] * x->v[i].pairs[j]);
+        for(int j = 0; j < n; j += ManSeg::MatrixTile)
+        {
+            const int m = std::min<int>(ManSeg::MatrixTile, n - j);
+            x->v.pairs.row(i).readBlock(j, m, row);
+            for(int k = 0; k < m; ++k)
+                p += row[k] * row[k];
+        }
 
     return p;
 }
@@ -37,18 +37,236 @@
 #define __MANSEG_LIB_H__
 
 #include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "manseglib_trace.hpp"
+#include "manseglib_traffic.hpp"
+#include "manseglib_error.hpp"
+#include "manseglib_memory.hpp"
+#include "manseglib_parallel.hpp"
+
+/*
+    Target detection. On x86 the SSE/AVX intrinsics are used; on AArch64 (GCC, Clang or MSVC),
+    NEON, plus SVE gathers when built with SVE enabled. Anything else uses portable scalar code,
+    which MANSEG_PORTABLE also forces on x86 (e.g. to test it).
+*/
+#if defined(MANSEG_PORTABLE)
+#elif defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MANSEG_X86
 #include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MANSEG_NEON
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_SVE)
+#define MANSEG_SVE
+#include <arm_sve.h>
+#endif
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+#endif
 
 namespace ManSeg
 {
     // internal representation of double, so it can be easily manipulated
     typedef uint_fast64_t doublerep;
 
-    /* Highest achievable precision with a single segment - i.e. TwoSegArray<false> */
-    constexpr double MaxSingleSegmentPrecision = 1e-6;
-    /* decimal precision: num_mantissa_bits*log10(2) = 6~ */
-	/* so we have approximately 6 digits of decimal precision */
-    constexpr double AdaptivePrecisionBound = 5e-5;
+    // 10^e, exact for 0 <= e <= 22
+    constexpr double decimalPower(const int e) { return e <= 0 ? 1.0 : 10.0 * decimalPower(e - 1); }
+
+    /*
+        Precision constants for a head segment of HeadBits bits, i.e. the sign bit, full 11 bit exponent
+        and HeadBits - 12 bits of mantissa.
+        decimal precision: num_mantissa_bits*log10(2), so a 32 bit head has approximately 6 digits.
+    */
+    template<int HeadBits>
+    struct SegmentPrecision
+    {
+        static_assert(HeadBits > 12 && HeadBits <= 64, "head must hold the sign, exponent and some mantissa");
+
+        static constexpr int mantissaBits = HeadBits - 12;
+        static constexpr int decimalDigits = static_cast<int>(mantissaBits * 0.30102999566398120);
+        /* highest achievable precision with the head segment alone */
+        static constexpr double maxPrecision = 1.0 / decimalPower(decimalDigits);
+        /* suggested bound on the change between iterations at which to switch to higher precision */
+        static constexpr double adaptiveBound = 5.0 / decimalPower(decimalDigits - 1);
+    };
+
+    /* Highest achievable precision with a single segment - i.e. TwoSegArray<false> (1e-6) */
+    constexpr double MaxSingleSegmentPrecision = SegmentPrecision<32>::maxPrecision;
+	/* so we have approximately 6 digits of decimal precision (5e-5) */
+    constexpr double AdaptivePrecisionBound = SegmentPrecision<32>::adaptiveBound;
+
+    /*
+        Element conversions between doubles and segments, the only platform specific code outside of
+        the bulk kernels. They are either SSE casts (MANSEG_ELEMENT_SSE), so values never leave the xmm
+        registers, or the 64 bits are split and joined with memcpy and shifts (MANSEG_ELEMENT_SHIFTS),
+        which compilers reduce to register moves. None of them rely on compiler vector extensions.
+        In bench/conversion_bench the shifts are as fast as the casts at DRAM sizes and 5-20% faster on
+        cache resident arrays (GCC 12, AVX-512 Xeon), so they are the default on every target;
+        define MANSEG_ELEMENT_SSE for the casts on x86.
+    */
+#if !defined(MANSEG_ELEMENT_SSE) && !defined(MANSEG_ELEMENT_SHIFTS)
+#define MANSEG_ELEMENT_SHIFTS
+#endif
+#if defined(MANSEG_ELEMENT_SSE) && !defined(MANSEG_X86)
+#error "MANSEG_ELEMENT_SSE requires an x86 target"
+#endif
+
+    // double with head as its upper 32 bits, and zero lower 32 bits
+    inline double headToDouble(const float& head)
+    {
+#if defined(MANSEG_ELEMENT_SSE)
+        return _mm_cvtsd_f64(_mm_castps_pd(_mm_set_ps(0.0f, 0.0f, head, 0.0f)));
+#else
+        uint32_t h;
+        memcpy(&h, &head, sizeof(float));
+        const uint64_t bits = static_cast<uint64_t>(h) << 32;
+        double d;
+        memcpy(&d, &bits, sizeof(double));
+        return d;
+#endif
+    }
+
+    // double made up of head (upper 32 bits) and tail (lower 32 bits)
+    inline double segmentsToDouble(const float& head, const float& tail)
+    {
+#if defined(MANSEG_ELEMENT_SSE)
+        return _mm_cvtsd_f64(_mm_castps_pd(_mm_set_ps(0.0f, 0.0f, head, tail)));
+#else
+        uint32_t h, t;
+        memcpy(&h, &head, sizeof(float));
+        memcpy(&t, &tail, sizeof(float));
+        const uint64_t bits = (static_cast<uint64_t>(h) << 32) | t;
+        double d;
+        memcpy(&d, &bits, sizeof(double));
+        return d;
+#endif
+    }
+
+    // upper 32 bits of d, i.e. its head truncated
+    inline float headOf(const double& d)
+    {
+#if defined(MANSEG_ELEMENT_SSE)
+        const __m128 seg_v = _mm_castpd_ps(_mm_set_sd(d));
+        return _mm_cvtss_f32(_mm_shuffle_ps(seg_v, seg_v, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(double));
+        const uint32_t h = static_cast<uint32_t>(bits >> 32);
+        float f;
+        memcpy(&f, &h, sizeof(float));
+        return f;
+#endif
+    }
+
+    // *head = upper 32 bits of d, *tail = lower 32 bits of d
+    inline void splitSegment(const double& d, float* head, float* tail)
+    {
+#if defined(MANSEG_ELEMENT_SSE)
+        const __m128 seg_v = _mm_castpd_ps(_mm_set_sd(d));
+        *tail = _mm_cvtss_f32(seg_v);
+        *head = _mm_cvtss_f32(_mm_shuffle_ps(seg_v, seg_v, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(double));
+        const uint32_t h = static_cast<uint32_t>(bits >> 32);
+        const uint32_t t = static_cast<uint32_t>(bits);
+        memcpy(head, &h, sizeof(float));
+        memcpy(tail, &t, sizeof(float));
+#endif
+    }
+
+    /*
+        Atomics used by atomicAdd and BlockAdaptiveArray: the GCC/Clang __atomic builtins, or the
+        MSVC Interlocked intrinsics (which are full barriers, so stronger than needed).
+    */
+    template<typename T>
+    inline T atomicLoadRelaxed(const T* word)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return *static_cast<const volatile T*>(word);
+#else
+        return __atomic_load_n(word, __ATOMIC_RELAXED);
+#endif
+    }
+
+    // if *word == expected, sets it to desired and returns true; otherwise expected is updated to *word
+    inline bool atomicCompareExchange(uint32_t* word, uint32_t& expected, const uint32_t& desired)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        const uint32_t old = static_cast<uint32_t>(_InterlockedCompareExchange(reinterpret_cast<volatile long*>(word),
+            static_cast<long>(desired), static_cast<long>(expected)));
+        const bool swapped = (old == expected);
+        expected = old;
+        return swapped;
+#else
+        return __atomic_compare_exchange_n(word, &expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+    }
+
+    inline bool atomicCompareExchange(uint64_t* word, uint64_t& expected, const uint64_t& desired)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        const uint64_t old = static_cast<uint64_t>(_InterlockedCompareExchange64(reinterpret_cast<volatile long long*>(word),
+            static_cast<long long>(desired), static_cast<long long>(expected)));
+        const bool swapped = (old == expected);
+        expected = old;
+        return swapped;
+#else
+        return __atomic_compare_exchange_n(word, &expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#endif
+    }
+
+    inline void atomicIncrementRelaxed(uint_fast64_t* word)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        _InterlockedIncrement64(reinterpret_cast<volatile long long*>(word));
+#else
+        __atomic_add_fetch(word, 1, __ATOMIC_RELAXED);
+#endif
+    }
+
+    // spinlock acquire/release on a word that is 0 when free
+    inline bool tryLock(volatile int* word)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _InterlockedExchange(reinterpret_cast<volatile long*>(word), 1) == 0;
+#else
+        return __atomic_exchange_n(word, 1, __ATOMIC_ACQUIRE) == 0;
+#endif
+    }
+
+    inline void unlock(volatile int* word)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        _InterlockedExchange(reinterpret_cast<volatile long*>(word), 0);
+#else
+        __atomic_store_n(word, 0, __ATOMIC_RELEASE);
+#endif
+    }
+
+    // hint to the CPU that this is a spin-wait loop
+    inline void spinPause()
+    {
+#if defined(MANSEG_X86)
+        _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        __yield();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__("yield");
+#endif
+    }
 
     /*
         Class representing the "head" segment of a double.
@@ -65,10 +283,10 @@ namespace ManSeg
             :head(head)
         {}
 
+        // a copy refers to the same head
         Head(const Head& o)
-        {
-            *head = *o.head;
-        }
+            :head(o.head)
+        {}
 
         template<typename T>
         inline Head& operator=(const T& rhs);
@@ -84,12 +302,7 @@ namespace ManSeg
         template<typename T>
         double operator/=(const T& rhs);
 
-        operator double() const
-        {
-            __m128 head_v = _mm_set_ps(0.0f, 0.0f, *head, 0.0f);
-            __m128d head_vd = _mm_castps_pd(head_v);
-            return head_vd[0];
-        }
+        operator double() const { MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float)); return headToDouble(*head); }
 
         float* head;
     };
@@ -110,10 +323,8 @@ namespace ManSeg
         {}
 
         Pair(const Pair& o)
-        {
-            *head = *o.head;
-            *tail = *o.tail;
-        }
+            :head(o.head), tail(o.tail)
+        {}
 
 		Pair(const Head& o)
 		{
@@ -135,512 +346,2609 @@ namespace ManSeg
         template<typename T>
         double operator/=(const T& rhs);
 
-        operator double() const
-        {
-            __m128 seg_v = _mm_set_ps(0.0f, 0.0f, *head, *tail);
-            __m128d seg_vd = _mm_castps_pd(seg_v);
-            return seg_vd[0];
-        }
+        operator double() const { MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double)); return segmentsToDouble(*head, *tail); }
 
         float* head;
         float* tail;
     };
 
     /*
-        Array type class for performing operations on double values, conceptually split into two 32 bit segments - "head" and "tail".
-        The user is required to manually clean up memory after allocation using the del() function, as the deconstructor does not handle this. This is due to the
-        way that shifting from low to high precision is handled, by just reading the extra segments in the <true> variant.
-        
-        <false> specialisation - Operations performed on values in the array only modify the "head" segment (i.e. the first 32 bits of a double value) unless specified otherwise.
-        <true> specialisation - Operations performed on values in the array are exactly the same as standard IEEE-754 doubles, but a bit slower due to combining of head and tail segments.
+        Rounding applied when a double is narrowed to its head segment.
+        ROUND_TRUNCATE keeps the upper 32 bits (rounds toward zero) and is what Head::operator= does;
+        ROUND_NEAREST rounds to the nearest head, ties to even;
+        ROUND_STOCHASTIC rounds up with probability proportional to the discarded bits, so that
+        the expected value of the head is the double being written.
+        Infinities and NaNs are never rounded.
     */
-    template<bool useTail>
-    class TwoSegArray; // explicitly specialise this below.
+    enum RoundingMode { ROUND_TRUNCATE, ROUND_NEAREST, ROUND_STOCHASTIC };
+
+    // per-thread state of the xorshift generator used by ROUND_STOCHASTIC
+    inline uint64_t& stochasticState()
+    {
+        static thread_local uint64_t state = 0x9E3779B97F4A7C15ULL ^ reinterpret_cast<uintptr_t>(&state);
+        return state;
+    }
+
+    inline uint64_t nextStochastic()
+    {
+        uint64_t& x = stochasticState();
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+
+    template<RoundingMode mode>
+    inline uint64_t roundHeadBits(const uint64_t& bits)
+    {
+        if(mode == ROUND_TRUNCATE || (bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL)
+            return bits;
+        if(mode == ROUND_NEAREST)
+            return bits + 0x7FFFFFFFULL + ((bits >> 32) & 1);
+        return bits + (nextStochastic() & 0xFFFFFFFFULL);
+    }
+
+    // largest error of narrowing d to a head according to mode, relative to |d| (see manseglib_error.hpp)
+    template<RoundingMode mode>
+    constexpr double headRoundoff()
+    {
+        return mode == ROUND_NEAREST ? ErrorBound::nearest : ErrorBound::truncation;
+    }
+
+    // head segment of d, rounded according to mode
+    template<RoundingMode mode>
+    inline float roundToHead(const double& d)
+    {
+        MANSEG_ERROR_ADD(headRoundoff<mode>() * ErrorBound::magnitude(d));
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(double));
+        const uint32_t head = static_cast<uint32_t>(roundHeadBits<mode>(bits) >> 32);
+        float f;
+        memcpy(&f, &head, sizeof(float));
+        return f;
+    }
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bit_cast)
+#define MANSEG_HAS_BIT_CAST
+#endif
+#endif
+#if !defined(MANSEG_HAS_BIT_CAST) && defined(_MSC_VER) && _MSC_VER >= 1927
+#define MANSEG_HAS_BIT_CAST
+#endif
+    // conversions of h32 and seg64 are constexpr where the compiler has a constexpr bit cast
+#if defined(MANSEG_HAS_BIT_CAST)
+#define MANSEG_BIT_CONSTEXPR constexpr
+#else
+#define MANSEG_BIT_CONSTEXPR
+#endif
+
+    template<typename To, typename From>
+    MANSEG_BIT_CONSTEXPR inline To bitCast(const From& from)
+    {
+#if defined(MANSEG_HAS_BIT_CAST)
+        return __builtin_bit_cast(To, from);
+#else
+        To to;
+        memcpy(&to, &from, sizeof(To));
+        return to;
+#endif
+    }
 
     /*
-        Specialisation of TwoSegArray.
-        User is required to manage de-allocation of memory manually, using the del()
-        function, as the deconstructor does not free this space.
-        Operations performed on values in the array are exactly the same as standard IEEE-754 doubles, but a bit slower due to combining of head and tail segments.
+        Value types for the segments, where Head and Pair are proxies for segments in arrays: h32 is
+        the bits of a head, and seg64 those of a head and a tail. They are trivially copyable and as
+        large as their bits, so they can be kept in registers, stored in any container (e.g. Ligra's
+        mmap_ptr<h32>), and used with std::atomic or a CAS on the word.
+        Arithmetic is in double. Between two h32 the result is truncated back to an h32, as float
+        arithmetic gives a float, and between two seg64 it is exact; anything else (an h32 and a double,
+        or an h32 and a seg64) is a double. The constructors are explicit, so that mixed expressions are
+        not ambiguous: assigning a double to an h32 truncates it, as Head::operator= does, and
+        h32::round<mode> rounds it.
+        Ligra's writeAdd and CAS copy through volatile temporaries, so both can be read from and
+        assigned to volatile objects.
+    */
+    struct h32
+    {
+        /* tag for the constructor from the bits */
+        struct Bits {};
 
-		Note: the class deconstructor does not free space automatically, so use the delSegments and del functions to clean up.
+        uint32_t bits;
+
+        h32() = default;
+        MANSEG_BIT_CONSTEXPR explicit h32(const double& d) :bits(static_cast<uint32_t>(bitCast<uint64_t>(d) >> 32)) {}
+        constexpr h32(const uint32_t& bits, Bits) :bits(bits) {}
+        explicit h32(const Head& h) :bits(bitCast<uint32_t>(*h.head)) {}
+        // copies of volatile objects (a template, so h32 stays trivially copyable)
+        template<class V, typename std::enable_if<std::is_same<V, h32>::value, int>::type = 0>
+        h32(const volatile V& o) :bits(o.bits) {}
+
+        template<class V, typename std::enable_if<std::is_same<V, h32>::value, int>::type = 0>
+        void operator=(const V& o) volatile { bits = o.bits; }
+
+        h32& operator=(const double& d) { return *this = h32(d); }
+
+        /* the head of d, rounded according to mode */
+        template<RoundingMode mode>
+        static h32 round(const double& d) { return h32(bitCast<uint32_t>(roundToHead<mode>(d)), Bits()); }
+
+        MANSEG_BIT_CONSTEXPR operator double() const { return bitCast<double>(static_cast<uint64_t>(bits) << 32); }
+
+        /* the head as the float with the same bits, as TwoSegArray<false> stores it */
+        MANSEG_BIT_CONSTEXPR float asFloat() const { return bitCast<float>(bits); }
+
+        h32& operator+=(const double& rhs) { return *this = h32(static_cast<double>(*this) + rhs); }
+        h32& operator-=(const double& rhs) { return *this = h32(static_cast<double>(*this) - rhs); }
+        h32& operator*=(const double& rhs) { return *this = h32(static_cast<double>(*this) * rhs); }
+        h32& operator/=(const double& rhs) { return *this = h32(static_cast<double>(*this) / rhs); }
+
+        // negation only flips the sign bit, so it is exact
+        friend constexpr h32 operator-(h32 a) { return h32(a.bits ^ 0x80000000u, Bits()); }
+
+        friend MANSEG_BIT_CONSTEXPR h32 operator+(h32 a, h32 b) { return h32(static_cast<double>(a) + static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR h32 operator-(h32 a, h32 b) { return h32(static_cast<double>(a) - static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR h32 operator*(h32 a, h32 b) { return h32(static_cast<double>(a) * static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR h32 operator/(h32 a, h32 b) { return h32(static_cast<double>(a) / static_cast<double>(b)); }
+    };
+
+    struct seg64
+    {
+        uint64_t bits;
+
+        seg64() = default;
+        MANSEG_BIT_CONSTEXPR explicit seg64(const double& d) :bits(bitCast<uint64_t>(d)) {}
+        constexpr explicit seg64(const h32& head, const uint32_t& tail = 0) :bits((static_cast<uint64_t>(head.bits) << 32) | tail) {}
+        explicit seg64(const Pair& p) :bits((static_cast<uint64_t>(bitCast<uint32_t>(*p.head)) << 32) | bitCast<uint32_t>(*p.tail)) {}
+        template<class V, typename std::enable_if<std::is_same<V, seg64>::value, int>::type = 0>
+        seg64(const volatile V& o) :bits(o.bits) {}
+
+        template<class V, typename std::enable_if<std::is_same<V, seg64>::value, int>::type = 0>
+        void operator=(const V& o) volatile { bits = o.bits; }
+
+        seg64& operator=(const double& d) { return *this = seg64(d); }
+
+        MANSEG_BIT_CONSTEXPR operator double() const { return bitCast<double>(bits); }
+
+        constexpr h32 head() const { return h32(static_cast<uint32_t>(bits >> 32), h32::Bits()); }
+        constexpr uint32_t tail() const { return static_cast<uint32_t>(bits); }
+
+        seg64& operator+=(const double& rhs) { return *this = seg64(static_cast<double>(*this) + rhs); }
+        seg64& operator-=(const double& rhs) { return *this = seg64(static_cast<double>(*this) - rhs); }
+        seg64& operator*=(const double& rhs) { return *this = seg64(static_cast<double>(*this) * rhs); }
+        seg64& operator/=(const double& rhs) { return *this = seg64(static_cast<double>(*this) / rhs); }
+
+        friend constexpr seg64 operator-(seg64 a) { return seg64(-a.head(), a.tail()); }
+
+        friend MANSEG_BIT_CONSTEXPR seg64 operator+(seg64 a, seg64 b) { return seg64(static_cast<double>(a) + static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR seg64 operator-(seg64 a, seg64 b) { return seg64(static_cast<double>(a) - static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR seg64 operator*(seg64 a, seg64 b) { return seg64(static_cast<double>(a) * static_cast<double>(b)); }
+        friend MANSEG_BIT_CONSTEXPR seg64 operator/(seg64 a, seg64 b) { return seg64(static_cast<double>(a) / static_cast<double>(b)); }
+    };
+
+    /*
+        Instruction set used by the bulk kernels below.
+        With GCC or Clang on x86, every kernel is compiled for SSE2, AVX2 and AVX-512 (F and CD) through
+        target attributes, and the variant is picked at run time from the CPU, so one binary (even one
+        built without -mavx2) runs the widest path each node supports. Define MANSEG_NO_DISPATCH to
+        pick the variant at compile time from the -m flags instead.
+        Other targets only have the baseline SIMD_SSE2 level, which is NEON (and SVE gathers) on AArch64,
+        and scalar code elsewhere.
     */
-    template<>
-    class TwoSegArray<true>
+    enum SimdLevel { SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+
+#if !defined(MANSEG_NO_DISPATCH) && defined(__GNUC__) && defined(MANSEG_X86)
+#define MANSEG_DISPATCH
+#define MANSEG_TARGET_AVX2 __attribute__((target("avx2")))
+#define MANSEG_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512cd")))
+#else
+#define MANSEG_TARGET_AVX2
+#define MANSEG_TARGET_AVX512
+#endif
+#if defined(MANSEG_DISPATCH) || (defined(MANSEG_X86) && defined(__AVX2__))
+#define MANSEG_HAS_AVX2
+#endif
+#if defined(MANSEG_DISPATCH) || (defined(MANSEG_X86) && defined(__AVX512F__) && defined(__AVX512CD__))
+#define MANSEG_HAS_AVX512
+#endif
+
+    // widest level the CPU supports (without dispatch, the widest the build was compiled for)
+    inline SimdLevel detectSimdLevel()
     {
-    public:
-        TwoSegArray() 
-		{
-			heads = nullptr;
-			tails = nullptr;
-		}
+#if defined(MANSEG_DISPATCH)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd"))
+            return SIMD_AVX512;
+        if(__builtin_cpu_supports("avx2"))
+            return SIMD_AVX2;
+        return SIMD_SSE2;
+#elif defined(MANSEG_HAS_AVX512)
+        return SIMD_AVX512;
+#elif defined(MANSEG_HAS_AVX2)
+        return SIMD_AVX2;
+#else
+        return SIMD_SSE2;
+#endif
+    }
+
+    inline SimdLevel& currentSimdLevel()
+    {
+        static SimdLevel level = detectSimdLevel();
+        return level;
+    }
+
+    /* level the bulk kernels currently run at */
+    inline SimdLevel simdLevel() { return currentSimdLevel(); }
+
+    /*
+        Limits the bulk kernels to at most level (e.g. to compare the paths on one machine),
+        returning the level now in use; a level above what the CPU supports is lowered to it.
+        Not thread safe, so call it before any parallel region uses the kernels.
+    */
+    inline SimdLevel setSimdLevel(const SimdLevel& level)
+    {
+        currentSimdLevel() = std::min(level, detectSimdLevel());
+        return currentSimdLevel();
+    }
+
+    /*
+        Arithmetic of the kernels that compute on heads alone (see stencil5): in double, as the heads
+        are widened to, or in float where headsFitFloat says the block's heads and the values computed
+        from them fit one, twice as many lanes to a vector. The float path rounds its intermediate sums
+        to 24 bits rather than 53, so a result can differ from the double path's by up to a unit in the
+        last place of the head of its largest term (more than that relative to a result that cancels);
+        it is opt in for that reason. Not thread safe, as setSimdLevel.
+    */
+    enum HeadsArithmetic { HEADS_DOUBLE, HEADS_FLOAT };
+
+    inline HeadsArithmetic& currentHeadsArithmetic()
+    {
+        static HeadsArithmetic arithmetic = HEADS_DOUBLE;
+        return arithmetic;
+    }
+
+    inline HeadsArithmetic headsArithmetic() { return currentHeadsArithmetic(); }
+    inline void setHeadsArithmetic(const HeadsArithmetic& arithmetic) { currentHeadsArithmetic() = arithmetic; }
 
-        TwoSegArray(const uint_fast64_t& length)
+#if defined(MANSEG_HAS_AVX2)
+    // rounds the head of 4 doubles (as 64-bit integers) according to mode; rng is a 4 lane xorshift state
+    template<RoundingMode mode>
+    MANSEG_TARGET_AVX2 inline __m256i roundHeadBits(const __m256i& bits, __m256i& rng)
+    {
+        if(mode == ROUND_TRUNCATE)
+            return bits;
+
+        const __m256i expMask = _mm256_set1_epi64x(0x7FF0000000000000LL);
+        const __m256i lowMask = _mm256_set1_epi64x(0xFFFFFFFFLL);
+        __m256i rounded;
+        if(mode == ROUND_NEAREST)
+        {
+            __m256i lsb = _mm256_and_si256(_mm256_srli_epi64(bits, 32), _mm256_set1_epi64x(1));
+            rounded = _mm256_add_epi64(bits, _mm256_add_epi64(_mm256_set1_epi64x(0x7FFFFFFFLL), lsb));
+        }
+        else
         {
-            heads = new float[length];
-            tails = new float[length] (); // initially zero tails array
+            rng = _mm256_xor_si256(rng, _mm256_slli_epi64(rng, 13));
+            rng = _mm256_xor_si256(rng, _mm256_srli_epi64(rng, 7));
+            rng = _mm256_xor_si256(rng, _mm256_slli_epi64(rng, 17));
+            rounded = _mm256_add_epi64(bits, _mm256_and_si256(rng, lowMask));
         }
+        // leave infinities and NaNs alone
+        __m256i special = _mm256_cmpeq_epi64(_mm256_and_si256(bits, expMask), expMask);
+        return _mm256_blendv_epi8(rounded, bits, special);
+    }
+#endif
 
-        TwoSegArray(float* heads, float* tails)
-            :heads(heads), tails(tails)
-        {}
+#if defined(MANSEG_HAS_AVX512)
+    // as above, for 8 doubles
+    template<RoundingMode mode>
+    MANSEG_TARGET_AVX512 inline __m512i roundHeadBits(const __m512i& bits, __m512i& rng)
+    {
+        if(mode == ROUND_TRUNCATE)
+            return bits;
 
-        ~TwoSegArray() { }
+        const __m512i expMask = _mm512_set1_epi64(0x7FF0000000000000LL);
+        __m512i rounded;
+        if(mode == ROUND_NEAREST)
+        {
+            __m512i lsb = _mm512_and_si512(_mm512_srli_epi64(bits, 32), _mm512_set1_epi64(1));
+            rounded = _mm512_add_epi64(bits, _mm512_add_epi64(_mm512_set1_epi64(0x7FFFFFFFLL), lsb));
+        }
+        else
+        {
+            rng = _mm512_xor_si512(rng, _mm512_slli_epi64(rng, 13));
+            rng = _mm512_xor_si512(rng, _mm512_srli_epi64(rng, 7));
+            rng = _mm512_xor_si512(rng, _mm512_slli_epi64(rng, 17));
+            rounded = _mm512_add_epi64(bits, _mm512_and_si512(rng, _mm512_set1_epi64(0xFFFFFFFFLL)));
+        }
+        __mmask8 special = _mm512_cmpeq_epi64_mask(_mm512_and_si512(bits, expMask), expMask);
+        return _mm512_mask_blend_epi64(special, rounded, bits);
+    }
+#endif
 
-        Pair operator[](const uint_fast64_t& id)
+    /*
+        SIMD variants of the bulk kernels. Each processes a prefix of its n elements and returns its
+        length; the AVX-512 variants hand the rest to the AVX2 ones, and the kernels finish with the
+        scalar loop. A 512-bit register holds 16 heads, or 8 doubles.
+    */
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 inline uint_fast64_t widenHeadsAVX2(const float* heads, const uint_fast64_t& n, double* out)
         {
-            return Pair(&heads[id], &tails[id]);
+            uint_fast64_t i = 0;
+            const __m256i zero = _mm256_setzero_si256();
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i lo = _mm256_unpacklo_epi32(zero, h); // [h0, h1 | h4, h5]
+                __m256i hi = _mm256_unpackhi_epi32(zero, h); // [h2, h3 | h6, h7]
+                _mm256_storeu_pd(out + i, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20)));
+                _mm256_storeu_pd(out + i + 4, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31)));
+            }
+            return i;
         }
 
-        template<typename T>
-        void set(const uint_fast64_t& id, const T& t)
+        MANSEG_TARGET_AVX2 inline uint_fast64_t combineSegmentsAVX2(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
         {
-            double d = t;
-            __m128d d_v = _mm_set_pd(0.0, d);
-            __m128 seg_v = _mm_castpd_ps(d_v);
-            tails[id] = seg_v[0];
-            heads[id] = seg_v[1];
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tails + i));
+                __m256i lo = _mm256_unpacklo_epi32(t, h);
+                __m256i hi = _mm256_unpackhi_epi32(t, h);
+                _mm256_storeu_pd(out + i, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20)));
+                _mm256_storeu_pd(out + i + 4, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31)));
+            }
+            return i;
         }
 
-        template<typename T>
-        void setPair(const uint_fast64_t& id, const T& t)
+        // widenHeadsAVX2 (useTail false) or combineSegmentsAVX2 with streaming stores; out must be 32 byte aligned
+        template<bool useTail>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t streamSegmentsAVX2(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
         {
-            double d = t;
-            __m128d d_v = _mm_set_pd(0.0, d);
-            __m128 seg_v = _mm_castpd_ps(d_v);
-            tails[id] = seg_v[0];
-            heads[id] = seg_v[1];
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i t = useTail ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tails + i)) : _mm256_setzero_si256();
+                __m256i lo = _mm256_unpacklo_epi32(t, h);
+                __m256i hi = _mm256_unpackhi_epi32(t, h);
+                _mm256_stream_pd(out + i, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20)));
+                _mm256_stream_pd(out + i + 4, _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31)));
+            }
+            return i;
         }
 
-        double read(const uint_fast64_t& id)
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t narrowToHeadsAVX2(const double* in, const uint_fast64_t& n, float* heads)
         {
-            return static_cast<double>(Pair(&heads[id], &tails[id]));
+            uint_fast64_t i = 0;
+            __m256i rng = _mm256_setzero_si256();
+            if(mode == ROUND_STOCHASTIC && n >= 8)
+                rng = _mm256_set_epi64x(nextStochastic(), nextStochastic(), nextStochastic(), nextStochastic());
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i ia = roundHeadBits<mode>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), rng);
+                __m256i ib = roundHeadBits<mode>(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 4)), rng);
+                __m256 a = _mm256_castsi256_ps(ia);
+                __m256 b = _mm256_castsi256_ps(ib);
+                // odd 32-bit elements are the heads: [h0, h1, h4, h5 | h2, h3, h6, h7]
+                __m256 h = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                h = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(h), _MM_SHUFFLE(3, 1, 2, 0)));
+                _mm256_storeu_ps(heads + i, h);
+            }
+            return i;
         }
 
-        /*
-            Returns object of the same type, with pointers to the same data values
-			as this object.
-        */
-        TwoSegArray<true> createFullPrecision()
+        MANSEG_TARGET_AVX2 inline uint_fast64_t splitSegmentsAVX2(const double* in, const uint_fast64_t& n, float* heads, float* tails)
         {
-            return TwoSegArray<true>(heads, tails);
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256 a = _mm256_castpd_ps(_mm256_loadu_pd(in + i));
+                __m256 b = _mm256_castpd_ps(_mm256_loadu_pd(in + i + 4));
+                __m256 h = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                __m256 t = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                h = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(h), _MM_SHUFFLE(3, 1, 2, 0)));
+                t = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(t), _MM_SHUFFLE(3, 1, 2, 0)));
+                _mm256_storeu_ps(heads + i, h);
+                _mm256_storeu_ps(tails + i, t);
+            }
+            return i;
         }
 
-        void alloc(const uint_fast64_t& length)
+        MANSEG_TARGET_AVX2 inline uint_fast64_t gatherHeadsAVX2(const float* heads, const int32_t* idx, const uint_fast64_t& n, double* out)
         {
-            heads = new float[length];
-            tails = new float[length] ();
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i vi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+                __m256i h = _mm256_castps_si256(_mm256_i32gather_ps(heads, vi, 4));
+                __m256i lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(h));
+                __m256i hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(h, 1));
+                _mm256_storeu_pd(out + i, _mm256_castsi256_pd(_mm256_slli_epi64(lo, 32)));
+                _mm256_storeu_pd(out + i + 4, _mm256_castsi256_pd(_mm256_slli_epi64(hi, 32)));
+            }
+            return i;
         }
 
-		bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+        MANSEG_TARGET_AVX2 inline uint_fast64_t gatherSegmentsAVX2(const float* heads, const float* tails, const int32_t* idx, const uint_fast64_t& n, double* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i vi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+                __m256i h = _mm256_castps_si256(_mm256_i32gather_ps(heads, vi, 4));
+                __m256i t = _mm256_castps_si256(_mm256_i32gather_ps(tails, vi, 4));
+                __m256i lo = _mm256_or_si256(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(h)), 32),
+                    _mm256_cvtepu32_epi64(_mm256_castsi256_si128(t)));
+                __m256i hi = _mm256_or_si256(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(h, 1)), 32),
+                    _mm256_cvtepu32_epi64(_mm256_extracti128_si256(t, 1)));
+                _mm256_storeu_pd(out + i, _mm256_castsi256_pd(lo));
+                _mm256_storeu_pd(out + i + 4, _mm256_castsi256_pd(hi));
+            }
+            return i;
+        }
 
         /*
-            Deletes the values of the dynamic arrays used to store values in
-            the array.
-            NOTE: this should only be called by one object with references to
-            the same set of values (such as object created using createFullPrecision).
+            Adds values[i] * heads[idx[i]], both widened, for the first multiple of 8 of n to *sum; returns
+            that count. Eight values and indices a step, the heads gathered beside them, summed in two
+            registers of 4 doubles and added across only once at the end.
         */
-        void del()
+        MANSEG_TARGET_AVX2 inline uint_fast64_t dotGatherHeadsAVX2(const float* values, const int32_t* idx, const float* heads, const uint_fast64_t& n, double* sum)
         {
-            if(heads != nullptr) delete[] heads;
-            if(tails != nullptr) delete[] tails;
-			heads = nullptr;
-			tails = nullptr;
+            uint_fast64_t i = 0;
+            __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+                __m256i vi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+                __m256i h = _mm256_castps_si256(_mm256_i32gather_ps(heads, vi, 4));
+                __m256d a0 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)), 32));
+                __m256d a1 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)), 32));
+                __m256d x0 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(h)), 32));
+                __m256d x1 = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(h, 1)), 32));
+                s0 = _mm256_add_pd(s0, _mm256_mul_pd(a0, x0));
+                s1 = _mm256_add_pd(s1, _mm256_mul_pd(a1, x1));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+            *sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            return i;
         }
 
-    private:
-        float* heads;
-        float* tails;
-    };
+        /*
+            The smallest and largest biased exponents of the nonzero heads, into lo and hi (see headsFitFloat),
+            and with convert the heads as floats into out, as headToFloat.
+        */
+        template<bool convert>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t headsToFloatsAVX2(const float* heads, const uint_fast64_t& n, float* out, uint32_t& lo, uint32_t& hi)
+        {
+            uint_fast64_t i = 0;
+            const __m256i magnitude = _mm256_set1_epi32(0x7FFFFFFF);
+            const __m256i rebias = _mm256_set1_epi32((1023 - 127) << 20);
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i vlo = _mm256_set1_epi32(static_cast<int>(lo)), vhi = _mm256_set1_epi32(static_cast<int>(hi));
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i a = _mm256_and_si256(h, magnitude);
+                __m256i e = _mm256_srli_epi32(a, 20);
+                __m256i zeros = _mm256_cmpeq_epi32(a, zero);
+                // zeros count as the largest exponent for the minimum, and as 0 for the maximum
+                vlo = _mm256_min_epu32(vlo, _mm256_or_si256(e, zeros));
+                vhi = _mm256_max_epu32(vhi, _mm256_andnot_si256(zeros, e));
+                if(convert)
+                {
+                    __m256i f = _mm256_andnot_si256(zeros, _mm256_slli_epi32(_mm256_sub_epi32(a, rebias), 3));
+                    f = _mm256_or_si256(f, _mm256_andnot_si256(magnitude, h));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), f);
+                }
+            }
+            uint32_t lanes[16];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), vlo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 8), vhi);
+            for(int l = 0; l < 8; ++l)
+            {
+                lo = std::min(lo, lanes[l]);
+                hi = std::max(hi, lanes[8 + l]);
+            }
+            return i;
+        }
 
-    /*
-        Specialisation of TwoSegArray.
-        Operations performed on values in the array only modify the "head" segment
-        (i.e. the first 32 bits of a double value) unless specified otherwise.
-		Note: the class deconstructor does not free space automatically, so use the delSegments and del functions to clean up.
-    */
-    template<>
-    class TwoSegArray<false>
-    {
-    public:
-        TwoSegArray()
-		{
-			heads = nullptr;
-			tails = nullptr;
-		}
+        MANSEG_TARGET_AVX2 inline uint_fast64_t floatsToHeadsAVX2(const float* in, const uint_fast64_t& n, float* heads)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256 a = _mm256_castpd_ps(_mm256_cvtps_pd(_mm_loadu_ps(in + i)));
+                __m256 b = _mm256_castpd_ps(_mm256_cvtps_pd(_mm_loadu_ps(in + i + 4)));
+                // the heads of the doubles, as narrowToHeadsAVX2 truncates them
+                __m256 h = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                h = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(h), _MM_SHUFFLE(3, 1, 2, 0)));
+                _mm256_storeu_ps(heads + i, h);
+            }
+            return i;
+        }
+#endif
 
-        TwoSegArray(const uint_fast64_t& length)
+#if defined(MANSEG_HAS_AVX512)
+        // 16 heads <-> 16 doubles: each head is zero extended to 64 bits and shifted into the upper half
+        MANSEG_TARGET_AVX512 inline uint_fast64_t widenHeadsAVX512(const float* heads, const uint_fast64_t& n, double* out)
         {
-            heads = new float[length];
-            tails = new float[length] (); // initially zero tails array
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i h = _mm512_loadu_si512(heads + i);
+                __m512i lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(h));
+                __m512i hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1));
+                _mm512_storeu_pd(out + i, _mm512_castsi512_pd(_mm512_slli_epi64(lo, 32)));
+                _mm512_storeu_pd(out + i + 8, _mm512_castsi512_pd(_mm512_slli_epi64(hi, 32)));
+            }
+            return i + widenHeadsAVX2(heads + i, n - i, out + i);
         }
 
-        TwoSegArray(float* heads, float* tails)
-            :heads(heads), tails(tails)
-        {}
+        MANSEG_TARGET_AVX512 inline uint_fast64_t combineSegmentsAVX512(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i h = _mm512_loadu_si512(heads + i);
+                __m512i t = _mm512_loadu_si512(tails + i);
+                __m512i lo = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(h)), 32),
+                    _mm512_cvtepu32_epi64(_mm512_castsi512_si256(t)));
+                __m512i hi = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1)), 32),
+                    _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(t, 1)));
+                _mm512_storeu_pd(out + i, _mm512_castsi512_pd(lo));
+                _mm512_storeu_pd(out + i + 8, _mm512_castsi512_pd(hi));
+            }
+            return i + combineSegmentsAVX2(heads + i, tails + i, n - i, out + i);
+        }
 
-        ~TwoSegArray() { }
+        // as streamSegmentsAVX2, a whole cache line per store; out must be 64 byte aligned
+        template<bool useTail>
+        MANSEG_TARGET_AVX512 inline uint_fast64_t streamSegmentsAVX512(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i h = _mm512_loadu_si512(heads + i);
+                __m512i lo = _mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(h)), 32);
+                __m512i hi = _mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1)), 32);
+                if(useTail)
+                {
+                    __m512i t = _mm512_loadu_si512(tails + i);
+                    lo = _mm512_or_si512(lo, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(t)));
+                    hi = _mm512_or_si512(hi, _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(t, 1)));
+                }
+                _mm512_stream_pd(out + i, _mm512_castsi512_pd(lo));
+                _mm512_stream_pd(out + i + 8, _mm512_castsi512_pd(hi));
+            }
+            return i + streamSegmentsAVX2<useTail>(heads + i, tails + i, n - i, out + i);
+        }
 
-        template<typename T>
-        void set(const uint_fast64_t& id, const T& t)
+        // the heads (and tails) are the upper (and lower) halves of each 64-bit lane, narrowed with vpmovqd
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX512 inline uint_fast64_t narrowToHeadsAVX512(const double* in, const uint_fast64_t& n, float* heads)
         {
-            double d = t;
-            __m128d d_v = _mm_set_pd(0.0, d);
-            __m128 seg_v = _mm_castpd_ps(d_v);
-            heads[id] = seg_v[1];
+            uint_fast64_t i = 0;
+            __m512i rng = _mm512_setzero_si512();
+            if(mode == ROUND_STOCHASTIC && n >= 16)
+                rng = _mm512_set_epi64(nextStochastic(), nextStochastic(), nextStochastic(), nextStochastic(),
+                    nextStochastic(), nextStochastic(), nextStochastic(), nextStochastic());
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i a = roundHeadBits<mode>(_mm512_loadu_si512(in + i), rng);
+                __m512i b = roundHeadBits<mode>(_mm512_loadu_si512(in + i + 8), rng);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i), _mm512_cvtepi64_epi32(_mm512_srli_epi64(a, 32)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i + 8), _mm512_cvtepi64_epi32(_mm512_srli_epi64(b, 32)));
+            }
+            return i + narrowToHeadsAVX2<mode>(in + i, n - i, heads + i);
         }
 
-        template<typename T>
-        void setPair(const uint_fast64_t& id, const T& t)
+        MANSEG_TARGET_AVX512 inline uint_fast64_t splitSegmentsAVX512(const double* in, const uint_fast64_t& n, float* heads, float* tails)
         {
-            double d = t;
-            __m128d d_v = _mm_set_pd(0.0, d);
-            __m128 seg_v = _mm_castpd_ps(d_v);
-			tails[id] = seg_v[0];
-            heads[id] = seg_v[1];
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i a = _mm512_loadu_si512(in + i);
+                __m512i b = _mm512_loadu_si512(in + i + 8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i), _mm512_cvtepi64_epi32(_mm512_srli_epi64(a, 32)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i + 8), _mm512_cvtepi64_epi32(_mm512_srli_epi64(b, 32)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tails + i), _mm512_cvtepi64_epi32(a));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tails + i + 8), _mm512_cvtepi64_epi32(b));
+            }
+            return i + splitSegmentsAVX2(in + i, n - i, heads + i, tails + i);
         }
 
-        double read(const uint_fast64_t& id)
+        MANSEG_TARGET_AVX512 inline uint_fast64_t gatherHeadsAVX512(const float* heads, const int32_t* idx, const uint_fast64_t& n, double* out)
         {
-            return static_cast<double>(Head(&heads[id]));
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i h = _mm512_castps_si512(_mm512_i32gather_ps(_mm512_loadu_si512(idx + i), heads, 4));
+                __m512i lo = _mm512_cvtepu32_epi64(_mm512_castsi512_si256(h));
+                __m512i hi = _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1));
+                _mm512_storeu_pd(out + i, _mm512_castsi512_pd(_mm512_slli_epi64(lo, 32)));
+                _mm512_storeu_pd(out + i + 8, _mm512_castsi512_pd(_mm512_slli_epi64(hi, 32)));
+            }
+            return i + gatherHeadsAVX2(heads, idx + i, n - i, out + i);
         }
 
-        Head operator[](const uint_fast64_t& id)
+        MANSEG_TARGET_AVX512 inline uint_fast64_t gatherSegmentsAVX512(const float* heads, const float* tails, const int32_t* idx, const uint_fast64_t& n, double* out)
         {
-            return Head(&heads[id]);
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i vi = _mm512_loadu_si512(idx + i);
+                __m512i h = _mm512_castps_si512(_mm512_i32gather_ps(vi, heads, 4));
+                __m512i t = _mm512_castps_si512(_mm512_i32gather_ps(vi, tails, 4));
+                __m512i lo = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(h)), 32),
+                    _mm512_cvtepu32_epi64(_mm512_castsi512_si256(t)));
+                __m512i hi = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1)), 32),
+                    _mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(t, 1)));
+                _mm512_storeu_pd(out + i, _mm512_castsi512_pd(lo));
+                _mm512_storeu_pd(out + i + 8, _mm512_castsi512_pd(hi));
+            }
+            return i + gatherSegmentsAVX2(heads, tails, idx + i, n - i, out + i);
         }
 
         /*
-            Increases the precision of the operations performed by returning an
-            object of type TwoSegArray<true> that has pointers to the values
-            in the existing array.
+            heads[idx[i]] += values[i * step] (truncated) for groups of 16 distinct indices, stopping
+            before the first group that repeats an index, which must be applied in order by the caller.
         */
-        TwoSegArray<true> createFullPrecision()
+        MANSEG_TARGET_AVX512 inline uint_fast64_t scatterAddHeadsAVX512(float* heads, const int32_t* idx, const uint_fast64_t& n, const double* values, const uint_fast64_t& step)
         {
-            return TwoSegArray<true>(heads, tails);
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                __m512i vi = _mm512_loadu_si512(idx + i);
+                __m512i conflicts = _mm512_conflict_epi32(vi);
+                if(_mm512_test_epi32_mask(conflicts, conflicts) != 0)
+                    break;
+                __m512d vlo = step ? _mm512_loadu_pd(values + i) : _mm512_set1_pd(*values);
+                __m512d vhi = step ? _mm512_loadu_pd(values + i + 8) : vlo;
+                __m512i h = _mm512_castps_si512(_mm512_i32gather_ps(vi, heads, 4));
+                __m512d lo = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(h)), 32));
+                __m512d hi = _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(h, 1)), 32));
+                // truncate the sums back to their upper 32 bits
+                __m256i nlo = _mm512_cvtepi64_epi32(_mm512_srli_epi64(_mm512_castpd_si512(_mm512_add_pd(lo, vlo)), 32));
+                __m256i nhi = _mm512_cvtepi64_epi32(_mm512_srli_epi64(_mm512_castpd_si512(_mm512_add_pd(hi, vhi)), 32));
+                _mm512_i32scatter_ps(heads, vi, _mm512_castsi512_ps(_mm512_inserti64x4(_mm512_castsi256_si512(nlo), nhi, 1)), 4);
+            }
+            return i;
+        }
+#endif
+
+#if defined(MANSEG_NEON)
+        // NEON has no run time choice of width, so these are the baseline (SIMD_SSE2) kernels on AArch64
+        inline uint_fast64_t widenHeadsNEON(const float* heads, const uint_fast64_t& n, double* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(3)); i += 4)
+            {
+                // vst2 interleaves {0, head} pairs, i.e. head in the upper 32 bits of each double
+                uint32x4x2_t v = { { vdupq_n_u32(0), vld1q_u32(reinterpret_cast<const uint32_t*>(heads + i)) } };
+                vst2q_u32(reinterpret_cast<uint32_t*>(out + i), v);
+            }
+            return i;
+        }
+
+        inline uint_fast64_t combineSegmentsNEON(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(3)); i += 4)
+            {
+                uint32x4x2_t v = { { vld1q_u32(reinterpret_cast<const uint32_t*>(tails + i)), vld1q_u32(reinterpret_cast<const uint32_t*>(heads + i)) } };
+                vst2q_u32(reinterpret_cast<uint32_t*>(out + i), v);
+            }
+            return i;
+        }
+
+        template<RoundingMode mode>
+        inline uint64x2_t roundHeadBitsNEON(const uint64x2_t& bits)
+        {
+            if(mode == ROUND_TRUNCATE)
+                return bits;
+            const uint64x2_t expMask = vdupq_n_u64(0x7FF0000000000000ULL);
+            uint64x2_t special = vceqq_u64(vandq_u64(bits, expMask), expMask);
+            uint64x2_t odd = vandq_u64(vshrq_n_u64(bits, 32), vdupq_n_u64(1));
+            uint64x2_t rounded = vaddq_u64(bits, vaddq_u64(vdupq_n_u64(0x7FFFFFFFULL), odd));
+            return vbslq_u64(special, bits, rounded);
+        }
+
+        template<RoundingMode mode>
+        inline uint_fast64_t narrowToHeadsNEON(const double* in, const uint_fast64_t& n, float* heads)
+        {
+            // stochastic rounding draws from the scalar generator
+            if(mode == ROUND_STOCHASTIC)
+                return 0;
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(3)); i += 4)
+            {
+                uint64x2_t lo = roundHeadBitsNEON<mode>(vld1q_u64(reinterpret_cast<const uint64_t*>(in + i)));
+                uint64x2_t hi = roundHeadBitsNEON<mode>(vld1q_u64(reinterpret_cast<const uint64_t*>(in + i + 2)));
+                vst1q_u32(reinterpret_cast<uint32_t*>(heads + i), vcombine_u32(vshrn_n_u64(lo, 32), vshrn_n_u64(hi, 32)));
+            }
+            return i;
+        }
+
+        inline uint_fast64_t splitSegmentsNEON(const double* in, const uint_fast64_t& n, float* heads, float* tails)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(3)); i += 4)
+            {
+                // vld2 de-interleaves the lower (tail) and upper (head) words
+                uint32x4x2_t v = vld2q_u32(reinterpret_cast<const uint32_t*>(in + i));
+                vst1q_u32(reinterpret_cast<uint32_t*>(tails + i), v.val[0]);
+                vst1q_u32(reinterpret_cast<uint32_t*>(heads + i), v.val[1]);
+            }
+            return i;
+        }
+#endif
+
+#if defined(MANSEG_SVE)
+        // SVE gathers, svcntd() elements per step with the loop tail predicated off
+        inline uint_fast64_t gatherHeadsSVE(const float* heads, const int32_t* idx, const uint_fast64_t& n, double* out)
+        {
+            for(uint_fast64_t i = 0; i < n; i += svcntd())
+            {
+                svbool_t pg = svwhilelt_b64(static_cast<uint64_t>(i), static_cast<uint64_t>(n));
+                svint64_t vi = svld1sw_s64(pg, idx + i);
+                svuint64_t h = svld1uw_gather_s64index_u64(pg, reinterpret_cast<const uint32_t*>(heads), vi);
+                svst1_u64(pg, reinterpret_cast<uint64_t*>(out + i), svlsl_n_u64_x(pg, h, 32));
+            }
+            return n;
+        }
+
+        inline uint_fast64_t gatherSegmentsSVE(const float* heads, const float* tails, const int32_t* idx, const uint_fast64_t& n, double* out)
+        {
+            for(uint_fast64_t i = 0; i < n; i += svcntd())
+            {
+                svbool_t pg = svwhilelt_b64(static_cast<uint64_t>(i), static_cast<uint64_t>(n));
+                svint64_t vi = svld1sw_s64(pg, idx + i);
+                svuint64_t h = svld1uw_gather_s64index_u64(pg, reinterpret_cast<const uint32_t*>(heads), vi);
+                svuint64_t t = svld1uw_gather_s64index_u64(pg, reinterpret_cast<const uint32_t*>(tails), vi);
+                svst1_u64(pg, reinterpret_cast<uint64_t*>(out + i), svorr_u64_x(pg, svlsl_n_u64_x(pg, h, 32), t));
+            }
+            return n;
+        }
+#endif
+    }
+
+    /*
+        Bulk conversion kernels used by the readBlock/writeBlock functions of TwoSegArray.
+        These operate on raw segment arrays, so that streaming loops do not have to go through
+        the Head/Pair proxies one element at a time (which prevents auto-vectorisation).
+        At SIMD_AVX2, 8 segments are widened to/narrowed from 8 doubles per step using 256-bit
+        unpack/shuffle operations, and at SIMD_AVX512, 16; the remainder (and SIMD_SSE2) use the scalar casts.
+        On AArch64, SIMD_SSE2 is the baseline level and runs 4 segments per step with NEON.
+    */
+
+    // out[i] = (double)heads[i], i.e. upper 32 bits from heads, lower 32 bits zero
+    inline void widenHeads(const float* heads, const uint_fast64_t& n, double* out)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::widenHeadsAVX512(heads, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::widenHeadsAVX2(heads, n, out);
+#endif
+#if defined(MANSEG_NEON)
+        if(level == SIMD_SSE2) i = simd::widenHeadsNEON(heads, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = headToDouble(heads[i]);
+    }
+
+    // out[i] = double made up of heads[i] (upper 32 bits) and tails[i] (lower 32 bits)
+    inline void combineSegments(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::combineSegmentsAVX512(heads, tails, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::combineSegmentsAVX2(heads, tails, n, out);
+#endif
+#if defined(MANSEG_NEON)
+        if(level == SIMD_SSE2) i = simd::combineSegmentsNEON(heads, tails, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = segmentsToDouble(heads[i], tails[i]);
+    }
+
+    // heads[i] = upper 32 bits of in[i], rounded according to mode (truncated by default)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void narrowToHeads(const double* in, const uint_fast64_t& n, float* heads)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::narrowToHeadsAVX512<mode>(in, n, heads);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::narrowToHeadsAVX2<mode>(in, n, heads);
+#endif
+#if defined(MANSEG_NEON)
+        if(level == SIMD_SSE2) i = simd::narrowToHeadsNEON<mode>(in, n, heads);
+#endif
+        MANSEG_ERROR_ADD(headRoundoff<mode>() * ErrorBound::l1(in, i));
+        for(; i < n; ++i)
+            heads[i] = roundToHead<mode>(in[i]);
+    }
+
+    // heads[i] = upper 32 bits of in[i], tails[i] = lower 32 bits of in[i]
+    inline void splitSegments(const double* in, const uint_fast64_t& n, float* heads, float* tails)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::splitSegmentsAVX512(in, n, heads, tails);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::splitSegmentsAVX2(in, n, heads, tails);
+#endif
+#if defined(MANSEG_NEON)
+        if(level == SIMD_SSE2) i = simd::splitSegmentsNEON(in, n, heads, tails);
+#endif
+        for(; i < n; ++i)
+            splitSegment(in[i], heads + i, tails + i);
+    }
+
+    /*
+        Range analysis for computing on heads in single precision. A head has 20 bits of mantissa, so
+        a float (23) holds it exactly as long as its exponent is in the range of a float's normal values.
+        headsFitFloat tells whether every nonzero head of heads[0, n) has, with headroom bits to spare
+        at the top for the growth of sums and products of them (e.g. 3 for a sum of up to 8 values).
+        Infinities and NaNs never fit. fitsFloat is the same for doubles, e.g. the halos of a block.
+    */
+    // biased exponents of a double: 1023 - 126 is a float's smallest normal, 1023 + 127 its largest
+    inline bool exponentsFitFloat(const uint_fast64_t& lo, const uint_fast64_t& hi, const int& headroom)
+    {
+        return lo >= 1023 - 126 && static_cast<int>(hi) + headroom <= 1023 + 127;
+    }
+
+    // the exponent of head rebiased to a float's, so exact for a head that fits one and meaningless for the others
+    inline float headToFloat(const float& head)
+    {
+        uint32_t h;
+        memcpy(&h, &head, sizeof(float));
+        const uint32_t a = h & 0x7FFFFFFF;
+        const uint32_t bits = (a == 0 ? 0 : (a - ((1023 - 127) << 20)) << 3) | (h & 0x80000000);
+        float f;
+        memcpy(&f, &bits, sizeof(float));
+        return f;
+    }
+
+    // the exponent range of heads, continuing from lo and hi, and with out the heads as floats
+    inline void headsToFloatsScalar(const float* heads, const uint_fast64_t& begin, const uint_fast64_t& n, float* out,
+        uint32_t& lo, uint32_t& hi)
+    {
+        for(uint_fast64_t i = begin; i < n; ++i)
+        {
+            uint32_t bits;
+            memcpy(&bits, heads + i, sizeof(float));
+            if(out) out[i] = headToFloat(heads[i]);
+            if((bits & 0x7FFFFFFF) == 0)
+                continue;
+            const uint32_t e = (bits >> 20) & 0x7FF;
+            lo = std::min(lo, e);
+            hi = std::max(hi, e);
+        }
+    }
+
+    inline bool headsFitFloat(const float* heads, const uint_fast64_t& n, const int& headroom = 0)
+    {
+        uint32_t lo = 0x7FF, hi = 0;
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::headsToFloatsAVX2<false>(heads, n, nullptr, lo, hi);
+#endif
+        headsToFloatsScalar(heads, i, n, nullptr, lo, hi);
+        return exponentsFitFloat(lo, hi, headroom);
+    }
+
+    inline bool fitsFloat(const double* in, const uint_fast64_t& n, const int& headroom = 0)
+    {
+        uint_fast64_t lo = 0x7FF, hi = 0;
+        for(uint_fast64_t i = 0; i < n; ++i)
+        {
+            uint64_t bits;
+            memcpy(&bits, in + i, sizeof(double));
+            if((bits << 1) == 0)
+                continue;
+            const uint_fast64_t e = (bits >> 52) & 0x7FF;
+            lo = std::min(lo, e);
+            hi = std::max(hi, e);
+        }
+        return exponentsFitFloat(lo, hi, headroom);
+    }
+
+    /*
+        out[i] = heads[i] as a float, in the same pass as headsFitFloat(heads, n, headroom), which it
+        returns: where it is false, out is not meaningful.
+    */
+    inline bool headsToFloats(const float* heads, const uint_fast64_t& n, float* out, const int& headroom = 0)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+        uint32_t lo = 0x7FF, hi = 0;
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::headsToFloatsAVX2<true>(heads, n, out, lo, hi);
+#endif
+        headsToFloatsScalar(heads, i, n, out, lo, hi);
+        return exponentsFitFloat(lo, hi, headroom);
+    }
+
+    // heads[i] = in[i] truncated to a head, as narrowToHeads does for (double)in[i]
+    inline void floatsToHeads(const float* in, const uint_fast64_t& n, float* heads)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float) * n);
+#if MANSEG_ERROR_BOUND
+        for(uint_fast64_t j = 0; j < n; ++j)
+            ErrorBound::add(ErrorBound::truncation * ErrorBound::magnitude(in[j]));
+#endif
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::floatsToHeadsAVX2(in, n, heads);
+#endif
+        for(; i < n; ++i)
+            heads[i] = headOf(static_cast<double>(in[i]));
+    }
+
+    /*
+        As combineSegments, or widenHeads when tails is null, but with streaming (non-temporal) stores,
+        which write out without reading its cache lines first or evicting anything to hold them: for
+        filling an array too large to stay in cache, such as full at a precision switch. Up to the first
+        64 byte boundary of out, and below SIMD_AVX2, the values are stored as the other kernels do. The
+        streaming stores are fenced before this returns, so another thread may read out once it has
+        synchronised with this one.
+    */
+    inline void streamSegments(const float* heads, const float* tails, const uint_fast64_t& n, double* out)
+    {
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+        const SimdLevel level = simdLevel();
+        if(level != SIMD_SSE2)
+        {
+            for(; i < n && (reinterpret_cast<uintptr_t>(out + i) & 63) != 0; ++i)
+                out[i] = tails == nullptr ? headToDouble(heads[i]) : segmentsToDouble(heads[i], tails[i]);
+#if defined(MANSEG_HAS_AVX512)
+            if(level == SIMD_AVX512)
+                i += tails == nullptr ? simd::streamSegmentsAVX512<false>(heads + i, nullptr, n - i, out + i)
+                    : simd::streamSegmentsAVX512<true>(heads + i, tails + i, n - i, out + i);
+#endif
+            if(level == SIMD_AVX2)
+                i += tails == nullptr ? simd::streamSegmentsAVX2<false>(heads + i, nullptr, n - i, out + i)
+                    : simd::streamSegmentsAVX2<true>(heads + i, tails + i, n - i, out + i);
+            _mm_sfence();
+        }
+#endif
+        // the values streamed above are counted here, the rest by widenHeads or combineSegments
+        MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double) * n);
+        if(tails == nullptr)
+        {
+            MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * i);
+            widenHeads(heads + i, n - i, out + i);
+        }
+        else
+        {
+            MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double) * i);
+            combineSegments(heads + i, tails + i, n - i, out + i);
+        }
+    }
+
+    /*
+        Indirect (gather/scatter) kernels, for loops such as SpMV and edge traversals that read or
+        update the elements idx[0..n) in turn. Gathering a 4 byte head rather than an 8 byte double
+        halves the cache lines touched by random access.
+        At SIMD_AVX512, 16 segments are gathered per step; at SIMD_AVX2, 8; with SVE, one vector of
+        doubles. Gathered heads are widened to doubles by moving them into the upper 32 bits of each
+        64-bit lane.
+    */
+
+    // out[i] = (double)heads[idx[i]]
+    inline void gatherHeads(const float* heads, const int32_t* idx, const uint_fast64_t& n, double* out)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::gatherHeadsAVX512(heads, idx, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::gatherHeadsAVX2(heads, idx, n, out);
+#endif
+#if defined(MANSEG_SVE)
+        if(level == SIMD_SSE2) i = simd::gatherHeadsSVE(heads, idx, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = headToDouble(heads[idx[i]]);
+    }
+
+    // out[i] = double made up of heads[idx[i]] and tails[idx[i]]
+    inline void gatherSegments(const float* heads, const float* tails, const int32_t* idx, const uint_fast64_t& n, double* out)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double) * n);
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::gatherSegmentsAVX512(heads, tails, idx, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::gatherSegmentsAVX2(heads, tails, idx, n, out);
+#endif
+#if defined(MANSEG_SVE)
+        if(level == SIMD_SSE2) i = simd::gatherSegmentsSVE(heads, tails, idx, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = segmentsToDouble(heads[idx[i]], tails[idx[i]]);
+    }
+
+    /*
+        Sum of values[i] * heads[idx[i]] over n values, both widened: a row of a sparse product with its
+        values and the vector at the heads, without gathering the vector into a buffer of doubles first.
+        Rows shorter than DotGatherShort take the scalar loop, as a vector step and the sum across its
+        lanes would cost them more than they save.
+    */
+    constexpr uint_fast64_t DotGatherShort = 8;
+
+    inline double dotGatherHeads(const float* values, const int32_t* idx, const float* heads, const uint_fast64_t& n)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, 2 * sizeof(float) * n);
+        double sum = 0.0;
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX2)
+        if(n >= DotGatherShort && (level == SIMD_AVX2 || level == SIMD_AVX512)) i = simd::dotGatherHeadsAVX2(values, idx, heads, n, &sum);
+#endif
+        for(; i < n; ++i)
+            sum += headToDouble(values[i]) * headToDouble(heads[idx[i]]);
+        return sum;
+    }
+
+    /*
+        heads[idx[i]] += values[i * step], in order of i, rounding each result according to mode.
+        step is 1 for an array of values, or 0 to add the same value to every element.
+        Repeated indices are applied one after another, as in the scalar loop. AVX2 has no scatter,
+        so this is only vectorised at SIMD_AVX512 (using conflict detection), and then only for
+        ROUND_TRUNCATE and groups of 16 indices that are all distinct.
+    */
+    template<RoundingMode mode>
+    inline void scatterAddHeadsStep(float* heads, const int32_t* idx, const uint_fast64_t& n, const double* values, const uint_fast64_t& step)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float) * n);
+        uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX512)
+        if(mode == ROUND_TRUNCATE && simdLevel() == SIMD_AVX512)
+        {
+            while(i < n)
+            {
+#if MANSEG_ERROR_BOUND
+                const uint_fast64_t group = i;
+#endif
+                i += simd::scatterAddHeadsAVX512(heads, idx + i, n - i, values + i * step, step);
+#if MANSEG_ERROR_BOUND
+                // a truncated head is within 2^-20 of itself as well as of the sum it was cut from
+                for(uint_fast64_t j = group; j < i; ++j)
+                    ErrorBound::add(ErrorBound::truncation * ErrorBound::magnitude(headToDouble(heads[idx[j]])));
+#endif
+                // a group with a repeated index, or the remainder
+                const uint_fast64_t end = std::min(i + 16, n);
+                for(; i < end; ++i)
+                    heads[idx[i]] = roundToHead<mode>(headToDouble(heads[idx[i]]) + values[i * step]);
+            }
+        }
+#endif
+        for(; i < n; ++i)
+            heads[idx[i]] = roundToHead<mode>(headToDouble(heads[idx[i]]) + values[i * step]);
+    }
+
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAddHeads(float* heads, const int32_t* idx, const uint_fast64_t& n, const double* values)
+    {
+        scatterAddHeadsStep<mode>(heads, idx, n, values, 1);
+    }
+
+    // heads[idx[i]] += value for every i, e.g. a vertex's contribution to each of its out-neighbours
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAddHeads(float* heads, const int32_t* idx, const uint_fast64_t& n, const double& value)
+    {
+        scatterAddHeadsStep<mode>(heads, idx, n, &value, 0);
+    }
+
+    // pairs (heads[idx[i]], tails[idx[i]]) += values[i * step], in order of i
+    inline void scatterAddSegmentsStep(float* heads, float* tails, const int32_t* idx, const uint_fast64_t& n, const double* values, const uint_fast64_t& step)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double) * n);
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double) * n);
+        for(uint_fast64_t i = 0; i < n; ++i)
+        {
+            float* h = &heads[idx[i]];
+            float* t = &tails[idx[i]];
+            splitSegment(segmentsToDouble(*h, *t) + values[i * step], h, t);
+        }
+    }
+
+    /*
+        Default storage policy for TwoSegArray and BasicManSegArray, using new[] and delete[].
+        A custom policy provides allocate<T>(length, zero), returning space for length values of type T
+        (zero-initialised if zero is true), and deallocate<T>(ptr, length) to release it.
+        Policies may hold state (such as a partitioning of the array), as each array keeps a copy.
+    */
+    struct SegmentAllocator
+    {
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            return zero ? new T[length] () : new T[length];
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length) { delete[] ptr; }
+    };
+
+    /*
+        Called by TwoSegArray<false>::createFullPrecision before the tails are used at full precision.
+        Storage whose tails are only brought in when they are first needed overloads it for its
+        policy (see MappedSegmentAllocator); for every other policy the tails are already there.
+    */
+    template<class Allocator>
+    inline void provideTails(Allocator& allocator, float* tails, const uint_fast64_t& length) {}
+
+    /*
+        Called by TwoSegArray once it has allocated the tails, before anything is written to them.
+        Storage that keeps the tails apart from the heads overloads it for its policy (see
+        TieredSegmentAllocator); every other policy places the two planes alike.
+    */
+    template<class Allocator>
+    inline void placeTails(Allocator& allocator, float* tails, const uint_fast64_t& length) {}
+
+    /*
+        Called by TwoSegArray<false>::dropTails when the tails are no longer wanted (see
+        BasicManSegArray::demote); afterwards they must read as zero. This zeroes them in place.
+        Storage that can give their pages back to the system overloads it (see LazySegmentAllocator).
+    */
+    template<class Allocator>
+    inline void releaseTails(Allocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        memset(tails, 0, length * sizeof(float));
+    }
+
+    /*
+        Called once a plane of an array (its heads, tails, full doubles or contiguous segments) has
+        been allocated, with owner the array's heads, and before it is deallocated. With MANSEG_MEMORY
+        this records it for the memory report (see manseglib_memory.hpp); otherwise it does nothing.
+        Storage which hands out parts of a larger allocation, and records that itself, overloads both
+        to do nothing (see SlabAllocator).
+    */
+    template<class Allocator>
+    inline void trackPlane(Allocator& allocator, const void* p, const size_t& bytes, const Memory::Plane& plane, const void* owner)
+    {
+        Memory::track(p, bytes, plane, owner);
+    }
+
+    template<class Allocator>
+    inline void untrackPlane(Allocator& allocator, const void* p)
+    {
+        Memory::untrack(p);
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    /*
+        Storage policy that reserves segments as anonymous private mappings instead of using new[].
+        Such memory is zero-filled by the OS on first touch, so requesting a zero-initialised array
+        costs no memset and no page faults: the tails of a TwoSegArray which is only used through
+        its heads are never made resident, halving the footprint (and startup time) of heads-only runs.
+        Reading untouched tails (e.g. through createFullPrecision) maps the shared zero page.
+        Every allocation is rounded up to whole pages, so this is intended for large arrays.
+    */
+    struct LazySegmentAllocator
+    {
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+            flags |= MAP_NORESERVE;
+#endif
+            void* mem = mmap(nullptr, bytes<T>(length), PROT_READ | PROT_WRITE, flags, -1, 0);
+            if(mem == MAP_FAILED)
+                throw std::bad_alloc();
+            return reinterpret_cast<T*>(mem);
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length) { munmap(ptr, bytes<T>(length)); }
+
+    private:
+        template<typename T>
+        static size_t bytes(const uint_fast64_t& length)
+        {
+            // mmap does not accept 0 length mappings
+            return length == 0 ? 1 : length * sizeof(T);
+        }
+    };
+
+    /*
+        Zeroes [p, p + bytes) of an anonymous private mapping, giving its whole pages back to the system:
+        they are zero pages again until written. The partial pages at either end are zeroed in place.
+    */
+    inline void discardPages(void* p, const size_t& bytes)
+    {
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(p), end = begin + bytes;
+        const uintptr_t first = (begin + page - 1) / page * page, last = end / page * page;
+        if(first >= last)
+        {
+            memset(p, 0, bytes);
+            return;
+        }
+        memset(p, 0, first - begin);
+        memset(reinterpret_cast<void*>(last), 0, end - last);
+        if(madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0)
+            memset(reinterpret_cast<void*>(first), 0, last - first);
+    }
+
+    inline void releaseTails(LazySegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        discardPages(tails, length * sizeof(float));
+    }
+#endif
+
+    /*
+        Array type class for performing operations on double values, conceptually split into two 32 bit segments - "head" and "tail".
+        The user is required to manually clean up memory after allocation using the del() function, as the deconstructor does not handle this. This is due to the
+        way that shifting from low to high precision is handled, by just reading the extra segments in the <true> variant.
+        
+        <false> specialisation - Operations performed on values in the array only modify the "head" segment (i.e. the first 32 bits of a double value) unless specified otherwise.
+        <true> specialisation - Operations performed on values in the array are exactly the same as standard IEEE-754 doubles, but a bit slower due to combining of head and tail segments.
+    */
+    template<bool useTail, class Allocator = SegmentAllocator>
+    class TwoSegArray; // explicitly specialise this below.
+
+    template<bool useTail>
+    class TwoSegSpan; // non-owning sub-range of a TwoSegArray, specialised below.
+
+    /*
+        Random access iterator over the heads (useTail = false) or pairs of a TwoSegArray or TwoSegSpan,
+        from their begin() and end(). Dereferencing gives a Head or Pair proxy, which reads as a double
+        and can be assigned to, so the iterators work with the standard algorithms (as vector<bool>'s do)
+        and with generic code; they are two pointers stepped together, which the compiler vectorises.
+        The overloads of manseglib_algorithm.hpp take the iterators' ranges in blocks through the bulk
+        kernels instead.
+    */
+    template<bool useTail>
+    class SegmentIterator
+    {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef double value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef typename std::conditional<useTail, Pair, Head>::type reference;
+
+        SegmentIterator() :heads(nullptr), tails(nullptr) {}
+        SegmentIterator(float* heads, float* tails) :heads(heads), tails(tails) {}
+
+        reference operator*() const { return at(0, std::integral_constant<bool, useTail>()); }
+        reference operator[](const difference_type& n) const { return at(n, std::integral_constant<bool, useTail>()); }
+
+        SegmentIterator& operator++() { ++heads; ++tails; return *this; }
+        SegmentIterator& operator--() { --heads; --tails; return *this; }
+        SegmentIterator operator++(int) { SegmentIterator old(*this); ++*this; return old; }
+        SegmentIterator operator--(int) { SegmentIterator old(*this); --*this; return old; }
+        SegmentIterator& operator+=(const difference_type& n) { heads += n; tails += n; return *this; }
+        SegmentIterator& operator-=(const difference_type& n) { heads -= n; tails -= n; return *this; }
+
+        friend SegmentIterator operator+(SegmentIterator it, const difference_type& n) { return it += n; }
+        friend SegmentIterator operator+(const difference_type& n, SegmentIterator it) { return it += n; }
+        friend SegmentIterator operator-(SegmentIterator it, const difference_type& n) { return it -= n; }
+        friend difference_type operator-(const SegmentIterator& a, const SegmentIterator& b) { return a.heads - b.heads; }
+
+        friend bool operator==(const SegmentIterator& a, const SegmentIterator& b) { return a.heads == b.heads; }
+        friend bool operator!=(const SegmentIterator& a, const SegmentIterator& b) { return a.heads != b.heads; }
+        friend bool operator<(const SegmentIterator& a, const SegmentIterator& b) { return a.heads < b.heads; }
+        friend bool operator>(const SegmentIterator& a, const SegmentIterator& b) { return a.heads > b.heads; }
+        friend bool operator<=(const SegmentIterator& a, const SegmentIterator& b) { return a.heads <= b.heads; }
+        friend bool operator>=(const SegmentIterator& a, const SegmentIterator& b) { return a.heads >= b.heads; }
+
+        /* the segments the iterator is at */
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+    private:
+        Head at(const difference_type& n, std::false_type) const { return Head(heads + n); }
+        Pair at(const difference_type& n, std::true_type) const { return Pair(heads + n, tails + n); }
+
+        float* heads;
+        float* tails;
+    };
+
+    using HeadsIterator = SegmentIterator<false>;
+    using PairsIterator = SegmentIterator<true>;
+
+    /*
+        Specialisation of TwoSegArray.
+        User is required to manage de-allocation of memory manually, using the del()
+        function, as the deconstructor does not free this space.
+        Operations performed on values in the array are exactly the same as standard IEEE-754 doubles, but a bit slower due to combining of head and tail segments.
+
+		Note: the class deconstructor does not free space automatically, so use the delSegments and del functions to clean up.
+    */
+    template<class Allocator>
+    class TwoSegArray<true, Allocator>
+    {
+    public:
+        TwoSegArray() 
+		{
+			heads = nullptr;
+			tails = nullptr;
+			length = 0;
+		}
+
+        TwoSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :length(length), allocator(allocator)
+        {
+            heads = this->allocator.template allocate<float>(length, false);
+            trackPlane(this->allocator, heads, length * sizeof(float), Memory::PLANE_HEADS, heads);
+            tails = this->allocator.template allocate<float>(length, true); // initially zero tails array
+            trackPlane(this->allocator, tails, length * sizeof(float), Memory::PLANE_TAILS, heads);
+            placeTails(this->allocator, tails, length);
+        }
+
+        TwoSegArray(float* heads, float* tails, const uint_fast64_t& length = 0, const Allocator& allocator = Allocator())
+            :heads(heads), tails(tails), length(length), allocator(allocator)
+        {}
+
+        ~TwoSegArray() { }
+
+        Pair operator[](const uint_fast64_t& id)
+        {
+            return Pair(&heads[id], &tails[id]);
+        }
+
+        /*
+            Sets value id to t. The value is stored exactly, so mode has no effect; it is accepted
+            so that kernels can call set<mode> on any level (see LevelView).
+        */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t)
+        {
+            MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+            splitSegment(t, heads + id, tails + id);
+        }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t)
+        {
+            MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+            splitSegment(t, heads + id, tails + id);
+        }
+
+        double read(const uint_fast64_t& id)
+        {
+            return static_cast<double>(Pair(&heads[id], &tails[id]));
+        }
+
+        /*
+            Reads n values starting at start into out, combining heads and tails.
+            Equivalent to out[i] = (*this)[start + i], but vectorised.
+        */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            combineSegments(heads + start, tails + start, n, out);
+        }
+
+        /*
+            Writes n values from in to the array starting at start, splitting each value
+            into its head and tail segments.
+            Equivalent to (*this)[start + i] = in[i], but vectorised.
+        */
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            splitSegments(in, n, heads + start, tails + start);
+        }
+
+        /*
+            Returns object of the same type, with pointers to the same data values
+			as this object.
+        */
+        TwoSegArray<true, Allocator> createFullPrecision()
+        {
+            return TwoSegArray<true, Allocator>(heads, tails, length, allocator);
+        }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            heads = allocator.template allocate<float>(length, false);
+            trackPlane(allocator, heads, length * sizeof(float), Memory::PLANE_HEADS, heads);
+            tails = allocator.template allocate<float>(length, true);
+            trackPlane(allocator, tails, length * sizeof(float), Memory::PLANE_TAILS, heads);
+            placeTails(allocator, tails, length);
+        }
+
+		bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+
+        /* raw segment arrays, for kernels that operate on the segments directly */
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+        /* storage policy the segments were allocated with */
+        const Allocator& getAllocator() const { return allocator; }
+
+        /* view of elements [start, start + n), indexed from 0 (e.g. a partition's part.start_of(k) range) */
+        inline TwoSegSpan<true> subspan(const uint_fast64_t& start, const uint_fast64_t& n) const;
+        inline TwoSegSpan<true> span() const;
+
+        /* iterators over the pairs, and their number (see SegmentIterator) */
+        PairsIterator begin() const { return PairsIterator(heads, tails); }
+        PairsIterator end() const { return PairsIterator(heads + length, tails + length); }
+        uint_fast64_t size() const { return length; }
+
+        /*
+            Deletes the values of the dynamic arrays used to store values in
+            the array.
+            NOTE: this should only be called by one object with references to
+            the same set of values (such as object created using createFullPrecision).
+        */
+        void del()
+        {
+            if(heads != nullptr) { untrackPlane(allocator, heads); allocator.deallocate(heads, length); }
+            if(tails != nullptr) { untrackPlane(allocator, tails); allocator.deallocate(tails, length); }
+			heads = nullptr;
+			tails = nullptr;
+			length = 0;
+        }
+
+    private:
+        float* heads;
+        float* tails;
+        uint_fast64_t length;   // number of elements, as passed to the allocator
+        Allocator allocator;
+    };
+
+    /*
+        Specialisation of TwoSegArray.
+        Operations performed on values in the array only modify the "head" segment
+        (i.e. the first 32 bits of a double value) unless specified otherwise.
+		Note: the class deconstructor does not free space automatically, so use the delSegments and del functions to clean up.
+    */
+    template<class Allocator>
+    class TwoSegArray<false, Allocator>
+    {
+    public:
+        TwoSegArray()
+		{
+			heads = nullptr;
+			tails = nullptr;
+			length = 0;
+		}
+
+        TwoSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :length(length), allocator(allocator)
+        {
+            heads = this->allocator.template allocate<float>(length, false);
+            trackPlane(this->allocator, heads, length * sizeof(float), Memory::PLANE_HEADS, heads);
+            tails = this->allocator.template allocate<float>(length, true); // initially zero tails array
+            trackPlane(this->allocator, tails, length * sizeof(float), Memory::PLANE_TAILS, heads);
+            placeTails(this->allocator, tails, length);
+        }
+
+        TwoSegArray(float* heads, float* tails, const uint_fast64_t& length = 0, const Allocator& allocator = Allocator())
+            :heads(heads), tails(tails), length(length), allocator(allocator)
+        {}
+
+        ~TwoSegArray() { }
+
+        /*
+            Sets the head of value id to t, rounded according to mode (truncated by default, as with operator[]).
+            e.g. a.set<ROUND_NEAREST>(i, x)
+        */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t)
+        {
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+            double d = t;
+            heads[id] = roundToHead<mode>(d);
+        }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t)
+        {
+            MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+            splitSegment(t, heads + id, tails + id);
+        }
+
+        double read(const uint_fast64_t& id)
+        {
+            return static_cast<double>(Head(&heads[id]));
+        }
+
+        /*
+            Reads n values starting at start into out, reading only the heads.
+            Equivalent to out[i] = (*this)[start + i], but vectorised.
+        */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            widenHeads(heads + start, n, out);
+        }
+
+        /*
+            Writes n values from in to the array starting at start, only modifying the heads.
+            Equivalent to set<mode>(start + i, in[i]), but vectorised.
+        */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            narrowToHeads<mode>(in, n, heads + start);
+        }
+
+        Head operator[](const uint_fast64_t& id)
+        {
+            return Head(&heads[id]);
+        }
+
+        /*
+            Increases the precision of the operations performed by returning an
+            object of type TwoSegArray<true> that has pointers to the values
+            in the existing array.
+        */
+        TwoSegArray<true, Allocator> createFullPrecision()
+        {
+            provideTails(allocator, tails, length);
+            return TwoSegArray<true, Allocator>(heads, tails, length, allocator);
         }
 
         void alloc(const uint_fast64_t& length)
         {
-            heads = new float[length];
-            // we should zero tails when allocating heads array for
-            // to avoid unexpected behaviour
-            tails = new float[length] ();
+            this->length = length;
+            heads = allocator.template allocate<float>(length, false);
+            trackPlane(allocator, heads, length * sizeof(float), Memory::PLANE_HEADS, heads);
+            // we should zero tails when allocating heads array for
+            // to avoid unexpected behaviour
+            tails = allocator.template allocate<float>(length, true);
+            trackPlane(allocator, tails, length * sizeof(float), Memory::PLANE_TAILS, heads);
+            placeTails(allocator, tails, length);
+        }
+
+		bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+
+        /*
+            Zeroes the tails through the allocator (see releaseTails), which may give their memory back
+            until they are written again; values then read at full precision are their heads.
+        */
+        void dropTails()
+        {
+            if(tails != nullptr) releaseTails(allocator, tails, length);
+        }
+
+        /* raw segment arrays, for kernels that operate on the segments directly */
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+        /* storage policy the segments were allocated with */
+        const Allocator& getAllocator() const { return allocator; }
+
+        /* view of elements [start, start + n), indexed from 0 (e.g. a partition's part.start_of(k) range) */
+        inline TwoSegSpan<false> subspan(const uint_fast64_t& start, const uint_fast64_t& n) const;
+        inline TwoSegSpan<false> span() const;
+
+        /* iterators over the heads, and their number (see SegmentIterator) */
+        HeadsIterator begin() const { return HeadsIterator(heads, tails); }
+        HeadsIterator end() const { return HeadsIterator(heads + length, tails + length); }
+        uint_fast64_t size() const { return length; }
+
+        /*
+            Deletes the values of the dynamic arrays used to store values in
+            the array.
+            NOTE: this should only be called by one object with references to
+            the same set of values (such as object created using createFullPrecision).
+        */
+        void del()
+        {
+            if(heads != nullptr) { untrackPlane(allocator, heads); allocator.deallocate(heads, length); }
+            if(tails != nullptr) { untrackPlane(allocator, tails); allocator.deallocate(tails, length); }
+			heads = nullptr;
+			tails = nullptr;
+			length = 0;
+        }
+
+    private:
+        float* heads;
+        float* tails;
+        uint_fast64_t length;   // number of elements, as passed to the allocator
+        Allocator allocator;
+    };
+
+
+    /**
+     * Head functions
+    */
+
+    template<>
+    inline Head& Head::operator=(const Head& other)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<>
+    inline Head& Head::operator=(const Head&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<>
+    inline Head& Head::operator=(const Pair& other)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<>
+    inline Head& Head::operator=(const Pair&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<typename T>
+    inline Head& Head::operator=(const T& other)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        MANSEG_ERROR_ADD(ErrorBound::truncation * ErrorBound::magnitude(other));
+        *head = headOf(other);
+        return *this;
+    }
+
+    template<typename T>
+    inline Head& Head::operator=(const T&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        MANSEG_ERROR_ADD(ErrorBound::truncation * ErrorBound::magnitude(other));
+        *head = headOf(other);
+        return *this;
+    }
+
+    template<typename T>
+    double Head::operator+=(const T& rhs)
+    {
+        double t = *this;
+        t += rhs;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator+(Head lhs, const T& rhs)
+    {
+        double d = lhs;
+        d += rhs;
+        return d;
+    }
+
+    template<typename T>
+    double Head::operator-=(const T& rhs)
+    {
+        double t = *this;
+        t -= rhs;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator-(Head lhs, const T& rhs)
+    {
+        double d = lhs;
+        d -= rhs;
+        return d;
+    }
+
+    template<typename T>
+    double Head::operator*=(const T& rhs)
+    {
+        double t = *this;
+        t *= rhs;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator*(Head lhs, const T& rhs)
+    {
+        double d = lhs;
+        d *= rhs;
+        return d;
+    }
+
+    template<typename T>
+    double Head::operator/=(const T& rhs)
+    {
+        double t = *this;
+        t /= rhs;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator/(Head lhs, const T& rhs)
+    {
+        double d = lhs;
+        d /= rhs;
+        return d;
+    }
+
+    /**
+     * ManSegPair functions
+    */
+    template<>
+    inline Pair& Pair::operator=(const Head& other)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<>
+    inline Pair& Pair::operator=(const Head&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(float));
+        *head = *other.head;
+        return *this;
+    }
+
+    template<>
+    inline Pair& Pair::operator=(const Pair& other)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double));
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+        *head = *other.head;
+        *tail = *other.tail;
+        return *this;
+    }
+
+    template<>
+    inline Pair& Pair::operator=(const Pair&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_READ, sizeof(double));
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+        *head = *other.head;
+        *tail = *other.tail;
+        return *this;
+    }
+
+    template<typename T>
+    inline Pair& Pair::operator=(const T& other)
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+        splitSegment(other, head, tail);
+        return *this;
+    }
+
+    template<typename T>
+    inline Pair& Pair::operator=(const T&& other) noexcept
+    {
+        MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+        splitSegment(other, head, tail);
+        return *this;
+    }
+
+    template <typename T>
+    double Pair::operator+=(const T& rhs)
+    {
+        double t = *this;
+        double r = rhs;
+        t += r;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator+(Pair lhs, const T& rhs)
+    {
+        double d = lhs;
+        double r = rhs;
+        d += r;
+        return d;
+    }
+
+    template<typename T>
+    double Pair::operator-=(const T& rhs)
+    {
+        double t = *this;
+        double r = rhs;
+        t -= r;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator-(Pair lhs, const T& rhs)
+    {
+        double d = lhs;
+        double r = rhs;
+        d -= r;
+        return d;
+    }
+
+    template<typename T>
+    double Pair::operator*=(const T& rhs)
+    {
+        double t = *this;
+        double r = rhs;
+        t *= r;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator*(Pair lhs, const T& rhs)
+    {
+        double d = lhs;
+        double r = rhs;
+        d *= r;
+        return d;
+    }
+
+    template<typename T>
+    double Pair::operator/=(const T& rhs)
+    {
+        double t = *this;
+        double r = rhs;
+        t /= r;
+        *this = t;
+        return t;
+    }
+
+    template<typename T>
+    inline double operator/(Pair lhs, const T& rhs)
+    {
+        double d = lhs;
+        double r = rhs;
+        d /= r;
+        return d;
+    }
+
+	/* 
+		convenience typename for TwoSegArray that only accesses the "head" segment 
+		of a double precision number
+		i.e. reduced precision
+	*/
+    using HeadsArray = TwoSegArray<false>;
+
+	/* 
+		convenience typename for TwoSegArray that accesses the full 64 bits of
+		a double precision number
+		i.e. double precision
+	*/
+    using PairsArray = TwoSegArray<true>;
+
+    /*
+        Atomically performs a[id] += value, modifying only the head segment.
+        The head is a single 32-bit word, so this is a CAS loop on the head bits.
+    */
+    template<class Allocator>
+    inline void atomicAdd(TwoSegArray<false, Allocator>& a, const uint_fast64_t& id, const double& value)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        uint32_t* word = reinterpret_cast<uint32_t*>(a.getHeads() + id);
+        uint32_t oldBits, newBits;
+        do
+        {
+            oldBits = atomicLoadRelaxed(word);
+            float oldHead, newHead;
+            memcpy(&oldHead, &oldBits, sizeof(float));
+            newHead = headOf(headToDouble(oldHead) + value);
+            memcpy(&newBits, &newHead, sizeof(float));
+        } while(!atomicCompareExchange(word, oldBits, newBits));
+        MANSEG_ERROR_ADD(ErrorBound::truncation * ErrorBound::magnitude(headToDouble(bitCast<float>(newBits))));
+    }
+
+    /*
+        Atomically performs a[id] = min(a[id], value) on the head, value being truncated to a head first,
+        and returns whether a[id] was lowered. A CAS on the head word, as atomicAdd. Truncation is toward
+        zero, so for values >= 0 the head kept is a lower bound of the smallest value offered, as the
+        tentative distances of a shortest path search need.
+    */
+    template<class Allocator>
+    inline bool atomicMin(TwoSegArray<false, Allocator>& a, const uint_fast64_t& id, const double& value)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        uint32_t* word = reinterpret_cast<uint32_t*>(a.getHeads() + id);
+        const float newHead = headOf(value);
+        uint32_t oldBits, newBits;
+        memcpy(&newBits, &newHead, sizeof(float));
+        do
+        {
+            oldBits = atomicLoadRelaxed(word);
+            if(!(headToDouble(newHead) < headToDouble(bitCast<float>(oldBits))))
+                return false;
+        } while(!atomicCompareExchange(word, oldBits, newBits));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        MANSEG_ERROR_ADD(ErrorBound::truncation * ErrorBound::magnitude(headToDouble(newHead)));
+        return true;
+    }
+
+    /* number of (cache line padded) locks guarding concurrent updates of pairs */
+    constexpr uint_fast64_t PairLockCount = 4096;
+
+    struct alignas(64) PairLock
+    {
+        volatile int locked;
+    };
+
+    inline PairLock& pairLock(const uint_fast64_t& id)
+    {
+        static PairLock locks[PairLockCount];
+        return locks[id % PairLockCount];
+    }
+
+    /*
+        Atomically performs a[id] += value on the full double precision value.
+        The head and tail live in separate arrays, so they cannot be updated with a single CAS;
+        instead updates are serialised through a striped spinlock indexed by id.
+        Only concurrent atomicAdd calls are synchronised; plain reads racing with an update
+        may observe a head and tail from different values.
+    */
+    template<class Allocator>
+    inline void atomicAdd(TwoSegArray<true, Allocator>& a, const uint_fast64_t& id, const double& value)
+    {
+        PairLock& lock = pairLock(id);
+        while(!tryLock(&lock.locked))
+            while(lock.locked)
+                spinPause();
+
+        a[id] += value;
+
+        unlock(&lock.locked);
+    }
+
+    /* a[id] = min(a[id], value) on the full value, through the same striped locks as atomicAdd; returns whether a[id] was lowered */
+    template<class Allocator>
+    inline bool atomicMin(TwoSegArray<true, Allocator>& a, const uint_fast64_t& id, const double& value)
+    {
+        PairLock& lock = pairLock(id);
+        while(!tryLock(&lock.locked))
+            while(lock.locked)
+                spinPause();
+
+        const bool lower = value < a.read(id);
+        if(lower)
+            a[id] = value;
+
+        unlock(&lock.locked);
+        return lower;
+    }
+
+    /* atomically performs *x += value, truncated to the head as h32 arithmetic is (e.g. on an mmap_ptr<h32>) */
+    inline void atomicAdd(h32* x, const double& value)
+    {
+        uint32_t oldBits, newBits;
+        do
+        {
+            oldBits = atomicLoadRelaxed(&x->bits);
+            newBits = h32(static_cast<double>(h32(oldBits, h32::Bits())) + value).bits;
+        } while(!atomicCompareExchange(&x->bits, oldBits, newBits));
+    }
+
+    /* atomically performs *x += value: a seg64 is a single 64-bit word, so unlike pairs it needs no lock */
+    inline void atomicAdd(seg64* x, const double& value)
+    {
+        uint64_t oldBits, newBits;
+        do
+        {
+            oldBits = atomicLoadRelaxed(&x->bits);
+            newBits = seg64(bitCast<double>(oldBits) + value).bits;
+        } while(!atomicCompareExchange(&x->bits, oldBits, newBits));
+    }
+
+    /* number of elements below which interleaveSegments transposes through a stack buffer */
+    constexpr uint_fast64_t InterleaveLeafSize = 2048;
+    /* number of elements above which interleaveSegments spawns omp tasks */
+    constexpr uint_fast64_t InterleaveTaskSize = 1 << 16;
+
+    // taskloop needs OpenMP 4.5 (MSVC only has 2.0); other backends swap the halves with parallelFor
+#if defined(MANSEG_PARALLEL_OPENMP) && _OPENMP >= 201511
+#define MANSEG_OMP_TASKS
+#endif
+
+    inline void interleaveSegmentsRec(float* seg, const uint_fast64_t n)
+    {
+        if(n <= InterleaveLeafSize)
+        {
+            double buf[InterleaveLeafSize];
+            combineSegments(seg, seg + n, n, buf);
+            memcpy(seg, buf, n * sizeof(double));
+            return;
         }
 
-		bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+        // [h1 h2 t1 t2] -> [h1 t1 h2 t2], then each half is an independent subproblem
+        const uint_fast64_t m = n / 2;
+        if(m == n - m)
+        {
+#if defined(MANSEG_OMP_TASKS)
+            #pragma omp taskloop grainsize(InterleaveTaskSize) if(n > InterleaveTaskSize)
+            for(uint_fast64_t i = 0; i < m; ++i)
+                std::swap(seg[m + i], seg[n + i]);
+#else
+            parallelFor(m, [seg, m, n](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                std::swap_ranges(seg + m + begin, seg + m + end, seg + n + begin);
+            }, InterleaveTaskSize);
+#endif
+        }
+        else
+            std::rotate(seg + m, seg + n, seg + n + m);
 
-        /*
-            Deletes the values of the dynamic arrays used to store values in
-            the array.
-            NOTE: this should only be called by one object with references to
-            the same set of values (such as object created using createFullPrecision).
-        */
-        void del()
+#if defined(MANSEG_OMP_TASKS)
+        #pragma omp task if(n > InterleaveTaskSize)
+#endif
+        interleaveSegmentsRec(seg, m);
+        interleaveSegmentsRec(seg + 2 * m, n - m);
+#if defined(MANSEG_OMP_TASKS)
+        #pragma omp taskwait
+#endif
+    }
+
+    /*
+        In-place transpose of a buffer of 2n floats laid out as [heads(n) | tails(n)] into n IEEE doubles.
+        The halves are recursively swapped into place (cache-blocked, parallelised with omp tasks, or
+        with parallelFor on the other backends) until the subproblems are small enough to be combined
+        through a stack buffer.
+        This requires O(n log(n / InterleaveLeafSize)) data movement, but no extra allocation.
+    */
+    inline void interleaveSegments(float* seg, const uint_fast64_t& n)
+    {
+#if defined(MANSEG_OMP_TASKS)
+        #pragma omp parallel
+        #pragma omp single
+#endif
+        interleaveSegmentsRec(seg, n);
+    }
+
+    /*
+        View of an array of IEEE doubles (such as the full array of a ManSegArray) with the same
+        interface as TwoSegArray, so kernels can be written once for every level.
+        Like TwoSegArray, it does not own the values.
+    */
+    class FullView
+    {
+    public:
+        FullView(double* full = nullptr, const uint_fast64_t& length = 0) :full(full), length(length) {}
+
+        double& operator[](const uint_fast64_t& id) { return full[id]; }
+
+        /* values are stored exactly, so mode has no effect */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) { MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double)); full[id] = t; }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t) { MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double)); full[id] = t; }
+
+        double read(const uint_fast64_t& id) const { MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double)); return full[id]; }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
         {
-            if(heads != nullptr) delete[] heads;
-            if(tails != nullptr) delete[] tails;   
-			heads = nullptr;
-			tails = nullptr;
+            MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double) * n);
+            memcpy(out, full + start, n * sizeof(double));
+        }
+
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double) * n);
+            memcpy(full + start, in, n * sizeof(double));
         }
 
+        /* view of elements [start, start + n), indexed from 0 */
+        FullView subspan(const uint_fast64_t& start, const uint_fast64_t& n) const { return FullView(full + start, n); }
+
+        double* getFull() const { return full; }
+        uint_fast64_t size() const { return length; }
+
     private:
-        float* heads;
-        float* tails;
+        double* full;
+        uint_fast64_t length;
     };
 
-
-    /**
-     * Head functions
+    /*
+        Write view for the iterations just before a switch: every store goes to the heads, rounded by
+        mode, and also, exactly, to an array of full values (a ManSegArray's full). read gives the full
+        value, so an update read-modify-write (p[i] = p[i] + x, or a rescale) is exact in the full
+        values, and the heads are rewritten from them. Once the solver switches, the full values are
+        those a heads-in, full-out (interim) iteration would have written, and it can go straight to
+        reading them. Costs 12 bytes a store rather than 4.
     */
+    class DualWriteView
+    {
+    public:
+        DualWriteView(float* heads = nullptr, double* full = nullptr, const uint_fast64_t& length = 0)
+            :heads(heads), full(full), length(length)
+        {}
+
+        double operator[](const uint_fast64_t& id) const { MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double)); return full[id]; }
+        double read(const uint_fast64_t& id) const { MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double)); return full[id]; }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double));
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+            full[id] = t;
+            heads[id] = roundToHead<mode>(full[id]);
+        }
+
+        DualWriteView subspan(const uint_fast64_t& start, const uint_fast64_t& n) const
+        {
+            return DualWriteView(heads + start, full + start, n);
+        }
+
+        float* getHeads() const { return heads; }
+        double* getFull() const { return full; }
+        uint_fast64_t size() const { return length; }
 
+    private:
+        float* heads;
+        double* full;
+        uint_fast64_t length;
+    };
+
+    /*
+        Non-owning view of n consecutive heads (and tails) of a TwoSegArray, from TwoSegArray::subspan.
+        Elements are indexed from the start of the view, so a per-partition kernel sees its range as
+        [0, size()) with base pointers it can vectorise on. Spans never free the values they view.
+    */
     template<>
-    inline Head& Head::operator=(const Head& other)
+    class TwoSegSpan<false>
     {
-        *head = *other.head;
-        return *this;
-    }
+    public:
+        TwoSegSpan(float* heads = nullptr, float* tails = nullptr, const uint_fast64_t& n = 0) :heads(heads), tails(tails), n(n) {}
+
+        Head operator[](const uint_fast64_t& id) const { return Head(&heads[id]); }
+        double read(const uint_fast64_t& id) const { return static_cast<double>(Head(&heads[id])); }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const { MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float)); heads[id] = roundToHead<mode>(t); }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& count, double* out) const
+        {
+            widenHeads(heads + start, count, out);
+        }
 
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& count, const double* in) const
+        {
+            narrowToHeads<mode>(in, count, heads + start);
+        }
+
+        TwoSegSpan<false> subspan(const uint_fast64_t& start, const uint_fast64_t& count) const { return TwoSegSpan<false>(heads + start, tails + start, count); }
+        HeadsIterator begin() const { return HeadsIterator(heads, tails); }
+        HeadsIterator end() const { return HeadsIterator(heads + n, tails + n); }
+        /* the same elements at full precision, as TwoSegArray::createFullPrecision */
+        TwoSegSpan<true> createFullPrecision() const;
+
+        uint_fast64_t size() const { return n; }
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+    private:
+        float* heads;
+        float* tails;
+        uint_fast64_t n;
+    };
+
+    /* Non-owning view of n consecutive pairs of a TwoSegArray; see TwoSegSpan<false> */
     template<>
-    inline Head& Head::operator=(const Head&& other) noexcept
+    class TwoSegSpan<true>
     {
-        *head = *other.head;
-        return *this;
-    }
+    public:
+        TwoSegSpan(float* heads = nullptr, float* tails = nullptr, const uint_fast64_t& n = 0) :heads(heads), tails(tails), n(n) {}
+
+        Pair operator[](const uint_fast64_t& id) const { return Pair(&heads[id], &tails[id]); }
+        double read(const uint_fast64_t& id) const { return static_cast<double>(Pair(&heads[id], &tails[id])); }
+
+        /* values are stored exactly, so mode has no effect */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, sizeof(double));
+            splitSegment(t, heads + id, tails + id);
+        }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& count, double* out) const
+        {
+            combineSegments(heads + start, tails + start, count, out);
+        }
+
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& count, const double* in) const
+        {
+            splitSegments(in, count, heads + start, tails + start);
+        }
+
+        TwoSegSpan<true> subspan(const uint_fast64_t& start, const uint_fast64_t& count) const { return TwoSegSpan<true>(heads + start, tails + start, count); }
+        PairsIterator begin() const { return PairsIterator(heads, tails); }
+        PairsIterator end() const { return PairsIterator(heads + n, tails + n); }
+
+        uint_fast64_t size() const { return n; }
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+    private:
+        float* heads;
+        float* tails;
+        uint_fast64_t n;
+    };
 
-    template<>
-    inline Head& Head::operator=(const Pair& other)
-    {
-        *head = *other.head;
-        return *this;
-    }
+    inline TwoSegSpan<true> TwoSegSpan<false>::createFullPrecision() const { return TwoSegSpan<true>(heads, tails, n); }
 
-    template<>
-    inline Head& Head::operator=(const Pair&& other) noexcept
+    using HeadsSpan = TwoSegSpan<false>;
+    using PairsSpan = TwoSegSpan<true>;
+
+    template<class Allocator>
+    inline TwoSegSpan<true> TwoSegArray<true, Allocator>::subspan(const uint_fast64_t& start, const uint_fast64_t& n) const
     {
-        *head = *other.head;
-        return *this;
+        return TwoSegSpan<true>(heads + start, tails + start, n);
     }
 
-    template<typename T>
-    inline Head& Head::operator=(const T& other)
+    template<class Allocator>
+    inline TwoSegSpan<true> TwoSegArray<true, Allocator>::span() const { return subspan(0, length); }
+
+    template<class Allocator>
+    inline TwoSegSpan<false> TwoSegArray<false, Allocator>::subspan(const uint_fast64_t& start, const uint_fast64_t& n) const
     {
-        double d = other;
-        __m128d d_v = _mm_set_pd(0.0, d);
-        __m128 seg_v = _mm_castpd_ps(d_v);
-        *head = seg_v[1];
-        return *this;
+        return TwoSegSpan<false>(heads + start, tails + start, n);
     }
 
-    template<typename T>
-    inline Head& Head::operator=(const T&& other) noexcept
+    template<class Allocator>
+    inline TwoSegSpan<false> TwoSegArray<false, Allocator>::span() const { return subspan(0, length); }
+
+    /* hint to the CPU to bring the cache line holding address into cache, for reading (no-op where unsupported) */
+    inline void prefetchLine(const void* address)
     {
-        double d = other;
-        __m128d d_v = _mm_set_pd(0.0, d);
-        __m128 seg_v = _mm_castpd_ps(d_v);
-        *head = seg_v[1];
-        return *this;
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address, 0, 3);
+#elif defined(MANSEG_X86)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
     }
 
-    template<typename T>
-    double Head::operator+=(const T& rhs)
+    /*
+        Prefetches element id of a view, for indirect reads (e.g. p[s] for the source s of an edge) that
+        the hardware prefetcher cannot predict: issue it some accesses ahead of the read. A line holds 16
+        heads, or 8 doubles, so prefetching the heads brings in twice the elements per line; pairs
+        prefetch both their head and their tail.
+    */
+    template<class Allocator>
+    inline void prefetch(const TwoSegArray<false, Allocator>& a, const uint_fast64_t& id) { prefetchLine(a.getHeads() + id); }
+
+    template<class Allocator>
+    inline void prefetch(const TwoSegArray<true, Allocator>& a, const uint_fast64_t& id)
     {
-        double t = *this;
-        t += rhs;
-        *this = t;
-        return t;
+        prefetchLine(a.getHeads() + id);
+        prefetchLine(a.getTails() + id);
     }
 
-    template<typename T>
-    inline double operator+(Head lhs, const T& rhs)
+    inline void prefetch(const HeadsSpan& a, const uint_fast64_t& id) { prefetchLine(a.getHeads() + id); }
+
+    inline void prefetch(const PairsSpan& a, const uint_fast64_t& id)
     {
-        double d = lhs;
-        d += rhs;
-        return d;
+        prefetchLine(a.getHeads() + id);
+        prefetchLine(a.getTails() + id);
     }
 
-    template<typename T>
-    double Head::operator-=(const T& rhs)
+    inline void prefetch(const FullView& a, const uint_fast64_t& id) { prefetchLine(a.getFull() + id); }
+
+    inline void prefetch(const double* a, const uint_fast64_t& id) { prefetchLine(a + id); }
+
+    /* Atomically performs a[id] += value, as a CAS loop on the double's bits */
+    inline void atomicAdd(FullView& a, const uint_fast64_t& id, const double& value)
     {
-        double t = *this;
-        t -= rhs;
-        *this = t;
-        return t;
+        uint64_t* word = reinterpret_cast<uint64_t*>(&a[id]);
+        uint64_t oldBits, newBits;
+        do
+        {
+            oldBits = atomicLoadRelaxed(word);
+            double old;
+            memcpy(&old, &oldBits, sizeof(double));
+            double next = old + value;
+            memcpy(&newBits, &next, sizeof(double));
+        } while(!atomicCompareExchange(word, oldBits, newBits));
     }
 
-    template<typename T>
-    inline double operator-(Head lhs, const T& rhs)
+    /* Atomically performs a[id] = min(a[id], value), as a CAS loop on the double's bits; returns whether a[id] was lowered */
+    inline bool atomicMin(FullView& a, const uint_fast64_t& id, const double& value)
     {
-        double d = lhs;
-        d -= rhs;
-        return d;
+        uint64_t* word = reinterpret_cast<uint64_t*>(&a[id]);
+        uint64_t oldBits, newBits;
+        memcpy(&newBits, &value, sizeof(double));
+        do
+        {
+            oldBits = atomicLoadRelaxed(word);
+            if(!(value < bitCast<double>(oldBits)))
+                return false;
+        } while(!atomicCompareExchange(word, oldBits, newBits));
+        return true;
     }
 
-    template<typename T>
-    double Head::operator*=(const T& rhs)
+    /*
+        a[id] += value atomically in the full values. The head is stored after, so with concurrent adds it may
+        lag the full value until the next set of id (e.g. a rescale) rewrites it from the full value.
+    */
+    inline void atomicAdd(DualWriteView& a, const uint_fast64_t& id, const double& value)
     {
-        double t = *this;
-        t *= rhs;
-        *this = t;
-        return t;
+        FullView full(a.getFull(), a.size());
+        atomicAdd(full, id, value);
+        const uint64_t bits = atomicLoadRelaxed(reinterpret_cast<uint64_t*>(a.getFull() + id));
+        double now;
+        memcpy(&now, &bits, sizeof(double));
+        a.getHeads()[id] = roundToHead<ROUND_TRUNCATE>(now);
     }
 
-    template<typename T>
-    inline double operator*(Head lhs, const T& rhs)
+    inline void prefetch(const DualWriteView& a, const uint_fast64_t& id)
     {
-        double d = lhs;
-        d *= rhs;
-        return d;
+        prefetchLine(a.getHeads() + id);
+        prefetchLine(a.getFull() + id);
     }
 
-    template<typename T>
-    double Head::operator/=(const T& rhs)
+    /*
+        Indirect access through a view: out[i] = a[idx[i]], and a[idx[i]] += values[i] (or value) in order of i.
+        The overloads mirror atomicAdd, so a kernel templated on its view types can gather from, or
+        scatter into, heads, pairs or full values, e.g. scatterAdd(newPr, dest + curr, next - curr, contr[i]).
+        Heads updates are truncated, as Head::operator+= is, unless another RoundingMode is given.
+    */
+    template<class Allocator>
+    inline void gather(const TwoSegArray<false, Allocator>& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        double t = *this;
-        t /= rhs;
-        *this = t;
-        return t;
+        gatherHeads(a.getHeads(), idx, n, out);
     }
 
-    template<typename T>
-    inline double operator/(Head lhs, const T& rhs)
+    template<class Allocator>
+    inline void gather(const TwoSegArray<true, Allocator>& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        double d = lhs;
-        d /= rhs;
-        return d;
+        gatherSegments(a.getHeads(), a.getTails(), idx, n, out);
     }
 
-    /**
-     * ManSegPair functions
-    */
-    template<>
-    inline Pair& Pair::operator=(const Head& other)
+    inline void gather(const HeadsSpan& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        *head = *other.head;
-        return *this;
+        gatherHeads(a.getHeads(), idx, n, out);
     }
 
-    template<>
-    inline Pair& Pair::operator=(const Head&& other) noexcept
+    inline void gather(const PairsSpan& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        *head = *other.head;
-        return *this;
+        gatherSegments(a.getHeads(), a.getTails(), idx, n, out);
     }
 
-    template<>
-    inline Pair& Pair::operator=(const Pair& other)
+    inline void gather(const FullView& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        *head = *other.head;
-        *tail = *other.tail;
-        return *this;
+        const double* full = a.getFull();
+        for(uint_fast64_t i = 0; i < n; ++i)
+            out[i] = full[idx[i]];
     }
 
-    template<>
-    inline Pair& Pair::operator=(const Pair&& other) noexcept
+    /* gather with the indices divided between the workers of the parallel backend (see parallelFor) */
+    template<class View>
+    inline void parallelGather(const View& a, const int32_t* idx, const uint_fast64_t& n, double* out)
     {
-        *head = *other.head;
-        *tail = *other.tail;
-        return *this;
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            gather(a, idx + begin, end - begin, out + begin);
+        });
     }
 
-    template<typename T>
-    inline Pair& Pair::operator=(const T& other)
+    /*
+        a.set<mode>(start + i, value) for n values of a view, with the range divided between the
+        workers of the parallel backend.
+    */
+    template<RoundingMode mode = ROUND_TRUNCATE, class View>
+    inline void parallelFill(View&& a, const uint_fast64_t& start, const uint_fast64_t& n, const double& value)
     {
-        double d = other;
-        __m128d d_v = _mm_set_pd(0.0, d);
-        __m128 seg_v = _mm_castpd_ps(d_v);
-        *tail = seg_v[0];
-        *head = seg_v[1];
-        return *this;
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t i = begin; i < end; ++i)
+                a.template set<mode>(start + i, value);
+        });
     }
 
-    template<typename T>
-    inline Pair& Pair::operator=(const T&& other) noexcept
+    template<RoundingMode mode = ROUND_TRUNCATE, class Allocator, typename V>
+    inline void scatterAdd(const TwoSegArray<false, Allocator>& a, const int32_t* idx, const uint_fast64_t& n, const V& values)
     {
-        double d = other;
-        __m128d d_v = _mm_set_pd(0.0, d);
-        __m128 seg_v = _mm_castpd_ps(d_v);
-        *tail = seg_v[0];
-        *head = seg_v[1];
-        return *this;
+        scatterAddHeads<mode>(a.getHeads(), idx, n, values);
     }
 
-    template <typename T>
-    double Pair::operator+=(const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE, typename V>
+    inline void scatterAdd(const HeadsSpan& a, const int32_t* idx, const uint_fast64_t& n, const V& values)
     {
-        double t = *this;
-        double r = rhs;
-        t += r;
-        *this = t;
-        return t;
+        scatterAddHeads<mode>(a.getHeads(), idx, n, values);
     }
 
-    template<typename T>
-    inline double operator+(Pair lhs, const T& rhs)
+    /* values are stored exactly, so mode has no effect */
+    template<RoundingMode mode = ROUND_TRUNCATE, class Allocator>
+    inline void scatterAdd(const TwoSegArray<true, Allocator>& a, const int32_t* idx, const uint_fast64_t& n, const double* values)
     {
-        double d = lhs;
-        double r = rhs;
-        d += r;
-        return d;
+        scatterAddSegmentsStep(a.getHeads(), a.getTails(), idx, n, values, 1);
     }
 
-    template<typename T>
-    double Pair::operator-=(const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE, class Allocator>
+    inline void scatterAdd(const TwoSegArray<true, Allocator>& a, const int32_t* idx, const uint_fast64_t& n, const double& value)
     {
-        double t = *this;
-        double r = rhs;
-        t -= r;
-        *this = t;
-        return t;
+        scatterAddSegmentsStep(a.getHeads(), a.getTails(), idx, n, &value, 0);
     }
 
-    template<typename T>
-    inline double operator-(Pair lhs, const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAdd(const PairsSpan& a, const int32_t* idx, const uint_fast64_t& n, const double* values)
     {
-        double d = lhs;
-        double r = rhs;
-        d -= r;
-        return d;
+        scatterAddSegmentsStep(a.getHeads(), a.getTails(), idx, n, values, 1);
     }
 
-    template<typename T>
-    double Pair::operator*=(const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAdd(const PairsSpan& a, const int32_t* idx, const uint_fast64_t& n, const double& value)
     {
-        double t = *this;
-        double r = rhs;
-        t *= r;
-        *this = t;
-        return t;
+        scatterAddSegmentsStep(a.getHeads(), a.getTails(), idx, n, &value, 0);
     }
 
-    template<typename T>
-    inline double operator*(Pair lhs, const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAdd(const FullView& a, const int32_t* idx, const uint_fast64_t& n, const double* values)
     {
-        double d = lhs;
-        double r = rhs;
-        d *= r;
-        return d;
+        double* full = a.getFull();
+        for(uint_fast64_t i = 0; i < n; ++i)
+            full[idx[i]] += values[i];
     }
 
-    template<typename T>
-    double Pair::operator/=(const T& rhs)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void scatterAdd(const FullView& a, const int32_t* idx, const uint_fast64_t& n, const double& value)
     {
-        double t = *this;
-        double r = rhs;
-        t /= r;
-        *this = t;
-        return t;
+        double* full = a.getFull();
+        for(uint_fast64_t i = 0; i < n; ++i)
+            full[idx[i]] += value;
     }
 
-    template<typename T>
-    inline double operator/(Pair lhs, const T& rhs)
+    /* level a ManSegArray is read or written at */
+    enum AccessLevel { ACCESS_HEADS, ACCESS_PAIRS, ACCESS_FULL };
+
+    /*
+        Maps an AccessLevel to the view type of that level: TwoSegArray<false>, TwoSegArray<true> or FullView.
+        All three provide operator[], read, set<mode>, readBlock and writeBlock, so a kernel templated
+        on its view types is instantiated once per (read level, write level) pair, e.g.
+            template<class In, class Out> void sweep(In x, Out y);
+            sweep(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_FULL>()); // the interim step
+    */
+    template<AccessLevel level, class Allocator = SegmentAllocator>
+    struct LevelView;
+
+    template<class Allocator>
+    struct LevelView<ACCESS_HEADS, Allocator>
     {
-        double d = lhs;
-        double r = rhs;
-        d /= r;
-        return d;
-    }
+        using type = TwoSegArray<false, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.heads; }
+    };
 
-	/* 
-		convenience typename for TwoSegArray that only accesses the "head" segment 
-		of a double precision number
-		i.e. reduced precision
-	*/
-    using HeadsArray = TwoSegArray<false>;
+    template<class Allocator>
+    struct LevelView<ACCESS_PAIRS, Allocator>
+    {
+        using type = TwoSegArray<true, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.pairs; }
+    };
 
-	/* 
-		convenience typename for TwoSegArray that accesses the full 64 bits of
-		a double precision number
-		i.e. double precision
-	*/
-    using PairsArray = TwoSegArray<true>;
+    template<class Allocator>
+    struct LevelView<ACCESS_FULL, Allocator>
+    {
+        using type = FullView;
+        template<class Array>
+        static type of(Array& a) { return FullView(a.full, a.length); }
+    };
 
     /*
         Convenient type for use of TwoSegArray<false> and TwoSegArray<true> without having to manage two separate sets of arrays.
-		Note: the class deconstructor does not free space automatically, so use the delSegments and del functions to clean up.
+		The array owns its segments and full array: the destructor frees whatever delSegments and del have not,
+		and it can be moved (or swapped) but not copied. heads and pairs remain shallow views of the segments,
+		so copies of them must not outlive the array.
         
         @heads - used to access only the upper 32 bits of a double : [sign(1), exp(11), mantissa(20)]
         @pairs - used to access all 64 bits of a double : [sign(1), exp(11), mantissa(52)] (slow, but does not require extra memory)
         @full - used to access all 64 bits of double, in the standard IEEE method (fast, recommended, but requires extra space)
+
+        All storage (segments and full) is obtained from Allocator; see SegmentAllocator.
     */
-    class ManSegArray
+    template<class Allocator = SegmentAllocator>
+    class BasicManSegArray
     {
     public:
-        HeadsArray heads; 		// provides access to values in reduced precision (i.e. the upper 32 bits of a double precision number)
-        PairsArray pairs; 		// provides access to values in full precision, by converting values from segments (i.e. all 64 bits of a double precision number)
+        using HeadsType = TwoSegArray<false, Allocator>;
+        using PairsType = TwoSegArray<true, Allocator>;
+
+        HeadsType heads; 		// provides access to values in reduced precision (i.e. the upper 32 bits of a double precision number)
+        PairsType pairs; 		// provides access to values in full precision, by converting values from segments (i.e. all 64 bits of a double precision number)
         double* full; 			// standard double precision access; requires use of copyToIEEEdouble, or manual population
         uint_fast64_t length; 	// length of allocated array; should be manually set if parameterised constructor/alloc is not used.
 
-        ManSegArray() { full = nullptr; length = 0; }
+        BasicManSegArray(const Allocator& allocator = Allocator())
+            :allocator(allocator)
+        { full = nullptr; length = 0; segmentBlock = nullptr; }
+
+        /* frees the segments and full array, if they have not been freed already */
+        ~BasicManSegArray()
+        {
+            delSegments();
+            del();
+        }
+
+        // the array owns its storage, so it can be moved but not copied
+        BasicManSegArray(const BasicManSegArray&) = delete;
+        BasicManSegArray& operator=(const BasicManSegArray&) = delete;
+
+        BasicManSegArray(BasicManSegArray&& other) noexcept
+            :heads(other.heads), pairs(other.pairs), full(other.full), length(other.length),
+            segmentBlock(other.segmentBlock), allocator(other.allocator)
+        {
+            other.release();
+        }
+
+        BasicManSegArray& operator=(BasicManSegArray&& other) noexcept
+        {
+            if(this != &other)
+            {
+                delSegments();
+                del();
+                heads = other.heads;
+                pairs = other.pairs;
+                full = other.full;
+                length = other.length;
+                segmentBlock = other.segmentBlock;
+                allocator = other.allocator;
+                other.release();
+            }
+            return *this;
+        }
+
+        /*
+            Exchanges the storage of two arrays (heads, pairs, full and any contiguous block) in one go,
+            e.g. swap(p_curr, p_next) at the end of an iteration.
+        */
+        void swap(BasicManSegArray& other) noexcept
+        {
+            std::swap(heads, other.heads);
+            std::swap(pairs, other.pairs);
+            std::swap(full, other.full);
+            std::swap(length, other.length);
+            std::swap(segmentBlock, other.segmentBlock);
+            std::swap(allocator, other.allocator);
+        }
 
-        ~ManSegArray() { }
+        friend void swap(BasicManSegArray& a, BasicManSegArray& b) noexcept { a.swap(b); }
 
-        ManSegArray(const uint_fast64_t& length)
+        BasicManSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :allocator(allocator)
         {
             this->length = length;
-            heads.alloc(length);
+            heads = HeadsType(length, allocator);
             pairs = heads.createFullPrecision();
 			full = nullptr;
+			segmentBlock = nullptr;
         }
 
         /*
@@ -649,39 +2957,246 @@ namespace ManSeg
         */
         void alloc(const uint_fast64_t& length)
         {
+            MANSEG_TRACE_SCOPE_ARG("alloc", "length", length);
 			this->length = length;
-            heads.alloc(length);
+            heads = HeadsType(length, allocator);
+            pairs = heads.createFullPrecision();
+			segmentBlock = nullptr;
+        }
+
+        /*
+            Views of the array at the given level (see LevelView), which share its values.
+            The two are the same view; the names document which side of a kernel they feed.
+            For ACCESS_FULL, full must already be allocated (see allocFull).
+        */
+        template<AccessLevel level>
+        typename LevelView<level, Allocator>::type read_as() { return LevelView<level, Allocator>::of(*this); }
+
+        template<AccessLevel level>
+        typename LevelView<level, Allocator>::type write_as() { return LevelView<level, Allocator>::of(*this); }
+
+        /*
+            Allocates (uninitialised) space for the full IEEE double array, without copying any values.
+            Use this rather than assigning new[] to full when a custom Allocator is used.
+        */
+        void allocFull()
+        {
+            MANSEG_TRACE_SCOPE_ARG("allocFull", "length", length);
+            full = allocator.template allocate<double>(length, false);
+            trackPlane(allocator, full, length * sizeof(double), Memory::PLANE_FULL, heads.getHeads());
+        }
+
+        /*
+            Allocates length elements as a single buffer of length doubles, with the heads in the
+            first half and the tails in the second half.
+            This allows the precision switch to be done in-place using promoteInPlace, so that
+            at no point are the segments and full array resident at the same time.
+        */
+        void allocContiguous(const uint_fast64_t& length)
+        {
+            MANSEG_TRACE_SCOPE_ARG("allocContiguous", "length", length);
+            this->length = length;
+            segmentBlock = allocator.template allocate<double>(length, true);
+            trackPlane(allocator, segmentBlock, length * sizeof(double), Memory::PLANE_SEGMENTS, segmentBlock);
+            float* seg = reinterpret_cast<float*>(segmentBlock);
+            heads = HeadsType(seg, seg + length, length, allocator);
             pairs = heads.createFullPrecision();
+			full = nullptr;
         }
 
         /*
-            Implements precision switching by allocating length space for copying the full 64-bit values from
-			the pairs array to the full doubles array.
+            Implements precision switching by allocating length space for copying the values of the heads
+			to the full doubles array (the tails are not copied; see promote for that).
 
-            This is implemented using omp parallel, however it can also be accomplished by the user, as full is
+            This runs on the parallel backend (see parallelFor), however it can also be accomplished by the user, as full is
 			publically available. Note: the length variable should be set if a user implemented copy is performed.
         */
         void copytoIEEEdouble()
         {
-            full = new double[length];
+            MANSEG_TRACE_SCOPE_ARG("copytoIEEEdouble", "length", length);
+            MANSEG_TRAFFIC_ADD(PROMOTED, length);
+            full = allocator.template allocate<double>(length, false);
+            trackPlane(allocator, full, length * sizeof(double), Memory::PLANE_FULL, heads.getHeads());
+
+            parallelFor(length, [this](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                streamSegments(heads.getHeads() + begin, nullptr, end - begin, full + begin);
+            });
+        }
+
+        /*
+            Precision switching at full precision: allocates full, if it is not already, and fills it with
+            the doubles the heads and tails make up. The parallel backend divides the array between its
+            workers, which write full with streaming stores (see streamSegments), so the switch is a single
+            pass over memory that neither reads full first nor evicts the working set. The segments are
+            kept; delSegments frees them.
+        */
+        void promote()
+        {
+            MANSEG_TRACE_SCOPE_ARG("promote", "length", length);
+            MANSEG_TRAFFIC_ADD(PROMOTED, length);
+            if(full == nullptr)
+                allocFull();
+
+            parallelFor(length, [this](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                streamSegments(pairs.getHeads() + begin, pairs.getTails() + begin, end - begin, full + begin);
+            });
+        }
+
+        /*
+            Implements precision switching for arrays allocated with allocContiguous, by transposing
+            the heads and tails in-place into length IEEE doubles, which full then points to.
+            After this, heads and pairs are no longer valid, and del() frees the space.
+        */
+        void promoteInPlace()
+        {
+            if(segmentBlock == nullptr) return;
+
+            MANSEG_TRACE_SCOPE_ARG("promoteInPlace", "length", length);
+            MANSEG_TRAFFIC_ADD(PROMOTED, length);
+            // the pairs read are counted by the transpose's combineSegments
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double) * length);
+            interleaveSegments(reinterpret_cast<float*>(segmentBlock), length);
+            Memory::retype(segmentBlock, Memory::PLANE_FULL);
+            full = segmentBlock;
+            segmentBlock = nullptr;
+            heads = HeadsType();
+            pairs = PairsType();
+        }
 
-            #pragma omp parallel for
-			for(int i = 0; i < length; ++i)
-				full[i] = heads[i];
+        /*
+            Goes back from the full doubles to the segments, e.g. to give memory back when it is short:
+            the values of full are split into heads and tails, exactly, and full is freed. With dropTails
+            they are rounded to the heads according to mode instead, and the tails are dropped too (see
+            TwoSegArray::dropTails), so the array goes on at the heads. An array without full values
+            rounds its pairs to their heads for dropTails, and is otherwise left alone. An array promoted
+            in place has its segments allocated again, so it needs room for them before full is freed.
+        */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void demote(const bool& dropTails = false)
+        {
+            MANSEG_TRACE_SCOPE_ARG("demote", "length", length);
+            if(!heads.isAlloc())
+            {
+                if(full == nullptr) return;
+                heads = HeadsType(length, allocator);
+                pairs = heads.createFullPrecision();
+            }
+
+            if(full != nullptr)
+            {
+                parallelFor(length, [this, &dropTails](const uint_fast64_t& begin, const uint_fast64_t& end)
+                {
+                    if(dropTails)
+                        heads.template writeBlock<mode>(begin, end - begin, full + begin);
+                    else
+                        pairs.writeBlock(begin, end - begin, full + begin);
+                });
+                untrackPlane(allocator, full);
+                allocator.deallocate(full, length);
+                full = nullptr;
+            }
+            else if(dropTails && mode != ROUND_TRUNCATE)
+            {
+                parallelFor(length, [this](const uint_fast64_t& begin, const uint_fast64_t& end)
+                {
+                    for(uint_fast64_t i = begin; i < end; ++i)
+                        heads.template set<mode>(i, pairs.read(i));
+                });
+            }
+            if(dropTails)
+                heads.dropTails();
         }
 
         /* 
             Deletes space allocated to the segments arrays.
             WARNING: should only be called once, as heads and pairs share the array space.
         */
-        void delSegments() { heads.del(); if(full == nullptr) length = 0; }
+        void delSegments()
+        {
+            if(segmentBlock != nullptr)
+            {
+                untrackPlane(allocator, segmentBlock);
+                allocator.deallocate(segmentBlock, length);
+                segmentBlock = nullptr;
+                heads = HeadsType();
+                pairs = PairsType();
+            }
+            else
+                heads.del();
+            if(full == nullptr) length = 0;
+        }
 
 		/*
 			Deletes space allocated to full IEEE double precision array.
-			Must be called in order to free space.
+			Frees it before the array goes out of scope (e.g. once the computation has switched back to segments).
 		*/
-		void del() { if(full != nullptr) delete[] full; full = nullptr; if(!heads.isAlloc()) length = 0; }
+		void del() { if(full != nullptr) { untrackPlane(allocator, full); allocator.deallocate(full, length); } full = nullptr; if(!heads.isAlloc()) length = 0; }
+
+        /*
+            Names the array's planes in the memory report (see manseglib_memory.hpp), those allocated
+            so far and those it allocates later, such as its full doubles. Call it once it is allocated.
+        */
+        void label(const char* name) { Memory::label(heads.isAlloc() ? static_cast<const void*>(heads.getHeads()) : full, name); }
+
+    private:
+        double* segmentBlock;   // single allocation backing heads and tails, if allocated with allocContiguous
+        Allocator allocator;
+
+        /* forgets the storage without freeing it, after it has been moved to another array */
+        void release()
+        {
+            heads = HeadsType();
+            pairs = PairsType();
+            full = nullptr;
+            length = 0;
+            segmentBlock = nullptr;
+        }
     };
+
+    /*
+        Reads one ManSegArray at level Read and writes another (or the same one) at level Write, e.g.
+        the interim step of a precision switch reads the heads of x and writes the full values of y.
+            ReadWriteView<ACCESS_HEADS, ACCESS_FULL> v(x, y);
+            v.write(i, f(v.read(i)));
+        in and out are the underlying views, for kernels which take the two separately.
+    */
+    template<AccessLevel Read, AccessLevel Write, class Allocator = SegmentAllocator>
+    struct ReadWriteView
+    {
+        typename LevelView<Read, Allocator>::type in;
+        typename LevelView<Write, Allocator>::type out;
+
+        ReadWriteView(BasicManSegArray<Allocator>& src, BasicManSegArray<Allocator>& dst)
+            :in(src.template read_as<Read>()), out(dst.template write_as<Write>())
+        {}
+
+        /* reads and writes the same array, e.g. to promote it in a single sweep */
+        ReadWriteView(BasicManSegArray<Allocator>& a)
+            :in(a.template read_as<Read>()), out(a.template write_as<Write>())
+        {}
+
+        double read(const uint_fast64_t& id) { return in.read(id); }
+
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void write(const uint_fast64_t& id, const double& d) { out.template set<mode>(id, d); }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* values) const { in.readBlock(start, n, values); }
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* values) { out.writeBlock(start, n, values); }
+    };
+
+    /* the interim step: read the heads, write full IEEE doubles */
+    template<class Allocator = SegmentAllocator>
+    using InterimView = ReadWriteView<ACCESS_HEADS, ACCESS_FULL, Allocator>;
+
+    /* ManSegArray using the default new[]/delete[] storage */
+    using ManSegArray = BasicManSegArray<>;
+
+#if defined(__unix__) || defined(__APPLE__)
+    /* ManSegArray whose tails are not made resident until they are written */
+    using LazyManSegArray = BasicManSegArray<LazySegmentAllocator>;
+#endif
 }
 
 #endif
@@ -0,0 +1,289 @@
+/*
+	Per block adaptive precision for blocked mantissa segmented arrays.
+	Author: harunadess
+
+	ManSegArray switches precision for a whole array at once, so in a blocked computation (e.g. the
+	NB x NB grid of the Jacobi stencil) every block keeps being read at the lowest precision until the
+	slowest block has converged, and then every block pays for reading tails.
+	BlockAdaptiveArray keeps one precision level per block instead: each block is read and written
+	through its heads until its own delta drops below the bound, and is then promoted on its own.
+	Blocks are visited with forEachBlock (or a Block handle from block(b)), which passes the kernel
+	the heads or pairs view of the block, so the kernel is instantiated for both and the right one
+	is chosen per block.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_ADAPTIVE_H__
+#define __MANSEG_ADAPTIVE_H__
+
+#include <math.h>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* precision level of a single block; blocks only move from heads to pairs */
+    enum BlockPrecision { BLOCK_HEADS, BLOCK_PAIRS };
+
+    /*
+        Array of numBlocks blocks of blockSize values each, with a precision level per block.
+        All blocks share a single heads and a single tails allocation (block b holds the elements
+        [b * blockSize, (b + 1) * blockSize)), and the tails start zeroed.
+        While a block is at BLOCK_HEADS only its heads are written, so its tails are still zero and
+        promotion is free: the pairs view of the block reads exactly the values the heads held.
+
+        As with the other arrays, the deconstructor does not free space; use del().
+    */
+    template<class Allocator = SegmentAllocator>
+    class BlockAdaptiveArray
+    {
+    public:
+        using HeadsType = TwoSegArray<false, Allocator>;
+        using PairsType = TwoSegArray<true, Allocator>;
+
+        /*
+            Handle to one block, giving its views and dispatching kernels to the view
+            matching its current precision.
+        */
+        class Block
+        {
+        public:
+            Block(BlockAdaptiveArray* array, const uint_fast64_t& index) :array(array), id(index) {}
+
+            uint_fast64_t index() const { return id; }
+            BlockPrecision precision() const { return array->precision(id); }
+            HeadsType heads() const { return array->heads(id); }
+            PairsType pairs() const { return array->pairs(id); }
+
+            /*
+                Calls kernel(index, view), where view is the HeadsType or PairsType view of the block.
+                Kernel must therefore accept both view types, e.g. a functor with two operator()
+                overloads, or a template operator().
+            */
+            template<class Kernel>
+            void dispatch(Kernel& kernel) const
+            {
+                if(precision() == BLOCK_HEADS)
+                    kernel(id, heads());
+                else
+                    kernel(id, pairs());
+            }
+
+        private:
+            BlockAdaptiveArray* array;
+            uint_fast64_t id;
+        };
+
+        BlockAdaptiveArray(const Allocator& allocator = Allocator())
+            :levels(nullptr), blocks(0), size(0), promoted(0), allocator(allocator)
+        {}
+
+        BlockAdaptiveArray(const uint_fast64_t& numBlocks, const uint_fast64_t& blockSize, const Allocator& allocator = Allocator())
+            :levels(nullptr), blocks(0), size(0), promoted(0), allocator(allocator)
+        {
+            alloc(numBlocks, blockSize);
+        }
+
+        ~BlockAdaptiveArray() { }
+
+        /* Allocates numBlocks blocks of blockSize elements, all at BLOCK_HEADS */
+        void alloc(const uint_fast64_t& numBlocks, const uint_fast64_t& blockSize)
+        {
+            blocks = numBlocks;
+            size = blockSize;
+            promoted = 0;
+            storage = HeadsType(numBlocks * blockSize, allocator);
+            levels = new BlockPrecision[numBlocks];
+            for(uint_fast64_t b = 0; b < numBlocks; ++b)
+                levels[b] = BLOCK_HEADS;
+        }
+
+        uint_fast64_t numBlocks() const { return blocks; }
+        uint_fast64_t blockSize() const { return size; }
+        /* number of blocks promoted to BLOCK_PAIRS */
+        uint_fast64_t numPromoted() const { return promoted; }
+        bool allPromoted() const { return promoted == blocks; }
+
+        BlockPrecision precision(const uint_fast64_t& b) const { return levels[b]; }
+
+        /* views of block b; these share the array's storage */
+        HeadsType heads(const uint_fast64_t& b) const
+        {
+            return HeadsType(storage.getHeads() + b * size, storage.getTails() + b * size, size, allocator);
+        }
+        PairsType pairs(const uint_fast64_t& b) const
+        {
+            return PairsType(storage.getHeads() + b * size, storage.getTails() + b * size, size, allocator);
+        }
+
+        Block block(const uint_fast64_t& b) { return Block(this, b); }
+
+        /* Reads element i of block b at the block's precision */
+        double read(const uint_fast64_t& b, const uint_fast64_t& i) const
+        {
+            const uint_fast64_t id = b * size + i;
+            if(levels[b] == BLOCK_HEADS)
+                return static_cast<double>(Head(&storage.getHeads()[id]));
+            return static_cast<double>(Pair(&storage.getHeads()[id], &storage.getTails()[id]));
+        }
+
+        /* Writes element i of block b at the block's precision */
+        void write(const uint_fast64_t& b, const uint_fast64_t& i, const double& d)
+        {
+            const uint_fast64_t id = b * size + i;
+            if(levels[b] == BLOCK_HEADS)
+            {
+                Head h(&storage.getHeads()[id]);
+                h = d;
+            }
+            else
+            {
+                Pair p(&storage.getHeads()[id], &storage.getTails()[id]);
+                p = d;
+            }
+        }
+
+        /* Reads n elements of block b from start into out, at the block's precision */
+        void readBlock(const uint_fast64_t& b, const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            if(levels[b] == BLOCK_HEADS)
+                heads(b).readBlock(start, n, out);
+            else
+                pairs(b).readBlock(start, n, out);
+        }
+
+        /* Writes n elements of in to block b from start, at the block's precision */
+        void writeBlock(const uint_fast64_t& b, const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            if(levels[b] == BLOCK_HEADS)
+                heads(b).writeBlock(start, n, in);
+            else
+                pairs(b).writeBlock(start, n, in);
+        }
+
+        /*
+            Promotes block b to BLOCK_PAIRS, returning false if it already was.
+            Different blocks may be promoted concurrently.
+            If the tails of the block may have been written while at BLOCK_HEADS (e.g. through setPair),
+            pass clearTails so the pairs view starts from the heads values.
+        */
+        bool promote(const uint_fast64_t& b, const bool& clearTails = false)
+        {
+            if(levels[b] == BLOCK_PAIRS) return false;
+            MANSEG_TRAFFIC_ADD(PROMOTED, size);
+            if(clearTails)
+            {
+                MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, size * sizeof(float));
+                memset(storage.getTails() + b * size, 0, size * sizeof(float));
+            }
+            levels[b] = BLOCK_PAIRS;
+            atomicIncrementRelaxed(&promoted); // blocks may be promoted from parallel loops
+            return true;
+        }
+
+        /* Promotes block b if delta (e.g. from maxDelta) is within bound */
+        bool promoteIfConverged(const uint_fast64_t& b, const double& delta, const double& bound = AdaptivePrecisionBound)
+        {
+            return (delta <= bound) && promote(b);
+        }
+
+        /*
+            Maximum absolute difference between block b of this array and block b of other,
+            each read at its own precision.
+        */
+        double maxDelta(const uint_fast64_t& b, const BlockAdaptiveArray& other) const
+        {
+            const uint_fast64_t chunk = 256;
+            double mine[chunk], theirs[chunk];
+            double delta = 0.0;
+            for(uint_fast64_t s = 0; s < size; s += chunk)
+            {
+                const uint_fast64_t n = std::min(chunk, size - s);
+                readBlock(b, s, n, mine);
+                other.readBlock(b, s, n, theirs);
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    delta = std::max(delta, fabs(mine[i] - theirs[i]));
+            }
+            return delta;
+        }
+
+        /*
+            Copies block b of src into block b of this array, copying tails as well if src's block
+            is at BLOCK_PAIRS. Both arrays must have the same block size.
+        */
+        void copyBlock(const uint_fast64_t& b, const BlockAdaptiveArray& src)
+        {
+            const uint_fast64_t off = b * size;
+            MANSEG_TRAFFIC_ADD(HEADS_READ, size * sizeof(float));
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, size * sizeof(float));
+            memcpy(storage.getHeads() + off, src.storage.getHeads() + off, size * sizeof(float));
+            if(src.levels[b] == BLOCK_PAIRS)
+            {
+                // the tails, the other half of the pairs
+                MANSEG_TRAFFIC_ADD(PAIRS_READ, size * sizeof(float));
+                MANSEG_TRAFFIC_ADD(PAIRS_WRITTEN, size * sizeof(float));
+                memcpy(storage.getTails() + off, src.storage.getTails() + off, size * sizeof(float));
+            }
+        }
+
+        /* Dispatches kernel (see Block::dispatch) for every block in turn */
+        template<class Kernel>
+        void forEachBlock(Kernel& kernel)
+        {
+            for(uint_fast64_t b = 0; b < blocks; ++b)
+                block(b).dispatch(kernel);
+        }
+
+        /*
+            Dispatches kernel for every block, with the blocks divided between the workers of the
+            parallel backend (see parallelFor). Kernel is shared by all workers.
+        */
+        template<class Kernel>
+        void parallelForEachBlock(Kernel& kernel)
+        {
+            parallelFor(blocks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(uint_fast64_t b = begin; b < end; ++b)
+                    block(b).dispatch(kernel);
+            }, 1);
+        }
+
+        /* Deletes the segments and the precision levels */
+        void del()
+        {
+            storage.del();
+            delete[] levels;
+            levels = nullptr;
+            blocks = size = promoted = 0;
+        }
+
+    private:
+        HeadsType storage;          // owns the heads and tails of all blocks
+        BlockPrecision* levels;     // precision level of each block
+        uint_fast64_t blocks;
+        uint_fast64_t size;
+        uint_fast64_t promoted;
+        Allocator allocator;
+    };
+}
+
+#endif
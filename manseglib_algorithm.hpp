@@ -0,0 +1,238 @@
+/*
+	Standard algorithms over the iterators of mantissa segmented arrays, through the bulk kernels.
+	Author: harunadess
+
+	TwoSegArray and TwoSegSpan have begin(), end() and size(), with SegmentIterators, so they can be
+	given to the standard algorithms and to generic code, which read and write them an element at a
+	time through the Head and Pair proxies. The overloads here take reductions and copies in blocks
+	instead: the values are widened (or combined from heads and tails) into a buffer of doubles with
+	the SIMD kernels and reduced there, or copied with the kernels directly. They have the names and
+	arguments of the standard ones, and are found by argument dependent lookup on the iterators, so an
+	unqualified call (or one after using namespace std) gets them:
+		double sum = reduce(x.pairs.begin(), x.pairs.end(), 0.0);
+		double dot = transform_reduce(std::execution::par, x.pairs.begin(), x.pairs.end(), y.heads.begin(), 0.0);
+		transform(std::execution::par, x.heads.begin(), x.heads.end(), x.heads.begin(), [](double v) { return 0.85 * v; });
+	A call qualified with std:: gets the element at a time algorithm. With an execution policy (of any
+	type, so <execution> is not needed here), the blocks are divided between the workers of the
+	library's parallel backend (see manseglib_parallel.hpp), whatever the policy. As with the standard
+	algorithms, reduce and the two range transform_reduce may sum in any order; the rest apply their
+	operations in order within a chunk. Writes to heads are truncated, as Head::operator= is.
+	Without a policy, transform is left to std::transform, which is already as fast through the proxies.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_ALGORITHM_H__
+#define __MANSEG_ALGORITHM_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* values per block of the algorithms below: 2 KB of doubles, which stay in L1 */
+    constexpr uint_fast64_t AlgorithmBlock = 256;
+
+    /* out[i] = the value at first[i], for n values, with the bulk kernels */
+    inline void readSegments(const HeadsIterator& first, const uint_fast64_t& n, double* out)
+    {
+        widenHeads(first.getHeads(), n, out);
+    }
+
+    inline void readSegments(const PairsIterator& first, const uint_fast64_t& n, double* out)
+    {
+        combineSegments(first.getHeads(), first.getTails(), n, out);
+    }
+
+    inline void readSegments(const double* first, const uint_fast64_t& n, double* out)
+    {
+        memcpy(out, first, n * sizeof(double));
+    }
+
+    /* first[i] = in[i], for n values, with the bulk kernels */
+    inline void writeSegments(const double* in, const uint_fast64_t& n, const HeadsIterator& first)
+    {
+        narrowToHeads<ROUND_TRUNCATE>(in, n, first.getHeads());
+    }
+
+    inline void writeSegments(const double* in, const uint_fast64_t& n, const PairsIterator& first)
+    {
+        splitSegments(in, n, first.getHeads(), first.getTails());
+    }
+
+    inline void writeSegments(const double* in, const uint_fast64_t& n, double* first)
+    {
+        memcpy(first, in, n * sizeof(double));
+    }
+
+    /* sum of the n values at first, and the n products of the values at first and second, in 4 lanes */
+    template<class It>
+    inline double sumBlocks(const It& first, const uint_fast64_t& n)
+    {
+        double block[AlgorithmBlock];
+        double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for(uint_fast64_t i = 0; i < n; i += AlgorithmBlock)
+        {
+            const uint_fast64_t m = std::min(AlgorithmBlock, n - i);
+            readSegments(first + i, m, block);
+            uint_fast64_t k = 0;
+            for(; k + 4 <= m; k += 4)
+                for(int l = 0; l < 4; ++l)
+                    lanes[l] += block[k + l];
+            for(; k < m; ++k)
+                lanes[0] += block[k];
+        }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    template<class It1, class It2>
+    inline double dotBlocks(const It1& first, const It2& second, const uint_fast64_t& n)
+    {
+        double a[AlgorithmBlock], b[AlgorithmBlock];
+        double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for(uint_fast64_t i = 0; i < n; i += AlgorithmBlock)
+        {
+            const uint_fast64_t m = std::min(AlgorithmBlock, n - i);
+            readSegments(first + i, m, a);
+            readSegments(second + i, m, b);
+            uint_fast64_t k = 0;
+            for(; k + 4 <= m; k += 4)
+                for(int l = 0; l < 4; ++l)
+                    lanes[l] += a[k + l] * b[k + l];
+            for(; k < m; ++k)
+                lanes[0] += a[k] * b[k];
+        }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    /* init, then reduceOp(acc, transformOp(value)) for the n values at first, in order */
+    template<class It, typename T, class R, class U>
+    inline T foldBlocks(const It& first, const uint_fast64_t& n, T init, R& reduceOp, U& transformOp)
+    {
+        double block[AlgorithmBlock];
+        for(uint_fast64_t i = 0; i < n; i += AlgorithmBlock)
+        {
+            const uint_fast64_t m = std::min(AlgorithmBlock, n - i);
+            readSegments(first + i, m, block);
+            for(uint_fast64_t k = 0; k < m; ++k)
+                init = reduceOp(init, transformOp(block[k]));
+        }
+        return init;
+    }
+
+    template<bool useTail>
+    inline double reduce(const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last)
+    {
+        return sumBlocks(first, last - first);
+    }
+
+    template<bool useTail, typename T>
+    inline T reduce(const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, const T& init)
+    {
+        return static_cast<T>(init + sumBlocks(first, last - first));
+    }
+
+    template<class ExecutionPolicy, bool useTail>
+    inline double reduce(ExecutionPolicy&&, const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last)
+    {
+        return parallelReduce<double>(last - first, 0.0,
+            [&](const uint_fast64_t& begin, const uint_fast64_t& end) { return sumBlocks(first + begin, end - begin); },
+            [](const double& a, const double& b) { return a + b; });
+    }
+
+    template<class ExecutionPolicy, bool useTail, typename T>
+    inline T reduce(ExecutionPolicy&& policy, const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, const T& init)
+    {
+        return static_cast<T>(init + reduce(policy, first, last));
+    }
+
+    /* sum of the products of the values of [first1, last1) and those from first2 (segments or doubles) */
+    template<bool useTail, class It2, typename T>
+    inline T transform_reduce(const SegmentIterator<useTail>& first1, const SegmentIterator<useTail>& last1, const It2& first2, const T& init)
+    {
+        return static_cast<T>(init + dotBlocks(first1, first2, last1 - first1));
+    }
+
+    template<class ExecutionPolicy, bool useTail, class It2, typename T>
+    inline T transform_reduce(ExecutionPolicy&&, const SegmentIterator<useTail>& first1, const SegmentIterator<useTail>& last1, const It2& first2, const T& init)
+    {
+        return static_cast<T>(init + parallelReduce<double>(last1 - first1, 0.0,
+            [&](const uint_fast64_t& begin, const uint_fast64_t& end) { return dotBlocks(first1 + begin, first2 + begin, end - begin); },
+            [](const double& a, const double& b) { return a + b; }));
+    }
+
+    /* reduceOp over the values of [first, last) as transformOp maps them, starting from init */
+    template<bool useTail, typename T, class R, class U>
+    inline T transform_reduce(const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, const T& init, R reduceOp, U transformOp)
+    {
+        return foldBlocks(first, last - first, init, reduceOp, transformOp);
+    }
+
+    /* each chunk is folded from its first value, and the chunks' values are reduced in order from init */
+    template<class ExecutionPolicy, bool useTail, typename T, class R, class U>
+    inline T transform_reduce(ExecutionPolicy&&, const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, const T& init, R reduceOp, U transformOp)
+    {
+        return parallelReduce<T>(last - first, init,
+            [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                const T head = transformOp(static_cast<double>(first[begin]));
+                return foldBlocks(first + begin + 1, end - begin - 1, head, reduceOp, transformOp);
+            },
+            [&](const T& a, const T& b) { return reduceOp(a, b); });
+    }
+
+    /*
+        out[i] = op(first[i]) into segments or doubles, with the range divided between the workers;
+        first and out may be the same range. Unlike the reductions, this goes element by element, as
+        std::transform does: the compiler vectorises the loop through the proxies, and going through
+        a buffer of doubles was slower.
+    */
+    template<class ExecutionPolicy, bool useTail, class Out, class Op>
+    inline Out transform(ExecutionPolicy&&, const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, const Out& out, Op op)
+    {
+        parallelFor(last - first, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t i = begin; i < end; ++i)
+                out[i] = op(static_cast<double>(first[i]));
+        });
+        return out + (last - first);
+    }
+
+    /* copies between segments and doubles, widening or narrowing as the kernels do */
+    template<bool useTail>
+    inline double* copy(const SegmentIterator<useTail>& first, const SegmentIterator<useTail>& last, double* out)
+    {
+        readSegments(first, last - first, out);
+        return out + (last - first);
+    }
+
+    template<bool useTail>
+    inline SegmentIterator<useTail> copy(const double* first, const double* last, const SegmentIterator<useTail>& out)
+    {
+        writeSegments(first, last - first, out);
+        return out + (last - first);
+    }
+}
+
+#endif
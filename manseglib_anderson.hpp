@@ -0,0 +1,325 @@
+/*
+	Anderson acceleration of fixed point iterations, with its history in heads.
+	Author: harunadess
+
+	A solver iterating x = g(x) (a Jacobi sweep, an outer step of iterative refinement) converges at the
+	rate of its slowest error component. Anderson mixing takes the next iterate from the last m as well:
+	with f = g(x) - x, and dF, dG the differences of the last m f and g(x), it finds the gamma that makes
+	|f - dF gamma| least and steps to
+		x' = g(x) - dG gamma
+	which for a linear g is GMRES on the last m directions. The cost is the 2m history vectors, which
+	the AndersonAccelerator keeps in a ring of HeadsArrays with heads only, 4 bytes a value, so the same
+	memory holds twice the window of doubles. The differences are of small values, so the heads hold
+	them to their own 20 bits however close the iterates are; the f and the step x' - x that they are
+	formed from are kept in heads too, for the same reason. Only the m x m least squares problem is
+	solved in doubles, regularised, by Cholesky.
+
+	A step goes over the vector in ranges, which may be done in parallel as long as they are disjoint,
+	e.g. the blocks of a grid:
+		AndersonAccelerator<> anderson(n, m, ranges);
+		... each range r of [start, start + count):  anderson.accumulate(r, start, count, x, g);
+		anderson.solve();
+		... each range:                              anderson.apply(start, count, x, g, out);
+	where x is the iterate, g is g(x), and out may be either of them, each holding the range's values in
+	doubles, so a solver holding x in heads or pairs widens a block of it first. step(x, g, out) does
+	the three over whole vectors of doubles. restart() drops the history, e.g. when g changes at a
+	precision switch; the new history starts from the next step.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_ANDERSON_H__
+#define __MANSEG_ANDERSON_H__
+
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_expr.hpp"
+
+namespace ManSeg
+{
+    /* Anderson mixing of a fixed point iteration over n values, with a window of m (see above) */
+    template<class Allocator = SegmentAllocator>
+    class AndersonAccelerator
+    {
+    public:
+        typedef TwoSegArray<false, Allocator> History;
+
+        AndersonAccelerator(const uint_fast64_t& n, const int& m, const uint_fast64_t& ranges = 1,
+            const double& regularisation = 1e-10, const Allocator& allocator = Allocator())
+            :n(n), m(std::max(1, m)), ranges(std::max<uint_fast64_t>(1, ranges)), regularisation(regularisation),
+            allocator(allocator), gram(this->m * this->m, 0.0), gamma(this->m, 0.0),
+            partial(this->ranges * (2 * this->m + 1), 0.0), cols(0), slot(0), started(false), norm(0.0)
+        {
+            for(int j = 0; j < this->m; ++j)
+            {
+                dF.push_back(heads());
+                dG.push_back(heads());
+            }
+            fPrev = heads();
+            dx = heads();
+        }
+
+        ~AndersonAccelerator()
+        {
+            for(int j = 0; j < m; ++j)
+            {
+                release(dF[j]);
+                release(dG[j]);
+            }
+            release(fPrev);
+            release(dx);
+        }
+
+        AndersonAccelerator(const AndersonAccelerator&) = delete;
+        AndersonAccelerator& operator=(const AndersonAccelerator&) = delete;
+
+        /*
+            The residual g - x of [start, start + count), as range r of the step, x and g holding the range's
+            values (x[0] is element start): its differences from the last step join the history, and its
+            sums with the history are kept for solve().
+        */
+        void accumulate(const uint_fast64_t& r, const uint_fast64_t& start, const uint_fast64_t& count,
+            const double* x, const double* g)
+        {
+            double* sums = &partial[r * (2 * m + 1)];     // f.f, dF_j.df by slot, dF_j.f by slot
+            std::fill(sums, sums + 2 * m + 1, 0.0);
+            const int after = started ? std::min(cols + 1, m) : cols;
+            double f[chunk], df[chunk], column[chunk];
+            for(uint_fast64_t c = 0; c < count; c += chunk)
+            {
+                const uint_fast64_t s = start + c, len = std::min<uint_fast64_t>(chunk, count - c);
+                for(uint_fast64_t i = 0; i < len; ++i)
+                    f[i] = g[c + i] - x[c + i];
+                if(started)
+                {
+                    // df = f - fPrev, dg = df + the step to x, stored, then df read back as the history holds it
+                    fPrev.readBlock(s, len, df);
+                    dx.readBlock(s, len, column);
+                    for(uint_fast64_t i = 0; i < len; ++i)
+                    {
+                        df[i] = f[i] - df[i];
+                        column[i] += df[i];
+                    }
+                    dF[slot].template writeBlock<ROUND_NEAREST>(s, len, df);
+                    dG[slot].template writeBlock<ROUND_NEAREST>(s, len, column);
+                    dF[slot].readBlock(s, len, df);
+                }
+                fPrev.template writeBlock<ROUND_NEAREST>(s, len, f);
+                sums[0] += dot(f, f, 0, len);
+                for(int k = 0; k < after; ++k)
+                {
+                    const int j = (slot + m - k) % m;
+                    const double* cj = df;
+                    if(!(started && j == slot))
+                    {
+                        dF[j].readBlock(s, len, column);
+                        cj = column;
+                    }
+                    if(started)
+                        sums[1 + j] += dot(cj, df, 0, len);
+                    sums[1 + m + j] += dot(cj, f, 0, len);
+                }
+            }
+        }
+
+        /* ends the accumulation of the step: the gamma of its least squares problem, in doubles */
+        void solve()
+        {
+            std::vector<double> total(2 * m + 1, 0.0);
+            for(uint_fast64_t r = 0; r < ranges; ++r)
+                for(int k = 0; k < 2 * m + 1; ++k)
+                    total[k] += partial[r * (2 * m + 1) + k];
+            norm = sqrt(total[0]);
+            if(started)
+            {
+                cols = std::min(cols + 1, m);
+                for(int k = 0; k < cols; ++k)
+                {
+                    const int j = (slot + m - k) % m;
+                    gram[slot * m + j] = gram[j * m + slot] = total[1 + j];
+                }
+            }
+
+            // (K + lambda I) c = rhs over the columns, newest first, lambda relative to K's diagonal
+            std::fill(gamma.begin(), gamma.end(), 0.0);
+            const int k = cols;
+            std::vector<double> K(k * k), c(k);
+            double trace = 0.0;
+            for(int a = 0; a < k; ++a)
+            {
+                const int ja = (slot + m - a) % m;
+                for(int b = 0; b < k; ++b)
+                    K[a * k + b] = gram[ja * m + (slot + m - b) % m];
+                c[a] = total[1 + m + ja];
+                trace += K[a * k + a];
+            }
+            for(int a = 0; a < k; ++a)
+                K[a * k + a] += regularisation * (k > 0 ? trace / k : 0.0);
+            if(k > 0 && cholesky(K, k) && trace > 0.0)
+            {
+                choleskySolve(K, k, c);
+                for(int a = 0; a < k; ++a)
+                    gamma[(slot + m - a) % m] = c[a];
+            }
+            else if(k > 0)
+                cols = 0;       // degenerate history: a plain step, and the history starts again
+
+            if(started)
+                slot = (slot + 1) % m;
+            started = true;
+        }
+
+        /* out = g - dG gamma over [start, start + count), the three holding the range's values; out may be x or g */
+        void apply(const uint_fast64_t& start, const uint_fast64_t& count, const double* x, const double* g, double* out)
+        {
+            double next[chunk], column[chunk];
+            for(uint_fast64_t c = 0; c < count; c += chunk)
+            {
+                const uint_fast64_t s = start + c, len = std::min<uint_fast64_t>(chunk, count - c);
+                for(uint_fast64_t i = 0; i < len; ++i)
+                    next[i] = g[c + i];
+                for(int k = 0; k < cols; ++k)
+                {
+                    const int j = (slot + m - 1 - k) % m;
+                    dG[j].readBlock(s, len, column);
+                    const double gj = gamma[j];
+                    for(uint_fast64_t i = 0; i < len; ++i)
+                        next[i] -= gj * column[i];
+                }
+                for(uint_fast64_t i = 0; i < len; ++i)
+                {
+                    const double step = next[i] - x[c + i];
+                    out[c + i] = next[i];
+                    column[i] = step;
+                }
+                dx.template writeBlock<ROUND_NEAREST>(s, len, column);
+            }
+        }
+
+        /* a whole step over vectors of doubles, the ranges done in parallel */
+        void step(const double* x, const double* g, double* out)
+        {
+            parallelFor(ranges, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(uint_fast64_t r = begin; r < end; ++r)
+                {
+                    const uint_fast64_t s = rangeStart(r);
+                    accumulate(r, s, rangeStart(r + 1) - s, x + s, g + s);
+                }
+            }, 1);
+            solve();
+            parallelFor(ranges, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(uint_fast64_t r = begin; r < end; ++r)
+                {
+                    const uint_fast64_t s = rangeStart(r);
+                    apply(s, rangeStart(r + 1) - s, x + s, g + s, out + s);
+                }
+            }, 1);
+        }
+
+        /* drops the history; the next step starts a new one from the residual of this one */
+        void restart() { cols = 0; }
+
+        /* the columns of history the last step mixed, at most m */
+        int depth() const { return cols; }
+        /* |g - x| of the last step */
+        double residualNorm() const { return norm; }
+        /* the bytes of the history: 2m columns and the last residual and step, in heads */
+        uint_fast64_t bytes() const { return (2 * (uint_fast64_t)m + 2) * n * sizeof(float); }
+        /* range r of the ranges step() divides the vector into */
+        uint_fast64_t rangeStart(const uint_fast64_t& r) const { return n * r / ranges; }
+
+    private:
+        // elements of a range processed at a time: the chunks of the columns stay in L1
+        enum { chunk = 256 };
+
+        History heads()
+        {
+            // no tails: the history is never read in full
+            return History(allocator.template allocate<float>(n, true), nullptr, n, allocator);
+        }
+
+        void release(History& h)
+        {
+            allocator.template deallocate<float>(h.getHeads(), n);
+        }
+
+        // K = L L^T in place (lower triangle); false if K is not positive definite
+        static bool cholesky(std::vector<double>& K, const int& k)
+        {
+            for(int j = 0; j < k; ++j)
+            {
+                double d = K[j * k + j];
+                for(int p = 0; p < j; ++p)
+                    d -= K[j * k + p] * K[j * k + p];
+                if(!(d > 0.0))
+                    return false;
+                K[j * k + j] = sqrt(d);
+                for(int i = j + 1; i < k; ++i)
+                {
+                    double v = K[i * k + j];
+                    for(int p = 0; p < j; ++p)
+                        v -= K[i * k + p] * K[j * k + p];
+                    K[i * k + j] = v / K[j * k + j];
+                }
+            }
+            return true;
+        }
+
+        static void choleskySolve(const std::vector<double>& L, const int& k, std::vector<double>& c)
+        {
+            for(int i = 0; i < k; ++i)
+            {
+                for(int p = 0; p < i; ++p)
+                    c[i] -= L[i * k + p] * c[p];
+                c[i] /= L[i * k + i];
+            }
+            for(int i = k - 1; i >= 0; --i)
+            {
+                for(int p = i + 1; p < k; ++p)
+                    c[i] -= L[p * k + i] * c[p];
+                c[i] /= L[i * k + i];
+            }
+        }
+
+        uint_fast64_t n;
+        int m;
+        uint_fast64_t ranges;
+        double regularisation;
+        Allocator allocator;
+        std::vector<History> dF, dG;    // the ring of differences, by slot
+        History fPrev, dx;              // the last residual and the last step x' - x
+        std::vector<double> gram;       // dF_i.dF_j by slot
+        std::vector<double> gamma;      // by slot
+        std::vector<double> partial;    // the sums of each range of the step
+        int cols;                       // columns of history in use
+        int slot;                       // the slot the next difference goes in
+        bool started;                   // whether there is a last residual to difference with
+        double norm;
+    };
+}
+
+#endif
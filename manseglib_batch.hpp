@@ -0,0 +1,209 @@
+/*
+	A batch of solves run back to back, each job's input loading while the job before it computes.
+	Author: harunadess
+
+	A batch of graphs or matrices run one process at a time pays, for every job, the load of its input,
+	the solve, and the teardown, one after the other, and the cores sit idle through the first and the
+	last. A BatchRunner keeps the jobs in a queue and runs them in one process: while job k solves on
+	the calling thread, job k + 1 is loaded on a thread of its own, and job k's input is torn down on
+	another once it is done, so with loads no longer than solves the batch takes about as long as its
+	solves alone. The files of the jobs after the one loading are hinted to the kernel (POSIX_FADV_WILLNEED)
+	so their reads start early too:
+		BatchRunner<Graph> batch(
+			[](const std::string& path) { return std::unique_ptr<Graph>(new Graph(path)); },  // nullptr if it fails
+			[](const BatchJob& job, Graph& g) { solve(g); });
+		batch.add("a.adj"); batch.add("b.adj");
+		batch.run();                                // the jobs that loaded
+		batch.job(k).waitSeconds ...                // the part of job k's load not hidden behind a solve
+	The solves, and the loads, run in a SegmentPool::Scope of the runner's pool, so the arrays they make
+	as PooledManSegArray (manseglib_pool.hpp) take the planes of the job before rather than mapping
+	and faulting in their own: jobs of similar size then allocate nothing after the first. A loader
+	that maps its input should fault it in (e.g. MADV_POPULATE_READ) rather than leave that to the
+	solve. Up to three inputs are in memory at once: the one solving, the next, and the one before
+	while it is torn down. $MANSEG_BATCH_AHEAD (default
+	1) is how many jobs past the one loading are hinted. POSIX only (threads and posix_fadvise).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_BATCH_H__
+#define __MANSEG_BATCH_H__
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "manseglib_pool.hpp"
+
+namespace ManSeg
+{
+    /* jobs past the one loading whose files are hinted: $MANSEG_BATCH_AHEAD, or fallback if it is unset */
+    inline int batchAhead(const int& fallback = 1)
+    {
+        const char* ahead = getenv("MANSEG_BATCH_AHEAD");
+        return (ahead != nullptr && *ahead != '\0') ? std::max(0, atoi(ahead)) : fallback;
+    }
+
+    /* asks the kernel to start reading path into the page cache; false if it could not be opened */
+    inline bool hintFile(const std::string& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+            return false;
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+        close(fd);
+        return true;
+    }
+
+    /* a job of a batch, and where its time went */
+    struct BatchJob
+    {
+        std::string path;
+        bool loaded = false;
+        double loadSeconds = 0.0;   // on the loading thread
+        double waitSeconds = 0.0;   // the solve waited for the load (all of it, for the first job)
+        double solveSeconds = 0.0;
+    };
+
+    template<class Input>
+    class BatchRunner
+    {
+    public:
+        typedef std::function<std::unique_ptr<Input>(const std::string&)> Loader;
+        typedef std::function<void(const BatchJob&, Input&)> Solver;
+        typedef std::function<std::vector<std::string>(const std::string&)> Hinter;
+
+        /* hint gives the files a job will read, by default its path */
+        BatchRunner(const Loader& load, const Solver& solve, const int& ahead = batchAhead(), const Hinter& hint = Hinter())
+            :load(load), solve(solve), hint(hint), ahead(ahead), wall(0.0)
+        {}
+
+        BatchRunner(const BatchRunner&) = delete;
+        BatchRunner& operator=(const BatchRunner&) = delete;
+
+        void add(const std::string& path)
+        {
+            BatchJob j;
+            j.path = path;
+            queue.push_back(j);
+        }
+
+        size_t jobs() const { return queue.size(); }
+        const BatchJob& job(const size_t& k) const { return queue[k]; }
+
+        /* the pool the jobs' pooled arrays come from */
+        SegmentPool& workspaces() { return pool; }
+
+        /* seconds the last run took, and those its solves took */
+        double wallSeconds() const { return wall; }
+        double solveSeconds() const
+        {
+            double s = 0.0;
+            for(const BatchJob& j : queue)
+                s += j.solveSeconds;
+            return s;
+        }
+
+        /* runs the jobs in order, none to be added meanwhile; the number that loaded (and so were solved) */
+        size_t run()
+        {
+            const auto begun = std::chrono::steady_clock::now();
+            size_t solved = 0;
+            std::future<std::unique_ptr<Input>> next;
+            std::thread teardown;
+            if(!queue.empty())
+                next = startLoad(0);
+            for(size_t k = 0; k < queue.size(); ++k)
+            {
+                const auto waiting = std::chrono::steady_clock::now();
+                std::unique_ptr<Input> input = next.get();
+                queue[k].waitSeconds = secondsSince(waiting);
+                if(k + 1 < queue.size())
+                    next = startLoad(k + 1);
+                if(!input)
+                    continue;
+
+                const auto solving = std::chrono::steady_clock::now();
+                {
+                    SegmentPool::Scope scope(pool);
+                    solve(queue[k], *input);
+                }
+                queue[k].solveSeconds = secondsSince(solving);
+                ++solved;
+
+                // the input is freed beside the next solve (the solve's own arrays are back in the pool already)
+                if(teardown.joinable())
+                    teardown.join();
+                teardown = std::thread([](std::unique_ptr<Input> done) { done.reset(); }, std::move(input));
+            }
+            if(teardown.joinable())
+                teardown.join();
+            wall = secondsSince(begun);
+            return solved;
+        }
+
+    private:
+        Loader load;
+        Solver solve;
+        Hinter hint;
+        int ahead;
+        std::vector<BatchJob> queue;
+        SegmentPool pool;
+        double wall;
+
+        static double secondsSince(const std::chrono::steady_clock::time_point& t)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+        }
+
+        /* loads job k on a thread of its own, hinting the files of the jobs after it first */
+        std::future<std::unique_ptr<Input>> startLoad(const size_t& k)
+        {
+            return std::async(std::launch::async, [this, k]()
+            {
+                for(size_t a = k + 1; a <= k + ahead && a < queue.size(); ++a)
+                    for(const std::string& f : hint ? hint(queue[a].path) : std::vector<std::string>(1, queue[a].path))
+                        hintFile(f);
+                const auto loading = std::chrono::steady_clock::now();
+                std::unique_ptr<Input> input;
+                {
+                    SegmentPool::Scope scope(pool);
+                    input = load(queue[k].path);
+                }
+                queue[k].loadSeconds = secondsSince(loading);
+                queue[k].loaded = static_cast<bool>(input);
+                return input;
+            });
+        }
+    };
+}
+
+#endif // __MANSEG_BATCH_H__
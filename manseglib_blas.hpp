@@ -0,0 +1,249 @@
+/*
+	BLAS style level 1 and 2 operations on mantissa segmented vectors and matrices.
+	Author: harunadess
+
+	dot, nrm2, axpy, scal and gemv, with the arguments of their BLAS namesakes (less the strides, which
+	are always 1), on any view with readBlock and writeBlock: the heads or pairs of a ManSegArray (or
+	the read_as/write_as views of one), TwoSegSpans, and FullViews of doubles, mixed as needed:
+		double d = blas::dot(n, x.pairs, y.heads);
+		blas::axpy(n, alpha, p.pairs, x.pairs);         // x += alpha * p, at full precision
+		blas::gemv(rows, cols, 1.0, A.heads, x.pairs, 0.0, y.pairs);   // y = A x, A row major
+	Values are read a block at a time into buffers of doubles with the SIMD kernels, and written back
+	the same way, so nothing is copied to a full double array; writes to heads are truncated, as with
+	writeBlock. dot and nrm2 accumulate in four lanes, so their sums are not in element order. gemv
+	divides the rows (or, transposed, the columns of the result) between the workers of the parallel
+	backend, and widens x once.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_BLAS_H__
+#define __MANSEG_BLAS_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+namespace blas
+{
+    /* values per block: 2 KB of doubles per operand, which stay in L1 */
+    constexpr uint_fast64_t Block = 256;
+
+    /* sum of x[i] * y[i] over [start, start + n), in 4 lanes */
+    template<class X, class Y>
+    inline double dotRange(const X& x, const Y& y, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        double a[Block], b[Block];
+        double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for(uint_fast64_t i = start; i < start + n; i += Block)
+        {
+            const uint_fast64_t m = std::min(Block, start + n - i);
+            x.readBlock(i, m, a);
+            y.readBlock(i, m, b);
+            uint_fast64_t k = 0;
+            for(; k + 4 <= m; k += 4)
+                for(int l = 0; l < 4; ++l)
+                    lanes[l] += a[k + l] * b[k + l];
+            for(; k < m; ++k)
+                lanes[0] += a[k] * b[k];
+        }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    /* x . y over the first n values */
+    template<class X, class Y>
+    inline double dot(const uint_fast64_t& n, const X& x, const Y& y)
+    {
+        return parallelReduce<double>(n, 0.0,
+            [&](const uint_fast64_t& begin, const uint_fast64_t& end) { return dotRange(x, y, begin, end - begin); },
+            [](const double& a, const double& b) { return a + b; });
+    }
+
+    /* the largest |x[i]| of the first n values */
+    template<class X>
+    inline double amax(const uint_fast64_t& n, const X& x)
+    {
+        return parallelReduce<double>(n, 0.0, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[Block], largest = 0.0;
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, a);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                    largest = std::max(largest, fabs(a[k]));
+            }
+            return largest;
+        }, [](const double& a, const double& b) { return std::max(a, b); });
+    }
+
+    /*
+        Euclidean norm of the first n values. The squares are summed directly; only if that overflows
+        or underflows to zero is the sum taken again with the values scaled by the largest of them.
+    */
+    template<class X>
+    inline double nrm2(const uint_fast64_t& n, const X& x)
+    {
+        const double sum = dot(n, x, x);
+        if((sum >= 1e-290 && sum <= 1e290) || sum != sum)
+            return sqrt(sum);
+        const double scale = amax(n, x);
+        if(scale == 0.0 || !(scale <= 1.7976931348623157e308))
+            return scale;
+        const double scaled = parallelReduce<double>(n, 0.0, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[Block], s = 0.0;
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, a);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                    s += (a[k] / scale) * (a[k] / scale);
+            }
+            return s;
+        }, [](const double& a, const double& b) { return a + b; });
+        return scale * sqrt(scaled);
+    }
+
+    /* y = alpha * x + y over the first n values */
+    template<class X, class Y>
+    inline void axpy(const uint_fast64_t& n, const double& alpha, const X& x, Y&& y)
+    {
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[Block], b[Block];
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, a);
+                y.readBlock(i, m, b);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                    b[k] += alpha * a[k];
+                y.writeBlock(i, m, b);
+            }
+        });
+    }
+
+    /* x = alpha * x over the first n values */
+    template<class X>
+    inline void scal(const uint_fast64_t& n, const double& alpha, X&& x)
+    {
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[Block];
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, a);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                    a[k] *= alpha;
+                x.writeBlock(i, m, a);
+            }
+        });
+    }
+
+    /*
+        y = alpha * A x + beta * y, or alpha * A^T x + beta * y if transpose is set, for the rows x cols
+        matrix A stored row major (A[i * cols + j]). As in BLAS, y is not read when beta is 0.
+    */
+    template<class M, class X, class Y>
+    inline void gemv(const uint_fast64_t& rows, const uint_fast64_t& cols, const double& alpha, const M& A, const X& x,
+        const double& beta, Y&& y, const bool& transpose = false)
+    {
+        const uint_fast64_t xLength = transpose ? rows : cols;
+        std::vector<double> xs(xLength);
+        for(uint_fast64_t i = 0; i < xLength; i += Block)
+            x.readBlock(i, std::min(Block, xLength - i), xs.data() + i);
+
+        if(!transpose)
+        {
+            // a row at a time: y[i] = alpha * (A[i, :] . x) + beta * y[i]
+            parallelFor(rows, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                double a[Block], out[Block];
+                for(uint_fast64_t r0 = begin; r0 < end; r0 += Block)
+                {
+                    const uint_fast64_t m = std::min(Block, end - r0);
+                    if(beta != 0.0)
+                        y.readBlock(r0, m, out);
+                    for(uint_fast64_t r = 0; r < m; ++r)
+                    {
+                        double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };
+                        const uint_fast64_t row = (r0 + r) * cols;
+                        for(uint_fast64_t j = 0; j < cols; j += Block)
+                        {
+                            const uint_fast64_t c = std::min(Block, cols - j);
+                            A.readBlock(row + j, c, a);
+                            uint_fast64_t k = 0;
+                            for(; k + 4 <= c; k += 4)
+                                for(int l = 0; l < 4; ++l)
+                                    lanes[l] += a[k + l] * xs[j + k + l];
+                            for(; k < c; ++k)
+                                lanes[0] += a[k] * xs[j + k];
+                        }
+                        const double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+                        out[r] = alpha * sum + (beta != 0.0 ? beta * out[r] : 0.0);
+                    }
+                    y.writeBlock(r0, m, out);
+                }
+            }, std::max<uint_fast64_t>(1, ParallelGrain / std::max<uint_fast64_t>(1, cols)));
+        }
+        else
+        {
+            // a block of y at a time: y[j] = alpha * sum over i of A[i, j] x[i] + beta * y[j]
+            parallelFor(cols, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                double a[Block], out[Block];
+                for(uint_fast64_t j = begin; j < end; j += Block)
+                {
+                    const uint_fast64_t c = std::min(Block, end - j);
+                    std::fill(out, out + c, 0.0);
+                    for(uint_fast64_t i = 0; i < rows; ++i)
+                    {
+                        A.readBlock(i * cols + j, c, a);
+                        const double xi = xs[i];
+                        for(uint_fast64_t k = 0; k < c; ++k)
+                            out[k] += a[k] * xi;
+                    }
+                    if(beta != 0.0)
+                    {
+                        double old[Block];
+                        y.readBlock(j, c, old);
+                        for(uint_fast64_t k = 0; k < c; ++k)
+                            out[k] = alpha * out[k] + beta * old[k];
+                    }
+                    else
+                        for(uint_fast64_t k = 0; k < c; ++k)
+                            out[k] *= alpha;
+                    y.writeBlock(j, c, out);
+                }
+            }, Block);
+        }
+    }
+}
+}
+
+#endif
@@ -0,0 +1,783 @@
+/*
+	Checkpoints of iterative solvers as segment planes, for runs that may be preempted.
+	Author: harunadess
+
+	A Checkpointer saves, every so many iterations, what a driver needs to carry on (a trivially
+	copyable struct of its own: the iteration count, its PrecisionController, ...) together with its
+	solution as segment planes: the heads plane alone while the solver is still at the heads, half the
+	bytes of the doubles, and the heads and tails planes once it is at full precision. The file is
+	written by a thread of its own while the solver goes on, under a temporary name that is renamed
+	over the previous checkpoint once it is complete, so a job killed mid-write still has the last
+	one. The solver must not change the saved values until wait() returns:
+		Checkpointer checkpoint;                                // $MANSEG_CHECKPOINT, every $MANSEG_CHECKPOINT_EVERY
+		if(checkpoint.due(iter)) checkpoint.saveHeads(state, x.heads.getHeads(), n);   // or saveFull(state, x.full, n)
+		...
+		checkpoint.wait();                                      // before x is written again
+	A restarted run maps the file and copies the planes back, in place of its usual start:
+		CheckpointFile saved;                                   // $MANSEG_CHECKPOINT
+		if(saved.state(state) && saved.size() == n)
+			for(i ...) x.full[i] = saved.value(i);              // or x.heads[i], if !saved.hasTails()
+	The file is the 8 bytes "MSCHKPNT", a CheckpointHeader, the state, and at the next page boundary the
+	heads plane, followed directly by the tails plane if there is one, all in the machine's byte order.
+
+	With compress ($MANSEG_CHECKPOINT_COMPRESS=1) the planes are coded instead. Consecutive iterates
+	differ mostly in their low mantissa bits, so each checkpoint is XORed with the one before it, which
+	leaves the high bytes of its values zero. The bytes are then shuffled into byte planes (the lowest
+	byte of every value, then the next, ...), and each byte plane is run coded, or coded as a mask of
+	its nonzero bytes followed by those bytes, whichever is shorter. Planes are coded in blocks of
+	checkpointBlockValues, in parallel. The first checkpoint, a base, is coded alone and written to
+	path. The k-th after it is written to path.delta.k, until the deltas add up to more than
+	checkpointChainBases bases (or number checkpointMaxChain), when a new base replaces the chain. A
+	base is also written when the planes saved change. The coding is done by save itself, which
+	copies the values, so the solver may change them as soon as it returns. The Checkpointer keeps a
+	copy of the last checkpoint's planes to XOR the next one with. CheckpointFile reads either kind,
+	decoding a base and then each delta of its chain in turn. How well deltas shrink depends on how far
+	the values move: the heads of a PageRank several iterations from its switch change in their two
+	low bytes, and the tails in full precision in their three low bytes, so those bytes barely shrink.
+	POSIX only (a thread, mmap and rename).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_CHECKPOINT_H__
+#define __MANSEG_CHECKPOINT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "manseglib_parallel.hpp"
+
+namespace ManSeg
+{
+    /* start of a checkpoint */
+    static const char checkpointMagic[8] = { 'M', 'S', 'C', 'H', 'K', 'P', 'N', 'T' };
+
+    struct CheckpointHeader
+    {
+        char magic[8];
+        uint64_t count;         // values in each plane
+        uint32_t planes;        // 1: heads, 2: heads and tails
+        uint32_t stateBytes;    // size of the driver's state, which follows the header
+        uint64_t planeOffset;   // of the heads plane, a multiple of the page size
+    };
+
+    /* start of a compressed checkpoint, a base or a delta */
+    static const char compressedCheckpointMagic[8] = { 'M', 'S', 'C', 'H', 'K', 'P', 'T', 'Z' };
+
+    /* values in each independently coded block of a compressed checkpoint's planes */
+    static const uint32_t checkpointBlockValues = 1 << 16;
+    /* a base is written in place of a delta that would take the chain's deltas past this many bases */
+    static const uint64_t checkpointChainBases = 2;
+    /* or past this many deltas */
+    static const uint32_t checkpointMaxChain = 64;
+
+    /*
+        Followed by the state, the coded size of every block (uint64_t, the heads plane's blocks then the
+        tails plane's), and the blocks themselves in the same order.
+    */
+    struct CompressedCheckpointHeader
+    {
+        char magic[8];
+        uint64_t count;         // values in each plane
+        uint32_t planes;        // 1: heads, 2: heads and tails
+        uint32_t stateBytes;    // size of the driver's state, which follows the header
+        uint64_t generation;    // of the base, shared by the deltas of its chain
+        uint32_t sequence;      // 0: the base, k: the k-th delta, XORed with the (k-1)-th
+        uint32_t blockValues;   // values in each block (the last of a plane may have fewer)
+    };
+
+    namespace detail
+    {
+        inline void putCodedLength(std::vector<unsigned char>& out, uint64_t v)
+        {
+            for(; v >= 0x80; v >>= 7)
+                out.push_back((unsigned char)(v | 0x80));
+            out.push_back((unsigned char)v);
+        }
+
+        inline bool getCodedLength(const unsigned char*& in, const unsigned char* end, uint64_t& v)
+        {
+            v = 0;
+            for(int shift = 0; in < end && shift < 64; shift += 7)
+            {
+                const unsigned char b = *in++;
+                v |= (uint64_t)(b & 0x7f) << shift;
+                if(b < 0x80)
+                    return true;
+            }
+            return false;
+        }
+
+        /*
+            Appends total bytes to out as tokens, length << 1 | 1 followed by a byte repeated length
+            times, or length << 1 followed by length bytes. Runs shorter than 4 stay among the latter.
+        */
+        inline void runCode(const unsigned char* bytes, const size_t& total, std::vector<unsigned char>& out)
+        {
+            size_t literal = 0;
+            for(size_t i = 0; i < total;)
+            {
+                size_t j = i + 1;
+                while(j < total && bytes[j] == bytes[i])
+                    ++j;
+                if(j - i >= 4)
+                {
+                    if(literal < i)
+                    {
+                        putCodedLength(out, (i - literal) << 1);
+                        out.insert(out.end(), bytes + literal, bytes + i);
+                    }
+                    putCodedLength(out, ((j - i) << 1) | 1);
+                    out.push_back(bytes[i]);
+                    literal = j;
+                }
+                i = j;
+            }
+            if(literal < total)
+            {
+                putCodedLength(out, (total - literal) << 1);
+                out.insert(out.end(), bytes + literal, bytes + total);
+            }
+        }
+
+        /* reads runCode's tokens from in until they fill total bytes; false if they do not fill exactly that */
+        inline bool runDecode(const unsigned char*& in, const unsigned char* end, unsigned char* bytes, const size_t& total)
+        {
+            for(size_t at = 0; at < total;)
+            {
+                uint64_t token;
+                if(!getCodedLength(in, end, token))
+                    return false;
+                const uint64_t length = token >> 1;
+                if(length == 0 || length > total - at)
+                    return false;
+                if(token & 1)
+                {
+                    if(in == end)
+                        return false;
+                    memset(bytes + at, *in++, length);
+                }
+                else
+                {
+                    if(length > (uint64_t)(end - in))
+                        return false;
+                    memcpy(bytes + at, in, length);
+                    in += length;
+                }
+                at += length;
+            }
+            return true;
+        }
+    }
+
+    /*
+        Codes m words, word(i) for i in [0, m), XORed with base[i] unless base is null. Their bytes are
+        shuffled into four byte planes, the lowest byte of every word first, and each byte plane is coded
+        after a byte saying how: 0, run coded (detail::runCode); or 1, a run coded mask of its nonzero
+        bytes, a bit each from the lowest, followed by those bytes, for planes whose zeros are scattered.
+    */
+    template<class Word>
+    inline void encodeCheckpointBlock(const Word& word, const uint32_t* base, const size_t& m, std::vector<unsigned char>& out)
+    {
+        std::vector<unsigned char> bytes(4 * m);
+        for(size_t i = 0; i < m; ++i)
+        {
+            const uint32_t w = word(i) ^ (base != nullptr ? base[i] : 0);
+            bytes[i] = (unsigned char)w;
+            bytes[m + i] = (unsigned char)(w >> 8);
+            bytes[2 * m + i] = (unsigned char)(w >> 16);
+            bytes[3 * m + i] = (unsigned char)(w >> 24);
+        }
+        std::vector<unsigned char> mask((m + 7) / 8), runs, sparse;
+        out.clear();
+        for(int k = 0; k < 4; ++k)
+        {
+            const unsigned char* plane = bytes.data() + k * m;
+            runs.clear();
+            detail::runCode(plane, m, runs);
+            std::fill(mask.begin(), mask.end(), 0);
+            for(size_t i = 0; i < m; ++i)
+                if(plane[i] != 0)
+                    mask[i >> 3] |= (unsigned char)(1 << (i & 7));
+            sparse.clear();
+            detail::runCode(mask.data(), mask.size(), sparse);
+            for(size_t i = 0; i < m; ++i)
+                if(plane[i] != 0)
+                    sparse.push_back(plane[i]);
+            const bool masked = sparse.size() < runs.size();
+            out.push_back(masked ? 1 : 0);
+            out.insert(out.end(), masked ? sparse.begin() : runs.begin(), masked ? sparse.end() : runs.end());
+        }
+    }
+
+    /*
+        Decodes size bytes coded by encodeCheckpointBlock into words[0, m), XORed with base[i] unless base
+        is null (base may be words itself); false, with words unchanged, if they are not m coded words.
+    */
+    inline bool decodeCheckpointBlock(const unsigned char* in, const size_t& size, const uint32_t* base, const size_t& m, uint32_t* words)
+    {
+        std::vector<unsigned char> bytes(4 * m), mask((m + 7) / 8);
+        const unsigned char* end = in + size;
+        for(int k = 0; k < 4; ++k)
+        {
+            unsigned char* plane = bytes.data() + k * m;
+            if(in == end)
+                return false;
+            const unsigned char how = *in++;
+            if(how == 0)
+            {
+                if(!detail::runDecode(in, end, plane, m))
+                    return false;
+            }
+            else if(how == 1)
+            {
+                if(!detail::runDecode(in, end, mask.data(), mask.size()))
+                    return false;
+                for(size_t i = 0; i < m; ++i)
+                    if((mask[i >> 3] >> (i & 7)) & 1)
+                    {
+                        if(in == end)
+                            return false;
+                        plane[i] = *in++;
+                    }
+                    else
+                        plane[i] = 0;
+            }
+            else
+                return false;
+        }
+        if(in != end)
+            return false;
+        for(size_t i = 0; i < m; ++i)
+        {
+            const uint32_t w = (uint32_t)bytes[i] | (uint32_t)bytes[m + i] << 8 | (uint32_t)bytes[2 * m + i] << 16
+                | (uint32_t)bytes[3 * m + i] << 24;
+            words[i] = w ^ (base != nullptr ? base[i] : 0);
+        }
+        return true;
+    }
+
+    /* where the planes start after a state of stateBytes: at a page boundary, so a mapping reads them aligned */
+    inline uint64_t checkpointPlaneOffset(const uint64_t& stateBytes)
+    {
+        const uint64_t page = 4096;
+        return (sizeof(CheckpointHeader) + stateBytes + page - 1) / page * page;
+    }
+
+    /* the k-th delta of the compressed checkpoint at path */
+    inline std::string checkpointDeltaPath(const std::string& path, const uint32_t& k)
+    {
+        return path + ".delta." + std::to_string(k);
+    }
+
+    /* iterations between checkpoints: $MANSEG_CHECKPOINT_EVERY, or fallback if it is unset */
+    inline int checkpointInterval(const int& fallback = 10)
+    {
+        const char* every = getenv("MANSEG_CHECKPOINT_EVERY");
+        return (every != nullptr && *every != '\0') ? atoi(every) : fallback;
+    }
+
+    /* whether to code checkpoints as XOR deltas: $MANSEG_CHECKPOINT_COMPRESS is set to anything but 0 */
+    inline bool checkpointCompression()
+    {
+        const char* compress = getenv("MANSEG_CHECKPOINT_COMPRESS");
+        return compress != nullptr && *compress != '\0' && strcmp(compress, "0") != 0;
+    }
+
+    /*
+        Writes checkpoints to path in the background, at most one at a time: a save waits for the one
+        before it. Without a path (or with every <= 0) nothing is ever due and nothing is written. With
+        compress, writes coded bases to path and coded deltas to path.delta.k.
+    */
+    class Checkpointer
+    {
+    public:
+        explicit Checkpointer(const char* path = getenv("MANSEG_CHECKPOINT"), const int& every = checkpointInterval(),
+            const bool& compress = checkpointCompression())
+            :target(path != nullptr ? path : ""), every(every), compress(compress), succeeded(true), written(0),
+             fileBytes(0), planeBytes(0), previousPlanes(0), previousCount(0), baseBytes(0), chainBytes(0), chain(0),
+             generation(0)
+        {}
+
+        Checkpointer(const Checkpointer&) = delete;
+        Checkpointer& operator=(const Checkpointer&) = delete;
+
+        ~Checkpointer() { wait(); }
+
+        bool enabled() const { return !target.empty() && every > 0; }
+        /* whether to save after the given (1-based) iteration */
+        bool due(const int& iteration) const { return enabled() && iteration % every == 0; }
+        /* checkpoints written so far (including one still being written) */
+        int count() const { return written; }
+        /* bytes of the files written so far, and of the planes saved in them, for how well they were coded */
+        uint64_t bytes() const { return fileBytes; }
+        uint64_t rawBytes() const { return planeBytes; }
+
+        /* saves state and the heads plane of n values, which must not change until wait() (or, compressed, return) */
+        template<class State>
+        void saveHeads(const State& state, const float* heads, const uint_fast64_t& n)
+        {
+            start(state, heads, nullptr, n);
+        }
+
+        /* saves state and n doubles as heads and tails planes, which must not change until wait() (or, compressed, return) */
+        template<class State>
+        void saveFull(const State& state, const double* full, const uint_fast64_t& n)
+        {
+            start(state, nullptr, full, n);
+        }
+
+        /* waits for the checkpoint being written, if any; false if it could not be written */
+        bool wait()
+        {
+            if(writer.joinable())
+                writer.join();
+            return succeeded;
+        }
+
+        /* waits for any write, then deletes the checkpoint, as a run that has finished needs none */
+        void remove()
+        {
+            wait();
+            if(!target.empty())
+            {
+                unlink(target.c_str());
+                removeDeltas();
+            }
+        }
+
+    private:
+        std::string target;
+        int every;
+        bool compress;
+        std::vector<char> state;
+        std::thread writer;
+        bool succeeded;
+        int written;
+        uint64_t fileBytes;
+        uint64_t planeBytes;
+        // the planes of the last checkpoint, one after the other, which the next is XORed with
+        std::vector<uint32_t> previous;
+        uint32_t previousPlanes;
+        uint_fast64_t previousCount;
+        // the coded bytes of the base and of the deltas since, the number of those, and the base's generation
+        uint64_t baseBytes;
+        uint64_t chainBytes;
+        uint32_t chain;
+        uint64_t generation;
+        // the coded blocks of the checkpoint being written, the heads plane's then the tails plane's
+        std::vector<std::vector<unsigned char> > blocks;
+
+        template<class State>
+        void start(const State& s, const float* heads, const double* full, const uint_fast64_t& n)
+        {
+            static_assert(std::is_trivially_copyable<State>::value, "checkpoint state is saved as its bytes");
+            // a delta of a checkpoint that was never written could not be read back
+            if(!wait())
+                previous.clear();
+            state.assign(reinterpret_cast<const char*>(&s), reinterpret_cast<const char*>(&s) + sizeof(State));
+            ++written;
+            const uint32_t planes = full != nullptr ? 2 : 1;
+            planeBytes += planes * n * sizeof(uint32_t);
+            if(compress)
+            {
+                encode(heads, full, n);
+                fileBytes += sizeof(CompressedCheckpointHeader) + state.size() + blocks.size() * sizeof(uint64_t) + codedBytes();
+                writer = std::thread([this, planes, n]() {
+                    succeeded = writeCoded(planes, n);
+                    if(!succeeded)
+                        fprintf(stderr, "checkpoint: cannot write %s\n", target.c_str());
+                });
+                return;
+            }
+            fileBytes += checkpointPlaneOffset(state.size()) + planes * n * sizeof(uint32_t);
+            writer = std::thread([this, heads, full, n]() {
+                succeeded = write(heads, full, n);
+                if(!succeeded)
+                    fprintf(stderr, "checkpoint: cannot write %s\n", target.c_str());
+            });
+        }
+
+        /* word i of plane p of the values being saved: a head, or the head or tail of a double */
+        static uint32_t word(const float* heads, const double* full, const uint32_t& p, const uint_fast64_t& i)
+        {
+            if(full == nullptr)
+            {
+                uint32_t w;
+                memcpy(&w, heads + i, sizeof(w));
+                return w;
+            }
+            uint64_t bits;
+            memcpy(&bits, full + i, sizeof(bits));
+            return (uint32_t)(bits >> (p == 0 ? 32 : 0));
+        }
+
+        uint64_t codedBytes() const
+        {
+            uint64_t total = 0;
+            for(size_t b = 0; b < blocks.size(); ++b)
+                total += blocks[b].size();
+            return total;
+        }
+
+        /* codes the planes into blocks, XORed with the previous checkpoint's or alone, in parallel by block */
+        void codeBlocks(const float* heads, const double* full, const uint_fast64_t& n, const uint32_t& planes, const bool& delta)
+        {
+            const uint_fast64_t perPlane = (n + checkpointBlockValues - 1) / checkpointBlockValues;
+            blocks.resize(planes * perPlane);
+            parallelFor(planes * perPlane, [&](const uint_fast64_t& first, const uint_fast64_t& last)
+            {
+                for(uint_fast64_t b = first; b < last; ++b)
+                {
+                    const uint32_t p = (uint32_t)(b / perPlane);
+                    const uint_fast64_t begin = (b % perPlane) * checkpointBlockValues;
+                    const size_t m = (size_t)std::min<uint_fast64_t>(checkpointBlockValues, n - begin);
+                    encodeCheckpointBlock([&](const size_t& i) { return word(heads, full, p, begin + i); },
+                        delta ? previous.data() + p * n + begin : nullptr, m, blocks[b]);
+                }
+            }, 1);
+        }
+
+        /* codes the values as the next delta of the chain, or as a new base, and keeps them for the next */
+        void encode(const float* heads, const double* full, const uint_fast64_t& n)
+        {
+            const uint32_t planes = full != nullptr ? 2 : 1;
+            bool delta = !previous.empty() && previousPlanes == planes && previousCount == n && chain < checkpointMaxChain;
+            if(delta)
+            {
+                codeBlocks(heads, full, n, planes, true);
+                // a restart reads the base and every delta, so the chain is kept to a few bases' worth
+                delta = chainBytes + codedBytes() <= checkpointChainBases * baseBytes;
+            }
+            if(!delta)
+                codeBlocks(heads, full, n, planes, false);
+
+            previous.resize(planes * n);
+            for(uint32_t p = 0; p < planes; ++p)
+                parallelFor(n, [&](const uint_fast64_t& first, const uint_fast64_t& last)
+                {
+                    for(uint_fast64_t i = first; i < last; ++i)
+                        previous[p * n + i] = word(heads, full, p, i);
+                });
+            previousPlanes = planes;
+            previousCount = n;
+
+            if(delta)
+            {
+                ++chain;
+                chainBytes += codedBytes();
+                return;
+            }
+            chain = 0;
+            chainBytes = 0;
+            baseBytes = codedBytes();
+            if(generation == 0)
+                generation = ((uint64_t)std::random_device()() << 32) | std::random_device()();
+            ++generation;
+        }
+
+        /* deletes path.delta.1, .2, ... up to the first that is missing */
+        void removeDeltas() const
+        {
+            for(uint32_t k = 1; unlink(checkpointDeltaPath(target, k).c_str()) == 0; ++k)
+                ;
+        }
+
+        /* writes path through a temporary, on disk before it is renamed over the previous one */
+        template<class Body>
+        static bool writeFile(const std::string& path, const Body& body)
+        {
+            const std::string part = path + ".part";
+            FILE* f = fopen(part.c_str(), "wb");
+            if(f == nullptr) return false;
+            bool ok = body(f);
+            // on disk before it replaces the previous checkpoint, which a crash would otherwise leave as neither
+            ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+            ok = (fclose(f) == 0) && ok;
+            if(ok)
+                ok = rename(part.c_str(), path.c_str()) == 0;
+            else
+                unlink(part.c_str());
+            return ok;
+        }
+
+        bool write(const float* heads, const double* full, const uint_fast64_t& n) const
+        {
+            return writeFile(target, [&](FILE* f)
+            {
+                CheckpointHeader header;
+                memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+                header.count = n;
+                header.planes = full != nullptr ? 2 : 1;
+                header.stateBytes = (uint32_t)state.size();
+                header.planeOffset = checkpointPlaneOffset(state.size());
+                const std::vector<char> padding(header.planeOffset - sizeof(header) - state.size(), 0);
+                bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+                    && fwrite(state.data(), 1, state.size(), f) == state.size()
+                    && fwrite(padding.data(), 1, padding.size(), f) == padding.size();
+
+                if(full == nullptr)
+                    return ok && fwrite(heads, sizeof(float), n, f) == n;
+                // split into the planes a block at a time, as writeSegments does
+                std::vector<uint32_t> block(std::min<uint_fast64_t>(n, 1 << 20));
+                for(uint32_t p = 0; p < 2; ++p)
+                    for(uint_fast64_t begin = 0; ok && begin < n; begin += block.size())
+                    {
+                        const uint_fast64_t m = std::min<uint_fast64_t>(block.size(), n - begin);
+                        for(uint_fast64_t i = 0; i < m; ++i)
+                            block[i] = word(heads, full, p, begin + i);
+                        ok = fwrite(block.data(), sizeof(uint32_t), m, f) == m;
+                    }
+                return ok;
+            });
+        }
+
+        /* the next delta of the chain, or a base over path, which leaves the deltas of the last one stale */
+        bool writeCoded(const uint32_t& planes, const uint_fast64_t& n) const
+        {
+            const bool ok = writeFile(chain > 0 ? checkpointDeltaPath(target, chain) : target, [&](FILE* f)
+            {
+                CompressedCheckpointHeader header;
+                memcpy(header.magic, compressedCheckpointMagic, sizeof(header.magic));
+                header.count = n;
+                header.planes = planes;
+                header.stateBytes = (uint32_t)state.size();
+                header.generation = generation;
+                header.sequence = chain;
+                header.blockValues = checkpointBlockValues;
+                std::vector<uint64_t> sizes(blocks.size());
+                for(size_t b = 0; b < blocks.size(); ++b)
+                    sizes[b] = blocks[b].size();
+                bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+                    && fwrite(state.data(), 1, state.size(), f) == state.size()
+                    && fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), f) == sizes.size();
+                for(size_t b = 0; ok && b < blocks.size(); ++b)
+                    ok = fwrite(blocks[b].data(), 1, blocks[b].size(), f) == blocks[b].size();
+                return ok;
+            });
+            if(ok && chain == 0)
+                removeDeltas();
+            return ok;
+        }
+    };
+
+    /*
+        A checkpoint mapped read-only, or decoded if it was compressed. Invalid (valid() false, state()
+        false) if path is null, missing, not a checkpoint, or shorter than its header says. A compressed
+        base is read with the deltas of its chain, path.delta.1, .2, ..., up to the first that is
+        missing, of another base, or not whole.
+    */
+    class CheckpointFile
+    {
+    public:
+        explicit CheckpointFile(const char* path = getenv("MANSEG_CHECKPOINT"))
+            :data(nullptr), bytes(0), planes(0), count(0), stateBytes(0), stateData(nullptr), planeData(nullptr),
+             generation(0), applied(0)
+        {
+            if(path == nullptr || *path == '\0') return;
+            if(!map(path, data, bytes)) return;
+
+            if(bytes >= sizeof(CheckpointHeader) && memcmp(data, checkpointMagic, sizeof(checkpointMagic)) == 0)
+            {
+                const CheckpointHeader* h = reinterpret_cast<const CheckpointHeader*>(data);
+                const bool whole = (h->planes == 1 || h->planes == 2)
+                    && h->planeOffset == checkpointPlaneOffset(h->stateBytes)
+                    && h->planeOffset + h->planes * h->count * sizeof(float) <= bytes;
+                if(whole)
+                {
+                    planes = h->planes;
+                    count = h->count;
+                    stateBytes = h->stateBytes;
+                    stateData = data + sizeof(CheckpointHeader);
+                    planeData = reinterpret_cast<const float*>(data + h->planeOffset);
+                    madvise(const_cast<char*>(data), bytes, MADV_WILLNEED);
+                }
+                return;
+            }
+
+            // a compressed base and its deltas are decoded, so the files are not kept
+            const bool decoded = decode(data, bytes, 0);
+            munmap(const_cast<char*>(data), bytes);
+            data = nullptr;
+            if(!decoded) return;
+            const char* delta;
+            size_t deltaBytes;
+            for(uint32_t k = 1; map(checkpointDeltaPath(path, k).c_str(), delta, deltaBytes); ++k)
+            {
+                const bool next = decode(delta, deltaBytes, k);
+                munmap(const_cast<char*>(delta), deltaBytes);
+                if(!next)
+                    break;
+                applied = k;
+            }
+            stateData = savedState.data();
+            planeData = reinterpret_cast<const float*>(values.data());
+        }
+
+        CheckpointFile(const CheckpointFile&) = delete;
+        CheckpointFile& operator=(const CheckpointFile&) = delete;
+
+        ~CheckpointFile()
+        {
+            if(data != nullptr)
+                munmap(const_cast<char*>(data), bytes);
+        }
+
+        bool valid() const { return planeData != nullptr; }
+        uint_fast64_t size() const { return valid() ? count : 0; }
+        /* whether the full doubles were saved, rather than the heads alone */
+        bool hasTails() const { return valid() && planes == 2; }
+        /* whether the checkpoint was compressed, and the number of deltas applied to its base */
+        bool compressed() const { return valid() && data == nullptr; }
+        uint32_t deltas() const { return valid() ? applied : 0; }
+
+        /* copies the saved state into s; false if there is none of its size */
+        template<class State>
+        bool state(State& s) const
+        {
+            static_assert(std::is_trivially_copyable<State>::value, "checkpoint state is saved as its bytes");
+            if(!valid() || stateBytes != sizeof(State)) return false;
+            memcpy(&s, stateData, sizeof(State));
+            return true;
+        }
+
+        const float* heads() const { return valid() ? planeData : nullptr; }
+        const float* tails() const { return hasTails() ? planeData + count : nullptr; }
+
+        /* the i-th saved value: its head with a zero tail, or the whole double if the tails were saved */
+        double value(const uint_fast64_t& i) const
+        {
+            uint32_t h, t = 0;
+            memcpy(&h, heads() + i, sizeof(h));
+            if(hasTails())
+                memcpy(&t, tails() + i, sizeof(t));
+            const uint64_t bits = ((uint64_t)h << 32) | t;
+            double v;
+            memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+
+    private:
+        const char* data;               // the mapped file, unless it was compressed
+        size_t bytes;
+        uint32_t planes;
+        uint_fast64_t count;
+        uint32_t stateBytes;
+        const char* stateData;
+        const float* planeData;
+        std::vector<uint32_t> values;   // the decoded planes of a compressed checkpoint
+        std::vector<char> savedState;
+        uint64_t generation;
+        uint32_t applied;
+
+        static bool map(const char* path, const char*& mapped, size_t& size)
+        {
+            mapped = nullptr;
+            size = 0;
+            const int fd = open(path, O_RDONLY);
+            if(fd < 0) return false;
+            struct stat info;
+            if(fstat(fd, &info) == 0 && info.st_size > 0)
+            {
+                size = info.st_size;
+                void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                mapped = (mem == MAP_FAILED) ? nullptr : static_cast<const char*>(mem);
+            }
+            close(fd);
+            return mapped != nullptr;
+        }
+
+        /*
+            Decodes a compressed base (sequence 0) into values and savedState, or the sequence-th delta of
+            its chain over them; false, leaving them as they were, if the file is not that.
+        */
+        bool decode(const char* file, const size_t& size, const uint32_t& sequence)
+        {
+            if(size < sizeof(CompressedCheckpointHeader)) return false;
+            CompressedCheckpointHeader h;
+            memcpy(&h, file, sizeof(h));
+            if(memcmp(h.magic, compressedCheckpointMagic, sizeof(h.magic)) != 0 || (h.planes != 1 && h.planes != 2)
+                || h.sequence != sequence || h.blockValues == 0)
+                return false;
+            if(sequence > 0 && (h.generation != generation || h.planes != planes || h.count != count))
+                return false;
+            const uint64_t perPlane = (h.count + h.blockValues - 1) / h.blockValues;
+            const uint64_t numBlocks = h.planes * perPlane;
+            const uint64_t tableAt = sizeof(h) + (uint64_t)h.stateBytes;
+            if(tableAt > size || numBlocks > (size - tableAt) / sizeof(uint64_t)) return false;
+            // where each block starts, checking that they all lie within the file
+            std::vector<uint64_t> offsets(numBlocks + 1);
+            offsets[0] = tableAt + numBlocks * sizeof(uint64_t);
+            for(uint64_t b = 0; b < numBlocks; ++b)
+            {
+                uint64_t blockBytes;
+                memcpy(&blockBytes, file + tableAt + b * sizeof(uint64_t), sizeof(blockBytes));
+                if(blockBytes > size - offsets[b]) return false;
+                offsets[b + 1] = offsets[b] + blockBytes;
+            }
+
+            // a delta is XORed with a copy, so a bad one leaves the checkpoint before it intact
+            std::vector<uint32_t> decoded;
+            if(sequence > 0)
+                decoded = values;
+            else
+                decoded.resize(h.planes * h.count);
+            const uint64_t n = h.count;
+            std::atomic<bool> ok(true);
+            parallelFor(numBlocks, [&](const uint_fast64_t& first, const uint_fast64_t& last)
+            {
+                for(uint_fast64_t b = first; b < last; ++b)
+                {
+                    const uint64_t begin = (b % perPlane) * h.blockValues;
+                    uint32_t* words = decoded.data() + (b / perPlane) * n + begin;
+                    const size_t m = (size_t)std::min<uint64_t>(h.blockValues, n - begin);
+                    if(!decodeCheckpointBlock(reinterpret_cast<const unsigned char*>(file) + offsets[b],
+                        offsets[b + 1] - offsets[b], sequence > 0 ? words : nullptr, m, words))
+                        ok = false;
+                }
+            }, 1);
+            if(!ok) return false;
+
+            values.swap(decoded);
+            savedState.assign(file + sizeof(h), file + tableAt);
+            planes = h.planes;
+            count = h.count;
+            stateBytes = h.stateBytes;
+            generation = h.generation;
+            return true;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,283 @@
+/*
+	Mixed-precision MPI collectives for mantissa segmented values.
+	Author: harunadess
+
+	Distributed solvers exchange the same kinds of things: a reduction over every process, the values
+	of the boundary elements other processes read, and now and then the full precision of a few of
+	those. Sending only the heads halves the bytes of the first two at low precision; ManSeg::comm
+	packs the segments so that each app does not have to:
+		allreduceHeads(h, n, MPI_SUM, comm);            // h: a heads plane, summed at the heads
+		allreducePairs(h, t, n, MPI_MAX, comm);         // the doubles the planes make up, exactly
+		ExchangePattern p = exchangePattern(ghosts, bounds, comm);  // once: who reads what of whom
+		SegmentExchange<false> x(p);                    // the heads of the values; <true>: the doubles
+		x.pack(v);                                      // v[p.sendIndex[k]] for each value sent
+		x.start();  ...  x.wait();                      // MPI_Ialltoallv, overlapped with local work
+		x.received(g);                                  // value g, in the order of ghosts
+		fetchTails(p, v.getTails(), wanted, tails);     // only the tails asked for, of an exchange of
+		                                                // v's own heads: PairsSpan(x.heads(), tails, ..)
+	Process r owns the global elements [bounds[r], bounds[r+1]), held locally from index 0; ghosts,
+	the global ids a process reads from the others, are sorted. The heads travel as MPI_FLOAT and the
+	pairs as MPI_DOUBLE: a pair is the double whose high and low halves are its head and tail, so no
+	derived datatype is needed and nothing is lost. Counts are int, as MPI's are. The C++ bindings of
+	MPI are skipped (they are gone since MPI-3, and break with -DLONG as in ligra).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_COMM_H__
+#define __MANSEG_COMM_H__
+
+#ifndef OMPI_SKIP_MPICXX
+#define OMPI_SKIP_MPICXX 1
+#endif
+#ifndef MPICH_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX 1
+#endif
+#include <mpi.h>
+#include <stdint.h>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+namespace comm
+{
+    /* a heads plane combined element by element: the heads are read as doubles and the result truncated */
+    template<int op>
+    void combineHeads(void* in, void* inout, int* len, MPI_Datatype*)
+    {
+        HeadsSpan a(static_cast<float*>(in), nullptr, *len), b(static_cast<float*>(inout), nullptr, *len);
+        for(int i = 0; i < *len; ++i)
+        {
+            const double x = a.read(i), y = b.read(i);
+            b.set(i, op == 0 ? x + y : op == 1 ? std::max(x, y) : std::min(x, y));
+        }
+    }
+
+    /* the user op reducing heads as op (MPI_SUM, MPI_MAX or MPI_MIN) reduces doubles; created once */
+    inline MPI_Op headsOp(MPI_Op op)
+    {
+        static MPI_Op ops[3] = { MPI_OP_NULL, MPI_OP_NULL, MPI_OP_NULL };
+        const int k = op == MPI_SUM ? 0 : op == MPI_MAX ? 1 : op == MPI_MIN ? 2 : -1;
+        if(k < 0)
+            throw std::invalid_argument("allreduceHeads: only MPI_SUM, MPI_MAX and MPI_MIN");
+        if(ops[k] == MPI_OP_NULL)
+        {
+            MPI_User_function* f[3] = { combineHeads<0>, combineHeads<1>, combineHeads<2> };
+            MPI_Op_create(f[k], 1, &ops[k]);
+        }
+        return ops[k];
+    }
+
+    /*
+        Reduces the n heads of every process in place, sending 4 bytes a value. A sum of heads is
+        truncated at each step of the reduction, so it can be a few units in the last place of a head
+        below the sum of the doubles; max and min are exact.
+    */
+    inline void allreduceHeads(float* heads, const int& n, MPI_Op op, MPI_Comm comm)
+    {
+        MPI_Allreduce(MPI_IN_PLACE, heads, n, MPI_FLOAT, headsOp(op), comm);
+    }
+
+    /* Reduces the n pairs of every process in place, as the doubles they make up */
+    inline void allreducePairs(float* heads, float* tails, const int& n, MPI_Op op, MPI_Comm comm)
+    {
+        PairsSpan pairs(heads, tails, n);
+        std::vector<double> values(n);
+        for(int i = 0; i < n; ++i)
+            values[i] = pairs.read(i);
+        MPI_Allreduce(MPI_IN_PLACE, values.data(), n, MPI_DOUBLE, op, comm);
+        for(int i = 0; i < n; ++i)
+            pairs.set(i, values[i]);
+    }
+
+    /* Which local values a process sends to each other, and how many it receives from each (see above) */
+    struct ExchangePattern
+    {
+        MPI_Comm comm;
+        std::vector<int> sendCounts, sendDispls, recvCounts, recvDispls;
+        std::vector<uint_fast64_t> sendIndex;   // local index of each value sent, grouped by process
+
+        int numSent() const { return sendDispls.empty() ? 0 : sendDispls.back() + sendCounts.back(); }
+        int numReceived() const { return recvDispls.empty() ? 0 : recvDispls.back() + recvCounts.back(); }
+    };
+
+    /*
+        The pattern of an exchange in which each process receives the values of ghosts, the sorted global
+        ids it reads; bounds has the first global id of each process, and one past the last. Collective.
+    */
+    inline ExchangePattern exchangePattern(const std::vector<uint64_t>& ghosts, const std::vector<uint64_t>& bounds, MPI_Comm comm)
+    {
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        if((int)bounds.size() != size + 1)
+            throw std::invalid_argument("exchangePattern: bounds needs one more entry than there are processes");
+
+        ExchangePattern p;
+        p.comm = comm;
+        p.recvCounts.assign(size, 0);
+        for(int r = 0, k = 0; r < size; ++r)
+            while(k < (int)ghosts.size() && ghosts[k] < bounds[r + 1])
+                ++p.recvCounts[r], ++k;
+        p.sendCounts.assign(size, 0);
+        MPI_Alltoall(p.recvCounts.data(), 1, MPI_INT, p.sendCounts.data(), 1, MPI_INT, comm);
+        p.recvDispls.assign(size, 0);
+        p.sendDispls.assign(size, 0);
+        for(int r = 1; r < size; ++r)
+        {
+            p.recvDispls[r] = p.recvDispls[r - 1] + p.recvCounts[r - 1];
+            p.sendDispls[r] = p.sendDispls[r - 1] + p.sendCounts[r - 1];
+        }
+
+        std::vector<unsigned long long> wanted(ghosts.begin(), ghosts.end()), asked(p.numSent());
+        MPI_Alltoallv(wanted.data(), p.recvCounts.data(), p.recvDispls.data(), MPI_UNSIGNED_LONG_LONG,
+                      asked.data(), p.sendCounts.data(), p.sendDispls.data(), MPI_UNSIGNED_LONG_LONG, comm);
+        p.sendIndex.resize(asked.size());
+        for(size_t k = 0; k < asked.size(); ++k)
+            p.sendIndex[k] = asked[k] - bounds[rank];
+        return p;
+    }
+
+    /*
+        A nonblocking exchange of values along a pattern: their heads (useTail false), 4 bytes each, or
+        their doubles, 8. The buffers are kept, so one SegmentExchange serves every iteration; the
+        pattern must outlive it.
+    */
+    template<bool useTail>
+    class SegmentExchange
+    {
+    public:
+        typedef typename std::conditional<useTail, double, float>::type value_type;
+
+        explicit SegmentExchange(const ExchangePattern& pattern)
+            :pattern(&pattern), send(pattern.numSent()), recv(pattern.numReceived()), request(MPI_REQUEST_NULL) {}
+
+        SegmentExchange(const SegmentExchange&) = delete;
+        SegmentExchange& operator=(const SegmentExchange&) = delete;
+
+        ~SegmentExchange() { wait(); }
+
+        /* value k of those sent */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void set(const uint_fast64_t& k, const double& value) { put<mode>(send.data(), k, value); }
+
+        /* sets every value sent from x, at pattern.sendIndex */
+        template<RoundingMode mode = ROUND_TRUNCATE, class View>
+        void pack(View x)
+        {
+            for(size_t k = 0; k < send.size(); ++k)
+                set<mode>(k, x[pattern->sendIndex[k]]);
+        }
+
+        void start()
+        {
+            MPI_Ialltoallv(send.data(), pattern->sendCounts.data(), pattern->sendDispls.data(), type(),
+                           recv.data(), pattern->recvCounts.data(), pattern->recvDispls.data(), type(), pattern->comm, &request);
+        }
+
+        void wait()
+        {
+            if(request != MPI_REQUEST_NULL)
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+
+        /* value g of those received, once wait() has returned */
+        double received(const uint_fast64_t& g) const { return get(recv.data(), g); }
+
+        /* the heads received, as a plane (useTail false) */
+        float* heads() { return reinterpret_cast<float*>(recv.data()); }
+
+        int numSent() const { return send.size(); }
+        int numReceived() const { return recv.size(); }
+        static MPI_Datatype type() { return useTail ? MPI_DOUBLE : MPI_FLOAT; }
+
+    private:
+        const ExchangePattern* pattern;
+        std::vector<value_type> send, recv;
+        MPI_Request request;
+
+        template<RoundingMode mode>
+        static void put(double* values, const uint_fast64_t& k, const double& value) { values[k] = value; }
+        template<RoundingMode mode>
+        static void put(float* values, const uint_fast64_t& k, const double& value) { HeadsSpan(values, nullptr, k + 1).template set<mode>(k, value); }
+        static double get(const double* values, const uint_fast64_t& g) { return values[g]; }
+        static double get(const float* values, const uint_fast64_t& g) { return HeadsSpan(const_cast<float*>(values), nullptr, g + 1).read(g); }
+    };
+
+    /* Exchanges the heads of x along pattern, blocking: recvHeads gets pattern.numReceived() heads */
+    template<class View>
+    void alltoallvHeads(const ExchangePattern& pattern, View x, float* recvHeads)
+    {
+        SegmentExchange<false> exchange(pattern);
+        exchange.pack(x);
+        exchange.start();
+        exchange.wait();
+        std::copy(exchange.heads(), exchange.heads() + pattern.numReceived(), recvHeads);
+    }
+
+    /*
+        Tails on demand, after an exchange of the heads of an array's own values (e.g. a halo): each
+        process asks only for the tails of the received values it wants at full precision, slots
+        (ascending indices of values received), and gets them from their owners' tails plane
+        localTails into recvTails[slot], so that PairsSpan(received heads, recvTails, ..) reads those
+        values exactly. Two small alltoallvs carry the requests and the tails. Collective: a process
+        wanting none passes an empty slots.
+    */
+    inline void fetchTails(const ExchangePattern& pattern, const float* localTails, const std::vector<uint_fast64_t>& slots, float* recvTails)
+    {
+        const int size = pattern.recvCounts.size();
+        std::vector<int> askCounts(size, 0), askDispls(size, 0), giveCounts(size), giveDispls(size, 0);
+        std::vector<int> positions(slots.size());
+        for(size_t j = 0, r = 0; j < slots.size(); ++j)
+        {
+            while(r + 1 < (size_t)size && slots[j] >= (uint_fast64_t)pattern.recvDispls[r + 1])
+                ++r;
+            positions[j] = slots[j] - pattern.recvDispls[r];    // among those r sends this process
+            ++askCounts[r];
+        }
+        MPI_Alltoall(askCounts.data(), 1, MPI_INT, giveCounts.data(), 1, MPI_INT, pattern.comm);
+        for(int r = 1; r < size; ++r)
+        {
+            askDispls[r] = askDispls[r - 1] + askCounts[r - 1];
+            giveDispls[r] = giveDispls[r - 1] + giveCounts[r - 1];
+        }
+        std::vector<int> asked(size == 0 ? 0 : giveDispls.back() + giveCounts.back());
+        MPI_Alltoallv(positions.data(), askCounts.data(), askDispls.data(), MPI_INT,
+                      asked.data(), giveCounts.data(), giveDispls.data(), MPI_INT, pattern.comm);
+
+        std::vector<float> give(asked.size()), got(slots.size());
+        for(int r = 0; r < size; ++r)
+            for(int k = giveDispls[r]; k < giveDispls[r] + giveCounts[r]; ++k)
+                give[k] = localTails[pattern.sendIndex[pattern.sendDispls[r] + asked[k]]];
+        MPI_Alltoallv(give.data(), giveCounts.data(), giveDispls.data(), MPI_FLOAT,
+                      got.data(), askCounts.data(), askDispls.data(), MPI_FLOAT, pattern.comm);
+        for(size_t j = 0; j < slots.size(); ++j)
+            recvTails[slots[j]] = got[j];
+    }
+}
+}
+
+#endif
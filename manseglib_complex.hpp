@@ -0,0 +1,368 @@
+/*
+	Mantissa segmented arrays of complex numbers, and the complex BLAS operations on them.
+	Author: harunadess
+
+	A complex double is 16 bytes, so a complex solver (a Hermitian system, a frequency domain PDE)
+	moves twice the bytes of a real one for the same arithmetic. A ComplexSegArray keeps the real and
+	imaginary parts as two ManSegArrays, re and im, each with its heads, tails and (once promoted) full
+	planes, so the heads of a complex value are 8 bytes and its pairs are the 16 of the double:
+		ComplexSegArray x(n), y(n);
+		x.set<ACCESS_HEADS>(i, std::complex<double>(1.0, -2.0));
+		std::complex<double> d = blas::zdotc(n, x.heads(), y.pairs());    // sum of conj(x[i]) * y[i]
+		blas::zaxpy(n, alpha, p.pairs(), y.pairs());                      // y += alpha * p
+		blas::zcsrmv(rows, offsets, cols, A.heads(), x.pairs(), y.pairs()); // y = A x, A in CSR
+		x.promote();                                                      // both parts to full
+		blas::zaxpy(n, alpha, p.full(), x.full());
+	heads(), pairs() and full() (or read_as and write_as) are ComplexViews of the array at a level,
+	with read and set<mode> of std::complex<double> and readBlock and writeBlock into separate buffers
+	of real and imaginary parts; a ComplexView can also be made of any two views of the other kinds,
+	such as FullViews of caller's doubles. The parts being stored apart, the operations widen each
+	with the SIMD kernels of the real views and do the complex arithmetic on the split buffers, which
+	the compiler vectorises with no shuffles; zcsrmv gathers the parts of x with gatherHeads or
+	gatherSegments. zdotc and dznrm2 sum in blocks, so their sums are not in element order, and the
+	operations divide their range (zcsrmv its rows) between the workers of the parallel backend.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_COMPLEX_H__
+#define __MANSEG_COMPLEX_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <complex>
+#include <utility>
+
+#include "manseglib.hpp"
+#include "manseglib_blas.hpp"
+
+namespace ManSeg
+{
+    /*
+        The complex values whose real parts are those of re and imaginary parts those of im, two views
+        of any kind (heads, pairs, spans or FullViews). Like the views it is made of, it does not own
+        the values.
+    */
+    template<class Re, class Im = Re>
+    class ComplexView
+    {
+    public:
+        Re re;
+        Im im;
+
+        ComplexView() {}
+        ComplexView(const Re& re, const Im& im) :re(re), im(im) {}
+
+        std::complex<double> operator[](const uint_fast64_t& id) { return read(id); }
+
+        std::complex<double> read(const uint_fast64_t& id)
+        {
+            return std::complex<double>(re.read(id), im.read(id));
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void set(const uint_fast64_t& id, const std::complex<double>& z)
+        {
+            re.template set<mode>(id, z.real());
+            im.template set<mode>(id, z.imag());
+        }
+
+        /* the real parts of [start, start + n) to outRe, and the imaginary parts to outIm */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* outRe, double* outIm) const
+        {
+            re.readBlock(start, n, outRe);
+            im.readBlock(start, n, outIm);
+        }
+
+        /* heads are truncated, as by their writeBlock */
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* inRe, const double* inIm)
+        {
+            re.writeBlock(start, n, inRe);
+            im.writeBlock(start, n, inIm);
+        }
+
+        ComplexView subspan(const uint_fast64_t& start, const uint_fast64_t& n) const
+        {
+            return ComplexView(re.subspan(start, n), im.subspan(start, n));
+        }
+
+        uint_fast64_t size() const { return re.size(); }
+    };
+
+    template<class Re, class Im>
+    inline ComplexView<Re, Im> complexView(const Re& re, const Im& im) { return ComplexView<Re, Im>(re, im); }
+
+    /* the parts of x[idx[i]] for i in [0, n), gathered at x's level (see gather) */
+    template<class Re, class Im>
+    inline void gather(const ComplexView<Re, Im>& x, const int32_t* idx, const uint_fast64_t& n, double* outRe, double* outIm)
+    {
+        gather(x.re, idx, n, outRe);
+        gather(x.im, idx, n, outIm);
+    }
+
+    /* the ComplexView of a ComplexSegArray at a level, as LevelView is of a ManSegArray */
+    template<AccessLevel level, class Allocator = SegmentAllocator>
+    struct ComplexLevelView
+    {
+        using part = typename LevelView<level, Allocator>::type;
+        using type = ComplexView<part, part>;
+        template<class Array>
+        static type of(Array& a) { return type(LevelView<level, Allocator>::of(a.re), LevelView<level, Allocator>::of(a.im)); }
+    };
+
+    /*
+        length complex values as two ManSegArrays of their real and imaginary parts (see
+        manseglib_complex.hpp). Promotion, demotion and freeing act on both parts together; re and im
+        can also be used on their own, e.g. to label them or to read one part with the real kernels.
+        It can be moved or swapped but not copied.
+    */
+    template<class Allocator = SegmentAllocator>
+    class BasicComplexSegArray
+    {
+    public:
+        using PartType = BasicManSegArray<Allocator>;
+        template<AccessLevel level>
+        using ViewType = typename ComplexLevelView<level, Allocator>::type;
+
+        PartType re;
+        PartType im;
+        uint_fast64_t length;
+
+        BasicComplexSegArray(const Allocator& allocator = Allocator())
+            :re(allocator), im(allocator), length(0)
+        {}
+
+        BasicComplexSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :re(length, allocator), im(length, allocator), length(length)
+        {}
+
+        BasicComplexSegArray(BasicComplexSegArray&& other) noexcept
+            :re(std::move(other.re)), im(std::move(other.im)), length(other.length)
+        {
+            other.length = 0;
+        }
+
+        BasicComplexSegArray& operator=(BasicComplexSegArray&& other) noexcept
+        {
+            if(this != &other)
+            {
+                re = std::move(other.re);
+                im = std::move(other.im);
+                length = other.length;
+                other.length = 0;
+            }
+            return *this;
+        }
+
+        void swap(BasicComplexSegArray& other) noexcept
+        {
+            re.swap(other.re);
+            im.swap(other.im);
+            std::swap(length, other.length);
+        }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            re.alloc(length);
+            im.alloc(length);
+        }
+
+        /* views of the array at a level; for ACCESS_FULL, full must be allocated (see allocFull and promote) */
+        template<AccessLevel level>
+        ViewType<level> read_as() { return ComplexLevelView<level, Allocator>::of(*this); }
+
+        template<AccessLevel level>
+        ViewType<level> write_as() { return ComplexLevelView<level, Allocator>::of(*this); }
+
+        ViewType<ACCESS_HEADS> heads() { return read_as<ACCESS_HEADS>(); }
+        ViewType<ACCESS_PAIRS> pairs() { return read_as<ACCESS_PAIRS>(); }
+        ViewType<ACCESS_FULL> full() { return read_as<ACCESS_FULL>(); }
+
+        template<AccessLevel level>
+        std::complex<double> read(const uint_fast64_t& id) { return read_as<level>().read(id); }
+
+        template<AccessLevel level, RoundingMode mode = ROUND_TRUNCATE>
+        void set(const uint_fast64_t& id, const std::complex<double>& z) { write_as<level>().template set<mode>(id, z); }
+
+        void allocFull()
+        {
+            re.allocFull();
+            im.allocFull();
+        }
+
+        /* fills the full values of both parts from their pairs (see BasicManSegArray::promote) */
+        void promote()
+        {
+            re.promote();
+            im.promote();
+        }
+
+        /* writes the full values of both parts back to their segments and frees them (see BasicManSegArray::demote) */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void demote(const bool& dropTails = false)
+        {
+            re.template demote<mode>(dropTails);
+            im.template demote<mode>(dropTails);
+        }
+
+        void delSegments()
+        {
+            re.delSegments();
+            im.delSegments();
+            if(re.full == nullptr) length = 0;
+        }
+
+        void del()
+        {
+            re.del();
+            im.del();
+            if(!re.heads.isAlloc()) length = 0;
+        }
+
+        bool isPromoted() const { return re.full != nullptr; }
+        uint_fast64_t size() const { return length; }
+    };
+
+    typedef BasicComplexSegArray<> ComplexSegArray;
+
+namespace blas
+{
+    /* sum of conj(x[i]) * y[i] over [start, start + n) */
+    template<class X, class Y>
+    inline std::complex<double> zdotcRange(const X& x, const Y& y, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        double xr[Block], xi[Block], yr[Block], yi[Block];
+        double sumRe = 0.0, sumIm = 0.0;
+        for(uint_fast64_t i = start; i < start + n; i += Block)
+        {
+            const uint_fast64_t m = std::min(Block, start + n - i);
+            x.readBlock(i, m, xr, xi);
+            y.readBlock(i, m, yr, yi);
+            double blockRe = 0.0, blockIm = 0.0;
+            for(uint_fast64_t k = 0; k < m; ++k)
+            {
+                blockRe += xr[k] * yr[k] + xi[k] * yi[k];
+                blockIm += xr[k] * yi[k] - xi[k] * yr[k];
+            }
+            sumRe += blockRe;
+            sumIm += blockIm;
+        }
+        return std::complex<double>(sumRe, sumIm);
+    }
+
+    /* the Hermitian inner product of the first n values: the sum of conj(x[i]) * y[i] */
+    template<class X, class Y>
+    inline std::complex<double> zdotc(const uint_fast64_t& n, const X& x, const Y& y)
+    {
+        return parallelReduce<std::complex<double>>(n, std::complex<double>(0.0, 0.0),
+            [&](const uint_fast64_t& begin, const uint_fast64_t& end) { return zdotcRange(x, y, begin, end - begin); },
+            [](const std::complex<double>& a, const std::complex<double>& b) { return a + b; });
+    }
+
+    /* the Euclidean norm of the first n values, that of their real and imaginary parts together */
+    template<class X>
+    inline double dznrm2(const uint_fast64_t& n, const X& x)
+    {
+        return sqrt(zdotc(n, x, x).real());
+    }
+
+    /* y = alpha * x + y over the first n values */
+    template<class X, class Y>
+    inline void zaxpy(const uint_fast64_t& n, const std::complex<double>& alpha, const X& x, Y&& y)
+    {
+        const double ar = alpha.real(), ai = alpha.imag();
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double xr[Block], xi[Block], yr[Block], yi[Block];
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, xr, xi);
+                y.readBlock(i, m, yr, yi);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                {
+                    yr[k] += ar * xr[k] - ai * xi[k];
+                    yi[k] += ar * xi[k] + ai * xr[k];
+                }
+                y.writeBlock(i, m, yr, yi);
+            }
+        });
+    }
+
+    /* x = alpha * x over the first n values */
+    template<class X>
+    inline void zscal(const uint_fast64_t& n, const std::complex<double>& alpha, X&& x)
+    {
+        const double ar = alpha.real(), ai = alpha.imag();
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double xr[Block], xi[Block];
+            for(uint_fast64_t i = begin; i < end; i += Block)
+            {
+                const uint_fast64_t m = std::min(Block, end - i);
+                x.readBlock(i, m, xr, xi);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                {
+                    const double r = ar * xr[k] - ai * xi[k];
+                    xi[k] = ar * xi[k] + ai * xr[k];
+                    xr[k] = r;
+                }
+                x.writeBlock(i, m, xr, xi);
+            }
+        });
+    }
+
+    /*
+        y = A x for the rows x n complex matrix A in CSR: row r's entries are A[offsets[r], offsets[r + 1]),
+        in the columns cols[offsets[r], offsets[r + 1]). A's values are read a block of a row at a time,
+        and the parts of x gathered alongside them, at the levels of the views given.
+    */
+    template<class Offset, class M, class X, class Y>
+    inline void zcsrmv(const uint_fast64_t& rows, const Offset* offsets, const int32_t* cols, const M& A, const X& x, Y&& y)
+    {
+        parallelFor(rows, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double ar[Block], ai[Block], xr[Block], xi[Block];
+            for(uint_fast64_t r = begin; r < end; ++r)
+            {
+                double sumRe = 0.0, sumIm = 0.0;
+                const uint_fast64_t last = offsets[r + 1];
+                for(uint_fast64_t l = offsets[r]; l < last; l += Block)
+                {
+                    const uint_fast64_t m = std::min(Block, last - l);
+                    A.readBlock(l, m, ar, ai);
+                    gather(x, cols + l, m, xr, xi);
+                    for(uint_fast64_t k = 0; k < m; ++k)
+                    {
+                        sumRe += ar[k] * xr[k] - ai[k] * xi[k];
+                        sumIm += ar[k] * xi[k] + ai[k] * xr[k];
+                    }
+                }
+                y.set(r, std::complex<double>(sumRe, sumIm));
+            }
+        });
+    }
+}
+}
+
+#endif // __MANSEG_COMPLEX_H__
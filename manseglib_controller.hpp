@@ -0,0 +1,504 @@
+/*
+	Precision switching control for iterative solvers using mantissa segmented arrays.
+	Author: harunadess
+
+	The drivers each decide when to leave the heads with their own rule (a bound on the delta,
+	a minimum relative change per iteration, ...). PrecisionController moves a solver through
+	heads -> interim -> full, asking a policy after every heads iteration whether it is time to
+	switch, and records when and why it did.
+		PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
+		while(control.level() == PRECISION_HEADS) { ...; control.update(delta); }
+	Policies are small classes providing
+		SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+	which return SWITCH_NONE to stay at the heads, and
+		double remaining(const double& delta, const double& rate) const
+	which estimates how many more iterations that will go on for, with the delta falling by rate per
+	iteration (see PrecisionController::iterationsToSwitch); two policies can be combined with
+	EitherPolicy, and ConfiguredPolicy picks one at run time from the environment.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_CONTROLLER_H__
+#define __MANSEG_CONTROLLER_H__
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /*
+        Precision a solver iterates at.
+        PRECISION_INTERIM is the single iteration which reads heads and writes full precision.
+    */
+    enum PrecisionLevel { PRECISION_HEADS, PRECISION_INTERIM, PRECISION_FULL };
+
+    inline const char* levelName(const PrecisionLevel& level)
+    {
+        switch(level)
+        {
+        case PRECISION_HEADS: return "heads";
+        case PRECISION_INTERIM: return "interim";
+        default: return "full";
+        }
+    }
+
+    /* why the controller left the heads */
+    enum SwitchReason { SWITCH_NONE, SWITCH_BOUND, SWITCH_STAGNATION, SWITCH_PREDICTED, SWITCH_FORCED, SWITCH_FLOOR, SWITCH_TRUNCATION, SWITCH_REMEMBERED };
+
+    inline const char* reasonName(const SwitchReason& reason)
+    {
+        switch(reason)
+        {
+        case SWITCH_BOUND: return "delta within bound";
+        case SWITCH_STAGNATION: return "delta stagnated";
+        case SWITCH_PREDICTED: return "predicted to reach bound";
+        case SWITCH_FORCED: return "forced";
+        case SWITCH_FLOOR: return "at attainable accuracy";
+        case SWITCH_TRUNCATION: return "heads error dominates";
+        case SWITCH_REMEMBERED: return "remembered from an earlier run";
+        default: return "none";
+        }
+    }
+
+    /*
+        Iterations for a delta falling by rate per iteration to reach target: 0 if it already has,
+        INFINITY if it is not falling.
+    */
+    inline double iterationsToReach(const double& target, const double& delta, const double& rate)
+    {
+        if(delta <= target) return 0.0;
+        if(!(rate > 0.0 && rate < 1.0)) return INFINITY;
+        return log(target / delta) / log(rate);
+    }
+
+    /*
+        Switches once the delta is within bound, by default the reliable precision of the heads.
+        (The rule of PageRankManSeg and PageRankUpdate_F2D.)
+    */
+    struct AbsoluteBoundPolicy
+    {
+        double bound;
+
+        AbsoluteBoundPolicy(const double& bound = AdaptivePrecisionBound) :bound(bound) {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            return (delta <= bound) ? SWITCH_BOUND : SWITCH_NONE;
+        }
+
+        double remaining(const double& delta, const double& rate) const
+        {
+            return iterationsToReach(bound, delta, rate);
+        }
+    };
+
+    /*
+        Switches once the relative decrease of the delta, (prevDelta - delta) / prevDelta, is at or
+        below threshold, i.e. the heads have stopped making progress. With checkFrequency > 1 the
+        decrease is measured over that many iterations rather than a single one.
+        (The rule of msa_pagerank.)
+    */
+    struct StagnationPolicy
+    {
+        double threshold;
+        int checkFrequency;
+        double change;      // last relative decrease measured
+
+        StagnationPolicy(const double& threshold = 0.25, const int& checkFrequency = 1)
+            :threshold(threshold), checkFrequency(checkFrequency), change(1.0), reference(-1.0), steps(0)
+        {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            if(reference < 0.0) reference = prevDelta;
+            if(++steps < checkFrequency) return SWITCH_NONE;
+
+            change = (reference - delta) / reference;
+            reference = delta;
+            steps = 0;
+            return (change <= threshold) ? SWITCH_STAGNATION : SWITCH_NONE;
+        }
+
+        /*
+            The heads stagnate about where rounding them dominates the delta: taken as the delta reaching
+            MaxSingleSegmentPrecision, as for a solution of norm 1 such as a PageRank vector.
+        */
+        double remaining(const double& delta, const double& rate) const
+        {
+            return iterationsToReach(MaxSingleSegmentPrecision, delta, rate);
+        }
+
+    private:
+        double reference;   // delta at the start of the current check period
+        int steps;
+    };
+
+    /*
+        Estimates the convergence rate r = delta / prevDelta and switches once the delta is
+        predicted to be within bound in at most lookahead more iterations,
+        i.e. log(bound / delta) / log(r) <= lookahead, so that the switch does not wait for
+        iterations whose progress the heads cannot resolve.
+        Also switches if the delta is already within bound.
+    */
+    struct PredictedIterationsPolicy
+    {
+        double bound;
+        double lookahead;
+        double predicted;   // last predicted number of iterations to reach bound
+
+        PredictedIterationsPolicy(const double& bound = AdaptivePrecisionBound, const double& lookahead = 1.0)
+            :bound(bound), lookahead(lookahead), predicted(INFINITY)
+        {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            if(delta <= bound) return SWITCH_BOUND;
+
+            predicted = iterationsToReach(bound, delta, delta / prevDelta);    // INFINITY while not (yet) converging
+            return (predicted <= lookahead) ? SWITCH_PREDICTED : SWITCH_NONE;
+        }
+
+        double remaining(const double& delta, const double& rate) const
+        {
+            return std::max(0.0, iterationsToReach(bound, delta, rate) - lookahead);
+        }
+    };
+
+    /*
+        For a residual rather than a delta, fed every iteration: switches once the residual is above
+        ratio times the residual window iterations earlier (SWITCH_STAGNATION), so a residual that
+        oscillates from one iteration to the next, as CG's does, is judged over the window rather
+        than step by step, or once it is at or below floor (SWITCH_FLOOR), the smallest residual the
+        heads can attain. The caller sets floor, and may raise it as the solution grows (e.g. u (||A|| ||x|| +
+        ||b||) for a solve at unit roundoff u); 0 disables it.
+    */
+    struct ResidualHistoryPolicy
+    {
+        int window;
+        double ratio;
+        double floor;
+        double change;      // residual / residual window iterations earlier, at the last check
+
+        ResidualHistoryPolicy(const int& window = 32, const double& ratio = 0.5, const double& floor = 0.0)
+            :window(window), ratio(ratio), floor(floor), change(0.0), history(window > 0 ? window : 1), seen(0)
+        {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            if(delta <= floor) return SWITCH_FLOOR;
+
+            double& oldest = history[seen % history.size()];
+            bool full = ++seen > history.size();
+            change = full ? delta / oldest : 0.0;
+            oldest = delta;
+            return (full && change > ratio) ? SWITCH_STAGNATION : SWITCH_NONE;
+        }
+
+        /* only the floor can be foreseen; 0 disables it, and with it the estimate */
+        double remaining(const double& delta, const double& rate) const
+        {
+            return floor > 0.0 ? iterationsToReach(floor, delta, rate) : INFINITY;
+        }
+
+    private:
+        std::vector<double> history;    // the last window residuals, a ring
+        size_t seen;
+    };
+
+    /*
+        Switches once the error the heads add to every iteration dominates what is left to converge.
+        truncation is that error, as an L1 norm, estimated by the solver (e.g. by redoing a sample of
+        the iteration in doubles) and set before each update. With the delta falling by r per
+        iteration, the iterations still to come would move the solution by about delta r / (1 - r),
+        and the heads keep it about truncation / (1 - r) from the fixed point, so the switch is at
+        delta r <= factor * truncation. Until there is an estimate (truncation < 0) it switches at bound.
+    */
+    struct ShadowErrorPolicy
+    {
+        double factor;
+        double bound;
+        double truncation;  // error added per iteration at the heads; < 0 while unknown
+
+        ShadowErrorPolicy(const double& factor = 1.0, const double& bound = AdaptivePrecisionBound)
+            :factor(factor), bound(bound), truncation(-1.0)
+        {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            if(truncation < 0.0)
+                return (delta <= bound) ? SWITCH_BOUND : SWITCH_NONE;
+            const double rate = std::min(1.0, delta / prevDelta);
+            return (delta * rate <= factor * truncation) ? SWITCH_TRUNCATION : SWITCH_NONE;
+        }
+
+        /* with the truncation staying as it is */
+        double remaining(const double& delta, const double& rate) const
+        {
+            if(truncation < 0.0)
+                return iterationsToReach(bound, delta, rate);
+            return (rate > 0.0) ? iterationsToReach(factor * truncation / rate, delta, rate) : 0.0;
+        }
+    };
+
+    /* switches when either policy would, reporting the reason of the first that does */
+    template<class First, class Second>
+    struct EitherPolicy
+    {
+        First first;
+        Second second;
+
+        EitherPolicy(const First& first = First(), const Second& second = Second()) :first(first), second(second) {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            SwitchReason reason = first.check(delta, prevDelta, iteration);
+            SwitchReason other = second.check(delta, prevDelta, iteration); // keep both policies' state current
+            return (reason != SWITCH_NONE) ? reason : other;
+        }
+
+        double remaining(const double& delta, const double& rate) const
+        {
+            return std::min(first.remaining(delta, rate), second.remaining(delta, rate));
+        }
+    };
+
+    /*
+        One of the policies above chosen at run time, so that switch settings can be swept without
+        rebuilding (see bench/sweep.sh). fromEnvironment starts from the driver's own policy and reads
+            MANSEG_SWITCH_POLICY    bound, stagnation, predicted, shadow (for drivers that estimate the
+                                    truncation, see ShadowErrorPolicy), or full to leave the heads after
+                                    the first iteration (the double precision reference of a sweep)
+            MANSEG_SWITCH_PARAM     the bound of bound and predicted, the threshold of stagnation, the
+                                    factor of shadow
+        keeping the driver's setting for whatever is unset.
+    */
+    struct ConfiguredPolicy
+    {
+        enum Kind { BOUND, STAGNATION, PREDICTED, FULL, SHADOW };
+
+        Kind kind;
+        AbsoluteBoundPolicy absolute;
+        StagnationPolicy stagnation;
+        PredictedIterationsPolicy predicted;
+        ShadowErrorPolicy shadow;
+
+        ConfiguredPolicy(const AbsoluteBoundPolicy& policy = AbsoluteBoundPolicy()) :kind(BOUND), absolute(policy) {}
+        ConfiguredPolicy(const StagnationPolicy& policy) :kind(STAGNATION), stagnation(policy) {}
+        ConfiguredPolicy(const PredictedIterationsPolicy& policy) :kind(PREDICTED), predicted(policy) {}
+        ConfiguredPolicy(const ShadowErrorPolicy& policy) :kind(SHADOW), shadow(policy) {}
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            switch(kind)
+            {
+            case STAGNATION: return stagnation.check(delta, prevDelta, iteration);
+            case PREDICTED: return predicted.check(delta, prevDelta, iteration);
+            case SHADOW: return shadow.check(delta, prevDelta, iteration);
+            case FULL: return SWITCH_FORCED;
+            default: return absolute.check(delta, prevDelta, iteration);
+            }
+        }
+
+        double remaining(const double& delta, const double& rate) const
+        {
+            switch(kind)
+            {
+            case STAGNATION: return stagnation.remaining(delta, rate);
+            case PREDICTED: return predicted.remaining(delta, rate);
+            case SHADOW: return shadow.remaining(delta, rate);
+            case FULL: return 0.0;
+            default: return absolute.remaining(delta, rate);
+            }
+        }
+
+        const char* name() const
+        {
+            static const char* names[] = { "bound", "stagnation", "predicted", "full", "shadow" };
+            return names[kind];
+        }
+
+        /* the bound or threshold of the chosen policy, NAN for full */
+        double parameter() const
+        {
+            switch(kind)
+            {
+            case STAGNATION: return stagnation.threshold;
+            case PREDICTED: return predicted.bound;
+            case SHADOW: return shadow.factor;
+            case FULL: return NAN;
+            default: return absolute.bound;
+            }
+        }
+
+        void setParameter(const double& p)
+        {
+            switch(kind)
+            {
+            case STAGNATION: stagnation.threshold = p; break;
+            case PREDICTED: predicted.bound = p; break;
+            case SHADOW: shadow.factor = p; break;
+            case FULL: break;
+            default: absolute.bound = p;
+            }
+        }
+
+        static ConfiguredPolicy fromEnvironment(const ConfiguredPolicy& fallback = ConfiguredPolicy())
+        {
+            ConfiguredPolicy policy = fallback;
+            const char* name = getenv("MANSEG_SWITCH_POLICY");
+            if(name != nullptr && *name != '\0')
+            {
+                if(strcmp(name, "bound") == 0) policy.kind = BOUND;
+                else if(strcmp(name, "stagnation") == 0) policy.kind = STAGNATION;
+                else if(strcmp(name, "predicted") == 0) policy.kind = PREDICTED;
+                else if(strcmp(name, "full") == 0) policy.kind = FULL;
+                else if(strcmp(name, "shadow") == 0) policy.kind = SHADOW;
+                else fprintf(stderr, "MANSEG_SWITCH_POLICY: unknown policy %s, keeping %s\n", name, policy.name());
+            }
+            const char* param = getenv("MANSEG_SWITCH_PARAM");
+            if(param != nullptr && *param != '\0')
+                policy.setParameter(atof(param));
+            return policy;
+        }
+    };
+
+    /*
+        Tracks the precision level of a solver.
+        Call update(delta) after every iteration; it returns the level to use for the next one.
+        From PRECISION_HEADS the policy is consulted, and once it gives a reason the controller
+        moves to PRECISION_INTERIM (or straight to PRECISION_FULL if useInterim is false).
+        A single interim iteration is followed by PRECISION_FULL.
+
+        initialDelta is the delta assumed before the first iteration (the drivers start from 2.0,
+        the largest L1 distance between two probability vectors).
+    */
+    template<class Policy = AbsoluteBoundPolicy>
+    class PrecisionController
+    {
+    public:
+        PrecisionController(const Policy& policy = Policy(), const bool& useInterim = true, const double& initialDelta = 2.0)
+            :switchPolicy(policy), interim(useInterim), current(PRECISION_HEADS), why(SWITCH_NONE),
+            iter(0), prevDelta(initialDelta), rate(1.0), deltaAtSwitch(initialDelta)
+        {
+            entered[PRECISION_HEADS] = 0;
+            entered[PRECISION_INTERIM] = entered[PRECISION_FULL] = -1;
+        }
+
+        PrecisionLevel update(const double& delta)
+        {
+            ++iter;
+            if(current == PRECISION_HEADS)
+            {
+                SwitchReason reason = switchPolicy.check(delta, prevDelta, iter);
+                if(reason != SWITCH_NONE)
+                {
+                    why = reason;
+                    deltaAtSwitch = delta;
+                    enter(interim ? PRECISION_INTERIM : PRECISION_FULL);
+                }
+            }
+            else if(current == PRECISION_INTERIM)
+                enter(PRECISION_FULL);
+            rate = delta / prevDelta;
+            prevDelta = delta;
+            return current;
+        }
+
+        /*
+            From PRECISION_INTERIM straight on to PRECISION_FULL, without an interim iteration, for a solver
+            whose last iteration at the heads already stored its values in full (see DualWriteView).
+        */
+        void skipInterim()
+        {
+            if(current == PRECISION_INTERIM)
+                enter(PRECISION_FULL);
+        }
+
+        PrecisionLevel level() const { return current; }
+        /* number of updates so far */
+        int iteration() const { return iter; }
+        /* number of iterations completed before level was entered, or -1 if it has not been */
+        int switchIteration(const PrecisionLevel& level = PRECISION_FULL) const { return entered[level]; }
+        /* why the heads were left, SWITCH_NONE while still at the heads */
+        SwitchReason reason() const { return why; }
+        const char* reasonName() const { return ManSeg::reasonName(why); }
+        /* delta of the iteration after which the heads were left */
+        double switchDelta() const { return deltaAtSwitch; }
+        /* the last delta over the one before it */
+        double convergenceRate() const { return rate; }
+
+        /*
+            Estimated number of further iterations at the heads before the policy switches, from the last
+            delta and the rate it fell at (INFINITY while it is not falling, 0 once the heads are left),
+            so that whatever the switch needs can be got ready before it (see TailWarmer).
+        */
+        double iterationsToSwitch() const
+        {
+            return current == PRECISION_HEADS ? switchPolicy.remaining(prevDelta, rate) : 0.0;
+        }
+
+        /*
+            Whether a delta known only to be within [lower, upper], such as a sampled estimate, is enough for
+            the next update: above tolerance (the solver's convergence test) at either end, and, at the heads,
+            with the policy deciding the same at both ends. Otherwise the delta should be computed exactly.
+        */
+        bool decides(const double& lower, const double& upper, const double& tolerance = 0.0) const
+        {
+            if(lower <= tolerance)
+                return false;
+            if(current != PRECISION_HEADS)
+                return true;
+            Policy atLower = switchPolicy, atUpper = switchPolicy;
+            return atLower.check(lower, prevDelta, iter + 1) == SWITCH_NONE
+                && atUpper.check(upper, prevDelta, iter + 1) == SWITCH_NONE;
+        }
+
+        Policy& policy() { return switchPolicy; }
+        const Policy& policy() const { return switchPolicy; }
+
+    private:
+        Policy switchPolicy;
+        bool interim;
+        PrecisionLevel current;
+        SwitchReason why;
+        int iter;
+        double prevDelta;
+        double rate;            // delta / the delta before it, at the last update
+        double deltaAtSwitch;
+        int entered[3];
+
+        void enter(const PrecisionLevel& level)
+        {
+            MANSEG_TRACE_INSTANT_ARG(level == PRECISION_INTERIM ? "switch to interim" : "switch to full", "iter", iter);
+            current = level;
+            entered[level] = iter;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,680 @@
+/*
+	Mantissa segmented arrays and their bulk kernels on a GPU (CUDA or HIP).
+	Author: harunadess
+
+	On a GPU the solvers here are bound by the bandwidth of its memory even more than on a CPU, so
+	reading 4 bytes of a value rather than 8 pays off the same way. A DeviceSegArray holds only the
+	heads plane on the device to begin with; the tails are copied over when the solver switches to
+	full precision, and combined with the heads into doubles there:
+		DeviceSegArray x(n);                    // n heads on the device
+		x.uploadHeads(a.getHeads());            // from a host TwoSegArray (or fill(x.heads(), n, v))
+		double s = sum(x.heads(), n);           // kernels take the device views of a level
+		x.uploadTails(a.getTails());            // at the switch: the tails too (optional)
+		x.promote();                            // heads (and tails) combined into doubles; planes freed
+		spmv(rows, offsets, cols, vals.full(), x.full(), y.full());
+		x.download(out);                        // the values as doubles, at whatever level x is
+	The views (DeviceHeads, DevicePairs, DeviceFull) are plain structs of device pointers, passed to the
+	kernels by value: read(i) gives a double, set(i, v) stores v truncated to the level, as the host
+	views do. Every kernel is a functor run by forEach (a grid-stride loop) or reduce (a sum or max per
+	block in shared memory, then one atomic per block), so thread i of a warp reads element i of 32
+	consecutive ones: the heads of a warp are one 128 byte load. spmv gives each row 32 lanes that
+	stride over its entries, so the column indices and values are read coalesced too.
+	The backend is picked by the compiler: nvcc (__CUDACC__) runs the kernels with the CUDA runtime,
+	hipcc (__HIPCC__) with HIP, and any other compiler runs them as loops on the host, in "device"
+	memory that is host memory, so the same code is built and tested on machines without a GPU.
+	Everything is on the default stream, and the kernels return once launched except reduce, whose
+	result is copied back. The largest value found by reduce<true> is taken on the bits of the doubles,
+	so it is only for non-negative values (changes, absolute values).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_DEVICE_H__
+#define __MANSEG_DEVICE_H__
+
+#if defined(__CUDACC__)
+#include <cuda_runtime.h>
+#define MANSEG_DEVICE_CUDA
+#elif defined(__HIPCC__)
+#include <hip/hip_runtime.h>
+#define MANSEG_DEVICE_HIP
+#else
+#define MANSEG_DEVICE_HOST
+#endif
+
+#if defined(MANSEG_DEVICE_HOST)
+#define MANSEG_HD
+#else
+#define MANSEG_HD __host__ __device__
+#endif
+
+// code compiled for the device, rather than its host side
+#if defined(__CUDA_ARCH__) || defined(__HIP_DEVICE_COMPILE__)
+#define MANSEG_DEVICE_CODE
+#endif
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+namespace device
+{
+    constexpr int BlockSize = 256;      // threads per block
+    constexpr int MaxBlocks = 4096;     // beyond this the threads stride over the elements
+    constexpr int RowLanes = 32;        // threads per row in spmv
+
+    /* throws if a call to the runtime failed, with what was called */
+#if defined(MANSEG_DEVICE_CUDA)
+    inline void check(const cudaError_t& e, const char* what)
+    {
+        if(e != cudaSuccess)
+            throw std::runtime_error(std::string(what) + ": " + cudaGetErrorString(e));
+    }
+#elif defined(MANSEG_DEVICE_HIP)
+    inline void check(const hipError_t& e, const char* what)
+    {
+        if(e != hipSuccess)
+            throw std::runtime_error(std::string(what) + ": " + hipGetErrorString(e));
+    }
+#endif
+
+    /* bytes of device memory; nullptr for 0 */
+    inline void* allocate(const size_t& bytes)
+    {
+        if(bytes == 0)
+            return nullptr;
+        void* p = nullptr;
+#if defined(MANSEG_DEVICE_CUDA)
+        check(cudaMalloc(&p, bytes), "cudaMalloc");
+#elif defined(MANSEG_DEVICE_HIP)
+        check(hipMalloc(&p, bytes), "hipMalloc");
+#else
+        p = malloc(bytes);
+        if(p == nullptr)
+            throw std::bad_alloc();
+#endif
+        return p;
+    }
+
+    inline void release(void* p)
+    {
+        if(p == nullptr)
+            return;
+#if defined(MANSEG_DEVICE_CUDA)
+        cudaFree(p);
+#elif defined(MANSEG_DEVICE_HIP)
+        hipFree(p);
+#else
+        free(p);
+#endif
+    }
+
+    /* copies between host and device memory; both wait for the kernels launched before them */
+    inline void copyToDevice(void* dst, const void* src, const size_t& bytes)
+    {
+        if(bytes == 0)
+            return;
+#if defined(MANSEG_DEVICE_CUDA)
+        check(cudaMemcpy(dst, src, bytes, cudaMemcpyHostToDevice), "cudaMemcpy to the device");
+#elif defined(MANSEG_DEVICE_HIP)
+        check(hipMemcpy(dst, src, bytes, hipMemcpyHostToDevice), "hipMemcpy to the device");
+#else
+        memcpy(dst, src, bytes);
+#endif
+    }
+
+    inline void copyToHost(void* dst, const void* src, const size_t& bytes)
+    {
+        if(bytes == 0)
+            return;
+#if defined(MANSEG_DEVICE_CUDA)
+        check(cudaMemcpy(dst, src, bytes, cudaMemcpyDeviceToHost), "cudaMemcpy to the host");
+#elif defined(MANSEG_DEVICE_HIP)
+        check(hipMemcpy(dst, src, bytes, hipMemcpyDeviceToHost), "hipMemcpy to the host");
+#else
+        memcpy(dst, src, bytes);
+#endif
+    }
+
+    /* waits for the kernels launched so far, e.g. before timing them */
+    inline void synchronize()
+    {
+#if defined(MANSEG_DEVICE_CUDA)
+        check(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+#elif defined(MANSEG_DEVICE_HIP)
+        check(hipDeviceSynchronize(), "hipDeviceSynchronize");
+#endif
+    }
+
+    /*
+        The element conversions of manseglib.hpp, for device code too: the device has instructions for
+        the halves of a double, so a head is never stored and reloaded to be widened.
+    */
+    MANSEG_HD inline double headToDouble(const float& head)
+    {
+#if defined(MANSEG_DEVICE_CODE)
+        return __hiloint2double(__float_as_int(head), 0);
+#else
+        return ManSeg::headToDouble(head);
+#endif
+    }
+
+    MANSEG_HD inline double segmentsToDouble(const float& head, const float& tail)
+    {
+#if defined(MANSEG_DEVICE_CODE)
+        return __hiloint2double(__float_as_int(head), __float_as_int(tail));
+#else
+        return ManSeg::segmentsToDouble(head, tail);
+#endif
+    }
+
+    MANSEG_HD inline float headOf(const double& d)
+    {
+#if defined(MANSEG_DEVICE_CODE)
+        return __int_as_float(__double2hiint(d));
+#else
+        return ManSeg::headOf(d);
+#endif
+    }
+
+    MANSEG_HD inline float tailOf(const double& d)
+    {
+#if defined(MANSEG_DEVICE_CODE)
+        return __int_as_float(__double2loint(d));
+#else
+        float head, tail;
+        ManSeg::splitSegment(d, &head, &tail);
+        return tail;
+#endif
+    }
+
+    /* the views of a level of a DeviceSegArray, for kernels */
+    struct DeviceHeads
+    {
+        float* heads;
+        MANSEG_HD double read(const uint_fast64_t& i) const { return headToDouble(heads[i]); }
+        MANSEG_HD void set(const uint_fast64_t& i, const double& v) const { heads[i] = headOf(v); }
+    };
+
+    struct DevicePairs
+    {
+        float* heads;
+        float* tails;
+        MANSEG_HD double read(const uint_fast64_t& i) const { return segmentsToDouble(heads[i], tails[i]); }
+        MANSEG_HD void set(const uint_fast64_t& i, const double& v) const
+        {
+            heads[i] = headOf(v);
+            tails[i] = tailOf(v);
+        }
+    };
+
+    struct DeviceFull
+    {
+        double* values;
+        MANSEG_HD double read(const uint_fast64_t& i) const { return values[i]; }
+        MANSEG_HD void set(const uint_fast64_t& i, const double& v) const { values[i] = v; }
+    };
+
+    /* the values of a matrix whose entries are all 1, for spmv over a pattern (e.g. a graph) */
+    struct UnitValues
+    {
+        MANSEG_HD double read(const uint_fast64_t&) const { return 1.0; }
+    };
+
+#if !defined(MANSEG_DEVICE_HOST)
+    namespace detail
+    {
+        inline unsigned blocks(const uint_fast64_t& threads)
+        {
+            const uint_fast64_t b = (threads + BlockSize - 1) / BlockSize;
+            return static_cast<unsigned>(b < 1 ? 1 : b > MaxBlocks ? MaxBlocks : b);
+        }
+
+        template<class F>
+        __global__ void forEachKernel(const uint_fast64_t n, F f)
+        {
+            const uint_fast64_t stride = static_cast<uint_fast64_t>(blockDim.x) * gridDim.x;
+            for(uint_fast64_t i = static_cast<uint_fast64_t>(blockIdx.x) * blockDim.x + threadIdx.x; i < n; i += stride)
+                f(i);
+        }
+
+        template<bool isMax, class F>
+        __global__ void reduceKernel(const uint_fast64_t n, F f, double* result)
+        {
+            __shared__ double partial[BlockSize];
+            double acc = 0.0;
+            const uint_fast64_t stride = static_cast<uint_fast64_t>(blockDim.x) * gridDim.x;
+            for(uint_fast64_t i = static_cast<uint_fast64_t>(blockIdx.x) * blockDim.x + threadIdx.x; i < n; i += stride)
+                acc = isMax ? fmax(acc, f(i)) : acc + f(i);
+            partial[threadIdx.x] = acc;
+            __syncthreads();
+            for(int w = BlockSize / 2; w > 0; w >>= 1)
+            {
+                if(threadIdx.x < w)
+                    partial[threadIdx.x] = isMax ? fmax(partial[threadIdx.x], partial[threadIdx.x + w])
+                        : partial[threadIdx.x] + partial[threadIdx.x + w];
+                __syncthreads();
+            }
+            if(threadIdx.x == 0)
+            {
+                // non-negative doubles are ordered as their bits are
+                if(isMax)
+                    atomicMax(reinterpret_cast<unsigned long long*>(result), static_cast<unsigned long long>(__double_as_longlong(partial[0])));
+                else
+                    atomicAdd(result, partial[0]);
+            }
+        }
+
+        // RowLanes threads per row, each summing every RowLanes'th entry, then summed in shared memory
+        template<class Offset, class Index, class Values, class In, class Out>
+        __global__ void spmvKernel(const uint_fast64_t rows, const Offset* offsets, const Index* cols, Values vals, In x, Out y,
+            const double alpha, const double beta)
+        {
+            __shared__ double partial[BlockSize];
+            const unsigned lane = threadIdx.x % RowLanes;
+            const uint_fast64_t rowsPerBlock = BlockSize / RowLanes;
+            // the loop is the same for every thread of a block, so all of them reach the barriers
+            for(uint_fast64_t first = blockIdx.x * rowsPerBlock; first < rows; first += gridDim.x * rowsPerBlock)
+            {
+                const uint_fast64_t r = first + threadIdx.x / RowLanes;
+                double acc = 0.0;
+                if(r < rows)
+                    for(Offset k = offsets[r] + lane; k < offsets[r + 1]; k += RowLanes)
+                        acc += vals.read(k) * x.read(cols[k]);
+                partial[threadIdx.x] = acc;
+                __syncthreads();
+                for(unsigned w = RowLanes / 2; w > 0; w >>= 1)
+                {
+                    if(lane < w)
+                        partial[threadIdx.x] += partial[threadIdx.x + w];
+                    __syncthreads();
+                }
+                if(lane == 0 && r < rows)
+                    y.set(r, alpha * partial[threadIdx.x] + beta);
+                __syncthreads();
+            }
+        }
+    }
+#endif
+
+    /* f(i) for every i in [0, n); f is a functor whose operator() is MANSEG_HD and const */
+    template<class F>
+    void forEach(const uint_fast64_t& n, const F& f)
+    {
+        if(n == 0)
+            return;
+#if defined(MANSEG_DEVICE_CUDA)
+        detail::forEachKernel<<<detail::blocks(n), BlockSize>>>(n, f);
+        check(cudaGetLastError(), "forEach");
+#elif defined(MANSEG_DEVICE_HIP)
+        hipLaunchKernelGGL(detail::forEachKernel<F>, dim3(detail::blocks(n)), dim3(BlockSize), 0, 0, n, f);
+        check(hipGetLastError(), "forEach");
+#else
+        for(uint_fast64_t i = 0; i < n; ++i)
+            f(i);
+#endif
+    }
+
+    /* the sum (or, with isMax, the largest) of f(i) over [0, n), on the host when it returns */
+    template<bool isMax, class F>
+    double reduce(const uint_fast64_t& n, const F& f)
+    {
+#if defined(MANSEG_DEVICE_HOST)
+        double acc = 0.0;
+        for(uint_fast64_t i = 0; i < n; ++i)
+            acc = isMax ? fmax(acc, f(i)) : acc + f(i);
+        return acc;
+#else
+        // one double the blocks reduce into, kept for the whole run
+        static double* result = static_cast<double*>(allocate(sizeof(double)));
+        const double zero = 0.0;
+        copyToDevice(result, &zero, sizeof(double));
+        if(n > 0)
+        {
+#if defined(MANSEG_DEVICE_CUDA)
+            detail::reduceKernel<isMax><<<detail::blocks(n), BlockSize>>>(n, f, result);
+            check(cudaGetLastError(), "reduce");
+#else
+            hipLaunchKernelGGL((detail::reduceKernel<isMax, F>), dim3(detail::blocks(n)), dim3(BlockSize), 0, 0, n, f, result);
+            check(hipGetLastError(), "reduce");
+#endif
+        }
+        double acc;
+        copyToHost(&acc, result, sizeof(double));
+        return acc;
+#endif
+    }
+
+    // the functors of the kernels below
+    template<class View>
+    struct FillOp
+    {
+        View x;
+        double v;
+        MANSEG_HD void operator()(const uint_fast64_t& i) const { x.set(i, v); }
+    };
+
+    template<class In, class Out>
+    struct CopyOp
+    {
+        In in;
+        Out out;
+        MANSEG_HD void operator()(const uint_fast64_t& i) const { out.set(i, in.read(i)); }
+    };
+
+    template<class View>
+    struct ReadOp
+    {
+        View x;
+        MANSEG_HD double operator()(const uint_fast64_t& i) const { return x.read(i); }
+    };
+
+    template<class X, class Y>
+    struct DotOp
+    {
+        X x;
+        Y y;
+        MANSEG_HD double operator()(const uint_fast64_t& i) const { return x.read(i) * y.read(i); }
+    };
+
+    template<class X, class Y>
+    struct AbsDiffOp
+    {
+        X x;
+        Y y;
+        MANSEG_HD double operator()(const uint_fast64_t& i) const { return fabs(x.read(i) - y.read(i)); }
+    };
+
+    template<class X, class Y>
+    struct AxpyOp
+    {
+        double a;
+        X x;
+        Y y;
+        MANSEG_HD void operator()(const uint_fast64_t& i) const { y.set(i, y.read(i) + a * x.read(i)); }
+    };
+
+    template<class X, class Y>
+    struct XpayOp
+    {
+        X x;
+        double b;
+        Y y;
+        MANSEG_HD void operator()(const uint_fast64_t& i) const { y.set(i, x.read(i) + b * y.read(i)); }
+    };
+
+    template<class In, class Index, class Out>
+    struct GatherOp
+    {
+        In in;
+        const Index* idx;
+        Out out;
+        MANSEG_HD void operator()(const uint_fast64_t& i) const { out.set(i, in.read(idx[i])); }
+    };
+
+    template<class In, class Out>
+    struct Stencil5Op
+    {
+        In in;
+        Out out;
+        uint_fast64_t B;
+        double weight;
+        // stores the new value of point k and returns its change; the sum is in the order of stencilRow
+        MANSEG_HD double operator()(const uint_fast64_t& k) const
+        {
+            const uint_fast64_t i = k / B, j = k % B;
+            const double centre = in.read(k);
+            double sum = centre + (j > 0 ? in.read(k - 1) : 0.0);
+            sum += i > 0 ? in.read(k - B) : 0.0;
+            sum += j + 1 < B ? in.read(k + 1) : 0.0;
+            sum += i + 1 < B ? in.read(k + B) : 0.0;
+            const double next = weight * sum;
+            out.set(k, next);
+            return fabs(next - centre);
+        }
+    };
+
+    /* x[i] = v for i in [0, n) */
+    template<class View>
+    void fill(View x, const uint_fast64_t& n, const double& v) { forEach(n, FillOp<View>{ x, v }); }
+
+    /* out[i] = in[i]: a change of level when they are views of different levels */
+    template<class In, class Out>
+    void copyValues(In in, Out out, const uint_fast64_t& n) { forEach(n, CopyOp<In, Out>{ in, out }); }
+
+    template<class View>
+    double sum(View x, const uint_fast64_t& n) { return reduce<false>(n, ReadOp<View>{ x }); }
+
+    template<class X, class Y>
+    double dot(X x, Y y, const uint_fast64_t& n) { return reduce<false>(n, DotOp<X, Y>{ x, y }); }
+
+    /* the sum of |x[i] - y[i]|, e.g. the change of an iteration */
+    template<class X, class Y>
+    double absDiffSum(X x, Y y, const uint_fast64_t& n) { return reduce<false>(n, AbsDiffOp<X, Y>{ x, y }); }
+
+    /* y = y + a*x */
+    template<class X, class Y>
+    void axpy(const double& a, X x, Y y, const uint_fast64_t& n) { forEach(n, AxpyOp<X, Y>{ a, x, y }); }
+
+    /* y = x + b*y */
+    template<class X, class Y>
+    void xpay(X x, const double& b, Y y, const uint_fast64_t& n) { forEach(n, XpayOp<X, Y>{ x, b, y }); }
+
+    /* out[i] = in[idx[i]] for i in [0, n); idx is in device memory */
+    template<class In, class Index, class Out>
+    void gather(In in, const Index* idx, Out out, const uint_fast64_t& n) { forEach(n, GatherOp<In, Index, Out>{ in, idx, out }); }
+
+    /*
+        One Jacobi sweep of the 5 point stencil of manseglib_stencil.hpp over a B x B block with a zero
+        boundary: out = weight * (the point and its 4 neighbours). out must not be in. Returns the largest
+        change of a point.
+    */
+    template<class In, class Out>
+    double stencil5(In in, Out out, const uint_fast64_t& B, const double& weight = 0.2)
+    {
+        return reduce<true>(B * B, Stencil5Op<In, Out>{ in, out, B, weight });
+    }
+
+    /*
+        y[r] = alpha * (the sum of vals[k] * x[cols[k]] over row r's entries k) + beta, for a CSR matrix of
+        rows rows; offsets (rows + 1 of them) and cols are in device memory.
+    */
+    template<class Offset, class Index, class Values, class In, class Out>
+    void spmv(const uint_fast64_t& rows, const Offset* offsets, const Index* cols, Values vals, In x, Out y,
+        const double& alpha = 1.0, const double& beta = 0.0)
+    {
+        if(rows == 0)
+            return;
+#if defined(MANSEG_DEVICE_HOST)
+        for(uint_fast64_t r = 0; r < rows; ++r)
+        {
+            double acc = 0.0;
+            for(Offset k = offsets[r]; k < offsets[r + 1]; ++k)
+                acc += vals.read(k) * x.read(cols[k]);
+            y.set(r, alpha * acc + beta);
+        }
+#else
+        const unsigned blocks = detail::blocks(rows * RowLanes);
+#if defined(MANSEG_DEVICE_CUDA)
+        detail::spmvKernel<<<blocks, BlockSize>>>(rows, offsets, cols, vals, x, y, alpha, beta);
+        check(cudaGetLastError(), "spmv");
+#else
+        hipLaunchKernelGGL((detail::spmvKernel<Offset, Index, Values, In, Out>), dim3(blocks), dim3(BlockSize), 0, 0,
+            rows, offsets, cols, vals, x, y, alpha, beta);
+        check(hipGetLastError(), "spmv");
+#endif
+#endif
+    }
+
+    /* n values of T in device memory, e.g. the indices of a matrix, freed with the buffer */
+    template<class T>
+    class DeviceBuffer
+    {
+    public:
+        explicit DeviceBuffer(const uint_fast64_t& n) :length(n), values(static_cast<T*>(allocate(n * sizeof(T)))) {}
+
+        DeviceBuffer(const T* host, const uint_fast64_t& n) :DeviceBuffer(n) { copyToDevice(values, host, n * sizeof(T)); }
+
+        DeviceBuffer(const std::vector<T>& host) :DeviceBuffer(host.data(), host.size()) {}
+
+        ~DeviceBuffer() { release(values); }
+
+        DeviceBuffer(const DeviceBuffer&) = delete;
+        DeviceBuffer& operator=(const DeviceBuffer&) = delete;
+
+        T* data() const { return values; }
+        uint_fast64_t size() const { return length; }
+        void download(T* host) const { copyToHost(host, values, length * sizeof(T)); }
+
+    private:
+        uint_fast64_t length;
+        T* values;
+    };
+
+    /*
+        A mantissa segmented array in device memory. It starts at ACCESS_HEADS with only its heads plane
+        allocated (uninitialised); uploadTails takes it to ACCESS_PAIRS, and promote to ACCESS_FULL, which
+        frees the planes once they are combined. It never goes back down: a solver that finishes at full
+        precision has no use for its heads again.
+    */
+    class DeviceSegArray
+    {
+    public:
+        explicit DeviceSegArray(const uint_fast64_t& n)
+            :length(n), headsPlane(static_cast<float*>(allocate(n * sizeof(float)))), tailsPlane(nullptr), values(nullptr)
+        {}
+
+        ~DeviceSegArray() { del(); }
+
+        DeviceSegArray(const DeviceSegArray&) = delete;
+        DeviceSegArray& operator=(const DeviceSegArray&) = delete;
+
+        uint_fast64_t size() const { return length; }
+
+        AccessLevel level() const { return values ? ACCESS_FULL : tailsPlane ? ACCESS_PAIRS : ACCESS_HEADS; }
+
+        /* the bytes of device memory the array holds */
+        size_t deviceBytes() const
+        {
+            return values ? length * sizeof(double) : (tailsPlane ? 2 : 1) * length * sizeof(float);
+        }
+
+        /* the n heads of a host plane, e.g. a.getHeads() of a TwoSegArray */
+        void uploadHeads(const float* heads)
+        {
+            if(values)
+                throw std::logic_error("DeviceSegArray::uploadHeads: the array is already at full precision");
+            copyToDevice(headsPlane, heads, length * sizeof(float));
+        }
+
+        /* the n tails of a host plane, to go with the heads; allocates the tails plane the first time */
+        void uploadTails(const float* tails)
+        {
+            if(values)
+                throw std::logic_error("DeviceSegArray::uploadTails: the array is already at full precision");
+            if(tailsPlane == nullptr)
+                tailsPlane = static_cast<float*>(allocate(length * sizeof(float)));
+            copyToDevice(tailsPlane, tails, length * sizeof(float));
+        }
+
+        /*
+            Combines the heads, and the tails if they were uploaded, into doubles on the device and frees the
+            planes. Without tails the values are the heads widened, as a host array promoted from the heads.
+        */
+        void promote()
+        {
+            if(values)
+                return;
+            values = static_cast<double*>(allocate(length * sizeof(double)));
+            if(tailsPlane)
+                copyValues(pairs(), full(), length);
+            else
+                copyValues(heads(), full(), length);
+            synchronize();
+            release(headsPlane);
+            release(tailsPlane);
+            headsPlane = tailsPlane = nullptr;
+        }
+
+        DeviceHeads heads() const
+        {
+            if(headsPlane == nullptr && length > 0)
+                throw std::logic_error("DeviceSegArray::heads: the array is at full precision");
+            return DeviceHeads{ headsPlane };
+        }
+
+        DevicePairs pairs() const
+        {
+            if(tailsPlane == nullptr && length > 0)
+                throw std::logic_error("DeviceSegArray::pairs: the tails are not on the device");
+            return DevicePairs{ headsPlane, tailsPlane };
+        }
+
+        DeviceFull full() const
+        {
+            if(values == nullptr && length > 0)
+                throw std::logic_error("DeviceSegArray::full: the array is not promoted");
+            return DeviceFull{ values };
+        }
+
+        /* the values as doubles into host memory, at the current level */
+        void download(double* out) const
+        {
+            if(values)
+            {
+                copyToHost(out, values, length * sizeof(double));
+                return;
+            }
+            std::vector<float> h(length), t(tailsPlane ? length : 0);
+            copyToHost(h.data(), headsPlane, length * sizeof(float));
+            copyToHost(t.data(), tailsPlane, t.size() * sizeof(float));
+            for(uint_fast64_t i = 0; i < length; ++i)
+                out[i] = tailsPlane ? ManSeg::segmentsToDouble(h[i], t[i]) : ManSeg::headToDouble(h[i]);
+        }
+
+        void del()
+        {
+            release(headsPlane);
+            release(tailsPlane);
+            release(values);
+            headsPlane = tailsPlane = nullptr;
+            values = nullptr;
+        }
+
+    private:
+        uint_fast64_t length;
+        float* headsPlane;
+        float* tailsPlane;
+        double* values;
+    };
+}
+}
+
+#endif // __MANSEG_DEVICE_H__
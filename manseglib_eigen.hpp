@@ -0,0 +1,257 @@
+/*
+	Eigen expressions over mantissa segmented vectors and matrices.
+	Author: harunadess
+
+	asEigen gives the heads or pairs of a TwoSegArray (or a TwoSegSpan) as a read only Eigen column
+	vector expression, which reads the segments in place: Eigen vectorises it, widening (or combining)
+	a packet of segments into a packet of doubles as the bulk kernels do. It can be used anywhere an
+	Eigen vector expression can, with no copy of the values into doubles:
+		Eigen::VectorXd r = b - A * asEigen(x.pairs);
+		double d = asEigen(x.heads).dot(asEigen(y.pairs));
+	assign(view, expression) evaluates an Eigen vector expression into a view, a block at a time:
+		assign(x.pairs, asEigen(x.pairs) + alpha * p);
+	SegmentedMatrix<View> is a dense row major matrix kept in a view, as a matrix free operator (see
+	Eigen's "Matrix-free solvers" page), so Eigen's iterative solvers can run on a matrix stored in
+	segments; its products use blas::gemv (manseglib_blas.hpp):
+		SegmentedMatrix<HeadsArray> A(m.heads, n, n);    // m: a ManSegArray of n * n values
+		Eigen::ConjugateGradient<SegmentedMatrix<HeadsArray>, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> cg(A);
+		Eigen::VectorXd x = cg.solve(b);
+	Needs Eigen 3.3 or later on the include path (e.g. -I/usr/include/eigen3).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_EIGEN_H__
+#define __MANSEG_EIGEN_H__
+
+#include <stdint.h>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+#include "manseglib.hpp"
+#include "manseglib_blas.hpp"
+
+namespace ManSeg
+{
+    /*
+        Coefficients of a heads (useTail = false) or pairs vector, as an Eigen nullary functor.
+        packetOp builds a packet of doubles from the segments with unpacks: a double is its head in
+        the upper 32 bits and its tail (or zero) in the lower. There is only the one index form, which
+        tells Eigen the expression has linear access.
+    */
+    template<bool useTail>
+    struct SegmentCoeffs
+    {
+        const float* heads;
+        const float* tails;
+
+        SegmentCoeffs(const float* heads = nullptr, const float* tails = nullptr) :heads(heads), tails(tails) {}
+
+        double operator()(const Eigen::Index& i) const
+        {
+            return useTail ? segmentsToDouble(heads[i], tails[i]) : headToDouble(heads[i]);
+        }
+
+        template<typename Packet>
+        Packet packetOp(const Eigen::Index& i) const { return loadPacket(i, static_cast<Packet*>(nullptr)); }
+
+    private:
+        template<typename Packet>
+        Packet loadPacket(const Eigen::Index& i, Packet*) const
+        {
+            EIGEN_ALIGN_MAX double lanes[Eigen::internal::unpacket_traits<Packet>::size];
+            for(int k = 0; k < Eigen::internal::unpacket_traits<Packet>::size; ++k)
+                lanes[k] = (*this)(i + k);
+            return Eigen::internal::pload<Packet>(lanes);
+        }
+
+#if defined(EIGEN_VECTORIZE_SSE2)
+        __m128 tailsAt(const Eigen::Index&, std::false_type) const { return _mm_setzero_ps(); }
+        __m128 tailsAt(const Eigen::Index& i, std::true_type) const { return _mm_loadu_ps(tails + i); }
+
+        Eigen::internal::Packet2d loadPacket(const Eigen::Index& i, Eigen::internal::Packet2d*) const
+        {
+            const __m128 h = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(heads + i)));
+            const __m128 t = useTail ? _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(tails + i))) : _mm_setzero_ps();
+            return _mm_castps_pd(_mm_unpacklo_ps(t, h));
+        }
+#endif
+#if defined(EIGEN_VECTORIZE_AVX)
+        Eigen::internal::Packet4d loadPacket(const Eigen::Index& i, Eigen::internal::Packet4d*) const
+        {
+            const __m128 h = _mm_loadu_ps(heads + i);
+            const __m128 t = tailsAt(i, std::integral_constant<bool, useTail>());
+            const __m128d lo = _mm_castps_pd(_mm_unpacklo_ps(t, h));
+            const __m128d hi = _mm_castps_pd(_mm_unpackhi_ps(t, h));
+            return _mm256_insertf128_pd(_mm256_castpd128_pd256(lo), hi, 1);
+        }
+#endif
+#if defined(EIGEN_VECTORIZE_AVX512)
+        __m256 tailsAt8(const Eigen::Index&, std::false_type) const { return _mm256_setzero_ps(); }
+        __m256 tailsAt8(const Eigen::Index& i, std::true_type) const { return _mm256_loadu_ps(tails + i); }
+
+        Eigen::internal::Packet8d loadPacket(const Eigen::Index& i, Eigen::internal::Packet8d*) const
+        {
+            const __m256 h = _mm256_loadu_ps(heads + i);
+            const __m256 t = tailsAt8(i, std::integral_constant<bool, useTail>());
+            // unpacks work within 128 bit lanes: [0 1 | 4 5] and [2 3 | 6 7]
+            const __m256d lo = _mm256_castps_pd(_mm256_unpacklo_ps(t, h));
+            const __m256d hi = _mm256_castps_pd(_mm256_unpackhi_ps(t, h));
+            const __m256d first = _mm256_permute2f128_pd(lo, hi, 0x20);
+            const __m256d second = _mm256_permute2f128_pd(lo, hi, 0x31);
+            return _mm512_insertf64x4(_mm512_castpd256_pd512(first), second, 1);
+        }
+#endif
+    };
+}
+
+namespace Eigen
+{
+namespace internal
+{
+    template<bool useTail>
+    struct functor_traits<ManSeg::SegmentCoeffs<useTail> >
+    {
+        enum { Cost = 1, PacketAccess = true, IsRepeatable = true };
+    };
+}
+}
+
+namespace ManSeg
+{
+    template<bool useTail>
+    using SegmentVector = Eigen::CwiseNullaryOp<SegmentCoeffs<useTail>, const Eigen::VectorXd>;
+
+    /* the heads or pairs of an array or span, as a read only Eigen column vector of size() doubles */
+    template<class Allocator>
+    inline SegmentVector<false> asEigen(const TwoSegArray<false, Allocator>& a)
+    {
+        return SegmentVector<false>(a.size(), 1, SegmentCoeffs<false>(a.getHeads(), a.getTails()));
+    }
+
+    template<class Allocator>
+    inline SegmentVector<true> asEigen(const TwoSegArray<true, Allocator>& a)
+    {
+        return SegmentVector<true>(a.size(), 1, SegmentCoeffs<true>(a.getHeads(), a.getTails()));
+    }
+
+    inline SegmentVector<false> asEigen(const HeadsSpan& a)
+    {
+        return SegmentVector<false>(a.size(), 1, SegmentCoeffs<false>(a.getHeads(), a.getTails()));
+    }
+
+    inline SegmentVector<true> asEigen(const PairsSpan& a)
+    {
+        return SegmentVector<true>(a.size(), 1, SegmentCoeffs<true>(a.getHeads(), a.getTails()));
+    }
+
+    /*
+        view[i] = expression[i] for every coefficient of an Eigen vector expression, a block at a time
+        through writeBlock. The expression is evaluated once (products into a temporary, as Eigen
+        does), and may read the view it is assigned to, element i only being read for element i.
+    */
+    template<class View, class Derived>
+    inline void assign(View&& view, const Eigen::MatrixBase<Derived>& expression)
+    {
+        typedef Eigen::internal::evaluator<Derived> Evaluator;
+        Evaluator values(expression.derived());
+        const uint_fast64_t n = expression.size();
+        double block[blas::Block];
+        for(uint_fast64_t i = 0; i < n; i += blas::Block)
+        {
+            const uint_fast64_t m = std::min(blas::Block, n - i);
+            for(uint_fast64_t k = 0; k < m; ++k)
+                block[k] = values.coeff(static_cast<Eigen::Index>(i + k));
+            view.writeBlock(i, m, block);
+        }
+    }
+
+    /*
+        A rows x cols matrix stored row major in a view (A[i * cols + j]), for Eigen's iterative solvers
+        and products with Eigen vectors. It keeps a copy of the view, not of the values.
+    */
+    template<class View>
+    class SegmentedMatrix : public Eigen::EigenBase<SegmentedMatrix<View> >
+    {
+    public:
+        typedef double Scalar;
+        typedef double RealScalar;
+        typedef int StorageIndex;
+        enum
+        {
+            ColsAtCompileTime = Eigen::Dynamic,
+            MaxColsAtCompileTime = Eigen::Dynamic,
+            IsRowMajor = false
+        };
+
+        SegmentedMatrix(const View& values, const uint_fast64_t& rows, const uint_fast64_t& cols)
+            :values(values), numRows(rows), numCols(cols)
+        {}
+
+        Eigen::Index rows() const { return static_cast<Eigen::Index>(numRows); }
+        Eigen::Index cols() const { return static_cast<Eigen::Index>(numCols); }
+
+        template<typename Rhs>
+        Eigen::Product<SegmentedMatrix, Rhs, Eigen::AliasFreeProduct> operator*(const Eigen::MatrixBase<Rhs>& x) const
+        {
+            return Eigen::Product<SegmentedMatrix, Rhs, Eigen::AliasFreeProduct>(*this, x.derived());
+        }
+
+        const View& view() const { return values; }
+
+    private:
+        View values;
+        uint_fast64_t numRows, numCols;
+    };
+}
+
+namespace Eigen
+{
+namespace internal
+{
+    // the solvers read the traits of a sparse matrix, as in Eigen's matrix free example
+    template<class View>
+    struct traits<ManSeg::SegmentedMatrix<View> > : public traits<SparseMatrix<double> >
+    {};
+
+    template<class View, typename Rhs>
+    struct generic_product_impl<ManSeg::SegmentedMatrix<View>, Rhs, SparseShape, DenseShape, GemvProduct>
+        : generic_product_impl_base<ManSeg::SegmentedMatrix<View>, Rhs, generic_product_impl<ManSeg::SegmentedMatrix<View>, Rhs> >
+    {
+        typedef typename Product<ManSeg::SegmentedMatrix<View>, Rhs>::Scalar Scalar;
+
+        /* dst += alpha * A * rhs */
+        template<typename Dest>
+        static void scaleAndAddTo(Dest& dst, const ManSeg::SegmentedMatrix<View>& lhs, const Rhs& rhs, const Scalar& alpha)
+        {
+            const VectorXd x = rhs;
+            VectorXd y = dst;
+            ManSeg::blas::gemv(lhs.rows(), lhs.cols(), alpha, lhs.view(), ManSeg::FullView(const_cast<double*>(x.data()), x.size()),
+                1.0, ManSeg::FullView(y.data(), y.size()));
+            dst = y;
+        }
+    };
+}
+}
+
+#endif
@@ -0,0 +1,331 @@
+/*
+	Energy measurement for the precision levels of the benchmark drivers.
+	Author: harunadess
+
+	Reads the RAPL energy counters the Linux powercap driver exposes (intel_rapl, which also drives
+	AMD's RAPL on Zen and later) around each iteration, and adds the joules up by precision level, so
+	that the energy of a run at the heads can be set against that of the pairs or the full doubles:
+		EnergyPhases energy;                        // reads $MANSEG_RAPL, or /sys/class/powercap
+		energy.start();
+		... an iteration at level ...
+		Energy it = energy.lap(levelName(level));   // since the last lap, added to the level's total
+		results.iteration(iter, delta, seconds, levelName(level), bytes);
+		results.energy(it.package, it.dram);
+		...
+		energy.report(results);                     // energy_<level>_* and energy_* run settings
+	The package zones (intel-rapl:N, named package-N) are added up over the sockets, and so are their
+	dram subzones where the platform has them (most servers; few desktops, and no AMD part so far).
+	Core, uncore and psys zones are not read: core and uncore are within the package, and psys
+	overlaps it. The counters wrap at max_energy_range_uj, which a single read apart is never more
+	than once, so laps are exact however long the run.
+	RAPL updates about every millisecond, so the energy of an iteration much shorter than that is
+	noise; the totals of a level are good whatever its iterations take. Each lap reads a file per zone
+	(some microseconds), so lap whole iterations, not the loops within them.
+	Where there are no zones, or their counters cannot be read (since Linux 5.10 energy_uj is
+	readable by root alone, unless the administrator has changed its mode), available() is false,
+	laps are NaN and report records nothing, so the drivers can measure unconditionally. $MANSEG_RAPL
+	points the meter at another tree laid out as /sys/class/powercap, e.g. for testing.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_ENERGY_H__
+#define __MANSEG_ENERGY_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#endif
+
+#include "manseglib_results.hpp"
+
+namespace ManSeg
+{
+    /* joules used by the packages (cores, caches, memory controllers) and by the DRAM */
+    struct Energy
+    {
+        double package;
+        double dram;
+
+        Energy() :package(0.0), dram(0.0) {}
+        Energy(const double& package, const double& dram) :package(package), dram(dram) {}
+
+        double total() const { return package + dram; }
+
+        Energy operator-(const Energy& other) const { return Energy(package - other.package, dram - other.dram); }
+        Energy& operator+=(const Energy& other) { package += other.package; dram += other.dram; return *this; }
+    };
+
+    /*
+        The RAPL zones of the machine, read as joules used since the meter was made. Without DRAM
+        zones dram stays 0; without any zones both are NaN.
+    */
+    class EnergyMeter
+    {
+    public:
+        explicit EnergyMeter(const char* root = getenv("MANSEG_RAPL"))
+        {
+            discover(root != nullptr && root[0] != '\0' ? root : "/sys/class/powercap");
+        }
+
+        bool available() const { return packages > 0; }
+        bool hasDram() const { return zones.size() > packages; }
+        int sockets() const { return (int)packages; }
+
+        /* energy used since the meter was made; call it at least once per counter wrap (minutes) */
+        Energy read()
+        {
+            if(!available())
+                return Energy(NAN, NAN);
+            Energy e;
+            for(size_t z = 0; z < zones.size(); ++z)
+            {
+                Zone& zone = zones[z];
+                uint64_t now;
+                if(readCounter(zone.path + "/energy_uj", now))
+                {
+                    // a counter below its last reading has wrapped, once
+                    zone.microjoules += now >= zone.last ? now - zone.last : now + (zone.range - zone.last);
+                    zone.last = now;
+                }
+                (zone.dram ? e.dram : e.package) += zone.microjoules * 1e-6;
+            }
+            return e;
+        }
+
+    private:
+        struct Zone
+        {
+            std::string path;
+            bool dram;
+            uint64_t range;         // max_energy_range_uj: where the counter wraps
+            uint64_t last;          // the counter when last read
+            double microjoules;     // used since the meter was made
+        };
+
+        std::vector<Zone> zones;
+        size_t packages = 0;
+
+        static bool readCounter(const std::string& path, uint64_t& value)
+        {
+            FILE* f = fopen(path.c_str(), "r");
+            if(f == nullptr)
+                return false;
+            unsigned long long v;
+            bool ok = fscanf(f, "%llu", &v) == 1;
+            fclose(f);
+            if(ok)
+                value = v;
+            return ok;
+        }
+
+        static std::string readName(const std::string& path)
+        {
+            char name[64] = "";
+            FILE* f = fopen((path + "/name").c_str(), "r");
+            if(f == nullptr)
+                return "";
+            if(fgets(name, sizeof(name), f) == nullptr)
+                name[0] = '\0';
+            fclose(f);
+            name[strcspn(name, "\n")] = '\0';
+            return name;
+        }
+
+        /* a zone whose counter and range can both be read, starting from its counter now */
+        bool addZone(const std::string& path, const bool& dram)
+        {
+            Zone zone = { path, dram, 0, 0, 0.0 };
+            if(!readCounter(path + "/max_energy_range_uj", zone.range) || !readCounter(path + "/energy_uj", zone.last))
+                return false;
+            zones.push_back(zone);
+            return true;
+        }
+
+        /* the packages at the top level (intel-rapl:N), and the dram subzones (intel-rapl:N:M) within them */
+        void discover(const std::string& root)
+        {
+#if defined(__linux__)
+            DIR* dir = opendir(root.c_str());
+            if(dir == nullptr)
+                return;
+            std::vector<std::string> tops;
+            for(struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+            {
+                const char* name = entry->d_name;
+                if(strncmp(name, "intel-rapl:", 11) == 0 && strchr(name + 11, ':') == nullptr)
+                    tops.push_back(name);
+            }
+            closedir(dir);
+            // in socket order, so that the zones are read the same way every run
+            std::sort(tops.begin(), tops.end());
+            for(size_t t = 0; t < tops.size(); ++t)
+            {
+                std::string path = root + "/" + tops[t];
+                if(readName(path).compare(0, 7, "package") != 0 || !addZone(path, false))
+                    continue;
+                ++packages;
+                DIR* sub = opendir(path.c_str());
+                if(sub == nullptr)
+                    continue;
+                std::vector<std::string> subzones;
+                for(struct dirent* entry = readdir(sub); entry != nullptr; entry = readdir(sub))
+                    if(strncmp(entry->d_name, tops[t].c_str(), tops[t].size()) == 0 && entry->d_name[tops[t].size()] == ':')
+                        subzones.push_back(entry->d_name);
+                closedir(sub);
+                std::sort(subzones.begin(), subzones.end());
+                for(size_t s = 0; s < subzones.size(); ++s)
+                    if(readName(path + "/" + subzones[s]) == "dram")
+                        addZone(path + "/" + subzones[s], true);
+            }
+#else
+            (void)root;
+#endif
+        }
+    };
+
+    /*
+        Energy of a run by precision level: lap() after each iteration charges the energy since the
+        last lap (or start) to the level it ran at.
+    */
+    class EnergyPhases
+    {
+    public:
+        struct Phase
+        {
+            std::string level;
+            Energy energy;
+            int iterations;
+            double seconds;
+        };
+
+        explicit EnergyPhases(const char* root = getenv("MANSEG_RAPL")) :meter(root) {}
+
+        bool available() const { return meter.available(); }
+        bool hasDram() const { return meter.hasDram(); }
+
+        /* starts (or restarts) the lap, e.g. before the first iteration */
+        void start() { last = meter.read(); }
+
+        /* energy since the last lap or start, charged to level along with its iterations and seconds */
+        Energy lap(const char* level, const double& seconds = NAN, const int& iterations = 1)
+        {
+            if(!available())
+                return Energy(NAN, NAN);
+            Energy now = meter.read();
+            Energy e = now - last;
+            last = now;
+            Phase& p = phase(level);
+            p.energy += e;
+            p.iterations += iterations;
+            p.seconds += seconds;
+            return e;
+        }
+
+        /* energy of every level */
+        Energy total() const
+        {
+            Energy t;
+            for(size_t i = 0; i < phases.size(); ++i)
+                t += phases[i].energy;
+            return t;
+        }
+
+        const std::vector<Phase>& levels() const { return phases; }
+
+        /* discards the phases, e.g. between rounds */
+        void clear() { phases.clear(); start(); }
+
+        /*
+            Records, for each level, energy_<level>_package_joules, _dram_joules, _iterations and
+            _joules_per_iteration (package and DRAM), and for the run energy_package_joules,
+            energy_dram_joules and energy_joules; nothing where RAPL cannot be read.
+        */
+        void report(ResultsWriter& results) const
+        {
+            if(!available())
+                return;
+            for(size_t i = 0; i < phases.size(); ++i)
+            {
+                const Phase& p = phases[i];
+                std::string key = "energy_" + p.level + "_";
+                results.set((key + "package_joules").c_str(), p.energy.package);
+                if(hasDram())
+                    results.set((key + "dram_joules").c_str(), p.energy.dram);
+                results.set((key + "iterations").c_str(), p.iterations);
+                if(p.iterations > 0)
+                    results.set((key + "joules_per_iteration").c_str(), p.energy.total() / p.iterations);
+            }
+            Energy t = total();
+            results.set("energy_package_joules", t.package);
+            if(hasDram())
+                results.set("energy_dram_joules", t.dram);
+            results.set("energy_joules", t.total());
+        }
+
+        /* a line per level and one for the run, or a note that RAPL cannot be read */
+        void print(FILE* f = stdout) const
+        {
+            if(!available())
+            {
+                fprintf(f, "energy: no readable RAPL counters\n");
+                return;
+            }
+            for(size_t i = 0; i < phases.size(); ++i)
+            {
+                const Phase& p = phases[i];
+                fprintf(f, "energy: %-8s %6d iterations %10.3f J package %10.3f J dram", p.level.c_str(), p.iterations, p.energy.package, p.energy.dram);
+                if(p.iterations > 0)
+                    fprintf(f, " %10.4f J/iteration", p.energy.total() / p.iterations);
+                if(p.seconds == p.seconds && p.seconds > 0.0)
+                    fprintf(f, " %8.2f W", p.energy.total() / p.seconds);
+                fprintf(f, "\n");
+            }
+            Energy t = total();
+            fprintf(f, "energy: total %.3f J (%.3f J package, %.3f J dram)\n", t.total(), t.package, t.dram);
+        }
+
+    private:
+        EnergyMeter meter;
+        Energy last;
+        std::vector<Phase> phases;
+
+        Phase& phase(const char* level)
+        {
+            for(size_t i = 0; i < phases.size(); ++i)
+                if(phases[i].level == level)
+                    return phases[i];
+            Phase p = { level, Energy(), 0, 0.0 };
+            phases.push_back(p);
+            return phases.back();
+        }
+    };
+}
+
+#endif // __MANSEG_ENERGY_H__
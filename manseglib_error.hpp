@@ -0,0 +1,191 @@
+/*
+	A-priori bounds on the error of writing heads.
+	Author: harunadess
+
+	A head keeps the upper 32 bits of a double, 20 bits of its mantissa, so storing d in one moves it
+	by less than 2^-20 |d| when truncated (and stochastically rounded), and by at most 2^-21 |d| when
+	rounded to nearest. Built with MANSEG_ERROR_BOUND=1, the library adds that bound for every value
+	it narrows to a head to a running total:
+		- roundToHead, and so the set of the arrays, spans and DualWriteView, scatterAddHeads and the
+		  scalar remainders of the kernels;
+		- the SIMD paths of narrowToHeads and scatterAddHeads;
+		- the Head proxy's stores and atomicAdd on heads.
+	The total is an L1 norm: the sum over the writes of the largest error each can have added, so
+	between two points of a run it bounds the distance the heads written in between were moved from
+	what was computed. Reads, reductions into doubles and anything kept in pairs or in full add
+	nothing. It bounds the new error only: the error already in the heads that were read is the
+	previous iterations' own.
+
+	As with the traffic counters each thread adds into its own cache line and total() adds them up,
+	so the bound of an iteration is a difference,
+		double before = ErrorBound::total();
+		... an iteration at the heads ...
+		control.policy().shadow.truncation = ErrorBound::total() - before;
+	which is what ShadowErrorPolicy compares the delta with. Without MANSEG_ERROR_BOUND (the default)
+	MANSEG_ERROR_ADD expands to nothing and its argument is not evaluated, and total() is zero;
+	ErrorBound::enabled tells a driver which it has.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_ERROR_H__
+#define __MANSEG_ERROR_H__
+
+#ifndef MANSEG_ERROR_BOUND
+#define MANSEG_ERROR_BOUND 0
+#endif
+
+#include <cmath>
+#include <stdint.h>
+
+#if MANSEG_ERROR_BOUND
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace ManSeg
+{
+    namespace ErrorBound
+    {
+        constexpr bool enabled = MANSEG_ERROR_BOUND != 0;
+
+        /* largest error, relative to |d|, of truncating d to a head, and of rounding it to nearest */
+        constexpr double truncation = 1.0 / 1048576.0;
+        constexpr double nearest = truncation / 2;
+
+        /* |d|, or 0 for infinities and NaNs, which a head keeps as they are */
+        inline double magnitude(const double& d)
+        {
+            return std::isfinite(d) ? std::fabs(d) : 0.0;
+        }
+
+        /* sum of the magnitudes of in[0, n) */
+        inline double l1(const double* in, const uint_fast64_t& n)
+        {
+            double sum = 0.0;
+            for(uint_fast64_t i = 0; i < n; ++i)
+                sum += magnitude(in[i]);
+            return sum;
+        }
+
+#if MANSEG_ERROR_BOUND
+        /* one thread's total, a cache line of its own; only its thread writes it */
+        struct alignas(64) ThreadBound
+        {
+            std::atomic<double> sum;
+
+            ThreadBound() { sum.store(0.0, std::memory_order_relaxed); }
+        };
+
+        /*
+            Keeps track of the totals of the threads running, and of those that have exited.
+            Threads only take the lock when they first add and when they exit.
+        */
+        class Registry
+        {
+        public:
+            static Registry& get()
+            {
+                static Registry registry;
+                return registry;
+            }
+
+            ThreadBound& local()
+            {
+                static thread_local Slot slot;
+                return slot.bound;
+            }
+
+            /* the bounds of every thread; exact once the threads adding have synchronised with this one */
+            double total()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                double t = retired;
+                for(size_t i = 0; i < threads.size(); ++i)
+                    t += threads[i]->sum.load(std::memory_order_relaxed);
+                return t;
+            }
+
+            /* zeroes every total, e.g. between rounds; call it while no other thread is adding */
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                retired = 0.0;
+                for(size_t i = 0; i < threads.size(); ++i)
+                    threads[i]->sum.store(0.0, std::memory_order_relaxed);
+            }
+
+        private:
+            std::mutex mutex;
+            std::vector<ThreadBound*> threads;
+            double retired = 0.0;
+
+            /* a thread's total, registered on its first add and folded into retired when it exits */
+            struct Slot
+            {
+                ThreadBound bound;
+
+                Slot()
+                {
+                    Registry& r = get();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.threads.push_back(&bound);
+                }
+
+                ~Slot()
+                {
+                    Registry& r = get();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.retired += bound.sum.load(std::memory_order_relaxed);
+                    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &bound));
+                }
+            };
+
+            Registry() {}
+            Registry(const Registry&);
+            Registry& operator=(const Registry&);
+        };
+
+        /* adds e to this thread's total; a plain load and store, as no other thread writes it */
+        inline void add(const double& e)
+        {
+            std::atomic<double>& v = Registry::get().local().sum;
+            v.store(v.load(std::memory_order_relaxed) + e, std::memory_order_relaxed);
+        }
+
+        inline double total() { return Registry::get().total(); }
+        inline void clear() { Registry::get().clear(); }
+#else
+        inline double total() { return 0.0; }
+        inline void clear() {}
+#endif
+    }
+}
+
+#if MANSEG_ERROR_BOUND
+#define MANSEG_ERROR_ADD(e) ManSeg::ErrorBound::add(e)
+#else
+#define MANSEG_ERROR_ADD(e) ((void)0)
+#endif
+
+#endif // __MANSEG_ERROR_H__
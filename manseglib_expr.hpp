@@ -0,0 +1,660 @@
+/*
+	Expression templates for whole array (or range) arithmetic on mantissa segmented arrays.
+	Author: harunadess
+
+	Element-wise code through the Head/Pair proxies converts between segments and doubles for every
+	operation, e.g. p[i] += a * (q[i] / d) narrows and widens p[i] once per term.
+	Here an expression such as
+		assign(y, 0, n, a * expr(x) + expr(y) / 2.0);
+	builds a lazy tree of terms, which assign evaluates in a single loop: each plane of each
+	operand is loaded once per element, the arithmetic is done on doubles in registers (4 at a time
+	with AVX2), and the result is narrowed and stored once.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_EXPR_H__
+#define __MANSEG_EXPR_H__
+
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "manseglib.hpp"
+
+
+namespace ManSeg
+{
+    /*
+        Base of all expression nodes (CRTP).
+        A node provides at(i), the double value of element i, and with AVX2 load4(i), elements i..i+3.
+        load4 is compiled for AVX2 (see SimdLevel), so it is only called from the AVX2 loops below.
+    */
+    template<class Derived>
+    struct Expr
+    {
+        const Derived& self() const { return static_cast<const Derived&>(*this); }
+    };
+
+    /* reads the heads of a TwoSegArray, i.e. reduced precision */
+    struct HeadsTerm : Expr<HeadsTerm>
+    {
+        const float* heads;
+
+        HeadsTerm(const float* heads)
+            :heads(heads)
+        {}
+
+        double at(const uint_fast64_t& i) const
+        {
+            return static_cast<double>(Head(const_cast<float*>(heads + i)));
+        }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const
+        {
+            __m256i h = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heads + i)));
+            return _mm256_castsi256_pd(_mm256_slli_epi64(h, 32));
+        }
+#endif
+    };
+
+    /* reads heads and tails of a TwoSegArray, i.e. full precision */
+    struct PairsTerm : Expr<PairsTerm>
+    {
+        const float* heads;
+        const float* tails;
+
+        PairsTerm(const float* heads, const float* tails)
+            :heads(heads), tails(tails)
+        {}
+
+        double at(const uint_fast64_t& i) const
+        {
+            return static_cast<double>(Pair(const_cast<float*>(heads + i), const_cast<float*>(tails + i)));
+        }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const
+        {
+            __m256i h = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heads + i)));
+            __m256i t = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tails + i)));
+            return _mm256_castsi256_pd(_mm256_or_si256(_mm256_slli_epi64(h, 32), t));
+        }
+#endif
+    };
+
+    /* reads a standard IEEE double array */
+    struct FullTerm : Expr<FullTerm>
+    {
+        const double* full;
+
+        FullTerm(const double* full)
+            :full(full)
+        {}
+
+        double at(const uint_fast64_t& i) const { return full[i]; }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const { return _mm256_loadu_pd(full + i); }
+#endif
+    };
+
+    /* a constant, broadcast to every element */
+    struct ScalarTerm : Expr<ScalarTerm>
+    {
+        double value;
+
+        ScalarTerm(const double& value)
+            :value(value)
+        {}
+
+        double at(const uint_fast64_t& i) const { return value; }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const { return _mm256_set1_pd(value); }
+#endif
+    };
+
+    struct AddOp
+    {
+        static double apply(const double& a, const double& b) { return a + b; }
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 static __m256d apply(const __m256d& a, const __m256d& b) { return _mm256_add_pd(a, b); }
+#endif
+    };
+
+    struct SubOp
+    {
+        static double apply(const double& a, const double& b) { return a - b; }
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 static __m256d apply(const __m256d& a, const __m256d& b) { return _mm256_sub_pd(a, b); }
+#endif
+    };
+
+    struct MulOp
+    {
+        static double apply(const double& a, const double& b) { return a * b; }
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 static __m256d apply(const __m256d& a, const __m256d& b) { return _mm256_mul_pd(a, b); }
+#endif
+    };
+
+    struct DivOp
+    {
+        static double apply(const double& a, const double& b) { return a / b; }
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 static __m256d apply(const __m256d& a, const __m256d& b) { return _mm256_div_pd(a, b); }
+#endif
+    };
+
+    template<class L, class R, class Op>
+    struct BinaryExpr : Expr<BinaryExpr<L, R, Op> >
+    {
+        L lhs;
+        R rhs;
+
+        BinaryExpr(const L& lhs, const R& rhs)
+            :lhs(lhs), rhs(rhs)
+        {}
+
+        double at(const uint_fast64_t& i) const { return Op::apply(lhs.at(i), rhs.at(i)); }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const { return Op::apply(lhs.load4(i), rhs.load4(i)); }
+#endif
+    };
+
+    /* |e| */
+    template<class E>
+    struct AbsExpr : Expr<AbsExpr<E> >
+    {
+        E e;
+
+        AbsExpr(const E& e)
+            :e(e)
+        {}
+
+        double at(const uint_fast64_t& i) const { return fabs(e.at(i)); }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const
+        {
+            return _mm256_andnot_pd(_mm256_set1_pd(-0.0), e.load4(i));
+        }
+#endif
+    };
+
+    template<class E>
+    inline AbsExpr<E> abs(const Expr<E>& e) { return AbsExpr<E>(e.self()); }
+
+    /*
+        Terminals. Expressions are evaluated over absolute indices, so the terms of an expression
+        read the same elements as the range being assigned.
+    */
+    template<class Allocator>
+    inline HeadsTerm expr(const TwoSegArray<false, Allocator>& a) { return HeadsTerm(a.getHeads()); }
+
+    template<class Allocator>
+    inline PairsTerm expr(const TwoSegArray<true, Allocator>& a) { return PairsTerm(a.getHeads(), a.getTails()); }
+
+    inline FullTerm expr(const double* a) { return FullTerm(a); }
+
+    inline FullTerm expr(const FullView& a) { return FullTerm(a.getFull()); }
+
+    /* spans are indexed from their own start, so their terms are too */
+    inline HeadsTerm expr(const HeadsSpan& a) { return HeadsTerm(a.getHeads()); }
+
+    inline PairsTerm expr(const PairsSpan& a) { return PairsTerm(a.getHeads(), a.getTails()); }
+
+    template<class E>
+    inline const E& expr(const Expr<E>& e) { return e.self(); }
+
+#define MANSEG_EXPR_OPERATOR(op, Op) \
+    template<class L, class R> \
+    inline BinaryExpr<L, R, Op> operator op(const Expr<L>& lhs, const Expr<R>& rhs) \
+    { return BinaryExpr<L, R, Op>(lhs.self(), rhs.self()); } \
+    template<class L> \
+    inline BinaryExpr<L, ScalarTerm, Op> operator op(const Expr<L>& lhs, const double& rhs) \
+    { return BinaryExpr<L, ScalarTerm, Op>(lhs.self(), ScalarTerm(rhs)); } \
+    template<class R> \
+    inline BinaryExpr<ScalarTerm, R, Op> operator op(const double& lhs, const Expr<R>& rhs) \
+    { return BinaryExpr<ScalarTerm, R, Op>(ScalarTerm(lhs), rhs.self()); }
+
+    MANSEG_EXPR_OPERATOR(+, AddOp)
+    MANSEG_EXPR_OPERATOR(-, SubOp)
+    MANSEG_EXPR_OPERATOR(*, MulOp)
+    MANSEG_EXPR_OPERATOR(/, DivOp)
+
+#undef MANSEG_EXPR_OPERATOR
+
+    /*
+        AVX2 loops of assign and reduceSum, which call the load4 of the expression, 4 elements at a time.
+        Each returns the index it stopped at, for the scalar loop of the caller to finish from.
+    */
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        template<RoundingMode mode, class E>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t assignHeadsAVX2(float* heads, const uint_fast64_t& start, const uint_fast64_t& n, const E& e)
+        {
+            uint_fast64_t i = start;
+            const __m256i odd = _mm256_setr_epi32(1, 3, 5, 7, 0, 0, 0, 0);
+            __m256i rng = _mm256_setzero_si256();
+            if(mode == ROUND_STOCHASTIC && n >= 4)
+                rng = _mm256_set_epi64x(nextStochastic(), nextStochastic(), nextStochastic(), nextStochastic());
+            for(; i < start + (n & ~uint_fast64_t(3)); i += 4)
+            {
+                __m256i v = roundHeadBits<mode>(_mm256_castpd_si256(e.load4(i)), rng);
+                v = _mm256_permutevar8x32_epi32(v, odd);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(heads + i), _mm256_castsi256_si128(v));
+            }
+            return i;
+        }
+
+        template<class E>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t assignPairsAVX2(float* heads, float* tails, const uint_fast64_t& start, const uint_fast64_t& n, const E& e)
+        {
+            uint_fast64_t i = start;
+            const __m256i split = _mm256_setr_epi32(1, 3, 5, 7, 0, 2, 4, 6);
+            for(; i < start + (n & ~uint_fast64_t(3)); i += 4)
+            {
+                __m256i v = _mm256_permutevar8x32_epi32(_mm256_castpd_si256(e.load4(i)), split);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(heads + i), _mm256_castsi256_si128(v));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tails + i), _mm256_extracti128_si256(v, 1));
+            }
+            return i;
+        }
+
+        template<class E>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t assignFullAVX2(double* y, const uint_fast64_t& start, const uint_fast64_t& n, const E& e)
+        {
+            uint_fast64_t i = start;
+            for(; i < start + (n & ~uint_fast64_t(3)); i += 4)
+                _mm256_storeu_pd(y + i, e.load4(i));
+            return i;
+        }
+
+        // 8 lane compensated sum of e over multiples of 8 elements, leaving the lane sums and errors in lanes
+        template<class E>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t reduceSumAVX2(const E& e, const uint_fast64_t& start, const uint_fast64_t& n, double* lanes)
+        {
+            uint_fast64_t i = start;
+            __m256d d0 = _mm256_setzero_pd(), d1 = _mm256_setzero_pd();
+            __m256d e0 = _mm256_setzero_pd(), e1 = _mm256_setzero_pd();
+            for(; i < start + (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256d t0 = d0, t1 = d1;
+                __m256d y0 = _mm256_add_pd(e.load4(i), e0);
+                __m256d y1 = _mm256_add_pd(e.load4(i + 4), e1);
+                d0 = _mm256_add_pd(t0, y0);
+                d1 = _mm256_add_pd(t1, y1);
+                e0 = _mm256_add_pd(_mm256_sub_pd(t0, d0), y0);
+                e1 = _mm256_add_pd(_mm256_sub_pd(t1, d1), y1);
+            }
+            _mm256_storeu_pd(lanes, d0);
+            _mm256_storeu_pd(lanes + 4, d1);
+            _mm256_storeu_pd(lanes + 8, e0);
+            _mm256_storeu_pd(lanes + 12, e1);
+            return i;
+        }
+#endif
+    }
+
+    /*
+        y[i] = e[i] for i in [start, start + n), writing only the heads of y, rounded according to mode.
+        Elements are read before they are written, so e may refer to y itself.
+    */
+    template<RoundingMode mode = ROUND_TRUNCATE, class Allocator, class E>
+    inline void assign(TwoSegArray<false, Allocator>& y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        const E& e = expression.self();
+        float* heads = y.getHeads();
+        uint_fast64_t i = start;
+        const uint_fast64_t end = start + n;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::assignHeadsAVX2<mode>(heads, start, n, e);
+#endif
+        for(; i < end; ++i)
+            heads[i] = roundToHead<mode>(e.at(i));
+    }
+
+    /*
+        y[i] = e[i] for i in [start, start + n), writing heads and tails of y.
+        Elements are read before they are written, so e may refer to y itself.
+    */
+    template<class Allocator, class E>
+    inline void assign(TwoSegArray<true, Allocator>& y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        const E& e = expression.self();
+        uint_fast64_t i = start;
+        const uint_fast64_t end = start + n;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::assignPairsAVX2(y.getHeads(), y.getTails(), start, n, e);
+#endif
+        for(; i < end; ++i)
+            y.set(i, e.at(i));
+    }
+
+    /* y[i] = e[i] for i in [start, start + n), for a standard IEEE double array y */
+    template<class E>
+    inline void assign(double* y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        const E& e = expression.self();
+        uint_fast64_t i = start;
+        const uint_fast64_t end = start + n;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) i = simd::assignFullAVX2(y, start, n, e);
+#endif
+        for(; i < end; ++i)
+            y[i] = e.at(i);
+    }
+
+    template<class E>
+    inline void assign(FullView& y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        assign(y.getFull(), start, n, expression);
+    }
+
+    template<RoundingMode mode = ROUND_TRUNCATE, class E>
+    inline void assign(const HeadsSpan& y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        HeadsArray view(y.getHeads(), y.getTails(), y.size());
+        assign<mode>(view, start, n, expression);
+    }
+
+    template<class E>
+    inline void assign(const PairsSpan& y, const uint_fast64_t& start, const uint_fast64_t& n, const Expr<E>& expression)
+    {
+        PairsArray view(y.getHeads(), y.getTails(), y.size());
+        assign(view, start, n, expression);
+    }
+
+    /*
+        Compensated (Kahan) summation of e over [start, start + n), i.e. the loop
+            temp = d; y = e[i] + err; d = temp + y; err = (temp - d) + y;
+        used throughout the benchmarks, but with AVX2 run as 8 independent lanes (two 4 wide accumulators),
+        so that the loop is not bound by the latency of a single dependency chain.
+        The lanes are combined with the same compensated sum at the end.
+        Note: must not be compiled with -ffast-math (or -fassociative-math), which removes the compensation.
+    */
+    template<class E>
+    inline double reduceSum(const Expr<E>& expression, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        const E& e = expression.self();
+        double d = 0.0;
+        double err = 0.0;
+        uint_fast64_t i = start;
+#if defined(MANSEG_HAS_AVX2)
+        if(n >= 8 && simdLevel() >= SIMD_AVX2)
+        {
+            double lanes[16];
+            i = simd::reduceSumAVX2(e, start, n, lanes);
+            for(int k = 0; k < 16; ++k)
+            {
+                double temp = d;
+                double y = lanes[k] + err;
+                d = temp + y;
+                err = temp - d;
+                err += y;
+            }
+        }
+#endif
+        for(; i < start + n; ++i)
+        {
+            double temp = d;
+            double y = e.at(i) + err;
+            d = temp + y;
+            err = temp - d;
+            err += y;
+        }
+        return d;
+    }
+
+    /*
+        As reduceSum, with [start, start + n) divided between the workers of the parallel backend
+        (see parallelFor). The chunk sums are combined with a compensated sum, in chunk order.
+        With the serial backend this is reduceSum.
+    */
+    template<class E>
+    inline double parallelReduceSum(const Expr<E>& expression, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        const uint_fast64_t chunks = parallelChunks(n);
+        if(chunks <= 1)
+            return reduceSum(expression, start, n);
+
+        std::vector<double> partial(chunks);
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t c = begin; c < end; ++c)
+            {
+                const uint_fast64_t s = start + (n * c) / chunks;
+                const uint_fast64_t e = start + (n * (c + 1)) / chunks;
+                partial[c] = reduceSum(expression, s, e - s);
+            }
+        }, 1);
+        return reduceSum(expr(partial.data()), 0, chunks);
+    }
+
+    /*
+        sum(a[i]), sum(|a[i] - b[i]|) and sum(a[i] * b[i]) over [start, start + n), using compensated summation.
+        a and b may each be a HeadsArray, a PairsArray, a double* or an expression.
+    */
+    template<class A>
+    inline double kahanSum(const A& a, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return reduceSum(expr(a), start, n);
+    }
+
+    template<class A, class B>
+    inline double l1Diff(const A& a, const B& b, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return reduceSum(abs(expr(a) - expr(b)), start, n);
+    }
+
+    template<class A, class B>
+    inline double dot(const A& a, const B& b, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return reduceSum(expr(a) * expr(b), start, n);
+    }
+
+    /* an estimate of a sum, which is within [lower(), upper()] with the confidence of the sample */
+    struct SampleEstimate
+    {
+        double value;
+        double bound;
+
+        double lower() const { return value - bound; }
+        double upper() const { return value + bound; }
+    };
+
+    /*
+        A fixed random sample of k of the indices [0, n) (with replacement, sorted so that a pass over it
+        reads forwards), for estimating sums over [0, n) from k of their terms: n times the mean of the
+        sampled terms, give or take z standard errors. The default z of 3 is a 99.7% bound for a normal
+        error, which the mean of a few thousand terms is close to. With k >= n every index is taken once
+        and the sum is exact (bound 0).
+        Meant for convergence checks far from their thresholds, e.g.
+            SampleEstimate delta = sampledL1Diff(sample, x.heads, y.heads);
+            if(!control.decides(delta.lower(), delta.upper(), tol)) delta = {l1Diff(x.heads, y.heads, 0, n), 0.0};
+    */
+    class IndexSample
+    {
+    public:
+        IndexSample(const uint_fast64_t& n, const uint_fast64_t& k, const uint_fast64_t& seed = 5489, const double& z = 3.0)
+            :n(n), z(z)
+        {
+            if(k >= n)
+            {
+                indices.resize(n);
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    indices[i] = i;
+                return;
+            }
+            std::mt19937_64 gen(seed);
+            std::uniform_int_distribution<uint_fast64_t> pick(0, n - 1);
+            indices.resize(k);
+            for(uint_fast64_t i = 0; i < k; ++i)
+                indices[i] = pick(gen);
+            std::sort(indices.begin(), indices.end());
+        }
+
+        uint_fast64_t size() const { return indices.size(); }
+        // every index is in the sample (only when k >= n, as smaller samples are drawn with replacement)
+        bool exact() const { return indices.size() == n; }
+
+        template<class E>
+        SampleEstimate sum(const Expr<E>& expression) const
+        {
+            const E& e = expression.self();
+            const uint_fast64_t k = indices.size();
+            if(k == 0)
+                return SampleEstimate{0.0, 0.0};
+            if(exact())
+                return SampleEstimate{reduceSum(expression, 0, n), 0.0};
+            // Welford's mean and variance of the sampled terms
+            double mean = 0.0, m2 = 0.0;
+            for(uint_fast64_t j = 0; j < k; ++j)
+            {
+                const double x = e.at(indices[j]);
+                const double d = x - mean;
+                mean += d / (double)(j + 1);
+                m2 += d * (x - mean);
+            }
+            const double variance = (k > 1) ? m2 / (double)(k - 1) : 0.0;
+            return SampleEstimate{n * mean, z * n * sqrt(variance / (double)k)};
+        }
+
+    private:
+        uint_fast64_t n;
+        double z;
+        std::vector<uint_fast64_t> indices;
+    };
+
+    /* sampled estimates of kahanSum and l1Diff over [0, n) */
+    template<class A>
+    inline SampleEstimate sampledSum(const IndexSample& sample, const A& a)
+    {
+        return sample.sum(expr(a));
+    }
+
+    template<class A, class B>
+    inline SampleEstimate sampledL1Diff(const IndexSample& sample, const A& a, const B& b)
+    {
+        return sample.sum(abs(expr(a) - expr(b)));
+    }
+
+    /*
+        Counter based random numbers: the word drawn for index i is splitmix64's output i for the seed
+        (its finaliser applied to seed + (i + 1) times the golden ratio), so it depends on nothing but
+        the seed and i, not on the order the indices are visited in or how they are divided up.
+    */
+    inline uint64_t counterRandom(const uint64_t& seed, const uint64_t& i)
+    {
+        uint64_t z = seed + (i + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    /* the top 53 bits of a random word as a double in [0, 1) */
+    inline double unitRandom(const uint64_t& bits)
+    {
+        return (double)(bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /* the distributions of fillRandom: the value of index i for a seed */
+    struct UniformRandom
+    {
+        double lo, hi;
+
+        UniformRandom(const double& lo = 0.0, const double& hi = 1.0) :lo(lo), hi(hi) {}
+
+        double operator()(const uint64_t& seed, const uint64_t& i) const
+        {
+            return lo + (hi - lo) * unitRandom(counterRandom(seed, i));
+        }
+    };
+
+    /* Box-Muller on the words 2i and 2i + 1 of the seed's stream */
+    struct NormalRandom
+    {
+        double mean, sd;
+
+        NormalRandom(const double& mean = 0.0, const double& sd = 1.0) :mean(mean), sd(sd) {}
+
+        double operator()(const uint64_t& seed, const uint64_t& i) const
+        {
+            const double u = 1.0 - unitRandom(counterRandom(seed, 2 * i));  // (0, 1], for the log
+            const double v = unitRandom(counterRandom(seed, 2 * i + 1));
+            return mean + sd * sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+        }
+    };
+
+    /*
+        a.set<mode>(start + i, dist(seed, start + i)) for n values of a view, divided between the workers
+        of the parallel backend, e.g.
+            fillRandom(x.heads, 0, n, 42, UniformRandom(-1.0, 1.0));   // writes the heads only
+            fillRandom(x.pairs, 0, n, 42, NormalRandom());             // heads and tails
+        The values are drawn a block at a time, in a loop of integer multiplies and shifts that the
+        compiler vectorises, then stored. As each depends only on the seed and its index, the array is
+        the same on any number of workers, and filling a range in pieces is the same as filling it whole.
+    */
+    template<RoundingMode mode = ROUND_TRUNCATE, class View, class Distribution>
+    inline void fillRandom(View&& a, const uint_fast64_t& start, const uint_fast64_t& n, const uint64_t& seed,
+        const Distribution& dist)
+    {
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double values[256];
+            for(uint_fast64_t b = begin; b < end; b += 256)
+            {
+                const uint_fast64_t len = std::min<uint_fast64_t>(256, end - b);
+                for(uint_fast64_t i = 0; i < len; ++i)
+                    values[i] = dist(seed, start + b + i);
+                for(uint_fast64_t i = 0; i < len; ++i)
+                    a.template set<mode>(start + b + i, values[i]);
+            }
+        });
+    }
+
+    /* versions of kahanSum, l1Diff and dot divided between the workers of the parallel backend */
+    template<class A>
+    inline double parallelKahanSum(const A& a, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return parallelReduceSum(expr(a), start, n);
+    }
+
+    template<class A, class B>
+    inline double parallelL1Diff(const A& a, const B& b, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return parallelReduceSum(abs(expr(a) - expr(b)), start, n);
+    }
+
+    template<class A, class B>
+    inline double parallelDot(const A& a, const B& b, const uint_fast64_t& start, const uint_fast64_t& n)
+    {
+        return parallelReduceSum(expr(a) * expr(b), start, n);
+    }
+}
+
+#endif
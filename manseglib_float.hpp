@@ -0,0 +1,688 @@
+/*
+	Mantissa segmentation of single precision floats: a 16 bit head and a 16 bit tail.
+	Author: harunadess
+
+	The head of a float is its upper 16 bits: the sign, the 8 bit exponent and 7 mantissa bits, which
+	is a bfloat16. The tail holds the other 16 mantissa bits. As with doubles, the heads and tails are
+	two planes, so a sweep at the heads reads 2 bytes a value rather than 4:
+		FloatSegArray x(n);
+		x.heads.set<ROUND_NEAREST>(i, v);   // bfloat16, e.g. of features or embeddings
+		float a = x.heads.read(i);          // the head widened to a float, exactly
+		x.pairs.set(i, v);                  // the float, exactly
+		x.copytoIEEEfloat();                // promotion: x.full holds the floats
+	FloatTwoSegArray<useTail> mirrors TwoSegArray<useTail> (operator[], read, set<mode>, readBlock and
+	writeBlock, in floats), FloatFullView mirrors FullView, and read_as/write_as give the view of an
+	AccessLevel, so the kernels of a float app can be templated on their levels in the same way.
+	A head reads back as the float whose lower 16 bits are zero, so it is a bfloat16 as hardware and
+	other libraries read it; the relative precision of a head is 2^-7 (MaxFloatHeadPrecision).
+	Narrowing to a head rounds as RoundingMode says, except that NaNs are kept NaNs (made quiet)
+	rather than truncated to infinities, and infinities are left alone.
+	The bulk kernels are integer shifts and packs (AVX2, AVX-512F), dispatched as those of
+	manseglib.hpp. Rounding to the nearest heads uses the AVX-512 BF16 conversion on CPUs that have
+	it; that instruction flushes denormals to zero, so the denormal lanes are taken from the shifts,
+	and every path gives the same heads.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_FLOAT_H__
+#define __MANSEG_FLOAT_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+
+#include "manseglib.hpp"
+
+#if defined(MANSEG_DISPATCH)
+#define MANSEG_TARGET_AVX512BF16 __attribute__((target("avx2,avx512f,avx512cd,avx512bf16")))
+#define MANSEG_HAS_AVX512BF16
+#elif defined(MANSEG_HAS_AVX512) && defined(__AVX512BF16__)
+#define MANSEG_TARGET_AVX512BF16
+#define MANSEG_HAS_AVX512BF16
+#endif
+
+namespace ManSeg
+{
+    /* relative precision of a float's head (7 mantissa bits), as MaxSingleSegmentPrecision is of a double's */
+    constexpr double MaxFloatHeadPrecision = 1.0 / 128;
+
+    inline uint32_t floatBits(const float& f)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(float));
+        return bits;
+    }
+
+    inline float bitsFloat(const uint32_t& bits)
+    {
+        float f;
+        memcpy(&f, &bits, sizeof(float));
+        return f;
+    }
+
+    // float with head as its upper 16 bits, and zero lower 16 bits
+    inline float floatHeadToFloat(const uint16_t& head) { return bitsFloat(static_cast<uint32_t>(head) << 16); }
+
+    // float made up of head (upper 16 bits) and tail (lower 16 bits)
+    inline float floatSegmentsToFloat(const uint16_t& head, const uint16_t& tail)
+    {
+        return bitsFloat((static_cast<uint32_t>(head) << 16) | tail);
+    }
+
+    // head of a float (its upper 16 bits, truncated)
+    inline uint16_t floatHeadOf(const float& f) { return static_cast<uint16_t>(floatBits(f) >> 16); }
+
+    inline void splitFloatSegment(const float& f, uint16_t* head, uint16_t* tail)
+    {
+        const uint32_t bits = floatBits(f);
+        *head = static_cast<uint16_t>(bits >> 16);
+        *tail = static_cast<uint16_t>(bits);
+    }
+
+    // head of the float with these bits, rounded according to mode; NaNs stay (quiet) NaNs
+    template<RoundingMode mode>
+    inline uint16_t roundFloatHeadBits(const uint32_t& bits)
+    {
+        if((bits & 0x7F800000u) == 0x7F800000u)
+            return static_cast<uint16_t>((bits >> 16) | ((bits & 0x007FFFFFu) != 0 ? 0x0040u : 0u));
+        if(mode == ROUND_TRUNCATE)
+            return static_cast<uint16_t>(bits >> 16);
+        if(mode == ROUND_NEAREST)
+            return static_cast<uint16_t>((bits + 0x7FFFu + ((bits >> 16) & 1u)) >> 16);
+        return static_cast<uint16_t>((bits + static_cast<uint32_t>(nextStochastic() & 0xFFFFu)) >> 16);
+    }
+
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline uint16_t roundToFloatHead(const float& f) { return roundFloatHeadBits<mode>(floatBits(f)); }
+
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        // the heads of 8 floats (as 32-bit integers), rounded as roundFloatHeadBits, in the low 16 bits of each lane
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX2 inline __m256i roundFloatHeadBits(const __m256i& bits)
+        {
+            const __m256i expMask = _mm256_set1_epi32(0x7F800000);
+            __m256i rounded = bits;
+            if(mode == ROUND_NEAREST)
+            {
+                const __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+                rounded = _mm256_add_epi32(bits, _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), lsb));
+            }
+            const __m256i special = _mm256_cmpeq_epi32(_mm256_and_si256(bits, expMask), expMask);
+            const __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF)), expMask);
+            const __m256i heads = _mm256_srli_epi32(_mm256_blendv_epi8(rounded, bits, special), 16);
+            return _mm256_or_si256(heads, _mm256_and_si256(nan, _mm256_set1_epi32(0x0040)));
+        }
+
+        MANSEG_TARGET_AVX2 inline uint_fast64_t widenFloatHeadsAVX2(const uint16_t* heads, const uint_fast64_t& n, float* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heads + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_slli_epi32(h, 16));
+            }
+            return i;
+        }
+
+        MANSEG_TARGET_AVX2 inline uint_fast64_t combineFloatSegmentsAVX2(const uint16_t* heads, const uint16_t* tails, const uint_fast64_t& n, float* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                const __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heads + i)));
+                const __m256i t = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tails + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_or_si256(_mm256_slli_epi32(h, 16), t));
+            }
+            return i;
+        }
+
+        // 16 lanes of 16 bits (each in the low half of a 32-bit lane of a and b) packed in order
+        MANSEG_TARGET_AVX2 inline void storeFloatSegmentsAVX2(const __m256i& a, const __m256i& b, uint16_t* out)
+        {
+            // packus works within 128-bit halves: [a0-3, b0-3, a4-7, b4-7], then the quarters are put in order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+        }
+
+        MANSEG_TARGET_AVX2 inline uint_fast64_t splitFloatSegmentsAVX2(const float* in, const uint_fast64_t& n, uint16_t* heads, uint16_t* tails)
+        {
+            uint_fast64_t i = 0;
+            const __m256i low = _mm256_set1_epi32(0xFFFF);
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+                storeFloatSegmentsAVX2(_mm256_srli_epi32(a, 16), _mm256_srli_epi32(b, 16), heads + i);
+                storeFloatSegmentsAVX2(_mm256_and_si256(a, low), _mm256_and_si256(b, low), tails + i);
+            }
+            return i;
+        }
+
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t narrowToFloatHeadsAVX2(const float* in, const uint_fast64_t& n, uint16_t* heads)
+        {
+            // stochastic rounding draws from the scalar generator
+            if(mode == ROUND_STOCHASTIC)
+                return 0;
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+                storeFloatSegmentsAVX2(roundFloatHeadBits<mode>(a), roundFloatHeadBits<mode>(b), heads + i);
+            }
+            return i;
+        }
+#endif
+
+#if defined(MANSEG_HAS_AVX512)
+        // as above, for 16 floats
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX512 inline __m512i roundFloatHeadBits(const __m512i& bits)
+        {
+            const __m512i expMask = _mm512_set1_epi32(0x7F800000);
+            __m512i rounded = bits;
+            if(mode == ROUND_NEAREST)
+            {
+                const __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+                rounded = _mm512_add_epi32(bits, _mm512_add_epi32(_mm512_set1_epi32(0x7FFF), lsb));
+            }
+            const __mmask16 special = _mm512_cmpeq_epi32_mask(_mm512_and_si512(bits, expMask), expMask);
+            const __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(bits, _mm512_set1_epi32(0x7FFFFFFF)), expMask);
+            const __m512i heads = _mm512_srli_epi32(_mm512_mask_blend_epi32(special, rounded, bits), 16);
+            return _mm512_mask_or_epi32(heads, nan, heads, _mm512_set1_epi32(0x0040));
+        }
+
+        MANSEG_TARGET_AVX512 inline uint_fast64_t widenFloatHeadsAVX512(const uint16_t* heads, const uint_fast64_t& n, float* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i)));
+                _mm512_storeu_si512(out + i, _mm512_slli_epi32(h, 16));
+            }
+            return i + widenFloatHeadsAVX2(heads + i, n - i, out + i);
+        }
+
+        MANSEG_TARGET_AVX512 inline uint_fast64_t combineFloatSegmentsAVX512(const uint16_t* heads, const uint16_t* tails, const uint_fast64_t& n, float* out)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m512i h = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i)));
+                const __m512i t = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tails + i)));
+                _mm512_storeu_si512(out + i, _mm512_or_si512(_mm512_slli_epi32(h, 16), t));
+            }
+            return i + combineFloatSegmentsAVX2(heads + i, tails + i, n - i, out + i);
+        }
+
+        MANSEG_TARGET_AVX512 inline uint_fast64_t splitFloatSegmentsAVX512(const float* in, const uint_fast64_t& n, uint16_t* heads, uint16_t* tails)
+        {
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m512i v = _mm512_loadu_si512(in + i);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i), _mm512_cvtepi32_epi16(_mm512_srli_epi32(v, 16)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tails + i), _mm512_cvtepi32_epi16(v));
+            }
+            return i;
+        }
+
+        template<RoundingMode mode>
+        MANSEG_TARGET_AVX512 inline uint_fast64_t narrowToFloatHeadsAVX512(const float* in, const uint_fast64_t& n, uint16_t* heads)
+        {
+            if(mode == ROUND_STOCHASTIC)
+                return 0;
+            uint_fast64_t i = 0;
+            for(; i < (n & ~uint_fast64_t(15)); i += 16)
+            {
+                const __m512i v = _mm512_loadu_si512(in + i);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(heads + i), _mm512_cvtepi32_epi16(roundFloatHeadBits<mode>(v)));
+            }
+            return i;
+        }
+#endif
+
+#if defined(MANSEG_HAS_AVX512BF16)
+        /*
+            The nearest heads with vcvtne2ps2bf16, which rounds ties to even and quiets NaNs as
+            roundFloatHeadBits does, but flushes denormals to zero: those lanes are rounded with shifts.
+        */
+        MANSEG_TARGET_AVX512BF16 inline uint_fast64_t narrowToFloatHeadsNearestBF16(const float* in, const uint_fast64_t& n, uint16_t* heads)
+        {
+            uint_fast64_t i = 0;
+            const __m512i expMask = _mm512_set1_epi32(0x7F800000);
+            for(; i < (n & ~uint_fast64_t(31)); i += 32)
+            {
+                const __m512 a = _mm512_loadu_ps(in + i);
+                const __m512 b = _mm512_loadu_ps(in + i + 16);
+                __m512i converted = reinterpret_cast<__m512i>(_mm512_cvtne2ps_pbh(b, a));
+                const __mmask16 tinyA = _mm512_testn_epi32_mask(_mm512_castps_si512(a), expMask);
+                const __mmask16 tinyB = _mm512_testn_epi32_mask(_mm512_castps_si512(b), expMask);
+                if((tinyA | tinyB) != 0)
+                {
+                    const __m256i fixA = _mm512_cvtepi32_epi16(roundFloatHeadBits<ROUND_NEAREST>(_mm512_castps_si512(a)));
+                    const __m256i fixB = _mm512_cvtepi32_epi16(roundFloatHeadBits<ROUND_NEAREST>(_mm512_castps_si512(b)));
+                    const __m512i fix = _mm512_inserti64x4(_mm512_castsi256_si512(fixA), fixB, 1);
+                    const __mmask32 tiny = static_cast<__mmask32>(tinyA) | (static_cast<__mmask32>(tinyB) << 16);
+                    converted = _mm512_mask_blend_epi16(tiny, converted, fix);
+                }
+                _mm512_storeu_si512(heads + i, converted);
+            }
+            return i;
+        }
+#endif
+    }
+
+    inline bool hasAvx512Bf16()
+    {
+#if defined(MANSEG_DISPATCH)
+        static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx512bf16"));
+        return supported;
+#elif defined(MANSEG_HAS_AVX512BF16)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // out[i] = heads[i] widened to a float
+    inline void widenFloatHeads(const uint16_t* heads, const uint_fast64_t& n, float* out)
+    {
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::widenFloatHeadsAVX512(heads, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::widenFloatHeadsAVX2(heads, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = floatHeadToFloat(heads[i]);
+    }
+
+    // out[i] = float made up of heads[i] (upper 16 bits) and tails[i] (lower 16 bits)
+    inline void combineFloatSegments(const uint16_t* heads, const uint16_t* tails, const uint_fast64_t& n, float* out)
+    {
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::combineFloatSegmentsAVX512(heads, tails, n, out);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::combineFloatSegmentsAVX2(heads, tails, n, out);
+#endif
+        for(; i < n; ++i)
+            out[i] = floatSegmentsToFloat(heads[i], tails[i]);
+    }
+
+    // heads[i] and tails[i] = upper and lower 16 bits of in[i]
+    inline void splitFloatSegments(const float* in, const uint_fast64_t& n, uint16_t* heads, uint16_t* tails)
+    {
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512) i = simd::splitFloatSegmentsAVX512(in, n, heads, tails);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::splitFloatSegmentsAVX2(in, n, heads, tails);
+#endif
+        for(; i < n; ++i)
+            splitFloatSegment(in[i], heads + i, tails + i);
+    }
+
+    // heads[i] = upper 16 bits of in[i], rounded according to mode (truncated by default)
+    template<RoundingMode mode = ROUND_TRUNCATE>
+    inline void narrowToFloatHeads(const float* in, const uint_fast64_t& n, uint16_t* heads)
+    {
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX512)
+        if(level == SIMD_AVX512)
+        {
+#if defined(MANSEG_HAS_AVX512BF16)
+            if(mode == ROUND_NEAREST && hasAvx512Bf16())
+                i = simd::narrowToFloatHeadsNearestBF16(in, n, heads);
+#endif
+            i += simd::narrowToFloatHeadsAVX512<mode>(in + i, n - i, heads + i);
+        }
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2) i = simd::narrowToFloatHeadsAVX2<mode>(in, n, heads);
+#endif
+        for(; i < n; ++i)
+            heads[i] = roundToFloatHead<mode>(in[i]);
+    }
+
+    /*
+        A float array as a plane of 16 bit heads and one of 16 bit tails, accessed through the heads
+        only (useTail false: writes round to the head and leave the tail alone) or through both (exactly).
+        As TwoSegArray, it does not free its planes when it goes out of scope: use del.
+    */
+    template<bool useTail, class Allocator = SegmentAllocator>
+    class FloatTwoSegArray
+    {
+    public:
+        /* proxy for a single value, behaving like a float */
+        class Ref
+        {
+        public:
+            Ref(FloatTwoSegArray& a, const uint_fast64_t& id)
+                :a(a), id(id)
+            {}
+
+            operator float() const { return a.read(id); }
+
+            Ref& operator=(const float& f) { a.set(id, f); return *this; }
+            Ref& operator=(const Ref& o) { return *this = static_cast<float>(o); }
+
+            float operator+=(const float& f) { float t = *this; t += f; *this = t; return t; }
+            float operator-=(const float& f) { float t = *this; t -= f; *this = t; return t; }
+            float operator*=(const float& f) { float t = *this; t *= f; *this = t; return t; }
+            float operator/=(const float& f) { float t = *this; t /= f; *this = t; return t; }
+
+        private:
+            FloatTwoSegArray& a;
+            uint_fast64_t id;
+        };
+
+        FloatTwoSegArray()
+        {
+            heads = nullptr;
+            tails = nullptr;
+            length = 0;
+        }
+
+        FloatTwoSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :length(length), allocator(allocator)
+        {
+            heads = this->allocator.template allocate<uint16_t>(length, false);
+            tails = this->allocator.template allocate<uint16_t>(length, true); // initially zero tails
+        }
+
+        FloatTwoSegArray(uint16_t* heads, uint16_t* tails, const uint_fast64_t& length = 0, const Allocator& allocator = Allocator())
+            :heads(heads), tails(tails), length(length), allocator(allocator)
+        {}
+
+        ~FloatTwoSegArray() { }
+
+        Ref operator[](const uint_fast64_t& id) { return Ref(*this, id); }
+
+        /* sets value id to t: exactly with the tails, otherwise its head rounded according to mode */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t)
+        {
+            const float f = static_cast<float>(t);
+            if(useTail)
+                splitFloatSegment(f, heads + id, tails + id);
+            else
+                heads[id] = roundToFloatHead<mode>(f);
+        }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t)
+        {
+            splitFloatSegment(static_cast<float>(t), heads + id, tails + id);
+        }
+
+        float read(const uint_fast64_t& id) const
+        {
+            return useTail ? floatSegmentsToFloat(heads[id], tails[id]) : floatHeadToFloat(heads[id]);
+        }
+
+        /* out[i] = read(start + i) for n values, vectorised */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, float* out) const
+        {
+            if(useTail)
+                combineFloatSegments(heads + start, tails + start, n, out);
+            else
+                widenFloatHeads(heads + start, n, out);
+        }
+
+        /* set<mode>(start + i, in[i]) for n values, vectorised */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const float* in)
+        {
+            if(useTail)
+                splitFloatSegments(in, n, heads + start, tails + start);
+            else
+                narrowToFloatHeads<mode>(in, n, heads + start);
+        }
+
+        /* the same values, read and written through both segments */
+        FloatTwoSegArray<true, Allocator> createFullPrecision() const
+        {
+            return FloatTwoSegArray<true, Allocator>(heads, tails, length, allocator);
+        }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            heads = allocator.template allocate<uint16_t>(length, false);
+            tails = allocator.template allocate<uint16_t>(length, true);
+        }
+
+        bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+
+        uint_fast64_t size() const { return length; }
+
+        /* raw segment arrays, for kernels that operate on the segments directly */
+        uint16_t* getHeads() const { return heads; }
+        uint16_t* getTails() const { return tails; }
+
+        /*
+            Deletes the planes. Only one of the arrays sharing them (e.g. through createFullPrecision)
+            should call it.
+        */
+        void del()
+        {
+            if(heads != nullptr) allocator.deallocate(heads, length);
+            if(tails != nullptr) allocator.deallocate(tails, length);
+            heads = nullptr;
+            tails = nullptr;
+            length = 0;
+        }
+
+    private:
+        uint16_t* heads;
+        uint16_t* tails;
+        uint_fast64_t length;
+        Allocator allocator;
+    };
+
+    /* the promoted floats of a FloatSegArray, with the interface of the segment views (cf. FullView) */
+    class FloatFullView
+    {
+    public:
+        FloatFullView(float* full = nullptr, const uint_fast64_t& length = 0) :full(full), length(length) {}
+
+        float& operator[](const uint_fast64_t& id) { return full[id]; }
+
+        /* values are stored exactly, so mode has no effect */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) { full[id] = static_cast<float>(t); }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t) { full[id] = static_cast<float>(t); }
+
+        float read(const uint_fast64_t& id) const { return full[id]; }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, float* out) const
+        {
+            memcpy(out, full + start, n * sizeof(float));
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const float* in)
+        {
+            memcpy(full + start, in, n * sizeof(float));
+        }
+
+        float* getFull() const { return full; }
+        uint_fast64_t size() const { return length; }
+
+    private:
+        float* full;
+        uint_fast64_t length;
+    };
+
+    template<AccessLevel level, class Allocator = SegmentAllocator>
+    struct FloatLevelView;
+
+    template<class Allocator>
+    struct FloatLevelView<ACCESS_HEADS, Allocator>
+    {
+        using type = FloatTwoSegArray<false, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.heads; }
+    };
+
+    template<class Allocator>
+    struct FloatLevelView<ACCESS_PAIRS, Allocator>
+    {
+        using type = FloatTwoSegArray<true, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.pairs; }
+    };
+
+    template<class Allocator>
+    struct FloatLevelView<ACCESS_FULL, Allocator>
+    {
+        using type = FloatFullView;
+        template<class Array>
+        static type of(Array& a) { return FloatFullView(a.full, a.length); }
+    };
+
+    /*
+        The float counterpart of BasicManSegArray: heads and pairs share the two planes, and full holds
+        the floats once the array is promoted (copytoIEEEfloat). The array owns its storage: the
+        destructor frees whatever delSegments and del have not, and it can be moved or swapped but not
+        copied.
+    */
+    template<class Allocator = SegmentAllocator>
+    class BasicFloatSegArray
+    {
+    public:
+        using HeadsType = FloatTwoSegArray<false, Allocator>;
+        using PairsType = FloatTwoSegArray<true, Allocator>;
+
+        HeadsType heads;        // the bfloat16 heads: [sign(1), exp(8), mantissa(7)]
+        PairsType pairs;        // the floats, from both segments: [sign(1), exp(8), mantissa(23)]
+        float* full;            // the floats as an array, after copytoIEEEfloat (or allocFull)
+        uint_fast64_t length;
+
+        BasicFloatSegArray(const Allocator& allocator = Allocator())
+            :full(nullptr), length(0), allocator(allocator)
+        {}
+
+        BasicFloatSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :full(nullptr), length(0), allocator(allocator)
+        {
+            alloc(length);
+        }
+
+        ~BasicFloatSegArray()
+        {
+            delSegments();
+            del();
+        }
+
+        BasicFloatSegArray(const BasicFloatSegArray&) = delete;
+        BasicFloatSegArray& operator=(const BasicFloatSegArray&) = delete;
+
+        BasicFloatSegArray(BasicFloatSegArray&& other) noexcept
+            :heads(other.heads), pairs(other.pairs), full(other.full), length(other.length), allocator(other.allocator)
+        {
+            other.heads = HeadsType();
+            other.pairs = PairsType();
+            other.full = nullptr;
+            other.length = 0;
+        }
+
+        void swap(BasicFloatSegArray& other) noexcept
+        {
+            std::swap(heads, other.heads);
+            std::swap(pairs, other.pairs);
+            std::swap(full, other.full);
+            std::swap(length, other.length);
+            std::swap(allocator, other.allocator);
+        }
+
+        friend void swap(BasicFloatSegArray& a, BasicFloatSegArray& b) noexcept { a.swap(b); }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            heads = HeadsType(length, allocator);
+            pairs = heads.createFullPrecision();
+        }
+
+        /* views of the array at the given level (see LevelView); for ACCESS_FULL, full must be allocated */
+        template<AccessLevel level>
+        typename FloatLevelView<level, Allocator>::type read_as() { return FloatLevelView<level, Allocator>::of(*this); }
+
+        template<AccessLevel level>
+        typename FloatLevelView<level, Allocator>::type write_as() { return FloatLevelView<level, Allocator>::of(*this); }
+
+        /* allocates (uninitialised) space for the floats, without copying any values */
+        void allocFull()
+        {
+            full = allocator.template allocate<float>(length, false);
+        }
+
+        /*
+            The precision switch: the floats the heads and tails make up are copied into full, which is
+            allocated first if need be. The segments are kept; delSegments frees them.
+        */
+        void copytoIEEEfloat()
+        {
+            if(full == nullptr)
+                allocFull();
+            pairs.readBlock(0, length, full);
+        }
+
+        /* frees the heads and tails, shared by heads and pairs */
+        void delSegments()
+        {
+            heads.del();
+            pairs = PairsType();
+            if(full == nullptr) length = 0;
+        }
+
+        /* frees the floats of full */
+        void del()
+        {
+            if(full != nullptr) allocator.deallocate(full, length);
+            full = nullptr;
+            if(!heads.isAlloc()) length = 0;
+        }
+
+    private:
+        Allocator allocator;
+    };
+
+    using FloatSegArray = BasicFloatSegArray<>;
+}
+
+#endif
@@ -0,0 +1,269 @@
+/*
+	Grids of mantissa segmented blocks, allocated from a single slab.
+	Author: harunadess
+
+	A blocked computation (e.g. the NB x NB grid of the Jacobi stencil) that allocates every block
+	as its own ManSegArray makes three small allocations per block (heads, tails and full), scattered
+	through the heap: thousands of them, each touching its own pages, with poor TLB reach and no
+	control of which NUMA node they land on. ManSegGrid instead reserves one anonymous mapping for
+	the whole grid, advised to use transparent huge pages, and carves every block's planes from it
+	in block order (block (i, j)'s heads, tails and full doubles, then block (i, j + 1)'s), each
+	plane aligned to a cache line. The blocks are then zeroed a grid row at a time on the parallel
+	backend (see parallelFor), so each page is first touched by a worker, in the same chunks of rows
+	as a sweep that divides the rows with parallelFor.
+		ManSegGrid A(NB, NB, B * B);
+		A[i][j].heads[k] = x;	// block (i, j) is a BasicManSegArray<SlabAllocator>
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_GRID_H__
+#define __MANSEG_GRID_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /*
+        A region of memory handed out front to back, as the backing store of a ManSegGrid.
+        Unmapped (freed) when destroyed; nothing is freed before.
+    */
+    class Slab
+    {
+    public:
+        static const size_t alignment = 64;             // every allocation starts a cache line
+        static const size_t hugePage = 2 * 1024 * 1024; // the slab is a whole number of (aligned) huge pages
+
+        Slab() :base(nullptr), mapped(0), begin(nullptr), capacity(0), used(0) {}
+
+        explicit Slab(const size_t& bytes) :Slab() { reserve(bytes); }
+
+        ~Slab() { release(); }
+
+        Slab(const Slab&) = delete;
+        Slab& operator=(const Slab&) = delete;
+
+        /* maps at least bytes of zeroed memory, replacing any earlier reservation */
+        void reserve(const size_t& bytes)
+        {
+            release();
+            capacity = (bytes + hugePage - 1) / hugePage * hugePage;
+            used = 0;
+#if defined(__unix__) || defined(__APPLE__)
+            // one extra huge page to align the start to one
+            mapped = capacity + hugePage;
+            int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+            flags |= MAP_NORESERVE;
+#endif
+            base = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if(base == MAP_FAILED)
+            {
+                base = nullptr;
+                throw std::bad_alloc();
+            }
+            begin = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + hugePage - 1) & ~uintptr_t(hugePage - 1));
+#ifdef MADV_HUGEPAGE
+            madvise(begin, capacity, MADV_HUGEPAGE);
+#endif
+#else
+            mapped = capacity + alignment;
+            base = calloc(mapped, 1);
+            if(base == nullptr)
+                throw std::bad_alloc();
+            begin = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(base) + alignment - 1) & ~uintptr_t(alignment - 1));
+#endif
+            Memory::track(begin, capacity, Memory::PLANE_SLAB);
+        }
+
+        /* the next bytes of the slab, starting on a cache line */
+        void* take(const size_t& bytes)
+        {
+            size_t start = (used + alignment - 1) / alignment * alignment;
+            if(start + bytes > capacity)
+                throw std::bad_alloc();
+            used = start + bytes;
+            return begin + start;
+        }
+
+        /* bytes needed to take each of sizes in turn */
+        static size_t bytesFor(const std::vector<size_t>& sizes)
+        {
+            size_t total = 0;
+            for(size_t i = 0; i < sizes.size(); ++i)
+                total += (sizes[i] + alignment - 1) / alignment * alignment;
+            return total;
+        }
+
+        char* data() const { return begin; }
+        size_t size() const { return used; }
+
+    private:
+        void* base;         // the mapping, as returned by mmap
+        size_t mapped;
+        char* begin;        // its first aligned byte
+        size_t capacity;
+        size_t used;
+
+        void release()
+        {
+            if(base == nullptr) return;
+            Memory::untrack(begin);
+#if defined(__unix__) || defined(__APPLE__)
+            munmap(base, mapped);
+#else
+            free(base);
+#endif
+            base = nullptr;
+            begin = nullptr;
+            capacity = used = 0;
+        }
+    };
+
+    /*
+        Storage policy taking segments from a Slab. The slab is already zero, so zero needs no work,
+        and deallocate does nothing: the space is returned when the slab is.
+    */
+    struct SlabAllocator
+    {
+        Slab* slab;
+
+        SlabAllocator(Slab* slab = nullptr) :slab(slab) {}
+
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            if(slab == nullptr)
+                throw std::bad_alloc();
+            return reinterpret_cast<T*>(slab->take(length * sizeof(T)));
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length) {}
+    };
+
+    // the slab is recorded as a whole (see Slab::reserve), not block by block
+    inline void trackPlane(SlabAllocator&, const void*, const size_t&, const Memory::Plane&, const void*) {}
+    inline void untrackPlane(SlabAllocator&, const void*) {}
+
+    /*
+        rows x cols blocks of blockLength values each, as BasicManSegArray<SlabAllocator>s whose heads,
+        tails and (with withFull) full doubles all come from one slab, in block order. grid[i][j] is
+        block (i, j). The rows are first touched in the chunks of parallelFor over the rows, with a grain of one.
+        The grid owns its blocks and slab: it can be moved or swapped but not copied.
+    */
+    class ManSegGrid
+    {
+    public:
+        typedef BasicManSegArray<SlabAllocator> Block;
+
+        ManSegGrid() :numRows(0), numCols(0), slab(new Slab()) {}
+
+        ManSegGrid(const uint_fast64_t& rows, const uint_fast64_t& cols, const uint_fast64_t& blockLength, const bool& withFull = true)
+            :ManSegGrid()
+        {
+            alloc(rows, cols, blockLength, withFull);
+        }
+
+        ManSegGrid(const ManSegGrid&) = delete;
+        ManSegGrid& operator=(const ManSegGrid&) = delete;
+
+        ManSegGrid(ManSegGrid&& other) noexcept :ManSegGrid() { swap(other); }
+        ManSegGrid& operator=(ManSegGrid&& other) noexcept { swap(other); return *this; }
+
+        ~ManSegGrid()
+        {
+            // the blocks first, as they point into the slab
+            blocks.clear();
+        }
+
+        /* (re)allocates the grid, with its blocks zeroed */
+        void alloc(const uint_fast64_t& rows, const uint_fast64_t& cols, const uint_fast64_t& blockLength, const bool& withFull = true)
+        {
+            MANSEG_TRACE_SCOPE_ARG("ManSegGrid::alloc", "blocks", rows * cols);
+            blocks.clear();
+            numRows = rows;
+            numCols = cols;
+
+            std::vector<size_t> planes;
+            planes.push_back(blockLength * sizeof(float));
+            planes.push_back(blockLength * sizeof(float));
+            if(withFull)
+                planes.push_back(blockLength * sizeof(double));
+            const size_t blockBytes = Slab::bytesFor(planes);
+            slab->reserve(rows * cols * blockBytes);
+
+            // the addresses only: no page is touched until the loop below
+            blocks.reserve(rows * cols);
+            for(uint_fast64_t b = 0; b < rows * cols; ++b)
+            {
+                blocks.emplace_back(SlabAllocator(slab.get()));
+                blocks.back().alloc(blockLength);
+                if(withFull)
+                    blocks.back().allocFull();
+            }
+
+            char* start = slab->data();
+            parallelFor(rows, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                memset(start + begin * cols * blockBytes, 0, (end - begin) * cols * blockBytes);
+            }, 1);
+        }
+
+        uint_fast64_t rows() const { return numRows; }
+        uint_fast64_t cols() const { return numCols; }
+
+        /* row i of the grid: grid[i][j] is block (i, j) */
+        Block* operator[](const uint_fast64_t& i) { return &blocks[i * numCols]; }
+        Block& operator()(const uint_fast64_t& i, const uint_fast64_t& j) { return blocks[i * numCols + j]; }
+
+        /* bytes of the slab in use */
+        size_t bytes() const { return slab->size(); }
+
+        /* names the grid's slab in the memory report (see manseglib_memory.hpp); call it once allocated */
+        void label(const char* name) { Memory::label(slab->data(), name); }
+
+        void swap(ManSegGrid& other) noexcept
+        {
+            std::swap(numRows, other.numRows);
+            std::swap(numCols, other.numCols);
+            blocks.swap(other.blocks);
+            // the blocks keep pointing at their own slab, which is swapped with them
+            slab.swap(other.slab);
+        }
+
+        friend void swap(ManSegGrid& a, ManSegGrid& b) noexcept { a.swap(b); }
+
+    private:
+        uint_fast64_t numRows;
+        uint_fast64_t numCols;
+        std::vector<Block> blocks;
+        std::unique_ptr<Slab> slab;
+    };
+}
+
+#endif // __MANSEG_GRID_H__
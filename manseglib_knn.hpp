@@ -0,0 +1,205 @@
+/*
+	Nearest neighbour search over the rows of a ManSegMatrix, scanned at the heads and re-ranked at the pairs.
+	Author: harunadess
+
+	A brute force k-NN scan reads every value of the database once per query, so it is bound by
+	memory bandwidth. knnScan reads only the heads, 4 bytes a value rather than 8, and keeps the
+	k * oversample nearest rows by their heads distances in a bounded heap. Only those candidates
+	are read again at the pairs. Their exact distances pick the k returned, so the result is
+	exact whenever the true neighbours are among the candidates:
+		ManSegMatrix db(rows, dim);                                           // a row per embedding
+		std::vector<KnnNeighbour> nn = knnScan(db, query, 10, 4);            // the 10 nearest, nearest first
+		std::vector<KnnNeighbour> ip = knnScan(db, query, 10, 4, KNN_DOT);   // the 10 largest dot products
+	A head keeps 20 bits of mantissa, so a heads distance is within about 2^-20 of the exact one
+	relative to the norms. An oversample of a few is usually enough unless many rows are within
+	that of the k-th. The scan is split between the workers of the parallel backend by tile rows
+	of the matrix, 64 database rows each. Each chunk keeps a heap of its own, and the heaps are
+	merged before the re-rank. A tile row of heads is read by a vectorised kernel, AVX2 when the
+	CPU has it, that widens the heads and sums the squared differences (or the products) with
+	the query in doubles.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_KNN_H__
+#define __MANSEG_KNN_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_matrix.hpp"
+
+namespace ManSeg
+{
+    /* what knnScan compares rows by: the squared Euclidean distance, or the dot product, largest nearest */
+    enum KnnMetric
+    {
+        KNN_L2,
+        KNN_DOT
+    };
+
+    /* a row of the database and its distance to the query: for KNN_DOT, minus the dot product */
+    struct KnnNeighbour
+    {
+        uint_fast64_t row;
+        double distance;
+
+        bool operator<(const KnnNeighbour& other) const
+        {
+            return distance != other.distance ? distance < other.distance : row < other.row;
+        }
+    };
+
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* adds (heads[i] - x[i])^2 for the first multiple of 8 of n values to *sum; returns that count */
+        MANSEG_TARGET_AVX2 inline uint_fast64_t l2HeadsAVX2(const float* heads, const double* x, const uint_fast64_t& n, double* sum)
+        {
+            uint_fast64_t i = 0;
+            const __m256i zero = _mm256_setzero_si256();
+            __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i lo = _mm256_unpacklo_epi32(zero, h);
+                __m256i hi = _mm256_unpackhi_epi32(zero, h);
+                __m256d d0 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20)), _mm256_loadu_pd(x + i));
+                __m256d d1 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31)), _mm256_loadu_pd(x + i + 4));
+                s0 = _mm256_add_pd(s0, _mm256_mul_pd(d0, d0));
+                s1 = _mm256_add_pd(s1, _mm256_mul_pd(d1, d1));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+            *sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            return i;
+        }
+#endif
+    }
+
+    /* sum of (widened heads[i] - x[i])^2 over n values */
+    inline double l2Heads(const float* heads, const double* x, const uint_fast64_t& n)
+    {
+        double sum = 0.0;
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2 || level == SIMD_AVX512) i = simd::l2HeadsAVX2(heads, x, n, &sum);
+#endif
+        for(; i < n; ++i)
+        {
+            const double d = headToDouble(heads[i]) - x[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    /*
+        The k rows of db nearest to query (db.cols values) by metric, nearest first (all the rows if
+        there are fewer than k). The heads of every row are scanned for the k * oversample nearest,
+        and those are ranked by their distances at the pairs, which are the distances returned.
+        Equal distances are ranked by row.
+    */
+    template<class Allocator>
+    std::vector<KnnNeighbour> knnScan(const BasicManSegMatrix<Allocator>& db, const double* query, const uint_fast64_t& k,
+        const uint_fast64_t& oversample = 4, const KnnMetric& metric = KNN_L2)
+    {
+        const SegMatrixView<false>& heads = db.heads;
+        const uint_fast64_t rows = heads.numRows(), cols = heads.numCols();
+        const uint_fast64_t tileRows = heads.numTileRows(), tileCols = heads.numTileCols();
+        const uint_fast64_t candidates = std::min(rows, k * std::max<uint_fast64_t>(oversample, 1));
+        if(candidates == 0)
+            return std::vector<KnnNeighbour>();
+
+        // padded with zeros to whole tiles, as the rows are
+        std::vector<double> q(tileCols * MatrixTile, 0.0);
+        std::copy(query, query + cols, q.begin());
+
+        // each chunk's nearest candidates by their heads, in a heap with the farthest on top
+        const uint_fast64_t chunks = parallelChunks(tileRows, 1);
+        std::vector<std::vector<KnnNeighbour> > found(chunks);
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double distance[MatrixTile];
+            for(uint_fast64_t c = begin; c < end; ++c)
+            {
+                std::priority_queue<KnnNeighbour> heap;
+                for(uint_fast64_t ti = tileRows * c / chunks; ti < tileRows * (c + 1) / chunks; ++ti)
+                {
+                    std::fill(distance, distance + MatrixTile, 0.0);
+                    for(uint_fast64_t tj = 0; tj < tileCols; ++tj)
+                    {
+                        const float* tile = heads.getHeads() + (ti * tileCols + tj) * MatrixTileSize;
+                        const double* qt = q.data() + tj * MatrixTile;
+                        for(uint_fast64_t r = 0; r < MatrixTile; ++r)
+                            distance[r] += (metric == KNN_L2) ? l2Heads(tile + r * MatrixTile, qt, MatrixTile)
+                                : -dotHeads(tile + r * MatrixTile, qt, MatrixTile);
+                    }
+                    const uint_fast64_t r0 = ti * MatrixTile, m = std::min(MatrixTile, rows - r0);
+                    for(uint_fast64_t r = 0; r < m; ++r)
+                    {
+                        const KnnNeighbour n = { r0 + r, distance[r] };
+                        if(heap.size() < candidates)
+                            heap.push(n);
+                        else if(n < heap.top())
+                        {
+                            heap.pop();
+                            heap.push(n);
+                        }
+                    }
+                }
+                for(; !heap.empty(); heap.pop())
+                    found[c].push_back(heap.top());
+            }
+        }, 1);
+
+        std::vector<KnnNeighbour> nearest;
+        for(uint_fast64_t c = 0; c < chunks; ++c)
+            nearest.insert(nearest.end(), found[c].begin(), found[c].end());
+        if(nearest.size() > candidates)
+        {
+            std::nth_element(nearest.begin(), nearest.begin() + candidates, nearest.end());
+            nearest.resize(candidates);
+        }
+
+        // the candidates' distances at the pairs
+        parallelFor(nearest.size(), [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            std::vector<double> row(cols);
+            for(uint_fast64_t i = begin; i < end; ++i)
+            {
+                db.pairs.row(nearest[i].row).readBlock(0, cols, row.data());
+                double d = 0.0;
+                for(uint_fast64_t j = 0; j < cols; ++j)
+                    d += (metric == KNN_L2) ? (row[j] - query[j]) * (row[j] - query[j]) : -row[j] * query[j];
+                nearest[i].distance = d;
+            }
+        }, 16);
+        std::sort(nearest.begin(), nearest.end());
+        nearest.resize(std::min(k, nearest.size()));
+        return nearest;
+    }
+}
+
+#endif // __MANSEG_KNN_H__
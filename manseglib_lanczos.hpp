@@ -0,0 +1,730 @@
+/*
+	Power iteration and Lanczos eigensolvers on mantissa segmented vectors.
+	Author: harunadess
+
+	Both find extreme eigenpairs of a symmetric operator, given as a functor which overwrites y with
+	A x, on the views of its arguments' level:
+		struct Laplacian
+		{
+			template<class In, class Out>
+			void operator()(const PrecisionLevel& level, const In& x, Out&& y) { ... }
+		};
+		EigenOptions opts;
+		opts.wanted = 3;
+		EigenResult r = lanczos(n, op, start, opts);           // start: a ManSegArray, any nonzero values
+		r.values[0], r.residuals[0], r.switchedAt
+	Until the switch the operator is called with heads views (level PRECISION_HEADS), and after it with
+	pairs views (PRECISION_FULL), so an operator on a segmented matrix can read its heads until then
+	(see Matrix<Format, ACCESS_HEADS> and mat_increase_precision in the CG benchmark).
+	The Krylov vectors are ManSegArrays (or any BasicManSegArray, made by the make functor, e.g. a
+	PartitionedManSegArray for Ligra), read and written at the heads while the Ritz residuals are
+	above switchFactor times the precision of the heads (MaxSingleSegmentPrecision) relative to the
+	norm of the operator, as the heads cannot resolve them any further; the solver then restarts from
+	the sum of the wanted Ritz vectors, written at full precision, and carries on with the pairs.
+	Once the Lanczos basis holds opts.basis vectors it is restarted with the Ritz vectors of its
+	wanted half and the residual (thick restart). In place of full reorthogonalisation each new
+	Krylov vector is orthogonalised against the Ritz vectors which have converged far enough to cost
+	the basis its orthogonality (Parlett and Scott's selective reorthogonalisation): those are kept at
+	full precision but read through their heads, as semi-orthogonality needs much less than that.
+	powerIteration finds the dominant eigenpair alone, with one vector besides the start one.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_LANCZOS_H__
+#define __MANSEG_LANCZOS_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_blas.hpp"
+#include "manseglib_controller.hpp"
+
+namespace ManSeg
+{
+    struct EigenOptions
+    {
+        int maxIterations = 1000;   // products with the operator, over every restart
+        double tol = 1e-10;         // residual, relative to the norm of the operator, to converge at
+        double switchFactor = 10.0; // switch once the residuals are within this many heads precisions
+        int wanted = 1;             // eigenpairs to find (Lanczos)
+        bool largest = true;        // the largest eigenvalues, or else the smallest (Lanczos)
+        int basis = 40;             // Krylov vectors before a restart (Lanczos)
+        int checkEvery = 5;         // steps between eigendecompositions of the tridiagonal matrix (Lanczos)
+        int reorthogonalise = 4;    // good Ritz vectors to orthogonalise against, at most (Lanczos)
+    };
+
+    struct EigenResult
+    {
+        std::vector<double> values;     // wanted eigenvalues, the most extreme first
+        std::vector<double> residuals;  // bounds on ||A y - theta y|| for each
+        int iterations = 0;             // products with the operator
+        int restarts = 0;
+        int switchedAt = -1;            // products at the heads, or -1 if the solver never switched
+        bool converged = false;
+    };
+
+    /* makes the vectors of a solver; ManSegArrays unless the caller gives another */
+    template<class Array = ManSegArray>
+    struct MakeArray
+    {
+        Array* operator()(const uint_fast64_t& n) const { return new Array(n); }
+    };
+
+    /* the view of an array the solver works on at each level */
+    struct HeadsOf
+    {
+        template<class Array>
+        auto operator()(Array& a) const -> decltype((a.heads)) { return a.heads; }
+    };
+
+    struct PairsOf
+    {
+        template<class Array>
+        auto operator()(Array& a) const -> decltype((a.pairs)) { return a.pairs; }
+    };
+
+    /* ||y - theta x|| over the first n values */
+    template<class X, class Y>
+    inline double residualNorm(const uint_fast64_t& n, const Y& y, const double& theta, const X& x)
+    {
+        return sqrt(parallelReduce<double>(n, 0.0, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[blas::Block], b[blas::Block], s = 0.0;
+            for(uint_fast64_t i = begin; i < end; i += blas::Block)
+            {
+                const uint_fast64_t m = std::min(blas::Block, end - i);
+                x.readBlock(i, m, a);
+                y.readBlock(i, m, b);
+                for(uint_fast64_t k = 0; k < m; ++k)
+                    s += (b[k] - theta * a[k]) * (b[k] - theta * a[k]);
+            }
+            return s;
+        }, [](const double& a, const double& b) { return a + b; }));
+    }
+
+    namespace detail
+    {
+        /*
+            The implicit QL algorithm on the tridiagonal matrix with diagonal d and off diagonal e (e[i]
+            joins i and i + 1), as tql2 of EISPACK (and JAMA): d becomes the eigenvalues, ascending,
+            and the columns of z (n x n row major, the transformation so far) the eigenvectors.
+        */
+        inline void tql2(const int& n, std::vector<double>& d, std::vector<double>& e, std::vector<double>& z)
+        {
+            e.resize(n);
+            e[n - 1] = 0.0;
+
+            const double eps = 2.220446049250313e-16;
+            double f = 0.0, tst1 = 0.0;
+            for(int l = 0; l < n; ++l)
+            {
+                tst1 = std::max(tst1, fabs(d[l]) + fabs(e[l]));
+                int m = l;
+                while(m < n - 1 && fabs(e[m]) > eps * tst1)
+                    ++m;
+                if(m > l)
+                {
+                    do
+                    {
+                        double g = d[l];
+                        double p = (d[l + 1] - g) / (2.0 * e[l]);
+                        double r = hypot(p, 1.0);
+                        if(p < 0)
+                            r = -r;
+                        d[l] = e[l] / (p + r);
+                        d[l + 1] = e[l] * (p + r);
+                        const double dl1 = d[l + 1];
+                        double h = g - d[l];
+                        for(int i = l + 2; i < n; ++i)
+                            d[i] -= h;
+                        f += h;
+
+                        p = d[m];
+                        double c = 1.0, c2 = 1.0, c3 = 1.0, s = 0.0, s2 = 0.0;
+                        const double el1 = e[l + 1];
+                        for(int i = m - 1; i >= l; --i)
+                        {
+                            c3 = c2;
+                            c2 = c;
+                            s2 = s;
+                            g = c * e[i];
+                            h = c * p;
+                            r = hypot(p, e[i]);
+                            e[i + 1] = s * r;
+                            s = e[i] / r;
+                            c = p / r;
+                            p = c * d[i] - s * g;
+                            d[i + 1] = h + s * (c * g + s * d[i]);
+                            for(int k = 0; k < n; ++k)
+                            {
+                                double* row = &z[(size_t)k * n];
+                                h = row[i + 1];
+                                row[i + 1] = s * row[i] + c * h;
+                                row[i] = c * row[i] - s * h;
+                            }
+                        }
+                        p = -s * s2 * c3 * el1 * e[l] / dl1;
+                        e[l] = s * p;
+                        d[l] = c * p;
+                    }
+                    while(fabs(e[l]) > eps * tst1);
+                }
+                d[l] += f;
+                e[l] = 0.0;
+            }
+
+            // ascending, by selection, as the matrices are small
+            for(int i = 0; i < n - 1; ++i)
+            {
+                int k = i;
+                for(int j = i + 1; j < n; ++j)
+                    if(d[j] < d[k])
+                        k = j;
+                if(k != i)
+                {
+                    std::swap(d[i], d[k]);
+                    for(int j = 0; j < n; ++j)
+                        std::swap(z[(size_t)j * n + i], z[(size_t)j * n + k]);
+                }
+            }
+        }
+
+        /*
+            Householder reduction of the symmetric n x n a (row major) to tridiagonal form, as tred2 of
+            EISPACK (and JAMA): the diagonal in d, the off diagonal in e (e[i] joins i - 1 and i) and the
+            transformation in a.
+        */
+        inline void tred2(const int& n, std::vector<double>& a, std::vector<double>& d, std::vector<double>& e)
+        {
+            d.resize(n);
+            e.assign(n, 0.0);
+            auto v = [&](const int& i, const int& j) -> double& { return a[(size_t)i * n + j]; };
+            for(int j = 0; j < n; ++j)
+                d[j] = v(n - 1, j);
+
+            for(int i = n - 1; i > 0; --i)
+            {
+                double scale = 0.0, h = 0.0;
+                for(int k = 0; k < i; ++k)
+                    scale += fabs(d[k]);
+                if(scale == 0.0)
+                {
+                    e[i] = d[i - 1];
+                    for(int j = 0; j < i; ++j)
+                    {
+                        d[j] = v(i - 1, j);
+                        v(i, j) = 0.0;
+                        v(j, i) = 0.0;
+                    }
+                }
+                else
+                {
+                    for(int k = 0; k < i; ++k)
+                    {
+                        d[k] /= scale;
+                        h += d[k] * d[k];
+                    }
+                    double f = d[i - 1];
+                    double g = sqrt(h);
+                    if(f > 0)
+                        g = -g;
+                    e[i] = scale * g;
+                    h -= f * g;
+                    d[i - 1] = f - g;
+                    for(int j = 0; j < i; ++j)
+                        e[j] = 0.0;
+
+                    for(int j = 0; j < i; ++j)
+                    {
+                        f = d[j];
+                        v(j, i) = f;
+                        g = e[j] + v(j, j) * f;
+                        for(int k = j + 1; k <= i - 1; ++k)
+                        {
+                            g += v(k, j) * d[k];
+                            e[k] += v(k, j) * f;
+                        }
+                        e[j] = g;
+                    }
+                    f = 0.0;
+                    for(int j = 0; j < i; ++j)
+                    {
+                        e[j] /= h;
+                        f += e[j] * d[j];
+                    }
+                    const double hh = f / (h + h);
+                    for(int j = 0; j < i; ++j)
+                        e[j] -= hh * d[j];
+                    for(int j = 0; j < i; ++j)
+                    {
+                        f = d[j];
+                        g = e[j];
+                        for(int k = j; k <= i - 1; ++k)
+                            v(k, j) -= (f * e[k] + g * d[k]);
+                        d[j] = v(i - 1, j);
+                        v(i, j) = 0.0;
+                    }
+                }
+                d[i] = h;
+            }
+
+            // accumulate the transformations
+            for(int i = 0; i < n - 1; ++i)
+            {
+                v(n - 1, i) = v(i, i);
+                v(i, i) = 1.0;
+                const double h = d[i + 1];
+                if(h != 0.0)
+                {
+                    for(int k = 0; k <= i; ++k)
+                        d[k] = v(k, i + 1) / h;
+                    for(int j = 0; j <= i; ++j)
+                    {
+                        double g = 0.0;
+                        for(int k = 0; k <= i; ++k)
+                            g += v(k, i + 1) * v(k, j);
+                        for(int k = 0; k <= i; ++k)
+                            v(k, j) -= g * d[k];
+                    }
+                }
+                for(int k = 0; k <= i; ++k)
+                    v(k, i + 1) = 0.0;
+            }
+            for(int j = 0; j < n; ++j)
+            {
+                d[j] = v(n - 1, j);
+                v(n - 1, j) = 0.0;
+            }
+            v(n - 1, n - 1) = 1.0;
+
+            // as e[i] joining i and i + 1
+            for(int i = 1; i < n; ++i)
+                e[i - 1] = e[i];
+        }
+    }
+
+    /*
+        Eigenvalues (ascending, in d) and eigenvectors (the columns of z, n x n row major) of the
+        symmetric tridiagonal matrix with diagonal d and off diagonal e (e[i] joins i and i + 1). e is
+        destroyed.
+    */
+    inline void tridiagonalEigen(const int& n, std::vector<double>& d, std::vector<double>& e, std::vector<double>& z)
+    {
+        z.assign((size_t)n * n, 0.0);
+        for(int i = 0; i < n; ++i)
+            z[(size_t)i * n + i] = 1.0;
+        detail::tql2(n, d, e, z);
+    }
+
+    /*
+        Eigenvalues (ascending, in d) of the symmetric n x n a (row major), which is overwritten by
+        the eigenvectors, as its columns.
+    */
+    inline void symmetricEigen(const int& n, std::vector<double>& a, std::vector<double>& d)
+    {
+        std::vector<double> e;
+        detail::tred2(n, a, d, e);
+        detail::tql2(n, d, e, a);
+    }
+
+    /*
+        out.pairs = sum of c[j] * get(*basis[j]) for j < k, one block of every vector at a time, so out
+        is written once.
+    */
+    template<class Array, class Get>
+    inline void combineBasis(const uint_fast64_t& n, const double* c, const int& k,
+        const std::vector<std::unique_ptr<Array>>& basis, const Get& get, Array& out)
+    {
+        parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[blas::Block], s[blas::Block];
+            for(uint_fast64_t i = begin; i < end; i += blas::Block)
+            {
+                const uint_fast64_t m = std::min(blas::Block, end - i);
+                std::fill(s, s + m, 0.0);
+                for(int j = 0; j < k; ++j)
+                {
+                    get(*basis[j]).readBlock(i, m, a);
+                    for(uint_fast64_t l = 0; l < m; ++l)
+                        s[l] += c[j] * a[l];
+                }
+                out.pairs.writeBlock(i, m, s);
+            }
+        });
+    }
+
+    /*
+        Finds the dominant eigenpair of op by power iteration from x, which is left holding the
+        eigenvector (at full precision if the solver switched). The Rayleigh quotient theta = x . A x
+        of the normalised x is the eigenvalue, and ||A x - theta x|| its residual.
+    */
+    template<class Operator, class Array, class Make = MakeArray<Array>>
+    EigenResult powerIteration(const uint_fast64_t& n, Operator& op, Array& x, const EigenOptions& opts,
+        const Make& make = Make())
+    {
+        EigenResult result;
+        result.values.assign(1, 0.0);
+        result.residuals.assign(1, INFINITY);
+
+        std::unique_ptr<Array> y(make(n));
+        const double floor = opts.switchFactor * MaxSingleSegmentPrecision;
+        PrecisionLevel level = PRECISION_HEADS;
+        blas::scal(n, 1.0 / blas::nrm2(n, x.heads), x.heads);
+
+        while(result.iterations < opts.maxIterations)
+        {
+            double theta, r;
+            if(level == PRECISION_HEADS)
+            {
+                op(level, x.heads, y->heads);
+                theta = blas::dot(n, x.heads, y->heads);
+                r = residualNorm(n, y->heads, theta, x.heads);
+                blas::scal(n, 1.0 / blas::nrm2(n, y->heads), y->heads);
+            }
+            else
+            {
+                op(level, x.pairs, y->pairs);
+                theta = blas::dot(n, x.pairs, y->pairs);
+                r = residualNorm(n, y->pairs, theta, x.pairs);
+                blas::scal(n, 1.0 / blas::nrm2(n, y->pairs), y->pairs);
+            }
+            ++result.iterations;
+            result.values[0] = theta;
+            result.residuals[0] = r;
+
+            if(r <= opts.tol * fabs(theta))
+            {
+                result.converged = true;
+                break;
+            }
+            x.swap(*y);
+            if(level == PRECISION_HEADS && r <= floor * fabs(theta))
+            {
+                // the heads of x are its value, so its tails are cleared before they are read
+                for(uint_fast64_t i = 0; i < n; i += blas::Block)
+                {
+                    double a[blas::Block];
+                    const uint_fast64_t m = std::min(blas::Block, n - i);
+                    x.heads.readBlock(i, m, a);
+                    x.pairs.writeBlock(i, m, a);
+                }
+                level = PRECISION_FULL;
+                result.switchedAt = result.iterations;
+            }
+        }
+        return result;
+    }
+
+    namespace detail
+    {
+        /* state of a Lanczos run, shared by its cycles at each level */
+        template<class Array, class Make>
+        struct LanczosState
+        {
+            uint_fast64_t n;
+            const EigenOptions& opts;
+            const Make& make;
+            std::vector<std::unique_ptr<Array>> basis;
+            std::vector<std::unique_ptr<Array>> good;   // Ritz vectors to reorthogonalise against
+            std::unique_ptr<Array> w;
+            int ld;
+            std::vector<double> t;                      // the operator on the basis, ld x ld
+            double beta;                                // norm of the residual of the last step
+            std::vector<double> theta, s;               // eigenpairs of the k x k t
+            std::vector<int> wanted;                    // indices into theta, the most extreme first
+            int k;                                      // steps taken
+            int kept;                                   // Ritz vectors the basis was restarted with
+            double normT;
+
+            LanczosState(const uint_fast64_t& n, const EigenOptions& opts, const Make& make)
+                :n(n), opts(opts), make(make), basis(opts.basis + 1), ld(opts.basis + 1),
+                t((size_t)ld * ld, 0.0), beta(0.0), k(0), kept(0), normT(0.0)
+            {}
+
+            double& at(const int& i, const int& j) { return t[(size_t)i * ld + j]; }
+
+            double bound(const int& i) const { return fabs(beta * s[(size_t)(k - 1) * k + i]); }
+
+            /* index of the i-th Ritz value from the wanted end */
+            int extreme(const int& i) const { return opts.largest ? k - 1 - i : i; }
+
+            /* eigendecomposes the k x k t and picks the wanted Ritz values */
+            void decompose()
+            {
+                s.resize((size_t)k * k);
+                for(int i = 0; i < k; ++i)
+                    for(int j = 0; j < k; ++j)
+                        s[(size_t)i * k + j] = at(i, j);
+                symmetricEigen(k, s, theta);
+                normT = std::max(normT, std::max(fabs(theta[0]), fabs(theta[k - 1])));
+                wanted.clear();
+                for(int i = 0; i < std::min(opts.wanted, k); ++i)
+                    wanted.push_back(extreme(i));
+            }
+
+            /*
+                Coefficients of the Ritz vector i on the basis, or if i < 0 of the sum of the wanted
+                ones, each weighted by its residual so the least converged lead.
+            */
+            std::vector<double> ritz(const int& i) const
+            {
+                std::vector<double> c(k, 0.0);
+                for(int j = 0; j < k; ++j)
+                {
+                    if(i >= 0)
+                        c[j] = s[(size_t)j * k + i];
+                    else
+                        for(int l : wanted)
+                            c[j] += bound(l) * s[(size_t)j * k + l];
+                }
+                return c;
+            }
+
+            void clear()
+            {
+                std::fill(t.begin(), t.end(), 0.0);
+                good.clear();
+            }
+        };
+
+        /* the next vector of the basis, or false on an invariant subspace */
+        template<class Operator, class Array, class Make, class Get>
+        bool lanczosStep(LanczosState<Array, Make>& st, Operator& op, const PrecisionLevel& level, const Get& get)
+        {
+            const uint_fast64_t n = st.n;
+            const int j = st.k;
+            auto& w = get(*st.w);
+            op(level, get(*st.basis[j]), w);
+            // after a thick restart the first step is coupled to every kept Ritz vector, later ones only to the last
+            for(int i = j > st.kept ? j - 1 : 0; i < j; ++i)
+                blas::axpy(n, -st.at(i, j), get(*st.basis[i]), w);
+            const double a = blas::dot(n, get(*st.basis[j]), w);
+            blas::axpy(n, -a, get(*st.basis[j]), w);
+            for(auto& y : st.good)
+                blas::axpy(n, -blas::dot(n, y->heads, w), y->heads, w);
+            const double b = blas::nrm2(n, w);
+
+            st.at(j, j) = a;
+            st.beta = b;
+            st.k = j + 1;
+            if(b <= 1e-14 * std::max(st.normT, fabs(a)))
+                return false;
+
+            blas::scal(n, 1.0 / b, w);
+            if(j + 1 < st.ld - 1)
+                st.at(j, j + 1) = st.at(j + 1, j) = b;
+            std::swap(st.basis[j + 1], st.w);
+            if(!st.w)
+                st.w.reset(st.make(n));
+            return true;
+        }
+
+        /*
+            Keeps the Ritz vectors whose bound is below sqrt(eps) ||T||, for the precision eps of the
+            level, the most converged first, as the ones to reorthogonalise against.
+        */
+        template<class Array, class Make, class Get>
+        void selectGood(LanczosState<Array, Make>& st, const double& eps, const Get& get)
+        {
+            std::vector<int> order(st.k);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](const int& a, const int& b) { return st.bound(a) < st.bound(b); });
+            st.good.clear();
+            for(int i : order)
+            {
+                if((int)st.good.size() >= st.opts.reorthogonalise || st.bound(i) > sqrt(eps) * st.normT)
+                    break;
+                std::unique_ptr<Array> y(st.make(st.n));
+                const std::vector<double> c = st.ritz(i);
+                combineBasis(st.n, c.data(), st.k, st.basis, get, *y);
+                st.good.push_back(std::move(y));
+            }
+        }
+
+        /*
+            Restarts a full basis with the Ritz vectors of the half of the spectrum at the wanted end,
+            and the residual of the last step, as the thick restart of Wu and Simon: t becomes their
+            Ritz values, bordered by the couplings of each to the residual.
+        */
+        template<class Array, class Make, class Get>
+        void thickRestart(LanczosState<Array, Make>& st, const Get& get)
+        {
+            const int p = std::min(st.k - 1, std::max(st.opts.wanted + 1, st.opts.basis / 2));
+            std::vector<std::unique_ptr<Array>> kept(p);
+            for(int i = 0; i < p; ++i)
+            {
+                kept[i].reset(st.make(st.n));
+                const std::vector<double> c = st.ritz(st.extreme(i));
+                combineBasis(st.n, c.data(), st.k, st.basis, get, *kept[i]);
+            }
+            std::vector<double> theta(p), coupling(p);
+            for(int i = 0; i < p; ++i)
+            {
+                theta[i] = st.theta[st.extreme(i)];
+                coupling[i] = st.beta * st.s[(size_t)(st.k - 1) * st.k + st.extreme(i)];
+            }
+
+            // the old vectors are the spares for the steps to come
+            std::unique_ptr<Array> residual = std::move(st.basis[st.k]);
+            std::vector<std::unique_ptr<Array>> spare;
+            for(int i = 0; i < st.k; ++i)
+                spare.push_back(std::move(st.basis[i]));
+            for(int i = 0; i < p; ++i)
+                st.basis[i] = std::move(kept[i]);
+            st.basis[p] = std::move(residual);
+            for(int i = p + 1; i < st.ld && !spare.empty(); ++i)
+            {
+                st.basis[i] = std::move(spare.back());
+                spare.pop_back();
+            }
+
+            st.clear();
+            for(int i = 0; i < p; ++i)
+            {
+                st.at(i, i) = theta[i];
+                st.at(i, p) = st.at(p, i) = coupling[i];
+            }
+            st.k = st.kept = p;
+        }
+    }
+
+    /*
+        Finds opts.wanted extreme eigenpairs of op by thick restarted Lanczos, from start, which is
+        overwritten. If vectors is given, the Ritz vector of each eigenvalue is written to the pairs of
+        vectors[i].
+    */
+    template<class Operator, class Array, class Make = MakeArray<Array>>
+    EigenResult lanczos(const uint_fast64_t& n, Operator& op, Array& start, const EigenOptions& opts,
+        Array* vectors = nullptr, const Make& make = Make())
+    {
+        EigenResult result;
+        detail::LanczosState<Array, Make> st(n, opts, make);
+        st.basis[0].reset(make(n));
+        st.basis[0]->swap(start);
+        st.w.reset(make(n));
+
+        const HeadsOf heads;
+        const PairsOf pairs;
+        const double headsEps = MaxSingleSegmentPrecision, fullEps = 2.220446049250313e-16;
+        PrecisionLevel level = PRECISION_HEADS;
+        blas::scal(n, 1.0 / blas::nrm2(n, st.basis[0]->heads), st.basis[0]->heads);
+
+        while(true)
+        {
+            bool invariant = false, done = false, switching = false;
+            while(result.iterations < opts.maxIterations)
+            {
+                invariant = level == PRECISION_HEADS ? !detail::lanczosStep(st, op, level, heads)
+                    : !detail::lanczosStep(st, op, level, pairs);
+                ++result.iterations;
+                const bool full = st.k == opts.basis;
+                if(!invariant && !full && (st.k - st.kept) % opts.checkEvery != 0)
+                    continue;
+
+                st.decompose();
+                bool converged = invariant || (int)st.wanted.size() == opts.wanted;
+                bool nearFloor = converged;
+                for(int i : st.wanted)
+                {
+                    converged = converged && (invariant || st.bound(i) <= opts.tol * st.normT);
+                    nearFloor = nearFloor && st.bound(i) <= opts.switchFactor * headsEps * st.normT;
+                }
+                if(converged)
+                {
+                    done = true;
+                    break;
+                }
+                if(level == PRECISION_HEADS && nearFloor)
+                {
+                    switching = true;
+                    break;
+                }
+                if(full)
+                    break;
+                if(level == PRECISION_HEADS)
+                    detail::selectGood(st, headsEps, heads);
+                else
+                    detail::selectGood(st, fullEps, pairs);
+            }
+            if(!done && !switching)
+                st.decompose();
+
+            // the Ritz values found, and with done their vectors
+            result.values.clear();
+            result.residuals.clear();
+            for(int i : st.wanted)
+            {
+                result.values.push_back(st.theta[i]);
+                result.residuals.push_back(invariant ? 0.0 : st.bound(i));
+            }
+            if(done || result.iterations >= opts.maxIterations)
+            {
+                result.converged = done;
+                if(vectors)
+                    for(size_t i = 0; i < st.wanted.size(); ++i)
+                    {
+                        const std::vector<double> c = st.ritz(st.wanted[i]);
+                        if(level == PRECISION_HEADS)
+                            combineBasis(n, c.data(), st.k, st.basis, heads, vectors[i]);
+                        else
+                            combineBasis(n, c.data(), st.k, st.basis, pairs, vectors[i]);
+                    }
+                break;
+            }
+
+            if(!switching)
+            {
+                if(level == PRECISION_HEADS)
+                    detail::thickRestart(st, heads);
+                else
+                    detail::thickRestart(st, pairs);
+                ++result.restarts;
+                continue;
+            }
+
+            /*
+                The Ritz vectors of the heads hold only as much as the heads, so the pairs start afresh
+                from their sum, written at full precision.
+            */
+            const std::vector<double> c = st.ritz(-1);
+            std::unique_ptr<Array> v(make(n));
+            combineBasis(n, c.data(), st.k, st.basis, heads, *v);
+            level = PRECISION_FULL;
+            result.switchedAt = result.iterations;
+            st.basis[0] = std::move(v);
+            st.k = st.kept = 0;
+            st.clear();
+            blas::scal(n, 1.0 / blas::nrm2(n, st.basis[0]->pairs), st.basis[0]->pairs);
+        }
+
+        // hand the start array back, as the first basis vector, for the caller to free
+        start.swap(*st.basis[0]);
+        return result;
+    }
+}
+
+#endif // __MANSEG_LANCZOS_H__
@@ -0,0 +1,361 @@
+/*
+	Layouts of the segments in memory, as a policy of the segment arrays.
+	Author: harunadess
+
+	TwoSegArray keeps its heads and tails in two planes. A sweep of the heads reads only head lines,
+	but a value read in pairs touches two lines far apart, which is much of why pairs are slower than
+	doubles. BlockLayout<16> instead interleaves blocks: 16 heads (one 64 byte line), then their 16
+	tails, then the next 16 heads, so the two lines of a pair are adjacent and the adjacent line
+	prefetcher fetches them together. A sweep of the heads reads every other line, but the prefetchers
+	bring the tail lines in as well, so it costs about as much as a sweep of the pairs: the blocks suit
+	arrays that are mostly read in pairs at random (e.g. gathers after the switch), and the planes
+	arrays that spend most of their sweeps at the heads.
+		BlockManSegArray x(n);
+		x.heads.set<ROUND_NEAREST>(i, v);
+		double a = x.pairs.read(i);
+		x.copytoIEEEdouble();
+	LayoutTwoSegArray<useTail, Layout> has the interface of TwoSegArray<useTail> (operator[] with the
+	Head and Pair proxies, read, set<mode>, setPair, readBlock and writeBlock), and read_as/write_as
+	give the view of an AccessLevel, so kernels templated on their views (such as stencil5) run on
+	either layout. PlaneLayout is the layout of TwoSegArray, for comparison in the same class.
+	readBlock and writeBlock run the bulk kernels of manseglib.hpp on each stretch of consecutive
+	heads and tails: the whole range for planes, a block at a time for blocks.
+	The segments are one allocation, aligned to a cache line so that a block of heads is one line. The
+	tail placement of a storage policy (placeTails, provideTails, releaseTails) does not apply: it is
+	the heads and tails of a block that are together.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_LAYOUT_H__
+#define __MANSEG_LAYOUT_H__
+
+#include <algorithm>
+#include <utility>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* alignment of the segments of a LayoutTwoSegArray, in floats (a 64 byte line) */
+    constexpr uint_fast64_t LayoutAlignment = 16;
+
+    /*
+        A layout maps value id of an array of length values to the offsets of its head and tail in one
+        allocation of storage() floats, and gives the number of values from id on whose heads (and tails)
+        are consecutive, so the bulk kernels can run on them.
+    */
+
+    /* the heads, then the tails: the layout of TwoSegArray */
+    struct PlaneLayout
+    {
+        uint_fast64_t length;
+
+        explicit PlaneLayout(const uint_fast64_t& length = 0) :length(length) {}
+
+        uint_fast64_t storage() const { return 2 * length; }
+        uint_fast64_t head(const uint_fast64_t& id) const { return id; }
+        uint_fast64_t tail(const uint_fast64_t& id) const { return length + id; }
+        uint_fast64_t run(const uint_fast64_t& id) const { return length - id; }
+    };
+
+    /* blocks of Block heads followed by their Block tails; the last block is padded */
+    template<unsigned Block = 16>
+    struct BlockLayout
+    {
+        static_assert(Block > 0 && (Block & (Block - 1)) == 0, "the block must be a power of two");
+
+        uint_fast64_t length;
+
+        explicit BlockLayout(const uint_fast64_t& length = 0) :length(length) {}
+
+        uint_fast64_t storage() const { return 2 * ((length + Block - 1) & ~uint_fast64_t(Block - 1)); }
+        uint_fast64_t head(const uint_fast64_t& id) const { return 2 * (id & ~uint_fast64_t(Block - 1)) + (id & (Block - 1)); }
+        uint_fast64_t tail(const uint_fast64_t& id) const { return head(id) + Block; }
+        uint_fast64_t run(const uint_fast64_t& id) const { return Block - (id & (Block - 1)); }
+    };
+
+    /*
+        A TwoSegArray whose segments are placed by Layout. As TwoSegArray, useTail selects access to the
+        heads only or to both segments, createFullPrecision gives the other view of the same segments, and
+        the destructor does not free them: use del.
+    */
+    template<bool useTail, class Layout = BlockLayout<>, class Allocator = SegmentAllocator>
+    class LayoutTwoSegArray
+    {
+    public:
+        using Proxy = typename std::conditional<useTail, Pair, Head>::type;
+
+        LayoutTwoSegArray() :segments(nullptr), allocation(nullptr) {}
+
+        LayoutTwoSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :segments(nullptr), allocation(nullptr), allocator(allocator)
+        {
+            alloc(length);
+        }
+
+        /* a view of segments placed by layout; allocation is what del frees (segments, if null) */
+        LayoutTwoSegArray(float* segments, const Layout& layout, const Allocator& allocator = Allocator(), float* allocation = nullptr)
+            :segments(segments), allocation(allocation ? allocation : segments), layout(layout), allocator(allocator)
+        {}
+
+        ~LayoutTwoSegArray() { }
+
+        Proxy operator[](const uint_fast64_t& id) { return proxy(id, std::integral_constant<bool, useTail>()); }
+
+        /* sets value id to t: exactly with the tails, otherwise its head rounded according to mode */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t)
+        {
+            const double d = t;
+            if(useTail)
+                splitSegment(d, segments + layout.head(id), segments + layout.tail(id));
+            else
+                segments[layout.head(id)] = roundToHead<mode>(d);
+        }
+
+        template<typename T>
+        void setPair(const uint_fast64_t& id, const T& t)
+        {
+            splitSegment(t, segments + layout.head(id), segments + layout.tail(id));
+        }
+
+        double read(const uint_fast64_t& id) const
+        {
+            const float* head = segments + layout.head(id);
+            return useTail ? segmentsToDouble(*head, segments[layout.tail(id)]) : headToDouble(*head);
+        }
+
+        /* out[i] = read(start + i) for n values, vectorised on each run of consecutive segments */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            for(uint_fast64_t i = 0; i < n;)
+            {
+                const uint_fast64_t id = start + i;
+                const uint_fast64_t m = std::min(n - i, layout.run(id));
+                if(useTail)
+                    combineSegments(segments + layout.head(id), segments + layout.tail(id), m, out + i);
+                else
+                    widenHeads(segments + layout.head(id), m, out + i);
+                i += m;
+            }
+        }
+
+        /* set<mode>(start + i, in[i]) for n values, vectorised on each run of consecutive segments */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            for(uint_fast64_t i = 0; i < n;)
+            {
+                const uint_fast64_t id = start + i;
+                const uint_fast64_t m = std::min(n - i, layout.run(id));
+                if(useTail)
+                    splitSegments(in + i, m, segments + layout.head(id), segments + layout.tail(id));
+                else
+                    narrowToHeads<mode>(in + i, m, segments + layout.head(id));
+                i += m;
+            }
+        }
+
+        /* the same values, read and written through both segments */
+        LayoutTwoSegArray<true, Layout, Allocator> createFullPrecision() const
+        {
+            return LayoutTwoSegArray<true, Layout, Allocator>(segments, layout, allocator, allocation);
+        }
+
+        /* the segments, with zero tails (and heads), from the first line boundary of the allocation */
+        void alloc(const uint_fast64_t& length)
+        {
+            layout = Layout(length);
+            allocation = allocator.template allocate<float>(layout.storage() + LayoutAlignment, true);
+            const uintptr_t line = LayoutAlignment * sizeof(float);
+            segments = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(allocation) + line - 1) & ~(line - 1));
+        }
+
+        bool isAlloc() const { return segments != nullptr; }
+
+        uint_fast64_t size() const { return layout.length; }
+
+        /* the allocation and its layout, for kernels that operate on the segments directly */
+        float* getSegments() const { return segments; }
+        const Layout& getLayout() const { return layout; }
+
+        /*
+            Deletes the segments. Only one of the arrays sharing them (e.g. through createFullPrecision)
+            should call it.
+        */
+        void del()
+        {
+            if(allocation != nullptr) allocator.deallocate(allocation, layout.storage() + LayoutAlignment);
+            segments = nullptr;
+            allocation = nullptr;
+            layout = Layout();
+        }
+
+    private:
+        Pair proxy(const uint_fast64_t& id, std::true_type) { return Pair(segments + layout.head(id), segments + layout.tail(id)); }
+        Head proxy(const uint_fast64_t& id, std::false_type) { return Head(segments + layout.head(id)); }
+
+        float* segments;
+        float* allocation;
+        Layout layout;
+        Allocator allocator;
+    };
+
+    template<AccessLevel level, class Layout, class Allocator = SegmentAllocator>
+    struct LayoutLevelView;
+
+    template<class Layout, class Allocator>
+    struct LayoutLevelView<ACCESS_HEADS, Layout, Allocator>
+    {
+        using type = LayoutTwoSegArray<false, Layout, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.heads; }
+    };
+
+    template<class Layout, class Allocator>
+    struct LayoutLevelView<ACCESS_PAIRS, Layout, Allocator>
+    {
+        using type = LayoutTwoSegArray<true, Layout, Allocator>;
+        template<class Array>
+        static type of(Array& a) { return a.pairs; }
+    };
+
+    template<class Layout, class Allocator>
+    struct LayoutLevelView<ACCESS_FULL, Layout, Allocator>
+    {
+        using type = FullView;
+        template<class Array>
+        static type of(Array& a) { return FullView(a.full, a.length); }
+    };
+
+    /*
+        The counterpart of BasicManSegArray for a Layout: heads and pairs share the segments, and full
+        holds the doubles once the array is promoted (copytoIEEEdouble). The array owns its storage: the
+        destructor frees whatever delSegments and del have not, and it can be moved or swapped but not
+        copied.
+    */
+    template<class Layout = BlockLayout<>, class Allocator = SegmentAllocator>
+    class BasicLayoutManSegArray
+    {
+    public:
+        using HeadsType = LayoutTwoSegArray<false, Layout, Allocator>;
+        using PairsType = LayoutTwoSegArray<true, Layout, Allocator>;
+
+        HeadsType heads;        // the heads: [sign(1), exp(11), mantissa(20)]
+        PairsType pairs;        // the doubles, from both segments
+        double* full;           // the doubles as an array, after copytoIEEEdouble (or allocFull)
+        uint_fast64_t length;
+
+        BasicLayoutManSegArray(const Allocator& allocator = Allocator())
+            :full(nullptr), length(0), allocator(allocator)
+        {}
+
+        BasicLayoutManSegArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :full(nullptr), length(0), allocator(allocator)
+        {
+            alloc(length);
+        }
+
+        ~BasicLayoutManSegArray()
+        {
+            delSegments();
+            del();
+        }
+
+        BasicLayoutManSegArray(const BasicLayoutManSegArray&) = delete;
+        BasicLayoutManSegArray& operator=(const BasicLayoutManSegArray&) = delete;
+
+        BasicLayoutManSegArray(BasicLayoutManSegArray&& other) noexcept
+            :heads(other.heads), pairs(other.pairs), full(other.full), length(other.length), allocator(other.allocator)
+        {
+            other.heads = HeadsType();
+            other.pairs = PairsType();
+            other.full = nullptr;
+            other.length = 0;
+        }
+
+        void swap(BasicLayoutManSegArray& other) noexcept
+        {
+            std::swap(heads, other.heads);
+            std::swap(pairs, other.pairs);
+            std::swap(full, other.full);
+            std::swap(length, other.length);
+            std::swap(allocator, other.allocator);
+        }
+
+        friend void swap(BasicLayoutManSegArray& a, BasicLayoutManSegArray& b) noexcept { a.swap(b); }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            heads = HeadsType(length, allocator);
+            pairs = heads.createFullPrecision();
+        }
+
+        /* views of the array at the given level (see LevelView); for ACCESS_FULL, full must be allocated */
+        template<AccessLevel level>
+        typename LayoutLevelView<level, Layout, Allocator>::type read_as() { return LayoutLevelView<level, Layout, Allocator>::of(*this); }
+
+        template<AccessLevel level>
+        typename LayoutLevelView<level, Layout, Allocator>::type write_as() { return LayoutLevelView<level, Layout, Allocator>::of(*this); }
+
+        /* allocates (uninitialised) space for the doubles, without copying any values */
+        void allocFull()
+        {
+            full = allocator.template allocate<double>(length, false);
+        }
+
+        /*
+            The precision switch: the doubles the heads and tails make up are copied into full, which is
+            allocated first if need be. The segments are kept; delSegments frees them.
+        */
+        void copytoIEEEdouble()
+        {
+            if(full == nullptr)
+                allocFull();
+            pairs.readBlock(0, length, full);
+        }
+
+        /* frees the segments, shared by heads and pairs */
+        void delSegments()
+        {
+            heads.del();
+            pairs = PairsType();
+            if(full == nullptr) length = 0;
+        }
+
+        /* frees the doubles of full */
+        void del()
+        {
+            if(full != nullptr) allocator.deallocate(full, length);
+            full = nullptr;
+            if(!heads.isAlloc()) length = 0;
+        }
+
+    private:
+        Allocator allocator;
+    };
+
+    using BlockManSegArray = BasicLayoutManSegArray<BlockLayout<>>;
+}
+
+#endif
@@ -0,0 +1,186 @@
+/*
+	Mantissa segmented arrays saved to, and mapped from, segments files.
+	Author: harunadess
+
+	A segments file (see manseglib_results.hpp) keeps the heads and the tails of an array as two
+	planes, each starting at a page boundary. writeSegments saves a TwoSegArray's planes as they are
+	stored, without splitting any doubles, and mapSegments maps a file back as a heads array, of which
+	only the heads plane is mapped from the file at first:
+		writeSegments("ranks.seg", x.heads, n);                  // or x.pairs: the planes are the same
+		uint_fast64_t n;
+		MappedSegments ranks = mapSegments("ranks.seg", n);     // reads as a heads array
+		std::vector<uint_fast64_t> top = topK(ranks, n, 100);   // only touches the heads plane
+		MappedPairs exact = ranks.createFullPrecision();        // now maps the tails plane as well
+		ranks.del();
+	A consumer at heads precision so reads half the bytes of the doubles from storage, and one at full
+	precision pays for the tails when it calls createFullPrecision, once: the arrays it returns (and
+	copies of them) share the mapping. Until then the tails read as zero, as those of a heads array
+	never written at full precision, and anything written to them is lost when the file's tails are
+	mapped over them. The mappings are private, so writes to the array never reach the file; del()
+	unmaps both planes, and the file is closed when the last array using it is gone.
+	POSIX only (mmap).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_MAPPED_H__
+#define __MANSEG_MAPPED_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "manseglib.hpp"
+#include "manseglib_results.hpp"
+
+namespace ManSeg
+{
+    /* the tails plane of a mapped segments file, mapped over the array's zero tails on first use */
+    struct SegmentTailsSource
+    {
+        int fd;
+        uint64_t offset;    // of the tails plane in the file
+        std::once_flag once;
+
+        SegmentTailsSource(const int& fd, const uint64_t& offset) :fd(fd), offset(offset) {}
+        ~SegmentTailsSource() { close(fd); }
+
+        void map(float* tails, const uint_fast64_t& length)
+        {
+            std::call_once(once, [&]() {
+                const uint_fast64_t bytes = length * sizeof(float);
+                if(bytes == 0) return;
+                const uint64_t lead = offset % sysconf(_SC_PAGESIZE);
+                char* start = reinterpret_cast<char*>(tails) - lead;
+                void* mem = mmap(start, lead + bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset - lead);
+                // a file system that cannot map the file still has to provide the values
+                if(mem == MAP_FAILED && pread(fd, tails, bytes, offset) != (ssize_t)bytes)
+                    throw std::runtime_error("cannot read the tails of a segments file");
+            });
+        }
+    };
+
+    /*
+        Storage policy of arrays mapped from a segments file by mapSegments: the heads plane is mapped
+        from the file, the tails are anonymous zero pages until provideTails maps the file's tails over
+        them. Anything it allocates itself is an anonymous mapping, as with LazySegmentAllocator.
+    */
+    struct MappedSegmentAllocator
+    {
+        std::shared_ptr<SegmentTailsSource> source;     // none for arrays allocated rather than mapped
+
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            return LazySegmentAllocator().allocate<T>(length, zero);
+        }
+
+        /* unmaps ptr, which a mapping of a plane may start part way into a page */
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length)
+        {
+            const uintptr_t page = sysconf(_SC_PAGESIZE);
+            const uintptr_t lead = reinterpret_cast<uintptr_t>(ptr) % page;
+            munmap(reinterpret_cast<char*>(ptr) - lead, lead + (length == 0 ? 1 : length * sizeof(T)));
+        }
+    };
+
+    inline void provideTails(MappedSegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        if(allocator.source)
+            allocator.source->map(tails, length);
+    }
+
+    typedef TwoSegArray<false, MappedSegmentAllocator> MappedSegments;
+    typedef TwoSegArray<true, MappedSegmentAllocator> MappedPairs;
+
+    /* Writes the n values of a to path as a segments file, copying its heads and tails planes as they are */
+    template<bool useTail, class Allocator>
+    bool writeSegments(const char* path, const TwoSegArray<useTail, Allocator>& a, const uint_fast64_t& n)
+    {
+        FILE* f = beginSegments(path, n);
+        if(f == nullptr) return false;
+        const uint64_t headsEnd = segmentsHeadsOffset() + n * sizeof(float);
+        bool ok = fwrite(a.getHeads(), sizeof(float), n, f) == n
+            && padSegments(f, headsEnd, segmentsTailsOffset(n))
+            && fwrite(a.getTails(), sizeof(float), n, f) == n;
+        return (fclose(f) == 0) && ok;
+    }
+
+    /*
+        Maps the segments file at path as a heads array of its n values, mapping the tails plane only
+        once createFullPrecision is called. An empty array (isAlloc() false, n 0) if path is null,
+        missing, not a segments file, or shorter than its count says.
+    */
+    inline MappedSegments mapSegments(const char* path, uint_fast64_t& n)
+    {
+        n = 0;
+        if(path == nullptr || *path == '\0') return MappedSegments();
+        const int fd = open(path, O_RDONLY);
+        if(fd < 0) return MappedSegments();
+
+        char magic[sizeof(segmentsMagic)];
+        uint64_t count = 0;
+        struct stat info;
+        const bool whole = pread(fd, magic, sizeof(magic), 0) == sizeof(magic) && memcmp(magic, segmentsMagic, sizeof(magic)) == 0
+            && pread(fd, &count, sizeof(count), sizeof(magic)) == sizeof(count)
+            && fstat(fd, &info) == 0 && (uint64_t)info.st_size >= segmentsTailsOffset(count) + count * sizeof(float);
+        if(!whole)
+        {
+            close(fd);
+            return MappedSegments();
+        }
+
+        // the planes are page aligned in the file; on a larger page, a mapping starts part way into one
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        const uint64_t headsLead = segmentsHeadsOffset() % page;
+        const uint64_t tailsLead = segmentsTailsOffset(count) % page;
+        const uint64_t bytes = count == 0 ? 1 : count * sizeof(float);
+        void* heads = mmap(nullptr, headsLead + bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, segmentsHeadsOffset() - headsLead);
+        int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+        flags |= MAP_NORESERVE;
+#endif
+        void* tails = mmap(nullptr, tailsLead + bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if(heads == MAP_FAILED || tails == MAP_FAILED)
+        {
+            if(heads != MAP_FAILED) munmap(heads, headsLead + bytes);
+            if(tails != MAP_FAILED) munmap(tails, tailsLead + bytes);
+            close(fd);
+            return MappedSegments();
+        }
+
+        MappedSegmentAllocator allocator;
+        allocator.source = std::make_shared<SegmentTailsSource>(fd, segmentsTailsOffset(count));
+        n = count;
+        return MappedSegments(reinterpret_cast<float*>(static_cast<char*>(heads) + headsLead),
+            reinterpret_cast<float*>(static_cast<char*>(tails) + tailsLead), count, allocator);
+    }
+}
+
+#endif
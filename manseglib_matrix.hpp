@@ -0,0 +1,607 @@
+/*
+	Dense mantissa segmented matrices.
+	Author: harunadess
+
+	ManSegMatrix is the dense counterpart of ManSegArray: a rows x cols matrix in one allocation, its
+	heads plane followed by its tails plane, each stored tile by tile. A tile is MatrixTile x
+	MatrixTile values, row major, and the tiles are in row major order, padded with zeros at the
+	right and bottom edges. A tile is so one contiguous run of 16 KB of heads (and of tails), which a
+	product widens in one call of the bulk kernels, and any tile row or column of it is in one place:
+		ManSegMatrix A(rows, cols);
+		A.pairs.set(i, j, v);                                   // or A.heads.set<ROUND_NEAREST>(i, j, v)
+		A.heads.row(i).writeBlock(0, cols, values);             // a row (or column) is a view of a level
+		double d = blas::dot(cols, A.heads.row(i), x.pairs);
+		gemv(1.0, A.heads, x.pairs, 0.0, y.pairs);              // y = A x, reading 4 bytes a value of A
+		gemm(1.0, A.heads, B.heads, 0.0, C.pairs);              // C = A B
+	heads and pairs are views of the same segments, as those of a ManSegArray, with read, set<mode>,
+	operator() (giving the Head and Pair proxies), row and col; the rows and columns have read, set,
+	readBlock and writeBlock, so the blas:: operations and any kernel templated on its views take
+	them. A row is read a tile row (MatrixTile values) at a time with the SIMD kernels, a column a
+	value at a time. There is no full: the pairs are exact.
+	gemv at the heads multiplies the heads of each tile row with x directly (AVX2 when the CPU has
+	it), without widening them to a buffer first; at the pairs each tile row is combined into a
+	buffer. gemm packs A and B into widened micro-panels, as BLIS does, and sums in doubles with an
+	FMA micro-kernel, so at the heads it reads half the bytes of a DGEMM's operands. Both divide
+	their rows (or blocks) of the result between the workers of the parallel backend.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_MATRIX_H__
+#define __MANSEG_MATRIX_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* rows (and columns) of a tile of a ManSegMatrix */
+    constexpr uint_fast64_t MatrixTile = 64;
+
+    /* values of a tile */
+    constexpr uint_fast64_t MatrixTileSize = MatrixTile * MatrixTile;
+
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* adds heads[i] * x[i] for the first multiple of 8 of n values to *sum; returns that count */
+        MANSEG_TARGET_AVX2 inline uint_fast64_t dotHeadsAVX2(const float* heads, const double* x, const uint_fast64_t& n, double* sum)
+        {
+            uint_fast64_t i = 0;
+            const __m256i zero = _mm256_setzero_si256();
+            __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                __m256i lo = _mm256_unpacklo_epi32(zero, h);
+                __m256i hi = _mm256_unpackhi_epi32(zero, h);
+                __m256d a0 = _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x20));
+                __m256d a1 = _mm256_castsi256_pd(_mm256_permute2x128_si256(lo, hi, 0x31));
+                s0 = _mm256_add_pd(s0, _mm256_mul_pd(a0, _mm256_loadu_pd(x + i)));
+                s1 = _mm256_add_pd(s1, _mm256_mul_pd(a1, _mm256_loadu_pd(x + i + 4)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+            *sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+            return i;
+        }
+#endif
+    }
+
+    /* sum of the widened heads[i] * x[i] over n values */
+    inline double dotHeads(const float* heads, const double* x, const uint_fast64_t& n)
+    {
+        double sum = 0.0;
+        uint_fast64_t i = 0;
+        [[maybe_unused]] const SimdLevel level = simdLevel();
+#if defined(MANSEG_HAS_AVX2)
+        if(level == SIMD_AVX2 || level == SIMD_AVX512) i = simd::dotHeadsAVX2(heads, x, n, &sum);
+#endif
+        for(; i < n; ++i)
+            sum += headToDouble(heads[i]) * x[i];
+        return sum;
+    }
+
+    /*
+        A row or column of a ManSegMatrix, at the heads or (useTail) the pairs: value k is at
+        base + (k / MatrixTile) * tileStride + (k % MatrixTile) * step of each plane, so a row (step 1)
+        is in runs of a tile row and a column (step MatrixTile) is not. The view of a TwoSegArray of
+        its length, without the proxies.
+    */
+    template<bool useTail>
+    class SegMatrixLine
+    {
+    public:
+        SegMatrixLine(float* heads, float* tails, const uint_fast64_t& length, const uint_fast64_t& step, const uint_fast64_t& tileStride)
+            :heads(heads), tails(tails), length(length), step(step), tileStride(tileStride)
+        {}
+
+        uint_fast64_t size() const { return length; }
+
+        double read(const uint_fast64_t& k) const
+        {
+            const uint_fast64_t at = offset(k);
+            return useTail ? segmentsToDouble(heads[at], tails[at]) : headToDouble(heads[at]);
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& k, const T& t)
+        {
+            const uint_fast64_t at = offset(k);
+            if(useTail)
+                splitSegment(t, heads + at, tails + at);
+            else
+                heads[at] = roundToHead<mode>(static_cast<double>(t));
+        }
+
+        /* out[i] = read(start + i) for n values, vectorised on each tile row of a row */
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            for(uint_fast64_t i = 0; i < n;)
+            {
+                const uint_fast64_t k = start + i;
+                if(step != 1)
+                {
+                    out[i++] = read(k);
+                    continue;
+                }
+                const uint_fast64_t m = std::min(n - i, MatrixTile - k % MatrixTile);
+                if(useTail)
+                    combineSegments(heads + offset(k), tails + offset(k), m, out + i);
+                else
+                    widenHeads(heads + offset(k), m, out + i);
+                i += m;
+            }
+        }
+
+        /* set<mode>(start + i, in[i]) for n values, vectorised on each tile row of a row */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            for(uint_fast64_t i = 0; i < n;)
+            {
+                const uint_fast64_t k = start + i;
+                if(step != 1)
+                {
+                    set<mode>(k, in[i++]);
+                    continue;
+                }
+                const uint_fast64_t m = std::min(n - i, MatrixTile - k % MatrixTile);
+                if(useTail)
+                    splitSegments(in + i, m, heads + offset(k), tails + offset(k));
+                else
+                    narrowToHeads<mode>(in + i, m, heads + offset(k));
+                i += m;
+            }
+        }
+
+    private:
+        uint_fast64_t offset(const uint_fast64_t& k) const { return k / MatrixTile * tileStride + k % MatrixTile * step; }
+
+        float* heads;
+        float* tails;
+        uint_fast64_t length, step, tileStride;
+    };
+
+    /*
+        The values of a ManSegMatrix at the heads or (useTail) the pairs. A view: copies share the
+        segments, and the matrix frees them.
+    */
+    template<bool useTail>
+    class SegMatrixView
+    {
+    public:
+        using Proxy = typename std::conditional<useTail, Pair, Head>::type;
+
+        SegMatrixView() :heads(nullptr), tails(nullptr), rows(0), cols(0), tileCols(0) {}
+
+        SegMatrixView(float* heads, float* tails, const uint_fast64_t& rows, const uint_fast64_t& cols)
+            :heads(heads), tails(tails), rows(rows), cols(cols), tileCols((cols + MatrixTile - 1) / MatrixTile)
+        {}
+
+        Proxy operator()(const uint_fast64_t& i, const uint_fast64_t& j) { return proxy(offset(i, j), std::integral_constant<bool, useTail>()); }
+
+        double read(const uint_fast64_t& i, const uint_fast64_t& j) const
+        {
+            const uint_fast64_t at = offset(i, j);
+            return useTail ? segmentsToDouble(heads[at], tails[at]) : headToDouble(heads[at]);
+        }
+
+        /* sets value (i, j) to t: exactly with the tails, otherwise its head rounded according to mode */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& i, const uint_fast64_t& j, const T& t)
+        {
+            const uint_fast64_t at = offset(i, j);
+            if(useTail)
+                splitSegment(t, heads + at, tails + at);
+            else
+                heads[at] = roundToHead<mode>(static_cast<double>(t));
+        }
+
+        SegMatrixLine<useTail> row(const uint_fast64_t& i) const
+        {
+            const uint_fast64_t at = offset(i, 0);
+            return SegMatrixLine<useTail>(heads + at, tails + at, cols, 1, MatrixTileSize);
+        }
+
+        SegMatrixLine<useTail> col(const uint_fast64_t& j) const
+        {
+            const uint_fast64_t at = offset(0, j);
+            return SegMatrixLine<useTail>(heads + at, tails + at, rows, MatrixTile, tileCols * MatrixTileSize);
+        }
+
+        /* the MatrixTileSize values of tile (ti, tj), row major, with the zeros of the padding */
+        void readTile(const uint_fast64_t& ti, const uint_fast64_t& tj, double* out) const
+        {
+            const uint_fast64_t at = (ti * tileCols + tj) * MatrixTileSize;
+            if(useTail)
+                combineSegments(heads + at, tails + at, MatrixTileSize, out);
+            else
+                widenHeads(heads + at, MatrixTileSize, out);
+        }
+
+        /* writes a tile read by readTile, leaving the padding alone */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeTile(const uint_fast64_t& ti, const uint_fast64_t& tj, const double* in)
+        {
+            const uint_fast64_t width = std::min(MatrixTile, cols - tj * MatrixTile);
+            const uint_fast64_t height = std::min(MatrixTile, rows - ti * MatrixTile);
+            for(uint_fast64_t r = 0; r < height; ++r)
+            {
+                const uint_fast64_t at = (ti * tileCols + tj) * MatrixTileSize + r * MatrixTile;
+                if(useTail)
+                    splitSegments(in + r * MatrixTile, width, heads + at, tails + at);
+                else
+                    narrowToHeads<mode>(in + r * MatrixTile, width, heads + at);
+            }
+        }
+
+        /* the planes, tile by tile, for kernels that operate on the segments directly */
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+        uint_fast64_t numRows() const { return rows; }
+        uint_fast64_t numCols() const { return cols; }
+        uint_fast64_t numTileRows() const { return (rows + MatrixTile - 1) / MatrixTile; }
+        uint_fast64_t numTileCols() const { return tileCols; }
+
+        /* offset of value (i, j) in each plane */
+        uint_fast64_t offset(const uint_fast64_t& i, const uint_fast64_t& j) const
+        {
+            return (i / MatrixTile * tileCols + j / MatrixTile) * MatrixTileSize + i % MatrixTile * MatrixTile + j % MatrixTile;
+        }
+
+    private:
+        Pair proxy(const uint_fast64_t& at, std::true_type) { return Pair(heads + at, tails + at); }
+        Head proxy(const uint_fast64_t& at, std::false_type) { return Head(heads + at); }
+
+        float* heads;
+        float* tails;
+        uint_fast64_t rows, cols, tileCols;
+    };
+
+    /*
+        A rows x cols matrix of heads and tails in one zeroed allocation, aligned to a cache line. The
+        matrix owns it: the destructor frees it, and the matrix can be moved or swapped but not copied.
+    */
+    template<class Allocator = SegmentAllocator>
+    class BasicManSegMatrix
+    {
+    public:
+        SegMatrixView<false> heads;     // the heads: [sign(1), exp(11), mantissa(20)]
+        SegMatrixView<true> pairs;      // the doubles, from both segments
+        uint_fast64_t rows, cols;
+
+        BasicManSegMatrix(const Allocator& allocator = Allocator())
+            :rows(0), cols(0), allocation(nullptr), allocator(allocator)
+        {}
+
+        BasicManSegMatrix(const uint_fast64_t& rows, const uint_fast64_t& cols, const Allocator& allocator = Allocator())
+            :rows(0), cols(0), allocation(nullptr), allocator(allocator)
+        {
+            alloc(rows, cols);
+        }
+
+        ~BasicManSegMatrix() { del(); }
+
+        BasicManSegMatrix(const BasicManSegMatrix&) = delete;
+        BasicManSegMatrix& operator=(const BasicManSegMatrix&) = delete;
+
+        BasicManSegMatrix(BasicManSegMatrix&& other) noexcept
+            :heads(other.heads), pairs(other.pairs), rows(other.rows), cols(other.cols), allocation(other.allocation),
+            storage(other.storage), allocator(other.allocator)
+        {
+            other.heads = SegMatrixView<false>();
+            other.pairs = SegMatrixView<true>();
+            other.rows = other.cols = 0;
+            other.allocation = nullptr;
+        }
+
+        void swap(BasicManSegMatrix& other) noexcept
+        {
+            std::swap(heads, other.heads);
+            std::swap(pairs, other.pairs);
+            std::swap(rows, other.rows);
+            std::swap(cols, other.cols);
+            std::swap(allocation, other.allocation);
+            std::swap(storage, other.storage);
+            std::swap(allocator, other.allocator);
+        }
+
+        friend void swap(BasicManSegMatrix& a, BasicManSegMatrix& b) noexcept { a.swap(b); }
+
+        /* the segments of a rows x cols matrix, all zero (freeing any there were) */
+        void alloc(const uint_fast64_t& rows, const uint_fast64_t& cols)
+        {
+            del();
+            const uint_fast64_t plane = (rows + MatrixTile - 1) / MatrixTile * ((cols + MatrixTile - 1) / MatrixTile) * MatrixTileSize;
+            const uint_fast64_t line = 64 / sizeof(float);
+            storage = 2 * plane + line;
+            allocation = allocator.template allocate<float>(storage, true);
+            float* first = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(allocation) + 63) & ~uintptr_t(63));
+            this->rows = rows;
+            this->cols = cols;
+            heads = SegMatrixView<false>(first, first + plane, rows, cols);
+            pairs = SegMatrixView<true>(first, first + plane, rows, cols);
+        }
+
+        bool isAlloc() const { return allocation != nullptr; }
+
+        void del()
+        {
+            if(allocation != nullptr) allocator.deallocate(allocation, storage);
+            allocation = nullptr;
+            heads = SegMatrixView<false>();
+            pairs = SegMatrixView<true>();
+            rows = cols = 0;
+        }
+
+    private:
+        float* allocation;
+        uint_fast64_t storage;
+        Allocator allocator;
+    };
+
+    using ManSegMatrix = BasicManSegMatrix<>;
+
+    /*
+        y = alpha * A x + beta * y for A a level of a ManSegMatrix and x, y views of its columns and
+        rows (with readBlock and writeBlock). As in BLAS, y is not read when beta is 0.
+    */
+    template<bool useTail, class X, class Y>
+    inline void gemv(const double& alpha, const SegMatrixView<useTail>& A, const X& x, const double& beta, Y&& y)
+    {
+        const uint_fast64_t tileRows = A.numTileRows(), tileCols = A.numTileCols();
+        // padded with zeros to whole tiles
+        std::vector<double> xs(tileCols * MatrixTile, 0.0);
+        x.readBlock(0, A.numCols(), xs.data());
+
+        parallelFor(tileRows, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            double a[MatrixTile], out[MatrixTile];
+            for(uint_fast64_t ti = begin; ti < end; ++ti)
+            {
+                std::fill(out, out + MatrixTile, 0.0);
+                for(uint_fast64_t tj = 0; tj < tileCols; ++tj)
+                {
+                    const uint_fast64_t at = (ti * tileCols + tj) * MatrixTileSize;
+                    const double* xt = xs.data() + tj * MatrixTile;
+                    for(uint_fast64_t r = 0; r < MatrixTile; ++r)
+                    {
+                        const float* h = A.getHeads() + at + r * MatrixTile;
+                        if(useTail)
+                        {
+                            combineSegments(h, A.getTails() + at + r * MatrixTile, MatrixTile, a);
+                            double sum = 0.0;
+                            for(uint_fast64_t k = 0; k < MatrixTile; ++k)
+                                sum += a[k] * xt[k];
+                            out[r] += sum;
+                        }
+                        else
+                            out[r] += dotHeads(h, xt, MatrixTile);
+                    }
+                }
+                const uint_fast64_t r0 = ti * MatrixTile, m = std::min(MatrixTile, A.numRows() - r0);
+                if(beta != 0.0)
+                {
+                    y.readBlock(r0, m, a);
+                    for(uint_fast64_t r = 0; r < m; ++r)
+                        out[r] = alpha * out[r] + beta * a[r];
+                }
+                else
+                    for(uint_fast64_t r = 0; r < m; ++r)
+                        out[r] *= alpha;
+                y.writeBlock(r0, m, out);
+            }
+        }, 1);
+    }
+
+    /*
+        The blocking of gemm, after BLIS: C is made in blocks of GemmMC x GemmNC, each summed over
+        the inner dimension GemmKC at a time. For each step the block's rows of A are packed into
+        micro-panels of GemmMR rows and its columns of B into micro-panels of GemmNR columns, widened
+        to doubles and laid out in the order the micro-kernel reads them, which then sums a
+        GemmMR x GemmNR block of C in registers. A packed panel of A (144 KB) stays in L2, and one of
+        B (512 KB) in L3.
+    */
+    constexpr uint_fast64_t GemmMR = 6;
+    constexpr uint_fast64_t GemmNR = 8;
+    constexpr uint_fast64_t GemmKC = 256;
+    constexpr uint_fast64_t GemmMC = 12 * GemmMR;
+    constexpr uint_fast64_t GemmNC = 256;
+
+#if defined(MANSEG_DISPATCH) || (defined(MANSEG_X86) && defined(__AVX2__) && defined(__FMA__))
+#define MANSEG_HAS_FMA
+#endif
+
+    /* whether the CPU has FMA, for the micro-kernel (AVX2 CPUs all do, bar a few) */
+    inline bool fmaSupported()
+    {
+#if defined(MANSEG_DISPATCH)
+        __builtin_cpu_init();
+        static const bool fma = __builtin_cpu_supports("fma");
+        return fma;
+#elif defined(MANSEG_HAS_FMA)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    namespace simd
+    {
+#if defined(MANSEG_HAS_FMA)
+        /*
+            c[r * ldc + j] += sum over k of a[k * GemmMR + r] * b[k * GemmNR + j], for the packed
+            micro-panels a and b of kc steps: the 6 x 8 block of C is 12 registers of 4 doubles.
+        */
+        __attribute__((target("avx2,fma"))) inline void gemmKernelFMA(const uint_fast64_t& kc, const double* a, const double* b,
+            double* c, const uint_fast64_t& ldc)
+        {
+            __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd(), c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+            __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd(), c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+            __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd(), c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+            for(uint_fast64_t k = 0; k < kc; ++k, a += GemmMR, b += GemmNR)
+            {
+                const __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+                __m256d ar = _mm256_broadcast_sd(a);
+                c00 = _mm256_fmadd_pd(ar, b0, c00); c01 = _mm256_fmadd_pd(ar, b1, c01);
+                ar = _mm256_broadcast_sd(a + 1);
+                c10 = _mm256_fmadd_pd(ar, b0, c10); c11 = _mm256_fmadd_pd(ar, b1, c11);
+                ar = _mm256_broadcast_sd(a + 2);
+                c20 = _mm256_fmadd_pd(ar, b0, c20); c21 = _mm256_fmadd_pd(ar, b1, c21);
+                ar = _mm256_broadcast_sd(a + 3);
+                c30 = _mm256_fmadd_pd(ar, b0, c30); c31 = _mm256_fmadd_pd(ar, b1, c31);
+                ar = _mm256_broadcast_sd(a + 4);
+                c40 = _mm256_fmadd_pd(ar, b0, c40); c41 = _mm256_fmadd_pd(ar, b1, c41);
+                ar = _mm256_broadcast_sd(a + 5);
+                c50 = _mm256_fmadd_pd(ar, b0, c50); c51 = _mm256_fmadd_pd(ar, b1, c51);
+            }
+            const __m256d rows[GemmMR][2] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, { c30, c31 }, { c40, c41 }, { c50, c51 } };
+            for(uint_fast64_t r = 0; r < GemmMR; ++r)
+            {
+                double* cr = c + r * ldc;
+                _mm256_storeu_pd(cr, _mm256_add_pd(_mm256_loadu_pd(cr), rows[r][0]));
+                _mm256_storeu_pd(cr + 4, _mm256_add_pd(_mm256_loadu_pd(cr + 4), rows[r][1]));
+            }
+        }
+#endif
+    }
+
+    /* the micro-kernel: the FMA one where the CPU has it, else a loop over a block of sums */
+    inline void gemmKernel(const uint_fast64_t& kc, const double* a, const double* b, double* c, const uint_fast64_t& ldc)
+    {
+#if defined(MANSEG_HAS_FMA)
+        if(simdLevel() != SIMD_SSE2 && fmaSupported())
+        {
+            simd::gemmKernelFMA(kc, a, b, c, ldc);
+            return;
+        }
+#endif
+        double sums[GemmMR][GemmNR] = {};
+        for(uint_fast64_t k = 0; k < kc; ++k)
+            for(uint_fast64_t r = 0; r < GemmMR; ++r)
+                for(uint_fast64_t j = 0; j < GemmNR; ++j)
+                    sums[r][j] += a[k * GemmMR + r] * b[k * GemmNR + j];
+        for(uint_fast64_t r = 0; r < GemmMR; ++r)
+            for(uint_fast64_t j = 0; j < GemmNR; ++j)
+                c[r * ldc + j] += sums[r][j];
+    }
+
+    /*
+        Packs rows [i0, i0 + mc) and columns [k0, k0 + kc) of A into micro-panels of GemmMR rows,
+        each kc columns of GemmMR values, with rows past mc zero. row is scratch of kc values.
+    */
+    template<bool useTail>
+    inline void gemmPackA(const SegMatrixView<useTail>& A, const uint_fast64_t& i0, const uint_fast64_t& mc, const uint_fast64_t& k0,
+        const uint_fast64_t& kc, double* packed, double* row)
+    {
+        for(uint_fast64_t p = 0; p < mc; p += GemmMR)
+        {
+            double* panel = packed + p * kc;
+            for(uint_fast64_t r = 0; r < GemmMR; ++r)
+            {
+                if(p + r < mc)
+                    A.row(i0 + p + r).readBlock(k0, kc, row);
+                else
+                    std::fill(row, row + kc, 0.0);
+                for(uint_fast64_t k = 0; k < kc; ++k)
+                    panel[k * GemmMR + r] = row[k];
+            }
+        }
+    }
+
+    /*
+        Packs rows [k0, k0 + kc) and columns [j0, j0 + nc) of B into micro-panels of GemmNR columns,
+        each kc rows of GemmNR values, with columns past nc zero. row is scratch of nc values.
+    */
+    template<bool useTail>
+    inline void gemmPackB(const SegMatrixView<useTail>& B, const uint_fast64_t& k0, const uint_fast64_t& kc, const uint_fast64_t& j0,
+        const uint_fast64_t& nc, double* packed, double* row)
+    {
+        const uint_fast64_t panels = (nc + GemmNR - 1) / GemmNR;
+        for(uint_fast64_t k = 0; k < kc; ++k)
+        {
+            B.row(k0 + k).readBlock(j0, nc, row);
+            std::fill(row + nc, row + panels * GemmNR, 0.0);
+            for(uint_fast64_t q = 0; q < panels; ++q)
+                std::copy(row + q * GemmNR, row + (q + 1) * GemmNR, packed + (q * kc + k) * GemmNR);
+        }
+    }
+
+    /*
+        C = alpha * A B + beta * C for levels of ManSegMatrices, A rows x inner, B inner x cols and C
+        rows x cols. A and B are read at their levels, 4 bytes a value at the heads, and widened as
+        they are packed; the sums are in doubles, so the heads of A and B give the exact product of
+        those heads (up to the order of the sums), and a refinement step reads the pairs. C is read
+        (when beta is not 0) and written once, a row of a block at a time; writes to C's heads are
+        truncated, as with writeBlock. The blocks of C are divided between the workers of the
+        parallel backend, each packing its own panels of A and B.
+    */
+    template<bool useTailA, bool useTailB, bool useTailC>
+    inline void gemm(const double& alpha, const SegMatrixView<useTailA>& A, const SegMatrixView<useTailB>& B, const double& beta,
+        SegMatrixView<useTailC> C)
+    {
+        const uint_fast64_t m = C.numRows(), n = C.numCols(), inner = A.numCols();
+        const uint_fast64_t blockRows = (m + GemmMC - 1) / GemmMC, blockCols = (n + GemmNC - 1) / GemmNC;
+        parallelFor(blockRows * blockCols, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            // the sums of a block of C, in rows of GemmNC
+            const uint_fast64_t ldc = GemmNC;
+            std::vector<double> a(GemmMC * GemmKC), b(GemmKC * ldc), c(GemmMC * ldc), row(std::max(GemmKC, ldc));
+            for(uint_fast64_t t = begin; t < end; ++t)
+            {
+                const uint_fast64_t i0 = t / blockCols * GemmMC, j0 = t % blockCols * GemmNC;
+                const uint_fast64_t mc = std::min(GemmMC, m - i0), nc = std::min(GemmNC, n - j0);
+                std::fill(c.begin(), c.end(), 0.0);
+                for(uint_fast64_t k0 = 0; k0 < inner; k0 += GemmKC)
+                {
+                    const uint_fast64_t kc = std::min(GemmKC, inner - k0);
+                    gemmPackA(A, i0, mc, k0, kc, a.data(), row.data());
+                    gemmPackB(B, k0, kc, j0, nc, b.data(), row.data());
+                    for(uint_fast64_t p = 0; p < mc; p += GemmMR)
+                        for(uint_fast64_t q = 0; q < nc; q += GemmNR)
+                            gemmKernel(kc, a.data() + p * kc, b.data() + q * kc, c.data() + p * ldc + q, ldc);
+                }
+                for(uint_fast64_t r = 0; r < mc; ++r)
+                {
+                    double* cr = c.data() + r * ldc;
+                    if(beta != 0.0)
+                    {
+                        C.row(i0 + r).readBlock(j0, nc, row.data());
+                        for(uint_fast64_t j = 0; j < nc; ++j)
+                            cr[j] = alpha * cr[j] + beta * row[j];
+                    }
+                    else
+                        for(uint_fast64_t j = 0; j < nc; ++j)
+                            cr[j] *= alpha;
+                    C.row(i0 + r).writeBlock(j0, nc, cr);
+                }
+            }
+        }, 1);
+    }
+}
+
+#endif
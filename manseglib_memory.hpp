@@ -0,0 +1,364 @@
+/*
+	Footprint accounting for the planes of mantissa segmented arrays.
+	Author: harunadess
+
+	Jobs are sized by peak RSS, and it is easy to leave two copies of an array resident, e.g. the full
+	doubles of copytoIEEEdouble or promote alongside the heads and tails until delSegments. Built with
+	MANSEG_MEMORY=1, the library records every plane it allocates and frees: the heads, tails and full
+	doubles of TwoSegArray and BasicManSegArray (whatever their allocator policy, see trackPlane), the
+	contiguous segments of allocContiguous, and the slabs of ManSegGrid. An array's planes share an
+	owner (the address of its heads), which a driver can label:
+		ManSegArray p(n);
+		p.label("p_curr");
+		...
+		printf("%s", memoryReport().c_str());
+	The report lists each plane with its label, size, state and NUMA node. A plane is reserved until
+	one of its pages is resident, then touched, and freed once deallocated. It also gives the live and
+	peak bytes, and the planes of one owner that were live at the same time as its full doubles (a
+	transient double residency). Residency and nodes are read from the kernel when the report is made
+	(mincore, get_mempolicy; Linux only, elsewhere every live plane reads as reserved). The peak is
+	that of the bytes allocated, an upper bound on what the planes add to the RSS.
+	Without MANSEG_MEMORY (the default) nothing is recorded, and the report says so.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_MEMORY_H__
+#define __MANSEG_MEMORY_H__
+
+#ifndef MANSEG_MEMORY
+#define MANSEG_MEMORY 0
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#if MANSEG_MEMORY
+#include <map>
+#include <mutex>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace ManSeg
+{
+    namespace Memory
+    {
+        enum Plane { PLANE_HEADS, PLANE_TAILS, PLANE_FULL, PLANE_SEGMENTS, PLANE_SLAB, PLANE_BASE };
+        enum PlaneState { PLANE_RESERVED, PLANE_TOUCHED, PLANE_FREED };
+
+        inline const char* planeName(const Plane& plane)
+        {
+            static const char* names[] = { "heads", "tails", "full", "segments", "slab", "base" };
+            return names[plane];
+        }
+
+        inline const char* stateName(const PlaneState& state)
+        {
+            static const char* names[] = { "reserved", "touched", "freed" };
+            return names[state];
+        }
+
+        constexpr bool enabled = MANSEG_MEMORY != 0;
+
+        /*
+            A plane as last seen. allocated and freed are the plane's place in the sequence of
+            allocations and frees (freed is 0 while it is live), so lifetimes can be compared.
+            node is that of its first resident page, or -1; resident is its resident bytes, in
+            whole pages.
+        */
+        struct PlaneRecord
+        {
+            std::string label;
+            Plane plane;
+            const void* owner;
+            const void* address;
+            size_t bytes;
+            uint64_t allocated;
+            uint64_t freed;
+            PlaneState state;
+            int node;
+            size_t resident;
+        };
+
+#if MANSEG_MEMORY
+        /*
+            Every plane allocated since the start (or the last clear), with the live and peak bytes.
+            Planes are recorded as they are allocated and freed, under a lock, so any thread may do
+            either.
+        */
+        class Registry
+        {
+        public:
+            static Registry& get()
+            {
+                // never destroyed, as arrays with static storage may free their planes after it would be
+                static Registry* registry = new Registry();
+                return *registry;
+            }
+
+            /* a plane of owner (its own address if null) has been allocated at p */
+            void track(const void* p, const size_t& bytes, const Plane& plane, const void* owner)
+            {
+                if(p == nullptr) return;
+                std::lock_guard<std::mutex> lock(mutex);
+                PlaneRecord r;
+                r.owner = (owner != nullptr) ? owner : p;
+                std::map<const void*, std::string>::const_iterator l = labels.find(r.owner);
+                r.label = (l != labels.end()) ? l->second : std::string();
+                r.plane = plane;
+                r.address = p;
+                r.bytes = bytes;
+                r.allocated = ++events;
+                r.freed = 0;
+                r.state = PLANE_RESERVED;
+                r.node = -1;
+                r.resident = 0;
+                live[p] = history.size();
+                history.push_back(r);
+                liveBytes += bytes;
+                if(liveBytes > peakBytes) peakBytes = liveBytes;
+            }
+
+            /* the plane at p is being freed; planes not recorded (e.g. from a slab) are ignored */
+            void untrack(const void* p)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::map<const void*, size_t>::iterator it = live.find(p);
+                if(it == live.end()) return;
+                PlaneRecord& r = history[it->second];
+                r.freed = ++events;
+                r.state = PLANE_FREED;
+                liveBytes -= r.bytes;
+                const void* owner = r.owner;
+                live.erase(it);
+                // the label goes with the owner's last plane, so a later array at its address starts without one
+                for(it = live.begin(); it != live.end(); ++it)
+                    if(history[it->second].owner == owner) return;
+                labels.erase(owner);
+            }
+
+            /* the plane at p is now used as plane, e.g. segments transposed into full doubles in place */
+            void retype(const void* p, const Plane& plane)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::map<const void*, size_t>::iterator it = live.find(p);
+                if(it != live.end())
+                    history[it->second].plane = plane;
+            }
+
+            /*
+                Labels the live planes of owner, and those it allocates until its last is freed. owner
+                may also be the address of any of its live planes, e.g. of the full doubles once the
+                heads are gone.
+            */
+            void label(const void* owner, const char* name)
+            {
+                if(owner == nullptr) return;
+                std::lock_guard<std::mutex> lock(mutex);
+                std::map<const void*, size_t>::iterator plane = live.find(owner);
+                if(plane != live.end())
+                    owner = history[plane->second].owner;
+                labels[owner] = name;
+                for(std::map<const void*, size_t>::iterator it = live.begin(); it != live.end(); ++it)
+                    if(history[it->second].owner == owner)
+                        history[it->second].label = name;
+            }
+
+            /* every plane recorded, in order of allocation, with the residency and node of the live ones */
+            std::vector<PlaneRecord> records()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::vector<PlaneRecord> out(history);
+                for(size_t i = 0; i < out.size(); ++i)
+                    if(out[i].freed == 0)
+                        inspect(out[i]);
+                return out;
+            }
+
+            size_t current()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return liveBytes;
+            }
+
+            size_t peak()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return peakBytes;
+            }
+
+            /* starts a new watermark from the bytes live now, e.g. after the setup of a run */
+            void resetPeak()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                peakBytes = liveBytes;
+            }
+
+            /* forgets the freed planes */
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::vector<PlaneRecord> kept;
+                for(std::map<const void*, size_t>::iterator it = live.begin(); it != live.end(); ++it)
+                {
+                    kept.push_back(history[it->second]);
+                    it->second = kept.size() - 1;
+                }
+                history.swap(kept);
+            }
+
+        private:
+            std::mutex mutex;
+            std::vector<PlaneRecord> history;
+            std::map<const void*, size_t> live;     // address of each live plane to its record
+            std::map<const void*, std::string> labels;
+            uint64_t events;
+            size_t liveBytes;
+            size_t peakBytes;
+
+            Registry() :events(0), liveBytes(0), peakBytes(0) {}
+            Registry(const Registry&);
+            Registry& operator=(const Registry&);
+
+            /* the resident pages of a live plane, and the node of the first */
+            static void inspect(PlaneRecord& r)
+            {
+#if defined(__linux__)
+                const uintptr_t page = sysconf(_SC_PAGESIZE);
+                const uintptr_t start = reinterpret_cast<uintptr_t>(r.address) / page * page;
+                const uintptr_t end = reinterpret_cast<uintptr_t>(r.address) + r.bytes;
+                std::vector<unsigned char> pages((end - start + page - 1) / page);
+                if(pages.empty() || mincore(reinterpret_cast<void*>(start), end - start, pages.data()) != 0)
+                    return;
+                for(size_t i = 0; i < pages.size(); ++i)
+                    if(pages[i] & 1)
+                    {
+                        if(r.resident == 0)
+                        {
+                            // MPOL_F_NODE | MPOL_F_ADDR, from <numaif.h>
+                            int node = -1;
+                            if(syscall(SYS_get_mempolicy, &node, nullptr, 0, reinterpret_cast<void*>(start + i * page), 3UL) == 0)
+                                r.node = node;
+                        }
+                        r.resident += page;
+                    }
+                if(r.resident > 0)
+                    r.state = PLANE_TOUCHED;
+#endif
+            }
+        };
+
+        inline void track(const void* p, const size_t& bytes, const Plane& plane, const void* owner = nullptr) { Registry::get().track(p, bytes, plane, owner); }
+        inline void untrack(const void* p) { Registry::get().untrack(p); }
+        inline void retype(const void* p, const Plane& plane) { Registry::get().retype(p, plane); }
+        inline void label(const void* owner, const char* name) { Registry::get().label(owner, name); }
+        inline std::vector<PlaneRecord> records() { return Registry::get().records(); }
+        inline size_t currentBytes() { return Registry::get().current(); }
+        inline size_t peakBytes() { return Registry::get().peak(); }
+        inline void resetPeak() { Registry::get().resetPeak(); }
+        inline void clear() { Registry::get().clear(); }
+
+        /* the peak resident set of the process so far, in bytes (0 if unknown) */
+        inline size_t processPeakRSS()
+        {
+#if defined(__linux__)
+            struct rusage usage;
+            if(getrusage(RUSAGE_SELF, &usage) == 0)
+                return (size_t)usage.ru_maxrss * 1024;
+#endif
+            return 0;
+        }
+#else
+        inline void track(const void*, const size_t&, const Plane&, const void* = nullptr) {}
+        inline void untrack(const void*) {}
+        inline void retype(const void*, const Plane&) {}
+        inline void label(const void*, const char*) {}
+        inline std::vector<PlaneRecord> records() { return std::vector<PlaneRecord>(); }
+        inline size_t currentBytes() { return 0; }
+        inline size_t peakBytes() { return 0; }
+        inline void resetPeak() {}
+        inline void clear() {}
+        inline size_t processPeakRSS() { return 0; }
+#endif
+    }
+
+    /*
+        The planes recorded, one a line, then the live and peak bytes, and a line for each owner whose
+        full doubles were live at the same time as another of its planes.
+    */
+    inline std::string memoryReport()
+    {
+        if(!Memory::enabled)
+            return "memory report: built without MANSEG_MEMORY\n";
+
+        std::vector<Memory::PlaneRecord> planes = Memory::records();
+        std::string out;
+        char line[256];
+        snprintf(line, sizeof(line), "%-16s %-9s %14s %14s %-9s %5s\n", "label", "plane", "bytes", "resident", "state", "node");
+        out += line;
+        size_t resident = 0;
+        for(size_t i = 0; i < planes.size(); ++i)
+        {
+            const Memory::PlaneRecord& r = planes[i];
+            snprintf(line, sizeof(line), "%-16s %-9s %14zu %14zu %-9s %5d\n", r.label.empty() ? "-" : r.label.c_str(),
+                     Memory::planeName(r.plane), r.bytes, r.resident, Memory::stateName(r.state), r.node);
+            out += line;
+            resident += r.resident;
+        }
+        snprintf(line, sizeof(line), "live %zu bytes (%zu resident), peak %zu bytes; process peak RSS %zu bytes\n",
+                 Memory::currentBytes(), resident, Memory::peakBytes(), Memory::processPeakRSS());
+        out += line;
+
+        // planes of an owner whose lifetimes overlap those of its full doubles
+        for(size_t i = 0; i < planes.size(); ++i)
+        {
+            const Memory::PlaneRecord& full = planes[i];
+            if(full.plane != Memory::PLANE_FULL) continue;
+            size_t overlap = 0;
+            for(size_t j = 0; j < planes.size(); ++j)
+            {
+                const Memory::PlaneRecord& r = planes[j];
+                if(j == i || r.owner != full.owner || r.plane == Memory::PLANE_FULL) continue;
+                const bool before = r.freed != 0 && r.freed < full.allocated;
+                const bool after = full.freed != 0 && full.freed < r.allocated;
+                if(!before && !after)
+                    overlap += r.bytes;
+            }
+            if(overlap > 0)
+            {
+                snprintf(line, sizeof(line), "double residency: %s held %zu bytes of segments alongside %zu bytes of full doubles%s\n",
+                         full.label.empty() ? "-" : full.label.c_str(), overlap, full.bytes, full.freed == 0 ? " (still live)" : "");
+                out += line;
+            }
+        }
+        return out;
+    }
+}
+
+#endif // __MANSEG_MEMORY_H__
@@ -0,0 +1,366 @@
+/*
+	Geometric multigrid V-cycles on grids of mantissa segmented blocks.
+	Author: harunadess
+
+	Jacobi sweeps remove the error of a grid of N x N points a wavelength at a time, and need O(N^2)
+	of them for the smoothest. A V-cycle smooths the error with a few sweeps, carries the residual down
+	to a grid half the size, where the smooth error is rough again, corrects from there, and smooths
+	once more on the way back up, so that it reduces the error by a constant factor in O(N^2) work.
+	The problem is that of the Jacobi stencil, 4u - (the four neighbours of u) = f on the NB x NB blocks
+	of B x B points of a ManSegGrid, with zero outside the grid:
+		Multigrid mg(NB, B);
+		mg.rhs()[i][j].pairs[k] = f;    // and mg.solution() the starting guess, both zero by default
+		PrecisionController<ConfiguredPolicy> control(...);
+		while(...)
+			control.update(mg.vcycle(control.level()));
+	Every level is a pair of ManSegGrids (the sweeps go from one to the other) and a right hand side,
+	without the full doubles. The coarse levels hold corrections, which only need to be a few digits
+	right for the cycle to converge, and live entirely in their heads. The finest level is read and
+	written at the heads until the controller leaves them, and at the pairs from then on: its tails
+	are still zero from the allocation, so heads and zero tails are the values at the heads exactly
+	and the promotion moves no data.
+	The smoother is damped Jacobi (omega 0.8), stencilRow with a right hand side over a block widened
+	with its halo. Restriction sums the residuals of the four fine points of a coarse point (the
+	residual of the coarse operator, on a grid twice as coarse, is four times the average) and is fused
+	with the residual, so the residual is never stored. Prolongation is bilinear: a fine point gets
+	9/16 of its coarse point, 3/16 of each of the two nearest beside it and 1/16 of the one diagonal.
+	The blocks are halved down to MultigridOptions::minBlock points a side and then merged, halving the
+	blocks per side, until the grid can be halved no more (its side is odd, or less than 4); the
+	coarsest grid gets enough sweeps to solve it to about 2%.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_MULTIGRID_H__
+#define __MANSEG_MULTIGRID_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_controller.hpp"
+#include "manseglib_grid.hpp"
+#include "manseglib_stencil.hpp"
+
+namespace ManSeg
+{
+    struct MultigridOptions
+    {
+        int preSmooth = 2;              // sweeps before the restriction
+        int postSmooth = 2;             // and after the correction
+        uint_fast64_t minBlock = 8;     // the smallest block side the levels are halved to before they are merged
+        int coarseSweeps = 0;           // sweeps on the coarsest grid, 0 for (N + 1)^2 on N x N points
+    };
+
+    class Multigrid
+    {
+    public:
+        /* the levels of a grid of NB x NB blocks of B x B points, all zero */
+        Multigrid(const uint_fast64_t& NB, const uint_fast64_t& B, const MultigridOptions& options = MultigridOptions())
+            :opts(options)
+        {
+            // the zero boundary is a point beyond the finest grid, distance spacings from the edge points of a level
+            double distance = 1.0;
+            levels.emplace_back(NB, B, 0.0);
+            for(;;)
+            {
+                // by value, as emplace_back moves the levels
+                const uint_fast64_t nb = levels.back().nb, b = levels.back().b;
+                if(b % 2 != 0 || nb * b < 4)
+                    break;
+                // a coarse edge point is half a fine spacing in from the fine edge
+                distance = (distance + 0.5) / 2.0;
+                const double ghost = (distance - 1.0) / distance;
+                if(b / 2 >= opts.minBlock || nb == 1)
+                    levels.emplace_back(nb, b / 2, ghost);
+                else if(nb % 2 == 0)
+                    levels.emplace_back(nb / 2, b, ghost);
+                else
+                    break;
+            }
+            const uint_fast64_t n = levels.back().nb * levels.back().b;
+            if(opts.coarseSweeps <= 0)
+                opts.coarseSweeps = (int)((n + 1) * (n + 1));
+        }
+
+        uint_fast64_t numLevels() const { return levels.size(); }
+        /* points per side of level l, 0 the finest */
+        uint_fast64_t side(const uint_fast64_t& l) const { return levels[l].nb * levels[l].b; }
+        /* sweeps of level l so far */
+        uint_fast64_t sweeps(const uint_fast64_t& l) const { return levels[l].sweeps; }
+
+        /* the finest level's current values and right hand side, NB x NB blocks of B * B */
+        ManSegGrid& solution() { return levels[0].u; }
+        ManSegGrid& rhs() { return levels[0].f; }
+
+        /*
+            One V-cycle, with the finest level at the heads (PRECISION_HEADS) or the pairs (any other level).
+            Returns the largest residual |f - (4u - neighbours)| of the finest level after its pre-smoothing.
+        */
+        double vcycle(const PrecisionLevel& level)
+        {
+            return (level == PRECISION_HEADS) ? cycle<ACCESS_HEADS>() : cycle<ACCESS_PAIRS>();
+        }
+
+        /* the largest residual of the finest level, read at the heads or the pairs */
+        double residual(const PrecisionLevel& level)
+        {
+            return (level == PRECISION_HEADS) ? restrictResidual<ACCESS_HEADS>(0, false) : restrictResidual<ACCESS_PAIRS>(0, false);
+        }
+
+    private:
+        struct Level
+        {
+            uint_fast64_t nb;           // blocks per side
+            uint_fast64_t b;            // points per side of a block
+            ManSegGrid u, next, f;      // the values, the next sweep's and the right hand side
+            double ghost;               // the value outside the grid over the value of the point inside it
+            uint_fast64_t sweeps;
+
+            Level(const uint_fast64_t& nb, const uint_fast64_t& b, const double& ghost)
+                :nb(nb), b(b), u(nb, nb, b * b, false), next(nb, nb, b * b, false), f(nb, nb, b * b, false),
+                ghost(ghost), sweeps(0)
+            {}
+        };
+
+        MultigridOptions opts;
+        std::vector<Level> levels;
+
+        template<AccessLevel level>
+        static typename LevelView<level, SlabAllocator>::type view(ManSegGrid& g, const Level& l, const uint_fast64_t& row, const uint_fast64_t& col)
+        {
+            return LevelView<level, SlabAllocator>::of(g[row / l.b][col / l.b]);
+        }
+
+        /*
+            The h x w points of g from (row0, col0) into tile, stride w. The ring of points just outside the
+            grid are the ghosts, l.ghost times the point inside (l.ghost squared at a corner), so that the
+            zero boundary is where the finest level has it: the coarse levels' edge points are nearer to it
+            than a spacing (and without the ghosts each coarser level would move it further out). Points
+            further out are zero.
+        */
+        template<AccessLevel level>
+        static void loadRegion(ManSegGrid& g, const Level& l, const int64_t& row0, const int64_t& col0,
+            const int64_t& h, const int64_t& w, double* tile)
+        {
+            const int64_t n = l.nb * l.b;
+            std::fill(tile, tile + h * w, 0.0);
+            for(int64_t r = std::max<int64_t>(0, -row0); r < h && row0 + r < n; ++r)
+            {
+                const uint_fast64_t row = row0 + r;
+                for(int64_t col = std::max<int64_t>(0, col0); col < std::min(col0 + w, n);)
+                {
+                    // to the end of the block or of the region
+                    const int64_t run = std::min<int64_t>(l.b - col % l.b, col0 + w - col);
+                    view<level>(g, l, row, col).readBlock((row % l.b) * l.b + col % l.b, run, tile + r * w + col - col0);
+                    col += run;
+                }
+            }
+            if(l.ghost == 0.0)
+                return;
+            // the columns, then the rows with the corners
+            for(int64_t r = 0; r < h; ++r)
+            {
+                if(col0 < 0 && -col0 < w)
+                    tile[r * w - col0 - 1] = l.ghost * tile[r * w - col0];
+                if(n - col0 >= 1 && n - col0 < w)
+                    tile[r * w + n - col0] = l.ghost * tile[r * w + n - col0 - 1];
+            }
+            for(int64_t c = 0; c < w; ++c)
+            {
+                if(row0 < 0 && -row0 < h)
+                    tile[(-row0 - 1) * w + c] = l.ghost * tile[-row0 * w + c];
+                if(n - row0 >= 1 && n - row0 < h)
+                    tile[(n - row0) * w + c] = l.ghost * tile[(n - row0 - 1) * w + c];
+            }
+        }
+
+        /* count points of g from (row, col), within one block, from in */
+        template<AccessLevel level>
+        static void storeRun(ManSegGrid& g, const Level& l, const uint_fast64_t& row, const uint_fast64_t& col,
+            const uint_fast64_t& count, const double* in)
+        {
+            view<level>(g, l, row, col).writeBlock((row % l.b) * l.b + col % l.b, count, in);
+        }
+
+        /* sweeps of damped Jacobi on level k, from u into next and back; returns the largest change in the last */
+        template<AccessLevel level>
+        double smooth(const uint_fast64_t& k, const int& sweeps)
+        {
+            Level& l = levels[k];
+            const int64_t B = l.b, NB = l.nb, width = B + 2;
+            double delta = 0.0;
+            for(int s = 0; s < sweeps; ++s)
+            {
+                delta = parallelReduce<double>(NB, 0.0, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+                {
+                    double largest = 0.0;
+                    for(int64_t ii = (int64_t)begin; ii < (int64_t)end; ++ii)
+                    {
+                        static thread_local std::vector<double> buffers;
+                        buffers.resize(width * width + 2 * B);
+                        double* tile = buffers.data();
+                        double* f = tile + width * width;
+                        double* out = f + B;
+                        for(int64_t jj = 0; jj < NB; ++jj)
+                        {
+                            loadRegion<level>(l.u, l, ii * B - 1, jj * B - 1, width, width, tile);
+                            auto rhs = LevelView<level, SlabAllocator>::of(l.f[ii][jj]);
+                            auto result = LevelView<level, SlabAllocator>::of(l.next[ii][jj]);
+                            for(int64_t i = 0; i < B; ++i)
+                            {
+                                rhs.readBlock(i * B, B, f);
+                                const double* row = tile + (i + 1) * width;
+                                largest = std::max(largest, stencilRow(row - width, row, row + width, f, B, 0.2, out));
+                                result.writeBlock(i * B, B, out);
+                            }
+                        }
+                    }
+                    return largest;
+                }, [](const double& a, const double& b) { return std::max(a, b); }, 1);
+                l.u.swap(l.next);
+                l.sweeps++;
+            }
+            return delta;
+        }
+
+        /*
+            The residual of level k, read at level, summed over each 2 x 2 square of points into the right
+            hand side of level k + 1 (with store), whose values, the correction, are set to zero.
+            Returns the largest residual.
+        */
+        template<AccessLevel level>
+        double restrictResidual(const uint_fast64_t& k, const bool& store)
+        {
+            Level& l = levels[k];
+            Level* c = store ? &levels[k + 1] : nullptr;
+            const int64_t B = l.b, NB = l.nb, width = B + 2, half = B / 2;
+            return parallelReduce<double>(NB, 0.0, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                double largest = 0.0;
+                for(int64_t ii = (int64_t)begin; ii < (int64_t)end; ++ii)
+                {
+                    static thread_local std::vector<double> buffers;
+                    buffers.resize(width * width + B + half + 1);
+                    double* tile = buffers.data();
+                    double* f = tile + width * width;
+                    double* sums = f + B;
+                    const std::vector<double> zeros(half, 0.0);
+                    for(int64_t jj = 0; jj < NB; ++jj)
+                    {
+                        loadRegion<level>(l.u, l, ii * B - 1, jj * B - 1, width, width, tile);
+                        auto rhs = LevelView<level, SlabAllocator>::of(l.f[ii][jj]);
+                        for(int64_t i = 0; i < B; ++i)
+                        {
+                            rhs.readBlock(i * B, B, f);
+                            const double* row = tile + (i + 1) * width + 1;
+                            if(i % 2 == 0)
+                                std::fill(sums, sums + half, 0.0);
+                            for(int64_t j = 0; j < B; ++j)
+                            {
+                                const double r = f[j] - (4.0 * row[j] - row[j - 1] - row[j + 1] - row[j - width] - row[j + width]);
+                                largest = std::max(largest, fabs(r));
+                                if(c) sums[j / 2] += r;
+                            }
+                            if(c && i % 2 == 1)
+                            {
+                                const uint_fast64_t crow = (ii * B + i) / 2, ccol = jj * half;
+                                storeRun<ACCESS_HEADS>(c->f, *c, crow, ccol, half, sums);
+                                storeRun<ACCESS_HEADS>(c->u, *c, crow, ccol, half, zeros.data());
+                            }
+                        }
+                    }
+                }
+                return largest;
+            }, [](const double& a, const double& b) { return std::max(a, b); }, 1);
+        }
+
+        /* level k += the bilinear interpolation of the correction on level k + 1 */
+        template<AccessLevel level>
+        void prolong(const uint_fast64_t& k)
+        {
+            Level& l = levels[k];
+            Level& c = levels[k + 1];
+            const int64_t B = l.b, NB = l.nb, half = B / 2, width = half + 2;
+            parallelFor(NB, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(int64_t ii = (int64_t)begin; ii < (int64_t)end; ++ii)
+                {
+                    static thread_local std::vector<double> buffers;
+                    buffers.resize(width * width + B);
+                    double* tile = buffers.data();
+                    double* values = tile + width * width;
+                    for(int64_t jj = 0; jj < NB; ++jj)
+                    {
+                        // the coarse points under the block, with a ring of their neighbours
+                        loadRegion<ACCESS_HEADS>(c.u, c, ii * half - 1, jj * half - 1, width, width, tile);
+                        auto u = LevelView<level, SlabAllocator>::of(l.u[ii][jj]);
+                        for(int64_t i = 0; i < B; ++i)
+                        {
+                            const double* centre = tile + (i / 2 + 1) * width + 1;
+                            const double* beside = centre + ((i % 2) ? width : -width);
+                            u.readBlock(i * B, B, values);
+                            for(int64_t j = 0; j < B; ++j)
+                            {
+                                const int64_t cj = j / 2, nj = (j % 2) ? cj + 1 : cj - 1;
+                                values[j] += 0.5625 * centre[cj] + 0.1875 * (beside[cj] + centre[nj]) + 0.0625 * beside[nj];
+                            }
+                            u.writeBlock(i * B, B, values);
+                        }
+                    }
+                }
+            }, 1);
+        }
+
+        template<AccessLevel fine>
+        double cycle()
+        {
+            MANSEG_TRACE_SCOPE("Multigrid::vcycle");
+            const uint_fast64_t last = levels.size() - 1;
+            smooth<fine>(0, opts.preSmooth);
+            if(last == 0)
+            {
+                double r = restrictResidual<fine>(0, false);
+                smooth<fine>(0, opts.postSmooth);
+                return r;
+            }
+            const double r = restrictResidual<fine>(0, true);
+            for(uint_fast64_t k = 1; k < last; ++k)
+            {
+                smooth<ACCESS_HEADS>(k, opts.preSmooth);
+                restrictResidual<ACCESS_HEADS>(k, true);
+            }
+            smooth<ACCESS_HEADS>(last, opts.coarseSweeps);
+            for(uint_fast64_t k = last - 1; k > 0; --k)
+            {
+                prolong<ACCESS_HEADS>(k);
+                smooth<ACCESS_HEADS>(k, opts.postSmooth);
+            }
+            prolong<fine>(0);
+            smooth<fine>(0, opts.postSmooth);
+            return r;
+        }
+    };
+}
+
+#endif // __MANSEG_MULTIGRID_H__
@@ -0,0 +1,233 @@
+/*
+	Large page and NUMA node storage for mantissa segmented arrays, on Linux and on Windows.
+
+	Author: harunadess
+
+	PagedSegmentAllocator gives every plane of an array (heads, tails, full doubles) pages of its own
+	from the system, optionally large pages (2 MB on x86-64) to cut the TLB misses of sweeps over
+	arrays of many megabytes, and optionally preferring one NUMA node:
+		PagedSegmentAllocator pages = PagedSegmentAllocator::fromEnvironment();   // $MANSEG_LARGE_PAGES, $MANSEG_NODE
+		BasicManSegArray<PagedSegmentAllocator> x(n, pages);
+		x.allocFull();
+
+	On Linux the planes are anonymous mappings as with LazySegmentAllocator, taken from the huge page
+	pool (MAP_HUGETLB) when it has room and otherwise advised to use transparent huge pages; the node
+	is preferred with mbind (see preferNode). On Windows they come from VirtualAllocExNuma, with
+	MEM_LARGE_PAGES when the process can be given the "Lock pages in memory" privilege
+	(SeLockMemoryPrivilege, granted to the account through the local security policy). Windows large
+	pages are committed and locked when they are allocated, so, unlike everywhere else, untouched tails
+	take memory; without the privilege, or without enough contiguous memory, the allocation falls back
+	to ordinary pages with a warning. Either way the memory is zero-filled by the system.
+
+	With large pages every plane is rounded up to whole large pages, so this is meant for large arrays.
+	A node of -1 leaves the placement to the system (the node of the thread that first touches a page).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PAGES_H__
+#define __MANSEG_PAGES_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "manseglib.hpp"
+#if defined(__linux__)
+#include "manseglib_tiered.hpp"
+#endif
+
+namespace ManSeg
+{
+    /* prints message unless warned is set, then sets it: a fallback would otherwise be reported for every plane */
+    inline void warnPagesOnce(const char* message, bool& warned)
+    {
+        if(!warned)
+            fprintf(stderr, "PagedSegmentAllocator: %s\n", message);
+        warned = true;
+    }
+
+#if defined(_WIN32)
+    /*
+        Enables SeLockMemoryPrivilege in the process token, which MEM_LARGE_PAGES needs; false if the
+        account does not hold it. Tried once per process.
+    */
+    inline bool enableLargePages()
+    {
+        static const bool enabled = []()
+        {
+            HANDLE token;
+            if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+                return false;
+            TOKEN_PRIVILEGES tp;
+            tp.PrivilegeCount = 1;
+            tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool ok = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &tp.Privileges[0].Luid)
+                && AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr)
+                && GetLastError() == ERROR_SUCCESS;     // not ERROR_NOT_ALL_ASSIGNED
+            CloseHandle(token);
+            return ok && GetLargePageMinimum() > 0;
+        }();
+        return enabled;
+    }
+#endif
+
+    /*
+        Storage policy taking each plane from the system's pages: large pages if largePages is set and
+        the system provides them, on node if it is not -1 (see the top of the file).
+    */
+    struct PagedSegmentAllocator
+    {
+        bool largePages;
+        int node;
+
+        PagedSegmentAllocator(const bool& largePages = false, const int& node = -1)
+            :largePages(largePages), node(node)
+        {}
+
+        /* $MANSEG_LARGE_PAGES (non-zero for large pages) and $MANSEG_NODE */
+        static PagedSegmentAllocator fromEnvironment()
+        {
+            const char* large = getenv("MANSEG_LARGE_PAGES");
+            const char* node = getenv("MANSEG_NODE");
+            return PagedSegmentAllocator(large != nullptr && atoi(large) != 0,
+                (node != nullptr && *node != '\0') ? atoi(node) : -1);
+        }
+
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            void* p = allocateBytes(mappedBytes(length * sizeof(T)));
+            if(p == nullptr)
+                throw std::bad_alloc();
+            return reinterpret_cast<T*>(p);
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length)
+        {
+#if defined(_WIN32)
+            VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+            munmap(ptr, mappedBytes(length * sizeof(T)));
+#endif
+        }
+
+    private:
+#if defined(_WIN32)
+        size_t mappedBytes(const size_t& bytes) const
+        {
+            // VirtualAlloc rounds ordinary pages up itself
+            const size_t large = largePages ? GetLargePageMinimum() : 0;
+            const size_t b = bytes == 0 ? 1 : bytes;
+            return large > 0 ? (b + large - 1) / large * large : b;
+        }
+
+        void* allocateBytes(const size_t& bytes) const
+        {
+            static bool noPrivilege = false, noLargePages = false;
+            void* p = nullptr;
+            if(largePages)
+            {
+                if(enableLargePages())
+                {
+                    p = reserve(bytes, MEM_LARGE_PAGES);
+                    if(p == nullptr)
+                        warnPagesOnce("no contiguous memory for large pages; using ordinary pages", noLargePages);
+                }
+                else
+                    warnPagesOnce("cannot lock pages in memory (SeLockMemoryPrivilege); using ordinary pages", noPrivilege);
+            }
+            return p != nullptr ? p : reserve(bytes, 0);
+        }
+
+        void* reserve(const size_t& bytes, const DWORD& flags) const
+        {
+            const DWORD type = MEM_RESERVE | MEM_COMMIT | flags;
+            if(node >= 0)
+                return VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, type, PAGE_READWRITE, node);
+            return VirtualAlloc(nullptr, bytes, type, PAGE_READWRITE);
+        }
+#else
+        // the huge page size of x86-64 and of most arm64 kernels
+        static const size_t largePage = 2 * 1024 * 1024;
+
+        /* rounded whether or not the huge page pool had room, so deallocate unmaps what was mapped */
+        size_t mappedBytes(const size_t& bytes) const
+        {
+            const size_t b = bytes == 0 ? 1 : bytes;     // mmap does not accept 0 length mappings
+            return largePages ? (b + largePage - 1) / largePage * largePage : b;
+        }
+
+        void* allocateBytes(const size_t& bytes) const
+        {
+            int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+            flags |= MAP_NORESERVE;
+#endif
+            void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            // reserved, not MAP_NORESERVE: an empty pool must fail here rather than fault on first touch
+            if(largePages)
+                p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON | MAP_HUGETLB, -1, 0);
+#endif
+            if(p == MAP_FAILED)
+            {
+                p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+                if(p == MAP_FAILED)
+                    return nullptr;
+#ifdef MADV_HUGEPAGE
+                if(largePages)
+                    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+            }
+#if defined(__linux__)
+            static bool unplaced = false;
+            if(!preferNode(p, bytes, node))
+                warnPagesOnce("the kernel refused the node; the planes are placed by first touch", unplaced);
+#endif
+            return p;
+        }
+#endif
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    /* the planes are anonymous mappings, as for LazySegmentAllocator, so their pages can be given back */
+    inline void releaseTails(PagedSegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        discardPages(tails, length * sizeof(float));
+    }
+#endif
+
+    typedef BasicManSegArray<PagedSegmentAllocator> PagedManSegArray;
+}
+
+#endif
@@ -0,0 +1,579 @@
+/*
+	The parallel backend of the library's bulk operations.
+	Author: harunadess
+
+	Promotion (copytoIEEEdouble, demote, promoteInPlace), the parallel reductions of manseglib_expr.hpp,
+	parallelFill and parallelGather, and the loops over blocks and ranks of the other headers divide
+	their work into chunks with parallelFor and parallelReduce, which run on one backend, picked when
+	the library is compiled:
+		MANSEG_PARALLEL_FOR     defined as a parallel for keyword, e.g. Ligra's parallel_for or cilk_for,
+		                        so the library's work goes to the application's own scheduler
+		MANSEG_PARALLEL_CILK    cilk_for (Cilk Plus or OpenCilk)
+		MANSEG_PARALLEL_TBB     tbb::parallel_for (link with -ltbb)
+		MANSEG_PARALLEL_THREADS the library's own work stealing pool of std::threads (see ThreadPool),
+		                        with no runtime library to link
+		MANSEG_PARALLEL_SERIAL  none
+	Otherwise OpenMP is used if it is enabled (-fopenmp), and the operations are serial if not, as
+	before. An application built on Cilk or TBB should pick its own runtime, so the library's loops
+	do not start an OpenMP team next to it and oversubscribe the cores.
+	A call of parallelFor from inside a chunk (or from a pool thread) runs serially, except with
+	OpenMP, whose nested regions are serial by default anyway. parallelForPartitions keeps every chunk
+	within one part of a given partition of the range, e.g. the NUMA partitions of a Ligra graph.
+	The pool's threads, and OpenMP's with MANSEG_BIND=1, are bound to CPUs as ThreadTopology places
+	workers (manseglib_topology.hpp), on the nodes Ligra's partitioner puts their partitions on.
+	setParallelWorkers(k) runs the loops on k of the workers until it is lifted with 0, e.g. while a
+	phase that saturates memory bandwidth on few cores runs (see ThreadThrottle in
+	manseglib_throttle.hpp). With OpenMP it sets the number of threads of the calling thread's later
+	regions (omp_set_num_threads), the application's own included; the thread pool leaves the other
+	workers asleep. With Cilk, TBB or a parallel for macro it only lowers the number of chunks, as
+	their runtimes' workers cannot be parked from here.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PARALLEL_H__
+#define __MANSEG_PARALLEL_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib_topology.hpp"
+
+#if defined(MANSEG_PARALLEL_FOR)
+#define MANSEG_PARALLEL_MACRO
+#elif defined(MANSEG_PARALLEL_CILK) || defined(MANSEG_PARALLEL_TBB) || defined(MANSEG_PARALLEL_THREADS) || defined(MANSEG_PARALLEL_SERIAL)
+#elif defined(_OPENMP)
+#define MANSEG_PARALLEL_OPENMP
+#else
+#define MANSEG_PARALLEL_SERIAL
+#endif
+
+#if defined(MANSEG_PARALLEL_OPENMP)
+#include <omp.h>
+#elif defined(MANSEG_PARALLEL_CILK)
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#elif defined(MANSEG_PARALLEL_TBB)
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#elif defined(MANSEG_PARALLEL_THREADS)
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#elif defined(MANSEG_PARALLEL_MACRO)
+#include <thread>
+#endif
+
+namespace ManSeg
+{
+    /* fewest elements worth a chunk of their own; smaller loops run serially */
+    constexpr uint_fast64_t ParallelGrain = 4096;
+    /* chunks per worker, so that uneven chunks (e.g. with many promoted blocks) balance out */
+    constexpr uint_fast64_t ChunksPerWorker = 4;
+
+#if defined(MANSEG_PARALLEL_THREADS)
+    /*
+        Work stealing workers for parallelFor: by default one per CPU the process may run on, the
+        calling thread being the first (MANSEG_THREADS sets how many). On Linux each pool thread is
+        pinned to the CPU of its worker in ThreadTopology (unless MANSEG_PIN_THREADS=0), so it stays
+        on one NUMA node, the node of the partitions it owns in parallelForPartitions.
+        Every worker has a deque of ranges of chunks. A run seeds each worker with the chunks it owns,
+        the same ones on every run of the same size, so the pages a chunk first touched stay on the
+        node of the worker that goes on using them. A worker splits the newest range of its deque in
+        halves until it has a single chunk to run; an idle worker steals the oldest (largest) range of
+        another, trying the workers on its own node first. One run goes at a time; runs from other
+        threads wait, and runs from inside a chunk are serial.
+    */
+    class ThreadPool
+    {
+    public:
+        static ThreadPool& instance()
+        {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        unsigned workers() const { return static_cast<unsigned>(queues.size()); }
+
+        /* runs from now on use workers 0 to count - 1 (all of them for 0); the others stay asleep */
+        void limit(const unsigned& count)
+        {
+            std::lock_guard<std::mutex> one(running);
+            active = (count == 0) ? workers() : std::min(count, workers());
+        }
+
+        /* NUMA node of worker w (that of the thread which created the pool, for worker 0) */
+        int node(const unsigned& w) const { return queues[w].node; }
+
+        /*
+            Runs body(c) for every chunk c in [0, chunks). Without firsts, worker w owns the chunks
+            [chunks * w / workers, chunks * (w + 1) / workers); with them, the chunks of part p,
+            [firsts[p], firsts[p + 1]), are owned by worker p * workers / parts.
+        */
+        template<class Body>
+        void run(const uint_fast64_t& chunks, const Body& body, const uint_fast64_t* firsts = nullptr, const uint_fast64_t& parts = 0)
+        {
+            if(inChunk() || threads.empty())
+            {
+                for(uint_fast64_t c = 0; c < chunks; ++c)
+                    body(c);
+                return;
+            }
+            std::lock_guard<std::mutex> one(running);
+            Job<Body> job(body);
+            const uint_fast64_t w = active;
+            if(firsts == nullptr)
+                for(uint_fast64_t k = 0; k < w; ++k)
+                    push(static_cast<unsigned>(k), Range{ chunks * k / w, chunks * (k + 1) / w });
+            else
+                for(uint_fast64_t p = 0; p < parts; ++p)
+                    push(static_cast<unsigned>(p * w / parts), Range{ firsts[p], firsts[p + 1] });
+            remaining.store(chunks, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = &job;
+                runWorkers = active;
+                busy = static_cast<unsigned>(threads.size());
+                generation.fetch_add(1, std::memory_order_release);
+            }
+            wake.notify_all();
+            work(0, job);
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return busy == 0; });
+            current = nullptr;
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+                generation.fetch_add(1, std::memory_order_release);
+            }
+            wake.notify_all();
+            for(auto& t : threads)
+                t.join();
+        }
+
+    private:
+        struct JobBase
+        {
+            virtual void chunk(const uint_fast64_t& c) const = 0;
+            virtual ~JobBase() {}
+        };
+
+        template<class Body>
+        struct Job : JobBase
+        {
+            const Body& body;
+            explicit Job(const Body& body) :body(body) {}
+            void chunk(const uint_fast64_t& c) const { body(c); }
+        };
+
+        struct Range
+        {
+            uint_fast64_t begin, end;
+        };
+
+        /* a worker's deque, on a line of its own */
+        struct alignas(64) Queue
+        {
+            std::mutex lock;
+            std::deque<Range> ranges;
+            int node = 0;
+            std::vector<unsigned> victims;  // the other workers, those on the same node first
+        };
+
+        ThreadPool()
+        {
+            const ThreadTopology& topology = ThreadTopology::instance();
+            unsigned count = std::max(1u, topology.cpus());
+            const char* threadsVar = getenv("MANSEG_THREADS");
+            if(threadsVar != nullptr && atoi(threadsVar) > 0)
+                count = static_cast<unsigned>(atoi(threadsVar));
+            const char* pinVar = getenv("MANSEG_PIN_THREADS");
+            const bool pin = pinVar == nullptr || atoi(pinVar) != 0;
+
+            queues = std::vector<Queue>(count);
+            active = count;
+            queues[0].node = currentNode();
+            unsigned started = 0;
+            for(unsigned t = 1; t < count; ++t)
+                threads.emplace_back([this, t, count, pin, &topology, &started]()
+                {
+                    if(pin) topology.bind(t, count);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        queues[t].node = currentNode();
+                        ++started;
+                    }
+                    done.notify_one();
+                    loop(t);
+                });
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [&]() { return started == count - 1; });
+            }
+
+            for(unsigned w = 0; w < count; ++w)
+                for(int local = 1; local >= 0; --local)
+                    for(unsigned k = 1; k < count; ++k)
+                    {
+                        const unsigned v = (w + k) % count;
+                        if((queues[v].node == queues[w].node) == (local == 1))
+                            queues[w].victims.push_back(v);
+                    }
+        }
+
+        static int currentNode()
+        {
+#if defined(__linux__) && defined(SYS_getcpu)
+            unsigned cpu = 0, node = 0;
+            if(syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+                return static_cast<int>(node);
+#endif
+            return 0;
+        }
+
+        static bool& inChunk()
+        {
+            static thread_local bool flag = false;
+            return flag;
+        }
+
+        void push(const unsigned& w, const Range& r)
+        {
+            if(r.begin == r.end) return;
+            std::lock_guard<std::mutex> lock(queues[w].lock);
+            queues[w].ranges.push_back(r);
+        }
+
+        /* the newest range of worker w's own deque */
+        bool pop(const unsigned& w, Range& r)
+        {
+            std::lock_guard<std::mutex> lock(queues[w].lock);
+            if(queues[w].ranges.empty()) return false;
+            r = queues[w].ranges.back();
+            queues[w].ranges.pop_back();
+            return true;
+        }
+
+        /* the oldest range of the first victim of w that has one */
+        bool steal(const unsigned& w, Range& r)
+        {
+            for(const unsigned& v : queues[w].victims)
+            {
+                std::lock_guard<std::mutex> lock(queues[v].lock);
+                if(queues[v].ranges.empty()) continue;
+                r = queues[v].ranges.front();
+                queues[v].ranges.pop_front();
+                return true;
+            }
+            return false;
+        }
+
+        void work(const unsigned& w, const JobBase& job)
+        {
+            inChunk() = true;
+            Range r;
+            while(remaining.load(std::memory_order_acquire) > 0)
+            {
+                if(!pop(w, r) && !steal(w, r))
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                while(r.end - r.begin > 1)
+                {
+                    const uint_fast64_t mid = r.begin + (r.end - r.begin) / 2;
+                    push(w, Range{ mid, r.end });
+                    r.end = mid;
+                }
+                job.chunk(r.begin);
+                remaining.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            inChunk() = false;
+        }
+
+        void loop(const unsigned& w)
+        {
+            uint_fast64_t seen = 0;
+            for(;;)
+            {
+                // spin a little before sleeping, as runs tend to come in quick succession
+                for(int spin = 0; spin < 4096 && generation.load(std::memory_order_acquire) == seen; ++spin)
+                    std::this_thread::yield();
+                const JobBase* job;
+                bool used;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&]() { return generation.load(std::memory_order_relaxed) != seen; });
+                    if(stop) return;
+                    seen = generation.load(std::memory_order_relaxed);
+                    job = current;
+                    used = w < runWorkers;
+                }
+                if(used)
+                    work(w, *job);
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--busy == 0)
+                    done.notify_one();
+            }
+        }
+
+        std::vector<Queue> queues;
+        std::vector<std::thread> threads;
+        std::mutex running;             // one job at a time
+        std::mutex mutex;
+        std::condition_variable wake, done;
+        const JobBase* current = nullptr;
+        unsigned active = 1;            // workers of the next run
+        unsigned runWorkers = 1;        // and of the current one
+        std::atomic<uint_fast64_t> remaining{0};
+        unsigned busy = 0;
+        std::atomic<uint_fast64_t> generation{0};
+        bool stop = false;
+    };
+#endif
+
+    namespace parallel
+    {
+        /* the limit of setParallelWorkers, 0 for none */
+        inline unsigned& workerLimit()
+        {
+            static unsigned limit = 0;
+            return limit;
+        }
+
+        /* OpenMP's threads when the limit was set, which omp_get_max_threads no longer gives */
+        inline unsigned& openmpThreads()
+        {
+            static unsigned threads = 0;
+            return threads;
+        }
+
+#if defined(MANSEG_PARALLEL_OPENMP)
+        /* the team size the threads were last bound for with MANSEG_BIND=1, 0 before */
+        inline int& boundTeam()
+        {
+            static int team = 0;
+            return team;
+        }
+
+        /*
+            With MANSEG_BIND=1, binds the threads of the team the next region starts (see
+            ThreadTopology), again whenever its size changes; true if they are bound.
+        */
+        inline bool bindTeam()
+        {
+            static const bool wanted = getenv("MANSEG_BIND") != nullptr && atoi(getenv("MANSEG_BIND")) != 0;
+            if(!wanted || omp_in_parallel())
+                return false;
+            if(boundTeam() != omp_get_max_threads())
+            {
+                ThreadTopology::instance().bindOpenMP();
+                boundTeam() = omp_get_max_threads();
+            }
+            return true;
+        }
+#endif
+    }
+
+    /* number of workers of the backend, whatever limit setParallelWorkers has set */
+    inline unsigned parallelMaxWorkers()
+    {
+#if defined(MANSEG_PARALLEL_OPENMP)
+        if(parallel::workerLimit() != 0)
+            return parallel::openmpThreads();
+        return static_cast<unsigned>(omp_get_max_threads());
+#elif defined(MANSEG_PARALLEL_CILK)
+        return static_cast<unsigned>(__cilkrts_get_nworkers());
+#elif defined(MANSEG_PARALLEL_TBB)
+        return static_cast<unsigned>(tbb::this_task_arena::max_concurrency());
+#elif defined(MANSEG_PARALLEL_THREADS)
+        return ThreadPool::instance().workers();
+#elif defined(MANSEG_PARALLEL_MACRO)
+        return std::max(1u, std::thread::hardware_concurrency());
+#else
+        return 1;
+#endif
+    }
+
+    /* number of workers in use, i.e. how many chunks can run at once */
+    inline unsigned parallelWorkers()
+    {
+        const unsigned all = parallelMaxWorkers();
+        return parallel::workerLimit() == 0 ? all : std::min(parallel::workerLimit(), all);
+    }
+
+    /* runs the loops on workers of the backend's (at least one), or on all of them again for 0 */
+    inline void setParallelWorkers(const unsigned& workers)
+    {
+#if defined(MANSEG_PARALLEL_OPENMP)
+        if(parallel::workerLimit() == 0)
+            parallel::openmpThreads() = static_cast<unsigned>(omp_get_max_threads());
+#endif
+        const unsigned all = parallelMaxWorkers();
+        parallel::workerLimit() = (workers == 0 || workers >= all) ? 0 : workers;
+#if defined(MANSEG_PARALLEL_OPENMP)
+        omp_set_num_threads(static_cast<int>(parallel::workerLimit() == 0 ? all : parallel::workerLimit()));
+#elif defined(MANSEG_PARALLEL_THREADS)
+        ThreadPool::instance().limit(parallel::workerLimit());
+#endif
+    }
+
+    /* number of chunks parallelFor divides n elements into */
+    inline uint_fast64_t parallelChunks(const uint_fast64_t& n, const uint_fast64_t& grain = ParallelGrain)
+    {
+        if(n <= grain) return n > 0 ? 1 : 0;
+        return std::min<uint_fast64_t>((n + grain - 1) / grain, ChunksPerWorker * parallelWorkers());
+    }
+
+    /*
+        Calls body(begin, end) on consecutive ranges that cover [0, n), in parallel. The ranges are
+        parallelChunks(n, grain) near equal chunks, the k-th being [n*k/chunks, n*(k+1)/chunks).
+    */
+    template<class Body>
+    inline void parallelFor(const uint_fast64_t& n, const Body& body, const uint_fast64_t& grain = ParallelGrain)
+    {
+        const uint_fast64_t chunks = parallelChunks(n, grain);
+        if(chunks <= 1)
+        {
+            if(n > 0) body(uint_fast64_t(0), n);
+            return;
+        }
+        auto chunk = [&](const uint_fast64_t& c) { body(n * c / chunks, n * (c + 1) / chunks); };
+        const int64_t numChunks = static_cast<int64_t>(chunks);
+#if defined(MANSEG_PARALLEL_OPENMP)
+        parallel::bindTeam();
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int64_t c = 0; c < numChunks; ++c)
+            chunk(c);
+#elif defined(MANSEG_PARALLEL_CILK)
+        cilk_for(int64_t c = 0; c < numChunks; ++c)
+            chunk(c);
+#elif defined(MANSEG_PARALLEL_TBB)
+        tbb::parallel_for(tbb::blocked_range<int64_t>(0, numChunks, 1), [&](const tbb::blocked_range<int64_t>& r)
+        {
+            for(int64_t c = r.begin(); c < r.end(); ++c)
+                chunk(c);
+        });
+#elif defined(MANSEG_PARALLEL_THREADS)
+        ThreadPool::instance().run(chunks, chunk);
+#elif defined(MANSEG_PARALLEL_MACRO)
+        MANSEG_PARALLEL_FOR(int64_t c = 0; c < numChunks; ++c)
+            chunk(c);
+#else
+        for(int64_t c = 0; c < numChunks; ++c)
+            chunk(c);
+#endif
+    }
+
+    /*
+        Calls body(begin, end) on ranges that cover [bounds[0], bounds[parts]) in parallel, none of which
+        crosses a bound: part p, [bounds[p], bounds[p + 1]), is divided into parallelChunks of its own.
+        With the thread pool, the chunks of part p start on worker p * workers / parts, so a part (e.g.
+        the vertices of one partition of Ligra's partitioner, whose pages are on one node) is worked
+        on by the same worker on every call, unless another steals it. With OpenMP and MANSEG_BIND=1
+        the part is only ever run by that thread, bound to the part's node (see ThreadTopology).
+    */
+    template<class Body>
+    inline void parallelForPartitions(const uint_fast64_t* bounds, const uint_fast64_t& parts, const Body& body,
+        const uint_fast64_t& grain = ParallelGrain)
+    {
+        std::vector<uint_fast64_t> firsts(parts + 1, 0), cuts;
+        for(uint_fast64_t p = 0; p < parts; ++p)
+        {
+            const uint_fast64_t size = bounds[p + 1] - bounds[p];
+            const uint_fast64_t chunks = parallelChunks(size, grain);
+            for(uint_fast64_t c = 0; c < chunks; ++c)
+                cuts.push_back(bounds[p] + size * c / chunks);
+            firsts[p + 1] = firsts[p] + chunks;
+        }
+        const uint_fast64_t chunks = firsts[parts];
+        cuts.push_back(parts > 0 ? bounds[parts] : 0);
+        auto chunk = [&](const uint_fast64_t& c) { body(cuts[c], cuts[c + 1]); };
+#if defined(MANSEG_PARALLEL_THREADS)
+        ThreadPool::instance().run(chunks, chunk, firsts.data(), parts);
+#elif defined(MANSEG_PARALLEL_OPENMP)
+        if(chunks > 1 && parallel::bindTeam())
+        {
+            #pragma omp parallel
+            {
+                const uint_fast64_t t = static_cast<uint_fast64_t>(omp_get_thread_num());
+                const uint_fast64_t team = static_cast<uint_fast64_t>(omp_get_num_threads());
+                for(uint_fast64_t p = 0; p < parts; ++p)
+                    if(p * team / parts == t)
+                        for(uint_fast64_t c = firsts[p]; c < firsts[p + 1]; ++c)
+                            chunk(c);
+            }
+            return;
+        }
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t c = begin; c < end; ++c)
+                chunk(c);
+        }, 1);
+#else
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t c = begin; c < end; ++c)
+                chunk(c);
+        }, 1);
+#endif
+    }
+
+    /*
+        Reduces [0, n) in parallel: partial(begin, end) gives the value of each chunk of parallelFor,
+        and the values are combined in chunk order with combine(a, b), starting from identity, so the
+        result does not depend on the backend or on the order the chunks ran in (only on the number
+        of workers).
+    */
+    template<typename T, class Partial, class Combine>
+    inline T parallelReduce(const uint_fast64_t& n, const T& identity, const Partial& partial, const Combine& combine,
+        const uint_fast64_t& grain = ParallelGrain)
+    {
+        const uint_fast64_t chunks = parallelChunks(n, grain);
+        if(chunks <= 1)
+            return n > 0 ? combine(identity, partial(uint_fast64_t(0), n)) : identity;
+        std::vector<T> values(chunks, identity);
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t c = begin; c < end; ++c)
+                values[c] = partial(n * c / chunks, n * (c + 1) / chunks);
+        }, 1);
+        T result = identity;
+        for(uint_fast64_t c = 0; c < chunks; ++c)
+            result = combine(result, values[c]);
+        return result;
+    }
+}
+
+#endif
@@ -0,0 +1,256 @@
+/*
+	A pool of segment planes and full arrays, for solvers that allocate the same arrays over and over.
+	Author: harunadess
+
+	A solver called many times on systems of similar size (or an outer iteration that makes a new inner
+	solve each time) allocates its vectors afresh on every call: a system call for each plane, a page
+	fault for each page as it is first touched, and zeroing of the tails. A SegmentPool keeps the planes
+	that are given back, by size class (powers of two, from a page), and hands them out again, still in
+	memory, so a call after the first allocates nothing and takes no page faults:
+		PooledManSegArray r(n);                     // from SegmentPool::global(), or:
+		SegmentPool pool;
+		PooledManSegArray p(n, PooledSegmentAllocator(&pool));
+		...                                         // del() / the destructor give the planes back
+	A thread that makes many arrays of its own (a worker of a batch of solves) can make its own pool,
+	SegmentPool::local(), the default for the arrays it makes while a SegmentPool::Scope names it.
+	Planes are anonymous mappings, as with LazySegmentAllocator. A plane asked for zeroed (the tails) is
+	zero if it is new, and written over with zeros if it has been used before: giving its pages back
+	(MADV_DONTNEED) would be cheaper to ask for, but every page written again then faults in again, which
+	for solver vectors that are all written costs more than the pass. The heads and full arrays are not
+	zeroed.
+	reset() takes back at once every plane handed out, for a solver context whose arrays have been
+	abandoned (e.g. by an exception) rather than freed; those arrays must not be used or freed after.
+	trim() returns the planes held to the system. The pool is thread-safe; it takes a lock only to hand
+	out and take back planes, never while they are in use. POSIX only (mmap).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_POOL_H__
+#define __MANSEG_POOL_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* Planes by size class, handed out and taken back (see above) */
+    class SegmentPool
+    {
+    public:
+        SegmentPool() :outstandingBytes(0), heldBytes(0), hits(0), misses(0) {}
+
+        SegmentPool(const SegmentPool&) = delete;
+        SegmentPool& operator=(const SegmentPool&) = delete;
+
+        /* returns the planes held to the system; planes still handed out are left to their arrays */
+        ~SegmentPool() { trim(); }
+
+        /* the pool of PooledSegmentAllocator by default, unless a Scope on the thread names another */
+        static SegmentPool& global()
+        {
+            static SegmentPool pool;
+            return pool;
+        }
+
+        /*
+            A pool of the calling thread's own, for workers that each solve systems of their own: its
+            planes stay with the thread (and in its caches) and are handed out without contending for
+            the global pool's lock. It is returned to the system when the thread ends.
+        */
+        static SegmentPool& local()
+        {
+            static thread_local SegmentPool pool;
+            return pool;
+        }
+
+        /* the pool PooledSegmentAllocator draws from by default on this thread */
+        static SegmentPool& current()
+        {
+            SegmentPool* p = scoped();
+            return p != nullptr ? *p : global();
+        }
+
+        /* makes pool the default of PooledSegmentAllocator on this thread while it is in scope */
+        class Scope
+        {
+        public:
+            explicit Scope(SegmentPool& pool) :previous(scoped()) { scoped() = &pool; }
+            ~Scope() { scoped() = previous; }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            SegmentPool* previous;
+        };
+
+        /* a plane of at least bytes, zero if zero is set */
+        void* acquire(const size_t& bytes, const bool& zero)
+        {
+            const int c = sizeClass(bytes);
+            void* p = nullptr;
+            bool fresh = false;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if(c < (int)free.size() && !free[c].empty())
+                {
+                    p = free[c].back();
+                    free[c].pop_back();
+                    heldBytes -= classBytes(c);
+                    ++hits;
+                }
+                else
+                    ++misses;
+            }
+            if(p == nullptr)
+            {
+                int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+                flags |= MAP_NORESERVE;
+#endif
+                p = mmap(nullptr, classBytes(c), PROT_READ | PROT_WRITE, flags, -1, 0);
+                if(p == MAP_FAILED)
+                    throw std::bad_alloc();
+                fresh = true;
+            }
+            if(zero && !fresh)
+                memset(p, 0, bytes);
+
+            std::lock_guard<std::mutex> guard(lock);
+            outstanding[p] = c;
+            outstandingBytes += classBytes(c);
+            return p;
+        }
+
+        /* takes back a plane from acquire; one that is not handed out (e.g. since a reset) is ignored */
+        void release(void* p)
+        {
+            if(p == nullptr) return;
+            std::lock_guard<std::mutex> guard(lock);
+            std::unordered_map<void*, int>::iterator it = outstanding.find(p);
+            if(it == outstanding.end()) return;
+            hold(p, it->second);
+            outstandingBytes -= classBytes(it->second);
+            outstanding.erase(it);
+        }
+
+        /* takes back every plane handed out; the arrays holding them must not be used or freed after */
+        void reset()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for(std::unordered_map<void*, int>::iterator it = outstanding.begin(); it != outstanding.end(); ++it)
+                hold(it->first, it->second);
+            outstanding.clear();
+            outstandingBytes = 0;
+        }
+
+        /* returns the planes held to the system */
+        void trim()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for(size_t c = 0; c < free.size(); ++c)
+            {
+                for(size_t i = 0; i < free[c].size(); ++i)
+                    munmap(free[c][i], classBytes(c));
+                free[c].clear();
+            }
+            heldBytes = 0;
+        }
+
+        /* bytes of the planes handed out, and of those held for reuse */
+        size_t bytesInUse() const { std::lock_guard<std::mutex> guard(lock); return outstandingBytes; }
+        size_t bytesHeld() const { std::lock_guard<std::mutex> guard(lock); return heldBytes; }
+        /* planes handed out again, and planes that had to be mapped */
+        uint_fast64_t reused() const { std::lock_guard<std::mutex> guard(lock); return hits; }
+        uint_fast64_t mapped() const { std::lock_guard<std::mutex> guard(lock); return misses; }
+
+        /* bytes of the planes of size class c: a page, doubled c times */
+        static size_t classBytes(const int& c) { return static_cast<size_t>(sysconf(_SC_PAGESIZE)) << c; }
+
+        static int sizeClass(const size_t& bytes)
+        {
+            int c = 0;
+            while(classBytes(c) < bytes)
+                ++c;
+            return c;
+        }
+
+    private:
+        static SegmentPool*& scoped()
+        {
+            static thread_local SegmentPool* pool = nullptr;
+            return pool;
+        }
+
+        mutable std::mutex lock;
+        std::vector<std::vector<void*> > free;              // held planes, by size class
+        std::unordered_map<void*, int> outstanding;         // planes handed out, and their classes
+        size_t outstandingBytes, heldBytes;
+        uint_fast64_t hits, misses;
+
+        void hold(void* p, const int& c)
+        {
+            if(c >= (int)free.size())
+                free.resize(c + 1);
+            free[c].push_back(p);
+            heldBytes += classBytes(c);
+        }
+    };
+
+    /*
+        Storage policy drawing from a SegmentPool (by default the thread's current one, see Scope, which
+        is the global one unless set). Copies share the pool, which must outlive the arrays.
+    */
+    struct PooledSegmentAllocator
+    {
+        SegmentPool* pool;
+
+        PooledSegmentAllocator(SegmentPool* pool = &SegmentPool::current()) :pool(pool) {}
+
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            return static_cast<T*>(pool->acquire(length * sizeof(T), zero));
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length) { pool->release(ptr); }
+    };
+
+    /* the planes are anonymous mappings, so dropped tails can be given back as for LazySegmentAllocator */
+    inline void releaseTails(PooledSegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        discardPages(tails, length * sizeof(float));
+    }
+
+    typedef BasicManSegArray<PooledSegmentAllocator> PooledManSegArray;
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+	Warming the tails of mantissa segmented arrays in the background, ahead of a precision switch.
+	Author: harunadess
+
+	Until a solver leaves the heads nothing reads its tails. Lazily allocated tails (LazySegmentAllocator,
+	LazyManSegArray) are then still unbacked, and those of an array mapped by mapSegments are still in the
+	file. The first iteration at full precision then faults in the whole tails plane, a page at a time, on
+	the solver's threads. A TailWarmer does this on threads of its own while the solver is still at the
+	heads: it calls createFullPrecision (which maps the file's tails) and faults the tails in a chunk at a
+	time. Anonymous tails are faulted in for writing, which allocates them and leaves their values (zero, or
+	whatever has been written) as they are. File-backed tails are faulted in for reading.
+	PrecisionController::iterationsToSwitch says when to start:
+		TailWarmer warmer;                                          // $MANSEG_WARM_THREADS threads
+		...
+		if(!warmer.started() && control.iterationsToSwitch() <= tailsWarmingAhead())
+			warmer.warm(x.heads, n);                                // returns at once
+	The destructor waits for the threads; the array must outlive them. The solver may go on reading and
+	writing the array meanwhile. POSIX only (threads and madvise).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PREFETCH_H__
+#define __MANSEG_PREFETCH_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_mapped.hpp"
+
+namespace ManSeg
+{
+    /* iterations before the predicted switch to start warming at: $MANSEG_WARM_TAILS_AHEAD, or fallback if it is unset */
+    inline double tailsWarmingAhead(const double& fallback = 3.0)
+    {
+        const char* ahead = getenv("MANSEG_WARM_TAILS_AHEAD");
+        return (ahead != nullptr && *ahead != '\0') ? atof(ahead) : fallback;
+    }
+
+    /* whether an array's tails come from a file once provided, and so are warmed by reading them */
+    template<class Allocator>
+    inline bool tailsFromFile(const Allocator& allocator) { return false; }
+
+    inline bool tailsFromFile(const MappedSegmentAllocator& allocator) { return static_cast<bool>(allocator.source); }
+
+    /*
+        Faults in the pages of [begin, end): for writing, which backs anonymous memory without changing
+        its values, or for reading. With a kernel that cannot populate a range (before Linux 5.14), a
+        word of each page is touched instead: added 0 to atomically, so a concurrent write is not lost.
+    */
+    inline void faultInTails(float* begin, float* end, const bool& write)
+    {
+        if(begin >= end) return;
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        char* first = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) / page * page);
+        const size_t bytes = reinterpret_cast<char*>(end) - first;
+#if defined(MADV_POPULATE_WRITE) && defined(MADV_POPULATE_READ)
+        if(madvise(first, bytes, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0)
+            return;
+#endif
+        if(!write)
+            madvise(first, bytes, MADV_WILLNEED);
+        for(float* p = begin; p < end; p = reinterpret_cast<float*>(reinterpret_cast<char*>(p) + page))
+        {
+            uint32_t* word = reinterpret_cast<uint32_t*>(p);
+            if(write)
+                __atomic_fetch_add(word, 0u, __ATOMIC_RELAXED);
+            else
+                (void)*const_cast<volatile uint32_t*>(word);
+        }
+    }
+
+    /*
+        Faults in the tails of arrays on a pool of background threads, each taking the next chunk of
+        chunkBytes until none is left. warm() may be called for several arrays, each getting threads of its own.
+    */
+    class TailWarmer
+    {
+    public:
+        explicit TailWarmer(const int& threads = defaultThreads(), const size_t& chunkBytes = 2 << 20)
+            :threads(std::max(1, threads)), chunk(std::max<size_t>(1, chunkBytes / sizeof(float))), pending(0), begun(false)
+        {}
+
+        TailWarmer(const TailWarmer&) = delete;
+        TailWarmer& operator=(const TailWarmer&) = delete;
+
+        ~TailWarmer() { wait(); }
+
+        /* provides the tails of the n values of a and starts faulting them in; returns at once */
+        template<class Allocator>
+        void warm(TwoSegArray<false, Allocator>& a, const uint_fast64_t& n)
+        {
+            TwoSegArray<true, Allocator> pairs = a.createFullPrecision();
+            start(pairs.getTails(), n, !tailsFromFile(a.getAllocator()));
+        }
+
+        /* whether warm() has been called */
+        bool started() const { return begun; }
+        /* whether every chunk started has been faulted in */
+        bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+        /* waits for the threads to finish */
+        void wait()
+        {
+            for(size_t i = 0; i < pool.size(); ++i)
+                pool[i].join();
+            pool.clear();
+        }
+
+        /* threads to warm with: $MANSEG_WARM_THREADS, or 1 if it is unset */
+        static int defaultThreads()
+        {
+            const char* threads = getenv("MANSEG_WARM_THREADS");
+            return (threads != nullptr && *threads != '\0') ? atoi(threads) : 1;
+        }
+
+    private:
+        int threads;
+        size_t chunk;                   // floats per chunk
+        std::atomic<int> pending;       // arrays not yet fully warmed
+        std::vector<std::thread> pool;
+        bool begun;
+
+        void start(float* tails, const uint_fast64_t& n, const bool& write)
+        {
+            begun = true;
+            if(tails == nullptr || n == 0) return;
+            pending.fetch_add(1, std::memory_order_relaxed);
+            std::shared_ptr<std::atomic<uint_fast64_t> > next = std::make_shared<std::atomic<uint_fast64_t> >(0);
+            std::shared_ptr<std::atomic<int> > running = std::make_shared<std::atomic<int> >(threads);
+            const size_t step = chunk;
+            std::atomic<int>* left = &pending;
+            for(int t = 0; t < threads; ++t)
+                pool.emplace_back([tails, n, write, step, next, running, left]() {
+                    for(uint_fast64_t begin; (begin = next->fetch_add(step)) < n; )
+                        faultInTails(tails + begin, tails + std::min<uint_fast64_t>(n, begin + step), write);
+                    if(running->fetch_sub(1) == 1)
+                        left->fetch_sub(1, std::memory_order_release);
+                });
+        }
+    };
+}
+
+#endif
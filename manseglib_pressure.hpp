@@ -0,0 +1,113 @@
+/*
+	Memory pressure signalled to a running solver, for demoting its arrays.
+	Author: harunadess
+
+	On a node shared by several jobs, a scheduler short of memory can ask a solver to shrink rather
+	than have it killed. A MemoryPressure listens for a signal (SIGUSR1, or $MANSEG_PRESSURE_SIGNAL)
+	and the solver checks it between iterations, demoting its arrays when it has come (see
+	BasicManSegArray::demote): from the full doubles to the segments, half the memory at the same
+	precision, or with the tails dropped to the heads, a quarter of it:
+		MemoryPressure pressure;
+		while(...)
+		{
+			if(pressure.take())
+				x.demote(), y.demote();                 // full -> pairs: on at ACCESS_PAIRS
+			...
+		}
+	With the job run under `systemd-run --user -p MemoryHigh=...` or a container, whatever watches the
+	cgroup's memory.events (or PSI) sends the signal: `kill -USR1 <pid>`. Only one MemoryPressure
+	listens at a time; its destructor puts back the handler it replaced. POSIX only.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PRESSURE_H__
+#define __MANSEG_PRESSURE_H__
+
+#include <signal.h>
+#include <stdlib.h>
+
+namespace ManSeg
+{
+    /* set by the signal handler, cleared by MemoryPressure::take */
+    inline volatile sig_atomic_t& pressureSignalled()
+    {
+        static volatile sig_atomic_t signalled = 0;
+        return signalled;
+    }
+
+    inline void onPressureSignal(int) { pressureSignalled() = 1; }
+
+    /* Listens for a memory pressure signal while it is in scope */
+    class MemoryPressure
+    {
+    public:
+        /* listens for signal; 0 listens for nothing, so take() is only true after raise() */
+        explicit MemoryPressure(const int& signal = defaultSignal())
+            :signal(signal), installed(false)
+        {
+            pressureSignalled() = 0;
+            if(signal <= 0) return;
+            struct sigaction action;
+            action.sa_handler = onPressureSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            installed = sigaction(signal, &action, &previous) == 0;
+        }
+
+        MemoryPressure(const MemoryPressure&) = delete;
+        MemoryPressure& operator=(const MemoryPressure&) = delete;
+
+        ~MemoryPressure()
+        {
+            if(installed)
+                sigaction(signal, &previous, nullptr);
+        }
+
+        /* whether the signal has come since the last call (or construction), clearing it */
+        bool take()
+        {
+            if(!pressureSignalled()) return false;
+            pressureSignalled() = 0;
+            return true;
+        }
+
+        /* signals pressure from within the process, as the signal would */
+        void raise() { pressureSignalled() = 1; }
+
+        /* whether the handler is installed */
+        bool listening() const { return installed; }
+
+        /* $MANSEG_PRESSURE_SIGNAL (a signal number), or SIGUSR1 if it is unset */
+        static int defaultSignal()
+        {
+            const char* signal = getenv("MANSEG_PRESSURE_SIGNAL");
+            return (signal != nullptr && *signal != '\0') ? atoi(signal) : SIGUSR1;
+        }
+
+    private:
+        int signal;
+        bool installed;
+        struct sigaction previous;
+    };
+}
+
+#endif
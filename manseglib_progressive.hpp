@@ -0,0 +1,277 @@
+/*
+	Promotion of mantissa segmented arrays a block at a time, alongside the computation.
+	Author: harunadess
+
+	ManSegArray::promote and copytoIEEEdouble fill the whole of full in one pass, which every thread
+	waits for. A ProgressivePromotion splits the work into blocks (of an array, or the blocks of a grid,
+	the partitions of a graph or the row blocks of a matrix) and promotes them one by one: from a thread
+	of its own started with start(), which works through the blocks in order while the solver goes on,
+	and on demand from the solver's threads, which call promote(b) before they need block b at full
+	precision, so the blocks are taken in the order the computation reaches them:
+		ProgressivePromotion widening(numBlocks, [&](const uint_fast64_t& b) { ... widen block b ... });
+		widening.start();
+		... before a sweep reads block b in full: widening.promote(b) ...
+		widening.finish();
+	Each block is promoted exactly once, by whichever thread claims it first; the others wait for it
+	to be done. Once promote(b) or promoted(b) has returned true, the values the block function wrote
+	are visible to the thread that asked. finish() (and the destructor) promote whatever is left on the
+	calling thread as well, and join the background thread.
+
+	ArrayPromotion does this for a ManSegArray, a block being blockSize consecutive elements whose full
+	values are streamed from the pairs (or the heads alone, as copytoIEEEdouble); full is allocated if
+	it is not already. Its ProgressiveView reads each block at its current precision, the full value
+	once it is promoted and the segments until then, which hold the same value; a set promotes the
+	element's block first and writes full, so the segments are never written once promotion has
+	started. Values read and written through the view are consistent as long as no element is written
+	by one thread while another reads it, as in an iteration that reads one array and writes another.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PROGRESSIVE_H__
+#define __MANSEG_PROGRESSIVE_H__
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* elements per block of an ArrayPromotion, by default: 512KB of full values */
+    constexpr uint_fast64_t ProgressiveBlockSize = 1 << 16;
+
+    /*
+        Promotes numBlocks blocks, each once, through promoteBlock(b): in block order from a thread of
+        its own after start(), and block by block as the solver asks for them.
+        As with std::thread, it can be neither copied nor moved.
+    */
+    class ProgressivePromotion
+    {
+    public:
+        typedef std::function<void(const uint_fast64_t&)> BlockFunction;
+
+        ProgressivePromotion(const uint_fast64_t& numBlocks, const BlockFunction& promoteBlock)
+            :blocks(numBlocks), promoteBlock(promoteBlock), state(new std::atomic<unsigned char>[numBlocks]),
+             cursor(0), promotedCount(0), backgroundCount(0)
+        {
+            for(uint_fast64_t b = 0; b < blocks; ++b)
+                state[b].store(BLOCK_SEGMENTS, std::memory_order_relaxed);
+        }
+
+        ProgressivePromotion(const ProgressivePromotion&) = delete;
+        ProgressivePromotion& operator=(const ProgressivePromotion&) = delete;
+
+        ~ProgressivePromotion()
+        {
+            finish();
+            delete [] state;
+        }
+
+        /* starts promoting the blocks in order on a thread of its own; once only */
+        void start()
+        {
+            if(background.joinable())
+                return;
+            background = std::thread([this]()
+            {
+                MANSEG_TRACE_SCOPE_ARG("progressive promotion", "blocks", blocks);
+                while(promoteNext())
+                    backgroundCount.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+
+        /*
+            Promotes the next block in order that no thread has claimed, on the calling thread, e.g. a
+            few at the end of each iteration to spread the promotion without a thread of its own.
+            Returns false once every block has been claimed.
+        */
+        bool promoteNext()
+        {
+            for(;;)
+            {
+                const uint_fast64_t b = cursor.fetch_add(1, std::memory_order_relaxed);
+                if(b >= blocks)
+                    return false;
+                if(claim(b))
+                    return true;
+            }
+        }
+
+        /* block b is promoted when this returns: by this thread if no other has claimed it, or by the one that has */
+        void promote(const uint_fast64_t& b)
+        {
+            if(state[b].load(std::memory_order_acquire) == BLOCK_FULL)
+                return;
+            if(!claim(b))
+                while(state[b].load(std::memory_order_acquire) != BLOCK_FULL)
+                    std::this_thread::yield();
+        }
+
+        bool promoted(const uint_fast64_t& b) const { return state[b].load(std::memory_order_acquire) == BLOCK_FULL; }
+
+        /* promotes the blocks still at the segments on this thread too, and waits for every block */
+        void finish()
+        {
+            while(promoteNext());
+            if(background.joinable())
+                background.join();
+            for(uint_fast64_t b = 0; b < blocks; ++b)
+                promote(b);
+        }
+
+        uint_fast64_t numBlocks() const { return blocks; }
+        uint_fast64_t numPromoted() const { return promotedCount.load(std::memory_order_acquire); }
+        bool done() const { return numPromoted() == blocks; }
+
+        /* blocks promoted by the background thread; the rest were promoted by the threads that needed them, or by finish */
+        uint_fast64_t numBackground() const { return backgroundCount.load(std::memory_order_relaxed); }
+
+    private:
+        enum { BLOCK_SEGMENTS, BLOCK_MOVING, BLOCK_FULL };
+
+        uint_fast64_t blocks;
+        BlockFunction promoteBlock;
+        std::atomic<unsigned char>* state;
+        std::atomic<uint_fast64_t> cursor;          // the next block the ordered promotion tries
+        std::atomic<uint_fast64_t> promotedCount;
+        std::atomic<uint_fast64_t> backgroundCount;
+        std::thread background;
+
+        /* promotes b if no other thread has claimed it, returning whether this one did */
+        bool claim(const uint_fast64_t& b)
+        {
+            unsigned char expected = BLOCK_SEGMENTS;
+            if(!state[b].compare_exchange_strong(expected, BLOCK_MOVING, std::memory_order_acquire))
+                return false;
+            promoteBlock(b);
+            state[b].store(BLOCK_FULL, std::memory_order_release);
+            promotedCount.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    template<class Allocator> class ProgressiveView;
+
+    /*
+        Fills the full values of a ManSegArray blockSize elements at a time, from its pairs, or with
+        headsOnly from its heads alone (the tails of an array that has only ever been written at the
+        heads being zero, that is the same value). The array must outlive the promotion, and keep its
+        storage (e.g. not be swapped) while it runs.
+    */
+    template<class Allocator = SegmentAllocator>
+    class ArrayPromotion : public ProgressivePromotion
+    {
+    public:
+        ArrayPromotion(BasicManSegArray<Allocator>& a, const uint_fast64_t& blockSize = ProgressiveBlockSize, const bool& headsOnly = false)
+            :ProgressivePromotion((a.length + blockSize - 1) / blockSize, blockFunction(a, blockSize, headsOnly)),
+             heads(a.heads.getHeads()), tails(headsOnly ? nullptr : a.pairs.getTails()), full(a.full), n(a.length), blockSize(blockSize)
+        {
+            MANSEG_TRAFFIC_ADD(PROMOTED, n);
+        }
+
+        /* the array read at each block's current precision (see ProgressiveView) */
+        ProgressiveView<Allocator> view() { return ProgressiveView<Allocator>(*this); }
+
+        uint_fast64_t size() const { return n; }
+        uint_fast64_t getBlockSize() const { return blockSize; }
+
+    private:
+        friend class ProgressiveView<Allocator>;
+
+        float* heads;
+        float* tails;
+        double* full;
+        uint_fast64_t n;
+        uint_fast64_t blockSize;
+
+        /* the block function, full being allocated first as the members are initialised after the base */
+        static BlockFunction blockFunction(BasicManSegArray<Allocator>& a, const uint_fast64_t& blockSize, const bool& headsOnly)
+        {
+            if(a.full == nullptr)
+                a.allocFull();
+            float* h = a.heads.getHeads();
+            float* t = headsOnly ? nullptr : a.pairs.getTails();
+            double* f = a.full;
+            const uint_fast64_t length = a.length;
+            return [h, t, f, length, blockSize](const uint_fast64_t& b)
+            {
+                const uint_fast64_t begin = b * blockSize;
+                const uint_fast64_t count = std::min(blockSize, length - begin);
+                streamSegments(h + begin, t == nullptr ? nullptr : t + begin, count, f + begin);
+            };
+        }
+    };
+
+    /*
+        An array being promoted by an ArrayPromotion, read from full where its block has been promoted
+        and from the segments elsewhere; set promotes the block first (see manseglib_progressive.hpp).
+    */
+    template<class Allocator = SegmentAllocator>
+    class ProgressiveView
+    {
+    public:
+        ProgressiveView(ArrayPromotion<Allocator>& promotion)
+            :promotion(&promotion), heads(promotion.heads), tails(promotion.tails), full(promotion.full),
+             n(promotion.n), blockSize(promotion.blockSize)
+        {}
+
+        bool promoted(const uint_fast64_t& id) const { return promotion->promoted(id / blockSize); }
+
+        double operator[](const uint_fast64_t& id) const { return read(id); }
+
+        double read(const uint_fast64_t& id) const
+        {
+            if(promoted(id))
+            {
+                MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double));
+                return full[id];
+            }
+            if(tails != nullptr)
+                return static_cast<double>(Pair(heads + id, tails + id));
+            return static_cast<double>(Head(heads + id));
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            promotion->promote(id / blockSize);
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double));
+            full[id] = static_cast<double>(t);
+        }
+
+        uint_fast64_t size() const { return n; }
+        double* getFull() const { return full; }
+
+    private:
+        ArrayPromotion<Allocator>* promotion;
+        float* heads;
+        float* tails;
+        double* full;
+        uint_fast64_t n;
+        uint_fast64_t blockSize;
+    };
+}
+
+#endif // __MANSEG_PROGRESSIVE_H__
@@ -0,0 +1,345 @@
+/*
+	Rank vectors published to readers in other processes while a solver is still computing them.
+	Author: harunadess
+
+	A RankPublisher keeps two slots in a shared file (on tmpfs, e.g. /dev/shm, the file is only memory):
+	each publish copies the vector into the slot not being read, at its current level (the heads plane,
+	both planes, or the doubles), and then makes that slot the current one, so the copy is the only cost
+	to the solver. A RankReader maps the same file and takes a RankSnapshot of the current slot, which
+	reads the values in place, at the level they were published, for as long as it is held:
+		RankPublisher out("/dev/shm/ranks", n);                 // in the solver
+		out.publish(x.heads, n, iter, delta);                   // heads, at the heads
+		out.publish(x.full, n, iter, delta);                    // doubles, at full precision
+		RankReader in("/dev/shm/ranks");                        // in the server
+		RankSnapshot s = in.snapshot();
+		if(s.valid()) serve(s.read(v), s.level(), s.epoch());   // or s.heads(), s.pairs(), s.full()
+	A snapshot pins its slot: the publisher never writes a pinned slot, so a snapshot is never torn,
+	and readers never wait for the publisher. The publisher never waits either: a publish that finds
+	its slot still pinned (a reader holding a snapshot across two publishes) is skipped and returns
+	false, and the next one tries again. Taking a snapshot retries only if a publish lands between its
+	two loads, so it is lock-free. A reader that dies holding a snapshot leaves its slot pinned, and
+	every other publish is then skipped; drop snapshots promptly. One publisher per file; creating it
+	starts the file afresh. POSIX only (mmap of a shared file); std::atomic<uint32_t/uint64_t> must be
+	lock-free, as it is on x86-64 and AArch64.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_PUBLISH_H__
+#define __MANSEG_PUBLISH_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    static const char publicationMagic[8] = { 'M', 'S', 'P', 'U', 'B', '0', '1', '\0' };
+
+    /* a slot's vector, as of its last publish */
+    struct PublicationSlot
+    {
+        std::atomic<uint32_t> pins;     // snapshots holding the slot
+        uint32_t level;                 // AccessLevel
+        uint64_t length, epoch, iteration;
+        double delta;
+    };
+
+    /* the start of a publication file; the slots' values follow, each from a page boundary */
+    struct PublicationHeader
+    {
+        char magic[8];
+        uint64_t capacity;
+        std::atomic<uint64_t> epoch;    // publishes so far
+        std::atomic<uint32_t> current;  // slot of the last publish
+        PublicationSlot slots[2];
+    };
+
+    /* bytes of the header, and of each slot's values, in a publication file of capacity values */
+    inline uint64_t publicationHeaderBytes()
+    {
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        return (sizeof(PublicationHeader) + page - 1) / page * page;
+    }
+
+    inline uint64_t publicationSlotBytes(const uint64_t& capacity)
+    {
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        return (capacity * sizeof(double) + page - 1) / page * page;
+    }
+
+    /* A published vector, pinned in place until the snapshot is destroyed (see above) */
+    class RankSnapshot
+    {
+    public:
+        RankSnapshot() :header(nullptr), slot(0), values(nullptr) {}
+
+        RankSnapshot(PublicationHeader* header, const uint32_t& slot, char* values)
+            :header(header), slot(slot), values(values) {}
+
+        RankSnapshot(RankSnapshot&& other) :header(other.header), slot(other.slot), values(other.values)
+        {
+            other.header = nullptr;
+        }
+
+        RankSnapshot& operator=(RankSnapshot&& other)
+        {
+            if(this != &other)
+            {
+                release();
+                header = other.header, slot = other.slot, values = other.values;
+                other.header = nullptr;
+            }
+            return *this;
+        }
+
+        RankSnapshot(const RankSnapshot&) = delete;
+        RankSnapshot& operator=(const RankSnapshot&) = delete;
+
+        ~RankSnapshot() { release(); }
+
+        /* whether anything had been published when the snapshot was taken */
+        bool valid() const { return header != nullptr; }
+
+        AccessLevel level() const { return static_cast<AccessLevel>(meta().level); }
+        uint_fast64_t size() const { return meta().length; }
+        /* the publish this is (1 for the first), and the solver's iteration and delta at it */
+        uint_fast64_t epoch() const { return meta().epoch; }
+        uint_fast64_t iteration() const { return meta().iteration; }
+        double delta() const { return meta().delta; }
+
+        /* value i, at the level published */
+        double read(const uint_fast64_t& i) const
+        {
+            switch(level())
+            {
+            case ACCESS_FULL: return full()[i];
+            case ACCESS_PAIRS: return pairs().read(i);
+            default: return heads().read(i);
+            }
+        }
+
+        /* the planes, in place: heads at any level but ACCESS_FULL, pairs at ACCESS_PAIRS, full at ACCESS_FULL */
+        HeadsSpan heads() const { return HeadsSpan(planeHeads(), planeTails(), size()); }
+        PairsSpan pairs() const { return PairsSpan(planeHeads(), planeTails(), size()); }
+        const double* full() const { return reinterpret_cast<const double*>(values); }
+
+        /* unpins the slot; the snapshot is then not valid */
+        void release()
+        {
+            if(header == nullptr) return;
+            header->slots[slot].pins.fetch_sub(1);
+            header = nullptr;
+        }
+
+    private:
+        PublicationHeader* header;
+        uint32_t slot;
+        char* values;
+
+        const PublicationSlot& meta() const { return header->slots[slot]; }
+        float* planeHeads() const { return reinterpret_cast<float*>(values); }
+        float* planeTails() const { return level() == ACCESS_PAIRS ? reinterpret_cast<float*>(values) + size() : nullptr; }
+    };
+
+    /* The shared file of a publisher or reader, mapped whole */
+    class PublicationFile
+    {
+    public:
+        PublicationFile() :header(nullptr), bytes(0) {}
+
+        PublicationFile(const PublicationFile&) = delete;
+        PublicationFile& operator=(const PublicationFile&) = delete;
+
+        ~PublicationFile()
+        {
+            if(header != nullptr)
+                munmap(header, bytes);
+        }
+
+        bool isOpen() const { return header != nullptr; }
+        uint_fast64_t capacity() const { return header->capacity; }
+
+        /* publishes so far, e.g. to poll for a new vector */
+        uint_fast64_t epoch() const { return header == nullptr ? 0 : header->epoch.load(); }
+
+    protected:
+        PublicationHeader* header;
+        uint64_t bytes;
+
+        /* maps the file open at fd, which it closes */
+        bool map(const int& fd, const uint64_t& length)
+        {
+            void* mem = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if(mem == MAP_FAILED) return false;
+            header = static_cast<PublicationHeader*>(mem);
+            bytes = length;
+            return true;
+        }
+
+        char* slotValues(const uint32_t& slot) const
+        {
+            return reinterpret_cast<char*>(header) + publicationHeaderBytes() + slot * publicationSlotBytes(header->capacity);
+        }
+    };
+
+    /* Publishes vectors of up to capacity values to the file at path (see above) */
+    class RankPublisher : public PublicationFile
+    {
+    public:
+        /* creates (or starts afresh) the file at path; isOpen() is false if that fails */
+        RankPublisher(const char* path, const uint_fast64_t& capacity) :published(0), skipped(0)
+        {
+            if(path == nullptr || *path == '\0') return;
+            const int fd = open(path, O_RDWR | O_CREAT, 0644);
+            if(fd < 0) return;
+            const uint64_t length = publicationHeaderBytes() + 2 * publicationSlotBytes(capacity);
+            if(ftruncate(fd, length) != 0)
+            {
+                close(fd);
+                return;
+            }
+            if(!map(fd, length)) return;
+            // a reader that opens the file before this is done fails on the magic
+            memset(header->magic, 0, sizeof(header->magic));
+            header->capacity = capacity;
+            new (&header->epoch) std::atomic<uint64_t>(0);
+            new (&header->current) std::atomic<uint32_t>(0);
+            for(int s = 0; s < 2; ++s)
+            {
+                new (&header->slots[s].pins) std::atomic<uint32_t>(0);
+                header->slots[s].level = ACCESS_HEADS;
+                header->slots[s].length = header->slots[s].epoch = header->slots[s].iteration = 0;
+                header->slots[s].delta = 0.0;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            memcpy(header->magic, publicationMagic, sizeof(publicationMagic));
+        }
+
+        /* the n values of a, at its level (the heads plane, or both planes) */
+        template<bool useTail, class Allocator>
+        bool publish(const TwoSegArray<useTail, Allocator>& a, const uint_fast64_t& n, const uint_fast64_t& iteration, const double& delta)
+        {
+            return publish(useTail ? ACCESS_PAIRS : ACCESS_HEADS, a.getHeads(), useTail ? a.getTails() : nullptr, n, iteration, delta);
+        }
+
+        /* the n doubles of full */
+        bool publish(const double* full, const uint_fast64_t& n, const uint_fast64_t& iteration, const double& delta)
+        {
+            return publish(ACCESS_FULL, full, nullptr, n, iteration, delta);
+        }
+
+        /* publishes done, and skipped because a reader held the slot */
+        uint_fast64_t numPublished() const { return published; }
+        uint_fast64_t numSkipped() const { return skipped; }
+
+    private:
+        uint_fast64_t published, skipped;
+
+        /*
+            Copies into the slot that is not current, unless a snapshot still pins it, then makes it current.
+            Making the slot current and then checking the other's pins (both seq_cst) pairs with a reader
+            pinning a slot and then checking it is still current: either the reader sees that it is not, and
+            lets go, or this sees the pin.
+        */
+        bool publish(const AccessLevel& level, const void* first, const float* tails, const uint_fast64_t& n,
+            const uint_fast64_t& iteration, const double& delta)
+        {
+            if(header == nullptr || n > header->capacity) return false;
+            const uint32_t target = 1 - header->current.load();
+            PublicationSlot& slot = header->slots[target];
+            if(slot.pins.load() != 0)
+            {
+                ++skipped;
+                return false;
+            }
+            char* values = slotValues(target);
+            if(level == ACCESS_FULL)
+                memcpy(values, first, n * sizeof(double));
+            else
+            {
+                memcpy(values, first, n * sizeof(float));
+                if(level == ACCESS_PAIRS)
+                    memcpy(values + n * sizeof(float), tails, n * sizeof(float));
+            }
+            slot.level = level;
+            slot.length = n;
+            slot.epoch = header->epoch.load() + 1;
+            slot.iteration = iteration;
+            slot.delta = delta;
+            header->current.store(target);
+            header->epoch.fetch_add(1);
+            ++published;
+            return true;
+        }
+    };
+
+    /* Reads what a RankPublisher publishes to the file at path (see above) */
+    class RankReader : public PublicationFile
+    {
+    public:
+        /* maps the file at path; isOpen() is false if it is missing or not (yet) a publication file */
+        explicit RankReader(const char* path)
+        {
+            if(path == nullptr || *path == '\0') return;
+            const int fd = open(path, O_RDWR);
+            if(fd < 0) return;
+            struct stat info;
+            if(fstat(fd, &info) != 0 || (uint64_t)info.st_size < publicationHeaderBytes())
+            {
+                close(fd);
+                return;
+            }
+            if(!map(fd, info.st_size)) return;
+            if(memcmp(header->magic, publicationMagic, sizeof(publicationMagic)) != 0
+                || bytes < publicationHeaderBytes() + 2 * publicationSlotBytes(header->capacity))
+            {
+                munmap(header, bytes);
+                header = nullptr;
+            }
+        }
+
+        /* the last vector published, pinned; not valid() if nothing has been published */
+        RankSnapshot snapshot()
+        {
+            if(header == nullptr) return RankSnapshot();
+            for(;;)
+            {
+                if(header->epoch.load() == 0) return RankSnapshot();
+                const uint32_t slot = header->current.load();
+                header->slots[slot].pins.fetch_add(1);
+                if(header->current.load() == slot)
+                    return RankSnapshot(header, slot, slotValues(slot));
+                header->slots[slot].pins.fetch_sub(1);     // a publish landed in between: try its slot
+            }
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,431 @@
+/*
+	Top-k selection over the heads of mantissa segmented arrays.
+	Author: harunadess
+
+	Ranking a solution (the leaders of a PageRank vector, or how well two runs agree on them) does not
+	need the whole vector sorted. The bits of a head, read as an integer with the sign bit flipped (and
+	all the bits flipped for a negative value), are in the same order as the values it rounds, so a
+	radix select over the 32-bit heads finds the k-th largest head in four passes over half the bytes
+	of the doubles. Only the values whose head ties with it are then told apart by their tails, which
+	hold the low 32 bits of the double, so the ranking is exact:
+		std::vector<uint_fast64_t> top = topK(x.heads, n, 100);   // indices, largest first
+		std::vector<uint_fast64_t> ref = topK(reference, n, 100); // the same for doubles
+	Equal values are ranked by index. The passes are split between the workers of the parallel backend (see manseglib_parallel.hpp).
+	The tails of a heads array are read as they are stored; a vector only ever written at the heads
+	has no low bits to tell its ties apart, and they are ranked by index. When only a share of the
+	values is wanted rather than their order, the first two passes are enough: headsQuantile gives a
+	threshold with that share of the heads at or above it.
+	The distribution of the values needs no select at all. histogramLog2 counts the heads by their top
+	bits (sign, exponent and the first few bits of the mantissa) in one pass, with the keys of eight
+	heads computed in a vector at a time, and no head is widened to a double:
+		Log2Histogram h = histogramLog2(x.heads, n);                 // a bucket a binade
+		std::vector<double> q = quantiles(x.heads, n, { 0.5, 0.01 });  // several thresholds, one pass
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_RANK_H__
+#define __MANSEG_RANK_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    namespace ranking
+    {
+        /* the 32 bits of a head (or the high half of a double) as an unsigned key in the order of the values */
+        inline uint32_t orderedKey(const uint32_t& bits)
+        {
+            return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        }
+
+        /* the value of the head (the high half of a double, low half zero) whose ordered key is key */
+        inline double keyValue(const uint32_t& key)
+        {
+            const uint64_t bits = static_cast<uint64_t>((key & 0x80000000u) ? (key & 0x7fffffffu) : ~key) << 32;
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        /* the low half of a double, in the order of the values with its high half */
+        inline uint32_t orderedLow(const uint32_t& high, const uint32_t& low)
+        {
+            return (high & 0x80000000u) ? ~low : low;
+        }
+
+        /* keys of a heads (and tails) array: tails may be nullptr */
+        struct SegmentKeys
+        {
+            const float* heads;
+            const float* tails;
+
+            uint32_t high(const uint_fast64_t& i) const
+            {
+                uint32_t h;
+                memcpy(&h, heads + i, sizeof(h));
+                return orderedKey(h);
+            }
+
+            uint32_t low(const uint_fast64_t& i) const
+            {
+                if(tails == nullptr)
+                    return 0;
+                uint32_t h, t;
+                memcpy(&h, heads + i, sizeof(h));
+                memcpy(&t, tails + i, sizeof(t));
+                return orderedLow(h, t);
+            }
+        };
+
+        /* keys of an array of doubles, from their high and low halves */
+        struct DoubleKeys
+        {
+            const double* values;
+
+            uint32_t high(const uint_fast64_t& i) const
+            {
+                uint64_t b;
+                memcpy(&b, values + i, sizeof(b));
+                return orderedKey(static_cast<uint32_t>(b >> 32));
+            }
+
+            uint32_t low(const uint_fast64_t& i) const
+            {
+                uint64_t b;
+                memcpy(&b, values + i, sizeof(b));
+                return orderedLow(static_cast<uint32_t>(b >> 32), static_cast<uint32_t>(b));
+            }
+        };
+
+        /* counts, in hist, the next 8 bits (from shift) of the keys whose bits above them equal prefix */
+        template<class Keys>
+        inline void histogram(const Keys& keys, const uint_fast64_t& n, const uint32_t& prefix, const uint32_t& mask, const int& shift, uint_fast64_t* hist)
+        {
+            memset(hist, 0, 256 * sizeof(uint_fast64_t));
+            const uint_fast64_t chunks = parallelChunks(n, 65536);
+            std::vector<uint_fast64_t> local(chunks * 256, 0);
+            parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(uint_fast64_t c = begin; c < end; ++c)
+                {
+                    uint_fast64_t* h = local.data() + c * 256;
+                    for(uint_fast64_t i = (n * c) / chunks; i < (n * (c + 1)) / chunks; ++i)
+                    {
+                        const uint32_t key = keys.high(i);
+                        if((key & mask) == prefix)
+                            ++h[(key >> shift) & 255];
+                    }
+                }
+            }, 1);
+            for(uint_fast64_t c = 0; c < chunks; ++c)
+                for(int b = 0; b < 256; ++b)
+                    hist[b] += local[c * 256 + b];
+        }
+
+        /* appends to above the indices with a high key over threshold, and to ties those equal to it, in order */
+        template<class Keys>
+        inline void collect(const Keys& keys, const uint_fast64_t& n, const uint32_t& threshold,
+            std::vector<uint_fast64_t>& above, std::vector<uint_fast64_t>& ties)
+        {
+            const uint_fast64_t chunks = parallelChunks(n, 65536);
+            std::vector<std::vector<uint_fast64_t> > partAbove(chunks), partTies(chunks);
+            parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                for(uint_fast64_t c = begin; c < end; ++c)
+                    for(uint_fast64_t i = (n * c) / chunks; i < (n * (c + 1)) / chunks; ++i)
+                    {
+                        const uint32_t key = keys.high(i);
+                        if(key > threshold) partAbove[c].push_back(i);
+                        else if(key == threshold) partTies[c].push_back(i);
+                    }
+            }, 1);
+            for(uint_fast64_t c = 0; c < chunks; ++c)
+            {
+                above.insert(above.end(), partAbove[c].begin(), partAbove[c].end());
+                ties.insert(ties.end(), partTies[c].begin(), partTies[c].end());
+            }
+        }
+
+        template<class Keys>
+        inline std::vector<uint_fast64_t> select(const Keys& keys, const uint_fast64_t& n, uint_fast64_t k)
+        {
+            k = std::min(k, n);
+            std::vector<uint_fast64_t> top;
+            if(k == 0)
+                return top;
+
+            // radix select of the k-th largest high key, 8 bits at a time from the top
+            uint32_t prefix = 0, mask = 0;
+            uint_fast64_t need = k;
+            uint_fast64_t hist[256];
+            for(int shift = 24; shift >= 0; shift -= 8)
+            {
+                histogram(keys, n, prefix, mask, shift, hist);
+                int digit = 255;
+                uint_fast64_t above = 0;
+                for(; digit > 0 && above + hist[digit] < need; --digit)
+                    above += hist[digit];
+                need -= above;
+                prefix |= static_cast<uint32_t>(digit) << shift;
+                mask |= 255u << shift;
+            }
+
+            // everything above the threshold, and the need largest of its ties by their low halves
+            std::vector<uint_fast64_t> ties;
+            top.reserve(k);
+            collect(keys, n, prefix, top, ties);
+            auto byLow = [&keys](const uint_fast64_t& a, const uint_fast64_t& b) {
+                const uint32_t la = keys.low(a), lb = keys.low(b);
+                return la != lb ? la > lb : a < b;
+            };
+            if(need < ties.size())
+                std::nth_element(ties.begin(), ties.begin() + need, ties.end(), byLow);
+            top.insert(top.end(), ties.begin(), ties.begin() + need);
+
+            std::sort(top.begin(), top.end(), [&keys](const uint_fast64_t& a, const uint_fast64_t& b) {
+                const uint32_t ha = keys.high(a), hb = keys.high(b);
+                if(ha != hb) return ha > hb;
+                const uint32_t la = keys.low(a), lb = keys.low(b);
+                return la != lb ? la > lb : a < b;
+            });
+            return top;
+        }
+    }
+
+    /*
+        The indices of the k largest of the first n values, largest first (all n of them if k > n).
+        The heads are selected on, and the tails only break ties between equal heads.
+    */
+    template<class Allocator>
+    inline std::vector<uint_fast64_t> topK(const TwoSegArray<false, Allocator>& a, const uint_fast64_t& n, const uint_fast64_t& k)
+    {
+        return ranking::select(ranking::SegmentKeys{a.getHeads(), a.getTails()}, n, k);
+    }
+
+    template<class Allocator>
+    inline std::vector<uint_fast64_t> topK(const TwoSegArray<true, Allocator>& a, const uint_fast64_t& n, const uint_fast64_t& k)
+    {
+        return ranking::select(ranking::SegmentKeys{a.getHeads(), a.getTails()}, n, k);
+    }
+
+    inline std::vector<uint_fast64_t> topK(const HeadsSpan& a, const uint_fast64_t& n, const uint_fast64_t& k)
+    {
+        return ranking::select(ranking::SegmentKeys{a.getHeads(), a.getTails()}, n, k);
+    }
+
+    inline std::vector<uint_fast64_t> topK(const double* a, const uint_fast64_t& n, const uint_fast64_t& k)
+    {
+        return ranking::select(ranking::DoubleKeys{a}, n, k);
+    }
+
+    /*
+        A threshold with at least fraction of the n heads at or above it, found from their top 16 bits
+        (sign, exponent and 4 bits of mantissa of the double) in two passes of the radix select: it is the smallest
+        value with the same top bits as the head at the quantile, so within 1/16 of a binade below it.
+        INFINITY for a fraction of 0 (nothing is above it), -INFINITY for 1.
+    */
+    inline double headsQuantile(const float* heads, const uint_fast64_t& n, const double& fraction)
+    {
+        if(n == 0 || fraction <= 0.0) return INFINITY;
+        if(fraction >= 1.0) return -INFINITY;
+
+        const ranking::SegmentKeys keys{heads, nullptr};
+        uint_fast64_t need = std::max<uint_fast64_t>(1, static_cast<uint_fast64_t>(ceil(fraction * n)));
+        uint32_t prefix = 0, mask = 0;
+        uint_fast64_t hist[256];
+        for(int shift = 24; shift >= 16; shift -= 8)
+        {
+            ranking::histogram(keys, n, prefix, mask, shift, hist);
+            int digit = 255;
+            uint_fast64_t above = 0;
+            for(; digit > 0 && above + hist[digit] < need; --digit)
+                above += hist[digit];
+            need -= above;
+            prefix |= static_cast<uint32_t>(digit) << shift;
+            mask |= 255u << shift;
+        }
+        return ranking::keyValue(prefix);
+    }
+
+    namespace ranking
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* countTopBits for a prefix of the heads, eight at a time; returns its length */
+        MANSEG_TARGET_AVX2 inline uint_fast64_t countTopBitsAVX2(const float* heads, const uint_fast64_t& n, const int& shift, uint_fast64_t* counts)
+        {
+            uint_fast64_t i = 0;
+            const __m256i top = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            const __m128i by = _mm_cvtsi32_si128(shift);
+            alignas(32) uint32_t bucket[8];
+            for(; i < (n & ~uint_fast64_t(7)); i += 8)
+            {
+                // orderedKey: all the bits flipped for a negative head, the sign bit for any other
+                const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heads + i));
+                const __m256i flip = _mm256_or_si256(_mm256_srai_epi32(h, 31), top);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(bucket), _mm256_srl_epi32(_mm256_xor_si256(h, flip), by));
+                for(int k = 0; k < 8; ++k)
+                    ++counts[bucket[k]];
+            }
+            return i;
+        }
+#endif
+
+        /* adds to counts[key >> shift] for the ordered keys of n heads */
+        inline void countTopBits(const float* heads, const uint_fast64_t& n, const int& shift, uint_fast64_t* counts)
+        {
+            uint_fast64_t i = 0;
+#if defined(MANSEG_HAS_AVX2)
+            if(simdLevel() >= SIMD_AVX2) i = countTopBitsAVX2(heads, n, shift, counts);
+#endif
+            const SegmentKeys keys{heads, nullptr};
+            for(; i < n; ++i)
+                ++counts[keys.high(i) >> shift];
+        }
+    }
+
+    /*
+        Counts of heads by their top 12 + subBits bits: the sign, the exponent and the first subBits
+        bits of the mantissa, so 2^subBits buckets a binade, and with subBits 0 a bucket for each power
+        of two. The buckets are in the order of the values, from -NaN through -0 and +0 up to +NaN.
+    */
+    struct Log2Histogram
+    {
+        int subBits;
+        std::vector<uint_fast64_t> counts;
+
+        explicit Log2Histogram(const int& subBits = 0)
+            :subBits(subBits), counts(size_t(1) << (12 + subBits), 0)
+        {}
+
+        int shift() const { return 20 - subBits; }
+        size_t buckets() const { return counts.size(); }
+
+        uint_fast64_t total() const
+        {
+            uint_fast64_t t = 0;
+            for(const uint_fast64_t& c : counts)
+                t += c;
+            return t;
+        }
+
+        /* the bucket the head of value falls in */
+        size_t bucket(const double& value) const
+        {
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return ranking::orderedKey(static_cast<uint32_t>(bits >> 32)) >> shift();
+        }
+
+        /* the smallest and largest heads of bucket b */
+        double lower(const size_t& b) const { return ranking::keyValue(static_cast<uint32_t>(b << shift())); }
+        double upper(const size_t& b) const { return ranking::keyValue(static_cast<uint32_t>(((b + 1) << shift()) - 1)); }
+
+        /*
+            A threshold with at least fraction of the heads counted at or above it: the smallest head of
+            the bucket the quantile falls in, as headsQuantile gives for subBits 4. INFINITY for a fraction
+            of 0, -INFINITY for 1.
+        */
+        double quantile(const double& fraction) const
+        {
+            const uint_fast64_t n = total();
+            if(n == 0 || fraction <= 0.0) return INFINITY;
+            if(fraction >= 1.0) return -INFINITY;
+            const uint_fast64_t need = std::max<uint_fast64_t>(1, static_cast<uint_fast64_t>(ceil(fraction * n)));
+            uint_fast64_t above = 0;
+            size_t b = buckets() - 1;
+            for(; b > 0 && above + counts[b] < need; --b)
+                above += counts[b];
+            return lower(b);
+        }
+    };
+
+    /*
+        The histogram of the first n heads, 2^subBits buckets a binade (subBits at most 8). The heads
+        are divided between the workers of the parallel backend, each counting into buckets of its own.
+    */
+    inline Log2Histogram histogramLog2(const float* heads, const uint_fast64_t& n, const int& subBits = 0)
+    {
+        Log2Histogram hist(std::max(0, std::min(subBits, 8)));
+        const size_t buckets = hist.buckets();
+        const uint_fast64_t chunks = std::min<uint_fast64_t>(parallelChunks(n, 65536), parallelWorkers());
+        if(chunks <= 1)
+        {
+            ranking::countTopBits(heads, n, hist.shift(), hist.counts.data());
+            return hist;
+        }
+        std::vector<uint_fast64_t> local(chunks * buckets, 0);
+        parallelFor(chunks, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            for(uint_fast64_t c = begin; c < end; ++c)
+                ranking::countTopBits(heads + (n * c) / chunks, (n * (c + 1)) / chunks - (n * c) / chunks, hist.shift(), local.data() + c * buckets);
+        }, 1);
+        for(uint_fast64_t c = 0; c < chunks; ++c)
+            for(size_t b = 0; b < buckets; ++b)
+                hist.counts[b] += local[c * buckets + b];
+        return hist;
+    }
+
+    template<bool useTail, class Allocator>
+    inline Log2Histogram histogramLog2(const TwoSegArray<useTail, Allocator>& a, const uint_fast64_t& n, const int& subBits = 0)
+    {
+        return histogramLog2(a.getHeads(), n, subBits);
+    }
+
+    inline Log2Histogram histogramLog2(const HeadsSpan& a, const uint_fast64_t& n, const int& subBits = 0)
+    {
+        return histogramLog2(a.getHeads(), n, subBits);
+    }
+
+    /*
+        For each fraction, a threshold with at least that share of the n heads at or above it, from a
+        single histogram of 2^subBits buckets a binade: within 2^-subBits of a binade below the head at
+        the quantile. With subBits 4, the thresholds headsQuantile gives, in one pass for all of them.
+    */
+    inline std::vector<double> quantiles(const float* heads, const uint_fast64_t& n, const std::vector<double>& fractions, const int& subBits = 4)
+    {
+        const Log2Histogram hist = histogramLog2(heads, n, subBits);
+        std::vector<double> q;
+        q.reserve(fractions.size());
+        for(const double& f : fractions)
+            q.push_back(hist.quantile(f));
+        return q;
+    }
+
+    template<bool useTail, class Allocator>
+    inline std::vector<double> quantiles(const TwoSegArray<useTail, Allocator>& a, const uint_fast64_t& n, const std::vector<double>& fractions, const int& subBits = 4)
+    {
+        return quantiles(a.getHeads(), n, fractions, subBits);
+    }
+
+    inline std::vector<double> quantiles(const HeadsSpan& a, const uint_fast64_t& n, const std::vector<double>& fractions, const int& subBits = 4)
+    {
+        return quantiles(a.getHeads(), n, fractions, subBits);
+    }
+}
+
+#endif
@@ -0,0 +1,215 @@
+/*
+	Base plus correction storage for the late iterations of a solver.
+	Author: harunadess
+
+	Once an iterate has nearly converged its updates are tiny next to its values, yet the pairs or
+	the full doubles still read and write all 64 bits of every value each iteration. A BaseSnapshot
+	freezes the values at full precision, and the solver goes on iterating on a correction held in
+	heads (e.g. the heads of the arrays it was already using, which are idle at full precision):
+		BaseSnapshot<> base(n);
+		base.freeze(0, n, x.full);                       // x's values now, correction zero
+		memset(x.heads.getHeads(), 0, n * sizeof(float));
+		CorrectedView v = base.view(x.heads.getHeads(), 0, n);
+		... kernels read v[i] == base + correction, and v.set(i, t) stores t - base in the correction ...
+		base.rebase(0, n, x.heads.getHeads());           // now and then: base += correction, correction = 0
+	The values written are those the iteration computes, to the truncation of their difference from
+	the base to a head: 20 bits relative to the correction rather than to the value, so a correction a
+	thousandth of its value keeps the value to about 30 bits. Rebasing folds the correction back into the
+	base before it grows large enough to cost precision. The correction is the only array the iterations
+	write, at 4 bytes a value; the base is read only, and is placed as the tails are (placeTails), so a
+	TieredSegmentAllocator puts it on the capacity node. CorrectedView has the interface of the other
+	views (operator[], read, set<mode>, readBlock and writeBlock), so the kernels templated on a view,
+	such as stencil5, run on it.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_REFINE_H__
+#define __MANSEG_REFINE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /*
+        Values as a read only base of doubles plus a correction in heads, both n long from the start
+        of the view (see manseglib_refine.hpp). Like the other views, it does not own the values.
+    */
+    class CorrectedView
+    {
+    public:
+        CorrectedView(const double* base = nullptr, float* correction = nullptr, const uint_fast64_t& length = 0)
+            :base(base), correction(correction), length(length)
+        {}
+
+        double operator[](const uint_fast64_t& id) const { return read(id); }
+
+        double read(const uint_fast64_t& id) const
+        {
+            MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double));
+            MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+            return base[id] + headToDouble(correction[id]);
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double));
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+            correction[id] = roundToHead<mode>(static_cast<double>(t) - base[id]);
+        }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double) * n);
+            MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+            const double* b = base + start;
+            const float* c = correction + start;
+            for(uint_fast64_t i = 0; i < n; ++i)
+                out[i] = b[i] + headToDouble(c[i]);
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in) const
+        {
+            MANSEG_TRAFFIC_ADD(FULL_READ, sizeof(double) * n);
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float) * n);
+            const double* b = base + start;
+            float* c = correction + start;
+            for(uint_fast64_t i = 0; i < n; ++i)
+                c[i] = roundToHead<mode>(in[i] - b[i]);
+        }
+
+        CorrectedView subspan(const uint_fast64_t& start, const uint_fast64_t& n) const
+        {
+            return CorrectedView(base + start, correction + start, n);
+        }
+
+        const double* getBase() const { return base; }
+        float* getCorrection() const { return correction; }
+        uint_fast64_t size() const { return length; }
+
+    private:
+        const double* base;
+        float* correction;
+        uint_fast64_t length;
+    };
+
+    /*
+        The frozen base of n values, allocated by allocator and placed as its tails would be. The
+        corrections are the caller's, e.g. the heads of the arrays it iterates on; any number of them
+        (such as the two arrays of a Jacobi sweep) can be taken against the same base.
+        It can be moved but not copied.
+    */
+    template<class Allocator = SegmentAllocator>
+    class BaseSnapshot
+    {
+    public:
+        BaseSnapshot(const uint_fast64_t& n = 0, const Allocator& allocator = Allocator())
+            :base(nullptr), length(0), allocator(allocator)
+        {
+            if(n > 0)
+                alloc(n);
+        }
+
+        BaseSnapshot(const BaseSnapshot&) = delete;
+        BaseSnapshot& operator=(const BaseSnapshot&) = delete;
+
+        BaseSnapshot(BaseSnapshot&& other)
+            :base(other.base), length(other.length), allocator(other.allocator)
+        {
+            other.base = nullptr;
+            other.length = 0;
+        }
+
+        ~BaseSnapshot() { free(); }
+
+        void alloc(const uint_fast64_t& n)
+        {
+            free();
+            length = n;
+            base = allocator.template allocate<double>(n, false);
+            trackPlane(allocator, base, n * sizeof(double), Memory::PLANE_BASE, base);
+            // the base is read only and cold, as the tails are while at the heads
+            placeTails(allocator, reinterpret_cast<float*>(base), 2 * n);
+        }
+
+        void free()
+        {
+            if(base != nullptr)
+            {
+                untrackPlane(allocator, base);
+                allocator.deallocate(base, length);
+            }
+            base = nullptr;
+            length = 0;
+        }
+
+        /* base[start, start + n) = values[0, n); the corrections taken against it must be zeroed too */
+        void freeze(const uint_fast64_t& start, const uint_fast64_t& n, const double* values)
+        {
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double) * n);
+            memcpy(base + start, values, n * sizeof(double));
+        }
+
+        /*
+            Folds correction[0, n) into base[start, start + n) and zeroes it. Any other correction taken
+            against that part of the base is then out of date, so rebase when the others are about to be
+            overwritten, as the input of a Jacobi sweep is rebased before the sweep into the other grid.
+        */
+        void rebase(const uint_fast64_t& start, const uint_fast64_t& n, float* correction)
+        {
+            MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float) * n);
+            MANSEG_TRAFFIC_ADD(FULL_WRITTEN, sizeof(double) * n);
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float) * n);
+            double* b = base + start;
+            for(uint_fast64_t i = 0; i < n; ++i)
+                b[i] += headToDouble(correction[i]);
+            memset(correction, 0, n * sizeof(float));
+        }
+
+        /* the values base[start, start + n) + correction[0, n), e.g. to write back to full at the end */
+        void combine(const uint_fast64_t& start, const uint_fast64_t& n, const float* correction, double* out) const
+        {
+            CorrectedView(base + start, const_cast<float*>(correction), n).readBlock(0, n, out);
+        }
+
+        /* base[start, start + n) plus the correction, as a view indexed from 0 */
+        CorrectedView view(float* correction, const uint_fast64_t& start, const uint_fast64_t& n) const
+        {
+            return CorrectedView(base + start, correction, n);
+        }
+
+        double* getBase() const { return base; }
+        uint_fast64_t size() const { return length; }
+        const Allocator& getAllocator() const { return allocator; }
+
+    private:
+        double* base;
+        uint_fast64_t length;
+        Allocator allocator;
+    };
+}
+
+#endif // __MANSEG_REFINE_H__
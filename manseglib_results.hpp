@@ -0,0 +1,508 @@
+/*
+	Machine readable results for the benchmark drivers.
+	Author: harunadess
+
+	A driver fills a ResultsWriter with a record per iteration (delta, time, precision level and the
+	bytes it touched), a few run settings (threads, NUMA placement, input, ...) and the final error
+	against a double precision reference, and writes it as JSON or CSV (chosen by the extension):
+		ResultsWriter results("msa_pagerank");      // writes to $MANSEG_RESULTS, if set
+		results.set("threads", 1);
+		results.iteration(iter, delta, seconds, levelName(control.level()), bytes);
+		if(loadReference(getenv("MANSEG_REFERENCE"), ref)) results.finalError(relativeError(x.full, n, ref));
+		results.write();
+	Without a path every call does nothing, so the drivers can record unconditionally.
+	With $MANSEG_TELEMETRY set to a shared memory name, each iteration is also published there as it
+	is recorded, path or not, for bench/telemetry_export to read while the run goes on (see
+	manseglib_telemetry.hpp).
+	Drivers that repeat the computation number the rounds with round(r), and can record each round's
+	time with endRound. Drivers that measure energy (see manseglib_energy.hpp) add the joules of each
+	iteration with energy(package, dram) after recording it.
+	JSON has the run settings under "run" and arrays of "iterations" and "rounds"; CSV has a row per
+	iteration and one per round (level "round", no iter), with the settings and final error repeated
+	on every row. An iteration's energy is written as package_joules and dram_joules, in JSON only
+	where it was measured.
+	Solutions are saved with writeValues and read back with loadReference, as text (one value per
+	line) or, for a path ending in .bin, as binary: the 8 bytes "MSVALUES", the number of values as
+	a uint64_t, then the values as doubles, all in the machine's byte order. Binary files are written
+	in large blocks and read back exactly, so saving and comparing a large grid costs little next to
+	the solve; bench/valdiff compares two files of either kind.
+	A run can also leave a snapshot of its solution for the next one to start from, as segment planes:
+	writeSegments saves the 8 bytes "MSSEGMNT" and the count, then from the next 4096 byte boundary the
+	heads (high halves of the doubles) and from the boundary after them the tails (low halves), so that
+	each plane can be read, or mapped, without the other. warmStart reads back the heads plane alone,
+	for a run that begins in the heads, renumbered for a graph that has since gained or lost vertices:
+		warmStart(getenv("MANSEG_WARM_START"), getenv("MANSEG_WARM_MAP"), n, start);   // false: cold start
+		writeSegments(getenv("MANSEG_SNAPSHOT"), x.full, n);
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_RESULTS_H__
+#define __MANSEG_RESULTS_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "manseglib_telemetry.hpp"
+
+namespace ManSeg
+{
+    /* start of a binary values file, followed by the count and the doubles */
+    static const char valuesMagic[8] = { 'M', 'S', 'V', 'A', 'L', 'U', 'E', 'S' };
+
+    /* whether writeValues saves to path in binary */
+    inline bool binaryValuesPath(const char* path)
+    {
+        size_t len = strlen(path);
+        return len >= 4 && strcmp(path + len - 4, ".bin") == 0;
+    }
+
+    /*
+        Reads a reference solution: a binary values file, or text with one value per line, of which
+        only the last number on a line is used, so files of "index value" lines work as well.
+        Returns false if path is null, unreadable or a truncated binary file.
+    */
+    inline bool loadReference(const char* path, std::vector<double>& ref)
+    {
+        ref.clear();
+        if(path == nullptr || *path == '\0') return false;
+        FILE* f = fopen(path, "rb");
+        if(f == nullptr) return false;
+
+        char magic[sizeof(valuesMagic)];
+        uint64_t count = 0;
+        if(fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, valuesMagic, sizeof(magic)) == 0)
+        {
+            bool ok = fread(&count, sizeof(count), 1, f) == 1;
+            if(ok)
+            {
+                ref.resize(count);
+                ok = fread(ref.data(), sizeof(double), count, f) == count;
+            }
+            fclose(f);
+            if(!ok) ref.clear();
+            return ok && !ref.empty();
+        }
+        rewind(f);
+
+        char line[256];
+        while(fgets(line, sizeof(line), f) != nullptr)
+        {
+            char* last = nullptr;
+            for(char* tok = strtok(line, " \t\r\n,"); tok != nullptr; tok = strtok(nullptr, " \t\r\n,"))
+                last = tok;
+            if(last != nullptr)
+                ref.push_back(atof(last));
+        }
+        fclose(f);
+        return !ref.empty();
+    }
+
+    /*
+        Writes n values of x in a format loadReference reads: binary if path ends in .bin (in blocks of
+        doubles, one fwrite each), otherwise one value per line.
+    */
+    template<class View>
+    bool writeValues(const char* path, View x, const uint_fast64_t& n)
+    {
+        if(path == nullptr || *path == '\0') return false;
+        const bool binary = binaryValuesPath(path);
+        FILE* f = fopen(path, binary ? "wb" : "w");
+        if(f == nullptr) return false;
+        bool ok = true;
+        if(binary)
+        {
+            const uint64_t count = n;
+            ok = fwrite(valuesMagic, 1, sizeof(valuesMagic), f) == sizeof(valuesMagic)
+                && fwrite(&count, sizeof(count), 1, f) == 1;
+            std::vector<double> block(std::min<uint_fast64_t>(n, 1 << 20));
+            for(uint_fast64_t start = 0; ok && start < n; start += block.size())
+            {
+                const uint_fast64_t m = std::min<uint_fast64_t>(block.size(), n - start);
+                for(uint_fast64_t i = 0; i < m; ++i)
+                    block[i] = (double)x[start + i];
+                ok = fwrite(block.data(), sizeof(double), m, f) == m;
+            }
+        }
+        else
+            for(uint_fast64_t i = 0; i < n; ++i)
+                fprintf(f, "%.17g\n", (double)x[i]);
+        return (fclose(f) == 0) && ok;
+    }
+
+    /* ||x - ref||_1 / ||ref||_1 for the n values of x, or NAN if ref does not have n values */
+    template<class View>
+    double relativeError(View x, const uint_fast64_t& n, const std::vector<double>& ref)
+    {
+        if(ref.size() != n) return NAN;
+        double diff = 0., norm = 0.;
+        for(uint_fast64_t i = 0; i < n; ++i)
+        {
+            diff += fabs((double)x[i] - ref[i]);
+            norm += fabs(ref[i]);
+        }
+        return norm > 0. ? diff/norm : diff;
+    }
+
+    /* start of a segments file, followed by the count, the heads plane and the tails plane */
+    static const char segmentsMagic[8] = { 'M', 'S', 'S', 'E', 'G', 'M', 'N', 'T' };
+
+    /* boundary each plane of a segments file starts at, so that either can be mapped on its own */
+    static const uint64_t segmentsAlignment = 4096;
+
+    /* offset of the heads plane of a segments file, past the magic and count */
+    inline uint64_t segmentsHeadsOffset()
+    {
+        return segmentsAlignment;
+    }
+
+    /* offset of the tails plane of a segments file of count values, at the first boundary past the heads */
+    inline uint64_t segmentsTailsOffset(const uint64_t& count)
+    {
+        return segmentsHeadsOffset() + (count * sizeof(uint32_t) + segmentsAlignment - 1) / segmentsAlignment * segmentsAlignment;
+    }
+
+    /* writes zeros to f from position at up to offset, which is where the next plane starts */
+    inline bool padSegments(FILE* f, const uint64_t& at, const uint64_t& offset)
+    {
+        static const char zeros[segmentsAlignment] = {};
+        return at <= offset && fwrite(zeros, 1, offset - at, f) == offset - at;
+    }
+
+    /* opens path and writes the start of a segments file of count values, up to its heads plane */
+    inline FILE* beginSegments(const char* path, const uint64_t& count)
+    {
+        if(path == nullptr || *path == '\0') return nullptr;
+        FILE* f = fopen(path, "wb");
+        if(f == nullptr) return nullptr;
+        if(fwrite(segmentsMagic, 1, sizeof(segmentsMagic), f) != sizeof(segmentsMagic) || fwrite(&count, sizeof(count), 1, f) != 1
+            || !padSegments(f, sizeof(segmentsMagic) + sizeof(count), segmentsHeadsOffset()))
+        {
+            fclose(f);
+            return nullptr;
+        }
+        return f;
+    }
+
+    /* Writes n values of x to path as a segments file (see above), a plane at a time in blocks */
+    template<class View>
+    bool writeSegments(const char* path, View x, const uint_fast64_t& n)
+    {
+        FILE* f = beginSegments(path, n);
+        if(f == nullptr) return false;
+        bool ok = true;
+        std::vector<uint32_t> block(std::min<uint_fast64_t>(n, 1 << 20));
+        for(int shift = 32; shift >= 0; shift -= 32)
+        {
+            if(shift == 0)
+                ok = ok && padSegments(f, segmentsHeadsOffset() + n * sizeof(uint32_t), segmentsTailsOffset(n));
+            for(uint_fast64_t start = 0; ok && start < n; start += block.size())
+            {
+                const uint_fast64_t m = std::min<uint_fast64_t>(block.size(), n - start);
+                for(uint_fast64_t i = 0; i < m; ++i)
+                {
+                    const double v = (double)x[start + i];
+                    uint64_t bits;
+                    memcpy(&bits, &v, sizeof(bits));
+                    block[i] = (uint32_t)(bits >> shift);
+                }
+                ok = fwrite(block.data(), sizeof(uint32_t), m, f) == m;
+            }
+        }
+        return (fclose(f) == 0) && ok;
+    }
+
+    /*
+        Reads a segments file into values: the heads alone (rounded toward zero, as a heads array
+        holds them), or with withTails the doubles that were saved. False if path is null, unreadable
+        or not a whole segments file. (manseglib_mapped.hpp maps one instead.)
+    */
+    inline bool loadSegments(const char* path, std::vector<double>& values, const bool& withTails = false)
+    {
+        values.clear();
+        if(path == nullptr || *path == '\0') return false;
+        FILE* f = fopen(path, "rb");
+        if(f == nullptr) return false;
+        char magic[sizeof(segmentsMagic)];
+        uint64_t count = 0;
+        std::vector<char> padding(segmentsAlignment);
+        bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, segmentsMagic, sizeof(magic)) == 0
+            && fread(&count, sizeof(count), 1, f) == 1;
+        // the planes start at page boundaries, reached by reading past the padding rather than seeking
+        const uint64_t headsPadding = segmentsHeadsOffset() - sizeof(magic) - sizeof(count);
+        ok = ok && fread(padding.data(), 1, headsPadding, f) == headsPadding;
+        std::vector<uint32_t> heads, tails;
+        if(ok)
+        {
+            heads.resize(count);
+            ok = fread(heads.data(), sizeof(uint32_t), count, f) == count;
+        }
+        if(ok && withTails)
+        {
+            const uint64_t tailsPadding = segmentsTailsOffset(count) - segmentsHeadsOffset() - count * sizeof(uint32_t);
+            tails.resize(count);
+            ok = fread(padding.data(), 1, tailsPadding, f) == tailsPadding
+                && fread(tails.data(), sizeof(uint32_t), count, f) == count;
+        }
+        fclose(f);
+        if(!ok) return false;
+        values.resize(count);
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            const uint64_t bits = ((uint64_t)heads[i] << 32) | (withTails ? tails[i] : 0);
+            memcpy(&values[i], &bits, sizeof(double));
+        }
+        return true;
+    }
+
+    /*
+        Starting values for a run on n vertices from the heads of the snapshot at path, made by a run
+        on a graph that may since have changed. mapPath, if given, is a values file (see loadReference)
+        with the new number of each vertex of the snapshot, negative for a deleted one; without it
+        vertex v keeps its number, and those not below n are deleted. Vertices that no old vertex maps
+        to are new, and start at 1/n as in a cold start; then the values are scaled to sum to 1.
+        False, leaving start empty, if there is no snapshot or mapPath cannot be read.
+    */
+    inline bool warmStart(const char* path, const char* mapPath, const uint_fast64_t& n, std::vector<double>& start)
+    {
+        start.clear();
+        std::vector<double> old, map;
+        if(!loadSegments(path, old))
+            return false;
+        const bool mapped = mapPath != nullptr && *mapPath != '\0';
+        if(mapped && (!loadReference(mapPath, map) || map.size() != old.size()))
+            return false;
+
+        std::vector<bool> carried(n, false);
+        start.assign(n, 0.0);
+        for(uint_fast64_t i = 0; i < old.size(); ++i)
+        {
+            const double to = mapped ? map[i] : (double)i;
+            if(to >= 0 && to < (double)n)
+            {
+                start[(uint_fast64_t)to] += old[i];
+                carried[(uint_fast64_t)to] = true;
+            }
+        }
+        double sum = 0.0;
+        for(uint_fast64_t v = 0; v < n; ++v)
+        {
+            if(!carried[v])
+                start[v] = 1.0/n;
+            sum += start[v];
+        }
+        if(sum > 0.0)
+            for(uint_fast64_t v = 0; v < n; ++v)
+                start[v] /= sum;
+        return true;
+    }
+
+    class ResultsWriter
+    {
+    public:
+        /* path defaults to $MANSEG_RESULTS; a path ending in .csv is written as CSV, anything else as JSON */
+        ResultsWriter(const char* app, const char* path = getenv("MANSEG_RESULTS"))
+            :app(app), path(path != nullptr ? path : ""), error(NAN), currentRound(-1),
+            telemetry(std::make_shared<Telemetry>(app, getenv("MANSEG_TELEMETRY")))
+        {}
+
+        bool enabled() const { return !path.empty(); }
+
+        /* run settings, written once for JSON and on every row for CSV */
+        void set(const char* key, const char* value) { addSetting(key, quote(value)); }
+        void set(const char* key, const std::string& value) { addSetting(key, quote(value.c_str())); }
+        void set(const char* key, const double& value) { addSetting(key, number(value)); }
+        void set(const char* key, const int& value) { addSetting(key, number(value)); }
+        void set(const char* key, const long& value) { addSetting(key, number((double)value)); }
+
+        /* round of a driver that repeats the computation; recorded with each iteration */
+        void round(const int& r) { currentRound = r; }
+
+        /* time of the current round */
+        void endRound(const double& seconds)
+        {
+            if(!enabled()) return;
+            Record rec = { currentRound, -1, NAN, seconds, "round", NAN, NAN, NAN };
+            rounds.push_back(rec);
+        }
+
+        /* bytes is the driver's estimate of the memory traffic of the iteration */
+        void iteration(const int& iter, const double& delta, const double& seconds, const char* level, const double& bytes)
+        {
+            telemetry->publish(currentRound, iter, delta, seconds, level, bytes);
+            if(!enabled()) return;
+            Record rec = { currentRound, iter, delta, seconds, level, bytes, NAN, NAN };
+            records.push_back(rec);
+        }
+
+        /* joules used by the packages and the DRAM during the iteration recorded last */
+        void energy(const double& package, const double& dram)
+        {
+            if(!enabled() || records.empty()) return;
+            records.back().package = package;
+            records.back().dram = dram;
+        }
+
+        /* error of the final solution relative to a double precision reference */
+        void finalError(const double& e) { error = e; }
+
+        /* writes everything recorded so far, returning false if there is no path or it cannot be opened */
+        bool write() const
+        {
+            if(!enabled()) return false;
+            FILE* f = fopen(path.c_str(), "w");
+            if(f == nullptr)
+            {
+                fprintf(stderr, "ResultsWriter: cannot open %s\n", path.c_str());
+                return false;
+            }
+            if(path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0)
+                writeCSV(f);
+            else
+                writeJSON(f);
+            fclose(f);
+            return true;
+        }
+
+    private:
+        struct Record
+        {
+            int round;
+            int iter;
+            double delta;
+            double seconds;
+            const char* level;
+            double bytes;
+            double package;
+            double dram;
+        };
+
+        std::string app;
+        std::string path;
+        std::vector<std::string> keys;
+        std::vector<std::string> values;    // as JSON literals
+        std::vector<Record> records;
+        std::vector<Record> rounds;
+        double error;
+        int currentRound;
+        std::shared_ptr<Telemetry> telemetry;   // shared by copies, so the block is marked finished once
+
+        void addSetting(const char* key, const std::string& value)
+        {
+            for(size_t i = 0; i < keys.size(); ++i)
+                if(keys[i] == key)
+                {
+                    values[i] = value;
+                    return;
+                }
+            keys.push_back(key);
+            values.push_back(value);
+        }
+
+        static std::string number(const double& x)
+        {
+            if(x != x || fabs(x) == INFINITY) return "null";
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", x);
+            return buf;
+        }
+
+        static std::string quote(const char* s)
+        {
+            std::string q = "\"";
+            for(; *s != '\0'; ++s)
+            {
+                if(*s == '"' || *s == '\\') q += '\\';
+                q += *s;
+            }
+            return q + "\"";
+        }
+
+        /* JSON literal as a CSV field: strings lose their quotes (and commas), null is empty */
+        static std::string field(const std::string& literal)
+        {
+            if(literal == "null") return "";
+            if(literal.empty() || literal[0] != '"') return literal;
+            std::string s;
+            for(size_t i = 1; i + 1 < literal.size(); ++i)
+            {
+                if(literal[i] == '\\') ++i;
+                s += literal[i] == ',' ? ';' : literal[i];
+            }
+            return s;
+        }
+
+        void writeJSON(FILE* f) const
+        {
+            fprintf(f, "{\n  \"app\": %s,\n  \"run\": {", quote(app.c_str()).c_str());
+            for(size_t i = 0; i < keys.size(); ++i)
+                fprintf(f, "%s\n    %s: %s", i == 0 ? "" : ",", quote(keys[i].c_str()).c_str(), values[i].c_str());
+            fprintf(f, "\n  },\n  \"iterations\": [");
+            for(size_t i = 0; i < records.size(); ++i)
+            {
+                const Record& r = records[i];
+                fprintf(f, "%s\n    {", i == 0 ? "" : ",");
+                if(r.round >= 0)
+                    fprintf(f, "\"round\": %d, ", r.round);
+                fprintf(f, "\"iter\": %d, \"level\": %s, \"delta\": %s, \"time\": %s, \"bytes\": %s", r.iter, quote(r.level).c_str(),
+                    number(r.delta).c_str(), number(r.seconds).c_str(), number(r.bytes).c_str());
+                if(r.package == r.package)
+                    fprintf(f, ", \"package_joules\": %s, \"dram_joules\": %s", number(r.package).c_str(), number(r.dram).c_str());
+                fprintf(f, "}");
+            }
+            fprintf(f, "\n  ],\n  \"rounds\": [");
+            for(size_t i = 0; i < rounds.size(); ++i)
+                fprintf(f, "%s\n    {\"round\": %d, \"time\": %s}", i == 0 ? "" : ",", rounds[i].round, number(rounds[i].seconds).c_str());
+            fprintf(f, "\n  ],\n  \"final_error\": %s\n}\n", number(error).c_str());
+        }
+
+        void writeCSV(FILE* f) const
+        {
+            fprintf(f, "app,round,iter,level,delta,time,bytes,package_joules,dram_joules,final_error");
+            for(size_t i = 0; i < keys.size(); ++i)
+                fprintf(f, ",%s", keys[i].c_str());
+            fprintf(f, "\n");
+            for(size_t i = 0; i < records.size(); ++i)
+                writeRow(f, records[i]);
+            for(size_t i = 0; i < rounds.size(); ++i)
+                writeRow(f, rounds[i]);
+        }
+
+        void writeRow(FILE* f, const Record& r) const
+        {
+            fprintf(f, "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s", field(quote(app.c_str())).c_str(), r.round >= 0 ? number(r.round).c_str() : "",
+                r.iter >= 0 ? number(r.iter).c_str() : "", r.level, field(number(r.delta)).c_str(), field(number(r.seconds)).c_str(),
+                field(number(r.bytes)).c_str(), field(number(r.package)).c_str(), field(number(r.dram)).c_str(), field(number(error)).c_str());
+            for(size_t k = 0; k < values.size(); ++k)
+                fprintf(f, ",%s", field(values[k]).c_str());
+            fprintf(f, "\n");
+        }
+    };
+}
+
+#endif // __MANSEG_RESULTS_H__
@@ -0,0 +1,124 @@
+/*
+	Precision schedules known at compile time.
+	Author: harunadess
+
+	Where the schedule of a solver is known in advance (say 20 iterations at the heads, the interim
+	iteration, then full precision), a FixedSchedule makes it a type, and runSchedule runs each phase
+	as a loop of its own over an iteration body instantiated for that level:
+		struct Sweep
+		{
+			template<PrecisionLevel L> double iterate(const int& iter);   // the delta of iteration iter
+		};
+		int iterations = runSchedule<FixedSchedule<20> >(sweep, maxIterations, tolerance);
+	Inside iterate<L> the level is a constant, so the kernels, views and swaps it picks with it are
+	resolved by the compiler, and the loops neither branch on the level nor ask a controller anything:
+	the deltas at the heads are not even looked at. The full phase runs until an iteration's delta is
+	within tolerance, or maxIterations in all, and runSchedule returns the number of iterations run.
+	The level of an iteration is also a constant expression, for static_assert or to size things:
+		static_assert(FixedSchedule<20>::levelAt(20) == PRECISION_INTERIM, "");
+	A PrecisionController runs the same body with the switch decided at run time (the same loops, with
+	an update after each iteration at the heads):
+		PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment());
+		int iterations = runSchedule(control, sweep, maxIterations, tolerance);
+	so a driver can keep the dynamic controller as an opt in next to its fixed schedule.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_SCHEDULE_H__
+#define __MANSEG_SCHEDULE_H__
+
+#include "manseglib_controller.hpp"
+
+namespace ManSeg
+{
+    /*
+        Heads iterations at the heads, then (with UseInterim) the interim iteration, then full precision.
+        FixedSchedule<0, false> is full precision throughout.
+    */
+    template<int Heads, bool UseInterim = true>
+    struct FixedSchedule
+    {
+        static_assert(Heads >= 0, "a schedule cannot have fewer than no iterations at the heads");
+
+        static constexpr int heads = Heads;
+        static constexpr int interim = (UseInterim && Heads > 0) ? 1 : 0;
+
+        /* level of iteration iter, counted from 0 */
+        static constexpr PrecisionLevel levelAt(const int iter)
+        {
+            return iter < heads ? PRECISION_HEADS : iter < heads + interim ? PRECISION_INTERIM : PRECISION_FULL;
+        }
+
+        /* number of iterations completed before level is entered, as PrecisionController::switchIteration */
+        static constexpr int switchIteration(const PrecisionLevel level = PRECISION_FULL)
+        {
+            return level == PRECISION_HEADS ? 0 : level == PRECISION_INTERIM ? (interim ? heads : -1) : heads + interim;
+        }
+
+        static const char* name() { return "fixed"; }
+    };
+
+    /*
+        The iterations of Schedule, each phase a loop of body.iterate<level>(iter); the full phase ends at
+        a delta within tolerance. Returns the number of iterations run, at most maxIterations.
+    */
+    template<class Schedule, class Body>
+    int runSchedule(Body& body, const int& maxIterations, const double& tolerance = 0.0)
+    {
+        int heads = Schedule::heads;
+        if(heads > maxIterations)
+            heads = maxIterations;
+        int iter = 0;
+        for(; iter < heads; ++iter)
+            body.template iterate<PRECISION_HEADS>(iter);
+        if(Schedule::interim && iter < maxIterations)
+            body.template iterate<PRECISION_INTERIM>(iter++);
+        while(iter < maxIterations)
+            if(body.template iterate<PRECISION_FULL>(iter++) <= tolerance)
+                break;
+        return iter;
+    }
+
+    /*
+        The same iterations with the switch decided by control, updated with the delta of every
+        iteration; the heads are left when it says so.
+    */
+    template<class Policy, class Body>
+    int runSchedule(PrecisionController<Policy>& control, Body& body, const int& maxIterations, const double& tolerance = 0.0)
+    {
+        int iter = 0;
+        while(iter < maxIterations && control.level() == PRECISION_HEADS)
+            control.update(body.template iterate<PRECISION_HEADS>(iter++));
+        if(iter < maxIterations && control.level() == PRECISION_INTERIM)
+            control.update(body.template iterate<PRECISION_INTERIM>(iter++));
+        while(iter < maxIterations)
+        {
+            double delta = body.template iterate<PRECISION_FULL>(iter++);
+            control.update(delta);
+            if(delta <= tolerance)
+                break;
+        }
+        return iter;
+    }
+}
+
+#endif // __MANSEG_SCHEDULE_H__
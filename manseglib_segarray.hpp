@@ -0,0 +1,429 @@
+/*
+	Generalised mantissa segmentation: a double split into NumSegments planes of SegmentBits bits each.
+	Author: harunadess
+
+	Extends the two segment (32/32) representation of manseglib.hpp to a ladder of precision levels.
+	With 16 bit segments for example, level 1 holds the sign, exponent and 4 mantissa bits, level 2
+	holds 20 mantissa bits (the same as a Head), level 3 holds 36, and level 4 the full double.
+	Each plane is a separate array, so a sweep at level k reads (and writes) only k planes, and the memory
+	traffic of the sweep is proportional to k.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_SEGARRAY_H__
+#define __MANSEG_SEGARRAY_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    // storage type of a single segment
+    template<int SegmentBits>
+    struct SegmentType;
+
+    template<>
+    struct SegmentType<8> { typedef uint8_t type; };
+
+    template<>
+    struct SegmentType<16> { typedef uint16_t type; };
+
+    template<>
+    struct SegmentType<32> { typedef uint32_t type; };
+
+    inline uint64_t doubleBits(const double& d)
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(double));
+        return bits;
+    }
+
+    inline double bitsDouble(const uint64_t& bits)
+    {
+        double d;
+        memcpy(&d, &bits, sizeof(double));
+        return d;
+    }
+
+    /*
+        Array of doubles stored as NumSegments planes of SegmentBits bits.
+        Plane 0 holds the most significant bits (sign, exponent and leading mantissa bits),
+        plane NumSegments - 1 the least significant.
+        Values are accessed at a compile-time precision level 1 <= Level <= NumSegments, which reads
+        and writes only the first Level planes; bits of the remaining planes read as zero (truncation),
+        and writes at a lower level leave them untouched, as with TwoSegArray<false>.
+
+        Note: the class deconstructor does not free space automatically, so use the del function to clean up.
+    */
+    template<int NumSegments, int SegmentBits = 64 / NumSegments>
+    class SegArray
+    {
+        static_assert(NumSegments * SegmentBits == 64, "segments must make up exactly 64 bits");
+        static_assert(NumSegments >= 2, "at least two segments are required");
+
+    public:
+        typedef typename SegmentType<SegmentBits>::type segment_t;
+
+        static constexpr int Segments = NumSegments;
+        static constexpr int Bits = SegmentBits;
+
+        /* number of mantissa bits available at precision level (excluding the implicit bit) */
+        static constexpr int mantissaBits(const int level) { return level * SegmentBits - 12; }
+
+        /*
+            Proxy for a single value at a given precision level.
+            Behaves like a double, in the same way as Head and Pair.
+        */
+        template<int Level>
+        class Ref
+        {
+        public:
+            Ref(SegArray& a, const uint_fast64_t& id)
+                :a(a), id(id)
+            {}
+
+            operator double() const { return a.template read<Level>(id); }
+
+            Ref& operator=(const double& d) { a.template write<Level>(id, d); return *this; }
+            Ref& operator=(const Ref& o) { a.template write<Level>(id, static_cast<double>(o)); return *this; }
+
+            double operator+=(const double& d) { double t = *this; t += d; *this = t; return t; }
+            double operator-=(const double& d) { double t = *this; t -= d; *this = t; return t; }
+            double operator*=(const double& d) { double t = *this; t *= d; *this = t; return t; }
+            double operator/=(const double& d) { double t = *this; t /= d; *this = t; return t; }
+
+        private:
+            SegArray& a;
+            uint_fast64_t id;
+        };
+
+        /*
+            Array-like access to a SegArray at a fixed precision level,
+            analogous to HeadsArray/PairsArray for TwoSegArray.
+        */
+        template<int Level>
+        class View
+        {
+            static_assert(Level >= 1 && Level <= NumSegments, "invalid precision level");
+        public:
+            View(SegArray& a)
+                :a(&a)
+            {}
+
+            Ref<Level> operator[](const uint_fast64_t& id) { return Ref<Level>(*a, id); }
+            double read(const uint_fast64_t& id) const { return a->template read<Level>(id); }
+
+            void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+            {
+                a->template readBlock<Level>(start, n, out);
+            }
+            void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+            {
+                a->template writeBlock<Level>(start, n, in);
+            }
+
+        private:
+            SegArray* a;
+        };
+
+        SegArray()
+        {
+            for(int s = 0; s < NumSegments; ++s)
+                planes[s] = nullptr;
+            length = 0;
+        }
+
+        SegArray(const uint_fast64_t& length)
+        {
+            alloc(length);
+        }
+
+        ~SegArray() { }
+
+        /*
+            Allocates length elements; all planes other than the first are zero initialised,
+            so values written at a lower level read back exactly at a higher one.
+        */
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            planes[0] = new segment_t[length];
+            for(int s = 1; s < NumSegments; ++s)
+                planes[s] = new segment_t[length] ();
+        }
+
+        bool isAlloc() { return planes[0] != nullptr; }
+
+        uint_fast64_t size() const { return length; }
+
+        template<int Level>
+        View<Level> level() { return View<Level>(*this); }
+
+        template<int Level>
+        double read(const uint_fast64_t& id) const
+        {
+            static_assert(Level >= 1 && Level <= NumSegments, "invalid precision level");
+            uint64_t bits = 0;
+            for(int s = 0; s < Level; ++s)
+                bits |= static_cast<uint64_t>(planes[s][id]) << shift(s);
+            return bitsDouble(bits);
+        }
+
+        template<int Level>
+        void write(const uint_fast64_t& id, const double& d)
+        {
+            static_assert(Level >= 1 && Level <= NumSegments, "invalid precision level");
+            const uint64_t bits = doubleBits(d);
+            for(int s = 0; s < Level; ++s)
+                planes[s][id] = static_cast<segment_t>(bits >> shift(s));
+        }
+
+        /*
+            Reads n values starting at start into out, at precision level Level.
+            Written plane by plane, so that each loop streams through a single plane and vectorises.
+        */
+        template<int Level>
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+        {
+            static_assert(Level >= 1 && Level <= NumSegments, "invalid precision level");
+            uint64_t* o = reinterpret_cast<uint64_t*>(out);
+            const segment_t* p = planes[0] + start;
+            for(uint_fast64_t i = 0; i < n; ++i)
+                o[i] = static_cast<uint64_t>(p[i]) << shift(0);
+            for(int s = 1; s < Level; ++s)
+            {
+                p = planes[s] + start;
+                const int sh = shift(s);
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    o[i] |= static_cast<uint64_t>(p[i]) << sh;
+            }
+        }
+
+        /*
+            Writes n values from in to the array starting at start, at precision level Level.
+        */
+        template<int Level>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+        {
+            static_assert(Level >= 1 && Level <= NumSegments, "invalid precision level");
+            const uint64_t* b = reinterpret_cast<const uint64_t*>(in);
+            for(int s = 0; s < Level; ++s)
+            {
+                segment_t* p = planes[s] + start;
+                const int sh = shift(s);
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    p[i] = static_cast<segment_t>(b[i] >> sh);
+            }
+        }
+
+        /*
+            Zeroes planes [Level, NumSegments), i.e. truncates stored values to precision level Level.
+            Useful before raising the level if lower levels have written over stale low planes.
+        */
+        template<int Level>
+        void truncate()
+        {
+            for(int s = Level; s < NumSegments; ++s)
+                memset(planes[s], 0, length * sizeof(segment_t));
+        }
+
+        /* direct access to a plane, e.g. for custom kernels */
+        segment_t* plane(const int& s) { return planes[s]; }
+        const segment_t* plane(const int& s) const { return planes[s]; }
+
+        /*
+            Deletes the planes used to store values in the array.
+            NOTE: this should only be called by one object with references to the same set
+            of values (such as copies of this object).
+        */
+        void del()
+        {
+            for(int s = 0; s < NumSegments; ++s)
+            {
+                if(planes[s] != nullptr) delete[] planes[s];
+                planes[s] = nullptr;
+            }
+            length = 0;
+        }
+
+    private:
+        static constexpr int shift(const int s) { return 64 - (s + 1) * SegmentBits; }
+
+        segment_t* planes[NumSegments];
+        uint_fast64_t length;
+    };
+
+    /*
+        Array of doubles split into a head of HeadBits bits and a tail of 64 - HeadBits bits, at any byte
+        boundary (e.g. 24/40 or 40/24), rather than the fixed 32/32 split of TwoSegArray.
+        Heads and tails are stored as packed byte planes, so a heads-only sweep reads HeadBits / 8 bytes
+        per value. Precision constants for the chosen split are available through precision
+        (e.g. SplitSegArray<40>::precision::adaptiveBound), replacing MaxSingleSegmentPrecision and
+        AdaptivePrecisionBound, which describe the 32 bit head.
+
+        Access mirrors TwoSegArray: headsView() only reads and writes the head (truncating), pairsView() uses both.
+        Note: the class deconstructor does not free space automatically, so use the del function to clean up.
+    */
+    template<int HeadBits>
+    class SplitSegArray
+    {
+        static_assert(HeadBits % 8 == 0 && HeadBits >= 16 && HeadBits <= 56, "split must be at a byte boundary within the mantissa");
+#if defined(__BYTE_ORDER__)
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "packed segments assume little endian doubles");
+#endif
+
+    public:
+        static constexpr int HeadBytes = HeadBits / 8;
+        static constexpr int TailBytes = 8 - HeadBytes;
+        typedef SegmentPrecision<HeadBits> precision;
+
+        /* proxy for a single value, through the head only or through both segments */
+        template<bool useTail>
+        class Ref
+        {
+        public:
+            Ref(SplitSegArray& a, const uint_fast64_t& id)
+                :a(a), id(id)
+            {}
+
+            operator double() const { return useTail ? a.readPair(id) : a.readHead(id); }
+
+            Ref& operator=(const double& d) { if(useTail) a.setPair(id, d); else a.setHead(id, d); return *this; }
+            Ref& operator=(const Ref& o) { return *this = static_cast<double>(o); }
+
+            double operator+=(const double& d) { double t = *this; t += d; *this = t; return t; }
+            double operator-=(const double& d) { double t = *this; t -= d; *this = t; return t; }
+            double operator*=(const double& d) { double t = *this; t *= d; *this = t; return t; }
+            double operator/=(const double& d) { double t = *this; t /= d; *this = t; return t; }
+
+        private:
+            SplitSegArray& a;
+            uint_fast64_t id;
+        };
+
+        /* array-like access in head or full precision, analogous to HeadsArray/PairsArray */
+        template<bool useTail>
+        class View
+        {
+        public:
+            View(SplitSegArray& a)
+                :a(&a)
+            {}
+
+            Ref<useTail> operator[](const uint_fast64_t& id) { return Ref<useTail>(*a, id); }
+            double read(const uint_fast64_t& id) const { return useTail ? a->readPair(id) : a->readHead(id); }
+
+            void readBlock(const uint_fast64_t& start, const uint_fast64_t& n, double* out) const
+            {
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    out[i] = read(start + i);
+            }
+            void writeBlock(const uint_fast64_t& start, const uint_fast64_t& n, const double* in)
+            {
+                for(uint_fast64_t i = 0; i < n; ++i)
+                    (*this)[start + i] = in[i];
+            }
+
+        private:
+            SplitSegArray* a;
+        };
+
+        SplitSegArray()
+        {
+            heads = nullptr;
+            tails = nullptr;
+            length = 0;
+        }
+
+        SplitSegArray(const uint_fast64_t& length)
+        {
+            alloc(length);
+        }
+
+        ~SplitSegArray() { }
+
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            heads = new uint8_t[length * HeadBytes];
+            tails = new uint8_t[length * TailBytes] (); // initially zero tails
+        }
+
+        bool isAlloc() { return (heads != nullptr) && (tails != nullptr); }
+
+        uint_fast64_t size() const { return length; }
+
+        View<false> headsView() { return View<false>(*this); }
+        View<true> pairsView() { return View<true>(*this); }
+
+        double readHead(const uint_fast64_t& id) const
+        {
+            uint64_t bits = 0;
+            memcpy(reinterpret_cast<uint8_t*>(&bits) + TailBytes, heads + id * HeadBytes, HeadBytes);
+            return bitsDouble(bits);
+        }
+
+        double readPair(const uint_fast64_t& id) const
+        {
+            uint64_t bits;
+            memcpy(reinterpret_cast<uint8_t*>(&bits) + TailBytes, heads + id * HeadBytes, HeadBytes);
+            memcpy(&bits, tails + id * TailBytes, TailBytes);
+            return bitsDouble(bits);
+        }
+
+        void setHead(const uint_fast64_t& id, const double& d)
+        {
+            const uint64_t bits = doubleBits(d);
+            memcpy(heads + id * HeadBytes, reinterpret_cast<const uint8_t*>(&bits) + TailBytes, HeadBytes);
+        }
+
+        void setPair(const uint_fast64_t& id, const double& d)
+        {
+            const uint64_t bits = doubleBits(d);
+            memcpy(heads + id * HeadBytes, reinterpret_cast<const uint8_t*>(&bits) + TailBytes, HeadBytes);
+            memcpy(tails + id * TailBytes, &bits, TailBytes);
+        }
+
+        void del()
+        {
+            if(heads != nullptr) delete[] heads;
+            if(tails != nullptr) delete[] tails;
+            heads = nullptr;
+            tails = nullptr;
+            length = 0;
+        }
+
+    private:
+        uint8_t* heads;
+        uint8_t* tails;
+        uint_fast64_t length;
+    };
+
+    /* four 16-bit planes: 4, 20, 36 and 52 bits of mantissa */
+    using SegArray16 = SegArray<4, 16>;
+    /* eight 8-bit planes */
+    using SegArray8 = SegArray<8, 8>;
+}
+
+#endif
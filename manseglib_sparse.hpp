@@ -0,0 +1,370 @@
+/*
+	Mantissa segmented arrays with tails for only some of their elements.
+	Author: harunadess
+
+	Often only a few elements need more than the precision of the heads by the end of a solve: the
+	vertices of highest rank, say, whose order is what a PageRank is read for. SparseTailArray keeps
+	every element's head, densely, and a tail only for the elements that have been promoted. Tails are
+	kept in groups of 64 elements: a group is a 64 bit mask of its promoted elements and an array of
+	their tails, in element order, so an element's tail is at the count of promoted elements before it
+	in the group. Reading an element checks its bit, and reads the tail only if it is set:
+		SparseTailArray<> x(n);
+		... x.heads() ...                           // a HeadsSpan, for the iterations at the heads
+		std::vector<uint_fast64_t> top = topK(x.heads(), n, k);
+		x.promote(top.begin(), top.end());          // these now keep their tails
+		... x.read(i), x.set(i, d) ...              // full precision for promoted elements, heads for the rest
+	A promoted element starts from its head with a zero tail, as for a block of a BlockAdaptiveArray.
+	An array with p of its n elements promoted takes 4n bytes of heads, 16 bytes of mask and pointer per
+	64 elements, and 4p bytes of tails. Reads and writes of different elements may run in parallel;
+	promotion may not run alongside anything else.
+
+	An array that already has a dense tails plane (a ManSegArray) can be read the same way through a
+	PromotedView: a PromotionMask marks the elements to be kept at full precision, such as those whose
+	heads are above a quantile (headsQuantile), and the view reads and writes their heads and tails, and
+	only the heads of the rest:
+		PromotionMask mask(n);
+		mask.markAbove(x.heads.getHeads(), headsQuantile(x.heads.getHeads(), n, 0.05));
+		PromotedView v(x.heads.getHeads(), x.heads.getTails(), mask);
+	Only the tails of marked elements are touched, so in the tails plane it costs the cache lines they
+	share. Elements keep their values when marked, since the tails behind heads-only writes are zero.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_SPARSE_H__
+#define __MANSEG_SPARSE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_expr.hpp"
+
+namespace ManSeg
+{
+    /* the number of bits set in bits */
+    inline int countBits(const uint64_t& bits)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return (int)__popcnt64(bits);
+#else
+        return __builtin_popcountll(bits);
+#endif
+    }
+
+    /*
+        Array of dense heads and sparse tails (see above). As with the other arrays, the deconstructor
+        does not free space; use del().
+    */
+    template<class Allocator = SegmentAllocator>
+    class SparseTailArray
+    {
+    public:
+        static const uint_fast64_t groupSize = 64;
+
+        SparseTailArray(const Allocator& allocator = Allocator())
+            :headSegments(nullptr), groups(nullptr), length(0), promoted(0), allocator(allocator)
+        {}
+
+        SparseTailArray(const uint_fast64_t& length, const Allocator& allocator = Allocator())
+            :headSegments(nullptr), groups(nullptr), length(0), promoted(0), allocator(allocator)
+        {
+            alloc(length);
+        }
+
+        ~SparseTailArray() { }
+
+        /* Allocates length elements, none of them promoted */
+        void alloc(const uint_fast64_t& length)
+        {
+            this->length = length;
+            promoted = 0;
+            headSegments = allocator.template allocate<float>(length, false);
+            groups = new TailGroup[numGroups()]();
+        }
+
+        uint_fast64_t size() const { return length; }
+        /* number of elements promoted */
+        uint_fast64_t numPromoted() const { return promoted; }
+        /* bytes taken by the tails and the groups' masks and pointers */
+        uint_fast64_t tailBytes() const { return promoted * sizeof(float) + numGroups() * sizeof(TailGroup); }
+
+        bool hasTail(const uint_fast64_t& id) const { return (groups[id / groupSize].bits >> (id % groupSize)) & 1; }
+
+        /* the heads of every element, read and written at head precision; it has no tails */
+        HeadsSpan heads() const { return HeadsSpan(headSegments, nullptr, length); }
+        float* getHeads() const { return headSegments; }
+
+        /* value id: its head and tail if it has been promoted, otherwise its head */
+        double read(const uint_fast64_t& id) const
+        {
+            float* tail = tailOf(id);
+            if(tail == nullptr)
+                return static_cast<double>(Head(&headSegments[id]));
+            return static_cast<double>(Pair(&headSegments[id], tail));
+        }
+
+        /*
+            Sets value id to t: exactly if it has been promoted, otherwise its head, rounded according
+            to mode (truncated by default, as for a heads array).
+        */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t)
+        {
+            float* tail = tailOf(id);
+            if(tail == nullptr)
+                headSegments[id] = roundToHead<mode>(t);
+            else
+                splitSegment(t, headSegments + id, tail);
+        }
+
+        /* Gives element id a tail, zero, so it reads as before; false if it already had one */
+        bool promote(const uint_fast64_t& id)
+        {
+            TailGroup& g = groups[id / groupSize];
+            const uint64_t bit = uint64_t(1) << (id % groupSize);
+            if(g.bits & bit) return false;
+
+            const int count = countBits(g.bits);
+            const int at = countBits(g.bits & (bit - 1));
+            float* tails = new float[count + 1];
+            if(count > 0)
+            {
+                memcpy(tails, g.tails, at * sizeof(float));
+                memcpy(tails + at + 1, g.tails + at, (count - at) * sizeof(float));
+                delete[] g.tails;
+            }
+            tails[at] = 0.0f;
+            g.tails = tails;
+            g.bits |= bit;
+            ++promoted;
+            return true;
+        }
+
+        /* Promotes the elements whose indices are in [first, last), returning how many were not already */
+        template<class Iterator>
+        uint_fast64_t promote(Iterator first, Iterator last)
+        {
+            uint_fast64_t count = 0;
+            for(; first != last; ++first)
+                count += promote(*first) ? 1 : 0;
+            return count;
+        }
+
+        /* Deletes the heads and the tails */
+        void del()
+        {
+            if(headSegments != nullptr)
+                allocator.deallocate(headSegments, length);
+            if(groups != nullptr)
+            {
+                for(uint_fast64_t g = 0; g < numGroups(); ++g)
+                    delete[] groups[g].tails;
+                delete[] groups;
+            }
+            headSegments = nullptr;
+            groups = nullptr;
+            length = promoted = 0;
+        }
+
+    private:
+        struct TailGroup
+        {
+            uint64_t bits;      // the elements of the group that have tails
+            float* tails;       // their tails, in element order
+        };
+
+        float* headSegments;
+        TailGroup* groups;
+        uint_fast64_t length;
+        uint_fast64_t promoted;
+        Allocator allocator;
+
+        uint_fast64_t numGroups() const { return (length + groupSize - 1) / groupSize; }
+
+        /* where the tail of id is, or nullptr if it has none */
+        float* tailOf(const uint_fast64_t& id) const
+        {
+            const TailGroup& g = groups[id / groupSize];
+            const uint64_t bit = uint64_t(1) << (id % groupSize);
+            if(!(g.bits & bit)) return nullptr;
+            return g.tails + countBits(g.bits & (bit - 1));
+        }
+    };
+
+    /* one bit per element of an array: those to be read and written at full precision by a PromotedView */
+    class PromotionMask
+    {
+    public:
+        PromotionMask(const uint_fast64_t& length = 0)
+            :words((length + 63) / 64, 0), length(length), marked(0)
+        {}
+
+        /* Marks the elements whose heads are at least threshold, and clears the rest; returns how many are marked */
+        uint_fast64_t markAbove(const float* heads, const double& threshold)
+        {
+            const uint_fast64_t count = parallelReduce<uint_fast64_t>(words.size(), 0,
+                [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+                {
+                    uint_fast64_t c = 0;
+                    for(uint_fast64_t w = begin; w < end; ++w)
+                    {
+                        const uint_fast64_t s = w * 64, e = std::min<uint_fast64_t>(length, s + 64);
+                        uint64_t bits = 0;
+                        for(uint_fast64_t i = s; i < e; ++i)
+                            if(static_cast<double>(Head(const_cast<float*>(heads + i))) >= threshold)
+                                bits |= uint64_t(1) << (i - s);
+                        words[w] = bits;
+                        c += countBits(bits);
+                    }
+                    return c;
+                },
+                [](const uint_fast64_t& a, const uint_fast64_t& b) { return a + b; }, 1024);
+            return marked = count;
+        }
+
+        /* Marks element id; promotion may not run alongside anything else */
+        void mark(const uint_fast64_t& id)
+        {
+            const uint64_t bit = uint64_t(1) << (id % 64);
+            if(!(words[id / 64] & bit))
+                ++marked;
+            words[id / 64] |= bit;
+        }
+
+        bool test(const uint_fast64_t& id) const { return (words[id / 64] >> (id % 64)) & 1; }
+        const uint64_t* getWords() const { return words.data(); }
+        uint_fast64_t size() const { return length; }
+        uint_fast64_t numMarked() const { return marked; }
+
+    private:
+        std::vector<uint64_t> words;
+        uint_fast64_t length;
+        uint_fast64_t marked;
+    };
+
+    /*
+        View of the heads and tails of an array reading and writing the elements marked in a
+        PromotionMask at full precision, and only the heads of the rest, rounded according to mode as
+        for a HeadsSpan. Non-owning, like the spans, and the mask must outlive it. Subspans keep their
+        offset into the mask.
+    */
+    class PromotedView
+    {
+    public:
+        PromotedView(float* heads = nullptr, float* tails = nullptr, const uint64_t* mask = nullptr,
+            const uint_fast64_t& n = 0, const uint_fast64_t& offset = 0)
+            :heads(heads), tails(tails), mask(mask), n(n), offset(offset)
+        {}
+
+        PromotedView(float* heads, float* tails, const PromotionMask& mask)
+            :heads(heads), tails(tails), mask(mask.getWords()), n(mask.size()), offset(0)
+        {}
+
+        bool promoted(const uint_fast64_t& id) const
+        {
+            const uint_fast64_t bit = offset + id;
+            return (mask[bit / 64] >> (bit % 64)) & 1;
+        }
+
+        double operator[](const uint_fast64_t& id) const { return read(id); }
+
+        double read(const uint_fast64_t& id) const
+        {
+            if(promoted(id))
+                return static_cast<double>(Pair(heads + id, tails + id));
+            return static_cast<double>(Head(heads + id));
+        }
+
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            if(promoted(id))
+                splitSegment(t, heads + id, tails + id);
+            else
+                heads[id] = roundToHead<mode>(t);
+        }
+
+        PromotedView subspan(const uint_fast64_t& start, const uint_fast64_t& count) const
+        {
+            return PromotedView(heads + start, tails + start, mask, count, offset + start);
+        }
+
+        uint_fast64_t size() const { return n; }
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+    private:
+        float* heads;
+        float* tails;
+        const uint64_t* mask;
+        uint_fast64_t n;
+        uint_fast64_t offset;       // bit of the mask for element 0
+    };
+
+    /* a[id] += value atomically: under the pair locks if id is promoted, by compare and swap of its head if not */
+    inline void atomicAdd(PromotedView& a, const uint_fast64_t& id, const double& value)
+    {
+        if(a.promoted(id))
+        {
+            TwoSegArray<true> pairs(a.getHeads(), a.getTails());
+            atomicAdd(pairs, id, value);
+        }
+        else
+        {
+            TwoSegArray<false> heads(a.getHeads(), a.getTails());
+            atomicAdd(heads, id, value);
+        }
+    }
+
+    /* prefetches element id (see ManSeg::prefetch): its head, and its tail if it is promoted; the mask is small enough to stay in cache */
+    inline void prefetch(const PromotedView& a, const uint_fast64_t& id)
+    {
+        prefetchLine(a.getHeads() + id);
+        if(a.promoted(id))
+            prefetchLine(a.getTails() + id);
+    }
+
+    /* reads a PromotedView, in the expressions of manseglib_expr.hpp */
+    struct PromotedTerm : Expr<PromotedTerm>
+    {
+        PromotedView view;
+
+        PromotedTerm(const PromotedView& view)
+            :view(view)
+        {}
+
+        double at(const uint_fast64_t& i) const { return view.read(i); }
+
+#if defined(MANSEG_HAS_AVX2)
+        MANSEG_TARGET_AVX2 __m256d load4(const uint_fast64_t& i) const
+        {
+            return _mm256_set_pd(at(i + 3), at(i + 2), at(i + 1), at(i));
+        }
+#endif
+    };
+
+    inline PromotedTerm expr(const PromotedView& a) { return PromotedTerm(a); }
+}
+
+#endif
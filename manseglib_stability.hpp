@@ -0,0 +1,315 @@
+/*
+	Tracking of the elements whose heads changed, for skipping stable elements at the heads.
+	Author: harunadess
+
+	At the heads a value whose 32 head bits did not change in an iteration will not change in the
+	next one either if nothing it depends on changed: it can get no more accurate until the array
+	is promoted. A ChangeMask has a bit per element, set by the writes through a TrackedHeadsView
+	whose new head differs in its bits from the old one (a compare of the old head, which the writer
+	of an update has just read anyway). It keeps two iterations' bits: the writes of this iteration
+	mark the current bits, and changed() and the helpers read those of the last one, so an iteration
+	can decide what to skip while it writes:
+		ChangeMask changes(n);
+		TrackedHeadsView next(x.heads.getHeads(), x.heads.getTails(), changes);
+		for(each heads iteration)
+		{
+			changes.advance();                          // the last iteration's marks become readable
+			changes.flags(frontier, 0, n);              // a dense frontier of the changed elements
+			... or: if(!changes.anyChanged(s, e)) skip rows s..e (a Jacobi block, a CG row block)
+			... next.set(i, v), next.writeBlock(s, k, in), atomicAdd(next, i, v) ...
+		}
+		changes.stop();                                 // at promotion: everything counts as changed
+	What may be skipped is for the algorithm to say: a row of a Jacobi sweep is stable if it and the
+	elements it reads are, a destination of a PageRank push only needs the sources that changed if it
+	keeps its sum. Before the first advance() and after stop() every element counts as changed, so
+	nothing is skipped that should not be.
+
+	Marks are atomic ORs into the mask's words, made only when an element's bit is not set yet, so
+	writers of different elements may run in parallel. advance() and stop() may not run alongside
+	anything else.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_STABILITY_H__
+#define __MANSEG_STABILITY_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* the two iterations of change bits of an array (see above) */
+    class ChangeMask
+    {
+    public:
+        ChangeMask(const uint_fast64_t& length = 0)
+            :current((length + 63) / 64, 0), last((length + 63) / 64, 0), length(length), tracking(true), started(false)
+        {}
+
+        /* records that element id's head changed in this iteration */
+        void mark(const uint_fast64_t& id)
+        {
+            markBits(id / 64, uint64_t(1) << (id % 64));
+        }
+
+        /* records the elements of word w given by bits */
+        void markBits(const uint_fast64_t& w, const uint64_t& bits)
+        {
+            uint64_t* word = &current[w];
+            if((atomicLoadRelaxed(word) & bits) == bits)
+                return;
+#if defined(_MSC_VER) && !defined(__clang__)
+            _InterlockedOr64(reinterpret_cast<volatile long long*>(word), static_cast<long long>(bits));
+#else
+            __atomic_fetch_or(word, bits, __ATOMIC_RELAXED);
+#endif
+        }
+
+        /* ends an iteration: its marks become what changed() reads, and the next starts with none */
+        void advance()
+        {
+            current.swap(last);
+            uint64_t* words = current.data();
+            parallelFor(current.size(), [words](const uint_fast64_t& begin, const uint_fast64_t& end)
+            {
+                memset(words + begin, 0, (end - begin) * sizeof(uint64_t));
+            });
+            started = true;
+        }
+
+        /* ends the tracking, at promotion: every element counts as changed from now on */
+        void stop() { tracking = false; }
+
+        /* whether the last iteration can be told apart: after an advance() and before stop() */
+        bool active() const { return tracking && started; }
+
+        /* whether element id's head changed in the last iteration */
+        bool changed(const uint_fast64_t& id) const
+        {
+            return !active() || ((last[id / 64] >> (id % 64)) & 1);
+        }
+
+        /* whether any element of [begin, end) changed in the last iteration, a word at a time */
+        bool anyChanged(const uint_fast64_t& begin, const uint_fast64_t& end) const
+        {
+            if(!active())
+                return begin < end;
+            for(uint_fast64_t w = begin / 64; w * 64 < end; ++w)
+                if(last[w] & wordRange(w, begin, end))
+                    return true;
+            return false;
+        }
+
+        /* calls f(id) for every element of [begin, end) that changed in the last iteration, in order */
+        template<class F>
+        void forEachChanged(const uint_fast64_t& begin, const uint_fast64_t& end, const F& f) const
+        {
+            if(!active())
+            {
+                for(uint_fast64_t i = begin; i < end; ++i)
+                    f(i);
+                return;
+            }
+            for(uint_fast64_t w = begin / 64; w * 64 < end; ++w)
+            {
+                uint64_t bits = last[w] & wordRange(w, begin, end);
+                while(bits != 0)
+                {
+                    f(w * 64 + lowestBit(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        /* out[i - begin] = changed(i) for i in [begin, end): a dense frontier of the changed elements */
+        void flags(bool* out, const uint_fast64_t& begin, const uint_fast64_t& end) const
+        {
+            for(uint_fast64_t i = begin; i < end; ++i)
+                out[i - begin] = changed(i);
+        }
+
+        /* the blocks of blockSize elements (block b holds b * blockSize onwards) with any change */
+        std::vector<uint_fast64_t> changedBlocks(const uint_fast64_t& blockSize) const
+        {
+            std::vector<uint_fast64_t> blocks;
+            for(uint_fast64_t s = 0; s < length; s += blockSize)
+                if(anyChanged(s, std::min(length, s + blockSize)))
+                    blocks.push_back(s / blockSize);
+            return blocks;
+        }
+
+        /* the number of elements that changed in the last iteration */
+        uint_fast64_t count() const
+        {
+            if(!active())
+                return length;
+            uint_fast64_t c = 0;
+            for(uint_fast64_t w = 0; w < last.size(); ++w)
+                c += popCount(last[w]);
+            return c;
+        }
+
+        uint_fast64_t size() const { return length; }
+
+    private:
+        // the bits of word w that are elements of [begin, end)
+        static uint64_t wordRange(const uint_fast64_t& w, const uint_fast64_t& begin, const uint_fast64_t& end)
+        {
+            const uint_fast64_t s = std::max(begin, w * 64), e = std::min(end, w * 64 + 64);
+            if(s >= e)
+                return 0;
+            const uint64_t upTo = (e - w * 64) == 64 ? ~uint64_t(0) : (uint64_t(1) << (e - w * 64)) - 1;
+            return upTo & ~((uint64_t(1) << (s - w * 64)) - 1);
+        }
+
+        static int lowestBit(const uint64_t& bits)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long i;
+            _BitScanForward64(&i, bits);
+            return (int)i;
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        static int popCount(const uint64_t& bits)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            return (int)__popcnt64(bits);
+#else
+            return __builtin_popcountll(bits);
+#endif
+        }
+
+        std::vector<uint64_t> current, last;    // marks of this iteration, and of the last
+        uint_fast64_t length;
+        bool tracking, started;
+    };
+
+    /*
+        View of the heads of an array whose writes mark the elements whose heads change in a ChangeMask,
+        rounded according to mode as for a HeadsSpan. Non-owning, like the spans, and the mask must
+        outlive it. Subspans keep their offset into the mask.
+    */
+    class TrackedHeadsView
+    {
+    public:
+        TrackedHeadsView(float* heads = nullptr, float* tails = nullptr, ChangeMask* mask = nullptr,
+            const uint_fast64_t& n = 0, const uint_fast64_t& offset = 0)
+            :heads(heads), tails(tails), mask(mask), n(n), offset(offset)
+        {}
+
+        TrackedHeadsView(float* heads, float* tails, ChangeMask& mask)
+            :heads(heads), tails(tails), mask(&mask), n(mask.size()), offset(0)
+        {}
+
+        Head operator[](const uint_fast64_t& id) const { return Head(&heads[id]); }
+        double read(const uint_fast64_t& id) const { return static_cast<double>(Head(&heads[id])); }
+
+        /* writes the head, and marks it if its bits change; an unchanged head is not stored */
+        template<RoundingMode mode = ROUND_TRUNCATE, typename T>
+        void set(const uint_fast64_t& id, const T& t) const
+        {
+            MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+            const float h = roundToHead<mode>(t);
+            if(bitCast<uint32_t>(h) != bitCast<uint32_t>(heads[id]))
+            {
+                heads[id] = h;
+                mask->mark(offset + id);
+            }
+        }
+
+        void readBlock(const uint_fast64_t& start, const uint_fast64_t& count, double* out) const
+        {
+            widenHeads(heads + start, count, out);
+        }
+
+        /* narrowToHeads, a chunk at a time, marking the elements of each mask word whose heads change */
+        template<RoundingMode mode = ROUND_TRUNCATE>
+        void writeBlock(const uint_fast64_t& start, const uint_fast64_t& count, const double* in) const
+        {
+            float chunk[64];
+            uint_fast64_t i = 0;
+            while(i < count)
+            {
+                // up to the end of the mask word of element start + i
+                const uint_fast64_t bit = offset + start + i;
+                const uint_fast64_t k = std::min<uint_fast64_t>(count - i, 64 - bit % 64);
+                narrowToHeads<mode>(in + i, k, chunk);
+                float* h = heads + start + i;
+                uint64_t bits = 0;
+                for(uint_fast64_t j = 0; j < k; ++j)
+                    bits |= uint64_t(bitCast<uint32_t>(chunk[j]) != bitCast<uint32_t>(h[j])) << j;
+                if(bits != 0)
+                {
+                    memcpy(h, chunk, k * sizeof(float));
+                    mask->markBits(bit / 64, bits << (bit % 64));
+                }
+                i += k;
+            }
+        }
+
+        TrackedHeadsView subspan(const uint_fast64_t& start, const uint_fast64_t& count) const
+        {
+            return TrackedHeadsView(heads + start, tails + start, mask, count, offset + start);
+        }
+
+        ChangeMask& changes() const { return *mask; }
+        uint_fast64_t position(const uint_fast64_t& id) const { return offset + id; }
+        uint_fast64_t size() const { return n; }
+        float* getHeads() const { return heads; }
+        float* getTails() const { return tails; }
+
+    private:
+        float* heads;
+        float* tails;
+        ChangeMask* mask;
+        uint_fast64_t n;
+        uint_fast64_t offset;       // bit of the mask for element 0
+    };
+
+    /* a[id] += value atomically, by compare and swap of its head as for a heads array, marking it if it changes */
+    inline void atomicAdd(TrackedHeadsView& a, const uint_fast64_t& id, const double& value)
+    {
+        MANSEG_TRAFFIC_ADD(HEADS_READ, sizeof(float));
+        MANSEG_TRAFFIC_ADD(HEADS_WRITTEN, sizeof(float));
+        uint32_t* word = reinterpret_cast<uint32_t*>(a.getHeads() + id);
+        uint32_t oldBits, newBits;
+        do
+        {
+            oldBits = atomicLoadRelaxed(word);
+            newBits = bitCast<uint32_t>(headOf(headToDouble(bitCast<float>(oldBits)) + value));
+            if(newBits == oldBits)
+                return;
+        } while(!atomicCompareExchange(word, oldBits, newBits));
+        a.changes().mark(a.position(id));
+    }
+
+    inline void prefetch(const TrackedHeadsView& a, const uint_fast64_t& id) { prefetchLine(a.getHeads() + id); }
+}
+
+#endif
@@ -0,0 +1,840 @@
+/*
+	5 point stencil kernel over square blocks of mantissa segmented arrays.
+	Author: harunadess
+
+	A Jacobi sweep written element-wise through the Head proxies, with a ternary per neighbour for
+	the halos, converts every value five times and does not vectorise. stencil5 instead keeps three
+	rows of the block widened to doubles, each padded with a ghost value from the left and right
+	halos, with the halo rows above and below the block as the first and last neighbour rows. Each
+	output row is then computed on doubles (4 at a time with AVX2), together with the largest change
+	of a value, and is narrowed and stored once:
+		double delta = stencil5(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_HEADS>(), B, top, bottom, left, right);
+	In and Out are any of the LevelView types, so the same kernel does the heads sweep, the interim
+	step (read heads, write full) and the full precision sweep. Halo pointers are to B doubles, or
+	null for the zero boundary. From heads to heads with setHeadsArithmetic(HEADS_FLOAT), a block whose
+	values and halos are within a float's exponent range (a cheap scan of the heads' exponents) is
+	swept in float, 8 or 16 at a time, and the others in double as before.
+	stencil5Steps does several sweeps of a tile of doubles padded with ghost points, for temporal
+	blocking: a block is read and written once for all of them while it stays in cache.
+	sor5 is the in place alternative, one colour of red-black SOR over a block: a grid needs no second
+	copy to sweep into. chebyshev5 is a sweep of stencil5 as a step of Chebyshev semi-iteration, with the
+	weights from ChebyshevWeights and the sweep before as a third operand, usually the grid swept into. stencil7 and sor7 are the same for the 7 point stencil over B x B x B bricks,
+	with the six faces of a brick as its halos.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_STENCIL_H__
+#define __MANSEG_STENCIL_H__
+
+#include <math.h>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* stencilRow for 4 values per step; returns the number of values done, with their largest change in delta */
+        template<bool withRhs>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t stencilRowAVX2(const double* up, const double* row, const double* down,
+            const double* rhs, const uint_fast64_t& n, const double& weight, double* out, double& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m256d w = _mm256_set1_pd(weight);
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            __m256d dmax = _mm256_setzero_pd();
+            for(; j < (n & ~uint_fast64_t(3)); j += 4)
+            {
+                __m256d centre = _mm256_loadu_pd(row + j + 1);
+                __m256d sum = _mm256_add_pd(centre, _mm256_loadu_pd(row + j));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 2));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j + 1));
+                if(withRhs) sum = _mm256_add_pd(sum, _mm256_loadu_pd(rhs + j));
+                __m256d next = _mm256_mul_pd(w, sum);
+                _mm256_storeu_pd(out + j, next);
+                dmax = _mm256_max_pd(dmax, _mm256_andnot_pd(sign, _mm256_sub_pd(next, centre)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, dmax);
+            delta = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            return j;
+        }
+
+        /*
+            sorRow for 4 values per step, the lanes of parity first updated (colour strided by a blend), into
+            out[j]; returns the number of values done. Storing into row would stall every load of the next
+            step's left neighbours, which overlap the store.
+        */
+        template<int first>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t sorRowAVX2(const double* up, const double* row, const double* down,
+            const uint_fast64_t& n, const double& omega, double* out, double& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m256d w = _mm256_set1_pd(omega);
+            const __m256d quarter = _mm256_set1_pd(0.25);
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            __m256d dmax = _mm256_setzero_pd();
+            for(; j < (n & ~uint_fast64_t(3)); j += 4)
+            {
+                // the other colour's lanes are computed and dropped: their neighbours are being updated
+                __m256d centre = _mm256_loadu_pd(row + j + 1);
+                __m256d sum = _mm256_add_pd(_mm256_loadu_pd(row + j), _mm256_loadu_pd(up + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 2));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j + 1));
+                __m256d next = _mm256_add_pd(centre, _mm256_mul_pd(w, _mm256_sub_pd(_mm256_mul_pd(quarter, sum), centre)));
+                next = _mm256_blend_pd(centre, next, first == 0 ? 0x5 : 0xA);
+                _mm256_storeu_pd(out + j, next);
+                dmax = _mm256_max_pd(dmax, _mm256_andnot_pd(sign, _mm256_sub_pd(next, centre)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, dmax);
+            delta = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            return j;
+        }
+
+        /* stencilRowAVX2 without a right hand side, in float for 8 values per step */
+        MANSEG_TARGET_AVX2 inline uint_fast64_t stencilRowFloatAVX2(const float* up, const float* row, const float* down,
+            const uint_fast64_t& n, const float& weight, float* out, float& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m256 w = _mm256_set1_ps(weight);
+            const __m256 sign = _mm256_set1_ps(-0.0f);
+            __m256 dmax = _mm256_setzero_ps();
+            for(; j < (n & ~uint_fast64_t(7)); j += 8)
+            {
+                __m256 centre = _mm256_loadu_ps(row + j + 1);
+                __m256 sum = _mm256_add_ps(centre, _mm256_loadu_ps(row + j));
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(up + j + 1));
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + j + 2));
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(down + j + 1));
+                __m256 next = _mm256_mul_ps(w, sum);
+                _mm256_storeu_ps(out + j, next);
+                dmax = _mm256_max_ps(dmax, _mm256_andnot_ps(sign, _mm256_sub_ps(next, centre)));
+            }
+            float lanes[8];
+            _mm256_storeu_ps(lanes, dmax);
+            delta = *std::max_element(lanes, lanes + 8);
+            return j;
+        }
+#endif
+#if defined(MANSEG_HAS_AVX512)
+        /* stencilRowFloatAVX2 for 16 values per step */
+        MANSEG_TARGET_AVX512 inline uint_fast64_t stencilRowFloatAVX512(const float* up, const float* row, const float* down,
+            const uint_fast64_t& n, const float& weight, float* out, float& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m512 w = _mm512_set1_ps(weight);
+            const __m512i magnitude = _mm512_set1_epi32(0x7FFFFFFF);
+            __m512 dmax = _mm512_setzero_ps();
+            for(; j < (n & ~uint_fast64_t(15)); j += 16)
+            {
+                __m512 centre = _mm512_loadu_ps(row + j + 1);
+                __m512 sum = _mm512_add_ps(centre, _mm512_loadu_ps(row + j));
+                sum = _mm512_add_ps(sum, _mm512_loadu_ps(up + j + 1));
+                sum = _mm512_add_ps(sum, _mm512_loadu_ps(row + j + 2));
+                sum = _mm512_add_ps(sum, _mm512_loadu_ps(down + j + 1));
+                __m512 next = _mm512_mul_ps(w, sum);
+                _mm512_storeu_ps(out + j, next);
+                __m512i change = _mm512_and_si512(_mm512_castps_si512(_mm512_sub_ps(next, centre)), magnitude);
+                dmax = _mm512_max_ps(dmax, _mm512_castsi512_ps(change));
+            }
+            delta = _mm512_reduce_max_ps(dmax);
+            return j;
+        }
+#endif
+    }
+
+    /*
+        Over-relaxes the values of one colour of a padded row of n + 2 values in place, those at j =
+        first, first + 2, ... (first 0 or 1):
+            row[j+1] += omega * ((row[j] + up[j+1] + row[j+2] + down[j+1]) / 4 - row[j+1])
+        the Gauss-Seidel update of 4u = (the four neighbours) for omega 1. Every neighbour of a point is
+        of the other colour, which this leaves alone, so the order does not matter. Returns the
+        largest change of a value.
+    */
+    inline double sorRow(const double* up, double* row, const double* down, const uint_fast64_t& n,
+        const uint_fast64_t& first, const double& omega)
+    {
+        uint_fast64_t j = 0;
+        double delta = 0.0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2)
+        {
+            static thread_local std::vector<double> out;
+            if(out.size() < n)
+                out.resize(n);
+            j = (first == 0) ? simd::sorRowAVX2<0>(up, row, down, n, omega, out.data(), delta)
+                             : simd::sorRowAVX2<1>(up, row, down, n, omega, out.data(), delta);
+            std::copy(out.data(), out.data() + j, row + 1);
+        }
+#endif
+        for(j += first; j < n; j += 2)
+        {
+            const double centre = row[j + 1];
+            const double next = centre + omega * (0.25 * (row[j] + up[j + 1] + row[j + 2] + down[j + 1]) - centre);
+            row[j + 1] = next;
+            delta = std::max(delta, fabs(next - centre));
+        }
+        return delta;
+    }
+
+    /*
+        out[j] = weight * (row[j+1] + row[j] + up[j+1] + row[j+2] + down[j+1]) for j in [0, n), where row,
+        up and down are padded rows of n + 2 values; returns the largest |out[j] - row[j+1]|.
+        The terms are added in the order of the element-wise drivers, so full precision results match them.
+    */
+    inline double stencilRow(const double* up, const double* row, const double* down, const uint_fast64_t& n,
+        const double& weight, double* out)
+    {
+        uint_fast64_t j = 0;
+        double delta = 0.0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) j = simd::stencilRowAVX2<false>(up, row, down, nullptr, n, weight, out, delta);
+#endif
+        for(; j < n; ++j)
+        {
+            out[j] = weight * (row[j + 1] + row[j] + up[j + 1] + row[j + 2] + down[j + 1]);
+            delta = std::max(delta, fabs(out[j] - row[j + 1]));
+        }
+        return delta;
+    }
+
+    /*
+        stencilRow with a right hand side, rhs[j] added last to the five terms: with weight 0.2 this is
+        a sweep of damped Jacobi (omega 0.8) for 4u - (the four neighbours) = rhs, the smoother of
+        manseglib_multigrid.hpp.
+    */
+    inline double stencilRow(const double* up, const double* row, const double* down, const double* rhs,
+        const uint_fast64_t& n, const double& weight, double* out)
+    {
+        uint_fast64_t j = 0;
+        double delta = 0.0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) j = simd::stencilRowAVX2<true>(up, row, down, rhs, n, weight, out, delta);
+#endif
+        for(; j < n; ++j)
+        {
+            out[j] = weight * (row[j + 1] + row[j] + up[j + 1] + row[j + 2] + down[j + 1] + rhs[j]);
+            delta = std::max(delta, fabs(out[j] - row[j + 1]));
+        }
+        return delta;
+    }
+
+    /*
+        stencilRow in float, for heads that fit one (see HeadsArithmetic): the same terms in the same
+        order, each sum rounded to a float.
+    */
+    inline float stencilRowFloat(const float* up, const float* row, const float* down, const uint_fast64_t& n,
+        const float& weight, float* out)
+    {
+        uint_fast64_t j = 0;
+        float delta = 0.0f;
+#if defined(MANSEG_HAS_AVX512)
+        if(simdLevel() >= SIMD_AVX512) j = simd::stencilRowFloatAVX512(up, row, down, n, weight, out, delta);
+#endif
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2 && j + 8 <= n)
+        {
+            float d = 0.0f;
+            j += simd::stencilRowFloatAVX2(up + j, row + j, down + j, n - j, weight, out + j, d);
+            delta = std::max(delta, d);
+        }
+#endif
+        for(; j < n; ++j)
+        {
+            out[j] = weight * (row[j + 1] + row[j] + up[j + 1] + row[j + 2] + down[j + 1]);
+            delta = std::max(delta, std::fabs(out[j] - row[j + 1]));
+        }
+        return delta;
+    }
+
+    // the heads of a view at the heads, which stencil5 can compute on in float; null for the other views
+    template<class View>
+    float* headsPlaneOf(const View&) { return nullptr; }
+    template<class Allocator>
+    float* headsPlaneOf(const TwoSegArray<false, Allocator>& a) { return a.getHeads(); }
+    inline float* headsPlaneOf(const TwoSegSpan<false>& a) { return a.getHeads(); }
+
+    /*
+        stencil5 from the heads in to the heads out, in float: false, with nothing written, unless the
+        block's heads and the halos fit a float with 3 bits of headroom, enough for the sum of five.
+        The block is widened to a padded tile of floats first, checking the heads as it goes.
+    */
+    inline bool stencil5Float(const float* in, float* out, const uint_fast64_t& B, const double* top, const double* bottom,
+        const double* left, const double* right, const double& weight, double& delta)
+    {
+        const double* halos[4] = { top, bottom, left, right };
+        for(int h = 0; h < 4; ++h)
+            if(halos[h] && !fitsFloat(halos[h], B, 3))
+                return false;
+
+        static thread_local std::vector<float> scratch;
+        const uint_fast64_t width = B + 2;
+        if(scratch.size() < (width + 1) * width)
+            scratch.assign((width + 1) * width, 0.0f);
+        float* tile = scratch.data();
+        float* result = tile + width * width;
+
+        for(uint_fast64_t j = 0; j < B; ++j)
+        {
+            tile[j + 1] = top ? static_cast<float>(top[j]) : 0.0f;
+            tile[(B + 1) * width + j + 1] = bottom ? static_cast<float>(bottom[j]) : 0.0f;
+        }
+        for(uint_fast64_t i = 0; i < B; ++i)
+        {
+            float* row = tile + (i + 1) * width;
+            if(!headsToFloats(in + i * B, B, row + 1, 3))
+                return false;
+            row[0] = left ? static_cast<float>(left[i]) : 0.0f;
+            row[B + 1] = right ? static_cast<float>(right[i]) : 0.0f;
+        }
+
+        const float w = static_cast<float>(weight);
+        float d = 0.0f;
+        for(uint_fast64_t i = 0; i < B; ++i)
+        {
+            d = std::max(d, stencilRowFloat(tile + i * width, tile + (i + 1) * width, tile + (i + 2) * width, B, w, result));
+            floatsToHeads(result, B, out + i * B);
+        }
+        delta = d;
+        return true;
+    }
+
+    /*
+        One sweep of the 5 point stencil over the B x B block in, written to out:
+            out[i][j] = weight * (in[i][j] + left + top + right + bottom)
+        with the neighbours outside the block taken from the halos: top and bottom are the rows above
+        and below, left and right the columns, B values each or null for zeros.
+        Returns the largest change of a value, |out[i][j] - in[i][j]|, before out is narrowed.
+        Each row is read before the row above it is written, so out may be the same block as in.
+        From heads to heads with HEADS_FLOAT (see setHeadsArithmetic), the sweep is computed in float
+        where the block's values allow it, and in double where they do not.
+    */
+    template<class In, class Out>
+    double stencil5(In in, Out out, const uint_fast64_t& B, const double* top, const double* bottom,
+        const double* left, const double* right, const double& weight = 0.2)
+    {
+        if(headsArithmetic() == HEADS_FLOAT)
+        {
+            const float* inHeads = headsPlaneOf(in);
+            float* outHeads = headsPlaneOf(out);
+            double delta;
+            if(inHeads && outHeads && stencil5Float(inHeads, outHeads, B, top, bottom, left, right, weight, delta))
+                return delta;
+        }
+
+        // three padded input rows and the output row, reused by each thread
+        static thread_local std::vector<double> scratch;
+        const uint_fast64_t width = B + 2;
+        if(scratch.size() < 4 * width)
+            scratch.assign(4 * width, 0.0);
+        double* up = scratch.data();
+        double* row = up + width;
+        double* down = row + width;
+        double* result = down + width;
+
+        // padded row i of the block (or the bottom halo for i == B) into dst
+        auto load = [&](const uint_fast64_t& i, double* dst)
+        {
+            dst[0] = 0.0;
+            dst[B + 1] = 0.0;
+            if(i == B)
+            {
+                for(uint_fast64_t j = 0; j < B; ++j)
+                    dst[j + 1] = bottom ? bottom[j] : 0.0;
+                return;
+            }
+            in.readBlock(i * B, B, dst + 1);
+            if(left) dst[0] = left[i];
+            if(right) dst[B + 1] = right[i];
+        };
+
+        up[0] = up[B + 1] = 0.0;
+        for(uint_fast64_t j = 0; j < B; ++j)
+            up[j + 1] = top ? top[j] : 0.0;
+        load(0, row);
+
+        double delta = 0.0;
+        for(uint_fast64_t i = 0; i < B; ++i)
+        {
+            load(i + 1, down);
+            delta = std::max(delta, stencilRow(up, row, down, B, weight, result));
+            out.writeBlock(i * B, B, result);
+            // the rows move up by one
+            double* spare = up;
+            up = row;
+            row = down;
+            down = spare;
+        }
+        return delta;
+    }
+
+    /*
+        Half a sweep of red-black SOR over the B x B block a, in place: the points (i, j) with (i + j) % 2
+        == colour are over-relaxed (see sorRow), with the halos as for stencil5. Their neighbours, in the
+        block and in the halos, are all of the other colour, so the blocks of a grid can do a colour in
+        any order, or in parallel, with the halos gathered before or during it. With a grid's colour
+        taken from the global row and column, the two colours in turn are a sweep of red-black SOR.
+        A is any of the LevelView types, e.g. the heads, read and written a row at a time.
+        Returns the largest change of a value, before it is narrowed.
+    */
+    template<class A>
+    double sor5(A a, const uint_fast64_t& B, const double* top, const double* bottom, const double* left,
+        const double* right, const uint_fast64_t& colour, const double& omega)
+    {
+        static thread_local std::vector<double> scratch;
+        const uint_fast64_t width = B + 2;
+        if(scratch.size() < 3 * width)
+            scratch.assign(3 * width, 0.0);
+        double* up = scratch.data();
+        double* row = up + width;
+        double* down = row + width;
+
+        auto load = [&](const uint_fast64_t& i, double* dst)
+        {
+            dst[0] = 0.0;
+            dst[B + 1] = 0.0;
+            if(i == B)
+            {
+                for(uint_fast64_t j = 0; j < B; ++j)
+                    dst[j + 1] = bottom ? bottom[j] : 0.0;
+                return;
+            }
+            a.readBlock(i * B, B, dst + 1);
+            if(left) dst[0] = left[i];
+            if(right) dst[B + 1] = right[i];
+        };
+
+        up[0] = up[B + 1] = 0.0;
+        for(uint_fast64_t j = 0; j < B; ++j)
+            up[j + 1] = top ? top[j] : 0.0;
+        load(0, row);
+
+        double delta = 0.0;
+        for(uint_fast64_t i = 0; i < B; ++i)
+        {
+            load(i + 1, down);
+            delta = std::max(delta, sorRow(up, row, down, B, (colour + i) % 2, omega));
+            a.writeBlock(i * B, B, row + 1);
+            double* spare = up;
+            up = row;
+            row = down;
+            down = spare;
+        }
+        return delta;
+    }
+
+    /*
+        The weights of Chebyshev semi-iteration for a sweep x' = Sx + c whose iteration matrix S is symmetric
+        with its eigenvalues in [lower, upper], upper < 1. The sweep is first extrapolated by gamma,
+        gamma * x' + (1 - gamma) * x, which maps the eigenvalues to [-rho, rho], and the k-th sweep since a
+        start is then
+            x(k) = x(k-2) + omega(k) * (gamma * Sx(k-1) + gamma * c + (1 - gamma) * x(k-1) - x(k-2))
+        with omega(1) = 1, which does not read x(k-2), omega(2) = 2 / (2 - rho^2) and omega(k + 1) =
+        1 / (1 - rho^2 * omega(k) / 4). The omegas are computed up front until they settle, at their limit
+        2 / (1 + sqrt(1 - rho^2)), so a sweep only looks one up. The error falls by about that limit minus
+        one per sweep, against rho for the plain sweeps.
+    */
+    class ChebyshevWeights
+    {
+    private:
+        double gamma_;
+        double rho_;
+        std::vector<double> omegas;
+
+    public:
+        ChebyshevWeights(const double& lower, const double& upper)
+            : gamma_(2.0 / (2.0 - lower - upper)), rho_((upper - lower) / (2.0 - lower - upper)), omegas(1, 1.0)
+        {
+            double omega = 2.0 / (2.0 - rho_ * rho_);
+            while(omegas.size() < 100000 && fabs(omega - omegas.back()) > 1e-15)
+            {
+                omegas.push_back(omega);
+                omega = 1.0 / (1.0 - rho_ * rho_ * omega / 4.0);
+            }
+        }
+
+        /*
+            The bounds for stencil5 with weight 0.2 over an n x n grid with zero edges: the eigenvalues are
+            0.2 * (1 + 2cos(pi i / (n + 1)) + 2cos(pi j / (n + 1))), so gamma is 1.25 (the extrapolated
+            sweep is plain Jacobi, the average of the four neighbours) and rho is cos(pi / (n + 1)).
+        */
+        static ChebyshevWeights forStencil5(const uint_fast64_t& n)
+        {
+            const double c = cos(M_PI / (n + 1.0));
+            return ChebyshevWeights(0.2 * (1.0 - 4.0 * c), 0.2 * (1.0 + 4.0 * c));
+        }
+
+        /* omega of the k-th sweep since the start, k from 1 */
+        double omega(const uint_fast64_t& k) const { return omegas[std::min<uint_fast64_t>(std::max<uint_fast64_t>(k, 1), omegas.size()) - 1]; }
+        double gamma() const { return gamma_; }
+        double rho() const { return rho_; }
+        /* the number of omegas before they settle */
+        uint_fast64_t size() const { return omegas.size(); }
+    };
+
+    /*
+        A sweep of stencil5 made a Chebyshev step (see ChebyshevWeights): out is
+            prev + omega * (gamma * stencil5(in) + (1 - gamma) * in - prev)
+        row by row, with the halos as for stencil5. prev holds the sweep before in's, and is not read with
+        omega 1, the first sweep after a start. Each row of prev is read before that row of out is written,
+        so out may be the same block as prev, the grid the sweep before in was swept from.
+        Returns the largest change of a value, |out - in|, before out is narrowed.
+    */
+    template<class In, class Prev, class Out>
+    double chebyshev5(In in, Prev prev, Out out, const uint_fast64_t& B, const double* top, const double* bottom,
+        const double* left, const double* right, const double& omega, const double& gamma, const double& weight = 0.2)
+    {
+        static thread_local std::vector<double> scratch;
+        const uint_fast64_t width = B + 2;
+        if(scratch.size() < 5 * width)
+            scratch.assign(5 * width, 0.0);
+        double* up = scratch.data();
+        double* row = up + width;
+        double* down = row + width;
+        double* result = down + width;
+        double* previous = result + width;
+
+        auto load = [&](const uint_fast64_t& i, double* dst)
+        {
+            dst[0] = 0.0;
+            dst[B + 1] = 0.0;
+            if(i == B)
+            {
+                for(uint_fast64_t j = 0; j < B; ++j)
+                    dst[j + 1] = bottom ? bottom[j] : 0.0;
+                return;
+            }
+            in.readBlock(i * B, B, dst + 1);
+            if(left) dst[0] = left[i];
+            if(right) dst[B + 1] = right[i];
+        };
+
+        up[0] = up[B + 1] = 0.0;
+        for(uint_fast64_t j = 0; j < B; ++j)
+            up[j + 1] = top ? top[j] : 0.0;
+        load(0, row);
+
+        const bool first = (omega == 1.0);
+        double delta = 0.0;
+        for(uint_fast64_t i = 0; i < B; ++i)
+        {
+            load(i + 1, down);
+            stencilRow(up, row, down, B, weight, result);
+            if(first)
+                for(uint_fast64_t j = 0; j < B; ++j)
+                    result[j] = gamma * result[j] + (1.0 - gamma) * row[j + 1];
+            else
+            {
+                prev.readBlock(i * B, B, previous);
+                for(uint_fast64_t j = 0; j < B; ++j)
+                    result[j] = previous[j] + omega * (gamma * result[j] + (1.0 - gamma) * row[j + 1] - previous[j]);
+            }
+            for(uint_fast64_t j = 0; j < B; ++j)
+                delta = std::max(delta, fabs(result[j] - row[j + 1]));
+            out.writeBlock(i * B, B, result);
+            double* spare = up;
+            up = row;
+            row = down;
+            down = spare;
+        }
+        return delta;
+    }
+
+    /*
+        steps sweeps of the 5 point stencil over a width x width tile of doubles, for temporal blocking:
+        a block padded with steps ghost rows and columns from its neighbours can be advanced steps sweeps
+        in one pass over its data. Every sweep leaves one more ring of the tile out of date, so only the
+        central (width - 2*steps)^2 points are exact after the last. Only the points in rows
+        [rowBegin, rowEnd) and columns [colBegin, colEnd) are updated; the others, the grid's fixed
+        boundary, keep their values (rowBegin and colBegin are at least 1, rowEnd and colEnd at most
+        width - 1). With heads, the sweeps before the last are truncated to heads, as a sweep of a heads
+        array would store them; the last is left for the caller to narrow.
+        tile and scratch (width * width doubles) are swapped after each sweep, so tile holds the result on
+        return. Returns the largest change of a point in the last sweep.
+    */
+    inline double stencil5Steps(double*& tile, double*& scratch, const uint_fast64_t& width, const uint_fast64_t& steps,
+        const uint_fast64_t& rowBegin, const uint_fast64_t& rowEnd, const uint_fast64_t& colBegin,
+        const uint_fast64_t& colEnd, const bool& heads, const double& weight = 0.2)
+    {
+        // the boundary and the ring that is not updated are read from scratch too
+        std::copy(tile, tile + width * width, scratch);
+
+        double delta = 0.0;
+        for(uint_fast64_t s = 1; s <= steps; ++s)
+        {
+            const uint_fast64_t r0 = std::max(rowBegin, s), r1 = std::min(rowEnd, width - s);
+            const uint_fast64_t c0 = std::max(colBegin, s), c1 = std::min(colEnd, width - s);
+            delta = 0.0;
+            for(uint_fast64_t i = r0; i < r1 && c0 < c1; ++i)
+            {
+                double* out = scratch + i * width + c0;
+                const double* row = tile + i * width + c0 - 1;
+                delta = std::max(delta, stencilRow(row - width, row, row + width, c1 - c0, weight, out));
+                if(heads && s < steps)
+                    for(uint_fast64_t j = 0; j < c1 - c0; ++j)
+                        out[j] = headToDouble(roundToHead<ROUND_TRUNCATE>(out[j]));
+            }
+            std::swap(tile, scratch);
+        }
+        return delta;
+    }
+
+    /*
+        The 7 point stencil over B x B x B bricks, point (k, i, j) at k*B*B + i*B + j: each row of a brick
+        has its four neighbour rows, above and below in its plane (i) and in the planes before and after
+        it (k). The halos of a brick are its six faces, B*B values each or null for zeros: front and back
+        (the planes k = -1 and B) indexed i*B + j, top and bottom (the rows i = -1 and B of each plane)
+        k*B + j, and left and right (the columns j = -1 and B) k*B + i. The bricks are swept a plane at a
+        time, three planes widened to doubles with their ring of halo values.
+    */
+    namespace simd
+    {
+#if defined(MANSEG_HAS_AVX2)
+        /* stencilRow7 for 4 values per step; returns the number of values done, with their largest change in delta */
+        MANSEG_TARGET_AVX2 inline uint_fast64_t stencilRow7AVX2(const double* row, const double* up, const double* down,
+            const double* front, const double* back, const uint_fast64_t& n, const double& weight, double* out, double& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m256d w = _mm256_set1_pd(weight);
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            __m256d dmax = _mm256_setzero_pd();
+            for(; j < (n & ~uint_fast64_t(3)); j += 4)
+            {
+                __m256d centre = _mm256_loadu_pd(row + j + 1);
+                __m256d sum = _mm256_add_pd(centre, _mm256_loadu_pd(row + j));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(up + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 2));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(front + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(back + j + 1));
+                __m256d next = _mm256_mul_pd(w, sum);
+                _mm256_storeu_pd(out + j, next);
+                dmax = _mm256_max_pd(dmax, _mm256_andnot_pd(sign, _mm256_sub_pd(next, centre)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, dmax);
+            delta = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            return j;
+        }
+
+        /* sorRow7 for 4 values per step into out[j], as sorRowAVX2 */
+        template<int first>
+        MANSEG_TARGET_AVX2 inline uint_fast64_t sorRow7AVX2(const double* row, const double* up, const double* down,
+            const double* front, const double* back, const uint_fast64_t& n, const double& omega, double* out, double& delta)
+        {
+            uint_fast64_t j = 0;
+            const __m256d w = _mm256_set1_pd(omega);
+            const __m256d sixth = _mm256_set1_pd(1.0 / 6.0);
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            __m256d dmax = _mm256_setzero_pd();
+            for(; j < (n & ~uint_fast64_t(3)); j += 4)
+            {
+                __m256d centre = _mm256_loadu_pd(row + j + 1);
+                __m256d sum = _mm256_add_pd(_mm256_loadu_pd(row + j), _mm256_loadu_pd(up + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(row + j + 2));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(down + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(front + j + 1));
+                sum = _mm256_add_pd(sum, _mm256_loadu_pd(back + j + 1));
+                __m256d next = _mm256_add_pd(centre, _mm256_mul_pd(w, _mm256_sub_pd(_mm256_mul_pd(sixth, sum), centre)));
+                next = _mm256_blend_pd(centre, next, first == 0 ? 0x5 : 0xA);
+                _mm256_storeu_pd(out + j, next);
+                dmax = _mm256_max_pd(dmax, _mm256_andnot_pd(sign, _mm256_sub_pd(next, centre)));
+            }
+            double lanes[4];
+            _mm256_storeu_pd(lanes, dmax);
+            delta = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            return j;
+        }
+#endif
+    }
+
+    /*
+        out[j] = weight * (row[j+1] + row[j] + up[j+1] + row[j+2] + down[j+1] + front[j+1] + back[j+1]) for j
+        in [0, n), all padded rows of n + 2 values; returns the largest |out[j] - row[j+1]|.
+    */
+    inline double stencilRow7(const double* row, const double* up, const double* down, const double* front,
+        const double* back, const uint_fast64_t& n, const double& weight, double* out)
+    {
+        uint_fast64_t j = 0;
+        double delta = 0.0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2) j = simd::stencilRow7AVX2(row, up, down, front, back, n, weight, out, delta);
+#endif
+        for(; j < n; ++j)
+        {
+            out[j] = weight * (row[j + 1] + row[j] + up[j + 1] + row[j + 2] + down[j + 1] + front[j + 1] + back[j + 1]);
+            delta = std::max(delta, fabs(out[j] - row[j + 1]));
+        }
+        return delta;
+    }
+
+    /* sorRow with the six neighbours of the 7 point stencil, the average of them in place of the four */
+    inline double sorRow7(double* row, const double* up, const double* down, const double* front, const double* back,
+        const uint_fast64_t& n, const uint_fast64_t& first, const double& omega)
+    {
+        uint_fast64_t j = 0;
+        double delta = 0.0;
+#if defined(MANSEG_HAS_AVX2)
+        if(simdLevel() >= SIMD_AVX2)
+        {
+            static thread_local std::vector<double> out;
+            if(out.size() < n)
+                out.resize(n);
+            j = (first == 0) ? simd::sorRow7AVX2<0>(row, up, down, front, back, n, omega, out.data(), delta)
+                             : simd::sorRow7AVX2<1>(row, up, down, front, back, n, omega, out.data(), delta);
+            std::copy(out.data(), out.data() + j, row + 1);
+        }
+#endif
+        for(j += first; j < n; j += 2)
+        {
+            const double centre = row[j + 1];
+            const double sum = row[j] + up[j + 1] + row[j + 2] + down[j + 1] + front[j + 1] + back[j + 1];
+            const double next = centre + omega * ((1.0 / 6.0) * sum - centre);
+            row[j + 1] = next;
+            delta = std::max(delta, fabs(next - centre));
+        }
+        return delta;
+    }
+
+    /*
+        The faces of a brick (see stencilRow7), in the order front, back, top, bottom, left, right.
+    */
+    struct BrickHalos
+    {
+        const double* face[6];
+
+        BrickHalos() { std::fill(face, face + 6, nullptr); }
+    };
+
+    namespace detail
+    {
+        /*
+            Plane k of the B x B x B brick a (k = -1 and B from the front and back faces) into the padded
+            (B + 2) x (B + 2) plane dst, with its ring from the top, bottom, left and right faces.
+        */
+        template<class A>
+        void loadPlane(A& a, const uint_fast64_t& B, const BrickHalos& h, const int64_t& k, double* dst)
+        {
+            const uint_fast64_t width = B + 2;
+            std::fill(dst, dst + width * width, 0.0);
+            if(k < 0 || k >= (int64_t)B)
+            {
+                const double* face = h.face[(k < 0) ? 0 : 1];
+                if(face)
+                    for(uint_fast64_t i = 0; i < B; ++i)
+                        std::copy(face + i * B, face + (i + 1) * B, dst + (i + 1) * width + 1);
+                return;
+            }
+            for(uint_fast64_t i = 0; i < B; ++i)
+            {
+                a.readBlock(k * B * B + i * B, B, dst + (i + 1) * width + 1);
+                if(h.face[4]) dst[(i + 1) * width] = h.face[4][k * B + i];
+                if(h.face[5]) dst[(i + 1) * width + B + 1] = h.face[5][k * B + i];
+            }
+            if(h.face[2]) std::copy(h.face[2] + k * B, h.face[2] + (k + 1) * B, dst + 1);
+            if(h.face[3]) std::copy(h.face[3] + k * B, h.face[3] + (k + 1) * B, dst + (B + 1) * width + 1);
+        }
+    }
+
+    /*
+        One sweep of the 7 point stencil over the B x B x B brick in, written to out:
+            out[k][i][j] = weight * (in[k][i][j] + its six neighbours)
+        with the neighbours outside the brick from the halos. Returns the largest change of a value,
+        before out is narrowed. In and Out are any of the LevelView types; they must be different bricks.
+    */
+    template<class In, class Out>
+    double stencil7(In in, Out out, const uint_fast64_t& B, const BrickHalos& halos, const double& weight = 1.0 / 7.0)
+    {
+        // three padded planes and the output row, reused by each thread
+        static thread_local std::vector<double> scratch;
+        const uint_fast64_t width = B + 2, plane = width * width;
+        if(scratch.size() < 3 * plane + B)
+            scratch.assign(3 * plane + B, 0.0);
+        double* front = scratch.data();
+        double* cur = front + plane;
+        double* back = cur + plane;
+        double* result = back + plane;
+
+        detail::loadPlane(in, B, halos, -1, front);
+        detail::loadPlane(in, B, halos, 0, cur);
+        double delta = 0.0;
+        for(uint_fast64_t k = 0; k < B; ++k)
+        {
+            detail::loadPlane(in, B, halos, k + 1, back);
+            for(uint_fast64_t i = 0; i < B; ++i)
+            {
+                const uint_fast64_t at = (i + 1) * width;
+                delta = std::max(delta, stencilRow7(cur + at, cur + at - width, cur + at + width, front + at, back + at, B, weight, result));
+                out.writeBlock(k * B * B + i * B, B, result);
+            }
+            double* spare = front;
+            front = cur;
+            cur = back;
+            back = spare;
+        }
+        return delta;
+    }
+
+    /*
+        Half a sweep of red-black SOR over the B x B x B brick a, in place: the points with (k + i + j) % 2
+        == colour are over-relaxed (see sorRow7), with the halos as for stencil7. As for sor5, every
+        neighbour of such a point is of the other colour, so the bricks can do a colour in parallel.
+        Returns the largest change of a value, before it is narrowed.
+    */
+    template<class A>
+    double sor7(A a, const uint_fast64_t& B, const BrickHalos& halos, const uint_fast64_t& colour, const double& omega)
+    {
+        static thread_local std::vector<double> scratch;
+        const uint_fast64_t width = B + 2, plane = width * width;
+        if(scratch.size() < 3 * plane)
+            scratch.assign(3 * plane, 0.0);
+        double* front = scratch.data();
+        double* cur = front + plane;
+        double* back = cur + plane;
+
+        detail::loadPlane(a, B, halos, -1, front);
+        detail::loadPlane(a, B, halos, 0, cur);
+        double delta = 0.0;
+        for(uint_fast64_t k = 0; k < B; ++k)
+        {
+            detail::loadPlane(a, B, halos, k + 1, back);
+            for(uint_fast64_t i = 0; i < B; ++i)
+            {
+                const uint_fast64_t at = (i + 1) * width;
+                delta = std::max(delta, sorRow7(cur + at, cur + at - width, cur + at + width, front + at, back + at,
+                                                B, (colour + k + i) % 2, omega));
+                a.writeBlock(k * B * B + i * B, B, cur + at + 1);
+            }
+            double* spare = front;
+            front = cur;
+            cur = back;
+            back = spare;
+        }
+        return delta;
+    }
+}
+
+#endif // __MANSEG_STENCIL_H__
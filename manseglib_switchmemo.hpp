@@ -0,0 +1,289 @@
+/*
+	Switch points remembered from earlier runs on the same input.
+	Author: harunadess
+
+	A solver rerun on the same graph or matrix with the same parameters leaves the heads at the same
+	iteration every time, and its policy only finds that iteration after spending a few at the heads
+	that no longer gain much (a stagnation policy has to see the stagnation). A SwitchMemo keeps, in
+	a directory ($MANSEG_SWITCH_CACHE, off without it), a record for each input fingerprint and
+	parameters: the deltas of the heads iterations, the iteration the policy switched at, the rate
+	of the full iterations after it, and from those the best iteration to have switched at. A later
+	run's controller switches there, as long as its deltas follow the record's:
+		SwitchMemo memo(inputFingerprint(file), "pagerank d=0.85 stagnation 0.25");
+		PrecisionController<MemoisedPolicy<StagnationPolicy> > control(memo.policy(StagnationPolicy(0.25)));
+		while(...) { ...; memo.observe(delta); control.update(delta); }     // every iteration, at any level
+		memo.save(control, "stagnation 0.25");                              // a record for the next run
+	The best switch is after the last heads iteration that gained at least half (in log terms) of what
+	a full iteration does, as an iteration at the heads moves about half the bytes of one at full.
+	A delta more than tolerance ($MANSEG_SWITCH_CACHE_TOLERANCE, default 0.01) from the record's, relatively,
+	means the input or the solver is not what it was: the policy is then asked as without a record, and
+	save replaces the record with the new run's. A run that followed its record leaves it as it is.
+	The policy wrapped is asked at every iteration either way, so policies with a history keep it.
+	The fingerprint is the size of the file and a hash of its first and last 64 KB, so a copy of the
+	input, or one written again the same, finds the record too. POSIX only.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_SWITCHMEMO_H__
+#define __MANSEG_SWITCHMEMO_H__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "manseglib_controller.hpp"
+
+namespace ManSeg
+{
+    namespace switchmemo
+    {
+        /* FNV-1a, continued from h */
+        inline uint64_t hash(const void* data, const size_t& bytes, uint64_t h = 14695981039346656037ull)
+        {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for(size_t i = 0; i < bytes; ++i)
+                h = (h ^ p[i]) * 1099511628211ull;
+            return h;
+        }
+    }
+
+    /* the tolerance of a delta against a record's: $MANSEG_SWITCH_CACHE_TOLERANCE, or fallback if it is unset */
+    inline double switchCacheTolerance(const double& fallback = 0.01)
+    {
+        const char* t = getenv("MANSEG_SWITCH_CACHE_TOLERANCE");
+        return (t != nullptr && *t != '\0') ? atof(t) : fallback;
+    }
+
+    /* a fingerprint of the file at path: its size and a hash of its first and last 64 KB; 0 if it cannot be read */
+    inline uint64_t inputFingerprint(const char* path)
+    {
+        const int fd = open(path, O_RDONLY);
+        if(fd < 0)
+            return 0;
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return 0;
+        }
+        const uint64_t size = static_cast<uint64_t>(st.st_size);
+        uint64_t h = switchmemo::hash(&size, sizeof(size));
+        const size_t sample = 1 << 16;
+        std::vector<char> buffer(sample);
+        const off_t ends[2] = { 0, static_cast<off_t>(size > sample ? size - sample : 0) };
+        for(const off_t& at : ends)
+        {
+            const ssize_t got = pread(fd, buffer.data(), sample, at);
+            if(got > 0)
+                h = switchmemo::hash(buffer.data(), static_cast<size_t>(got), h);
+        }
+        close(fd);
+        return h == 0 ? 1 : h;
+    }
+
+    /* what a run on an input did at the heads */
+    struct SwitchRecord
+    {
+        std::string policy;             // the policy that switched, e.g. "stagnation 0.25"
+        int observed = -1;              // heads iterations before the policy switched
+        int best = -1;                  // heads iterations it would have been best to stop after
+        double fullRate = NAN;          // the delta of a full iteration over the one before, on average
+        std::vector<double> deltas;     // of the heads iterations, observed of them
+
+        /*
+            The best switch from the deltas and fullRate: after the last heads iteration k such that
+            every one up to it fell by at least the square root of fullRate.
+        */
+        void findBest()
+        {
+            best = observed;
+            if(!(fullRate > 0.0 && fullRate < 1.0))
+                return;
+            const double worth = sqrt(fullRate);
+            for(int k = 1; k < observed; ++k)
+                if(deltas[k] / deltas[k - 1] > worth)
+                {
+                    best = k;
+                    return;
+                }
+        }
+    };
+
+    /*
+        A policy that switches where a record says, while the deltas follow it, and otherwise (or
+        without a record) as the policy it wraps. See SwitchMemo.
+    */
+    template<class Policy>
+    struct MemoisedPolicy
+    {
+        Policy policy;
+        std::shared_ptr<const SwitchRecord> record;     // none to always ask policy
+        double tolerance;
+        bool diverged;
+        int last;                                       // the iteration last checked
+
+        MemoisedPolicy(const Policy& policy = Policy(), const std::shared_ptr<const SwitchRecord>& record = nullptr, const double& tolerance = 0.01)
+            :policy(policy), record(record), tolerance(tolerance), diverged(false), last(0)
+        {}
+
+        /* whether the switch still comes from the record */
+        bool following() const { return record && !diverged && record->best > 0; }
+
+        SwitchReason check(const double& delta, const double& prevDelta, const int& iteration)
+        {
+            last = iteration;
+            const SwitchReason online = policy.check(delta, prevDelta, iteration);
+            if(following())
+            {
+                const int k = iteration - 1;
+                if(k >= static_cast<int>(record->deltas.size()) || fabs(delta - record->deltas[k]) > tolerance * fabs(record->deltas[k]))
+                    diverged = true;
+                else if(iteration >= record->best)
+                    return SWITCH_REMEMBERED;
+            }
+            return online;
+        }
+
+        double remaining(const double& delta, const double& rate) const
+        {
+            if(following())
+                return std::max(0, record->best - last);
+            return policy.remaining(delta, rate);
+        }
+    };
+
+    class SwitchMemo
+    {
+    public:
+        /* the record of fingerprint and parameters in dir, if there is one; a null dir or fingerprint 0 turns the memo off */
+        SwitchMemo(const uint64_t& fingerprint, const std::string& parameters, const char* dir = getenv("MANSEG_SWITCH_CACHE"),
+            const double& tolerance = switchCacheTolerance())
+            :tolerance(tolerance)
+        {
+            if(dir == nullptr || *dir == '\0' || fingerprint == 0)
+                return;
+            const uint64_t key = switchmemo::hash(parameters.data(), parameters.size(), switchmemo::hash(&fingerprint, sizeof(fingerprint)));
+            char name[32];
+            snprintf(name, sizeof(name), "/%016llx.switch", static_cast<unsigned long long>(key));
+            path = std::string(dir) + name;
+            load();
+        }
+
+        bool enabled() const { return !path.empty(); }
+        /* whether there was a record */
+        bool found() const { return static_cast<bool>(record); }
+        const SwitchRecord& remembered() const { return *record; }
+
+        /* policy, switching where the record says while the deltas follow it */
+        template<class Policy>
+        MemoisedPolicy<Policy> policy(const Policy& wrapped) const { return MemoisedPolicy<Policy>(wrapped, record, tolerance); }
+
+        /* the delta of the next iteration, at whatever level */
+        void observe(const double& delta) { deltas.push_back(delta); }
+
+        /*
+            Records the run controlled by control (whose policy is one of this memo's), if there was no
+            record or the run did not follow it; true if a record was written. policyName describes the
+            policy wrapped, for whoever reads the file.
+        */
+        template<class Policy>
+        bool save(const PrecisionController<MemoisedPolicy<Policy> >& control, const std::string& policyName = std::string())
+        {
+            if(!enabled() || (record && !control.policy().diverged))
+                return false;
+            const int interim = control.switchIteration(PRECISION_INTERIM);
+            const int heads = interim >= 0 ? interim : control.switchIteration(PRECISION_FULL);
+            if(heads <= 0 || heads > static_cast<int>(deltas.size()))
+                return false;
+
+            SwitchRecord r;
+            r.policy = policyName.empty() ? "unnamed" : policyName;
+            r.observed = heads;
+            r.deltas.assign(deltas.begin(), deltas.begin() + heads);
+            // the full iterations, after the interim one
+            const int first = heads + (interim >= 0 ? 1 : 0);
+            const int count = static_cast<int>(deltas.size()) - first;
+            if(count >= 2 && deltas[first] > 0.0 && deltas.back() > 0.0)
+                r.fullRate = pow(deltas.back() / deltas[first], 1.0 / (count - 1));
+            r.findBest();
+            return write(r);
+        }
+
+    private:
+        double tolerance;
+        std::string path;
+        std::shared_ptr<const SwitchRecord> record;
+        std::vector<double> deltas;
+
+        void load()
+        {
+            FILE* f = fopen(path.c_str(), "r");
+            if(f == nullptr)
+                return;
+            std::shared_ptr<SwitchRecord> r = std::make_shared<SwitchRecord>();
+            char policy[256];
+            int count = 0;
+            bool ok = fscanf(f, "MSSWITCH 1\npolicy %255[^\n]\nobserved %d\nbest %d\nfull_rate %lf\ndeltas %d",
+                policy, &r->observed, &r->best, &r->fullRate, &count) == 5 && count == r->observed && count > 0;
+            for(int k = 0; ok && k < count; ++k)
+            {
+                double d;
+                ok = fscanf(f, "%lf", &d) == 1;
+                r->deltas.push_back(d);
+            }
+            fclose(f);
+            if(!ok || r->best < 1 || r->best > r->observed)
+                return;
+            r->policy = policy;
+            record = r;
+        }
+
+        /* written whole to a file of its own, then renamed over the record, so a reader never sees half of one */
+        bool write(const SwitchRecord& r) const
+        {
+            const std::string tmp = path + ".tmp" + std::to_string(getpid());
+            FILE* f = fopen(tmp.c_str(), "w");
+            if(f == nullptr)
+                return false;
+            fprintf(f, "MSSWITCH 1\npolicy %s\nobserved %d\nbest %d\nfull_rate %.17g\ndeltas %d\n",
+                r.policy.c_str(), r.observed, r.best, r.fullRate, static_cast<int>(r.deltas.size()));
+            for(const double& d : r.deltas)
+                fprintf(f, "%.17g\n", d);
+            const bool ok = fclose(f) == 0;
+            if(!ok || rename(tmp.c_str(), path.c_str()) != 0)
+            {
+                unlink(tmp.c_str());
+                return false;
+            }
+            return true;
+        }
+    };
+}
+
+#endif // __MANSEG_SWITCHMEMO_H__
@@ -0,0 +1,291 @@
+/*
+	Live telemetry of a running solve in a named shared memory segment.
+	Author: harunadess
+
+	A long run is watched by tailing its stderr, which needs the log parsed and puts stdio on the
+	path of every iteration. With $MANSEG_TELEMETRY set to a name (e.g. /pagerank_42), a driver's
+	ResultsWriter also publishes each iteration it records to a small block in the shared memory
+	segment of that name (see shm_open; on Linux it is /dev/shm/pagerank_42). The block holds the
+	round, the iteration, its delta, time, precision level and bytes, their bytes per second, and
+	the time since the first:
+		Telemetry telemetry("msa_pagerank", getenv("MANSEG_TELEMETRY"));   // does nothing without a name
+		telemetry.publish(round, iter, delta, seconds, "heads", bytes);
+	The writer takes no lock. The block is a seqlock: the sequence is odd while the fields are being
+	written, so a reader copies the fields between two reads of an even sequence and tries again if
+	it changed. A reader maps the segment read only, so it never writes a line the driver uses,
+	however often it looks:
+		TelemetryReader reader("/pagerank_42");
+		TelemetrySnapshot s;
+		if(reader.read(s)) printf("%d: delta = %g\n", (int)s.iteration, s.delta);
+	bench/telemetry_export prints the block, or writes it as a Prometheus textfile. The segment is
+	left when the run ends, marked finished, so its last state can still be read. rm /dev/shm/<name>,
+	or TelemetryReader::remove, deletes it.
+	POSIX only (shm_open, mmap).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_TELEMETRY_H__
+#define __MANSEG_TELEMETRY_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+namespace ManSeg
+{
+    /* "MSTELEM1": the block has been set up */
+    constexpr uint64_t TelemetryMagic = 0x314d454c4554534dull;
+
+    /* the fields of a telemetry block, each 8 bytes */
+    enum TelemetryField
+    {
+        TELEMETRY_ROUND,
+        TELEMETRY_ITERATION,
+        TELEMETRY_DELTA,
+        TELEMETRY_SECONDS,          // of the iteration
+        TELEMETRY_ELAPSED,          // since the first iteration started
+        TELEMETRY_BYTES,            // of the iteration, the driver's estimate
+        TELEMETRY_BYTES_PER_SECOND,
+        TELEMETRY_LEVEL,            // up to 8 characters of the precision level's name
+        TELEMETRY_UPDATES,
+        TELEMETRY_FINISHED,
+        TELEMETRY_FIELDS
+    };
+
+    /*
+        The block in the segment: every field is atomic, so that the seqlock's copies are not data
+        races; the writer stores them relaxed between two releases of the sequence.
+    */
+    struct TelemetryBlock
+    {
+        std::atomic<uint64_t> magic;
+        std::atomic<uint64_t> sequence;
+        std::atomic<uint64_t> pid;
+        char app[40];
+        std::atomic<uint64_t> fields[TELEMETRY_FIELDS];
+    };
+
+    /* a consistent copy of a telemetry block */
+    struct TelemetrySnapshot
+    {
+        char app[40];
+        uint64_t pid;
+        int64_t round;
+        int64_t iteration;
+        double delta;
+        double seconds;
+        double elapsed;
+        double bytes;
+        double bytesPerSecond;
+        char level[9];
+        uint64_t updates;
+        bool finished;
+    };
+
+    namespace telemetry
+    {
+        inline uint64_t bits(const double& d)
+        {
+            uint64_t b;
+            memcpy(&b, &d, sizeof(b));
+            return b;
+        }
+
+        inline double value(const uint64_t& b)
+        {
+            double d;
+            memcpy(&d, &b, sizeof(d));
+            return d;
+        }
+    }
+
+    /* the writer of a telemetry block: a driver has one, and publishes to it after each iteration */
+    class Telemetry
+    {
+    public:
+        /* creates (or takes over) the segment name for app; without a name, or if it cannot, publish does nothing */
+        Telemetry(const char* app, const char* name)
+            :block(nullptr), elapsed(0.0)
+        {
+            if(name == nullptr || *name == '\0')
+                return;
+            const int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+            if(fd < 0)
+                return;
+            void* mem = MAP_FAILED;
+            if(ftruncate(fd, sizeof(TelemetryBlock)) == 0)
+                mem = mmap(nullptr, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if(mem == MAP_FAILED)
+                return;
+            block = static_cast<TelemetryBlock*>(mem);
+
+            // a reader ignores the block until the magic is stored, and the sequence is odd until the first publish
+            block->magic.store(0, std::memory_order_relaxed);
+            block->sequence.store(1, std::memory_order_relaxed);
+            block->pid.store(static_cast<uint64_t>(getpid()), std::memory_order_relaxed);
+            memset(block->app, 0, sizeof(block->app));
+            strncpy(block->app, app, sizeof(block->app) - 1);
+            for(int f = 0; f < TELEMETRY_FIELDS; ++f)
+                block->fields[f].store(0, std::memory_order_relaxed);
+            block->sequence.store(2, std::memory_order_relaxed);
+            block->magic.store(TelemetryMagic, std::memory_order_release);
+        }
+
+        /* marks the block finished and unmaps it; the segment stays for the readers */
+        ~Telemetry()
+        {
+            if(block == nullptr)
+                return;
+            begin();
+            store(TELEMETRY_FINISHED, uint64_t(1));
+            end();
+            munmap(block, sizeof(TelemetryBlock));
+        }
+
+        Telemetry(const Telemetry&) = delete;
+        Telemetry& operator=(const Telemetry&) = delete;
+
+        bool enabled() const { return block != nullptr; }
+
+        /* the iteration just done: its delta, time in seconds, precision level and bytes touched */
+        void publish(const int& round, const int& iter, const double& delta, const double& seconds, const char* level, const double& bytes)
+        {
+            if(block == nullptr)
+                return;
+            elapsed += seconds;
+            uint64_t name = 0;
+            if(level != nullptr)
+                memcpy(&name, level, std::min(strlen(level), sizeof(name)));
+            begin();
+            store(TELEMETRY_ROUND, static_cast<uint64_t>(static_cast<int64_t>(round)));
+            store(TELEMETRY_ITERATION, static_cast<uint64_t>(static_cast<int64_t>(iter)));
+            store(TELEMETRY_DELTA, telemetry::bits(delta));
+            store(TELEMETRY_SECONDS, telemetry::bits(seconds));
+            store(TELEMETRY_ELAPSED, telemetry::bits(elapsed));
+            store(TELEMETRY_BYTES, telemetry::bits(bytes));
+            store(TELEMETRY_BYTES_PER_SECOND, telemetry::bits(seconds > 0.0 ? bytes / seconds : 0.0));
+            store(TELEMETRY_LEVEL, name);
+            store(TELEMETRY_UPDATES, block->fields[TELEMETRY_UPDATES].load(std::memory_order_relaxed) + 1);
+            end();
+        }
+
+    private:
+        TelemetryBlock* block;
+        double elapsed;
+
+        void store(const TelemetryField& f, const uint64_t& v) { block->fields[f].store(v, std::memory_order_relaxed); }
+
+        // odd while the fields change: the fence keeps the fields' stores after the odd sequence's
+        void begin()
+        {
+            block->sequence.store(block->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        void end()
+        {
+            block->sequence.store(block->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+    };
+
+    /* a read only view of a telemetry block, for a process watching a run */
+    class TelemetryReader
+    {
+    public:
+        explicit TelemetryReader(const char* name)
+            :block(nullptr)
+        {
+            const int fd = (name != nullptr) ? shm_open(name, O_RDONLY, 0) : -1;
+            if(fd < 0)
+                return;
+            struct stat st;
+            void* mem = MAP_FAILED;
+            if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(TelemetryBlock))
+                mem = mmap(nullptr, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if(mem != MAP_FAILED)
+                block = static_cast<const TelemetryBlock*>(mem);
+        }
+
+        ~TelemetryReader()
+        {
+            if(block != nullptr)
+                munmap(const_cast<TelemetryBlock*>(block), sizeof(TelemetryBlock));
+        }
+
+        TelemetryReader(const TelemetryReader&) = delete;
+        TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+        /* whether the segment exists and has been set up by a writer */
+        bool isOpen() const { return block != nullptr && block->magic.load(std::memory_order_acquire) == TelemetryMagic; }
+
+        /* copies the block into s: false if it is not open, or was being written throughout tries attempts */
+        bool read(TelemetrySnapshot& s, const int& tries = 1000) const
+        {
+            if(!isOpen())
+                return false;
+            for(int t = 0; t < tries; ++t)
+            {
+                const uint64_t before = block->sequence.load(std::memory_order_acquire);
+                if(before & 1)
+                    continue;
+                uint64_t f[TELEMETRY_FIELDS];
+                for(int i = 0; i < TELEMETRY_FIELDS; ++i)
+                    f[i] = block->fields[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(block->sequence.load(std::memory_order_relaxed) != before)
+                    continue;
+
+                memcpy(s.app, block->app, sizeof(s.app));
+                s.app[sizeof(s.app) - 1] = '\0';
+                s.pid = block->pid.load(std::memory_order_relaxed);
+                s.round = static_cast<int64_t>(f[TELEMETRY_ROUND]);
+                s.iteration = static_cast<int64_t>(f[TELEMETRY_ITERATION]);
+                s.delta = telemetry::value(f[TELEMETRY_DELTA]);
+                s.seconds = telemetry::value(f[TELEMETRY_SECONDS]);
+                s.elapsed = telemetry::value(f[TELEMETRY_ELAPSED]);
+                s.bytes = telemetry::value(f[TELEMETRY_BYTES]);
+                s.bytesPerSecond = telemetry::value(f[TELEMETRY_BYTES_PER_SECOND]);
+                memcpy(s.level, &f[TELEMETRY_LEVEL], 8);
+                s.level[8] = '\0';
+                s.updates = f[TELEMETRY_UPDATES];
+                s.finished = f[TELEMETRY_FINISHED] != 0;
+                return true;
+            }
+            return false;
+        }
+
+        /* deletes the segment name; the mappings of it stay valid */
+        static bool remove(const char* name) { return shm_unlink(name) == 0; }
+
+    private:
+        const TelemetryBlock* block;
+    };
+}
+
+#endif // __MANSEG_TELEMETRY_H__
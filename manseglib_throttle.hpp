@@ -0,0 +1,181 @@
+/*
+	Worker counts tuned to each precision phase of a solve.
+	Author: harunadess
+
+	An iteration at the heads moves half the bytes of one at full precision, and on many machines
+	memory bandwidth saturates at a fraction of the cores: the other threads add nothing but power
+	and contention. A ThreadThrottle finds, for each phase of a solve, the fewest workers that still
+	give the phase's best throughput, and runs the phase's iterations on those (setParallelWorkers
+	in manseglib_parallel.hpp), leaving the rest of the cores to other jobs, or asleep:
+		ThreadThrottle throttle;                        // does nothing unless $MANSEG_THROTTLE=1
+		while(...)
+		{
+			throttle.phase(levelName(control.level())); // a new phase is tuned, a known one takes up its count
+			...one iteration...
+			throttle.update(seconds, bytes);            // may change the workers of the next iteration
+		}
+	A phase is tuned from all the workers down, halving the count: the first iteration of a phase
+	(and of each count) is not measured, as it pays for faulting in pages and the like; each count
+	then gets samples iterations ($MANSEG_THROTTLE_SAMPLES, default 2), of which the best throughput
+	counts (bytes per second, or iterations per second without bytes). Halving stops at the first
+	count more than tolerance ($MANSEG_THROTTLE_TOLERANCE, default 0.05) slower than the best so far,
+	and the phase settles on the fewest workers within tolerance of the best. A solve whose
+	iterations are not long enough to time, or that has few of them in a phase, gains nothing.
+	The loops of the application must follow the count: OpenMP's regions without num_threads do,
+	and others can ask parallelWorkers(). With OpenMP, set OMP_WAIT_POLICY=passive for the unused
+	threads to sleep rather than spin.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_THROTTLE_H__
+#define __MANSEG_THROTTLE_H__
+
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "manseglib_parallel.hpp"
+
+namespace ManSeg
+{
+    class ThreadThrottle
+    {
+    public:
+        /*
+            Negative arguments are taken from the environment: enabled from $MANSEG_THROTTLE (off
+            without it), tolerance and samples as described above.
+        */
+        explicit ThreadThrottle(const int& enabled = -1, const double& tolerance = -1.0, const int& samples = -1)
+            :on(enabled > 0), tolerance(tolerance), samples(samples), current(-1)
+        {
+            if(enabled < 0)
+                on = getenv("MANSEG_THROTTLE") != nullptr && atoi(getenv("MANSEG_THROTTLE")) != 0;
+            if(this->tolerance < 0.0)
+                this->tolerance = getenv("MANSEG_THROTTLE_TOLERANCE") != nullptr ? atof(getenv("MANSEG_THROTTLE_TOLERANCE")) : 0.05;
+            if(this->samples < 1)
+                this->samples = getenv("MANSEG_THROTTLE_SAMPLES") != nullptr ? std::max(1, atoi(getenv("MANSEG_THROTTLE_SAMPLES"))) : 2;
+        }
+
+        /* gives the loops all the workers back */
+        ~ThreadThrottle()
+        {
+            if(on)
+                setParallelWorkers(0);
+        }
+
+        ThreadThrottle(const ThreadThrottle&) = delete;
+        ThreadThrottle& operator=(const ThreadThrottle&) = delete;
+
+        bool enabled() const { return on; }
+
+        /* the phase of the iterations from now on, e.g. levelName(control.level()) */
+        void phase(const char* name)
+        {
+            if(!on || (current >= 0 && phases[current].name == name))
+                return;
+            current = -1;
+            for(size_t p = 0; p < phases.size(); ++p)
+                if(phases[p].name == name)
+                    current = static_cast<int>(p);
+            if(current < 0)
+            {
+                Phase p;
+                p.name = name;
+                for(unsigned count = parallelMaxWorkers(); count >= 1; count /= 2)
+                    p.counts.push_back(count);
+                p.rates.assign(p.counts.size(), 0.0);
+                phases.push_back(p);
+                current = static_cast<int>(phases.size()) - 1;
+            }
+            Phase& p = phases[current];
+            // a phase left while it was being tuned starts its count's measurements again
+            p.taken = -1;
+            setParallelWorkers(p.settled ? p.chosen : p.counts[p.at]);
+        }
+
+        /* an iteration of the current phase took seconds, and touched bytes (0 if not known) */
+        void update(const double& seconds, const double& bytes = 0.0)
+        {
+            if(!on || current < 0 || seconds <= 0.0)
+                return;
+            Phase& p = phases[current];
+            if(p.settled)
+                return;
+            if(p.taken++ < 0)
+                return;
+            p.rates[p.at] = std::max(p.rates[p.at], bytes > 0.0 ? bytes / seconds : 1.0 / seconds);
+            if(p.taken < samples)
+                return;
+
+            const double best = *std::max_element(p.rates.begin(), p.rates.begin() + p.at + 1);
+            if(p.at + 1 < p.counts.size() && p.rates[p.at] >= (1.0 - tolerance) * best)
+            {
+                ++p.at;
+                p.taken = -1;
+                setParallelWorkers(p.counts[p.at]);
+                return;
+            }
+            // the fewest workers of those measured within tolerance of the best
+            p.settled = true;
+            for(size_t k = 0; k <= p.at; ++k)
+                if(p.rates[k] >= (1.0 - tolerance) * best)
+                    p.chosen = p.counts[k];
+            setParallelWorkers(p.chosen);
+        }
+
+        /* the workers the loops now run on */
+        unsigned workers() const { return parallelWorkers(); }
+
+        /* whether the current phase is still being tuned */
+        bool tuning() const { return on && current >= 0 && !phases[current].settled; }
+
+        /* the workers phase name settled on, or 0 if it has not (yet) */
+        unsigned settled(const char* name) const
+        {
+            for(const Phase& p : phases)
+                if(p.name == name && p.settled)
+                    return p.chosen;
+            return 0;
+        }
+
+    private:
+        struct Phase
+        {
+            std::string name;
+            std::vector<unsigned> counts;   // tried in order, all the workers first
+            std::vector<double> rates;      // the best throughput of each count measured
+            size_t at = 0;                  // the count being measured
+            int taken = -1;                 // its iterations measured, -1 before the one not measured
+            bool settled = false;
+            unsigned chosen = 0;
+        };
+
+        bool on;
+        double tolerance;
+        int samples;
+        std::vector<Phase> phases;
+        int current;
+    };
+}
+
+#endif // __MANSEG_THROTTLE_H__
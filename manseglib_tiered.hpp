@@ -0,0 +1,173 @@
+/*
+	Placement of the heads and the tails of mantissa segmented arrays on different memory tiers.
+	Author: harunadess
+
+	For most of a run only the heads are read and written, so they want the fastest memory and the
+	tails can sit on a slower one. TieredSegmentAllocator places the heads plane (and any full doubles)
+	on a fast NUMA node, such as HBM or local DRAM, and the tails plane on a capacity node, such as a CXL
+	expander, PMEM exposed as system memory, or a remote socket. All of these appear to the kernel as
+	NUMA nodes; `numactl -H` lists them. The nodes are preferred, not bound, so a full node spills to
+	the others rather than failing the run. The tails can be moved to the heads' node at the precision
+	switch, if there is room for them there:
+		TieredSegmentAllocator tiers = TieredSegmentAllocator::fromEnvironment();  // $MANSEG_HEADS_NODE, $MANSEG_TAILS_NODE
+		BasicManSegArray<TieredSegmentAllocator> x(n, tiers);
+		...                                             // at the heads: the tails are not touched
+		if(tiers.migrate)                               // $MANSEG_TAILS_MIGRATE
+			moveTails(x.heads, n);                      // then on to pairs
+	A node of -1 leaves that plane where the kernel would put it (on the node of the thread that first
+	touches it). Storage is anonymous mappings, as with LazySegmentAllocator, so the tails take no
+	memory at all until they are written. Linux only (mbind); it calls the system call directly, so it
+	needs neither libnuma nor its headers.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_TIERED_H__
+#define __MANSEG_TIERED_H__
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+#include "manseglib.hpp"
+
+namespace ManSeg
+{
+    /* from <numaif.h> */
+    static const int tierPreferred = 1;         // MPOL_PREFERRED
+    static const unsigned tierMove = 1 << 1;    // MPOL_MF_MOVE
+    static const unsigned long tierAddress = 1 << 1, tierNode = 1 << 0;    // MPOL_F_ADDR, MPOL_F_NODE
+
+    /*
+        Prefers node for the pages of [p, p + bytes), moving those already in memory if move is set
+        (pages in use by other processes stay). False, with errno set, if the kernel refused, e.g. for a
+        node that does not exist; a node of -1 changes nothing.
+    */
+    inline bool preferNode(void* p, const size_t& bytes, const int& node, const bool& move = false)
+    {
+        if(node < 0 || bytes == 0) return true;
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        const uintptr_t start = reinterpret_cast<uintptr_t>(p) / page * page;
+        const size_t span = reinterpret_cast<uintptr_t>(p) + bytes - start;
+        const size_t bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask(node / bits + 1, 0);
+        mask[node / bits] = 1UL << (node % bits);
+        return syscall(SYS_mbind, start, span, tierPreferred, mask.data(), mask.size() * bits + 1, move ? tierMove : 0) == 0;
+    }
+
+    /* the node holding the page of p, or -1 if it is not in memory or the kernel cannot say */
+    inline int nodeOf(const void* p)
+    {
+        int node = -1;
+        if(syscall(SYS_get_mempolicy, &node, nullptr, 0, p, tierAddress | tierNode) != 0)
+            return -1;
+        return node;
+    }
+
+    /* a NUMA node from the environment variable name, or -1 if it is unset */
+    inline int nodeFromEnvironment(const char* name)
+    {
+        const char* node = getenv(name);
+        return (node != nullptr && *node != '\0') ? atoi(node) : -1;
+    }
+
+    /*
+        Storage policy placing the heads (and anything else it allocates, such as the full doubles) on
+        headsNode and, through placeTails, the tails on tailsNode. Placement is advice: where the kernel
+        refuses it, a warning is printed and the array is used where it lands.
+    */
+    struct TieredSegmentAllocator
+    {
+        int headsNode;
+        int tailsNode;
+        bool migrate;       // whether the driver should move the tails to headsNode at the switch
+
+        TieredSegmentAllocator(const int& headsNode = -1, const int& tailsNode = -1, const bool& migrate = false)
+            :headsNode(headsNode), tailsNode(tailsNode), migrate(migrate)
+        {}
+
+        /* $MANSEG_HEADS_NODE, $MANSEG_TAILS_NODE and $MANSEG_TAILS_MIGRATE (non-zero to migrate) */
+        static TieredSegmentAllocator fromEnvironment()
+        {
+            const char* migrate = getenv("MANSEG_TAILS_MIGRATE");
+            return TieredSegmentAllocator(nodeFromEnvironment("MANSEG_HEADS_NODE"), nodeFromEnvironment("MANSEG_TAILS_NODE"),
+                migrate != nullptr && atoi(migrate) != 0);
+        }
+
+        template<typename T>
+        T* allocate(const uint_fast64_t& length, const bool& zero)
+        {
+            T* p = LazySegmentAllocator().allocate<T>(length, zero);
+            place(p, length * sizeof(T), headsNode, false);
+            return p;
+        }
+
+        template<typename T>
+        void deallocate(T* ptr, const uint_fast64_t& length) { LazySegmentAllocator().deallocate(ptr, length); }
+
+        /* prefers node for [p, p + bytes), warning (once) if the kernel refuses */
+        static bool place(void* p, const size_t& bytes, const int& node, const bool& move)
+        {
+            if(preferNode(p, bytes, node, move))
+                return true;
+            static bool warned = false;
+            if(!warned)
+                fprintf(stderr, "TieredSegmentAllocator: cannot place segments on node %d: %s\n", node, strerror(errno));
+            warned = true;
+            return false;
+        }
+    };
+
+    /* the tails are allocated untouched, so this only sets where their pages will come from */
+    inline void placeTails(TieredSegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        if(allocator.tailsNode != allocator.headsNode)
+            TieredSegmentAllocator::place(tails, length * sizeof(float), allocator.tailsNode, false);
+    }
+
+    /* the tails are anonymous mappings, as for LazySegmentAllocator, so their pages can be given back */
+    inline void releaseTails(TieredSegmentAllocator& allocator, float* tails, const uint_fast64_t& length)
+    {
+        discardPages(tails, length * sizeof(float));
+    }
+
+    /*
+        Moves the tails of the n values of a to the heads' node, for the iterations at full precision,
+        along with any pages to come. False if the kernel could not move them (e.g. the node is full).
+    */
+    template<bool useTail>
+    bool moveTails(TwoSegArray<useTail, TieredSegmentAllocator>& a, const uint_fast64_t& n)
+    {
+        const TieredSegmentAllocator& tiers = a.getAllocator();
+        if(tiers.tailsNode == tiers.headsNode || tiers.headsNode < 0)
+            return true;
+        return TieredSegmentAllocator::place(a.getTails(), n * sizeof(float), tiers.headsNode, true);
+    }
+
+    typedef BasicManSegArray<TieredSegmentAllocator> TieredManSegArray;
+}
+
+#endif
@@ -0,0 +1,279 @@
+/*
+	Sockets, cores and SMT threads of the machine, and where the library's workers are bound on them.
+	Author: harunadess
+
+	Ligra's partitioner puts partition k of p on NUMA node k / (p / nodes), and allocates (first
+	touches) its vertices there; a loop over the partitions only reads local memory if the worker of
+	partition k runs on that node too. A ThreadTopology is the CPUs the process may run on, each with
+	its node, socket, core and SMT thread, from Linux's sysfs (one node, and a core per CPU, where
+	it is not there; binding is Linux only), and the placement the library's workers follow:
+		ThreadTopology& topo = ThreadTopology::instance();
+		topo.nodeOfPartition(k, parts);     // the node of Ligra's partition k
+		topo.cpuOfWorker(w, workers);       // the CPU worker w of workers is bound to
+		topo.bind(w, workers);              // binds the calling thread there
+	Workers are placed the way partitions are: worker w of workers is on the node of partition w of
+	workers, so when workers and partitions divide evenly between the nodes the worker that owns a
+	partition (p * workers / parts, as parallelForPartitions seeds them) is on the partition's node.
+	Within a node the workers take a thread of every core before the second thread of any core, as
+	SMT siblings share a core's caches and bandwidth. The thread pool pins its threads this way
+	(unless MANSEG_PIN_THREADS=0); OpenMP threads are bound by bindOpenMP, or by the library's own
+	regions with MANSEG_BIND=1, which then overrides OMP_PROC_BIND and also runs each part of
+	parallelForPartitions on the thread of its node. The node numbers are the system's.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_TOPOLOGY_H__
+#define __MANSEG_TOPOLOGY_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace ManSeg
+{
+    /* a CPU the process may run on */
+    struct TopologyCpu
+    {
+        int cpu;        // as the system numbers it
+        int node;       // NUMA node
+        int socket;     // physical package
+        int core;       // within the socket
+        int thread;     // SMT thread within the core, 0 for the first
+    };
+
+    class ThreadTopology
+    {
+    public:
+        /* the topology of the CPUs the process could run on when it was first asked for */
+        static ThreadTopology& instance()
+        {
+            static ThreadTopology topology(discover());
+            return topology;
+        }
+
+        /* of the given CPUs (e.g. of another machine), whose thread fields are filled in here */
+        explicit ThreadTopology(std::vector<TopologyCpu> list)
+            :all(list)
+        {
+            std::sort(all.begin(), all.end(), [](const TopologyCpu& a, const TopologyCpu& b) { return a.cpu < b.cpu; });
+            std::vector<std::pair<int, int>> seen;
+            for(TopologyCpu& c : all)
+            {
+                c.thread = static_cast<int>(std::count(seen.begin(), seen.end(), std::make_pair(c.socket, c.core)));
+                seen.push_back(std::make_pair(c.socket, c.core));
+                if(std::find(nodeIds.begin(), nodeIds.end(), c.node) == nodeIds.end())
+                    nodeIds.push_back(c.node);
+                if(std::find(socketIds.begin(), socketIds.end(), c.socket) == socketIds.end())
+                    socketIds.push_back(c.socket);
+                smt = std::max(smt, c.thread + 1);
+            }
+            std::sort(nodeIds.begin(), nodeIds.end());
+            std::sort(socketIds.begin(), socketIds.end());
+            std::sort(seen.begin(), seen.end());
+            coreCount = static_cast<unsigned>(std::unique(seen.begin(), seen.end()) - seen.begin());
+
+            // each node's CPUs in the order workers take them: the first thread of every core, then the second...
+            order.resize(nodeIds.size());
+            for(const TopologyCpu& c : all)
+                order[nodeIndex(c.node)].push_back(c);
+            for(std::vector<TopologyCpu>& o : order)
+                std::stable_sort(o.begin(), o.end(), [](const TopologyCpu& a, const TopologyCpu& b)
+                {
+                    return a.thread != b.thread ? a.thread < b.thread : (a.socket != b.socket ? a.socket < b.socket : a.core < b.core);
+                });
+        }
+
+        unsigned cpus() const { return static_cast<unsigned>(all.size()); }
+        unsigned nodes() const { return static_cast<unsigned>(nodeIds.size()); }
+        unsigned sockets() const { return static_cast<unsigned>(socketIds.size()); }
+        unsigned cores() const { return coreCount; }
+        unsigned threadsPerCore() const { return static_cast<unsigned>(smt); }
+
+        /* CPU i, in the system's order */
+        const TopologyCpu& cpu(const unsigned& i) const { return all[i]; }
+
+        /* the system number of the n-th node (from 0) */
+        int nodeId(const unsigned& n) const { return nodeIds[n]; }
+
+        /* the CPUs of node id, in the order workers are bound to them */
+        std::vector<int> cpusOfNode(const int& id) const
+        {
+            std::vector<int> list;
+            const unsigned n = nodeIndex(id);
+            if(n < nodeIds.size() && nodeIds[n] == id)
+                for(const TopologyCpu& c : order[n])
+                    list.push_back(c.cpu);
+            return list;
+        }
+
+        /* the node of partition k of parts, as Ligra's partitioner allocates it */
+        int nodeOfPartition(const uint_fast64_t& k, const uint_fast64_t& parts) const
+        {
+            return nodeIds.empty() ? 0 : nodeIds[blockOf(k, parts)];
+        }
+
+        /* the node worker w of workers runs on */
+        int nodeOfWorker(const unsigned& w, const unsigned& workers) const { return nodeOfPartition(w, workers); }
+
+        /* the CPU worker w of workers is bound to, -1 if there are none */
+        int cpuOfWorker(const unsigned& w, const unsigned& workers) const
+        {
+            if(all.empty())
+                return -1;
+            const unsigned n = blockOf(w, workers);
+            const unsigned perNode = std::max(1u, workers / nodes());
+            const std::vector<TopologyCpu>& o = order[n];
+            return o[(w - n * perNode) % o.size()].cpu;
+        }
+
+        /* binds the calling thread to the CPU of worker w of workers; false if it could not be */
+        bool bind(const unsigned& w, const unsigned& workers) const
+        {
+            const int c = cpuOfWorker(w, workers);
+#if defined(__linux__)
+            if(c < 0 || c >= CPU_SETSIZE)
+                return false;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(c, &set);
+            return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+            (void)c;
+            return false;
+#endif
+        }
+
+#if defined(_OPENMP)
+        /*
+            Binds each thread of the calling thread's OpenMP team, of omp_get_max_threads threads,
+            to the CPU of its worker. GNU and LLVM OpenMP keep a thread's number from one region to
+            the next, so the binding holds until the team grows or shrinks; bind again then.
+        */
+        void bindOpenMP() const
+        {
+            #pragma omp parallel
+            bind(static_cast<unsigned>(omp_get_thread_num()), static_cast<unsigned>(omp_get_num_threads()));
+        }
+#endif
+
+    private:
+        std::vector<TopologyCpu> all;
+        std::vector<int> nodeIds, socketIds;
+        std::vector<std::vector<TopologyCpu>> order;
+        unsigned coreCount = 0;
+        int smt = 1;
+
+        unsigned nodeIndex(const int& id) const
+        {
+            return static_cast<unsigned>(std::lower_bound(nodeIds.begin(), nodeIds.end(), id) - nodeIds.begin());
+        }
+
+        /* Ligra's k / (parts / nodes), the last node taking what is left over */
+        unsigned blockOf(const uint_fast64_t& k, const uint_fast64_t& parts) const
+        {
+            if(nodeIds.size() <= 1)
+                return 0;
+            const uint_fast64_t perNode = std::max<uint_fast64_t>(1, parts / nodeIds.size());
+            return static_cast<unsigned>(std::min<uint_fast64_t>(k / perNode, nodeIds.size() - 1));
+        }
+
+        /* an integer from a sysfs file, or fallback */
+        static int readInt(const std::string& path, const int& fallback)
+        {
+            FILE* f = fopen(path.c_str(), "r");
+            if(f == nullptr)
+                return fallback;
+            int v = fallback;
+            if(fscanf(f, "%d", &v) != 1)
+                v = fallback;
+            fclose(f);
+            return v;
+        }
+
+        /* the CPUs of a list such as "0-3,8-11" */
+        static std::vector<int> readCpuList(const std::string& path)
+        {
+            std::vector<int> list;
+            FILE* f = fopen(path.c_str(), "r");
+            if(f == nullptr)
+                return list;
+            int first, last;
+            while(fscanf(f, "%d", &first) == 1)
+            {
+                last = first;
+                int c = fgetc(f);
+                if(c == '-')
+                {
+                    if(fscanf(f, "%d", &last) != 1)
+                        break;
+                    c = fgetc(f);
+                }
+                for(int k = first; k <= last; ++k)
+                    list.push_back(k);
+                if(c != ',')
+                    break;
+            }
+            fclose(f);
+            return list;
+        }
+
+        static std::vector<TopologyCpu> discover()
+        {
+            std::vector<TopologyCpu> list;
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(sched_getaffinity(0, sizeof(set), &set) != 0)
+                return list;
+            std::vector<int> nodeOf(CPU_SETSIZE, 0);
+            for(const int& n : readCpuList("/sys/devices/system/node/possible"))
+                for(const int& c : readCpuList("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist"))
+                    if(c >= 0 && c < CPU_SETSIZE)
+                        nodeOf[c] = n;
+            for(int c = 0; c < CPU_SETSIZE; ++c)
+            {
+                if(!CPU_ISSET(c, &set))
+                    continue;
+                const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+                list.push_back(TopologyCpu{ c, nodeOf[c], readInt(dir + "physical_package_id", 0), readInt(dir + "core_id", c), 0 });
+            }
+#endif
+            // without affinity: one node, of as many single thread cores as the standard library knows of
+            if(list.empty())
+                for(unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c)
+                    list.push_back(TopologyCpu{ static_cast<int>(c), 0, 0, static_cast<int>(c), 0 });
+            return list;
+        }
+    };
+}
+
+#endif // __MANSEG_TOPOLOGY_H__
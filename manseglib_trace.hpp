@@ -0,0 +1,230 @@
+/*
+	Timeline tracing for mantissa segmented solvers, written as Chrome trace JSON (chrome://tracing,
+	ui.perfetto.dev).
+	Author: harunadess
+
+	Each thread records into its own buffer, so spans from inside parallel loops are cheap and show up
+	on the thread that ran them. Built with MANSEG_TRACE=1, the library records its allocations,
+	promotions and the PrecisionController's level changes; drivers add their own spans:
+		for(...) {
+			MANSEG_TRACE_SCOPE_ARG("iteration", "iter", iter);
+			{ MANSEG_TRACE_SCOPE("edgeMap"); ... }
+			{ MANSEG_TRACE_SCOPE("reduction"); ... }
+		}
+		MANSEG_TRACE_WRITE("pagerank.trace.json");
+	Names and argument keys must be string literals (only the pointer is stored).
+	Without MANSEG_TRACE (the default) every macro expands to nothing and the arguments are not
+	evaluated.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_TRACE_H__
+#define __MANSEG_TRACE_H__
+
+#ifndef MANSEG_TRACE
+#define MANSEG_TRACE 0
+#endif
+
+#if MANSEG_TRACE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace ManSeg
+{
+    namespace Trace
+    {
+        /* a span ('X', dur set) or an instant ('i'); argName is null if there is no argument */
+        struct Event
+        {
+            const char* name;
+            char phase;
+            int64_t start;      // ns since the recorder was created
+            int64_t dur;
+            const char* argName;
+            double arg;
+        };
+
+        struct ThreadBuffer
+        {
+            int tid;
+            std::vector<Event> events;
+        };
+
+        /*
+            Owns the buffers of every thread that has recorded an event.
+            Threads only take the lock the first time they record.
+        */
+        class Recorder
+        {
+        public:
+            static Recorder& get()
+            {
+                static Recorder recorder;
+                return recorder;
+            }
+
+            ~Recorder()
+            {
+                for(size_t i = 0; i < buffers.size(); ++i)
+                    delete buffers[i];
+            }
+
+            int64_t now() const
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+            }
+
+            ThreadBuffer& local()
+            {
+                static thread_local ThreadBuffer* buffer = nullptr;
+                if(buffer == nullptr)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    buffer = new ThreadBuffer();
+                    buffer->tid = (int)buffers.size();
+                    buffers.push_back(buffer);
+                }
+                return *buffer;
+            }
+
+            void record(const char* name, const char& phase, const int64_t& start, const int64_t& dur, const char* argName, const double& arg)
+            {
+                Event e = { name, phase, start, dur, argName, arg };
+                local().events.push_back(e);
+            }
+
+            /*
+                Writes every event recorded so far to path, returning false if it cannot be opened.
+                Call it while no other thread is recording.
+            */
+            bool write(const char* path)
+            {
+                FILE* f = fopen(path, "w");
+                if(f == nullptr) return false;
+
+                std::lock_guard<std::mutex> lock(mutex);
+                fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+                bool first = true;
+                for(size_t t = 0; t < buffers.size(); ++t)
+                {
+                    fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                        first ? "" : ",\n", buffers[t]->tid, buffers[t]->tid);
+                    first = false;
+                    const std::vector<Event>& events = buffers[t]->events;
+                    for(size_t i = 0; i < events.size(); ++i)
+                        writeEvent(f, events[i], buffers[t]->tid);
+                }
+                fprintf(f, "\n]}\n");
+                fclose(f);
+                return true;
+            }
+
+            /* forgets the recorded events, e.g. between rounds */
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for(size_t i = 0; i < buffers.size(); ++i)
+                    buffers[i]->events.clear();
+            }
+
+        private:
+            std::chrono::steady_clock::time_point origin;
+            std::mutex mutex;
+            std::vector<ThreadBuffer*> buffers;
+
+            Recorder()
+                :origin(std::chrono::steady_clock::now())
+            {}
+            Recorder(const Recorder&);
+            Recorder& operator=(const Recorder&);
+
+            static void writeEvent(FILE* f, const Event& e, const int& tid)
+            {
+                // timestamps are in microseconds
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", e.name, e.phase, e.start*1e-3, tid);
+                if(e.phase == 'X')
+                    fprintf(f, ",\"dur\":%.3f", e.dur*1e-3);
+                else
+                    fprintf(f, ",\"s\":\"t\"");
+                if(e.argName != nullptr)
+                    fprintf(f, ",\"args\":{\"%s\":%.17g}", e.argName, e.arg);
+                fprintf(f, "}");
+            }
+        };
+
+        /* records the enclosing scope as a span */
+        class Scope
+        {
+        public:
+            Scope(const char* name, const char* argName = nullptr, const double& arg = 0)
+                :name(name), argName(argName), arg(arg), start(Recorder::get().now())
+            {}
+
+            ~Scope()
+            {
+                Recorder& r = Recorder::get();
+                r.record(name, 'X', start, r.now() - start, argName, arg);
+            }
+
+        private:
+            const char* name;
+            const char* argName;
+            double arg;
+            int64_t start;
+
+            Scope(const Scope&);
+            Scope& operator=(const Scope&);
+        };
+
+        inline void instant(const char* name, const char* argName = nullptr, const double& arg = 0)
+        {
+            Recorder& r = Recorder::get();
+            r.record(name, 'i', r.now(), 0, argName, arg);
+        }
+    }
+}
+
+#define MANSEG_TRACE_CONCAT_(a, b) a##b
+#define MANSEG_TRACE_CONCAT(a, b) MANSEG_TRACE_CONCAT_(a, b)
+#define MANSEG_TRACE_SCOPE(name) ManSeg::Trace::Scope MANSEG_TRACE_CONCAT(mansegTraceScope, __LINE__)(name)
+#define MANSEG_TRACE_SCOPE_ARG(name, key, value) ManSeg::Trace::Scope MANSEG_TRACE_CONCAT(mansegTraceScope, __LINE__)(name, key, (double)(value))
+#define MANSEG_TRACE_INSTANT(name) ManSeg::Trace::instant(name)
+#define MANSEG_TRACE_INSTANT_ARG(name, key, value) ManSeg::Trace::instant(name, key, (double)(value))
+#define MANSEG_TRACE_WRITE(path) ManSeg::Trace::Recorder::get().write(path)
+#define MANSEG_TRACE_CLEAR() ManSeg::Trace::Recorder::get().clear()
+
+#else
+
+#define MANSEG_TRACE_SCOPE(name)
+#define MANSEG_TRACE_SCOPE_ARG(name, key, value)
+#define MANSEG_TRACE_INSTANT(name) ((void)0)
+#define MANSEG_TRACE_INSTANT_ARG(name, key, value) ((void)0)
+#define MANSEG_TRACE_WRITE(path) ((void)0)
+#define MANSEG_TRACE_CLEAR() ((void)0)
+
+#endif // MANSEG_TRACE
+
+#endif // __MANSEG_TRACE_H__
@@ -0,0 +1,210 @@
+/*
+	Software byte traffic accounting for mantissa segmented arrays.
+	Author: harunadess
+
+	Counts the logical bytes a run reads and writes at each precision level, and the elements it
+	promotes, so that the heads-vs-pairs trade-off can be measured where hardware counters (PAPI,
+	perf) are not available, e.g. in containers and VMs. Built with MANSEG_TRAFFIC=1, the library
+	counts:
+		- the bulk kernels (widenHeads, combineSegments, narrowToHeads, splitSegments, streamSegments,
+		  the gathers and scatter-adds), and so every readBlock and writeBlock;
+		- element access through the Head and Pair proxies (operator[], read, set) of the arrays and
+		  spans, FullView's read, set and blocks, and DualWriteView's stores;
+		- the elements promoted by ManSegArray (copytoIEEEdouble, promote, promoteInPlace) and
+		  BlockAdaptiveArray::promote.
+	Bytes are those of the values as stored at that level: 4 a head, 8 a pair or full double. A
+	read-modify-write (a[i] += x) counts a read and a write. References into full (FullView's
+	operator[], or the full pointer itself) are not counted, nor are caches: this is what the code
+	asks for, not what reaches memory.
+
+	Each thread counts into its own cache line, so counting from parallel loops does not share lines
+	between cores; totals() adds them up:
+		Traffic::Totals before = Traffic::totals();
+		... an iteration ...
+		Traffic::Totals it = Traffic::totals() - before;
+		results.iteration(iter, delta, seconds, level, it.bytes());
+	Without MANSEG_TRAFFIC (the default) MANSEG_TRAFFIC_ADD expands to nothing and its arguments are
+	not evaluated, and totals() is zero; Traffic::enabled tells a driver which it has.
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_TRAFFIC_H__
+#define __MANSEG_TRAFFIC_H__
+
+#ifndef MANSEG_TRAFFIC
+#define MANSEG_TRAFFIC 0
+#endif
+
+#include <stdint.h>
+
+#if MANSEG_TRAFFIC
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace ManSeg
+{
+    namespace Traffic
+    {
+        /* bytes read and written at each level, and elements promoted */
+        enum Counter { HEADS_READ, HEADS_WRITTEN, PAIRS_READ, PAIRS_WRITTEN, FULL_READ, FULL_WRITTEN, PROMOTED, NUM_COUNTERS };
+
+        /* name of a counter, e.g. as a results key */
+        inline const char* counterName(const Counter& c)
+        {
+            static const char* names[NUM_COUNTERS] = {
+                "heads_read_bytes", "heads_written_bytes", "pairs_read_bytes", "pairs_written_bytes",
+                "full_read_bytes", "full_written_bytes", "promoted_elements"
+            };
+            return names[c];
+        }
+
+        constexpr bool enabled = MANSEG_TRAFFIC != 0;
+
+        /* the counters of every thread, added up; subtract two to get the traffic between them */
+        struct Totals
+        {
+            uint64_t count[NUM_COUNTERS];
+
+            Totals() { for(int c = 0; c < NUM_COUNTERS; ++c) count[c] = 0; }
+
+            uint64_t operator[](const Counter& c) const { return count[c]; }
+
+            uint64_t bytesRead() const { return count[HEADS_READ] + count[PAIRS_READ] + count[FULL_READ]; }
+            uint64_t bytesWritten() const { return count[HEADS_WRITTEN] + count[PAIRS_WRITTEN] + count[FULL_WRITTEN]; }
+            uint64_t bytes() const { return bytesRead() + bytesWritten(); }
+
+            Totals operator-(const Totals& other) const
+            {
+                Totals t;
+                for(int c = 0; c < NUM_COUNTERS; ++c)
+                    t.count[c] = count[c] - other.count[c];
+                return t;
+            }
+        };
+
+#if MANSEG_TRAFFIC
+        /* one thread's counters, a cache line of their own; only their thread writes them */
+        struct alignas(64) ThreadCounters
+        {
+            std::atomic<uint64_t> count[NUM_COUNTERS];
+
+            ThreadCounters() { for(int c = 0; c < NUM_COUNTERS; ++c) count[c].store(0, std::memory_order_relaxed); }
+        };
+
+        /*
+            Keeps track of the counters of the threads running, and the totals of those that have exited.
+            Threads only take the lock when they first count and when they exit.
+        */
+        class Registry
+        {
+        public:
+            static Registry& get()
+            {
+                static Registry registry;
+                return registry;
+            }
+
+            ThreadCounters& local()
+            {
+                static thread_local Slot slot;
+                return slot.counters;
+            }
+
+            /* the counts of every thread; exact once the threads counting have synchronised with this one */
+            Totals totals()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Totals t = retired;
+                for(size_t i = 0; i < threads.size(); ++i)
+                    for(int c = 0; c < NUM_COUNTERS; ++c)
+                        t.count[c] += threads[i]->count[c].load(std::memory_order_relaxed);
+                return t;
+            }
+
+            /* zeroes every counter, e.g. between rounds; call it while no other thread is counting */
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                retired = Totals();
+                for(size_t i = 0; i < threads.size(); ++i)
+                    for(int c = 0; c < NUM_COUNTERS; ++c)
+                        threads[i]->count[c].store(0, std::memory_order_relaxed);
+            }
+
+        private:
+            std::mutex mutex;
+            std::vector<ThreadCounters*> threads;
+            Totals retired;
+
+            /* a thread's counters, registered on its first count and folded into retired when it exits */
+            struct Slot
+            {
+                ThreadCounters counters;
+
+                Slot()
+                {
+                    Registry& r = get();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.threads.push_back(&counters);
+                }
+
+                ~Slot()
+                {
+                    Registry& r = get();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    for(int c = 0; c < NUM_COUNTERS; ++c)
+                        r.retired.count[c] += counters.count[c].load(std::memory_order_relaxed);
+                    r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &counters));
+                }
+            };
+
+            Registry() {}
+            Registry(const Registry&);
+            Registry& operator=(const Registry&);
+        };
+
+        /* adds n to this thread's counter c; a plain load and store, as no other thread writes it */
+        inline void add(const Counter& c, const uint64_t& n)
+        {
+            std::atomic<uint64_t>& v = Registry::get().local().count[c];
+            v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        inline Totals totals() { return Registry::get().totals(); }
+        inline void clear() { Registry::get().clear(); }
+#else
+        inline Totals totals() { return Totals(); }
+        inline void clear() {}
+#endif
+    }
+}
+
+#if MANSEG_TRAFFIC
+#define MANSEG_TRAFFIC_ADD(counter, n) ManSeg::Traffic::add(ManSeg::Traffic::counter, (uint64_t)(n))
+#else
+#define MANSEG_TRAFFIC_ADD(counter, n) ((void)0)
+#endif
+
+#endif // __MANSEG_TRAFFIC_H__
@@ -0,0 +1,187 @@
+/*
+	Streaming writers of segment planes, for loaders that parse values one at a time.
+	Author: harunadess
+
+	A loader that parses doubles into a buffer and then copies it into a TwoSegArray (or saves it
+	as a segments file) holds the values twice: the doubles, and the planes made from them. A
+	SegmentWriter takes the values as they are parsed instead, in order, and splits them into the
+	heads and tails planes a chunk at a time, so the only buffer is of a chunk (SegmentWriterChunk
+	values):
+		PairsArray a(n);
+		SegmentWriter w(a);                         // or (heads, tails, count) for any pair of planes
+		while(parse(p, v)) w.push(v);
+		if(!w.close()) ...;                         // false unless all n values were pushed
+	The planes can also be in a file: a new segments file (see manseglib_results.hpp), which then
+	never exists as doubles in memory at all, or two planes at offsets of a file of some other layout
+	(e.g. a cache), through a descriptor the caller keeps:
+		SegmentWriter w("weights.seg", m);          // mapSegments or loadSegments reads it back
+		SegmentWriter part(fd, headsAt + start * 4, tailsAt + start * 4, count);
+	Writers of disjoint stretches of the same planes can run on threads of their own; one writer is
+	not thread safe. A value pushed past count, or a write that fails, makes close return false.
+	POSIX only for the files (pwrite).
+
+	Copyright (c) 2020 harunadess
+
+	Permission is hereby granted, free of charge, to any person obtaining a copy
+	of this software and associated documentation files (the "Software"), to deal
+	in the Software without restriction, including without limitation the rights
+	to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+	copies of the Software, and to permit persons to whom the Software is
+	furnished to do so, subject to the following conditions:
+
+	The above copyright notice and this permission notice shall be included in all
+	copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+	IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+	FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+	AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+	LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+	OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+	SOFTWARE.
+*/
+
+#ifndef __MANSEG_WRITER_H__
+#define __MANSEG_WRITER_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <vector>
+
+#include "manseglib.hpp"
+#include "manseglib_results.hpp"
+
+namespace ManSeg
+{
+    /* values split at a time: 128 KB of doubles, and half that of each plane for a file */
+    constexpr uint_fast64_t SegmentWriterChunk = 1 << 14;
+
+    class SegmentWriter
+    {
+    public:
+        /* into the planes heads and tails, of count values */
+        SegmentWriter(float* heads, float* tails, const uint_fast64_t& count)
+            :heads(heads), tails(tails), fd(-1), ownsFd(false), headsAt(0), tailsAt(0), count(count), written(0), failed(false), closed(false)
+        {
+            buffer.reserve(std::min(count, SegmentWriterChunk));
+        }
+
+        /* into the planes of a (pairs or heads) array, from its first value */
+        template<bool useTail, class Allocator>
+        explicit SegmentWriter(TwoSegArray<useTail, Allocator>& a)
+            :SegmentWriter(a.getHeads(), a.getTails(), a.size())
+        {}
+
+        /* into a new segments file of count values at path; close fails if it could not be created */
+        SegmentWriter(const char* path, const uint_fast64_t& count)
+            :heads(nullptr), tails(nullptr), fd(-1), ownsFd(true), headsAt(segmentsHeadsOffset()), tailsAt(segmentsTailsOffset(count)),
+            count(count), written(0), failed(false), closed(false)
+        {
+            if(path != nullptr && *path != '\0')
+                fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+            const uint64_t header = count;
+            // the padding between the header and the planes is the hole left by the truncation
+            failed = fd < 0 || ftruncate(fd, (off_t)(tailsAt + count * sizeof(float))) != 0
+                || !put(segmentsMagic, sizeof(segmentsMagic), 0) || !put(&header, sizeof(header), sizeof(segmentsMagic));
+            buffer.reserve(std::min(count, SegmentWriterChunk));
+        }
+
+        /* into the planes of count values at byte offsets headsAt and tailsAt of fd, which stays open */
+        SegmentWriter(const int& fd, const uint64_t& headsAt, const uint64_t& tailsAt, const uint_fast64_t& count)
+            :heads(nullptr), tails(nullptr), fd(fd), ownsFd(false), headsAt(headsAt), tailsAt(tailsAt), count(count), written(0),
+            failed(fd < 0), closed(false)
+        {
+            buffer.reserve(std::min(count, SegmentWriterChunk));
+        }
+
+        ~SegmentWriter() { close(); }
+
+        SegmentWriter(const SegmentWriter&) = delete;
+        SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+        /* the next value */
+        void push(const double& v)
+        {
+            buffer.push_back(v);
+            if(buffer.size() == SegmentWriterChunk)
+                flush();
+        }
+
+        /* the next n values */
+        void push(const double* v, const uint_fast64_t& n)
+        {
+            for(uint_fast64_t i = 0; i < n; ++i)
+                push(v[i]);
+        }
+
+        /* the values pushed so far */
+        uint_fast64_t size() const { return written + buffer.size(); }
+
+        /* splits what is left; true if exactly count values were pushed and all of them written */
+        bool close()
+        {
+            if(closed)
+                return !failed && written == count;
+            flush();
+            closed = true;
+            if(ownsFd && fd >= 0 && ::close(fd) != 0)
+                failed = true;
+            return !failed && written == count;
+        }
+
+    private:
+        float* heads;
+        float* tails;
+        int fd;
+        bool ownsFd;
+        uint64_t headsAt, tailsAt;
+        uint_fast64_t count, written;
+        bool failed, closed;
+        std::vector<double> buffer;
+        std::vector<float> headChunk, tailChunk;    // for a file
+
+        bool put(const void* data, const size_t& bytes, const uint64_t& at)
+        {
+            const char* p = static_cast<const char*>(data);
+            size_t done = 0;
+            while(done < bytes)
+            {
+                const ssize_t n = pwrite(fd, p + done, bytes - done, (off_t)(at + done));
+                if(n <= 0)
+                    return false;
+                done += n;
+            }
+            return true;
+        }
+
+        void flush()
+        {
+            const uint_fast64_t n = buffer.size();
+            if(n == 0)
+                return;
+            if(failed || written + n > count)
+            {
+                failed = true;
+                buffer.clear();
+                return;
+            }
+            if(fd < 0)
+                splitSegments(buffer.data(), n, heads + written, tails + written);
+            else
+            {
+                headChunk.resize(n);
+                tailChunk.resize(n);
+                splitSegments(buffer.data(), n, headChunk.data(), tailChunk.data());
+                failed = !put(headChunk.data(), n * sizeof(float), headsAt + written * sizeof(float))
+                    || !put(tailChunk.data(), n * sizeof(float), tailsAt + written * sizeof(float));
+            }
+            buffer.clear();
+            written += n;
+        }
+    };
+}
+
+#endif // __MANSEG_WRITER_H__
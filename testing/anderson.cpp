@@ -0,0 +1,107 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_anderson.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1000;        // several chunks, not a whole number of them
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// a Jacobi sweep of (1 + s) u[i] - (u[i-1] + u[i+1]) / 2 = 1 / length, zero at both ends: a shifted
+// -u'' = 1, so that plain sweeps converge in a few thousand rather than millions
+void sweep(const vector<double>& u, vector<double>& g)
+{
+	const double shift = 0.01;
+	for(int i = 0; i < length; ++i)
+		g[i] = (0.5 * ((i > 0 ? u[i - 1] : 0.0) + (i < length - 1 ? u[i + 1] : 0.0)) + 1.0 / length) / (1.0 + shift);
+}
+
+double maxChange(const vector<double>& u, const vector<double>& g)
+{
+	double d = 0.0;
+	for(int i = 0; i < length; ++i)
+		d = max(d, fabs(g[i] - u[i]));
+	return d;
+}
+
+// sweeps to a change of at most tolerance, accelerated with a window of m (0 for plain sweeps), at most limit
+int solve(int m, uint_fast64_t ranges, double tolerance, int limit, vector<double>& u)
+{
+	u.assign(length, 0.0);
+	vector<double> g(length);
+	AndersonAccelerator<> anderson(length, max(m, 1), ranges);
+	for(int it = 1; it <= limit; ++it)
+	{
+		sweep(u, g);
+		if(maxChange(u, g) <= tolerance)
+			return it;
+		if(m > 0)
+			anderson.step(u.data(), g.data(), u.data());
+		else
+			u.swap(g);
+	}
+	return limit + 1;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	vector<double> reference, u;
+	const int plain = solve(0, 1, 1e-12, 20000, reference);
+	const int accelerated = solve(8, 1, 1e-12, 20000, u);
+	double error = 0.0;
+	for(int i = 0; i < length; ++i)
+		error = max(error, fabs(u[i] - reference[i]));
+	cout << "plain sweeps " << plain << ", accelerated " << accelerated << ", error " << error << "\n";
+	if(accelerated * 5 > plain)
+		return_code |= fail("the acceleration does not cut the sweeps");
+	if(error > 1e-9)
+		return_code |= fail("the accelerated solution is wrong");
+
+	// the same steps in ranges: their sums are added in another order, so the iterates differ in their last bits
+	vector<double> ranged;
+	const int inRanges = solve(8, 7, 1e-12, 20000, ranged);
+	if(abs(inRanges - accelerated) > accelerated / 10)
+		return_code |= fail("the ranges change the iteration");
+
+	// the history is in heads only
+	AndersonAccelerator<> sized(length, 8);
+	if(sized.bytes() != 18 * length * sizeof(float))
+		return_code |= fail("the history is not 2m + 2 heads vectors");
+
+	// the window fills up to m columns, and a restart starts it again from the next step's single column
+	{
+		vector<double> a(length, 0.0), g(length);
+		AndersonAccelerator<> anderson(length, 4);
+		for(int it = 0; it < 6; ++it)
+		{
+			sweep(a, g);
+			anderson.step(a.data(), g.data(), a.data());
+		}
+		if(anderson.depth() != 4)
+			return_code |= fail("the window does not fill");
+		anderson.restart();
+		sweep(a, g);
+		anderson.step(a.data(), g.data(), a.data());
+		if(anderson.depth() != 1)
+			return_code |= fail("a restarted history does not start again from one column");
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
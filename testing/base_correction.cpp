@@ -0,0 +1,144 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_refine.hpp"
+#include "../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// a unit in the last place of the head of d
+double headUlp(const double& d)
+{
+	int e;
+	frexp(d, &e);
+	return ldexp(1.0, e - 21);
+}
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+	const uint64_t B = 24, n = B * B;
+	mt19937_64 rng(3);
+	uniform_real_distribution<double> dist(1.0, 2.0), step(-1e-3, 1e-3);
+
+	vector<double> values(n);
+	for(auto& v : values)
+		v = dist(rng);
+	BaseSnapshot<> base(n + 8);
+	vector<float> correction(n, 1.0f);
+
+	// frozen with a zero correction, the view reads the values exactly
+	base.freeze(8, n, values.data());
+	memset(correction.data(), 0, n * sizeof(float));
+	CorrectedView v = base.view(correction.data(), 8, n);
+	for(uint64_t i = 0; i < n; ++i)
+		if(v[i] != values[i] || v.read(i) != values[i])
+		{
+			cerr << "frozen value " << i << " reads " << v[i] << " for " << values[i] << "\n";
+			return_code = 1;
+			break;
+		}
+
+	// small updates are kept to the precision of the correction, not of the value
+	vector<double> updated(n), read(n);
+	double worst = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+	{
+		updated[i] = values[i] + step(rng);
+		v.set(i, updated[i]);
+		worst = max(worst, fabs(v[i] - updated[i]) / headUlp(updated[i] - values[i]));
+	}
+	if(worst > 1.0)
+	{
+		cerr << "set kept a value to " << worst << " ulps of its correction\n";
+		return_code = 1;
+	}
+
+	// the block functions are the element ones
+	vector<float> blockCorrection(n);
+	CorrectedView w = base.view(blockCorrection.data(), 8, n);
+	w.writeBlock(0, n, updated.data());
+	w.readBlock(0, n, read.data());
+	for(uint64_t i = 0; i < n; ++i)
+		if(memcmp(&blockCorrection[i], &correction[i], sizeof(float)) != 0 || read[i] != v[i])
+		{
+			cerr << "block write of " << updated[i] << " reads " << read[i] << " for " << v[i] << "\n";
+			return_code = 1;
+			break;
+		}
+	CorrectedView tail = v.subspan(n - 3, 3);
+	if(tail.size() != 3 || tail[2] != v[n - 1])
+	{
+		cerr << "subspan reads " << tail[2] << " for " << v[n - 1] << "\n";
+		return_code = 1;
+	}
+
+	// combining and rebasing keep the values, and rebasing zeroes the correction
+	vector<double> combined(n);
+	base.combine(8, n, correction.data(), combined.data());
+	base.rebase(8, n, correction.data());
+	bool kept = true;
+	for(uint64_t i = 0; i < n; ++i)
+		kept = kept && combined[i] == read[i] && correction[i] == 0.0f && v[i] == read[i];
+	if(!kept || base.getBase()[8] != read[0])
+	{
+		cerr << "combine or rebase changed the values\n";
+		return_code = 1;
+	}
+
+	// a sweep of the 5 point stencil on base plus correction, against one on the full values
+	{
+		vector<double> grid(n), next(n), halo(B);
+		for(auto& g : grid)
+			g = dist(rng);
+		for(auto& h : halo)
+			h = dist(rng);
+		BaseSnapshot<> frozen(n);
+		frozen.freeze(0, n, grid.data());
+		vector<float> in(n), out(n);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			grid[i] += step(rng);
+			frozen.view(in.data(), 0, n).set(i, grid[i]);
+			grid[i] = frozen.view(in.data(), 0, n)[i];
+		}
+		double delta = stencil5(FullView(grid.data(), n), FullView(next.data(), n), B, halo.data(), halo.data(),
+			halo.data(), halo.data());
+		double deltaRefine = stencil5(frozen.view(in.data(), 0, n), frozen.view(out.data(), 0, n), B, halo.data(),
+			halo.data(), halo.data(), halo.data());
+		double furthest = 0.0;
+		CorrectedView result = frozen.view(out.data(), 0, n);
+		for(uint64_t i = 0; i < n; ++i)
+			furthest = max(furthest, fabs(result[i] - next[i]));
+		// a sweep moves these values by up to about 1, far more than a late one would, which the corrections keep to a head
+		if(delta != deltaRefine || furthest > headUlp(2.0))
+		{
+			cerr << "refined sweep differs by " << furthest << ", delta " << deltaRefine << " for " << delta << "\n";
+			return_code = 1;
+		}
+	}
+
+	// moved, the base keeps its values and the source is empty
+	BaseSnapshot<> moved(std::move(base));
+	if(base.getBase() != nullptr || base.size() != 0 || moved.size() != n + 8 || moved.getBase()[8] != read[0])
+	{
+		cerr << "moved base lost its values\n";
+		return_code = 1;
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_batch.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr uint_fast64_t length = 1 << 16;
+constexpr int pauseMs = 50; // milliseconds of a load, and of a solve
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// an input that counts how many are alive, and when each was torn down
+atomic<int> alive(0);
+atomic<int> tornDown(0);
+
+struct Input
+{
+	string path;
+	PooledManSegArray values;
+	explicit Input(const string& path) :path(path), values(length) { ++alive; }
+	~Input() { ++tornDown; --alive; }
+};
+
+int main()
+{
+	int return_code = 0;
+	vector<string> solved;
+	int mostAlive = 0;
+	const auto begun = chrono::steady_clock::now();
+
+	BatchRunner<Input> batch([](const string& path)
+	{
+		this_thread::sleep_for(chrono::milliseconds(pauseMs));
+		// a job whose input is missing is skipped
+		return path == "missing" ? unique_ptr<Input>() : unique_ptr<Input>(new Input(path));
+	}, [&](const BatchJob& job, Input& in)
+	{
+		if(job.path != in.path)
+			return_code |= fail("a job is given another job's input");
+		mostAlive = max(mostAlive, alive.load());
+		// the workspace of the solve, from the runner's pool
+		PooledManSegArray x(length);
+		x.pairs.set(0, 1.0);
+		this_thread::sleep_for(chrono::milliseconds(pauseMs));
+		solved.push_back(job.path);
+	}, 0);
+	for(const char* p : { "a", "b", "missing", "c", "d" })
+		batch.add(p);
+
+	if(batch.run() != 4 || solved != vector<string>({ "a", "b", "c", "d" }))
+		return_code |= fail("the jobs are not solved in order, without the one that did not load");
+	if(batch.job(2).loaded || !batch.job(3).loaded || batch.job(2).solveSeconds != 0.0)
+		return_code |= fail("a job that did not load is not marked so");
+	if(alive != 0 || tornDown != 4)
+		return_code |= fail("the inputs are not torn down");
+	if(mostAlive > 3)
+		return_code |= fail("more than the inputs solving, loading and being torn down are in memory");
+
+	// the loads after the first are hidden behind the solves: the first load, four solves, the load
+	// of the job that did not load and a pause to spare, rather than the nine pauses of one by one
+	const double wall = chrono::duration<double>(chrono::steady_clock::now() - begun).count();
+	if(wall > (4 + 1 + 2) * pauseMs * 1e-3 || batch.wallSeconds() > wall)
+	{
+		cerr << "the batch took " << wall << " seconds\n";
+		return_code |= 1;
+	}
+	if(batch.job(0).waitSeconds < pauseMs * 0.5e-3 || batch.job(1).waitSeconds > pauseMs * 0.5e-3)
+		return_code |= fail("the first load is not waited for, or the second is");
+	if(batch.solveSeconds() < 4 * pauseMs * 1e-3)
+		return_code |= fail("the solves are not timed");
+
+	// the solves' workspaces, and the inputs, are reused from the pool
+	if(batch.workspaces().reused() == 0 || batch.workspaces().bytesInUse() != 0)
+		return_code |= fail("the jobs do not reuse the pool's planes");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_blas.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 5003;
+constexpr int rows = 301, cols = 517;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+bool close(const double& a, const double& b, const double& tolerance = 1e-12)
+{
+	return fabs(a - b) <= tolerance * max(1.0, fabs(b));
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+	vector<double> xv(length), yv(length);
+	for(int i = 0; i < length; ++i)
+	{
+		xv[i] = dist(gen);
+		yv[i] = dist(gen);
+	}
+
+	ManSegArray x(length), y(length);
+	x.pairs.writeBlock(0, length, xv.data());
+	y.pairs.writeBlock(0, length, yv.data());
+
+	// level 1, on pairs, heads and doubles mixed
+	double d = 0.0, dh = 0.0, squares = 0.0;
+	for(int i = 0; i < length; ++i)
+	{
+		d += xv[i] * yv[i];
+		dh += xv[i] * static_cast<double>(y.heads[i]);
+		squares += xv[i] * xv[i];
+	}
+	if(!close(blas::dot(length, x.pairs, y.pairs), d) || !close(blas::dot(length, x.pairs, y.heads), dh)
+		|| !close(blas::dot(length, FullView(xv.data(), length), y.pairs), d) || !close(blas::nrm2(length, x.pairs), sqrt(squares)))
+		return_code |= fail("wrong dot or nrm2");
+	// the norm of values whose squares overflow, or underflow, is still found
+	vector<double> huge(length, 1e200), tiny(length, 3e-200);
+	if(!close(blas::nrm2(length, FullView(huge.data(), length)), 1e200 * sqrt(length))
+		|| !close(blas::nrm2(length, FullView(tiny.data(), length)), 3e-200 * sqrt(length)) || blas::nrm2(0, x.pairs) != 0.0)
+		return_code |= fail("wrong scaled nrm2");
+
+	blas::axpy(length, 0.5, x.pairs, y.pairs);
+	for(int i = 0; i < length; ++i)
+		if(y.pairs.read(i) != yv[i] + 0.5 * xv[i])
+		{
+			return_code |= fail("wrong axpy");
+			break;
+		}
+	blas::scal(length, 3.0, x.heads);
+	for(int i = 0; i < length; ++i)
+		if(x.heads.read(i) != headToDouble(headOf(3.0 * headToDouble(headOf(xv[i])))))
+		{
+			return_code |= fail("wrong scal of the heads");
+			break;
+		}
+
+	// level 2: y = alpha A x + beta y and its transpose, with A in heads
+	ManSegArray A(rows * cols), u(cols), v(rows);
+	vector<double> av(rows * cols), uv(cols), vv(rows);
+	for(auto& a : av)
+		a = dist(gen);
+	for(auto& a : uv)
+		a = dist(gen);
+	for(auto& a : vv)
+		a = dist(gen);
+	A.heads.writeBlock(0, rows * cols, av.data());
+	u.pairs.writeBlock(0, cols, uv.data());
+	v.pairs.writeBlock(0, rows, vv.data());
+	blas::gemv(rows, cols, 2.0, A.heads, u.pairs, -1.0, v.pairs);
+	for(int i = 0; i < rows; ++i)
+	{
+		double s = 0.0;
+		for(int j = 0; j < cols; ++j)
+			s += A.heads.read(i * cols + j) * uv[j];
+		if(!close(v.pairs.read(i), 2.0 * s - vv[i]))
+		{
+			return_code |= fail("wrong gemv");
+			break;
+		}
+	}
+	vector<double> out(cols, 7.0);
+	blas::gemv(rows, cols, 1.0, A.heads, FullView(vv.data(), rows), 0.0, FullView(out.data(), cols), true);
+	for(int j = 0; j < cols; ++j)
+	{
+		double s = 0.0;
+		for(int i = 0; i < rows; ++i)
+			s += A.heads.read(i * cols + j) * vv[i];
+		if(!close(out[j], s))
+		{
+			return_code |= fail("wrong transposed gemv");
+			break;
+		}
+	}
+
+	x.del();
+	y.del();
+	A.del();
+	u.del();
+	v.del();
+
+	if(return_code == 0)
+		cout << "blas kernels: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_adaptive.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int numBlocks = 6;
+constexpr int blockSize = 301;
+
+// records which view each block was dispatched with
+struct CountKernel
+{
+	int heads[numBlocks] = {0};
+	int pairs[numBlocks] = {0};
+
+	void operator()(const uint_fast64_t& b, BlockAdaptiveArray<>::HeadsType view) { ++heads[b]; }
+	void operator()(const uint_fast64_t& b, BlockAdaptiveArray<>::PairsType view) { ++pairs[b]; }
+};
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[blockSize];
+	double* out = new double[blockSize];
+	for(int i = 0; i < blockSize; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	BlockAdaptiveArray<> a(numBlocks, blockSize);
+	BlockAdaptiveArray<> b(numBlocks, blockSize);
+
+	// every block starts at heads, so full precision writes are truncated as in HeadsArray
+	HeadsArray h(blockSize);
+	h.writeBlock(0, blockSize, d);
+	for(int blk = 0; blk < numBlocks; ++blk)
+		a.writeBlock(blk, 0, blockSize, d);
+	for(int i = 0; i < blockSize; ++i)
+	{
+		double expected = h[i];
+		if(a.read(0, i) != expected || a.read(5, i) != expected)
+		{
+			cerr << "heads value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << a.read(0, i) << "\n";
+			return_code = 1;
+		}
+	}
+	h.del();
+
+	// promotion keeps the values the heads held, then stores full precision
+	double headValue = a.read(2, 7);
+	if(!a.promote(2) || a.promote(2) || a.precision(2) != BLOCK_PAIRS || a.numPromoted() != 1)
+	{
+		cerr << "promotion of block 2 not recorded\n";
+		return_code = 1;
+	}
+	if(a.read(2, 7) != headValue)
+	{
+		cerr << "promoted value changed: expected = " << headValue << ", actual = " << a.read(2, 7) << "\n";
+		return_code = 1;
+	}
+	a.writeBlock(2, 0, blockSize, d);
+	a.readBlock(2, 0, blockSize, out);
+	for(int i = 0; i < blockSize; ++i)
+	{
+		if(out[i] != d[i])
+		{
+			cerr << "pairs value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	// neighbouring blocks are still at heads
+	if(a.precision(1) != BLOCK_HEADS || a.precision(3) != BLOCK_HEADS || a.read(3, 7) != headValue)
+	{
+		cerr << "neighbouring blocks affected by promotion\n";
+		return_code = 1;
+	}
+
+	// delta based promotion
+	b.copyBlock(2, a);
+	b.promote(2);
+	if(b.maxDelta(2, a) != 0.0 || a.maxDelta(0, b) == 0.0)
+	{
+		cerr << "block delta incorrect\n";
+		return_code = 1;
+	}
+	if(a.promoteIfConverged(4, 1.0) || !a.promoteIfConverged(4, AdaptivePrecisionBound / 2))
+	{
+		cerr << "promoteIfConverged ignored the bound\n";
+		return_code = 1;
+	}
+
+	// dispatch picks the view matching each block's precision
+	CountKernel kernel;
+	a.forEachBlock(kernel);
+	for(int blk = 0; blk < numBlocks; ++blk)
+	{
+		bool promoted = (blk == 2 || blk == 4);
+		if(kernel.heads[blk] != (promoted ? 0 : 1) || kernel.pairs[blk] != (promoted ? 1 : 0))
+		{
+			cerr << "block " << blk << " dispatched to the wrong kernel\n";
+			return_code = 1;
+		}
+	}
+
+	a.del();
+	b.del();
+	delete[] d;
+	delete[] out;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
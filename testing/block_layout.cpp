@@ -0,0 +1,144 @@
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_stencil.hpp"
+#include "../manseglib_layout.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+constexpr int B = 37;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// every read and block access of Array agrees with the planes of a ManSegArray
+template<class Array>
+int compare(Array& x, ManSegArray& reference, const vector<double>& values)
+{
+	int return_code = 0;
+	if(reinterpret_cast<uintptr_t>(x.heads.getSegments()) % 64 != 0)
+		return_code |= fail("the segments are not aligned to a line");
+	for(int i = 0; i < length; ++i)
+	{
+		x.heads.template set<ROUND_NEAREST>(i, values[i]);
+		reference.heads.set<ROUND_NEAREST>(i, values[i]);
+	}
+	for(int i = 0; i < length; ++i)
+		if(x.heads.read(i) != reference.heads.read(i) || x.pairs.read(i) != reference.heads.read(i))
+			return fail("wrong heads set");
+
+	x.pairs.writeBlock(5, length - 5, values.data() + 5);
+	for(int i = 0; i < 5; ++i)
+		x.pairs[i] = values[i];
+	vector<double> out(length);
+	for(int start : { 0, 3, 16, 17 })
+		for(int n : { 1, 15, 16, 33, length - start })
+		{
+			x.pairs.readBlock(start, n, out.data());
+			if(!equal(out.begin(), out.begin() + n, values.begin() + start))
+				return_code |= fail("wrong pairs read");
+			x.heads.readBlock(start, n, out.data());
+			for(int i = 0; i < n; ++i)
+				if(out[i] != headToDouble(headOf(values[start + i])) || out[i] != x.heads[start + i])
+				{
+					return_code |= fail("wrong heads read");
+					break;
+				}
+		}
+
+	// writing heads leaves the tails alone
+	x.heads.template writeBlock<ROUND_TRUNCATE>(7, 20, values.data() + 100);
+	for(int i = 0; i < length; ++i)
+	{
+		float head, tail;
+		splitSegment(values[i], &head, &tail);
+		const double v = (i >= 7 && i < 27) ? segmentsToDouble(headOf(values[100 + i - 7]), tail) : values[i];
+		if(x.pairs.read(i) != v)
+		{
+			return_code |= fail("heads written over the tails");
+			break;
+		}
+	}
+	x.pairs.writeBlock(0, length, values.data());
+
+	x.copytoIEEEdouble();
+	if(!equal(x.full, x.full + length, values.begin()))
+		return_code |= fail("wrong promotion");
+	return return_code;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	vector<double> values(length);
+	for(auto& v : values)
+		v = dist(gen);
+
+	BlockLayout<16> blocks(length);
+	if(blocks.storage() != 2 * 1008 || blocks.head(0) != 0 || blocks.tail(0) != 16 || blocks.head(15) != 15
+		|| blocks.head(16) != 32 || blocks.tail(17) != 49 || blocks.run(17) != 15)
+		return_code |= fail("wrong block offsets");
+
+	ManSegArray reference(length);
+	for(int level = SIMD_SSE2; level <= simdLevel(); ++level)
+	{
+		const SimdLevel widest = simdLevel();
+		setSimdLevel(static_cast<SimdLevel>(level));
+		BlockManSegArray x(length);
+		BasicLayoutManSegArray<PlaneLayout> planes(length);
+		BasicLayoutManSegArray<BlockLayout<8>> small(length);
+		return_code |= compare(x, reference, values);
+		return_code |= compare(planes, reference, values);
+		return_code |= compare(small, reference, values);
+		setSimdLevel(widest);
+	}
+
+	// a kernel templated on its views gives the same sweep on either layout
+	ManSegArray grid(B * B), next(B * B);
+	BlockManSegArray bgrid(B * B), bnext(B * B);
+	for(int i = 0; i < B * B; ++i)
+	{
+		const double v = fabs(dist(gen));
+		grid.pairs.set(i, v);
+		bgrid.pairs.set(i, v);
+	}
+	const double delta = stencil5(grid.read_as<ACCESS_HEADS>(), next.write_as<ACCESS_HEADS>(), B, nullptr, nullptr, nullptr, nullptr);
+	const double bdelta = stencil5(bgrid.read_as<ACCESS_HEADS>(), bnext.write_as<ACCESS_HEADS>(), B, nullptr, nullptr, nullptr, nullptr);
+	const double pdelta = stencil5(grid.read_as<ACCESS_PAIRS>(), next.write_as<ACCESS_PAIRS>(), B, nullptr, nullptr, nullptr, nullptr);
+	const double bpdelta = stencil5(bgrid.read_as<ACCESS_PAIRS>(), bnext.write_as<ACCESS_PAIRS>(), B, nullptr, nullptr, nullptr, nullptr);
+	if(delta != bdelta || pdelta != bpdelta)
+		return_code |= fail("wrong stencil change");
+	for(int i = 0; i < B * B; ++i)
+		if(next.pairs.read(i) != bnext.pairs.read(i))
+		{
+			return_code |= fail("wrong stencil sweep");
+			break;
+		}
+
+	// moved and swapped arrays keep their segments
+	BlockManSegArray moved(std::move(bgrid));
+	if(bgrid.heads.isAlloc() || moved.pairs.read(3) != grid.pairs.read(3))
+		return_code |= fail("wrong move");
+	swap(moved, bnext);
+	if(moved.pairs.read(5) != next.pairs.read(5))
+		return_code |= fail("wrong swap");
+
+	reference.del();
+	grid.del();
+	next.del();
+
+	if(return_code == 0)
+		cout << "block layout: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, so that the scalar remainder of the vectorised kernels is also exercised
+constexpr int length = 1003;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[length];
+	double* out = new double[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	// heads: block write must match element-wise write, block read must match element-wise read
+	HeadsArray h(length);
+	HeadsArray h_ref(length);
+	h.writeBlock(0, length, d);
+	for(int i = 0; i < length; ++i)
+		h_ref[i] = d[i];
+
+	h.readBlock(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		double expected = h_ref[i];
+		if(out[i] != expected || h[i] != expected)
+		{
+			cerr << "heads block value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << out[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// pairs: block round trip must be exact
+	PairsArray p(length);
+	p.writeBlock(0, length, d);
+	p.readBlock(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		if(out[i] != d[i] || p[i] != d[i])
+		{
+			cerr << "pairs block value [" << i << "] mismatch\n";
+			cerr << "expected = " << d[i] << ", actual = " << out[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// sub-range at an unaligned offset
+	ManSegArray m(length);
+	for(int i = 0; i < length; ++i)
+		m.pairs[i] = 0.0;
+	m.pairs.writeBlock(5, 20, d);
+	m.heads.readBlock(5, 20, out);
+	for(int i = 0; i < 20; ++i)
+	{
+		if(out[i] != m.heads[5 + i] || m.pairs[5 + i] != d[i])
+		{
+			cerr << "sub-range value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	if(m.pairs[4] != 0.0 || m.pairs[25] != 0.0)
+	{
+		cerr << "sub-range write modified values outside of range\n";
+		return_code = 1;
+	}
+
+	h.del();
+	h_ref.del();
+	p.del();
+	m.delSegments();
+	delete[] d;
+	delete[] out;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
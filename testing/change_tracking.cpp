@@ -0,0 +1,99 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_stability.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1000;     // not a whole number of mask words
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	ManSegArray x(length);
+	for(int i = 0; i < length; ++i)
+		x.pairs.set(i, 1.0 + i * 0.01);
+
+	ChangeMask changes(length);
+	TrackedHeadsView next(x.heads.getHeads(), x.heads.getTails(), changes);
+
+	// before the first advance everything counts as changed
+	if(!changes.changed(5) || changes.count() != length || !changes.anyChanged(0, 1))
+		return_code |= fail("an untracked element is not changed");
+
+	// an iteration that writes back the same heads except for a few
+	changes.advance();
+	vector<double> in(length);
+	x.heads.readBlock(0, length, in.data());
+	in[3] += 0.5;
+	in[130] += 0.5;
+	next.writeBlock(0, 500, in.data());
+	next.writeBlock(500, length - 500, in.data() + 500);
+	next.set(999, next.read(999));                  // the same bits: not a change
+	next.set(700, next.read(700) * 2.0);
+	atomicAdd(next, 640, 1.0);
+	atomicAdd(next, 641, 1e-30);                    // below the heads' precision: not a change
+
+	// not readable until the iteration ends
+	if(changes.count() != 0)
+		return_code |= fail("the current iteration's marks are visible");
+	changes.advance();
+
+	vector<uint_fast64_t> seen;
+	changes.forEachChanged(0, length, [&seen](const uint_fast64_t& i) { seen.push_back(i); });
+	const vector<uint_fast64_t> expected = {3, 130, 640, 700};
+	if(seen != expected || changes.count() != 4)
+		return_code |= fail("the changed elements are not the ones written");
+	if(fabs(next.read(3) - (1.03 + 0.5)) > 1e-5 || fabs(next.read(640) - (7.4 + 1.0)) > 1e-5)
+		return_code |= fail("a tracked write did not store its head");
+
+	if(!changes.anyChanged(120, 140) || changes.anyChanged(4, 130) || changes.anyChanged(131, 640)
+		|| !changes.anyChanged(0, length) || changes.anyChanged(701, length))
+		return_code |= fail("anyChanged does not match the marks");
+
+	const vector<uint_fast64_t> blocks = changes.changedBlocks(100);
+	if(blocks != vector<uint_fast64_t>({0, 1, 6, 7}))
+		return_code |= fail("the changed blocks are not the ones written");
+
+	bool frontier[length];
+	changes.flags(frontier, 0, length);
+	int flagged = 0;
+	for(int i = 0; i < length; ++i)
+		flagged += frontier[i];
+	if(flagged != 4 || !frontier[130])
+		return_code |= fail("the frontier is not the changed elements");
+
+	// a subspan marks at its offset, and a block write across a word boundary
+	TrackedHeadsView part = next.subspan(60, 10);
+	double two[2] = {100.0, 200.0};
+	part.writeBlock(2, 2, two);
+	changes.advance();
+	if(changes.count() != 2 || !changes.changed(62) || !changes.changed(63) || changes.changed(3))
+		return_code |= fail("a subspan does not mark its own elements");
+
+	// an iteration without writes, then promotion
+	changes.advance();
+	if(changes.count() != 0 || changes.anyChanged(0, length))
+		return_code |= fail("an iteration without writes has changes");
+	changes.stop();
+	if(changes.active() || !changes.changed(0) || changes.count() != length)
+		return_code |= fail("after promotion an element is not changed");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,229 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_controller.hpp"
+#include "../manseglib_checkpoint.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1001;
+
+struct State
+{
+	int iteration;
+	PrecisionController<StagnationPolicy> control;
+};
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	const char* path = "checkpoint_test.ckpt";
+
+	ManSegArray x(length);
+	x.allocFull();
+	for(int i = 0; i < length; ++i)
+	{
+		x.full[i] = 1.0 + sin(i) * 0.5 + i * 1e-9;
+		x.heads.set(i, x.full[i]);
+	}
+
+	State state;
+	state.iteration = 4;
+	state.control.update(1.0);
+	state.control.update(0.9);  // a decrease of 10%: switches
+
+	// nothing is due, or written, without a path
+	Checkpointer none(nullptr, 1);
+	if(none.enabled() || none.due(1))
+		return_code |= fail("a checkpointer without a path is enabled");
+
+	// the heads alone, while at the heads
+	{
+		Checkpointer checkpoint(path, 2);
+		if(!checkpoint.due(4) || checkpoint.due(3))
+			return_code |= fail("due at the wrong iterations");
+		checkpoint.saveHeads(state, x.heads.getHeads(), length);
+		if(!checkpoint.wait())
+			return fail("cannot write the heads checkpoint");
+	}
+	{
+		CheckpointFile saved(path);
+		State restored;
+		if(!saved.valid() || saved.size() != length || saved.hasTails() || saved.tails() != nullptr)
+			return fail("the heads checkpoint does not read back");
+		if(!saved.state(restored) || restored.iteration != 4 || restored.control.level() != state.control.level()
+			|| restored.control.iteration() != 2 || restored.control.reason() != state.control.reason())
+			return_code |= fail("the state did not survive the checkpoint");
+		int wrongSize;
+		if(saved.state(wrongSize))
+			return_code |= fail("a state of another size was accepted");
+		for(int i = 0; i < length; ++i)
+			if(saved.value(i) != x.heads.read(i))
+			{
+				return_code |= fail("a head did not survive the checkpoint");
+				break;
+			}
+	}
+
+	// the doubles as heads and tails, once at full precision
+	{
+		Checkpointer checkpoint(path, 1);
+		checkpoint.saveFull(state, x.full, length);
+		state.iteration = 5;
+		checkpoint.saveFull(state, x.full, length);  // waits for the first
+		if(!checkpoint.wait() || checkpoint.count() != 2)
+			return fail("cannot write the full checkpoint");
+	}
+	{
+		CheckpointFile saved(path);
+		State restored;
+		if(!saved.hasTails() || !saved.state(restored) || restored.iteration != 5)
+			return fail("the full checkpoint does not read back");
+		for(int i = 0; i < length; ++i)
+			if(saved.value(i) != x.full[i])
+			{
+				return_code |= fail("a value did not survive the checkpoint");
+				break;
+			}
+	}
+
+	// a truncated file, or none, is no checkpoint
+	{
+		ifstream in(path, ios::binary);
+		string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		ofstream out(path, ios::binary | ios::trunc);
+		out.write(bytes.data(), bytes.size() - 4);
+	}
+	{
+		CheckpointFile saved(path);
+		State restored;
+		if(saved.valid() || saved.state(restored))
+			return_code |= fail("a truncated checkpoint was accepted");
+	}
+	Checkpointer(path, 1).remove();
+	if(CheckpointFile(path).valid() || CheckpointFile(nullptr).valid())
+		return_code |= fail("a missing checkpoint was accepted");
+
+	// compressed: a base, then a chain of deltas, each over several coded blocks
+	{
+		const char* zpath = "checkpoint_test.ckptz";
+		const string delta1 = checkpointDeltaPath(zpath, 1), delta2 = checkpointDeltaPath(zpath, 2);
+		const int big = 3 * checkpointBlockValues + 123;
+		ManSegArray y(big);
+		y.allocFull();
+		for(int i = 0; i < big; ++i)
+		{
+			y.full[i] = 1.0 / (1.0 + i % 977) + i * 1e-12;
+			y.heads.set(i, y.full[i]);
+		}
+		Checkpointer checkpoint(zpath, 1, true);
+		checkpoint.saveHeads(state, y.heads.getHeads(), big);
+		const uint64_t baseBytes = checkpoint.bytes();
+		// the values may change as soon as a compressed save returns
+		for(int step = 1; step <= 2; ++step)
+		{
+			for(int i = 0; i < big; ++i)
+				y.heads.set(i, y.full[i] * (1.0 + step * 1e-7));
+			state.iteration = 5 + step;
+			checkpoint.saveHeads(state, y.heads.getHeads(), big);
+		}
+		if(!checkpoint.wait() || access(delta1.c_str(), F_OK) != 0 || access(delta2.c_str(), F_OK) != 0)
+			return fail("cannot write the compressed checkpoints");
+		const uint64_t deltaBytes = (checkpoint.bytes() - baseBytes) / 2;
+		if(baseBytes >= checkpoint.rawBytes() / 3 || deltaBytes * 2 > baseBytes)
+		{
+			cerr << "base of " << baseBytes << " and deltas of " << deltaBytes << " bytes for "
+				 << checkpoint.rawBytes() / 3 << " bytes of heads\n";
+			return_code |= fail("the heads did not compress");
+		}
+		{
+			CheckpointFile saved(zpath);
+			State restored;
+			if(!saved.valid() || !saved.compressed() || saved.deltas() != 2 || saved.size() != (uint_fast64_t)big
+				|| saved.hasTails() || !saved.state(restored) || restored.iteration != 7)
+				return fail("the compressed checkpoint does not read back");
+			for(int i = 0; i < big; ++i)
+				if(saved.value(i) != y.heads.read(i))
+				{
+					return_code |= fail("a head did not survive the compressed checkpoint");
+					break;
+				}
+		}
+
+		// the tails too: a new base, which leaves no deltas behind
+		checkpoint.saveFull(state, y.full, big);
+		if(!checkpoint.wait() || access(delta1.c_str(), F_OK) == 0 || access(delta2.c_str(), F_OK) == 0)
+			return fail("a base did not replace the chain");
+		for(int i = 0; i < big; ++i)
+			y.full[i] *= 1.0 + 1e-13;
+		state.iteration = 8;
+		checkpoint.saveFull(state, y.full, big);
+		if(!checkpoint.wait())
+			return fail("cannot write the compressed full checkpoint");
+		{
+			CheckpointFile saved(zpath);
+			State restored;
+			if(saved.deltas() != 1 || !saved.hasTails() || !saved.state(restored) || restored.iteration != 8)
+				return fail("the compressed full checkpoint does not read back");
+			for(int i = 0; i < big; ++i)
+				if(saved.value(i) != y.full[i])
+				{
+					return_code |= fail("a value did not survive the compressed checkpoint");
+					break;
+				}
+		}
+
+		// a delta cut short is ignored, and the base read alone
+		{
+			ifstream in(delta1, ios::binary);
+			string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+			ofstream out(delta1, ios::binary | ios::trunc);
+			out.write(bytes.data(), bytes.size() - 4);
+		}
+		{
+			CheckpointFile saved(zpath);
+			State restored;
+			if(!saved.valid() || saved.deltas() != 0 || !saved.state(restored) || restored.iteration != 7)
+				return_code |= fail("a truncated delta was not ignored");
+		}
+		checkpoint.remove();
+		if(CheckpointFile(zpath).valid() || access(delta1.c_str(), F_OK) == 0)
+			return_code |= fail("the compressed checkpoint was not removed");
+	}
+
+	// the block codec: runs, literals and both at once, against a base and without
+	{
+		const size_t m = 1000;
+		vector<uint32_t> words(m), base(m), decoded(m);
+		for(size_t i = 0; i < m; ++i)
+		{
+			words[i] = (uint32_t)(i * 2654435761u);
+			base[i] = i % 3 == 0 ? words[i] : words[i] ^ (uint32_t)i;
+		}
+		vector<unsigned char> coded;
+		auto word = [&](const size_t& i) { return words[i]; };
+		encodeCheckpointBlock(word, base.data(), m, coded);
+		const bool againstBase = decodeCheckpointBlock(coded.data(), coded.size(), base.data(), m, decoded.data()) && decoded == words;
+		encodeCheckpointBlock(word, nullptr, m, coded);
+		const bool alone = decodeCheckpointBlock(coded.data(), coded.size(), nullptr, m, decoded.data()) && decoded == words;
+		const bool shortBlock = !decodeCheckpointBlock(coded.data(), coded.size() - 1, nullptr, m, decoded.data());
+		if(!againstBase || !alone || !shortBlock)
+			return_code |= fail("a block did not decode to its words");
+	}
+
+	if(return_code == 0)
+		cout << "checkpoint: all tests passed\n";
+	return return_code;
+}
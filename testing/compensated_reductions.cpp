@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, so that the scalar remainder of the vectorised loops is also exercised
+constexpr int length = 100003;
+
+int check(const char* name, const double& actual, const long double& expected)
+{
+	if(fabsl(actual - expected) > 1e-14L * fabsl(expected))
+	{
+		cerr << name << " mismatch\n";
+		cerr << "expected = " << (double)expected << ", actual = " << actual << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(0.0, 1.0);
+
+	ManSegArray x(length);
+	ManSegArray y(length);
+	x.full = new double[length];
+	y.full = new double[length];
+	for(int i = 0; i < length; ++i)
+	{
+		x.pairs[i] = dist(gen);
+		y.pairs[i] = dist(gen) - 0.5;
+		x.full[i] = x.pairs[i];
+		y.full[i] = y.pairs[i];
+	}
+
+	int return_code = 0;
+
+	// reference sums in extended precision
+	long double sum_h = 0, sum_p = 0, diff_hh = 0, diff_pf = 0, dot_hp = 0, dot_ff = 0;
+	for(int i = 0; i < length; ++i)
+	{
+		sum_h += (double)x.heads[i];
+		sum_p += (double)x.pairs[i];
+		diff_hh += fabs(x.heads[i] - y.heads[i]);
+		diff_pf += fabs(x.pairs[i] - y.full[i]);
+		dot_hp += (double)x.heads[i] * (double)y.pairs[i];
+		dot_ff += x.full[i] * y.full[i];
+	}
+
+	return_code |= check("heads sum", kahanSum(x.heads, 0, length), sum_h);
+	return_code |= check("pairs sum", kahanSum(x.pairs, 0, length), sum_p);
+	return_code |= check("full sum", kahanSum(x.full, 0, length), sum_p);
+	return_code |= check("heads/heads l1 diff", l1Diff(x.heads, y.heads, 0, length), diff_hh);
+	return_code |= check("pairs/full l1 diff", l1Diff(x.pairs, y.full, 0, length), diff_pf);
+	return_code |= check("heads/pairs dot", dot(x.heads, y.pairs, 0, length), dot_hp);
+	return_code |= check("full/full dot", dot(x.full, y.full, 0, length), dot_ff);
+	return_code |= check("parallel pairs sum", parallelKahanSum(x.pairs, 0, length), sum_p);
+	return_code |= check("parallel pairs/full l1 diff", parallelL1Diff(x.pairs, y.full, 0, length), diff_pf);
+	return_code |= check("parallel full/full dot", parallelDot(x.full, y.full, 0, length), dot_ff);
+
+	// compensation: 1 followed by many values below half an ulp of 1
+	double* small = new double[length];
+	small[0] = 1.0;
+	for(int i = 1; i < length; ++i)
+		small[i] = 1e-17;
+	return_code |= check("compensated sum", kahanSum(small, 0, length), 1.0L + (length - 1) * 1e-17L);
+
+	// sub-range
+	long double range = 0;
+	for(int i = 5; i < 5 + 1000; ++i)
+		range += (double)x.pairs[i];
+	return_code |= check("sub-range sum", kahanSum(x.pairs, 5, 1000), range);
+
+	x.delSegments();
+	x.del();
+	y.delSegments();
+	y.del();
+	delete[] small;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
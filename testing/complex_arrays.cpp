@@ -0,0 +1,192 @@
+#include <iostream>
+#include <iomanip>
+#include <complex>
+#include <random>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_complex.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+typedef complex<double> cd;
+
+// the largest |a[i] - b[i]|
+template<class View>
+double furthest(View a, const vector<cd>& b)
+{
+	double d = 0.0;
+	for(uint64_t i = 0; i < b.size(); ++i)
+		d = max(d, abs(a.read(i) - b[i]));
+	return d;
+}
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+	const uint64_t n = 1000;   // not a multiple of the block
+	mt19937_64 rng(5);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	vector<cd> xs(n), ys(n);
+	for(uint64_t i = 0; i < n; ++i)
+	{
+		xs[i] = cd(dist(rng), dist(rng));
+		ys[i] = cd(dist(rng), dist(rng));
+	}
+	ComplexSegArray x(n), y(n);
+	for(uint64_t i = 0; i < n; ++i)
+	{
+		x.set<ACCESS_PAIRS>(i, xs[i]);
+		y.set<ACCESS_PAIRS>(i, ys[i]);
+	}
+
+	// the pairs hold the values exactly and the heads to a head of each part
+	if(furthest(x.pairs(), xs) != 0.0 || furthest(x.heads(), xs) > 1e-6 || x.heads()[3].imag() != headToDouble(x.im.heads.getHeads()[3]))
+	{
+		cerr << "set or read of the parts is wrong\n";
+		return_code = 1;
+	}
+
+	// the operations at the pairs are those of std::complex, to the order of the sums
+	cd dot(0.0, 0.0);
+	for(uint64_t i = 0; i < n; ++i)
+		dot += conj(xs[i]) * ys[i];
+	cd d = blas::zdotc(n, x.pairs(), y.pairs());
+	cd dHeads = blas::zdotc(n, x.heads(), y.pairs());
+	double norm = blas::dznrm2(n, x.pairs());
+	if(abs(d - dot) > 1e-12 || abs(dHeads - dot) > 1e-4 || fabs(norm * norm - blas::zdotc(n, x.pairs(), x.pairs()).real()) > 1e-9)
+	{
+		cerr << "zdotc " << d << " (at the heads " << dHeads << ") for " << dot << "\n";
+		return_code = 1;
+	}
+
+	const cd alpha(0.5, -1.5);
+	blas::zaxpy(n, alpha, x.pairs(), y.pairs());
+	for(uint64_t i = 0; i < n; ++i)
+		ys[i] += alpha * xs[i];
+	if(furthest(y.pairs(), ys) > 1e-15)
+	{
+		cerr << "zaxpy differs by " << furthest(y.pairs(), ys) << "\n";
+		return_code = 1;
+	}
+	blas::zscal(n, alpha, y.pairs());
+	for(uint64_t i = 0; i < n; ++i)
+		ys[i] *= alpha;
+	if(furthest(y.pairs(), ys) > 1e-15)
+	{
+		cerr << "zscal differs by " << furthest(y.pairs(), ys) << "\n";
+		return_code = 1;
+	}
+
+	// promoted, full holds the pairs, and demoted the pairs are those of full
+	y.promote();
+	if(!y.isPromoted() || furthest(y.full(), ys) > 1e-15)
+	{
+		cerr << "promotion changed the values\n";
+		return_code = 1;
+	}
+	blas::zaxpy(n, alpha, x.pairs(), y.full());
+	for(uint64_t i = 0; i < n; ++i)
+		ys[i] += alpha * xs[i];
+	y.demote();
+	if(y.isPromoted() || furthest(y.pairs(), ys) > 1e-15)
+	{
+		cerr << "demotion lost the values\n";
+		return_code = 1;
+	}
+
+	// a Hermitian positive definite tridiagonal matrix, 4 on the diagonal and 1 - i (or its conjugate) beside it
+	vector<int32_t> offsets(1, 0), cols;
+	vector<cd> values;
+	for(uint64_t r = 0; r < n; ++r)
+	{
+		if(r > 0) { cols.push_back(r - 1); values.push_back(cd(1.0, 1.0)); }
+		cols.push_back(r); values.push_back(cd(4.0, 0.0));
+		if(r + 1 < n) { cols.push_back(r + 1); values.push_back(cd(1.0, -1.0)); }
+		offsets.push_back(cols.size());
+	}
+	ComplexSegArray A(values.size());
+	for(uint64_t k = 0; k < values.size(); ++k)
+		A.set<ACCESS_PAIRS>(k, values[k]);
+
+	// the product, against std::complex
+	{
+		ComplexSegArray Ax(n);
+		blas::zcsrmv(n, offsets.data(), cols.data(), A.pairs(), x.pairs(), Ax.pairs());
+		vector<cd> expected(n, cd(0.0, 0.0));
+		for(uint64_t r = 0; r < n; ++r)
+			for(int32_t k = offsets[r]; k < offsets[r + 1]; ++k)
+				expected[r] += values[k] * xs[cols[k]];
+		if(furthest(Ax.pairs(), expected) > 1e-14)
+		{
+			cerr << "zcsrmv differs by " << furthest(Ax.pairs(), expected) << "\n";
+			return_code = 1;
+		}
+	}
+
+	// conjugate gradients on A b = x, reading A at its heads (exact here) and the vectors at their pairs
+	{
+		ComplexSegArray b(n), r(n), p(n), Ap(n);
+		for(uint64_t i = 0; i < n; ++i)
+		{
+			b.set<ACCESS_PAIRS>(i, cd(0.0, 0.0));
+			r.set<ACCESS_PAIRS>(i, xs[i]);
+			p.set<ACCESS_PAIRS>(i, xs[i]);
+		}
+		double rr = blas::zdotc(n, r.pairs(), r.pairs()).real();
+		const double target = 1e-24 * rr;
+		int iterations = 0;
+		for(; iterations < 200 && rr > target; ++iterations)
+		{
+			blas::zcsrmv(n, offsets.data(), cols.data(), A.heads(), p.pairs(), Ap.pairs());
+			const cd alphaCG = rr / blas::zdotc(n, p.pairs(), Ap.pairs());
+			blas::zaxpy(n, alphaCG, p.pairs(), b.pairs());
+			blas::zaxpy(n, -alphaCG, Ap.pairs(), r.pairs());
+			const double rrNext = blas::zdotc(n, r.pairs(), r.pairs()).real();
+			blas::zscal(n, cd(rrNext / rr, 0.0), p.pairs());
+			blas::zaxpy(n, cd(1.0, 0.0), r.pairs(), p.pairs());
+			rr = rrNext;
+		}
+		ComplexSegArray Ab(n);
+		blas::zcsrmv(n, offsets.data(), cols.data(), A.pairs(), b.pairs(), Ab.pairs());
+		if(rr > target || furthest(Ab.pairs(), xs) > 1e-10)
+		{
+			cerr << "CG left a residual of " << furthest(Ab.pairs(), xs) << " after " << iterations << " iterations\n";
+			return_code = 1;
+		}
+	}
+
+	// moved and swapped, the arrays keep their values
+	ComplexSegArray moved(std::move(x));
+	moved.swap(y);
+	if(x.size() != 0 || furthest(y.pairs(), xs) != 0.0 || furthest(moved.pairs(), ys) > 1e-15)
+	{
+		cerr << "moved or swapped arrays lost their values\n";
+		return_code = 1;
+	}
+
+	// a view of caller's doubles
+	{
+		vector<double> re(n), im(n);
+		auto v = complexView(FullView(re.data(), n), FullView(im.data(), n));
+		blas::zaxpy(n, cd(1.0, 0.0), y.pairs(), v);
+		if(furthest(v, xs) != 0.0 || v.subspan(5, 3)[1] != xs[6])
+		{
+			cerr << "view of doubles differs\n";
+			return_code = 1;
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
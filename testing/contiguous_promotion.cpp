@@ -0,0 +1,106 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// checks that an array allocated with allocContiguous is promoted to the exact doubles in-place
+int check(const uint_fast64_t length)
+{
+	mt19937 gen(length);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	double* d = new double[length];
+	ManSegArray m;
+	m.allocContiguous(length);
+	for(uint_fast64_t i = 0; i < length; ++i)
+	{
+		d[i] = dist(gen);
+		m.pairs[i] = d[i];
+	}
+
+	int return_code = 0;
+	m.promoteInPlace();
+	if(m.heads.isAlloc())
+	{
+		cerr << "heads still allocated after promotion\n";
+		return_code = 1;
+	}
+	for(uint_fast64_t i = 0; i < length; ++i)
+	{
+		if(m.full[i] != d[i])
+		{
+			cerr << "length " << length << ": m.full[" << i << "] != d[" << i << "]\n";
+			cerr << "expected = " << d[i] << ", actual = " << m.full[i] << "\n";
+			return_code = 1;
+			break;
+		}
+	}
+
+	m.delSegments();
+	m.del();
+	delete[] d;
+	return return_code;
+}
+// checks that the views of an array allocated with allocContiguous span its length, and that its
+// tails can be dropped
+int checkViews(const uint_fast64_t length)
+{
+	int return_code = 0;
+	ManSegArray m;
+	m.allocContiguous(length);
+	for(uint_fast64_t i = 0; i < length; ++i)
+		m.pairs.set(i, 1.0 + i * 1e-9);
+
+	if(m.heads.size() != length || m.pairs.size() != length)
+	{
+		cerr << "length " << length << ": heads or pairs of size " << m.heads.size() << ", " << m.pairs.size() << "\n";
+		return_code = 1;
+	}
+	if(m.heads.span().size() != length || m.pairs.span().size() != length)
+	{
+		cerr << "length " << length << ": spans of size " << m.heads.span().size() << ", " << m.pairs.span().size() << "\n";
+		return_code = 1;
+	}
+
+	m.heads.dropTails();
+	for(uint_fast64_t i = 0; i < length; ++i)
+	{
+		if(m.heads.getTails()[i] != 0.0f || m.pairs.read(i) != m.heads.read(i))
+		{
+			cerr << "length " << length << ": tail [" << i << "] not dropped\n";
+			return_code = 1;
+			break;
+		}
+	}
+
+	m.delSegments();
+	return return_code;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	int return_code = 0;
+	// sizes below, at, and well above the leaf size, both even and odd
+	uint_fast64_t sizes[] = {1, 7, 2048, 2049, 100000, 100003, 1 << 20};
+	for(uint_fast64_t s : sizes)
+	{
+		return_code |= check(s);
+		return_code |= checkViews(s);
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
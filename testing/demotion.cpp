@@ -0,0 +1,159 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_pressure.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1 << 18;    // 1 MB planes
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// pages of [p, p + n) in memory
+size_t resident(const float* p, const uint_fast64_t& n)
+{
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	char* first = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(p) / page * page);
+	const size_t bytes = reinterpret_cast<const char*>(p + n) - first;
+	vector<unsigned char> in((bytes + page - 1) / page);
+	if(mincore(first, bytes, in.data()) != 0)
+		return 0;
+	size_t count = 0;
+	for(size_t i = 0; i < in.size(); ++i)
+		count += in[i] & 1;
+	return count;
+}
+
+double value(const int& i) { return 1.0 + sin(i) * 0.5 + i * 1e-9; }
+
+int main()
+{
+	int return_code = 0;
+
+	// full -> pairs: exact, and full is freed
+	ManSegArray x(length);
+	x.allocFull();
+	for(int i = 0; i < length; ++i)
+		x.full[i] = value(i);
+	x.demote();
+	if(x.full != nullptr || !x.heads.isAlloc())
+		return_code |= fail("full is not freed");
+	for(int i = 0; i < length; ++i)
+		if(x.pairs.read(i) != value(i))
+		{
+			return_code |= fail("a value did not survive demotion to the pairs");
+			break;
+		}
+	// pairs -> heads, rounded to nearest
+	x.demote<ROUND_NEAREST>(true);
+	for(int i = 0; i < length; ++i)
+	{
+		float head = 0.0f;
+		HeadsSpan(&head, nullptr, 1).set<ROUND_NEAREST>(0, value(i));
+		if(x.heads.read(i) != HeadsSpan(&head, nullptr, 1).read(0) || x.heads.getTails()[i] != 0.0f)
+		{
+			return_code |= fail("the pairs are not rounded to their heads");
+			break;
+		}
+	}
+	x.del();
+	x.delSegments();
+
+	// full -> heads, with the tails given back to the system
+	LazyManSegArray y(length);
+	y.allocFull();
+	for(int i = 0; i < length; ++i)
+		y.full[i] = value(i);
+	y.demote();
+	if(resident(y.heads.getTails(), length) == 0)
+		cout << "(tails not resident after writing: the residency check below is not meaningful here)\n";
+	y.demote(true);
+	if(resident(y.heads.getTails() + 1024, length - 2048) != 0)
+		return_code |= fail("the dropped tails are still in memory");
+	for(int i = 0; i < length; ++i)
+	{
+		float head = 0.0f;
+		HeadsSpan(&head, nullptr, 1).set(0, value(i));
+		if(y.pairs.read(i) != HeadsSpan(&head, nullptr, 1).read(0))
+		{
+			return_code |= fail("a value is not its truncated head after dropping the tails");
+			break;
+		}
+	}
+	// the array goes on: a tail written again is kept
+	y.pairs.set(5, value(5));
+	if(y.pairs.read(5) != value(5))
+		return_code |= fail("a tail cannot be written after dropping them");
+	y.delSegments();
+
+	// promoted in place: the segments come back
+	ManSegArray z;
+	z.allocContiguous(length);
+	for(int i = 0; i < length; ++i)
+		z.pairs.set(i, value(i));
+	z.promoteInPlace();
+	z.demote();
+	if(z.full != nullptr || !z.heads.isAlloc() || z.pairs.read(length - 1) != value(length - 1) || z.pairs.read(0) != value(0))
+		return_code |= fail("an array promoted in place is not demoted");
+	z.delSegments();
+
+	// allocated contiguously: the tails within the one block are dropped as well
+	ManSegArray c;
+	c.allocContiguous(length);
+	for(int i = 0; i < length; ++i)
+		c.pairs.set(i, value(i));
+	c.demote(true);
+	for(int i = 0; i < length; ++i)
+	{
+		float head = 0.0f;
+		HeadsSpan(&head, nullptr, 1).set(0, value(i));
+		if(c.pairs.read(i) != HeadsSpan(&head, nullptr, 1).read(0) || c.heads.getTails()[i] != 0.0f)
+		{
+			return_code |= fail("a contiguous array keeps its tails after dropping them");
+			break;
+		}
+	}
+	c.delSegments();
+
+	// nothing to demote
+	ManSegArray w(16);
+	w.pairs.set(3, value(3));
+	w.demote();
+	if(w.pairs.read(3) != value(3))
+		return_code |= fail("demoting an array without full values changed it");
+	w.delSegments();
+
+	// memory pressure, from a signal or from within
+	{
+		MemoryPressure pressure(SIGUSR2);
+		if(!pressure.listening() || pressure.take())
+			return_code |= fail("pressure before any signal");
+		kill(getpid(), SIGUSR2);
+		if(!pressure.take() || pressure.take())
+			return_code |= fail("a signal is not taken once");
+		pressure.raise();
+		if(!pressure.take())
+			return_code |= fail("pressure raised within is not taken");
+	}
+	setenv("MANSEG_PRESSURE_SIGNAL", "0", 1);
+	if(MemoryPressure().listening())
+		return_code |= fail("signal 0 is listened for");
+	unsetenv("MANSEG_PRESSURE_SIGNAL");
+	if(MemoryPressure::defaultSignal() != SIGUSR1)
+		return_code |= fail("the default signal is not SIGUSR1");
+
+	if(return_code == 0)
+		cout << "demotion: all tests passed\n";
+	return return_code;
+}
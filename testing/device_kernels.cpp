@@ -0,0 +1,211 @@
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// built with g++, so the kernels run on the host: the same code nvcc and hipcc build for the device
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_stencil.hpp"
+#include "../manseglib_device.hpp"
+
+using namespace ManSeg;
+using namespace ManSeg::device;
+using namespace std;
+
+constexpr int length = 1003;
+constexpr int B = 37;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	ManSegArray a(length);
+	vector<double> values(length);
+	for(int i = 0; i < length; ++i)
+	{
+		values[i] = dist(gen);
+		a.pairs.set(i, values[i]);
+	}
+
+	// only the heads go over at first, then the tails are combined with them
+	DeviceSegArray x(length);
+	x.uploadHeads(a.heads.getHeads());
+	if(x.level() != ACCESS_HEADS || x.deviceBytes() != length * sizeof(float))
+		return_code |= fail("a new array is not just its heads");
+	vector<double> out(length);
+	x.download(out.data());
+	double headsSum = 0.0;
+	for(int i = 0; i < length; ++i)
+	{
+		headsSum += a.heads.read(i);
+		if(out[i] != a.heads.read(i))
+		{
+			return_code |= fail("wrong heads downloaded");
+			break;
+		}
+	}
+	if(sum(x.heads(), length) != headsSum)
+		return_code |= fail("wrong sum of the heads");
+	x.uploadTails(a.heads.getTails());
+	if(x.level() != ACCESS_PAIRS || x.deviceBytes() != 2 * length * sizeof(float))
+		return_code |= fail("the tails are not on the device");
+	x.promote();
+	x.download(out.data());
+	if(x.level() != ACCESS_FULL || x.deviceBytes() != length * sizeof(double) || out != values)
+		return_code |= fail("the promoted array is not the doubles");
+	try
+	{
+		x.heads();
+		return_code |= fail("the heads of a promoted array");
+	}
+	catch(const logic_error&) {}
+
+	// promoted without tails, the heads are widened
+	DeviceSegArray y(length);
+	y.uploadHeads(a.heads.getHeads());
+	y.promote();
+	y.download(out.data());
+	for(int i = 0; i < length; ++i)
+		if(out[i] != a.heads.read(i))
+		{
+			return_code |= fail("wrong heads promoted");
+			break;
+		}
+
+	// the element kernels truncate to the level written as the host views do
+	DeviceSegArray h(length);
+	fill(h.heads(), length, 0.1);
+	axpy(3.0, x.full(), h.heads(), length);
+	xpay(y.full(), -0.5, h.heads(), length);
+	h.download(out.data());
+	for(int i = 0; i < length; ++i)
+	{
+		a.heads.set(i, 0.1);
+		a.heads.set(i, a.heads.read(i) + 3.0 * values[i]);
+		a.heads.set(i, ManSeg::headToDouble(ManSeg::headOf(values[i])) - 0.5 * a.heads.read(i));
+		if(out[i] != a.heads.read(i))
+		{
+			return_code |= fail("wrong axpy or xpay at the heads");
+			break;
+		}
+	}
+	double exact = 0.0, diff = 0.0;
+	for(int i = 0; i < length; ++i)
+	{
+		exact += values[i] * a.heads.read(i);
+		diff += fabs(values[i] - a.heads.read(i));
+	}
+	if(dot(x.full(), h.heads(), length) != exact || absDiffSum(x.full(), h.heads(), length) != diff)
+		return_code |= fail("wrong dot or change");
+
+	// gather as gatherHeads does
+	vector<int32_t> idx(length);
+	uniform_int_distribution<int> pick(0, length - 1);
+	for(int i = 0; i < length; ++i)
+		idx[i] = pick(gen);
+	DeviceBuffer<int32_t> dIdx(idx);
+	DeviceBuffer<double> gathered(length);
+	gather(h.heads(), dIdx.data(), DeviceFull{ gathered.data() }, length);
+	vector<double> expected(length);
+	gatherHeads(a.heads.getHeads(), idx.data(), length, expected.data());
+	gathered.download(out.data());
+	if(out != expected)
+		return_code |= fail("wrong gather");
+
+	// a stencil sweep is the host kernel's, to the bit
+	ManSegArray grid(B * B), next(B * B);
+	out.resize(B * B);
+	for(int i = 0; i < B * B; ++i)
+		grid.pairs.set(i, fabs(dist(gen)));
+	DeviceSegArray g(B * B), gNext(B * B);
+	g.uploadHeads(grid.heads.getHeads());
+	const double delta = stencil5(g.heads(), gNext.heads(), B);
+	const double hostDelta = ManSeg::stencil5(grid.read_as<ACCESS_HEADS>(), next.write_as<ACCESS_HEADS>(), B, nullptr, nullptr, nullptr, nullptr);
+	gNext.download(out.data());
+	for(int i = 0; i < B * B; ++i)
+		if(out[i] != next.heads.read(i))
+		{
+			return_code |= fail("wrong stencil sweep");
+			break;
+		}
+	if(delta != hostDelta)
+		return_code |= fail("wrong largest change of the stencil");
+
+	// spmv of the grid's Laplacian, with values at each level and over the pattern
+	vector<int> offsets(1, 0), cols;
+	vector<double> entries;
+	for(int i = 0; i < B * B; ++i)
+	{
+		const int r = i / B, c = i % B;
+		const int neighbours[5] = { r > 0 ? i - B : -1, c > 0 ? i - 1 : -1, i, c + 1 < B ? i + 1 : -1, r + 1 < B ? i + B : -1 };
+		for(int k = 0; k < 5; ++k)
+			if(neighbours[k] >= 0)
+			{
+				cols.push_back(neighbours[k]);
+				entries.push_back(neighbours[k] == i ? 4.0 + 1.0 / (1 + i) : -1.0);
+			}
+		offsets.push_back(cols.size());
+	}
+	ManSegArray hostVals(entries.size());
+	for(size_t k = 0; k < entries.size(); ++k)
+		hostVals.pairs.set(k, entries[k]);
+	DeviceBuffer<int> dOffsets(offsets), dCols(cols);
+	DeviceSegArray vals(entries.size());
+	vals.uploadHeads(hostVals.heads.getHeads());
+	spmv(B * B, dOffsets.data(), dCols.data(), vals.heads(), g.heads(), gNext.heads());
+	vector<double> unit(B * B);
+	DeviceBuffer<double> sums(B * B);
+	spmv(B * B, dOffsets.data(), dCols.data(), UnitValues(), g.heads(), DeviceFull{ sums.data() }, 2.0, 1.0);
+	sums.download(unit.data());
+	gNext.download(out.data());
+	for(int i = 0; i < B * B; ++i)
+	{
+		double s = 0.0, u = 0.0;
+		for(int k = offsets[i]; k < offsets[i + 1]; ++k)
+		{
+			s += hostVals.heads.read(k) * grid.heads.read(cols[k]);
+			u += grid.heads.read(cols[k]);
+		}
+		next.heads.set(i, s);
+		if(out[i] != next.heads.read(i) || unit[i] != 2.0 * u + 1.0)
+		{
+			return_code |= fail("wrong spmv");
+			break;
+		}
+	}
+	vals.uploadTails(hostVals.heads.getTails());
+	vals.promote();
+	g.promote();
+	gNext.promote();
+	spmv(B * B, dOffsets.data(), dCols.data(), vals.full(), g.full(), gNext.full());
+	gNext.download(out.data());
+	for(int i = 0; i < B * B; ++i)
+	{
+		double s = 0.0;
+		for(int k = offsets[i]; k < offsets[i + 1]; ++k)
+			s += entries[k] * grid.heads.read(cols[k]);
+		if(out[i] != s)
+		{
+			return_code |= fail("wrong spmv at full precision");
+			break;
+		}
+	}
+
+	a.del();
+	grid.del();
+	next.del();
+	hostVals.del();
+
+	if(return_code == 0)
+		cout << "device kernels (host backend): all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/IterativeLinearSolvers>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_eigen.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+constexpr int n = 120;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+	Eigen::VectorXd values(length), others(length);
+	for(int i = 0; i < length; ++i)
+	{
+		values[i] = dist(gen);
+		others[i] = dist(gen);
+	}
+
+	ManSegArray x(length), y(length);
+	x.pairs.writeBlock(0, length, values.data());
+	y.pairs.writeBlock(0, length, others.data());
+
+	// the expressions read the segments in place, through packets and one coefficient at a time
+	const Eigen::VectorXd pairs = asEigen(x.pairs), heads = asEigen(x.heads);
+	const Eigen::VectorXd tail = asEigen(x.pairs.subspan(5, 17)), twice = asEigen(x.pairs) * 2.0;
+	if(pairs.size() != length || pairs != values || tail != values.segment(5, 17) || twice != 2.0 * values)
+		return_code |= fail("wrong pairs expression");
+	for(int i = 0; i < length; ++i)
+		if(heads[i] != x.heads[i] || asEigen(x.heads)(i) != x.heads[i])
+		{
+			return_code |= fail("wrong heads expression");
+			break;
+		}
+	if(fabs(asEigen(x.pairs).dot(asEigen(y.pairs)) - values.dot(others)) > 1e-12
+		|| fabs(asEigen(x.heads).sum() - heads.sum()) > 1e-12 || asEigen(x.pairs).maxCoeff() != values.maxCoeff())
+		return_code |= fail("wrong reductions");
+
+	// assign evaluates into the segments, and may read the view it writes
+	assign(y.pairs, asEigen(y.pairs) + 0.5 * asEigen(x.pairs));
+	for(int i = 0; i < length; ++i)
+		if(y.pairs.read(i) != others[i] + 0.5 * values[i])
+		{
+			return_code |= fail("wrong assign");
+			break;
+		}
+
+	// a symmetric positive definite matrix in pairs, as a matrix free operator
+	Eigen::MatrixXd dense = Eigen::MatrixXd::Random(n, n);
+	dense = (dense * dense.transpose()).eval() + n * Eigen::MatrixXd::Identity(n, n);
+	ManSegArray m(n * n);
+	const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rowMajor = dense;
+	m.pairs.writeBlock(0, n * n, rowMajor.data());
+	SegmentedMatrix<PairsArray> A(m.pairs, n, n);
+
+	const Eigen::VectorXd b = values.head(n);
+	const Eigen::VectorXd product = A * b;
+	if((product - dense * b).norm() > 1e-10 * (dense * b).norm())
+		return_code |= fail("wrong product");
+	ManSegArray r(n);
+	r.pairs.writeBlock(0, n, b.data());
+	const Eigen::VectorXd residual = b - A * asEigen(r.pairs);
+	if((residual - (b - dense * b)).norm() > 1e-10 * (dense * b).norm())
+		return_code |= fail("wrong product with an expression");
+
+	Eigen::ConjugateGradient<SegmentedMatrix<PairsArray>, Eigen::Lower | Eigen::Upper, Eigen::IdentityPreconditioner> cg(A);
+	cg.setTolerance(1e-12);
+	const Eigen::VectorXd solved = cg.solve(b);
+	const Eigen::VectorXd expected = dense.ldlt().solve(b);
+	if(cg.info() != Eigen::Success || (solved - expected).norm() > 1e-9 * expected.norm())
+		return_code |= fail("wrong conjugate gradient solve");
+
+	x.del();
+	y.del();
+	m.del();
+	r.del();
+
+	if(return_code == 0)
+		cout << "eigen interop: all tests passed\n";
+	return return_code;
+}
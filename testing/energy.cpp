@@ -0,0 +1,154 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib_energy.hpp"
+#include "../manseglib_results.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// a powercap zone as the kernel lays it out: name, energy_uj and max_energy_range_uj
+void writeZone(const string& path, const char* name, const unsigned long long& uj, const unsigned long long& range)
+{
+	mkdir(path.c_str(), 0755);
+	FILE* f = fopen((path + "/name").c_str(), "w");
+	fprintf(f, "%s\n", name);
+	fclose(f);
+	f = fopen((path + "/energy_uj").c_str(), "w");
+	fprintf(f, "%llu\n", uj);
+	fclose(f);
+	f = fopen((path + "/max_energy_range_uj").c_str(), "w");
+	fprintf(f, "%llu\n", range);
+	fclose(f);
+}
+
+void setCounter(const string& path, const unsigned long long& uj)
+{
+	FILE* f = fopen((path + "/energy_uj").c_str(), "w");
+	fprintf(f, "%llu\n", uj);
+	fclose(f);
+}
+
+bool near(const double& a, const double& b) { return fabs(a - b) < 1e-9; }
+
+int check(const char* name, const bool& ok)
+{
+	if(!ok)
+		cerr << name << "\n";
+	return ok ? 0 : 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	char dir[] = "/tmp/manseg_powercap_XXXXXX";
+	if(mkdtemp(dir) == nullptr)
+	{
+		cerr << "cannot make a directory under /tmp\n";
+		return 1;
+	}
+	const string root = dir;
+	const string pkg0 = root + "/intel-rapl:0", pkg1 = root + "/intel-rapl:1";
+	const string dram0 = pkg0 + "/intel-rapl:0:1", core0 = pkg0 + "/intel-rapl:0:0";
+
+	// no tree: nothing measured, and nothing recorded
+	{
+		EnergyPhases none((root + "/missing").c_str());
+		none.start();
+		Energy e = none.lap("heads");
+		return_code |= check("none: unavailable", !none.available() && e.package != e.package);
+	}
+
+	// two sockets, a dram and a core subzone on the first, and psys, which overlaps the packages
+	const unsigned long long range = 262143328850ULL;
+	writeZone(pkg0, "package-0", 1000000, range);
+	writeZone(core0, "core", 500000, range);
+	writeZone(dram0, "dram", 2000000, range);
+	writeZone(pkg1, "package-1", range - 1500000, range);
+	writeZone(root + "/intel-rapl:2", "psys", 0, range);
+
+	EnergyMeter meter(root.c_str());
+	return_code |= check("meter: two sockets with dram", meter.available() && meter.sockets() == 2 && meter.hasDram());
+	Energy e = meter.read();
+	return_code |= check("meter: nothing used yet", near(e.package, 0.0) && near(e.dram, 0.0));
+
+	EnergyPhases phases(root.c_str());
+	phases.start();
+
+	// 3 J at the heads: package 0 uses 1 J, package 1 wraps having used 2 J, the dram 0.5 J
+	setCounter(pkg0, 2000000);
+	setCounter(pkg1, 500000);
+	setCounter(dram0, 2500000);
+	setCounter(core0, 900000000);
+	e = phases.lap("heads", 1.0);
+	return_code |= check("heads: packages added up over the wrap", near(e.package, 3.0));
+	return_code |= check("heads: dram alone", near(e.dram, 0.5));
+
+	setCounter(pkg0, 3000000);
+	e = phases.lap("heads", 1.0);
+	return_code |= check("heads: a second iteration", near(e.package, 1.0) && near(e.dram, 0.0));
+
+	setCounter(pkg0, 7000000);
+	setCounter(dram0, 4500000);
+	e = phases.lap("full", 2.0);
+	return_code |= check("full: 4 J and 2 J", near(e.package, 4.0) && near(e.dram, 2.0));
+
+	const vector<EnergyPhases::Phase>& levels = phases.levels();
+	return_code |= check("phases: heads then full", levels.size() == 2 && levels[0].level == "heads" && levels[1].level == "full");
+	if(levels.size() == 2)
+	{
+		return_code |= check("phases: heads", levels[0].iterations == 2 && near(levels[0].energy.package, 4.0) && near(levels[0].energy.dram, 0.5));
+		return_code |= check("phases: full", levels[1].iterations == 1 && near(levels[1].energy.total(), 6.0));
+	}
+	return_code |= check("phases: total", near(phases.total().total(), 10.5));
+	phases.print();
+
+	// the iterations carry their energy into the results, and the run its phases
+	const string csv = root + "/results.csv";
+	{
+		ResultsWriter results("energy", csv.c_str());
+		results.iteration(0, 1.0, 1.0, "heads", 0.0);
+		results.energy(3.0, 0.5);
+		results.iteration(1, 0.5, 1.0, "heads", 0.0);
+		phases.report(results);
+		results.write();
+	}
+	string text;
+	{
+		FILE* f = fopen(csv.c_str(), "r");
+		char buf[4096];
+		size_t got = fread(buf, 1, sizeof(buf) - 1, f);
+		buf[got] = '\0';
+		fclose(f);
+		text = buf;
+	}
+	return_code |= check("results: energy columns", text.find("bytes,package_joules,dram_joules,final_error") != string::npos);
+	return_code |= check("results: an iteration's energy", text.find(",heads,1,1,0,3,0.5,") != string::npos);
+	return_code |= check("results: unmeasured iterations empty", text.find(",heads,0.5,1,0,,,") != string::npos);
+	return_code |= check("results: per level", text.find("energy_heads_joules_per_iteration") != string::npos
+		&& text.find("energy_full_package_joules") != string::npos && text.find("energy_joules") != string::npos);
+
+	remove(csv.c_str());
+	const string zones[] = { core0, dram0, pkg0, pkg1, root + "/intel-rapl:2" };
+	for(size_t z = 0; z < 5; ++z)
+	{
+		remove((zones[z] + "/name").c_str());
+		remove((zones[z] + "/energy_uj").c_str());
+		remove((zones[z] + "/max_energy_range_uj").c_str());
+		rmdir(zones[z].c_str());
+	}
+	rmdir(dir);
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
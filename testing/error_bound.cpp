@@ -0,0 +1,174 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <math.h>
+
+#define MANSEG_ERROR_BOUND 1
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_controller.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// the bound added since before is expected (to rounding of the sums), and at least the actual error
+int expect(const char* name, const double& before, const double& expected, const double& actual)
+{
+	const double bound = ErrorBound::total() - before;
+	if(fabs(bound - expected) > 1e-12 * expected || actual > bound)
+	{
+		cerr << name << ": bound " << bound << ", expected " << expected << ", actual error " << actual << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	static_assert(ErrorBound::enabled, "built with MANSEG_ERROR_BOUND");
+	static_assert(headRoundoff<ROUND_TRUNCATE>() == 1.0 / 1048576, "a head keeps 20 bits of mantissa");
+	static_assert(headRoundoff<ROUND_NEAREST>() == 0.5 / 1048576, "");
+	static_assert(headRoundoff<ROUND_STOCHASTIC>() == 1.0 / 1048576, "");
+
+	cout << setprecision(16);
+
+	int return_code = 0;
+	const uint64_t n = 10000;
+	mt19937_64 rng(7);
+	uniform_real_distribution<double> dist(-4.0, 4.0);
+	vector<double> values(n);
+	for(uint64_t i = 0; i < n; ++i)
+		values[i] = dist(rng);
+	const double l1 = ErrorBound::l1(values.data(), n);
+
+	// the bulk narrowing, whichever SIMD path runs it
+	vector<float> heads(n);
+	double before = ErrorBound::total();
+	narrowToHeads(values.data(), n, heads.data());
+	double actual = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+		actual += fabs(headToDouble(heads[i]) - values[i]);
+	return_code |= expect("truncation", before, ErrorBound::truncation * l1, actual);
+
+	before = ErrorBound::total();
+	narrowToHeads<ROUND_NEAREST>(values.data(), n, heads.data());
+	actual = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+		actual += fabs(headToDouble(heads[i]) - values[i]);
+	return_code |= expect("nearest", before, ErrorBound::nearest * l1, actual);
+
+	// element writes: the arrays' set and the Head proxy
+	ManSegArray a(n);
+	before = ErrorBound::total();
+	actual = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+	{
+		if(i % 2)
+			a.heads.set<ROUND_NEAREST>(i, values[i]);
+		else
+			a.heads[i] = values[i];
+		actual += fabs((double)a.heads[i] - values[i]);
+	}
+	double expected = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+		expected += (i % 2 ? ErrorBound::nearest : ErrorBound::truncation) * fabs(values[i]);
+	return_code |= expect("elements", before, expected, actual);
+
+	// scatter-adds into a few heads: their error is at most what every add was bounded by
+	const uint64_t targets = 16;
+	vector<int32_t> idx(n);
+	vector<double> exact(targets, 0.0);
+	for(uint64_t i = 0; i < n; ++i)
+	{
+		idx[i] = (int32_t)((i * 7 + i / 3) % targets);
+		exact[idx[i]] += fabs(values[i]);
+	}
+	vector<double> magnitudes(n);
+	for(uint64_t i = 0; i < n; ++i)
+		magnitudes[i] = fabs(values[i]);
+	vector<float> sums(targets, 0.0f);
+	before = ErrorBound::total();
+	scatterAddHeads(sums.data(), idx.data(), n, magnitudes.data());
+	const double scattered = ErrorBound::total() - before;
+	actual = 0.0;
+	for(uint64_t t = 0; t < targets; ++t)
+		actual += fabs(headToDouble(sums[t]) - exact[t]);
+	if(actual > scattered || scattered <= 0.0)
+	{
+		cerr << "scatter-add: bound " << scattered << ", actual error " << actual << "\n";
+		return_code = 1;
+	}
+
+	// reads and reductions add nothing
+	before = ErrorBound::total();
+	double sum = 0.0;
+	for(uint64_t i = 0; i < n; ++i)
+		sum += a.heads[i];
+	a.heads.readBlock(0, n, values.data());
+	if(ErrorBound::total() != before)
+	{
+		cerr << "reads added " << ErrorBound::total() - before << " to the bound (sum " << sum << ")\n";
+		return_code = 1;
+	}
+
+	// threads add into their own totals, which outlive them; atomicAdd adds the bound of each store
+	vector<double> ones(n, 1.0);
+	for(uint64_t i = 0; i < n; ++i)
+		a.heads[i] = 0.0;
+	before = ErrorBound::total();
+	vector<thread> threads;
+	for(int t = 0; t < 4; ++t)
+		threads.push_back(thread([&a, &ones, n, t]()
+		{
+			vector<float> part(n / 4);
+			narrowToHeads(ones.data(), n / 4, part.data());
+			for(uint64_t i = 0; i < 1000; ++i)
+				atomicAdd(a.heads, i, 1.0 / 3);
+		}));
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	actual = 0.0;
+	expected = ErrorBound::truncation * n;
+	for(uint64_t i = 0; i < 1000; ++i)
+	{
+		actual += fabs((double)a.heads[i] - 4.0 / 3);
+		expected += ErrorBound::truncation * (1.0 / 3 + 2.0 / 3 + 1.0 + 4.0 / 3);
+	}
+	// the heads stored after each add are a little below the sums, so the bound is a little below expected
+	const double threaded = ErrorBound::total() - before;
+	if(actual > threaded || threaded > expected || threaded < expected * (1 - 1e-5))
+	{
+		cerr << "threads: bound " << threaded << ", expected about " << expected << ", actual error " << actual << "\n";
+		return_code = 1;
+	}
+
+	// the shadow policy, given the bound of an iteration, switches once delta * rate is within it
+	ShadowErrorPolicy policy;
+	policy.truncation = scattered;
+	if(policy.check(100 * scattered, 200 * scattered, 1) != SWITCH_NONE
+		|| policy.check(scattered, 1.5 * scattered, 2) != SWITCH_TRUNCATION)
+	{
+		cerr << "shadow policy did not switch at the bound\n";
+		return_code = 1;
+	}
+
+	cout << "bounded " << ErrorBound::total() << " of error in all\n";
+	ErrorBound::clear();
+	if(ErrorBound::total() != 0.0)
+	{
+		cerr << "clear: the bound is " << ErrorBound::total() << "\n";
+		return_code = 1;
+	}
+
+	a.del();
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, so that the scalar remainder of the vectorised loops is also exercised
+constexpr int length = 1003;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	ManSegArray x(length);
+	ManSegArray y(length);
+	double* z = new double[length];
+	for(int i = 0; i < length; ++i)
+	{
+		x.pairs[i] = dist(gen);
+		y.pairs[i] = dist(gen);
+		z[i] = dist(gen);
+	}
+
+	int return_code = 0;
+	const double a = 0.85;
+
+	// heads = a * heads + pairs / full - 1, compared with the same expression through the proxies
+	HeadsArray h(length);
+	assign(h, 0, length, a * expr(x.heads) + expr(y.pairs) / expr(z) - 1.0);
+	for(int i = 0; i < length; ++i)
+	{
+		HeadsArray expected(1);
+		expected[0] = a * x.heads[i] + y.pairs[i] / z[i] - 1.0;
+		if(h[i] != expected[0])
+		{
+			cerr << "heads expression value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected[0] << ", actual = " << h[i] << "\n";
+			return_code = 1;
+		}
+		expected.del();
+	}
+
+	// pairs and full destinations are exact
+	PairsArray p(length);
+	double* f = new double[length];
+	assign(p, 0, length, expr(x.pairs) * expr(y.pairs) - expr(z));
+	assign(f, 0, length, expr(x.pairs) * expr(y.pairs) - expr(z));
+	for(int i = 0; i < length; ++i)
+	{
+		double expected = (double)x.pairs[i] * (double)y.pairs[i] - z[i];
+		if(p[i] != expected || f[i] != expected)
+		{
+			cerr << "pairs/full expression value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << p[i] << ", " << f[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// in-place update of a sub-range, i.e. y += 2 * x over [3, 103)
+	double* before = new double[length];
+	for(int i = 0; i < length; ++i)
+		before[i] = y.heads[i];
+	assign(y.heads, 3, 100, expr(y.heads) + 2.0 * expr(x.heads));
+	for(int i = 0; i < length; ++i)
+	{
+		HeadsArray expected(1);
+		expected[0] = (i >= 3 && i < 103) ? before[i] + 2.0 * x.heads[i] : before[i];
+		if(y.heads[i] != expected[0])
+		{
+			cerr << "in-place range value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+		expected.del();
+	}
+
+	// rounding mode on the heads store
+	HeadsArray r(length);
+	assign<ROUND_NEAREST>(r, 0, length, expr(y.pairs) * 3.0);
+	for(int i = 0; i < length; ++i)
+	{
+		HeadsArray expected(1);
+		expected.set<ROUND_NEAREST>(0, (double)y.pairs[i] * 3.0);
+		if(r[i] != expected[0])
+		{
+			cerr << "rounded expression value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+		expected.del();
+	}
+
+	x.delSegments();
+	y.delSegments();
+	h.del();
+	p.del();
+	r.del();
+	delete[] z;
+	delete[] f;
+	delete[] before;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib_float.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// nearest head by comparing the two candidates, ties to the even head
+uint16_t nearestReference(const float& f)
+{
+	const uint16_t down = roundToFloatHead<ROUND_TRUNCATE>(f);
+	const double below = fabs((double)floatHeadToFloat(down) - f);
+	const double above = fabs((double)floatHeadToFloat(down + 1) - f);
+	if(below < above || (below == above && (down & 1) == 0))
+		return down;
+	return down + 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<float> dist(-10.0f, 10.0f);
+	uniform_int_distribution<uint32_t> anyBits;
+
+	// test values: ordinary floats, arbitrary bit patterns (denormals, NaNs and infinities among them)
+	vector<float> values(length);
+	for(int i = 0; i < length; ++i)
+		values[i] = (i % 3 == 0) ? bitsFloat(anyBits(gen)) : dist(gen);
+	values[1] = bitsFloat(0x00012345u); // denormal
+	values[2] = bitsFloat(0x7F800001u); // NaN that truncates to an infinity
+	values[4] = numeric_limits<float>::infinity();
+	values[5] = bitsFloat(0x3F80FFFFu); // rounds up to the next head
+	values[7] = bitsFloat(0x3F808000u); // a tie, to the even head 0x3F80
+	values[8] = bitsFloat(0x3F818000u); // a tie, to the even head 0x3F82
+
+	for(int i = 0; i < length; ++i)
+	{
+		uint16_t h, t;
+		splitFloatSegment(values[i], &h, &t);
+		const uint32_t bits = floatBits(values[i]);
+		if(floatBits(floatSegmentsToFloat(h, t)) != bits || floatBits(floatHeadToFloat(h)) != (bits & 0xFFFF0000u))
+		{
+			return_code |= fail("wrong split");
+			break;
+		}
+		if(isnan(values[i]))
+		{
+			if(!isnan(floatHeadToFloat(roundToFloatHead<ROUND_TRUNCATE>(values[i])))
+				|| !isnan(floatHeadToFloat(roundToFloatHead<ROUND_NEAREST>(values[i])))
+				|| !isnan(floatHeadToFloat(roundToFloatHead<ROUND_STOCHASTIC>(values[i]))))
+			{
+				return_code |= fail("a NaN's head is not a NaN");
+				break;
+			}
+		}
+		else if(isfinite(values[i]) && roundToFloatHead<ROUND_NEAREST>(values[i]) != nearestReference(values[i]))
+		{
+			return_code |= fail("wrong nearest head");
+			break;
+		}
+	}
+	if(roundToFloatHead<ROUND_NEAREST>(values[7]) != 0x3F80 || roundToFloatHead<ROUND_NEAREST>(values[8]) != 0x3F82
+		|| roundToFloatHead<ROUND_NEAREST>(values[4]) != 0x7F80)
+		return_code |= fail("wrong ties or infinity");
+	// stochastic heads are one of the two neighbours, and average out to the value
+	{
+		const float v = 1.0f + 1.0f / 512;
+		double mean = 0.0;
+		for(int k = 0; k < 4000; ++k)
+		{
+			const uint16_t h = roundToFloatHead<ROUND_STOCHASTIC>(v);
+			if(h != 0x3F80 && h != 0x3F81)
+				return_code |= fail("a stochastic head is not a neighbour");
+			mean += floatHeadToFloat(h);
+		}
+		if(fabs(mean / 4000 - v) > 1e-3)
+			return_code |= fail("stochastic heads are biased");
+	}
+
+	// the kernels agree at every level, at lengths that leave a scalar remainder
+	const SimdLevel widest = simdLevel();
+	vector<uint16_t> heads(length), tails(length);
+	vector<float> out(length);
+	for(int level = SIMD_SSE2; level <= widest; ++level)
+	{
+		setSimdLevel(static_cast<SimdLevel>(level));
+		for(int n : { length, 37, 15 })
+		{
+			splitFloatSegments(values.data(), n, heads.data(), tails.data());
+			combineFloatSegments(heads.data(), tails.data(), n, out.data());
+			for(int i = 0; i < n; ++i)
+				if(heads[i] != (floatBits(values[i]) >> 16) || floatBits(out[i]) != floatBits(values[i]))
+				{
+					return_code |= fail("wrong split or combined segments");
+					break;
+				}
+			widenFloatHeads(heads.data(), n, out.data());
+			for(int i = 0; i < n; ++i)
+				if(floatBits(out[i]) != (floatBits(values[i]) & 0xFFFF0000u))
+				{
+					return_code |= fail("wrong widened heads");
+					break;
+				}
+			narrowToFloatHeads<ROUND_TRUNCATE>(values.data(), n, heads.data());
+			narrowToFloatHeads<ROUND_NEAREST>(values.data(), n, tails.data());
+			for(int i = 0; i < n; ++i)
+				if(heads[i] != roundToFloatHead<ROUND_TRUNCATE>(values[i]) || tails[i] != roundToFloatHead<ROUND_NEAREST>(values[i]))
+				{
+					return_code |= fail("wrong narrowed heads");
+					break;
+				}
+		}
+		// denormals in every lane, which the BF16 conversion would flush to zero
+		vector<float> tiny(64);
+		for(int i = 0; i < 64; ++i)
+			tiny[i] = bitsFloat((i % 2 ? 0x80000000u : 0u) | (0x00008000u + 0x1234u * i));
+		narrowToFloatHeads<ROUND_NEAREST>(tiny.data(), 64, heads.data());
+		for(int i = 0; i < 64; ++i)
+			if(heads[i] != roundToFloatHead<ROUND_NEAREST>(tiny[i]))
+			{
+				return_code |= fail("wrong nearest heads of denormals");
+				break;
+			}
+	}
+	setSimdLevel(widest);
+
+	// the arrays: heads round, pairs are exact, and the promotion gives the floats
+	FloatSegArray a(length);
+	for(int i = 0; i < length; ++i)
+		a.heads.set<ROUND_NEAREST>(i, values[i]);
+	for(int i = 0; i < length; ++i)
+		if(a.heads.getHeads()[i] != roundToFloatHead<ROUND_NEAREST>(values[i]) || a.pairs.getTails()[i] != 0)
+		{
+			return_code |= fail("wrong heads set");
+			break;
+		}
+	a.pairs.writeBlock(0, length, values.data());
+	a.heads.readBlock(0, length, out.data());
+	for(int i = 0; i < length; ++i)
+		if(floatBits(a.pairs.read(i)) != floatBits(values[i]) || floatBits(out[i]) != floatBits(a.heads[i])
+			|| floatBits(out[i]) != (floatBits(values[i]) & 0xFFFF0000u))
+		{
+			return_code |= fail("wrong pairs or heads read");
+			break;
+		}
+	a.pairs[3] = 0.3f;
+	a.heads[6] = 0.3f;
+	a.heads[6] += 1.0f;
+	if(a.pairs.read(3) != 0.3f || a.read_as<ACCESS_HEADS>().read(6) != floatHeadToFloat(floatHeadOf(1.0f + floatHeadToFloat(floatHeadOf(0.3f)))))
+		return_code |= fail("wrong assignment through a reference");
+
+	a.copytoIEEEfloat();
+	a.delSegments();
+	auto full = a.read_as<ACCESS_FULL>();
+	if(a.heads.isAlloc() || full.read(3) != 0.3f || floatBits(full.read(0)) != floatBits(values[0]))
+		return_code |= fail("wrong promotion");
+
+	FloatSegArray b(length);
+	b.pairs.writeBlock(0, length, values.data());
+	swap(a, b);
+	if(a.full != nullptr || floatBits(a.pairs.read(9)) != floatBits(values[9]) || b.read_as<ACCESS_FULL>().read(3) != 0.3f)
+		return_code |= fail("wrong swap");
+
+	if(return_code == 0)
+		cout << "float segments: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,187 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <numeric>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+constexpr int numIdx = 4099; // not a multiple of 16, and with repeated indices
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	uniform_int_distribution<int> pick(0, length - 1);
+
+	double* d = new double[length];
+	double* values = new double[numIdx];
+	double* out = new double[numIdx];
+	int32_t* idx = new int32_t[numIdx];
+	int32_t* perm = new int32_t[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+	for(int i = 0; i < numIdx; ++i)
+	{
+		idx[i] = pick(gen);
+		values[i] = dist(gen);
+	}
+	iota(perm, perm + length, 0);
+	shuffle(perm, perm + length, gen);
+
+	int return_code = 0;
+
+	ManSegArray a(length);
+	a.allocFull();
+	a.pairs.writeBlock(0, length, d);
+	a.pairs.readBlock(0, length, a.full);
+
+	// gathers at each level match indexing one element at a time
+	gather(a.heads, idx, numIdx, out);
+	for(int i = 0; i < numIdx; ++i)
+	{
+		if(out[i] != (double)a.heads[idx[i]])
+		{
+			cerr << "gathered head [" << i << "] mismatch\n";
+			cerr << "expected = " << (double)a.heads[idx[i]] << ", actual = " << out[i] << "\n";
+			return_code = 1;
+		}
+	}
+	gather(a.pairs, idx, numIdx, out);
+	for(int i = 0; i < numIdx; ++i)
+	{
+		if(out[i] != d[idx[i]])
+		{
+			cerr << "gathered pair [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	gather(a.read_as<ACCESS_FULL>(), idx, numIdx, out);
+	gather(a.pairs.subspan(0, length), idx + 1, 1, out + 1);
+	for(int i = 0; i < numIdx; ++i)
+	{
+		if(out[i] != d[idx[i]])
+		{
+			cerr << "gathered full value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// the heads of values times the gathered heads, rows of every length from empty to past a vector
+	ManSegArray v(numIdx);
+	v.pairs.writeBlock(0, numIdx, values);
+	for(int len : { 0, 1, 7, 8, 9, 64, 1000, numIdx })
+	{
+		double expected = 0.0;
+		for(int i = 0; i < len; ++i)
+			expected += (double)v.heads[i] * (double)a.heads[idx[i]];
+		const double actual = dotGatherHeads(v.heads.getHeads(), idx, a.heads.getHeads(), len);
+		if(fabs(actual - expected) > 1e-12 * (1.0 + fabs(expected)) * len)
+		{
+			cerr << "gathered heads dot of " << len << " mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << actual << "\n";
+			return_code = 1;
+		}
+	}
+
+	// prefetching the indexed elements of each view is only a hint, and leaves the values alone
+	for(int i = 0; i < numIdx; ++i)
+	{
+		prefetch(a.heads, idx[i]);
+		prefetch(a.pairs, idx[i]);
+		prefetch(a.pairs.subspan(0, length), idx[i]);
+		prefetch(a.read_as<ACCESS_FULL>(), idx[i]);
+	}
+	gather(a.pairs, idx, numIdx, out);
+	for(int i = 0; i < numIdx; ++i)
+	{
+		if(out[i] != d[idx[i]])
+		{
+			cerr << "value [" << i << "] changed by prefetching\n";
+			return_code = 1;
+		}
+	}
+
+	// scatter add, with repeats, against Head::operator+= applied in order
+	HeadsArray ref(length);
+	ref.writeBlock(0, length, d);
+	a.heads.writeBlock(0, length, d);
+	for(int i = 0; i < numIdx; ++i)
+		ref[idx[i]] += values[i];
+	scatterAdd(a.heads, idx, numIdx, values);
+	for(int i = 0; i < length; ++i)
+	{
+		if((double)a.heads[i] != (double)ref[i])
+		{
+			cerr << "scattered head [" << i << "] mismatch\n";
+			cerr << "expected = " << (double)ref[i] << ", actual = " << (double)a.heads[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// distinct indices, adding the same value to each
+	for(int i = 0; i < length; ++i)
+		ref[perm[i]] += 0.75;
+	scatterAdd(a.heads, perm, length, 0.75);
+	for(int i = 0; i < length; ++i)
+	{
+		if((double)a.heads[i] != (double)ref[i])
+		{
+			cerr << "broadcast scattered head [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// rounded scatter add
+	for(int i = 0; i < numIdx; ++i)
+		ref.set<ROUND_NEAREST>(idx[i], (double)ref[idx[i]] + values[i]);
+	scatterAdd<ROUND_NEAREST>(a.heads, idx, numIdx, values);
+	for(int i = 0; i < length; ++i)
+	{
+		if((double)a.heads[i] != (double)ref[i])
+		{
+			cerr << "rounded scattered head [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// pairs and full values are updated exactly
+	a.pairs.writeBlock(0, length, d);
+	a.pairs.readBlock(0, length, a.full);
+	for(int i = 0; i < numIdx; ++i)
+		d[idx[i]] += values[i];
+	scatterAdd(a.pairs, idx, numIdx, values);
+	scatterAdd(a.write_as<ACCESS_FULL>(), idx, numIdx, values);
+	for(int i = 0; i < length; ++i)
+	{
+		if((double)a.pairs[i] != d[i] || a.full[i] != d[i])
+		{
+			cerr << "scattered pair/full [" << i << "] mismatch\n";
+			cerr << "expected = " << d[i] << ", actual = " << (double)a.pairs[i] << ", " << a.full[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	ref.del();
+	delete[] d;
+	delete[] values;
+	delete[] out;
+	delete[] idx;
+	delete[] perm;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
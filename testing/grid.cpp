@@ -0,0 +1,91 @@
+#include <iostream>
+#include <iomanip>
+#include <utility>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_grid.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	int return_code = 0;
+
+	// 100 values leave the planes a whole number of cache lines only after padding
+	const uint_fast64_t rows = 3, cols = 4, n = 100;
+	ManSegGrid g(rows, cols, n);
+
+	// block order: each block's heads, tails and full, cache line aligned, after the previous block's
+	const char* last = nullptr;
+	for(uint_fast64_t i = 0; i < rows; ++i)
+		for(uint_fast64_t j = 0; j < cols; ++j)
+		{
+			ManSegGrid::Block& b = g[i][j];
+			const char* planes[] = { reinterpret_cast<const char*>(b.heads.getHeads()),
+				reinterpret_cast<const char*>(b.heads.getTails()), reinterpret_cast<const char*>(b.full) };
+			for(const char* p : planes)
+			{
+				if(reinterpret_cast<uintptr_t>(p) % Slab::alignment != 0 || (last != nullptr && p <= last))
+				{
+					cerr << "block (" << i << ", " << j << ") plane at " << (const void*)p << " is misaligned or out of order\n";
+					return_code = 1;
+				}
+				last = p;
+			}
+			if(&g(i, j) != &b || b.length != n)
+			{
+				cerr << "block (" << i << ", " << j << ") has the wrong index or length\n";
+				return_code = 1;
+			}
+			for(uint_fast64_t k = 0; k < n; ++k)
+				if(b.heads.getHeads()[k] != 0.0f || b.heads.getTails()[k] != 0.0f || b.full[k] != 0.0)
+				{
+					cerr << "block (" << i << ", " << j << ") value [" << k << "] is not zero\n";
+					return_code = 1;
+					break;
+				}
+		}
+	if(g.bytes() > rows * cols * (n * 16 + 3 * Slab::alignment))
+	{
+		cerr << "slab uses " << g.bytes() << " bytes\n";
+		return_code = 1;
+	}
+
+	// the blocks work as ManSegArrays
+	for(uint_fast64_t k = 0; k < n; ++k)
+	{
+		g[1][2].pairs[k] = 1.0 / (k + 3);
+		g[1][2].full[k] = g[1][2].pairs[k];
+		g[2][3].heads[k] = k + 0.5;
+	}
+
+	// swapping and moving grids keeps the blocks and their values
+	ManSegGrid h(1, 1, 1);
+	double* full = g[1][2].full;
+	g.swap(h);
+	if(h.rows() != rows || h.cols() != cols || h[1][2].full != full || g.rows() != 1)
+	{
+		cerr << "swap did not exchange the grids\n";
+		return_code = 1;
+	}
+	ManSegGrid m(std::move(h));
+	for(uint_fast64_t k = 0; k < n; ++k)
+		if(m[1][2].pairs[k] != 1.0 / (k + 3) || m[1][2].full[k] != 1.0 / (k + 3) || m[2][3].heads[k] != k + 0.5)
+		{
+			cerr << "value [" << k << "] lost by swap or move\n";
+			return_code = 1;
+			break;
+		}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// a unit in the last place of the head of d
+double headUlp(const double& d)
+{
+	int e;
+	frexp(d, &e);
+	return ldexp(1.0, e - 21);
+}
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+	const int B = 37;   // not a multiple of any vector width, so every path has a remainder
+	mt19937_64 rng(11);
+	uniform_real_distribution<double> dist(-4.0, 4.0);
+
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 })
+	{
+		setSimdLevel(level);
+
+		// the range check: zeros fit, as do the smallest and largest normals with room for the headroom
+		{
+			vector<float> heads(B * B, 0.0f);
+			bool zeros = headsFitFloat(heads.data(), heads.size(), 3);
+			heads[5] = headOf(numeric_limits<float>::min());
+			heads[B] = headOf(-ldexp(1.0, 124));
+			bool edges = headsFitFloat(heads.data(), heads.size(), 3);
+			bool noRoom = headsFitFloat(heads.data(), heads.size(), 4);
+			heads[B + 1] = headOf(numeric_limits<float>::min() / 2);
+			bool subnormal = headsFitFloat(heads.data(), heads.size(), 0);
+			heads[B + 1] = headOf(INFINITY);
+			bool infinite = headsFitFloat(heads.data(), heads.size(), 0);
+			heads[B + 1] = headOf(NAN);
+			bool nan = headsFitFloat(heads.data(), heads.size(), 0);
+			double halo[3] = { 0.0, 1e-30, -3e38 };
+			double big[3] = { 0.0, 1e-30, 1e39 };
+			if(!zeros || !edges || noRoom || subnormal || infinite || nan || !fitsFloat(halo, 3) || fitsFloat(halo, 3, 1)
+				|| fitsFloat(big, 3))
+			{
+				cerr << "level " << level << ": range check " << zeros << edges << noRoom << subnormal << infinite
+					 << nan << "\n";
+				return_code = 1;
+			}
+		}
+
+		// heads that fit convert to floats exactly, and back
+		{
+			vector<double> values(B * B);
+			for(auto& v : values)
+				v = dist(rng) * ldexp(1.0, int(dist(rng) * 20));
+			values[3] = 0.0;
+			values[4] = -0.0;
+			vector<float> heads(B * B), floats(B * B), back(B * B);
+			narrowToHeads(values.data(), values.size(), heads.data());
+			bool fits = headsToFloats(heads.data(), heads.size(), floats.data(), 3);
+			floatsToHeads(floats.data(), floats.size(), back.data());
+			for(int i = 0; i < B * B; ++i)
+				if(double(floats[i]) != headToDouble(heads[i]) || memcmp(&back[i], &heads[i], sizeof(float)) != 0)
+				{
+					cerr << "level " << level << ": head " << headToDouble(heads[i]) << " as float " << floats[i] << "\n";
+					return_code = 1;
+					break;
+				}
+			if(!fits)
+			{
+				cerr << "level " << level << ": heads in range reported out of it\n";
+				return_code = 1;
+			}
+		}
+
+		// a sweep in float is that in double, to the rounding of its sums
+		{
+			ManSegArray grid, next, nextFloat;
+			grid.alloc(B * B);
+			next.alloc(B * B);
+			nextFloat.alloc(B * B);
+			for(int i = 0; i < B * B; ++i)
+				grid.heads.set(i, dist(rng));
+			vector<double> top(B), bottom(B), left(B), right(B);
+			for(int j = 0; j < B; ++j)
+			{
+				top[j] = headToDouble(headOf(dist(rng)));
+				bottom[j] = headToDouble(headOf(dist(rng)));
+				left[j] = headToDouble(headOf(dist(rng)));
+				right[j] = headToDouble(headOf(dist(rng)));
+			}
+
+			setHeadsArithmetic(HEADS_DOUBLE);
+			double delta = stencil5(grid.read_as<ACCESS_HEADS>(), next.write_as<ACCESS_HEADS>(), B, top.data(),
+				bottom.data(), left.data(), right.data());
+			setHeadsArithmetic(HEADS_FLOAT);
+			double deltaFloat = stencil5(grid.read_as<ACCESS_HEADS>(), nextFloat.write_as<ACCESS_HEADS>(), B, top.data(),
+				bottom.data(), left.data(), right.data());
+			// the results are under 4: the rounding of the sums, and the truncation of a result either side of a head
+			const double tolerance = 2 * headUlp(4.0);
+			double worst = 0.0;
+			for(int i = 0; i < B * B; ++i)
+				worst = max(worst, fabs(nextFloat.heads.read(i) - next.heads.read(i)));
+			if(worst > tolerance || fabs(deltaFloat - delta) > tolerance)
+			{
+				cerr << "level " << level << ": float sweep differs by " << worst << ", delta " << deltaFloat
+					 << " against " << delta << "\n";
+				return_code = 1;
+			}
+
+			// in place, as the asynchronous sweeps do it
+			setHeadsArithmetic(HEADS_FLOAT);
+			stencil5(grid.read_as<ACCESS_HEADS>(), grid.write_as<ACCESS_HEADS>(), B, top.data(), bottom.data(),
+				left.data(), right.data());
+			for(int i = 0; i < B * B; ++i)
+				if(memcmp(&grid.heads.getHeads()[i], &nextFloat.heads.getHeads()[i], sizeof(float)) != 0)
+				{
+					cerr << "level " << level << ": in place float sweep differs at " << i << "\n";
+					return_code = 1;
+					break;
+				}
+
+			// a block out of range is swept in double: the same heads bit for bit
+			grid.heads.set(B + 2, 1e300);
+			setHeadsArithmetic(HEADS_DOUBLE);
+			stencil5(grid.read_as<ACCESS_HEADS>(), next.write_as<ACCESS_HEADS>(), B, top.data(), bottom.data(),
+				left.data(), right.data());
+			setHeadsArithmetic(HEADS_FLOAT);
+			stencil5(grid.read_as<ACCESS_HEADS>(), nextFloat.write_as<ACCESS_HEADS>(), B, top.data(), bottom.data(),
+				left.data(), right.data());
+			// and so is one with a halo out of range
+			top[1] = 1e-60;
+			setHeadsArithmetic(HEADS_DOUBLE);
+			grid.heads.set(B + 2, 0.5);
+			ManSegArray haloNext, haloNextFloat;
+			haloNext.alloc(B * B);
+			haloNextFloat.alloc(B * B);
+			stencil5(grid.read_as<ACCESS_HEADS>(), haloNext.write_as<ACCESS_HEADS>(), B, top.data(), bottom.data(),
+				left.data(), right.data());
+			setHeadsArithmetic(HEADS_FLOAT);
+			stencil5(grid.read_as<ACCESS_HEADS>(), haloNextFloat.write_as<ACCESS_HEADS>(), B, top.data(), bottom.data(),
+				left.data(), right.data());
+			if(memcmp(next.heads.getHeads(), nextFloat.heads.getHeads(), B * B * sizeof(float)) != 0
+				|| memcmp(haloNext.heads.getHeads(), haloNextFloat.heads.getHeads(), B * B * sizeof(float)) != 0)
+			{
+				cerr << "level " << level << ": a block out of range was not swept in double\n";
+				return_code = 1;
+			}
+			setHeadsArithmetic(HEADS_DOUBLE);
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
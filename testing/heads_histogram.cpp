@@ -0,0 +1,127 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <math.h>
+#include <string.h>
+
+#include "util.h"
+#include "../manseglib_rank.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, and enough values to split between threads
+constexpr int length = 200003;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// the value of a head, its low half zero
+double headValue(const float& head)
+{
+	uint32_t h;
+	memcpy(&h, &head, sizeof(h));
+	const uint64_t bits = static_cast<uint64_t>(h) << 32;
+	double v;
+	memcpy(&v, &bits, sizeof(v));
+	return v;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	// ranks spread over many binades, as PageRank's are, with some zeros, negatives and an infinity
+	mt19937_64 rng(11);
+	lognormal_distribution<double> spread(-12.0, 3.0);
+	ManSegArray x(length);
+	for(int i = 0; i < length; ++i)
+	{
+		double v = spread(rng);
+		if(i % 1000 == 7) v = 0.0;
+		if(i % 997 == 3) v = -v;
+		x.pairs.set(i, v);
+	}
+	x.pairs.set(12345, INFINITY);
+	const float* heads = x.heads.getHeads();
+
+	// a bucket a binade: the positive normal heads counted by floor(log2)
+	const Log2Histogram h = histogramLog2(x.heads, length);
+	if(h.buckets() != 4096 || h.total() != (uint_fast64_t)length)
+		return_code |= fail("the histogram does not count every head once");
+	vector<uint_fast64_t> byExponent(2048, 0);
+	uint_fast64_t zeros = 0, negatives = 0;
+	for(int i = 0; i < length; ++i)
+	{
+		const double v = headValue(heads[i]);
+		if(v == 0.0) ++zeros;
+		else if(v < 0.0) ++negatives;
+		else if(isfinite(v)) ++byExponent[ilogb(v) + 1023];
+	}
+	for(int e = -1022; e <= 1023; ++e)
+		if(h.counts[h.bucket(ldexp(1.0, e))] != byExponent[e + 1023])
+		{
+			cerr << "binade 2^" << e << " has " << h.counts[h.bucket(ldexp(1.0, e))] << " heads, not " << byExponent[e + 1023] << "\n";
+			return_code |= 1;
+			break;
+		}
+	if(h.counts[h.bucket(0.0)] != zeros || h.counts[h.bucket(INFINITY)] != 1)
+		return_code |= fail("zero or infinity is not a bucket of its own");
+	uint_fast64_t below = 0;
+	for(size_t b = 0; b < h.bucket(-0.0); ++b)
+		below += h.counts[b];
+	if(below != negatives)
+		return_code |= fail("the negative heads are not below zero");
+	if(h.lower(h.bucket(0.75)) != 0.5 || h.upper(h.bucket(0.75)) >= 1.0 || h.upper(h.bucket(0.75)) < 0.99999
+		|| h.lower(h.bucket(-0.75)) > -0.99999 || h.upper(h.bucket(-0.75)) != -0.5)
+		return_code |= fail("a bucket's bounds are not its binade");
+
+	// finer buckets, and the same counts with the scalar loop
+	const Log2Histogram fine = histogramLog2(x.heads, length, 6);
+	if(fine.buckets() != (1u << 18) || fine.total() != (uint_fast64_t)length || fine.lower(fine.bucket(0.75)) != 0.75)
+		return_code |= fail("a histogram of 64 buckets a binade is not counted");
+	const SimdLevel level = simdLevel();
+	setSimdLevel(SIMD_SSE2);
+	if(histogramLog2(heads, length, 6).counts != fine.counts)
+		return_code |= fail("the scalar and vector histograms differ");
+	setSimdLevel(level);
+
+	// quantiles: with 16 buckets a binade those of headsQuantile, all from one pass
+	const vector<double> fractions = { 1e-4, 0.01, 0.1, 0.5, 0.9, 0.999 };
+	const vector<double> q = quantiles(x.heads, length, fractions);
+	for(size_t f = 0; f < fractions.size(); ++f)
+		if(q[f] != headsQuantile(heads, length, fractions[f]))
+		{
+			cerr << "the " << fractions[f] << " quantile is " << q[f] << ", not " << headsQuantile(heads, length, fractions[f]) << "\n";
+			return_code |= 1;
+		}
+
+	// and with 256, the bucket of the head at the quantile
+	vector<double> sorted(length);
+	for(int i = 0; i < length; ++i)
+		sorted[i] = headValue(heads[i]);
+	sort(sorted.begin(), sorted.end(), greater<double>());
+	const vector<double> q8 = quantiles(x.heads, length, fractions, 8);
+	const Log2Histogram h8 = histogramLog2(x.heads, length, 8);
+	for(size_t f = 0; f < fractions.size(); ++f)
+	{
+		const double at = sorted[(size_t)ceil(fractions[f] * length) - 1];
+		if(q8[f] != h8.lower(h8.bucket(at)) || q8[f] > at || (at > 0.0 && at - q8[f] > ldexp(at, -8)))
+			return_code |= fail("a quantile is not the bucket of the head at it");
+	}
+	if(!isinf(quantiles(heads, length, { 0.0 })[0]) || quantiles(heads, length, { 1.0 })[0] != -INFINITY
+		|| !isinf(quantiles(heads, 0, { 0.5 })[0]))
+		return_code |= fail("the quantiles at the ends are not infinite");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
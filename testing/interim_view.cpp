@@ -0,0 +1,161 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <type_traits>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+
+// written once, instantiated for each (read level, write level) pair
+template<class In, class Out>
+void scale(In x, Out y, const double& a)
+{
+	for(int i = 0; i < length; ++i)
+		y.set(i, a * x[i]);
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[length];
+	double* out = new double[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	static_assert(is_same<decltype(declval<ManSegArray&>().read_as<ACCESS_HEADS>()), HeadsArray>::value, "heads view should be HeadsArray");
+	static_assert(is_same<decltype(declval<ManSegArray&>().read_as<ACCESS_PAIRS>()), PairsArray>::value, "pairs view should be PairsArray");
+	static_assert(is_same<decltype(declval<ManSegArray&>().write_as<ACCESS_FULL>()), FullView>::value, "full view should be FullView");
+
+	ManSegArray x(length);
+	ManSegArray y(length);
+	x.allocFull();
+	y.allocFull();
+	x.pairs.writeBlock(0, length, d);
+
+	// interim: heads of x scaled into the full values of y
+	scale(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_FULL>(), 3.0);
+	for(int i = 0; i < length; ++i)
+	{
+		double expected = 3.0 * (double)x.heads[i];
+		if(y.full[i] != expected)
+		{
+			cerr << "interim value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << y.full[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// pairs read, heads write, as the other levels
+	scale(x.read_as<ACCESS_PAIRS>(), y.write_as<ACCESS_HEADS>(), 0.5);
+	for(int i = 0; i < length; ++i)
+	{
+		HeadsArray expected(1);
+		expected.set(0, 0.5 * d[i]);
+		if((double)y.heads[i] != (double)expected[0])
+		{
+			cerr << "pairs to heads value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+		expected.del();
+	}
+
+	// an InterimView over a single array promotes it in place
+	InterimView<> promote(x);
+	promote.readBlock(0, length, out);
+	promote.writeBlock(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		if(x.full[i] != (double)x.heads[i] || promote.read(i) != x.full[i])
+		{
+			cerr << "promoted value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// read/write views across arrays, with a rounding mode
+	ReadWriteView<ACCESS_FULL, ACCESS_HEADS> narrow(x, y);
+	for(int i = 0; i < length; ++i)
+		narrow.write<ROUND_NEAREST>(i, narrow.read(i) + d[i]);
+	HeadsArray ref(length);
+	for(int i = 0; i < length; ++i)
+		ref.set<ROUND_NEAREST>(i, x.full[i] + d[i]);
+	for(int i = 0; i < length; ++i)
+	{
+		if((double)y.heads[i] != (double)ref[i])
+		{
+			cerr << "rounded write [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// full views take part in expressions and atomics
+	FullView fx = x.read_as<ACCESS_FULL>();
+	FullView fy = y.write_as<ACCESS_FULL>();
+	assign(fy, 0, length, expr(fx) * 2.0);
+	double diff = l1Diff(fy, fx, 0, length);
+	double expected = kahanSum(abs(expr(fx)), 0, length);
+	if(fabs(diff - expected) > 1e-9 * expected)
+	{
+		cerr << "full view reductions: expected = " << expected << ", actual = " << diff << "\n";
+		return_code = 1;
+	}
+	double before = fy[7];
+	atomicAdd(fy, 7, 1.5);
+	if(fy[7] != before + 1.5)
+	{
+		cerr << "full view atomicAdd incorrect\n";
+		return_code = 1;
+	}
+
+	// a dual write view stores both levels: the heads rounded, the full values exact and read back
+	DualWriteView dual(y.heads.getHeads(), y.full, length);
+	scale(x.read_as<ACCESS_HEADS>(), dual, 3.0);
+	for(int i = 0; i < length; ++i)
+		dual.set<ROUND_NEAREST>(i, dual.read(i) + d[i]);
+	atomicAdd(dual, 7, 1.5);
+	for(int i = 0; i < length; ++i)
+	{
+		double exact = 3.0 * (double)x.heads[i] + d[i] + (i == 7 ? 1.5 : 0.0);
+		// the atomic add stores its head truncated
+		HeadsArray rounded(1);
+		if(i == 7)
+			rounded.set<ROUND_TRUNCATE>(0, exact);
+		else
+			rounded.set<ROUND_NEAREST>(0, exact);
+		if(y.full[i] != exact || (double)y.heads[i] != (double)rounded[0])
+		{
+			cerr << "dual write [" << i << "] mismatch\n";
+			cerr << "expected = " << exact << ", actual = " << y.full[i] << ", " << (double)y.heads[i] << "\n";
+			return_code = 1;
+		}
+		rounded.del();
+	}
+
+	ref.del();
+	x.delSegments();
+	x.del();
+	y.delSegments();
+	y.del();
+	delete[] d;
+	delete[] out;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_knn.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// not multiples of the tile, so the last tile row and column are padded
+constexpr int rows = 1000;
+constexpr int dim = 100;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// the k nearest rows of db by metric, computed in doubles
+vector<KnnNeighbour> bruteForce(const vector<double>& db, const vector<double>& query, const int& k, const KnnMetric& metric)
+{
+	vector<KnnNeighbour> all;
+	for(int i = 0; i < rows; ++i)
+	{
+		double d = 0.0;
+		for(int j = 0; j < dim; ++j)
+			d += (metric == KNN_L2) ? (db[i*dim + j] - query[j]) * (db[i*dim + j] - query[j]) : -db[i*dim + j] * query[j];
+		all.push_back(KnnNeighbour{ (uint_fast64_t)i, d });
+	}
+	sort(all.begin(), all.end());
+	all.resize(k);
+	return all;
+}
+
+int main()
+{
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	vector<double> values(rows * dim);
+	for(double& v : values) v = dist(gen);
+	ManSegMatrix db(rows, dim);
+	for(int i = 0; i < rows; ++i)
+		db.pairs.row(i).writeBlock(0, dim, values.data() + i*dim);
+
+	int return_code = 0;
+
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	for(KnnMetric metric : { KNN_L2, KNN_DOT })
+	for(int q = 0; q < 5; ++q)
+	{
+		setSimdLevel(level);
+		vector<double> query(dim);
+		for(double& v : query) v = dist(gen);
+		// a row of the database is its own nearest neighbour, at distance 0
+		if(q == 0)
+			copy(values.begin() + 17*dim, values.begin() + 18*dim, query.begin());
+
+		const vector<KnnNeighbour> expected = bruteForce(values, query, 10, metric);
+		const vector<KnnNeighbour> actual = knnScan(db, query.data(), 10, 4, metric);
+		if(actual.size() != expected.size())
+			return_code |= fail("the scan does not return k rows");
+		for(size_t i = 0; i < min(actual.size(), expected.size()); ++i)
+			if(actual[i].row != expected[i].row || fabs(actual[i].distance - expected[i].distance) > 1e-12)
+			{
+				cerr << "neighbour " << i << ": row " << actual[i].row << " at " << actual[i].distance
+					 << ", expected row " << expected[i].row << " at " << expected[i].distance << "\n";
+				return_code |= 1;
+				break;
+			}
+		if(q == 0 && metric == KNN_L2 && (actual.empty() || actual[0].row != 17 || actual[0].distance != 0.0))
+			return_code |= fail("a row is not its own nearest neighbour");
+	}
+
+	// more neighbours than rows, and no oversampling: every row, nearest first, at its exact distance
+	{
+		vector<double> query(dim, 0.5);
+		const vector<KnnNeighbour> all = knnScan(db, query.data(), rows + 10, 1);
+		if(all.size() != (size_t)rows || !is_sorted(all.begin(), all.end()))
+			return_code |= fail("a scan for more than the rows does not return them all in order");
+		const vector<KnnNeighbour> expected = bruteForce(values, query, rows, KNN_L2);
+		for(int i = 0; i < rows && i < (int)all.size(); ++i)
+			if(all[i].row != expected[i].row)
+			{
+				return_code |= fail("the rows are not ranked by their exact distances");
+				break;
+			}
+		if(!knnScan(db, query.data(), 0).empty())
+			return_code |= fail("a scan for no neighbours returns some");
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
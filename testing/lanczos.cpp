@@ -0,0 +1,181 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_lanczos.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 3001;
+
+// a diagonal operator, counting its products at the heads and after them
+struct Diagonal
+{
+	const vector<double>& d;
+	int heads, full;
+
+	Diagonal(const vector<double>& d) :d(d), heads(0), full(0) {}
+
+	template<class In, class Out>
+	void operator()(const PrecisionLevel& level, const In& x, Out&& y)
+	{
+		if(level == PRECISION_HEADS)
+			++heads;
+		else
+			++full;
+		vector<double> a(d.size());
+		x.readBlock(0, d.size(), a.data());
+		for(size_t i = 0; i < d.size(); ++i)
+			a[i] *= d[i];
+		y.writeBlock(0, d.size(), a.data());
+	}
+};
+
+void fillStart(ManSegArray& x)
+{
+	for(int i = 0; i < length; ++i)
+		x.pairs[i] = 1.0 + 0.5 * sin(0.1 * i);
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	// eigenvalues 0.25 and 0.5, 3, 3.5 and 4 apart from the rest, which are in [1, 2)
+	vector<double> d(length);
+	for(int i = 0; i < length; ++i)
+		d[i] = 1.0 + (double)((i * 7) % length) / length;
+	d[10] = 4.0;
+	d[1500] = 3.5;
+	d[2999] = 3.0;
+	d[77] = 0.25;
+	d[2000] = 0.5;
+
+	int return_code = 0;
+
+	// the three largest, and their vectors, starting at the heads, with a basis small enough to restart
+	EigenOptions opts;
+	opts.wanted = 3;
+	opts.basis = 12;
+	Diagonal op(d);
+	ManSegArray start(length);
+	fillStart(start);
+	vector<ManSegArray> vectors;
+	for(int i = 0; i < 3; ++i)
+		vectors.emplace_back(length);
+	EigenResult r = lanczos(length, op, start, opts, vectors.data());
+	const double largest[3] = { 4.0, 3.5, 3.0 };
+	const int at[3] = { 10, 1500, 2999 };
+	if(!r.converged || r.values.size() != 3 || r.switchedAt <= 0 || r.restarts == 0 || op.heads != r.switchedAt || op.full + op.heads != r.iterations)
+	{
+		cerr << "largest: not converged, or no switch from the heads\n";
+		cerr << "converged = " << r.converged << ", switched at = " << r.switchedAt << ", iterations = " << r.iterations << "\n";
+		return_code = 1;
+	}
+	for(size_t i = 0; i < r.values.size() && i < 3; ++i)
+	{
+		// the Ritz vector is the unit vector of its eigenvalue
+		const double v = vectors[i].pairs[at[i]];
+		double rest = 0.0;
+		for(int j = 0; j < length; ++j)
+			if(j != at[i])
+				rest += (double)vectors[i].pairs[j] * vectors[i].pairs[j];
+		if(fabs(r.values[i] - largest[i]) > 1e-9 || r.residuals[i] > 1e-9 || fabs(fabs(v) - 1.0) > 1e-9 || sqrt(rest) > 1e-8)
+		{
+			cerr << "largest eigenpair " << i << " mismatch\n";
+			cerr << "expected = " << largest[i] << ", actual = " << r.values[i] << " (residual " << r.residuals[i] << ", vector " << v << ")\n";
+			return_code = 1;
+		}
+	}
+
+	// the two smallest
+	opts.wanted = 2;
+	opts.basis = 40;
+	opts.largest = false;
+	Diagonal low(d);
+	fillStart(start);
+	r = lanczos(length, low, start, opts);
+	if(!r.converged || r.values.size() != 2 || fabs(r.values[0] - 0.25) > 1e-9 || fabs(r.values[1] - 0.5) > 1e-9)
+	{
+		cerr << "smallest eigenvalues mismatch\n";
+		for(double v : r.values)
+			cerr << "actual = " << v << "\n";
+		return_code = 1;
+	}
+
+	// a loose tolerance is met at the heads alone
+	opts.tol = 1e-4;
+	Diagonal loose(d);
+	fillStart(start);
+	r = lanczos(length, loose, start, opts);
+	if(!r.converged || r.switchedAt != -1 || loose.full != 0 || fabs(r.values[0] - 0.25) > 1e-3)
+	{
+		cerr << "loose tolerance left the heads\n";
+		return_code = 1;
+	}
+
+	// power iteration finds the dominant pair, switching on the way
+	EigenOptions power;
+	power.tol = 1e-9;
+	power.maxIterations = 2000;
+	Diagonal dominant(d);
+	fillStart(start);
+	r = powerIteration(length, dominant, start, power);
+	if(!r.converged || r.switchedAt <= 0 || fabs(r.values[0] - 4.0) > 1e-9 || fabs(fabs((double)start.pairs[10]) - 1.0) > 1e-8)
+	{
+		cerr << "power iteration mismatch\n";
+		cerr << "expected = 4, actual = " << r.values[0] << " after " << r.iterations << " (switched at " << r.switchedAt << ")\n";
+		return_code = 1;
+	}
+
+	// tridiagonalEigen of the 1D Laplacian, whose eigenvalues are 2 - 2 cos(k pi / (n + 1))
+	{
+		const int n = 12;
+		vector<double> diag(n, 2.0), off(n, -1.0), z;
+		tridiagonalEigen(n, diag, off, z);
+		for(int k = 0; k < n; ++k)
+			if(fabs(diag[k] - (2.0 - 2.0 * cos((k + 1) * M_PI / (n + 1)))) > 1e-13)
+			{
+				cerr << "tridiagonal eigenvalue " << k << " mismatch\n";
+				return_code = 1;
+			}
+	}
+
+	// symmetricEigen of a dense matrix: A v = lambda v for each column v
+	{
+		const int n = 9;
+		vector<double> a(n * n), v, lambda;
+		for(int i = 0; i < n; ++i)
+			for(int j = 0; j <= i; ++j)
+				a[i * n + j] = a[j * n + i] = sin(1.0 + i * 3 + j) + (i == j ? i : 0);
+		v = a;
+		symmetricEigen(n, v, lambda);
+		for(int k = 0; k < n; ++k)
+		{
+			double residual = 0.0;
+			for(int i = 0; i < n; ++i)
+			{
+				double s = -lambda[k] * v[i * n + k];
+				for(int j = 0; j < n; ++j)
+					s += a[i * n + j] * v[j * n + k];
+				residual = max(residual, fabs(s));
+			}
+			if(residual > 1e-12 || (k > 0 && lambda[k] < lambda[k - 1]))
+			{
+				cerr << "dense eigenpair " << k << " mismatch\n";
+				return_code = 1;
+			}
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
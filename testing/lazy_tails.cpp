@@ -0,0 +1,86 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+
+#include <math.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// large enough that the heads and tails each span many pages
+constexpr uint_fast64_t length = 1 << 24;
+
+// resident set size in bytes, from /proc/self/statm
+long residentBytes()
+{
+	long pages = 0, resident = 0;
+	ifstream statm("/proc/self/statm");
+	statm >> pages >> resident;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	int return_code = 0;
+
+	const long before = residentBytes();
+	LazyManSegArray m(length);
+	for(uint_fast64_t i = 0; i < length; ++i)
+		m.heads[i] = 1.0 + i;
+	const long heads_only = residentBytes() - before;
+
+	// only the heads should have been made resident (allow some slack for the rest of the process)
+	const long head_bytes = length * sizeof(float);
+	if(before > 0 && heads_only > head_bytes + head_bytes / 2)
+	{
+		cerr << "tails were made resident before use\n";
+		cerr << "expected <= " << head_bytes + head_bytes / 2 << " bytes, actual = " << heads_only << " bytes\n";
+		return_code = 1;
+	}
+
+	// untouched tails read as zero
+	for(uint_fast64_t i = 0; i < length; i += 4099)
+	{
+		if(m.pairs[i] != m.heads[i])
+		{
+			cerr << "pairs value [" << i << "] mismatch with zero tails\n";
+			return_code = 1;
+		}
+	}
+
+	// full precision writes land in the tails as usual
+	for(uint_fast64_t i = 0; i < length; i += 4099)
+		m.pairs[i] = 1.0 / (i + 3);
+	for(uint_fast64_t i = 0; i < length; i += 4099)
+	{
+		if(m.pairs[i] != 1.0 / (i + 3))
+		{
+			cerr << "pairs value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	const double head = m.heads[4099];
+	m.copytoIEEEdouble();
+	if(m.full[4099] != head)
+	{
+		cerr << "full value mismatch after copy\n";
+		return_code = 1;
+	}
+
+	m.delSegments();
+	m.del();
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_mapped.hpp"
+#include "../manseglib_rank.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 5001;   // planes of more than a page each
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	const char* path = "mapped_segments_test.seg";
+	const char* snapshot = "mapped_segments_test.snap";
+
+	ManSegArray x(length);
+	x.allocFull();
+	for(int i = 0; i < length; ++i)
+	{
+		x.full[i] = 1.0 + sin(i) * 0.5 + i * 1e-9;
+		x.pairs.set(i, x.full[i]);
+	}
+
+	// the planes as stored, and a snapshot split from the doubles, are the same file
+	if(!writeSegments(path, x.heads, length) || !writeSegments(snapshot, x.full, length))
+		return fail("cannot write the segments");
+	{
+		ifstream a(path, ios::binary), b(snapshot, ios::binary);
+		string bytesA((istreambuf_iterator<char>(a)), istreambuf_iterator<char>());
+		string bytesB((istreambuf_iterator<char>(b)), istreambuf_iterator<char>());
+		if(bytesA != bytesB || bytesA.size() != segmentsTailsOffset(length) + length * sizeof(float))
+			return_code |= fail("the planes and the snapshot differ");
+	}
+	vector<double> exact;
+	if(!loadSegments(path, exact, true) || exact.size() != length || exact[17] != x.full[17])
+		return_code |= fail("loadSegments does not read the planes back");
+
+	uint_fast64_t n = 0;
+	MappedSegments mapped = mapSegments(path, n);
+	if(!mapped.isAlloc() || n != length)
+		return fail("cannot map the segments");
+
+	// the heads come from the file; the tails are not there yet
+	for(int i = 0; i < length; ++i)
+		if(mapped.read(i) != x.heads.read(i) || mapped.getTails()[i] != 0.0f)
+		{
+			return_code |= fail("the heads are not mapped, or the tails already are");
+			break;
+		}
+	// ties between equal heads are ranked by index, as for a heads array never written at full precision
+	vector<float> noTails(length, 0.0f);
+	if(topK(mapped, n, 10) != topK(TwoSegArray<false>(x.heads.getHeads(), noTails.data(), length), n, 10))
+		return_code |= fail("the mapped heads rank differently");
+
+	// the full values once the tails are asked for
+	MappedPairs pairs = mapped.createFullPrecision();
+	for(int i = 0; i < length; ++i)
+		if(pairs.read(i) != x.full[i])
+		{
+			return_code |= fail("a value did not survive the mapping");
+			break;
+		}
+
+	// writes stay in memory: shared by the arrays, and neither remapped nor written to the file
+	pairs.set(3, 42.0);
+	MappedPairs again = mapped.createFullPrecision();
+	if(again.read(3) != 42.0)
+		return_code |= fail("the tails were mapped again");
+	if(!loadSegments(path, exact, true) || exact[3] != x.full[3])
+		return_code |= fail("a write reached the file");
+	mapped.del();
+
+	// a truncated file, or none, is not mapped
+	{
+		ifstream in(path, ios::binary);
+		string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		ofstream out(path, ios::binary | ios::trunc);
+		out.write(bytes.data(), bytes.size() - 4);
+	}
+	if(mapSegments(path, n).isAlloc() || n != 0 || mapSegments("mapped_segments_missing.seg", n).isAlloc() || mapSegments(nullptr, n).isAlloc())
+		return_code |= fail("a truncated or missing file was mapped");
+
+	remove(path);
+	remove(snapshot);
+
+	if(return_code == 0)
+		cout << "mapped segments: all tests passed\n";
+	return return_code;
+}
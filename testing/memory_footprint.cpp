@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define MANSEG_MEMORY 1
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_grid.hpp"
+#include "../manseglib_memory.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// the last record of the plane of the given label
+const Memory::PlaneRecord* find(const vector<Memory::PlaneRecord>& records, const string& label, const Memory::Plane& plane)
+{
+	const Memory::PlaneRecord* found = nullptr;
+	for(size_t i = 0; i < records.size(); ++i)
+		if(records[i].label == label && records[i].plane == plane)
+			found = &records[i];
+	return found;
+}
+
+int check(const char* name, const bool& ok)
+{
+	if(!ok)
+		cerr << name << "\n";
+	return ok ? 0 : 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	const uint_fast64_t n = 1 << 20;
+
+	// heads and tails, then the full doubles alongside them until the segments are freed
+	{
+		ManSegArray a(n);
+		a.label("a");
+		return_code |= check("a: 8 bytes an element live", Memory::currentBytes() == 8 * n);
+		for(uint_fast64_t i = 0; i < n; ++i)
+			a.heads.set(i, 1.0);
+		a.copytoIEEEdouble();
+		return_code |= check("a: the peak holds the segments and the full doubles", Memory::peakBytes() == 16 * n);
+		vector<Memory::PlaneRecord> r = Memory::records();
+		const Memory::PlaneRecord* heads = find(r, "a", Memory::PLANE_HEADS);
+		const Memory::PlaneRecord* full = find(r, "a", Memory::PLANE_FULL);
+		return_code |= check("a: heads and full recorded under the label", heads != nullptr && full != nullptr);
+		if(heads != nullptr)
+			return_code |= check("a: the heads written are touched", heads->state == Memory::PLANE_TOUCHED && heads->resident >= 4 * n);
+		if(full != nullptr)
+			return_code |= check("a: full is as large as the segments", full->bytes == 8 * n && full->freed == 0);
+		a.delSegments();
+		return_code |= check("a: the full doubles alone once the segments are freed", Memory::currentBytes() == 8 * n);
+		const string report = memoryReport();
+		cout << report;
+		return_code |= check("a: the report shows the double residency", report.find("double residency: a held") != string::npos);
+	}
+	return_code |= check("a: nothing live once destroyed", Memory::currentBytes() == 0);
+	{
+		vector<Memory::PlaneRecord> r = Memory::records();
+		const Memory::PlaneRecord* full = find(r, "a", Memory::PLANE_FULL);
+		return_code |= check("a: the full doubles are freed", full != nullptr && full->state == Memory::PLANE_FREED && full->freed != 0);
+	}
+
+	// promoted in place: one plane throughout, so no double residency
+	Memory::clear();
+	Memory::resetPeak();
+	{
+		ManSegArray b;
+		b.allocContiguous(n);
+		b.label("b");
+		b.promoteInPlace();
+		vector<Memory::PlaneRecord> r = Memory::records();
+		return_code |= check("b: one plane, now the full doubles", r.size() == 1 && r[0].plane == Memory::PLANE_FULL && r[0].label == "b");
+		return_code |= check("b: no double residency", memoryReport().find("double residency") == string::npos);
+		return_code |= check("b: peak of one plane", Memory::peakBytes() == 8 * n);
+	}
+
+#if defined(__linux__)
+	// lazy tails are reserved but never resident while only the heads are written
+	Memory::clear();
+	{
+		LazyManSegArray c(n);
+		c.label("c");
+		for(uint_fast64_t i = 0; i < n; ++i)
+			c.heads.set(i, 2.0);
+		vector<Memory::PlaneRecord> r = Memory::records();
+		const Memory::PlaneRecord* tails = find(r, "c", Memory::PLANE_TAILS);
+		const Memory::PlaneRecord* heads = find(r, "c", Memory::PLANE_HEADS);
+		return_code |= check("c: lazy tails are reserved", tails != nullptr && tails->state == Memory::PLANE_RESERVED && tails->resident == 0);
+		return_code |= check("c: heads are touched", heads != nullptr && heads->state == Memory::PLANE_TOUCHED);
+	}
+#endif
+
+	// a grid is one slab, however many blocks it has
+	Memory::clear();
+	{
+		ManSegGrid g(4, 4, 64 * 64);
+		g.label("grid");
+		vector<Memory::PlaneRecord> r = Memory::records();
+		return_code |= check("grid: the slab alone", r.size() == 1 && r[0].plane == Memory::PLANE_SLAB && r[0].label == "grid" && r[0].bytes >= g.bytes());
+	}
+	return_code |= check("grid: freed with the grid", Memory::currentBytes() == 0);
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_comm.hpp"
+
+using namespace ManSeg;
+using namespace ManSeg::comm;
+using namespace std;
+
+int fail(const int& rank, const char* what)
+{
+	cerr << "rank " << rank << ": " << what << "\n";
+	return 1;
+}
+
+double value(const uint64_t& g) { return 1.0 + sin(g) * 0.5 + g * 1e-9; }
+
+double head(const double& v)
+{
+	float h = 0.0f;
+	HeadsSpan(&h, nullptr, 1).set(0, v);
+	return HeadsSpan(&h, nullptr, 1).read(0);
+}
+
+int main(int argc, char* argv[])
+{
+	MPI_Init(&argc, &argv);
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	int return_code = 0;
+
+	// process r owns 1000 + 10r elements, from bounds[r]
+	const int n = 1000 + 10 * rank;
+	vector<int> counts(size);
+	MPI_Allgather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+	vector<uint64_t> bounds(size + 1, 0);
+	for(int r = 0; r < size; ++r)
+		bounds[r + 1] = bounds[r] + counts[r];
+	ManSegArray x(n);
+	for(int i = 0; i < n; ++i)
+		x.pairs.set(i, value(bounds[rank] + i));
+
+	// reductions at the heads, and of the pairs exactly
+	vector<float> heads(x.heads.getHeads(), x.heads.getHeads() + 100), maxHeads(heads);
+	for(int i = 0; i < 100; ++i)
+		HeadsSpan(maxHeads.data(), nullptr, 100).set(i, value(i) * (rank + 1));
+	allreduceHeads(heads.data(), 100, MPI_SUM, MPI_COMM_WORLD);
+	allreduceHeads(maxHeads.data(), 100, MPI_MAX, MPI_COMM_WORLD);
+	vector<float> h(x.heads.getHeads(), x.heads.getHeads() + 100), t(x.heads.getTails(), x.heads.getTails() + 100);
+	allreducePairs(h.data(), t.data(), 100, MPI_SUM, MPI_COMM_WORLD);
+	for(int i = 0; i < 100; ++i)
+	{
+		double sum = 0.0;
+		for(int r = 0; r < size; ++r)
+			sum += value(bounds[r] + i);
+		double exact = 0.0;
+		const double mine = x.pairs.read(i);
+		MPI_Allreduce(&mine, &exact, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		if(fabs(HeadsSpan(heads.data(), nullptr, 100).read(i) - sum) > size * ldexp(sum, -20))
+			return_code |= fail(rank, "wrong sum of the heads");
+		if(HeadsSpan(maxHeads.data(), nullptr, 100).read(i) != head(value(i) * size))
+			return_code |= fail(rank, "wrong max of the heads");
+		if(PairsSpan(h.data(), t.data(), 100).read(i) != exact)
+			return_code |= fail(rank, "wrong sum of the pairs");
+		if(return_code) break;
+	}
+
+	// every 7th element of the others
+	vector<uint64_t> ghosts;
+	for(uint64_t g = 0; g < bounds[size]; g += 7)
+		if(g < bounds[rank] || g >= bounds[rank + 1])
+			ghosts.push_back(g);
+	ExchangePattern pattern = exchangePattern(ghosts, bounds, MPI_COMM_WORLD);
+	if(pattern.numReceived() != (int)ghosts.size())
+		return_code |= fail(rank, "wrong number of values received");
+	for(int k = 0; k < pattern.numSent(); ++k)
+		if(pattern.sendIndex[k] % 7 != (7 - bounds[rank] % 7) % 7 || pattern.sendIndex[k] >= (uint64_t)n)
+		{
+			return_code |= fail(rank, "a value sent is not one asked for");
+			break;
+		}
+
+	// heads and doubles through the exchange, and blocking
+	SegmentExchange<false> headsExchange(pattern);
+	SegmentExchange<true> pairsExchange(pattern);
+	headsExchange.pack(x.heads);
+	pairsExchange.pack(x.pairs);
+	headsExchange.start();
+	pairsExchange.start();
+	headsExchange.wait();
+	pairsExchange.wait();
+	vector<float> blocking(ghosts.size());
+	alltoallvHeads(pattern, x.heads, blocking.data());
+	for(size_t g = 0; g < ghosts.size(); ++g)
+		if(headsExchange.received(g) != head(value(ghosts[g])) || pairsExchange.received(g) != value(ghosts[g])
+			|| HeadsSpan(blocking.data(), nullptr, ghosts.size()).read(g) != head(value(ghosts[g])))
+		{
+			return_code |= fail(rank, "a value received is not the one sent");
+			break;
+		}
+
+	// the tails of every third value received
+	vector<uint_fast64_t> wanted;
+	for(size_t g = 0; g < ghosts.size(); g += 3)
+		wanted.push_back(g);
+	vector<float> tails(ghosts.size(), 0.0f);
+	fetchTails(pattern, x.heads.getTails(), wanted, tails.data());
+	PairsSpan received(headsExchange.heads(), tails.data(), ghosts.size());
+	for(size_t g = 0; g < ghosts.size(); ++g)
+		if(received.read(g) != (g % 3 == 0 ? value(ghosts[g]) : head(value(ghosts[g]))))
+		{
+			return_code |= fail(rank, "wrong tails on demand");
+			break;
+		}
+
+	x.del();
+	MPI_Allreduce(MPI_IN_PLACE, &return_code, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(return_code == 0 && rank == 0)
+		cout << "mpi comm (" << size << " processes): all tests passed\n";
+	MPI_Finalize();
+	return return_code;
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_multigrid.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// the right hand side of the grid, random, written at full precision
+void fillRhs(Multigrid& mg, const int& NB, const int& B, mt19937& gen)
+{
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+	for(int ii = 0; ii < NB; ++ii)
+		for(int jj = 0; jj < NB; ++jj)
+			for(int k = 0; k < B*B; ++k)
+				mg.rhs()[ii][jj].pairs[k] = dist(gen);
+}
+
+/*
+	V-cycles of an NB x NB grid of B x B blocks at the pairs, from zero, until the residual is below
+	tol times the first; fails if that takes more than maxCycles.
+*/
+int converges(const char* name, const int& NB, const int& B, const uint_fast64_t& levels, const int& maxCycles, mt19937& gen)
+{
+	Multigrid mg(NB, B);
+	fillRhs(mg, NB, B, gen);
+	if(mg.numLevels() != levels)
+	{
+		cerr << name << ": " << mg.numLevels() << " levels, expected " << levels << "\n";
+		return 1;
+	}
+	const double first = mg.residual(PRECISION_FULL);
+	int cycles = 0;
+	double r = first;
+	while(r > 1e-10 * first && cycles < maxCycles)
+	{
+		mg.vcycle(PRECISION_FULL);
+		++cycles;
+		r = mg.residual(PRECISION_FULL);
+	}
+	cout << name << ": residual " << first << " to " << r << " in " << cycles << " cycles, coarsest "
+		 << mg.side(mg.numLevels() - 1) << " x " << mg.side(mg.numLevels() - 1) << "\n";
+	if(r > 1e-10 * first)
+	{
+		cerr << name << ": did not converge in " << maxCycles << " cycles\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	cout << scientific << setprecision(3);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-2.0, 2.0);
+
+	int return_code = 0;
+
+	// stencilRow with a right hand side against the element-wise sweep, 13 leaving a remainder after the vector loop
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int n = 13;
+		vector<double> up(n + 2), row(n + 2), down(n + 2), rhs(n), out(n);
+		for(int j = 0; j < n + 2; ++j) { up[j] = dist(gen); row[j] = dist(gen); down[j] = dist(gen); }
+		for(int j = 0; j < n; ++j) rhs[j] = dist(gen);
+		double delta = stencilRow(up.data(), row.data(), down.data(), rhs.data(), n, 0.2, out.data());
+		double expectedDelta = 0.0;
+		for(int j = 0; j < n; ++j)
+		{
+			double expected = 0.2 * (row[j + 1] + row[j] + up[j + 1] + row[j + 2] + down[j + 1] + rhs[j]);
+			expectedDelta = max(expectedDelta, fabs(expected - row[j + 1]));
+			if(out[j] != expected)
+			{
+				cerr << "stencilRow with rhs: value [" << j << "] " << out[j] << ", expected " << expected << "\n";
+				return_code = 1;
+			}
+		}
+		if(delta != expectedDelta)
+		{
+			cerr << "stencilRow with rhs: delta " << delta << ", expected " << expectedDelta << "\n";
+			return_code = 1;
+		}
+	}
+	setSimdLevel(detectSimdLevel());
+
+	// the number of cycles does not grow with the grid: halved blocks, merged blocks, and an odd coarsest side
+	return_code |= converges("4 x 4 blocks of 16", 4, 16, 6, 20, gen);
+	return_code |= converges("16 x 16 blocks of 16", 16, 16, 8, 20, gen);
+	return_code |= converges("3 x 3 blocks of 20", 3, 20, 2, 40, gen);
+
+	// at the heads the residual stalls, and once the controller leaves them the pairs carry on from there
+	{
+		const int NB = 8, B = 16;
+		Multigrid mg(NB, B);
+		fillRhs(mg, NB, B, gen);
+		const double first = mg.residual(PRECISION_FULL);
+		PrecisionController<StagnationPolicy> control(StagnationPolicy(0.5), false, INFINITY);
+		int cycles = 0;
+		while(control.level() == PRECISION_HEADS && cycles < 40)
+		{
+			control.update(mg.vcycle(control.level()));
+			++cycles;
+		}
+		const double atSwitch = mg.residual(PRECISION_FULL);
+		cout << "heads: stalled at " << atSwitch / first << " of the first residual after " << cycles << " cycles\n";
+		if(control.level() != PRECISION_FULL || atSwitch < 1e-8 * first)
+		{
+			cerr << "heads: the residual did not stall at the heads\n";
+			return_code = 1;
+		}
+		// the promotion is exact: the pairs read the values the heads left
+		vector<double> h(B*B), p(B*B);
+		for(int ii = 0; ii < NB; ++ii)
+			for(int jj = 0; jj < NB; ++jj)
+			{
+				mg.solution()[ii][jj].heads.readBlock(0, B*B, h.data());
+				mg.solution()[ii][jj].pairs.readBlock(0, B*B, p.data());
+				if(h != p)
+				{
+					cerr << "heads: the pairs of block (" << ii << ", " << jj << ") are not the values at the heads\n";
+					return_code = 1;
+				}
+			}
+		for(int i = 0; i < 20; ++i)
+			control.update(mg.vcycle(control.level()));
+		const double r = mg.residual(PRECISION_FULL);
+		cout << "pairs: " << r / first << " of the first residual after 20 more cycles\n";
+		if(r > 1e-10 * first)
+		{
+			cerr << "pairs: did not converge after the switch\n";
+			return_code = 1;
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
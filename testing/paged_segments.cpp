@@ -0,0 +1,89 @@
+#include <iostream>
+#include <cmath>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_pages.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 300001;     // over a large page of doubles, not a whole number of them
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// whether the array holds the values written by fill, and its tails were zero before
+bool roundTrip(PagedManSegArray& x)
+{
+	for(int i = 0; i < length; ++i)
+		if(x.heads.getTails()[i] != 0.0f || x.full[i] != 0.0)
+			return false;
+	for(int i = 0; i < length; ++i)
+	{
+		x.pairs.set(i, 1.0 + sin(i) * 0.5 + i * 1e-9);
+		x.full[i] = x.pairs.read(i);
+	}
+	for(int i = 0; i < length; ++i)
+		if(x.pairs.read(i) != 1.0 + sin(i) * 0.5 + i * 1e-9 || x.full[i] != x.pairs.read(i))
+			return false;
+	return true;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	// ordinary pages, placed by the system: zero-filled and as any array
+	{
+		PagedManSegArray x(length);
+		x.allocFull();
+		if(!roundTrip(x))
+			return_code |= fail("an array of ordinary pages does not hold its values");
+		x.demote(true);
+		for(int i = 0; i < length; ++i)
+			if(x.heads.getTails()[i] != 0.0f)
+			{
+				return_code |= fail("dropped tails are not zero");
+				break;
+			}
+	}
+
+	// large pages, whether or not the system has any to give, on node 0, which always exists
+	{
+		PagedManSegArray x(length, PagedSegmentAllocator(true, 0));
+		x.allocFull();
+		if(!roundTrip(x))
+			return_code |= fail("an array of large pages does not hold its values");
+	}
+
+	// a node that does not exist is only a warning
+	{
+		PagedManSegArray x(length, PagedSegmentAllocator(false, 1000));
+		x.allocFull();
+		if(!roundTrip(x))
+			return_code |= fail("an array on a missing node does not work");
+	}
+
+	// the environment
+	setenv("MANSEG_LARGE_PAGES", "1", 1);
+	setenv("MANSEG_NODE", "0", 1);
+	PagedSegmentAllocator pages = PagedSegmentAllocator::fromEnvironment();
+	if(!pages.largePages || pages.node != 0)
+		return_code |= fail("the policy is not read from the environment");
+	setenv("MANSEG_LARGE_PAGES", "0", 1);
+	unsetenv("MANSEG_NODE");
+	pages = PagedSegmentAllocator::fromEnvironment();
+	if(pages.largePages || pages.node != -1)
+		return_code |= fail("unset, the policy is not ordinary pages anywhere");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <math.h>
+#include <omp.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 64;
+constexpr int updates = 100000;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	int return_code = 0;
+
+	// heads: whole numbers up to 2^20 are exact with 20 bits of mantissa
+	HeadsArray h(length);
+	for(int i = 0; i < length; ++i)
+		h[i] = 0.0;
+
+	#pragma omp parallel for schedule(static, 1)
+	for(int k = 0; k < updates * length; ++k)
+		atomicAdd(h, k % length, 1.0);
+
+	for(int i = 0; i < length; ++i)
+	{
+		if(h[i] != (double)updates)
+		{
+			cerr << "heads atomicAdd value [" << i << "] mismatch\n";
+			cerr << "expected = " << (double)updates << ", actual = " << h[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// pairs: 2^-30 only lands in the tail, so lost updates to either segment are detected
+	const double inc = ldexp(1.0, -30);
+	PairsArray p(length);
+	for(int i = 0; i < length; ++i)
+		p[i] = 1.0;
+
+	#pragma omp parallel for schedule(static, 1)
+	for(int k = 0; k < updates * length; ++k)
+		atomicAdd(p, k % length, inc);
+
+	const double expected = 1.0 + updates * inc;
+	for(int i = 0; i < length; ++i)
+	{
+		if(p[i] != expected)
+		{
+			cerr << "pairs atomicAdd value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << p[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// atomicMin: each element is offered a descending run of values, interleaved between the threads,
+	// and keeps the smallest; an offer that is not smaller leaves it alone
+	HeadsArray m(length);
+	PairsArray pm(length);
+	vector<double> fullMin(length);
+	FullView f(fullMin.data(), length);
+	for(int i = 0; i < length; ++i)
+	{
+		m[i] = 1e9;
+		pm[i] = 1e9;
+		fullMin[i] = 1e9;
+	}
+
+	#pragma omp parallel for schedule(static, 1)
+	for(int k = 0; k < updates * length; ++k)
+	{
+		const double offer = 1.0 + (updates - 1 - k / length) * ldexp(1.0, -20);
+		atomicMin(m, k % length, offer);
+		atomicMin(pm, k % length, offer + inc);
+		atomicMin(f, k % length, offer);
+	}
+
+	for(int i = 0; i < length; ++i)
+	{
+		if(m[i] != 1.0 || pm[i] != 1.0 + inc || fullMin[i] != 1.0 || atomicMin(m, i, 1.0) || !atomicMin(m, i, 0.5))
+		{
+			cerr << "atomicMin value [" << i << "] mismatch\n";
+			cerr << "expected = 1, actual = " << m[i] << " and " << fullMin[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	h.del();
+	p.del();
+	m.del();
+	pm.del();
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,181 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_expr.hpp"
+#include "../manseglib_rank.hpp"
+#include "../manseglib_sparse.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 100003;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	vector<double> values(length);
+	for(auto& v : values)
+		v = dist(gen);
+
+	// every index is visited once, by consecutive chunks
+	for(uint_fast64_t n : { 0, 1, 4096, 4097, 100003 })
+	{
+		vector<atomic<int> > visits(n);
+		for(auto& v : visits)
+			v = 0;
+		atomic<uint_fast64_t> chunks(0);
+		parallelFor(n, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+		{
+			++chunks;
+			for(uint_fast64_t i = begin; i < end; ++i)
+				++visits[i];
+		});
+		for(uint_fast64_t i = 0; i < n; ++i)
+			if(visits[i] != 1)
+			{
+				return_code |= fail("wrong parallelFor coverage");
+				break;
+			}
+		if(chunks != parallelChunks(n))
+			return_code |= fail("wrong number of chunks");
+	}
+	// parts are covered by chunks that never cross a bound, empty parts included
+	const uint_fast64_t bounds[] = { 0, 0, 1000, 1000, 50000, 100003 };
+	vector<atomic<int> > visits(length);
+	for(auto& v : visits)
+		v = 0;
+	atomic<int> crossed(0);
+	parallelForPartitions(bounds, 5, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+	{
+		const uint_fast64_t* part = upper_bound(bounds, bounds + 6, begin);
+		if(end > *part || begin >= end)
+			++crossed;
+		for(uint_fast64_t i = begin; i < end; ++i)
+			++visits[i];
+	}, 1000);
+	for(int i = 0; i < length; ++i)
+		if(visits[i] != 1)
+		{
+			return_code |= fail("wrong parallelForPartitions coverage");
+			break;
+		}
+	if(crossed != 0)
+		return_code |= fail("a chunk crossed a partition bound");
+
+	// nested loops run too
+	atomic<uint_fast64_t> nested(0);
+	parallelFor(8, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+	{
+		for(uint_fast64_t i = begin; i < end; ++i)
+			parallelFor(10000, [&](const uint_fast64_t& b, const uint_fast64_t& e) { nested += e - b; });
+	}, 1);
+	if(nested != 80000)
+		return_code |= fail("wrong nested parallelFor");
+
+	// the chunk values are combined in order: concatenating the chunk ranges gives [0, n)
+	vector<uint_fast64_t> order = parallelReduce<vector<uint_fast64_t> >(length, vector<uint_fast64_t>(),
+		[](const uint_fast64_t& begin, const uint_fast64_t& end) { return vector<uint_fast64_t>{ begin, end }; },
+		[](vector<uint_fast64_t> a, const vector<uint_fast64_t>& b) { a.insert(a.end(), b.begin(), b.end()); return a; });
+	if(order.empty() || order.front() != 0 || order.back() != static_cast<uint_fast64_t>(length))
+		return_code |= fail("wrong parallelReduce range");
+	for(size_t i = 1; i + 1 < order.size(); i += 2)
+		if(order[i] != order[i + 1])
+			return_code |= fail("parallelReduce combined out of order");
+	const uint_fast64_t count = parallelReduce<uint_fast64_t>(length, 0,
+		[](const uint_fast64_t& begin, const uint_fast64_t& end) { return end - begin; },
+		[](const uint_fast64_t& a, const uint_fast64_t& b) { return a + b; });
+	if(count != static_cast<uint_fast64_t>(length))
+		return_code |= fail("wrong parallelReduce count");
+
+	// the bulk operations give the serial results
+	ManSegArray x(length);
+	x.pairs.writeBlock(0, length, values.data());
+	x.copytoIEEEdouble();
+	for(int i = 0; i < length; ++i)
+		if(x.full[i] != x.heads[i])
+		{
+			return_code |= fail("wrong copytoIEEEdouble");
+			break;
+		}
+	for(int i = 0; i < length; ++i)
+		x.full[i] = values[i];
+	x.demote();
+	for(int i = 0; i < length; ++i)
+		if(x.pairs.read(i) != values[i])
+		{
+			return_code |= fail("wrong demotion to the pairs");
+			break;
+		}
+
+	vector<int32_t> idx(length);
+	for(auto& i : idx)
+		i = gen() % length;
+	vector<double> out(length);
+	parallelGather(x.pairs, idx.data(), length, out.data());
+	for(int i = 0; i < length; ++i)
+		if(out[i] != values[idx[i]])
+		{
+			return_code |= fail("wrong pairs gather");
+			break;
+		}
+	parallelGather(x.heads, idx.data(), length, out.data());
+	for(int i = 0; i < length; ++i)
+		if(out[i] != x.heads[idx[i]])
+		{
+			return_code |= fail("wrong heads gather");
+			break;
+		}
+
+	parallelFill(x.pairs, 10, length - 20, 0.1);
+	if(x.pairs.read(9) != values[9] || x.pairs.read(10) != 0.1 || x.pairs.read(length - 11) != 0.1 || x.pairs.read(length - 10) != values[length - 10])
+		return_code |= fail("wrong pairs fill");
+	parallelFill<ROUND_NEAREST>(x.heads, 0, length, 0.1);
+	for(int i = 0; i < length; ++i)
+		if(x.heads[i] != headToDouble(roundToHead<ROUND_NEAREST>(0.1)))
+		{
+			return_code |= fail("wrong heads fill");
+			break;
+		}
+
+	// reductions, ranks and masks over chunks agree with the serial versions
+	x.pairs.writeBlock(0, length, values.data());
+	if(fabs(parallelKahanSum(x.pairs, 0, length) - kahanSum(x.pairs, 0, length)) > 1e-9)
+		return_code |= fail("wrong parallel sum");
+	vector<uint_fast64_t> top = topK(x.pairs, length, 50);
+	vector<uint_fast64_t> expected(length);
+	for(int i = 0; i < length; ++i)
+		expected[i] = i;
+	partial_sort(expected.begin(), expected.begin() + 50, expected.end(), [&](const uint_fast64_t& a, const uint_fast64_t& b)
+	{
+		return values[a] > values[b] || (values[a] == values[b] && a < b);
+	});
+	expected.resize(50);
+	if(top != expected)
+		return_code |= fail("wrong top k");
+	PromotionMask mask(length);
+	uint_fast64_t above = 0;
+	for(int i = 0; i < length; ++i)
+		above += x.heads[i] >= 5.0;
+	if(mask.markAbove(x.heads.getHeads(), 5.0) != above)
+		return_code |= fail("wrong number of marked elements");
+
+	x.del();
+
+	if(return_code == 0)
+		cout << "parallel backend (" << parallelWorkers() << " workers): all tests passed\n";
+	return return_code;
+}
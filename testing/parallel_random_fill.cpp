@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <math.h>
+#include <omp.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr uint_fast64_t length = 100003;
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+
+	// the first outputs of splitmix64 seeded with 1234567
+	if(counterRandom(1234567, 0) != 6457827717110365317ull || counterRandom(1234567, 1) != 3203168211198807973ull)
+	{
+		cerr << "counterRandom is not splitmix64: " << counterRandom(1234567, 0) << "\n";
+		return_code = 1;
+	}
+
+	// the same array on one worker and on four, and filled in two pieces
+	vector<double> one(length), four(length), pieces(length);
+	omp_set_num_threads(1);
+	fillRandom(FullView(one.data(), length), 0, length, 42, UniformRandom(-1.0, 1.0));
+	omp_set_num_threads(4);
+	fillRandom(FullView(four.data(), length), 0, length, 42, UniformRandom(-1.0, 1.0));
+	fillRandom(FullView(pieces.data(), length), 0, 1000, 42, UniformRandom(-1.0, 1.0));
+	fillRandom(FullView(pieces.data(), length), 1000, length - 1000, 42, UniformRandom(-1.0, 1.0));
+	if(one != four || one != pieces)
+	{
+		cerr << "the fill depends on the workers or the pieces\n";
+		return_code = 1;
+	}
+
+	// the pairs hold the values, the heads their heads
+	PairsArray p(length);
+	HeadsArray h(length);
+	fillRandom(p, 0, length, 42, UniformRandom(-1.0, 1.0));
+	fillRandom(h, 0, length, 42, UniformRandom(-1.0, 1.0));
+	for(uint_fast64_t i = 0; i < length; ++i)
+		if(p[i] != one[i] || h.getHeads()[i] != headOf(one[i]))
+		{
+			cerr << "value " << i << " reads " << p[i] << " and " << h[i] << " for " << one[i] << "\n";
+			return_code = 1;
+			break;
+		}
+
+	// the moments are those of the distributions, to a few standard errors
+	double mean = 0.0, square = 0.0, lowest = 1.0, highest = -1.0;
+	for(const double& v : one)
+	{
+		mean += v;
+		lowest = min(lowest, v);
+		highest = max(highest, v);
+	}
+	mean /= length;
+	if(fabs(mean) > 4.0 * sqrt(1.0 / 3.0 / length) || lowest < -1.0 || highest >= 1.0)
+	{
+		cerr << "uniform mean " << mean << " in [" << lowest << ", " << highest << "]\n";
+		return_code = 1;
+	}
+	vector<double> normal(length);
+	fillRandom(FullView(normal.data(), length), 0, length, 7, NormalRandom(2.0, 0.5));
+	mean = 0.0;
+	for(const double& v : normal)
+		mean += v;
+	mean /= length;
+	for(const double& v : normal)
+		square += (v - mean) * (v - mean);
+	const double sd = sqrt(square / (length - 1));
+	if(fabs(mean - 2.0) > 4.0 * 0.5 / sqrt(length) || fabs(sd - 0.5) > 0.01)
+	{
+		cerr << "normal mean " << mean << " and deviation " << sd << "\n";
+		return_code = 1;
+	}
+
+	// another seed, another array
+	vector<double> other(length);
+	fillRandom(FullView(other.data(), length), 0, length, 43, UniformRandom(-1.0, 1.0));
+	if(other == one)
+	{
+		cerr << "the seed is ignored\n";
+		return_code = 1;
+	}
+
+	p.del();
+	h.del();
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
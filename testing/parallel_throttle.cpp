@@ -0,0 +1,112 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+
+#include <omp.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_throttle.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int threads = 8;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// an iteration whose bandwidth saturates at saturation threads
+double iterationSeconds(const unsigned& workers, const unsigned& saturation)
+{
+	return 1.0 / min(workers, saturation);
+}
+
+// runs iterations of phase until the throttle settles on it, checking the loops follow its count
+int tune(ThreadThrottle& throttle, const char* phase, const unsigned& saturation, int& iterations)
+{
+	int return_code = 0;
+	iterations = 0;
+	do
+	{
+		throttle.phase(phase);
+		const unsigned w = throttle.workers();
+		if(omp_get_max_threads() != (int)w)
+			return_code |= fail("OpenMP's regions do not follow the throttle");
+		atomic<int> most(0);
+		#pragma omp parallel
+		{
+			#pragma omp single
+			most = omp_get_num_threads();
+		}
+		if(most > (int)w)
+			return_code |= fail("a region runs on more threads than the throttle allows");
+		throttle.update(iterationSeconds(w, saturation), 1e9);
+		++iterations;
+	}
+	while(throttle.tuning() && iterations < 100);
+	return return_code;
+}
+
+int main()
+{
+	int return_code = 0;
+	omp_set_num_threads(threads);
+
+	// a limit on the workers, and lifting it
+	setParallelWorkers(3);
+	if(parallelWorkers() != 3 || parallelMaxWorkers() != threads || omp_get_max_threads() != 3)
+		return_code |= fail("the limit is not set");
+	if(parallelChunks(1 << 24) > ChunksPerWorker * 3)
+		return_code |= fail("the chunks are not of the limited workers");
+	setParallelWorkers(0);
+	if(parallelWorkers() != threads || omp_get_max_threads() != threads)
+		return_code |= fail("the limit is not lifted");
+
+	// off, the throttle changes nothing
+	{
+		ThreadThrottle off(0);
+		off.phase("heads");
+		off.update(1.0, 1.0);
+		if(off.enabled() || off.tuning() || parallelWorkers() != threads)
+			return_code |= fail("a disabled throttle changes the workers");
+	}
+
+	{
+		ThreadThrottle throttle(1, 0.05, 1);
+		int iterations;
+		// saturating at 3 threads: 8 and 4 are as fast, 2 is slower, so the heads settle on 4
+		return_code |= tune(throttle, "heads", 3, iterations);
+		if(throttle.settled("heads") != 4 || throttle.workers() != 4)
+		{
+			cerr << "heads settled on " << throttle.settled("heads") << " after " << iterations << " iterations\n";
+			return_code |= 1;
+		}
+		// a new phase is tuned from all the threads again: saturating at 6, it keeps all 8
+		return_code |= tune(throttle, "full", 6, iterations);
+		if(throttle.settled("full") != threads || throttle.workers() != threads)
+			return_code |= fail("the full phase is not tuned again");
+		// a phase seen before takes up its count at once
+		throttle.phase("heads");
+		if(throttle.tuning() || throttle.workers() != 4)
+			return_code |= fail("a known phase is tuned again");
+		// with no gain from threads at all, the fewest
+		return_code |= tune(throttle, "flat", 1, iterations);
+		if(throttle.settled("flat") != 1)
+			return_code |= fail("a phase that gains nothing from threads does not settle on one");
+		if(throttle.settled("unknown") != 0)
+			return_code |= fail("a phase never seen has settled");
+	}
+	if(parallelWorkers() != threads || omp_get_max_threads() != threads)
+		return_code |= fail("the throttle does not give the threads back");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
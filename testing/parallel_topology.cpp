@@ -0,0 +1,144 @@
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+#include <stdlib.h>
+#include <sched.h>
+#include <omp.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_parallel.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int threads = 8;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// two sockets of one node each, four cores a socket and two threads a core, the siblings numbered
+// after all the first threads (cpu 16 + c is the sibling of cpu c), as Linux numbers most x86 machines
+vector<TopologyCpu> twoSockets()
+{
+	vector<TopologyCpu> cpus;
+	for(int t = 0; t < 2; ++t)
+		for(int s = 0; s < 2; ++s)
+			for(int c = 0; c < 4; ++c)
+				cpus.push_back(TopologyCpu{ t * 8 + s * 4 + c, s, s, c, -1 });
+	return cpus;
+}
+
+// the cpu the calling thread may run on, or -1 for more than one
+int boundCpu()
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0, sizeof(set), &set) != 0 || CPU_COUNT(&set) != 1)
+		return -1;
+	for(int c = 0; c < CPU_SETSIZE; ++c)
+		if(CPU_ISSET(c, &set))
+			return c;
+	return -1;
+}
+
+int main()
+{
+	int return_code = 0;
+	setenv("MANSEG_BIND", "1", 1);
+	omp_set_num_threads(threads);
+
+	const ThreadTopology topo(twoSockets());
+	if(topo.cpus() != 16 || topo.nodes() != 2 || topo.sockets() != 2 || topo.cores() != 8 || topo.threadsPerCore() != 2)
+		return_code |= fail("the topology is not counted");
+	if(topo.cpu(12).thread != 1 || topo.cpu(12).core != 0 || topo.cpu(3).thread != 0)
+		return_code |= fail("the SMT threads are not found");
+
+	// a node's cpus: its cores' first threads, then their siblings
+	const vector<int> expected = { 4, 5, 6, 7, 12, 13, 14, 15 };
+	if(topo.cpusOfNode(1) != expected || !topo.cpusOfNode(2).empty())
+		return_code |= fail("the cpus of a node are not in binding order");
+
+	// Ligra's partition k of p is on node k / (p / nodes), the last node taking the rest
+	for(uint_fast64_t parts = 1; parts <= 9; ++parts)
+		for(uint_fast64_t k = 0; k < parts; ++k)
+		{
+			const uint_fast64_t perNode = max<uint_fast64_t>(1, parts / 2);
+			if(topo.nodeOfPartition(k, parts) != (int)min<uint_fast64_t>(k / perNode, 1))
+				return_code |= fail("a partition is not on Ligra's node");
+		}
+
+	// the owner of a partition is on its node, and no two workers share a cpu until they must
+	for(unsigned workers : { 2u, 4u, 8u, 16u })
+	{
+		vector<int> used;
+		for(unsigned w = 0; w < workers; ++w)
+		{
+			const int c = topo.cpuOfWorker(w, workers);
+			if(topo.cpu(c).node != topo.nodeOfWorker(w, workers))
+				return_code |= fail("a worker is not on its node");
+			used.push_back(c);
+		}
+		sort(used.begin(), used.end());
+		if(unique(used.begin(), used.end()) != used.end())
+			return_code |= fail("two workers share a cpu");
+		for(uint_fast64_t parts = 2; parts <= 32; parts *= 2)
+			for(uint_fast64_t p = 0; p < parts; ++p)
+				if(topo.nodeOfWorker(p * workers / parts, workers) != topo.nodeOfPartition(p, parts))
+					return_code |= fail("a partition's owner is not on its node");
+	}
+	// four workers take a core each, the first threads of their node's cores
+	if(topo.cpuOfWorker(1, 4) != 1 || topo.cpuOfWorker(2, 4) != 4 || topo.cpuOfWorker(3, 4) != 5)
+		return_code |= fail("workers take a sibling before a core");
+
+	// this machine's topology: every cpu the process may run on, once
+	const ThreadTopology& here = ThreadTopology::instance();
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	if(here.cpus() != (unsigned)CPU_COUNT(&allowed) || here.nodes() < 1 || here.cores() < 1 || here.cores() > here.cpus())
+		return_code |= fail("this machine's topology is not found");
+	for(unsigned i = 0; i < here.cpus(); ++i)
+		if(!CPU_ISSET(here.cpu(i).cpu, &allowed))
+			return_code |= fail("a cpu the process may not run on is in the topology");
+
+	// the team is bound, thread t to the cpu of worker t
+	vector<int> cpus(threads, -2);
+	if(!parallel::bindTeam())
+		return_code |= fail("MANSEG_BIND does not bind the team");
+	#pragma omp parallel
+	cpus[omp_get_thread_num()] = boundCpu();
+	for(int t = 0; t < threads; ++t)
+		if(cpus[t] != here.cpuOfWorker(t, threads))
+			return_code |= fail("a thread is not bound to its worker's cpu");
+
+	// and each part of parallelForPartitions is run by its owner, whole
+	const uint_fast64_t parts = 16, size = 1 << 16;
+	vector<uint_fast64_t> bounds(parts + 1);
+	for(uint_fast64_t p = 0; p <= parts; ++p)
+		bounds[p] = size * p / parts;
+	vector<int> by(size, -1);
+	parallelForPartitions(bounds.data(), parts, [&](const uint_fast64_t& begin, const uint_fast64_t& end)
+	{
+		for(uint_fast64_t i = begin; i < end; ++i)
+			by[i] = omp_get_thread_num();
+	}, 1024);
+	for(uint_fast64_t p = 0; p < parts; ++p)
+		for(uint_fast64_t i = bounds[p]; i < bounds[p + 1]; ++i)
+			if(by[i] != (int)(p * threads / parts))
+			{
+				return_code |= fail("a part is not run by its owner");
+				break;
+			}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
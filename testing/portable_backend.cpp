@@ -0,0 +1,122 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+// the scalar code used on targets without SSE or NEON
+#define MANSEG_PORTABLE
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+
+uint64_t bitsOf(const double& d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(double));
+	return bits;
+}
+
+uint32_t bitsOf(const float& f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(float));
+	return bits;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	uniform_int_distribution<int> pick(0, length - 1);
+
+	double* d = new double[length];
+	double* out = new double[length];
+	int32_t* idx = new int32_t[length];
+	for(int i = 0; i < length; ++i)
+	{
+		d[i] = dist(gen);
+		idx[i] = pick(gen);
+	}
+
+	int return_code = 0;
+
+	if(simdLevel() != SIMD_SSE2 || setSimdLevel(SIMD_AVX512) != SIMD_SSE2)
+	{
+		cerr << "portable build should only have the baseline level\n";
+		return_code = 1;
+	}
+
+	// element conversions against shifts of the bits
+	for(int i = 0; i < length; ++i)
+	{
+		const uint64_t bits = bitsOf(d[i]);
+		float head, tail;
+		splitSegment(d[i], &head, &tail);
+		if(bitsOf(head) != uint32_t(bits >> 32) || bitsOf(tail) != uint32_t(bits) || bitsOf(headOf(d[i])) != uint32_t(bits >> 32)
+			|| bitsOf(segmentsToDouble(head, tail)) != bits || bitsOf(headToDouble(head)) != (bits & 0xFFFFFFFF00000000ULL))
+		{
+			cerr << "element conversion [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// arrays, blocks and gathers
+	ManSegArray a(length);
+	a.pairs.writeBlock(0, length, d);
+	a.pairs.readBlock(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		if(out[i] != d[i] || (double)a.pairs[i] != d[i] || bitsOf((double)a.heads[i]) != (bitsOf(d[i]) & 0xFFFFFFFF00000000ULL))
+		{
+			cerr << "array value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	gather(a.pairs, idx, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		if(out[i] != d[idx[i]])
+		{
+			cerr << "gathered value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// expressions and atomics
+	double expected = 0.0;
+	for(int i = 0; i < length; ++i)
+		expected += 2.0 * d[i];
+	assign(a.pairs, 0, length, expr(a.pairs) * 2.0);
+	double sum = kahanSum(a.pairs, 0, length);
+	if(fabs(sum - expected) > 1e-9 * fabs(expected))
+	{
+		cerr << "sum: expected = " << expected << ", actual = " << sum << "\n";
+		return_code = 1;
+	}
+	double before = (double)a.pairs[3];
+	atomicAdd(a.pairs, 3, 0.5);
+	atomicAdd(a.heads, 4, 0.5);
+	if((double)a.pairs[3] != before + 0.5)
+	{
+		cerr << "atomicAdd incorrect\n";
+		return_code = 1;
+	}
+
+	delete[] d;
+	delete[] out;
+	delete[] idx;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
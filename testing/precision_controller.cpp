@@ -0,0 +1,191 @@
+#include <iostream>
+#include <iomanip>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_controller.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// feeds delta = start * rate^k until the controller leaves the heads, returning the number of updates
+template<class Policy>
+int runUntilSwitch(PrecisionController<Policy>& control, const double& start, const double& rate, const int& maxIter)
+{
+	double delta = start;
+	for(int i = 0; i < maxIter; ++i)
+	{
+		if(control.update(delta) != PRECISION_HEADS)
+			return i + 1;
+		delta *= rate;
+	}
+	return -1;
+}
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+
+	// absolute bound: 1 * 0.5^k <= 1e-3 first at k = 10, i.e. the 11th update
+	{
+		AbsoluteBoundPolicy bound(1e-3);
+		PrecisionController<> control(bound);
+		int switchAt = runUntilSwitch(control, 1.0, 0.5, 100);
+		if(switchAt != 11 || control.reason() != SWITCH_BOUND || control.level() != PRECISION_INTERIM
+			|| control.switchIteration(PRECISION_INTERIM) != 11 || control.switchDelta() != pow(0.5, 10))
+		{
+			cerr << "absolute bound switched at " << switchAt << " (" << control.reasonName() << ")\n";
+			return_code = 1;
+		}
+		// a single interim iteration, then full
+		if(control.update(1e-4) != PRECISION_FULL || control.switchIteration(PRECISION_FULL) != 12
+			|| control.update(1e-5) != PRECISION_FULL)
+		{
+			cerr << "interim step not followed by full precision\n";
+			return_code = 1;
+		}
+	}
+
+	// without interim, heads go straight to full
+	{
+		PrecisionController<> control(AbsoluteBoundPolicy(), false);
+		control.update(1.0);
+		if(control.update(AdaptivePrecisionBound) != PRECISION_FULL || control.switchIteration(PRECISION_INTERIM) != -1)
+		{
+			cerr << "controller without interim did not go to full\n";
+			return_code = 1;
+		}
+	}
+
+	// stagnation: deltas halve, then stop improving
+	{
+		PrecisionController<StagnationPolicy> control(StagnationPolicy(0.25));
+		const double deltas[] = { 1.0, 0.5, 0.25, 0.125, 0.12, 0.119 };
+		int switchAt = -1;
+		for(int i = 0; i < 6 && switchAt < 0; ++i)
+			if(control.update(deltas[i]) != PRECISION_HEADS)
+				switchAt = i + 1;
+		if(switchAt != 5 || control.reason() != SWITCH_STAGNATION || fabs(control.policy().change - 0.04) > 1e-12)
+		{
+			cerr << "stagnation switched at " << switchAt << " (" << control.reasonName() << ")\n";
+			return_code = 1;
+		}
+	}
+
+	// stagnation measured over several iterations
+	{
+		PrecisionController<StagnationPolicy> control(StagnationPolicy(0.5, 3));
+		// the first check compares 0.8^2 with the initial 2.0; the second sees 0.8^5 / 0.8^2 = 0.512, a 48.8% decrease
+		int switchAt = runUntilSwitch(control, 1.0, 0.8, 100);
+		if(switchAt != 6)
+		{
+			cerr << "stagnation with check frequency 3 switched at " << switchAt << "\n";
+			return_code = 1;
+		}
+	}
+
+	// predicted iterations: at rate 0.1 from 1, the bound 1e-5 is 5 iterations away from the first delta
+	{
+		PredictedIterationsPolicy predict(1e-5, 2.5);
+		PrecisionController<PredictedIterationsPolicy> control(predict, true, 10.0);
+		// deltas 1, 0.1, 0.01, 0.001: predictions 5, 4, 3, 2
+		int switchAt = runUntilSwitch(control, 1.0, 0.1, 100);
+		if(switchAt != 4 || control.reason() != SWITCH_PREDICTED)
+		{
+			cerr << "prediction switched at " << switchAt << " (" << control.reasonName() << ")\n";
+			return_code = 1;
+		}
+	}
+
+	// residual history: at rate 0.9 the residual is 0.9^4 = 0.6561 of its value 4 iterations earlier
+	{
+		PrecisionController<ResidualHistoryPolicy> fast(ResidualHistoryPolicy(4, 0.7), false);
+		int fastAt = runUntilSwitch(fast, 1.0, 0.9, 50);
+		PrecisionController<ResidualHistoryPolicy> slow(ResidualHistoryPolicy(4, 0.6), false);
+		int slowAt = runUntilSwitch(slow, 1.0, 0.9, 100);
+		// the window is only judged once it is full: the fifth residual against the first
+		if(fastAt != -1 || slowAt != 5 || slow.reason() != SWITCH_STAGNATION
+			|| fabs(slow.policy().change - 0.6561) > 1e-12)
+		{
+			cerr << "residual history switched at " << fastAt << " and " << slowAt << " (" << slow.reasonName() << ")\n";
+			return_code = 1;
+		}
+		// a residual at the floor switches at once, whatever its history
+		PrecisionController<ResidualHistoryPolicy> floor(ResidualHistoryPolicy(4, 0.5, 2e-3), false);
+		int floorAt = runUntilSwitch(floor, 1.0, 0.1, 100);
+		if(floorAt != 4 || floor.reason() != SWITCH_FLOOR)
+		{
+			cerr << "residual floor switched at " << floorAt << " (" << floor.reasonName() << ")\n";
+			return_code = 1;
+		}
+	}
+
+	// combined policies report whichever fired
+	{
+		typedef EitherPolicy<AbsoluteBoundPolicy, StagnationPolicy> Either;
+		PrecisionController<Either> control(Either(AbsoluteBoundPolicy(1e-9), StagnationPolicy(0.25)));
+		int switchAt = runUntilSwitch(control, 1.0, 0.9, 100);
+		if(switchAt != 2 || control.reason() != SWITCH_STAGNATION)
+		{
+			cerr << "combined policy switched at " << switchAt << " (" << control.reasonName() << ")\n";
+			return_code = 1;
+		}
+	}
+
+	// shadow error: delta * rate <= truncation, 0.5^(k+1) <= 1e-3 first at k = 9; at the bound until estimated
+	{
+		ShadowErrorPolicy shadow(1.0, 1e-3);
+		PrecisionController<ShadowErrorPolicy> bounded(shadow);
+		int boundAt = runUntilSwitch(bounded, 1.0, 0.5, 100);
+		shadow.truncation = 1e-3;
+		PrecisionController<ShadowErrorPolicy> control(shadow);
+		control.update(1.0);
+		control.update(0.5);
+		double remaining = control.iterationsToSwitch();  // 0.5^k <= 2e-3 at k = 9, 8 more
+		int switchAt = runUntilSwitch(control, 0.25, 0.5, 100) + 2;
+		if(boundAt != 11 || bounded.reason() != SWITCH_BOUND || switchAt != 10 || control.reason() != SWITCH_TRUNCATION
+			|| ceil(remaining) != 8.0)
+		{
+			cerr << "shadow error switched at " << switchAt << " (" << control.reasonName() << "), "
+				 << remaining << " predicted, at the bound at " << boundAt << "\n";
+			return_code = 1;
+		}
+	}
+
+	// policy chosen from the environment, keeping the driver's default for what is unset
+	{
+		unsetenv("MANSEG_SWITCH_POLICY");
+		unsetenv("MANSEG_SWITCH_PARAM");
+		ConfiguredPolicy fallback = ConfiguredPolicy::fromEnvironment(AbsoluteBoundPolicy(5e-3));
+		setenv("MANSEG_SWITCH_POLICY", "stagnation", 1);
+		ConfiguredPolicy stagnation = ConfiguredPolicy::fromEnvironment(AbsoluteBoundPolicy(5e-3));
+		setenv("MANSEG_SWITCH_PARAM", "0.15", 1);
+		PrecisionController<ConfiguredPolicy> control(ConfiguredPolicy::fromEnvironment());
+		int switchAt = runUntilSwitch(control, 1.0, 0.9, 100);
+		setenv("MANSEG_SWITCH_POLICY", "full", 1);
+		PrecisionController<ConfiguredPolicy> full(ConfiguredPolicy::fromEnvironment());
+		int fullAt = runUntilSwitch(full, 1.0, 0.9, 100);
+		unsetenv("MANSEG_SWITCH_POLICY");
+		unsetenv("MANSEG_SWITCH_PARAM");
+
+		if(fallback.kind != ConfiguredPolicy::BOUND || fallback.parameter() != 5e-3
+			|| stagnation.kind != ConfiguredPolicy::STAGNATION || stagnation.parameter() != 0.25
+			|| control.policy().parameter() != 0.15 || switchAt != 2 || control.reason() != SWITCH_STAGNATION
+			|| fullAt != 1 || full.reason() != SWITCH_FORCED)
+		{
+			cerr << "configured policy " << control.policy().name() << " switched at " << switchAt
+				 << ", full at " << fullAt << "\n";
+			return_code = 1;
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <iomanip>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_schedule.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// the level of each iteration is a constant expression
+static_assert(FixedSchedule<3>::levelAt(0) == PRECISION_HEADS, "");
+static_assert(FixedSchedule<3>::levelAt(2) == PRECISION_HEADS, "");
+static_assert(FixedSchedule<3>::levelAt(3) == PRECISION_INTERIM, "");
+static_assert(FixedSchedule<3>::levelAt(4) == PRECISION_FULL, "");
+static_assert(FixedSchedule<3, false>::levelAt(3) == PRECISION_FULL, "");
+static_assert(FixedSchedule<0>::levelAt(0) == PRECISION_FULL, "");
+static_assert(FixedSchedule<3>::switchIteration(PRECISION_INTERIM) == 3, "");
+static_assert(FixedSchedule<3>::switchIteration() == 4, "");
+static_assert(FixedSchedule<3, false>::switchIteration(PRECISION_INTERIM) == -1, "");
+static_assert(FixedSchedule<3, false>::switchIteration() == 3, "");
+
+// deltas start * rate^iter, recording the level each iteration ran at
+struct Geometric
+{
+	double start, rate;
+	int runs[3];
+	PrecisionLevel levels[64];
+	int count;
+
+	Geometric(const double& start, const double& rate) :start(start), rate(rate), count(0)
+	{
+		runs[0] = runs[1] = runs[2] = 0;
+	}
+
+	template<PrecisionLevel L>
+	double iterate(const int& iter)
+	{
+		if(iter != count)
+			cerr << "iteration " << iter << " run as the " << count << "th\n";
+		++runs[L];
+		levels[count++] = L;
+		return start * pow(rate, iter);
+	}
+
+	// the levels ran as Schedule says
+	template<class Schedule>
+	bool follows() const
+	{
+		for(int i = 0; i < count; ++i)
+			if(levels[i] != Schedule::levelAt(i))
+				return false;
+		return true;
+	}
+};
+
+int main()
+{
+	cout << setprecision(16);
+
+	int return_code = 0;
+
+	// 5 heads, the interim, and full until 0.5^k <= 1e-3 at k = 10: 11 iterations
+	{
+		typedef FixedSchedule<5> Schedule;
+		Geometric body(1.0, 0.5);
+		int iterations = runSchedule<Schedule>(body, 100, 1e-3);
+		if(iterations != 11 || !body.follows<Schedule>() || body.runs[PRECISION_HEADS] != 5
+			|| body.runs[PRECISION_INTERIM] != 1 || body.runs[PRECISION_FULL] != 5)
+		{
+			cerr << "fixed schedule ran " << iterations << " iterations\n";
+			return_code = 1;
+		}
+	}
+
+	// deltas at the heads are not checked: converging there still runs the interim and one full
+	{
+		typedef FixedSchedule<5> Schedule;
+		Geometric body(1.0, 0.01);
+		int iterations = runSchedule<Schedule>(body, 100, 1e-3);
+		if(iterations != 7 || !body.follows<Schedule>() || body.runs[PRECISION_FULL] != 1)
+		{
+			cerr << "fixed schedule converged at the heads after " << iterations << " iterations\n";
+			return_code = 1;
+		}
+	}
+
+	// maxIterations cuts the heads short, and nothing runs past it
+	{
+		typedef FixedSchedule<5> Schedule;
+		Geometric body(1.0, 0.5);
+		int iterations = runSchedule<Schedule>(body, 3, 1e-3);
+		Geometric interim(1.0, 0.5);
+		int interimIterations = runSchedule<Schedule>(interim, 6, 1e-3);
+		Geometric none(1.0, 0.5);
+		int noIterations = runSchedule<Schedule>(none, 0, 1e-3);
+		if(iterations != 3 || body.runs[PRECISION_HEADS] != 3 || body.runs[PRECISION_INTERIM] != 0
+			|| interimIterations != 6 || interim.runs[PRECISION_INTERIM] != 1 || interim.runs[PRECISION_FULL] != 0
+			|| noIterations != 0 || none.count != 0)
+		{
+			cerr << "fixed schedule ran " << iterations << ", " << interimIterations << " and " << noIterations
+				 << " iterations\n";
+			return_code = 1;
+		}
+	}
+
+	// without the interim, and full throughout
+	{
+		typedef FixedSchedule<4, false> Schedule;
+		Geometric body(1.0, 0.5);
+		int iterations = runSchedule<Schedule>(body, 100, 1e-3);
+		typedef FixedSchedule<0, false> Full;
+		Geometric full(1.0, 0.5);
+		int fullIterations = runSchedule<Full>(full, 100, 1e-3);
+		if(iterations != 11 || !body.follows<Schedule>() || body.runs[PRECISION_INTERIM] != 0
+			|| fullIterations != 11 || full.runs[PRECISION_FULL] != 11)
+		{
+			cerr << "schedule without interim ran " << iterations << " and " << fullIterations << " iterations\n";
+			return_code = 1;
+		}
+	}
+
+	// the controller decides the switch: 0.5^k <= 1e-2 first at k = 7, then the interim and full to 1e-4
+	{
+		PrecisionController<> control(AbsoluteBoundPolicy(1e-2));
+		Geometric body(1.0, 0.5);
+		int iterations = runSchedule(control, body, 100, 1e-4);
+		if(iterations != 15 || !body.follows<FixedSchedule<8> >() || control.level() != PRECISION_FULL
+			|| control.switchIteration(PRECISION_INTERIM) != 8 || control.switchIteration() != 9)
+		{
+			cerr << "controlled schedule ran " << iterations << " iterations, switching at "
+				 << control.switchIteration(PRECISION_INTERIM) << "\n";
+			return_code = 1;
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
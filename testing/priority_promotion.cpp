@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_expr.hpp"
+#include "../manseglib_rank.hpp"
+#include "../manseglib_sparse.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 10001;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	// a power law of ranks, in no particular order
+	ManSegArray x(length);
+	vector<double> values(length);
+	for(int i = 0; i < length; ++i)
+	{
+		values[i] = 1.0 / (1 + (i * 7919) % length) + i * 1e-12;
+		x.heads.set(i, values[i]);
+	}
+
+	// the quantile: at least the share asked for, and no more than the next 1/16 binade down
+	const double threshold = headsQuantile(x.heads.getHeads(), length, 0.01);
+	int above = 0, near = 0;
+	for(int i = 0; i < length; ++i)
+	{
+		const double h = x.heads.read(i);
+		above += h >= threshold;
+		near += h >= threshold * (1.0 + 1.0 / 16);
+	}
+	if(above < length / 100 || near > length / 100)
+		return_code |= fail("the quantile does not split off the share asked for");
+	if(!isinf(headsQuantile(x.heads.getHeads(), length, 0.0)) || headsQuantile(x.heads.getHeads(), length, 1.0) != -INFINITY)
+		return_code |= fail("wrong quantile for none or all");
+	const double largest = x.heads.read(topK(x.heads, length, 1)[0]);
+	const double top = headsQuantile(x.heads.getHeads(), length, 1.0 / length);
+	if(top > largest || top * (1.0 + 1.0 / 16) <= largest)
+		return_code |= fail("the quantile of one element is not the bucket of the largest head");
+
+	// the mask marks the heads at or above it
+	PromotionMask mask(length);
+	if(mask.markAbove(x.heads.getHeads(), threshold) != (uint_fast64_t)above || mask.numMarked() != (uint_fast64_t)above)
+		return_code |= fail("the mask does not count what it marks");
+	for(int i = 0; i < length; ++i)
+		if(mask.test(i) != (x.heads.read(i) >= threshold))
+		{
+			return_code |= fail("the mask marks the wrong elements");
+			break;
+		}
+
+	// promoted elements keep full precision, the rest stay at the heads
+	PromotedView v(x.heads.getHeads(), x.heads.getTails(), mask);
+	for(int i = 0; i < length; ++i)
+		if(v.read(i) != x.heads.read(i))
+		{
+			return_code |= fail("marking changed a value");
+			break;
+		}
+	for(int i = 0; i < length; ++i)
+		v.set(i, values[i]);
+	for(int i = 0; i < length; ++i)
+	{
+		const double expected = mask.test(i) ? values[i] : x.heads.read(i);
+		if(v[i] != expected || (!mask.test(i) && x.heads.getTails()[i] != 0.0f))
+		{
+			return_code |= fail("a value is not kept at its level");
+			break;
+		}
+	}
+
+	// subspans read the mask from their own start
+	PromotedView sub = v.subspan(333, 1000);
+	for(int i = 0; i < 1000; ++i)
+		if(sub.promoted(i) != mask.test(333 + i) || sub.read(i) != v.read(333 + i))
+		{
+			return_code |= fail("a subspan is not aligned with its mask");
+			break;
+		}
+
+	// sums over the view, and atomic adds at both levels
+	double sum = 0.0;
+	for(int i = 0; i < length; ++i)
+		sum += v.read(i);
+	if(fabs(kahanSum(v, 0, length) - sum) > 1e-12 * sum || fabs(kahanSum(sub, 0, 1000) - kahanSum(v, 333, 1000)) > 1e-15)
+		return_code |= fail("wrong sum of the view");
+	int promoted = 0, plain = 0;
+	while(!mask.test(promoted)) ++promoted;
+	while(mask.test(plain)) ++plain;
+	const double p0 = v.read(promoted), q0 = v.read(plain);
+	float head = 0.0f;
+	HeadsSpan(&head, nullptr, 1).set(0, q0 + 1e-10);
+	atomicAdd(v, promoted, 1e-10);
+	atomicAdd(v, plain, 1e-10);
+	if(v.read(promoted) != p0 + 1e-10 || v.read(plain) != HeadsSpan(&head, nullptr, 1).read(0))
+		return_code |= fail("wrong atomic add");
+
+	// marking one more element
+	mask.mark(plain);
+	mask.mark(plain);
+	if(!mask.test(plain) || mask.numMarked() != (uint_fast64_t)above + 1)
+		return_code |= fail("a single mark is not counted once");
+
+	x.del();
+
+	if(return_code == 0)
+		cout << "priority promotion: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_progressive.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1e6, 1e6);
+
+	const uint_fast64_t n = 100003, blockSize = 4096;
+	vector<double> values(n);
+	for(uint_fast64_t i = 0; i < n; ++i)
+		values[i] = dist(gen);
+
+	// promoted on demand only: the view reads the pairs until a set promotes the block
+	{
+		ManSegArray a(n);
+		a.pairs.writeBlock(0, n, values.data());
+		ArrayPromotion<> promotion(a, blockSize);
+		ProgressiveView<> v = promotion.view();
+		if(promotion.numBlocks() != 25 || promotion.numPromoted() != 0 || a.full == nullptr)
+			return_code |= fail("promotion did not start at the segments");
+		bool same = true;
+		for(uint_fast64_t i = 0; i < n; ++i)
+			same = same && v.read(i) == values[i];
+		if(!same)
+			return_code |= fail("unpromoted view does not read the pairs");
+
+		v.set(5 * blockSize + 7, 1.5);
+		if(!promotion.promoted(5) || promotion.numPromoted() != 1 || promotion.promoted(4) || !v.promoted(5 * blockSize)
+			|| a.full[5 * blockSize + 7] != 1.5 || a.full[5 * blockSize] != values[5 * blockSize])
+			return_code |= fail("set did not promote its block");
+		values[5 * blockSize + 7] = 1.5;
+
+		// the ordered promotion skips the block already promoted
+		if(!promotion.promoteNext() || !promotion.promoted(0) || promotion.numPromoted() != 2)
+			return_code |= fail("promoteNext did not promote the first block");
+
+		promotion.finish();
+		same = promotion.done() && promotion.numBackground() == 0;
+		for(uint_fast64_t i = 0; i < n; ++i)
+			same = same && a.full[i] == values[i] && v.read(i) == values[i];
+		if(!same)
+			return_code |= fail("finished promotion does not hold the values");
+		if(promotion.promoteNext())
+			return_code |= fail("promoteNext after finish");
+		a.del();
+	}
+
+	// from the heads alone, as copytoIEEEdouble
+	{
+		ManSegArray a(n);
+		a.heads.writeBlock(0, n, values.data());
+		ArrayPromotion<> promotion(a, blockSize, true);
+		ProgressiveView<> v = promotion.view();
+		promotion.finish();
+		bool same = true;
+		for(uint_fast64_t i = 0; i < n; ++i)
+			same = same && a.full[i] == (double)a.heads[i] && v.read(i) == (double)a.heads[i];
+		if(!same)
+			return_code |= fail("heads only promotion does not hold the heads");
+		a.del();
+	}
+
+	// in the background while threads read the array through the view, and write another
+	{
+		ManSegArray a(n), b(n);
+		a.pairs.writeBlock(0, n, values.data());
+		b.pairs.writeBlock(0, n, values.data());
+		ArrayPromotion<> in(a, blockSize), out(b, blockSize);
+		ProgressiveView<> x = in.view(), y = out.view();
+		in.start();
+		vector<thread> threads;
+		for(int t = 0; t < 4; ++t)
+			threads.push_back(thread([&x, &y, t, n]()
+			{
+				for(uint_fast64_t i = t; i < n; i += 4)
+					y.set(i, 2.0 * x.read(i));
+			}));
+		for(size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+		in.finish();
+		out.finish();
+		bool same = in.done() && out.done() && out.numBackground() == 0;
+		for(uint_fast64_t i = 0; i < n; ++i)
+			same = same && a.full[i] == values[i] && b.full[i] == 2.0 * values[i];
+		if(!same)
+			return_code |= fail("background promotion alongside readers and writers");
+		cout << in.numBackground() << " of " << in.numBlocks() << " blocks promoted in the background\n";
+		a.del();
+		b.del();
+	}
+
+	// every block is promoted exactly once, whoever asks for it
+	{
+		const uint_fast64_t blocks = 1000;
+		vector<atomic<int>> calls(blocks);
+		for(uint_fast64_t b = 0; b < blocks; ++b)
+			calls[b].store(0);
+		ProgressivePromotion promotion(blocks, [&calls](const uint_fast64_t& b) { calls[b].fetch_add(1); });
+		promotion.start();
+		vector<thread> threads;
+		for(int t = 0; t < 4; ++t)
+			threads.push_back(thread([&promotion, t, blocks]()
+			{
+				for(uint_fast64_t b = 0; b < blocks; ++b)
+				{
+					const uint_fast64_t id = (t % 2) ? blocks - 1 - b : (b * 7 + t) % blocks;
+					promotion.promote(id);
+					if(!promotion.promoted(id))
+						cerr << "block " << id << " not promoted after promote\n";
+				}
+			}));
+		for(size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+		promotion.finish();
+		bool once = promotion.done() && promotion.numBackground() <= blocks;
+		for(uint_fast64_t b = 0; b < blocks; ++b)
+			once = once && calls[b].load() == 1;
+		if(!once)
+			return_code |= fail("a block was not promoted exactly once");
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
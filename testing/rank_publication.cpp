@@ -0,0 +1,139 @@
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_publish.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 5000;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+double value(const int& i, const int& k) { return 1.0 / (1 + i) + k * 1e-9; }
+
+int main()
+{
+	int return_code = 0;
+	char path[] = "/tmp/manseg_publication_XXXXXX";
+	const int fd = mkstemp(path);
+	if(fd < 0)
+		return fail("cannot make a file to publish to");
+	close(fd);
+
+	// nothing to read yet
+	if(RankReader(path).isOpen())
+		return_code |= fail("an empty file is read as a publication");
+	RankPublisher out(path, length);
+	RankReader in(path);
+	if(!out.isOpen() || !in.isOpen() || in.capacity() != (uint_fast64_t)length)
+		return fail("cannot open the publication");
+	if(in.snapshot().valid() || in.epoch() != 0)
+		return_code |= fail("a snapshot before any publish");
+
+	// each level is read back as published
+	ManSegArray x(length);
+	for(int i = 0; i < length; ++i)
+		x.pairs.set(i, value(i, 0));
+	if(!out.publish(x.heads, length, 1, 0.5))
+		return_code |= fail("cannot publish the heads");
+	{
+		RankSnapshot s = in.snapshot();
+		if(!s.valid() || s.level() != ACCESS_HEADS || s.size() != (uint_fast64_t)length || s.epoch() != 1 || s.iteration() != 1 || s.delta() != 0.5)
+			return_code |= fail("wrong snapshot of the heads");
+		for(int i = 0; i < length; ++i)
+			if(s.read(i) != x.heads.read(i) || s.heads().read(i) != x.heads.read(i))
+			{
+				return_code |= fail("wrong heads read back");
+				break;
+			}
+	}
+	out.publish(x.pairs, length, 2, 0.25);
+	{
+		RankSnapshot s = in.snapshot();
+		for(int i = 0; i < length; ++i)
+			if(s.level() != ACCESS_PAIRS || s.read(i) != value(i, 0) || s.pairs().read(i) != value(i, 0))
+			{
+				return_code |= fail("wrong pairs read back");
+				break;
+			}
+	}
+	vector<double> full(length);
+	for(int i = 0; i < length; ++i)
+		full[i] = value(i, 3);
+	out.publish(full.data(), length - 1, 3, 0.125);
+	{
+		RankSnapshot s = in.snapshot();
+		if(s.level() != ACCESS_FULL || s.size() != (uint_fast64_t)length - 1 || s.full()[7] != value(7, 3) || s.read(length - 2) != value(length - 2, 3))
+			return_code |= fail("wrong doubles read back");
+	}
+	if(out.publish(full.data(), length + 1, 4, 0.0))
+		return_code |= fail("published more than the capacity");
+
+	// a held snapshot is not written over: its slot is skipped, the other is not
+	{
+		RankSnapshot held = in.snapshot();
+		if(!out.publish(x.heads, length, 4, 0.0))
+			return_code |= fail("the slot not held is not published to");
+		if(out.publish(x.heads, length, 5, 0.0) || out.numSkipped() != 1)
+			return_code |= fail("the held slot is published to");
+		if(held.level() != ACCESS_FULL || held.full()[7] != value(7, 3) || held.epoch() != 3)
+			return_code |= fail("a held snapshot changed");
+		RankSnapshot moved = std::move(held);
+		if(held.valid() || !moved.valid())
+			return_code |= fail("a moved snapshot is still held");
+	}
+	if(!out.publish(x.heads, length, 5, 0.0) || in.epoch() != 5 || out.numPublished() != 5)
+		return_code |= fail("the slot is not published to once let go");
+
+	// readers never see a torn vector while the solver publishes
+	atomic<bool> done(false);
+	atomic<int> torn(0), seen(0);
+	vector<thread> readers;
+	for(int t = 0; t < 3; ++t)
+		readers.push_back(thread([&]() {
+			RankReader r(path);
+			while(!done.load())
+			{
+				RankSnapshot s = r.snapshot();
+				if(s.level() != ACCESS_FULL)
+					continue;
+				const int k = static_cast<int>(s.iteration());
+				for(int i = 0; i < length; i += 7)
+					if(s.full()[i] != value(i, k))
+					{
+						++torn;
+						break;
+					}
+				++seen;
+			}
+		}));
+	for(int k = 6; k < 3000; ++k)
+	{
+		for(int i = 0; i < length; ++i)
+			full[i] = value(i, k);
+		out.publish(full.data(), length, k, 0.0);
+	}
+	done = true;
+	for(size_t t = 0; t < readers.size(); ++t)
+		readers[t].join();
+	if(torn != 0 || seen == 0)
+		return_code |= fail("a reader saw a torn vector");
+
+	x.del();
+	unlink(path);
+
+	if(return_code == 0)
+		cout << "rank publication: all tests passed\n";
+	return return_code;
+}
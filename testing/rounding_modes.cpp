@@ -0,0 +1,113 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, so that the scalar remainder of the vectorised kernels is also exercised
+constexpr int length = 1003;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	// truncation is the default, and matches element-wise assignment
+	HeadsArray t(length);
+	HeadsArray t_ref(length);
+	t.writeBlock(0, length, d);
+	for(int i = 0; i < length; ++i)
+	{
+		t_ref[i] = d[i];
+		if(t[i] != t_ref[i])
+		{
+			cerr << "truncated value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// nearest: within half a head ulp, never further than truncation, block matches element-wise
+	HeadsArray r(length);
+	HeadsArray r_ref(length);
+	r.writeBlock<ROUND_NEAREST>(0, length, d);
+	for(int i = 0; i < length; ++i)
+	{
+		r_ref.set<ROUND_NEAREST>(i, d[i]);
+		double half_ulp = ldexp(fabs((double)t[i]), -21);
+		if(r[i] != r_ref[i] || fabs(r[i] - d[i]) > half_ulp || fabs(r[i] - d[i]) > fabs(t[i] - d[i]))
+		{
+			cerr << "nearest value [" << i << "] mismatch\n";
+			cerr << "value = " << d[i] << ", rounded = " << r[i] << ", block = " << r_ref[i] << "\n";
+			return_code = 1;
+		}
+	}
+
+	// ties go to even
+	double ties[2] = { 1.0 + ldexp(1.0, -21), 1.0 + 3 * ldexp(1.0, -21) };
+	HeadsArray e(2);
+	e.writeBlock<ROUND_NEAREST>(0, 2, ties);
+	if(e[0] != 1.0 || e[1] != 1.0 + ldexp(1.0, -19))
+	{
+		cerr << "nearest ties not rounded to even\n";
+		return_code = 1;
+	}
+
+	// stochastic rounding is unbiased: the mean of many roundings approaches the value
+	constexpr int samples = 100000;
+	const double value = 1.0 + 0.3 * ldexp(1.0, -20);
+	double* v = new double[samples];
+	for(int i = 0; i < samples; ++i)
+		v[i] = value;
+	HeadsArray s(samples);
+	s.writeBlock<ROUND_STOCHASTIC>(0, samples, v);
+	s.readBlock(0, samples, v);
+	double sum = 0.0;
+	for(int i = 0; i < samples; ++i)
+		sum += v[i] - 1.0;
+	double mean_frac = (sum / samples) / ldexp(1.0, -20);
+	if(fabs(mean_frac - 0.3) > 0.01)
+	{
+		cerr << "stochastic rounding is biased\n";
+		cerr << "expected = 0.3, actual = " << mean_frac << "\n";
+		return_code = 1;
+	}
+
+	// special values are left alone
+	double special[2] = { INFINITY, -INFINITY };
+	e.writeBlock<ROUND_NEAREST>(0, 2, special);
+	if(e[0] != INFINITY || e[1] != -INFINITY)
+	{
+		cerr << "infinity was rounded\n";
+		return_code = 1;
+	}
+
+	t.del();
+	t_ref.del();
+	r.del();
+	r_ref.del();
+	e.del();
+	s.del();
+	delete[] d;
+	delete[] v;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
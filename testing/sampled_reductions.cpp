@@ -0,0 +1,98 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+#include "../manseglib_controller.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 100003;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(0.0, 1.0);
+
+	ManSegArray x(length);
+	ManSegArray y(length);
+	for(int i = 0; i < length; ++i)
+	{
+		x.pairs[i] = dist(gen);
+		y.pairs[i] = dist(gen);
+	}
+
+	int return_code = 0;
+
+	// a sample of every index gives the compensated sums, with no bound
+	IndexSample all(length, length);
+	SampleEstimate s = sampledL1Diff(all, x.heads, y.heads);
+	if(!all.exact() || s.bound != 0.0 || s.value != l1Diff(x.heads, y.heads, 0, length))
+	{
+		cerr << "full sample is not exact\n";
+		cerr << "expected = " << l1Diff(x.heads, y.heads, 0, length) << ", actual = " << s.value << " +- " << s.bound << "\n";
+		return_code = 1;
+	}
+
+	// samples of 2000 bound the sums they estimate, and are the same every time
+	IndexSample sample(length, 2000);
+	const double diff = l1Diff(x.heads, y.heads, 0, length);
+	const double total = kahanSum(x.pairs, 0, length);
+	SampleEstimate d = sampledL1Diff(sample, x.heads, y.heads);
+	SampleEstimate t = sampledSum(sample, x.pairs);
+	if(sample.exact() || sample.size() != 2000 || d.bound <= 0.0 || diff < d.lower() || diff > d.upper())
+	{
+		cerr << "sampled l1Diff does not bound the exact one\n";
+		cerr << "expected = " << diff << ", actual = " << d.value << " +- " << d.bound << "\n";
+		return_code = 1;
+	}
+	if(total < t.lower() || total > t.upper() || t.bound > 0.05 * total)
+	{
+		cerr << "sampled sum does not bound the exact one\n";
+		cerr << "expected = " << total << ", actual = " << t.value << " +- " << t.bound << "\n";
+		return_code = 1;
+	}
+	if(sampledL1Diff(IndexSample(length, 2000), x.heads, y.heads).value != d.value)
+	{
+		cerr << "sample with the same seed differs\n";
+		return_code = 1;
+	}
+
+	// the controller settles on an estimate only while its whole range leads to the same decision
+	PrecisionController<AbsoluteBoundPolicy> control(AbsoluteBoundPolicy(1e-3));
+	if(!control.decides(0.1, 0.3) || control.decides(5e-4, 2e-3) || control.decides(0.1, 0.3, 0.2))
+	{
+		cerr << "decides at the heads mismatch\n";
+		return_code = 1;
+	}
+	control.update(1e-4);
+	control.update(1e-4);
+	if(control.level() != PRECISION_FULL || !control.decides(1e-4, 1e-3, 1e-5) || control.decides(1e-6, 1e-3, 1e-5))
+	{
+		cerr << "decides at full precision mismatch\n";
+		return_code = 1;
+	}
+	// probing the policy leaves its state alone
+	PrecisionController<StagnationPolicy> stagnation(StagnationPolicy(0.25));
+	stagnation.update(1.0);
+	stagnation.decides(0.1, 0.9);
+	stagnation.update(0.5);
+	if(stagnation.level() != PRECISION_HEADS || stagnation.policy().change != 0.5)
+	{
+		cerr << "decides changed the policy\n";
+		return_code = 1;
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
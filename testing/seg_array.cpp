@@ -0,0 +1,145 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_segarray.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+
+// upper level * bits bits of d, the rest zeroed
+double truncated(const double& d, const int& level, const int& bits)
+{
+	uint64_t mask = (level * bits >= 64) ? ~0ULL : ~(~0ULL >> (level * bits));
+	return bitsDouble(doubleBits(d) & mask);
+}
+
+template<int Level>
+int checkLevel(SegArray16& a, const double* d, double* out)
+{
+	int return_code = 0;
+	auto view = a.level<Level>();
+	view.readBlock(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		double expected = truncated(d[i], Level, 16);
+		if(view[i] != expected || out[i] != expected)
+		{
+			cerr << "level " << Level << " value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected << ", actual = " << out[i] << "\n";
+			return_code = 1;
+		}
+	}
+	return return_code;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[length];
+	double* out = new double[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	// full precision write, read back at each level
+	SegArray16 a(length);
+	a.level<4>().writeBlock(0, length, d);
+	return_code |= checkLevel<1>(a, d, out);
+	return_code |= checkLevel<2>(a, d, out);
+	return_code |= checkLevel<3>(a, d, out);
+	return_code |= checkLevel<4>(a, d, out);
+
+	// level 2 holds the same bits as a Head
+	for(int i = 0; i < length; ++i)
+	{
+		uint64_t bits = doubleBits(d[i]) >> 32;
+		if(a.read<2>(i) != bitsDouble(bits << 32))
+		{
+			cerr << "level 2 value [" << i << "] does not match head\n";
+			return_code = 1;
+		}
+	}
+
+	// element-wise writes at a low level only modify the leading planes
+	SegArray16 b(length);
+	for(int i = 0; i < length; ++i)
+		b.level<1>()[i] = d[i];
+	for(int i = 0; i < length; ++i)
+	{
+		if(b.read<4>(i) != truncated(d[i], 1, 16))
+		{
+			cerr << "level 1 write [" << i << "] modified lower planes\n";
+			return_code = 1;
+		}
+	}
+
+	// arithmetic through the proxy
+	auto full = b.level<4>();
+	for(int i = 0; i < length; ++i)
+	{
+		full[i] = d[i];
+		full[i] += 1.0;
+		if(full[i] != d[i] + 1.0)
+		{
+			cerr << "level 4 arithmetic [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// 8 x 8-bit planes round trip exactly
+	SegArray8 c(length);
+	c.writeBlock<8>(0, length, d);
+	c.readBlock<8>(0, length, out);
+	for(int i = 0; i < length; ++i)
+	{
+		if(out[i] != d[i] || c.read<3>(i) != truncated(d[i], 3, 8))
+		{
+			cerr << "8-bit planes value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// byte granular split points: 24/40 and 40/24
+	SplitSegArray<24> s24(length);
+	SplitSegArray<40> s40(length);
+	auto h24 = s24.headsView();
+	auto p24 = s24.pairsView();
+	p24.writeBlock(0, length, d);
+	s40.headsView().writeBlock(0, length, d);
+	for(int i = 0; i < length; ++i)
+	{
+		if(p24[i] != d[i] || h24[i] != truncated(d[i], 3, 8) || s40.readHead(i) != truncated(d[i], 5, 8) || s40.readPair(i) != truncated(d[i], 5, 8))
+		{
+			cerr << "split value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	static_assert(SplitSegArray<32>::precision::maxPrecision == MaxSingleSegmentPrecision, "32 bit head precision should match TwoSegArray");
+	static_assert(SplitSegArray<40>::precision::mantissaBits == 28, "40 bit head should hold 28 mantissa bits");
+
+	a.del();
+	b.del();
+	c.del();
+	s24.del();
+	s40.del();
+	delete[] d;
+	delete[] out;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_matrix.hpp"
+#include "../manseglib_blas.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// not multiples of the tile, so every edge is padded
+constexpr int rows = 150;
+constexpr int cols = 131;
+constexpr int inner = 77;
+
+bool close(double expected, double actual, double scale)
+{
+	return fabs(expected - actual) <= 1e-12 * scale;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	vector<double> a(rows * cols), b(inner * cols), c(rows * inner), x(cols), y(rows);
+	for(double& v : a) v = dist(gen);
+	for(double& v : b) v = dist(gen);
+	for(double& v : c) v = dist(gen);
+	for(double& v : x) v = dist(gen);
+	for(double& v : y) v = dist(gen);
+
+	int return_code = 0;
+
+	// a row at a time in, a value at a time out
+	ManSegMatrix A(rows, cols);
+	for(int i = 0; i < rows; ++i)
+		A.pairs.row(i).writeBlock(0, cols, &a[i * cols]);
+	for(int i = 0; i < rows; ++i)
+	{
+		for(int j = 0; j < cols; ++j)
+		{
+			const double head = headToDouble(roundToHead<ROUND_TRUNCATE>(a[i * cols + j]));
+			if(A.pairs.read(i, j) != a[i * cols + j] || A.heads.read(i, j) != head || (double)A.heads(i, j) != head)
+			{
+				cerr << "value (" << i << ", " << j << ") mismatch\n";
+				cerr << "expected = " << a[i * cols + j] << ", actual = " << A.pairs.read(i, j) << "\n";
+				return_code = 1;
+			}
+		}
+	}
+
+	// rows and columns read as the values they span, at both levels
+	vector<double> line(max(rows, cols));
+	for(int i = 0; i < rows; ++i)
+	{
+		A.pairs.row(i).readBlock(3, cols - 3, line.data());
+		for(int j = 3; j < cols; ++j)
+			if(line[j - 3] != a[i * cols + j])
+			{
+				cerr << "row " << i << " mismatch at " << j << "\n";
+				return_code = 1;
+			}
+	}
+	for(int j = 0; j < cols; ++j)
+	{
+		A.heads.col(j).readBlock(0, rows, line.data());
+		for(int i = 0; i < rows; ++i)
+			if(line[i] != A.heads.read(i, j))
+			{
+				cerr << "column " << j << " mismatch at " << i << "\n";
+				return_code = 1;
+			}
+	}
+
+	// a column written, and a value through its proxy, leave the rest alone
+	ManSegMatrix B(inner, cols);
+	for(int i = 0; i < inner; ++i)
+		for(int j = 0; j < cols; ++j)
+			B.pairs(i, j) = b[i * cols + j];
+	vector<double> column(inner);
+	for(int i = 0; i < inner; ++i)
+		column[i] = b[i * cols + 70] = 0.5 * i;
+	B.pairs.col(70).writeBlock(0, inner, column.data());
+	for(int i = 0; i < inner; ++i)
+		for(int j = 0; j < cols; ++j)
+			if(B.pairs.read(i, j) != b[i * cols + j])
+			{
+				cerr << "written column, value (" << i << ", " << j << ") mismatch\n";
+				return_code = 1;
+			}
+
+	// rows are views for the blas operations
+	double d = blas::dot(cols, A.pairs.row(5), FullView(x.data(), cols)), e = 0.0;
+	for(int j = 0; j < cols; ++j)
+		e += a[5 * cols + j] * x[j];
+	if(!close(e, d, cols))
+	{
+		cerr << "dot of a row mismatch\n";
+		cerr << "expected = " << e << ", actual = " << d << "\n";
+		return_code = 1;
+	}
+
+	// gemv at each level, against the values of that level
+	for(int level = 0; level < 2; ++level)
+	{
+		vector<double> out(y);
+		if(level == 0)
+			gemv(2.0, A.heads, FullView(x.data(), cols), 0.5, FullView(out.data(), rows));
+		else
+			gemv(2.0, A.pairs, FullView(x.data(), cols), 0.5, FullView(out.data(), rows));
+		for(int i = 0; i < rows; ++i)
+		{
+			double s = 0.0;
+			for(int j = 0; j < cols; ++j)
+				s += (level == 0 ? A.heads.read(i, j) : a[i * cols + j]) * x[j];
+			if(!close(2.0 * s + 0.5 * y[i], out[i], cols))
+			{
+				cerr << "gemv (level " << level << ") row " << i << " mismatch\n";
+				cerr << "expected = " << 2.0 * s + 0.5 * y[i] << ", actual = " << out[i] << "\n";
+				return_code = 1;
+			}
+		}
+	}
+
+	// C = A B^T, through a transposed copy of B, at the pairs and from the heads of A
+	ManSegMatrix BT(cols, inner), C(rows, inner);
+	for(int i = 0; i < inner; ++i)
+		BT.pairs.col(i).writeBlock(0, cols, &b[i * cols]);
+	for(int i = 0; i < rows; ++i)
+		C.pairs.row(i).writeBlock(0, inner, &c[i * inner]);
+	gemm(1.0, A.pairs, BT.pairs, -1.0, C.pairs);
+	ManSegMatrix H(rows, inner);
+	gemm(1.0, A.heads, BT.pairs, 0.0, H.pairs);
+	for(int i = 0; i < rows; ++i)
+	{
+		for(int k = 0; k < inner; ++k)
+		{
+			double s = 0.0, h = 0.0;
+			for(int j = 0; j < cols; ++j)
+			{
+				s += a[i * cols + j] * b[k * cols + j];
+				h += A.heads.read(i, j) * b[k * cols + j];
+			}
+			if(!close(s - c[i * inner + k], C.pairs.read(i, k), cols) || !close(h, H.pairs.read(i, k), cols))
+			{
+				cerr << "gemm (" << i << ", " << k << ") mismatch\n";
+				cerr << "expected = " << s - c[i * inner + k] << ", actual = " << C.pairs.read(i, k) << "\n";
+				return_code = 1;
+			}
+		}
+	}
+
+	// more than one block of C, and of the inner dimension, for gemm's packing
+	{
+		const int m = 200, k = 300, n = 270;
+		vector<double> p(m * k), q(k * n);
+		for(double& v : p) v = dist(gen);
+		for(double& v : q) v = dist(gen);
+		ManSegMatrix P(m, k), Q(k, n), R(m, n);
+		for(int i = 0; i < m; ++i)
+			P.pairs.row(i).writeBlock(0, k, &p[i * k]);
+		for(int i = 0; i < k; ++i)
+			Q.heads.row(i).writeBlock(0, n, &q[i * n]);
+		gemm(0.5, P.pairs, Q.heads, 0.0, R.pairs);
+		for(int i = 0; i < m; ++i)
+		{
+			for(int j = 0; j < n; ++j)
+			{
+				double s = 0.0;
+				for(int l = 0; l < k; ++l)
+					s += p[i * k + l] * Q.heads.read(l, j);
+				if(!close(0.5 * s, R.pairs.read(i, j), k))
+				{
+					cerr << "blocked gemm (" << i << ", " << j << ") mismatch\n";
+					cerr << "expected = " << 0.5 * s << ", actual = " << R.pairs.read(i, j) << "\n";
+					return_code = 1;
+				}
+			}
+		}
+	}
+
+	// a moved matrix keeps its segments
+	ManSegMatrix moved(std::move(A));
+	if(A.isAlloc() || !moved.isAlloc() || moved.pairs.read(7, 9) != a[7 * cols + 9])
+	{
+		cerr << "moved matrix mismatch\n";
+		return_code = 1;
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
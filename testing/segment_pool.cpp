@@ -0,0 +1,150 @@
+#include <iostream>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_pool.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 100000;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+double value(const int& i) { return 1.0 + sin(i) * 0.5 + i * 1e-9; }
+
+int main()
+{
+	int return_code = 0;
+
+	// a plane given back is handed out again, in its size class
+	SegmentPool pool;
+	if(SegmentPool::sizeClass(1) != 0 || SegmentPool::classBytes(SegmentPool::sizeClass(5000)) < 5000
+		|| SegmentPool::classBytes(SegmentPool::sizeClass(5000)) >= 10000)
+		return_code |= fail("wrong size class");
+	float* a = static_cast<float*>(pool.acquire(length * sizeof(float), false));
+	a[length - 1] = 1.0f;
+	pool.release(a);
+	float* b = static_cast<float*>(pool.acquire(length * sizeof(float) - 100, false));
+	if(b != a || pool.reused() != 1 || pool.mapped() != 1)
+		return_code |= fail("a plane is not reused");
+	if(pool.bytesInUse() != SegmentPool::classBytes(SegmentPool::sizeClass(length * sizeof(float))) || pool.bytesHeld() != 0)
+		return_code |= fail("wrong bytes in use");
+
+	// a reused plane asked for zeroed is zero
+	for(int i = 0; i < length; ++i)
+		b[i] = 3.0f;
+	pool.release(b);
+	float* c = static_cast<float*>(pool.acquire(length * sizeof(float), true));
+	for(int i = 0; i < length; ++i)
+		if(c[i] != 0.0f)
+		{
+			return_code |= fail("a reused plane is not zeroed");
+			break;
+		}
+
+	// a pointer that is not handed out is ignored, once or twice
+	int local = 0;
+	pool.release(&local);
+	pool.release(c);
+	pool.release(c);
+	if(pool.bytesInUse() != 0 || pool.bytesHeld() != SegmentPool::classBytes(SegmentPool::sizeClass(length * sizeof(float))))
+		return_code |= fail("a plane is taken back twice");
+
+	// reset takes back everything, trim returns it
+	pool.acquire(1000, false);
+	pool.acquire(1 << 20, true);
+	pool.reset();
+	if(pool.bytesInUse() != 0 || pool.bytesHeld() == 0)
+		return_code |= fail("reset did not take back the planes");
+	pool.trim();
+	if(pool.bytesHeld() != 0)
+		return_code |= fail("trim did not return the planes");
+
+	// threads handing out and taking back
+	SegmentPool shared;
+	vector<thread> threads;
+	for(int t = 0; t < 4; ++t)
+		threads.push_back(thread([&shared, t]() {
+			for(int k = 0; k < 200; ++k)
+			{
+				int* p = static_cast<int*>(shared.acquire(4096 << (k % 3), k % 2 == 0));
+				p[0] = t;
+				shared.release(p);
+			}
+		}));
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	if(shared.bytesInUse() != 0 || shared.reused() + shared.mapped() != 800 || shared.mapped() > 12)
+		return_code |= fail("wrong counts from threads");
+
+	// arrays from the pool: values kept, and a second array of the size reuses the planes
+	SegmentPool arrays;
+	for(int round = 0; round < 3; ++round)
+	{
+		PooledManSegArray x(length, PooledSegmentAllocator(&arrays));
+		for(int i = 0; i < length; ++i)
+			if(x.heads.getTails()[i] != 0.0f)
+			{
+				return_code |= fail("the tails of a pooled array are not zero");
+				break;
+			}
+		for(int i = 0; i < length; ++i)
+			x.heads.set(i, value(i));
+		for(int i = 0; i < length; ++i)
+			x.pairs.set(i, value(i));
+		x.allocFull();
+		for(int i = 0; i < length; ++i)
+			x.full[i] = x.pairs.read(i);
+		for(int i = 0; i < length; ++i)
+			if(x.full[i] != value(i))
+			{
+				return_code |= fail("a pooled array does not keep its values");
+				break;
+			}
+		x.del();
+		x.delSegments();
+	}
+	if(arrays.mapped() != 3 || arrays.reused() != 6 || arrays.bytesInUse() != 0)
+		return_code |= fail("pooled arrays do not reuse their planes");
+
+	// a thread's own pool, the default of its arrays while a Scope names it, and the global one after
+	if(&SegmentPool::current() != &SegmentPool::global())
+		return_code |= fail("the global pool is not the default");
+	{
+		SegmentPool::Scope scope(SegmentPool::local());
+		if(PooledSegmentAllocator().pool != &SegmentPool::local())
+			return_code |= fail("a scoped pool is not the default");
+		{
+			SegmentPool::Scope inner(arrays);
+			if(PooledSegmentAllocator().pool != &arrays)
+				return_code |= fail("the innermost scope is not the default");
+		}
+		if(PooledSegmentAllocator().pool != &SegmentPool::local())
+			return_code |= fail("an inner scope did not restore the outer one");
+		for(int round = 0; round < 2; ++round)
+		{
+			PooledManSegArray x(length);
+			x.heads.set(0, value(0));
+		}
+		if(SegmentPool::local().mapped() != 2 || SegmentPool::local().reused() != 2 || SegmentPool::global().mapped() != 0)
+			return_code |= fail("scoped arrays do not come from the thread's pool");
+	}
+	if(&SegmentPool::current() != &SegmentPool::global())
+		return_code |= fail("a scope did not restore the global pool");
+	SegmentPool* other = nullptr;
+	thread([&other]() { other = &SegmentPool::local(); }).join();
+	if(other == &SegmentPool::local())
+		return_code |= fail("threads share a local pool");
+
+	if(return_code == 0)
+		cout << "segment pool: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_writer.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 40001;   // a few chunks and a partial one
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+double value(const int& i)
+{
+	return 1.0 + sin(i) * 0.5 + i * 1e-9;
+}
+
+// the value with its tail zeroed, as a heads array holds it
+double truncatedHead(const double& d)
+{
+	uint64_t bits;
+	memcpy(&bits, &d, sizeof(bits));
+	bits &= 0xffffffff00000000ull;
+	double h;
+	memcpy(&h, &bits, sizeof(h));
+	return h;
+}
+
+int main()
+{
+	int return_code = 0;
+	const char* path = "segment_writer_test.seg";
+	const char* raw = "segment_writer_test.raw";
+
+	// into an array's planes: the same bits as set
+	{
+		PairsArray a(length);
+		SegmentWriter w(a);
+		for(int i = 0; i < length; ++i)
+			w.push(value(i));
+		if(w.size() != length || !w.close())
+			return_code |= fail("the array writer does not close");
+		for(int i = 0; i < length; ++i)
+			if((double)a[i] != value(i))
+			{
+				return_code |= fail("the array's values are not those pushed");
+				break;
+			}
+		a.del();
+	}
+
+	// into a segments file, read back whole and as heads
+	{
+		SegmentWriter w(path, length);
+		for(int i = 0; i < length; ++i)
+			w.push(value(i));
+		if(!w.close())
+			return_code |= fail("the file writer does not close");
+		vector<double> full, heads;
+		if(!loadSegments(path, full, true) || !loadSegments(path, heads) || full.size() != length || heads.size() != length)
+			return_code |= fail("the file is not a segments file");
+		else
+			for(int i = 0; i < length; ++i)
+				if(full[i] != value(i) || heads[i] != truncatedHead(value(i)))
+				{
+					return_code |= fail("the file's values are not those pushed");
+					break;
+				}
+	}
+
+	// writers of two stretches of planes at offsets of a file of its own layout
+	{
+		const int fd = open(raw, O_CREAT | O_TRUNC | O_RDWR, 0644);
+		const uint64_t headsAt = 100, tailsAt = headsAt + length * sizeof(float) + 28;
+		const int half = length / 2;
+		{
+			SegmentWriter second(fd, headsAt + half * sizeof(float), tailsAt + half * sizeof(float), length - half);
+			SegmentWriter first(fd, headsAt, tailsAt, half);
+			for(int i = half; i < length; ++i)
+				second.push(value(i));
+			for(int i = 0; i < half; ++i)
+				first.push(value(i));
+			if(!first.close() || !second.close())
+				return_code |= fail("the stretch writers do not close");
+		}
+		vector<float> h(length), t(length);
+		if(pread(fd, h.data(), length * sizeof(float), headsAt) != (ssize_t)(length * sizeof(float))
+			|| pread(fd, t.data(), length * sizeof(float), tailsAt) != (ssize_t)(length * sizeof(float)))
+			return_code |= fail("the planes are not in the file");
+		else
+		{
+			PairsArray planes(h.data(), t.data(), length);
+			for(int i = 0; i < length; ++i)
+				if((double)planes[i] != value(i))
+				{
+					return_code |= fail("the stretches are not where they were written");
+					break;
+				}
+		}
+		close(fd);
+	}
+
+	// too few or too many values fail
+	{
+		PairsArray a(10);
+		SegmentWriter few(a);
+		few.push(1.0);
+		if(few.close())
+			return_code |= fail("a writer short of values closes");
+		SegmentWriter many(a);
+		for(int i = 0; i < 11; ++i)
+			many.push(1.0);
+		if(many.close())
+			return_code |= fail("a writer of too many values closes");
+		if(SegmentWriter("", 4).close())
+			return_code |= fail("a writer without a file closes");
+		a.del();
+	}
+
+	remove(path);
+	remove(raw);
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003; // leaves a remainder after the 16 and 8 wide loops
+constexpr int numLevels = 3;
+const char* levelNames[numLevels] = { "SSE2", "AVX2", "AVX-512" };
+
+struct Results
+{
+	double widened[length];
+	double combined[length];
+	float narrowed[length];
+	float rounded[length];
+	float heads[length];
+	float tails[length];
+	double gathered[length];
+	float scattered[length];
+	float assigned[length];
+	double sum;
+};
+
+// runs each bulk kernel at the current SimdLevel
+void runKernels(const float* h, const float* t, const double* d, const int32_t* idx, Results& r)
+{
+	widenHeads(h, length, r.widened);
+	combineSegments(h, t, length, r.combined);
+	narrowToHeads(d, length, r.narrowed);
+	narrowToHeads<ROUND_NEAREST>(d, length, r.rounded);
+	splitSegments(d, length, r.heads, r.tails);
+	gatherSegments(h, t, idx, length, r.gathered);
+	memcpy(r.scattered, h, length * sizeof(float));
+	scatterAddHeads(r.scattered, idx, length, d);
+
+	HeadsArray y(r.assigned, nullptr, length);
+	PairsArray x(const_cast<float*>(h), const_cast<float*>(t), length);
+	assign<ROUND_NEAREST>(y, 0, length, expr(x) * 0.5 + expr(d));
+	r.sum = kahanSum(x, 0, length);
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	uniform_int_distribution<int> pick(0, length - 1);
+
+	double* d = new double[length];
+	float* h = new float[length];
+	float* t = new float[length];
+	int32_t* idx = new int32_t[length];
+	for(int i = 0; i < length; ++i)
+	{
+		d[i] = dist(gen);
+		idx[i] = (i % 5 == 0) ? pick(gen) : (i * 7) % length; // mostly distinct, with some repeats
+	}
+	for(int i = 0; i < length; ++i)
+	{
+		Pair p(&h[i], &t[i]);
+		p = dist(gen);
+	}
+
+	int return_code = 0;
+
+	const SimdLevel detected = simdLevel();
+	cout << "detected " << levelNames[detected] << "\n";
+
+	Results* results = new Results[numLevels];
+	for(int level = SIMD_SSE2; level <= detected; ++level)
+	{
+		if(setSimdLevel(SimdLevel(level)) != level)
+		{
+			cerr << "could not select " << levelNames[level] << "\n";
+			return_code = 1;
+		}
+		runKernels(h, t, d, idx, results[level]);
+	}
+	// levels the CPU does not have are clamped to the detected one
+	if(setSimdLevel(SIMD_AVX512) != detected)
+	{
+		cerr << "setSimdLevel was not limited to the detected level\n";
+		return_code = 1;
+	}
+
+	// every level gives the same values as the scalar (SSE2) kernels
+	const Results& ref = results[SIMD_SSE2];
+	for(int level = SIMD_AVX2; level <= detected; ++level)
+	{
+		const Results& r = results[level];
+		if(memcmp(r.widened, ref.widened, sizeof(ref.widened)) != 0
+			|| memcmp(r.combined, ref.combined, sizeof(ref.combined)) != 0
+			|| memcmp(r.narrowed, ref.narrowed, sizeof(ref.narrowed)) != 0
+			|| memcmp(r.rounded, ref.rounded, sizeof(ref.rounded)) != 0
+			|| memcmp(r.heads, ref.heads, sizeof(ref.heads)) != 0
+			|| memcmp(r.tails, ref.tails, sizeof(ref.tails)) != 0
+			|| memcmp(r.gathered, ref.gathered, sizeof(ref.gathered)) != 0
+			|| memcmp(r.scattered, ref.scattered, sizeof(ref.scattered)) != 0
+			|| memcmp(r.assigned, ref.assigned, sizeof(ref.assigned)) != 0)
+		{
+			cerr << levelNames[level] << " kernels differ from scalar kernels\n";
+			return_code = 1;
+		}
+		// the lanes of the compensated sum are combined in a different order
+		if(fabs(r.sum - ref.sum) > 1e-12 * fabs(ref.sum))
+		{
+			cerr << levelNames[level] << " sum = " << r.sum << ", scalar sum = " << ref.sum << "\n";
+			return_code = 1;
+		}
+	}
+
+	delete[] results;
+	delete[] d;
+	delete[] h;
+	delete[] t;
+	delete[] idx;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
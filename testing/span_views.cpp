@@ -0,0 +1,147 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_expr.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+constexpr int start = 211;
+constexpr int spanLength = 397;
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	double* d = new double[length];
+	double* out = new double[length];
+	for(int i = 0; i < length; ++i)
+		d[i] = dist(gen);
+
+	int return_code = 0;
+
+	static_assert(!is_copy_constructible<ManSegArray>::value, "ManSegArray should not be copyable");
+	static_assert(is_nothrow_move_constructible<ManSegArray>::value, "ManSegArray should be movable");
+
+	ManSegArray a(length);
+	a.pairs.writeBlock(0, length, d);
+
+	// subspans are indexed from their start
+	PairsSpan ps = a.pairs.subspan(start, spanLength);
+	HeadsSpan hs = a.heads.subspan(start, spanLength);
+	if(ps.size() != spanLength || hs.size() != spanLength)
+	{
+		cerr << "subspan size incorrect\n";
+		return_code = 1;
+	}
+	for(int i = 0; i < spanLength; ++i)
+	{
+		if(ps.read(i) != d[start + i] || (double)ps[i] != d[start + i] || hs.read(i) != (double)a.heads[start + i])
+		{
+			cerr << "subspan value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+
+	// nested subspans, and block access through a span
+	PairsSpan inner = ps.subspan(10, 20);
+	inner.readBlock(0, 20, out);
+	for(int i = 0; i < 20; ++i)
+	{
+		if(out[i] != d[start + 10 + i])
+		{
+			cerr << "nested subspan value [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	inner.set(3, 1.25);
+	hs.set<ROUND_NEAREST>(0, d[0]);
+	HeadsArray ref(1);
+	ref.set<ROUND_NEAREST>(0, d[0]);
+	if((double)a.pairs[start + 13] != 1.25 || (double)a.heads[start] != (double)ref[0])
+	{
+		cerr << "span writes not seen by the array\n";
+		return_code = 1;
+	}
+	ref.del();
+	a.pairs.writeBlock(0, length, d);
+
+	// spans in expressions and reductions match the sub-range of the array
+	double spanSum = kahanSum(ps, 0, spanLength);
+	double arraySum = kahanSum(a.pairs, start, spanLength);
+	double diff = l1Diff(a.heads.subspan(start, spanLength), ps, 0, spanLength);
+	double arrayDiff = l1Diff(a.heads, a.pairs, start, spanLength);
+	if(spanSum != arraySum || diff != arrayDiff)
+	{
+		cerr << "span reductions: sum " << spanSum << " vs " << arraySum << ", diff " << diff << " vs " << arrayDiff << "\n";
+		return_code = 1;
+	}
+	assign(ps, 0, spanLength, expr(ps) * 2.0);
+	for(int i = 0; i < spanLength; ++i)
+	{
+		if((double)a.pairs[start + i] != 2.0 * d[start + i])
+		{
+			cerr << "span assign [" << i << "] mismatch\n";
+			return_code = 1;
+		}
+	}
+	a.pairs.writeBlock(0, length, d);
+
+	// moving transfers the storage and empties the source
+	float* headsPtr = a.heads.getHeads();
+	ManSegArray b(std::move(a));
+	if(b.heads.getHeads() != headsPtr || b.length != length || a.heads.isAlloc() || a.length != 0 || (double)b.pairs[5] != d[5])
+	{
+		cerr << "move construction did not transfer storage\n";
+		return_code = 1;
+	}
+
+	// swap exchanges everything, including the full arrays
+	ManSegArray c(length);
+	c.allocFull();
+	for(int i = 0; i < length; ++i)
+		c.full[i] = -d[i];
+	double* fullPtr = c.full;
+	swap(b, c);
+	if(c.heads.getHeads() != headsPtr || b.full != fullPtr || c.full != nullptr || b.full[5] != -d[5] || (double)c.pairs[5] != d[5])
+	{
+		cerr << "swap did not exchange storage\n";
+		return_code = 1;
+	}
+
+	// move assignment frees the target's storage first; b, c and the moved from a are freed on scope exit
+	b = std::move(c);
+	if(b.heads.getHeads() != headsPtr || b.full != nullptr || c.heads.isAlloc())
+	{
+		cerr << "move assignment did not transfer storage\n";
+		return_code = 1;
+	}
+
+	// explicit del() still works, and the destructor does not free again
+	{
+		ManSegArray e(length);
+		e.allocFull();
+		e.delSegments();
+		e.del();
+	}
+
+	delete[] d;
+	delete[] out;
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_rank.hpp"
+#include "../manseglib_sparse.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1001;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	vector<double> values(length);
+	for(int i = 0; i < length; ++i)
+		values[i] = 1.0 + sin(i) * 0.5 + i * 1e-9;
+
+	SparseTailArray<> x(length);
+	for(int i = 0; i < length; ++i)
+		x.set(i, values[i]);
+
+	// nothing promoted: every element is its head, as in a heads array
+	ManSegArray heads(length);
+	for(int i = 0; i < length; ++i)
+		heads.heads.set(i, values[i]);
+	for(int i = 0; i < length; ++i)
+		if(x.hasTail(i) || x.read(i) != heads.heads.read(i) || x.heads().read(i) != heads.heads.read(i))
+		{
+			return_code |= fail("an element without a tail does not read as its head");
+			break;
+		}
+	if(x.numPromoted() != 0 || x.tailBytes() != 16 * ((length + 63) / 64))
+		return_code |= fail("tails before any promotion");
+
+	// promoted out of order and within one group: each keeps its head, then holds values exactly
+	const vector<uint_fast64_t> top = topK(x.heads(), length, 10);
+	const vector<uint_fast64_t> some = { 70, 65, 127, 64, 1000, 0, 65 };
+	uint_fast64_t fresh = 0;
+	for(size_t k = 0; k < some.size(); ++k)
+		if(find(top.begin(), top.end(), some[k]) == top.end() && find(some.begin(), some.begin() + k, some[k]) == some.begin() + k)
+			++fresh;
+	if(x.promote(top.begin(), top.end()) != 10 || x.promote(some.begin(), some.end()) != fresh || x.numPromoted() != 10 + fresh)
+		return_code |= fail("promotions miscounted");
+	if(x.promote(65))
+		return_code |= fail("an element was promoted twice");
+	for(const uint_fast64_t i : top)
+		if(!x.hasTail(i) || x.read(i) != heads.heads.read(i))
+			return_code |= fail("a promoted element does not start from its head");
+	for(int i = 0; i < length; ++i)
+		x.set(i, values[i]);
+	for(int i = 0; i < length; ++i)
+	{
+		const double expected = x.hasTail(i) ? values[i] : heads.heads.read(i);
+		if(x.read(i) != expected)
+		{
+			return_code |= fail("an element does not read back at its precision");
+			break;
+		}
+	}
+	if(x.tailBytes() != x.numPromoted() * sizeof(float) + 16 * ((length + 63) / 64))
+		return_code |= fail("wrong size of the tails");
+
+	// the leaders with their tails break the ties of their heads
+	if(topK(x.heads(), length, 10) != top)
+		return_code |= fail("the heads rank differently after promotion");
+
+	x.del();
+	heads.del();
+
+	if(return_code == 0)
+		cout << "sparse tails: all tests passed\n";
+	return return_code;
+}
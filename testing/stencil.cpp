@@ -0,0 +1,339 @@
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+#include <math.h>
+
+#include "util.h"
+#include "../manseglib_stencil.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// element-wise sweep of a B x B block of doubles, the reference for stencil5
+double reference(const vector<double>& in, vector<double>& out, const int& B, const double* top, const double* bottom,
+	const double* left, const double* right)
+{
+	double delta = 0.0;
+	for(int i = 0; i < B; ++i)
+		for(int j = 0; j < B; ++j)
+		{
+			double l = (j == 0) ? (left ? left[i] : 0.0) : in[i*B + j - 1];
+			double t = (i == 0) ? (top ? top[j] : 0.0) : in[(i - 1)*B + j];
+			double r = (j == B - 1) ? (right ? right[i] : 0.0) : in[i*B + j + 1];
+			double b = (i == B - 1) ? (bottom ? bottom[j] : 0.0) : in[(i + 1)*B + j];
+			out[i*B + j] = 0.2 * (in[i*B + j] + l + t + r + b);
+			delta = max(delta, fabs(out[i*B + j] - in[i*B + j]));
+		}
+	return delta;
+}
+
+// element-wise half sweep of red-black SOR of a B x B block in place, the reference for sor5
+double referenceSor(vector<double>& a, const int& B, const double* top, const double* bottom, const double* left,
+	const double* right, const int& colour, const double& omega)
+{
+	double delta = 0.0;
+	for(int i = 0; i < B; ++i)
+		for(int j = (colour + i) % 2; j < B; j += 2)
+		{
+			double l = (j == 0) ? (left ? left[i] : 0.0) : a[i*B + j - 1];
+			double t = (i == 0) ? (top ? top[j] : 0.0) : a[(i - 1)*B + j];
+			double r = (j == B - 1) ? (right ? right[i] : 0.0) : a[i*B + j + 1];
+			double b = (i == B - 1) ? (bottom ? bottom[j] : 0.0) : a[(i + 1)*B + j];
+			double next = a[i*B + j] + omega * (0.25 * (l + t + r + b) - a[i*B + j]);
+			delta = max(delta, fabs(next - a[i*B + j]));
+			a[i*B + j] = next;
+		}
+	return delta;
+}
+
+// element-wise 7 point sweep (jacobi) or half sweep of red-black SOR (sor, in place) of a B x B x B brick
+double reference7(vector<double>& in, vector<double>& out, const int& B, const BrickHalos& h, const bool& sor,
+	const int& colour, const double& omega)
+{
+	auto at = [&](const vector<double>& a, int k, int i, int j) -> double
+	{
+		if(k < 0) return h.face[0] ? h.face[0][i*B + j] : 0.0;
+		if(k >= B) return h.face[1] ? h.face[1][i*B + j] : 0.0;
+		if(i < 0) return h.face[2] ? h.face[2][k*B + j] : 0.0;
+		if(i >= B) return h.face[3] ? h.face[3][k*B + j] : 0.0;
+		if(j < 0) return h.face[4] ? h.face[4][k*B + i] : 0.0;
+		if(j >= B) return h.face[5] ? h.face[5][k*B + i] : 0.0;
+		return a[(k*B + i)*B + j];
+	};
+	double delta = 0.0;
+	for(int k = 0; k < B; ++k)
+		for(int i = 0; i < B; ++i)
+			for(int j = 0; j < B; ++j)
+			{
+				vector<double>& a = sor ? out : in;
+				const double c = a[(k*B + i)*B + j];
+				double next;
+				if(sor)
+				{
+					if((k + i + j) % 2 != colour) continue;
+					double sum = at(a, k, i, j - 1) + at(a, k, i - 1, j) + at(a, k, i, j + 1) + at(a, k, i + 1, j) + at(a, k - 1, i, j) + at(a, k + 1, i, j);
+					next = c + omega * ((1.0 / 6.0) * sum - c);
+				}
+				else
+					next = (1.0 / 7.0) * (c + at(a, k, i, j - 1) + at(a, k, i - 1, j) + at(a, k, i, j + 1) + at(a, k, i + 1, j) + at(a, k - 1, i, j) + at(a, k + 1, i, j));
+				out[(k*B + i)*B + j] = next;
+				delta = max(delta, fabs(next - c));
+			}
+	return delta;
+}
+
+int check(const char* name, const double& delta, const double& expectedDelta, const vector<double>& actual, const vector<double>& expected)
+{
+	for(size_t i = 0; i < expected.size(); ++i)
+		if(actual[i] != expected[i])
+		{
+			cerr << name << ": value [" << i << "] mismatch\n";
+			cerr << "expected = " << expected[i] << ", actual = " << actual[i] << "\n";
+			return 1;
+		}
+	if(delta != expectedDelta)
+	{
+		cerr << name << ": delta " << delta << ", expected " << expectedDelta << "\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	cout << fixed << setprecision(16);
+
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-2.0, 2.0);
+
+	int return_code = 0;
+
+	// 13 leaves a remainder after the vector loop
+	for(int B : { 13, 16 })
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int n = B*B;
+		vector<double> d(n), halos(4*B), widened(n), expected(n), actual(n);
+		for(int i = 0; i < n; ++i) d[i] = dist(gen);
+		for(int i = 0; i < 4*B; ++i) halos[i] = dist(gen);
+		const double* top = &halos[0];
+		const double* bottom = &halos[B];
+		const double* left = &halos[2*B];
+		const double* right = &halos[3*B];
+
+		ManSegArray x(n), y(n);
+		x.allocFull();
+		y.allocFull();
+		x.pairs.writeBlock(0, n, d.data());
+		for(int i = 0; i < n; ++i) x.full[i] = d[i];
+
+		// full precision: exact, as the terms are added in the same order
+		double delta = stencil5(x.read_as<ACCESS_FULL>(), y.write_as<ACCESS_FULL>(), B, top, bottom, left, right);
+		double expectedDelta = reference(d, expected, B, top, bottom, left, right);
+		y.read_as<ACCESS_FULL>().readBlock(0, n, actual.data());
+		return_code |= check("full", delta, expectedDelta, actual, expected);
+
+		// interim: the widened heads in, full values out
+		x.heads.readBlock(0, n, widened.data());
+		expectedDelta = reference(widened, expected, B, top, bottom, left, right);
+		delta = stencil5(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_FULL>(), B, top, bottom, left, right);
+		y.read_as<ACCESS_FULL>().readBlock(0, n, actual.data());
+		return_code |= check("interim", delta, expectedDelta, actual, expected);
+
+		// heads, with the zero boundary: results truncated to heads as they are stored
+		expectedDelta = reference(widened, expected, B, nullptr, nullptr, nullptr, nullptr);
+		delta = stencil5(x.read_as<ACCESS_HEADS>(), y.write_as<ACCESS_HEADS>(), B, nullptr, nullptr, nullptr, nullptr);
+		y.heads.readBlock(0, n, actual.data());
+		for(int i = 0; i < n; ++i) expected[i] = headToDouble(roundToHead<ROUND_TRUNCATE>(expected[i]));
+		return_code |= check("heads", delta, expectedDelta, actual, expected);
+
+		// in place on the full values
+		expectedDelta = reference(d, expected, B, top, bottom, left, right);
+		delta = stencil5(x.read_as<ACCESS_FULL>(), x.write_as<ACCESS_FULL>(), B, top, bottom, left, right);
+		x.read_as<ACCESS_FULL>().readBlock(0, n, actual.data());
+		return_code |= check("in place", delta, expectedDelta, actual, expected);
+	}
+
+	// temporal blocking: 3 sweeps of a 20 x 20 grid in one tile against 3 reference sweeps, the grid
+	// as the centre of a tile with a zero boundary ring, so the tile's outer ring is never updated
+	for(bool heads : { false, true })
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int G = 20, steps = 3, width = G + 2*steps;
+		vector<double> grid(G*G), next(G*G), buffers(2*width*width, 0.0);
+		for(int i = 0; i < G*G; ++i) grid[i] = headToDouble(roundToHead<ROUND_TRUNCATE>(dist(gen)));
+		for(int i = 0; i < G; ++i)
+			for(int j = 0; j < G; ++j)
+				buffers[(i + steps)*width + j + steps] = grid[i*G + j];
+
+		double expectedDelta = 0.0;
+		for(int s = 0; s < steps; ++s)
+		{
+			expectedDelta = reference(grid, next, G, nullptr, nullptr, nullptr, nullptr);
+			for(int i = 0; i < G*G; ++i)
+				grid[i] = (heads && s < steps - 1) ? headToDouble(roundToHead<ROUND_TRUNCATE>(next[i])) : next[i];
+		}
+
+		double* tile = buffers.data();
+		double* scratch = tile + width*width;
+		double delta = stencil5Steps(tile, scratch, width, steps, steps, steps + G, steps, steps + G, heads);
+		vector<double> actual(G*G);
+		for(int i = 0; i < G; ++i)
+			for(int j = 0; j < G; ++j)
+				actual[i*G + j] = tile[(i + steps)*width + j + steps];
+		return_code |= check(heads ? "steps (heads)" : "steps", delta, expectedDelta, actual, grid);
+	}
+
+	// red-black SOR in place, both colours, at the pairs (exact) and at the heads (each row narrowed as stored)
+	for(int B : { 13, 16 })
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int n = B*B;
+		const double omega = 1.7;
+		vector<double> d(n), halos(4*B), expected(n), actual(n);
+		for(int i = 0; i < n; ++i) d[i] = headToDouble(roundToHead<ROUND_TRUNCATE>(dist(gen)));
+		for(int i = 0; i < 4*B; ++i) halos[i] = dist(gen);
+		const double* top = &halos[0];
+		const double* bottom = &halos[B];
+		const double* left = &halos[2*B];
+		const double* right = &halos[3*B];
+
+		ManSegArray x(n), y(n);
+		x.pairs.writeBlock(0, n, d.data());
+		y.pairs.writeBlock(0, n, d.data());
+		expected = d;
+		for(int colour : { 0, 1 })
+		{
+			double expectedDelta = referenceSor(expected, B, top, bottom, left, right, colour, omega);
+			double delta = sor5(x.read_as<ACCESS_PAIRS>(), B, top, bottom, left, right, colour, omega);
+			x.pairs.readBlock(0, n, actual.data());
+			return_code |= check(colour ? "sor black" : "sor red", delta, expectedDelta, actual, expected);
+		}
+
+		// at the heads, one colour then the other with the zero boundary
+		vector<double> heads = d;
+		for(int colour : { 1, 0 })
+		{
+			double expectedDelta = referenceSor(heads, B, nullptr, nullptr, nullptr, nullptr, colour, omega);
+			for(int i = 0; i < n; ++i) heads[i] = headToDouble(roundToHead<ROUND_TRUNCATE>(heads[i]));
+			double delta = sor5(y.read_as<ACCESS_HEADS>(), B, nullptr, nullptr, nullptr, nullptr, colour, omega);
+			y.heads.readBlock(0, n, actual.data());
+			return_code |= check("sor heads", delta, expectedDelta, actual, heads);
+		}
+	}
+
+	// a Chebyshev step against the reference sweep, into prev's own block as the driver does, at the pairs
+	// (exact) and with omega 1, where prev is not read
+	for(int B : { 13, 16 })
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int n = B*B;
+		const double omega = 1.6, gamma = 1.25;
+		vector<double> d(n), p(n), halos(4*B), swept(n), expected(n), actual(n);
+		for(int i = 0; i < n; ++i) d[i] = dist(gen);
+		for(int i = 0; i < n; ++i) p[i] = dist(gen);
+		for(int i = 0; i < 4*B; ++i) halos[i] = dist(gen);
+		const double* top = &halos[0];
+		const double* bottom = &halos[B];
+		const double* left = &halos[2*B];
+		const double* right = &halos[3*B];
+
+		ManSegArray x(n), y(n);
+		x.pairs.writeBlock(0, n, d.data());
+		for(double w : { omega, 1.0 })
+		{
+			y.pairs.writeBlock(0, n, p.data());
+			reference(d, swept, B, top, bottom, left, right);
+			double expectedDelta = 0.0;
+			for(int i = 0; i < n; ++i)
+			{
+				expected[i] = (w == 1.0) ? gamma * swept[i] + (1.0 - gamma) * d[i]
+					: p[i] + w * (gamma * swept[i] + (1.0 - gamma) * d[i] - p[i]);
+				expectedDelta = max(expectedDelta, fabs(expected[i] - d[i]));
+			}
+			double delta = chebyshev5(x.read_as<ACCESS_PAIRS>(), y.read_as<ACCESS_PAIRS>(), y.write_as<ACCESS_PAIRS>(), B,
+									  top, bottom, left, right, w, gamma);
+			y.pairs.readBlock(0, n, actual.data());
+			return_code |= check(w == 1.0 ? "chebyshev first" : "chebyshev", delta, expectedDelta, actual, expected);
+		}
+	}
+
+	// Chebyshev steps with the weights for the grid reach a tolerance in far fewer sweeps than plain ones
+	{
+		const int G = 32;
+		const ChebyshevWeights weights = ChebyshevWeights::forStencil5(G);
+		if(fabs(weights.gamma() - 1.25) > 1e-15 || fabs(weights.rho() - cos(M_PI / (G + 1))) > 1e-15)
+		{
+			cerr << "chebyshev: gamma " << weights.gamma() << ", rho " << weights.rho() << "\n";
+			return_code |= 1;
+		}
+		int sweeps[2];
+		for(int accelerated : { 0, 1 })
+		{
+			ManSegArray grids[2] = { ManSegArray(G*G), ManSegArray(G*G) };
+			vector<double> start(G*G, 1.0);
+			grids[0].pairs.writeBlock(0, G*G, start.data());
+			int k = 0;
+			for(double delta = 1.0; delta > 1e-8 && k < 20000; )
+			{
+				++k;
+				// sweep k is from grids[(k - 1) % 2] into the other, which holds sweep k - 2
+				ManSegArray& a = grids[(k - 1) % 2];
+				ManSegArray& b = grids[k % 2];
+				delta = accelerated
+					? chebyshev5(a.read_as<ACCESS_PAIRS>(), b.read_as<ACCESS_PAIRS>(), b.write_as<ACCESS_PAIRS>(), G,
+								 nullptr, nullptr, nullptr, nullptr, weights.omega(k), weights.gamma())
+					: stencil5(a.read_as<ACCESS_PAIRS>(), b.write_as<ACCESS_PAIRS>(), G, nullptr, nullptr, nullptr, nullptr);
+			}
+			sweeps[accelerated] = k;
+		}
+		cout << "sweeps to 1e-8: plain " << sweeps[0] << ", chebyshev " << sweeps[1] << "\n";
+		if(sweeps[1] * 5 > sweeps[0])
+		{
+			cerr << "chebyshev: no faster than the plain sweeps\n";
+			return_code |= 1;
+		}
+	}
+
+	// the 7 point stencil and red-black SOR over bricks, at the pairs, with some faces missing
+	for(int B : { 7, 8 })
+	for(SimdLevel level : { SIMD_SSE2, SIMD_AVX2 })
+	{
+		setSimdLevel(level);
+		const int n = B*B*B;
+		vector<double> d(n), faces(6*B*B), expected(n), actual(n);
+		for(int i = 0; i < n; ++i) d[i] = dist(gen);
+		for(int i = 0; i < 6*B*B; ++i) faces[i] = dist(gen);
+		BrickHalos h;
+		for(int f : { 0, 3, 4, 5 }) h.face[f] = &faces[f*B*B];
+
+		ManSegArray x(n), y(n);
+		x.pairs.writeBlock(0, n, d.data());
+		double expectedDelta = reference7(d, expected, B, h, false, 0, 0.0);
+		double delta = stencil7(x.read_as<ACCESS_PAIRS>(), y.write_as<ACCESS_PAIRS>(), B, h);
+		y.pairs.readBlock(0, n, actual.data());
+		return_code |= check("stencil7", delta, expectedDelta, actual, expected);
+
+		expected = d;
+		for(int colour : { 0, 1 })
+		{
+			expectedDelta = reference7(d, expected, B, h, true, colour, 1.5);
+			delta = sor7(x.read_as<ACCESS_PAIRS>(), B, h, colour, 1.5);
+			x.pairs.readBlock(0, n, actual.data());
+			return_code |= check("sor7", delta, expectedDelta, actual, expected);
+		}
+	}
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
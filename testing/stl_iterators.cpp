@@ -0,0 +1,159 @@
+#include <iostream>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <vector>
+#if __has_include(<execution>)
+#include <execution>
+#endif
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_algorithm.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 10007;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// an execution policy of the application's own
+struct AppPolicy {};
+
+static_assert(is_same<iterator_traits<HeadsIterator>::iterator_category, random_access_iterator_tag>::value
+	&& is_same<iterator_traits<PairsIterator>::value_type, double>::value, "wrong iterator traits");
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+	vector<double> values(length);
+	for(auto& v : values)
+		v = dist(gen);
+
+	ManSegArray x(length), y(length);
+	x.pairs.writeBlock(0, length, values.data());
+	for(int i = 0; i < length; ++i)
+		y.pairs[i] = values[length - 1 - i];
+
+	// the iterators step through the elements, as proxies
+	if(x.pairs.size() != static_cast<uint_fast64_t>(length) || distance(x.heads.begin(), x.heads.end()) != length
+		|| x.pairs.end() - x.pairs.begin() != length || *(x.pairs.begin() + 5) != values[5] || x.heads.begin()[7] != x.heads[7])
+		return_code |= fail("wrong iteration");
+	int count = 0;
+	for(double v : x.pairs)
+		count += v == values[count];
+	if(count != length)
+		return_code |= fail("wrong range for");
+	HeadsSpan part = x.heads.subspan(100, 50);
+	if(part.end() - part.begin() != 50 || *part.begin() != x.heads[100])
+		return_code |= fail("wrong span iteration");
+
+	// the standard algorithms work on them element by element
+	const double accumulated = std::accumulate(x.pairs.begin(), x.pairs.end(), 0.0);
+	vector<double> copied(length);
+	std::copy(x.heads.begin(), x.heads.end(), copied.begin());
+	for(int i = 0; i < length; ++i)
+		if(copied[i] != x.heads[i])
+		{
+			return_code |= fail("wrong std::copy");
+			break;
+		}
+	ManSegArray z(length);
+	std::transform(x.pairs.begin(), x.pairs.end(), z.pairs.begin(), [](double v) { return 2.0 * v; });
+	if(z.pairs[3] != 2.0 * values[3] || *std::max_element(x.pairs.begin(), x.pairs.end()) != *max_element(values.begin(), values.end()))
+		return_code |= fail("wrong std algorithm");
+
+	// the unqualified calls go to the blocked overloads, which agree with them
+	double sum = 0.0, dot = 0.0;
+	for(int i = 0; i < length; ++i)
+	{
+		sum += values[i];
+		dot += values[i] * values[length - 1 - i];
+	}
+	const double tolerance = 1e-9;
+	if(fabs(reduce(x.pairs.begin(), x.pairs.end(), 0.0) - accumulated) > tolerance || fabs(reduce(x.pairs.begin(), x.pairs.end()) - sum) > tolerance
+		|| fabs(reduce(AppPolicy(), x.pairs.begin(), x.pairs.end(), 1.0) - (1.0 + sum)) > tolerance)
+		return_code |= fail("wrong reduce");
+	double headsSum = 0.0;
+	for(int i = 0; i < length; ++i)
+		headsSum += x.heads[i];
+	if(fabs(reduce(x.heads.begin(), x.heads.end(), 0.0) - headsSum) > tolerance)
+		return_code |= fail("wrong reduce of the heads");
+	if(fabs(transform_reduce(x.pairs.begin(), x.pairs.end(), y.pairs.begin(), 0.0) - dot) > tolerance
+		|| fabs(transform_reduce(AppPolicy(), x.pairs.begin(), x.pairs.end(), values.data(), 0.0) - inner_product(values.begin(), values.end(), values.begin(), 0.0)) > 1e-6)
+		return_code |= fail("wrong dot");
+	auto square = [](double v) { return v * v; };
+	const double squares = transform_reduce(x.pairs.begin(), x.pairs.end(), 0.0, plus<double>(), square);
+	const double maxAbs = transform_reduce(AppPolicy(), x.pairs.begin(), x.pairs.end(), 0.0,
+		[](double a, double b) { return max(a, b); }, [](double v) { return fabs(v); });
+	double squaresRef = 0.0, maxRef = 0.0;
+	for(double v : values)
+	{
+		squaresRef += v * v;
+		maxRef = max(maxRef, fabs(v));
+	}
+	if(squares != squaresRef || maxAbs != maxRef)
+		return_code |= fail("wrong transform_reduce");
+
+	// transform, in place on the heads, and into doubles; heads are truncated as by Head::operator=
+	transform(x.heads.begin(), x.heads.end(), x.heads.begin(), [](double v) { return v / 3.0; });
+	transform(AppPolicy(), x.pairs.begin(), x.pairs.end(), copied.data(), [](double v) { return v + 1.0; });
+	for(int i = 0; i < length; ++i)
+	{
+		float head, tail;
+		splitSegment(values[i], &head, &tail);
+		const double h = headToDouble(headOf(headToDouble(head) / 3.0));
+		if(x.heads[i] != h || copied[i] != segmentsToDouble(headOf(h), tail) + 1.0)
+		{
+			return_code |= fail("wrong transform");
+			break;
+		}
+	}
+	copy(values.data(), values.data() + length, x.pairs.begin());
+	double* end = copy(x.pairs.begin() + 1, x.pairs.end(), copied.data());
+	if(end != copied.data() + length - 1 || !equal(copied.begin(), copied.begin() + length - 1, values.begin() + 1))
+		return_code |= fail("wrong copy");
+
+#if defined(__cpp_lib_execution)
+	if(fabs(reduce(execution::par_unseq, x.pairs.begin(), x.pairs.end(), 0.0) - sum) > tolerance)
+		return_code |= fail("wrong reduce with a standard policy");
+#endif
+
+	// a contiguous array has views of its whole length too
+	ManSegArray c;
+	c.allocContiguous(length);
+	c.pairs.writeBlock(0, length, values.data());
+	if(c.pairs.size() != static_cast<uint_fast64_t>(length) || distance(c.heads.begin(), c.heads.end()) != length
+		|| c.pairs.end() - c.pairs.begin() != length)
+		return_code |= fail("wrong contiguous iteration");
+	count = 0;
+	for(double v : c.pairs)
+		count += v == values[count];
+	if(count != length)
+		return_code |= fail("wrong contiguous range for");
+	if(fabs(reduce(c.pairs.begin(), c.pairs.end(), 0.0) - sum) > tolerance
+		|| fabs(transform_reduce(c.pairs.begin(), c.pairs.end(), y.pairs.begin(), 0.0) - dot) > tolerance)
+		return_code |= fail("wrong contiguous reduce");
+	end = copy(c.pairs.begin(), c.pairs.end(), copied.data());
+	if(end != copied.data() + length || !equal(copied.begin(), copied.end(), values.begin()))
+		return_code |= fail("wrong contiguous copy");
+	c.delSegments();
+
+	x.del();
+	y.del();
+	z.del();
+
+	if(return_code == 0)
+		cout << "stl iterators: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1e6, 1e6);
+
+	for(int level = SIMD_SSE2; level <= simdLevel(); ++level)
+	{
+		const SimdLevel widest = simdLevel();
+		setSimdLevel(static_cast<SimdLevel>(level));
+
+		for(const uint_fast64_t length : { 0, 1, 7, 31, 100003 })
+		{
+			vector<double> values(length);
+			for(auto& v : values)
+				v = dist(gen);
+
+			// promote gives the pairs, copytoIEEEdouble the heads
+			ManSegArray x(length), y(length);
+			x.pairs.writeBlock(0, length, values.data());
+			y.pairs.writeBlock(0, length, values.data());
+			x.promote();
+			y.copytoIEEEdouble();
+			for(uint_fast64_t i = 0; i < length; ++i)
+				if(x.full[i] != values[i] || y.full[i] != static_cast<double>(y.heads[i]))
+				{
+					return_code |= fail("wrong promotion");
+					break;
+				}
+
+			// streamed from any offset into any alignment of out
+			for(uint_fast64_t offset = 0; offset < 4 && offset < length; ++offset)
+			{
+				vector<double> out(length + 8, -1.0);
+				const uint_fast64_t n = length - offset;
+				streamSegments(x.pairs.getHeads() + offset, x.pairs.getTails() + offset, n, out.data() + offset + 1);
+				for(uint_fast64_t i = 0; i < n; ++i)
+					if(out[offset + 1 + i] != values[offset + i])
+					{
+						return_code |= fail("wrong streamed pairs");
+						break;
+					}
+				streamSegments(x.heads.getHeads() + offset, nullptr, n, out.data() + offset);
+				for(uint_fast64_t i = 0; i < n; ++i)
+					if(out[offset + i] != static_cast<double>(x.heads[offset + i]))
+					{
+						return_code |= fail("wrong streamed heads");
+						break;
+					}
+				if(out[offset + n + 1] != -1.0)
+					return_code |= fail("streamed past the end");
+			}
+		}
+		setSimdLevel(widest);
+	}
+
+	if(return_code == 0)
+		cout << "streaming promotion: all tests passed\n";
+	return return_code;
+}
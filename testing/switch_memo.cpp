@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "util.h"
+#include "../manseglib_switchmemo.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+typedef PrecisionController<MemoisedPolicy<StagnationPolicy> > Controller;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// a solve whose heads fall by 0.4 an iteration for 8 iterations, then by 0.7 for 3 and by 0.8 after
+// (when the stagnation policy leaves them, at iteration 12); at full precision by 0.4 again, to 1e-9.
+// The deltas after iteration skew are scaled by skewBy.
+void solve(SwitchMemo& memo, Controller& control, const int& skew = 0, const double& skewBy = 1.0)
+{
+	double delta = 1.0;
+	for(int iter = 1; delta > 1e-9 && iter < 200; ++iter)
+	{
+		const double rate = control.level() != PRECISION_HEADS ? 0.4 : (iter <= 8 ? 0.4 : (iter <= 11 ? 0.7 : 0.8));
+		delta *= rate * (iter == skew ? skewBy : 1.0);
+		memo.observe(delta);
+		control.update(delta);
+	}
+}
+
+void writeFile(const string& path, const string& contents)
+{
+	FILE* f = fopen(path.c_str(), "w");
+	fwrite(contents.data(), 1, contents.size(), f);
+	fclose(f);
+}
+
+int main()
+{
+	int return_code = 0;
+	char dir[] = "/tmp/switch_memo_XXXXXX";
+	if(mkdtemp(dir) == nullptr)
+		return fail("no directory for the records");
+	const string d(dir);
+
+	// the fingerprint follows the contents, not the name
+	const string big(1 << 18, 'x');
+	writeFile(d + "/a", big);
+	writeFile(d + "/b", big);
+	writeFile(d + "/c", big.substr(1) + "y");
+	const uint64_t input = inputFingerprint((d + "/a").c_str());
+	if(input == 0 || input != inputFingerprint((d + "/b").c_str()) || input == inputFingerprint((d + "/c").c_str())
+		|| inputFingerprint((d + "/missing").c_str()) != 0)
+		return_code |= fail("the fingerprints do not tell the inputs apart");
+
+	// without a record the policy switches online, and the run is recorded
+	{
+		SwitchMemo memo(input, "test", dir, 0.01);
+		Controller control(memo.policy(StagnationPolicy(0.25)));
+		solve(memo, control);
+		if(!memo.enabled() || memo.found() || control.switchIteration(PRECISION_INTERIM) != 12 || control.reason() != SWITCH_STAGNATION)
+			return_code |= fail("the first run does not switch as its policy does");
+		if(!memo.save(control, "stagnation 0.25"))
+			return_code |= fail("the first run is not recorded");
+	}
+
+	// the record: the heads deltas, and the best switch, after the last iteration to fall by at least sqrt(0.4)
+	{
+		SwitchMemo memo(input, "test", dir, 0.01);
+		if(!memo.found())
+			return_code |= fail("the record is not found");
+		else
+		{
+			const SwitchRecord& r = memo.remembered();
+			if(r.policy != "stagnation 0.25" || r.observed != 12 || r.deltas.size() != 12 || r.best != 8
+				|| fabs(r.fullRate - 0.4) > 1e-9 || fabs(r.deltas[3] - pow(0.4, 4)) > 1e-15)
+				return_code |= fail("the record is not what the run did");
+		}
+
+		// a run that follows it switches at the best iteration, and leaves the record as it is
+		Controller control(memo.policy(StagnationPolicy(0.25)));
+		solve(memo, control);
+		if(control.switchIteration(PRECISION_INTERIM) != 8 || control.reason() != SWITCH_REMEMBERED || control.policy().diverged)
+			return_code |= fail("a run that follows the record does not switch where it says");
+		if(memo.save(control, "stagnation 0.25"))
+			return_code |= fail("a run that followed its record is recorded again");
+	}
+
+	// the same input with other parameters has no record
+	if(SwitchMemo(input, "other", dir, 0.01).found() || SwitchMemo(input, "test", nullptr, 0.01).enabled())
+		return_code |= fail("a record is found for other parameters, or without a directory");
+
+	// a run whose deltas leave the record's is switched by its policy, and replaces the record
+	{
+		SwitchMemo memo(input, "test", dir, 0.01);
+		Controller control(memo.policy(StagnationPolicy(0.25)));
+		solve(memo, control, 3, 1.05);
+		if(!control.policy().diverged || control.switchIteration(PRECISION_INTERIM) != 12 || control.reason() != SWITCH_STAGNATION)
+			return_code |= fail("a run that diverged from its record does not fall back on its policy");
+		if(!memo.save(control, "stagnation 0.25"))
+			return_code |= fail("a run that diverged is not recorded");
+		SwitchMemo again(input, "test", dir, 0.01);
+		if(!again.found() || fabs(again.remembered().deltas[3] - pow(0.4, 4) * 1.05) > 1e-15)
+			return_code |= fail("the record is not replaced");
+	}
+
+	// within tolerance is following
+	{
+		SwitchMemo memo(input, "test", dir, 0.1);
+		Controller control(memo.policy(StagnationPolicy(0.25)));
+		solve(memo, control, 5, 1.05);
+		if(control.policy().diverged || control.switchIteration(PRECISION_INTERIM) != 8)
+			return_code |= fail("a run within tolerance of its record does not follow it");
+	}
+
+	// a record cut short is not read
+	{
+		SwitchMemo memo(input, "cut", dir, 0.01);
+		Controller control(memo.policy(StagnationPolicy(0.25)));
+		solve(memo, control);
+		memo.save(control);
+		for(const char* f : { "/a", "/b", "/c" })
+			unlink((d + f).c_str());
+		DIR* records = opendir(dir);
+		for(dirent* e = readdir(records); e != nullptr; e = readdir(records))
+			if(e->d_name[0] != '.')
+				truncate((d + "/" + e->d_name).c_str(), 40);
+		closedir(records);
+		if(SwitchMemo(input, "cut", dir, 0.01).found() || SwitchMemo(input, "test", dir, 0.01).found())
+			return_code |= fail("a record cut short is read");
+	}
+
+	system(("rm -rf " + d).c_str());
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_controller.hpp"
+#include "../manseglib_mapped.hpp"
+#include "../manseglib_prefetch.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1 << 20;    // 4 MB planes: two chunks
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// pages of [p, p + n) in memory
+size_t resident(const float* p, const uint_fast64_t& n)
+{
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	char* first = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(p) / page * page);
+	const size_t bytes = reinterpret_cast<const char*>(p + n) - first;
+	vector<unsigned char> in((bytes + page - 1) / page);
+	if(mincore(first, bytes, in.data()) != 0)
+		return 0;
+	size_t count = 0;
+	for(size_t i = 0; i < in.size(); ++i)
+		count += in[i] & 1;
+	return count;
+}
+
+bool near(const double& a, const double& b) { return fabs(a - b) < 1e-9; }
+
+int main()
+{
+	int return_code = 0;
+
+	// the switch estimate: iterations for the delta to reach the bound at its last rate of decrease
+	PrecisionController<AbsoluteBoundPolicy> bound(AbsoluteBoundPolicy(1e-4));
+	if(!isinf(bound.iterationsToSwitch()))
+		return_code |= fail("an estimate before any delta");
+	bound.update(1.0);
+	bound.update(0.1);
+	if(!near(bound.iterationsToSwitch(), 3.0))
+		return_code |= fail("wrong estimate for a bound");
+	bound.update(0.2);
+	if(!isinf(bound.iterationsToSwitch()))
+		return_code |= fail("an estimate for a rising delta");
+	bound.update(1e-5);
+	if(bound.level() == PRECISION_HEADS || bound.iterationsToSwitch() != 0.0)
+		return_code |= fail("an estimate after the switch");
+
+	PrecisionController<PredictedIterationsPolicy> predicted(PredictedIterationsPolicy(1e-8, 2.0));
+	predicted.update(1.0);
+	predicted.update(0.1);
+	if(!near(predicted.iterationsToSwitch(), 5.0))
+		return_code |= fail("the lookahead is not taken off the estimate");
+
+	PrecisionController<EitherPolicy<AbsoluteBoundPolicy, ResidualHistoryPolicy> > either(
+		EitherPolicy<AbsoluteBoundPolicy, ResidualHistoryPolicy>(AbsoluteBoundPolicy(1e-6), ResidualHistoryPolicy(4, 0.9, 1e-3)));
+	either.update(1.0);
+	either.update(0.1);
+	if(!near(either.iterationsToSwitch(), 2.0))
+		return_code |= fail("combined policies do not take the nearer switch");
+
+	ConfiguredPolicy configured;
+	configured.kind = ConfiguredPolicy::FULL;
+	if(PrecisionController<ConfiguredPolicy>(configured).iterationsToSwitch() != 0.0)
+		return_code |= fail("the full policy is not about to switch");
+
+	// lazy tails: untouched until warmed, then in memory with their values kept
+	LazyManSegArray x(length);
+	for(int i = 0; i < length; ++i)
+		x.heads.set(i, 1.0 + i * 1e-3);
+	if(resident(x.heads.getTails(), length) != 0)
+		cout << "(tails already resident: the residency checks below are not meaningful here)\n";
+	x.pairs.set(12345, 7.25 + 1e-12);
+	{
+		TailWarmer warmer(2);
+		if(warmer.started() || !warmer.done())
+			return_code |= fail("a new warmer has started");
+		warmer.warm(x.heads, length);
+		warmer.wait();
+		if(!warmer.started() || !warmer.done())
+			return_code |= fail("the warmer did not finish");
+	}
+	const uintptr_t page = sysconf(_SC_PAGESIZE);
+	if(resident(x.heads.getTails(), length) < (length * sizeof(float)) / page)
+		return_code |= fail("the tails were not faulted in");
+	if(x.pairs.read(12345) != 7.25 + 1e-12 || x.heads.getTails()[0] != 0.0f)
+		return_code |= fail("warming changed a value");
+	for(int i = 0; i < length; i += 4099)
+		if(i != 12345 && x.pairs.read(i) != x.heads.read(i))
+		{
+			return_code |= fail("warming changed a tail");
+			break;
+		}
+	x.del();
+
+	// mapped tails: read in from the file
+	const char* path = "tail_warming_test.seg";
+	ManSegArray y(length);
+	for(int i = 0; i < length; ++i)
+		y.pairs.set(i, 1.0 + sin(i) * 0.5 + i * 1e-9);
+	if(!writeSegments(path, y.heads, length))
+		return fail("cannot write the segments");
+	uint_fast64_t n = 0;
+	MappedSegments mapped = mapSegments(path, n);
+	if(!mapped.isAlloc() || n != length)
+		return fail("cannot map the segments");
+	{
+		TailWarmer warmer;
+		warmer.warm(mapped, n);
+	}
+	MappedPairs pairs = mapped.createFullPrecision();
+	for(int i = 0; i < length; ++i)
+		if(pairs.read(i) != y.pairs.read(i))
+		{
+			return_code |= fail("a mapped value did not survive warming");
+			break;
+		}
+	mapped.del();
+	y.del();
+	remove(path);
+
+	if(return_code == 0)
+		cout << "tail warming: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "../manseglib_telemetry.hpp"
+#include "../manseglib_results.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int updates = 200000;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	const string name = "/manseg_telemetry_test_" + to_string(getpid());
+	int return_code = 0;
+
+	{
+		TelemetryReader missing(name.c_str());
+		if(missing.isOpen())
+			return_code |= fail("a segment that was never created is open");
+		Telemetry off("test", nullptr);
+		if(off.enabled())
+			return_code |= fail("telemetry without a name is enabled");
+		off.publish(0, 1, 0.5, 1.0, "heads", 8.0);
+	}
+
+	// a writer publishes iterations whose fields all follow from the iteration, while a reader checks
+	// that every copy it gets is of one iteration
+	{
+		Telemetry writer("telemetry_test", name.c_str());
+		if(!writer.enabled())
+			return fail("cannot create the segment");
+		TelemetryReader reader(name.c_str());
+		TelemetrySnapshot s;
+		if(!reader.read(s) || s.updates != 0 || s.iteration != 0 || s.finished || string(s.app) != "telemetry_test"
+			|| s.pid != (uint64_t)getpid())
+			return_code |= fail("the new block is not empty");
+
+		atomic<bool> done(false);
+		thread t([&]()
+		{
+			for(int i = 1; i <= updates; ++i)
+				writer.publish(i / 1000, i, 1.0 / i, 0.5 * i, (i & 1) ? "heads" : "pairs", 4.0 * i);
+			done.store(true);
+		});
+
+		int64_t last = 0;
+		long reads = 0, torn = 0;
+		while(!done.load() || last < updates)
+		{
+			if(!reader.read(s))
+				continue;
+			++reads;
+			const int64_t i = s.iteration;
+			if(i == 0)
+				continue;
+			if(i < last || s.round != i / 1000 || s.delta != 1.0 / i || s.seconds != 0.5 * i || s.bytes != 4.0 * i
+				|| s.bytesPerSecond != 8.0 || s.updates != (uint64_t)i || string(s.level) != ((i & 1) ? "heads" : "pairs"))
+				++torn;
+			last = i;
+		}
+		t.join();
+		if(torn > 0)
+		{
+			cerr << torn << " of " << reads << " reads mixed two iterations\n";
+			return_code |= 1;
+		}
+		const double elapsed = 0.5 * updates * (updates + 1) / 2.0;
+		if(!reader.read(s) || s.iteration != updates || s.elapsed != elapsed || s.finished)
+			return_code |= fail("the last iteration is not the one read");
+	}
+
+	// the block outlives its writer, marked finished
+	{
+		TelemetryReader reader(name.c_str());
+		TelemetrySnapshot s;
+		if(!reader.read(s) || !s.finished || s.iteration != updates)
+			return_code |= fail("the block is not left finished with the last iteration");
+	}
+
+	// a ResultsWriter publishes the iterations it records, with its round, whether it writes results or not
+	{
+		setenv("MANSEG_TELEMETRY", name.c_str(), 1);
+		{
+			ResultsWriter results("results_test", nullptr);
+			results.round(3);
+			results.iteration(7, 0.25, 2.0, "heads", 100.0);
+			TelemetryReader reader(name.c_str());
+			TelemetrySnapshot s;
+			if(!reader.read(s) || s.round != 3 || s.iteration != 7 || s.delta != 0.25 || s.bytesPerSecond != 50.0
+				|| string(s.level) != "heads" || string(s.app) != "results_test" || s.finished)
+				return_code |= fail("ResultsWriter does not publish its iterations");
+		}
+		unsetenv("MANSEG_TELEMETRY");
+		TelemetryReader reader(name.c_str());
+		TelemetrySnapshot s;
+		if(!reader.read(s) || !s.finished)
+			return_code |= fail("the ResultsWriter's block is not finished when it goes");
+	}
+
+	if(!TelemetryReader::remove(name.c_str()))
+		return_code |= fail("cannot remove the segment");
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <cmath>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_tiered.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 100001;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// the node preferred for the page of p, or -1 if there is no preference
+int preferred(const void* p)
+{
+	int mode = -1;
+	unsigned long mask[16] = {0};
+	if(syscall(SYS_get_mempolicy, &mode, mask, 16 * 8 * sizeof(unsigned long), p, tierAddress) != 0 || mode != tierPreferred)
+		return -1;
+	for(int node = 0; node < 16 * 64; ++node)
+		if(mask[node / 64] >> (node % 64) & 1)
+			return node;
+	return -1;
+}
+
+int main()
+{
+	int return_code = 0;
+
+	// node 0 always exists: both planes preferred there, values as for any array
+	TieredManSegArray x(length, TieredSegmentAllocator(0, 0));
+	x.allocFull();
+	for(int i = 0; i < length; ++i)
+	{
+		x.pairs.set(i, 1.0 + sin(i) * 0.5 + i * 1e-9);
+		x.full[i] = x.pairs.read(i);
+	}
+	if(preferred(x.heads.getHeads()) != 0 || preferred(x.heads.getTails() + length / 2) != 0 || preferred(x.full) != 0)
+		return_code |= fail("the planes are not placed on their node");
+	if(nodeOf(x.heads.getTails()) != 0)
+		return_code |= fail("a written tail is not on node 0");
+	if(!moveTails(x.pairs, length))
+		return_code |= fail("cannot move the tails to the heads' node");
+	for(int i = 0; i < length; ++i)
+		if(x.pairs.read(i) != x.full[i])
+		{
+			return_code |= fail("a value did not survive the placement");
+			break;
+		}
+	x.del();
+
+	// no nodes: nothing placed
+	TieredManSegArray y(length);
+	if(preferred(y.heads.getHeads()) != -1 || preferred(y.heads.getTails()) != -1)
+		return_code |= fail("an array without nodes was placed");
+	y.del();
+
+	// a node that does not exist is refused, and the array still works where it lands
+	TieredManSegArray z(length, TieredSegmentAllocator(0, 1000, true));
+	z.pairs.set(7, 3.25);
+	if(z.pairs.read(7) != 3.25 || preferred(z.heads.getTails()) == 1000)
+		return_code |= fail("an array on a missing node does not work");
+	z.del();
+
+	// the environment
+	setenv("MANSEG_HEADS_NODE", "0", 1);
+	setenv("MANSEG_TAILS_NODE", "2", 1);
+	setenv("MANSEG_TAILS_MIGRATE", "1", 1);
+	TieredSegmentAllocator tiers = TieredSegmentAllocator::fromEnvironment();
+	if(tiers.headsNode != 0 || tiers.tailsNode != 2 || !tiers.migrate)
+		return_code |= fail("the tiers are not read from the environment");
+	unsetenv("MANSEG_TAILS_NODE");
+	if(TieredSegmentAllocator::fromEnvironment().tailsNode != -1)
+		return_code |= fail("an unset node is not -1");
+
+	if(return_code == 0)
+		cout << "tiered placement: all tests passed\n";
+	return return_code;
+}
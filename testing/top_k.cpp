@@ -0,0 +1,88 @@
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib_rank.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// odd length, and enough values to split between threads
+constexpr int length = 200003;
+
+// the indices of the k largest values, largest first, equal values by index
+vector<uint_fast64_t> reference(const double* x, const int& n, const int& k)
+{
+	vector<uint_fast64_t> idx(n);
+	for(int i = 0; i < n; ++i)
+		idx[i] = i;
+	stable_sort(idx.begin(), idx.end(), [x](const uint_fast64_t& a, const uint_fast64_t& b) { return x[a] > x[b]; });
+	idx.resize(min(k, n));
+	return idx;
+}
+
+int check(const char* name, const vector<uint_fast64_t>& actual, const vector<uint_fast64_t>& expected)
+{
+	if(actual != expected)
+	{
+		cerr << name << " mismatch (" << actual.size() << " and " << expected.size() << " indices)\n";
+		for(size_t i = 0; i < min(actual.size(), expected.size()); ++i)
+			if(actual[i] != expected[i])
+			{
+				cerr << "first difference at " << i << ": expected " << expected[i] << ", actual " << actual[i] << "\n";
+				break;
+			}
+		return 1;
+	}
+	return 0;
+}
+
+int main()
+{
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-1.0, 1.0);
+
+	ManSegArray x(length);
+	double* full = new double[length];
+	for(int i = 0; i < length; ++i)
+	{
+		full[i] = dist(gen);
+		// runs of values with equal heads, told apart only by their tails
+		if(i % 7 == 0)
+			full[i] = 0.5 + i * 1e-15;
+		// and exact ties, ranked by index
+		if(i % 11 == 0)
+			full[i] = 0.25;
+		x.pairs[i] = full[i];
+	}
+
+	int return_code = 0;
+	for(int k : {0, 1, 10, 1000, 30000, length + 5})
+	{
+		vector<uint_fast64_t> expected = reference(full, length, k);
+		return_code |= check("heads", topK(x.heads, length, k), expected);
+		return_code |= check("pairs", topK(x.pairs, length, k), expected);
+		return_code |= check("full", topK(full, length, k), expected);
+	}
+
+	// a prefix of the array
+	return_code |= check("prefix", topK(x.heads, 1000, 50), reference(full, 1000, 50));
+
+	// values only written at the heads: equal heads are ranked by index
+	ManSegArray h(length);
+	vector<double> truncated(length);
+	for(int i = 0; i < length; ++i)
+	{
+		h.heads[i] = full[i];
+		truncated[i] = h.heads[i];
+	}
+	return_code |= check("heads only", topK(h.heads, length, 500), reference(truncated.data(), length, 500));
+
+	delete[] full;
+
+	if(return_code == 0)
+		cout << "top k: all tests passed\n";
+	return return_code;
+}
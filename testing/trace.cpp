@@ -0,0 +1,103 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#define MANSEG_TRACE 1
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_controller.hpp"
+#include "../manseglib_trace.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// number of times s occurs in text
+int occurrences(const string& text, const string& s)
+{
+	int n = 0;
+	for(size_t pos = text.find(s); pos != string::npos; pos = text.find(s, pos + 1))
+		++n;
+	return n;
+}
+
+void worker()
+{
+	MANSEG_TRACE_SCOPE("worker");
+	MANSEG_TRACE_INSTANT_ARG("marker", "value", 2.5);
+}
+
+int main()
+{
+	int return_code = 0;
+	const char* path = "trace_test.json";
+
+	{
+		MANSEG_TRACE_SCOPE_ARG("iteration", "iter", 1);
+		ManSegArray a(1000);
+		a.copytoIEEEdouble();
+		a.delSegments();
+		a.del();
+	}
+
+	PrecisionController<> control(AbsoluteBoundPolicy(1e-3));
+	control.update(1.0);
+	control.update(1e-4);   // to interim
+	control.update(1e-5);   // to full
+
+	thread t1(worker), t2(worker);
+	t1.join();
+	t2.join();
+
+	if(!MANSEG_TRACE_WRITE(path))
+	{
+		cerr << "could not write " << path << "\n";
+		return 1;
+	}
+	ifstream f(path);
+	stringstream ss;
+	ss << f.rdbuf();
+	const string text = ss.str();
+
+	if(text.find("\"traceEvents\":[") == string::npos || text.substr(text.size() - 4) != "\n]}\n")
+	{
+		cerr << "trace is not a traceEvents object\n";
+		return_code = 1;
+	}
+	if(occurrences(text, "\"name\":\"iteration\",\"ph\":\"X\"") != 1 || occurrences(text, "\"args\":{\"iter\":1}") != 1
+		|| occurrences(text, "\"name\":\"copytoIEEEdouble\",\"ph\":\"X\"") != 1)
+	{
+		cerr << "iteration or promotion span missing\n";
+		return_code = 1;
+	}
+	if(occurrences(text, "\"name\":\"switch to interim\",\"ph\":\"i\"") != 1 || occurrences(text, "\"name\":\"switch to full\",\"ph\":\"i\"") != 1)
+	{
+		cerr << "precision switches missing\n";
+		return_code = 1;
+	}
+	// the main thread and both workers have their own track
+	if(occurrences(text, "\"thread_name\"") != 3 || occurrences(text, "\"name\":\"worker\"") != 2
+		|| occurrences(text, "\"name\":\"marker\",\"ph\":\"i\"") != 2 || occurrences(text, "\"args\":{\"value\":2.5}") != 2)
+	{
+		cerr << "thread spans missing\n";
+		return_code = 1;
+	}
+
+	// cleared events are not written again
+	MANSEG_TRACE_CLEAR();
+	MANSEG_TRACE_WRITE(path);
+	ifstream g(path);
+	stringstream cleared;
+	cleared << g.rdbuf();
+	if(occurrences(cleared.str(), "\"ph\":\"X\"") != 0)
+	{
+		cerr << "events remain after clear\n";
+		return_code = 1;
+	}
+	remove(path);
+
+	if(return_code == 0)
+		cout << "trace test passed\n";
+	return return_code;
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define MANSEG_TRAFFIC 1
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_adaptive.hpp"
+#include "../manseglib_traffic.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+// compares each counter of the traffic since before with expected (zero where not given)
+int expect(const char* name, const Traffic::Totals& before, const vector<pair<Traffic::Counter, uint64_t>>& expected)
+{
+	Traffic::Totals t = Traffic::totals() - before;
+	Traffic::Totals e;
+	for(size_t i = 0; i < expected.size(); ++i)
+		e.count[expected[i].first] = expected[i].second;
+	int return_code = 0;
+	for(int c = 0; c < Traffic::NUM_COUNTERS; ++c)
+		if(t.count[c] != e.count[c])
+		{
+			cerr << name << ": " << Traffic::counterName((Traffic::Counter)c) << " " << t.count[c] << ", expected " << e.count[c] << "\n";
+			return_code = 1;
+		}
+	return return_code;
+}
+
+int main()
+{
+	static_assert(Traffic::enabled, "built with MANSEG_TRAFFIC");
+	static_assert(alignof(Traffic::ThreadCounters) == 64, "each thread's counters are a cache line of their own");
+
+	int return_code = 0;
+	const uint64_t n = 1000;
+	vector<double> values(n, 1.5);
+
+	ManSegArray a(n);
+	Traffic::Totals before = Traffic::totals();
+
+	// blocks: 4 bytes a value at the heads, 8 at the pairs
+	a.heads.writeBlock(0, n, values.data());
+	a.heads.readBlock(0, n, values.data());
+	return_code |= expect("heads blocks", before, { { Traffic::HEADS_WRITTEN, 4 * n }, { Traffic::HEADS_READ, 4 * n } });
+
+	before = Traffic::totals();
+	a.pairs.writeBlock(0, n, values.data());
+	a.pairs.readBlock(0, n / 2, values.data());
+	return_code |= expect("pairs blocks", before, { { Traffic::PAIRS_WRITTEN, 8 * n }, { Traffic::PAIRS_READ, 4 * n } });
+
+	// elements through the proxies; a read-modify-write is a read and a write
+	before = Traffic::totals();
+	a.heads[0] = 2.0;
+	double d = a.heads[1];
+	a.heads[2] += d;
+	a.pairs[3] = a.pairs[4];
+	a.pairs.set(5, 1.0);
+	return_code |= expect("elements", before, { { Traffic::HEADS_WRITTEN, 8 }, { Traffic::HEADS_READ, 8 },
+		{ Traffic::PAIRS_READ, 8 }, { Traffic::PAIRS_WRITTEN, 16 } });
+
+	// gathers and scatter-adds read (and write) only the elements indexed
+	before = Traffic::totals();
+	vector<int32_t> idx = { 7, 3, 3, 900 };
+	vector<double> out(idx.size());
+	gatherHeads(a.heads.getHeads(), idx.data(), idx.size(), out.data());
+	gatherSegments(a.pairs.getHeads(), a.pairs.getTails(), idx.data(), idx.size(), out.data());
+	scatterAddHeads(a.heads.getHeads(), idx.data(), idx.size(), 1.0);
+	return_code |= expect("indirect", before, { { Traffic::HEADS_READ, 32 }, { Traffic::HEADS_WRITTEN, 16 }, { Traffic::PAIRS_READ, 32 } });
+
+	// promotion: the pairs are read once and the full values streamed out
+	before = Traffic::totals();
+	a.promote();
+	return_code |= expect("promote", before, { { Traffic::PROMOTED, n }, { Traffic::PAIRS_READ, 8 * n }, { Traffic::FULL_WRITTEN, 8 * n } });
+
+	before = Traffic::totals();
+	FullView full = a.read_as<ACCESS_FULL>();
+	full.readBlock(0, n, values.data());
+	full.set(0, 3.0);
+	return_code |= expect("full", before, { { Traffic::FULL_READ, 8 * n }, { Traffic::FULL_WRITTEN, 8 } });
+
+	// promoting a block of a BlockAdaptiveArray moves no data
+	BlockAdaptiveArray<> blocks(4, 64);
+	before = Traffic::totals();
+	blocks.promote(1);
+	blocks.promote(1);
+	return_code |= expect("block promote", before, { { Traffic::PROMOTED, 64 } });
+	blocks.del();
+
+	// threads count into their own counters, which outlive them in the totals
+	before = Traffic::totals();
+	vector<thread> threads;
+	for(int t = 0; t < 4; ++t)
+		threads.push_back(thread([&a, t]()
+		{
+			double buf[250];
+			for(int r = 0; r < 100; ++r)
+				a.heads.readBlock(t * 250, 250, buf);
+		}));
+	for(size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	return_code |= expect("threads", before, { { Traffic::HEADS_READ, 4 * 4 * 100 * 250 } });
+
+	Traffic::Totals total = Traffic::totals();
+	cout << "counted " << total.bytesRead() << " bytes read, " << total.bytesWritten() << " written, "
+		 << total[Traffic::PROMOTED] << " elements promoted\n";
+	if(total.bytes() != total.bytesRead() + total.bytesWritten() || total.bytesRead() == 0)
+	{
+		cerr << "totals: the bytes do not add up\n";
+		return_code = 1;
+	}
+
+	Traffic::clear();
+	return_code |= expect("clear", Traffic::Totals(), {});
+
+	if(return_code == 0)
+		cout << "test passed !" << endl;
+	else
+		cerr << "test failed !" << endl;
+
+	return return_code;
+}
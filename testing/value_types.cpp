@@ -0,0 +1,162 @@
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1003;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+// CAS and writeAdd as in Ligra's utils.h, which copy through volatile temporaries
+template <class ET>
+inline bool CAS(ET *ptr, ET oldv, ET newv)
+{
+	if (sizeof(ET) == 8)
+	{
+		long* o = (long*) &oldv;
+		long* n = (long*) &newv;
+		return __sync_bool_compare_and_swap((long*)ptr, *o, *n);
+	}
+	int* o = (int*) &oldv;
+	int* n = (int*) &newv;
+	return __sync_bool_compare_and_swap((int*)ptr, *o, *n);
+}
+
+template <class ET>
+inline void writeAdd(ET *a, ET b)
+{
+	volatile ET newV, oldV;
+	do
+	{
+		oldV = *a;
+		newV = oldV + b;
+	}
+	while (!CAS(a, oldV, newV));
+}
+
+static_assert(is_trivially_copyable<h32>::value && sizeof(h32) == 4, "h32 is not a 32-bit value");
+static_assert(is_trivially_copyable<seg64>::value && sizeof(seg64) == 8, "seg64 is not a 64-bit value");
+static_assert(is_standard_layout<h32>::value && is_standard_layout<seg64>::value, "value types are not standard layout");
+#if defined(MANSEG_HAS_BIT_CAST)
+static_assert(static_cast<double>(h32(1.5)) == 1.5 && h32(-2.0).bits == 0xC0000000u, "h32 conversions are not constexpr");
+static_assert(static_cast<double>(seg64(0.1)) == 0.1 && seg64(0.1).head().bits == h32(0.1).bits, "seg64 conversions are not constexpr");
+#endif
+
+int main()
+{
+	int return_code = 0;
+	mt19937 gen(5489);
+	uniform_real_distribution<double> dist(-10.0, 10.0);
+
+	// conversions agree with the proxies and the element functions
+	ManSegArray a(length);
+	vector<h32> heads(length);
+	vector<seg64> pairs(length);
+	for(int i = 0; i < length; ++i)
+	{
+		const double v = dist(gen);
+		a.pairs[i] = v;
+		heads[i] = v;
+		pairs[i] = seg64(v);
+		if(heads[i].asFloat() != headOf(v) || static_cast<double>(heads[i]) != a.heads[i] || h32(a.heads[i]).bits != heads[i].bits
+			|| static_cast<double>(pairs[i]) != v || seg64(a.pairs[i]).bits != pairs[i].bits || pairs[i].head().bits != heads[i].bits
+			|| h32::round<ROUND_NEAREST>(v).asFloat() != roundToHead<ROUND_NEAREST>(v))
+		{
+			return_code |= fail("wrong conversion");
+			break;
+		}
+	}
+
+	// arithmetic: h32 with h32 stays a head, mixed with a double it is a double, seg64 is exact
+	const double x = 1.1, y = -2.333333;
+	const h32 hx(x), hy(y);
+	static_assert(is_same<decltype(hx + hy), h32>::value && is_same<decltype(hx * 2.0), double>::value
+		&& is_same<decltype(seg64(x) - seg64(y)), seg64>::value, "wrong result types");
+	if((hx + hy).bits != h32(static_cast<double>(hx) + static_cast<double>(hy)).bits
+		|| (hx / hy).bits != h32(static_cast<double>(hx) / static_cast<double>(hy)).bits
+		|| hx * 2.0 != static_cast<double>(hx) * 2.0 || 1.0 - hx != 1.0 - static_cast<double>(hx)
+		|| static_cast<double>(seg64(x) * seg64(y)) != x * y || static_cast<double>(-hx) != -static_cast<double>(hx)
+		|| static_cast<double>(-seg64(y)) != -y || !(hy < hx) || hx != h32(x))
+		return_code |= fail("wrong arithmetic");
+	h32 acc(0.0);
+	seg64 exact(0.0);
+	Head proxy(&a.heads.getHeads()[0]);
+	proxy = 0.0;
+	for(int i = 0; i < 100; ++i)
+	{
+		acc += 0.1;
+		exact += 0.1;
+		proxy += 0.1;
+	}
+	if(acc.asFloat() != *proxy.head)
+		return_code |= fail("h32 accumulation is not the Head's");
+	double sum = 0.0;
+	for(int i = 0; i < 100; ++i)
+		sum += 0.1;
+	if(static_cast<double>(exact) != sum)
+		return_code |= fail("seg64 accumulation is not the double's");
+
+	// a copy of a proxy refers to the same segment
+	Head copy(proxy);
+	copy = 2.0;
+	if(copy.head != proxy.head || static_cast<double>(proxy) != 2.0)
+		return_code |= fail("a copied Head does not refer to the same head");
+
+	// Ligra's writeAdd and CAS, and std::atomic, from several threads
+	const int threads = 4, adds = 10000;
+	h32 ligraHead(0.0);
+	seg64 ligraPair(0.0), casPair(0.0);
+	atomic<h32> atomicHead(h32(0.0));
+	atomic<seg64> atomicPair(seg64(0.0));
+	vector<thread> workers;
+	for(int t = 0; t < threads; ++t)
+		workers.emplace_back([&]()
+		{
+			for(int k = 0; k < adds; ++k)
+			{
+				writeAdd(&ligraHead, h32(1.0));
+				writeAdd(&ligraPair, seg64(0.5));
+				atomicAdd(&casPair, 0.25);
+				h32 expected = atomicHead.load();
+				while(!atomicHead.compare_exchange_weak(expected, h32(expected + h32(1.0))))
+					;
+				seg64 old = atomicPair.load();
+				while(!atomicPair.compare_exchange_weak(old, old + seg64(2.0)))
+					;
+			}
+		});
+	for(auto& w : workers)
+		w.join();
+	// integers are exact in a head up to 2^21
+	if(static_cast<double>(ligraHead) != threads * adds || static_cast<double>(ligraPair) != 0.5 * threads * adds
+		|| static_cast<double>(casPair) != 0.25 * threads * adds || static_cast<double>(atomicHead.load()) != threads * adds
+		|| static_cast<double>(atomicPair.load()) != 2.0 * threads * adds)
+		return_code |= fail("lost updates");
+	if(!atomic<h32>().is_lock_free() || !atomic<seg64>().is_lock_free())
+		return_code |= fail("atomics of the value types are not lock free");
+
+	// atomicAdd on a head truncates as h32 addition does
+	h32 single(0.3);
+	atomicAdd(&single, 0.7);
+	if(single.bits != h32(static_cast<double>(h32(0.3)) + 0.7).bits)
+		return_code |= fail("wrong atomicAdd of a head");
+
+	a.del();
+
+	if(return_code == 0)
+		cout << "value types: all tests passed\n";
+	return return_code;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "util.h"
+#include "../manseglib.hpp"
+#include "../manseglib_results.hpp"
+
+using namespace ManSeg;
+using namespace std;
+
+constexpr int length = 1001;
+
+int fail(const char* what)
+{
+	cerr << what << "\n";
+	return 1;
+}
+
+int main()
+{
+	int return_code = 0;
+	const char* path = "warm_start_test.seg";
+	const char* mapPath = "warm_start_test.map";
+
+	ManSegArray x(length);
+	x.allocFull();
+	double sum = 0.0;
+	for(int i = 0; i < length; ++i)
+	{
+		x.full[i] = 1.0 + sin(i) * 0.5 + i * 1e-9;
+		sum += x.full[i];
+	}
+	for(int i = 0; i < length; ++i)
+	{
+		x.full[i] /= sum;
+		x.heads.set(i, x.full[i]);
+	}
+
+	if(!writeSegments(path, x.full, length))
+		return fail("cannot write the snapshot");
+
+	// the planes hold the doubles exactly, and the heads plane alone the heads
+	vector<double> exact, heads;
+	if(!loadSegments(path, exact, true) || exact.size() != length || !loadSegments(path, heads) || heads.size() != length)
+		return fail("cannot read the snapshot back");
+	for(int i = 0; i < length; ++i)
+	{
+		if(exact[i] != x.full[i])
+			return_code |= fail("a value did not survive the snapshot");
+		if(heads[i] != x.heads.read(i))
+			return_code |= fail("the heads plane differs from the heads");
+		if(return_code) break;
+	}
+
+	// the same graph: the heads, scaled to sum to 1
+	vector<double> start;
+	if(!warmStart(path, nullptr, length, start) || start.size() != length)
+		return fail("no warm start from the snapshot");
+	double total = 0.0;
+	for(int i = 0; i < length; ++i)
+		total += start[i];
+	if(fabs(total - 1.0) > 1e-12 || fabs(start[7] - heads[7]) > 1e-6 * heads[7])
+		return_code |= fail("warm start is not the normalised heads");
+
+	// vertex 0 deleted, the rest moved down one, and two new vertices at the end
+	{
+		ofstream map(mapPath);
+		map << -1 << "\n";
+		for(int i = 1; i < length; ++i)
+			map << i - 1 << "\n";
+	}
+	const int n = length + 1;
+	if(!warmStart(path, mapPath, n, start) || start.size() != n)
+		return fail("no warm start through the map");
+	total = 0.0;
+	for(int i = 0; i < n; ++i)
+		total += start[i];
+	// the carried vertices keep their proportions, the new ones start at 1/n before scaling
+	const double scale = start[0] / heads[1];
+	if(fabs(total - 1.0) > 1e-12 || fabs(start[9] - heads[10] * scale) > 1e-12
+		|| fabs(start[n - 1] - scale / n) > 1e-12 || start[n - 2] != start[n - 1])
+		return_code |= fail("warm start through the map is wrong");
+
+	// a map of the wrong length, or no snapshot, is a cold start
+	{
+		ofstream map(mapPath);
+		map << 0 << "\n";
+	}
+	if(warmStart(path, mapPath, n, start) || !start.empty())
+		return_code |= fail("a short map was accepted");
+	if(warmStart("warm_start_missing.seg", nullptr, n, start) || warmStart(nullptr, nullptr, n, start))
+		return_code |= fail("a missing snapshot was accepted");
+
+	remove(path);
+	remove(mapPath);
+
+	if(return_code == 0)
+		cout << "warm start: all tests passed\n";
+	return return_code;
+}